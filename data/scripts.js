@@ -6,6 +6,7 @@
 
 // Global variables
 let isLoading = false;
+let configSchema = null;        // Promise of the /config_schema field list
 
 // Initialize when DOM is loaded
 document.addEventListener('DOMContentLoaded', function() {
@@ -19,8 +20,9 @@ document.addEventListener('DOMContentLoaded', function() {
     }
 
     if (window.location.pathname.includes('configuration.html')) {
-        // Load config and update UI indicators
+        // Load config and update UI indicators; the schema sets the input limits
         loadCurrentConfiguration();
+        loadConfigSchema().catch(error => console.error('Load config schema error:', error));
     }
 });
 
@@ -189,18 +191,17 @@ function saveConfiguration() {
         return;
     }
 
-    const formData = getFormData();
-    
     setLoading(true);
     showStatus('Saving configuration...', 'info');
 
-    fetch('/save_config', {
+    loadConfigSchema()
+    .then(fields => fetch('/save_config', {
         method: 'POST',
         headers: {
             'Content-Type': 'application/json',
         },
-        body: JSON.stringify(formData)
-    })
+        body: JSON.stringify(getFormData(fields))
+    }))
     .then(response => {
         if (!response.ok) {
             throw new Error(`HTTP error! status: ${response.status}`);
@@ -228,130 +229,94 @@ function saveConfiguration() {
 }
 
 /**
- * Get form data as object
+ * Fetch the config fields once: JSON key, type, limits and default (config_schema.h)
  */
-function getFormData() {
-    const macAddress = document.getElementById('macAddress')?.value.trim() || '';
-    const ipAddress = document.getElementById('ipAddress')?.value.trim() || '';
-    const password = document.getElementById('password')?.value.trim() || '';
-    const activeKey = document.getElementById('activeKey')?.value.trim() || '';
-    const pendingKey = document.getElementById('pendingKey')?.value.trim() || '';
-    const bootCount = parseInt(document.getElementById('bootCount')?.value) || 0;
-    const deviceRole = parseInt(document.getElementById('deviceRole')?.value) || 2;
-    const bridgeSsid = document.getElementById('bridgeSsid')?.value.trim() || '';
-    const bridgePassword = document.getElementById('bridgePassword')?.value.trim() || '';
-    const mqttServerIp = document.getElementById('mqttServerIp')?.value.trim() || '';
-    const mqttPort = parseInt(document.getElementById('mqttPort')?.value) || 1883;
-    const mqttUsername = document.getElementById('mqttUsername')?.value.trim() || '';
-    const mqttPassword = document.getElementById('mqttPassword')?.value.trim() || '';
-    const mqttClientId = document.getElementById('mqttClientId')?.value.trim() || '';
-    const mqttQos = parseInt(document.getElementById('mqttQos')?.value) || 0;
-    const mqttBaseTopic = document.getElementById('mqttBaseTopic')?.value.trim() || '';
-
-    return {
-        macAddress: macAddress,
-        ipAddress: ipAddress,
-        password: password,
-        activeKey: activeKey,
-        pendingKey: pendingKey,
-        bootCount: bootCount,
-        deviceRole: deviceRole,
-        bridgeSsid: bridgeSsid,
-        bridgePassword: bridgePassword,
-        mqttServerIp: mqttServerIp,
-        mqttPort: mqttPort,
-        mqttUsername: mqttUsername,
-        mqttPassword: mqttPassword,
-        mqttClientId: mqttClientId,
-        mqttQos: mqttQos,
-        mqttBaseTopic: mqttBaseTopic
-    };
+function loadConfigSchema() {
+    if (!configSchema) {
+        configSchema = fetch('/config_schema')
+            .then(response => {
+                if (!response.ok) {
+                    throw new Error(`HTTP error! status: ${response.status}`);
+                }
+                return response.json();
+            })
+            .then(fields => {
+                applySchemaLimits(fields);
+                return fields;
+            })
+            .catch(error => {
+                configSchema = null;
+                throw error;
+            });
+    }
+    return configSchema;
 }
 
 /**
- * Populate form with data
+ * Give each form input the length or range limits the device enforces
  */
-function populateForm(data) {
-    const macAddress = document.getElementById('macAddress');
-    const ipAddress = document.getElementById('ipAddress');
-    const password = document.getElementById('password');
-    const activeKey = document.getElementById('activeKey');
-    const pendingKey = document.getElementById('pendingKey');
-    const bootCount = document.getElementById('bootCount');
-    const deviceRole = document.getElementById('deviceRole');
-    const bridgeSsid = document.getElementById('bridgeSsid');
-    const bridgePassword = document.getElementById('bridgePassword');
-    const mqttServerIp = document.getElementById('mqttServerIp');
-    const mqttPort = document.getElementById('mqttPort');
-    const mqttUsername = document.getElementById('mqttUsername');
-    const mqttPassword = document.getElementById('mqttPassword');
-    const mqttClientId = document.getElementById('mqttClientId');
-    const mqttQos = document.getElementById('mqttQos');
-    const mqttBaseTopic = document.getElementById('mqttBaseTopic');
-
-    if (macAddress && data.macAddress) {
-        macAddress.value = data.macAddress;
-    }
-    
-    if (ipAddress && data.ipAddress) {
-        ipAddress.value = data.ipAddress;
-    }
-    
-    if (password && data.password) {
-        password.value = data.password;
-    }
-    
-    if (activeKey && data.activeKey) {
-        activeKey.value = data.activeKey;
-    }
-    
-    if (pendingKey && data.pendingKey) {
-        pendingKey.value = data.pendingKey;
-    }
-    
-    if (bootCount && data.bootCount !== undefined) {
-        bootCount.value = data.bootCount;
-    }
-
-    if (deviceRole && data.deviceRole !== undefined) {
-        deviceRole.value = data.deviceRole;
-    }
-
-    if (bridgeSsid && data.bridgeSsid) {
-        bridgeSsid.value = data.bridgeSsid;
-    }
-
-    if (bridgePassword && data.bridgePassword) {
-        bridgePassword.value = data.bridgePassword;
-    }
-
-    if (mqttServerIp && data.mqttServerIp) {
-        mqttServerIp.value = data.mqttServerIp;
+function applySchemaLimits(fields) {
+    const form = document.getElementById('configForm');
+    if (!form) {
+        return;
     }
 
-    if (mqttPort && data.mqttPort !== undefined) {
-        mqttPort.value = data.mqttPort;
-    }
+    fields.forEach(field => {
+        const input = form.elements[field.key];
+        if (!input || input.tagName !== 'INPUT') {
+            return;
+        }
+        if (field.maxLength !== undefined) {
+            input.maxLength = field.maxLength;
+        }
+        if (field.type === 'number' && input.type === 'number') {
+            input.min = field.min;
+            input.max = field.max;
+        }
+    });
+}
 
-    if (mqttUsername && data.mqttUsername) {
-        mqttUsername.value = data.mqttUsername;
-    }
+/**
+ * Get form data as object, one member per schema field the form has an input for
+ */
+function getFormData(fields) {
+    const form = document.getElementById('configForm');
+    const data = {};
 
-    if (mqttPassword && data.mqttPassword) {
-        mqttPassword.value = data.mqttPassword;
-    }
+    fields.forEach(field => {
+        const input = form?.elements[field.key];
+        if (!input) {
+            return;
+        }
+        data[field.key] = field.type === 'number'
+            ? parseInt(input.value) || field.default
+            : input.value.trim();
+    });
 
-    if (mqttClientId && data.mqttClientId) {
-        mqttClientId.value = data.mqttClientId;
+    // Kept by SystemMetrics, not the config, so it is not in the schema
+    const bootCount = form?.elements['bootCount'];
+    if (bootCount) {
+        data.bootCount = parseInt(bootCount.value) || 0;
     }
+    return data;
+}
 
-    if (mqttQos && data.mqttQos !== undefined) {
-        mqttQos.value = data.mqttQos;
+/**
+ * Populate form with data; each member goes to the input of the same name
+ */
+function populateForm(data) {
+    const form = document.getElementById('configForm');
+    if (!form) {
+        return;
     }
 
-    if (mqttBaseTopic && data.mqttBaseTopic) {
-        mqttBaseTopic.value = data.mqttBaseTopic;
-    }
+    Object.keys(data).forEach(key => {
+        const input = form.elements[key];
+        const value = data[key];
+        if (input && value !== undefined && value !== null && value !== '') {
+            input.value = value;
+        }
+    });
 }
 
 /**
@@ -386,7 +351,11 @@ function updateCurrentConfigDisplay(data) {
         </div>
         <div class="config-item">
             <span class="config-label">Device Role:</span>
-            <span class="config-value">${data.deviceRole === 1 ? 'Gateway' : data.deviceRole === 2 ? 'Responder/Node' : 'Unknown'}</span>
+            <span class="config-value">${{1: 'Gateway', 2: 'Responder/Node', 3: 'Link Test Initiator', 4: 'Link Test Reflector', 5: 'Node Simulator'}[data.deviceRole] || 'Unknown'}</span>
+        </div>
+        <div class="config-item">
+            <span class="config-label">BME680 Profile:</span>
+            <span class="config-value">${['Low power', 'Balanced', 'High precision'][data.bme680Profile] || 'Balanced'}</span>
         </div>
         <div class="config-item">
             <span class="config-label">Bridge WiFi SSID:</span>
@@ -424,6 +393,10 @@ function updateCurrentConfigDisplay(data) {
             <span class="config-label">MQTT Base Topic:</span>
             <span class="config-value">${data.mqttBaseTopic || 'Not set'}</span>
         </div>
+        <div class="config-item">
+            <span class="config-label">MQTT Format:</span>
+            <span class="config-value">${['Per field', 'Batched JSON', 'Batched CBOR'][data.mqttFormat] || 'Per field'}</span>
+        </div>
     `;
 
     configDataElement.innerHTML = html;
@@ -7,6 +7,7 @@ Automatically copies firmware.bin and spiffs.bin to firmware/ folder
 Import("env")
 import shutil
 import os
+import zlib
 from pathlib import Path
 
 def copy_firmware_files(source, target, env):
@@ -49,6 +50,12 @@ def copy_firmware_files(source, target, env):
                 shutil.copy2(source_file, dest_file)
                 file_size = dest_file.stat().st_size
                 print(f"✅ {file_name}: {source_file.name} → firmware/ ({file_size:,} bytes)")
+
+                # zlib copy for /api/ota; the device inflates it while writing
+                packed = zlib.compress(dest_file.read_bytes(), 9)
+                packed_file = dest_file.with_name(dest_file.name + ".zz")
+                packed_file.write_bytes(packed)
+                print(f"   {packed_file.name}: {len(packed):,} bytes ({len(packed) * 100 // max(file_size, 1)}% of image)")
                 success_count += 1
             else:
                 print(f"⚠️  {file_name}: {source_file.name} not found")
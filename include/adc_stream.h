@@ -0,0 +1,127 @@
+/**
+ * @file adc_stream.h
+ * @brief Continuous ADC1 sampling over DMA: oversampled, decimated and filtered per channel, read in O(1)
+ *
+ * METRIC_VDD33_VOLTAGE and the wind vane took single oneshot conversions
+ * on demand: noisy readings, each a blocking call, and the two fought over
+ * the unit. The stream runs ADC1 in continuous mode instead. The DMA
+ * engine scans the channels added with adc_stream_add() at
+ * ADC_STREAM_SAMPLE_HZ in total, into ADC_STREAM_FRAME_BYTES frames with
+ * room for two in the driver's pool, so one fills while the last is
+ * read. The CPU wakes once per frame (about ADC_STREAM_FRAME_MS): the
+ * stream task averages each channel's conversions in the frame into one
+ * decimated value (oversampling; at the default rate and two channels,
+ * over 500 conversions each), then runs it through a first-order IIR
+ * filter of the channel's shift. The filtered value and its calibrated
+ * millivolts are published under a spinlock, so adc_stream_get() is a
+ * copy.
+ *
+ * Continuous mode and oneshot cannot share ADC1, so adc_stream_start()
+ * releases the unit SystemMetrics holds (system_metrics_release_adc())
+ * and, when ADC_STREAM_VDD_CHANNEL is streamed, feeds METRIC_VDD33_VOLTAGE
+ * from it. The driver holds the APB clock while it runs, which stops
+ * light sleep, and the ULP needs ADC1 in deep sleep: only an awake node
+ * or a gateway streams.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ADC_STREAM_H
+#define ADC_STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ADC_STREAM_CHANNELS 4                   // Channels one stream scans
+#define ADC_STREAM_SAMPLE_HZ 20000              // Conversions per second, all channels together (the ESP32's lowest)
+#define ADC_STREAM_FRAME_BYTES 4096             // One DMA frame: 2048 conversions
+#define ADC_STREAM_FRAME_MS (ADC_STREAM_FRAME_BYTES / 2 * 1000 / ADC_STREAM_SAMPLE_HZ)
+#define ADC_STREAM_NAME_LEN 8
+#define ADC_STREAM_VDD_CHANNEL 0                // ADC1_CH0 (GPIO36): the METRIC_VDD33_VOLTAGE input
+#define ADC_STREAM_VDD_SHIFT 4                  // Supply filter: about 16 frames, 1.6 s
+#define ADC_STREAM_STOP_TIMEOUT_MS 500
+
+/**
+ * @brief Latest value of one channel
+ */
+typedef struct {
+    uint16_t raw;                               // Filtered conversion, 0..4095
+    int16_t mv;                                 // Calibrated, -1 without a calibration scheme
+    uint16_t conversions;                       // Averaged into the last frame's decimated value
+    int64_t time_us;                            // When the frame was read
+} adc_stream_value_t;
+
+/**
+ * @brief Stream counters
+ */
+typedef struct {
+    bool running;
+    uint8_t channels;
+    uint32_t frames;                            // DMA frames read
+    uint32_t overflows;                         // Frames the driver dropped because the pool was full
+    uint32_t read_us_max;                       // Longest frame read and filter
+} adc_stream_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Add a channel; before adc_stream_start()
+ *
+ * @param name Name for the log
+ * @param channel ADC1 channel; 12 dB attenuation, full scale about 3.1 V
+ * @param shift IIR filter shift: each frame moves the value 1/2^shift of the way (0: the frame's mean as is)
+ * @param id Receives the channel's id
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE once started, ESP_ERR_INVALID_ARG, or ESP_ERR_NO_MEM
+ *         when ADC_STREAM_CHANNELS are added
+ */
+esp_err_t adc_stream_add(const char *name, uint8_t channel, uint8_t shift, uint8_t *id);
+
+/**
+ * @brief Take ADC1 over from SystemMetrics and start the DMA stream and its task
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if running or no channel was added, or the driver error
+ */
+esp_err_t adc_stream_start(void);
+
+/**
+ * @brief Latest value of a channel
+ *
+ * @return bool false for an unknown channel or before its first frame
+ */
+bool adc_stream_get(uint8_t id, adc_stream_value_t *value);
+
+/**
+ * @brief Find the channel streaming an ADC1 channel
+ *
+ * @return bool false if it is not streamed
+ */
+bool adc_stream_find(uint8_t channel, uint8_t *id);
+
+/**
+ * @brief Copy the counters
+ */
+void adc_stream_get_stats(adc_stream_stats_t *stats);
+
+/**
+ * @brief Stop the stream and forget the channels; ADC1 stays with the stream until the next boot
+ */
+void adc_stream_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADC_STREAM_H
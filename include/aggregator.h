@@ -0,0 +1,231 @@
+/**
+ * @file aggregator.h
+ * @brief Streaming window aggregates on the gateway: count, min, max, mean and stddev per node and metric
+ *
+ * Every sample the forwarder takes off the record ring is folded into a
+ * Welford accumulator for each window configured for its metric, in O(1)
+ * and without keeping the samples:
+ *
+ *   temperature   10 min, 1 h, 24 h   (daily min and max)
+ *   pressure      1 h                 (trend: last - first)
+ *   humidity      1 h
+ *   wind speed    10 min, 1 h         (local wind module only)
+ *
+ * Windows are aligned to the sample clock (time_s / window) and close on
+ * the first sample of a later window, or AGGREGATOR_GRACE_S after their end
+ * when the node stops reporting. A closed window is handed to the emit
+ * hook, which the gateway publishes on <base>/<node id>/aggregate, and is
+ * kept for /api/aggregates next to the one still open. Samples for a window
+ * that has already closed (a node's backlog arriving late) are counted and
+ * not folded in.
+ *
+ * A node that sends on change (deadband.h) marks the record that ends a
+ * held stretch (TELEMETRY_REC_HELD). Its series is rebuilt with step-hold
+ * semantics: when such a record follows straight on from the previous one
+ * (seq + 1), the previous values are folded in again at the start of each
+ * window the stretch reached, so a window the node was quiet through still
+ * closes with the value in force, and a window it entered quietly starts
+ * from it. A stretch longer than AGGREGATOR_HOLD_MAX_S is treated as a gap.
+ *
+ * Wind direction is summarised as a rose rather than a mean: for each
+ * node that reports wind, each AGGREGATOR_ROSE_WINDOWS window counts its
+ * samples into AGGREGATOR_ROSE_SECTORS sectors by AGGREGATOR_ROSE_BINS speed
+ * bins (edges in AGGREGATOR_ROSE_EDGES), with calm samples, those below
+ * AGGREGATOR_ROSE_CALM, counted apart since their direction means nothing.
+ * The mean direction is circular: running sums of the sine and cosine of
+ * each direction, whose angle is the mean and whose length over the count
+ * is the steadiness, so 350 and 10 degrees average to north, not south. A
+ * sample costs a sector and bin lookup and two additions, whatever the
+ * window's length. Roses open, close and go late like the windows above,
+ * and a closed one goes to its own hook, which the gateway publishes on
+ * <base>/<node id>/rose.
+ *
+ * Values are in the record's fixed-point units: temperature 0.01 degC,
+ * pressure Pa, humidity 0.001 %RH, wind 0.01 m/s. The accumulators use
+ * single-precision floats, which the ESP32 does in hardware; for these
+ * ranges that keeps the mean to well under one unit.
+ *
+ * Fed and polled from the forwarder task only; readers copy under a spinlock.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "json_writer.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define AGGREGATOR_NODES 16                     // Nodes aggregated; later ones are counted as overflow
+#define AGGREGATOR_GRACE_S 120                  // A quiet window closes this long after its end
+#define AGGREGATOR_HOLD_MAX_S 86400             // Longest held stretch rebuilt from a send-on-change node
+
+#define AGGREGATOR_ROSE_NODES 4                 // Nodes with wind roses; later ones are counted as overflow
+#define AGGREGATOR_ROSE_WINDOWS { 600, 3600 }
+#define AGGREGATOR_ROSE_WINDOW_COUNT 2
+#define AGGREGATOR_ROSE_SECTORS 16              // 22.5 degrees each, the first centred on north
+#define AGGREGATOR_ROSE_BINS 6                  // Speed bins; the last has no upper edge
+#define AGGREGATOR_ROSE_EDGES { 200, 400, 600, 800, 1100 }  // Bin upper edges, 0.01 m/s
+#define AGGREGATOR_ROSE_CALM 50                 // Below this speed, 0.01 m/s, a sample is calm
+
+typedef enum {
+    AGGREGATOR_TEMPERATURE = 0,
+    AGGREGATOR_PRESSURE,
+    AGGREGATOR_HUMIDITY,
+    AGGREGATOR_WIND_SPEED,
+    AGGREGATOR_METRICS
+} aggregator_metric_t;
+
+/**
+ * @brief One window's summary
+ */
+typedef struct {
+    uint32_t node_id;
+    aggregator_metric_t metric;
+    uint32_t window_s;
+    uint32_t start_s;                           // Window start on the sample clock
+    uint32_t count;
+    int32_t min;
+    int32_t max;
+    int32_t first;                              // Earliest sample in the window
+    int32_t last;                               // Latest sample in the window
+    float mean;
+    float stddev;                               // Sample standard deviation; 0 below two samples
+} aggregator_result_t;
+
+/**
+ * @brief One window's wind rose
+ */
+typedef struct {
+    uint32_t node_id;
+    uint32_t window_s;
+    uint32_t start_s;                           // Window start on the sample clock
+    uint32_t count;                             // Samples, calm ones included
+    uint32_t calm;
+    uint16_t sectors[AGGREGATOR_ROSE_SECTORS][AGGREGATOR_ROSE_BINS];  // Samples per sector and speed bin
+    uint16_t speed_max;                         // 0.01 m/s
+    int16_t mean_dir;                           // Circular mean of the directions that were not calm; -1 if none
+    float steadiness;                           // Length of their mean unit vector: 1 for a wind that never veered
+} aggregator_rose_t;
+
+/**
+ * @brief Counters since aggregator_init()
+ */
+typedef struct {
+    uint32_t samples;                           // Samples folded in (one per metric and window)
+    uint32_t closed;                            // Windows emitted
+    uint32_t late;                              // Samples for a window already closed
+    uint32_t held;                              // Held values folded in again, rebuilding a send-on-change series
+    uint32_t overflow;                          // Samples from nodes beyond AGGREGATOR_NODES or AGGREGATOR_ROSE_NODES
+    uint32_t nodes;
+    uint32_t rose_samples;                      // Wind samples counted into roses (one per rose window)
+    uint32_t roses_closed;
+    uint32_t rose_nodes;
+} aggregator_stats_t;
+
+/**
+ * @brief Called with each closed window, from the forwarder task
+ */
+typedef void (*aggregator_emit_t)(const aggregator_result_t *result);
+
+/**
+ * @brief Called with each closed wind rose, from the forwarder task
+ */
+typedef void (*aggregator_rose_emit_t)(const aggregator_rose_t *rose);
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Allocate the accumulators
+ *
+ * @param emit Closed-window hook; NULL only keeps them for aggregator_write_json()
+ * @param emit_rose Closed-rose hook, likewise
+ * @return esp_err_t ESP_OK or ESP_ERR_NO_MEM
+ */
+esp_err_t aggregator_init(aggregator_emit_t emit, aggregator_rose_emit_t emit_rose);
+
+/**
+ * @brief Free the accumulators; open windows are dropped
+ */
+void aggregator_deinit(void);
+
+/**
+ * @brief Fold one sample into every window of its metric
+ *
+ * @param node_id Node the sample came from
+ * @param metric Which metric
+ * @param value Fixed-point value
+ * @param time_s Sample time, Unix seconds
+ */
+void aggregator_add(uint32_t node_id, aggregator_metric_t metric, int32_t value, uint32_t time_s);
+
+/**
+ * @brief Fold a telemetry record's temperature, pressure and humidity, after the values it says were held
+ */
+void aggregator_add_record(uint32_t node_id, const telemetry_record_t *rec);
+
+/**
+ * @brief Count one wind sample into every rose window of its node
+ *
+ * @param node_id Node the sample came from
+ * @param dir_deg Direction the wind is from, 0..359; below 0 for no vane reading, which counts as calm
+ * @param speed Speed, 0.01 m/s
+ * @param time_s Sample time, Unix seconds
+ */
+void aggregator_add_wind(uint32_t node_id, int16_t dir_deg, uint16_t speed, uint32_t time_s);
+
+/**
+ * @brief Close the windows whose node went quiet; forwarder task, each pass
+ */
+void aggregator_poll(void);
+
+/**
+ * @brief Metric name as used in JSON and MQTT payloads ("temperature", "windSpeed", ...)
+ */
+const char *aggregator_metric_name(aggregator_metric_t metric);
+
+/**
+ * @brief Copy the counters
+ */
+void aggregator_get_stats(aggregator_stats_t *stats);
+
+/**
+ * @brief One summary as a JSON object: node, metric, window, start, n, min, max, first, last, mean, sd
+ */
+void aggregator_write_result(json_writer_t *w, const aggregator_result_t *result);
+
+/**
+ * @brief One rose as a JSON object: node, window, start, n, calm, dir, steadiness, max, edges, sectors
+ *
+ * sectors is AGGREGATOR_ROSE_SECTORS arrays of AGGREGATOR_ROSE_BINS counts,
+ * clockwise from north; edges are the bins' upper edges.
+ */
+void aggregator_write_rose(json_writer_t *w, const aggregator_rose_t *rose);
+
+/**
+ * @brief Counters, then the open and the last closed window of every node and metric, then the roses likewise,
+ *        for /api/aggregates
+ */
+void aggregator_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AGGREGATOR_H
@@ -0,0 +1,110 @@
+/**
+ * @file asset_cache.h
+ * @brief In-RAM cache for static web UI assets
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef ASSET_CACHE_BUDGET_BYTES
+#define ASSET_CACHE_BUDGET_BYTES (32 * 1024)    // RAM budget for cached assets (override via build flag)
+#endif
+#define ASSET_CACHE_MAX_ENTRIES 24              // Maximum number of cached files
+#define ASSET_CACHE_PATH_MAX_LEN 40             // Longest cached path, including leading '/'
+#define ASSET_ETAG_MAX_LEN 20                   // Quoted 16 hex digit strong ETag plus terminator
+#define ASSET_MANIFEST_FILE "etags.txt"         // ETag manifest written by scripts/build_web_assets.py
+
+/**
+ * @brief A cached asset, valid until asset_cache_deinit() is called
+ */
+typedef struct {
+    const uint8_t *data;                        // File contents
+    size_t size;                                // File size in bytes
+    const char *etag;                           // Quoted strong ETag, or NULL if none is known
+} asset_cache_entry_t;
+
+/**
+ * @brief Cache occupancy and hit/miss counters
+ */
+typedef struct {
+    uint32_t hits;                              // Lookups served from RAM
+    uint32_t misses;                            // Lookups that fell back to the filesystem
+    uint32_t entries;                           // Number of cached files
+    size_t bytes_used;                          // Bytes of file data held in RAM
+    size_t budget_bytes;                        // Configured RAM budget
+} asset_cache_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Load the web UI files from a mounted filesystem into RAM
+ *
+ * Pre-compressed (.gz) variants are loaded first since most clients use them,
+ * then the smallest files, until the budget is exhausted. All cached files
+ * share one contiguous allocation. Files that do not fit stay on the filesystem.
+ * ETags come from the build-time manifest; cached files missing from it get
+ * one hashed from their contents.
+ *
+ * @param base_path VFS mount point to scan (e.g. "/data")
+ * @param budget_bytes Maximum number of bytes of file data to cache
+ * @return esp_err_t ESP_OK on success (including an empty cache), error code otherwise
+ */
+esp_err_t asset_cache_init(const char *base_path, size_t budget_bytes);
+
+/**
+ * @brief Release the cache buffer and forget all entries
+ */
+void asset_cache_deinit(void);
+
+/**
+ * @brief Look up a file by its path relative to the mount point
+ *
+ * @param path Path with leading '/', e.g. "/index.html.gz"
+ * @param entry Filled with the cached data on a hit
+ * @return true if the file is cached (counted as a hit), false otherwise
+ */
+bool asset_cache_lookup(const char *path, asset_cache_entry_t *entry);
+
+/**
+ * @brief Get the strong ETag of any known asset, cached or not
+ *
+ * @param path Path with leading '/', e.g. "/styles.css"
+ * @return Quoted ETag string, or NULL if the asset is unknown
+ */
+const char *asset_cache_get_etag(const char *path);
+
+/**
+ * @brief Record a request that had to be served from the filesystem
+ */
+void asset_cache_record_miss(void);
+
+/**
+ * @brief Get cache occupancy and hit/miss counters
+ *
+ * @param stats Pointer to stats structure to fill
+ */
+void asset_cache_get_stats(asset_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ASSET_CACHE_H
@@ -0,0 +1,108 @@
+/**
+ * @file bench_suite.h
+ * @brief On-target micro-benchmarks with cycle-counter timing, printed as JSON
+ *
+ * The [env:bench] build sets BENCH_BUILD, and app_main then runs this suite
+ * after the core system init instead of choosing a role. Each case times
+ * its operations with esp_cpu_get_cycle_count() (per operation: min, mean,
+ * max) and esp_timer (wall time, throughput):
+ *
+ *   flash_erase / flash_write / flash_read   inactive OTA slot, per chunk size (OTA_CHUNK_SIZE)
+ *   sha256_hw or sha256_sw                   mbedtls, per CONFIG_MBEDTLS_HARDWARE_SHA
+ *   fs_mount                                 data partition mount (storage.h backend)
+ *   fs_read                                  largest asset, per buffer size (file_get_handler)
+ *   fs_serve                                 each asset stat, open, read and close, 1 KB buffer
+ *   fs_append                                open, append, close per record size (ts_store)
+ *   nvs_open / nvs_commit_each / nvs_commit_batch   (NVS write batching)
+ *   nvs_config_load / nvs_config_store       bulk config path (nvs_utils.h), and nvs_config_get,
+ *   / nvs_config_get                         the RAM cache read; encrypted on [env:bench-secure]
+ *   espnow_send / espnow_send_done           hand-off, and send to send callback (broadcast)
+ *   espnow_mod_peer                          one LMK change on an encrypted peer (key rotation)
+ *   http_route / http_config_get /           the portal's request logic on synthetic requests
+ *   http_config_save / http_ota_multipart    (web_handlers.h through http_io_init_mem()), no socket
+ *   rx_path / rx_path_flash                  receive hand-off across the cores, alone and under
+ *                                            flash writes (iram_profile.h; diff [env:bench-iram])
+ *   tcp_connect / tls_connect_full / tls_connect_resumed   loopback connect, TLS with and without
+ *                                            a session ticket ([env:bench-https] only)
+ *   http_get / https_get                     16 KB keep-alive GETs, plain and TLS ([env:bench-https] only)
+ *
+ * The results go to the console as one JSON document between BENCH_JSON_BEGIN
+ * and BENCH_JSON_END lines, so two builds can be captured and diffed:
+ *
+ *   {"version":"1.0.0","idf":"v5.4","cpu_mhz":240,"fs":"SPIFFS","nvs_encrypted":false,"results":[
+ *    {"case":"flash_write","size":4096,"ops":16,"bytes":65536,"us":41000,
+ *     "cycles_min":...,"cycles_mean":...,"cycles_max":...,"kib_s":1560.9,"err":"ESP_OK"},...]}
+ *
+ * scripts/perf_dashboard.py keeps captures per firmware version, plots the
+ * trend and flags the cases that got slower.
+ *
+ * The filesystem cases run on whichever backend the build selects (see
+ * storage.h); [env:bench-littlefs] is the LittleFS twin of [env:bench], so
+ * the two captures compare SPIFFS and LittleFS directly. Flash the matching
+ * data image (`pio run -e <env> -t uploadfs`) first.
+ *
+ * The suite runs on the main task, which is pinned to TASK_CORE_APP, so every
+ * cycle count comes from one core's counter. Power management is left
+ * unconfigured, so the clock stays at its default. The flash cases
+ * overwrite the inactive OTA slot, so an OTA image staged there is lost.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef BENCH_SUITE_H
+#define BENCH_SUITE_H
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef BENCH_BUILD
+#define BENCH_BUILD 0                           // Set by [env:bench]: run the suite instead of a role
+#endif
+
+#define BENCH_FLASH_BYTES (64 * 1024)           // Erased, written and read per chunk size
+#define BENCH_SHA_BYTES 4096                    // Hashed per operation
+#define BENCH_SHA_ROUNDS 64
+#define BENCH_FS_PASSES 3                       // Whole-file reads per buffer size, and serves of every asset
+#define BENCH_FS_APPEND_BYTES (32 * 1024)       // Appended per record size in fs_append
+#define BENCH_NVS_NAMESPACE "bench"             // Erased again when the suite ends
+#define BENCH_NVS_ROUNDS 16
+#define BENCH_NVS_BATCH 8                       // Keys set per commit in nvs_commit_batch
+#define BENCH_ESPNOW_CHANNEL 1
+#define BENCH_ESPNOW_FRAMES 64
+#define BENCH_ESPNOW_TIMEOUT_MS 100             // Longest wait for one send callback
+#define BENCH_RX_FRAMES 256                     // Frames per rx_path case, one per tick
+#define BENCH_RX_WAIT_MS 100                    // Consumer's wait for a frame before it checks for the end
+#define BENCH_HTTP_ROUNDS 64                    // Synthetic requests per http_* case
+#define BENCH_HTTP_SEGMENT 1436                 // Body bytes per recv: one TCP segment
+#define BENCH_HTTPS_CONNECTS 8                  // Connects per tcp_connect / tls_connect_* case
+#define BENCH_HTTPS_GETS 16                     // GETs on one connection per http_get / https_get
+#define BENCH_HTTPS_TIMEOUT_MS 5000
+#define BENCH_JSON_BEGIN "BENCH_JSON_BEGIN"
+#define BENCH_JSON_END "BENCH_JSON_END"
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Run every case and print the results; call after NVS is up
+ *
+ * @return esp_err_t ESP_OK once the results are printed (failed cases carry their own error),
+ *         or ESP_ERR_NO_MEM if the work buffer could not be allocated
+ */
+esp_err_t bench_suite_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BENCH_SUITE_H
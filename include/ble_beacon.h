@@ -0,0 +1,104 @@
+/**
+ * @file ble_beacon.h
+ * @brief Current readings broadcast as BTHome v2 BLE advertisements, for phones nearby
+ *
+ * A non-connectable NimBLE broadcaster: no GATT server, no pairing, nothing
+ * for a phone to join. Every BLE_BEACON_INTERVAL_MS the radio sends one
+ * legacy advertisement (31 bytes) holding
+ *
+ *   flags                       LE general discoverable, no BR/EDR
+ *   service data, UUID 0xFCD2   BTHome v2, unencrypted:
+ *     0x00 packet id (u8)       bumped on every new reading
+ *     0x02 temperature (s16)    0.01 degC
+ *     0x03 humidity (u16)       0.01 %RH
+ *     0x04 pressure (u24)       0.01 hPa, that is Pa
+ *   complete local name         BLE_BEACON_NAME_PREFIX and the node id's low 16 bits in hex
+ *
+ * which Home Assistant's BTHome integration and BTHome-aware scanner apps
+ * show as a temperature / humidity / pressure sensor without any setup.
+ *
+ * BTHome names a device by its Bluetooth address, so the beacon speaks for
+ * one node: BLE_BEACON_NODE_ID, or with 0 the first node heard after boot.
+ * The forwarder hands each of that node's records to ble_beacon_update(),
+ * which only copies it; ble_beacon_poll(), later in the same pass, puts the
+ * newest one on the air with one HCI command. Replayed records older than
+ * the one on the air are ignored.
+ *
+ * NimBLE has to be in the build: [env:ble] applies sdkconfig.ble.defaults,
+ * which enables it in the broadcaster role only.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef BLE_BEACON_H
+#define BLE_BEACON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef BLE_BEACON_NODE_ID
+#define BLE_BEACON_NODE_ID 0                    // Node whose readings are broadcast (0: the first one heard)
+#endif
+#define BLE_BEACON_INTERVAL_MS 1000             // Advertising interval; scanners pick up a change within a few
+#define BLE_BEACON_NAME_PREFIX "WX-"
+#define BLE_BEACON_ADV_MAX 31                   // Legacy advertising payload
+
+/**
+ * @brief Counters
+ */
+typedef struct {
+    bool advertising;
+    uint32_t node_id;                           // Node on the air (0: none yet)
+    uint32_t updates;                           // Readings put on the air
+    uint32_t stale;                             // Records older than the one on the air, ignored
+    uint32_t errors;                            // Failed advertising data or start commands
+} ble_beacon_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Start the NimBLE host; advertising begins with the first reading
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_SUPPORTED without NimBLE in the build, or the controller/host init error
+ */
+esp_err_t ble_beacon_start(void);
+
+/**
+ * @brief Stop advertising and shut the NimBLE host and controller down
+ */
+void ble_beacon_stop(void);
+
+/**
+ * @brief Offer one record; forwarder task only, copies it and returns
+ */
+void ble_beacon_update(uint32_t node_id, const telemetry_record_t *rec);
+
+/**
+ * @brief Put the newest offered reading on the air; forwarder task only
+ */
+void ble_beacon_poll(void);
+
+/**
+ * @brief Copy the counters
+ */
+void ble_beacon_get_stats(ble_beacon_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLE_BEACON_H
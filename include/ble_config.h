@@ -0,0 +1,82 @@
+/**
+ * @file ble_config.h
+ * @brief Configuration over a BLE GATT service, opened by a boot button press while the role runs
+ *
+ * The lighter path to the settings: no AP, DNS, httpd or SPIFFS, and no
+ * restart to get there, so the role (ESP-NOW included) keeps running while
+ * a phone app reads and writes the configuration. With BLE_CONFIG=1 a
+ * boot button press in normal operation opens the service instead of
+ * restarting into the portal; a second press while it is open still
+ * restarts into the portal.
+ *
+ * One primary service, BLE_CONFIG_SERVICE_UUID, with two characteristics,
+ * both needing an encrypted link (LE Secure Connections, Just Works):
+ *
+ *   BLE_CONFIG_SCHEMA_UUID   read: config_schema_encode_meta(), the fields
+ *                            with their types and limits
+ *   BLE_CONFIG_VALUES_UUID   read: config_schema_encode(), every field
+ *                            write: config_schema_apply_binary() entries,
+ *                            any subset; a long write for more than the MTU
+ *
+ * A write is applied whole or refused with an ATT error, then goes into the
+ * config cache and is committed at once in one NVS transaction
+ * (nvs_config_update(), nvs_config_flush()). After a write the device
+ * restarts when the phone disconnects, so the role comes back up with the
+ * new settings.
+ *
+ * The service advertises, connectable, for BLE_CONFIG_WINDOW_MS after each
+ * press; one phone at a time. Needs NimBLE with the peripheral role:
+ * build [env:ble-config].
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef BLE_CONFIG_H
+#define BLE_CONFIG_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef BLE_CONFIG
+#define BLE_CONFIG 0                            // 1: a boot button press opens the BLE service; build [env:ble-config]
+#endif
+#define BLE_CONFIG_WINDOW_MS 300000             // Advertising after a press, until a phone connects
+#define BLE_CONFIG_NAME_PREFIX "WX-cfg-"        // Then the last two bytes of the Bluetooth address
+#define BLE_CONFIG_SERVICE_UUID "5a1e0001-7b3c-4f6e-9d2a-3c8e1f0b6a40"
+#define BLE_CONFIG_VALUES_UUID "5a1e0002-7b3c-4f6e-9d2a-3c8e1f0b6a40"
+#define BLE_CONFIG_SCHEMA_UUID "5a1e0003-7b3c-4f6e-9d2a-3c8e1f0b6a40"
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Open the configuration service for BLE_CONFIG_WINDOW_MS
+ *
+ * Brings the NimBLE host up on the first call; later calls start another
+ * advertising window.
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_SUPPORTED without BLE_CONFIG, or the host/GATT setup error
+ */
+esp_err_t ble_config_open(void);
+
+/**
+ * @brief Whether the service is advertising or a phone is connected
+ */
+bool ble_config_is_open(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLE_CONFIG_H
@@ -0,0 +1,93 @@
+/**
+ * @file boot_health.h
+ * @brief Post-boot health gate that confirms a newly updated image or rolls it back
+ *
+ * With CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE, an image installed by OTA
+ * first boots as ESP_OTA_IMG_PENDING_VERIFY. It stays on trial until the
+ * application confirms it; if the board resets first, the bootloader
+ * marks it aborted and boots the previous image.
+ *
+ * The role names the checks its image must pass (a sensor read, an answer
+ * from the ESP-NOW peer, the portal serving) and reports each as it
+ * happens. Once all have passed and the lowest free heap since boot is
+ * still above BOOT_HEALTH_MIN_HEAP, the image is confirmed with
+ * esp_ota_mark_app_valid_cancel_rollback(). An image that does not get
+ * there within BOOT_HEALTH_DEADLINE_MS, or whose heap already fell below
+ * the threshold, is rolled back at once.
+ *
+ * An image that was not installed by OTA (flashed over serial), or a build
+ * without rollback, is never on trial and every call here is a no-op.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef BOOT_HEALTH_H
+#define BOOT_HEALTH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define BOOT_HEALTH_MIN_HEAP (24 * 1024)        // Lowest free heap since boot a confirmed image may have reached
+#define BOOT_HEALTH_DEADLINE_MS (15 * 60 * 1000) // Checks must pass this long after boot_health_start()
+
+/**
+ * @brief Checks a role can require; a bit mask
+ */
+typedef enum {
+    BOOT_HEALTH_SENSOR = 1 << 0,                // A sensor read succeeded
+    BOOT_HEALTH_PEER = 1 << 1,                  // The ESP-NOW peer answered (an ACK, or a frame from a node)
+    BOOT_HEALTH_SERVICES = 1 << 2,              // Config mode: AP, DNS and the portal are serving
+} boot_health_check_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Put the running image on trial with the checks it must pass
+ *
+ * Call once the role is known. Starts the deadline; with no checks, only
+ * the heap is checked, immediately.
+ *
+ * @param checks Mask of boot_health_check_t
+ * @return esp_err_t ESP_OK, also when the image is not on trial, or the timer error
+ */
+esp_err_t boot_health_start(uint32_t checks);
+
+/**
+ * @brief Report a check as passed; confirms the image once every required one has
+ *
+ * Call from the role's main task: confirming writes the otadata partition.
+ */
+void boot_health_pass(boot_health_check_t check);
+
+/**
+ * @brief Whether the running image is still waiting to be confirmed
+ */
+bool boot_health_pending(void);
+
+/**
+ * @brief Decide now: roll back an image still on trial; call before deep sleep
+ *
+ * The wake from deep sleep goes through the bootloader, which would roll
+ * the image back anyway; this logs which checks were missing first. Does
+ * not return while the image is on trial.
+ */
+void boot_health_settle(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_HEALTH_H
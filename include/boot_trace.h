@@ -0,0 +1,111 @@
+/**
+ * @file boot_trace.h
+ * @brief Startup checkpoints kept in RTC memory, with a summary table, metric and JSON
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define BOOT_TRACE_MAX_STAGES 24                // Checkpoints kept per boot; later ones are counted, not stored
+#define BOOT_TRACE_NAME_LEN 16                  // Stage names are copied, so they survive a firmware change
+
+/**
+ * @brief One checkpoint: the end of a startup stage
+ */
+typedef struct {
+    char name[BOOT_TRACE_NAME_LEN];
+    uint32_t at_us;                             // esp_timer_get_time() at the checkpoint
+    uint32_t duration_us;                       // Since the previous checkpoint (or app_main entry)
+} boot_trace_stage_t;
+
+/**
+ * @brief The checkpoints of one boot
+ */
+typedef struct {
+    uint32_t app_start_us;                      // Time spent before app_main: ROM, bootloader, IDF startup
+    uint32_t stage_count;
+    uint32_t dropped;                           // Checkpoints past BOOT_TRACE_MAX_STAGES
+    bool complete;                              // boot_trace_done() was reached
+    uint32_t radio_us;                          // Radio up for ESP-NOW (boot_trace_radio_up()), 0 not reached
+    uint32_t first_tx_us;                       // First frame acknowledged over the air, 0 not reached
+    boot_trace_stage_t stages[BOOT_TRACE_MAX_STAGES];
+} boot_trace_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Start this boot's trace; call first thing in app_main
+ *
+ * The trace lives in RTC memory that survives software resets and panics.
+ * The previous boot's trace is copied out first, so a boot that hung or
+ * crashed part-way can still be read afterwards, showing where it stopped.
+ */
+void boot_trace_start(void);
+
+/**
+ * @brief Record the end of a startup stage
+ *
+ * @param name Stage name, truncated to BOOT_TRACE_NAME_LEN - 1 characters
+ */
+void boot_trace_mark(const char *name);
+
+/**
+ * @brief Record the radio coming up for ESP-NOW; only the first call counts
+ */
+void boot_trace_radio_up(void);
+
+/**
+ * @brief Record the first frame the peer's radio acknowledged; only the first call counts
+ *
+ * Safe from the WiFi task. On a node its time since reset is the
+ * wake-to-transmit time of the cycle, the part of each wake the radio
+ * startup decides.
+ */
+void boot_trace_first_tx(void);
+
+/**
+ * @brief Close the trace, log the summary table and publish it
+ *
+ * Registers METRIC_BOOT_TRACE and the boot_stage_seconds /metrics family,
+ * with boot_wake_to_tx_seconds once a frame went out.
+ */
+void boot_trace_done(void);
+
+/**
+ * @brief Get a copy of a trace
+ *
+ * @param previous false for this boot, true for the one before it
+ * @param trace Filled in
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND if there is no previous trace
+ */
+esp_err_t boot_trace_get(bool previous, boot_trace_t *trace);
+
+/**
+ * @brief Write this boot's and the previous boot's traces as a JSON object
+ */
+void boot_trace_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_TRACE_H
@@ -0,0 +1,131 @@
+/**
+ * @file calib.h
+ * @brief Per-unit sensor calibration: piecewise-linear tables in the config, applied in fixed point
+ *
+ * Every mounted sensor reads a little differently: the vane's potentiometer
+ * sits at some angle to the bow and is not quite linear, one set of cups
+ * turns faster than another at the same wind, and the battery divider's
+ * resistors are 1 % parts. Each sensor here has a table of up to
+ * CALIB_POINTS (input, output) points, a calib_table_t stored as a
+ * device_config_t member (config_schema.h, NVS only) and edited from the portal at
+ * /api/calibration. A table with no points stands for the build's own
+ * constants, so an uncalibrated unit reads as before.
+ *
+ *   CALIB_VANE        raw ADC (0..4095)          to 0.1 degree, relative to the bow
+ *   CALIB_ANEMOMETER  pulse rate, 0.01 Hz        to speed, 0.01 m/s
+ *   CALIB_SUPPLY      supply pin, mV             to the battery, mV (the divider)
+ *
+ * calib_load() turns each table into segments with a Q16 slope, so
+ * calib_apply() costs a few integer operations and no division or float:
+ * the segment is the count of inner points at or below the input, summed
+ * over a fixed number of compares, then one multiply and a shift. There
+ * is no branch on the input. Inputs outside the table follow its first or
+ * last segment.
+ *
+ * Two sets of segments are kept and calib_load() fills the idle one before
+ * switching, so readers take no lock. Two reloads within one sample of
+ * each other could tear that one reading; a reload is a portal save.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef CALIB_H
+#define CALIB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "json_writer.h"
+#include "nvs_utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define CALIB_TEXT_MAX 160                      // "x:y,x:y,..." at CALIB_POINTS points of 6-digit values
+
+/**
+ * @brief Calibrated sensors
+ */
+typedef enum {
+    CALIB_VANE = 0,
+    CALIB_ANEMOMETER,
+    CALIB_SUPPLY,
+    CALIB_COUNT
+} calib_sensor_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Build the segments from the stored tables; call after nvs_utils_init()
+ *
+ * Until then calib_apply() uses the build's constants.
+ */
+void calib_load(void);
+
+/**
+ * @brief Calibrate one reading
+ *
+ * @param sensor Which table
+ * @param x Input, in the table's input unit
+ * @return int32_t Output, in its output unit
+ */
+int32_t calib_apply(calib_sensor_t sensor, int32_t x);
+
+/**
+ * @brief Check a table: no points, or 2..CALIB_POINTS with rising inputs and slopes under 32768
+ */
+esp_err_t calib_validate(const calib_table_t *table);
+
+/**
+ * @brief Parse "x:y,x:y,..." into a table; an empty string is the empty table
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG for bad syntax, too many points or a failed calib_validate()
+ */
+esp_err_t calib_parse(const char *text, calib_table_t *table);
+
+/**
+ * @brief Store a sensor's table in the config and use it at once
+ *
+ * The config flush writes it to NVS shortly after.
+ */
+esp_err_t calib_set(calib_sensor_t sensor, const calib_table_t *table);
+
+/**
+ * @brief The table in force, the build's constants as points when none is stored
+ *
+ * @return bool Whether it is a stored table
+ */
+bool calib_get(calib_sensor_t sensor, calib_table_t *table);
+
+/**
+ * @brief Name in /api/calibration ("vane", "anemometer", "supply"), or NULL past the last
+ */
+const char *calib_name(calib_sensor_t sensor);
+
+/**
+ * @brief Write every table in force, with its units and whether it is stored, for /api/calibration
+ */
+void calib_write_json(json_writer_t *w);
+
+/**
+ * @brief Look a sensor up by name
+ *
+ * @return bool false if there is none of that name
+ */
+bool calib_find(const char *name, calib_sensor_t *sensor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CALIB_H
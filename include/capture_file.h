@@ -0,0 +1,97 @@
+/**
+ * @file capture_file.h
+ * @brief Byte layout of the ESP-NOW capture files frame_capture.h writes and replays
+ *
+ * Pure functions on buffers, with no files, tasks or logging, so a capture
+ * can be written and read back on a host as well as on the gateway. All
+ * fields little-endian:
+ *
+ *   File header, CAPTURE_FILE_HEADER_LEN bytes:
+ *     0..3   magic              CAPTURE_FILE_MAGIC, "WXC1"
+ *     4..7   start              Unix seconds when the file was opened, 0 if the clock was not set
+ *     8..15  reserved, 0
+ *
+ *   Then one record per frame, CAPTURE_FILE_RECORD_LEN bytes + the frame:
+ *     0..3   t                  ms since the file was opened
+ *     4..9   mac                Sender
+ *     10     rssi               dBm, signed
+ *     11     len                Frame length, 1..CAPTURE_FILE_FRAME_MAX
+ *     12..   frame              As received: telemetry, reliable DATA, OTA or slot requests...
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef CAPTURE_FILE_H
+#define CAPTURE_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define CAPTURE_FILE_MAGIC 0x31435857           // "WXC1"
+#define CAPTURE_FILE_HEADER_LEN 16
+#define CAPTURE_FILE_RECORD_LEN 12              // Before each frame
+#define CAPTURE_FILE_FRAME_MAX 250              // ESP_NOW_MAX_DATA_LEN
+#define CAPTURE_FILE_MAC_LEN 6
+
+/**
+ * @brief The record ahead of one captured frame
+ */
+typedef struct {
+    uint32_t t_ms;                              // Since the file was opened
+    uint8_t mac[CAPTURE_FILE_MAC_LEN];
+    int8_t rssi;
+    uint8_t len;                                // Frame bytes that follow the record
+} capture_file_record_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Write a file header
+ *
+ * @param out CAPTURE_FILE_HEADER_LEN bytes
+ * @param start Unix seconds, 0 if not known
+ */
+void capture_file_write_header(uint8_t *out, uint32_t start);
+
+/**
+ * @brief Check a file header
+ *
+ * @param buf CAPTURE_FILE_HEADER_LEN bytes
+ * @param start Output, Unix seconds (may be NULL)
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG if it is not a capture
+ */
+esp_err_t capture_file_read_header(const uint8_t *buf, uint32_t *start);
+
+/**
+ * @brief Write the record ahead of a frame
+ *
+ * @param out CAPTURE_FILE_RECORD_LEN bytes
+ */
+void capture_file_write_record(uint8_t *out, const capture_file_record_t *rec);
+
+/**
+ * @brief Decode the record ahead of a frame
+ *
+ * @param buf CAPTURE_FILE_RECORD_LEN bytes
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_SIZE for a length of 0 or past CAPTURE_FILE_FRAME_MAX
+ */
+esp_err_t capture_file_read_record(const uint8_t *buf, capture_file_record_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAPTURE_FILE_H
@@ -0,0 +1,79 @@
+/**
+ * @file cbor_writer.h
+ * @brief Minimal CBOR (RFC 8949) encoder into a caller-supplied buffer
+ *
+ * Covers what the MQTT batch payloads need: definite-length maps and
+ * arrays, integers, text strings and null, each in its shortest form.
+ * Running out of buffer is sticky: later calls do nothing and
+ * cbor_writer_finish() reports it.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef CBOR_WRITER_H
+#define CBOR_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+
+/**
+ * @brief Writer state; lives on the caller's stack
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;                                 // Bytes written so far
+    esp_err_t err;                              // First error seen; later calls become no-ops
+} cbor_writer_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Prepare a writer over buf
+ */
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t cap);
+
+/**
+ * @brief Result of the writes so far
+ *
+ * @param w Writer
+ * @param len Encoded length, set on success
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_SIZE if the buffer ran out
+ */
+esp_err_t cbor_writer_finish(const cbor_writer_t *w, size_t *len);
+
+/**
+ * @brief Start a map of pairs key/value pairs; write each key, then its value
+ */
+void cbor_map(cbor_writer_t *w, size_t pairs);
+
+/**
+ * @brief Start an array of count items
+ */
+void cbor_array(cbor_writer_t *w, size_t count);
+
+void cbor_uint(cbor_writer_t *w, uint64_t value);
+void cbor_int(cbor_writer_t *w, int64_t value);
+void cbor_text(cbor_writer_t *w, const char *value);
+void cbor_null(cbor_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CBOR_WRITER_H
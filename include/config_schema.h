@@ -0,0 +1,256 @@
+/**
+ * @file config_schema.h
+ * @brief One table for every device_config_t field: NVS key, JSON member, type, bounds and default
+ *
+ * CONFIG_SCHEMA lists each field once. From it come the bulk NVS load and
+ * store (nvs_utils.c), the defaults and validation, the /save_config
+ * parser and the /get_config emitter (web_server.c), /config_schema,
+ * which configuration.html reads to build its request and to set the
+ * length and range limits of its inputs, and the binary form the BLE
+ * configuration service carries (ble_config.h), and the blob
+ * /api/config/export and /api/config/import move between boards. Each entry is resolved at
+ * compile time to an offset and size in device_config_t, so the
+ * generated code copies straight into the struct instead of searching
+ * strings, and a key longer than NVS allows or a member whose size does
+ * not match its type fails the build.
+ *
+ * Adding a setting is a member in device_config_t, one line here, and an
+ * input named after its JSON member on the page.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef CONFIG_SCHEMA_H
+#define CONFIG_SCHEMA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs_utils.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+
+/**
+ * @brief How a field is stored in NVS and written in JSON
+ */
+typedef enum {
+    CONFIG_TYPE_STR,                            // NUL-terminated string; JSON string
+    CONFIG_TYPE_HEX,                            // Fixed-size bytes; JSON string of 2 hex digits per byte
+    CONFIG_TYPE_BLOB,                           // Fixed-size bytes, NVS only
+    CONFIG_TYPE_U8,                             // JSON number within [min, max]
+    CONFIG_TYPE_U16
+} config_type_t;
+
+#define CONFIG_SCHEMA_MAX_SIZE 64               // Largest member (passwords, base topic)
+#define CONFIG_SCHEMA_BINARY_MAX 512            // Longest binary form: a GATT attribute value
+#define CONFIG_SCHEMA_BLOB_MAX 1024             // Longest export blob, every field included
+#define CONFIG_SCHEMA_BLOB_VERSION 1            // Bumped when the blob's framing changes, not for new fields
+#define CONFIG_SCHEMA_BLOB_UNIT 0x01            // Blob flag: the per-unit fields are included
+
+// Default column: a number for U8/U16, a string for STR, nothing (zeros) for HEX and BLOB
+#define CONFIG_NUM(n) .def_num = (n)
+#define CONFIG_TEXT(s) .def_str = (s)
+#define CONFIG_ZERO .def_num = 0
+
+/**
+ * X(member, nvs_key, json_key, type, min, max, default)
+ *
+ * json_key NULL keeps a field off the web API. min and max bound the
+ * numeric types; a value outside them is replaced by the default.
+ */
+#define CONFIG_SCHEMA(X) \
+    X(server_mac,         "server_mac",     "macAddress",     CONFIG_TYPE_STR,  0, 0, CONFIG_TEXT("00:00:00:00:00:00")) \
+    X(server_channel,     "server_chan",    NULL,             CONFIG_TYPE_U8,   0, 14, CONFIG_NUM(0)) \
+    X(ip_address,         "ip_addr",        "ipAddress",      CONFIG_TYPE_STR,  0, 0, CONFIG_TEXT("192.168.1.100")) \
+    X(wifi_password,      "wifi_pass",      "password",       CONFIG_TYPE_STR,  0, 0, CONFIG_TEXT("12345678")) \
+    X(espnow_active_key,  "espnow_active",  "activeKey",      CONFIG_TYPE_HEX,  0, 0, CONFIG_ZERO) \
+    X(espnow_pending_key, "espnow_pending", "pendingKey",     CONFIG_TYPE_HEX,  0, 0, CONFIG_ZERO) \
+    X(device_role,        "device_role",    "deviceRole",     CONFIG_TYPE_U8,   DEVICE_ROLE_GATEWAY, DEVICE_ROLE_NODE_SIM, \
+      CONFIG_NUM(DEVICE_ROLE_RESPONDER)) \
+    X(bridge_ssid,        "bridge_ssid",    "bridgeSsid",     CONFIG_TYPE_STR,  0, 0, CONFIG_TEXT("MyBridgeWiFi")) \
+    X(bridge_password,    "bridge_pass",    "bridgePassword", CONFIG_TYPE_STR,  0, 0, CONFIG_TEXT("bridgepass123")) \
+    X(mqtt_server_ip,     "mqtt_ip",        "mqttServerIp",   CONFIG_TYPE_STR,  0, 0, CONFIG_TEXT("192.168.1.200")) \
+    X(mqtt_port,          "mqtt_port",      "mqttPort",       CONFIG_TYPE_U16,  1, 65535, CONFIG_NUM(MQTT_DEFAULT_PORT)) \
+    X(mqtt_username,      "mqtt_user",      "mqttUsername",   CONFIG_TYPE_STR,  0, 0, CONFIG_TEXT("mqttuser")) \
+    X(mqtt_password,      "mqtt_pass",      "mqttPassword",   CONFIG_TYPE_STR,  0, 0, CONFIG_TEXT("mqttpass123")) \
+    X(mqtt_client_id,     "mqtt_client",    "mqttClientId",   CONFIG_TYPE_STR,  0, 0, CONFIG_TEXT("ESP32WeatherStation")) \
+    X(mqtt_qos,           "mqtt_qos",       "mqttQos",        CONFIG_TYPE_U8,   0, 2, CONFIG_NUM(MQTT_DEFAULT_QOS)) \
+    X(mqtt_base_topic,    "mqtt_topic",     "mqttBaseTopic",  CONFIG_TYPE_STR,  0, 0, CONFIG_TEXT("weatherstation")) \
+    X(mqtt_format,        "mqtt_format",    "mqttFormat",     CONFIG_TYPE_U8,   MQTT_FORMAT_FIELDS, MQTT_FORMAT_CBOR, \
+      CONFIG_NUM(MQTT_DEFAULT_FORMAT)) \
+    X(bme680_profile,     "bme680_profile", "bme680Profile",  CONFIG_TYPE_U8,   SENSOR_PROFILE_LOW_POWER, \
+      SENSOR_PROFILE_HIGH_PRECISION, CONFIG_NUM(SENSOR_DEFAULT_PROFILE)) \
+    X(node_settings,      "node_settings",  NULL,             CONFIG_TYPE_BLOB, 0, 0, CONFIG_ZERO) \
+    X(calib_vane,         "calib_vane",     NULL,             CONFIG_TYPE_BLOB, 0, 0, CONFIG_ZERO) \
+    X(calib_wind,         "calib_wind",     NULL,             CONFIG_TYPE_BLOB, 0, 0, CONFIG_ZERO) \
+    X(calib_supply,       "calib_supply",   NULL,             CONFIG_TYPE_BLOB, 0, 0, CONFIG_ZERO)
+
+// CONFIG_FIELD_<member>: the index of a field in config_schema
+#define CONFIG_SCHEMA_INDEX(member, ...) CONFIG_FIELD_##member,
+typedef enum {
+    CONFIG_SCHEMA(CONFIG_SCHEMA_INDEX)
+    CONFIG_SCHEMA_COUNT
+} config_field_index_t;
+
+/**
+ * @brief One field of device_config_t
+ */
+typedef struct {
+    const char *nvs_key;                        // At most 15 characters
+    const char *json_key;                       // NULL: not on the web API
+    config_type_t type;
+    uint16_t offset;                            // Into device_config_t
+    uint16_t size;                              // Of the member, terminator included
+    uint16_t min;                               // U8/U16 bounds
+    uint16_t max;
+    uint16_t def_num;                           // Default of a U8/U16
+    const char *def_str;                        // Default of a STR
+} config_field_t;
+
+extern const config_field_t config_schema[CONFIG_SCHEMA_COUNT];
+
+/**
+ * @brief What config_schema_import_blob() found
+ */
+typedef struct {
+    uint16_t applied;                           // Entries copied into the configuration
+    uint16_t unknown;                           // Keys this build does not have, skipped
+    uint8_t flags;                              // CONFIG_SCHEMA_BLOB_* of the blob
+} config_import_result_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Fill a configuration with every field's default
+ */
+void config_schema_defaults(device_config_t *cfg);
+
+/**
+ * @brief Check every field: strings terminated, numbers within their bounds
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG naming the first bad field in the log
+ */
+esp_err_t config_schema_validate(const device_config_t *cfg);
+
+/**
+ * @brief Find a web API field by JSON member name
+ *
+ * @return const config_field_t* The field, NULL if there is none
+ */
+const config_field_t *config_schema_find_json(const char *json_key);
+
+/**
+ * @brief Apply a /save_config member to a configuration
+ *
+ * An empty value, a string too long for its member, or a key that is not
+ * 2 hex digits per byte keeps the current value; a number outside its
+ * bounds takes the default. Numbers may be sent bare or quoted.
+ *
+ * @param cfg Configuration to change
+ * @param field From config_schema_find_json()
+ * @param value The member's text, NUL-terminated
+ * @param len Its length
+ * @return bool Whether the field was set
+ */
+bool config_schema_apply_json(device_config_t *cfg, const config_field_t *field, const char *value, size_t len);
+
+/**
+ * @brief Write every web API field of a configuration as members of the open object
+ */
+void config_schema_write_json(json_writer_t *w, const device_config_t *cfg);
+
+/**
+ * @brief Write the schema of the web API fields as an array of
+ *        {"key","type","maxLength"|"min","max","default"} objects
+ */
+void config_schema_write_meta(json_writer_t *w);
+
+/**
+ * @brief Write every web API field of a configuration in binary form
+ *
+ * One entry per field: its index, the value's length, then the value
+ * (a string without its terminator, the key bytes, a number little-endian).
+ *
+ * @param out Output
+ * @param cap Its size; CONFIG_SCHEMA_BINARY_MAX always fits
+ * @return size_t Bytes written
+ */
+size_t config_schema_encode(const device_config_t *cfg, uint8_t *out, size_t cap);
+
+/**
+ * @brief Apply binary entries, as config_schema_encode() writes them, to a configuration
+ *
+ * Any subset of the web API fields, in any order. Nothing is applied
+ * unless every entry is well formed: a known field, a string that fits, a
+ * key of the exact length, a number within its bounds.
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG naming the first bad entry in the log
+ */
+esp_err_t config_schema_apply_binary(device_config_t *cfg, const uint8_t *data, size_t len);
+
+/**
+ * @brief Write the schema of the web API fields in binary form
+ *
+ * One entry per field: index, type (config_type_t), the longest value in
+ * bytes, min and max (u16 little-endian, 0 for strings and keys), the
+ * length of the JSON member name, then the name.
+ *
+ * @return size_t Bytes written, 0 if cap is too small
+ */
+size_t config_schema_encode_meta(uint8_t *out, size_t cap);
+
+/**
+ * @brief Whether a field belongs to one board (calibration, settings its gateway pushed) rather than the fleet
+ */
+bool config_schema_per_unit(const config_field_t *field);
+
+/**
+ * @brief Write a whole configuration as a provisioning blob
+ *
+ * Little-endian: "WSCF", CONFIG_SCHEMA_BLOB_VERSION, flags, the length of
+ * the entries (u16), the entries, then a CRC-32 of everything before it.
+ * Each entry is keyed by its NVS key rather than its index, so a blob
+ * survives fields being added or reordered: the key's length, the key,
+ * the value's length, the value (as config_schema_encode() writes it).
+ * Every field goes in, NVS-only ones included; the per-unit fields only
+ * with unit set.
+ *
+ * @param out Output
+ * @param cap Its size; CONFIG_SCHEMA_BLOB_MAX always fits
+ * @return size_t Bytes written, 0 if cap is too small
+ */
+size_t config_schema_export_blob(const device_config_t *cfg, bool unit, uint8_t *out, size_t cap);
+
+/**
+ * @brief Apply a blob from config_schema_export_blob() to a configuration
+ *
+ * The framing and CRC are checked first, then every entry: a value that
+ * does not fit its field, or a result config_schema_validate() refuses,
+ * rejects the blob and leaves cfg as it was. Keys this build does not
+ * know are skipped and counted, so a newer board's blob still loads.
+ *
+ * @param result Receives the counts; may be NULL
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_CRC for a damaged blob, ESP_ERR_NOT_SUPPORTED for
+ *         another version, or ESP_ERR_INVALID_ARG / ESP_ERR_INVALID_SIZE naming the fault in the log
+ */
+esp_err_t config_schema_import_blob(device_config_t *cfg, const uint8_t *blob, size_t len,
+                                    config_import_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONFIG_SCHEMA_H
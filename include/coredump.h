@@ -0,0 +1,94 @@
+/**
+ * @file coredump.h
+ * @brief Access to the ESP-IDF core dump stored in the coredump partition
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef COREDUMP_H
+#define COREDUMP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define COREDUMP_READ_CHUNK 1024                // Bytes read from flash per response chunk
+#define COREDUMP_MAX_BACKTRACE 16               // Frames kept from the crash summary
+#define COREDUMP_REASON_LEN 128
+
+/**
+ * @brief What is known about the stored dump without downloading it
+ */
+typedef struct {
+    bool present;                               // An image is in the partition
+    bool valid;                                 // Its checksum verifies
+    size_t size;                                // Image size in bytes
+    char panic_reason[COREDUMP_REASON_LEN];
+    bool summary_valid;                         // The fields below were decoded
+    char task[16];                              // Task running when it crashed
+    uint32_t pc;                                // Faulting program counter
+    uint32_t backtrace[COREDUMP_MAX_BACKTRACE];
+    uint32_t backtrace_depth;
+    bool backtrace_corrupted;
+    char app_sha256[65];                        // ELF SHA-256 of the crashed firmware
+} coredump_info_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Log a summary of any dump left by the previous boot
+ *
+ * @return true if a valid dump is stored
+ */
+bool coredump_check_boot(void);
+
+/**
+ * @brief Describe the stored dump
+ *
+ * @param info Receives the description; present is false when there is none
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND without a dump, or ESP_ERR_NOT_SUPPORTED when core dumps are off
+ */
+esp_err_t coredump_get_info(coredump_info_t *info);
+
+/**
+ * @brief Read part of the stored image
+ *
+ * @param offset Offset into the image
+ * @param buf Receives the bytes
+ * @param len Bytes wanted; offset + len must not pass the image size
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND, ESP_ERR_INVALID_SIZE, or the flash error
+ */
+esp_err_t coredump_read(size_t offset, void *buf, size_t len);
+
+/**
+ * @brief Erase the stored dump once it has been retrieved
+ *
+ * @return esp_err_t ESP_OK, or the core dump component's error
+ */
+esp_err_t coredump_erase(void);
+
+/**
+ * @brief Write coredump_get_info() as a JSON object
+ *
+ * @param w Writer positioned where a value is expected
+ */
+void coredump_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COREDUMP_H
@@ -0,0 +1,100 @@
+/**
+ * @file cpu_monitor.h
+ * @brief Per-task CPU usage, per-core load and stack high-water marks from FreeRTOS run-time stats
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef CPU_MONITOR_H
+#define CPU_MONITOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define CPU_MONITOR_INTERVAL_MS 1000            // Sampling period
+#define CPU_MONITOR_WINDOW 10                   // Samples in the rolling idle average
+#define CPU_MONITOR_MAX_TASKS 32                // Tasks tracked per sample
+#define CPU_MONITOR_NO_AFFINITY -1              // Task may run on either core
+
+/**
+ * @brief One task over the last sampling interval
+ */
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    int8_t core;                                // Pinned core, or CPU_MONITOR_NO_AFFINITY
+    uint8_t priority;
+    uint32_t stack_hwm;                         // Least free stack ever seen, bytes
+    float cpu_percent;                          // Share of total CPU time (all cores = 100%)
+} cpu_task_stats_t;
+
+/**
+ * @brief Processor load over the last sampling interval
+ */
+typedef struct {
+    bool valid;                                 // At least two samples taken
+    uint8_t cores;
+    float core_load[portNUM_PROCESSORS];        // Busy percent per core
+    float idle_percent;                         // Idle share of all cores, last interval
+    float idle_rolling;                         // Idle share averaged over CPU_MONITOR_WINDOW samples
+    uint32_t task_count;
+} cpu_load_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Start periodic sampling and register the CPU metrics
+ *
+ * Needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS.
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_SUPPORTED without run-time stats, or the timer error
+ */
+esp_err_t cpu_monitor_start(void);
+
+/**
+ * @brief Stop sampling; the last results stay readable
+ */
+void cpu_monitor_stop(void);
+
+/**
+ * @brief Copy the current processor load
+ *
+ * @param load Receives the snapshot; valid is false until two samples exist
+ */
+void cpu_monitor_get_load(cpu_load_t *load);
+
+/**
+ * @brief Copy the per-task results of the last interval
+ *
+ * @param tasks Receives up to max entries, busiest first
+ * @param max Capacity of tasks
+ * @return Number of entries written
+ */
+size_t cpu_monitor_get_tasks(cpu_task_stats_t *tasks, size_t max);
+
+/**
+ * @brief Write load and per-task results as a JSON object
+ *
+ * @param w Writer positioned where a value is expected
+ */
+void cpu_monitor_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CPU_MONITOR_H
@@ -0,0 +1,92 @@
+/**
+ * @file deadband.h
+ * @brief Send-on-change filter: a sample goes out only when a field leaves its deadband or the heartbeat runs out
+ *
+ * The filter remembers the last sample sent. A new one is sent when any
+ * field moved past its band from that sample, when the heartbeat interval
+ * has passed since it, or when the caller forces it (a priority step, a
+ * pressure alarm); otherwise it is held back. A band is either absolute,
+ * in the field's own units, or relative to the value last sent, in per
+ * mille, for a field like gas resistance that spans decades.
+ *
+ * The receiver reconstructs the series with step-hold semantics: a value
+ * holds from its sample until the next one. The first sample sent after
+ * some were held back is marked (deadband_check()'s held), so the receiver
+ * can tell a held stretch from a gap, and the sender gives sequence
+ * numbers to sent samples only, so nothing looks lost.
+ *
+ * A filter is plain data with no pointers, so a node can keep it in RTC
+ * memory across deep sleep. Not thread-safe: one task per filter.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef DEADBAND_H
+#define DEADBAND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define DEADBAND_FIELDS_MAX 4
+
+/**
+ * @brief One field's band
+ */
+typedef struct {
+    uint32_t band;                              // Smallest change sent; 0 sends every change
+    bool relative;                              // band is per mille of the value last sent
+} deadband_field_t;
+
+/**
+ * @brief Filter state; zero it with deadband_init()
+ */
+typedef struct {
+    bool primed;                                // A sample was sent; the next is compared with it
+    bool held;                                  // Samples were held back since it
+    uint32_t sent_s;                            // When it was taken
+    int32_t sent[DEADBAND_FIELDS_MAX];          // Its values
+    uint32_t passed;                            // Samples sent
+    uint32_t suppressed;                        // Samples held back
+} deadband_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Empty the filter; the next sample is sent
+ */
+void deadband_init(deadband_t *db);
+
+/**
+ * @brief Decide whether a sample is sent, and remember it if so
+ *
+ * @param db Filter
+ * @param fields Band of each value
+ * @param values The sample, one value per field
+ * @param count Fields, at most DEADBAND_FIELDS_MAX
+ * @param time_s When it was taken
+ * @param heartbeat_s Longest silence; a sample this long after the last one sent goes out (0: no heartbeat)
+ * @param force Send it whatever the bands say
+ * @param held Receives whether samples were held back since the last one sent; may be NULL
+ * @return bool true to send it
+ */
+bool deadband_check(deadband_t *db, const deadband_field_t *fields, const int32_t *values, size_t count,
+                    uint32_t time_s, uint32_t heartbeat_s, bool force, bool *held);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEADBAND_H
@@ -0,0 +1,71 @@
+/**
+ * @file discovery.h
+ * @brief mDNS/DNS-SD advertisement of the web interface and telemetry
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define DISCOVERY_HOSTNAME "weatherstation"     // Answered as weatherstation.local
+#define DISCOVERY_INSTANCE_PREFIX "ESP32 Weather Station"  // Followed by the last three MAC bytes
+#define DISCOVERY_HTTP_PORT 80
+#define DISCOVERY_TELEMETRY_SERVICE "_weatherstation" // DNS-SD type of the telemetry description
+#define DISCOVERY_INSTANCE_MAX_LEN 48
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Start the mDNS responder and advertise the device's services
+ *
+ * Registers the hostname and two DNS-SD services on every active netif:
+ * _http._tcp for the web interface (_https._tcp on port 443 in an
+ * HTTPS_PORTAL build), and DISCOVERY_TELEMETRY_SERVICE._tcp whose TXT
+ * records tell collectors where readings go (MQTT broker and base topic)
+ * and where to scrape them (/metrics, /ws/metrics, over "scheme").
+ *
+ * @return esp_err_t ESP_OK on success (or if already started), error code otherwise
+ */
+esp_err_t discovery_start(void);
+
+/**
+ * @brief Withdraw the services and stop the responder
+ *
+ * @return esp_err_t ESP_OK
+ */
+esp_err_t discovery_stop(void);
+
+/**
+ * @brief Refresh the telemetry TXT records after the MQTT settings change
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if discovery is not started
+ */
+esp_err_t discovery_update_telemetry(void);
+
+/**
+ * @brief Check if the responder is running
+ *
+ * @return true if discovery_start() succeeded and discovery_stop() has not been called
+ */
+bool discovery_is_running(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DISCOVERY_H
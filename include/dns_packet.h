@@ -0,0 +1,116 @@
+/**
+ * @file dns_packet.h
+ * @brief DNS wire format: question parsing, name skipping and record TTL/EDNS rewriting
+ *
+ * Pure functions on a packet buffer, with no sockets, tasks or logging, so
+ * the captive portal's parsing can be built and exercised on a host as
+ * well as on the device. Offsets and lengths are ints, as recvfrom()
+ * returns them.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef DNS_PACKET_H
+#define DNS_PACKET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define DNS_HEADER_SIZE 12
+#define DNS_MAX_NAME_LEN 255                    // Wire length of a name, RFC 1035 section 2.3.4
+
+// Header flag bits (second 16-bit word)
+#define DNS_FLAG_QR 0x8000
+#define DNS_FLAG_AA 0x0400
+#define DNS_FLAG_TC 0x0200
+#define DNS_FLAG_RD 0x0100
+#define DNS_FLAG_RA 0x0080
+#define DNS_OPCODE(flags) (((flags) >> 11) & 0x0F)
+#define DNS_RCODE(flags) ((flags) & 0x0F)
+#define DNS_RCODE_NOERROR 0
+#define DNS_RCODE_FORMERR 1
+#define DNS_RCODE_SERVFAIL 2
+#define DNS_RCODE_NXDOMAIN 3
+#define DNS_RCODE_NOTIMP 4
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_OPT 41
+#define DNS_TYPE_ANY 255
+#define DNS_CLASS_IN 1
+#define DNS_CLASS_ANY 255
+#define DNS_A_ANSWER_LEN 16                     // dns_packet_a_answer(): pointer name, type, class, TTL, RDLENGTH, IPv4
+
+/**
+ * @brief A parsed question
+ */
+typedef struct {
+    char name[DNS_MAX_NAME_LEN + 1];            // Lowercase, dotted
+    size_t name_len;
+    uint16_t qtype;
+    uint16_t qclass;
+    int end;                                    // Offset just past the question
+} dns_question_t;
+
+/**
+ * @brief State for dns_packet_adjust_records()
+ */
+typedef struct {
+    uint32_t elapsed_s;                         // Subtracted from every TTL
+    uint32_t min_ttl;                           // Lowest TTL seen after the subtraction
+    uint16_t max_payload;                       // Clamp for the EDNS UDP payload size; 0 leaves it
+} dns_record_ctx_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Decode the single question after the header
+ *
+ * Questions never use compression pointers, so one is rejected. The name
+ * is lowercased.
+ *
+ * @return false if the question is malformed
+ */
+bool dns_packet_parse_question(const uint8_t *pkt, int len, dns_question_t *q);
+
+/**
+ * @brief Offset just past a possibly compressed name, or -1
+ */
+int dns_packet_skip_name(const uint8_t *pkt, int len, int pos);
+
+/**
+ * @brief Walk every resource record: age the TTLs, find the lowest, clamp EDNS
+ *
+ * The OPT pseudo-record carries flags in its TTL field and the UDP payload
+ * size in its class field, so it is only clamped, never aged.
+ *
+ * @return false if the message is malformed
+ */
+bool dns_packet_adjust_records(uint8_t *pkt, int len, dns_record_ctx_t *ctx);
+
+/**
+ * @brief Build an A answer whose name points back at the question, so it answers any name
+ *
+ * @param ip IPv4 address in network byte order
+ * @param ttl_s Answer TTL
+ * @param out Receives DNS_A_ANSWER_LEN bytes
+ */
+void dns_packet_a_answer(uint32_t ip, uint32_t ttl_s, uint8_t out[DNS_A_ANSWER_LEN]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DNS_PACKET_H
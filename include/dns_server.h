@@ -11,6 +11,8 @@
 #define DNS_SERVER_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -21,7 +23,72 @@ extern "C" {
 // Constants & Definitions
 // =============================
 #define DNS_SERVER_PORT 53
-#define DNS_RESPONSE_IP "192.168.4.1"
+#define DNS_RESPONSE_IP "192.168.4.1"         // Fallback when the AP netif has no address yet
+#define DNS_ANSWER_TTL_S 60                     // TTL of the A answers
+
+// Forward mode
+#define DNS_CACHE_ENTRIES 8                     // Upstream replies kept, least recently used evicted
+#define DNS_CACHE_NAME_LEN 64                   // Longer names are forwarded but not cached
+#define DNS_CACHE_MAX_RESPONSE 256              // Larger replies are relayed but not cached
+#define DNS_CACHE_MAX_TTL_S 300                 // Cap on the TTL a reply is cached for
+#define DNS_CACHE_NEGATIVE_TTL_S 30             // Cache time of NXDOMAIN/NODATA replies without records
+#define DNS_FORWARD_MAX_PENDING 16              // Upstream queries in flight
+#define DNS_FORWARD_TIMEOUT_MS 3000             // Unanswered upstream queries are forgotten after this
+#define DNS_FORWARD_MAX_PACKET 1232             // Largest upstream reply; EDNS payload sizes are clamped to it
+
+// Per-client accounting and rate limiting
+#define DNS_MAX_CLIENTS 8                       // Sources tracked; the least recently seen is replaced
+#define DNS_RATE_LIMIT_QPS 10                   // Sustained queries per second allowed per source
+#define DNS_RATE_LIMIT_BURST 20                 // Queries a quiet source may send back to back
+#define DNS_TOP_NAMES 8                         // Most queried names tracked (space-saving counts)
+#define DNS_QPS_WINDOW_MS 5000                  // Interval the query rate is averaged over
+
+/**
+ * @brief How names other than the portal's own are answered
+ */
+typedef enum {
+    DNS_MODE_HIJACK,                            // Every name resolves to the AP address (captive portal)
+    DNS_MODE_FORWARD                            // Relayed to an upstream resolver (gateway with a STA uplink)
+} dns_server_mode_t;
+
+/**
+ * @brief Query counters since dns_server_start()
+ */
+typedef struct {
+    uint32_t queries;                           // Well-formed DNS queries received
+    uint32_t answered;                          // A/ANY queries answered with our address
+    uint32_t nodata;                            // Other types (AAAA, HTTPS, ...): no error, empty answer
+    uint32_t nxdomain;                          // Reverse lookups (*.arpa)
+    uint32_t errors;                            // FORMERR and NOTIMP replies
+    uint32_t dropped;                           // Runts and responses, not answered
+    uint32_t send_failures;
+    uint32_t forwarded;                         // Queries sent to the upstream resolver
+    uint32_t cache_hits;                        // Queries answered from the forward cache
+    uint32_t upstream_timeouts;                 // Forwarded queries that got no reply
+    uint32_t rate_limited;                      // Packets dropped by the per-source rate limit
+    float qps;                                  // Queries per second over the last DNS_QPS_WINDOW_MS
+} dns_server_stats_t;
+
+/**
+ * @brief Counters of one querying source
+ */
+typedef struct {
+    uint32_t addr;                              // IPv4, network byte order
+    uint32_t queries;                           // Packets accepted from this source
+    uint32_t rate_limited;                      // Packets dropped because the source exceeded its rate
+} dns_client_stats_t;
+
+/**
+ * @brief One of the most queried names
+ *
+ * Counts come from the space-saving algorithm: a name that displaced another
+ * inherits its count, so count is an upper bound and count - error a lower one.
+ */
+typedef struct {
+    char name[DNS_CACHE_NAME_LEN];
+    uint32_t count;
+    uint32_t error;
+} dns_name_stats_t;
 
 // =============================
 // Function Prototypes
@@ -31,16 +98,26 @@ extern "C" {
  * @brief Start DNS server for captive portal
  *
  * Creates a UDP socket on port 53 and responds to all DNS queries
- * by redirecting them to the ESP32 IP address (192.168.4.1)
+ * by redirecting them to the ESP32 IP address (192.168.4.1). The question
+ * is parsed: A and ANY queries get the address, other types an empty
+ * NOERROR answer so clients fall back to A at once, reverse lookups
+ * NXDOMAIN. Replies come from templates built here for the AP address.
  *
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * The task and its stack are statically allocated. Returns once the
+ * socket is bound.
+ *
+ * @return esp_err_t ESP_OK on success (or if already running), ESP_FAIL if the socket could not be
+ *         bound, ESP_ERR_INVALID_STATE if a previous task has still not exited
  */
 esp_err_t dns_server_start(void);
 
 /**
  * @brief Stop DNS server
  *
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * Wakes the server task, waits for it to close its sockets and deletes it,
+ * so dns_server_start() may be called again as soon as this returns ESP_OK.
+ *
+ * @return esp_err_t ESP_OK on success, ESP_ERR_TIMEOUT if the task did not exit
  */
 esp_err_t dns_server_stop(void);
 
@@ -51,6 +128,59 @@ esp_err_t dns_server_stop(void);
  */
 bool dns_server_is_running(void);
 
+/**
+ * @brief Choose hijack or forward mode
+ *
+ * In forward mode the portal names (portal, portal.local,
+ * weatherstation.local) are still answered locally; everything else is
+ * relayed to the upstream resolver under a random query ID, and replies
+ * are cached for their lowest TTL. The switch happens on the server task
+ * within one select() timeout, emptying the cache; if the server is not
+ * running, it takes effect when it starts.
+ *
+ * @param mode New mode
+ * @param upstream Resolver address as a dotted quad, required for DNS_MODE_FORWARD
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG for a missing or bad upstream address
+ */
+esp_err_t dns_server_set_mode(dns_server_mode_t mode, const char *upstream);
+
+/**
+ * @brief Mode the server task is currently answering in
+ *
+ * @return dns_server_mode_t DNS_MODE_HIJACK until a forward request has been applied
+ */
+dns_server_mode_t dns_server_get_mode(void);
+
+/**
+ * @brief Copy the query counters
+ *
+ * @param stats Receives the counters
+ */
+void dns_server_get_stats(dns_server_stats_t *stats);
+
+/**
+ * @brief Copy the per-source counters, busiest first
+ *
+ * Each source may send DNS_RATE_LIMIT_BURST queries at once and
+ * DNS_RATE_LIMIT_QPS per second after that; excess packets are dropped
+ * unanswered so a chatty client cannot keep the server task (and the
+ * core it shares with httpd) busy.
+ *
+ * @param clients Receives up to max entries
+ * @param max Size of clients
+ * @return size_t Entries written
+ */
+size_t dns_server_get_clients(dns_client_stats_t *clients, size_t max);
+
+/**
+ * @brief Copy the most queried names, most frequent first
+ *
+ * @param names Receives up to max entries
+ * @param max Size of names
+ * @return size_t Entries written
+ */
+size_t dns_server_get_top_names(dns_name_stats_t *names, size_t max);
+
 #ifdef __cplusplus
 }
 #endif
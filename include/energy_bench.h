@@ -0,0 +1,119 @@
+/**
+ * @file energy_bench.h
+ * @brief Energy-per-sample benchmark: awake time, radio time, bytes sent and integrated charge
+ *
+ * A node built with NODE_BENCHMARK_CYCLES runs a fixed sample-and-transmit
+ * workload at boot instead of its normal sampling (see node.h), and this
+ * module accounts for it between energy_bench_begin() and energy_bench_end():
+ *
+ *   awake    run time less light sleep (needs CONFIG_PM_LIGHT_SLEEP_CALLBACKS,
+ *            otherwise the whole run counts as awake)
+ *   radio    time from handing a frame over until its ACK, as the workload reports it
+ *   bytes    ESP-NOW payload sent, resends included (net_stats)
+ *   charge   integrated from an INA219 in the supply line, when one answers
+ *
+ * and reports charge per sample, in nAh so it stays an integer. That is
+ * the number to compare before and after a power change.
+ *
+ * The INA219 averages its own conversions over ENERGY_BENCH_INA219_AVG, and
+ * a meter task reads it once per averaging period and multiplies the mean
+ * by the time since the last read, so short radio bursts are counted in
+ * full. Those reads wake the chip from light sleep about 15 times a second,
+ * which the measured charge includes; it is the same for every build, so
+ * before/after differences still hold.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ENERGY_BENCH_H
+#define ENERGY_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ENERGY_BENCH_INA219_ADDRESS 0x40        // INA219_I2C_ADDR_DEFAULT
+#define ENERGY_BENCH_SHUNT_MOHM 100             // R100 on the common breakout boards
+#define ENERGY_BENCH_INA219_RANGE INA219_RANGE_80MV     // 800 mA with 0.1 ohm: covers WiFi TX peaks
+#define ENERGY_BENCH_INA219_AVG INA219_AVG_128  // 68 ms per result
+#define ENERGY_BENCH_STOP_TIMEOUT_MS 500
+
+/**
+ * @brief Benchmark totals between energy_bench_begin() and energy_bench_end() (or now, while running)
+ */
+typedef struct {
+    bool running;
+    bool metered;                               // An INA219 answered; the charge fields are valid
+    uint32_t cycles;
+    uint32_t samples;
+    uint32_t elapsed_ms;
+    uint32_t awake_ms;                          // elapsed_ms less light sleep
+    uint32_t radio_ms;
+    uint64_t bytes_sent;
+    uint64_t charge_nah;
+    uint32_t avg_ua;                            // charge_nah over elapsed_ms
+    uint32_t peak_ua;                           // Highest averaged reading
+    uint32_t nah_per_sample;                    // The figure of merit; 0 without samples
+} energy_bench_result_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Look for the INA219 on the shared I2C bus (i2c_bus.h) and start metering, and register the current
+ *        consumption metric
+ *
+ * @return esp_err_t ESP_OK, or the bus or INA219 error; the benchmark then runs without charge
+ */
+esp_err_t energy_bench_init(void);
+
+/**
+ * @brief Zero the totals and start accounting
+ */
+void energy_bench_begin(void);
+
+/**
+ * @brief Account one workload cycle
+ *
+ * @param samples Samples taken in the cycle
+ * @param radio_us Time the cycle spent sending and waiting for ACKs
+ */
+void energy_bench_add(uint32_t samples, uint32_t radio_us);
+
+/**
+ * @brief Stop accounting; the totals stay as they are, the meter keeps feeding the metric
+ */
+void energy_bench_end(void);
+
+/**
+ * @brief Copy the totals
+ */
+void energy_bench_get(energy_bench_result_t *result);
+
+/**
+ * @brief Log the totals and the charge per sample
+ */
+void energy_bench_log(void);
+
+/**
+ * @brief Stop the meter task, power the INA219 down and remove it from the bus; call before i2c_bus_stop()
+ */
+void energy_bench_deinit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ENERGY_BENCH_H
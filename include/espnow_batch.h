@@ -0,0 +1,178 @@
+/**
+ * @file espnow_batch.h
+ * @brief Adaptive aggregation of telemetry records into full-sized ESP-NOW frames
+ *
+ * Records are collected into one telemetry frame and sent when the frame
+ * holds the current target count, when its oldest record reaches the age
+ * deadline, or at once for a priority record. Every frame costs channel
+ * access and an ACK, so fewer, fuller frames save airtime and power.
+ * Frames go out through espnow_reliable, which keeps them until the
+ * gateway acknowledges them. When its window is full, or flash_backlog
+ * still holds older records, a frame's records are paged out to flash
+ * instead (node.c replays them). A priority batch overtakes the flash
+ * backlog through the window's alarm lane (espnow_reliable_send_urgent()).
+ *
+ * The target count adapts to the link: a long frame is more likely to be
+ * hit by interference and costs more to resend, so the target halves when
+ * the delivery rate falls below ESPNOW_BATCH_SHRINK_PERCENT and grows by
+ * ESPNOW_BATCH_GROW_STEP while it stays at or above ESPNOW_BATCH_GROW_PERCENT.
+ *
+ * In ESP-NOW Long Range mode (espnow_batch_set_long_range()) frames are cut
+ * to ESPNOW_BATCH_LR_PAYLOAD bytes. At 250 kbps a full frame is on the air
+ * eight times as long as at 1 Mbps, far out where a hit is more likely, so
+ * shorter frames keep the cost of a resend near what it is in normal range.
+ *
+ * Not thread-safe apart from espnow_batch_get_stats(): add, poll and flush
+ * belong to one task (the sampler transmit stage on a node).
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESPNOW_BATCH_H
+#define ESPNOW_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "espnow_reliable.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ESPNOW_BATCH_MIN_RECORDS 2              // Floor of the adaptive target
+#define ESPNOW_BATCH_HEADER_MAX \
+    (TELEMETRY_HEADER_LEN + TELEMETRY_POWER_LEN + TELEMETRY_RAIN_LEN + TELEMETRY_CONFIG_LEN + TELEMETRY_HEALTH_LEN + \
+     TELEMETRY_KEY_LEN)
+#define ESPNOW_BATCH_MAX_RECORDS ((ESPNOW_RELIABLE_MAX_PAYLOAD - ESPNOW_BATCH_HEADER_MAX) / TELEMETRY_RECORD_LEN)
+#define ESPNOW_BATCH_LR_PAYLOAD 128             // Frame bytes in Long Range mode: about 4 ms on the air at 250 kbps
+#define ESPNOW_BATCH_LR_MAX_RECORDS ((ESPNOW_BATCH_LR_PAYLOAD - ESPNOW_BATCH_HEADER_MAX) / TELEMETRY_RECORD_LEN)
+#define ESPNOW_BATCH_RATE_WEIGHT 8              // Delivery rate EWMA: each send moves it 1/8 of the way
+#define ESPNOW_BATCH_GROW_PERCENT 90            // Grow the target at or above this delivery rate
+#define ESPNOW_BATCH_SHRINK_PERCENT 70          // Halve the target below this delivery rate
+#define ESPNOW_BATCH_GROW_STEP 2                // Records added to the target per clean batch
+#define ESPNOW_BATCH_WAIT_FOREVER UINT32_MAX    // espnow_batch_poll(): nothing waiting
+
+/**
+ * @brief Why a batch was sent
+ */
+typedef enum {
+    ESPNOW_BATCH_FLUSH_SIZE,                    // Target count reached, or the frame is full
+    ESPNOW_BATCH_FLUSH_AGE,                     // Oldest record reached the age deadline
+    ESPNOW_BATCH_FLUSH_PRIORITY,                // A priority record was added
+    ESPNOW_BATCH_FLUSH_BREAK,                   // The next record's seq or time does not follow on
+    ESPNOW_BATCH_FLUSH_EXPLICIT,                // espnow_batch_flush()
+    ESPNOW_BATCH_FLUSH_COUNT
+} espnow_batch_flush_t;
+
+/**
+ * @brief Aggregation counters since espnow_batch_init(), and the last batch
+ */
+typedef struct {
+    uint32_t batches;                           // Frames taken by the reliable layer
+    uint32_t failed;                            // Frames neither the window nor the flash backlog took in full
+    uint32_t records;                           // Records in frames taken
+    uint32_t spilled;                           // Records paged out to the flash backlog
+    uint32_t records_lost;                      // Records neither took
+    uint64_t bytes;                             // Payload bytes taken
+    uint32_t retries;                           // Immediate resends after a missing MAC ACK
+    uint32_t flushes[ESPNOW_BATCH_FLUSH_COUNT]; // Batches sent, by reason
+    uint8_t target;                             // Current adaptive record count
+    uint8_t delivery_percent;                   // Smoothed share of sends that were ACKed
+    uint8_t last_records;                       // Last batch: records, bytes and resends
+    uint16_t last_bytes;
+    uint8_t last_retries;
+    espnow_batch_flush_t last_reason;
+} espnow_batch_stats_t;
+
+/**
+ * @brief Adds header extensions to each new frame after the power extension; no records yet
+ */
+typedef void (*espnow_batch_frame_hook_t)(telemetry_writer_t *w);
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Start aggregating and register METRIC_ESPNOW_BATCH
+ *
+ * Frames go to the peer given to espnow_reliable_sender_init().
+ *
+ * @param node_id Node id written into each frame header
+ * @param max_age_ms Longest a record waits for its frame to fill
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG
+ */
+esp_err_t espnow_batch_init(uint32_t node_id, uint32_t max_age_ms);
+
+/**
+ * @brief Set the frame header hook (e.g. the rain extension); call before espnow_batch_init()
+ *
+ * The hook runs as each frame is started, so its figures are as old as
+ * the frame's first record.
+ *
+ * @param hook Hook, or NULL for the power extension only
+ */
+void espnow_batch_set_frame_hook(espnow_batch_frame_hook_t hook);
+
+/**
+ * @brief Pack frames for ESP-NOW Long Range mode, or for the normal rates again
+ *
+ * A frame already holding records keeps its size; the next one is cut to
+ * match, and the adaptive target is capped to what it holds.
+ *
+ * @param lr ESPNOW_BATCH_LR_PAYLOAD-byte frames
+ */
+void espnow_batch_set_long_range(bool lr);
+
+/**
+ * @brief Add one record, sending the batch if that completes it
+ *
+ * A record that does not follow on from the waiting ones (a gap in seq
+ * after a dropped sample, or a clock step) sends those first and starts
+ * a new frame.
+ *
+ * @param rec Record to send
+ * @param priority Send the batch now, with this record in it
+ * @return esp_err_t ESP_OK, or ESP_ERR_NO_MEM for a batch neither the reliable layer nor the
+ *         flash backlog had room for
+ */
+esp_err_t espnow_batch_add(const telemetry_record_t *rec, bool priority);
+
+/**
+ * @brief Send the batch if its oldest record reached the age deadline
+ *
+ * @return Milliseconds until the deadline, or ESPNOW_BATCH_WAIT_FOREVER when nothing is waiting
+ */
+uint32_t espnow_batch_poll(void);
+
+/**
+ * @brief Send whatever is waiting now
+ *
+ * @return esp_err_t ESP_OK (also when nothing is waiting), or ESP_ERR_NO_MEM
+ */
+esp_err_t espnow_batch_flush(void);
+
+/**
+ * @brief Copy the counters
+ */
+void espnow_batch_get_stats(espnow_batch_stats_t *stats);
+
+/**
+ * @brief Short name of a flush reason, as used in logs and the metric
+ */
+const char *espnow_batch_flush_name(espnow_batch_flush_t reason);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPNOW_BATCH_H
@@ -0,0 +1,160 @@
+/**
+ * @file espnow_channel.h
+ * @brief ESP-NOW channel choice on the gateway and announced channel switches to the nodes
+ *
+ * Marinas are crowded 2.4 GHz environments, and a fixed channel may sit
+ * under a dozen yacht routers. A gateway without a bridge uplink scans
+ * once at boot and scores every channel up to ESPNOW_CHANNEL_MAX by the
+ * APs it hears. An AP counts by its signal strength, and also counts on
+ * neighbouring channels as far as its 20 MHz overlaps them. If a channel
+ * beats the current one by ESPNOW_CHANNEL_SWITCH_MARGIN, the gateway
+ * announces a switch to it in ESPNOW_CHANNEL_ANNOUNCE_S. That is long
+ * enough for every duty-cycled node to wake and send at least once:
+ *
+ *   - each node that sends is told once, by unicast, in reply;
+ *   - awake nodes also hear a broadcast every ESPNOW_CHANNEL_BEACON_MS.
+ *
+ * The announcement carries the time left rather than a clock time, so it
+ * works before the nodes' clocks are synced. The channel is kept in NVS,
+ * and the gateway starts on it after a restart.
+ *
+ * With a bridge uplink the radio is on the uplink AP's channel, which
+ * ESP-NOW has to share, so there is nothing to choose; the gateway only
+ * keeps it as the channel it starts on next time.
+ *
+ * A node keeps its channel in RTC memory and brings the radio up on it,
+ * so a wake never scans. A node that hears nothing from the gateway for
+ * ESPNOW_CHANNEL_LOST_WAKES wakes in a row (it missed a switch, or the
+ * uplink moved the gateway) tries the next channel on its following wake.
+ *
+ * Frames, ESPNOW_CHANNEL_MAGIC then the kind:
+ *
+ *   ANNOUNCE  gateway to node   2 channel, 3..6 ms until the switch (little-endian)
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESPNOW_CHANNEL_H
+#define ESPNOW_CHANNEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ESPNOW_CHANNEL_MAGIC 0x7A
+#define ESPNOW_CHANNEL_KIND_ANNOUNCE 1
+#define ESPNOW_CHANNEL_ANNOUNCE_LEN 7
+
+#define ESPNOW_CHANNEL_MAX 11                   // Highest channel used: 1..11 is legal everywhere
+#define ESPNOW_CHANNEL_SCAN_MS 120              // Passive dwell per channel; beacons come every ~102 ms
+#define ESPNOW_CHANNEL_SWITCH_MARGIN 80         // Score gain worth a switch (one -60 dBm AP on the channel is 160)
+#define ESPNOW_CHANNEL_ANNOUNCE_S 1800          // Switch lead time; covers the longest node send period
+#define ESPNOW_CHANNEL_BEACON_MS 5000           // Broadcast announcement period while a switch is pending
+#define ESPNOW_CHANNEL_NODES 32                 // Nodes told by unicast per switch
+#define ESPNOW_CHANNEL_LOST_WAKES 3             // Node: silent wakes before it tries the next channel
+
+/**
+ * @brief Channel state of either role
+ */
+typedef struct {
+    uint8_t channel;                            // Current channel
+    uint8_t next;                               // Announced channel, 0 if no switch is pending
+    uint32_t switch_in_ms;                      // Time until it
+    bool follows_uplink;                        // Gateway: the bridge uplink sets the channel
+    uint32_t told;                              // Gateway: nodes told of the pending switch
+    uint32_t switches;                          // Switches made since boot (node: since power-on)
+    uint32_t lost_moves;                        // Node: channels tried after silent wakes
+} espnow_channel_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Receive path for both roles; call it first from the link receive handler
+ *
+ * On a node every frame from the gateway counts as having heard it; on the
+ * gateway every node frame may be answered with a pending announcement.
+ *
+ * @return bool Whether the frame was an announcement
+ */
+bool espnow_channel_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+
+/**
+ * @brief Gateway: the channel to bring the radio up on
+ *
+ * @param fallback Used when no channel is stored
+ */
+uint8_t espnow_channel_gateway_home(uint8_t fallback);
+
+/**
+ * @brief Gateway: scan, pick the quietest channel and announce a switch to it; call once the link is up
+ *
+ * @param follows_uplink The bridge uplink owns the channel; nothing is scanned or announced
+ * @param wake Called from the link task when a node is owed an announcement; wakes the caller of the poll
+ */
+esp_err_t espnow_channel_gateway_start(bool follows_uplink, void (*wake)(void));
+
+/**
+ * @brief Gateway: send due announcements, and switch when the time comes; from the forwarder loop
+ */
+void espnow_channel_gateway_poll(void);
+
+/**
+ * @brief Gateway: milliseconds until espnow_channel_gateway_poll() has work
+ */
+uint32_t espnow_channel_gateway_poll_due_ms(void);
+
+/**
+ * @brief Gateway: stop announcing; a pending switch is dropped
+ */
+void espnow_channel_gateway_stop(void);
+
+/**
+ * @brief Node: the channel to bring the radio up on, kept in RTC memory
+ *
+ * @param fallback Used after a power-on
+ */
+uint8_t espnow_channel_node_home(uint8_t fallback);
+
+/**
+ * @brief Node: make a channel the home one, as found by pairing (espnow_pair.h)
+ */
+void espnow_channel_node_set_home(uint8_t channel);
+
+/**
+ * @brief Node: announcements are only taken from this gateway
+ */
+void espnow_channel_node_init(const uint8_t *gateway_mac);
+
+/**
+ * @brief Node: switch once an announced switch falls due
+ */
+void espnow_channel_node_poll(void);
+
+/**
+ * @brief Node, before deep sleep: switch if due, and move on after too many silent wakes
+ */
+void espnow_channel_node_settle(void);
+
+/**
+ * @brief Copy the channel state
+ */
+void espnow_channel_get_stats(espnow_channel_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPNOW_CHANNEL_H
@@ -0,0 +1,159 @@
+/**
+ * @file espnow_config.h
+ * @brief Remote node configuration: the gateway pushes sampling settings on its ACKs, the node confirms the version
+ *
+ * Changing a node's sample period or heater profile used to mean a trip up
+ * the mast with a laptop. The gateway now keeps the desired settings of
+ * each node (node_settings_t, nvs_utils.h) in NVS, set over MQTT with a
+ * JSON message on <mqtt_base_topic>/<node id>/config/set:
+ *
+ *   {"sample_ms":300000,"batch":6,"heater_c":300,"heater_ms":100,"lr":1}
+ *
+ * Members left out keep their desired value, and 0 restores the node's
+ * build default. "lr" moves the node's link to ESP-NOW Long Range mode
+ * (espnow_link.h); push it while the node is still in normal range. A message that changes something gets the next version
+ * number; the same settings again (a retained message after a reconnect)
+ * change nothing.
+ *
+ * Every telemetry frame carries the version the node runs
+ * (TELEMETRY_FLAG_CONFIG). While that differs from the desired one, the
+ * gateway adds the settings to each ACK it sends the node, as a trailer
+ * (espnow_reliable.h), so the push costs no frame of its own and reaches
+ * a duty-cycled node while its radio is on anyway. The node stores them
+ * with the bulk NVS store (nvs_store_config()) and runs them from its next
+ * sample on; its next frame reports the new version, which confirms it and
+ * stops the push. A lost ACK or a failed store just means the next ACK
+ * pushes again.
+ *
+ * The ACKs are encrypted with the node's key, as every ESP-NOW frame, so
+ * only a gateway holding it can reconfigure a node.
+ *
+ * Trailer item (slot ESPNOW_RELIABLE_TRAILER_CONFIG), ESPNOW_CONFIG_TRAILER_LEN bytes, little-endian:
+ *
+ *   0     magic               ESPNOW_CONFIG_MAGIC
+ *   1..2  version
+ *   3..6  sample period       ms
+ *   7     batch               Samples per duty-cycle send
+ *   8..9  heater target       degC
+ *   10..11 heater hold        ms
+ *   12    flags               NODE_SETTINGS_*
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESPNOW_CONFIG_H
+#define ESPNOW_CONFIG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "espnow_batch.h"
+#include "espnow_reliable.h"
+#include "nvs_utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ESPNOW_CONFIG_MAGIC 0x78
+#define ESPNOW_CONFIG_TRAILER_LEN 13
+
+#define ESPNOW_CONFIG_NODES 16                  // Nodes the gateway keeps desired settings for
+#define ESPNOW_CONFIG_SAMPLE_MS_MIN 500         // Accepted sample periods (0: build default)
+#define ESPNOW_CONFIG_SAMPLE_MS_MAX 3600000
+#define ESPNOW_CONFIG_HEATER_C_MIN 200          // Accepted heater targets, the BME680's range
+#define ESPNOW_CONFIG_HEATER_C_MAX 400
+#define ESPNOW_CONFIG_HEATER_MS_MAX 4032        // Longest heater hold the BME680 can time
+
+_Static_assert(ESPNOW_CONFIG_TRAILER_LEN <= ESPNOW_RELIABLE_ACK_TRAILER_MAX, "the settings must fit an ACK trailer");
+
+/**
+ * @brief Gateway counters
+ */
+typedef struct {
+    uint8_t nodes;                              // Nodes with desired settings
+    uint8_t pending;                            // ... not confirmed yet
+    uint32_t sets;                              // New versions taken
+    uint32_t pushes;                            // ACKs that carried settings
+    uint32_t confirmed;                         // Versions nodes reported back
+} espnow_config_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Check settings against the accepted ranges; 0 in any field is a build default and passes
+ */
+bool espnow_config_valid(const node_settings_t *settings);
+
+/**
+ * @brief Gateway: load the desired settings from NVS and start adding them to ACKs
+ *
+ * @return esp_err_t ESP_OK (a missing table is an empty one)
+ */
+esp_err_t espnow_config_gateway_start(void);
+
+/**
+ * @brief Gateway: desired settings for a node; the version is assigned here
+ *
+ * @param node_id Telemetry node id
+ * @param settings Settings; version is ignored
+ * @return esp_err_t ESP_OK (also when nothing changed), ESP_ERR_INVALID_ARG, or ESP_ERR_NO_MEM
+ *         when ESPNOW_CONFIG_NODES nodes already have settings
+ */
+esp_err_t espnow_config_gateway_set(uint32_t node_id, const node_settings_t *settings);
+
+/**
+ * @brief Gateway: desired settings from a JSON config/set message; also the MQTT handler
+ *
+ * @return esp_err_t As espnow_config_gateway_set(), or ESP_ERR_INVALID_ARG for malformed JSON
+ */
+esp_err_t espnow_config_gateway_set_json(uint32_t node_id, const char *json, size_t len);
+
+/**
+ * @brief Gateway: the version a node reported in a telemetry frame; runs in the link task
+ *
+ * @param mac The node, which its ACKs go to
+ * @param node_id Its telemetry node id
+ * @param version Its config extension, 0 if it had none
+ */
+void espnow_config_gateway_seen(const uint8_t *mac, uint32_t node_id, uint16_t version);
+
+/**
+ * @brief Gateway: copy the counters
+ */
+void espnow_config_get_stats(espnow_config_stats_t *stats);
+
+/**
+ * @brief Node: start taking settings from the gateway's ACKs
+ *
+ * @param version Version of the settings in force (0: none pushed yet)
+ */
+void espnow_config_node_init(uint16_t version);
+
+/**
+ * @brief Node: settings pushed since the last call, for the main task to store
+ *
+ * @param settings Receives them
+ * @return bool Whether there were any; they stay offered until espnow_config_node_applied()
+ */
+bool espnow_config_node_take(node_settings_t *settings);
+
+/**
+ * @brief Node: the settings taken are stored and in force
+ */
+void espnow_config_node_applied(uint16_t version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPNOW_CONFIG_H
@@ -0,0 +1,111 @@
+/**
+ * @file espnow_failover.h
+ * @brief Node-side failover between redundant gateways, ranked by recent link quality
+ *
+ * A cabin may run two gateways, so one lost to a power cut or a crash does
+ * not cut its nodes off. A node keeps a list of up to ESPNOW_FAILOVER_GATEWAYS
+ * gateways in RTC memory. The configured one (server MAC) seeds it, and the
+ * others are learned from their time beacons (espnow_time.h). Every gateway
+ * broadcasts its beacons at full power, so their RSSI ranks the gateways
+ * alike, whatever power each one's unicast frames adapt to. Relays
+ * (espnow_relay.h) repeat the beacon and are learned the same way, a hop
+ * worse.
+ *
+ * A gateway scores its smoothed beacon RSSI, less ESPNOW_FAILOVER_MISS_PENALTY_DB
+ * for each transmit cycle in a row whose frames it left unacknowledged; a
+ * beacon from it clears those. The node reports each cycle: one miss is
+ * enough to move to the best other gateway, so the node can resend to it
+ * in the same cycle. A cycle that was acknowledged still moves when
+ * another gateway scores ESPNOW_FAILOVER_HYSTERESIS_DB higher, which is
+ * how a node returns to a gateway that came back. The frames held for the
+ * old gateway go to the new one; any it already delivered are dropped at
+ * MQTT (MQTT_FORWARDER_CLAIMS), so the broker still gets each record once.
+ *
+ * Redundant gateways must share the ESP-NOW channel (one uplink AP, or no
+ * uplink and the same fixed channel), the PMK and node keys, and must not
+ * share an MQTT client id.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESPNOW_FAILOVER_H
+#define ESPNOW_FAILOVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef ESPNOW_FAILOVER
+#define ESPNOW_FAILOVER 1                       // 1: learn other gateways and fail over to them
+#endif
+#define ESPNOW_FAILOVER_GATEWAYS 3              // Gateways a node keeps
+#define ESPNOW_FAILOVER_MISS_PENALTY_DB 20      // Score lost per unacknowledged cycle in a row
+#define ESPNOW_FAILOVER_HYSTERESIS_DB 8         // Lead a better gateway needs while the current one delivers
+#define ESPNOW_FAILOVER_UNHEARD_RSSI -90        // Score of a gateway whose beacon was never heard
+#define ESPNOW_FAILOVER_RELAY_PENALTY_DB 10     // Score lost by a relay (ESPNOW_TIME_SOURCE_RELAY beacon), for its extra hop
+
+/**
+ * @brief Node failover state
+ */
+typedef struct {
+    uint8_t gateways;                           // Gateways known
+    uint8_t mac[6];                             // The one sent to
+    int8_t rssi;                                // Its beacon RSSI, ESPNOW_FAILOVER_UNHEARD_RSSI if unheard
+    uint8_t misses;                             // Its unacknowledged cycles in a row
+    uint32_t failovers;                         // Moves after a miss, since power-on
+    uint32_t upgrades;                          // Moves to a better gateway, since power-on
+} espnow_failover_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Receive path; call it first from the link receive handler
+ *
+ * Learns gateways from their beacons and tracks their RSSI. It only
+ * watches, so the frame still goes on to the other handlers.
+ *
+ * @return bool Always false
+ */
+bool espnow_failover_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+
+/**
+ * @brief Load the list kept in RTC memory, seeded with the configured gateway
+ *
+ * A new configured gateway starts the list over.
+ *
+ * @param configured The server MAC from the config
+ * @param active Receives the gateway to send to
+ */
+void espnow_failover_init(const uint8_t *configured, uint8_t *active);
+
+/**
+ * @brief Report a transmit cycle and pick the gateway for the next one
+ *
+ * @param delivered Everything sent in the cycle was acknowledged
+ * @param next Receives the new gateway when the node should move
+ * @return bool Whether to move to next
+ */
+bool espnow_failover_report(bool delivered, uint8_t *next);
+
+/**
+ * @brief Copy the failover state
+ */
+void espnow_failover_get_stats(espnow_failover_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPNOW_FAILOVER_H
@@ -0,0 +1,276 @@
+/**
+ * @file espnow_link.h
+ * @brief Encrypted ESP-NOW transport shared by node and gateway
+ *
+ * Peers are registered with an LMK taken from the espnow_active key in NVS
+ * (unencrypted if no key is set). The radio callbacks only copy into ring
+ * buffers; a link task does everything else, so nothing runs in the WiFi
+ * task beyond a memcpy. Received frames go through a lock-free
+ * single-producer ring of fixed slots (spsc_ring.h), allocated once, and the
+ * link task runs on the other core from WiFi, so a gateway can take
+ * hundreds of frames a second from many nodes without a lock or an
+ * allocation per frame.
+ *
+ * Key rotation: when an espnow_pending key is stored, the old key is kept
+ * for ESPNOW_LINK_KEY_GRACE_S and the pending one becomes the current key.
+ * ESP-NOW holds one LMK per peer, so each peer is on one of the two at a
+ * time. With ESPNOW_LINK_KEY_STAGED every peer stays on the old key until
+ * espnow_link_peer_switch_key() moves it, at a point both ends agreed on
+ * (espnow_rekey.h); a move is one esp_now_mod_peer(), timed in the stats.
+ * Without it, every peer moves when the rotation starts and a send that
+ * fails is retried once with the other key. When the window ends, peers
+ * still on the old key are moved and the pending key becomes the active
+ * key in NVS.
+ *
+ * Link adaptation (ESPNOW_LINK_ADAPT): every peer starts at the 1 Mbps rate
+ * and full power. After ESPNOW_LINK_ADAPT_WINDOW sends to it without a
+ * failure, the link steps to the next faster rate, or else to
+ * ESPNOW_LINK_ADAPT_POWER_STEP less power, if the estimated margin still
+ * clears ESPNOW_LINK_ADAPT_MARGIN_DB. The margin is taken from the RSSI of
+ * frames heard from the peer, less the power this side dropped. A peer that
+ * lowered its own power is heard weaker, which only makes the estimate
+ * more cautious. ESPNOW_LINK_ADAPT_LOSS failures in a window step back one
+ * rate and one power step at once. The radio's power is set per send and
+ * put back to full after it, so broadcasts and the WiFi uplink are never
+ * sent weaker. Settings are kept in RTC memory, so a duty-cycled node
+ * resumes them after deep sleep.
+ *
+ * Long Range (ESPNOW_LINK_LR): the station interface runs 802.11 b/g/n and
+ * Espressif's LR mode together, so one radio hears both kinds of frame. A
+ * peer set with espnow_link_peer_set_lr() is sent to at the LR rates
+ * instead, 250 kbps stepping up to 500 kbps, for several times the range
+ * of 1 Mbps. Adaptation then stays within those two rates. Both ends have
+ * to send LR: a node far out asks for it in its settings (NODE_SETTINGS_LR)
+ * and flags its frames, and the gateway sets its peer for that node to
+ * match. Broadcasts stay at 1 Mbps.
+ *
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESPNOW_LINK_H
+#define ESPNOW_LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ESPNOW_LINK_MAX_PEERS CONFIG_ESP_WIFI_ESPNOW_MAX_ENCRYPT_NUM
+#define ESPNOW_LINK_RX_SLOTS 32                 // Received frames waiting for the link task; power of two (~8 KB)
+#define ESPNOW_LINK_TX_RING_BYTES 256           // Send results waiting for the link task
+#define ESPNOW_LINK_INJECT_RING_BYTES 1024      // Frames from espnow_link_inject() waiting for the link task
+#define ESPNOW_LINK_SEND_TIMEOUT_MS 100         // Wait for the send callback
+#define ESPNOW_LINK_KEY_GRACE_S 3600            // Old key kept after a rotation (spans several node batches)
+#define ESPNOW_LINK_EPOCH_NONE 0xFF             // espnow_link_peer_epoch(): not a registered peer
+#ifndef ESPNOW_LINK_KEY_STAGED
+#define ESPNOW_LINK_KEY_STAGED 1                // 1: peers change keys one at a time when told; 0: all at once
+#endif
+#ifndef ESPNOW_LINK_ADAPT
+#define ESPNOW_LINK_ADAPT 1                     // 1: per-peer TX power and PHY rate follow the link margin
+#endif
+#define ESPNOW_LINK_ADAPT_WINDOW 8              // Clean sends before a step to less power or a faster rate
+#define ESPNOW_LINK_ADAPT_LOSS 2                // Failed sends in a window that step back
+#define ESPNOW_LINK_ADAPT_MARGIN_DB 12          // Kept above the rate's sensitivity by a step
+#define ESPNOW_LINK_ADAPT_POWER_MAX 78          // 0.25 dBm units: 19.5 dBm, where every peer starts
+#define ESPNOW_LINK_ADAPT_POWER_MIN 34          // 8.5 dBm
+#define ESPNOW_LINK_ADAPT_POWER_STEP 12         // 3 dB
+#define ESPNOW_LINK_ADAPT_MEMO 4                // Peers whose settings survive deep sleep
+#ifndef ESPNOW_LINK_LR
+#define ESPNOW_LINK_LR 1                        // 1: the radio also speaks LR, so peers can be moved to it
+#endif
+#ifndef ESPNOW_LINK_PMK
+#define ESPNOW_LINK_PMK "WxStationPMK0001"      // 16 bytes; must be the same on every board
+#endif
+
+/**
+ * @brief Receive handler; runs in the link task, not the WiFi task
+ *
+ * @param mac Sender
+ * @param data Frame payload, in its receive slot and valid only during the call
+ * @param len Payload length
+ * @param rssi Signal strength of the frame, dBm
+ */
+typedef void (*espnow_link_rx_t)(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+
+/**
+ * @brief Link counters since espnow_link_init()
+ */
+typedef struct {
+    uint32_t rx_frames;
+    uint32_t rx_dropped;                        // Lost to a full receive ring
+    uint32_t rx_high_water;                     // Most frames ever waiting in the receive ring
+    uint32_t tx_frames;
+    uint32_t tx_failed;                         // No ACK, or no send callback in time
+    uint32_t key_fallbacks;                     // Sends that only got through on the other key
+    uint32_t key_switches;                      // Peers moved to the new key by espnow_link_peer_switch_key()
+    uint32_t key_switch_us;                     // Time the last move took (esp_now_mod_peer)
+    uint32_t key_switch_us_max;
+    uint32_t adapt_steps;                       // Link adaptation: steps to a faster rate or less power
+    uint32_t adapt_backoffs;                    // Link adaptation: steps back after losses
+    bool rotating;                              // Inside the key grace window
+} espnow_link_stats_t;
+
+/**
+ * @brief What frames to one peer are sent with
+ */
+typedef struct {
+    const char *rate;                           // PHY rate, e.g. "24M"
+    int8_t power;                               // 0.25 dBm units
+    int8_t rssi;                                // Smoothed over frames heard from the peer, 0 if none yet
+    int8_t margin_db;                           // Estimated margin over the rate's sensitivity, 0 without RSSI
+    bool lr;                                    // Sent in Long Range mode
+} espnow_link_radio_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Start ESP-NOW on the already started WiFi radio
+ *
+ * Loads the keys from NVS, sets the PMK, starts the link task and, if a
+ * pending key is stored, starts (or, after a reboot, resumes) its rotation.
+ *
+ * @param rx Receive handler (may be NULL on a send-only node)
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if already started, ESP_ERR_NO_MEM, or the ESP-NOW error
+ */
+esp_err_t espnow_link_init(espnow_link_rx_t rx);
+
+/**
+ * @brief Register a peer on the current channel, encrypted with the current key
+ *
+ * FF:FF:FF:FF:FF:FF registers the broadcast peer, which is never encrypted.
+ *
+ * @return esp_err_t ESP_OK (also if already registered), ESP_ERR_NO_MEM when the table is full,
+ *         or the ESP-NOW error
+ */
+esp_err_t espnow_link_add_peer(const uint8_t *mac);
+
+/**
+ * @brief Whether the link is up with a current key, so unicast peers are encrypted
+ */
+bool espnow_link_encrypted(void);
+
+/**
+ * @brief Send one frame and wait for its MAC-level result
+ *
+ * One send is in flight at a time; concurrent callers queue on a mutex.
+ *
+ * @param mac Registered peer
+ * @param data Payload
+ * @param len Up to ESP_NOW_MAX_DATA_LEN bytes
+ * @return esp_err_t ESP_OK once ACKed, ESP_FAIL if not, ESP_ERR_TIMEOUT, or the ESP-NOW error
+ */
+esp_err_t espnow_link_send(const uint8_t *mac, const uint8_t *data, size_t len);
+
+/**
+ * @brief Hand a frame to the receive handler as if the radio had received it
+ *
+ * For replaying captured traffic (frame_capture.h): the frame is queued
+ * for the link task and goes through the same path as a received one,
+ * fault injection included, but is not counted as radio traffic.
+ *
+ * @param mac Sender
+ * @param data Payload, copied
+ * @param len Up to ESP_NOW_MAX_DATA_LEN bytes
+ * @param rssi Signal strength to report with it, dBm
+ * @param wait_ms Longest to wait for room in the queue
+ * @return esp_err_t ESP_OK, ESP_ERR_TIMEOUT, ESP_ERR_INVALID_ARG, or ESP_ERR_INVALID_STATE
+ */
+esp_err_t espnow_link_inject(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi, uint32_t wait_ms);
+
+/**
+ * @brief Frames queued by espnow_link_inject() and not yet handled
+ */
+size_t espnow_link_injected_pending(void);
+
+/**
+ * @brief Move to the stored pending key now and start the grace window
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND if no pending key is stored, or ESP_ERR_INVALID_STATE
+ */
+esp_err_t espnow_link_rotate_key(void);
+
+/**
+ * @brief Whether a rotation is under way, and the fingerprint of the key it moves to
+ *
+ * @param fingerprint Receives the low 32 bits of the new key's SHA-256 (may be NULL)
+ * @return bool Inside the grace window
+ */
+bool espnow_link_rotation(uint32_t *fingerprint);
+
+/**
+ * @brief Move one peer to the new key now
+ *
+ * @param mac Registered peer
+ * @param finish End the rotation when this leaves no peer on the old key (a node, whose only peers
+ *               are its gateways), making the new key the active one in NVS
+ * @return esp_err_t ESP_OK (also if it was on the new key already), ESP_ERR_NOT_FOUND,
+ *         ESP_ERR_INVALID_STATE outside a rotation, or the ESP-NOW error
+ */
+esp_err_t espnow_link_peer_switch_key(const uint8_t *mac, bool finish);
+
+/**
+ * @brief Which key a peer is on: the number of rotations started before that key, since init
+ *
+ * During a grace window a peer still on the old key reports one less than the others.
+ *
+ * @return Epoch, or ESPNOW_LINK_EPOCH_NONE for an unknown peer or a stopped link
+ */
+uint8_t espnow_link_peer_epoch(const uint8_t *mac);
+
+/**
+ * @brief Send to a peer in Long Range mode, or back at the normal rates
+ *
+ * Takes effect at the next send to the peer, with the adaptation settings
+ * it had in that mode before deep sleep, else from the slowest rate at full
+ * power. Does not block, so the link task may call it from its handler.
+ *
+ * @param mac Registered peer, not the broadcast peer
+ * @param lr Long Range mode
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND, ESP_ERR_NOT_SUPPORTED if the radio could not
+ *         enable LR (or ESPNOW_LINK_LR is 0), or ESP_ERR_INVALID_STATE
+ */
+esp_err_t espnow_link_peer_set_lr(const uint8_t *mac, bool lr);
+
+/**
+ * @brief Current link adaptation settings for a peer
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND for an unknown peer, or ESP_ERR_INVALID_STATE
+ */
+esp_err_t espnow_link_peer_radio(const uint8_t *mac, espnow_link_radio_t *radio);
+
+/**
+ * @brief Copy the link counters
+ */
+void espnow_link_get_stats(espnow_link_stats_t *stats);
+
+/**
+ * @brief Stop the link task and ESP-NOW
+ */
+esp_err_t espnow_link_deinit(void);
+
+/**
+ * @brief Parse "AA:BB:CC:DD:EE:FF"
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG for a malformed or all-zero address
+ */
+esp_err_t espnow_link_parse_mac(const char *str, uint8_t *mac);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPNOW_LINK_H
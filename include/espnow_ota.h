@@ -0,0 +1,195 @@
+/**
+ * @file espnow_ota.h
+ * @brief Node firmware distributed by the gateway over ESP-NOW, to several nodes in one pass
+ *
+ * A node image is uploaded to the gateway in config mode (POST /api/ota
+ * with target=nodes). It is written to the gateway's inactive OTA slot but
+ * not booted, and espnow_ota_stage() records it in NVS. From then on the
+ * gateway role serves it to every node that runs other firmware.
+ *
+ * Nodes ask after each batch (QUERY, with the ELF hash of what they run).
+ * The first node to ask sets a start time ESPNOW_OTA_GATHER_MS ahead,
+ * longer than a duty-cycled node's batch interval, so every node asks once
+ * in that window; each gets an OFFER with the time left. A node keeps the
+ * offer in RTC memory, sleeps until just before the start, erases its own
+ * inactive slot and JOINs. The gateway then broadcasts the image once for
+ * all joined nodes, window by window:
+ *
+ *   - the ESPNOW_OTA_WINDOW blocks of a window are broadcast,
+ *   - each node is POLLed and REPORTs which of them it misses (a 64-bit map),
+ *   - the union of the missing blocks is broadcast again, up to
+ *     ESPNOW_OTA_ROUNDS times; a node still missing blocks, or one that
+ *     stops answering, is dropped and tries again with a later session.
+ *
+ * Nodes write each block at its own offset as it arrives
+ * (esp_ota_write_with_offset(), so resent blocks may come in any order),
+ * and keep a bitmap of the blocks they hold. At END a node checks the
+ * image's SHA-256 against the one in the OFFER, boots it and sends DONE.
+ * Broadcast frames cannot be encrypted; the hash came over the encrypted
+ * unicast OFFER, so a tampered or corrupted block fails the check.
+ *
+ * Frames, little-endian, ESPNOW_OTA_MAGIC then the kind:
+ *
+ *   QUERY   node to gateway   2..9 first 8 bytes of the running app's ELF SHA-256
+ *   OFFER   gateway to node   2..3 session, 4..7 image bytes, 8..11 ms to the start, 12..43 image SHA-256
+ *   JOIN    node to gateway   2..3 session
+ *   BLOCK   gateway broadcast 2..3 session, 4..5 block index, 6.. up to ESPNOW_OTA_BLOCK_SIZE bytes
+ *   POLL    gateway to node   2..3 session, 4..5 first block of the window
+ *   REPORT  node to gateway   2..3 session, 4..5 first block of the window, 6..13 bit i: block missing
+ *   END     gateway to node   2..3 session
+ *   DONE    node to gateway   2..3 session, 4 ESPNOW_OTA_RESULT_*
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESPNOW_OTA_H
+#define ESPNOW_OTA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ESPNOW_OTA_MAGIC 0x7D
+#define ESPNOW_OTA_KIND_QUERY 1
+#define ESPNOW_OTA_KIND_OFFER 2
+#define ESPNOW_OTA_KIND_JOIN 3
+#define ESPNOW_OTA_KIND_BLOCK 4
+#define ESPNOW_OTA_KIND_POLL 5
+#define ESPNOW_OTA_KIND_REPORT 6
+#define ESPNOW_OTA_KIND_END 7
+#define ESPNOW_OTA_KIND_DONE 8
+#define ESPNOW_OTA_RESULT_OK 0
+#define ESPNOW_OTA_RESULT_FAILED 1              // Incomplete, or the image did not verify
+
+#define ESPNOW_OTA_BLOCK_SIZE 224               // Image bytes per BLOCK frame (frame: 230 of 250)
+#define ESPNOW_OTA_WINDOW 64                    // Blocks per window: one REPORT bitmap (~14 KB read at once)
+#define ESPNOW_OTA_BURST 8                      // Blocks broadcast back to back before a tick's pause
+#define ESPNOW_OTA_ROUNDS 8                     // Resend rounds per window before a node is dropped
+#define ESPNOW_OTA_SILENT_POLLS 3               // Unanswered POLLs in a row that drop a node
+#define ESPNOW_OTA_MAX_NODES 8                  // Nodes per session
+#define ESPNOW_OTA_GATHER_MS (12 * 60 * 1000)   // First QUERY to the start; above a node's batch interval
+#define ESPNOW_OTA_JOIN_MS 30000                // JOINs accepted this long after the start
+#define ESPNOW_OTA_WAKE_EARLY_MS 20000          // Node is up this long before the start (boot and erase)
+#define ESPNOW_OTA_QUERY_WAIT_MS 100            // Node waits this long for an OFFER
+#define ESPNOW_OTA_POLL_WAIT_MS 200             // Gateway waits this long for a REPORT
+#define ESPNOW_OTA_DONE_WAIT_MS 5000            // Gateway waits this long for the DONEs (the node verifies first)
+#define ESPNOW_OTA_NODE_IDLE_MS 20000           // Node gives up after this long without a frame
+#define ESPNOW_OTA_NONE UINT32_MAX              // espnow_ota_node_wake_in_ms(): no offer held
+
+_Static_assert(ESPNOW_OTA_WINDOW == 64, "the REPORT bitmap is 64 bits");
+_Static_assert(ESPNOW_OTA_BURST < 32, "a burst must fit the node's receive ring (ESPNOW_LINK_RX_SLOTS)");
+
+/**
+ * @brief Gateway counters since espnow_ota_gateway_start()
+ */
+typedef struct {
+    bool staged;                                // An image is being served
+    char version[32];                           // ... its app version
+    uint32_t size;                              // ... and size
+    uint32_t offers;                            // OFFERs sent
+    uint32_t sessions;                          // Sessions with at least one node joined
+    uint32_t updated;                           // Nodes that verified and booted the image
+    uint32_t failed;                            // Nodes that reported a failure
+    uint32_t dropped;                           // Nodes dropped for missing blocks or silence
+    uint32_t blocks_sent;                       // BLOCK frames, first sends
+    uint32_t blocks_resent;                     // BLOCK frames sent again for a REPORT
+    uint32_t last_session_ms;                   // Start to the last DONE
+} espnow_ota_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Receive path for both roles; call it from the link receive handler
+ *
+ * @return bool Whether the frame belonged to this layer
+ */
+bool espnow_ota_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+
+/**
+ * @brief Record an image just written to an app partition as the one to serve to the nodes
+ *
+ * @param part The partition, after esp_ota_end()
+ * @param size Image bytes
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG if the image does not verify, or the NVS error
+ */
+esp_err_t espnow_ota_stage(const esp_partition_t *part, size_t size);
+
+/**
+ * @brief Forget the staged image; called before its slot is overwritten
+ */
+void espnow_ota_unstage(void);
+
+/**
+ * @brief Gateway: serve the staged image, if any, from the espnow_ota task
+ *
+ * Call once the ESP-NOW link is up. A staged image whose slot no longer
+ * holds it is unstaged.
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND if nothing is staged, or ESP_ERR_NO_MEM
+ */
+esp_err_t espnow_ota_gateway_start(void);
+
+/**
+ * @brief Gateway: stop serving; a session in progress is abandoned
+ */
+void espnow_ota_gateway_stop(void);
+
+/**
+ * @brief Copy the gateway counters
+ */
+void espnow_ota_get_stats(espnow_ota_stats_t *stats);
+
+/**
+ * @brief Node: frames are only taken from this gateway
+ */
+void espnow_ota_node_init(const uint8_t *gateway_mac);
+
+/**
+ * @brief Node: ask the gateway for an update, unless an offer is already held
+ *
+ * @param wait_ms How long to wait for the OFFER
+ * @return esp_err_t ESP_OK if an offer is held, ESP_ERR_NOT_FOUND if none came, or the send error
+ */
+esp_err_t espnow_ota_node_query(uint32_t wait_ms);
+
+/**
+ * @brief Node: time until espnow_ota_node_run() must be called for the offer held
+ *
+ * Only reads RTC memory, so it is safe before the full boot.
+ *
+ * @return uint32_t Milliseconds, 0 if due now, or ESPNOW_OTA_NONE
+ */
+uint32_t espnow_ota_node_wake_in_ms(void);
+
+/**
+ * @brief Node: take part in the offered session; blocks until it ends
+ *
+ * The offer is used up whatever the result. On ESP_OK the new image is
+ * set to boot; the caller shuts down and restarts.
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND without an offer, ESP_ERR_TIMEOUT if the
+ *         start was missed or the gateway went silent, ESP_ERR_INVALID_CRC if the image
+ *         did not verify, or the OTA error
+ */
+esp_err_t espnow_ota_node_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPNOW_OTA_H
@@ -0,0 +1,152 @@
+/**
+ * @file espnow_pair.h
+ * @brief Automatic ESP-NOW pairing: a node with no server MAC finds its gateway once and keeps it
+ *
+ * Typing the gateway's MAC into configuration.html on every node is the
+ * slowest step of a deployment. A node whose server MAC is unset
+ * broadcasts a DISCOVER on its home channel, then on each other channel up
+ * to ESPNOW_CHANNEL_MAX. A gateway answers with an OFFER naming its
+ * channel. The node takes the strongest offer heard within
+ * ESPNOW_PAIR_LISTEN_MS of its request. It then writes the gateway's MAC
+ * and channel into the config (server_mac, server_channel) with one
+ * nvs_config_flush(), so both land in one NVS commit, and sets its RTC
+ * home channel (espnow_channel.h). Every later wake and boot goes
+ * straight to unicast on that channel with no discovery. Clearing the
+ * server MAC on the config page pairs the node again.
+ *
+ * Both frames travel unencrypted to the broadcast peer, since neither side
+ * has the other as a peer yet. Before it offers, the gateway adds the
+ * node as a peer (espnow_link_add_peer(), under the current key): a keyed
+ * node sends its telemetry encrypted, and ESP-NOW drops an encrypted
+ * frame from a sender that is not a peer before any receive handler runs.
+ * The gateway keeps the MACs of the nodes it took in NVS
+ * (nvs_store_espnow_nodes()) and makes them peers again at boot with
+ * espnow_pair_gateway_restore(), since paired nodes never ask again. A
+ * node whose gateway MAC was typed in rather than paired announces itself
+ * once per power-on (espnow_pair_node_announce()): the same signed
+ * DISCOVER, whose offer it ignores, so the gateway adds it all the same. Each carries a tag: the first
+ * ESPNOW_PAIR_TAG_LEN bytes of an HMAC-SHA256 under the espnow_active key
+ * (nvs_utils.h), over the frame and the sender's MAC. So a gateway answers
+ * only nodes that hold its key, and a node pairs only with a gateway that
+ * holds it too. The OFFER echoes the node's random nonce and MAC, so an
+ * old offer cannot be replayed to it. Without an active key there is
+ * nothing to sign with: the gateway answers nobody and the node does not
+ * pair.
+ *
+ * Frames, ESPNOW_PAIR_MAGIC then the kind, little-endian:
+ *
+ *   DISCOVER  node to broadcast      2..5 nonce, 6..13 tag
+ *   OFFER     gateway to broadcast   2..5 nonce, 6 channel, 7..12 node MAC, 13..20 tag
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESPNOW_PAIR_H
+#define ESPNOW_PAIR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef ESPNOW_PAIR
+#define ESPNOW_PAIR 1                           // 1: gateways answer pairing requests and unpaired nodes send them
+#endif
+#define ESPNOW_PAIR_MAGIC 0x77
+#define ESPNOW_PAIR_KIND_DISCOVER 1
+#define ESPNOW_PAIR_KIND_OFFER 2
+#define ESPNOW_PAIR_TAG_LEN 8                   // Truncated HMAC-SHA256
+#define ESPNOW_PAIR_DISCOVER_LEN (6 + ESPNOW_PAIR_TAG_LEN)
+#define ESPNOW_PAIR_OFFER_LEN (13 + ESPNOW_PAIR_TAG_LEN)
+
+#define ESPNOW_PAIR_LISTEN_MS 60                // Node: wait for offers after each request
+#define ESPNOW_PAIR_TRIES 2                     // Node: requests per channel
+
+/**
+ * @brief Pairing counters of either role
+ */
+typedef struct {
+    uint32_t requests;                          // Node: sent; gateway: received with a valid tag
+    uint32_t offers;                            // Node: received with a valid tag; gateway: sent
+    uint32_t rejected;                          // Frames whose tag, nonce or MAC did not match
+    uint8_t channel;                            // Node: channel paired on, 0 if not paired this boot
+} espnow_pair_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Receive path for both roles; call it from the link receive handler
+ *
+ * On a gateway a valid DISCOVER adds the node as a peer and is answered at once from the link task.
+ *
+ * @return bool Whether the frame was a pairing frame
+ */
+bool espnow_pair_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+
+/**
+ * @brief Gateway: answer pairing requests; call once the link is up
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_SUPPORTED with ESPNOW_PAIR 0, or ESP_ERR_INVALID_STATE without an active key
+ */
+esp_err_t espnow_pair_gateway_start(void);
+
+/**
+ * @brief Gateway: stop answering
+ */
+void espnow_pair_gateway_stop(void);
+
+/**
+ * @brief Gateway: make the nodes paired on earlier boots peers again
+ *
+ * Call once the link is up and before espnow_pair_gateway_start().
+ *
+ * @return esp_err_t ESP_OK, or the first NVS or peer error; the nodes before it are restored
+ */
+esp_err_t espnow_pair_gateway_restore(void);
+
+/**
+ * @brief Node: find the gateway and record it in NVS and RTC memory
+ *
+ * Call with the link up (espnow_link_init()) and espnow_pair_on_receive() in
+ * its handler. Tries first_channel, then the others in turn, and leaves
+ * the radio on the gateway's channel.
+ *
+ * @param first_channel Channel the radio is on
+ * @param gateway_mac Receives the gateway's MAC
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND if no gateway answered, or ESP_ERR_INVALID_STATE without an
+ *         active key. A pairing NVS failed to keep still holds for this boot, and is logged.
+ */
+esp_err_t espnow_pair_node_run(uint8_t first_channel, uint8_t *gateway_mac);
+
+/**
+ * @brief Node with a configured gateway: broadcast one signed DISCOVER so the gateway takes it as a peer
+ *
+ * Call with the link up, on the gateway's channel, once per power-on.
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_SUPPORTED with ESPNOW_PAIR 0, ESP_ERR_INVALID_STATE without an active
+ *         key (an open link needs no announcing), or the send error
+ */
+esp_err_t espnow_pair_node_announce(void);
+
+/**
+ * @brief Copy the counters
+ */
+void espnow_pair_get_stats(espnow_pair_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPNOW_PAIR_H
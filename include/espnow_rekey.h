@@ -0,0 +1,144 @@
+/**
+ * @file espnow_rekey.h
+ * @brief ESP-NOW key rotation without dropped frames: each node changes keys at a seq the gateway names on its ACKs
+ *
+ * configuration.html stores an espnow_pending key next to the active one.
+ * Once the same pending key is stored on the gateway and a node, both
+ * links start a staged rotation (ESPNOW_LINK_KEY_STAGED, espnow_link.h):
+ * the new key is loaded and the peers stay on the old one. ESP-NOW keeps
+ * one LMK per peer, so the two ends of a link have to change keys at the
+ * same frame, and nothing sent with the old key may still be on its way.
+ * The switch is agreed on the reliable layer's sequence numbers
+ * (espnow_reliable.h), with the ACK trailers and telemetry frames that
+ * flow anyway:
+ *
+ *   1. The node's telemetry frames carry the fingerprint of its pending
+ *      key (TELEMETRY_FLAG_KEY).
+ *   2. When it matches the gateway's, the gateway's ACKs to the node name
+ *      a switch seq ESPNOW_REKEY_LEAD past the ACK's cumulative seq.
+ *   3. The node sets a barrier there: frames from the switch seq on wait
+ *      in its flash backlog until every frame before it is acknowledged.
+ *      Its next telemetry frames report the switch seq back.
+ *   4. The ACK that acknowledges everything below the switch seq, to a
+ *      node that reported it, carries ESPNOW_REKEY_COMMIT. Once the node's
+ *      radio acknowledged that ACK, the gateway moves the node's peer to
+ *      the new key.
+ *   5. The node opens the barrier on the commit, waits
+ *      ESPNOW_REKEY_SETTLE_MS, moves its gateway peer to the new key, and
+ *      sends the switch seq with it. That ends the rotation on the node,
+ *      and the new key becomes its active key in NVS.
+ *
+ * Nothing is in flight at the switch, so a rotation costs no retransmit
+ * and no frame. Each move is one esp_now_mod_peer(), timed in the link
+ * stats (key_switch_us); the node counts the retransmits from when the
+ * switch seq was named to the switch, which should stay at zero. A switch
+ * seq the node could not stop at, or one that passed unreported, is
+ * named again further on. Nodes behind a relay (espnow_relay.h) are not
+ * switched this way, and neither is a node that reports another key or
+ * none; they move when the grace window ends, as before. So does a node
+ * whose commit ACK was heard while the gateway missed its radio ACK.
+ *
+ * Trailer item (slot ESPNOW_RELIABLE_TRAILER_REKEY), ESPNOW_REKEY_TRAILER_LEN bytes, little-endian:
+ *
+ *   0     magic               ESPNOW_REKEY_MAGIC
+ *   1     flags               ESPNOW_REKEY_COMMIT: the gateway moves the node right after this ACK
+ *   2..5  fingerprint         Of the new key (espnow_link_rotation())
+ *   6..9  switch seq          First seq sent with the new key
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESPNOW_REKEY_H
+#define ESPNOW_REKEY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "espnow_config.h"
+#include "espnow_reliable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ESPNOW_REKEY_MAGIC 0x6B
+#define ESPNOW_REKEY_TRAILER_LEN 10
+#define ESPNOW_REKEY_COMMIT (1 << 0)
+
+#define ESPNOW_REKEY_NODES ESPNOW_RELIABLE_MAX_NODES
+#define ESPNOW_REKEY_LEAD ESPNOW_RELIABLE_WINDOW // Switch seq past the cumulative ACK: the frames in flight finish first
+#define ESPNOW_REKEY_SETTLE_MS 5                // Node: pause before its own move, so the gateway's comes first
+
+_Static_assert(ESPNOW_CONFIG_TRAILER_LEN + ESPNOW_REKEY_TRAILER_LEN <= ESPNOW_RELIABLE_ACK_TRAILER_MAX,
+               "the settings and the switch seq must fit one ACK trailer");
+
+/**
+ * @brief Rotation counters; the gateway fills the first half, a node the second
+ */
+typedef struct {
+    uint8_t ready;                              // Gateway: nodes holding the new key
+    uint8_t switched;                           // ... moved to it
+    uint32_t announced;                         // ACKs that named a switch seq
+    uint32_t commits;                           // Nodes moved after their commit ACK was delivered
+    uint32_t switch_seq;                        // Node: the seq it changes keys at, 0 none
+    bool node_switched;                         // ... changed keys this boot
+    uint32_t retransmits;                       // ... resends and MAC retries from the switch seq named to the switch
+} espnow_rekey_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Gateway: name switch seqs on the ACKs and move nodes on their commits
+ *
+ * @return esp_err_t ESP_OK
+ */
+esp_err_t espnow_rekey_gateway_start(void);
+
+/**
+ * @brief Gateway: the key extension of a node's telemetry frame; runs in the link task
+ *
+ * @param mac The node, which its ACKs go to
+ * @param fingerprint Of the pending key it holds
+ * @param switch_seq The switch seq it stops at, 0 for none
+ */
+void espnow_rekey_gateway_seen(const uint8_t *mac, uint32_t fingerprint, uint32_t switch_seq);
+
+/**
+ * @brief Node: take switch seqs from the gateway's ACKs; after espnow_reliable_sender_init(), and again on failover
+ *
+ * A switch seq this gateway named before deep sleep is stopped at again; another gateway's is dropped.
+ *
+ * @param gateway The gateway sent to
+ */
+void espnow_rekey_node_init(const uint8_t *gateway);
+
+/**
+ * @brief Node: what the key extension of the next telemetry frame should say
+ *
+ * Also drops a barrier left by a rotation that ended on its grace window.
+ *
+ * @param fingerprint Receives the fingerprint of the pending key
+ * @param switch_seq Receives the switch seq, 0 for none
+ * @return bool Whether a rotation is under way, so the extension is sent at all
+ */
+bool espnow_rekey_node_report(uint32_t *fingerprint, uint32_t *switch_seq);
+
+/**
+ * @brief Copy the counters
+ */
+void espnow_rekey_get_stats(espnow_rekey_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPNOW_REKEY_H
@@ -0,0 +1,145 @@
+/**
+ * @file espnow_relay.h
+ * @brief Relay role: a mains-powered node forwards other nodes' frames to the gateway and their ACKs back
+ *
+ * The bow and masthead nodes can lose their direct link to the cabin
+ * gateway. A relay is an awake node (NODE_RELAY) that keeps its radio on
+ * and repeats the gateway's time beacon under its own MAC, marked
+ * ESPNOW_TIME_SOURCE_RELAY. Out-of-range nodes learn it from that beacon
+ * like any gateway (espnow_failover.h), at a score penalty per hop, and
+ * fail over to it when the gateway stops acknowledging them.
+ *
+ * The relay wraps each reliable DATA frame it gets in a relay header and
+ * sends it on to its own gateway, which may be a further relay. Every hop
+ * counts, and a frame past ESPNOW_RELAY_MAX_HOPS is dropped, so a loop
+ * dies out. Each relay, and the gateway, remembers the neighbour each
+ * origin was last heard through. The gateway's ACK then goes back down
+ * that reverse path, and the last relay unwraps it for the node. The ACK
+ * is still the gateway's, so delivery stays end to end.
+ *
+ * Duplicates are suppressed in the per-node table. A relay keeps the
+ * last ACK each node got through it. A resend of a frame that ACK already
+ * covers (the node missed the ACK) is answered from it and goes no
+ * further. A resend of the frame just forwarded is dropped within
+ * ESPNOW_RELAY_DUP_MS. The gateway's own per-node receive state catches
+ * any that still come in twice, by direct and relayed paths alike.
+ *
+ * Forwarding runs from a task, paced to ESPNOW_RELAY_RATE frames a second
+ * with bursts of ESPNOW_RELAY_BURST. Frames beyond its queue are dropped
+ * and resent later by their node, so a chatty node cannot flood the
+ * channel. Only the telemetry path is relayed. Slots, channel moves and
+ * firmware need the direct link.
+ *
+ * Frames, ESPNOW_RELAY_MAGIC then:
+ *
+ *   1     kind                ESPNOW_RELAY_KIND_UP (towards the gateway) or _DOWN
+ *   2     hops                Relays passed so far
+ *   3..8  origin              The node the inner frame is from or for
+ *   9..   inner frame         A reliable DATA frame up, its ACK down
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESPNOW_RELAY_H
+#define ESPNOW_RELAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "espnow_link.h"
+#include "espnow_reliable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ESPNOW_RELAY_MAGIC 0x79
+#define ESPNOW_RELAY_KIND_UP 1
+#define ESPNOW_RELAY_KIND_DOWN 2
+#define ESPNOW_RELAY_HEADER_LEN 9
+
+#define ESPNOW_RELAY_MAX_HOPS 3                 // Relays a frame may pass
+#define ESPNOW_RELAY_ROUTES 32                  // Nodes remembered, with their reverse path
+#define ESPNOW_RELAY_QUEUE 8                    // Frames waiting to be forwarded
+#define ESPNOW_RELAY_RATE 20                    // Frames forwarded upstream per second
+#define ESPNOW_RELAY_BURST 8                    // ... and in a burst above that
+#define ESPNOW_RELAY_DUP_MS 200                 // A resend of the frame just forwarded is dropped this soon
+
+_Static_assert(ESPNOW_RELAY_HEADER_LEN <= ESPNOW_RELIABLE_RELAY_ROOM, "a relayed DATA frame must fit one frame");
+
+/**
+ * @brief Relay counters, either role
+ */
+typedef struct {
+    bool running;
+    uint32_t up;                                // Frames forwarded upstream (gateway: received relayed)
+    uint32_t down;                              // ACKs sent back down
+    uint32_t answered;                          // Resends answered from the kept ACK
+    uint32_t suppressed;                        // Resends dropped as just forwarded
+    uint32_t dropped;                           // Queue full, too many hops, or no route back
+    uint32_t beacons;                           // Time beacons repeated
+    uint8_t routes;                             // Nodes in the table
+} espnow_relay_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Receive path for both roles; call it first from the link receive handler
+ *
+ * @return bool Whether the frame was taken for relaying
+ */
+bool espnow_relay_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+
+/**
+ * @brief Gateway: unwrap relayed frames; call before espnow_link_init()
+ *
+ * @param deliver Gets each relayed inner frame, as from its origin; runs in the link task
+ */
+esp_err_t espnow_relay_gateway_start(espnow_link_rx_t deliver);
+
+/**
+ * @brief Gateway: send a frame to a node that was last heard through a relay
+ *
+ * Call from a task that may send (not the link task).
+ *
+ * @return esp_err_t ESP_ERR_NOT_FOUND when the node was last heard directly, else as espnow_link_send()
+ */
+esp_err_t espnow_relay_send(const uint8_t *mac, const uint8_t *data, size_t len);
+
+/**
+ * @brief Node: start relaying to the gateway; keeps the radio on while it runs
+ *
+ * @param upstream The gateway (or relay) this node sends to
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if running, or ESP_ERR_NO_MEM
+ */
+esp_err_t espnow_relay_node_start(const uint8_t *upstream);
+
+/**
+ * @brief Node: forward to another gateway after a failover
+ */
+void espnow_relay_node_retarget(const uint8_t *upstream);
+
+/**
+ * @brief Node: stop relaying and release the radio
+ */
+void espnow_relay_node_stop(void);
+
+/**
+ * @brief Copy the counters
+ */
+void espnow_relay_get_stats(espnow_relay_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPNOW_RELAY_H
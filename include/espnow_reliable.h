@@ -0,0 +1,344 @@
+/**
+ * @file espnow_reliable.h
+ * @brief End-to-end delivery over ESP-NOW: sequence numbers, selective ACK and windowed retransmit
+ *
+ * A MAC-level ACK only says the gateway's radio heard a frame. This layer
+ * has the gateway acknowledge a frame once its handler accepted it, and the
+ * node keeps every frame until then. All fields are little-endian.
+ *
+ *   DATA, node to gateway, ESPNOW_RELIABLE_DATA_HEADER_LEN bytes + payload:
+ *     0     magic               ESPNOW_RELIABLE_MAGIC
+ *     1     kind                ESPNOW_RELIABLE_KIND_DATA
+ *     2..3  session             Chosen when the node's backlog starts empty
+ *     4..7  seq                 Frame sequence number within the session
+ *     8..11 base                Oldest seq the node still holds; all below were ACKed
+ *
+ *   ACK, gateway to node, ESPNOW_RELIABLE_ACK_LEN bytes:
+ *     0     magic
+ *     1     kind                ESPNOW_RELIABLE_KIND_ACK
+ *     2..3  session
+ *     4..7  cumulative          Every seq below this was delivered
+ *     8..11 selective           Bit i: seq cumulative + 1 + i was delivered too
+ *     12..13 hold_ms            Nonzero: the gateway is full, send nothing for this long
+ *     14..   trailer            Optional, up to ESPNOW_RELIABLE_ACK_TRAILER_MAX bytes: the items of
+ *                               the gateway's ACK hooks in slot order, each starting with its own
+ *                               magic, for the node's trailer hooks (espnow_config.h, espnow_rekey.h)
+ *
+ * Node (sender): frames wait in a window of ESPNOW_RELIABLE_WINDOW slots in
+ * RTC_NOINIT memory, so they survive deep sleep and any reset short of a
+ * power cut. A frame is resent when a later one was selectively ACKed
+ * (ESP-NOW does not reorder, so it was lost) or when its retransmit timeout
+ * expires; the timeout doubles per resend up to ESPNOW_RELIABLE_RTO_MAX_MS,
+ * so an absent gateway costs little airtime. The window does not shrink on
+ * loss: losses here are noise rather than congestion, and selective repeat
+ * resends only what was lost, so new frames keep flowing beside the resends.
+ *
+ * Gateway (receiver): per node, a cumulative seq and a 64-bit bitmap of the
+ * seqs above it, so the duplicate check is one shift and mask per frame.
+ * ACKs are sent from their own task, since the link task cannot send.
+ *
+ * Backpressure: while the gateway can take nothing more it sets a hold
+ * time, which every ACK carries. The node then neither resends nor takes
+ * new frames into the window until the hold runs out (or an ACK without
+ * one arrives), so its samples stay in its own flash backlog instead of
+ * being transmitted into a full gateway.
+ *
+ * Alarm lane: ESPNOW_RELIABLE_URGENT_SLOTS of the window are kept for
+ * espnow_reliable_send_urgent(). Bulk frames (a flash backlog replay, a
+ * full batch) stop short of them, so an alarm always finds a slot however
+ * deep the node's backlog is, and it is also let through a gateway hold,
+ * which only says the gateway's bulk ring is full (gateway.h).
+ *
+ * Barrier: the node can stop the window at a seq (espnow_reliable_set_barrier()).
+ * Frames from that seq on are refused, as during a hold, until every frame
+ * below it was acknowledged and the barrier was opened; its handler then
+ * runs in the sending task before the first frame past it is taken. The
+ * key rotation (espnow_rekey.h) changes keys there, with nothing in flight.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESPNOW_RELIABLE_H
+#define ESPNOW_RELIABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ESPNOW_RELIABLE_MAGIC 0x7E
+#define ESPNOW_RELIABLE_KIND_DATA 1
+#define ESPNOW_RELIABLE_KIND_ACK 2
+#define ESPNOW_RELIABLE_DATA_HEADER_LEN 12
+#define ESPNOW_RELIABLE_ACK_LEN 14
+#define ESPNOW_RELIABLE_ACK_TRAILER_MAX 32      // Bytes the gateway may add to an ACK
+#define ESPNOW_RELIABLE_TRAILER_CONFIG 0        // Trailer slots, in the order their items are written
+#define ESPNOW_RELIABLE_TRAILER_REKEY 1
+#define ESPNOW_RELIABLE_TRAILER_SLOTS 2
+#define ESPNOW_RELIABLE_FRAME_MAX 250           // ESP_NOW_MAX_DATA_LEN
+#define ESPNOW_RELIABLE_RELAY_ROOM 9           // Left for the relay header (espnow_relay.h)
+#define ESPNOW_RELIABLE_MAX_PAYLOAD (ESPNOW_RELIABLE_FRAME_MAX - ESPNOW_RELIABLE_DATA_HEADER_LEN - ESPNOW_RELIABLE_RELAY_ROOM)
+
+// Node
+#define ESPNOW_RELIABLE_WINDOW 8                // Unacknowledged frames held (~2 KB of RTC memory)
+#define ESPNOW_RELIABLE_URGENT_SLOTS 2          // ... of which only alarm frames may take
+#define ESPNOW_RELIABLE_BULK_WINDOW (ESPNOW_RELIABLE_WINDOW - ESPNOW_RELIABLE_URGENT_SLOTS)
+#define ESPNOW_RELIABLE_MAC_RETRIES 2           // Immediate resends when the MAC gets no ACK
+#define ESPNOW_RELIABLE_MAC_RETRY_DELAY_MS 20   // Pause before one, to step past a burst of interference
+#define ESPNOW_RELIABLE_RTO_MS 250              // First end-to-end retransmit timeout
+#define ESPNOW_RELIABLE_RTO_MAX_MS 30000        // Timeout cap while the gateway stays silent
+#define ESPNOW_RELIABLE_WAIT_FOREVER UINT32_MAX // espnow_reliable_pump(): nothing to resend
+
+// Gateway
+#define ESPNOW_RELIABLE_MAX_NODES 32            // Power of two; per-node receive state
+#define ESPNOW_RELIABLE_DUP_WINDOW 64           // Seqs tracked above the cumulative ACK
+
+_Static_assert(ESPNOW_RELIABLE_WINDOW <= 32, "the selective ACK covers 32 frames");
+_Static_assert(ESPNOW_RELIABLE_WINDOW < ESPNOW_RELIABLE_DUP_WINDOW, "the gateway must track the whole window");
+_Static_assert(ESPNOW_RELIABLE_URGENT_SLOTS < ESPNOW_RELIABLE_WINDOW, "bulk frames need a slot too");
+
+/**
+ * @brief Gateway handler for a delivered payload; runs in the link task
+ *
+ * @return esp_err_t ESP_OK to acknowledge; ESP_ERR_NO_MEM to leave it unacknowledged so the
+ *         node resends it later; any other error acknowledges and discards it
+ */
+typedef esp_err_t (*espnow_reliable_deliver_t)(const uint8_t *mac, const uint8_t *data, size_t len);
+
+/**
+ * @brief Gateway hook: an item to add to a node's ACK; runs in the ACK task
+ *
+ * @param mac The node
+ * @param cumulative The ACK's cumulative seq
+ * @param buf Where the item goes
+ * @param cap Room left in the trailer
+ * @return size_t Bytes written, 0 for none
+ */
+typedef size_t (*espnow_reliable_ack_hook_t)(const uint8_t *mac, uint32_t cumulative, uint8_t *buf, size_t cap);
+
+/**
+ * @brief Gateway hook: an ACK went out; runs in the ACK task
+ *
+ * @param mac The node
+ * @param direct Sent to the node itself, not through a relay
+ * @param delivered The node's radio acknowledged it
+ */
+typedef void (*espnow_reliable_ack_sent_t)(const uint8_t *mac, bool direct, bool delivered);
+
+/**
+ * @brief Node hook: the trailer of an ACK from the gateway sent to, from one item on; runs in the link task
+ *
+ * @return size_t Length of its item at data, or 0 if data does not start with one
+ */
+typedef size_t (*espnow_reliable_trailer_hook_t)(const uint8_t *data, size_t len);
+
+/**
+ * @brief Node handler for an opened barrier; runs in the sending task
+ *
+ * @param seq The barrier: every frame below it was acknowledged and none from it on was sent
+ */
+typedef void (*espnow_reliable_barrier_t)(uint32_t seq);
+
+/**
+ * @brief Node counters since espnow_reliable_sender_init()
+ */
+typedef struct {
+    uint32_t frames;                            // Frames taken into the window
+    uint32_t acked;                             // Frames the gateway acknowledged
+    uint32_t resends;                           // End-to-end retransmissions
+    uint32_t mac_retries;                       // Immediate resends after a missing MAC ACK
+    uint32_t window_full;                       // Frames refused because the window was full
+    uint32_t held;                              // Frames refused during a gateway hold
+    uint32_t barrier_waits;                     // Frames refused at a barrier
+    uint32_t holds;                             // ACKs that asked for a hold
+    uint32_t urgent;                            // Alarm frames taken (espnow_reliable_send_urgent())
+    uint32_t rtt_ms;                            // Smoothed send-to-ACK time of frames sent once
+    uint8_t backlog;                            // Frames waiting for an ACK now
+    uint16_t session;
+} espnow_reliable_tx_stats_t;
+
+/**
+ * @brief Gateway counters since espnow_reliable_receiver_init()
+ */
+typedef struct {
+    uint32_t delivered;                         // Frames handed to the deliver handler and accepted
+    uint32_t duplicates;                        // Frames already delivered, re-ACKed only
+    uint32_t deferred;                          // Frames the handler had no room for
+    uint32_t rejected;                          // Malformed, or beyond the duplicate window
+    uint32_t acks;                              // ACK frames sent
+    uint32_t hold_acks;                         // ... of which asked the node to hold off
+    uint32_t ack_failed;
+    uint8_t nodes;                              // Nodes with receive state
+} espnow_reliable_rx_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Receive path for both roles; call it from the link receive handler
+ *
+ * DATA frames go to the receiver, ACK frames to the sender; others are left to the caller.
+ *
+ * @return bool Whether the frame belonged to this layer
+ */
+bool espnow_reliable_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+
+/**
+ * @brief Start sending to one peer, resuming the window kept in RTC memory
+ *
+ * A window that does not check out (power-on, or another peer) is
+ * discarded and a new session starts.
+ *
+ * @param peer Peer already added with espnow_link_add_peer()
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG, or ESP_ERR_NO_MEM
+ */
+esp_err_t espnow_reliable_sender_init(const uint8_t *peer);
+
+/**
+ * @brief Move the window to another peer, for gateway failover
+ *
+ * The session and the frames held are kept and all of them fall due at
+ * once. The new gateway has never seen the session, so it takes the
+ * oldest held seq as its base; frames the old one already delivered
+ * arrive twice upstream, and the forwarders drop them (MQTT_FORWARDER_CLAIMS).
+ *
+ * @param peer Peer already added with espnow_link_add_peer()
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG, or ESP_ERR_INVALID_STATE before espnow_reliable_sender_init()
+ */
+esp_err_t espnow_reliable_sender_retarget(const uint8_t *peer);
+
+/**
+ * @brief Take a payload into the window and transmit it
+ *
+ * Call from one task only (with espnow_reliable_pump() and espnow_reliable_flush()).
+ *
+ * @param data Payload, up to ESPNOW_RELIABLE_MAX_PAYLOAD bytes
+ * @param len Payload length
+ * @param mac_retries Receives the immediate resends it took (may be NULL)
+ * @return esp_err_t ESP_OK once the MAC acknowledged it; ESP_FAIL or ESP_ERR_TIMEOUT if it did not
+ *         (the frame is kept and resent later); ESP_ERR_NO_MEM if the window is full or the
+ *         gateway asked for a hold, and the payload was not taken
+ */
+esp_err_t espnow_reliable_send(const uint8_t *data, size_t len, uint8_t *mac_retries);
+
+/**
+ * @brief espnow_reliable_send() in the alarm lane: may take the reserved slots, and passes a gateway hold
+ *
+ * A barrier still stops it. Same task and return values as espnow_reliable_send().
+ */
+esp_err_t espnow_reliable_send_urgent(const uint8_t *data, size_t len, uint8_t *mac_retries);
+
+/**
+ * @brief Resend frames found lost or past their timeout; nothing during a gateway hold
+ *
+ * @return Milliseconds until the next timeout or the end of the hold, or ESPNOW_RELIABLE_WAIT_FOREVER
+ *         with an empty window
+ */
+uint32_t espnow_reliable_pump(void);
+
+/**
+ * @brief Resend as needed until the window is empty or the time runs out
+ *
+ * @return esp_err_t ESP_OK when everything was acknowledged, ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t espnow_reliable_flush(uint32_t timeout_ms);
+
+/**
+ * @brief Frames waiting for an ACK
+ */
+uint8_t espnow_reliable_backlog(void);
+
+/**
+ * @brief Copy the node counters
+ */
+void espnow_reliable_get_tx_stats(espnow_reliable_tx_stats_t *stats);
+
+/**
+ * @brief Node: take one kind of item from the trailers of the gateway's ACKs; NULL stops
+ *
+ * @param slot ESPNOW_RELIABLE_TRAILER_*
+ */
+void espnow_reliable_set_trailer_hook(uint8_t slot, espnow_reliable_trailer_hook_t hook);
+
+/**
+ * @brief Node: refuse frames from seq on until the barrier is opened and everything below it is acknowledged
+ *
+ * Safe from the link task. A new barrier replaces the old one.
+ *
+ * @param seq First seq held back
+ * @param handler Runs once the barrier is passed
+ */
+void espnow_reliable_set_barrier(uint32_t seq, espnow_reliable_barrier_t handler);
+
+/**
+ * @brief Node: let the barrier pass once everything below it is acknowledged; safe from the link task
+ */
+void espnow_reliable_open_barrier(void);
+
+/**
+ * @brief Node: drop the barrier without running its handler
+ */
+void espnow_reliable_clear_barrier(void);
+
+/**
+ * @brief Node: the seq the next new frame will get
+ */
+uint32_t espnow_reliable_next_seq(void);
+
+/**
+ * @brief Start accepting DATA frames and the ACK task
+ *
+ * Nodes are added as ESP-NOW peers when their first frame arrives, so the
+ * ACK can be sent back.
+ *
+ * @param deliver Handler for each new payload
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_INVALID_STATE if running, or ESP_ERR_NO_MEM
+ */
+esp_err_t espnow_reliable_receiver_init(espnow_reliable_deliver_t deliver);
+
+/**
+ * @brief Stop the ACK task and forget the per-node state
+ */
+esp_err_t espnow_reliable_receiver_deinit(void);
+
+/**
+ * @brief Ask nodes to hold off for hold_ms from their next ACK on; 0 lifts the hold
+ *
+ * Capped at UINT16_MAX ms. Frames already deferred get an ACK carrying it.
+ */
+void espnow_reliable_set_hold(uint32_t hold_ms);
+
+/**
+ * @brief Gateway: add an item to the ACKs, from hook; NULL stops
+ *
+ * @param slot ESPNOW_RELIABLE_TRAILER_*: items are written in slot order
+ */
+void espnow_reliable_set_ack_hook(uint8_t slot, espnow_reliable_ack_hook_t hook);
+
+/**
+ * @brief Gateway: be told of every ACK sent; NULL stops
+ */
+void espnow_reliable_set_ack_sent_hook(espnow_reliable_ack_sent_t hook);
+
+/**
+ * @brief Copy the gateway counters
+ */
+void espnow_reliable_get_rx_stats(espnow_reliable_rx_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPNOW_RELIABLE_H
@@ -0,0 +1,165 @@
+/**
+ * @file espnow_slot.h
+ * @brief Transmit slots for duty-cycled nodes, on the gateway's time beacon (TDMA)
+ *
+ * Nodes that wake at arbitrary times collide, resend and stay awake for
+ * their ACKs, and the gateway has to listen all the time. With slots,
+ * every ESPNOW_SLOT_CYCLE_S of beacon time (espnow_time.h) starts with one
+ * window:
+ *
+ *   slot 0 | slot 1 | ... | slot ESPNOW_SLOT_COUNT - 1 | open period
+ *   ESPNOW_SLOT_MS each                                 ESPNOW_SLOT_OPEN_MS
+ *
+ * A node with a slot wakes ESPNOW_SLOT_LEAD_MS before it (to boot and
+ * bring the radio up), waits for its start and sends its batch inside it.
+ * A node without one, once its clock is synced, wakes for the open period,
+ * at a random point in it, and asks for a slot (REQUEST); the gateway
+ * answers with the slot and the cycle layout (ASSIGN). Nodes renew every
+ * ESPNOW_SLOT_RENEW_S; the gateway frees a slot not renewed for
+ * ESPNOW_SLOT_LEASE_S, and keeps its table in NVS so a restart does not
+ * hand a slot out twice.
+ *
+ * With slot sleep on (GATEWAY_SLOT_SLEEP), the gateway holds its radio
+ * lock only for the window, ESPNOW_SLOT_GUARD_MS either side, and light-
+ * sleeps the rest of the cycle. Beacons still go out between windows (a
+ * send takes the lock for itself), so an unsynced node can still set its
+ * clock and find the open period. Frames from nodes outside the windows
+ * (awake nodes, an unslotted node before its clock is set) are heard only
+ * when something else keeps the radio up, and are resent by the reliable
+ * layer; slot sleep suits a gateway whose nodes all duty cycle, without an
+ * uplink that needs the radio anyway.
+ *
+ * Frames, little-endian, ESPNOW_SLOT_MAGIC then the kind:
+ *
+ *   REQUEST  node to gateway   (nothing else)
+ *   ASSIGN   gateway to node   2 slot, 3 slot count, 4..5 slot ms, 6..7 cycle s, 8..9 open period ms
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESPNOW_SLOT_H
+#define ESPNOW_SLOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ESPNOW_SLOT_MAGIC 0x7B
+#define ESPNOW_SLOT_KIND_REQUEST 1
+#define ESPNOW_SLOT_KIND_ASSIGN 2
+#define ESPNOW_SLOT_REQUEST_LEN 2
+#define ESPNOW_SLOT_ASSIGN_LEN 10
+
+#define ESPNOW_SLOT_CYCLE_S 60                  // One window per cycle; a node's sample period is a multiple
+#define ESPNOW_SLOT_COUNT 16                    // Slots per window: nodes per gateway
+#define ESPNOW_SLOT_MS 250                      // A batch, its ACK and a resend or two
+#define ESPNOW_SLOT_OPEN_MS 1000                // After the slots: REQUESTs from nodes without one
+#define ESPNOW_SLOT_GUARD_MS 500                // Gateway listens this much longer either side (clock error)
+#define ESPNOW_SLOT_LEAD_MS 400                 // Node wakes this early: boot and radio bring-up
+#define ESPNOW_SLOT_RENEW_S (6 * 3600)          // Node asks again this often
+#define ESPNOW_SLOT_LEASE_S (24 * 3600)         // Gateway frees a slot not renewed for this long
+#define ESPNOW_SLOT_REQUEST_WAIT_MS 200         // Node waits this long for the ASSIGN
+
+_Static_assert(ESPNOW_SLOT_COUNT <= UINT8_MAX, "slots are numbered in one byte");
+_Static_assert((ESPNOW_SLOT_COUNT * ESPNOW_SLOT_MS + ESPNOW_SLOT_OPEN_MS + 2 * ESPNOW_SLOT_GUARD_MS) <
+               ESPNOW_SLOT_CYCLE_S * 1000, "the window must fit its cycle");
+
+/**
+ * @brief Gateway counters and node slot state
+ */
+typedef struct {
+    uint8_t assigned;                           // Gateway: slots held; node: 1 with a slot
+    uint8_t slot;                               // Node: its slot
+    uint32_t requests;                          // Gateway: REQUESTs heard; node: sent
+    uint32_t refused;                           // Gateway: REQUESTs with every slot taken
+    uint32_t windows;                           // Gateway: windows the radio was held for
+    uint32_t late;                              // Node: wakes that reached the slot after it ended
+} espnow_slot_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Receive path for both roles; call it from the link receive handler
+ *
+ * @return bool Whether the frame belonged to this layer
+ */
+bool espnow_slot_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+
+/**
+ * @brief Gateway: load the slot table and start answering REQUESTs
+ *
+ * @param sleep_between Hold the radio only for the windows (needs a power profile with light sleep)
+ * @param wake Called from the link task when an ASSIGN is due; wakes the caller of the poll
+ */
+esp_err_t espnow_slot_gateway_start(bool sleep_between, void (*wake)(void));
+
+/**
+ * @brief Gateway: send due ASSIGNs and take or let go of the radio at the window edges
+ */
+void espnow_slot_gateway_poll(void);
+
+/**
+ * @brief Gateway: milliseconds until espnow_slot_gateway_poll() has work
+ */
+uint32_t espnow_slot_gateway_poll_due_ms(void);
+
+/**
+ * @brief Gateway: stop, and keep the radio up
+ */
+void espnow_slot_gateway_stop(void);
+
+/**
+ * @brief Node: slot frames are only taken from this gateway; a slot another gateway assigned is dropped
+ */
+void espnow_slot_node_init(const uint8_t *gateway_mac);
+
+/**
+ * @brief Node: whether a REQUEST is due (no slot, or time to renew)
+ */
+bool espnow_slot_node_due(void);
+
+/**
+ * @brief Node: ask the gateway for a slot and wait for the ASSIGN
+ *
+ * @return esp_err_t ESP_OK with a slot, ESP_ERR_TIMEOUT, ESP_ERR_INVALID_STATE before the clock is synced,
+ *         or the send error
+ */
+esp_err_t espnow_slot_node_request(uint32_t wait_ms);
+
+/**
+ * @brief Node: Unix microseconds of the first transmit time at or after a given time
+ *
+ * The node's slot, or a random point in the open period without one.
+ *
+ * @return int64_t 0 while the clock is not synced
+ */
+int64_t espnow_slot_node_next_us(int64_t after_us);
+
+/**
+ * @brief Node: hold back until the slot starts, when the wake came early for it
+ */
+void espnow_slot_node_wait(void);
+
+/**
+ * @brief Copy the counters and slot state
+ */
+void espnow_slot_get_stats(espnow_slot_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPNOW_SLOT_H
@@ -0,0 +1,156 @@
+/**
+ * @file espnow_time.h
+ * @brief Gateway time beacon over ESP-NOW; nodes keep their clock from it, with offset and drift
+ *
+ * Nodes have no network time, yet their records carry Unix seconds that
+ * the gateway's aggregates, history and telemetry deltas all rely on.
+ *
+ * The gateway takes its time from SNTP over the uplink and broadcasts a
+ * beacon every ESPNOW_TIME_BEACON_MS once its clock is set. A gateway with
+ * no uplink keeps beaconing the clock it still holds from an earlier sync
+ * (the RTC keeps it across resets), marked as holdover, so the nodes at
+ * least agree with the gateway that stores their records.
+ *
+ * A node sets its clock from a beacon, then lets it run free. At the next
+ * beacon the error it built up over the time since gives the drift of its
+ * clock (mostly the RTC slow clock during deep sleep), smoothed over
+ * syncs. espnow_time_now() corrects the free-running clock by that drift,
+ * so a node timestamps samples on its own between syncs, without a round
+ * trip. It needs a beacon only every ESPNOW_TIME_RESYNC_S (sooner until
+ * the drift is known): an awake node takes the next one it hears, a
+ * duty-cycled node keeps its radio on for up to ESPNOW_TIME_LISTEN_MS on
+ * the wake that is due.
+ *
+ * The state lives in RTC memory next to the system time, so it survives
+ * deep sleep. The beacon is timestamped just before it is sent, and read
+ * in the link task, so a sync is good to a few milliseconds; records
+ * carry whole seconds.
+ *
+ * Beacon, gateway broadcast, ESPNOW_TIME_BEACON_LEN bytes, little-endian:
+ *   0      magic               ESPNOW_TIME_MAGIC
+ *   1      kind                ESPNOW_TIME_KIND_BEACON
+ *   2      source              ESPNOW_TIME_SOURCE_*
+ *   3..10  time                Unix microseconds
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESPNOW_TIME_H
+#define ESPNOW_TIME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ESPNOW_TIME_MAGIC 0x7C
+#define ESPNOW_TIME_KIND_BEACON 1
+#define ESPNOW_TIME_BEACON_LEN 11
+#define ESPNOW_TIME_SOURCE_HOLDOVER 0           // Gateway clock from an earlier sync
+#define ESPNOW_TIME_SOURCE_SNTP 1               // Gateway synced over SNTP this boot
+#define ESPNOW_TIME_SOURCE_RELAY 2              // Repeated by a relay from its own synced clock (espnow_relay.h)
+
+#define ESPNOW_TIME_SNTP_SERVER "pool.ntp.org"
+#define ESPNOW_TIME_VALID_AFTER 1735689600      // 2025-01-01: an earlier clock was never set
+#define ESPNOW_TIME_BEACON_MS 2000              // Gateway broadcast period
+#define ESPNOW_TIME_LISTEN_MS (ESPNOW_TIME_BEACON_MS + 500) // Longest a duty-cycled node waits for one
+#define ESPNOW_TIME_RESYNC_S 3600               // Node sync period once its drift is known
+#define ESPNOW_TIME_DRIFT_SPAN_S 300            // Shortest span a drift is measured over (and the period until then)
+#define ESPNOW_TIME_DRIFT_MAX_PPM 50000         // Larger estimates are discarded as a clock step
+
+/**
+ * @brief Counters and clock state of either role
+ */
+typedef struct {
+    bool synced;                                // Gateway: clock valid; node: set from a beacon
+    uint8_t source;                             // Node: ESPNOW_TIME_SOURCE_* of the last beacon taken
+    uint32_t beacons;                           // Gateway: sent; node: heard from the gateway
+    uint32_t syncs;                             // Gateway: SNTP syncs; node: beacons taken
+    int32_t last_offset_ms;                     // Node: gateway time minus own clock at the last sync
+    int32_t drift_ppm;                          // Node: own clock rate error, positive when it runs slow
+    bool drift_known;
+    uint32_t last_sync_s;                       // Unix seconds of the last sync, 0 if none
+} espnow_time_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Receive path for the node; call it from the link receive handler
+ *
+ * @return bool Whether the frame was a time beacon
+ */
+bool espnow_time_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+
+/**
+ * @brief Gateway: start SNTP and the broadcast peer; call once the ESP-NOW link is up
+ */
+esp_err_t espnow_time_gateway_start(void);
+
+/**
+ * @brief Gateway: broadcast a beacon when one is due; from the forwarder loop
+ */
+void espnow_time_gateway_poll(void);
+
+/**
+ * @brief Gateway: milliseconds until espnow_time_gateway_poll() has work
+ */
+uint32_t espnow_time_gateway_poll_due_ms(void);
+
+/**
+ * @brief Gateway: stop SNTP and the beacons
+ */
+void espnow_time_gateway_stop(void);
+
+/**
+ * @brief Node: beacons are only taken from this gateway
+ */
+void espnow_time_node_init(const uint8_t *gateway_mac);
+
+/**
+ * @brief Node: whether the clock needs a beacon
+ */
+bool espnow_time_node_due(void);
+
+/**
+ * @brief Node: wait for a beacon while one is due
+ *
+ * @param wait_ms Longest wait
+ * @return esp_err_t ESP_OK once synced (or when no sync was due), ESP_ERR_TIMEOUT, ESP_ERR_INVALID_STATE
+ *         before espnow_time_node_init()
+ */
+esp_err_t espnow_time_node_sync(uint32_t wait_ms);
+
+/**
+ * @brief Unix seconds, corrected for the drift measured since the last sync
+ *
+ * On the gateway, and on a node that never synced, this is time(NULL).
+ */
+uint32_t espnow_time_now(void);
+
+/**
+ * @brief espnow_time_now() in Unix microseconds
+ */
+int64_t espnow_time_now_us(void);
+
+/**
+ * @brief Copy the counters and clock state
+ */
+void espnow_time_get_stats(espnow_time_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPNOW_TIME_H
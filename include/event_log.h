@@ -0,0 +1,147 @@
+/**
+ * @file event_log.h
+ * @brief Binary event log: call sites record a format and raw arguments, text is made only when read
+ *
+ * ESP_LOGx formats at the call site and writes the line to the UART
+ * before it returns, which a per-frame path cannot afford. EVENT_LOGx
+ * records the format string's address, the tag, the time and up to
+ * EVENT_LOG_MAX_ARGS 32-bit arguments into a RAM ring instead: a slot is
+ * claimed with one atomic add and published with a release store, so
+ * any task on either core, or an ISR, records in about a microsecond
+ * without a lock.
+ *
+ * Formatting happens when someone reads: GET /api/log, or the drain task
+ * that prints to the UART what the tag's log level lets through. The
+ * ring keeps the last EVENT_LOG_SLOTS events, whether or not they were
+ * printed, and a reader that falls behind is told how many it lost.
+ *
+ * Formats take 32-bit integer conversions only (%d %u %x %ld %lu %lx %c),
+ * as every argument is stored as a uint32_t. A string would be a pointer
+ * read long after the call returned, so a pointer argument draws a
+ * conversion diagnostic rather than being stored. The format and the tag
+ * must stay valid for the whole run: literals and a file's TAG are.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef EVENT_LOG_SLOTS
+#define EVENT_LOG_SLOTS 128                     // Events kept, a power of two; 48 bytes each
+#endif
+#define EVENT_LOG_MAX_ARGS 6
+#ifndef EVENT_LOG_LEVEL
+#define EVENT_LOG_LEVEL ESP_LOG_DEBUG           // Most verbose level recorded; the drain still applies the tag's level
+#endif
+#ifndef EVENT_LOG_UART
+#define EVENT_LOG_UART 1                        // 0: no drain task; events are only read over /api/log
+#endif
+#define EVENT_LOG_DRAIN_MS 500                  // Drain task period
+#define EVENT_LOG_LINE_MAX 160                  // Longest formatted line, terminator included
+
+/**
+ * @brief One recorded event, as a reader gets it
+ */
+typedef struct {
+    uint32_t seq;                               // Position in the log, from 0 at boot
+    uint8_t level;                              // esp_log_level_t
+    uint8_t core;
+    uint8_t argc;
+    const char *tag;
+    const char *format;
+    int64_t time_us;                            // esp_timer_get_time() at the call
+    uint32_t args[EVENT_LOG_MAX_ARGS];
+} event_log_entry_t;
+
+/**
+ * @brief Record an event; the arguments are converted to uint32_t
+ */
+#define EVENT_LOG_LEVEL_LOCAL(level, tag, format, ...) do {                                     \
+        if ((level) <= EVENT_LOG_LEVEL) {                                                       \
+            const uint32_t event_args_[] = { 0, ##__VA_ARGS__ };                                \
+            _Static_assert(sizeof(event_args_) <= (EVENT_LOG_MAX_ARGS + 1) * sizeof(uint32_t),  \
+                           "Too many event log arguments");                                     \
+            event_log_record((level), (tag), (format), event_args_ + 1,                         \
+                             sizeof(event_args_) / sizeof(event_args_[0]) - 1);                 \
+        }                                                                                       \
+    } while (0)
+
+#define EVENT_LOGE(tag, format, ...) EVENT_LOG_LEVEL_LOCAL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define EVENT_LOGW(tag, format, ...) EVENT_LOG_LEVEL_LOCAL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define EVENT_LOGI(tag, format, ...) EVENT_LOG_LEVEL_LOCAL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define EVENT_LOGD(tag, format, ...) EVENT_LOG_LEVEL_LOCAL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+
+/**
+ * @brief Counters of the log
+ */
+typedef struct {
+    uint32_t recorded;                          // Events since boot; also the next seq
+    uint32_t drained;                           // Printed by the drain task
+    uint32_t overwritten;                       // Lost to the drain task before it got to them
+} event_log_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Record an event; use the EVENT_LOGx macros. From any task or ISR
+ *
+ * @param args argc values; more than EVENT_LOG_MAX_ARGS are dropped
+ */
+void event_log_record(esp_log_level_t level, const char *tag, const char *format, const uint32_t *args,
+                      size_t argc);
+
+/**
+ * @brief Start the UART drain task when EVENT_LOG_UART is set; recording works without it
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_NO_MEM
+ */
+esp_err_t event_log_start(void);
+
+/**
+ * @brief Read the event at a cursor and advance it
+ *
+ * @param cursor seq to read from; moved past the event, or to the oldest one kept if it was overwritten
+ * @param entry Receives the event
+ * @param lost Receives how many events were overwritten before the reader got to them; may be NULL
+ * @return true with an event, false when the cursor has caught up
+ */
+bool event_log_read(uint32_t *cursor, event_log_entry_t *entry, uint32_t *lost);
+
+/**
+ * @brief Format an event the way ESP_LOGx prints it, without colour or newline: "I (1234) TAG: text"
+ *
+ * @return size_t Characters written, excluding the terminator
+ */
+size_t event_log_format(const event_log_entry_t *entry, char *buf, size_t size);
+
+/**
+ * @brief Seq the next event will get
+ */
+uint32_t event_log_head(void);
+
+void event_log_get_stats(event_log_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVENT_LOG_H
@@ -0,0 +1,171 @@
+/**
+ * @file fault_inject.h
+ * @brief Controlled loss on the ESP-NOW and MQTT paths, for reliability benchmarks
+ *
+ * The reliable layer, the gateway's backpressure and the failover between
+ * gateways only show their worth on a bad link, and a bad link on the
+ * bench is hard to repeat. With FAULT_INJECT=1 ([env:faults]) two points
+ * in the pipeline draw one action per frame or message:
+ *
+ *   espnow_rx  Frames the link task takes off the receive ring, before the
+ *              receive handler: telemetry on the gateway, ACKs on a node
+ *   mqtt       Messages the gateway's forwarder hands to esp-mqtt
+ *
+ * and the actions are
+ *
+ *   drop       Never delivered; the MQTT forwarder counts it published
+ *   delay      Held up delay_ms. An ESP-NOW frame is set aside and
+ *              delivered from the link task once due, so frames behind it
+ *              overtake it (FAULT_INJECT_DELAY_SLOTS at a time); an MQTT
+ *              message holds up the forwarder task, and what follows it
+ *   duplicate  Delivered twice
+ *   reorder    Held back and delivered after the next one, or after
+ *              FAULT_INJECT_HOLD_MS if nothing follows
+ *
+ * Each point has its own probabilities, in permille; they start at the
+ * FAULT_INJECT_*_PERMILLE build values and fault_inject_set() changes
+ * them at run time (the gateway's MQTT cmd/fault, mqtt_cmd.h), so one
+ * image can sweep a loss curve. Counters per
+ * point and action are on /metrics as esp32_fault_injected_total. Set
+ * against the delivered samples and energy_bench.h's charge per run, they
+ * give goodput and energy per delivered sample at each loss rate.
+ *
+ * ESP-NOW itself never reorders or duplicates a frame, and the reliable
+ * layer relies on that to spot losses; those two actions exercise its
+ * duplicate check and its spurious resends.
+ *
+ * With FAULT_INJECT=0 FAULT_INJECT_DECIDE() is FAULT_INJECT_PASS, and the
+ * hooks compile away.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef FAULT_INJECT_H
+#define FAULT_INJECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifndef FAULT_INJECT
+#define FAULT_INJECT 0                          // 1: the hooks below draw faults; benchmarks only
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef FAULT_INJECT_DROP_PERMILLE
+#define FAULT_INJECT_DROP_PERMILLE 0            // Starting probabilities at every point
+#endif
+#ifndef FAULT_INJECT_DELAY_PERMILLE
+#define FAULT_INJECT_DELAY_PERMILLE 0
+#endif
+#ifndef FAULT_INJECT_DUPLICATE_PERMILLE
+#define FAULT_INJECT_DUPLICATE_PERMILLE 0
+#endif
+#ifndef FAULT_INJECT_REORDER_PERMILLE
+#define FAULT_INJECT_REORDER_PERMILLE 0
+#endif
+#ifndef FAULT_INJECT_DELAY_MS
+#define FAULT_INJECT_DELAY_MS 50                // How long a delayed frame or message is held up
+#endif
+#define FAULT_INJECT_HOLD_MS 200                // Longest a reordered frame waits for a successor
+#define FAULT_INJECT_DELAY_SLOTS 4              // ESP-NOW frames delayed at once; a delay drawn past them passes
+
+/**
+ * @brief Where faults are drawn
+ */
+typedef enum {
+    FAULT_INJECT_ESPNOW_RX,
+    FAULT_INJECT_MQTT,
+    FAULT_INJECT_POINT_COUNT
+} fault_inject_point_t;
+
+/**
+ * @brief What happens to one frame or message
+ */
+typedef enum {
+    FAULT_INJECT_PASS,
+    FAULT_INJECT_DROP,
+    FAULT_INJECT_DELAY,
+    FAULT_INJECT_DUPLICATE,
+    FAULT_INJECT_REORDER,
+    FAULT_INJECT_ACTION_COUNT
+} fault_inject_action_t;
+
+/**
+ * @brief Probabilities at one point; at most 1000 permille between them
+ */
+typedef struct {
+    uint16_t drop;                              // Permille
+    uint16_t delay;
+    uint16_t duplicate;
+    uint16_t reorder;
+    uint16_t delay_ms;
+} fault_inject_profile_t;
+
+#if FAULT_INJECT != 0
+#define FAULT_INJECT_DECIDE(point) fault_inject_decide(point)
+#else
+#define FAULT_INJECT_DECIDE(point) FAULT_INJECT_PASS
+#endif
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Load the build-time profile at every point and add the counters to /metrics;
+ *        does nothing with FAULT_INJECT=0
+ *
+ * @return esp_err_t ESP_OK
+ */
+esp_err_t fault_inject_init(void);
+
+/**
+ * @brief Replace the probabilities at one point
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG for an unknown point or more than 1000 permille,
+ *         or ESP_ERR_NOT_SUPPORTED with FAULT_INJECT=0
+ */
+esp_err_t fault_inject_set(fault_inject_point_t point, const fault_inject_profile_t *profile);
+
+/**
+ * @brief Look a point up by its name ("espnow_rx", "mqtt"), as on /metrics
+ *
+ * @return true with point set, false for an unknown name
+ */
+bool fault_inject_point_from_name(const char *name, fault_inject_point_t *point);
+
+/**
+ * @brief Copy the probabilities at one point
+ */
+void fault_inject_get(fault_inject_point_t point, fault_inject_profile_t *profile);
+
+/**
+ * @brief Draw the action for the next frame or message at a point, and count it; any task
+ */
+fault_inject_action_t fault_inject_decide(fault_inject_point_t point);
+
+/**
+ * @brief How long a delayed frame or message at a point is held up, ms
+ */
+uint32_t fault_inject_delay_ms(fault_inject_point_t point);
+
+/**
+ * @brief Actions drawn at a point since init
+ */
+uint32_t fault_inject_count(fault_inject_point_t point, fault_inject_action_t action);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FAULT_INJECT_H
@@ -0,0 +1,181 @@
+/**
+ * @file flash_backlog.h
+ * @brief Store-and-forward queue of telemetry records in a dedicated flash partition
+ *
+ * On a node: when the gateway stops acknowledging, the reliable window
+ * fills within a few frames. Records that no longer fit are paged out here
+ * instead of being dropped, and replayed oldest-first once ACKs come back.
+ * On the gateway: decoded records are spooled here while the MQTT broker
+ * or the uplink is down, and published from here once it is back. Each
+ * record carries the id of the node that took it.
+ *
+ * The partition is an append-only log of 32-byte records (a sector holds
+ * 128), laid out like metric_history: a record's slot is its queue seq
+ * modulo the capacity, and the head is found again at boot from the sector
+ * whose first record is newest. Records are buffered in RAM and written a
+ * sector's worth at a time; a sector is erased only when the log first
+ * enters it, so each one wears once per lap.
+ *
+ * The tail is kept in the log itself: when everything replayed so far has
+ * been acknowledged, the state byte of the last such record is cleared
+ * (flash can turn bits to 0 without an erase), and at boot the tail is the
+ * record after the newest cleared one. A power cut between an ACK and that
+ * write replays a few records twice, which the gateway sees as repeated
+ * sample seqs; nothing is lost. Needs plain (unencrypted) flash writes.
+ *
+ * When the log laps an unsent sector, its records are dropped, oldest first.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef FLASH_BACKLOG_H
+#define FLASH_BACKLOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define FLASH_BACKLOG_PARTITION "backlog"       // Label in partitions.csv
+#define FLASH_BACKLOG_BATCH 128                 // Records buffered per flash write (one 4 KB sector)
+
+/**
+ * @brief One record as stored in flash; 32 bytes
+ *
+ * qseq counts up for as long as the partition is in use and fixes the
+ * record's slot. state is outside the CRC so it can be cleared in place.
+ * Pressure and humidity take 24 bits (16.7 MPa, 16777 %RH) to make room
+ * for the node id.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t qseq;                              // Queue position
+    uint32_t node_id;                           // Node that took the sample
+    uint32_t seq;                               // Sample seq, as sent
+    uint32_t time_s;
+    uint32_t gas_resistance;
+    uint8_t pressure[3];                        // Pa, little-endian
+    uint8_t humidity[3];                        // 0.001 %RH, little-endian
+    int16_t temperature;
+    uint8_t flags;                              // Bit 0 gas_valid, bit 1 heat_stable, bits 2-5 heater_step, bit 6 held
+    uint16_t crc;                               // CRC-16 of the bytes before it
+    uint8_t state;                              // 0xFF queued; 0x00 delivered, with all before it
+} flash_backlog_record_t;
+
+/**
+ * @brief Queue state and counters since flash_backlog_init()
+ */
+typedef struct {
+    bool ready;
+    uint32_t capacity;                          // Records the partition holds
+    uint32_t queued;                            // Records not yet acknowledged
+    uint32_t unsent;                            // ... of which not yet handed on (reliable layer, or MQTT)
+    uint32_t buffered;                          // Records in RAM awaiting their flash write
+    uint32_t stored;                            // Records paged out
+    uint32_t replayed;                          // Records read back for sending
+    uint32_t dropped;                           // Unsent records overwritten when the log lapped them
+} flash_backlog_info_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Open the partition, find the head and tail, and save buffered records on esp_restart()
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND without the partition, ESP_ERR_INVALID_SIZE if it
+ *         is under two sectors, ESP_ERR_NO_MEM, or a flash error
+ */
+esp_err_t flash_backlog_init(void);
+
+/**
+ * @brief Append one record; written to flash when a sector's worth is buffered
+ *
+ * @param node_id Node that took the sample
+ * @param rec Sample
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE before init, or the flash write error
+ */
+esp_err_t flash_backlog_push(uint32_t node_id, const telemetry_record_t *rec);
+
+/**
+ * @brief Write buffered records now, e.g. before deep sleep
+ *
+ * A partial sector is written into its already-erased space, so this costs no extra erase.
+ */
+esp_err_t flash_backlog_flush(void);
+
+/**
+ * @brief Copy the oldest records not yet handed on, without consuming them
+ *
+ * @param records Receives the samples
+ * @param node_ids Receives the node of each sample; may be NULL
+ * @param max Room in both arrays
+ * @return Records copied, up to max
+ */
+size_t flash_backlog_peek(telemetry_record_t *records, uint32_t *node_ids, size_t max);
+
+/**
+ * @brief Mark the first count peeked records as handed on
+ */
+void flash_backlog_advance(size_t count);
+
+/**
+ * @brief Record that everything handed on so far was acknowledged; call when nothing is in flight
+ *
+ * @return esp_err_t ESP_OK (also when there was nothing to commit), or the flash write error
+ */
+esp_err_t flash_backlog_commit(void);
+
+/**
+ * @brief The queue position of the next record to be handed on, for flash_backlog_commit_to()
+ */
+uint32_t flash_backlog_position(void);
+
+/**
+ * @brief Record that every record before a position was acknowledged, while later ones are still in flight
+ *
+ * @param position From flash_backlog_position(); positions past those handed on are clamped to them
+ * @return esp_err_t ESP_OK (also when there was nothing to commit), or the flash write error
+ */
+esp_err_t flash_backlog_commit_to(uint32_t position);
+
+/**
+ * @brief Hand every unacknowledged record on again, from the tail
+ *
+ * For a consumer whose in-flight copies were lost (the gateway's MQTT
+ * outbox across a reset, or a message that expired in it).
+ */
+void flash_backlog_rewind(void);
+
+/**
+ * @brief Records not yet handed on; 0 before init
+ */
+uint32_t flash_backlog_unsent(void);
+
+/**
+ * @brief Records that can be pushed before the log laps unsent ones; 0 before init
+ *
+ * A sector is kept in hand, since entering a sector drops all it held.
+ */
+uint32_t flash_backlog_space(void);
+
+/**
+ * @brief Copy the queue state and counters
+ */
+void flash_backlog_get_info(flash_backlog_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLASH_BACKLOG_H
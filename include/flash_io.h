@@ -0,0 +1,207 @@
+/**
+ * @file flash_io.h
+ * @brief Counted and timed flash reads, writes and erases, per subsystem and per partition
+ *
+ * Modules that touch flash call these thin wrappers instead of
+ * esp_partition_*(), esp_ota_write() and nvs_set_blob()/nvs_commit(). Each
+ * call is counted with its bytes and timed into a latency histogram under
+ * the calling subsystem and the partition it hit, so a batching change
+ * shows up as fewer, larger operations rather than as a guess.
+ *
+ * Writes that do not go through a wrapper (the typed nvs_set_*() calls,
+ * files appended through the VFS) are accounted with flash_io_record() or,
+ * for NVS, flash_io_record_nvs() around the call. NVS writes are passed on
+ * to nvs_wear.h by key.
+ *
+ * The totals are the METRIC_FLASH_RW_OPERATIONS metric once
+ * flash_io_init() has run, and esp32_flash_io_* families on /metrics.
+ * bench_suite.c still uses the raw calls, so its benchmark traffic stays
+ * out of the counts.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef FLASH_IO_H
+#define FLASH_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define FLASH_IO_BUCKETS 8                      // Latency buckets; the last one is open-ended
+#define FLASH_IO_MAX_PARTITIONS 8               // Partitions counted separately; more share the last slot
+#define FLASH_IO_NVS_LABEL "nvs"                // Partition NVS calls are counted under
+
+/**
+ * @brief Who asked for the operation
+ */
+typedef enum {
+    FLASH_IO_NVS,                               // Settings, resume records, peer and slot tables
+    FLASH_IO_OTA,                               // Firmware and node images, resumed downloads
+    FLASH_IO_HISTORY,                           // metric_history ring
+    FLASH_IO_BACKLOG,                           // flash_backlog sample queue
+    FLASH_IO_FILES,                             // Files on the filesystem partitions (ts_store)
+    FLASH_IO_COREDUMP,                          // Core dump downloads
+    FLASH_IO_OTHER,                             // Formatting the log regions (long_op) and the rest
+    FLASH_IO_SUB_COUNT
+} flash_io_sub_t;
+
+/**
+ * @brief Kind of operation
+ */
+typedef enum {
+    FLASH_IO_READ,
+    FLASH_IO_WRITE,
+    FLASH_IO_ERASE,
+    FLASH_IO_COMMIT,                            // nvs_commit(); the NVS writes happen in nvs_set_*()
+    FLASH_IO_OP_COUNT
+} flash_io_op_t;
+
+/**
+ * @brief One subsystem's operations of one kind since boot
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t errors;                            // Calls that returned an error; counted and timed all the same
+    uint64_t bytes;
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t histogram[FLASH_IO_BUCKETS];       // Calls per latency bucket, see flash_io_bucket_us()
+} flash_io_stats_t;
+
+/**
+ * @brief Traffic to one partition since boot
+ */
+typedef struct {
+    char label[17];                             // As esp_partition_t.label; "other" for the overflow slot
+    uint32_t count[FLASH_IO_OP_COUNT];
+    uint64_t bytes[FLASH_IO_OP_COUNT];
+} flash_io_part_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Register the METRIC_FLASH_RW_OPERATIONS provider
+ *
+ * The wrappers count from the first call; this only makes the totals
+ * visible through SystemMetrics. Call after system_metrics_init().
+ */
+void flash_io_init(void);
+
+/**
+ * @brief esp_partition_read(), counted
+ */
+esp_err_t flash_io_read(flash_io_sub_t sub, const esp_partition_t *part, size_t offset, void *dst, size_t len);
+
+/**
+ * @brief esp_partition_write(), counted
+ */
+esp_err_t flash_io_write(flash_io_sub_t sub, const esp_partition_t *part, size_t offset, const void *src,
+                         size_t len);
+
+/**
+ * @brief esp_partition_erase_range(), counted
+ */
+esp_err_t flash_io_erase(flash_io_sub_t sub, const esp_partition_t *part, size_t offset, size_t len);
+
+/**
+ * @brief esp_ota_write(), counted as an OTA write to part
+ *
+ * The sector erases esp_ota_write() does as it goes are part of the
+ * write's time, not separate erases.
+ *
+ * @param part Partition the handle writes to, for the per-partition count
+ */
+esp_err_t flash_io_ota_write(const esp_partition_t *part, esp_ota_handle_t handle, const void *data, size_t len);
+
+/**
+ * @brief esp_ota_write_with_offset(), counted as an OTA write to part
+ */
+esp_err_t flash_io_ota_write_at(const esp_partition_t *part, esp_ota_handle_t handle, const void *data,
+                                size_t len, uint32_t offset);
+
+/**
+ * @brief nvs_set_blob(), counted as an NVS write
+ */
+esp_err_t flash_io_nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t len);
+
+/**
+ * @brief nvs_commit(), counted as an NVS commit
+ */
+esp_err_t flash_io_nvs_commit(nvs_handle_t handle);
+
+/**
+ * @brief Account an operation made without a wrapper
+ *
+ * @param sub Calling subsystem
+ * @param op Kind of operation
+ * @param label Partition label, or NULL to count it for the subsystem only
+ * @param bytes Bytes read or written
+ * @param start_us esp_timer_get_time() before the call
+ * @param err What the call returned
+ */
+void flash_io_record(flash_io_sub_t sub, flash_io_op_t op, const char *label, size_t bytes, int64_t start_us,
+                     esp_err_t err);
+
+/**
+ * @brief Account an NVS write made without a wrapper, and note it for nvs_wear
+ *
+ * @param key Key written
+ * @param bytes Size of the value
+ * @param start_us esp_timer_get_time() before the call
+ * @param err What the call returned
+ */
+void flash_io_record_nvs(const char *key, size_t bytes, int64_t start_us, esp_err_t err);
+
+/**
+ * @brief Copy one subsystem's counters for one kind of operation
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG for a bad subsystem or kind
+ */
+esp_err_t flash_io_get(flash_io_sub_t sub, flash_io_op_t op, flash_io_stats_t *out);
+
+/**
+ * @brief Copy the per-partition counters
+ *
+ * @param out Array of at least FLASH_IO_MAX_PARTITIONS
+ * @param max Its length
+ * @return Partitions copied
+ */
+size_t flash_io_get_partitions(flash_io_part_stats_t *out, size_t max);
+
+/**
+ * @brief Upper bound of a latency bucket in microseconds, 0 for the open-ended last one
+ */
+uint32_t flash_io_bucket_us(size_t bucket);
+
+/**
+ * @brief Name of a subsystem as used in metrics labels
+ */
+const char *flash_io_sub_name(flash_io_sub_t sub);
+
+/**
+ * @brief Name of a kind of operation as used in metrics labels
+ */
+const char *flash_io_op_name(flash_io_op_t op);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLASH_IO_H
@@ -0,0 +1,128 @@
+/**
+ * @file frame_capture.h
+ * @brief Raw ESP-NOW traffic captured to the SD card, and captures replayed through the gateway
+ *
+ * Capture (GATEWAY_CAPTURE=1): every frame the gateway's receive handler
+ * gets is copied, with its sender, RSSI and arrival time, into a byte
+ * ring the link task never waits on. A writer task just above idle
+ * appends the ring to SD_ARCHIVE_MOUNT/CAPnnnnn.WXC through a
+ * FRAME_CAPTURE_BUF_BYTES stdio buffer, so the card sees whole-sector
+ * sequential writes, and syncs every SD_ARCHIVE_SYNC_MS. Each boot starts
+ * the next file number; a file past FRAME_CAPTURE_FILE_MAX is closed and
+ * the next one opened. Frames the ring has no room for are counted and
+ * lost. The file format (header, then a record ahead of each frame) is
+ * in capture_file.h.
+ *
+ * Replay (GATEWAY_REPLAY=1): at boot a task reads a capture and hands
+ * each frame to espnow_link_inject(), so it takes the same path as one
+ * off the radio: the reliable layer's duplicate check, decode, the record
+ * ring, aggregation and the sink. At speed 0 the next frame goes in as
+ * soon as the previous one was handled and the room callback says the
+ * pipeline can take a full frame, so the run measures how fast the
+ * pipeline drains real traffic; at speed n the frames keep their
+ * recorded spacing, n times faster. The end of a run logs the frames,
+ * time taken and rate.
+ *
+ * Replayed frames carry the captured nodes' MACs, and the gateway answers
+ * them (ACKs, slot grants) as it would the nodes; run replays on a bench
+ * gateway without those nodes in range. Nothing is captured during a replay.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "capture_file.h"
+#include "esp_err.h"
+#include "sd_archive.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define FRAME_CAPTURE_EXT ".WXC"
+#define FRAME_CAPTURE_RING_BYTES 8192           // Frames waiting for the writer (~30 full frames)
+#define FRAME_CAPTURE_BUF_BYTES 4096            // stdio buffer; a multiple of SD_ARCHIVE_SECTOR
+#define FRAME_CAPTURE_FILE_MAX (16u * 1024 * 1024) // Bytes per file before the next one is opened
+#define FRAME_CAPTURE_MAX_FILES 99999
+#define FRAME_CAPTURE_INJECT_WAIT_MS 1000       // Replay: longest to wait for the link task's queue
+
+/**
+ * @brief Replay: whether the pipeline can take another frame now (a full frame's records)
+ */
+typedef bool (*frame_capture_room_t)(void);
+
+/**
+ * @brief Counters since boot
+ */
+typedef struct {
+    bool capturing;
+    uint32_t frames;                            // Frames written to the card
+    uint32_t bytes;                             // Bytes written, headers included
+    uint32_t dropped;                           // Frames lost to a full ring
+    uint32_t errors;                            // Failed opens, writes and syncs
+    uint32_t files;
+    bool replaying;
+    uint32_t replayed;                          // Frames handed to the link task
+    uint32_t replay_ms;                         // Time the last (or current) replay has taken
+} frame_capture_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Open the next capture file and start the writer task; the card must be mounted (sd_archive.h)
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE without a card, ESP_ERR_NO_MEM, or ESP_FAIL if no file opens
+ */
+esp_err_t frame_capture_start(void);
+
+/**
+ * @brief Write out what is queued, stop the writer task and close the file
+ */
+void frame_capture_stop(void);
+
+/**
+ * @brief Queue one received frame; link task only, never blocks
+ */
+void frame_capture_add(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+
+/**
+ * @brief Start replaying a capture through the ESP-NOW link's receive path
+ *
+ * @param path Capture file, or NULL for the newest one on the card
+ * @param speed 0: as fast as the pipeline takes it; n: n times the recorded pace
+ * @param room Asked before each frame at speed 0 (may be NULL)
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND, ESP_ERR_INVALID_STATE if one is running, or ESP_ERR_NO_MEM
+ */
+esp_err_t frame_capture_replay_start(const char *path, uint32_t speed, frame_capture_room_t room);
+
+/**
+ * @brief Path of capture file n
+ *
+ * @param path Output, SD_ARCHIVE_PATH_LEN bytes
+ */
+void frame_capture_path(char *path, uint32_t n);
+
+/**
+ * @brief Copy the counters
+ */
+void frame_capture_get_stats(frame_capture_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FRAME_CAPTURE_H
@@ -18,6 +18,129 @@
 extern "C" {
 #endif
 
+// =============================
+// Constants & Definitions
+// =============================
+// Receive pipeline: link task (decode, dedupe) -> record ring -> forwarder (gateway_main), and
+// -> sample bus (sample_bus.h) -> aggregates/history/alarms, NMEA 0183, NMEA 2000, Signal K
+#define GATEWAY_RECORD_SLOTS 512                // Decoded records awaiting the forwarder; power of two (16 KB)
+#define GATEWAY_OBSERVE_DEPTH 96                // Bus records the forwarder may fall behind on before dropping
+#define GATEWAY_FORWARD_BATCH 32                // Records copied out of the ring per forwarder step
+#define GATEWAY_RETRY_INTERVAL_MS 1000          // Re-check while records are stuck in the ring
+#define GATEWAY_STATS_INTERVAL_MS 60000         // How often gateway_main() logs the pipeline counters
+#define GATEWAY_HOLD_MS 10000                   // Backoff sent in ESP-NOW ACKs while the spool is full
+// Alarm lane: frames with a TELEMETRY_REC_URGENT record skip the record ring, the spool and the MQTT batches
+#define GATEWAY_ALARM_SLOTS 32                  // Alarm records awaiting the forwarder; power of two
+#define GATEWAY_ALARM_TARGET_MS 1000            // Receive-to-publish time beyond which an alarm counts as late
+
+// Navigation instrument output (see nmea.h); wind only from sensors wired to this board
+#ifndef GATEWAY_NMEA
+#define GATEWAY_NMEA 0                          // 1: emit NMEA 0183 sentences; build with -D GATEWAY_NMEA=1
+#endif
+#ifndef GATEWAY_WIND
+#define GATEWAY_WIND 0                          // 1: run the wind module here, for $WIMWV and the MDA wind fields
+#endif
+// Heel and mast motion for the wind correction (see motion.h), from an IMU on this board's I2C bus
+#ifndef GATEWAY_MOTION
+#define GATEWAY_MOTION 0                        // 1: with GATEWAY_WIND, run the motion module; build with -D GATEWAY_MOTION=1
+#endif
+// GPS on its own UART (see gps.h), for true wind, NMEA 2000 position and the clock without an uplink
+#ifndef GATEWAY_GPS
+#define GATEWAY_GPS 0                           // 1: read a GPS on GPS_UART_RX_GPIO; build with -D GATEWAY_GPS=1
+#endif
+// Bridge uplink radio (see wifi_set_profile()): modem sleep drops ESP-NOW frames sent while it is off
+#ifndef GATEWAY_WIFI_LOW_POWER
+#define GATEWAY_WIFI_LOW_POWER 0                // 1: low-power uplink, for battery gateways with few, retrying nodes
+#endif
+#define GATEWAY_I2C_PORT 0
+#define GATEWAY_I2C_SDA_GPIO 21
+#define GATEWAY_I2C_SCL_GPIO 22
+// Window aggregates (see aggregator.h), published on <base>/<node id>/aggregate
+#ifndef GATEWAY_AGGREGATE
+#define GATEWAY_AGGREGATE 1                     // 0: no aggregation
+#endif
+#ifndef GATEWAY_RAW_SAMPLES
+#define GATEWAY_RAW_SAMPLES 1                   // 0: aggregates only; records are not published or spooled
+#endif
+#define GATEWAY_WIND_SAMPLE_MS 3000             // Local wind speed into the aggregator this often (WIND_GUST_S mean)
+
+// Pressure trend per node (see pressure_trend.h); alarm changes go to MQTT and /ws/metrics at once
+#ifndef GATEWAY_PRESSURE_ALERTS
+#define GATEWAY_PRESSURE_ALERTS 1               // 0: no trend tracking on the gateway
+#endif
+#define GATEWAY_TREND_NODES 8                   // Nodes tracked (about 900 bytes each)
+
+// Local history on SPIFFS (see ts_store.h), for /api/history?metric= while the uplink is down
+#ifndef GATEWAY_HISTORY
+#define GATEWAY_HISTORY 1                       // 0: no on-gateway time-series store
+#endif
+
+// Raw archive of every record on an SD card (see sd_archive.h), in daily binary files
+#ifndef GATEWAY_SD_ARCHIVE
+#define GATEWAY_SD_ARCHIVE 0                    // 1: mount the card and archive; build with -D GATEWAY_SD_ARCHIVE=1
+#endif
+
+// The flash spool as the MQTT outbox: every record is spooled before it is published, and released only
+// once the broker confirmed it, so a reset loses nothing that was in flight (see mqtt_forwarder.h)
+#ifndef GATEWAY_MQTT_OUTBOX
+#define GATEWAY_MQTT_OUTBOX 1                   // 0: records bypass the spool while the broker is up
+#endif
+#define GATEWAY_OUTBOX_CHECKPOINT_MS 10000      // Batched formats: open batches are sent this often to release the spool
+
+// Remote control over MQTT: settings, OTA checks, metric snapshots, log levels and node settings (see mqtt_cmd.h)
+#ifndef GATEWAY_MQTT_CMD
+#define GATEWAY_MQTT_CMD 1                      // 0: no <base>/cmd/# subscription
+#endif
+// Home Assistant discovery configs for each node sensor, retained, sent when it first appears (see ha_discovery.h)
+#ifndef GATEWAY_HA_DISCOVERY
+#define GATEWAY_HA_DISCOVERY 1                  // 0: no discovery messages
+#endif
+
+// Raw ESP-NOW frames captured to the SD card, and captures replayed through the pipeline (see frame_capture.h);
+// both need GATEWAY_SD_ARCHIVE
+#ifndef GATEWAY_CAPTURE
+#define GATEWAY_CAPTURE 0                       // 1: capture every received frame; build with -D GATEWAY_CAPTURE=1
+#endif
+#ifndef GATEWAY_REPLAY
+#define GATEWAY_REPLAY 0                        // 1: at boot, replay the newest capture (or GATEWAY_REPLAY_FILE)
+#endif
+#ifndef GATEWAY_REPLAY_SPEED
+#define GATEWAY_REPLAY_SPEED 0                  // 0: as fast as the pipeline takes it; n: n times the recorded pace
+#endif
+
+// Signal K deltas for chartplotter apps and Node-RED (see signalk.h), on the web server's port
+#ifndef GATEWAY_SIGNALK
+#define GATEWAY_SIGNALK 1                       // 0: no /signalk endpoints
+#endif
+// Every accepted telemetry frame as one UDP multicast datagram on the uplink LAN (see telemetry_mcast.h)
+#ifndef GATEWAY_MULTICAST
+#define GATEWAY_MULTICAST 0                     // 1: send them; build with -D GATEWAY_MULTICAST=1
+#endif
+// Log output copied to a syslog collector on the uplink LAN over UDP (see syslog_sink.h)
+#ifndef GATEWAY_SYSLOG
+#define GATEWAY_SYSLOG 0                        // 1: send it to SYSLOG_HOST; build with -D GATEWAY_SYSLOG=1
+#endif
+// Raw records to InfluxDB in line-protocol batches instead of MQTT (see influx_writer.h)
+#ifndef GATEWAY_INFLUX
+#define GATEWAY_INFLUX 0                        // 1: MQTT keeps aggregates, alerts and node config
+#endif
+// Gateway and node firmware pulled from a manifest over the bridge uplink (see ota_pull.h)
+#ifndef GATEWAY_OTA_PULL
+#define GATEWAY_OTA_PULL 0                      // 1: check OTA_PULL_MANIFEST_URL; build with -D GATEWAY_OTA_PULL=1
+#endif
+// One node's current readings as BTHome BLE advertisements for phones nearby (see ble_beacon.h)
+#ifndef GATEWAY_BLE_BEACON
+#define GATEWAY_BLE_BEACON 0                    // 1: advertise; needs NimBLE, so build [env:ble]
+#endif
+#ifndef GATEWAY_N2K
+#define GATEWAY_N2K 0                           // 1: publish NMEA 2000 PGNs on the TWAI controller (see n2k.h)
+#endif
+
+// Node transmit slots (see espnow_slot.h); slots are always handed out, sleeping between them is optional
+#ifndef GATEWAY_SLOT_SLEEP
+#define GATEWAY_SLOT_SLEEP 0                    // 1: light-sleep outside the slot windows (duty-cycled nodes, no uplink)
+#endif
+
 /**
  * @brief Initialize gateway mode
  *
@@ -29,14 +152,30 @@ extern "C" {
 esp_err_t gateway_init(void);
 
 /**
- * @brief Main gateway processing loop
+ * @brief Forwarder: wait for work, then one pass over the decoded records
  *
- * This function contains the main gateway logic for receiving data
- * from nodes and forwarding it via MQTT. This function should be
- * called from the main application loop.
+ * Sleeps until a frame is queued, the broker connection changes, the MQTT
+ * window gets room, or the next timed job (an MQTT batch window, the stats
+ * log) is due, then forwards everything waiting that MQTT or the spool can
+ * take. Call it in a loop from the main application task, which is then
+ * the record ring's only consumer.
  */
 void gateway_main(void);
 
+/**
+ * @brief Decode one telemetry frame received from a node and queue its records for the forwarder
+ *
+ * Runs in the link task, the record ring's only producer. A frame is
+ * queued whole or not at all.
+ *
+ * @param mac Sending node, for its node_table entry
+ * @param data Frame as received
+ * @param len Frame length
+ * @return esp_err_t ESP_OK, the telemetry_decode_header() error for a malformed frame, or
+ *         ESP_ERR_NO_MEM when the forwarder is behind (a reliable frame is then resent later)
+ */
+esp_err_t gateway_handle_telemetry(const uint8_t *mac, const uint8_t *data, size_t len);
+
 /**
  * @brief Cleanup gateway resources
  *
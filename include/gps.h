@@ -0,0 +1,137 @@
+/**
+ * @file gps.h
+ * @brief GPS input on its own UART: event-driven reads and an incremental NMEA 0183 tokenizer
+ *
+ * True wind needs speed and course over ground, and a gateway without an
+ * uplink needs a clock. The GPS talks on GPS_UART_NUM's RX pin. The UART
+ * driver's interrupt moves the bytes from the hardware FIFO into a
+ * GPS_UART_RX_BUFFER ring buffer (about a second of input at
+ * GPS_UART_BAUD) and posts an event to the driver's queue; the gps task
+ * on the application core sleeps on that queue, so it wakes a few times
+ * per GPS epoch and never polls.
+ *
+ * The task reads what is buffered into a small chunk and feeds it to the
+ * tokenizer a byte at a time. The tokenizer keeps no line buffer and calls
+ * no scanf: it XORs the checksum, splits fields and accumulates each one
+ * straight into a fixed-point value as the bytes go by, in one pass. The
+ * values of a sentence are held aside and merged into the fix only when
+ * its two checksum digits match. It takes, from any talker:
+ *
+ *   RMC   time, date, status, position, speed and course over ground
+ *   GGA   time, position, fix quality, satellites, HDOP, altitude
+ *   VTG   course and speed over ground
+ *
+ * Everything else is checked and skipped. Each pass that changed the fix
+ * publishes it on the sample bus (SAMPLE_TOPIC_POSITION, sample_bus.h),
+ * so a 10 Hz receiver reaches its subscribers within one UART timeout of
+ * each epoch; gps_get_fix() copies the latest for callers that only want
+ * the newest value.
+ *
+ * While the system clock has never been set (no SNTP yet), the first RMC
+ * with a fix sets it from the GPS time (GPS_SET_CLOCK).
+ *
+ * The task times its tokenizer, and gps_get_stats() reports it as a share
+ * of the core: tens of parts per million at 10 Hz.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef GPS_H
+#define GPS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define GPS_UART_NUM 1
+#define GPS_UART_RX_GPIO 16                     // From the GPS's TX
+#define GPS_UART_BAUD 38400                     // RMC, GGA and VTG at 10 Hz need about 20000
+#define GPS_UART_RX_BUFFER 4096                 // Driver ring buffer: about 1 s at GPS_UART_BAUD
+#define GPS_UART_EVENT_DEPTH 16                 // Driver event queue
+#define GPS_READ_CHUNK 128                      // Bytes taken from the ring buffer per read
+#define GPS_SENTENCE_MAX 82                     // Including '$' and CR LF; longer input is dropped
+#define GPS_FIX_STALE_MS 5000                   // A fix older than this is not valid
+#define GPS_WAIT_MS 500                         // Longest wait for an event, so a stop is noticed
+#define GPS_STOP_TIMEOUT_MS 1000
+
+#ifndef GPS_SET_CLOCK
+#define GPS_SET_CLOCK 1                         // 0: never set the system clock from the GPS
+#endif
+
+/**
+ * @brief Latest fix, merged from RMC, GGA and VTG
+ */
+typedef struct {
+    bool valid;                                 // Position from a sentence with a fix, and fresh (gps_get_fix())
+    uint8_t quality;                            // GGA fix quality (1 GPS, 2 DGPS, ...); 0 before a GGA
+    uint8_t satellites;                         // In use, from GGA
+    uint16_t hdop;                              // 0.01, from GGA; 0 unknown
+    int32_t lat;                                // 1e-7 deg, north positive
+    int32_t lon;                                // 1e-7 deg, east positive
+    int32_t altitude;                           // 0.1 m above mean sea level, from GGA
+    uint16_t sog;                               // 0.01 m/s
+    int16_t cog;                                // 0.1 deg true, -1 when the GPS left it empty
+    int64_t utc_ms;                             // Unix ms of the fix; 0 until an RMC gave the date
+    int64_t time_us;                            // esp_timer time of the sentence that last changed it
+} gps_fix_t;
+
+/**
+ * @brief Input counters since gps_start()
+ */
+typedef struct {
+    bool running;
+    uint32_t bytes;
+    uint32_t sentences;                         // RMC, GGA and VTG with a good checksum
+    uint32_t skipped;                           // Other sentences with a good checksum
+    uint32_t checksum_errors;
+    uint32_t malformed;                         // No checksum, too long, or a field that is not a number
+    uint32_t overruns;                          // FIFO overflows and full ring buffers: input lost
+    uint32_t published;                         // Fixes put on the sample bus
+    uint32_t clock_sets;
+    uint32_t load_ppm;                          // Tokenizer time as a share of the elapsed time, parts per million
+} gps_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Install the UART driver with its event queue and start the gps task
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if already running, ESP_ERR_NO_MEM, or the driver error
+ */
+esp_err_t gps_start(void);
+
+/**
+ * @brief Copy the latest fix
+ *
+ * @return bool Its valid flag: false without a position in the last GPS_FIX_STALE_MS
+ */
+bool gps_get_fix(gps_fix_t *fix);
+
+/**
+ * @brief Copy the counters
+ */
+void gps_get_stats(gps_stats_t *stats);
+
+/**
+ * @brief Stop the task and remove the UART driver
+ */
+void gps_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GPS_H
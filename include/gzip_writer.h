@@ -0,0 +1,130 @@
+/**
+ * @file gzip_writer.h
+ * @brief Small gzip (RFC 1952) compressor: greedy LZ77 and the fixed Huffman codes
+ *
+ * Compresses a whole buffer in one call, for HTTP bodies sent with
+ * "Content-Encoding: gzip". Matches come from a single-entry hash of the
+ * next three bytes and are taken greedily; the codes are DEFLATE's fixed
+ * ones, so there are no tables to build or send. That gives up some ratio
+ * against zlib, but text made of repeated keys (line protocol, JSON)
+ * still shrinks several times. The only state is the caller's
+ * gzip_work_t, 8 KB, instead of the ~150 KB miniz's compressor needs.
+ *
+ * gzip_stream_t does the same for a body of any length that is produced a
+ * piece at a time, such as an export: input goes through a window of
+ * 2 * GZIP_STREAM_WINDOW bytes, whose older half is the history matches
+ * reach back into, and the compressed bytes leave through a sink every
+ * GZIP_STREAM_OUT bytes. The body is one fixed-code block, so nothing has
+ * to be held back for a block header, and the whole state is about 9 KB
+ * however long the body runs.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef GZIP_WRITER_H
+#define GZIP_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define GZIP_HASH_BITS 12
+#define GZIP_INPUT_MAX 65534                    // Longest input; positions are kept in 16 bits
+#define GZIP_OVERHEAD 18                        // Header and trailer bytes around the DEFLATE stream
+
+#define GZIP_STREAM_WINDOW 2048                 // Streaming: history a match can reach, and input taken per pass
+#define GZIP_STREAM_HASH_BITS 11
+#define GZIP_STREAM_OUT 512                     // Streaming: compressed bytes per sink call
+
+/**
+ * @brief Match finder state; one per concurrent caller, contents need not be initialised
+ */
+typedef struct {
+    uint16_t head[1 << GZIP_HASH_BITS];         // Position + 1 of the last occurrence of each hash, 0: none
+} gzip_work_t;
+
+/**
+ * @brief Sink for a stream's compressed bytes; (NULL, 0) once the member is complete
+ *
+ * The same shape as json_flush_fn_t, so an httpd chunk sender serves both.
+ */
+typedef esp_err_t (*gzip_sink_fn_t)(void *ctx, const char *data, size_t len);
+
+/**
+ * @brief Streaming compressor; one per response, set up by gzip_stream_init()
+ */
+typedef struct {
+    uint8_t in[2 * GZIP_STREAM_WINDOW];         // History, then input not yet encoded
+    uint16_t head[1 << GZIP_STREAM_HASH_BITS];  // Position in in + 1 of the last occurrence of each hash, 0: none
+    uint8_t out[GZIP_STREAM_OUT];
+    size_t fill;                                // Bytes in in
+    size_t pos;                                 // Next byte of in to encode
+    size_t out_len;                             // Bytes in out
+    uint32_t bits;                              // Bits not yet a whole byte
+    uint8_t count;
+    uint32_t crc;                               // Of the input so far
+    uint32_t total;                             // Input bytes, modulo 2^32 as the trailer has it
+    uint32_t sent;                              // Compressed bytes handed to the sink
+    gzip_sink_fn_t sink;
+    void *ctx;
+    esp_err_t err;                              // First sink error; later calls do nothing
+} gzip_stream_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Compress in into a complete gzip member
+ *
+ * @param work Scratch state
+ * @param in Input
+ * @param len Its length, at most GZIP_INPUT_MAX
+ * @param out Output buffer
+ * @param cap Its size
+ * @param out_len Compressed length, set on success
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG if len is too long, or
+ *         ESP_ERR_INVALID_SIZE if the output did not fit (incompressible input
+ *         grows by up to an eighth)
+ */
+esp_err_t gzip_compress(gzip_work_t *work, const uint8_t *in, size_t len, uint8_t *out, size_t cap,
+                        size_t *out_len);
+
+/**
+ * @brief Start a stream: the gzip header and the block header, sent with the first full output
+ *
+ * @param gz Stream to initialise
+ * @param sink Where the compressed bytes go
+ * @param ctx Passed through to sink
+ */
+void gzip_stream_init(gzip_stream_t *gz, gzip_sink_fn_t sink, void *ctx);
+
+/**
+ * @brief Compress len more bytes of the body
+ *
+ * @return esp_err_t ESP_OK, or the sink's first error
+ */
+esp_err_t gzip_stream_write(gzip_stream_t *gz, const void *data, size_t len);
+
+/**
+ * @brief Encode what is left, send the trailer, then call the sink with (NULL, 0)
+ *
+ * @return esp_err_t ESP_OK, or the sink's first error
+ */
+esp_err_t gzip_stream_finish(gzip_stream_t *gz);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GZIP_WRITER_H
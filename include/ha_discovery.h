@@ -0,0 +1,92 @@
+/**
+ * @file ha_discovery.h
+ * @brief Home Assistant MQTT discovery: one retained config per node sensor, published when it first appears
+ *
+ * Home Assistant builds its entities from config messages on
+ * <HA_DISCOVERY_PREFIX>/sensor/wx_<node id>/<key>/config. Sending them
+ * again every few minutes would outweigh the readings themselves, so each
+ * is sent once per boot, retained (the broker hands it to Home Assistant
+ * whenever it restarts), when the node table (node_table.h) first shows
+ * the node reporting that sensor. node_table_generation() only changes
+ * when a node or a sensor is new, so in steady state a poll costs one
+ * comparison and MQTT carries only the readings.
+ *
+ * The entities follow the record topics: per-metric topics in
+ * MQTT_FORMAT_FIELDS, the last sample of each batch column (scaled by a
+ * value template) in MQTT_FORMAT_JSON. Home Assistant cannot read CBOR,
+ * so there is no discovery in MQTT_FORMAT_CBOR. Names, units, device
+ * classes and scales come from sensor_quantity_info() (sensor_hal.h);
+ * each node is one device.
+ *
+ * A config the window has no room for waits for the next poll, at most
+ * HA_DISCOVERY_RETRY_MS later.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef HA_DISCOVERY_H
+#define HA_DISCOVERY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "mqtt_forwarder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef HA_DISCOVERY_PREFIX
+#define HA_DISCOVERY_PREFIX "homeassistant"     // Home Assistant's discovery_prefix
+#endif
+#define HA_DISCOVERY_NODES MQTT_FORWARDER_NODES // Nodes announced
+#define HA_DISCOVERY_RETRY_MS 1000              // Next poll while configs are waiting
+#define HA_DISCOVERY_PAYLOAD_MAX 640            // One config message
+
+/**
+ * @brief Counters since ha_discovery_start()
+ */
+typedef struct {
+    uint32_t nodes;                             // Nodes with at least one config sent
+    uint32_t configs;                           // Config messages sent
+    uint32_t deferred;                          // Polls that left configs for later (no room, refused)
+} ha_discovery_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Start announcing, with the stored base topic and MQTT format
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_SUPPORTED in MQTT_FORMAT_CBOR, or the nvs_config_get() error
+ */
+esp_err_t ha_discovery_start(void);
+
+/**
+ * @brief Send the configs of nodes and sensors that appeared since the last poll; forwarder task
+ */
+void ha_discovery_poll(void);
+
+/**
+ * @brief Milliseconds until ha_discovery_poll() has work: HA_DISCOVERY_RETRY_MS with configs waiting, else UINT32_MAX
+ */
+uint32_t ha_discovery_poll_due_ms(void);
+
+/**
+ * @brief Copy the counters
+ */
+void ha_discovery_get_stats(ha_discovery_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HA_DISCOVERY_H
@@ -0,0 +1,108 @@
+/**
+ * @file health_watch.h
+ * @brief Threshold alarms on the firmware's own metrics: low heap, heat, a sagging supply, a shrinking stack
+ *
+ * SystemMetrics answers when asked; nothing asks when nobody is looking.
+ * The watcher task checks a table of rules, each a metric, a direction
+ * and two thresholds:
+ *
+ *   heap_low      METRIC_FREE_HEAP below 20 KB, clears above 32 KB
+ *   heap_floor    METRIC_MIN_FREE_HEAP below 12 KB; a low-water mark, so it stays raised until reboot
+ *   heap_block    METRIC_HEAP_LARGEST_BLOCK below 8 KB (a TLS handshake needs more), clears above 12 KB
+ *   hot           METRIC_CPU_TEMPERATURE above 85 degC, clears below 75
+ *   vdd_sag       METRIC_VDD33_VOLTAGE below 3.0 V, clears above 3.1 V
+ *   stack_low     Least free stack of any task (cpu_monitor.h) below 512 bytes, clears above 768
+ *   nvs_wear      NVS partition projected to wear out (nvs_wear.h) within NVS_WEAR_DEPLOYMENT_DAYS,
+ *                 clears 10% above it
+ *
+ * Each rule is read at its metric's cache TTL (get_metric_ttl_ms()), no
+ * faster than HEALTH_WATCH_MIN_PERIOD_MS; uncached metrics every
+ * HEALTH_WATCH_PERIOD_MS. Values are compared as integers, a float metric
+ * scaled first (volts to millivolts). The gap between the two thresholds
+ * is the hysteresis: a value wandering around one of them raises the
+ * alarm once.
+ *
+ * A rule whose metric this chip does not have (the classic ESP32 has no
+ * temperature sensor) is dropped at its first read. Metrics that are only
+ * unavailable for now are read again next time.
+ *
+ * Every raise and clear goes to the event log, to the live web stream as
+ * a "health" event and, when the gateway has set a publisher, to MQTT on
+ * <mqtt_base_topic>/<gateway>/health:
+ *
+ *   {"rule":"heap_low","state":"raised","value":18432,"limit":20480,"unit":"bytes"}
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef HEALTH_WATCH_H
+#define HEALTH_WATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define HEALTH_WATCH_PERIOD_MS 5000             // Rules on metrics without a cache TTL
+#define HEALTH_WATCH_MIN_PERIOD_MS 2000         // Fastest any rule is read
+#define HEALTH_WATCH_JSON_MAX 128               // Longest alarm message
+
+/**
+ * @brief Counters since health_watch_start()
+ */
+typedef struct {
+    bool running;
+    uint8_t rules;                              // Rules watched; unsupported ones are not counted
+    uint8_t active;                             // Alarms raised now
+    uint32_t raised;
+    uint32_t cleared;
+    uint32_t reads;                             // Metric reads
+} health_watch_stats_t;
+
+/**
+ * @brief Sends an alarm change on; called from the watcher task
+ *
+ * @param json Alarm message, not terminated
+ * @param len Its length
+ */
+typedef void (*health_watch_publish_fn_t)(const char *json, size_t len);
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Start the watcher task
+ *
+ * Call after system_metrics_init(), and after cpu_monitor_start() for the stack rule.
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if already running, ESP_ERR_NO_MEM
+ */
+esp_err_t health_watch_start(void);
+
+/**
+ * @brief Send alarm changes to publish as well, e.g. MQTT; NULL stops it
+ */
+void health_watch_set_publisher(health_watch_publish_fn_t publish);
+
+/**
+ * @brief Copy the counters
+ */
+void health_watch_get_stats(health_watch_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HEALTH_WATCH_H
@@ -0,0 +1,128 @@
+/**
+ * @file heap_monitor.h
+ * @brief Heap fragmentation per memory capability and allocation counts per task
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define HEAP_MONITOR_MAX_CAPS 4                 // Capability classes reported
+#define HEAP_MONITOR_MAX_TASKS 24               // Tasks tracked by the allocation hooks
+
+/**
+ * @brief Heap state of one memory capability class
+ */
+typedef struct {
+    const char *name;                           // "internal", "dma", "8bit", "spiram"
+    uint32_t caps;                              // MALLOC_CAP_* mask queried
+    size_t total_bytes;
+    size_t free_bytes;
+    size_t largest_free_block;
+    size_t minimum_free_bytes;                  // Low-water mark since boot
+    size_t allocated_blocks;
+    size_t free_blocks;
+    float fragmentation;                        // Percent of free bytes outside the largest block
+} heap_caps_stats_t;
+
+/**
+ * @brief Allocation activity of one task since heap_monitor_start() or the last reset
+ *
+ * Frees are billed to the task that frees, which for buffers handed between
+ * tasks is not the one that allocated.
+ */
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t allocs;
+    uint32_t frees;
+    uint64_t bytes_allocated;                   // Sum of requested sizes
+    uint32_t largest_alloc;
+} heap_task_stats_t;
+
+/**
+ * @brief Allocations the heap could not satisfy
+ */
+typedef struct {
+    uint32_t count;
+    size_t last_size;
+    uint32_t last_caps;
+    int64_t last_time_us;                       // esp_timer time of the last failure
+    char last_task[configMAX_TASK_NAME_LEN];
+} heap_failure_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Register the failed-allocation callback and the heap metrics
+ *
+ * Per-task counts also need CONFIG_HEAP_USE_HOOKS; without it only the
+ * capability and failure data is collected.
+ *
+ * @return esp_err_t ESP_OK, or the heap_caps error
+ */
+esp_err_t heap_monitor_start(void);
+
+/**
+ * @brief Whether the allocation hooks are compiled in
+ */
+bool heap_monitor_tracking_tasks(void);
+
+/**
+ * @brief Read the current state of each capability class
+ *
+ * @param stats Receives up to max entries
+ * @param max Capacity of stats
+ * @return Number of entries written
+ */
+size_t heap_monitor_get_caps(heap_caps_stats_t *stats, size_t max);
+
+/**
+ * @brief Copy the per-task allocation counters
+ *
+ * @param tasks Receives up to max entries, most allocations first
+ * @param max Capacity of tasks
+ * @return Number of entries written
+ */
+size_t heap_monitor_get_tasks(heap_task_stats_t *tasks, size_t max);
+
+/**
+ * @brief Copy the failed-allocation record
+ */
+void heap_monitor_get_failures(heap_failure_stats_t *failures);
+
+/**
+ * @brief Zero the per-task counters; failures are kept
+ */
+void heap_monitor_reset(void);
+
+/**
+ * @brief Write capabilities, failures and per-task counters as a JSON object
+ *
+ * @param w Writer positioned where a value is expected
+ */
+void heap_monitor_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HEAP_MONITOR_H
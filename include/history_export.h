@@ -0,0 +1,74 @@
+/**
+ * @file history_export.h
+ * @brief Bulk export of stored records as CSV or NDJSON, streamed and resumable with HTTP Range
+ *
+ *   GET /api/history/export?format=csv|ndjson&from=&to=
+ *       every record of the time-series store (ts_store.h) in [from, to),
+ *       Unix seconds; by default the whole store
+ *   GET /api/archive
+ *       the SD archive's daily files (sd_archive.h), as JSON
+ *   GET /api/archive?day=YYYYMMDD&format=csv|ndjson|raw
+ *       one day of the SD archive; raw is the file as it is
+ *
+ * Every line of a format has the same length: fields are right-aligned
+ * and space-padded to a fixed width, and a missing value is null in NDJSON
+ * and blank in CSV. A byte offset therefore names a record and an offset
+ * within its line, so a Range request starts at the right record without
+ * encoding anything before it. The store's index lets it pass over whole
+ * blocks without reading them; the archive is counted by reading it, which
+ * a card does quickly. Nothing is built in RAM: records are read a few at
+ * a time and encoded into one EXPORT_BUF_BYTES buffer, which goes out as
+ * one chunk of a chunked response.
+ *
+ * Both answers carry "Accept-Ranges: bytes"; a single byte range gets 206
+ * with Content-Range, several get the whole export. Positions hold as
+ * long as nothing is added inside the range, so resume an interrupted
+ * download with the same from and to, once the range is in the past.
+ * A whole export to a client that accepts gzip goes compressed instead
+ * (http_gzip.h), without Accept-Ranges: ranges count the plain bytes, and
+ * a range request is always answered with them.
+ *
+ * CSV columns and NDJSON keys: time (Unix s), node (hex), seq, temperature
+ * (degC), pressure (Pa), humidity (%RH), gas (ohm). The store keeps no seq
+ * or gas, so those are always missing in a history export.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef HISTORY_EXPORT_H
+#define HISTORY_EXPORT_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define HISTORY_EXPORT_URI "/api/history/export"
+#define HISTORY_EXPORT_ARCHIVE_URI "/api/archive"
+#define EXPORT_BUF_BYTES 2048                   // One chunk of the response
+#define EXPORT_READ_RECORDS 32                  // Records read per pass
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Register the export endpoints
+ *
+ * @return esp_err_t ESP_OK, or the first registration error
+ */
+esp_err_t history_export_register(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HISTORY_EXPORT_H
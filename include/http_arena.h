@@ -0,0 +1,110 @@
+/**
+ * @file http_arena.h
+ * @brief Per-request arena for the HTTP server: handler buffers freed in one shot when the handler returns
+ *
+ * The arenas are taken once, when the server starts (from .bss in a
+ * STATIC_MEMORY build), and the http_perf trampoline that every handler
+ * runs through binds one to the request before the handler and rewinds it
+ * after. Handlers take their buffers with http_arena_alloc() and never
+ * free them, so an early return cannot leak and a request costs the heap
+ * nothing.
+ *
+ * Code that a handler calls without its request (the history query, the
+ * resume hash) uses http_arena_malloc()/http_arena_free(): the calling
+ * task's arena inside a request, the heap anywhere else.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef HTTP_ARENA_H
+#define HTTP_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef HTTP_ARENA_BYTES
+#define HTTP_ARENA_BYTES (20 * 1024)            // Per arena; the largest request takes one 16 KB OTA chunk
+#endif
+#define HTTP_ARENA_COUNT 1                      // One per server task; requests on one server run one at a time
+#define HTTP_ARENA_ALIGN 8                      // Buffers start on this boundary
+
+/**
+ * @brief Arena use since http_arena_init()
+ */
+typedef struct {
+    size_t bytes;                               // Per arena
+    uint32_t count;
+    uint32_t requests;                          // Requests that had an arena bound
+    uint32_t unbound;                           // Requests that found every arena taken
+    uint32_t allocs;
+    uint32_t failures;                          // Allocations that did not fit
+    size_t peak;                                // Most one request used
+} http_arena_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Take the arenas; once, before the server starts
+ *
+ * @return esp_err_t ESP_OK or ESP_ERR_NO_MEM
+ */
+esp_err_t http_arena_init(void);
+
+/**
+ * @brief Bind a free arena to the request on the calling task; NULL for server work outside a request
+ */
+void http_arena_begin(httpd_req_t *req);
+
+/**
+ * @brief Rewind and release the arena bound by http_arena_begin()
+ */
+void http_arena_end(httpd_req_t *req);
+
+/**
+ * @brief A buffer that lives until the handler returns; never freed by the caller
+ *
+ * @return NULL if the request has no arena or it is full
+ */
+void *http_arena_alloc(httpd_req_t *req, size_t size);
+
+/**
+ * @brief malloc() that uses the calling task's arena while it is inside a request
+ */
+void *http_arena_malloc(size_t size);
+
+/**
+ * @brief free() for http_arena_malloc(); arena buffers are left for the rewind
+ */
+void http_arena_free(void *ptr);
+
+/**
+ * @brief Copy the counters
+ */
+void http_arena_get_stats(http_arena_stats_t *stats);
+
+/**
+ * @brief Write the counters as a JSON object
+ */
+void http_arena_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HTTP_ARENA_H
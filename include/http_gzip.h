@@ -0,0 +1,94 @@
+/**
+ * @file http_gzip.h
+ * @brief gzip for large dynamic responses, compressed as they stream out when the client accepts it
+ *
+ * History and archive exports, the metric history and the Prometheus
+ * scrape run to hundreds of KB of text, and over the AP the radio is the
+ * slow part. When the request's Accept-Encoding names gzip,
+ * http_gzip_begin() takes a gzip_stream_t (gzip_writer.h) from the
+ * request's arena, marks the response "Content-Encoding: gzip", and the
+ * handler's chunks go through the stream instead of straight to
+ * httpd_resp_send_chunk(). Memory stays one stream, about 9 KB, however
+ * long the body; the cost is CPU on the httpd task, which mostly waits
+ * on the socket anyway. Without gzip in Accept-Encoding, with
+ * HTTP_GZIP 0, or when the arena has no room, the response goes out as
+ * before.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef HTTP_GZIP_H
+#define HTTP_GZIP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "gzip_writer.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef HTTP_GZIP
+#define HTTP_GZIP 1                             // 1: compress large dynamic responses for clients that accept gzip
+#endif
+
+/**
+ * @brief Responses compressed since boot
+ */
+typedef struct {
+    uint32_t responses;                         // Sent compressed
+    uint32_t skipped;                           // Accepted gzip but the arena had no room
+    uint64_t bytes_in;                          // Body before compression
+    uint64_t bytes_out;                         // And after
+} http_gzip_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Whether the request's Accept-Encoding names gzip
+ */
+bool http_gzip_accepted(httpd_req_t *req);
+
+/**
+ * @brief Start a compressed body if the client accepts one; before the first chunk
+ *
+ * Sets the Content-Encoding and Vary headers when it does.
+ *
+ * @return gzip_stream_t* Stream for http_gzip_send_chunk(), or NULL to send the body as it is
+ */
+gzip_stream_t *http_gzip_begin(httpd_req_t *req);
+
+/**
+ * @brief Send one chunk of the body, through gz when there is one; NULL or len 0 ends the response
+ */
+esp_err_t http_gzip_send_chunk(httpd_req_t *req, gzip_stream_t *gz, const char *data, size_t len);
+
+/**
+ * @brief Prepare a writer that streams a chunked JSON body, compressed when the client accepts it
+ *
+ * json_writer_init_httpd() otherwise; json_writer_finish() ends the response either way.
+ */
+void http_gzip_init_json(json_writer_t *w, httpd_req_t *req);
+
+/**
+ * @brief Copy the counters
+ */
+void http_gzip_get_stats(http_gzip_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HTTP_GZIP_H
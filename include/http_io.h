@@ -0,0 +1,176 @@
+/**
+ * @file http_io.h
+ * @brief Thin HTTP request/response interface, so handler logic runs on esp_http_server or on a host
+ *
+ * The portable handlers (web_handlers.h) read the request body and write
+ * the response only through an http_io_t, a table of operations and a
+ * context. Two adapters back it:
+ *
+ *   http_io_init_httpd()   an esp_http_server request (ESP_PLATFORM builds)
+ *   http_io_init_mem()     a request held in memory, the response captured
+ *                          to a buffer or only counted
+ *
+ * The memory adapter needs nothing from ESP-IDF but esp_err_t, so the same
+ * handler code can be driven with synthetic requests: by the http_* cases
+ * of bench_suite.h on the target, or on a workstation by the
+ * test_web_handlers suite of [env:native], which builds web_handlers.c and
+ * the parsers and schema it uses against the ESP-IDF stand-ins in
+ * test/host. recv_max hands the body over in short reads, so the parsers
+ * see the buffer boundaries a socket would give them.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef HTTP_IO_H
+#define HTTP_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "json_writer.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_http_server.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define HTTP_IO_RECV_TIMEOUT (-3)               // recv result for a timed-out read (HTTPD_SOCK_ERR_TIMEOUT)
+#define HTTP_IO_TYPE_MAX 48                     // Longest content type the memory adapter keeps
+
+/**
+ * @brief Operations of one adapter; ctx is http_io_t.ctx
+ */
+typedef struct {
+    int (*recv)(void *ctx, char *buf, size_t len);                  // Bytes read, 0 or less on error
+    esp_err_t (*get_header)(void *ctx, const char *name, char *out, size_t out_len);
+    esp_err_t (*set_status)(void *ctx, const char *status);         // "400 Bad Request"
+    esp_err_t (*set_type)(void *ctx, const char *type);
+    esp_err_t (*send)(void *ctx, const char *data, size_t len);     // Whole body
+    esp_err_t (*send_chunk)(void *ctx, const char *data, size_t len);  // len 0 ends the response
+    esp_err_t (*send_error)(void *ctx, int code, const char *message);
+} http_io_ops_t;
+
+/**
+ * @brief One request being answered
+ */
+typedef struct {
+    const http_io_ops_t *ops;
+    void *ctx;
+    size_t content_len;                         // Request body length
+    bool head;                                  // HEAD request: headers only
+} http_io_t;
+
+/**
+ * @brief Memory adapter state: the request, and the response as it is written
+ */
+typedef struct {
+    // Request, set by the caller
+    const char *body;
+    size_t body_len;
+    size_t recv_max;                            // Most bytes per recv, 0 for no limit
+    const char *headers;                        // "Name: value\n" lines, or NULL
+    bool head;
+    // Response
+    char *out;                                  // Body buffer, or NULL to only count it
+    size_t out_cap;
+    size_t out_len;                             // Body bytes written (counted past out_cap too)
+    int status;                                 // 200 unless set
+    char type[HTTP_IO_TYPE_MAX];
+    bool ended;                                 // Sent whole, or its last chunk
+    size_t pos;                                 // Body bytes handed out by recv
+} http_io_mem_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief Answer an esp_http_server request through io
+ *
+ * @param io Interface to initialise
+ * @param req Request; must outlive io
+ */
+void http_io_init_httpd(http_io_t *io, httpd_req_t *req);
+#endif
+
+/**
+ * @brief Answer a request held in memory
+ *
+ * Resets the response fields of mem; the request fields are the caller's.
+ *
+ * @param io Interface to initialise
+ * @param mem Request and response; must outlive io
+ */
+void http_io_init_mem(http_io_t *io, http_io_mem_t *mem);
+
+/**
+ * @brief Read up to len body bytes
+ *
+ * @return Bytes read; 0 at the end of the body or on a closed socket, HTTP_IO_RECV_TIMEOUT or below on error
+ */
+int http_io_recv(http_io_t *io, char *buf, size_t len);
+
+/**
+ * @brief Copy a request header's value
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND, or ESP_ERR_INVALID_SIZE if it did not fit out
+ */
+esp_err_t http_io_get_header(http_io_t *io, const char *name, char *out, size_t out_len);
+
+/**
+ * @brief Set the status line, e.g. "400 Bad Request"; before the body
+ */
+esp_err_t http_io_set_status(http_io_t *io, const char *status);
+
+/**
+ * @brief Set the content type; before the body
+ */
+esp_err_t http_io_set_type(http_io_t *io, const char *type);
+
+/**
+ * @brief Send the whole body in one piece
+ */
+esp_err_t http_io_send(http_io_t *io, const char *data, size_t len);
+
+/**
+ * @brief Send a NUL-terminated string as the whole body
+ */
+esp_err_t http_io_send_str(http_io_t *io, const char *str);
+
+/**
+ * @brief Send one chunk of the body; len 0 ends it
+ */
+esp_err_t http_io_send_chunk(http_io_t *io, const char *data, size_t len);
+
+/**
+ * @brief Answer with an error status and a short message
+ *
+ * @param io Interface
+ * @param code HTTP status: 400, 404, 408, 413 or 500
+ * @param message Body text
+ */
+esp_err_t http_io_send_error(http_io_t *io, int code, const char *message);
+
+/**
+ * @brief Prepare a writer that streams a chunked "application/json" body through io
+ *
+ * Same as json_writer_init_httpd(); json_writer_finish() sends the last chunk.
+ */
+void http_io_init_json(json_writer_t *w, http_io_t *io);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HTTP_IO_H
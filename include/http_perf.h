@@ -0,0 +1,118 @@
+/**
+ * @file http_perf.h
+ * @brief Per-handler request count, bytes and latency histogram for the web server
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef HTTP_PERF_H
+#define HTTP_PERF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "json_writer.h"
+#include "web_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define HTTP_PERF_MAX_HANDLERS WEB_SERVER_PORTAL_MAX_HANDLERS  // Every handler the portal can hold
+#define HTTP_PERF_BUCKETS 12                    // Latency buckets; the last one is open-ended
+
+/**
+ * @brief Counters of one registered URI handler
+ */
+typedef struct {
+    const char *uri;
+    httpd_method_t method;
+    uint32_t count;                             // Requests handled
+    uint32_t errors;                            // Handler returned something other than ESP_OK
+    uint64_t bytes_in;                          // Request bodies (Content-Length)
+    uint64_t bytes_out;                         // Bytes sent on the request's socket by the handler
+    uint64_t total_us;                          // Sum of handler run times
+    uint32_t max_us;                            // Slowest single request
+    uint32_t histogram[HTTP_PERF_BUCKETS];      // Requests per latency bucket, see http_perf_bucket_ms()
+} http_perf_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Register a URI handler with instrumentation around it
+ *
+ * Drop-in replacement for httpd_register_uri_handler(). The handler still
+ * sees its own user_ctx, and always runs with a request arena
+ * (http_arena.h): past HTTP_PERF_MAX_HANDLERS it is still wrapped, from
+ * a heap slot, and only left out of the stats.
+ *
+ * @param server Running server
+ * @param uri Handler description; copied like httpd does
+ * @return esp_err_t ESP_OK, ESP_ERR_NO_MEM when no slot could be allocated, or the httpd error
+ */
+esp_err_t http_perf_register(httpd_handle_t server, const httpd_uri_t *uri);
+
+/**
+ * @brief Socket send override that counts bytes for the running handler
+ *
+ * Install per session with httpd_sess_set_send_override(), typically from
+ * the server's open_fn.
+ */
+int http_perf_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags);
+
+/**
+ * @brief Number of instrumented handlers
+ */
+size_t http_perf_count(void);
+
+/**
+ * @brief Copy the counters of one handler
+ *
+ * @param index 0 .. http_perf_count() - 1, in registration order
+ * @param stats Receives the snapshot
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG for a bad index
+ */
+esp_err_t http_perf_get(size_t index, http_perf_stats_t *stats);
+
+/**
+ * @brief Upper bound of a latency bucket in milliseconds, 0 for the open-ended last one
+ */
+uint32_t http_perf_bucket_ms(size_t bucket);
+
+/**
+ * @brief esp_timer time at which the last registered handler returned, 0 before the first request
+ */
+int64_t http_perf_last_request_us(void);
+
+/**
+ * @brief Zero all counters; handlers stay registered
+ */
+void http_perf_reset(void);
+
+/**
+ * @brief Write every handler's counters as a JSON object
+ *
+ * @param w Writer positioned where a value is expected
+ */
+void http_perf_write_json(json_writer_t *w);
+
+/**
+ * @brief Forget all handlers; call after the server has stopped
+ */
+void http_perf_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HTTP_PERF_H
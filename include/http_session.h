@@ -0,0 +1,123 @@
+/**
+ * @file http_session.h
+ * @brief Persistent portal connections: per-session context, advertised keep-alive and idle reaping
+ *
+ * httpd already leaves an HTTP/1.1 connection open after each response,
+ * but nothing told the client how long it would stay open, so a polling
+ * dashboard either reopened one per poll or sent a request down a socket
+ * the LRU purge had just closed and sat through the retry. Over lossy
+ * WiFi each new connection is a handshake that can stall for seconds, and
+ * over HTTPS a TLS handshake on top.
+ *
+ * Every response now carries "Keep-Alive: timeout=N", N a few seconds
+ * under HTTP_SESSION_IDLE_S, and a sweep on the httpd task closes plain
+ * HTTP sessions idle longer than HTTP_SESSION_IDLE_S, so the client
+ * always gives up on a connection before the server does and sockets a
+ * closed browser tab left behind come back before the purge has to evict
+ * a live one. WebSocket sessions are left alone.
+ *
+ * Each session gets a context (httpd_sess_set_ctx() on its first
+ * request) with its open time, last request and request count; handlers
+ * reach it through http_session_get(). The table is only touched on the
+ * httpd task: the open and close callbacks, the http_perf trampoline and
+ * the queued sweep.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef HTTP_SESSION_H
+#define HTTP_SESSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "web_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef HTTP_SESSION_IDLE_S
+#define HTTP_SESSION_IDLE_S 30                  // Idle seconds before the server closes a session
+#endif
+#define HTTP_SESSION_MARGIN_S 5                 // Advertised timeout is this much shorter, so the client closes first
+#define HTTP_SESSION_SWEEP_MS 5000              // Idle sweep period
+#define HTTP_SESSION_MAX WEB_SERVER_PORTAL_MAX_SOCKETS
+
+_Static_assert(HTTP_SESSION_IDLE_S > HTTP_SESSION_MARGIN_S, "the advertised keep-alive timeout must be positive");
+
+/**
+ * @brief One open connection
+ */
+typedef struct {
+    int fd;                                     // -1: slot free
+    int64_t opened_us;
+    int64_t last_us;                            // Last request began, or the open if none yet
+    uint32_t requests;                          // Served on this connection
+} http_session_t;
+
+/**
+ * @brief Counters since http_session_start()
+ */
+typedef struct {
+    uint32_t sessions;                          // Opened
+    uint32_t requests;
+    uint32_t reused;                            // Requests on a connection that had already served one
+    uint32_t idle_closed;                       // Sessions the sweep closed
+    uint32_t most_requests;                     // Most requests one session served
+} http_session_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Clear the table and start the idle sweep for a started server
+ */
+esp_err_t http_session_start(httpd_handle_t server);
+
+/**
+ * @brief Stop the sweep; before httpd_stop()
+ */
+void http_session_stop(void);
+
+/**
+ * @brief Track a new connection; from the server's open_fn
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_NO_MEM with every slot taken
+ */
+esp_err_t http_session_open(int fd);
+
+/**
+ * @brief Forget a connection; from the server's close_fn
+ */
+void http_session_close(int fd);
+
+/**
+ * @brief Account for a request and set its Keep-Alive header; from the http_perf trampoline, before the handler
+ */
+void http_session_request(httpd_req_t *req);
+
+/**
+ * @brief The request's session, NULL if it is not tracked
+ */
+http_session_t *http_session_get(httpd_req_t *req);
+
+/**
+ * @brief Copy the counters
+ */
+void http_session_get_stats(http_session_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HTTP_SESSION_H
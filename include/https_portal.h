@@ -0,0 +1,89 @@
+/**
+ * @file https_portal.h
+ * @brief Portal over TLS (esp_https_server) with session ticket resumption
+ *
+ * With HTTPS_PORTAL=1 ([env:https]) web_server_start() runs the portal on
+ * port 443 through esp_https_server, and a small plain server on port 80
+ * answers every request with a redirect to the same path over HTTPS, so
+ * bookmarks and the captive-portal probes still land on the portal.
+ *
+ * The certificate and key are built into the app image (generated once
+ * into certs/ by scripts/tls_credentials.py, or put there by hand) and
+ * parsed once per server start into the context every session shares;
+ * nothing is read from the filesystem or NVS per connection. The server
+ * issues TLS session tickets, so a browser coming back within the ticket
+ * lifetime (CONFIG_ESP_TLS_SERVER_SESSION_TICKET_TIMEOUT) resumes with an
+ * abbreviated handshake instead of repeating the key exchange, which is
+ * what costs hundreds of milliseconds on the ESP32. The key is ECDSA
+ * P-256, far cheaper to sign with than RSA.
+ *
+ * Each TLS session holds its own record buffers, so the portal profile
+ * drops to HTTPS_PORTAL_MAX_SOCKETS sessions and a larger server stack.
+ * The SSL layer owns each session's send hook, so /api/perf reports no
+ * response byte counts in this build.
+ * The handshake and throughput cost is measured by the tls_* and http_get
+ * cases of [env:bench-https] (see bench_suite.h).
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef HTTPS_PORTAL_H
+#define HTTPS_PORTAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef HTTPS_PORTAL
+#define HTTPS_PORTAL 0                          // 1: serve the portal over TLS; build with -D HTTPS_PORTAL=1
+#endif
+#define HTTPS_PORTAL_PORT 443
+#define HTTPS_PORTAL_MAX_SOCKETS 4              // Sessions; each holds about 20 KB of TLS buffers
+#define HTTPS_PORTAL_REDIRECT_PORT 80
+#define HTTPS_PORTAL_REDIRECT_SOCKETS 3
+#define HTTPS_PORTAL_FALLBACK_HOST "192.168.4.1"  // Redirect target for requests without a Host header
+#define HTTPS_PORTAL_HOST_MAX_LEN 64
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Start an HTTPS server with config, and the redirect server beside it
+ *
+ * config->server_port is the secure port; ctrl_port + 1 is taken by the
+ * redirect server. A redirect server that fails to start only logs.
+ *
+ * @return esp_err_t ESP_OK, the httpd_ssl_start() error, or ESP_ERR_NOT_SUPPORTED without HTTPS_PORTAL
+ */
+esp_err_t https_portal_start(httpd_handle_t *handle, const httpd_config_t *config);
+
+/**
+ * @brief Stop a server from https_portal_start() and its redirect server
+ */
+esp_err_t https_portal_stop(httpd_handle_t handle);
+
+/**
+ * @brief The built-in certificate (PEM, NUL included), for clients that pin it
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_NOT_SUPPORTED without HTTPS_PORTAL
+ */
+esp_err_t https_portal_certificate(const uint8_t **pem, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HTTPS_PORTAL_H
@@ -0,0 +1,167 @@
+/**
+ * @file i2c_bus.h
+ * @brief Shared I2C bus: one task runs the transactions of every driver on it, with retries and per-device counters
+ *
+ * The node's BME680 and the energy benchmark's INA219 sit on one bus and
+ * are read from different tasks. The i2c_master driver serialises them
+ * with its own bus lock, but nobody counted what went wrong, so
+ * METRIC_I2C_BUS_ERRORS had nothing to report.
+ *
+ * The bus manager owns the bus and a task that runs the transactions, in
+ * the order they were queued. A driver submits a transaction with a
+ * completion callback (i2c_bus_submit()), or, as the BME680 and INA219
+ * drivers do through their transfer function, waits for it
+ * (i2c_bus_transfer()). A NACK or a timeout is tried again, up to
+ * I2C_BUS_RETRIES more times with I2C_BUS_RETRY_DELAY_MS between, which
+ * rides out a sensor busy with a conversion or a glitch on a long cable.
+ *
+ * Each device counts its transactions, the ones that failed after every
+ * retry, the retries, and the time its transactions held the bus;
+ * i2c_bus_get_stats() copies them and the METRIC_I2C_BUS_ERRORS provider
+ * reports them.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define I2C_BUS_DEVICES 4                       // Devices on the bus
+#define I2C_BUS_QUEUE 8                         // Transactions waiting for the bus
+#define I2C_BUS_NAME_LEN 12
+#define I2C_BUS_TIMEOUT_MS 50                   // Per attempt
+#define I2C_BUS_RETRIES 2                       // Further attempts after a NACK or a timeout
+#define I2C_BUS_RETRY_DELAY_MS 2
+#define I2C_BUS_SUBMIT_WAIT_MS 100              // Wait for room in the queue
+#define I2C_BUS_STOP_TIMEOUT_MS 500
+
+/**
+ * @brief A device on the bus
+ */
+typedef struct i2c_bus_device *i2c_bus_device_handle_t;
+
+/**
+ * @brief Completion callback; runs in the bus task, so it must not block
+ *
+ * @param ctx The transaction's ctx
+ * @param err ESP_OK, or the I2C error of the last attempt
+ */
+typedef void (*i2c_bus_done_t)(void *ctx, esp_err_t err);
+
+/**
+ * @brief One transaction: write tx, then read rx_len bytes into rx after a repeated start
+ *
+ * The buffers must stay valid until done runs.
+ */
+typedef struct {
+    i2c_bus_device_handle_t dev;
+    const uint8_t *tx;
+    size_t tx_len;
+    uint8_t *rx;
+    size_t rx_len;                              // 0: write only
+    i2c_bus_done_t done;                        // NULL: fire and forget
+    void *ctx;
+} i2c_bus_txn_t;
+
+/**
+ * @brief Counters of one device
+ */
+typedef struct {
+    char name[I2C_BUS_NAME_LEN];
+    uint8_t address;
+    uint32_t transactions;
+    uint32_t errors;                            // Failed after every retry
+    uint32_t retries;
+    uint64_t bus_us;                            // Time its attempts held the bus
+} i2c_bus_device_stats_t;
+
+/**
+ * @brief Bus counters
+ */
+typedef struct {
+    bool running;
+    uint8_t devices;
+    uint8_t queue_peak;                         // Most transactions ever waiting
+    i2c_bus_device_stats_t device[I2C_BUS_DEVICES];
+} i2c_bus_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Create the bus and start the bus task, and register the METRIC_I2C_BUS_ERRORS provider
+ *
+ * @param port I2C port
+ * @param sda_gpio SDA pin (internal pull-up enabled)
+ * @param scl_gpio SCL pin (internal pull-up enabled)
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if already running, ESP_ERR_NO_MEM, or the bus error
+ */
+esp_err_t i2c_bus_start(int port, int sda_gpio, int scl_gpio);
+
+/**
+ * @brief Add a device
+ *
+ * @param name Name in the counters and the metric
+ * @param address 7-bit address
+ * @param speed_hz SCL speed for its transactions
+ * @param dev Receives the device
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if the bus is not running, ESP_ERR_NO_MEM when
+ *         I2C_BUS_DEVICES are added, or the driver error
+ */
+esp_err_t i2c_bus_add_device(const char *name, uint8_t address, uint32_t speed_hz, i2c_bus_device_handle_t *dev);
+
+/**
+ * @brief Remove a device; none of its transactions may still be queued
+ */
+void i2c_bus_remove_device(i2c_bus_device_handle_t dev);
+
+/**
+ * @brief Queue a transaction; txn is copied
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_INVALID_STATE if the bus is not running,
+ *         or ESP_ERR_TIMEOUT if the queue stayed full for I2C_BUS_SUBMIT_WAIT_MS
+ */
+esp_err_t i2c_bus_submit(const i2c_bus_txn_t *txn);
+
+/**
+ * @brief Run a transaction and wait for it; the BME680 and INA219 transfer function
+ *
+ * One task at a time per device. Called from a completion callback, it runs
+ * the transaction in place.
+ *
+ * @param dev The device (i2c_bus_device_handle_t)
+ * @return esp_err_t As i2c_bus_submit(), or the I2C error
+ */
+esp_err_t i2c_bus_transfer(void *dev, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len);
+
+/**
+ * @brief Copy the counters
+ */
+void i2c_bus_get_stats(i2c_bus_stats_t *stats);
+
+/**
+ * @brief Stop the bus task once the queue drains, remove every device and delete the bus
+ */
+void i2c_bus_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // I2C_BUS_H
@@ -0,0 +1,135 @@
+/**
+ * @file iaq.h
+ * @brief Indoor air quality from the BME680 gas resistance, through Bosch BSEC, with its state kept across sleep
+ *
+ * The gas resistance alone drifts with the sensor and the room; BSEC turns
+ * it, with temperature and humidity, into an IAQ index (0..500), a static
+ * IAQ, a CO2 equivalent and a breath-VOC equivalent, each with an accuracy
+ * of 0 (not calibrated) to 3. Calibration takes hours of samples, so the
+ * library state is kept rather than relearned:
+ *
+ *   RTC memory   the whole state on every deep sleep (iaq_suspend()), CRC
+ *                checked; a timer wake restores it at once
+ *   NVS          the state at most every IAQ_NVS_SAVE_S, and when the
+ *                accuracy first reaches 3; only iaq_save() writes it, so a
+ *                duty-cycled node batches the write with its radio boot
+ *                rather than every wake. A power-on or reset restores it
+ *
+ * BSEC owns the schedule. iaq_prepare() asks it whether a sample is due
+ * and sets the heater it wants; iaq_process() feeds the reading back. A
+ * duty-cycled node samples at BSEC's ultra-low-power rate
+ * (IAQ_ULP_PERIOD_MS) and sleeps until iaq_next_us(); an awake node at the
+ * low-power rate (IAQ_LP_PERIOD_MS). Times are the RTC clock, which runs
+ * through deep sleep.
+ *
+ * The library is Bosch's and not in the tree: with NODE_BSEC=1 (node.h)
+ * the BSEC package's libalgobsec.a for the ESP32 and its headers go in
+ * lib/BSEC, with IAQ_BSEC_CONFIG_H and its .c (defining bsec_config_iaq)
+ * from the config matching the rate: bme680_iaq_33v_300s_4d for a
+ * duty-cycled node, bme680_iaq_33v_3s_4d for an awake one. Without a
+ * config BSEC runs on its built-in defaults. Build [env:bsec].
+ *
+ * Not thread-safe, apart from iaq_get() and iaq_save(): one task samples.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef IAQ_H
+#define IAQ_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bme680.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define IAQ_ULP_PERIOD_MS 300000                // BSEC_SAMPLE_RATE_ULP: duty-cycled node
+#define IAQ_LP_PERIOD_MS 3000                   // BSEC_SAMPLE_RATE_LP: awake node
+#define IAQ_NVS_SAVE_S 14400                    // Longest the NVS copy of the state lags: 4 h
+#define IAQ_STATE_MAX 256                       // Serialized state kept; BSEC 1.4 needs 139 bytes, 2.x 221
+#ifndef IAQ_BSEC_CONFIG_H
+#define IAQ_BSEC_CONFIG_H "bsec_serialized_configurations_iaq.h"
+#endif
+
+/**
+ * @brief BSEC outputs, in fixed point
+ */
+typedef struct {
+    bool valid;                                 // At least one sample processed since the state was new
+    uint8_t accuracy;                           // Of the IAQ: 0 stabilising .. 3 calibrated
+    uint16_t iaq;                               // 0.1 index: 250 is 25.0
+    uint16_t static_iaq;                        // 0.1 index, not scaled to the recent range
+    uint16_t co2_ppm;                           // CO2 equivalent
+    uint32_t bvoc_ppb;                          // Breath-VOC equivalent
+} iaq_result_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Start BSEC and restore its state, from RTC memory or else NVS
+ *
+ * @param duty_cycled Subscribe at IAQ_ULP_PERIOD_MS rather than IAQ_LP_PERIOD_MS
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_SUPPORTED without NODE_BSEC, or ESP_FAIL if BSEC refused its config
+ */
+esp_err_t iaq_start(bool duty_cycled);
+
+/**
+ * @brief Ask BSEC for this sample and program the heater it wants
+ *
+ * @param sensor Initialized BME680; its heater profile is replaced
+ * @param due Receives whether BSEC takes a sample now; a reading taken anyway is not fed to it
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE before iaq_start(), or ESP_FAIL if BSEC refused the call
+ */
+esp_err_t iaq_prepare(bme680_t *sensor, bool *due);
+
+/**
+ * @brief Feed the reading of a due sample to BSEC, stamped with the time of iaq_prepare()
+ *
+ * @param result Receives the outputs; may be NULL
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE with no sample due, or ESP_FAIL if BSEC refused it
+ */
+esp_err_t iaq_process(const bme680_reading_t *reading, iaq_result_t *result);
+
+/**
+ * @brief RTC clock time (esp_clk_rtc_time()) BSEC wants the next sample at; 0 before the first iaq_prepare()
+ */
+int64_t iaq_next_us(void);
+
+/**
+ * @brief Keep the state in RTC memory; call before each deep sleep
+ */
+void iaq_suspend(void);
+
+/**
+ * @brief Write the state to NVS if a save fell due; from any task
+ *
+ * @return esp_err_t ESP_OK (also with nothing due), or the NVS error, and the save stays due
+ */
+esp_err_t iaq_save(void);
+
+/**
+ * @brief Take the state for NVS now and write it; before a restart, with sampling stopped
+ */
+esp_err_t iaq_stop(void);
+
+/**
+ * @brief Copy the latest outputs; from any task
+ */
+void iaq_get(iaq_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_H
@@ -0,0 +1,151 @@
+/**
+ * @file influx_writer.h
+ * @brief Gateway InfluxDB writer: node samples as line protocol, POSTed in gzip batches
+ *
+ * Each sample becomes one line in a preallocated batch buffer:
+ *
+ *   weather,node=1a2b3c4d temperature=21.53,pressure=101325i,humidity=45.120,gas=12000i,seq=1200i 1760500000
+ *
+ * temperature in degC, humidity in %RH, pressure in Pa, gas in ohm (left
+ * out when the reading was not valid); the timestamp is the sample's, in
+ * seconds (the URL carries precision=s). A batch is sealed when the next
+ * line might not fit INFLUX_BATCH_BYTES or when its oldest line is
+ * INFLUX_BATCH_WINDOW_MS old. Sealing gzips it (gzip_writer.h) into the
+ * send buffer, and the writer task POSTs it to INFLUX_URL over one
+ * keep-alive esp_http_client connection. About 200 points share each
+ * request's headers, round trip and TLS records, so the per-point
+ * overhead is a few bytes.
+ *
+ * While one batch is in flight the next one fills. A POST that fails, or
+ * that the server answers with anything but 2xx (a 4xx other than 408 and
+ * 429 is dropped: resending a body the server refused cannot help), is
+ * retried from the send buffer with a backoff from INFLUX_RETRY_MIN_MS to
+ * INFLUX_RETRY_MAX_MS. Meanwhile influx_writer_connected() is false, so
+ * the gateway moves new records to its flash spool and replays them
+ * through the writer once the retry goes through: the same contract as
+ * mqtt_forwarder, so the forwarder drives either one the same way.
+ *
+ * The forwarder task calls every function; only the POST runs on the
+ * writer's own task.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef INFLUX_WRITER_H
+#define INFLUX_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef INFLUX_URL
+#define INFLUX_URL "http://192.168.1.200:8086/api/v2/write?org=home&bucket=weather&precision=s"
+#endif
+#ifndef INFLUX_TOKEN
+#define INFLUX_TOKEN ""                         // API token; sent as "Authorization: Token ..." when set
+#endif
+#define INFLUX_MEASUREMENT "weather"
+#define INFLUX_BATCH_BYTES 12288                // Line protocol per POST, about 200 points; twice this is preallocated
+#define INFLUX_BATCH_WINDOW_MS 10000            // Longest a point waits for its batch
+#define INFLUX_LINE_MAX 128                     // Longest line; a batch is sealed when this may not fit
+#define INFLUX_GZIP 1                           // 0: send the line protocol as it is
+#define INFLUX_TIMEOUT_MS 10000                 // Per request
+#define INFLUX_RETRY_MIN_MS 2000
+#define INFLUX_RETRY_MAX_MS 60000
+
+/**
+ * @brief Writer counters since influx_writer_init()
+ */
+typedef struct {
+    uint32_t points;                            // Lines added to batches
+    uint32_t batches;                           // Batches the server accepted
+    uint32_t failures;                          // POSTs that failed or were answered with an error
+    uint32_t rejected;                          // Batches dropped because the server refused them
+    uint32_t bytes_raw;                         // Line protocol in accepted batches
+    uint32_t bytes_sent;                        // Their bodies as sent
+    int last_status;                            // HTTP status of the last answer, 0: none
+    uint32_t last_ms;                           // Duration of the last POST
+} influx_writer_stats_t;
+
+/**
+ * @brief Called from the writer task when a batch was accepted, or the server answered again
+ */
+typedef void (*influx_writer_wake_t)(void);
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Allocate the batch buffers, create the HTTP client and start the writer task
+ *
+ * @param wake Called when the forwarder has work again; may be NULL
+ * @return esp_err_t ESP_OK, ESP_ERR_NO_MEM, or the HTTP client's error
+ */
+esp_err_t influx_writer_init(influx_writer_wake_t wake);
+
+/**
+ * @brief Stop the task, close the connection and free the buffers; an unsent batch is lost
+ */
+void influx_writer_deinit(void);
+
+/**
+ * @brief Samples that can be added now without waiting for the batch in flight
+ */
+size_t influx_writer_room(void);
+
+/**
+ * @brief Add one sample to the open batch
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NO_MEM if the batch is full while another is in flight
+ */
+esp_err_t influx_writer_publish(uint32_t node_id, const telemetry_record_t *rec);
+
+/**
+ * @brief Seal the open batch once its window has run out
+ */
+void influx_writer_poll(void);
+
+/**
+ * @brief Milliseconds until influx_writer_poll() has a batch to seal (UINT32_MAX: none)
+ */
+uint32_t influx_writer_poll_due_ms(void);
+
+/**
+ * @brief Seal the open batch now, if the send buffer is free
+ */
+void influx_writer_flush(void);
+
+/**
+ * @brief The last POST went through (true until the first one fails)
+ */
+bool influx_writer_connected(void);
+
+/**
+ * @brief Everything added so far was accepted: no open batch, nothing in flight
+ */
+bool influx_writer_idle(void);
+
+/**
+ * @brief Copy the counters
+ */
+void influx_writer_get_stats(influx_writer_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INFLUX_WRITER_H
@@ -0,0 +1,70 @@
+/**
+ * @file iram_profile.h
+ * @brief Radio, ring and ISR hot paths placed in IRAM/DRAM by the [env:iram] build
+ *
+ * Code runs from flash through a 32 KB cache per core. A miss costs a
+ * flash read, and while esp_partition_write() or an NVS commit programs
+ * flash the cache is off altogether: both cores then run only what is in
+ * IRAM, and only interrupts registered with ESP_INTR_FLAG_IRAM fire. A
+ * receive callback or a counter ISR that lives in flash waits that out.
+ *
+ * With IRAM_HOT_PATHS=1 the functions marked HOT_IRAM_ATTR are linked
+ * into IRAM:
+ *
+ *   espnow_link   recv_cb, send_cb (the Wi-Fi task's copy into the rings)
+ *   spsc_ring     acquire, commit, front, release, count, space
+ *   boot_trace    boot_trace_first_tx (called from send_cb)
+ *   rain_gauge    tip_isr, registered ESP_INTR_FLAG_IRAM so tips count through a flash write
+ *
+ * The data they touch is static .bss and .data, which is always in DRAM;
+ * a const table read from one of them would need DRAM_ATTR, or it stays
+ * in flash rodata.
+ *
+ * sdkconfig.iram.defaults adds the driver side: gpio_set_intr_type() in
+ * IRAM for tip_isr, the PCNT and continuous ADC ISRs kept running with
+ * the cache off, so the anemometer's overflow watch point and the ADC
+ * stream's DMA callbacks are not deferred either.
+ *
+ * IRAM is scarce (the Wi-Fi and FreeRTOS hot paths already take most of
+ * it), so a function goes on the list only when it runs per frame or per
+ * interrupt. scripts/iram_audit.py checks the link map after every
+ * [env:iram] build and fails it if a listed function was linked into
+ * flash, or its data into flash rodata. The rx_path and rx_path_flash
+ * cases of [env:bench] and [env:bench-iram] show the receive path with
+ * and without the profile.
+ *
+ * With IRAM_HOT_PATHS=0 the attribute is empty and the linker places
+ * everything as before.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef IRAM_PROFILE_H
+#define IRAM_PROFILE_H
+
+#include "esp_attr.h"
+#include "esp_intr_alloc.h"
+#include "sdkconfig.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef IRAM_HOT_PATHS
+#define IRAM_HOT_PATHS 0                        // 1: hot paths in IRAM; needs sdkconfig.iram.defaults
+#endif
+
+#if IRAM_HOT_PATHS != 0
+#if !defined(CONFIG_GPIO_CTRL_FUNC_IN_IRAM) || !defined(CONFIG_PCNT_ISR_IRAM_SAFE)
+#error "IRAM_HOT_PATHS needs the driver options of sdkconfig.iram.defaults ([env:iram])"
+#endif
+#define HOT_IRAM_ATTR IRAM_ATTR
+#define HOT_INTR_FLAGS ESP_INTR_FLAG_IRAM       // Keep firing while the flash cache is off
+#else
+#define HOT_IRAM_ATTR
+#define HOT_INTR_FLAGS 0
+#endif
+
+#endif // IRAM_PROFILE_H
@@ -0,0 +1,116 @@
+/**
+ * @file json_reader.h
+ * @brief Incremental (push) JSON tokenizer with constant memory use
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define JSON_READER_MAX_KEY 32                  // Longest member name, including terminator
+#define JSON_READER_MAX_TOKEN 128               // Longest scalar value, including terminator
+#define JSON_READER_MAX_DEPTH 16                // Deepest object/array nesting
+
+/**
+ * @brief Kinds of event reported while a document is fed in
+ */
+typedef enum {
+    JSON_EVENT_OBJECT_BEGIN,
+    JSON_EVENT_OBJECT_END,
+    JSON_EVENT_ARRAY_BEGIN,
+    JSON_EVENT_ARRAY_END,
+    JSON_EVENT_STRING,                          // value holds the unescaped UTF-8 string
+    JSON_EVENT_NUMBER,                          // value holds the number as written
+    JSON_EVENT_BOOL,                            // value is "true" or "false"
+    JSON_EVENT_NULL
+} json_event_type_t;
+
+/**
+ * @brief One parser event
+ */
+typedef struct {
+    json_event_type_t type;
+    const char *key;                            // Member name for values and begin events inside an object, else NULL
+    const char *value;                          // Scalar text, NULL for container events
+    size_t value_len;
+    uint8_t depth;                              // Nesting depth of the value; 1 = member of the root object
+} json_event_t;
+
+/**
+ * @brief Event handler; returning anything but ESP_OK stops the parse with that error
+ */
+typedef esp_err_t (*json_event_fn_t)(void *ctx, const json_event_t *event);
+
+/**
+ * @brief Tokenizer state; lives on the caller's stack
+ */
+typedef struct {
+    json_event_fn_t on_event;
+    void *ctx;
+    esp_err_t err;                              // First error seen; further input is ignored
+    uint8_t state;
+    uint8_t depth;
+    uint16_t array_mask;                        // Bit n set = container at depth n+1 is an array
+    bool string_is_key;
+    bool has_key;
+    uint8_t unicode_digits;                     // Hex digits collected for a \uXXXX escape
+    uint16_t unicode_value;
+    char key[JSON_READER_MAX_KEY];
+    char token[JSON_READER_MAX_TOKEN];
+    size_t token_len;
+    size_t key_len;
+} json_reader_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Prepare a tokenizer for a new document
+ *
+ * @param r Tokenizer to initialise
+ * @param on_event Called for every value and container boundary
+ * @param ctx Passed through to on_event
+ */
+void json_reader_init(json_reader_t *r, json_event_fn_t on_event, void *ctx);
+
+/**
+ * @brief Feed the next piece of the document; pieces may split tokens anywhere
+ *
+ * @param r Tokenizer
+ * @param data Next bytes of the document
+ * @param len Number of bytes
+ * @return esp_err_t ESP_OK to continue, ESP_ERR_INVALID_ARG on malformed input,
+ *         ESP_ERR_INVALID_SIZE if a key, value or nesting limit is exceeded,
+ *         or the handler's error
+ */
+esp_err_t json_reader_feed(json_reader_t *r, const char *data, size_t len);
+
+/**
+ * @brief Check that the input formed exactly one complete document
+ *
+ * @param r Tokenizer
+ * @return esp_err_t ESP_OK if complete, the first error otherwise
+ */
+esp_err_t json_reader_finish(json_reader_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_READER_H
@@ -0,0 +1,185 @@
+/**
+ * @file json_writer.h
+ * @brief Streaming JSON emitter with a fixed scratch buffer
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_http_server.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define JSON_WRITER_BUF_SIZE 512                // Scratch buffer flushed whenever it fills
+#define JSON_WRITER_MAX_DEPTH 16                // Deepest object/array nesting
+
+/**
+ * @brief Sink for completed output
+ *
+ * Called with each full scratch buffer and once more with (NULL, 0) from
+ * json_writer_finish() to signal the end of the document.
+ */
+typedef esp_err_t (*json_flush_fn_t)(void *ctx, const char *data, size_t len);
+
+/**
+ * @brief Writer state; lives on the caller's stack
+ */
+typedef struct {
+    char buf[JSON_WRITER_BUF_SIZE];
+    size_t len;                                 // Bytes pending in buf
+    json_flush_fn_t flush;
+    void *ctx;
+    esp_err_t err;                              // First error seen; later calls become no-ops
+    uint8_t depth;                              // Current nesting depth
+    uint32_t has_items;                         // Bit n set = container at depth n already has a member
+    bool after_key;                             // A key was written, its value comes next
+} json_writer_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Prepare a writer that hands output to a flush callback
+ *
+ * @param w Writer to initialise
+ * @param flush Sink for completed output
+ * @param ctx Passed through to flush
+ */
+void json_writer_init(json_writer_t *w, json_flush_fn_t flush, void *ctx);
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief Prepare a writer that streams a chunked "application/json" response
+ *
+ * Sets the content type; json_writer_finish() sends the terminating chunk.
+ *
+ * @param w Writer to initialise
+ * @param req Request to respond to
+ */
+void json_writer_init_httpd(json_writer_t *w, httpd_req_t *req);
+#endif
+
+/**
+ * @brief Flush pending output and end the document
+ *
+ * @param w Writer
+ * @return esp_err_t ESP_OK if the whole document was written, the first error otherwise
+ */
+esp_err_t json_writer_finish(json_writer_t *w);
+
+/**
+ * @brief Open an object ({) as a value
+ */
+void json_obj_begin(json_writer_t *w);
+
+/**
+ * @brief Close the innermost object (})
+ */
+void json_obj_end(json_writer_t *w);
+
+/**
+ * @brief Open an array ([) as a value
+ */
+void json_arr_begin(json_writer_t *w);
+
+/**
+ * @brief Close the innermost array (])
+ */
+void json_arr_end(json_writer_t *w);
+
+/**
+ * @brief Write an object member name; the next call writes its value
+ *
+ * @param w Writer
+ * @param key Member name (escaped)
+ */
+void json_key(json_writer_t *w, const char *key);
+
+/**
+ * @brief Write a string value with full JSON escaping
+ *
+ * @param w Writer
+ * @param value String to write; NULL writes null
+ */
+void json_str(json_writer_t *w, const char *value);
+
+/**
+ * @brief Write a signed integer value
+ */
+void json_int(json_writer_t *w, int64_t value);
+
+/**
+ * @brief Write an unsigned integer value
+ */
+void json_uint(json_writer_t *w, uint64_t value);
+
+/**
+ * @brief Write a number with a fixed number of decimals (NaN/Inf write null)
+ *
+ * @param w Writer
+ * @param value Number to write
+ * @param decimals Digits after the decimal point
+ */
+void json_double(json_writer_t *w, double value, int decimals);
+
+/**
+ * @brief Write true or false
+ */
+void json_bool(json_writer_t *w, bool value);
+
+/**
+ * @brief Write null
+ */
+void json_null(json_writer_t *w);
+
+/**
+ * @brief Write a string value of a hex dump of binary data (uppercase)
+ *
+ * @param w Writer
+ * @param data Bytes to encode
+ * @param len Number of bytes
+ */
+void json_hex(json_writer_t *w, const uint8_t *data, size_t len);
+
+/**
+ * @brief Write "key":"value"
+ */
+void json_kv_str(json_writer_t *w, const char *key, const char *value);
+
+/**
+ * @brief Write "key":value for a signed integer
+ */
+void json_kv_int(json_writer_t *w, const char *key, int64_t value);
+
+/**
+ * @brief Write "key":value for an unsigned integer
+ */
+void json_kv_uint(json_writer_t *w, const char *key, uint64_t value);
+
+/**
+ * @brief Write "key":true|false
+ */
+void json_kv_bool(json_writer_t *w, const char *key, bool value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,125 @@
+/**
+ * @file latest_values.h
+ * @brief Gateway per-node latest readings behind a seqlock, for readers that only want the current value
+ *
+ * The web handlers, the NMEA sentences and /api/latest want each node's
+ * newest reading, not every record. The link task is the only writer: it
+ * stores the newest record of each telemetry frame into the node's slot.
+ * It never waits. It makes the slot's sequence odd, writes the reading and
+ * makes it even again. A reader copies the slot between two reads of the
+ * sequence and retries while it was odd or changed, so a torn copy is
+ * never returned. Readers take no lock and disable no interrupts, so any
+ * number of them run without holding up ingest.
+ *
+ * Each slot starts on its own LATEST_VALUES_ALIGN boundary, so no cache
+ * line holds parts of two nodes and a write to one never disturbs readers
+ * of another. That matters only for memory reached through the data cache; in
+ * internal SRAM it costs a few padding bytes.
+ *
+ * Slots are handed out on first report and never reused, as in
+ * node_table.h; a node beyond LATEST_VALUES_MAX_NODES is not kept.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef LATEST_VALUES_H
+#define LATEST_VALUES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "json_writer.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define LATEST_VALUES_MAX_NODES 48              // As NODE_TABLE_MAX_NODES
+#define LATEST_VALUES_ALIGN 32                  // Slot boundary: the ESP32-S3 data cache line
+#define LATEST_VALUES_SPINS 16                  // Torn reads retried at once before the reader sleeps a tick
+#define LATEST_VALUES_STALE_MS 300000           // An older reading gives way to a record dated earlier
+
+/**
+ * @brief One node's newest reading, as copied out
+ */
+typedef struct {
+    uint32_t node_id;
+    uint32_t rx_ms;                             // Uptime when the gateway stored it
+    telemetry_record_t rec;
+} latest_value_t;
+
+/**
+ * @brief Counters, for /api/latest
+ */
+typedef struct {
+    uint32_t nodes;                             // Slots in use
+    uint32_t writes;
+    uint32_t skipped;                           // Records older than the node's current reading
+    uint32_t overflows;                         // Records from nodes beyond LATEST_VALUES_MAX_NODES
+    uint32_t reads;
+    uint32_t retries;                           // Reads that met a write in progress
+} latest_values_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Store a node's newest record; link task only
+ *
+ * Taken if it is no older than the stored one (backlog replays are not),
+ * or once the stored one is LATEST_VALUES_STALE_MS old.
+ *
+ * @param node_id Sending node
+ * @param rec Decoded record
+ */
+void latest_values_put(uint32_t node_id, const telemetry_record_t *rec);
+
+/**
+ * @brief Copy a node's newest reading; any task, not from an ISR
+ *
+ * @return bool false if the node has not reported
+ */
+bool latest_values_get(uint32_t node_id, latest_value_t *out);
+
+/**
+ * @brief Copy the reading stored last, whichever node sent it
+ *
+ * @return bool false before the first reading
+ */
+bool latest_values_newest(latest_value_t *out);
+
+/**
+ * @brief Nodes with a reading
+ */
+size_t latest_values_count(void);
+
+/**
+ * @brief Copy the nth node's reading (0 .. latest_values_count() - 1, in order of first report)
+ *
+ * @return bool false past the last node
+ */
+bool latest_values_get_nth(size_t n, latest_value_t *out);
+
+/**
+ * @brief Copy the counters
+ */
+void latest_values_get_stats(latest_values_stats_t *stats);
+
+/**
+ * @brief Write every node's reading and the counters as JSON, for /api/latest
+ */
+void latest_values_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LATEST_VALUES_H
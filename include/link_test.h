@@ -0,0 +1,111 @@
+/**
+ * @file link_test.h
+ * @brief Paired ESP-NOW throughput/latency test between two boards
+ *
+ * Selected through device_role in NVS: a DEVICE_ROLE_LINK_TEST_TX board
+ * drives the test and a DEVICE_ROLE_LINK_TEST_RX board answers it. The
+ * test runs on raw ESP-NOW, unencrypted and without espnow_link or the
+ * reliable layer, so it measures the link itself.
+ *
+ * The initiator finds the reflector with a broadcast hello on the home
+ * settings, then works through a sweep. Each step changes one setting
+ * away from the home settings: payload size, PHY rate, TX power, then
+ * channel. Sweeping every combination would take hundreds of steps.
+ * Both boards switch to a step's settings after the reflector acknowledges
+ * it. A reflector that hears nothing for LINK_TEST_IDLE_RESET_MS returns
+ * to the home settings, so a lost acknowledgement costs one step, not the
+ * rest of the run. Each step has two phases:
+ *
+ *   rtt     LINK_TEST_RTT_FRAMES unicast frames, one at a time, each echoed back
+ *           at the same size: round-trip percentiles and echoes lost
+ *   flood   LINK_TEST_FLOOD_FRAMES unicast frames back to back, each sent once
+ *           the previous send callback fired: frames/s, goodput, MAC failures
+ *           (no ACK after the driver's retries) and, from the reflector's
+ *           count, frames lost end to end
+ *
+ * The initiator logs one line per step, then the fastest step with loss
+ * under LINK_TEST_GOOD_LOSS_PERMILLE. It rests for LINK_TEST_PAUSE_MS and
+ * runs the sweep again.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef LINK_TEST_H
+#define LINK_TEST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define LINK_TEST_HOME_CHANNEL 1                // Where the boards meet, and return to between steps
+#define LINK_TEST_HOME_POWER 78                 // 0.25 dBm units: 19.5 dBm, the driver maximum
+#define LINK_TEST_RTT_FRAMES 100
+#define LINK_TEST_RTT_TIMEOUT_MS 50             // Echo counted lost after this
+#define LINK_TEST_FLOOD_FRAMES 500
+#define LINK_TEST_SEND_TIMEOUT_MS 100           // Wait for the send callback
+#define LINK_TEST_CTRL_TIMEOUT_MS 200           // Wait for a control reply
+#define LINK_TEST_CTRL_RETRIES 5
+#define LINK_TEST_SETTLE_MS 20                  // After switching channel, rate or power
+#define LINK_TEST_IDLE_RESET_MS 2000            // Reflector returns to the home settings after this much silence
+#define LINK_TEST_HELLO_INTERVAL_MS 500
+#define LINK_TEST_PAUSE_MS 10000                // Between sweeps
+#define LINK_TEST_GOOD_LOSS_PERMILLE 10         // Steps above this loss are not recommended
+#define LINK_TEST_RX_QUEUE_LEN 32
+
+/**
+ * @brief One sweep step as measured by the initiator
+ */
+typedef struct {
+    uint8_t channel;
+    uint8_t rate;                               // Index into the rate table; see link_test_rate_name()
+    int8_t power;                               // 0.25 dBm units
+    uint16_t payload_len;
+    bool completed;                             // The reflector followed the step; the rest is valid
+    uint16_t rtt_p50_us;
+    uint16_t rtt_p90_us;
+    uint16_t rtt_p99_us;
+    uint16_t rtt_lost;
+    uint32_t frames_per_s;
+    uint32_t goodput_kbps;                      // Payload bits delivered per second
+    uint16_t mac_failures;                      // Send callbacks reporting failure
+    uint16_t lost_permille;                     // Flood frames the reflector never counted
+    int8_t rssi;                                // Mean RSSI of the echoes
+} link_test_step_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Bring the radio up on the home channel and start ESP-NOW for the test
+ *
+ * @param initiator true for DEVICE_ROLE_LINK_TEST_TX, false for DEVICE_ROLE_LINK_TEST_RX
+ * @return esp_err_t ESP_OK, or the WiFi/ESP-NOW error
+ */
+esp_err_t link_test_init(bool initiator);
+
+/**
+ * @brief Main loop body: one full sweep on the initiator, one received frame (or idle check) on the reflector
+ */
+void link_test_main(void);
+
+/**
+ * @brief Name of a PHY rate index, e.g. "1M" or "MCS7"
+ */
+const char *link_test_rate_name(uint8_t rate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LINK_TEST_H
@@ -0,0 +1,138 @@
+/**
+ * @file log_policy.h
+ * @brief Per-subsystem runtime log levels and token-bucket rate limiting
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef LOG_POLICY_H
+#define LOG_POLICY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define LOG_POLICY_DEFAULT_BOOST_S 300          // Length of a temporary level change when none is given
+#define LOG_POLICY_MAX_BOOST_S 3600             // Longest temporary level change
+#define LOG_POLICY_ALL_TAGS "*"                 // Applies a change to every known subsystem
+
+/**
+ * @brief Token bucket for one noisy log call site
+ *
+ * Declare it static next to the call site with LOG_RATE_LIMIT_INIT().
+ */
+typedef struct {
+    uint16_t burst;                             // Messages allowed back to back
+    uint16_t refill_ms;                         // Time to earn one more message
+    uint16_t tokens;
+    int64_t last_refill_us;
+    uint32_t suppressed;                        // Messages dropped since the last one let through
+} log_rate_limit_t;
+
+#define LOG_RATE_LIMIT_INIT(burst_, refill_ms_) \
+    { .burst = (burst_), .refill_ms = (refill_ms_), .tokens = (burst_), .last_refill_us = 0, .suppressed = 0 }
+
+/**
+ * @brief Log through a token bucket; drops are counted and reported with the next message
+ *
+ * Nothing is consumed while the level is disabled for the tag.
+ */
+#define LOG_RATE_LIMITED(bucket, level, tag, format, ...) do {                                  \
+        uint32_t log_dropped_;                                                                  \
+        if (esp_log_level_get(tag) >= (level) && log_rate_allow(&(bucket), &log_dropped_)) {   \
+            if (log_dropped_ > 0) {                                                             \
+                ESP_LOG_LEVEL_LOCAL(level, tag, "(%lu similar messages suppressed)",            \
+                                    (unsigned long)log_dropped_);                               \
+            }                                                                                   \
+            ESP_LOG_LEVEL_LOCAL(level, tag, format, ##__VA_ARGS__);                             \
+        }                                                                                       \
+    } while (0)
+
+#define ESP_LOGW_RATE(bucket, tag, format, ...) LOG_RATE_LIMITED(bucket, ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI_RATE(bucket, tag, format, ...) LOG_RATE_LIMITED(bucket, ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+
+/**
+ * @brief Current log policy of one subsystem
+ */
+typedef struct {
+    const char *tag;                            // Log tag of the subsystem
+    esp_log_level_t default_level;              // Level applied at boot and after a boost expires
+    esp_log_level_t level;                      // Level in effect now
+    uint32_t boost_remaining_s;                 // Seconds until level reverts, 0 if not boosted
+} log_policy_entry_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Apply the default level of every known subsystem
+ *
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t log_policy_init(void);
+
+/**
+ * @brief Change the level of a subsystem, optionally for a limited time
+ *
+ * @param tag Subsystem log tag, or LOG_POLICY_ALL_TAGS
+ * @param level New level
+ * @param duration_s Seconds before the default level returns (capped at
+ *        LOG_POLICY_MAX_BOOST_S); 0 makes the level the new default until reboot
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_FOUND for an unknown tag
+ */
+esp_err_t log_policy_set_level(const char *tag, esp_log_level_t level, uint32_t duration_s);
+
+/**
+ * @brief Number of subsystems under the policy
+ */
+size_t log_policy_count(void);
+
+/**
+ * @brief Read the policy of one subsystem
+ *
+ * @param index 0 .. log_policy_count() - 1
+ * @param entry Receives the policy
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG for a bad index or NULL entry
+ */
+esp_err_t log_policy_get(size_t index, log_policy_entry_t *entry);
+
+/**
+ * @brief Lowercase name of a level ("none", "error", "warn", "info", "debug", "verbose")
+ */
+const char *log_policy_level_name(esp_log_level_t level);
+
+/**
+ * @brief Parse a level name as returned by log_policy_level_name()
+ *
+ * @param name Level name
+ * @param level Receives the level
+ * @return true if the name is known
+ */
+bool log_policy_level_from_name(const char *name, esp_log_level_t *level);
+
+/**
+ * @brief Take a token from a bucket (used by LOG_RATE_LIMITED)
+ *
+ * @param bucket Call-site bucket
+ * @param suppressed Receives the number of messages dropped since the last allowed one
+ * @return true if the message may be logged
+ */
+bool log_rate_allow(log_rate_limit_t *bucket, uint32_t *suppressed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOG_POLICY_H
@@ -0,0 +1,116 @@
+/**
+ * @file long_op.h
+ * @brief Long flash and filesystem operations in bounded slices that yield and feed the task watchdog
+ *
+ * A partition erase or a loop of filesystem reads can hold its task for
+ * seconds. Split into steps, it calls long_op_step() between them; once
+ * the current slice has run LONG_OP_SLICE_BUDGET_MS, the step ends it:
+ * it feeds the task watchdog if the task is subscribed, and sleeps a tick
+ * so every lower-priority task on the core (the idle task that feeds the
+ * watchdog too) gets to run. Short operations never reach the budget and
+ * cost nothing.
+ *
+ * Erases go one 64 KB flash block at a time (long_op_erase()), so the chip
+ * still uses its block erase; ESP-IDF additionally yields inside each one
+ * (CONFIG_SPI_FLASH_YIELD_DURING_ERASE).
+ *
+ * The longest slice each kind of operation took is kept and reported as
+ * METRIC_LONG_OP_SLICES, so a step that is too coarse shows up there.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef LONG_OP_H
+#define LONG_OP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define LONG_OP_SLICE_BUDGET_MS 20              // A slice ends at the first step past this
+#define LONG_OP_ERASE_STEP (64 * 1024)          // One flash block per erase call
+#define LONG_OP_READ_STEP 4096                  // Bytes per fread for whole-file loads
+
+/**
+ * @brief Kinds of long operation, each with its own counters
+ */
+typedef enum {
+    LONG_OP_OTA_ERASE,                          // OTA target partition
+    LONG_OP_LOG_ERASE,                          // Formatting the backlog or metric history region
+    LONG_OP_FILE_LOAD,                          // Whole files into RAM (asset cache)
+    LONG_OP_HISTORY_SCAN,                       // Local history segments (ts_store)
+    LONG_OP_COUNT
+} long_op_t;
+
+/**
+ * @brief One operation in progress; on the caller's stack
+ */
+typedef struct {
+    long_op_t op;
+    int64_t run_start_us;
+    int64_t slice_start_us;
+    uint32_t slices;
+} long_op_slice_t;
+
+/**
+ * @brief One kind's counters since boot
+ */
+typedef struct {
+    uint32_t runs;                              // Operations finished
+    uint32_t slices;                            // Slices over all runs
+    uint32_t max_slice_us;                      // Longest slice: the worst the task held its core
+    uint32_t max_run_ms;                        // Longest operation, start to end
+} long_op_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Register METRIC_LONG_OP_SLICES; once, after system_metrics_init()
+ */
+void long_op_init(void);
+
+/**
+ * @brief Start timing an operation and its first slice
+ */
+void long_op_begin(long_op_slice_t *s, long_op_t op);
+
+/**
+ * @brief Between two steps: end the slice and yield once it has run its budget
+ */
+void long_op_step(long_op_slice_t *s);
+
+/**
+ * @brief Record the last slice and the operation
+ */
+void long_op_end(long_op_slice_t *s);
+
+/**
+ * @brief esp_partition_erase_range() in block-sized slices
+ *
+ * @return esp_err_t The first erase error, or ESP_OK
+ */
+esp_err_t long_op_erase(const esp_partition_t *part, size_t offset, size_t len, long_op_t op);
+
+/**
+ * @brief Copy one kind's counters
+ */
+void long_op_get_stats(long_op_t op, long_op_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LONG_OP_H
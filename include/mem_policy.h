@@ -0,0 +1,119 @@
+/**
+ * @file mem_policy.h
+ * @brief Capability-aware allocation: large buffers in PSRAM when the board has it, internal RAM otherwise
+ *
+ * WROVER gateways carry 4 MB of PSRAM beside the 320 KB of internal RAM;
+ * WROOM boards have none. The firmware is the same for both: PSRAM is
+ * brought up at boot when it answers (CONFIG_SPIRAM_IGNORE_NOTFOUND) and
+ * left out of malloc() (CONFIG_SPIRAM_USE_CAPS_ALLOC), so nothing lands
+ * there unless it asks.
+ *
+ * MEM_BULK is for large buffers read and written by tasks at memory
+ * speed, where PSRAM's slower access over the SPI cache does not matter:
+ *
+ *   ts_store        pending history records
+ *   asset_cache     cached web assets
+ *   mqtt_forwarder  per-node topics, open batches and broker claims
+ *   ota_manager     write blocks and the inflate window (heap builds)
+ *
+ * It tries PSRAM first and falls back to internal RAM, so a WROOM board
+ * behaves as before. Flash writes from a PSRAM buffer go through the
+ * flash driver's internal bounce buffer, since PSRAM is unreadable while
+ * the cache is off. MEM_INTERNAL is for everything DMA or an ISR
+ * touches, and for anything used while the flash cache is off (the
+ * receive rings of espnow_link.c, the SD archive's DMA buffers): PSRAM
+ * is behind the same cache. Both are released with free().
+ *
+ * On WROVER modules PSRAM uses GPIO16 and GPIO17. mem_policy_pin_taken()
+ * lets a driver that defaults to one of them (GPS receive, NMEA transmit)
+ * step aside instead of taking the PSRAM bus.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef MEM_POLICY_H
+#define MEM_POLICY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define MEM_POLICY_PSRAM_CS_GPIO 16             // WROVER PSRAM chip select
+#define MEM_POLICY_PSRAM_CLK_GPIO 17            // WROVER PSRAM clock
+
+/**
+ * @brief Where an allocation may go
+ */
+typedef enum {
+    MEM_INTERNAL,                               // Internal RAM only: DMA, ISR and cache-off users
+    MEM_BULK,                                   // PSRAM when present, internal RAM otherwise
+} mem_class_t;
+
+/**
+ * @brief Allocation counters since boot
+ */
+typedef struct {
+    bool psram;                                 // PSRAM found at boot
+    uint32_t psram_total;                       // Bytes
+    uint32_t psram_free;
+    uint32_t bulk_psram_allocs;                 // MEM_BULK allocations served from PSRAM
+    uint32_t bulk_psram_bytes;
+    uint32_t bulk_internal_allocs;              // MEM_BULK allocations served from internal RAM
+    uint32_t bulk_internal_bytes;
+    uint32_t fallbacks;                         // Of those, ones that found PSRAM full
+} mem_policy_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Look for PSRAM and log what was found
+ *
+ * Call once at boot, before the modules that allocate MEM_BULK buffers.
+ *
+ * @return esp_err_t ESP_OK
+ */
+esp_err_t mem_policy_init(void);
+
+/**
+ * @brief True when PSRAM was found at boot
+ */
+bool mem_policy_psram(void);
+
+/**
+ * @brief Allocate size bytes of cls; NULL when neither heap has room
+ */
+void *mem_policy_malloc(mem_class_t cls, size_t size);
+
+/**
+ * @brief Allocate a zeroed array of n elements of size bytes of cls
+ */
+void *mem_policy_calloc(mem_class_t cls, size_t n, size_t size);
+
+/**
+ * @brief True when gpio is wired to the PSRAM found at boot and must not be reconfigured
+ */
+bool mem_policy_pin_taken(int gpio);
+
+/**
+ * @brief Copy the counters
+ */
+void mem_policy_get_stats(mem_policy_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEM_POLICY_H
@@ -0,0 +1,121 @@
+/**
+ * @file metric_history.h
+ * @brief Fixed-record ring log of key metrics in a dedicated flash partition
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef METRIC_HISTORY_H
+#define METRIC_HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define METRIC_HISTORY_PARTITION "history"      // Label in partitions.csv
+#ifndef METRIC_HISTORY_INTERVAL_S
+#define METRIC_HISTORY_INTERVAL_S 60            // Sampling period (override via build flag)
+#endif
+#define METRIC_HISTORY_BATCH 8                  // Records buffered per flash write (one 256-byte page)
+#define METRIC_HISTORY_MAX_QUERY 512            // Records returned by one query
+
+// Record flags: which optional fields hold a reading
+#define METRIC_HISTORY_HAS_RSSI (1 << 0)
+#define METRIC_HISTORY_HAS_VDD (1 << 1)
+#define METRIC_HISTORY_HAS_TEMPERATURE (1 << 2)
+
+/**
+ * @brief One sample as stored in flash; 32 bytes, so a sector holds 128
+ *
+ * seq counts up across reboots and fixes the record's slot (seq modulo the
+ * ring capacity), so records can be found without an index.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t seq;
+    uint32_t boot;                              // Boot count when recorded
+    uint32_t uptime_s;
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    uint32_t largest_block;                     // Largest free internal block
+    uint16_t vdd_mv;
+    int16_t temperature_c10;                    // Tenths of a degree Celsius
+    int8_t rssi;                                // dBm
+    uint8_t flags;                              // METRIC_HISTORY_HAS_*
+    uint16_t crc;                               // CRC-16 of the bytes before it
+} metric_history_record_t;
+
+/**
+ * @brief Extent of the stored history
+ */
+typedef struct {
+    bool ready;                                 // Partition found and scanned
+    uint32_t capacity;                          // Records the ring holds
+    uint32_t oldest_seq;                        // First seq that may still be readable
+    uint32_t next_seq;                          // Seq the next sample gets
+    uint32_t pending;                           // Samples buffered, not yet in flash
+} metric_history_info_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Find the partition, locate the ring head and start sampling
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND without a history partition, or the flash/task error
+ */
+esp_err_t metric_history_start(void);
+
+/**
+ * @brief Write buffered samples to flash now
+ *
+ * Also runs from a shutdown handler, so a clean restart loses nothing.
+ *
+ * @return esp_err_t ESP_OK, or the flash error
+ */
+esp_err_t metric_history_flush(void);
+
+/**
+ * @brief Report the stored range
+ */
+void metric_history_get_info(metric_history_info_t *info);
+
+/**
+ * @brief Read records by sequence number
+ *
+ * Slots that were erased, torn by a power cut or overwritten are skipped.
+ *
+ * @param from_seq First seq wanted
+ * @param records Receives up to max records in seq order
+ * @param max Capacity of records
+ * @param next_seq Receives the seq to continue from; may be NULL
+ * @return Number of records written
+ */
+size_t metric_history_read(uint32_t from_seq, metric_history_record_t *records, size_t max, uint32_t *next_seq);
+
+/**
+ * @brief Write up to count records from from_seq as a JSON object
+ *
+ * @param w Writer positioned where a value is expected
+ * @param from_seq First seq wanted
+ * @param count Records wanted, capped at METRIC_HISTORY_MAX_QUERY
+ */
+void metric_history_write_json(json_writer_t *w, uint32_t from_seq, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRIC_HISTORY_H
@@ -0,0 +1,174 @@
+/**
+ * @file metrics_export.h
+ * @brief Prometheus/OpenMetrics text exposition of the system metrics
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef METRICS_EXPORT_H
+#define METRICS_EXPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "gzip_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define METRICS_EXPORT_URI "/metrics"
+#define METRICS_EXPORT_PREFIX "esp32_"          // Prepended to every family name
+#define METRICS_EXPORT_BUF_SIZE 1024             // Scratch buffer sent as one chunk whenever it fills
+#define METRICS_EXPORT_MAX_SOURCES 8             // Application families added at run time
+#ifndef METRICS_EXPORT_SOURCES
+#define METRICS_EXPORT_SOURCES 1                 // 0: no /metrics to scrape; sources are dropped unlinked
+#endif
+#define METRICS_EXPORT_LABEL_MAX 64              // Longest escaped label value
+#define METRICS_EXPORT_SCHEMA_URI "/api/metrics/schema"
+#define METRICS_EXPORT_SCHEMA_MAX_AGE "31536000" // A year; the URL names the schema version
+
+/**
+ * @brief Family types; the text format decides how each is spelled
+ */
+typedef enum {
+    METRICS_EXPORT_GAUGE,
+    METRICS_EXPORT_COUNTER,                     // Samples are named <family>_total
+    METRICS_EXPORT_INFO,                        // One sample <family>_info{...} 1
+    METRICS_EXPORT_HISTOGRAM                    // _bucket{le=...}, _sum and _count samples
+} metrics_export_type_t;
+
+/**
+ * @brief Response state; lives on the handler's stack
+ */
+typedef struct {
+    char buf[METRICS_EXPORT_BUF_SIZE];
+    size_t len;                                 // Bytes pending in buf
+    httpd_req_t *req;
+    gzip_stream_t *gz;                          // Body compressed through it (http_gzip.h), or NULL
+    bool openmetrics;                           // OpenMetrics 1.0 rather than Prometheus text 0.0.4
+    esp_err_t err;                              // First send error; later writes become no-ops
+} metrics_export_writer_t;
+
+/**
+ * @brief Writes the families of one application module (sensors, ESP-NOW peers, ...)
+ */
+typedef void (*metrics_export_source_fn)(metrics_export_writer_t *w);
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Add a module's families to every scrape
+ *
+ * Sources run after the built-in families, in registration order. Each must
+ * write complete families: metrics_export_family() followed by all of its
+ * samples.
+ *
+ * @param source Writer for the module's families
+ * @return esp_err_t ESP_OK, or ESP_ERR_NO_MEM when METRICS_EXPORT_MAX_SOURCES are registered
+ */
+#if METRICS_EXPORT_SOURCES
+esp_err_t metrics_export_add_source(metrics_export_source_fn source);
+#else
+static inline esp_err_t metrics_export_add_source(metrics_export_source_fn source) {
+    (void)source;                               // Never referenced, so the linker drops it
+    return ESP_OK;
+}
+#endif
+
+/**
+ * @brief Answer a scrape with every family, one chunk per full buffer
+ *
+ * The format follows the Accept header: OpenMetrics when the scraper asks
+ * for application/openmetrics-text, Prometheus text 0.0.4 otherwise. Every
+ * system_metric_t is read in one system_metrics_collect() batch; numbers
+ * become gauges in base units, text values become info families,
+ * unavailable metrics are left out.
+ *
+ * @param req Request to respond to
+ * @return esp_err_t ESP_OK, or the first send error
+ */
+esp_err_t metrics_export_handler(httpd_req_t *req);
+
+/**
+ * @brief Answer GET /api/metrics/schema: name, unit, group, TTL and description of every metric
+ *
+ *   {"version":"1c0ffee5","groups":["system","memory",...],
+ *    "metrics":[{"id":0,"name":"cpu_frequency","unit":"MHz","group":"system",
+ *                "ttlMs":null,"description":"CPU frequency in MHz"},...]}
+ *
+ * ttlMs is null for a metric read once at boot and 0 for one read on
+ * every request. The schema only changes with the firmware, so a request
+ * for ?v=<current version> is served as immutable for a year; any other
+ * request is redirected there with 302, which lets a page keep one copy
+ * per firmware and still notice an update.
+ *
+ * @param req Request to respond to
+ * @return esp_err_t ESP_OK, or the first send error
+ */
+esp_err_t metrics_export_schema_handler(httpd_req_t *req);
+
+/**
+ * @brief Version of the schema: CRC-32 of its body as 8 hex digits
+ *
+ * Worked out on the first call. GET /api/metrics reports it, so a page
+ * holding an older schema knows to fetch it again.
+ */
+const char *metrics_export_schema_version(void);
+
+/**
+ * @brief Start a family: its TYPE, UNIT and HELP lines
+ *
+ * @param w Writer
+ * @param name Family name without METRICS_EXPORT_PREFIX or _total/_info; ends in the unit if it has one
+ * @param type Family type
+ * @param unit Base unit ("bytes", "seconds", ...), or NULL
+ * @param help One-line description, or NULL
+ */
+void metrics_export_family(metrics_export_writer_t *w, const char *name, metrics_export_type_t type,
+                           const char *unit, const char *help);
+
+/**
+ * @brief Write one sample with a floating-point value
+ *
+ * @param w Writer
+ * @param name Family name as given to metrics_export_family()
+ * @param suffix "_total", "_bucket", "_sum", "_count", "_info", or "" for a gauge
+ * @param labels Label pairs such as iface="ap",core="0" with escaped values, or NULL
+ * @param value Sample value
+ */
+void metrics_export_sample(metrics_export_writer_t *w, const char *name, const char *suffix,
+                           const char *labels, double value);
+
+/**
+ * @brief Write one sample with an exact integer value
+ *
+ * Same parameters as metrics_export_sample().
+ */
+void metrics_export_sample_int(metrics_export_writer_t *w, const char *name, const char *suffix,
+                               const char *labels, int64_t value);
+
+/**
+ * @brief Escape a string for use as a label value (backslash, quote, newline)
+ *
+ * @param out Output buffer; truncated output stays valid
+ * @param out_len Size of out
+ * @param value String to escape
+ * @return out
+ */
+const char *metrics_export_escape(char *out, size_t out_len, const char *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_EXPORT_H
@@ -0,0 +1,106 @@
+/**
+ * @file metrics_stream.h
+ * @brief WebSocket push stream of live system metrics
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef METRICS_STREAM_H
+#define METRICS_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define METRICS_STREAM_URI "/ws/metrics"
+#ifndef METRICS_STREAM_INTERVAL_MS
+#define METRICS_STREAM_INTERVAL_MS 5000         // Default sampling period (override via build flag)
+#endif
+#define METRICS_STREAM_MIN_INTERVAL_MS 1000     // Fastest rate a client may request
+#define METRICS_STREAM_MAX_INTERVAL_MS 60000    // Slowest rate a client may request
+#define METRICS_STREAM_MAX_CLIENTS 4            // Concurrent WebSocket subscribers
+#define METRICS_STREAM_FRAME_MAX 4096           // Largest frame (a full snapshot of every metric)
+#define METRICS_STREAM_FLEET_FRAME_MAX 8192     // Largest fleet frame: about 40 nodes in full
+#define METRICS_STREAM_OTA_INTERVAL_MS 1000     // Progress event period while an update runs
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Register the WebSocket endpoint and start the sampler task
+ *
+ * One sampler snapshots every metric at the configured rate and pushes only
+ * the values that changed to all subscribers, so the cost does not grow with
+ * the number of clients. New subscribers first receive a full snapshot.
+ * Frames are {"type":"full"|"delta","metrics":[...]} using the same entries
+ * as /api/metrics. Clients may send "interval=<ms>" to change the rate.
+ *
+ * Sampling runs on the httpd task through httpd_queue_work(), so it never
+ * races the HTTP handlers that also read metrics.
+ *
+ * On a gateway the same pass sends the fleet: {"type":"fleet","now":<uptime
+ * ms>,"nodes":[{"i":<n>,...}]}, one entry per node of the node table
+ * (node_table.h) whose fields changed, with only those fields: "id",
+ * "seen" (uptime ms of its last frame), "rssi", "q" (permille received),
+ * "lost", "mv" (supply), "bl" (backlog), "aw" (0.01 % awake) and the
+ * latest reading "t" (0.01 degC), "h" (0.001 %RH), "p" (Pa) and "ts" (Unix
+ * s); null is not reported yet. n never changes for a node. New
+ * subscribers first get every node with every field and its "mac", marked
+ * "full":true. A client sends "metrics=0" or "fleet=0" to stop either
+ * kind of frame (1 turns it back on, starting with a full one), so the
+ * fleet page on a phone is not sent every system metric.
+ *
+ * While an OTA update is running the sampler task also sends
+ * {"type":"ota","ota":{...}} events (the /api/ota fields) every
+ * METRICS_STREAM_OTA_INTERVAL_MS, plus one when it finishes. These go out
+ * straight from the sampler task, because the httpd task is busy inside
+ * the upload handler and could not answer a poll.
+ *
+ * @param server Running HTTP server handle
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t metrics_stream_start(httpd_handle_t server);
+
+/**
+ * @brief Drop all subscribers and stop sampling
+ *
+ * Call before stopping the HTTP server.
+ */
+void metrics_stream_stop(void);
+
+/**
+ * @brief Send an event to every subscriber now, from any task: {"type":"<type>","<type>":<json>}
+ *
+ * For alerts that must not wait for the next sample; a no-op while nobody
+ * is subscribed.
+ *
+ * @param type Event type, e.g. "alert"
+ * @param json Event body, a JSON value
+ * @param len Length of json
+ */
+void metrics_stream_push_event(const char *type, const char *json, size_t len);
+
+/**
+ * @brief Change the sampling period for all subscribers
+ *
+ * @param interval_ms Period in milliseconds, clamped to the MIN/MAX limits
+ */
+void metrics_stream_set_interval(uint32_t interval_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_STREAM_H
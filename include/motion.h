@@ -0,0 +1,134 @@
+/**
+ * @file motion.h
+ * @brief Boat attitude from an ICM-20948 on the shared I2C bus: batched complementary filter at about 100 Hz
+ *
+ * The masthead wind sensors lean with the boat and swing with its roll
+ * and pitch, so what they measure is not the horizontal apparent wind.
+ * This module works out how they are tilted and moving, for the true-wind
+ * correction (true_wind.h).
+ *
+ * The IMU samples its accelerometer and gyroscope at about 100 Hz
+ * (MOTION_RATE_DIVIDER) into its FIFO. The motion task on the application
+ * core wakes every MOTION_BATCH_MS, reads the batch in one I2C burst
+ * through the bus manager (i2c_bus.h) and fuses it:
+ *
+ *   per sample   the gyroscope rates integrate roll and pitch. The Euler
+ *                rate terms use the sines and cosines of the batch's
+ *                starting attitude, so each sample is a few float
+ *                multiply-adds on the FPU and no trigonometry.
+ *   per batch    the mean of the batch's accelerometer readings gives
+ *                the gravity direction. Its roll and pitch pull the
+ *                integrated angles towards it with time constant
+ *                MOTION_FILTER_TAU_MS (the complementary filter).
+ *                Batches whose mean is off 1 g by more than
+ *                MOTION_ACCEL_GATE_PCT are skipped, because a slam or
+ *                a turn would otherwise read as heel.
+ *
+ * The velocity of the masthead due to roll and pitch rate
+ * (MOTION_MAST_HEIGHT_CM above the IMU) is averaged over
+ * MOTION_MAST_AVG_MS, the wind module's gust window, so it can be
+ * taken off the same 3 s wind mean.
+ *
+ * Mounting: IMU X axis to the bow, Y to port, Z up. Roll is positive
+ * with the starboard side down and pitch is positive bow up.
+ *
+ * The task measures its own fusion time, and motion_get_stats() reports
+ * it as a share of the core (about 0.1 % at 100 Hz).
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define MOTION_IMU_ADDRESS 0x69                 // ICM-20948 with AD0 high, as on most breakouts
+#define MOTION_IMU_SPEED_HZ 400000
+#define MOTION_RATE_DIVIDER 10                  // 1125 / 11 = 102.3 Hz
+#define MOTION_BATCH_MS 100                     // FIFO read period: about 10 samples per wake
+#define MOTION_BATCH_MAX 24                     // Samples taken per read; a late wake leaves the rest for the next
+#define MOTION_FILTER_TAU_MS 2000               // Gyroscope below this period, accelerometer above
+#define MOTION_ACCEL_GATE_PCT 15                // Batch mean further than this from 1 g: no accelerometer correction
+#define MOTION_MAST_HEIGHT_CM 1500              // Anemometer height above the IMU
+#define MOTION_MAST_AVG_MS 3000                 // Masthead velocity mean; matches WIND_GUST_S
+#define MOTION_STALE_MS 1000                    // Attitude older than this is not valid
+#define MOTION_STOP_TIMEOUT_MS 500
+
+/**
+ * @brief Latest attitude
+ */
+typedef struct {
+    bool valid;                                 // Running, and the filter has had a batch recently
+    int16_t roll;                               // 0.01 deg, starboard down positive
+    int16_t pitch;                              // 0.01 deg, bow up positive
+    int16_t roll_rate;                          // 0.1 deg/s, batch mean
+    int16_t pitch_rate;
+    int16_t mast_vx;                            // Masthead velocity from roll and pitch, 0.01 m/s, MOTION_MAST_AVG_MS mean:
+    int16_t mast_vy;                            // ... forward and to starboard
+    int64_t time_us;                            // When the last batch was fused
+} motion_attitude_t;
+
+/**
+ * @brief Task counters
+ */
+typedef struct {
+    bool running;
+    uint32_t samples;                           // IMU samples fused
+    uint32_t batches;
+    uint32_t gated;                             // Batches without an accelerometer correction
+    uint32_t overflows;                         // FIFO overflows (a late task, a gap in the data)
+    uint32_t errors;                            // Failed FIFO reads
+    uint32_t fuse_us_max;                       // Longest batch fusion
+    uint16_t load_permille;                     // Fusion time as a share of the elapsed time, 0.1 %
+} motion_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Add the IMU to the shared I2C bus and start the motion task
+ *
+ * The bus must be running (i2c_bus_start()).
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if already running, ESP_ERR_NOT_FOUND without the IMU,
+ *         ESP_ERR_NO_MEM, or the bus error
+ */
+esp_err_t motion_start(void);
+
+/**
+ * @brief Copy the latest attitude
+ *
+ * @return bool Its valid flag
+ */
+bool motion_get(motion_attitude_t *attitude);
+
+/**
+ * @brief Copy the counters
+ */
+void motion_get_stats(motion_stats_t *stats);
+
+/**
+ * @brief Stop the task, put the IMU to sleep and take it off the bus
+ */
+void motion_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_H
@@ -0,0 +1,97 @@
+/**
+ * @file mqtt_cmd.h
+ * @brief Gateway remote control over MQTT: commands on <base>/cmd/<name>, answers on <base>/reply/<name>
+ *
+ * Commands (all payloads JSON objects; an "id" member is echoed back):
+ *
+ *   cmd/config                  Device settings, the keys of /save_config;
+ *                               stored like a web save. {"fields":N}
+ *   cmd/ota                     Check the OTA_PULL_MANIFEST_URL manifest now
+ *                               (GATEWAY_OTA_PULL builds)
+ *   cmd/metrics                 Snapshot of the system metrics, as /api/metrics;
+ *                               {"group":"wifi"} for one group. {"metrics":[...]}
+ *   cmd/log                     {"tag":"GATEWAY","level":"debug","duration":300}
+ *                               as POST /api/log_level; tag defaults to all
+ *   cmd/node/<node id>/config   Node settings (espnow_config.h), relayed over
+ *                               the ESP-NOW config channel at the node's next frame
+ *   cmd/fault                   {"point":"espnow_rx","drop":50,"delay_ms":100}:
+ *                               fault probabilities at one point (fault_inject.h),
+ *                               members left out unchanged; FAULT_INJECT builds.
+ *                               The profile in force is echoed back
+ *
+ * Every command gets one answer, {"id":...,"ok":true,...} or
+ * {"id":...,"ok":false,"error":"..."}, on the reply topic with the same name.
+ *
+ * The command names are hashed into a table once at mqtt_cmd_start(), so
+ * a message finds its route with one hash of its first topic level and,
+ * almost always, one comparison, however many commands there are. The
+ * esp-mqtt task only routes and copies a message into a short queue; a
+ * worker task parses it and does the work (a settings save, a metrics
+ * sweep), so the client keeps reading the broker meanwhile. Messages that
+ * find the queue full are counted and dropped unanswered.
+ *
+ * Anyone who can publish under <base>/cmd/ controls the gateway; restrict
+ * it with the broker's ACLs.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef MQTT_CMD_H
+#define MQTT_CMD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define MQTT_CMD_QUEUE 4                        // Commands waiting for the worker
+#define MQTT_CMD_NAME_MAX 32                    // Longest topic after <base>/cmd/
+#define MQTT_CMD_PAYLOAD_MAX 512                // Longest command payload
+#define MQTT_CMD_REPLY_MAX 4096                 // Longest answer; a metrics snapshot past it asks for a group
+#define MQTT_CMD_ROUTE_SLOTS 16                 // Route hash table; a power of two, over twice the commands
+
+/**
+ * @brief Counters since mqtt_cmd_start()
+ */
+typedef struct {
+    uint32_t received;                          // Messages under <base>/cmd/
+    uint32_t done;                              // Answered ok
+    uint32_t failed;                            // Answered with an error (unknown, malformed, refused)
+    uint32_t dropped;                           // Queue full, or a name too long to answer
+    uint32_t unanswered;                        // Answers esp-mqtt refused
+} mqtt_cmd_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Build the route table, start the worker and register the command handler
+ *
+ * Call before mqtt_forwarder_init(), which subscribes to <base>/cmd/# when
+ * it connects.
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if already started, or ESP_ERR_NO_MEM
+ */
+esp_err_t mqtt_cmd_start(void);
+
+/**
+ * @brief Copy the counters
+ */
+void mqtt_cmd_get_stats(mqtt_cmd_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MQTT_CMD_H
@@ -0,0 +1,321 @@
+/**
+ * @file mqtt_forwarder.h
+ * @brief Gateway MQTT publisher: node samples to per-node topics with pipelined QoS 1
+ *
+ * mqtt_format picks the payload. MQTT_FORMAT_FIELDS publishes each metric
+ * of each sample on <mqtt_base_topic>/<node id>/<metric>. The batched
+ * formats collect a node's samples for up to MQTT_FORWARDER_BATCH_WINDOW_MS
+ * (or MQTT_FORWARDER_BATCH_MAX samples) and publish them as one columnar
+ * message on <mqtt_base_topic>/<node id>/batch, as JSON or CBOR:
+ *
+ *   {"node":"1a2b3c4d","seq":1200,"time":1760500000,
+ *    "dseq":[0,1,2],"dt":[0,10,20],"temp":[2153,2150,2149],
+ *    "press":[101325,101322,101320],"hum":[45120,45200,45310],"gas":[12000,null,12100]}
+ *
+ * seq and time are those of the first sample; dseq and dt are offsets
+ * from them. Values are fixed point: temp 0.01 degC, press Pa, hum
+ * 0.001 %RH, gas ohm (null when the reading was not valid).
+ *
+ * Closed aggregator windows go to <mqtt_base_topic>/<node id>/aggregate as
+ * JSON in every format (see aggregator.h; the mean and deviation need
+ * floats, which the CBOR writer does not have), and closed wind roses to
+ * <mqtt_base_topic>/<node id>/rose the same way.
+ *
+ * Alarm changes (pressure_trend.h) go to <mqtt_base_topic>/<node id>/alert
+ * the moment they happen, ahead of any batch. The gateway's own health
+ * alarms (health_watch.h) go to <mqtt_base_topic>/<gateway STA MAC>/health.
+ *
+ * Publishes go into the esp-mqtt outbox without waiting for their PUBACK,
+ * so up to MQTT_FORWARDER_WINDOW are in flight at once and a burst drains
+ * at link speed rather than one round trip per message. When the window
+ * is full the forwarder stops taking records, which backs up the gateway
+ * record ring and, through it, the nodes.
+ *
+ * Alarm lane: the last MQTT_FORWARDER_URGENT_RESERVE window slots are
+ * only for mqtt_forwarder_publish_urgent(), which mqtt_forwarder_room()
+ * leaves out, so an alarm record finds room however far behind the bulk
+ * records are. It is published on its own at once, as its metrics or as a
+ * one-sample batch, ahead of any open batch; in the esp-mqtt outbox it then
+ * waits behind at most a window of messages.
+ *
+ * Redundant gateways (MQTT_FORWARDER_CLAIMS): a node sends to one gateway
+ * at a time and fails over to another on missed ACKs. A frame whose ACK
+ * was lost then reaches both. Each gateway claims the newest seq it took
+ * from a node, as a retained {"seq":N,"gateway":"<mac>"} message on
+ * <mqtt_base_topic>/<node id>/claim. Every gateway subscribes to all
+ * claims. A record at or up to MQTT_FORWARDER_CLAIM_SPAN below another
+ * gateway's claim is dropped as already published. A node restarting its
+ * seqs after a power cut lands far below the claim and passes. Claims are
+ * sent once per drain, not per record. The gateways need distinct MQTT
+ * client ids.
+ *
+ * Node settings (espnow_config.h) arrive as JSON on
+ * <mqtt_base_topic>/<node id>/config/set, subscribed at QoS 1 when a
+ * handler is set; they may be retained.
+ *
+ * Commands (mqtt_cmd.h) arrive on <mqtt_base_topic>/cmd/<name>, subscribed
+ * as <mqtt_base_topic>/cmd/# at QoS 1 when a command handler is set, and
+ * are answered on <mqtt_base_topic>/reply/<name>.
+ *
+ * Persistent session (MQTT_FORWARDER_PERSIST): the client connects with
+ * clean session off, so the broker keeps the gateway's subscriptions and
+ * queues its QoS 1 config messages while it is away, and unconfirmed
+ * publishes are resent on reconnect. esp-mqtt's outbox is in RAM, so the
+ * gateway keeps the durable copy of each record in its flash spool (see
+ * GATEWAY_MQTT_OUTBOX) and releases it by ticket: mqtt_forwarder_ticket()
+ * numbers the publishes handed over so far, and since a broker confirms
+ * QoS 1 publishes in the order it got them, mqtt_forwarder_settled() says
+ * when all of them have been confirmed or have expired.
+ *
+ * Topic strings are built once per node, the first time it is forwarded:
+ * the per-node prefix is kept with room for the metric name (or "batch"),
+ * which is copied in place for each publish.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef MQTT_FORWARDER_H
+#define MQTT_FORWARDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "aggregator.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define MQTT_FORWARDER_WINDOW 64                // QoS 1/2 publishes awaiting their PUBACK/PUBCOMP
+#define MQTT_FORWARDER_URGENT_RESERVE 8         // ... of which only the alarm lane may use
+#define MQTT_FORWARDER_METRICS 4                // Publishes per sample: temperature, pressure, humidity, gas
+#define MQTT_FORWARDER_NODES 48                 // Nodes with precomputed topics; matches NODE_TABLE_MAX_NODES
+#define MQTT_FORWARDER_KEEPALIVE_S 30
+#ifndef MQTT_FORWARDER_CLAIMS
+#define MQTT_FORWARDER_CLAIMS 1                 // 1: claim and dedupe (node, seq) across gateways on the broker
+#endif
+#ifndef MQTT_FORWARDER_PERSIST
+#define MQTT_FORWARDER_PERSIST 1                // 1: persistent session (clean session off); needs a fixed client id
+#endif
+#define MQTT_FORWARDER_CLAIM_SPAN 4096          // Seqs below another gateway's claim taken as duplicates
+
+// Batched formats
+#define MQTT_FORWARDER_BATCH_MAX 32             // Samples per batch message
+#define MQTT_FORWARDER_BATCH_WINDOW_MS 10000    // Longest a sample waits for its batch
+#define MQTT_FORWARDER_OPEN_BATCHES 8           // Nodes batching at once; the oldest is sent to make room
+#define MQTT_FORWARDER_PAYLOAD_MAX 2048         // Encoded batch; a full JSON batch takes about 1.4 KB
+
+/**
+ * @brief Publisher counters since mqtt_forwarder_init()
+ */
+typedef struct {
+    bool connected;
+    uint32_t connects;                          // Broker sessions established
+    uint32_t published;                         // Messages handed to esp-mqtt
+    uint32_t samples;                           // Samples carried by those messages
+    uint32_t acked;                             // QoS 1/2 messages the broker confirmed
+    uint32_t expired;                           // Dropped from the outbox unconfirmed
+    uint32_t failed;                            // Refused by esp-mqtt (not connected at QoS 0, outbox full)
+    uint32_t deduped;                           // Records another gateway already claimed
+    uint32_t urgent;                            // Records published in the alarm lane
+    uint32_t claims;                            // Claim messages sent
+    uint32_t in_flight;                         // Currently awaiting confirmation
+    uint32_t in_flight_peak;
+    uint8_t qos;
+    uint8_t format;                             // MQTT_FORMAT_*
+} mqtt_forwarder_stats_t;
+
+/**
+ * @brief Called from the esp-mqtt task when the forwarder has new work: the broker connection
+ *        came up or went down, half the window is free again, or the last message was confirmed
+ */
+typedef void (*mqtt_forwarder_wake_t)(void);
+
+/**
+ * @brief Called from the esp-mqtt task with each config/set message and the node id of its topic
+ */
+typedef esp_err_t (*mqtt_forwarder_config_t)(uint32_t node_id, const char *json, size_t len);
+
+/**
+ * @brief Called from the esp-mqtt task with each whole message under <base>/cmd/
+ *
+ * @param name Topic after "<base>/cmd/", not terminated
+ * @param name_len Its length
+ * @param data Payload, not terminated
+ * @param len Payload length
+ */
+typedef void (*mqtt_forwarder_command_t)(const char *name, size_t name_len, const char *data, size_t len);
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Take node config messages; call before mqtt_forwarder_init()
+ */
+void mqtt_forwarder_set_config_handler(mqtt_forwarder_config_t handler);
+
+/**
+ * @brief Take command messages; call before mqtt_forwarder_init()
+ */
+void mqtt_forwarder_set_command_handler(mqtt_forwarder_command_t handler);
+
+/**
+ * @brief Start the esp-mqtt client from the stored MQTT settings
+ *
+ * The client connects, and reconnects, in the background; publishing
+ * before it is connected queues QoS 1/2 messages in the outbox.
+ *
+ * @param wake Wakes the forwarder task; must not block
+ * @return esp_err_t ESP_OK, ESP_ERR_NO_MEM, or the esp-mqtt start error
+ */
+esp_err_t mqtt_forwarder_init(mqtt_forwarder_wake_t wake);
+
+/**
+ * @brief Stop the client and free the topic table
+ */
+void mqtt_forwarder_deinit(void);
+
+/**
+ * @brief Records the in-flight window has room for now, short of the alarm lane's reserve (SIZE_MAX at QoS 0)
+ */
+size_t mqtt_forwarder_room(void);
+
+/**
+ * @brief Alarm records the in-flight window has room for now, reserve included (SIZE_MAX at QoS 0)
+ */
+size_t mqtt_forwarder_urgent_room(void);
+
+/**
+ * @brief Publish one sample, or add it to its node's batch; forwarder task only
+ *
+ * @param node_id Sending node
+ * @param rec Sample
+ * @return esp_err_t ESP_OK (also for a record another gateway claimed), ESP_ERR_INVALID_STATE before
+ *         init, ESP_ERR_NO_MEM when the topic table is full, or ESP_FAIL if esp-mqtt refused a message
+ */
+esp_err_t mqtt_forwarder_publish(uint32_t node_id, const telemetry_record_t *rec);
+
+/**
+ * @brief Publish one alarm record at once, past its node's open batch; forwarder task
+ *
+ * @return esp_err_t As mqtt_forwarder_publish()
+ */
+esp_err_t mqtt_forwarder_publish_urgent(uint32_t node_id, const telemetry_record_t *rec);
+
+/**
+ * @brief Publish one closed aggregator window; forwarder task
+ *
+ * @param result Window summary
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE before init, ESP_ERR_NO_MEM when the topic
+ *         table is full, or ESP_FAIL if esp-mqtt refused the message
+ */
+esp_err_t mqtt_forwarder_publish_aggregate(const aggregator_result_t *result);
+
+/**
+ * @brief Publish one closed wind rose; forwarder task
+ *
+ * @param rose Rose of one window
+ * @return esp_err_t As mqtt_forwarder_publish_aggregate()
+ */
+esp_err_t mqtt_forwarder_publish_rose(const aggregator_rose_t *rose);
+
+/**
+ * @brief Publish an alarm change at once; forwarder task
+ *
+ * @param node_id Node the alarm is for
+ * @param json Payload, e.g. from pressure_trend_alert_json()
+ * @param len Payload length
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE before init, ESP_ERR_NO_MEM when the topic
+ *         table is full, or ESP_FAIL if esp-mqtt refused the message
+ */
+esp_err_t mqtt_forwarder_publish_alert(uint32_t node_id, const char *json, size_t len);
+
+/**
+ * @brief Publish one of the gateway's own health alarms at once; any task
+ *
+ * @param json Payload from health_watch.h
+ * @param len Payload length
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE before init, or ESP_FAIL if esp-mqtt refused the message
+ */
+esp_err_t mqtt_forwarder_publish_health(const char *json, size_t len);
+
+/**
+ * @brief Publish a retained message on a topic outside <base>, e.g. a discovery config; any task
+ *
+ * Takes a window slot like any QoS 1/2 publish; skips the fault injection point.
+ *
+ * @param topic Full topic
+ * @param json Payload
+ * @param len Payload length
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE before init, or ESP_FAIL if esp-mqtt refused the message
+ */
+esp_err_t mqtt_forwarder_publish_retained(const char *topic, const char *json, size_t len);
+
+/**
+ * @brief Publish the answer to a command on <base>/reply/<name>; any task
+ *
+ * @param name Command name, as passed to the command handler
+ * @param name_len Its length
+ * @param json Payload
+ * @param len Payload length
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE before init, ESP_ERR_INVALID_SIZE for a name
+ *         too long for a topic, or ESP_FAIL if esp-mqtt refused the message
+ */
+esp_err_t mqtt_forwarder_publish_reply(const char *name, size_t name_len, const char *json, size_t len);
+
+/**
+ * @brief Send the batches whose window has run out, and new claims; forwarder task, after each drain
+ */
+void mqtt_forwarder_poll(void);
+
+/**
+ * @brief Milliseconds until mqtt_forwarder_poll() has a batch or claim to send (UINT32_MAX: none)
+ */
+uint32_t mqtt_forwarder_poll_due_ms(void);
+
+/**
+ * @brief Send every open batch now; forwarder task
+ */
+void mqtt_forwarder_flush(void);
+
+/**
+ * @brief Connected to the broker
+ */
+bool mqtt_forwarder_connected(void);
+
+/**
+ * @brief Everything handed over so far was confirmed: nothing in flight, no open batch; forwarder task
+ */
+bool mqtt_forwarder_idle(void);
+
+/**
+ * @brief Number of the last QoS 1/2 publish handed to esp-mqtt, counting from init; any task
+ */
+uint32_t mqtt_forwarder_ticket(void);
+
+/**
+ * @brief Whether every publish up to a ticket has been confirmed or has expired; any task
+ *
+ * Expired ones were lost: compare mqtt_forwarder_stats_t.expired to tell.
+ */
+bool mqtt_forwarder_settled(uint32_t ticket);
+
+/**
+ * @brief Copy the publisher counters
+ */
+void mqtt_forwarder_get_stats(mqtt_forwarder_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MQTT_FORWARDER_H
@@ -0,0 +1,100 @@
+/**
+ * @file multipart_reader.h
+ * @brief Incremental multipart/form-data parser that streams part bodies without copying
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef MULTIPART_READER_H
+#define MULTIPART_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define MULTIPART_BOUNDARY_MAX 70               // RFC 2046 boundary length limit
+#define MULTIPART_HEADER_LINE_MAX 192           // Longer part header lines are truncated
+#define MULTIPART_NAME_MAX 32                   // Longest form field name, including terminator
+#define MULTIPART_FILENAME_MAX 64               // Longest file name kept, including terminator
+
+/**
+ * @brief Part event handlers; returning anything but ESP_OK stops the parse with that error
+ */
+typedef struct {
+    esp_err_t (*on_part_begin)(void *ctx, const char *name, const char *filename);  // filename is NULL for plain fields
+    esp_err_t (*on_part_data)(void *ctx, const uint8_t *data, size_t len);          // Points into the fed buffer
+    esp_err_t (*on_part_end)(void *ctx);
+} multipart_callbacks_t;
+
+/**
+ * @brief Parser state; lives on the caller's stack
+ */
+typedef struct {
+    multipart_callbacks_t cb;
+    void *ctx;
+    esp_err_t err;                              // First error seen; further input is ignored
+    uint8_t state;
+    bool dash_seen;                             // First '-' of a closing "--" after a boundary
+    char delimiter[MULTIPART_BOUNDARY_MAX + 5]; // "\r\n--" + boundary
+    size_t delimiter_len;
+    size_t match;                               // Delimiter bytes matched so far
+    size_t carry;                               // Of those, bytes that arrived in earlier feeds
+    char line[MULTIPART_HEADER_LINE_MAX];       // Part header line being collected
+    size_t line_len;
+    char name[MULTIPART_NAME_MAX];
+    char filename[MULTIPART_FILENAME_MAX];
+    bool has_filename;
+} multipart_reader_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Prepare a parser for one request body
+ *
+ * @param r Parser to initialise
+ * @param content_type Value of the request's Content-Type header (carries the boundary)
+ * @param cb Part event handlers (copied)
+ * @param ctx Passed through to the handlers
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if the content type has no usable boundary
+ */
+esp_err_t multipart_reader_init(multipart_reader_t *r, const char *content_type,
+                                const multipart_callbacks_t *cb, void *ctx);
+
+/**
+ * @brief Feed the next piece of the body; boundaries may straddle pieces
+ *
+ * Part data is handed to on_part_data as spans of data wherever possible, so
+ * the caller's receive buffer is the only copy.
+ *
+ * @param r Parser
+ * @param data Next bytes of the body
+ * @param len Number of bytes
+ * @return esp_err_t ESP_OK to continue, ESP_ERR_INVALID_ARG on malformed input, or the handler's error
+ */
+esp_err_t multipart_reader_feed(multipart_reader_t *r, const uint8_t *data, size_t len);
+
+/**
+ * @brief Check that the closing boundary was seen
+ *
+ * @param r Parser
+ * @return esp_err_t ESP_OK if the body was complete, the first error otherwise
+ */
+esp_err_t multipart_reader_finish(multipart_reader_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MULTIPART_READER_H
@@ -0,0 +1,144 @@
+/**
+ * @file n2k.h
+ * @brief NMEA 2000 output on the TWAI (CAN) controller: environmental, wind and position PGNs
+ *
+ * The task takes each record the gateway receives from its own sample bus
+ * queue (sample_bus.h) and hands it to n2k_publish(), which packs it
+ * straight from the fixed-point record into PGN payloads (integer scaling
+ * only, no strings) and queues the frames:
+ *
+ *   130311   Environmental Parameters: outside temperature, humidity, pressure (hPa)
+ *   130314   Actual Pressure: atmospheric, 0.1 Pa
+ *   130306   Wind Data, apparent, and true (boat referenced) with a GPS
+ *            fix; every N2K_WIND_PERIOD_MS while the wind module runs on
+ *            this board (see true_wind.h)
+ *   129025   Position, Rapid Update, and
+ *   129026   COG & SOG, Rapid Update: each GPS fix the task takes from
+ *            the bus (SAMPLE_TOPIC_POSITION, see gps.h)
+ *
+ * Frames go into the TWAI driver's transmit queue (N2K_TX_QUEUE_LEN deep)
+ * without waiting; the driver feeds the controller from its interrupt.
+ * A full queue drops the frame and counts it, so the task is never held up
+ * by the bus. Records arriving faster than N2K_ENV_MIN_INTERVAL_MS
+ * are skipped, which bounds the bus load however many nodes report.
+ *
+ * Payloads longer than a CAN frame use fast-packet framing: the first
+ * frame carries a sequence/frame counter and the length, the rest carry
+ * seven bytes each. The gateway uses it for Product Information (126996),
+ * which plotters request to list the device.
+ *
+ * A small task claims an address (ISO Address Claim, 60928) starting at
+ * N2K_PREFERRED_ADDRESS, defends or moves it when another device claims
+ * the same one, answers ISO Requests for the claim and the product
+ * information, and restarts the controller after bus-off.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef N2K_H
+#define N2K_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define N2K_TX_GPIO 5                           // To the CAN transceiver's TXD
+#define N2K_RX_GPIO 4                           // From its RXD
+#define N2K_TX_QUEUE_LEN 32                     // Frames; the 126996 fast packet alone takes 20
+#define N2K_RX_QUEUE_LEN 16
+#define N2K_PREFERRED_ADDRESS 35                // First address tried
+#define N2K_MAX_ADDRESS 251                     // 252..253 reserved, 254 "cannot claim", 255 global
+#define N2K_ENV_MIN_INTERVAL_MS 1000            // 130311/130314 no more often than this
+#define N2K_WIND_PERIOD_MS 1000                 // 130306 (the standard rate is 100 ms; 1 s matches the wind tick)
+#define N2K_MANUFACTURER_CODE 2046              // Not a registered manufacturer
+#define N2K_DEVICE_CLASS 85                     // External Environment
+#define N2K_DEVICE_FUNCTION 130                 // Atmospheric
+#define N2K_INDUSTRY_GROUP 4                    // Marine
+#define N2K_PRODUCT_CODE 1
+#define N2K_BUS_DEPTH 4                         // Records are rate-limited and only the newest fix matters; older ones may drop
+#define N2K_BUS_POLL_MS 100                     // Longest wait between bus reads: one 10 Hz GPS epoch
+
+// PGNs
+#define N2K_PGN_ISO_REQUEST 59904
+#define N2K_PGN_ADDRESS_CLAIM 60928
+#define N2K_PGN_PRODUCT_INFO 126996
+#define N2K_PGN_POSITION_RAPID 129025
+#define N2K_PGN_COG_SOG_RAPID 129026
+#define N2K_PGN_WIND 130306
+#define N2K_PGN_ENVIRONMENT 130311
+#define N2K_PGN_PRESSURE 130314
+
+#define N2K_FAST_PACKET_MAX 223                 // 6 bytes in the first frame, 7 in each of up to 31 more
+
+/**
+ * @brief Bus counters since n2k_start()
+ */
+typedef struct {
+    uint8_t address;                            // Claimed source address; 254 while none could be claimed
+    uint32_t frames;                            // Frames queued to the controller
+    uint32_t dropped;                           // Frames the full transmit queue refused
+    uint32_t skipped;                           // Records not sent, inside N2K_ENV_MIN_INTERVAL_MS
+    uint32_t claims_lost;                       // Times another device took our address
+    uint32_t bus_off;                           // Recoveries from bus-off
+} n2k_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Install and start the TWAI driver at 250 kbit/s and start the claim/request task
+ *
+ * @return esp_err_t ESP_OK (also if already started), the TWAI driver error, or ESP_ERR_NO_MEM
+ */
+esp_err_t n2k_start(void);
+
+/**
+ * @brief Send 130311 and 130314 for a received record; any task, never blocks
+ *
+ * @param node_id Sending node, used as the pressure instance's low byte
+ * @param rec Decoded record
+ */
+void n2k_publish(uint32_t node_id, const telemetry_record_t *rec);
+
+/**
+ * @brief Queue a PGN, in fast-packet frames when longer than 8 bytes
+ *
+ * @param pgn Parameter group
+ * @param priority 0 (highest) .. 7
+ * @param dest Destination for PDU1 PGNs (255: global); ignored for PDU2
+ * @param data Payload
+ * @param len Payload length, up to N2K_FAST_PACKET_MAX
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE before an address is claimed,
+ *         ESP_ERR_INVALID_SIZE, or ESP_ERR_NO_MEM when the transmit queue is full
+ */
+esp_err_t n2k_send(uint32_t pgn, uint8_t priority, uint8_t dest, const uint8_t *data, size_t len);
+
+/**
+ * @brief Copy the counters
+ */
+void n2k_get_stats(n2k_stats_t *stats);
+
+/**
+ * @brief Stop the task and the controller and uninstall the driver
+ */
+void n2k_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // N2K_H
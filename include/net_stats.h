@@ -0,0 +1,136 @@
+/**
+ * @file net_stats.h
+ * @brief Byte and packet counters per network interface, with lwIP drop counts
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef NET_STATS_H
+#define NET_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+
+/**
+ * @brief Interfaces with their own counters
+ */
+typedef enum {
+    NET_STATS_IF_AP,                            // SoftAP netif (portal clients)
+    NET_STATS_IF_STA,                           // Station netif, when one exists
+    NET_STATS_IF_ESPNOW,                        // ESP-NOW frames, reported by the sender/receiver
+    NET_STATS_IF_COUNT
+} net_stats_if_t;
+
+/**
+ * @brief Traffic of one interface since net_stats_start()
+ */
+typedef struct {
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint32_t tx_packets;
+    uint32_t rx_packets;
+    uint32_t tx_failed;                         // ESP-NOW sends unacknowledged after the MAC retries
+} net_if_stats_t;
+
+/**
+ * @brief Stack-wide drop and error counts; needs CONFIG_LWIP_STATS
+ *
+ * lwIP keeps these as 16-bit counters, so they wrap on a busy link.
+ */
+typedef struct {
+    bool valid;
+    uint32_t link_drop;
+    uint32_t link_err;
+    uint32_t ip_drop;
+    uint32_t tcp_drop;
+    uint32_t tcp_memerr;
+    uint32_t udp_drop;
+} net_drop_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Start counting on the WiFi netifs and register the network metrics
+ *
+ * Call after the netifs are created. Uses the per-packet IP_EVENT_TX_RX
+ * events (CONFIG_ESP_NETIF_REPORT_DATA_TRAFFIC); packets whose event is
+ * dropped because the event queue is full go uncounted.
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_SUPPORTED without traffic events, or the event loop error
+ */
+esp_err_t net_stats_start(void);
+
+/**
+ * @brief Stop counting, before the WiFi netifs are destroyed; the counters are kept
+ *
+ * @return esp_err_t ESP_OK
+ */
+esp_err_t net_stats_stop(void);
+
+/**
+ * @brief Account an ESP-NOW frame handed to esp_now_send()
+ *
+ * @param len Payload length
+ */
+void net_stats_espnow_sent(size_t len);
+
+/**
+ * @brief Account the outcome of an ESP-NOW send, from the send callback
+ *
+ * @param success Whether the peer acknowledged the frame
+ */
+void net_stats_espnow_send_done(bool success);
+
+/**
+ * @brief Account a received ESP-NOW frame, from the receive callback
+ *
+ * @param len Payload length
+ */
+void net_stats_espnow_received(size_t len);
+
+/**
+ * @brief Copy the counters of one interface
+ *
+ * @param iface Interface
+ * @param stats Receives the snapshot
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG for a bad interface
+ */
+esp_err_t net_stats_get(net_stats_if_t iface, net_if_stats_t *stats);
+
+/**
+ * @brief Read the lwIP drop counters; valid is false without CONFIG_LWIP_STATS
+ */
+void net_stats_get_drops(net_drop_stats_t *drops);
+
+/**
+ * @brief Name of an interface as used in JSON and metrics
+ */
+const char *net_stats_if_name(net_stats_if_t iface);
+
+/**
+ * @brief Write per-interface counters and drop counts as a JSON object
+ *
+ * @param w Writer positioned where a value is expected
+ */
+void net_stats_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NET_STATS_H
@@ -0,0 +1,147 @@
+/**
+ * @file nmea.h
+ * @brief NMEA 0183 for navigation instruments: MWV, MDA and XDR out over UART, UDP and TCP
+ *
+ * The sentence task reads the newest record the gateway received from
+ * latest_values.h, without a lock or a queue of its own; the wind figures
+ * come from wind_get() when this board runs the wind module.
+ * A task emits each sentence at its own period:
+ *
+ *   $WIMWV   apparent wind angle and speed, m/s             NMEA_MWV_PERIOD_MS
+ *   $WIMWV   true wind angle and speed (reference T)        NMEA_MWV_TRUE_PERIOD_MS
+ *   $WIMDA   pressure, air temperature, humidity, dew point, wind speed
+ *                                                           NMEA_MDA_PERIOD_MS
+ *   $WIXDR   the same readings as transducer values, for plotters
+ *            without MDA                                    NMEA_XDR_PERIOD_MS
+ *
+ * Environmental sentences stop once the newest record is older than
+ * NMEA_STALE_MS, and MWV stops while wind is not running, so instruments
+ * show the data as lost instead of a frozen value. Wind comes through
+ * true_wind_get(): heel- and motion-corrected with the motion module
+ * running, and true once a GPS fix (gps.h) gives speed and course over
+ * ground.
+ *
+ * Each sentence goes to the UART (NMEA_UART_BAUD, 8N1, TX only), as a UDP
+ * broadcast to NMEA_NET_PORT, and to up to NMEA_TCP_MAX_CLIENTS TCP clients
+ * on the same port. The sockets bind to every interface, so plotters on
+ * the AP and on the uplink network are both served. A TCP client that
+ * cannot keep up is dropped rather than allowed to stall the others.
+ *
+ * Sentences are built in place in a preallocated nmea_builder_t; nothing is
+ * allocated per sentence.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef NMEA_H
+#define NMEA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define NMEA_SENTENCE_MAX 82                    // Including '$' and CR LF (NMEA 0183 limit)
+#define NMEA_TALKER "WI"                        // Weather instruments
+#define NMEA_MWV_PERIOD_MS 1000                 // 0: sentence off
+#define NMEA_MWV_TRUE_PERIOD_MS 1000            // True wind; sent only with a GPS fix
+#define NMEA_MDA_PERIOD_MS 5000
+#define NMEA_XDR_PERIOD_MS 5000
+#define NMEA_STALE_MS 300000                    // Records older than this are not sent
+#define NMEA_NODE_ID 0                          // Node whose readings are sent (0: whichever reported last)
+#define NMEA_UART_NUM 2
+#define NMEA_UART_TX_GPIO 17
+#define NMEA_UART_BAUD 4800                     // NMEA 0183 standard rate; 38400 for high-speed inputs
+#define NMEA_UART_TX_BUFFER 512
+#define NMEA_NET_PORT 10110                     // IANA port for NMEA 0183 over IP
+#define NMEA_TCP_MAX_CLIENTS 4
+
+/**
+ * @brief Sentence being built; the caller owns it, usually as a static
+ */
+typedef struct {
+    char buf[NMEA_SENTENCE_MAX + 1];
+    size_t len;
+    bool overflow;                              // A field did not fit; nmea_finish() refuses the sentence
+} nmea_builder_t;
+
+/**
+ * @brief Output counters since nmea_start()
+ */
+typedef struct {
+    uint32_t sentences;                         // Sentences built
+    uint32_t uart_bytes;
+    uint32_t udp_sent;
+    uint32_t tcp_clients;                       // Connected now
+    uint32_t tcp_dropped;                       // Clients closed after a failed or short send
+} nmea_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief XOR of the characters between '$' and '*'
+ *
+ * @param body Sentence without the leading '$'
+ * @param len Characters of body to include
+ */
+uint8_t nmea_checksum(const char *body, size_t len);
+
+/**
+ * @brief Start a sentence: '$' and the address field, e.g. "WIMWV"
+ */
+void nmea_begin(nmea_builder_t *b, const char *address);
+
+/**
+ * @brief Append a text field (may be empty)
+ */
+void nmea_add_str(nmea_builder_t *b, const char *s);
+
+/**
+ * @brief Append a fixed-point field: value / 10^decimals with exactly that many decimals
+ */
+void nmea_add_fixed(nmea_builder_t *b, int32_t value, uint8_t decimals);
+
+/**
+ * @brief Append the checksum and CR LF
+ *
+ * @return Sentence length, or 0 if it did not fit NMEA_SENTENCE_MAX
+ */
+size_t nmea_finish(nmea_builder_t *b);
+
+
+/**
+ * @brief Bring up the UART and the UDP/TCP sockets and start the sentence task
+ *
+ * @return esp_err_t ESP_OK (also if already started; a missing output is logged and skipped),
+ *         or ESP_ERR_NO_MEM
+ */
+esp_err_t nmea_start(void);
+
+/**
+ * @brief Copy the counters
+ */
+void nmea_get_stats(nmea_stats_t *stats);
+
+/**
+ * @brief Stop the task, close the sockets and release the UART
+ */
+void nmea_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NMEA_H
@@ -13,27 +13,174 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "esp_err.h"
+#include "sdkconfig.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// =============================
+// Constants & Definitions
+// =============================
+#define NODE_I2C_PORT 0                         // I2C_NUM_0
+#if CONFIG_IDF_TARGET_ESP32C3
+#define NODE_I2C_SDA_GPIO 6                     // C3 has no GPIO 21/22 free; 8 and 9 are strapping pins
+#define NODE_I2C_SCL_GPIO 7
+#elif CONFIG_IDF_TARGET_ESP32S3
+#define NODE_I2C_SDA_GPIO 8                     // S3 DevKitC-1 default SDA
+#define NODE_I2C_SCL_GPIO 9                     // S3 DevKitC-1 default SCL
+#else
+#define NODE_I2C_SDA_GPIO 21                    // DevKit V1 default SDA
+#define NODE_I2C_SCL_GPIO 22                    // DevKit V1 default SCL
+#endif
+#define NODE_BME680_ADDRESS 0x76                // BME680_I2C_ADDR_PRIMARY (SDO to GND)
+#define NODE_BME680_HEATER_TEMP_C 320           // Gas heater target
+#define NODE_BME680_HEATER_MS 150               // Gas heater hold time per sample
+#define NODE_BME680_INTERVAL_MS 1000            // BME680 sampling period
+#define NODE_ESPNOW_CHANNEL 1                   // First channel after a power-on; the gateway announces moves
+#define NODE_MAIN_INTERVAL_MS 60000             // How often node_main() logs the sampling statistics
+#if CONFIG_IDF_TARGET_ESP32C3
+#define NODE_CONFIG_BUTTON_GPIO 9               // Boot button; not a deep sleep wake pin on C3, so held at a wake
+#else
+#define NODE_CONFIG_BUTTON_GPIO 0               // Boot button; an EXT0 wake on it enters config mode
+#endif
+
+// Node-only firmware: no portal, gateway, test roles or diagnostics pages, only sensing, ESP-NOW and
+// OTA over ESP-NOW. Settings come from NVS and the gateway's config channel (espnow_config.h).
+#ifndef NODE_MINIMAL
+#define NODE_MINIMAL 0                          // 1: build [env:node-minimal]
+#endif
+
+// Timer-driven sampling: readings are aggregated into ESP-NOW frames (see espnow_batch.h)
+#define NODE_BATCH_MAX_AGE_MS 30000             // Longest a reading waits for its frame to fill
+#define NODE_PRIORITY_TEMP_STEP 100             // Send at once on a step of this much from the last reading (0.01 degC)
+#define NODE_PRIORITY_PRESSURE_STEP_PA 50       // ... or of this much pressure (a squall front)
+#define NODE_ACK_WAIT_MS 500                    // Longest a wake or shutdown waits for the gateway's ACKs
+
+// Battery duty cycling: deep sleep between samples, radio only for batches. Period, batch and
+// heater are defaults; the gateway can push others (espnow_config.h).
+#ifndef NODE_DEEP_SLEEP_PERIOD_S
+#define NODE_DEEP_SLEEP_PERIOD_S 60             // Sample period while duty cycling (0: stay awake and sample by timer)
+#endif
+#define NODE_BATCH_SAMPLES 10                   // Samples per batch send
+#define NODE_RTC_BUFFER_LEN 32                  // RTC ring; holds a few batches if sending fails
+#define NODE_DEEP_SLEEP_MIN_US 1000000          // Shortest sleep when a wake overran its period
+
+// Energy benchmark: a fixed sample-and-transmit workload instead of normal sampling (see energy_bench.h)
+#ifndef NODE_BENCHMARK_CYCLES
+#define NODE_BENCHMARK_CYCLES 0                 // Cycles to run after boot (0: off); build with -D NODE_BENCHMARK_CYCLES=600
+#endif
+#define NODE_BENCHMARK_PERIOD_MS 1000           // One sample per cycle; light sleep in between
+#define NODE_BENCHMARK_BATCH NODE_BATCH_SAMPLES // Samples per frame, as a duty-cycled node sends them
+
+// Wind: anemometer on PCNT, vane on ADC1 (see wind.h); it holds off light sleep, so only for an awake node
+#ifndef NODE_WIND
+#define NODE_WIND 0                             // 1: run it when NODE_DEEP_SLEEP_PERIOD_S is 0; build with -D NODE_WIND=1
+#endif
+
+// Analog inputs: supply, and the vane with NODE_WIND, sampled continuously over DMA (see adc_stream.h);
+// the driver holds the APB clock, so only for an awake node
+#ifndef NODE_ADC_STREAM
+#define NODE_ADC_STREAM 1                       // 1: stream when NODE_DEEP_SLEEP_PERIOD_S is 0; 0: oneshot reads
+#endif
+
+// Relay: forward out-of-range nodes' frames to the gateway (see espnow_relay.h); needs mains power
+#ifndef NODE_RELAY
+#define NODE_RELAY 0                            // 1: relay when NODE_DEEP_SLEEP_PERIOD_S is 0; build with -D NODE_RELAY=1
+#endif
+
+// Rain gauge: tips counted by interrupt, or by EXT1 wake in deep sleep (see rain_gauge.h); sent in every frame
+#ifndef NODE_RAIN
+#define NODE_RAIN 0                             // 1: count tips on RAIN_GAUGE_GPIO; build with -D NODE_RAIN=1
+#endif
+
+// Long Range: 250/500 kbps ESP-NOW for a node beyond normal range (see espnow_link.h); the gateway can push it too
+#ifndef NODE_ESPNOW_LR
+#define NODE_ESPNOW_LR 0                        // 1: always send in LR mode; build with -D NODE_ESPNOW_LR=1
+#endif
+
+// Pressure trend over 3 h (see pressure_trend.h); a raised falling/storm alarm is sent at once
+#ifndef NODE_PRESSURE_TREND
+#define NODE_PRESSURE_TREND 1                   // 0: no trend tracking on the node
+#endif
+
+// Send on change (see deadband.h): a BME680 sample is sent only when a field leaves its deadband from the
+// last one sent, or NODE_DEADBAND_HEARTBEAT_S after it; priority steps and pressure alarms always go out
+#ifndef NODE_DEADBAND
+#define NODE_DEADBAND 1                         // 0: send every sample
+#endif
+#define NODE_DEADBAND_TEMP 10                   // 0.01 degC
+#define NODE_DEADBAND_PRESSURE_PA 20
+#define NODE_DEADBAND_HUMIDITY 1000             // 0.001 %RH
+#define NODE_DEADBAND_GAS_PERMILLE 100          // Gas resistance, relative to the value sent
+#define NODE_DEADBAND_HEARTBEAT_S 900           // Longest a node stays silent in steady weather
+
+// Adaptive sampling (see sample_rate.h): period and batch follow the supply's charge, the pressure trend
+// and the wind's gust spread, between these limits; logged as a "Rate:" line on each change. Off with
+// NODE_BSEC, whose rate is fixed
+#ifndef NODE_ADAPTIVE_RATE
+#define NODE_ADAPTIVE_RATE 1                    // 0: always the configured period and batch
+#endif
+#define NODE_RATE_MIN_S 15                      // Duty cycling: shortest period
+#define NODE_RATE_MAX_S 600                     // ... and longest; below ESPNOW_OTA_GATHER_MS
+#define NODE_RATE_AWAKE_MIN_MS 500              // Awake node: shortest period
+#define NODE_RATE_AWAKE_MAX_MS 10000
+#define NODE_RATE_CHECK_MS 60000                // Awake node: how often the period is worked out again
+
+// Stored samples (duty-cycle batches, the flash backlog) go out as packed records (see telemetry.h),
+// which a gateway older than this image cannot read
+#ifndef NODE_PACKED_BACKLOG
+#define NODE_PACKED_BACKLOG 1                   // 0: fixed-width records
+#endif
+#define NODE_REPLAY_RECORDS TELEMETRY_PACKED_MAX_RECORDS // Records read from flash per replayed frame
+
+// Indoor air quality: Bosch BSEC on the BME680 (see iaq.h); its sample rate then sets the period and the heater
+#ifndef NODE_BSEC
+#define NODE_BSEC 0                             // 1: needs the BSEC library in lib/BSEC; build [env:bsec]
+#endif
+
+// ULP supply watch while asleep (needs CONFIG_ULP_COPROC_TYPE_FSM); raw 12-bit counts at 12 dB
+#define NODE_ULP_LOW_RAW 2300                   // Wake below this: supply sagging (~1.9 V at the pin)
+#define NODE_ULP_HIGH_RAW 4096                  // Wake from this (4096: never)
+#define NODE_ULP_HYSTERESIS_RAW 64              // Re-arm margin after a threshold wake
+
 /**
  * @brief Initialize node mode
  *
  * Sets up all necessary components for node operation including
- * sensor initialization, ESP-NOW setup, and data collection.
+ * sensor initialization, ESP-NOW setup, and data collection. With
+ * NODE_BENCHMARK_CYCLES set it runs the energy benchmark to completion
+ * (NODE_BENCHMARK_CYCLES x NODE_BENCHMARK_PERIOD_MS) before returning.
  *
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
 esp_err_t node_init(void);
 
 /**
- * @brief Main node processing loop
+ * @brief Duty-cycle fast path; call first in app_main
+ *
+ * On a deep-sleep timer wake it brings up only the I2C bus and the
+ * BME680, appends one sample to the RTC ring and goes back to sleep.
+ * It returns only when a batch is due (NODE_BATCH_SAMPLES, or as the
+ * gateway pushed it; the full boot then sends it) or when this was not such a wake.
+ */
+void node_duty_cycle_wake(void);
+
+/**
+ * @brief Send the RTC batch and deep-sleep, when duty cycling is enabled
+ *
+ * Call after node_init(). Returns immediately when NODE_DEEP_SLEEP_PERIOD_S
+ * is 0 or a benchmark ran, and the node keeps running with timer-driven
+ * sampling (or, after a benchmark, idles and reports its result).
+ */
+void node_sleep_if_duty_cycled(void);
+
+/**
+ * @brief Periodic node housekeeping
  *
- * This function contains the main node logic for collecting sensor
- * data and sending it to the gateway. This function should be
- * called from the main application loop.
+ * Sampling and transmission run on their own timer and tasks (see
+ * sampler.h), so this only reports their statistics. Call it every
+ * NODE_MAIN_INTERVAL_MS from the main application loop.
  */
 void node_main(void);
 
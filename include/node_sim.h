@@ -0,0 +1,125 @@
+/**
+ * @file node_sim.h
+ * @brief Many virtual nodes on one board, to soak the gateway's ingest pipeline
+ *
+ * Selected through device_role in NVS: a DEVICE_ROLE_NODE_SIM board sends
+ * telemetry for NODE_SIM_NODES virtual nodes to the gateway in
+ * server_mac, over the same encrypted ESP-NOW link a node uses. Each
+ * virtual node has its own node id (the board's MAC with the node's index
+ * in the low byte), its own sequence numbers and its own schedule:
+ *
+ *   live    One record every period, jittered by up to a tenth so the nodes
+ *           drift apart; NODE_SIM_LOSS_PERMILLE of them are skipped, so the
+ *           gateway sees seq gaps as from a lossy link
+ *   outage  NODE_SIM_OUTAGE_PERMILLE of the live frames start an outage
+ *           instead: the node sends nothing for NODE_SIM_OUTAGE_RECORDS
+ *           periods, then replays what it held back to back in full packed
+ *           frames, with TELEMETRY_FLAG_MORE and its backlog in the health
+ *           extension as a node's flash backlog does
+ *   alarm   NODE_SIM_ALARM_PERMILLE of the live records are flagged
+ *           TELEMETRY_REC_URGENT, so the gateway's alarm lane carries
+ *           them past the replays; esp32_gateway_alarm_latency_ms shows
+ *           what that costs as the load rises
+ *
+ * ESP-NOW sends from the interface MAC, and changing it needs the WiFi
+ * interface down, so every virtual node shares the board's MAC: the
+ * gateway tells them apart by node id (records, MQTT topics, aggregates,
+ * trends), while its node_table sees one peer. Frames are sent bare, past
+ * the reliable layer, whose sessions are kept per MAC; a frame the gateway
+ * defers is lost, and counted there as deferred.
+ *
+ * The period starts at NODE_SIM_INTERVAL_MS and, every NODE_SIM_RAMP_STEP_MS,
+ * shrinks by a quarter down to NODE_SIM_INTERVAL_MIN_MS, so one run walks
+ * the offered load up to the ceiling. Each step is logged with the load
+ * offered and delivered. On the gateway the esp32_gateway_*, esp32_espnow_rx_*
+ * and esp32_mqtt_* families on /metrics give throughput, queue depths and
+ * the MQTT drain rate over the same run. Sends that fall more than a
+ * period behind their slot are counted as late: the simulator, not the
+ * gateway, is the bottleneck then.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef NODE_SIM_H
+#define NODE_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define NODE_SIM_MAX_NODES 64                   // Virtual nodes the state table holds
+#ifndef NODE_SIM_NODES
+#define NODE_SIM_NODES 16                       // Virtual nodes imitated; build with -D NODE_SIM_NODES=n
+#endif
+#ifndef NODE_SIM_INTERVAL_MS
+#define NODE_SIM_INTERVAL_MS 10000              // Each node's period at the start of a run
+#endif
+#ifndef NODE_SIM_INTERVAL_MIN_MS
+#define NODE_SIM_INTERVAL_MIN_MS 100            // The ramp stops here
+#endif
+#ifndef NODE_SIM_RAMP_STEP_MS
+#define NODE_SIM_RAMP_STEP_MS 60000             // Period shortened by a quarter this often; 0 holds it
+#endif
+#ifndef NODE_SIM_LOSS_PERMILLE
+#define NODE_SIM_LOSS_PERMILLE 20               // Live frames skipped
+#endif
+#ifndef NODE_SIM_OUTAGE_PERMILLE
+#define NODE_SIM_OUTAGE_PERMILLE 5              // Live frames that start an outage instead
+#endif
+#ifndef NODE_SIM_ALARM_PERMILLE
+#define NODE_SIM_ALARM_PERMILLE 5               // Live records flagged as alarms
+#endif
+#define NODE_SIM_OUTAGE_RECORDS 128             // Records held through an outage and replayed after it
+#define NODE_SIM_LOG_INTERVAL_MS 10000
+
+/**
+ * @brief Counters since node_sim_init()
+ */
+typedef struct {
+    uint32_t frames;                            // Frames the gateway's radio acknowledged
+    uint32_t records;                           // Records in those frames
+    uint32_t failed;                            // Frames sent but not acknowledged
+    uint32_t skipped;                           // Live frames left out on purpose
+    uint32_t replays;                           // Outages replayed
+    uint32_t alarms;                            // Live records flagged as alarms
+    uint32_t late;                              // Sends more than a period behind their slot
+    uint32_t interval_ms;                       // Each node's period now
+    uint16_t nodes;
+} node_sim_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Bring up the radio and the ESP-NOW link to the configured gateway
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG without a usable server MAC, or the WiFi/ESP-NOW error
+ */
+esp_err_t node_sim_init(void);
+
+/**
+ * @brief Main loop body: sleep until the next node is due, then send for every node that is
+ */
+void node_sim_main(void);
+
+/**
+ * @brief Copy the counters
+ */
+void node_sim_get_stats(node_sim_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NODE_SIM_H
@@ -0,0 +1,164 @@
+/**
+ * @file node_table.h
+ * @brief Gateway per-node state: last seq, RSSI, key epoch, link quality, health and latest reading, O(1) by MAC
+ *
+ * A fixed-capacity open-addressing table (linear probing, load kept under
+ * 75%) keyed by the node's MAC. It is stored as a struct of arrays: the
+ * keys probed on every lookup sit together, and so do the fields every
+ * frame writes (seq, last seen, RSSI, quality), away from the counters
+ * only read by /api/nodes and METRIC_GATEWAY_NODES. The bookkeeping per
+ * frame is then one hash, a probe or two and a few stores, however many
+ * nodes report.
+ *
+ * Sample integrity is checked as frames arrive, in O(1) per frame: each
+ * node keeps a NODE_TABLE_SEQ_WINDOW-bit map of the sample seqs below its
+ * newest one. A frame ahead of it slides the map (the seqs skipped are
+ * lost); one behind it is checked against the map with a mask, so a
+ * sample sent twice (a resend after a lost ACK, a failover, a replayed
+ * backlog) counts as a duplicate and one that fills a gap as late, taking
+ * it off the lost count. Timestamps must move with the seqs: a newer
+ * sample dated earlier than the one before it, or ahead of the gateway's
+ * clock by more than NODE_TABLE_CLOCK_SLACK_S, is a clock fault. The
+ * counts and each node's completeness go to /api/nodes and, through
+ * node_table_write_metrics(), to /metrics.
+ *
+ * Updated from the link task only; readers copy entries under a spinlock.
+ * Nodes are never removed: a node beyond NODE_TABLE_MAX_NODES is counted
+ * as an overflow and not tracked.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef NODE_TABLE_H
+#define NODE_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "json_writer.h"
+#include "metrics_export.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define NODE_TABLE_CAPACITY 64                  // Slots; power of two
+#define NODE_TABLE_MAX_NODES 48                 // Nodes tracked (75% load keeps probe runs short)
+#define NODE_TABLE_EWMA_WEIGHT 8                // RSSI and quality move 1/8 of the way per frame
+#define NODE_TABLE_SEQ_JUMP 10000               // A larger forward jump is a node restart, not loss
+#define NODE_TABLE_SEQ_WINDOW 64                // Seqs below the newest checked for duplicates and late samples
+#define NODE_TABLE_CLOCK_SLACK_S 2              // Sample times may lead the gateway's clock by this much
+#define NODE_TABLE_LEAD_UNKNOWN INT32_MIN       // clock_lead_s without a set clock on either side
+#define NODE_TABLE_AWAKE_UNKNOWN 0xFFFF         // awake_bp before a frame with the power extension
+#define NODE_TABLE_RAIN_UNKNOWN 0xFFFF          // rain_rate before a frame with the rain extension
+#define NODE_TABLE_HEALTH_UNKNOWN 0xFFFF        // supply_mv and backlog before a frame with the health extension
+
+/**
+ * @brief One node, as copied out of the table
+ */
+typedef struct {
+    uint8_t mac[6];
+    uint32_t node_id;                           // From its telemetry header; 0 before the first
+    uint32_t last_seq;                          // Newest sample seq received
+    uint32_t last_seen_ms;                      // Uptime of its last frame
+    int16_t rssi_x16;                           // Smoothed RSSI, 1/16 dBm
+    int8_t rssi_min;                            // Weakest frame, dBm
+    uint16_t quality_permille;                  // Smoothed share of samples received, from seq gaps
+    uint8_t key_epoch;                          // espnow_link_peer_epoch(); ESPNOW_LINK_EPOCH_NONE if unknown
+    uint32_t frames;                            // Frames received (duplicates included)
+    uint32_t records;                           // Samples received, each seq once
+    uint32_t lost;                              // Samples missing between received seqs
+    uint32_t duplicates;                        // Samples received again
+    uint32_t late;                              // Samples that filled a gap (in records, no longer in lost)
+    uint16_t completeness_permille;             // records / (records + lost), since the table started
+    uint16_t restarts;                          // Seq went back or jumped: the node restarted
+    uint16_t clock_faults;                      // Frames whose times went back, or led the gateway's clock
+    int32_t clock_lead_s;                       // Newest sample time less the gateway's clock on arrival; NODE_TABLE_LEAD_UNKNOWN
+    uint16_t awake_bp;                          // Reported share of time awake, 0.01 %; NODE_TABLE_AWAKE_UNKNOWN
+    uint16_t wake_ms;                           // Reported mean ms per deep sleep wake
+    uint32_t rain_tips;                         // Rain gauge tips reported, summed across node restarts
+    uint16_t rain_rate;                         // Reported rain in the last hour, 0.01 mm/h; NODE_TABLE_RAIN_UNKNOWN
+    uint16_t supply_mv;                         // Reported supply; NODE_TABLE_HEALTH_UNKNOWN
+    uint16_t backlog;                           // Records the node reported waiting to send; NODE_TABLE_HEALTH_UNKNOWN
+    bool lr;                                    // Sends in ESP-NOW Long Range mode, and is answered in it
+    bool have_reading;                          // The fields below hold the newest sample received
+    int16_t temperature;                        // 0.01 degC
+    uint32_t humidity;                          // 0.001 %RH
+    uint32_t pressure;                          // Pa
+    uint32_t reading_s;                         // Unix seconds of that sample
+    uint8_t sensors;                            // Bit n: sensor_quantity_t n (sensor_hal.h) seen in a reading
+} node_table_entry_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Empty the table and register METRIC_GATEWAY_NODES
+ */
+esp_err_t node_table_init(void);
+
+/**
+ * @brief Account for one received frame; link task
+ *
+ * @param mac Sender
+ * @param rssi Signal strength of the frame, dBm
+ */
+void node_table_on_frame(const uint8_t *mac, int8_t rssi);
+
+/**
+ * @brief Account for the samples of one newly delivered telemetry frame; link task
+ *
+ * Seq gaps since the node's previous frame count as lost samples and
+ * lower its quality; samples already received count as duplicates, and
+ * a gap they fill as late (see above). A change of TELEMETRY_FLAG_LR moves the node's peer
+ * into or out of Long Range mode (espnow_link_peer_set_lr()).
+ *
+ * @param mac Sender
+ * @param hdr Decoded header
+ * @param last The frame's last record, kept as the node's latest reading; NULL to keep the previous one
+ */
+void node_table_on_telemetry(const uint8_t *mac, const telemetry_header_t *hdr, const telemetry_record_t *last);
+
+/**
+ * @brief Nodes tracked
+ */
+size_t node_table_count(void);
+
+/**
+ * @brief Copy the nth tracked node (0 .. node_table_count() - 1, in table order)
+ *
+ * @return bool false past the last node
+ */
+bool node_table_get(size_t n, node_table_entry_t *entry);
+
+/**
+ * @brief Changes whenever a node first reports a reading, or a sensor it had not reported before
+ *
+ * Lets a reader (ha_discovery.h) skip the table walk while nothing new appeared.
+ */
+uint32_t node_table_generation(void);
+
+/**
+ * @brief Write every node as JSON, for /api/nodes
+ */
+void node_table_write_json(json_writer_t *w);
+
+/**
+ * @brief Write the per-node sample integrity families, labelled by node id; from a metrics_export source
+ */
+void node_table_write_metrics(metrics_export_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NODE_TABLE_H
@@ -1,6 +1,22 @@
 /**
  * @file nvs_utils.h
  * @brief NVS utility functions for configuration management
+ *
+ * The "config" namespace holds the Wi-Fi, bridge and MQTT passwords and
+ * the ESP-NOW keys. [env:secure] (sdkconfig.secure.defaults) stores it
+ * encrypted: CONFIG_NVS_ENCRYPTION makes nvs_flash_init() encrypt every
+ * entry with XTS-AES, run on the AES accelerator. The ESP32 has no HMAC
+ * peripheral to derive the NVS keys from an eFuse key, so they are
+ * generated on the first boot into the nvs_keys partition
+ * (partitions_secure.csv), and flash encryption keeps that partition
+ * readable only through the flash cache, with the key in eFuse.
+ *
+ * Encryption costs time on every NVS read and write. The RAM config cache
+ * pays it once per boot, in nvs_utils_init(), and the deferred flush pays
+ * it per batch of changes; nvs_config_get() never decrypts. The bench
+ * suite's nvs_config_* cases measure both paths ([env:bench-secure]
+ * against [env:bench]).
+ *
  * @version 1.0.0
  * @date 2025-10-18
  * @author John Devine
@@ -10,6 +26,7 @@
 #ifndef NVS_UTILS_H
 #define NVS_UTILS_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 #include "esp_err.h"
@@ -37,287 +54,267 @@ extern "C" {
 // Device role definitions
 #define DEVICE_ROLE_GATEWAY 1
 #define DEVICE_ROLE_RESPONDER 2
+#define DEVICE_ROLE_LINK_TEST_TX 3              // ESP-NOW link test initiator (link_test.h)
+#define DEVICE_ROLE_LINK_TEST_RX 4              // ESP-NOW link test reflector
+#define DEVICE_ROLE_NODE_SIM 5                  // Virtual nodes for gateway soak tests (node_sim.h)
+#define DEVICE_ROLE_VALID(role) ((role) >= DEVICE_ROLE_GATEWAY && (role) <= DEVICE_ROLE_NODE_SIM)
 
 // MQTT defaults
 #define MQTT_DEFAULT_PORT 1883
 #define MQTT_DEFAULT_QOS 0
 
-// =============================
-// Function Prototypes
-// =============================
+// MQTT payload formats (mqtt_format)
+#define MQTT_FORMAT_FIELDS 0                    // One message per metric per sample
+#define MQTT_FORMAT_JSON 1                      // One columnar JSON message per node per batch window
+#define MQTT_FORMAT_CBOR 2                      // The same batch, CBOR encoded
+#define MQTT_DEFAULT_FORMAT MQTT_FORMAT_FIELDS
+
+// BME680 oversampling/filter profiles (bme680_profile), the driver's bme680_profile_t
+#define SENSOR_PROFILE_LOW_POWER 0              // Shortest conversion, noisiest
+#define SENSOR_PROFILE_BALANCED 1
+#define SENSOR_PROFILE_HIGH_PRECISION 2         // Longest conversion; its IIR filter lags a step by a few samples
+#define SENSOR_DEFAULT_PROFILE SENSOR_PROFILE_BALANCED
+
+// Deferred config flush (see nvs_config_update)
+#ifndef NVS_CONFIG_FLUSH_DELAY_MS
+#define NVS_CONFIG_FLUSH_DELAY_MS 2000          // Quiet time after the last update before writing
+#endif
+#define NVS_CONFIG_FLUSH_MAX_DELAY_MS 10000     // Longest an update may wait during a burst
 
 /**
- * @brief Initialize NVS storage system
+ * @brief Where the bridge uplink was last found, for reconnecting without a scan
  *
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * Kept apart from device_config_t: the station writes it, not the user.
  */
-esp_err_t nvs_utils_init(void);
+typedef struct {
+    char ssid[BRIDGE_SSID_MAX_LEN];             // Bridge SSID the entry belongs to
+    uint8_t bssid[6];
+    uint8_t channel;                            // 0 = no entry
+} nvs_sta_cache_t;
 
-/**
- * @brief Store server MAC address to NVS
- *
- * @param mac MAC address string (format: "AA:BB:CC:DD:EE:FF")
- * @return esp_err_t ESP_OK on success, error code otherwise
- */
-esp_err_t nvs_store_server_mac(const char *mac);
+#define NVS_ESPNOW_NODES_MAX 16                 // One under ESPNOW_LINK_MAX_PEERS, leaving the broadcast peer a slot
 
 /**
- * @brief Load server MAC address from NVS
+ * @brief Nodes a gateway has paired, made ESP-NOW peers again at boot so their encrypted frames get through
  *
- * @param mac Buffer to store MAC address string
- * @param len Length of buffer (should be MAC_ADDR_STR_LEN)
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * Kept apart from device_config_t: pairing writes it, not the user.
  */
-esp_err_t nvs_load_server_mac(char *mac, size_t len);
+typedef struct {
+    uint8_t count;
+    uint8_t mac[NVS_ESPNOW_NODES_MAX][6];       // Oldest first
+} nvs_espnow_nodes_t;
 
-/**
- * @brief Store IP address to NVS
- *
- * @param ip IP address string (format: "192.168.1.100")
- * @return esp_err_t ESP_OK on success, error code otherwise
- */
-esp_err_t nvs_store_ip_address(const char *ip);
+#define NODE_SETTINGS_LR (1 << 0)               // Send to the gateway in ESP-NOW Long Range mode
 
 /**
- * @brief Load IP address from NVS
- *
- * @param ip Buffer to store IP address string
- * @param len Length of buffer (should be IP_ADDR_STR_LEN)
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @brief Node sampling settings a gateway can push (espnow_config.h); 0 in a field keeps the build default
  */
-esp_err_t nvs_load_ip_address(char *ip, size_t len);
+typedef struct {
+    uint16_t version;                           // Gateway's number for this config, 0 = never pushed
+    uint8_t batch_samples;                      // Samples per duty-cycle batch send
+    uint8_t flags;                              // NODE_SETTINGS_*
+    uint32_t sample_ms;                         // Sample period (rounded to seconds while duty cycling)
+    uint16_t heater_temp_c;                     // BME680 gas heater target
+    uint16_t heater_ms;                         // ... and hold time
+} node_settings_t;
 
-/**
- * @brief Store WiFi password to NVS
- *
- * @param password WiFi password string
- * @return esp_err_t ESP_OK on success, error code otherwise
- */
-esp_err_t nvs_store_wifi_password(const char *password);
+#define CALIB_POINTS 12                         // Points per calibration table (calib.h)
 
 /**
- * @brief Load WiFi password from NVS
- *
- * @param password Buffer to store password string
- * @param len Length of buffer (should be WIFI_PASS_MAX_LEN)
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @brief A sensor's calibration table (calib.h)
  */
-esp_err_t nvs_load_wifi_password(char *password, size_t len);
+typedef struct {
+    uint8_t count;                              // Points in use, 2..CALIB_POINTS; 0 = the build's constants
+    uint8_t reserved[3];
+    int16_t x[CALIB_POINTS];                    // Inputs, strictly rising
+    int16_t y[CALIB_POINTS];
+} calib_table_t;
 
 /**
- * @brief Store ESP-NOW active encryption key to NVS
- *
- * @param key 16-byte encryption key
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @brief Every setting held in the "config" NVS namespace; each member has a line in CONFIG_SCHEMA (config_schema.h)
  */
-esp_err_t nvs_store_espnow_active_key(const uint8_t *key);
+typedef struct {
+    char server_mac[MAC_ADDR_STR_LEN];
+    uint8_t server_channel;                     // Channel the node paired on (espnow_pair.h); 0 = not known
+    char ip_address[IP_ADDR_STR_LEN];
+    char wifi_password[WIFI_PASS_MAX_LEN];
+    uint8_t espnow_active_key[ESPNOW_KEY_LEN];
+    uint8_t espnow_pending_key[ESPNOW_KEY_LEN];
+    uint8_t device_role;
+    char bridge_ssid[BRIDGE_SSID_MAX_LEN];
+    char bridge_password[BRIDGE_PASS_MAX_LEN];
+    char mqtt_server_ip[MQTT_IP_MAX_LEN];
+    uint16_t mqtt_port;
+    char mqtt_username[MQTT_USER_MAX_LEN];
+    char mqtt_password[MQTT_PASS_MAX_LEN];
+    char mqtt_client_id[MQTT_CLIENT_ID_MAX_LEN];
+    uint8_t mqtt_qos;
+    char mqtt_base_topic[MQTT_BASE_TOPIC_MAX_LEN];
+    uint8_t mqtt_format;                        // MQTT_FORMAT_*
+    uint8_t bme680_profile;                     // SENSOR_PROFILE_*; nodes only
+    node_settings_t node_settings;              // Nodes only; set by the gateway, not the config page
+    calib_table_t calib_vane;                   // Set from /api/calibration, not the config page
+    calib_table_t calib_wind;
+    calib_table_t calib_supply;
+} device_config_t;
 
-/**
- * @brief Load ESP-NOW active encryption key from NVS
- *
- * @param key Buffer to store 16-byte encryption key
- * @return esp_err_t ESP_OK on success, error code otherwise
- */
-esp_err_t nvs_load_espnow_active_key(uint8_t *key);
+// =============================
+// Function Prototypes
+// =============================
 
 /**
- * @brief Store ESP-NOW pending encryption key to NVS
+ * @brief Initialize NVS storage system
  *
- * @param key 16-byte encryption key
- * @return esp_err_t ESP_OK on success, error code otherwise
- */
-esp_err_t nvs_store_espnow_pending_key(const uint8_t *key);
-
-/**
- * @brief Load ESP-NOW pending encryption key from NVS
+ * Also fills the RAM config cache and starts the background flush task.
  *
- * @param key Buffer to store 16-byte encryption key
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
-esp_err_t nvs_load_espnow_pending_key(uint8_t *key);
-
-/**
- * @brief Store boot count to NVS
- *
- * @param count Boot count value
- * @return esp_err_t ESP_OK on success, error code otherwise
- */
-esp_err_t nvs_store_boot_count(uint32_t count);
+esp_err_t nvs_utils_init(void);
 
 /**
- * @brief Load boot count from NVS
- *
- * @param count Pointer to store boot count value
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @brief Whether NVS is stored encrypted: CONFIG_NVS_ENCRYPTION, with flash encryption on
  */
-esp_err_t nvs_load_boot_count(uint32_t *count);
+bool nvs_utils_encrypted(void);
 
 /**
- * @brief Store device role to NVS
+ * @brief Fill a configuration with the defaults used for missing keys (config_schema.h)
  *
- * @param role Device role (DEVICE_ROLE_GATEWAY or DEVICE_ROLE_RESPONDER)
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @param cfg Configuration to fill
  */
-esp_err_t nvs_store_device_role(uint8_t role);
+void nvs_config_set_defaults(device_config_t *cfg);
 
 /**
- * @brief Load device role from NVS
+ * @brief Load every configuration field with a single NVS open
  *
- * @param role Pointer to store device role value
- * @return esp_err_t ESP_OK on success, error code otherwise
- */
-esp_err_t nvs_load_device_role(uint8_t *role);
-
-/**
- * @brief Store bridge WiFi SSID to NVS
+ * Keys that are not stored yet (including a missing namespace on first boot)
+ * take their defaults from the schema (config_schema.h).
  *
- * @param ssid Bridge WiFi SSID string
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @param cfg Configuration to fill
+ * @return esp_err_t ESP_OK on success, error code of the first failed read otherwise
  */
-esp_err_t nvs_store_bridge_ssid(const char *ssid);
+esp_err_t nvs_load_config(device_config_t *cfg);
 
 /**
- * @brief Load bridge WiFi SSID from NVS
+ * @brief Store every configuration field with a single NVS open and commit
  *
- * @param ssid Buffer to store SSID string
- * @param len Length of buffer (should be BRIDGE_SSID_MAX_LEN)
- * @return esp_err_t ESP_OK on success, error code otherwise
- */
-esp_err_t nvs_load_bridge_ssid(char *ssid, size_t len);
-
-/**
- * @brief Store bridge WiFi password to NVS
+ * The whole configuration is validated before anything is written. NVS skips
+ * keys whose value is unchanged, so saving an edited copy of a loaded
+ * configuration only writes the fields that changed.
  *
- * @param password Bridge WiFi password string
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @param cfg Configuration to store
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if a field is invalid, error code otherwise
  */
-esp_err_t nvs_store_bridge_password(const char *password);
+esp_err_t nvs_store_config(const device_config_t *cfg);
 
 /**
- * @brief Load bridge WiFi password from NVS
+ * @brief Get a snapshot of the RAM-resident configuration
  *
- * @param password Buffer to store password string
- * @param len Length of buffer (should be BRIDGE_PASS_MAX_LEN)
- * @return esp_err_t ESP_OK on success, error code otherwise
- */
-esp_err_t nvs_load_bridge_password(char *password, size_t len);
-
-/**
- * @brief Store MQTT server IP address to NVS
+ * A memcpy under a short critical section; never touches flash once
+ * nvs_utils_init() has filled the cache. Includes updates not yet flushed.
  *
- * @param ip MQTT server IP address string
+ * @param cfg Configuration to fill
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
-esp_err_t nvs_store_mqtt_server_ip(const char *ip);
+esp_err_t nvs_config_get(device_config_t *cfg);
 
 /**
- * @brief Load MQTT server IP address from NVS
+ * @brief Replace the RAM-resident configuration and schedule a deferred flush
  *
- * @param ip Buffer to store IP address string
- * @param len Length of buffer (should be MQTT_IP_MAX_LEN)
- * @return esp_err_t ESP_OK on success, error code otherwise
- */
-esp_err_t nvs_load_mqtt_server_ip(char *ip, size_t len);
-
-/**
- * @brief Store MQTT server port to NVS
+ * Fields that differ from the cache are marked dirty and the flush task
+ * writes them after NVS_CONFIG_FLUSH_DELAY_MS of quiet, so repeated saves
+ * collapse into one commit. Pending changes are also flushed on esp_restart().
  *
- * @param port MQTT server port
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @param cfg New configuration (validated like nvs_store_config())
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if a field is invalid
  */
-esp_err_t nvs_store_mqtt_port(uint16_t port);
+esp_err_t nvs_config_update(const device_config_t *cfg);
 
 /**
- * @brief Load MQTT server port from NVS
+ * @brief Write any pending configuration changes to NVS now
  *
- * @param port Pointer to store port value
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @return esp_err_t ESP_OK on success (including nothing to write), error code otherwise
  */
-esp_err_t nvs_load_mqtt_port(uint16_t *port);
+esp_err_t nvs_config_flush(void);
 
 /**
- * @brief Store MQTT username to NVS
+ * @brief Store ESP-NOW active encryption key to NVS
  *
- * @param username MQTT username string
+ * @param key 16-byte encryption key
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
-esp_err_t nvs_store_mqtt_username(const char *username);
+esp_err_t nvs_store_espnow_active_key(const uint8_t *key);
 
 /**
- * @brief Load MQTT username from NVS
+ * @brief Load ESP-NOW active encryption key from NVS
  *
- * @param username Buffer to store username string
- * @param len Length of buffer (should be MQTT_USER_MAX_LEN)
+ * @param key Buffer to store 16-byte encryption key
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
-esp_err_t nvs_load_mqtt_username(char *username, size_t len);
+esp_err_t nvs_load_espnow_active_key(uint8_t *key);
 
 /**
- * @brief Store MQTT password to NVS
+ * @brief Store ESP-NOW pending encryption key to NVS
  *
- * @param password MQTT password string
+ * @param key 16-byte encryption key
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
-esp_err_t nvs_store_mqtt_password(const char *password);
+esp_err_t nvs_store_espnow_pending_key(const uint8_t *key);
 
 /**
- * @brief Load MQTT password from NVS
+ * @brief Load ESP-NOW pending encryption key from NVS
  *
- * @param password Buffer to store password string
- * @param len Length of buffer (should be MQTT_PASS_MAX_LEN)
+ * @param key Buffer to store 16-byte encryption key
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
-esp_err_t nvs_load_mqtt_password(char *password, size_t len);
+esp_err_t nvs_load_espnow_pending_key(uint8_t *key);
 
 /**
- * @brief Store MQTT client ID to NVS
+ * @brief Store boot count to NVS
  *
- * @param client_id MQTT client ID string
+ * @param count Boot count value
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
-esp_err_t nvs_store_mqtt_client_id(const char *client_id);
+esp_err_t nvs_store_boot_count(uint32_t count);
 
 /**
- * @brief Load MQTT client ID from NVS
+ * @brief Load boot count from NVS
  *
- * @param client_id Buffer to store client ID string
- * @param len Length of buffer (should be MQTT_CLIENT_ID_MAX_LEN)
+ * @param count Pointer to store boot count value
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
-esp_err_t nvs_load_mqtt_client_id(char *client_id, size_t len);
+esp_err_t nvs_load_boot_count(uint32_t *count);
 
 /**
- * @brief Store MQTT QoS level to NVS
+ * @brief Store the BSSID and channel of the bridge uplink to NVS
  *
- * @param qos MQTT QoS level (0, 1, or 2)
+ * @param cache Uplink location; a zero channel clears it
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
-esp_err_t nvs_store_mqtt_qos(uint8_t qos);
+esp_err_t nvs_store_sta_cache(const nvs_sta_cache_t *cache);
 
 /**
- * @brief Load MQTT QoS level from NVS
+ * @brief Load the BSSID and channel of the bridge uplink from NVS
  *
- * @param qos Pointer to store QoS value
+ * @param cache Filled in; zeroed (channel 0) when nothing is stored
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
-esp_err_t nvs_load_mqtt_qos(uint8_t *qos);
+esp_err_t nvs_load_sta_cache(nvs_sta_cache_t *cache);
 
 /**
- * @brief Store MQTT base topic to NVS
+ * @brief Store the gateway's paired nodes to NVS
  *
- * @param topic MQTT base topic string
+ * @param nodes Node MACs; a zero count clears them
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
-esp_err_t nvs_store_mqtt_base_topic(const char *topic);
+esp_err_t nvs_store_espnow_nodes(const nvs_espnow_nodes_t *nodes);
 
 /**
- * @brief Load MQTT base topic from NVS
+ * @brief Load the gateway's paired nodes from NVS
  *
- * @param topic Buffer to store base topic string
- * @param len Length of buffer (should be MQTT_BASE_TOPIC_MAX_LEN)
+ * @param nodes Filled in; zeroed (count 0) when nothing is stored
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
-esp_err_t nvs_load_mqtt_base_topic(char *topic, size_t len);
+esp_err_t nvs_load_espnow_nodes(nvs_espnow_nodes_t *nodes);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,136 @@
+/**
+ * @file nvs_wear.h
+ * @brief NVS fill level per namespace, writes per key, and how long the partition lasts at this write rate
+ *
+ * The NVS partition is small (20 KB, five 4 KB pages, one kept free for
+ * garbage collection) and every change to a value appends new entries:
+ * once the pages are full, the oldest is compacted and erased. Each
+ * entries_total worth of writes therefore costs every page about one
+ * erase cycle, and a key rewritten every second wears the partition out
+ * in a few years.
+ *
+ * Writes are noted through flash_io's NVS paths, which call
+ * nvs_wear_note() with the key and size; the entries a write takes are
+ * estimated as the NVS format lays them out (one per primitive value or
+ * short string, two plus one per 32 bytes for a blob). NVS skips a write
+ * whose value has not changed, so the estimate errs on the side of more
+ * wear. SystemMetrics' boot counter, written once per boot outside the
+ * wrappers, is noted at nvs_wear_start().
+ *
+ * The write rate is averaged over the last NVS_WEAR_WINDOW_HOURS (at least
+ * an hour, so the settings written at boot do not extrapolate), and the
+ * projected life is
+ *
+ *   NVS_WEAR_ENDURANCE_CYCLES * usable entries / entries written per day
+ *
+ * health_watch.h raises "nvs_wear" when that falls below
+ * NVS_WEAR_DEPLOYMENT_DAYS. /metrics carries the partition's used, free
+ * and total entries, used entries per namespace, writes per key and the
+ * projection as esp32_nvs_* families.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef NVS_WEAR_H
+#define NVS_WEAR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef NVS_WEAR_DEPLOYMENT_DAYS
+#define NVS_WEAR_DEPLOYMENT_DAYS 3650           // Service life the partition must outlast
+#endif
+#define NVS_WEAR_ENDURANCE_CYCLES 100000        // Erase cycles per sector, the flash datasheet minimum
+#define NVS_WEAR_ENTRIES_PER_PAGE 126           // 32-byte entries in a 4 KB NVS page
+#define NVS_WEAR_WINDOW_HOURS 24                // Write rate averaged over this
+#define NVS_WEAR_LIFE_CAP_DAYS 365000           // Projection reported when almost nothing is written
+#define NVS_WEAR_MAX_KEYS 16                    // Keys counted separately; more share "other"
+#define NVS_WEAR_MAX_NAMESPACES 12              // Namespaces reported on /metrics
+
+/**
+ * @brief Partition fill and write rate
+ */
+typedef struct {
+    bool running;
+    uint32_t total_entries;                     // From nvs_get_stats(), read when copied
+    uint32_t used_entries;
+    uint32_t free_entries;
+    uint32_t namespaces;
+    uint32_t writes;                            // Since boot
+    uint32_t entries_written;                   // Estimated, since boot
+    uint32_t entries_per_day;                   // Over the window
+    uint32_t life_days;                         // Projected; NVS_WEAR_LIFE_CAP_DAYS when idle
+} nvs_wear_stats_t;
+
+/**
+ * @brief Writes to one key since boot
+ */
+typedef struct {
+    char key[NVS_KEY_NAME_MAX_SIZE];            // "other" for keys past NVS_WEAR_MAX_KEYS
+    uint32_t writes;
+    uint32_t entries;                           // Estimated
+} nvs_wear_key_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Read the partition size and add the esp32_nvs_* families to /metrics
+ *
+ * Call after nvs_flash_init() and system_metrics_init().
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if already started, or the nvs_get_stats() error
+ */
+esp_err_t nvs_wear_start(void);
+
+/**
+ * @brief Count a successful write to an NVS key
+ *
+ * @param key Key written
+ * @param bytes Size of the value
+ */
+void nvs_wear_note(const char *key, size_t bytes);
+
+/**
+ * @brief Days until the partition wears out at the current write rate
+ *
+ * Reader for health_watch's nvs_wear rule.
+ *
+ * @param days Receives the projection, at most NVS_WEAR_LIFE_CAP_DAYS
+ * @return false before nvs_wear_start()
+ */
+bool nvs_wear_life_days(int64_t *days);
+
+/**
+ * @brief Copy the counters and read the partition's entry counts
+ */
+void nvs_wear_get_stats(nvs_wear_stats_t *out);
+
+/**
+ * @brief Copy the per-key counters
+ *
+ * @param out Array of at least max entries
+ * @param max Its length
+ * @return Keys copied
+ */
+size_t nvs_wear_get_keys(nvs_wear_key_t *out, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NVS_WEAR_H
@@ -14,8 +14,10 @@
 // =============================
 #include <stdbool.h>
 #include "esp_err.h"
+#include "task_plan.h"
 #include "esp_ota_ops.h"
 #include "esp_http_server.h"
+#include "json_writer.h"
 
 // =============================
 // Constants & Definitions
@@ -23,9 +25,18 @@
 #define OTA_CHUNK_SIZE          8192
 #define OTA_MAX_FIRMWARE_SIZE   (1280 * 1024)  // 1.25MB
 #define OTA_MAX_FILESYSTEM_SIZE (1472 * 1024)  // ~1.44MB
-#define OTA_MAX_BOOT_ATTEMPTS   3
 #define OTA_HASH_LEN            32              // SHA256 hash length
 #define OTA_HASH_STR_LEN        65              // SHA256 hex string length
+#define OTA_FLASH_SECTOR_SIZE   4096            // Erase granularity for filesystem images
+
+// Flash writer pipeline: the HTTP task fills one block while the writer task
+// commits and hashes the previous one
+#define OTA_WRITER_BLOCKS       2               // Ping-pong blocks of OTA_CHUNK_SIZE bytes
+#define OTA_WRITER_TIMEOUT_MS   15000           // Longest wait for the writer to free a block
+
+// Backup download: flash is mapped a window at a time and sent from the mapping
+#define OTA_BACKUP_MAP_BYTES    (64 * 1024)     // One MMU page per window
+#define OTA_BACKUP_SEND_BYTES   (16 * 1024)     // Per HTTP chunk, hashed just before it is sent
 
 typedef enum {
     OTA_STATE_IDLE = 0,
@@ -41,6 +52,12 @@ typedef enum {
     OTA_TYPE_FILESYSTEM
 } ota_type_t;
 
+// How the uploaded bytes relate to the image written to flash
+typedef enum {
+    OTA_ENCODING_RAW = 0,                       // Upload is the image itself
+    OTA_ENCODING_ZLIB                           // zlib stream (RFC 1950), inflated on the writer task
+} ota_encoding_t;
+
 typedef struct {
     ota_state_t state;
     ota_type_t type;
@@ -51,7 +68,16 @@ typedef struct {
     bool backup_available;
     bool backup_created;
     bool backup_skipped;
-    bool reboot_required;
+    bool reboot_required;                    // False for a filesystem image in the spare asset slot
+    char computed_hash[OTA_HASH_STR_LEN];   // SHA-256 of the received image, empty until finalized
+    bool hash_verified;                      // computed_hash matched the expected hash
+    uint32_t upload_ms;                      // Start to last block committed
+    uint32_t flash_ms;                       // Writer time spent in flash writes/erases
+    uint32_t hash_ms;                        // Writer time spent hashing
+    size_t image_size;                       // Bytes written to flash (after inflating)
+    size_t written_size;                     // Bytes the writer has committed so far
+    uint32_t rate_bps;                       // Average upload rate since the start
+    uint32_t eta_s;                          // Seconds left at that rate, 0 if unknown
 } ota_status_t;
 
 typedef struct {
@@ -59,6 +85,9 @@ typedef struct {
     bool verify_crypto;
     char expected_hash[OTA_HASH_STR_LEN];
     ota_type_t update_type;
+    ota_encoding_t encoding;
+    size_t total_size;                          // Expected upload bytes for progress/ETA, 0 if unknown
+    bool for_nodes;                             // Firmware for the ESP-NOW nodes: staged for espnow_ota, not booted
 } ota_config_t;
 
 // =============================
@@ -87,29 +116,62 @@ esp_err_t ota_start_update(const ota_config_t* config);
 
 /**
  * @brief Process uploaded OTA data chunk
+ *
+ * The data is copied into the current writer block and the call returns as
+ * soon as it is queued; inflating, flash writes and hashing happen on the
+ * writer task.
+ *
  * @param data Data chunk to process
  * @param size Size of data chunk
- * @return ESP_OK on success, error code on failure
+ * @return ESP_OK on success, the writer's first error, or ESP_ERR_TIMEOUT if the writer stalls
  */
 esp_err_t ota_process_chunk(const uint8_t* data, size_t size);
 
 /**
  * @brief Finalize OTA update process
+ *
+ * Flushes the last partial block and waits for the writer to drain first.
+ *
  * @return ESP_OK on success, error code on failure
  */
 esp_err_t ota_finalize_update(void);
 
 /**
  * @brief Get current OTA status
+ *
+ * Returns a consistent snapshot without taking a lock, so it is safe and
+ * cheap to call from any task while an upload is running.
+ *
  * @param status Pointer to status structure to fill
  * @return ESP_OK on success, error code on failure
  */
 esp_err_t ota_get_status(ota_status_t* status);
 
 /**
- * @brief Create backup of current firmware/filesystem (optional)
+ * @brief Short lowercase name of a state ("idle", "uploading", ...)
+ * @param state State to name
+ * @return Static string
+ */
+const char *ota_state_name(ota_state_t state);
+
+/**
+ * @brief Write the progress members of a status snapshot into an open JSON object
+ *
+ * Shared by GET /api/ota and the live "ota" events so both report the same fields.
+ *
+ * @param w Writer positioned inside an object
+ * @param status Snapshot from ota_get_status()
+ */
+void ota_write_status_json(json_writer_t *w, const ota_status_t *status);
+
+/**
+ * @brief Mark a backup of the running firmware or the filesystem as available for download
+ *
+ * Nothing is copied: GET /api/ota/backup sends the partition straight from
+ * flash. This checks there is an image to send and records it in the status.
+ *
  * @param type Type of backup to create
- * @return ESP_OK on success, error code on failure, ESP_ERR_NOT_SUPPORTED if disabled
+ * @return ESP_OK, or the error from ota_get_backup_extent()
  */
 esp_err_t ota_create_backup(ota_type_t type);
 
@@ -120,6 +182,20 @@ esp_err_t ota_create_backup(ota_type_t type);
  */
 bool ota_is_backup_available(ota_type_t type);
 
+/**
+ * @brief Where a backup of type lives and how many bytes of it to send
+ *
+ * Firmware is the running app image, its length taken from the image
+ * header (segments, padding, checksum and hash), so the download can be
+ * uploaded again as it is. The filesystem is the whole mounted asset slot.
+ *
+ * @param type Type of backup
+ * @param partition Set to the partition to read
+ * @param size Set to the bytes to send from its start
+ * @return ESP_OK, ESP_ERR_NOT_FOUND without the partition, or the image check's error
+ */
+esp_err_t ota_get_backup_extent(ota_type_t type, const esp_partition_t **partition, size_t *size);
+
 /**
  * @brief Verify uploaded data using SHA256 (optional)
  * @param data Data buffer to verify
@@ -0,0 +1,128 @@
+/**
+ * @file ota_pull.h
+ * @brief Gateway firmware and node images pulled over HTTPS from a manifest, with Range resume
+ *
+ * A gateway with a bridge uplink fetches OTA_PULL_MANIFEST_URL every
+ * OTA_PULL_INTERVAL_MS:
+ *
+ *   {
+ *     "gateway": { "version": "1.4.0", "url": "https://.../gateway.bin", "sha256": "<64 hex>",
+ *                  "size": 1183744, "encoding": "raw" },
+ *     "node":    { "version": "1.4.0", "url": "https://.../node.bin.z", "sha256": "<64 hex>",
+ *                  "size": 402117, "encoding": "zlib" }
+ *   }
+ *
+ * Either entry may be left out. version is the image's app version
+ * (esp_app_desc_t), size the bytes to download, sha256 that of the image
+ * as written to flash (after inflating a "zlib" download); an entry
+ * without a hash is ignored, since nobody checks an unattended update.
+ *
+ * An entry whose version differs from what runs (gateway) or from the
+ * staged node image is downloaded with esp_http_client and fed to
+ * ota_process_chunk(), the same double-buffered writer and SHA-256 check
+ * as an upload to POST /api/ota. When the connection drops the download
+ * continues where it stopped with "Range: bytes=<received>-", up to
+ * OTA_PULL_RESUMES times, so a flaky metered link pays for each byte
+ * once; a server that answers a Range request with the whole file fails
+ * the download instead of sending it again.
+ *
+ * A gateway image is booted at once; boot_health.h rolls it back if the
+ * new firmware does not get node telemetry through, and an image that
+ * was rolled back is not fetched again. A node image is staged for
+ * espnow_ota.h, only once the running gateway firmware is confirmed, as
+ * the two share the inactive slot. An image that fails its hash, or
+ * whose app version is not the manifest's, is refused until the manifest
+ * names another one.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef OTA_PULL_H
+#define OTA_PULL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef OTA_PULL_MANIFEST_URL
+#define OTA_PULL_MANIFEST_URL "https://updates.example.com/weatherstation/manifest.json"
+#endif
+#define OTA_PULL_INTERVAL_MS (6 * 60 * 60 * 1000)  // Manifest checks; a few hundred bytes each
+#define OTA_PULL_FIRST_MS (5 * 60 * 1000)       // First check after the start, once boot_health has settled
+#define OTA_PULL_OFFLINE_MS (5 * 60 * 1000)     // Next try while the uplink has no address
+#define OTA_PULL_TIMEOUT_MS 15000               // Per request and per read
+#define OTA_PULL_RESUMES 8                      // Range requests per download after the first
+#define OTA_PULL_RESUME_MS 5000                 // Pause before each one, doubled every time
+#define OTA_PULL_READ_BYTES 4096                // Read buffer; ota_process_chunk() copies it into its blocks
+#define OTA_PULL_URL_MAX 128                    // Longest image URL (the JSON reader's token limit)
+#define OTA_PULL_VERSION_MAX 32                 // As esp_app_desc_t.version
+
+/**
+ * @brief Counters since ota_pull_start()
+ */
+typedef struct {
+    bool running;
+    uint32_t checks;                            // Manifests read
+    uint32_t check_failures;                    // Manifests that could not be fetched or parsed
+    uint32_t gateway_updates;                   // Gateway images written and set to boot
+    uint32_t node_images;                       // Node images staged for espnow_ota
+    uint32_t failures;                          // Downloads that did not end in a verified image
+    uint32_t refused;                           // Images skipped for an earlier failure or rollback
+    uint32_t resumes;                           // Range requests after a dropped connection
+    uint32_t bytes;                             // Image bytes downloaded
+    uint32_t manifest_bytes;
+} ota_pull_stats_t;
+
+/**
+ * @brief Called from the pull task around a download into the inactive slot
+ *
+ * in_use is true before the first byte is written, so the caller stops
+ * serving the staged node image, and false once the download is over
+ * (successful or not), so it serves whatever is staged then.
+ */
+typedef void (*ota_pull_slot_fn_t)(bool in_use);
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Start the pull task
+ *
+ * @param slot_fn Called around downloads; may be NULL
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if already running, ESP_ERR_NO_MEM
+ */
+esp_err_t ota_pull_start(ota_pull_slot_fn_t slot_fn);
+
+/**
+ * @brief Stop the task; a download in progress is abandoned and its slot left unbootable
+ */
+void ota_pull_stop(void);
+
+/**
+ * @brief Check the manifest now instead of at the next interval
+ */
+void ota_pull_check_now(void);
+
+/**
+ * @brief Copy the counters
+ */
+void ota_pull_get_stats(ota_pull_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OTA_PULL_H
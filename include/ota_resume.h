@@ -0,0 +1,123 @@
+/**
+ * @file ota_resume.h
+ * @brief Resumable chunked OTA uploads with progress persisted in NVS
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef OTA_RESUME_H
+#define OTA_RESUME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "ota_manager.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define OTA_RESUME_CHUNK_SIZE   (16 * 1024)     // Bytes per chunk, a multiple of the 4 KB flash sector
+#define OTA_RESUME_MAX_CHUNKS   128             // Bitmap capacity: images up to 2 MB
+#define OTA_RESUME_NVS_NAMESPACE "ota_resume"
+
+/**
+ * @brief Snapshot of the current chunked upload session
+ */
+typedef struct {
+    bool active;                                // A session exists (possibly from before a reboot)
+    ota_type_t type;
+    uint32_t image_size;                        // Total bytes the finished image will have
+    uint32_t chunk_size;
+    uint32_t chunks_total;
+    uint32_t chunks_done;                       // Chunks committed to flash
+    uint32_t next_offset;                       // First missing chunk, image_size once all are in
+    char expected_hash[OTA_HASH_STR_LEN];       // Lowercase hex, empty if none was given
+} ota_resume_info_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Join the current session or start a new one
+ *
+ * A session matches when type, size and hash are the same. A mismatching
+ * session is only replaced when restart is set (the client is sending the
+ * first chunk); otherwise the call fails so a stale client cannot clobber
+ * someone else's upload. Starting a filesystem session unmounts SPIFFS,
+ * unless the table has a spare asset slot (storage.h) for it to go to.
+ *
+ * @param type Partition to update
+ * @param image_size Total size of the image in bytes
+ * @param expected_hash 64 hex digits, or NULL/"" for none
+ * @param restart Replace a mismatching session instead of failing
+ * @return esp_err_t ESP_OK when the session is ready, ESP_ERR_INVALID_STATE on a
+ *         mismatch without restart, ESP_ERR_INVALID_SIZE if the image cannot fit
+ */
+esp_err_t ota_resume_begin(ota_type_t type, uint32_t image_size, const char *expected_hash, bool restart);
+
+/**
+ * @brief Erase and write one whole chunk, then record it in NVS
+ *
+ * Chunks may arrive in any order and may be resent.
+ *
+ * @param offset Chunk offset; must be a multiple of OTA_RESUME_CHUNK_SIZE
+ * @param data Chunk contents
+ * @param len Chunk length; OTA_RESUME_CHUNK_SIZE except for the last chunk
+ * @return esp_err_t ESP_OK once committed, ESP_ERR_INVALID_ARG/ESP_ERR_INVALID_SIZE for
+ *         a misplaced chunk, ESP_ERR_INVALID_STATE with no session, ESP_ERR_NOT_SUPPORTED
+ *         for a first filesystem chunk of the wrong filesystem (see storage.h), or the flash error
+ */
+esp_err_t ota_resume_write(uint32_t offset, const uint8_t *data, size_t len);
+
+/**
+ * @brief Verify the completed image and make it live
+ *
+ * Hashes the image back from flash, checks it against the expected hash if
+ * one was given and, for firmware, selects the new boot partition. The
+ * session is cleared whatever the outcome. A reboot is still needed, except
+ * for a filesystem image in the spare asset slot, which the caller switches to.
+ *
+ * @param computed_hash Receives the image hash as hex; may be NULL
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_STATE if chunks are missing,
+ *         ESP_ERR_INVALID_CRC on a hash mismatch, or the boot partition error
+ */
+esp_err_t ota_resume_finalize(char computed_hash[OTA_HASH_STR_LEN]);
+
+/**
+ * @brief Forget the current session; written chunks are left in flash
+ *
+ * @return esp_err_t ESP_OK, or the NVS error
+ */
+esp_err_t ota_resume_abort(void);
+
+/**
+ * @brief Describe the current session
+ *
+ * @param info Receives the snapshot
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG if info is NULL
+ */
+esp_err_t ota_resume_get_info(ota_resume_info_t *info);
+
+/**
+ * @brief Check for an unfinished session of the given type
+ *
+ * Used at boot to leave a half-written SPIFFS partition unmounted.
+ *
+ * @param type Partition type to ask about
+ * @return true if such a session is in progress
+ */
+bool ota_resume_pending(ota_type_t type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OTA_RESUME_H
@@ -0,0 +1,93 @@
+/**
+ * @file pipeline_trace.h
+ * @brief SEGGER SystemView markers around the pipeline stages, for timelines captured over JTAG
+ *
+ * The CPU monitor says how busy each task was over a second; it cannot
+ * say why one HTTP request stalled while an ESP-NOW burst arrived. With
+ * PIPELINE_TRACE=1 ([env:trace]) each stage below is bracketed by
+ * SystemView MarkStart/MarkStop events, and app_trace streams them over
+ * JTAG beside the scheduler's own events: every context switch, ISR and
+ * marker, per core, with cycle timestamps.
+ *
+ * Capture with OpenOCD while the station runs:
+ *
+ *   esp sysview start file://pro.svdat file://app.svdat
+ *   esp sysview stop
+ *
+ * and open the files in SEGGER SystemView, or merge both cores with
+ * $IDF_PATH/tools/esp_app_trace/sysviewtrace_proc.py. Marker ids are the
+ * pipeline_trace_stage_t values; pipeline_trace_init() logs the table and
+ * names them for a recording already running.
+ *
+ * With PIPELINE_TRACE=0 the macros expand to nothing.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef PIPELINE_TRACE_H
+#define PIPELINE_TRACE_H
+
+#include "esp_err.h"
+
+#ifndef PIPELINE_TRACE
+#define PIPELINE_TRACE 0                        // 1: SystemView markers; needs sdkconfig.trace.defaults
+#endif
+
+#if PIPELINE_TRACE != 0
+#include "SEGGER_SYSVIEW.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+
+/**
+ * @brief Traced stages; the value is the SystemView marker id
+ */
+typedef enum {
+    PIPELINE_TRACE_DNS_REPLY,                   // One query or upstream reply answered
+    PIPELINE_TRACE_FILE_SERVE,                  // One web asset request
+    PIPELINE_TRACE_OTA_WRITE,                   // One received block inflated, hashed and written to flash
+    PIPELINE_TRACE_SENSOR_SAMPLE,               // One sensor read by the sampler
+    PIPELINE_TRACE_ESPNOW_ENCODE,               // One record added to the batch frame
+    PIPELINE_TRACE_ESPNOW_SEND,                 // esp_now_send() to its send callback
+    PIPELINE_TRACE_MQTT_PUBLISH,                // One message handed to the MQTT client
+    PIPELINE_TRACE_STAGE_COUNT
+} pipeline_trace_stage_t;
+
+#if PIPELINE_TRACE != 0
+#define PIPELINE_TRACE_BEGIN(stage) SEGGER_SYSVIEW_MarkStart((unsigned)(stage))
+#define PIPELINE_TRACE_END(stage) SEGGER_SYSVIEW_MarkStop((unsigned)(stage))
+#else
+#define PIPELINE_TRACE_BEGIN(stage) do { } while (0)
+#define PIPELINE_TRACE_END(stage) do { } while (0)
+#endif
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Log the marker table and name the markers; does nothing with PIPELINE_TRACE=0
+ *
+ * @return esp_err_t ESP_OK
+ */
+esp_err_t pipeline_trace_init(void);
+
+/**
+ * @brief Name of a stage, for logs
+ */
+const char *pipeline_trace_stage_name(pipeline_trace_stage_t stage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PIPELINE_TRACE_H
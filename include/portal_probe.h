@@ -0,0 +1,83 @@
+/**
+ * @file portal_probe.h
+ * @brief Captive-portal probe responder: prebuilt answers to OS connectivity checks, counted per client
+ *
+ * A phone keeps probing (generate_204, hotspot-detect.html, connecttest.txt,
+ * ncsi.txt, ...) for as long as it stays on the AP. Each probe used to miss
+ * every registered handler, fall into the 404 handler, go through the
+ * route lookup, the rate-limited log and four response calls, all on the
+ * server task that also reads SPIFFS for real page loads.
+ *
+ * portal_probe_register() gives each probe route of web_routes.h an
+ * exact-match GET handler, registered before anything else on the
+ * server, so it matches ahead of the other handlers and the HTTPS build's
+ * wildcard redirect. The handler writes one prebuilt response (204, or 302
+ * to the portal) straight to the socket with httpd_send(): no status or
+ * header formatting, no log, no arena or CPU lock (it does not go through
+ * http_perf). Probes are counted per client IP address, so
+ * /api/server_stats shows what share of the traffic they are.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef PORTAL_PROBE_H
+#define PORTAL_PROBE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define PORTAL_PROBE_CLIENTS 8                  // Clients counted; the least recent makes way for a new one
+
+/**
+ * @brief Probes answered since boot
+ */
+typedef struct {
+    uint32_t no_content;                        // Answered 204
+    uint32_t redirect;                          // Answered 302 to the portal
+    uint32_t send_failed;
+} portal_probe_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Register a handler for every probe route; first, before the server's other handlers
+ *
+ * @return esp_err_t ESP_OK, or the first registration error; probes left
+ *         unregistered still reach the server's fallback
+ */
+esp_err_t portal_probe_register(httpd_handle_t server);
+
+/**
+ * @brief Copy the counters
+ */
+void portal_probe_get_stats(portal_probe_stats_t *stats);
+
+/**
+ * @brief Write the counters and the per-client counts as an object
+ *
+ * {"noContent","redirect","sendFailed","clients":[{"ip","probes","lastS"}]},
+ * lastS being seconds since the client's last probe.
+ */
+void portal_probe_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PORTAL_PROBE_H
@@ -0,0 +1,139 @@
+/**
+ * @file power_profile.h
+ * @brief Role-specific dynamic frequency scaling and light sleep, PM locks, and sleep time accounting
+ *
+ * Each role gets its own esp_pm configuration once it knows what it is:
+ *
+ *   Gateway  240/80 MHz, no light sleep: the radio has to listen for ESP-NOW
+ *            frames, which arrive at any time and are lost while it sleeps
+ *   Slotted  Gateway whose nodes send in slots (espnow_slot.h): light sleep
+ *            between the slot windows, which hold POWER_LOCK_RADIO
+ *   Node     80/40 MHz with automatic light sleep between samples
+ *   Config   240/80 MHz, no light sleep: the access point must keep beaconing
+ *
+ * Latency-critical sections hold a lock for their duration: web handlers
+ * and the OTA writer run at full clock (POWER_LOCK_CPU), ESP-NOW sends
+ * keep the chip out of light sleep until the send callback (POWER_LOCK_RADIO).
+ *
+ * Needs CONFIG_PM_ENABLE (and CONFIG_FREERTOS_USE_TICKLESS_IDLE for light
+ * sleep); without it the locks are no-ops and the CPU stays at the default
+ * clock. Light sleep time needs CONFIG_PM_LIGHT_SLEEP_CALLBACKS.
+ *
+ * Deep sleep is accounted in RTC memory from the RTC clock at each sleep
+ * entry and at each wake, until the next power-on: time asleep and awake,
+ * wakes by cause, and a histogram of how long each wake lasted. A wake
+ * starts when app_main starts, less the esp_timer time already elapsed, so
+ * ROM and bootloader time counts as sleep.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef POWER_PROFILE_H
+#define POWER_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define POWER_GATEWAY_MAX_MHZ 240
+#define POWER_GATEWAY_MIN_MHZ 80                // APB stays at 80 MHz, so WiFi and ESP-NOW timing hold
+#define POWER_NODE_MAX_MHZ 80
+#define POWER_NODE_MIN_MHZ 40                   // XTAL; only while idle, the radio raises it for a send
+#define POWER_CONFIG_MAX_MHZ 240
+#define POWER_CONFIG_MIN_MHZ 80
+#define POWER_AWAKE_BUCKETS 8                   // Wake length histogram; see power_awake_bucket_ms
+
+typedef enum {
+    POWER_PROFILE_NONE = 0,                     // Not configured: default clock, no sleep
+    POWER_PROFILE_CONFIG,
+    POWER_PROFILE_GATEWAY,
+    POWER_PROFILE_GATEWAY_SLOTTED,              // GATEWAY_SLOT_SLEEP: light sleep outside the slot windows
+    POWER_PROFILE_NODE,
+} power_profile_t;
+
+typedef enum {
+    POWER_LOCK_CPU = 0,                         // Full clock: web handlers, OTA writing
+    POWER_LOCK_RADIO,                           // No light sleep: ESP-NOW sends
+    POWER_LOCK_COUNT,
+} power_lock_t;
+
+typedef enum {
+    POWER_WAKE_TIMER = 0,
+    POWER_WAKE_BUTTON,                          // EXT0/GPIO: the config button
+    POWER_WAKE_ULP,                             // Supply watch threshold
+    POWER_WAKE_RAIN,                            // EXT1: a rain gauge tip
+    POWER_WAKE_OTHER,
+    POWER_WAKE_COUNT,
+} power_wake_t;
+
+// Upper bounds of the first POWER_AWAKE_BUCKETS - 1 wake length buckets, ms; the last is open
+extern const uint16_t power_awake_bucket_ms[POWER_AWAKE_BUCKETS - 1];
+
+/**
+ * @brief Time asleep and awake
+ */
+typedef struct {
+    uint64_t light_sleep_us;                    // Since boot
+    uint32_t light_sleeps;
+    bool light_sleep_tracked;                   // CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    // Since power-on
+    uint64_t deep_sleep_us;
+    uint32_t deep_sleeps;
+    uint64_t awake_us;                          // Awake time of the wakes that ended in deep sleep
+    uint32_t wakes[POWER_WAKE_COUNT];           // Wakes from deep sleep, by cause
+    uint32_t awake_histogram[POWER_AWAKE_BUCKETS];  // Those wakes by length
+    // Derived
+    uint16_t awake_bp;                          // Share of time awake, 0.01 % (this wake included, light sleep excluded)
+    uint32_t wake_ms;                           // Mean length of a completed wake (0 before the first)
+} power_sleep_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Account for the deep sleep that just ended and record the start of the next one
+ *
+ * Call first thing in app_main, ahead of the duty-cycle fast path, so every
+ * wake is counted.
+ */
+void power_profile_boot(void);
+
+/**
+ * @brief Create the PM locks, configure DFS and light sleep for the role, and register the sleep metrics
+ *
+ * @param profile POWER_PROFILE_CONFIG, _GATEWAY, _GATEWAY_SLOTTED or _NODE
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_SUPPORTED without CONFIG_PM_ENABLE, or the esp_pm error
+ */
+esp_err_t power_profile_apply(power_profile_t profile);
+
+/**
+ * @brief Take a PM lock; nests, and does nothing without power management
+ */
+void power_profile_acquire(power_lock_t lock);
+
+/**
+ * @brief Give back a PM lock taken with power_profile_acquire()
+ */
+void power_profile_release(power_lock_t lock);
+
+/**
+ * @brief Copy the sleep counters and derive the awake share
+ */
+void power_profile_get_sleep_stats(power_sleep_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POWER_PROFILE_H
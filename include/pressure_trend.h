@@ -0,0 +1,159 @@
+/**
+ * @file pressure_trend.h
+ * @brief Barometric tendency: least-squares pressure trend over the last 3 h, with falling and storm alarms
+ *
+ * A tracker keeps up to PRESSURE_TREND_SLOTS points of the last
+ * PRESSURE_TREND_WINDOW_S in a ring, together with running sums of t, p,
+ * t*t and t*p. Adding a point and dropping the oldest each adjust the sums,
+ * so the regression slope costs the same however many points there are:
+ *
+ *   slope = (n*Stp - St*Sp) / (n*Stt - St*St)
+ *
+ * The sums are exact 64-bit integers: t counts seconds from the oldest
+ * point (the sums are shifted, not rebuilt, when it leaves) and p is in
+ * Pa, so nothing cancels away in floating point.
+ *
+ * Samples are averaged into one point per PRESSURE_TREND_SPACING_S, which
+ * bounds the ring whatever the sample rate. The point still being averaged
+ * takes part in every evaluation, so the trend, and the alarm, move with
+ * each sample rather than once per point.
+ *
+ * The trend is reported as the change over 3 h (the marine barometric
+ * tendency), negative when falling. Once PRESSURE_TREND_MIN_SPAN_S of data
+ * is in, a fall of PRESSURE_TREND_FALLING_PA_3H raises the falling alarm and
+ * PRESSURE_TREND_STORM_PA_3H the storm alarm; an alarm only drops back when
+ * the fall is PRESSURE_TREND_HYSTERESIS_PA below its threshold.
+ *
+ * The node runs one tracker on its own samples and sends at once when an
+ * alarm is raised; the gateway runs one per node and publishes every alarm
+ * change on MQTT and the live web stream.
+ *
+ * A tracker is plain data with no pointers, so a node can keep it in RTC
+ * memory across deep sleep. Not thread-safe: one task per tracker.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef PRESSURE_TREND_H
+#define PRESSURE_TREND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define PRESSURE_TREND_WINDOW_S 10800           // Regression span: 3 h
+#define PRESSURE_TREND_SPACING_S 120            // Samples averaged into one point per this
+#define PRESSURE_TREND_SLOTS 96                 // Points kept; covers the window at the spacing above
+#define PRESSURE_TREND_MIN_SPAN_S 1800          // No trend (and no alarm) from less data than this
+#ifndef PRESSURE_TREND_FALLING_PA_3H
+#define PRESSURE_TREND_FALLING_PA_3H 360        // Falling alarm: 3.6 hPa in 3 h ("falling quickly")
+#endif
+#ifndef PRESSURE_TREND_STORM_PA_3H
+#define PRESSURE_TREND_STORM_PA_3H 600          // Storm alarm: 6 hPa in 3 h ("falling very rapidly", gale likely)
+#endif
+#define PRESSURE_TREND_HYSTERESIS_PA 50         // An alarm clears this far below its threshold
+
+_Static_assert(PRESSURE_TREND_SLOTS * PRESSURE_TREND_SPACING_S >= PRESSURE_TREND_WINDOW_S,
+               "the ring must cover the regression window");
+_Static_assert(PRESSURE_TREND_SLOTS <= 255, "ring indexes are 8 bits");
+
+typedef enum {
+    PRESSURE_TREND_ALARM_NONE = 0,
+    PRESSURE_TREND_ALARM_FALLING,
+    PRESSURE_TREND_ALARM_STORM,
+} pressure_trend_alarm_t;
+
+/**
+ * @brief Tracker state; zero it with pressure_trend_init()
+ */
+typedef struct {
+    uint32_t base_s;                            // Time of the oldest point; the sums count t from here
+    uint32_t t[PRESSURE_TREND_SLOTS];           // Point times, Unix seconds
+    uint32_t p[PRESSURE_TREND_SLOTS];           // Point pressures, Pa
+    uint8_t head;                               // Next slot to write
+    uint8_t count;
+    int64_t sum_t;
+    int64_t sum_p;
+    int64_t sum_tt;
+    int64_t sum_tp;
+    uint32_t bucket_s;                          // First sample of the point being averaged
+    uint32_t bucket_n;                          // Samples in it; 0 = none
+    uint64_t bucket_t;                          // Their times, seconds from bucket_s
+    uint64_t bucket_p;
+    uint32_t last_s;                            // Newest sample
+    uint32_t last_p;
+    uint8_t alarm;                              // pressure_trend_alarm_t
+} pressure_trend_t;
+
+/**
+ * @brief Trend as of the newest sample
+ */
+typedef struct {
+    bool valid;                                 // At least PRESSURE_TREND_MIN_SPAN_S of data
+    int32_t change_pa_3h;                       // Regression slope over 3 h, Pa; negative when falling
+    uint32_t span_s;                            // Oldest point to the newest sample
+    uint8_t points;                             // Including the one being averaged
+    uint32_t pressure;                          // Newest sample, Pa
+    uint32_t time_s;
+    pressure_trend_alarm_t alarm;
+} pressure_trend_reading_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Empty the tracker
+ */
+void pressure_trend_init(pressure_trend_t *pt);
+
+/**
+ * @brief Add a sample and re-evaluate the trend and the alarm
+ *
+ * A sample older than the newest is ignored, unless it is older by more
+ * than the window: the clock was set back, and the tracker starts over.
+ *
+ * @param pt Tracker
+ * @param time_s Sample time, Unix seconds
+ * @param pressure Pa
+ * @return bool true if the alarm changed, either way
+ */
+bool pressure_trend_add(pressure_trend_t *pt, uint32_t time_s, uint32_t pressure);
+
+/**
+ * @brief Evaluate the trend as of the newest sample
+ */
+void pressure_trend_get(const pressure_trend_t *pt, pressure_trend_reading_t *reading);
+
+/**
+ * @brief Change the alarm thresholds for every tracker; falls over 3 h, Pa
+ */
+void pressure_trend_set_thresholds(int32_t falling_pa_3h, int32_t storm_pa_3h);
+
+/**
+ * @brief Alarm name: "none", "falling" or "storm"
+ */
+const char *pressure_trend_alarm_name(pressure_trend_alarm_t alarm);
+
+/**
+ * @brief Alarm as a JSON object: {"node","alarm","change","span","pressure","time"}
+ *
+ * @return Length written, as snprintf() (cap or more: truncated)
+ */
+int pressure_trend_alert_json(char *buf, size_t cap, uint32_t node_id, const pressure_trend_reading_t *reading);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PRESSURE_TREND_H
@@ -0,0 +1,121 @@
+/**
+ * @file rain_gauge.h
+ * @brief Tipping-bucket rain gauge: every tip counted, awake or in deep sleep, without polling
+ *
+ * The bucket closes a reed switch to GND once per tip. The switch sits on
+ * an RTC GPIO so it can wake the chip:
+ *
+ *   awake        a level interrupt counts the tip and then waits for the
+ *                release, so a held switch raises one interrupt, not a storm.
+ *                GPIO wakeup is enabled on the pin, so light sleep ends on a tip.
+ *   deep sleep   an EXT1 wakeup on the pin (a deep sleep GPIO wakeup on the
+ *                C3, which has no EXT1 and wakes only on GPIO 0-5). The wake
+ *                counts the tip, waits for the switch to open and goes straight
+ *                back to sleep; the node keeps its sample schedule.
+ *
+ * The ULP would avoid those short wakes, but it is already running the
+ * supply watch, and tips are rare: a few hundred a day in heavy rain.
+ *
+ * The tip count and the per-RAIN_GAUGE_BUCKET_S counts behind the hourly
+ * rate are in RTC memory, so they survive deep sleep and reset only at
+ * power-on. Buckets are keyed on the RTC clock, which also runs through
+ * deep sleep and is not stepped by a time sync. The rate is the sum of the
+ * last RAIN_GAUGE_BUCKETS buckets, the current partial one included: the
+ * last 55 to 60 minutes.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef RAIN_GAUGE_H
+#define RAIN_GAUGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#if CONFIG_IDF_TARGET_ESP32C3
+#define RAIN_GAUGE_GPIO 4                       // Deep sleep wake pin (GPIO 0-5); reed switch to GND, internal pull-up
+#elif CONFIG_IDF_TARGET_ESP32S3
+#define RAIN_GAUGE_GPIO 4                       // RTC GPIO; reed switch to GND, internal pull-up
+#else
+#define RAIN_GAUGE_GPIO 25                      // RTC GPIO; reed switch to GND, internal pull-up (add 10k outside for long leads)
+#endif
+#define RAIN_GAUGE_UM_PER_TIP 279               // Rain per tip, um (0.2794 mm, the common 0.011 in bucket)
+#define RAIN_GAUGE_LOCKOUT_MS 50                // Closures this soon after a tip are contact bounce
+#define RAIN_GAUGE_RELEASE_MS 20                // Switch open this long before deep sleep re-arms on it
+#define RAIN_GAUGE_RELEASE_WAIT_MS 500          // Longest a wake waits for the switch to open
+#define RAIN_GAUGE_BUCKET_S 300                 // Rate resolution
+#define RAIN_GAUGE_BUCKETS 12                   // Buckets summed for the hourly rate
+
+/**
+ * @brief Rain figures since power-on
+ */
+typedef struct {
+    uint32_t tips;
+    uint32_t total;                             // Rain since power-on, 0.01 mm
+    uint16_t tips_hour;                         // Tips in the last hour
+    uint32_t rate;                              // Rain in the last hour, 0.01 mm/h
+    bool stuck;                                 // The switch stayed closed; deep sleep no longer wakes on it
+} rain_gauge_reading_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Count tips by interrupt while awake
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if already running, or the GPIO error
+ */
+esp_err_t rain_gauge_start(void);
+
+/**
+ * @brief Whether this boot is a deep sleep wake caused by a tip
+ */
+bool rain_gauge_woke(void);
+
+/**
+ * @brief Count the tip that caused this wake; call once, early, after rain_gauge_woke()
+ */
+void rain_gauge_count_wake(void);
+
+/**
+ * @brief Stop the interrupt and arm the EXT1 wakeup for the next deep sleep
+ *
+ * Waits up to RAIN_GAUGE_RELEASE_WAIT_MS for a closed switch to open. A
+ * switch still closed after that is not armed, as it would wake the chip
+ * at once; the next wake tries again.
+ */
+void rain_gauge_arm_sleep(void);
+
+/**
+ * @brief Copy the current figures
+ */
+void rain_gauge_get(rain_gauge_reading_t *reading);
+
+/**
+ * @brief Log the current figures
+ */
+void rain_gauge_log(void);
+
+/**
+ * @brief Remove the interrupt; the counts are kept
+ */
+void rain_gauge_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RAIN_GAUGE_H
@@ -0,0 +1,183 @@
+/**
+ * @file sample_bus.h
+ * @brief Publish/subscribe fan-out of received records and GPS fixes in reference-counted blocks
+ *
+ * A producer takes a block from a fixed pool, fills it in place and
+ * publishes it once. Every subscriber gets the same block's pointer through
+ * its own queue, reads the record where it lies and releases it; the last
+ * release puts the block back in the pool. Nothing is copied or allocated
+ * per record.
+ *
+ * A subscriber that falls behind loses its own oldest blocks when its queue
+ * is full (counted as dropped) and never holds up the producer or the other
+ * subscribers. sample_bus_subscribe() only admits queues the pool can fill
+ * with SAMPLE_BUS_RESERVE blocks to spare, so a stalled subscriber cannot
+ * starve the producers either.
+ *
+ * Each block carries one topic. A subscriber names the topics it takes,
+ * and sample_bus_publish() only queues a block to those.
+ *
+ *   SAMPLE_TOPIC_RECORD     a node's decoded record, from the link task
+ *   SAMPLE_TOPIC_POSITION   the GPS fix, from the gps task (gps.h)
+ *
+ * On the gateway the forwarder feeds aggregates, history, the SD archive
+ * and pressure alarms from its record subscription, and the NMEA 0183,
+ * NMEA 2000 and Signal K tasks take theirs; NMEA 2000 also takes
+ * positions. MQTT and the flash spool stay on the lossless record ring,
+ * where a full ring holds the nodes off.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef SAMPLE_BUS_H
+#define SAMPLE_BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "gps.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef SAMPLE_BUS_BLOCKS
+#define SAMPLE_BUS_BLOCKS 128                   // Pool size (about 7 KB)
+#endif
+#define SAMPLE_BUS_MAX_SUBSCRIBERS 6
+#define SAMPLE_BUS_RESERVE 4                    // Blocks never promised to a queue: the producers' working set
+#define SAMPLE_BUS_NAME_LEN 12
+
+// Block topics; a subscriber's mask is any combination
+#define SAMPLE_TOPIC_RECORD 0x01
+#define SAMPLE_TOPIC_POSITION 0x02
+
+/**
+ * @brief One published block; read-only once published
+ */
+typedef struct {
+    uint8_t topic;                              // SAMPLE_TOPIC_*; sample_bus_alloc() sets RECORD
+    uint32_t node_id;                           // Records only
+    union {
+        telemetry_record_t rec;                 // SAMPLE_TOPIC_RECORD
+        gps_fix_t fix;                          // SAMPLE_TOPIC_POSITION
+    };
+    uint8_t refs;                               // Owned by the bus
+} sample_block_t;
+
+typedef struct sample_bus_sub sample_bus_sub_t;
+
+/**
+ * @brief One subscriber's counters
+ */
+typedef struct {
+    char name[SAMPLE_BUS_NAME_LEN];
+    uint8_t topics;                             // SAMPLE_TOPIC_* mask
+    uint32_t depth;
+    uint32_t delivered;                         // Blocks queued to it
+    uint32_t dropped;                           // Oldest blocks discarded because its queue was full
+    uint32_t peak;                              // Most blocks ever waiting in its queue
+} sample_bus_sub_stats_t;
+
+/**
+ * @brief Bus counters since sample_bus_init()
+ */
+typedef struct {
+    uint32_t published;
+    uint32_t exhausted;                         // sample_bus_alloc() calls that found the pool empty
+    uint32_t free_blocks;
+    uint32_t min_free;                          // Fewest blocks ever free
+    uint32_t subscribers;
+    sample_bus_sub_stats_t subs[SAMPLE_BUS_MAX_SUBSCRIBERS];
+} sample_bus_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Take the block pool; once, before any subscriber or producer
+ *
+ * @return esp_err_t ESP_OK (also if already up) or ESP_ERR_NO_MEM
+ */
+esp_err_t sample_bus_init(void);
+
+/**
+ * @brief Release the pool; every subscriber must have unsubscribed
+ */
+void sample_bus_deinit(void);
+
+/**
+ * @brief Add a record subscriber with a queue of depth blocks
+ *
+ * @param name Shown in the counters
+ * @param depth Blocks it may fall behind by before losing the oldest
+ * @param out Subscriber handle
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE before sample_bus_init(),
+ *         ESP_ERR_NO_MEM if the pool cannot back the queue or there is no free subscriber slot
+ */
+esp_err_t sample_bus_subscribe(const char *name, uint32_t depth, sample_bus_sub_t **out);
+
+/**
+ * @brief Add a subscriber to the given topics; as sample_bus_subscribe() otherwise
+ *
+ * @param topics SAMPLE_TOPIC_* mask, not 0
+ */
+esp_err_t sample_bus_subscribe_topics(const char *name, uint32_t depth, uint8_t topics, sample_bus_sub_t **out);
+
+/**
+ * @brief Remove a subscriber and release whatever was still queued to it; its task must have stopped reading
+ */
+void sample_bus_unsubscribe(sample_bus_sub_t *sub);
+
+/**
+ * @brief A free block for the caller to fill and publish
+ *
+ * @return NULL if the bus is down or the pool is empty
+ */
+sample_block_t *sample_bus_alloc(void);
+
+/**
+ * @brief Hand a filled block to every subscriber of its topic; the caller's reference passes to the bus
+ *
+ * Never blocks on a subscriber. Blocks with no subscriber go straight back to the pool.
+ *
+ * @return uint32_t Subscribers reached
+ */
+uint32_t sample_bus_publish(sample_block_t *block);
+
+/**
+ * @brief The subscriber's oldest block, waiting up to wait ticks
+ *
+ * @return NULL if none arrived in time; otherwise release it when done
+ */
+const sample_block_t *sample_bus_receive(sample_bus_sub_t *sub, TickType_t wait);
+
+/**
+ * @brief Drop a reference from sample_bus_alloc() or sample_bus_receive()
+ */
+void sample_bus_release(const sample_block_t *block);
+
+/**
+ * @brief Copy the counters
+ */
+void sample_bus_get_stats(sample_bus_stats_t *stats);
+
+/**
+ * @brief Log the counters, one line per subscriber
+ */
+void sample_bus_log(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLE_BUS_H
@@ -0,0 +1,124 @@
+/**
+ * @file sample_rate.h
+ * @brief Adaptive sampling rate: the period and batch follow the supply's charge and the weather's volatility
+ *
+ * A node samples at the configured period. Calm weather stretches it and
+ * volatile weather shortens it. Volatility is the faster of two readings:
+ * the pressure trend (pressure_trend.h) against
+ * SAMPLE_RATE_PRESSURE_PA_3H, and the gust spread above the 2 min mean
+ * wind (wind.h) against SAMPLE_RATE_GUST_PERMILLE. Each is scaled to
+ * 0..1000 per mille. The rate then runs from SAMPLE_RATE_CALM_PERMILLE of
+ * the configured one in a dead calm to SAMPLE_RATE_STORM_PERMILLE at full
+ * volatility. Once the supply's charge falls below
+ * SAMPLE_RATE_RESERVE_PERMILLE the period stretches further, up to
+ * SAMPLE_RATE_LOW_STRETCH times at empty.
+ *
+ * The batch (samples per radio send) follows the same factor. Calm or a low
+ * battery give fewer, fuller sends. A squall gives small batches that
+ * reach the gateway within a few samples.
+ *
+ * The result is clamped to the caller's limits. It moves only when the
+ * period changes by more than SAMPLE_RATE_HYSTERESIS_PERMILLE or the
+ * batch changes, so a reading at a boundary does not flap the timers.
+ * Unknown inputs count as neutral: without a trend or wind the period is
+ * the configured one, and a charge once known is kept until the next
+ * measurement.
+ *
+ * A state is plain data with no pointers, so a node can keep it in RTC
+ * memory across deep sleep. Not thread-safe: one task per state.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef SAMPLE_RATE_H
+#define SAMPLE_RATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pressure_trend.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define SAMPLE_RATE_UNKNOWN 0xFFFF              // charge_permille, volatility_permille and supply_mv not known
+#define SAMPLE_RATE_SUPPLY_FULL_MV 2100         // Supply pin at full charge (4.2 V LiPo through a 1:2 divider)
+#define SAMPLE_RATE_SUPPLY_EMPTY_MV 1700        // ... and when empty (3.4 V)
+#define SAMPLE_RATE_RESERVE_PERMILLE 500        // Below this charge the period stretches
+#define SAMPLE_RATE_LOW_STRETCH 4               // ... up to this many times at empty
+#define SAMPLE_RATE_CALM_PERMILLE 500           // Rate in a dead calm, per mille of the configured one
+#define SAMPLE_RATE_STORM_PERMILLE 4000         // Rate at full volatility
+#define SAMPLE_RATE_PRESSURE_PA_3H PRESSURE_TREND_FALLING_PA_3H  // A trend this steep either way is full volatility
+#define SAMPLE_RATE_GUST_PERMILLE 1000          // Gusts this far above the 2 min mean are full volatility
+#define SAMPLE_RATE_GUST_MIN_SPEED 200          // 0.01 m/s; a slower mean wind counts as calm
+#define SAMPLE_RATE_HYSTERESIS_PERMILLE 100     // Smallest period change acted on
+
+/**
+ * @brief What the rate follows; a reading the node does not have is marked unknown
+ */
+typedef struct {
+    uint16_t supply_mv;                         // Supply pin; SAMPLE_RATE_UNKNOWN if not measured this time
+    bool have_trend;                            // change_pa_3h holds a valid trend
+    int32_t change_pa_3h;
+    bool have_wind;                             // The wind module is running
+    uint16_t wind_avg;                          // 2 min mean, 0.01 m/s
+    uint16_t wind_gust;                         // 0.01 m/s
+} sample_rate_inputs_t;
+
+/**
+ * @brief Bounds on the result
+ */
+typedef struct {
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint32_t step_ms;                           // The period is a multiple of this (1000 while duty cycling)
+    uint8_t max_batch;
+    uint32_t max_batch_ms;                      // A batch spans less than this (0: no bound)
+} sample_rate_limits_t;
+
+/**
+ * @brief Rate in force; zero it with sample_rate_init()
+ */
+typedef struct {
+    uint32_t interval_ms;                       // 0 before the first sample_rate_update()
+    uint8_t batch;
+    uint16_t supply_mv;                         // Last measured; SAMPLE_RATE_UNKNOWN
+    uint16_t charge_permille;                   // Behind the rate in force; SAMPLE_RATE_UNKNOWN
+    uint16_t volatility_permille;               // Behind the rate in force; SAMPLE_RATE_UNKNOWN
+    uint32_t changes;
+} sample_rate_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Forget the rate; the next update sets it from scratch
+ */
+void sample_rate_init(sample_rate_t *rate);
+
+/**
+ * @brief Work out the period and batch from the configured ones and the inputs
+ *
+ * @param rate State; interval_ms and batch hold the result
+ * @param base_ms Configured period
+ * @param base_batch Configured batch
+ * @param in Current readings
+ * @param limits Bounds
+ * @return bool The period or the batch changed (always on the first update)
+ */
+bool sample_rate_update(sample_rate_t *rate, uint32_t base_ms, uint8_t base_batch, const sample_rate_inputs_t *in,
+                        const sample_rate_limits_t *limits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLE_RATE_H
@@ -0,0 +1,180 @@
+/**
+ * @file sampler.h
+ * @brief Timer-driven sensor sampling: esp_timer schedule, acquisition task, queue and transmit task
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define SAMPLER_MAX_SENSORS 4
+#define SAMPLER_NAME_LEN 12
+#define SAMPLER_PAYLOAD_MAX 32                  // Bytes of sensor data carried per sample
+#define SAMPLER_MIN_INTERVAL_MS 10
+#define SAMPLER_QUEUE_LEN 16                    // Samples buffered while the transmit stage is busy
+#define SAMPLER_STOP_TIMEOUT_MS 2000
+#define SAMPLER_WAIT_FOREVER UINT32_MAX         // Idle callback: no deadline pending
+
+/**
+ * @brief One acquired sample, as queued from the acquisition stage to the transmit stage
+ */
+typedef struct {
+    uint8_t sensor;                             // Id from sampler_add_sensor()
+    uint32_t seq;                               // Timer period this sample belongs to, from 1
+    int64_t due_us;                             // Ideal time: start + seq * interval
+    int64_t fired_us;                           // When the timer callback ran
+    int64_t acquired_us;                        // When the read returned
+    esp_err_t status;                           // Result of the read callback
+    size_t len;
+    uint8_t data[SAMPLER_PAYLOAD_MAX] __attribute__((aligned(4)));
+} sampler_sample_t;
+
+/**
+ * @brief Read one sample; runs in the acquisition task
+ *
+ * @param ctx Pointer given to sampler_add_sensor()
+ * @param data Buffer of SAMPLER_PAYLOAD_MAX bytes
+ * @param len Receives the bytes used
+ */
+typedef esp_err_t (*sampler_read_t)(void *ctx, void *data, size_t *len);
+
+/**
+ * @brief Start a conversion whose result a sampler_read_t fetches later; runs in the acquisition task
+ *
+ * @param ctx Pointer given to sampler_add_sensor()
+ * @param ready_us Receives how long the conversion takes
+ */
+typedef esp_err_t (*sampler_trigger_t)(void *ctx, uint32_t *ready_us);
+
+/**
+ * @brief Consume one sample; runs in the transmit task and may block
+ */
+typedef void (*sampler_sink_t)(const sampler_sample_t *sample);
+
+/**
+ * @brief Deadline hook of the transmit stage; runs in the transmit task
+ *
+ * Called after each sample reaches the sink and again whenever the wait it
+ * asked for passes without a new sample, so a sink can send on a timeout.
+ *
+ * @return Milliseconds to wait for the next sample, or SAMPLER_WAIT_FOREVER
+ */
+typedef uint32_t (*sampler_idle_t)(void);
+
+/**
+ * @brief Scheduling statistics of one sensor
+ */
+typedef struct {
+    char name[SAMPLER_NAME_LEN];
+    uint32_t interval_ms;
+    uint32_t samples;                           // Reads done
+    uint32_t failed;                            // Reads that returned an error
+    uint32_t overruns;                          // Periods skipped because the previous read was still pending
+    uint32_t dropped;                           // Samples lost to a full queue
+    int32_t jitter_min_us;                      // Timer callback time minus ideal time
+    int32_t jitter_max_us;
+    uint32_t jitter_mean_us;                    // Mean absolute jitter
+    uint32_t latency_max_us;                    // Longest ideal-time-to-read-done
+} sampler_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Register a sensor to be read every interval_ms once the sampler starts
+ *
+ * @param name Short name used in logs and the metric
+ * @param interval_ms Sampling period, at least SAMPLER_MIN_INTERVAL_MS
+ * @param read Read callback
+ * @param ctx Passed to the callback
+ * @param id Receives the sensor id carried in each sample (may be NULL)
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_NO_MEM when full, or ESP_ERR_INVALID_STATE if running
+ */
+esp_err_t sampler_add_sensor(const char *name, uint32_t interval_ms, sampler_read_t read, void *ctx, uint8_t *id);
+
+/**
+ * @brief Register a sensor whose conversion is started and fetched in two steps
+ *
+ * Sensors with the same period share one timer. Every due conversion is
+ * triggered before any is read, and each is read once its own conversion
+ * time has passed, earliest first, so the sensors convert side by side and
+ * a full set takes as long as the slowest sensor instead of the sum.
+ *
+ * @param trigger Starts the conversion
+ * @param read Fetches its result
+ * @return esp_err_t As sampler_add_sensor()
+ */
+esp_err_t sampler_add_triggered(const char *name, uint32_t interval_ms, sampler_trigger_t trigger,
+                                sampler_read_t read, void *ctx, uint8_t *id);
+
+/**
+ * @brief Create the queue and both stage tasks, then start one periodic esp_timer per sampling period
+ *
+ * The timers run on absolute periods, so a slow read or a slow sink never
+ * shifts later samples. It only delays them, and the delay is counted in
+ * the jitter and latency statistics. Registers METRIC_SAMPLER_JITTER.
+ *
+ * @param sink Transmit stage callback
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if running or nothing is registered, or ESP_ERR_NO_MEM
+ */
+esp_err_t sampler_start(sampler_sink_t sink);
+
+/**
+ * @brief Set the transmit stage deadline hook; call before sampler_start()
+ *
+ * @param idle Hook, or NULL to wait for samples indefinitely
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_STATE if running
+ */
+esp_err_t sampler_set_idle(sampler_idle_t idle);
+
+/**
+ * @brief Change the period of a sensor's timer, and of every sensor sharing it; while running
+ *
+ * The new period counts from now: the next sample is due one new period
+ * later. Sample seqs carry on from the old schedule.
+ *
+ * @param id Any sensor of the timer
+ * @param interval_ms New period, at least SAMPLER_MIN_INTERVAL_MS
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_INVALID_STATE if not running, or the timer error
+ */
+esp_err_t sampler_set_interval(uint8_t id, uint32_t interval_ms);
+
+/**
+ * @brief Stop the timers and let both stages finish their current sample and exit
+ */
+esp_err_t sampler_stop(void);
+
+/**
+ * @brief Copy the statistics of one sensor
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG for an unknown id
+ */
+esp_err_t sampler_get_stats(uint8_t id, sampler_stats_t *stats);
+
+/**
+ * @brief Number of registered sensors
+ */
+uint8_t sampler_sensor_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLER_H
@@ -0,0 +1,144 @@
+/**
+ * @file sd_archive.h
+ * @brief Gateway raw archive: every node record, in daily binary files on an SD card
+ *
+ * The card is mounted at SD_ARCHIVE_MOUNT (FAT), over SPI with DMA by
+ * default or over the 4-bit SDMMC slot with SD_ARCHIVE_SDMMC=1. Each day
+ * (UTC, by the gateway's clock) gets one file, YYYYMMDD.WXA; until the
+ * clock is set records go to 00000000.WXA. A file is a plain sequence of
+ * 32-byte records, little-endian:
+ *
+ *   0  1  kind: SD_ARCHIVE_KIND_RECORD, or 0 for padding (skip it)
+ *   1  1  flags: bit 0 gas valid, bit 1 heat stable, bit 2 held
+ *   2  2  temperature, 0.01 degC, signed
+ *   4  4  node id
+ *   8  4  record seq
+ *  12  4  sample time, Unix seconds
+ *  16  4  pressure, Pa
+ *  20  4  humidity, 0.001 %RH
+ *  24  4  gas resistance, ohm
+ *  28  1  heater step
+ *  29  3  reserved, 0
+ *
+ * The forwarder copies each record it observes into one of two
+ * SD_ARCHIVE_BUF_BYTES DMA-capable buffers, which costs it a 32-byte
+ * copy. A full buffer is handed to a writer task just above idle priority
+ * while the other one fills; the writer appends it with a single write(),
+ * which FATFS passes to the card driver as whole sectors straight from the
+ * buffer, and fsync()s every SD_ARCHIVE_SYNC_MS. A buffer that has waited
+ * SD_ARCHIVE_SYNC_MS is handed over part full, padded to a whole sector,
+ * so every write stays sector-aligned and at most that long is lost to a
+ * power cut. If the card falls behind so far that both buffers are full,
+ * new records are dropped and counted; the radio side never waits on it.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef SD_ARCHIVE_H
+#define SD_ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef SD_ARCHIVE_SDMMC
+#define SD_ARCHIVE_SDMMC 0                      // 1: 4-bit SDMMC slot 1 (fixed pins 2, 4, 12-15) instead of SPI
+#endif
+#define SD_ARCHIVE_SPI_MOSI_GPIO 23             // VSPI defaults
+#define SD_ARCHIVE_SPI_MISO_GPIO 19
+#define SD_ARCHIVE_SPI_SCLK_GPIO 18
+#define SD_ARCHIVE_SPI_CS_GPIO 5
+#define SD_ARCHIVE_MOUNT "/sdcard"
+#define SD_ARCHIVE_EXT ".WXA"
+#define SD_ARCHIVE_PATH_LEN 32
+#define SD_ARCHIVE_MAX_FILES 4                  // Open at once: the writer's and readers' (history_export.h)
+#define SD_ARCHIVE_BUF_BYTES 16384              // Per write; two are allocated
+#define SD_ARCHIVE_SECTOR 512
+#define SD_ARCHIVE_RECORD_LEN 32
+#define SD_ARCHIVE_SYNC_MS 30000                // Longest a record waits to reach the card
+#define SD_ARCHIVE_KIND_RECORD 1
+
+/**
+ * @brief Counters
+ */
+typedef struct {
+    bool mounted;
+    uint32_t records;                           // Records buffered
+    uint32_t dropped;                           // Records lost because both buffers were full
+    uint32_t writes;                            // Buffers written
+    uint32_t bytes;                             // Bytes written, padding included
+    uint32_t syncs;
+    uint32_t errors;                            // Failed opens, writes and syncs
+    uint32_t write_ms_max;                      // Slowest write() so far
+    uint32_t files;                             // Daily files opened
+} sd_archive_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Mount the card, allocate the buffers and start the writer task
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NO_MEM, or the mount error (no card, no FAT)
+ */
+esp_err_t sd_archive_start(void);
+
+/**
+ * @brief Write out what is buffered, stop the writer task and unmount the card
+ */
+void sd_archive_stop(void);
+
+/**
+ * @brief Buffer one record; forwarder task only, never blocks
+ */
+void sd_archive_add(uint32_t node_id, const telemetry_record_t *rec);
+
+/**
+ * @brief Hand a part-full buffer to the writer once it has waited SD_ARCHIVE_SYNC_MS
+ */
+void sd_archive_poll(void);
+
+/**
+ * @brief Milliseconds until sd_archive_poll() has work (UINT32_MAX: none)
+ */
+uint32_t sd_archive_poll_due_ms(void);
+
+/**
+ * @brief Copy the counters
+ */
+void sd_archive_get_stats(sd_archive_stats_t *stats);
+
+/**
+ * @brief Path of a day's file
+ *
+ * @param path Output, SD_ARCHIVE_PATH_LEN bytes
+ * @param day YYYYMMDD, or 0 for records from before the clock was set
+ */
+void sd_archive_path(char *path, uint32_t day);
+
+/**
+ * @brief Decode one SD_ARCHIVE_RECORD_LEN record of a file
+ *
+ * @return bool false for padding, which holds no record
+ */
+bool sd_archive_decode(const uint8_t *p, uint32_t *node_id, telemetry_record_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SD_ARCHIVE_H
@@ -0,0 +1,173 @@
+/**
+ * @file sensor_hal.h
+ * @brief Sensor drivers behind one interface, registered at compile time and scheduled by the sampler
+ *
+ * Each sensor the node samples was wired into node.c by hand: its own read
+ * callback, its own payload struct, its own sampler_add_sensor() call. A
+ * driver now fills in a sensor_driver_t (init, trigger, read, deinit) and
+ * registers it with REGISTER_SENSOR_DRIVER(), which places it in the
+ * sensor_registry linker section (src/linker.lf) the same way
+ * REGISTER_VERSION() fills version_registry. sensor_hal_start() walks the
+ * section, initialises every driver and hands the ones whose hardware
+ * answered to the sampler.
+ *
+ * Every driver reports the same sensor_sample_t: up to
+ * SENSOR_SAMPLE_VALUES integers, each tagged with the quantity and fixed
+ * unit it carries. A driver with a trigger is added with
+ * sampler_add_triggered(), so drivers of the same period start their
+ * conversions together and the set takes as long as the slowest one.
+ *
+ * A registration lives in its driver's object file; one nothing else
+ * references is left out of the link, like any unused archive member.
+ * Keep a driver in a source file the firmware already calls into.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef SENSOR_HAL_H
+#define SENSOR_HAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sampler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define SENSOR_HAL_DRIVERS SAMPLER_MAX_SENSORS  // Drivers that can be active at once
+#define SENSOR_SAMPLE_VALUES 6                  // Values one sample carries
+
+/**
+ * @brief What a value measures, and its unit
+ */
+typedef enum {
+    SENSOR_TEMPERATURE = 0,                     // 0.01 degC
+    SENSOR_HUMIDITY,                            // 0.001 %RH
+    SENSOR_PRESSURE,                            // Pa
+    SENSOR_GAS_RESISTANCE,                      // Ohm
+    SENSOR_HEATER_STEP,                         // Gas heater profile step
+    SENSOR_GAS_STATUS,                          // Bit 0 gas valid, bit 1 heater stable
+    SENSOR_VOLTAGE,                             // mV
+    SENSOR_QUANTITY_COUNT
+} sensor_quantity_t;
+
+#define SENSOR_GAS_VALID 0x01
+#define SENSOR_GAS_HEAT_STABLE 0x02
+
+/**
+ * @brief How a quantity is shown outside the firmware (Home Assistant discovery, ha_discovery.h)
+ */
+typedef struct {
+    const char *key;                            // Word in topics and ids; NULL for internal quantities
+    const char *label;                          // Display name
+    const char *device_class;                   // Home Assistant device class, or NULL
+    const char *unit;                           // Display unit
+    uint16_t divisor;                           // Fixed-point units per display unit
+    uint8_t decimals;                           // Suggested display precision
+} sensor_quantity_info_t;
+
+/**
+ * @brief One sample of any driver, as carried in sampler_sample_t.data
+ */
+typedef struct {
+    uint8_t count;                              // Values filled in
+    uint8_t quantity[SENSOR_SAMPLE_VALUES];     // sensor_quantity_t of each value
+    int32_t value[SENSOR_SAMPLE_VALUES];
+} sensor_sample_t;
+
+_Static_assert(sizeof(sensor_sample_t) <= SAMPLER_PAYLOAD_MAX, "sensor_sample_t must fit a sampler payload");
+
+/**
+ * @brief A sensor driver
+ */
+typedef struct {
+    const char *name;                           // Sampler and log name
+    uint32_t interval_ms;                       // 0: the period given to sensor_hal_start()
+    esp_err_t (*init)(void **state);            // Find the hardware; any error leaves the driver out
+    esp_err_t (*trigger)(void *state, uint32_t *ready_us);  // NULL: read converts and returns at once
+    esp_err_t (*read)(void *state, sensor_sample_t *sample);
+    void (*deinit)(void *state);                // May be NULL
+} sensor_driver_t;
+
+/**
+ * @brief Register a sensor driver in the sensor_registry linker section
+ *
+ * @param ident Identifier for the entry (without quotes), unique per firmware
+ * @param ... sensor_driver_t initialiser fields
+ */
+#define REGISTER_SENSOR_DRIVER(ident, ...) \
+    static const sensor_driver_t ident##_sensor_driver \
+        __attribute__((used, section(".sensor_registry"), aligned(4))) = { __VA_ARGS__ }
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Initialise every registered driver and add the ones that answered to the sampler
+ *
+ * Call before sampler_start().
+ *
+ * @param interval_ms Period of the drivers that do not set their own
+ * @return esp_err_t ESP_OK with at least one driver added, ESP_ERR_NOT_FOUND with none,
+ *         or ESP_ERR_INVALID_STATE if already started
+ */
+esp_err_t sensor_hal_start(uint32_t interval_ms);
+
+/**
+ * @brief Move the drivers that do not set their own period to a new one; while the sampler runs
+ *
+ * @return esp_err_t ESP_OK, or the first sampler_set_interval() error
+ */
+esp_err_t sensor_hal_set_interval(uint32_t interval_ms);
+
+/**
+ * @brief Driver behind a sampler sensor id
+ *
+ * @return const sensor_driver_t* NULL if the id was not added by sensor_hal_start()
+ */
+const sensor_driver_t *sensor_hal_driver(uint8_t sensor);
+
+/**
+ * @brief Find a quantity in a sample
+ *
+ * @return bool false if the sample does not carry it
+ */
+bool sensor_sample_find(const sensor_sample_t *sample, sensor_quantity_t quantity, int32_t *value);
+
+/**
+ * @brief Short name of a quantity with its unit, for logs
+ */
+const char *sensor_quantity_name(sensor_quantity_t quantity);
+
+/**
+ * @brief Display metadata of a quantity
+ *
+ * @return const sensor_quantity_info_t* NULL for an unknown quantity
+ */
+const sensor_quantity_info_t *sensor_quantity_info(sensor_quantity_t quantity);
+
+/**
+ * @brief Deinitialise the active drivers; after sampler_stop()
+ */
+void sensor_hal_stop(void);
+
+/**
+ * @brief Number of drivers linked into the firmware, active or not
+ */
+size_t sensor_hal_registered(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SENSOR_HAL_H
@@ -0,0 +1,143 @@
+/**
+ * @file service_manager.h
+ * @brief Services started in dependency order, independent ones in parallel on both cores
+ *
+ * Each service is a start and an optional stop function, and the services
+ * it needs running first. service_manager_add() takes them in an order
+ * where every dependency comes earlier, so the ids are already sorted.
+ *
+ * service_manager_start_all() hands every service whose dependencies are
+ * running to one of two workers, one pinned to each core, so the SPIFFS
+ * mount and the AP come up side by side, then DNS, the web server and
+ * mDNS once the AP is up. A service whose dependency failed is not
+ * started and fails too. service_manager_restart() stops one service and
+ * the running services that need it, newest first, and starts them again;
+ * everything else keeps running. service_manager_stop() does the stopping
+ * alone; service_manager_start_all() brings them back.
+ *
+ * Every state change is posted to the default event loop as
+ * SERVICE_EVENT / SERVICE_EVENT_STATE with a service_event_t, so callers
+ * react to a service going down rather than polling it.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef SERVICE_MANAGER_H
+#define SERVICE_MANAGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define SERVICE_MANAGER_MAX 16                  // Services; the dependency mask has a bit each
+#define SERVICE_MANAGER_SLOW_START_MS 5000      // Starts still running after this are logged, and again each period
+#define SERVICE_DEP(id) (1u << (id))            // Dependency mask bit for a service id
+
+ESP_EVENT_DECLARE_BASE(SERVICE_EVENT);
+
+/**
+ * @brief Event ids under SERVICE_EVENT
+ */
+enum {
+    SERVICE_EVENT_STATE,                        // A service changed state; data is a service_event_t
+};
+
+typedef uint8_t service_id_t;
+
+typedef enum {
+    SERVICE_STOPPED,
+    SERVICE_STARTING,
+    SERVICE_RUNNING,
+    SERVICE_STOPPING,
+    SERVICE_FAILED,                             // Start returned an error, or a dependency failed
+} service_state_t;
+
+/**
+ * @brief One service; service_manager_add() copies it, but keeps the name by pointer
+ */
+typedef struct {
+    const char *name;
+    esp_err_t (*start)(void);
+    esp_err_t (*stop)(void);                    // NULL: cannot be restarted
+    uint32_t depends;                           // SERVICE_DEP() of each service needed running first
+    bool optional;                              // A failure is logged; start_all() still succeeds
+} service_def_t;
+
+/**
+ * @brief Data of SERVICE_EVENT_STATE
+ */
+typedef struct {
+    service_id_t id;
+    const char *name;
+    service_state_t state;
+    esp_err_t err;                              // Why it failed, or the stop error; ESP_OK otherwise
+    uint32_t start_ms;                          // How long the start took, once running
+} service_event_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Register a service
+ *
+ * @param def Copied; its name is kept by pointer
+ * @param id Receives the id for SERVICE_DEP() and the calls below
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG if a dependency is not registered yet,
+ *         or ESP_ERR_NO_MEM past SERVICE_MANAGER_MAX
+ */
+esp_err_t service_manager_add(const service_def_t *def, service_id_t *id);
+
+/**
+ * @brief Start every stopped or failed service, in parallel where the dependencies allow; returns when all settled
+ *
+ * @return esp_err_t ESP_OK, or the error of the first required service that failed
+ */
+esp_err_t service_manager_start_all(void);
+
+/**
+ * @brief Stop a service and its running dependents, then start them all again
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_SUPPORTED if one of them has no stop, or as start_all()
+ */
+esp_err_t service_manager_restart(service_id_t id);
+
+/**
+ * @brief Stop a service and its running dependents, newest first
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG for an unknown id, or
+ *         ESP_ERR_NOT_SUPPORTED (nothing stopped) if one of them has no stop
+ */
+esp_err_t service_manager_stop(service_id_t id);
+
+/**
+ * @brief Current state of a service; SERVICE_STOPPED for an unknown id
+ */
+service_state_t service_manager_state(service_id_t id);
+
+/**
+ * @brief Whether every required service is running
+ */
+bool service_manager_all_running(void);
+
+/**
+ * @brief Name of a state, for logs
+ */
+const char *service_state_name(service_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SERVICE_MANAGER_H
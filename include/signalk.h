@@ -0,0 +1,117 @@
+/**
+ * @file signalk.h
+ * @brief Signal K delta stream: environment.* readings over a WebSocket for chartplotters and Node-RED
+ *
+ * The gateway serves the Signal K discovery document at SIGNALK_URI and a
+ * delta stream at SIGNALK_STREAM_URI. A client is sent the hello message on
+ * connect, then one delta per record the gateway receives, carrying the
+ * readings of SIGNALK_NODE_ID (0: every node) in SI units:
+ *
+ *   environment.outside.temperature           K
+ *   environment.outside.pressure              Pa
+ *   environment.outside.relativeHumidity      ratio, 0..1
+ *   environment.outside.dewPointTemperature   K
+ *
+ * The source "src" of each update is the node id in hex, so a client can
+ * tell the nodes apart. A replayed backlog record older than the reading
+ * last sent is skipped unless that reading is SIGNALK_STALE_MS old.
+ *
+ * Subscriptions: ?subscribe=none on the stream URI starts a client with no
+ * paths, anything else with all of them. A client then sends the standard
+ * {"context":"vessels.self","subscribe":[{"path":"environment.outside.*"}]}
+ * and "unsubscribe" messages; "*" in a path matches any run of characters.
+ * Paths are fixed at build time, so a subscription is a bitmask over them;
+ * period and policy are ignored and every update goes out as it arrives.
+ *
+ * Each path's "{"path":...,"value":" prefix is a constant, and the values
+ * and the update header are formatted once per record. The frame for a
+ * set of paths is then assembled by copying, once per distinct bitmask, and
+ * the same buffer goes to every client with that mask; a dozen clients
+ * that all follow environment.* cost one frame.
+ *
+ * The endpoints are registered with the web server (signalk_register());
+ * the deltas start once the gateway's sample bus is up (signalk_start()).
+ * Without the bus a client gets the hello and no deltas.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef SIGNALK_H
+#define SIGNALK_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define SIGNALK_URI "/signalk"                  // Discovery document
+#define SIGNALK_STREAM_URI "/signalk/v1/stream"
+#define SIGNALK_VERSION "1.7.0"                 // Signal K specification version served
+#define SIGNALK_MAX_CLIENTS 6                   // Concurrent stream clients, of WEB_SERVER_PORTAL_MAX_SOCKETS
+#define SIGNALK_NODE_ID 0                       // Node whose readings are sent (0: every node)
+#define SIGNALK_STALE_MS 300000                 // A reading this old gives way to an older replayed one
+#define SIGNALK_BUS_DEPTH 8
+#define SIGNALK_FRAME_MAX 768                   // Largest delta: every path, with its header
+#define SIGNALK_RX_MAX 512                      // Largest subscribe message read from a client
+
+/**
+ * @brief Stream counters
+ */
+typedef struct {
+    uint32_t clients;                           // Connected now
+    uint32_t updates;                           // Records turned into deltas
+    uint32_t frames;                            // Frames assembled (one per distinct path set per update)
+    uint32_t sent;                              // Frames sent to clients
+    uint32_t dropped;                           // Clients dropped because a send failed
+} signalk_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Register the discovery and stream endpoints
+ *
+ * @param server Running HTTP server handle
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t signalk_register(httpd_handle_t server);
+
+/**
+ * @brief Drop every client; call before stopping the HTTP server
+ */
+void signalk_unregister(void);
+
+/**
+ * @brief Subscribe to the sample bus and start the delta task
+ *
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_STATE without the
+ *         sample bus, ESP_ERR_NO_MEM if the task cannot be created
+ */
+esp_err_t signalk_start(void);
+
+/**
+ * @brief Stop the delta task and leave the sample bus
+ */
+void signalk_stop(void);
+
+/**
+ * @brief Copy the counters
+ */
+void signalk_get_stats(signalk_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIGNALK_H
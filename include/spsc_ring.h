@@ -0,0 +1,101 @@
+/**
+ * @file spsc_ring.h
+ * @brief Lock-free single-producer, single-consumer ring of fixed-size slots
+ *
+ * The producer writes straight into the next free slot and publishes it;
+ * the consumer reads the oldest slot in place and releases it. Neither side
+ * takes a lock or disables interrupts: each index is written by one side
+ * only, with release/acquire ordering so a published slot's contents are
+ * visible to the other core before its index is. Storage is supplied once
+ * by the caller, so nothing is allocated per item.
+ *
+ * Exactly one task may produce and one (possibly on the other core) consume.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+
+/**
+ * @brief Ring state; head and tail run freely and wrap through the mask
+ */
+typedef struct {
+    uint8_t *storage;
+    size_t slot_size;
+    uint32_t mask;                              // Slots - 1
+    uint32_t head;                              // Next slot to fill; written by the producer only
+    uint32_t tail;                              // Oldest filled slot; written by the consumer only
+    uint32_t high_water;                        // Most slots ever filled; producer only
+} spsc_ring_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Set up an empty ring over caller-owned storage
+ *
+ * @param ring Ring to initialise
+ * @param storage slots * slot_size bytes, aligned for whatever the slots hold
+ * @param slot_size Bytes per slot
+ * @param slots Slot count, a power of two
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG
+ */
+esp_err_t spsc_ring_init(spsc_ring_t *ring, void *storage, size_t slot_size, uint32_t slots);
+
+/**
+ * @brief Producer: the next free slot to fill, or NULL when the ring is full
+ *
+ * The slot is not visible to the consumer until spsc_ring_commit().
+ */
+void *spsc_ring_acquire(spsc_ring_t *ring);
+
+/**
+ * @brief Producer: publish the slot returned by spsc_ring_acquire()
+ */
+void spsc_ring_commit(spsc_ring_t *ring);
+
+/**
+ * @brief Consumer: the oldest filled slot, or NULL when the ring is empty
+ *
+ * The slot stays valid, and is not reused, until spsc_ring_release().
+ */
+void *spsc_ring_front(spsc_ring_t *ring);
+
+/**
+ * @brief Consumer: hand the slot returned by spsc_ring_front() back to the producer
+ */
+void spsc_ring_release(spsc_ring_t *ring);
+
+/**
+ * @brief Filled slots; exact on either side, a snapshot from anywhere else
+ */
+uint32_t spsc_ring_count(const spsc_ring_t *ring);
+
+/**
+ * @brief Free slots; exact for the producer
+ */
+uint32_t spsc_ring_space(const spsc_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPSC_RING_H
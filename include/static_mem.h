@@ -0,0 +1,109 @@
+/**
+ * @file static_mem.h
+ * @brief Static memory build: task stacks and request buffers fixed at link time instead of taken from the heap
+ *
+ * With STATIC_MEMORY=1 ([env:static]) the tasks that run for the whole
+ * boot get their stack and TCB from a STATIC_TASK_SLOT in .bss, and the
+ * HTTP request arenas (http_arena.h) and OTA write blocks are static
+ * arrays. What is left on the heap is what ESP-IDF itself allocates, so
+ * weeks of uptime no longer carve it up, and the RAM the application
+ * needs shows in the link map.
+ *
+ * A slot serves one task creation. A task that is stopped and started
+ * again gets its second stack from the heap: a task that deleted itself
+ * keeps its TCB until the idle task has reclaimed it, so the slot cannot
+ * safely be handed out again.
+ *
+ * Without STATIC_MEMORY everything goes to the heap as before.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef STATIC_MEM_H
+#define STATIC_MEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef STATIC_MEMORY
+#define STATIC_MEMORY 0                         // 1: static task stacks and request buffers; build with -D STATIC_MEMORY=1
+#endif
+
+/**
+ * @brief Stack and TCB for one task
+ */
+typedef struct {
+    StaticTask_t tcb;
+    StackType_t *stack;
+    uint32_t stack_size;                        // Bytes (StackType_t is uint8_t on ESP-IDF)
+    bool used;
+} static_task_slot_t;
+
+/**
+ * @brief Define a slot for a task with stack_bytes of stack; NULL (heap) without STATIC_MEMORY
+ *
+ * Use at file scope and pass name to static_task_create().
+ */
+#if STATIC_MEMORY
+#define STATIC_TASK_SLOT(name, stack_bytes)                                                        \
+    static StackType_t name##_stack[(stack_bytes)];                                                \
+    static static_task_slot_t name##_slot = { .stack = name##_stack, .stack_size = (stack_bytes) }; \
+    static static_task_slot_t *const name = &name##_slot
+#else
+#define STATIC_TASK_SLOT(name, stack_bytes) static static_task_slot_t *const name = NULL
+#endif
+
+/**
+ * @brief Where the memory came from
+ */
+typedef struct {
+    bool enabled;                               // STATIC_MEMORY build
+    uint32_t static_tasks;                      // Tasks running on a slot
+    uint32_t static_stack_bytes;
+    uint32_t heap_tasks;                        // Tasks created on the heap from a slot already used
+} static_mem_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief xTaskCreatePinnedToCore() on a slot's stack, or on the heap without one
+ *
+ * @param slot From STATIC_TASK_SLOT(), or NULL for a heap stack
+ * @param stack_size Bytes; must not exceed the slot's
+ * @param core_id Core, or tskNO_AFFINITY
+ * @return pdPASS or the xTaskCreate error
+ */
+BaseType_t static_task_create(static_task_slot_t *slot, TaskFunction_t fn, const char *name, uint32_t stack_size,
+                              void *arg, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id);
+
+/**
+ * @brief Copy the counters
+ */
+void static_mem_get_stats(static_mem_stats_t *stats);
+
+/**
+ * @brief Write the counters as a JSON object
+ */
+void static_mem_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STATIC_MEM_H
@@ -0,0 +1,178 @@
+/**
+ * @file storage.h
+ * @brief Filesystem backend for the "spiffs" partition: SPIFFS or LittleFS, chosen at build time
+ *
+ * Everything on the data partition (web assets, the asset manifest, the
+ * time-series store) goes through the VFS at SPIFFS_BASE_PATH, so only
+ * mounting, unmounting, usage and formatting differ between backends.
+ * Those go through here.
+ *
+ * SPIFFS has no directories, slows down as it fills, and after a power cut
+ * it checks the whole partition on mount. LittleFS is copy-on-write, so an
+ * interrupted write leaves the previous state intact, and it mounts in
+ * constant time. That makes it the better choice on a 12 V bus that loses
+ * power as a matter of course. Build with -D STORAGE_LITTLEFS=1 (the
+ * [env:littlefs] PlatformIO environment), which also builds the data image
+ * as LittleFS. The partition keeps its name and subtype either way.
+ *
+ * A filesystem OTA image must match the backend: storage_check_image()
+ * looks for the LittleFS superblock magic in the first block.
+ *
+ * Two partition tables are supported. partitions.csv gives the data
+ * partition 1 MB and keeps the time-series store (ts_store.h) on it.
+ * partitions_split.csv ([env:split]) shrinks it to 384 KB, which the
+ * gzipped web assets fit with room to spare, and gives the store its own
+ * STORAGE_HISTORY_LABEL partition, mounted separately at
+ * STORAGE_HISTORY_BASE_PATH: its own wear levelling and its own VFS lock,
+ * and a web image update no longer wipes the history. Every other
+ * partition keeps its offset, so the node backlog, metric history and
+ * core dump survive flashing the other table. Which table is in use is
+ * found at boot; the same firmware runs on either.
+ *
+ * partitions_ab.csv ([env:ab]) splits the web asset space into two slots,
+ * STORAGE_PARTITION_LABEL and STORAGE_PARTITION_B_LABEL, with the store
+ * on its own partition as in the split table. One slot is mounted at
+ * SPIFFS_BASE_PATH; an NVS entry says which. A filesystem update is
+ * written to the other one while the portal keeps serving, and the web
+ * server switches over once the image is verified, without a reboot. A
+ * failed upload leaves the running slot untouched. With one slot
+ * storage_spare_label() is NULL and an update rewrites the mounted
+ * partition, as before.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef STORAGE_LITTLEFS
+#define STORAGE_LITTLEFS 0                      // 1: LittleFS on the data partition; build with -D STORAGE_LITTLEFS=1
+#endif
+#define STORAGE_PARTITION_LABEL "spiffs"        // Label in partitions.csv, for both backends
+#define STORAGE_PARTITION_B_LABEL "spiffs_b"    // Second web asset slot (partitions_ab.csv)
+#define STORAGE_NVS_NAMESPACE "storage"
+#define STORAGE_NVS_SLOT_KEY "assets"           // u8: 1 while STORAGE_PARTITION_B_LABEL is mounted
+#define STORAGE_HISTORY_LABEL "tsdata"          // The time-series store's own partition (split and A/B tables)
+#define STORAGE_HISTORY_BASE_PATH "/tsdata"     // Its VFS path
+#define STORAGE_LITTLEFS_MAGIC "littlefs"       // Superblock name, at STORAGE_LITTLEFS_MAGIC_OFFSET of block 0
+#define STORAGE_LITTLEFS_MAGIC_OFFSET 8
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Backend name for logs and status: "SPIFFS" or "LittleFS"
+ */
+const char *storage_name(void);
+
+/**
+ * @brief Label of the web asset slot mounted at SPIFFS_BASE_PATH
+ *
+ * STORAGE_PARTITION_LABEL unless the table has two slots and NVS names
+ * the second. The functions below without a label act on this one.
+ */
+const char *storage_active_label(void);
+
+/**
+ * @brief Label of the slot a filesystem update is written to; NULL with a single-slot table
+ */
+const char *storage_spare_label(void);
+
+/**
+ * @brief Make label the active slot, in NVS and for the next storage_mount()
+ *
+ * Call with the new slot already mounted, so a slot that does not mount
+ * is never recorded.
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG if label is not an asset slot of this table, or the NVS error
+ */
+esp_err_t storage_set_active(const char *label);
+
+/**
+ * @brief Mount the active slot
+ *
+ * @param base_path VFS path, SPIFFS_BASE_PATH
+ * @param max_files Files open at once (SPIFFS; LittleFS has no limit)
+ * @param format_if_mount_failed Format an unreadable partition instead of failing
+ * @return esp_err_t ESP_OK, or ESP_FAIL when the partition does not hold a filesystem
+ */
+esp_err_t storage_mount(const char *base_path, size_t max_files, bool format_if_mount_failed);
+
+/**
+ * @brief Unmount the active slot
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_STATE if it was not mounted
+ */
+esp_err_t storage_unmount(void);
+
+/**
+ * @brief True while the active slot is mounted
+ */
+bool storage_mounted(void);
+
+/**
+ * @brief Partition capacity and bytes in use
+ */
+esp_err_t storage_info(size_t *total, size_t *used);
+
+/**
+ * @brief Erase the active slot and lay down an empty filesystem
+ */
+esp_err_t storage_format(void);
+
+/**
+ * @brief Mount any data partition of subtype spiffs with the build's backend
+ *
+ * The functions above are these for storage_active_label().
+ *
+ * @param label Label in the partition table
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND without the partition, or ESP_FAIL when it does not hold a filesystem
+ */
+esp_err_t storage_mount_partition(const char *label, const char *base_path, size_t max_files,
+                                  bool format_if_mount_failed);
+
+esp_err_t storage_unmount_partition(const char *label);
+
+bool storage_partition_mounted(const char *label);
+
+esp_err_t storage_partition_info(const char *label, size_t *total, size_t *used);
+
+esp_err_t storage_format_partition(const char *label);
+
+/**
+ * @brief A filesystem partition in the running partition table; NULL if there is none
+ */
+const esp_partition_t *storage_find_partition(const char *label);
+
+/**
+ * @brief Check the start of a filesystem image against the backend
+ *
+ * @param data First bytes of the image, as written at offset 0
+ * @param len At least STORAGE_LITTLEFS_MAGIC_OFFSET plus the magic's length
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_SIZE if len is too short, or
+ *         ESP_ERR_NOT_SUPPORTED for an image of the other filesystem
+ */
+esp_err_t storage_check_image(const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STORAGE_H
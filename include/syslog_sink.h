@@ -0,0 +1,96 @@
+/**
+ * @file syslog_sink.h
+ * @brief Gateway log output copied to a remote syslog collector over UDP
+ *
+ * syslog_sink_start() hooks esp_log_set_vprintf(). Every line still goes
+ * to the UART as before; the hook also formats it straight into a slot
+ * of a ring buffer and returns. When the ring is full the line is
+ * counted and dropped, so a burst of logging never waits on the network.
+ *
+ * A task of its own sends the lines to SYSLOG_HOST:SYSLOG_PORT, several
+ * per datagram: it collects for up to SYSLOG_BATCH_MS after the first
+ * line, or until SYSLOG_DATAGRAM_MAX bytes. Each line is a BSD syslog
+ * (RFC 3164) message ending in '\n':
+ *
+ *   <PRI>HOSTNAME TAG: text
+ *
+ * with facility local0, the severity from the ESP log level letter, the
+ * hostname "wsgw-" and the last three bytes of the station MAC, and the
+ * colour codes stripped. A collector that takes one message per
+ * datagram (rsyslog's imudp) needs its multi-line split enabled; the
+ * gateway's own UART shows the same lines regardless.
+ *
+ * Nothing is sent while the station has no address; those lines count
+ * as no_uplink.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef SYSLOG_SINK_H
+#define SYSLOG_SINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef SYSLOG_HOST
+#define SYSLOG_HOST "192.168.1.200"             // Collector address; build with -D SYSLOG_HOST=\"...\"
+#endif
+#ifndef SYSLOG_PORT
+#define SYSLOG_PORT 514
+#endif
+#define SYSLOG_FACILITY 16                      // local0
+#define SYSLOG_LINE_MAX 192                     // Longest line kept, terminator included; longer ones are cut
+#define SYSLOG_RING_BYTES (16 * (SYSLOG_LINE_MAX + 8)) // About 16 lines waiting for the send task
+#define SYSLOG_DATAGRAM_MAX 1200                // Below the path MTU, so no IP fragments
+#define SYSLOG_BATCH_MS 200                     // Longest a line waits for others to share its datagram
+
+/**
+ * @brief Counters
+ */
+typedef struct {
+    bool running;
+    uint32_t lines;                             // Lines sent
+    uint32_t datagrams;
+    uint32_t dropped;                           // Ring full when the line was logged
+    uint32_t no_uplink;                         // Lines dropped while the station had no address
+    uint32_t errors;                            // sendto() failures; their lines are lost too
+} syslog_sink_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Open the socket, start the send task and hook the log output
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG for a SYSLOG_HOST that is not an IPv4 address,
+ *         ESP_FAIL if the socket cannot be opened, ESP_ERR_NO_MEM if the ring or task cannot be created
+ */
+esp_err_t syslog_sink_start(void);
+
+/**
+ * @brief Restore the previous log output, stop the send task and close the socket
+ */
+void syslog_sink_stop(void);
+
+/**
+ * @brief Copy the counters
+ */
+void syslog_sink_get_stats(syslog_sink_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SYSLOG_SINK_H
@@ -0,0 +1,206 @@
+/**
+ * @file task_plan.h
+ * @brief Core, priority and stack of every task, in one place
+ *
+ * The ESP32's two cores are split by job:
+ *
+ *   TASK_CORE_NET (0)   Wi-Fi, lwIP, the network servers and clients (DNS,
+ *                       httpd, MQTT, NMEA sockets, ESP-NOW ACKs), and the
+ *                       housekeeping tasks that touch flash (including the
+ *                       gateway's node firmware distribution)
+ *   TASK_CORE_APP (1)   sensor sampling, ESP-NOW decode, the role loop
+ *                       (forwarder and aggregation), NMEA 2000, OTA writes
+ *
+ * so a burst of network traffic cannot delay a sensor read or a decode.
+ * The Wi-Fi, lwIP, MQTT, NimBLE host and main tasks are created by ESP-IDF;
+ * their cores come from sdkconfig (CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_0,
+ * CONFIG_LWIP_TCPIP_TASK_AFFINITY_CPU0, CONFIG_MQTT_USE_CORE_0,
+ * CONFIG_BT_NIMBLE_PINNED_TO_CORE_0, CONFIG_ESP_MAIN_TASK_AFFINITY_CPU1),
+ * and are listed here so the boot check covers them too.
+ *
+ * Every module creates its task with the values below.
+ * task_plan_check() compares each running task against the plan once the
+ * role is up, and logs any that drifted.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef TASK_PLAN_H
+#define TASK_PLAN_H
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#if CONFIG_FREERTOS_UNICORE
+#define TASK_CORE_NET 0
+#define TASK_CORE_APP 0
+#else
+#define TASK_CORE_NET 0                         // Wi-Fi and lwIP run here
+#define TASK_CORE_APP 1                         // Sensors, decode and aggregation
+#endif
+
+// ESP-IDF tasks, configured in sdkconfig
+#define WIFI_TASK_NAME "wifi"
+#define LWIP_TASK_NAME "tiT"
+#define MAIN_TASK_NAME "main"
+#define MQTT_TASK_NAME "mqtt_task"
+#define MQTT_TASK_STACK_SIZE 6144
+#define MQTT_TASK_PRIORITY 5
+#define NIMBLE_HOST_TASK_NAME "nimble_host"     // BLE beacon builds (sdkconfig.ble.defaults)
+
+// Network core
+#define DNS_TASK_NAME "dns_server"
+#define DNS_TASK_STACK_SIZE 4096                // Bytes (StackType_t is uint8_t on ESP-IDF)
+#define DNS_TASK_PRIORITY 5
+#define WEB_SERVER_PORTAL_TASK_NAME "httpd"     // Also the HTTPS redirect server
+#ifndef WEB_SERVER_PORTAL_CORE
+#define WEB_SERVER_PORTAL_CORE TASK_CORE_NET
+#endif
+#ifndef WEB_SERVER_PORTAL_STACK_SIZE
+#define WEB_SERVER_PORTAL_STACK_SIZE 6144
+#endif
+#define WEB_SERVER_PORTAL_PRIORITY 5
+#define HTTPS_PORTAL_STACK_SIZE 10240           // The handshake runs on the server task
+#define HTTPS_PORTAL_REDIRECT_STACK_SIZE 3072
+#define METRICS_STREAM_TASK_NAME "metrics_stream"
+#define METRICS_STREAM_TASK_STACK_SIZE 3584
+#define METRICS_STREAM_TASK_PRIORITY 4
+#define ESPNOW_RELIABLE_ACK_TASK_NAME "espnow_ack"
+#define ESPNOW_RELIABLE_ACK_TASK_STACK_SIZE 3072
+#define ESPNOW_RELIABLE_ACK_TASK_PRIORITY 5     // Below the link task, which feeds it
+#define ESPNOW_RELAY_TASK_NAME "espnow_relay"
+#define ESPNOW_RELAY_TASK_STACK_SIZE 3072
+#define ESPNOW_RELAY_TASK_PRIORITY 4            // Node; below the link task, which feeds it
+#define NMEA_TASK_NAME "nmea"
+#define NMEA_TASK_STACK_SIZE 3072
+#define NMEA_TASK_PRIORITY 3
+#define SIGNALK_TASK_NAME "signalk"
+#define SIGNALK_TASK_STACK_SIZE 3072
+#define SIGNALK_TASK_PRIORITY 3
+#define TELEMETRY_MCAST_TASK_NAME "telem_mcast"
+#define TELEMETRY_MCAST_TASK_STACK_SIZE 2560
+#define TELEMETRY_MCAST_TASK_PRIORITY 4         // Gateway; below the link task, which feeds it
+#define SYSLOG_TASK_NAME "syslog"
+#define SYSLOG_TASK_STACK_SIZE 3072
+#define SYSLOG_TASK_PRIORITY 2                  // Gateway; below everything whose lines it sends
+#define INFLUX_WRITER_TASK_NAME "influx"
+#define INFLUX_WRITER_TASK_STACK_SIZE 4096      // esp_http_client, and TLS when the URL is https
+#define INFLUX_WRITER_TASK_PRIORITY 3
+#define OTA_PULL_TASK_NAME "ota_pull"
+#define OTA_PULL_TASK_STACK_SIZE 6144           // TLS handshake and the JSON reader
+#define OTA_PULL_TASK_PRIORITY 2                // Gateway; downloads wait for the telemetry path
+#define SD_ARCHIVE_TASK_NAME "sd_archive"
+#define SD_ARCHIVE_TASK_STACK_SIZE 3072
+#define SD_ARCHIVE_TASK_PRIORITY 1              // Just above idle: card writes wait for everything else
+#define FRAME_CAPTURE_TASK_NAME "capture"
+#define FRAME_CAPTURE_TASK_STACK_SIZE 3072
+#define FRAME_CAPTURE_TASK_PRIORITY 1           // Like the archive: the link task never waits on it
+#define FRAME_REPLAY_TASK_NAME "replay"
+#define FRAME_REPLAY_TASK_STACK_SIZE 3072
+#define FRAME_REPLAY_TASK_PRIORITY 2            // Below the forwarder it feeds
+
+// Network core housekeeping: flash writes and one-shot jobs, kept off the sensor core
+#define NVS_CONFIG_FLUSH_TASK_NAME "nvs_flush"
+#define NVS_CONFIG_FLUSH_TASK_STACK_SIZE 3072
+#define NVS_CONFIG_FLUSH_TASK_PRIORITY 2
+#define METRIC_HISTORY_TASK_NAME "metric_history"
+#define METRIC_HISTORY_TASK_STACK_SIZE 3072
+#define METRIC_HISTORY_TASK_PRIORITY 2
+#define HEALTH_WATCH_TASK_NAME "health_watch"
+#define HEALTH_WATCH_TASK_STACK_SIZE 3072       // The alarm message and the live stream frame
+#define HEALTH_WATCH_TASK_PRIORITY 2
+#define WEB_SERVER_SPIFFS_TASK_NAME "spiffs_mount"
+#define WEB_SERVER_SPIFFS_TASK_STACK_SIZE 4096
+#define WEB_SERVER_SPIFFS_TASK_PRIORITY 1       // Just above idle: mounting must not delay startup
+#define WEB_SERVER_REBOOT_TASK_NAME "reboot_task"
+#define WEB_SERVER_REBOOT_TASK_STACK_SIZE 2048
+#define WEB_SERVER_REBOOT_TASK_PRIORITY 5
+#define BOOT_BUTTON_TASK_NAME "boot_button"
+#define BOOT_BUTTON_TASK_STACK_SIZE 3072        // Brings up NimBLE with BLE_CONFIG
+#define BOOT_BUTTON_TASK_PRIORITY 2
+#define EVENT_LOG_TASK_NAME "event_log"
+#define EVENT_LOG_TASK_STACK_SIZE 3072          // Formats one line at a time
+#define EVENT_LOG_TASK_PRIORITY 1               // Just above idle: printing waits for everything else
+#define SERVICE_NET_TASK_NAME "svc_net"         // Service manager workers, one per core; config mode
+#define SERVICE_TASK_STACK_SIZE 4096            // Wi-Fi init and the web server start run on them
+#define SERVICE_TASK_PRIORITY 3
+#define MQTT_CMD_TASK_NAME "mqtt_cmd"
+#define MQTT_CMD_TASK_STACK_SIZE 4096           // Settings save, JSON reader and writer
+#define MQTT_CMD_TASK_PRIORITY 2                // Gateway; below the esp-mqtt task that feeds it
+#define ESPNOW_OTA_TASK_NAME "espnow_ota"
+#define ESPNOW_OTA_TASK_STACK_SIZE 3584
+#define ESPNOW_OTA_TASK_PRIORITY 2              // Gateway; node firmware goes out below the ACKs
+
+// Application core
+#define SAMPLER_ACQUIRE_TASK_NAME "sampler_acq"
+#define SAMPLER_ACQUIRE_TASK_STACK_SIZE 3072
+#define SAMPLER_ACQUIRE_TASK_PRIORITY 5         // Above transmit, so a slow radio never delays a read
+#define SAMPLER_TRANSMIT_TASK_NAME "sampler_tx"
+#define SAMPLER_TRANSMIT_TASK_STACK_SIZE 3072
+#define SAMPLER_TRANSMIT_TASK_PRIORITY 3
+#define ESPNOW_LINK_TASK_NAME "espnow_link"
+#define ESPNOW_LINK_TASK_STACK_SIZE 4096        // Also commits a rotated key to NVS
+#define ESPNOW_LINK_TASK_PRIORITY 6             // Above the sampler stages; it only drains the rings
+#ifndef ESPNOW_LINK_TASK_CORE
+#define ESPNOW_LINK_TASK_CORE TASK_CORE_APP     // Decode off the Wi-Fi core; the receive callback only copies
+#endif
+#define N2K_TASK_NAME "n2k"
+#define N2K_TASK_STACK_SIZE 3072
+#define N2K_TASK_PRIORITY 4
+#define OTA_WRITER_TASK_NAME "ota_writer"
+#define OTA_WRITER_STACK_SIZE 4096
+#define OTA_WRITER_PRIORITY 5
+#ifndef OTA_WRITER_CORE
+#define OTA_WRITER_CORE TASK_CORE_APP           // Opposite core to the web server task
+#endif
+#define ENERGY_BENCH_TASK_NAME "energy_meter"
+#define ENERGY_BENCH_TASK_STACK_SIZE 2560
+#define ENERGY_BENCH_TASK_PRIORITY 6            // Above the workload, so reads keep their period
+#define BENCH_RX_TASK_NAME "bench_rx"           // Stands in for the Wi-Fi task in the rx_path cases
+#define BENCH_RX_TASK_STACK_SIZE 2048
+#define BENCH_RX_TASK_PRIORITY 5
+#define BENCH_FLASH_TASK_NAME "bench_flash"     // Flash writes behind rx_path_flash
+#define BENCH_FLASH_TASK_STACK_SIZE 2048
+#define BENCH_FLASH_TASK_PRIORITY 1             // Below bench_rx, which preempts it between writes
+#define I2C_BUS_TASK_NAME "i2c_bus"
+#define I2C_BUS_TASK_STACK_SIZE 2560
+#define I2C_BUS_TASK_PRIORITY 7                 // Above every driver that waits on it
+#define ADC_STREAM_TASK_NAME "adc_stream"
+#define ADC_STREAM_TASK_STACK_SIZE 2560
+#define ADC_STREAM_TASK_PRIORITY 4              // Two frames of slack in the DMA pool
+#define MOTION_TASK_NAME "motion"
+#define MOTION_TASK_STACK_SIZE 3072
+#define MOTION_TASK_PRIORITY 5                  // Below the bus task; the FIFO holds several batches of slack
+#define GPS_TASK_NAME "gps"
+#define GPS_TASK_STACK_SIZE 2560
+#define GPS_TASK_PRIORITY 4                     // The UART ring buffer holds seconds of input
+#define SERVICE_APP_TASK_NAME "svc_app"         // Second service manager worker
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Check every running task of the plan for its core and priority, and log its stack headroom
+ *
+ * Tasks that are not running (other roles, not started yet) are skipped.
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_STATE if any task is off its core or priority
+ */
+esp_err_t task_plan_check(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TASK_PLAN_H
@@ -0,0 +1,347 @@
+/**
+ * @file telemetry.h
+ * @brief Node-to-gateway binary telemetry frame: encode and decode in place, no allocation
+ *
+ * One frame carries a batch of samples from one node and fits in a single
+ * ESP-NOW frame. All multi-byte fields are little-endian.
+ *
+ *   Header, TELEMETRY_HEADER_LEN bytes:
+ *     0     magic               TELEMETRY_MAGIC
+ *     1     version:4 | type:4  TELEMETRY_VERSION, TELEMETRY_TYPE_*
+ *     2     count               Records that follow
+ *     3     flags               TELEMETRY_FLAG_*
+ *     4..7  node id             Low four bytes of the node's station MAC
+ *     8..11 base seq            Sequence number of record 0; record i is base seq + i
+ *    12..15 base time           Unix seconds of record 0
+ *
+ *   Power extension, TELEMETRY_POWER_LEN bytes, only with TELEMETRY_FLAG_POWER:
+ *     0..1  awake share         0.01 % of the time since power-on the node was awake
+ *     2..3  wake length         Mean ms awake per deep sleep wake (0: not duty cycling), saturating
+ *
+ *   Rain extension, TELEMETRY_RAIN_LEN bytes, only with TELEMETRY_FLAG_RAIN; after the power extension:
+ *     0..1  tips                Rain gauge tips since power-on, wrapping; the gateway takes differences
+ *     2..3  rain rate           Rain in the last hour, 0.01 mm (= 0.01 mm/h), saturating
+ *
+ *   Config extension, TELEMETRY_CONFIG_LEN bytes, only with TELEMETRY_FLAG_CONFIG; after the rain extension:
+ *     0..1  config version      Version of the pushed settings the node runs (espnow_config.h)
+ *
+ *   Health extension, TELEMETRY_HEALTH_LEN bytes, only with TELEMETRY_FLAG_HEALTH; after the config extension:
+ *     0..1  supply              mV; TELEMETRY_HEALTH_UNKNOWN when the node does not measure it
+ *     2..3  backlog             Records waiting on the node to be sent (flash backlog, RTC batch), saturating
+ *
+ *   Key extension, TELEMETRY_KEY_LEN bytes, only with TELEMETRY_FLAG_KEY; after the health extension:
+ *     0..3  fingerprint         Of the pending ESP-NOW key the node holds (espnow_rekey.h)
+ *     4..7  switch seq          Reliable-layer seq the node will change keys at; 0 until the gateway named one
+ *
+ *   BME680 record, TELEMETRY_RECORD_LEN bytes:
+ *     0..1  time delta          Seconds after base time
+ *     2..3  temperature         int16, 0.01 degC
+ *     4..5  pressure            (Pa - TELEMETRY_PRESSURE_OFFSET_PA) / 2
+ *     6..7  humidity            0.01 %RH
+ *     8..9  gas resistance      exponent:4 | mantissa:12, ohm = mantissa << exponent
+ *    10     flags               TELEMETRY_REC_*
+ *
+ *   Packed BME680 records, type TELEMETRY_TYPE_BME680_PACKED, in place of the fixed ones:
+ *     Each field is a column predicted from the record before (record 0
+ *     from zeros and the base time), at the fixed record's resolution, so
+ *     both types decode to the same values. A record is a mask byte, bit n
+ *     set when column n differs from its prediction, then the set columns
+ *     in order:
+ *       0  time                delta-of-delta of the seconds, zigzag varint
+ *       1  temperature         delta, zigzag varint
+ *       2  pressure            delta of the 2 Pa code, zigzag varint
+ *       3  humidity            delta of the 0.01 %RH code, zigzag varint
+ *       4  gas resistance      XOR of the exponent:mantissa code, varint
+ *       5  flags               XOR of the flags byte, one byte
+ *     Varints are 7 bits a byte, low group first, bit 7 set on all but
+ *     the last. A steady series at a fixed period packs to 1 to 4 bytes a
+ *     record against TELEMETRY_RECORD_LEN, so a backlog replays in a
+ *     fraction of the frames. Records decode in order, in one pass.
+ *
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define TELEMETRY_FRAME_MAX 250                 // ESP_NOW_MAX_DATA_LEN
+#define TELEMETRY_MAGIC 0xB5
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_TYPE_BME680 1
+#define TELEMETRY_TYPE_BME680_PACKED 2          // Delta/XOR-coded records (above)
+#define TELEMETRY_HEADER_LEN 16
+#define TELEMETRY_RECORD_LEN 11
+#define TELEMETRY_POWER_LEN 4
+#define TELEMETRY_RAIN_LEN 4
+#define TELEMETRY_CONFIG_LEN 2
+#define TELEMETRY_HEALTH_LEN 4
+#define TELEMETRY_HEALTH_UNKNOWN 0xFFFF         // Supply not measured
+#define TELEMETRY_KEY_LEN 8
+#define TELEMETRY_MAX_RECORDS ((TELEMETRY_FRAME_MAX - TELEMETRY_HEADER_LEN) / TELEMETRY_RECORD_LEN)
+#define TELEMETRY_PACKED_MAX_RECORDS 64         // Most records in a packed frame, and so in any frame
+#define TELEMETRY_PACKED_RECORD_MAX 19          // Longest packed record: mask, five varints and the flags
+#define TELEMETRY_PRESSURE_OFFSET_PA 30000      // Encodable range 30000..161070 Pa in 2 Pa steps
+
+// Header flags
+#define TELEMETRY_FLAG_SAMPLES_LOST (1 << 0)    // Older samples were overwritten before this batch was sent
+#define TELEMETRY_FLAG_MORE (1 << 1)            // Another frame of the same batch follows
+#define TELEMETRY_FLAG_POWER (1 << 2)           // The power extension follows the header
+#define TELEMETRY_FLAG_RAIN (1 << 3)            // The rain extension follows the header (and power extension)
+#define TELEMETRY_FLAG_CONFIG (1 << 4)          // The config extension follows the header (and the others)
+#define TELEMETRY_FLAG_HEALTH (1 << 5)          // The health extension follows the header (and the others)
+#define TELEMETRY_FLAG_KEY (1 << 6)             // The key extension follows the header (and the others)
+#define TELEMETRY_FLAG_LR (1 << 7)              // Sent in ESP-NOW Long Range mode; answer the node in it too
+#define TELEMETRY_FLAG_EXTENSIONS \
+    (TELEMETRY_FLAG_POWER | TELEMETRY_FLAG_RAIN | TELEMETRY_FLAG_CONFIG | TELEMETRY_FLAG_HEALTH | TELEMETRY_FLAG_KEY)
+
+// Record flags
+#define TELEMETRY_REC_GAS_VALID (1 << 0)
+#define TELEMETRY_REC_HEAT_STABLE (1 << 1)
+#define TELEMETRY_REC_STEP_SHIFT 2              // Heater step in bits 2..5
+#define TELEMETRY_REC_STEP_MASK (0x0F << TELEMETRY_REC_STEP_SHIFT)
+#define TELEMETRY_REC_HELD (1 << 6)             // Samples since the previous record stayed within its deadbands (deadband.h)
+#define TELEMETRY_REC_URGENT (1 << 7)           // An alarm: the gateway forwards it in its alarm lane, ahead of bulk records
+
+_Static_assert(TELEMETRY_PACKED_MAX_RECORDS >= TELEMETRY_MAX_RECORDS, "a packed frame holds at least a fixed one");
+
+/**
+ * @brief A record at the encoded resolution: the column predictors of packed records
+ */
+typedef struct {
+    uint32_t time_s;
+    int32_t delta_s;                            // Seconds since the record before
+    int16_t temperature;
+    uint16_t pressure;                          // (Pa - TELEMETRY_PRESSURE_OFFSET_PA) / 2
+    uint16_t humidity;                          // 0.01 %RH
+    uint16_t gas;                               // exponent:4 | mantissa:12
+    uint8_t flags;                              // TELEMETRY_REC_*
+} telemetry_packed_t;
+
+/**
+ * @brief Frame header, decoded
+ */
+typedef struct {
+    uint8_t type;                               // TELEMETRY_TYPE_*
+    uint8_t count;
+    uint8_t flags;                              // TELEMETRY_FLAG_*
+    uint32_t node_id;
+    uint32_t base_seq;
+    uint32_t base_time_s;
+    uint8_t header_len;                         // Header plus extension: where record 0 starts
+    uint8_t len;                                // Frame length: where the last record ends
+    uint16_t awake_bp;                          // Power extension, with TELEMETRY_FLAG_POWER
+    uint16_t wake_ms;
+    uint16_t rain_tips;                         // Rain extension, with TELEMETRY_FLAG_RAIN
+    uint16_t rain_rate;                         // 0.01 mm/h
+    uint16_t config_version;                    // Config extension, with TELEMETRY_FLAG_CONFIG; else 0
+    uint16_t supply_mv;                         // Health extension, with TELEMETRY_FLAG_HEALTH, mV; else unknown
+    uint16_t backlog;                           // Records the node still holds; else 0
+    uint32_t key_fingerprint;                   // Key extension, with TELEMETRY_FLAG_KEY; else 0
+    uint32_t key_switch_seq;
+} telemetry_header_t;
+
+/**
+ * @brief Walks a decoded frame's records in order, either type
+ */
+typedef struct {
+    const uint8_t *buf;
+    const telemetry_header_t *hdr;
+    size_t pos;                                 // Next record's offset in buf
+    uint8_t index;                              // ... and its index
+    telemetry_packed_t prev;                    // Packed: the record before
+} telemetry_reader_t;
+
+/**
+ * @brief One sample, in the same fixed-point units as bme680_reading_t
+ *
+ * Encoding rounds pressure to 2 Pa, humidity to 0.01 %RH and the gas
+ * resistance to 12 significant bits.
+ */
+typedef struct {
+    uint32_t seq;
+    uint32_t time_s;                            // Unix seconds
+    int16_t temperature;                        // 0.01 degC
+    uint32_t pressure;                          // Pa
+    uint32_t humidity;                          // 0.001 %RH
+    uint32_t gas_resistance;                    // Ohm
+    uint8_t heater_step;
+    bool gas_valid;
+    bool heat_stable;
+    bool held;                                  // The previous record's values held until this one
+    bool urgent;                                // TELEMETRY_REC_URGENT
+} telemetry_record_t;
+
+/**
+ * @brief Frame being built; lives on the caller's stack, writes into the caller's buffer
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;                                 // Bytes of buf used so far: the frame length
+    uint8_t count;
+    uint32_t base_seq;
+    uint32_t base_time_s;
+    bool packed;                                // TELEMETRY_TYPE_BME680_PACKED
+    telemetry_packed_t prev;                    // ... the last record added
+} telemetry_writer_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Write the header of a new frame
+ *
+ * base_seq and base_time_s are taken from the first record added; count
+ * is kept up to date in the buffer as records are added.
+ *
+ * @param w Writer to initialise
+ * @param buf Frame buffer, usually TELEMETRY_FRAME_MAX bytes
+ * @param cap Size of buf
+ * @param node_id Sending node
+ * @param flags TELEMETRY_FLAG_*
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_SIZE if buf cannot hold a header
+ */
+esp_err_t telemetry_writer_init(telemetry_writer_t *w, uint8_t *buf, size_t cap, uint32_t node_id, uint8_t flags);
+
+/**
+ * @brief Append one record
+ *
+ * @return esp_err_t ESP_OK; ESP_ERR_NO_MEM when the frame is full, or
+ *         ESP_ERR_INVALID_ARG when seq or time do not follow on from record 0.
+ *         Either way the frame is unchanged and the record belongs in a new one.
+ */
+esp_err_t telemetry_writer_add(telemetry_writer_t *w, const telemetry_record_t *rec);
+
+/**
+ * @brief Add the power extension; before the first record
+ *
+ * @param w Writer
+ * @param awake_bp Share of time awake, 0.01 %
+ * @param wake_ms Mean ms per deep sleep wake, clamped to 16 bits
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE once records were added, or ESP_ERR_NO_MEM
+ */
+esp_err_t telemetry_writer_set_power(telemetry_writer_t *w, uint16_t awake_bp, uint32_t wake_ms);
+
+/**
+ * @brief Add the rain extension; before the first record, and after telemetry_writer_set_power() if both are used
+ *
+ * @param w Writer
+ * @param tips Tips since power-on; the low 16 bits are sent
+ * @param rate Rain in the last hour, 0.01 mm, clamped to 16 bits
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE once records were added, or ESP_ERR_NO_MEM
+ */
+esp_err_t telemetry_writer_set_rain(telemetry_writer_t *w, uint32_t tips, uint32_t rate);
+
+/**
+ * @brief Add the config extension; before the first record, and after the power and rain extensions
+ *
+ * @param w Writer
+ * @param version Version of the pushed settings in force
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE once records were added, or ESP_ERR_NO_MEM
+ */
+esp_err_t telemetry_writer_set_config(telemetry_writer_t *w, uint16_t version);
+
+/**
+ * @brief Add the health extension; before the first record, and after the other extensions
+ *
+ * @param w Writer
+ * @param supply_mv Supply voltage, mV, or TELEMETRY_HEALTH_UNKNOWN
+ * @param backlog Records waiting to be sent, clamped to 16 bits
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE once records were added, or ESP_ERR_NO_MEM
+ */
+esp_err_t telemetry_writer_set_health(telemetry_writer_t *w, uint16_t supply_mv, uint32_t backlog);
+
+/**
+ * @brief Add the key extension; before the first record, and after the other extensions
+ *
+ * @param w Writer
+ * @param fingerprint Fingerprint of the pending key the node holds
+ * @param switch_seq Seq the node will change keys at, 0 for none yet
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE once records were added, or ESP_ERR_NO_MEM
+ */
+esp_err_t telemetry_writer_set_key(telemetry_writer_t *w, uint32_t fingerprint, uint32_t switch_seq);
+
+/**
+ * @brief Pack the records (TELEMETRY_TYPE_BME680_PACKED); before the first record
+ *
+ * @param w Writer
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_STATE once records were added
+ */
+esp_err_t telemetry_writer_set_packed(telemetry_writer_t *w);
+
+/**
+ * @brief Set TELEMETRY_FLAG_LR; at any time
+ */
+void telemetry_writer_set_lr(telemetry_writer_t *w);
+
+/**
+ * @brief Set header flags after records were added (e.g. TELEMETRY_FLAG_MORE); the extension flags and LR are kept
+ */
+void telemetry_writer_set_flags(telemetry_writer_t *w, uint8_t flags);
+
+/**
+ * @brief Check and decode a frame header
+ *
+ * @param buf Received frame
+ * @param len Frame length
+ * @param hdr Decoded header
+ * A packed frame is walked once here, so its records are known to end at len.
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_VERSION for an unknown magic, version or type,
+ *         or ESP_ERR_INVALID_SIZE if len does not match count
+ */
+esp_err_t telemetry_decode_header(const uint8_t *buf, size_t len, telemetry_header_t *hdr);
+
+/**
+ * @brief Decode one record of a frame whose header already decoded
+ *
+ * Packed records are decoded from record 0 up to index; telemetry_reader_next() walks them in one pass.
+ *
+ * @param buf Received frame
+ * @param hdr Its header
+ * @param index Record, below hdr->count
+ * @param rec Decoded record with absolute seq and time
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG for an index out of range
+ */
+esp_err_t telemetry_decode_record(const uint8_t *buf, const telemetry_header_t *hdr, uint8_t index,
+                                  telemetry_record_t *rec);
+
+/**
+ * @brief Start walking the records of a frame whose header already decoded
+ *
+ * @param r Reader; reads buf and hdr, which must outlive it
+ * @param buf Received frame
+ * @param hdr Its header
+ */
+void telemetry_reader_init(telemetry_reader_t *r, const uint8_t *buf, const telemetry_header_t *hdr);
+
+/**
+ * @brief Decode the next record
+ *
+ * @param r Reader
+ * @param rec Decoded record with absolute seq and time
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND after the last record, or ESP_ERR_INVALID_SIZE for a truncated one
+ */
+esp_err_t telemetry_reader_next(telemetry_reader_t *r, telemetry_record_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_H
@@ -0,0 +1,101 @@
+/**
+ * @file telemetry_mcast.h
+ * @brief Telemetry frames as UDP multicast on the uplink LAN, for listeners that need no broker
+ *
+ * Every telemetry frame the gateway accepts goes out once, unchanged, as
+ * one datagram to TELEMETRY_MCAST_GROUP:TELEMETRY_MCAST_PORT on the
+ * station (bridge) interface, so any number of listeners costs the same.
+ * The datagram is an 8-byte header followed by the frame exactly as the
+ * node sent it (telemetry.h; decode it with telemetry_decode_header()
+ * and a telemetry_reader_t):
+ *
+ *   0  2  magic "WT"
+ *   2  1  version (TELEMETRY_MCAST_VERSION)
+ *   3  1  reserved, 0
+ *   4  4  datagram sequence number, little-endian, one per datagram
+ *
+ * A gap in the sequence number is a lost datagram, whether the network
+ * or a full send queue on the gateway dropped it; the nodes' own record
+ * sequence numbers still tell which samples it held. A frame a node
+ * resends because its ACK was lost is sent again; listeners drop records
+ * they have seen by node id and record seq, as the gateway does.
+ *
+ * The link task only copies the frame into a queue; a task of its own
+ * sends it. Nothing is sent while the station has no address.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef TELEMETRY_MCAST_H
+#define TELEMETRY_MCAST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define TELEMETRY_MCAST_GROUP "239.255.87.84"   // Organization-local scope
+#define TELEMETRY_MCAST_PORT 8784
+#define TELEMETRY_MCAST_TTL 1                   // Stay on the LAN
+#define TELEMETRY_MCAST_VERSION 1
+#define TELEMETRY_MCAST_HEADER_LEN 8
+#define TELEMETRY_MCAST_QUEUE 16                // Frames waiting for the send task (about 4 KB)
+
+/**
+ * @brief Counters
+ */
+typedef struct {
+    bool running;
+    uint32_t sent;                              // Datagrams sent
+    uint32_t queue_full;                        // Frames dropped because the send task fell behind
+    uint32_t no_uplink;                         // Frames dropped while the station had no address
+    uint32_t errors;                            // sendto() failures
+    uint32_t seq;                               // Next sequence number
+} telemetry_mcast_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Open the socket and start the send task
+ *
+ * @return esp_err_t ESP_OK on success, ESP_FAIL if the socket cannot be
+ *         opened, ESP_ERR_NO_MEM if the task cannot be created
+ */
+esp_err_t telemetry_mcast_start(void);
+
+/**
+ * @brief Queue a frame for sending; never blocks, so the link task may call it
+ *
+ * @param data Telemetry frame
+ * @param len Its length, at most TELEMETRY_FRAME_MAX
+ */
+void telemetry_mcast_send(const uint8_t *data, size_t len);
+
+/**
+ * @brief Stop the send task and close the socket
+ */
+void telemetry_mcast_stop(void);
+
+/**
+ * @brief Copy the counters
+ */
+void telemetry_mcast_get_stats(telemetry_mcast_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_MCAST_H
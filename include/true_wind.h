@@ -0,0 +1,81 @@
+/**
+ * @file true_wind.h
+ * @brief Masthead wind corrected for heel and mast motion, and true wind from GPS speed and course
+ *
+ * The vane and cups turn in the plane square to the mast. Heeled by roll
+ * and pitched by pitch, they see the athwartships part of the horizontal
+ * wind shortened by cos(roll) and the fore-and-aft part by cos(pitch).
+ * The mast swinging through the air adds its own velocity as wind. With
+ * the motion module running (motion.h), true_wind_get() undoes both on
+ * the wind module's 3 s means:
+ *
+ *   u = AWS cos(AWA) / cos(pitch) - mast_vx      wind from ahead
+ *   v = AWS sin(AWA) / cos(roll)  - mast_vy      wind from starboard
+ *
+ * The mast velocity is the motion module's mean over the same 3 s, so
+ * the regular swing of a seaway mostly cancels out and only the part that
+ * did not is taken off. Tilts past TRUE_WIND_TILT_MAX_DEG are clamped.
+ *
+ * With a GPS fix (gps_get_fix()), the boat's own motion is taken off
+ * too. The boat's velocity over ground is assumed to lie along the bow,
+ * since there is no compass, so leeway and current show up as true wind
+ * angle error. Below TRUE_WIND_MIN_SOG the course is noise, so the true
+ * direction is left unknown.
+ *
+ *   TWA, TWS = angle and length of (u - SOG, v)
+ *   TWD      = COG + TWA
+ *
+ * The math runs once per call in single-precision float on the FPU; the
+ * NMEA and NMEA 2000 tasks call it once per sentence.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef TRUE_WIND_H
+#define TRUE_WIND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define TRUE_WIND_TILT_MAX_DEG 45               // Roll or pitch used at most this much in the correction
+#define TRUE_WIND_MIN_SOG 25                    // 0.01 m/s (about 0.5 kn): below this COG gives no direction
+
+/**
+ * @brief Wind relative to the bow and to the ground; speeds in 0.01 m/s, angles in degrees 0..359
+ */
+typedef struct {
+    bool compensated;                           // Heel and mast motion taken off
+    bool have_true;                             // A GPS fix gave the true wind
+    int16_t awa;                                // Apparent angle from the bow, clockwise
+    uint16_t aws;
+    int16_t twa;                                // True angle from the bow
+    uint16_t tws;
+    int16_t twd;                                // True direction from north, -1 below TRUE_WIND_MIN_SOG or without COG
+} true_wind_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Current apparent and, with a fix, true wind
+ *
+ * @return bool false while wind is not running or the vane has no reading
+ */
+bool true_wind_get(true_wind_t *wind);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRUE_WIND_H
@@ -0,0 +1,243 @@
+/**
+ * @file ts_store.h
+ * @brief On-gateway time-series store: append-only day segments on flash with a block index, range queries
+ *
+ * Every record the forwarder takes off the ring is kept here as well, so
+ * the crew can look back over the last days without the uplink. Records go
+ * to one segment per UTC day, two files on the STORAGE_HISTORY_LABEL
+ * partition when the partition table has one, or else on the web server's
+ * data partition (SPIFFS or LittleFS, see storage.h):
+ *
+ *   ts<day>.dat   16-byte ts_store_record_t, appended in blocks
+ *   ts<day>.idx   one ts_store_block_t per block: min/max time, offset, count
+ *
+ * Records are buffered in RAM and appended a block at a time (at most
+ * TS_STORE_BLOCK_RECORDS, or whatever arrived in TS_STORE_FLUSH_MS), so
+ * the filesystem sees one write per block. A node's backlog lands in the
+ * segment of its own day, however late it arrives.
+ *
+ * The RAM directory keeps each segment's time span. A query opens only the
+ * segments that overlap its range, reads their (small) index, and reads
+ * only the blocks whose span overlaps; a week of one-minute data is a
+ * handful of files, not one long scan. Results are downsampled into step
+ * buckets (n, min, max, mean) and written TS_STORE_QUERY_CHUNK buckets at
+ * a time, so the JSON goes out in chunks while the next ones are read.
+ *
+ * Once the segments pass TS_STORE_MAX_BYTES on the shared partition, or
+ * the partition has less than TS_STORE_MIN_FREE_BYTES free, the oldest day
+ * is deleted. Writing a new filesystem image (OTA) clears a shared store.
+ *
+ * Fed and flushed from the forwarder task; queried from the HTTP server.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef TS_STORE_H
+#define TS_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "json_writer.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define TS_STORE_FILE_PREFIX "ts"               // Segment files are <prefix><day>.dat and .idx
+#define TS_STORE_SEGMENT_S 86400                // One segment per UTC day
+#define TS_STORE_BLOCK_RECORDS 64               // Records per appended block (1 KB)
+#define TS_STORE_PENDING 128                    // Records buffered in RAM while the filesystem is busy or not mounted
+#define TS_STORE_FLUSH_MS 300000                // A part block is written after this long
+#ifndef TS_STORE_MAX_BYTES
+#define TS_STORE_MAX_BYTES (512 * 1024)         // Segment data kept on the shared partition; the oldest day goes past this
+#endif
+#define TS_STORE_MIN_FREE_BYTES (96 * 1024)     // A nearly full filesystem slows badly; the oldest day goes below this
+#define TS_STORE_MAX_SEGMENTS 60                // Days in the directory
+#define TS_STORE_MIN_TIME_S 1577836800          // Earlier record times are a node without a clock (2020-01-01)
+#define TS_STORE_MAX_POINTS 1000                // Buckets per query; the step is raised to fit
+#define TS_STORE_DEFAULT_POINTS 200             // Buckets when the query gives no step
+#define TS_STORE_QUERY_CHUNK 48                 // Buckets filled and written per pass
+
+#define TS_STORE_PRESSURE_BASE 50000            // Pressure is stored as Pa above this (50 to 115 kPa)
+
+// Record flags: which fields hold a value
+#define TS_STORE_HAS_PRESSURE (1 << 0)
+#define TS_STORE_HAS_HUMIDITY (1 << 1)
+
+typedef enum {
+    TS_STORE_TEMPERATURE = 0,
+    TS_STORE_PRESSURE,
+    TS_STORE_HUMIDITY,
+    TS_STORE_METRICS
+} ts_store_metric_t;
+
+/**
+ * @brief One sample as stored; 16 bytes
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t time_s;                            // Unix seconds
+    uint32_t node_id;
+    int16_t temperature;                        // 0.01 degC
+    uint16_t pressure;                          // Pa above TS_STORE_PRESSURE_BASE
+    uint16_t humidity;                          // 0.01 %RH
+    uint8_t flags;                              // TS_STORE_HAS_*
+    uint8_t reserved;
+} ts_store_record_t;
+
+/**
+ * @brief Index entry: one appended block of a segment; 16 bytes
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t min_s;
+    uint32_t max_s;
+    uint32_t offset;                            // Byte offset of the block in the .dat file
+    uint16_t count;                             // Records in the block
+    uint16_t reserved;
+} ts_store_block_t;
+
+_Static_assert(sizeof(ts_store_record_t) == 16, "records are 16 bytes");
+_Static_assert(sizeof(ts_store_block_t) == 16, "index entries are 16 bytes");
+
+/**
+ * @brief Position in an export of the stored records; set up by ts_store_export_begin()
+ */
+typedef struct {
+    uint32_t from_s;
+    uint32_t to_s;
+    uint32_t day;                               // Segment being read
+    uint32_t block;                             // Index entry in it
+    uint32_t record;                            // Record in that block
+} ts_store_cursor_t;
+
+/**
+ * @brief Store state and counters since ts_store_init()
+ */
+typedef struct {
+    bool ready;                                 // Partition mounted and the directory loaded
+    uint32_t segments;
+    uint32_t bytes;                             // Segment data and index
+    uint32_t oldest_s;                          // Earliest stored sample; 0 when empty
+    uint32_t newest_s;
+    uint32_t pending;                           // Records waiting in RAM
+    uint32_t records;                           // Records written
+    uint32_t blocks;                            // Blocks appended
+    uint32_t dropped;                           // Records lost: buffer full, write failed, or older than the store
+    uint32_t no_clock;                          // Records skipped for a time before TS_STORE_MIN_TIME_S
+    uint32_t expired;                           // Segments deleted to make room
+} ts_store_info_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Allocate the buffer and lock, and mount the store's own partition if there is one
+ *
+ * Segments on the shared partition are found once the web server has mounted it.
+ *
+ * @return esp_err_t ESP_OK or ESP_ERR_NO_MEM
+ */
+esp_err_t ts_store_init(void);
+
+/**
+ * @brief Write what is buffered and free the store's memory
+ */
+void ts_store_deinit(void);
+
+/**
+ * @brief Buffer one telemetry record; forwarder task
+ */
+void ts_store_add(uint32_t node_id, const telemetry_record_t *rec);
+
+/**
+ * @brief Append a full or due block, loading the directory first if the partition has just mounted; forwarder task
+ *
+ * Never waits for a running query: the block is written on a later call.
+ */
+void ts_store_poll(void);
+
+/**
+ * @brief Milliseconds until ts_store_poll() has a block to write; UINT32_MAX when nothing is buffered
+ */
+uint32_t ts_store_poll_due_ms(void);
+
+/**
+ * @brief Copy the state and counters
+ */
+void ts_store_get_info(ts_store_info_t *info);
+
+/**
+ * @brief Metric name as used by /api/history ("temperature", "pressure", "humidity")
+ */
+const char *ts_store_metric_name(ts_store_metric_t metric);
+
+/**
+ * @brief Metric from its name
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_NOT_FOUND for an unknown name
+ */
+esp_err_t ts_store_metric_from_name(const char *name, ts_store_metric_t *metric);
+
+/**
+ * @brief True for the store's own files, which the asset cache must not pick up
+ */
+bool ts_store_owns_file(const char *name);
+
+/**
+ * @brief Downsample [from_s, to_s) of one metric into step buckets, for /api/history
+ *
+ * Writes {"metric","node","from","to","step","points":[[start,n,min,max,mean],...]}
+ * with only the buckets that hold samples. Values are in record units
+ * (0.01 degC, Pa, 0.001 %RH). The step is raised so the range is at most
+ * TS_STORE_MAX_POINTS buckets.
+ *
+ * @param w Writer, already set up for the response
+ * @param metric Which metric
+ * @param node_id One node, or 0 for all of them
+ * @param from_s Range start, Unix seconds
+ * @param to_s Range end (exclusive); must be after from_s
+ * @param step_s Bucket width; 0 for about TS_STORE_DEFAULT_POINTS buckets
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_INVALID_STATE before the store is ready, or ESP_ERR_NO_MEM
+ */
+esp_err_t ts_store_write_json(json_writer_t *w, ts_store_metric_t metric, uint32_t node_id, uint32_t from_s,
+                              uint32_t to_s, uint32_t step_s);
+
+/**
+ * @brief Start an export of the records in [from_s, to_s)
+ *
+ * Records come oldest day first and, within a day, in the order they were
+ * written; only records already on flash are exported, not the RAM buffer.
+ * The order is stable while no records are added inside the range, so a
+ * client can resume an export by position.
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG for an empty range, or ESP_ERR_INVALID_STATE before the store is ready
+ */
+esp_err_t ts_store_export_begin(ts_store_cursor_t *cur, uint32_t from_s, uint32_t to_s);
+
+/**
+ * @brief Read the next records of an export
+ *
+ * With out NULL the records are only counted and skipped: blocks wholly
+ * inside the range are passed over from the index without reading them.
+ *
+ * @param cur Cursor, advanced past what was returned
+ * @param out Records, or NULL to skip
+ * @param max How many to return or skip
+ * @return size_t How many; less than max only at the end
+ */
+size_t ts_store_export_read(ts_store_cursor_t *cur, ts_store_record_t *out, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TS_STORE_H
@@ -0,0 +1,98 @@
+/**
+ * @file ulp_monitor.h
+ * @brief ULP coprocessor ADC watch during deep sleep: buffers samples, wakes on a threshold or a full buffer
+ *
+ * Optional: needs CONFIG_ULP_COPROC_ENABLED with the FSM coprocessor and
+ * CONFIG_ULP_COPROC_RESERVE_MEM of at least ULP_MONITOR_RESERVE_BYTES.
+ * Without it every call returns ESP_ERR_NOT_SUPPORTED or does nothing.
+ *
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ULP_MONITOR_H
+#define ULP_MONITOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ULP_MONITOR_ADC_CHANNEL 0               // ADC1_CH0 (GPIO36): the METRIC_VDD33_VOLTAGE input
+#define ULP_MONITOR_PERIOD_MS 1000              // ULP wake-up period
+#define ULP_MONITOR_BUFFER_LEN 48               // Samples held in RTC slow memory before the main CPU is woken
+#define ULP_MONITOR_PROGRAM_WORDS 64            // Room reserved for the program ahead of its data
+#define ULP_MONITOR_RESERVE_BYTES ((ULP_MONITOR_PROGRAM_WORDS + 4 + ULP_MONITOR_BUFFER_LEN) * 4)
+
+/**
+ * @brief Why the ULP woke the main CPU
+ */
+typedef enum {
+    ULP_MONITOR_WAKE_NONE = 0,                  // It did not (timer or button wake)
+    ULP_MONITOR_WAKE_THRESHOLD,                 // A sample fell below low or reached high
+    ULP_MONITOR_WAKE_FULL                       // The buffer filled up
+} ulp_monitor_wake_t;
+
+/**
+ * @brief What the ULP collected since it was started or last drained
+ */
+typedef struct {
+    uint16_t count;
+    uint16_t last;                              // Raw 12-bit ADC counts at 12 dB attenuation
+    uint16_t min;
+    uint16_t max;
+    ulp_monitor_wake_t reason;
+} ulp_monitor_summary_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Load the ULP program and start it on its timer; call right before deep sleep
+ *
+ * Every ULP_MONITOR_PERIOD_MS the ULP reads the ADC into the RTC buffer.
+ * It wakes the main CPU, then stops its timer, when a sample is below
+ * low_raw or at or above high_raw, or when the buffer is full. ADC1 must
+ * be free: call system_metrics_release_adc() first.
+ *
+ * @param low_raw Wake below this raw value (0 disables)
+ * @param high_raw Wake at or above this raw value (above 4095 disables)
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_SUPPORTED without the ULP, or the ADC/ULP error
+ */
+esp_err_t ulp_monitor_start(uint16_t low_raw, uint16_t high_raw);
+
+/**
+ * @brief Stop the ULP timer so the main CPU can use ADC1 again; the buffer is kept
+ */
+void ulp_monitor_stop(void);
+
+/**
+ * @brief Whether the ULP was started before the last deep sleep and not stopped since
+ */
+bool ulp_monitor_running(void);
+
+/**
+ * @brief Copy out and clear the buffered samples; call with the ULP stopped
+ *
+ * @param samples Receives up to max raw samples, oldest first (may be NULL)
+ * @param max Capacity of samples
+ * @param summary Receives count, last, min, max and the wake reason
+ * @return size_t Samples copied
+ */
+size_t ulp_monitor_drain(uint16_t *samples, size_t max, ulp_monitor_summary_t *summary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ULP_MONITOR_H
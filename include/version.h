@@ -9,8 +9,11 @@
 #ifndef VERSION_H
 #define VERSION_H
 
+#include <stddef.h>
 #include <stdio.h>
+#ifdef ESP_PLATFORM
 #include "esp_log.h"
+#endif
 
 /**
  * @brief Structure for version information
@@ -24,15 +27,19 @@ typedef struct {
 /**
  * @brief Register a component version
  * 
- * This macro creates version information that will be visible to the linker
- * and can be accessed at runtime.
+ * This macro places the version information in the version_registry linker
+ * section (src/linker.lf), where version_registry_get() finds every
+ * registration of the firmware at runtime. scripts/version_manifest.py reads
+ * the same lines at build time for the constant manifest /get_version_info
+ * serves, so the arguments must be literals and used once per component.
  * 
  * @param component Component name (without quotes)
  * @param ver Version string (with quotes)
  * @param build_date Build date string (with quotes)
  */
 #define REGISTER_VERSION(component, ver, build_date) \
-    static const version_info_t component##_version_info __attribute__((used)) = { \
+    static const version_info_t component##_version_info \
+        __attribute__((used, section(".version_registry"), aligned(4))) = { \
         #component, ver, build_date \
     }; \
     static const char component##_version_string[] __attribute__((used)) = \
@@ -64,9 +71,6 @@ typedef struct {
 #define PROJECT_BUILD_DATE __DATE__
 #define PROJECT_BUILD_TIME __TIME__
 
-// Register project version
-REGISTER_VERSION(Project, PROJECT_VERSION, PROJECT_BUILD_DATE);
-
 // Make project version directly accessible
 static const char PROJECT_VERSION_STRING[] __attribute__((used)) = PROJECT_VERSION;
 
@@ -80,12 +84,36 @@ void print_version_info(void);
 /**
  * @brief Get comprehensive version information as formatted string
  * 
- * Returns a formatted string containing all project and component version
- * information suitable for display in web interfaces. The returned string
- * is statically allocated and should not be freed.
+ * Returns an HTML fragment with the project and every component version,
+ * built at compile time from the generated manifest (src/version_manifest.h).
+ * The string is constant and should not be freed.
  * 
+ * @param len Set to the string length if not NULL
  * @return Pointer to formatted version information string
  */
-const char* get_version_info_string(void);
+const char* get_version_info_string(size_t *len);
+
+/**
+ * @brief The same information as a JSON object, also constant
+ * 
+ * @param len Set to the string length if not NULL
+ * @return Pointer to the JSON string
+ */
+const char* get_version_info_json(size_t *len);
+
+/**
+ * @brief Number of version registrations linked into the firmware
+ * 
+ * @return Registrations in the version_registry section, the project included
+ */
+size_t version_registry_count(void);
+
+/**
+ * @brief One linked registration, in link order
+ * 
+ * @param index 0 to version_registry_count() - 1
+ * @return Registration, or NULL past the end
+ */
+const version_info_t* version_registry_get(size_t index);
 
 #endif // VERSION_H
@@ -0,0 +1,104 @@
+/**
+ * @file web_assets.h
+ * @brief Web UI assets built into the app image, served without the filesystem
+ *
+ * With WEB_EMBED_ASSETS=1 ([env:embed]) scripts/build_web_assets.py packs
+ * every staged asset, the gzip copy where there is one, into one blob that
+ * src/CMakeLists.txt embeds with EMBED_FILES, and writes the table of
+ * offsets, sizes, content types and ETags (src/web_assets_table.h). The
+ * portal then comes up from the app image alone: no data partition needs
+ * to be flashed or mounted, and a response is sent straight from
+ * flash-mapped rodata.
+ *
+ * The data partition still wins where it holds a different copy of an
+ * asset (an ETag that does not match), so a new UI can be tried with a
+ * filesystem upload without rebuilding the firmware. Files the image does
+ * not carry are served from the filesystem as before.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#ifndef WEB_EMBED_ASSETS
+#define WEB_EMBED_ASSETS 0                      // 1: serve the UI from the app image; build with -D WEB_EMBED_ASSETS=1
+#endif
+
+/**
+ * @brief One embedded asset (an entry of the generated table)
+ */
+typedef struct {
+    const char *path;                           // Asset path as in the routing table, e.g. "/index.html"
+    const char *mime_type;
+    const char *etag;                           // Quoted strong ETag, the same as the filesystem manifest's
+    uint32_t offset;                            // Into the embedded blob
+    uint32_t size;
+    bool gzip;                                  // Data is the .gz copy
+} web_asset_t;
+
+/**
+ * @brief Embedded assets and how they were served
+ */
+typedef struct {
+    uint32_t assets;
+    uint32_t bytes;                             // Blob size
+    uint32_t overridden;                        // Assets the filesystem holds a different copy of
+    uint32_t served;                            // Responses sent from the image
+} web_assets_stats_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Embedded asset for a routing-table path; NULL if the image does not carry it or embedding is off
+ *
+ * Assets the filesystem overrides are not returned.
+ */
+const web_asset_t *web_assets_find(const char *path);
+
+/**
+ * @brief The asset's bytes in flash-mapped rodata
+ */
+const uint8_t *web_assets_data(const web_asset_t *asset);
+
+/**
+ * @brief Compare the mounted filesystem's copies against the image and mark the ones that differ
+ *
+ * Call once the data partition is mounted and the asset cache has loaded
+ * its ETag manifest. Until then every embedded asset is served.
+ *
+ * @param base_path VFS mount point, SPIFFS_BASE_PATH
+ */
+void web_assets_scan_overrides(const char *base_path);
+
+/**
+ * @brief Count a response sent from the image
+ */
+void web_assets_record_served(void);
+
+/**
+ * @brief Copy the counters
+ */
+void web_assets_get_stats(web_assets_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WEB_ASSETS_H
@@ -0,0 +1,150 @@
+/**
+ * @file web_handlers.h
+ * @brief Request logic of the portal's config and OTA upload endpoints, on the portable http_io.h interface
+ *
+ * web_server.c keeps what touches the device (NVS, the OTA writer, SPIFFS,
+ * the reboot) and passes each request through http_io_init_httpd() to
+ * these functions, which do the part worth measuring and fuzzing: reading
+ * the body, parsing it (json_reader.h, multipart_reader.h), building JSON
+ * (json_writer.h) and choosing the error responses. URI routing is
+ * already portable (web_routes.h). Nothing here logs or includes an
+ * ESP-IDF component header, so the functions run unchanged against
+ * http_io_init_mem() on a workstation or in bench_suite.h.
+ *
+ * On any error the functions have sent the response; on ESP_OK the
+ * caller sends it.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef WEB_HANDLERS_H
+#define WEB_HANDLERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "config_schema.h"
+#include "http_io.h"
+#include "nvs_utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define WEB_CONFIG_MAX_BODY 16384               // Larger /save_config bodies are refused outright
+#define WEB_CONFIG_RECV_CHUNK 256               // Bytes read per parse step
+#define WEB_OTA_MAX_UPLOAD (4 * 1024 * 1024)    // Largest /api/ota upload, multipart framing included
+#define WEB_OTA_HASH_LEN 65                     // SHA-256 hex digits and terminator (OTA_HASH_STR_LEN)
+
+/**
+ * @brief A /save_config body applied onto a configuration
+ */
+typedef struct {
+    device_config_t cfg;                        // Current config on entry; the body overrides what it names
+    uint32_t fields_set;
+    uint32_t boot_count;
+    bool have_boot_count;                       // bootCount is kept outside the config (SystemMetrics)
+    esp_err_t parse_err;                        // json_reader error of a rejected body, else ESP_OK
+} web_config_body_t;
+
+/**
+ * @brief The /api/ota form fields that precede the file part
+ */
+typedef struct {
+    bool filesystem;                            // type=filesystem, else firmware
+    bool for_nodes;                             // target=nodes
+    bool zlib;                                  // encoding=zlib
+    char hash[WEB_OTA_HASH_LEN];                // From the X-Image-SHA256 header or the hash field; may be empty
+} web_ota_form_t;
+
+/**
+ * @brief Where an upload's file part goes
+ */
+typedef struct {
+    esp_err_t (*begin)(void *ctx, const web_ota_form_t *form, const char *filename);  // File part opens
+    esp_err_t (*write)(void *ctx, const uint8_t *data, size_t len);                  // Straight from the receive buffer
+    void (*abort)(void *ctx);                   // After a successful begin, when the upload fails
+} web_ota_sink_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Read and parse a /save_config body onto body->cfg
+ *
+ * Top-level members land where the schema (config_schema.h) puts them;
+ * bootCount is returned apart. A body that is not valid JSON is drained
+ * and answered 400, so the connection stays usable.
+ *
+ * @param io Request
+ * @param body Holds the current config on entry
+ * @return esp_err_t ESP_OK with body filled; ESP_ERR_INVALID_ARG for a body that is
+ *         not valid JSON (parse_err says why), ESP_ERR_INVALID_SIZE (empty or too large),
+ *         ESP_ERR_TIMEOUT or ESP_FAIL (receive), each answered
+ */
+esp_err_t web_config_receive(http_io_t *io, web_config_body_t *body);
+
+/**
+ * @brief Answer /get_config: the config as JSON, with the boot count; headers only for HEAD
+ */
+esp_err_t web_config_send(http_io_t *io, const device_config_t *cfg, uint32_t boot_count);
+
+/**
+ * @brief Answer /api/config/export: the config as one blob (config_schema_export_blob())
+ *
+ * @param unit Include the per-unit fields, for a backup of this board rather than a fleet template
+ * @param buf Blob buffer, CONFIG_SCHEMA_BLOB_MAX bytes
+ */
+esp_err_t web_config_export(http_io_t *io, const device_config_t *cfg, bool unit, uint8_t *buf);
+
+/**
+ * @brief Read an /api/config/import body and apply the blob onto cfg
+ *
+ * The body must be one blob of at most CONFIG_SCHEMA_BLOB_MAX bytes; a
+ * damaged or foreign one is answered 400 and cfg is left as it was.
+ *
+ * @param io Request
+ * @param cfg Current config on entry, the imported one on ESP_OK
+ * @param buf Receive buffer, CONFIG_SCHEMA_BLOB_MAX bytes
+ * @param result Receives config_schema_import_blob()'s counts
+ * @return esp_err_t ESP_OK with cfg updated; ESP_ERR_INVALID_SIZE (empty or too large), the
+ *         config_schema_import_blob() error, ESP_ERR_TIMEOUT or ESP_FAIL (receive), each answered
+ */
+esp_err_t web_config_import(http_io_t *io, device_config_t *cfg, uint8_t *buf, config_import_result_t *result);
+
+/**
+ * @brief True for exactly 64 hex digits, as an image hash must be
+ */
+bool web_ota_hash_valid(const char *hash);
+
+/**
+ * @brief Stream a multipart /api/ota upload into sink
+ *
+ * The form fields are collected into form; the file part is checked
+ * against them, then handed to sink->begin() and, in receive-buffer
+ * pieces, to sink->write(). Extra file parts are ignored.
+ *
+ * @param io Request
+ * @param sink File destination
+ * @param ctx Passed to the sink
+ * @param buf Receive buffer, e.g. OTA_CHUNK_SIZE bytes
+ * @param buf_len Its size
+ * @param form Receives the form fields
+ * @return esp_err_t ESP_OK with the whole file written; otherwise the error, answered, and sink->abort() called if begun
+ */
+esp_err_t web_ota_receive(http_io_t *io, const web_ota_sink_t *sink, void *ctx, uint8_t *buf, size_t buf_len,
+                          web_ota_form_t *form);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WEB_HANDLERS_H
@@ -0,0 +1,68 @@
+/**
+ * @file web_routes.h
+ * @brief Constant-time URI routing for the web UI assets and captive-portal probes
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef WEB_ROUTES_H
+#define WEB_ROUTES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define WEB_ROUTES_MAX 24                       // Routes the generated table may hold; each becomes a portal handler
+
+/**
+ * @brief How a routed URI is answered
+ */
+typedef enum {
+    WEB_ROUTE_ASSET,                            // Serve the file at path from SPIFFS or the asset cache
+    WEB_ROUTE_PROBE_NO_CONTENT,                 // Connectivity check that expects 204 No Content
+    WEB_ROUTE_PROBE_REDIRECT                    // Connectivity check that should be sent to the portal
+} web_route_kind_t;
+
+/**
+ * @brief One entry of the generated routing table (src/web_routes_table.h)
+ */
+typedef struct {
+    const char *uri;                            // Request path, without query string
+    const char *path;                           // Asset path relative to the mount point, NULL for probes
+    const char *mime_type;                      // Content type of the asset, NULL for probes
+    web_route_kind_t kind;
+} web_route_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Resolve a request URI with one hash and one string compare
+ *
+ * @param uri Request URI; anything from '?' on is ignored
+ * @return Matching route, or NULL if the URI is not known
+ */
+const web_route_t *web_route_find(const char *uri);
+
+/**
+ * @brief Access the full routing table, e.g. to register handlers
+ *
+ * @param count Receives the number of routes
+ * @return First route of the table
+ */
+const web_route_t *web_routes_get(size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WEB_ROUTES_H
@@ -11,8 +11,11 @@
 #define WEB_SERVER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
+#include "task_plan.h"
 #include "esp_http_server.h"
+#include "web_routes.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,6 +26,41 @@ extern "C" {
 // =============================
 #define WEB_SERVER_PORT 80
 #define SPIFFS_BASE_PATH "/data"
+#define WEB_ASSET_MAX_AGE_STR "86400"   // Cache-Control max-age (seconds) for assets other than HTML, CSS and JS
+#define WEB_SERVER_SPIFFS_WAIT_MS 5000          // Asset requests wait this long for the mount, then get 503
+
+// "Portal" server profile: sized for a phone loading the page while its OS
+// fires connectivity probes in parallel. Sockets must fit in
+// CONFIG_LWIP_MAX_SOCKETS alongside httpd's 3 internal sockets and the DNS server.
+#ifndef WEB_SERVER_PORTAL_MAX_SOCKETS
+#define WEB_SERVER_PORTAL_MAX_SOCKETS 10
+#endif
+#ifndef WEB_SERVER_PORTAL_BACKLOG
+#define WEB_SERVER_PORTAL_BACKLOG 8             // Pending accepts queued by lwIP
+#endif
+#define WEB_SERVER_PORTAL_KEEPALIVE_IDLE 5      // Seconds idle before the first probe
+#define WEB_SERVER_PORTAL_KEEPALIVE_INTERVAL 5  // Seconds between probes
+#define WEB_SERVER_PORTAL_KEEPALIVE_COUNT 3     // Unanswered probes before the socket dies
+#define WEB_SERVER_PORTAL_MIN_FREE_HEAP 16384   // Refuse new sessions below this much free heap
+
+// URI handlers: one per route (assets and probes), then web_server.c's API,
+// the history export, the metrics stream and Signal K (37 of them today).
+// http_perf sizes its slots from the same total.
+#define WEB_SERVER_PORTAL_API_HANDLERS 44
+#define WEB_SERVER_PORTAL_MAX_HANDLERS (WEB_ROUTES_MAX + WEB_SERVER_PORTAL_API_HANDLERS)
+
+/**
+ * @brief Connection counters for the running server (reset on each start)
+ */
+typedef struct {
+    uint32_t accepted;                          // Sessions opened
+    uint32_t closed;                            // Sessions closed, for any reason
+    uint32_t purged;                            // Live sessions evicted to make room for a new one
+    uint32_t refused;                           // Sessions rejected in the open callback
+    uint32_t active;                            // Sessions open right now
+    uint32_t peak_active;                       // Highest concurrent sessions since start
+    uint16_t max_sockets;                       // Session limit of the active profile
+} web_server_conn_stats_t;
 
 // =============================
 // Function Prototypes
@@ -54,12 +92,24 @@ esp_err_t web_server_stop(void);
  */
 bool web_server_is_running(void);
 
+/**
+ * @brief Snapshot the server's connection counters
+ *
+ * Also served as JSON from /api/server_stats.
+ *
+ * @param stats Receives the counters
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t web_server_get_conn_stats(web_server_conn_stats_t *stats);
+
 /**
  * @brief Initialize SPIFFS file system
  *
- * Mounts SPIFFS partition for serving web files
+ * Starts a low-priority task that mounts the SPIFFS partition (formatting
+ * it if the mount fails) and loads the asset cache, and returns at once.
+ * Static asset requests and OTA uploads wait for the mount to finish.
  *
- * @return esp_err_t ESP_OK on success, error code otherwise
+ * @return esp_err_t ESP_OK once the mount is under way, error code if it had to run inline and failed
  */
 esp_err_t web_server_init_spiffs(void);
 
@@ -11,6 +11,7 @@
 #define WIFI_AP_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -25,20 +26,133 @@ extern "C" {
 #define AP_CHANNEL 1
 #define AP_MAX_CONNECTIONS 4
 
+// Bridge uplink (STA side of APSTA mode)
+#define STA_BACKOFF_MIN_MS 500                  // First retry delay after a failed attempt
+#define STA_BACKOFF_MAX_MS 60000                // Retry delay cap; doubles from the minimum
+#define STA_RSSI_THRESHOLD -85                  // Weaker APs are ignored by the full scan
+
+// Radio profiles (wifi_set_profile()): AP beacons, DTIM, idle station kick and uplink modem sleep
+#define WIFI_FAST_BEACON_TU 100                 // portal-fast: the usual 102.4 ms, so phones find the AP at once
+#define WIFI_FAST_DTIM 1
+#define WIFI_FAST_INACTIVE_S 300                // Station silent this long is disassociated (the IDF default)
+#define WIFI_FAST_LISTEN_INTERVAL 3             // Uplink beacons per wake under modem sleep (unused: awake)
+#define WIFI_LOW_BEACON_TU 300                  // low-power: a third of the beacons to send
+#define WIFI_LOW_DTIM 3                         // Associated clients wake for every third beacon
+#define WIFI_LOW_INACTIVE_S 60                  // Idle clients go sooner, so the portal can idle out (main.c)
+#define WIFI_LOW_MAX_CONNECTIONS 2
+#define WIFI_LOW_LISTEN_INTERVAL 10             // Uplink wakes for every tenth beacon of the bridge AP
+
+/**
+ * @brief Radio tuning for the AP and the bridge uplink
+ */
+typedef enum {
+    WIFI_PROFILE_PORTAL_FAST = 0,               // Quick association, radio always listening
+    WIFI_PROFILE_LOW_POWER,                     // Fewer beacons, higher DTIM, modem sleep on a station-only uplink
+} wifi_profile_t;
+
+#ifndef WIFI_AP_PROFILE
+#define WIFI_AP_PROFILE WIFI_PROFILE_PORTAL_FAST  // Config mode AP; someone is waiting at the portal
+#endif
+
+/**
+ * @brief Bridge uplink connection state
+ */
+typedef enum {
+    WIFI_STA_DISABLED,                          // No bridge SSID configured: AP only
+    WIFI_STA_CONNECTING,                        // Association or DHCP in progress
+    WIFI_STA_CONNECTED,                         // Got an IP; DNS forwards upstream
+    WIFI_STA_BACKOFF                            // Waiting to retry after a failure
+} wifi_sta_state_t;
+
+/**
+ * @brief Bridge uplink status
+ */
+typedef struct {
+    wifi_sta_state_t state;
+    bool fast_connect;                          // Current or last attempt used the cached BSSID/channel
+    uint8_t channel;                            // Uplink channel; the AP follows it
+    uint32_t ip;                                // STA address, network byte order; 0 unless connected
+    uint32_t connect_ms;                        // Time from attempt start to IP for the last connection
+    uint32_t attempts;                          // Connection attempts since boot
+    uint32_t disconnects;                       // Times the uplink dropped or an attempt failed
+    uint8_t last_reason;                        // wifi_err_reason_t of the last disconnect
+    uint32_t retry_in_ms;                       // Backoff delay in WIFI_STA_BACKOFF
+} wifi_sta_status_t;
+
 // =============================
 // Function Prototypes
 // =============================
 
+/**
+ * @brief Pick the radio profile for the next wifi_ap_init() or wifi_sta_init()
+ *
+ * portal-fast beacons every WIFI_FAST_BEACON_TU with DTIM 1, lets up to
+ * AP_MAX_CONNECTIONS stations in and keeps the uplink's modem awake.
+ * low-power beacons every WIFI_LOW_BEACON_TU with DTIM WIFI_LOW_DTIM,
+ * takes WIFI_LOW_MAX_CONNECTIONS stations and disassociates idle ones
+ * sooner, and puts a station-only uplink into modem sleep, waking every
+ * WIFI_LOW_LISTEN_INTERVAL beacons. An AP cannot sleep, so in APSTA mode
+ * the uplink stays awake whatever the profile. Modem sleep also misses
+ * ESP-NOW frames sent while the modem is off, so a gateway only takes it
+ * with GATEWAY_WIFI_LOW_POWER (gateway.h).
+ *
+ * On a running radio the idle timeout and modem sleep change at once;
+ * beacons and DTIM wait for the next wifi_ap_init().
+ */
+void wifi_set_profile(wifi_profile_t profile);
+
+/**
+ * @brief Profile name for logs: "portal-fast" or "low-power"
+ */
+const char *wifi_profile_name(wifi_profile_t profile);
+
 /**
  * @brief Initialize WiFi Access Point
  *
  * Sets up ESP32 as an Access Point with configurable password from NVS
  * IP: 192.168.4.1, Gateway: 192.168.4.1, Netmask: 255.255.255.0
  *
+ * When a bridge SSID is configured the radio runs in APSTA mode and the
+ * station joins it as the uplink. The first attempt goes straight to the
+ * BSSID and channel cached in NVS from the last connection; if that fails
+ * a full scan follows, and further failures back off exponentially from
+ * STA_BACKOFF_MIN_MS to STA_BACKOFF_MAX_MS. The AP starts on the cached
+ * channel so AP clients are not dropped when the station moves the radio.
+ * With the uplink up, the DNS server forwards to the DHCP-supplied
+ * resolver and AP traffic is NATed out through the station.
+ *
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
 esp_err_t wifi_ap_init(void);
 
+/**
+ * @brief Join the bridge uplink without starting the Access Point
+ *
+ * Station-only variant of wifi_ap_init() for the gateway's normal
+ * operation: same fast-connect and backoff behaviour, but no AP, DNS
+ * forwarding or NAT. Stop it with wifi_ap_stop().
+ *
+ * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_STATE if no bridge SSID is configured
+ */
+esp_err_t wifi_sta_init(void);
+
+/**
+ * @brief Start the radio in station mode on a fixed channel, without joining anything
+ *
+ * For ESP-NOW on a node. Does nothing if wifi_ap_init() or wifi_sta_init()
+ * already started the radio; ESP-NOW then uses whatever channel that picked.
+ * Stop it with wifi_ap_stop().
+ *
+ * Brings up only the driver: no TCP/IP stack or netif, and no read of the
+ * driver's saved config. The PHY calibration IDF keeps in NVS
+ * (CONFIG_ESP_PHY_CALIBRATION_AND_DATA_STORAGE) is reused, so a deep-sleep
+ * wake starts the radio without calibrating it again.
+ *
+ * @param channel WiFi channel, 1..13; must match the gateway's
+ * @return esp_err_t ESP_OK on success, error code otherwise
+ */
+esp_err_t wifi_espnow_init(uint8_t channel);
+
 /**
  * @brief Get current AP status
  *
@@ -49,10 +163,32 @@ bool wifi_ap_is_running(void);
 /**
  * @brief Stop WiFi Access Point
  *
+ * Stops and deinitializes the radio and destroys the netifs, so
+ * wifi_ap_init() can bring it all up again.
+ *
  * @return esp_err_t ESP_OK on success, error code otherwise
  */
 esp_err_t wifi_ap_stop(void);
 
+/**
+ * @brief Stations associated to the AP; 0 while it is down
+ */
+uint8_t wifi_ap_station_count(void);
+
+/**
+ * @brief Get the bridge uplink status
+ *
+ * @param status Filled in
+ */
+void wifi_ap_get_sta_status(wifi_sta_status_t *status);
+
+/**
+ * @brief Check if the bridge uplink has an IP address
+ *
+ * @return true if connected, false otherwise
+ */
+bool wifi_ap_sta_is_connected(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,120 @@
+/**
+ * @file wind.h
+ * @brief Anemometer pulse counting on the PCNT peripheral, wind vane on ADC1, gust and sliding averages
+ *
+ * The cup anemometer closes a reed switch once per revolution. The PCNT
+ * unit counts those closures in hardware, with its glitch filter on, so
+ * there is no interrupt per pulse at any wind speed. An esp_timer reads
+ * the counter every WIND_TICK_MS and updates fixed-size ring buffers in
+ * O(1):
+ *
+ *   3 s      sliding sum of the last 3 s of ticks: the WMO gust averaging time
+ *   gust     the highest 3 s average over the last 10 min (monotonic deque,
+ *            amortised O(1) per second)
+ *   2 / 10 min   sliding sums of per-second counts: mean speed
+ *   direction    sliding sums of the vane's unit vector over the same windows,
+ *                since angles cannot be averaged directly (350 and 10 degrees)
+ *
+ * The vane is read once per second. When its channel is in the ADC stream
+ * (adc_stream.h) that is the mean of the latest DMA frame; otherwise it
+ * takes WIND_VANE_OVERSAMPLE oneshot conversions on SystemMetrics' ADC1
+ * unit, because ESP32 ADC2 is unavailable while WiFi runs. Direction is relative to the bow (apparent wind) once
+ * WIND_VANE_OFFSET_DEG holds the vane's mounting offset.
+ *
+ * The C3 has no PCNT: there a GPIO interrupt counts the closures, with
+ * WIND_EDGE_LOCKOUT_US of bounce rejection in place of the glitch filter.
+ * Even a gale is well under a hundred pulses a second.
+ *
+ * PCNT stops counting in light sleep, so a light-sleep lock is held while
+ * wind runs. The node starts it only when it stays awake
+ * (NODE_DEEP_SLEEP_PERIOD_S 0).
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef WIND_H
+#define WIND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#if CONFIG_IDF_TARGET_ESP32C3
+#define WIND_ANEMOMETER_GPIO 5                  // Reed switch to GND; internal pull-up
+#define WIND_VANE_ADC_CHANNEL 3                 // ADC1_CH3 (GPIO3): vane potentiometer wiper
+#elif CONFIG_IDF_TARGET_ESP32S3
+#define WIND_ANEMOMETER_GPIO 5                  // Reed switch to GND; internal pull-up
+#define WIND_VANE_ADC_CHANNEL 5                 // ADC1_CH5 (GPIO6): vane potentiometer wiper
+#else
+#define WIND_ANEMOMETER_GPIO 27                 // Reed switch to GND; internal pull-up
+#define WIND_VANE_ADC_CHANNEL 6                 // ADC1_CH6 (GPIO34): vane potentiometer wiper
+#endif
+#define WIND_EDGE_LOCKOUT_US 2000               // Without PCNT (C3): edges this soon after a pulse are bounce
+#define WIND_PCNT_GLITCH_NS 10000               // Hardware filter; reed bounce longer than this needs an RC
+#define WIND_PCNT_HIGH_LIMIT 10000              // Counter wraps here; the driver accumulates across it
+#define WIND_MPS_PER_HZ_X1000 667               // m/s per pulse per second, x1000 (2.4 km/h per Hz cups)
+#define WIND_VANE_OVERSAMPLE 16                 // Oneshot conversions averaged per vane reading, without the ADC stream
+#define WIND_VANE_OFFSET_DEG 0                  // Added to the vane angle: its zero relative to the bow
+#define WIND_TICK_MS 250                        // Counter read period
+#define WIND_GUST_S 3                           // Gust averaging time
+#define WIND_SHORT_AVG_S 120                    // 2 min mean
+#define WIND_LONG_AVG_S 600                     // 10 min mean, and the gust window
+
+/**
+ * @brief Wind figures; speeds in 0.01 m/s, directions in degrees 0..359 (-1 until the vane has a reading)
+ */
+typedef struct {
+    bool running;
+    uint32_t pulses;                            // Since wind_start()
+    uint16_t speed_3s;                          // Mean over the last WIND_GUST_S
+    uint16_t gust;                              // Highest WIND_GUST_S mean in the last WIND_LONG_AVG_S
+    uint16_t avg_2min;
+    uint16_t avg_10min;
+    int16_t dir_now;                            // Last vane reading
+    int16_t dir_2min;
+    int16_t dir_10min;
+    uint16_t window_s;                          // Seconds of data behind the averages, up to WIND_LONG_AVG_S
+} wind_reading_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Set up the PCNT unit and the vane channel and start the counter timer
+ *
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE if already running, or the PCNT/ADC/timer error
+ */
+esp_err_t wind_start(void);
+
+/**
+ * @brief Copy the current figures
+ */
+void wind_get(wind_reading_t *reading);
+
+/**
+ * @brief Log the current figures
+ */
+void wind_log(void);
+
+/**
+ * @brief Stop the timer, release the PCNT unit and the light-sleep lock
+ */
+void wind_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WIND_H
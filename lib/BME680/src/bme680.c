@@ -0,0 +1,500 @@
+/**
+ * @file bme680.c
+ * @brief Bosch BME680 temperature/pressure/humidity driver (I2C, forced mode)
+ *
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ * @copyright Copyright (c) 2026 John Devine
+ */
+
+// =============================
+// Includes
+// =============================
+#include "bme680.h"
+#include "../../../include/version.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_rom_sys.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+static const char *TAG = "BME680";
+
+// Register bme680.c version
+REGISTER_VERSION(BME680, "1.0.0", "2026-10-14");
+
+// Registers (datasheet section 5.2)
+#define REG_RES_HEAT_VAL 0x00
+#define REG_RES_HEAT_RANGE 0x02
+#define REG_RANGE_SW_ERR 0x04
+#define REG_MEAS_STATUS 0x1D                    // Start of the field 0 data block
+#define REG_RES_HEAT_0 0x5A
+#define REG_GAS_WAIT_0 0x64
+#define REG_CTRL_GAS_0 0x70
+#define REG_CTRL_GAS_1 0x71
+#define REG_CTRL_HUM 0x72
+#define REG_CTRL_MEAS 0x74
+#define REG_CONFIG 0x75
+#define REG_COEFF1 0x89
+#define REG_CHIP_ID 0xD0
+#define REG_COEFF2 0xE1
+
+#define COEFF1_LEN 25                           // 0x89..0xA1
+#define COEFF2_LEN 16                           // 0xE1..0xF0
+#define HEAT_CAL_LEN 5                          // 0x00..0x04: res_heat_val, res_heat_range, range_sw_err
+#define DATA_LEN 10                             // 0x1D status .. 0x26 hum_lsb: T, P and H in one read
+#define DATA_LEN_GAS 15                         // .. 0x2B gas_r_lsb when the heater runs
+
+#define STATUS_NEW_DATA (1 << 7)
+#define CTRL_GAS_0_HEAT_OFF (1 << 3)
+#define CTRL_GAS_1_RUN_GAS (1 << 4)
+#define MODE_FORCED 0x01
+#define GAS_VALID (1 << 5)                      // In gas_r_lsb
+#define GAS_HEAT_STABLE (1 << 4)
+#define GAS_RANGE_MASK 0x0F
+
+#define CYCLE_US 1963                           // One oversampling cycle
+#define TPH_SWITCH_US (477 * 4)
+#define GAS_MEAS_US (477 * 5)                   // Spent even with the heater off
+#define WAKEUP_US 1000
+#define POLL_INTERVAL_US 250                    // Status polls after the expected duration
+#define POLL_MAX 40
+#define HEATER_AMBIENT_DRIFT 500                // Recompute res_heat_x after 5 degC of drift
+#define HEATER_DEFAULT_AMBIENT 2500             // Assumed until the first sample
+#define LIGHT_SLEEP_MIN_US 20000                // Shorter waits are not worth the sleep entry and exit
+
+// Kept across deep sleep; RTC_DATA_ATTR is reloaded from the image (zeroed) on every other kind of boot
+#define CALIB_CACHE_MAGIC 0xB680CA1Bu
+typedef struct {
+    uint32_t magic;
+    uint8_t address;
+    bme680_calib_t calib;
+    uint32_t crc;
+} bme680_calib_cache_t;
+
+static RTC_DATA_ATTR bme680_calib_cache_t calib_cache;
+
+// Where the heater profile continues after deep sleep (one sensor per node)
+static RTC_DATA_ATTR uint8_t heater_next_step;
+
+// Conversion cycles per oversampling setting, and the T, P and H conversion time they add up to
+#define OS_CYCLES(os) ((os) == BME680_OS_NONE ? 0u : 1u << ((os) - 1))
+#define TPH_DURATION_US(t, p, h) \
+    ((OS_CYCLES(t) + OS_CYCLES(p) + OS_CYCLES(h)) * CYCLE_US + TPH_SWITCH_US + GAS_MEAS_US + WAKEUP_US)
+
+#define PROFILE(n, t, p, h, f, nt, np, nh, steps) \
+    { .name = (n), .os_temperature = (t), .os_pressure = (p), .os_humidity = (h), .filter = (f), \
+      .duration_us = TPH_DURATION_US(t, p, h), .noise_temperature = (nt), .noise_pressure = (np), \
+      .noise_humidity = (nh), .step_samples = (steps) }
+
+// IIR 1 halves a step each sample and cuts the noise by sqrt(3)
+static const bme680_profile_info_t profiles[BME680_PROFILE_COUNT] = {
+    [BME680_PROFILE_LOW_POWER] = PROFILE("low-power", BME680_OS_1X, BME680_OS_1X, BME680_OS_1X,
+                                         BME680_FILTER_OFF, 5, 330, 20, 1),
+    [BME680_PROFILE_BALANCED] = PROFILE("balanced", BME680_OS_2X, BME680_OS_4X, BME680_OS_1X,
+                                        BME680_FILTER_OFF, 3, 210, 20, 1),
+    [BME680_PROFILE_HIGH_PRECISION] = PROFILE("high-precision", BME680_OS_2X, BME680_OS_16X, BME680_OS_2X,
+                                              BME680_FILTER_1, 2, 70, 14, 4),
+};
+
+// =============================
+// Function Prototypes
+// =============================
+static bool attached(const bme680_t *sensor);
+static esp_err_t transfer(bme680_t *sensor, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len);
+static esp_err_t read_regs(bme680_t *sensor, uint8_t reg, uint8_t *buf, size_t len);
+static esp_err_t write_reg(bme680_t *sensor, uint8_t reg, uint8_t value);
+static esp_err_t read_calibration(bme680_t *sensor);
+static bool load_cached_calibration(bme680_t *sensor);
+static void store_cached_calibration(const bme680_t *sensor);
+static esp_err_t program_heater(bme680_t *sensor);
+static void wait_for_conversion(const bme680_t *sensor, uint32_t duration_us);
+
+// =============================
+// Function Definitions
+// =============================
+
+static bool attached(const bme680_t *sensor) {
+    return sensor->dev != NULL || sensor->config.transfer != NULL;
+}
+
+/**
+ * @brief One transaction, through the caller's transfer function when there is one
+ */
+static esp_err_t transfer(bme680_t *sensor, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len) {
+    if (sensor->config.transfer != NULL) {
+        return sensor->config.transfer(sensor->config.transfer_ctx, tx, tx_len, rx, rx_len);
+    }
+    if (rx_len == 0) {
+        return i2c_master_transmit(sensor->dev, tx, tx_len, BME680_I2C_TIMEOUT_MS);
+    }
+    return i2c_master_transmit_receive(sensor->dev, tx, tx_len, rx, rx_len, BME680_I2C_TIMEOUT_MS);
+}
+
+static esp_err_t read_regs(bme680_t *sensor, uint8_t reg, uint8_t *buf, size_t len) {
+    return transfer(sensor, &reg, 1, buf, len);
+}
+
+static esp_err_t write_reg(bme680_t *sensor, uint8_t reg, uint8_t value) {
+    uint8_t buf[2] = { reg, value };
+    return transfer(sensor, buf, sizeof(buf), NULL, 0);
+}
+
+/**
+ * @brief Read the coefficient blocks and heater trim and unpack them (datasheet table 13)
+ */
+static esp_err_t read_calibration(bme680_t *sensor) {
+    uint8_t b[COEFF1_LEN + COEFF2_LEN];
+    uint8_t heat[HEAT_CAL_LEN];
+    esp_err_t err = read_regs(sensor, REG_COEFF1, b, COEFF1_LEN);
+    if (err == ESP_OK) {
+        err = read_regs(sensor, REG_COEFF2, b + COEFF1_LEN, COEFF2_LEN);
+    }
+    if (err == ESP_OK) {
+        err = read_regs(sensor, REG_RES_HEAT_VAL, heat, HEAT_CAL_LEN);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    bme680_calib_t *c = &sensor->calib;
+    c->par_t2 = (int16_t)(b[2] << 8 | b[1]);
+    c->par_t3 = (int8_t)b[3];
+    c->par_p1 = (uint16_t)(b[6] << 8 | b[5]);
+    c->par_p2 = (int16_t)(b[8] << 8 | b[7]);
+    c->par_p3 = (int8_t)b[9];
+    c->par_p4 = (int16_t)(b[12] << 8 | b[11]);
+    c->par_p5 = (int16_t)(b[14] << 8 | b[13]);
+    c->par_p7 = (int8_t)b[15];
+    c->par_p6 = (int8_t)b[16];
+    c->par_p8 = (int16_t)(b[20] << 8 | b[19]);
+    c->par_p9 = (int16_t)(b[22] << 8 | b[21]);
+    c->par_p10 = b[23];
+    // H1 and H2 share the nibbles of 0xE2
+    c->par_h2 = (uint16_t)(b[25] << 4 | b[26] >> 4);
+    c->par_h1 = (uint16_t)(b[27] << 4 | (b[26] & 0x0F));
+    c->par_h3 = (int8_t)b[28];
+    c->par_h4 = (int8_t)b[29];
+    c->par_h5 = (int8_t)b[30];
+    c->par_h6 = b[31];
+    c->par_h7 = (int8_t)b[32];
+    c->par_t1 = (uint16_t)(b[34] << 8 | b[33]);
+    c->par_g2 = (int16_t)(b[36] << 8 | b[35]);
+    c->par_g1 = (int8_t)b[37];
+    c->par_g3 = (int8_t)b[38];
+    c->res_heat_val = (int8_t)heat[REG_RES_HEAT_VAL];
+    c->res_heat_range = (heat[REG_RES_HEAT_RANGE] & 0x30) >> 4;
+    c->range_sw_err = (int8_t)(heat[REG_RANGE_SW_ERR] & 0xF0) / 16;
+    return ESP_OK;
+}
+
+/**
+ * @brief Take the coefficients from RTC memory if they are for this sensor and intact
+ */
+static bool load_cached_calibration(bme680_t *sensor) {
+    if (calib_cache.magic != CALIB_CACHE_MAGIC || calib_cache.address != sensor->config.address) {
+        return false;
+    }
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&calib_cache.calib, sizeof(calib_cache.calib));
+    if (crc != calib_cache.crc) {
+        return false;
+    }
+    sensor->calib = calib_cache.calib;
+    return true;
+}
+
+static void store_cached_calibration(const bme680_t *sensor) {
+    calib_cache.calib = sensor->calib;
+    calib_cache.address = sensor->config.address;
+    calib_cache.crc = esp_rom_crc32_le(0, (const uint8_t *)&calib_cache.calib, sizeof(calib_cache.calib));
+    calib_cache.magic = CALIB_CACHE_MAGIC;
+}
+
+/**
+ * @brief Write every step's res_heat_x and gas_wait_x as register/value pairs in one transaction
+ */
+static esp_err_t program_heater(bme680_t *sensor) {
+    uint8_t buf[BME680_HEATER_MAX_STEPS * 4];
+    size_t len = 0;
+    for (uint8_t i = 0; i < sensor->heater_count; i++) {
+        buf[len++] = REG_RES_HEAT_0 + i;
+        buf[len++] = bme680_heater_resistance(&sensor->calib, sensor->ambient, sensor->heater[i].temperature_c);
+        buf[len++] = REG_GAS_WAIT_0 + i;
+        buf[len++] = bme680_heater_wait(sensor->heater[i].duration_ms);
+    }
+    esp_err_t err = transfer(sensor, buf, len, NULL, 0);
+    if (err == ESP_OK) {
+        sensor->heater_ambient = sensor->ambient;
+    }
+    return err;
+}
+
+/**
+ * @brief Sleep through a conversion: light sleep when enabled and worth it, otherwise a task delay
+ *
+ * Only whole ticks are slept; the caller polls the status for the remainder.
+ */
+static void wait_for_conversion(const bme680_t *sensor, uint32_t duration_us) {
+    int64_t deadline = esp_timer_get_time() + duration_us;
+    if (sensor->config.light_sleep && duration_us >= LIGHT_SLEEP_MIN_US) {
+        esp_sleep_enable_timer_wakeup(duration_us);
+        esp_light_sleep_start();
+        esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+    }
+
+    // Also covers an early wake from another source
+    int64_t remaining = deadline - esp_timer_get_time();
+    TickType_t ticks = remaining > 0 ? pdMS_TO_TICKS((uint32_t)(remaining / 1000)) : 0;
+    if (ticks > 0) {
+        vTaskDelay(ticks);
+    }
+}
+
+esp_err_t bme680_init(bme680_t *sensor, const bme680_config_t *config) {
+    if (sensor == NULL || config == NULL || (config->bus == NULL && config->transfer == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->config = *config;
+    sensor->ambient = HEATER_DEFAULT_AMBIENT;
+
+    esp_err_t err = ESP_OK;
+    if (config->transfer == NULL) {
+        i2c_device_config_t dev_cfg = {
+            .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+            .device_address = config->address,
+            .scl_speed_hz = BME680_I2C_SPEED_HZ,
+        };
+        err = i2c_master_bus_add_device(config->bus, &dev_cfg, &sensor->dev);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to add device 0x%02x: %s", config->address, esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    uint8_t chip_id = 0;
+    err = read_regs(sensor, REG_CHIP_ID, &chip_id, 1);
+    if (err == ESP_OK && chip_id != BME680_CHIP_ID) {
+        ESP_LOGE(TAG, "Unexpected chip ID 0x%02x at 0x%02x", chip_id, config->address);
+        err = ESP_ERR_NOT_FOUND;
+    }
+
+    bool cached = err == ESP_OK && load_cached_calibration(sensor);
+    if (err == ESP_OK && !cached) {
+        err = read_calibration(sensor);
+        if (err == ESP_OK) {
+            store_cached_calibration(sensor);
+        }
+    }
+
+    // Heater off and no gas conversion until a profile is set: only T, P and H are sampled
+    sensor->ctrl_meas = (uint8_t)(config->os_temperature << 5 | config->os_pressure << 2);
+    if (err == ESP_OK) {
+        err = write_reg(sensor, REG_CTRL_GAS_0, CTRL_GAS_0_HEAT_OFF);
+    }
+    if (err == ESP_OK) {
+        err = write_reg(sensor, REG_CTRL_GAS_1, 0);
+    }
+    if (err == ESP_OK) {
+        err = write_reg(sensor, REG_CTRL_HUM, (uint8_t)config->os_humidity);
+    }
+    if (err == ESP_OK) {
+        err = write_reg(sensor, REG_CONFIG, (uint8_t)(config->filter << 2));
+    }
+    if (err == ESP_OK) {
+        err = write_reg(sensor, REG_CTRL_MEAS, sensor->ctrl_meas);  // Latches ctrl_hum
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Sensor setup failed: %s", esp_err_to_name(err));
+        bme680_deinit(sensor);
+        return err;
+    }
+
+    sensor->meas_duration_us = TPH_DURATION_US(config->os_temperature, config->os_pressure, config->os_humidity);
+    ESP_LOGI(TAG, "BME680 at 0x%02x ready (calibration %s, %lu us per sample)", config->address,
+             cached ? "from RTC memory" : "read from sensor", (unsigned long)sensor->meas_duration_us);
+    return ESP_OK;
+}
+
+esp_err_t bme680_trigger(bme680_t *sensor, uint32_t *duration_us) {
+    if (sensor == NULL || !attached(sensor)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool gas = sensor->heater_count > 0;
+    uint8_t step = gas ? heater_next_step % sensor->heater_count : 0;
+    esp_err_t err = ESP_OK;
+    if (gas && abs(sensor->ambient - sensor->heater_ambient) >= HEATER_AMBIENT_DRIFT) {
+        err = program_heater(sensor);
+    }
+
+    // Step select and trigger go out together; the sensor heats right after T, P and H
+    uint8_t tx[4];
+    size_t tx_len = 0;
+    if (gas) {
+        tx[tx_len++] = REG_CTRL_GAS_1;
+        tx[tx_len++] = CTRL_GAS_1_RUN_GAS | step;
+    }
+    tx[tx_len++] = REG_CTRL_MEAS;
+    tx[tx_len++] = sensor->ctrl_meas | MODE_FORCED;
+    if (err == ESP_OK) {
+        err = transfer(sensor, tx, tx_len, NULL, 0);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    sensor->triggered = true;
+    sensor->triggered_gas = gas;
+    sensor->triggered_step = step;
+    if (duration_us != NULL) {
+        *duration_us = sensor->meas_duration_us + (gas ? sensor->heater[step].duration_ms * 1000u : 0);
+    }
+    return ESP_OK;
+}
+
+esp_err_t bme680_fetch(bme680_t *sensor, bme680_reading_t *reading) {
+    if (sensor == NULL || !attached(sensor) || reading == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!sensor->triggered) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sensor->triggered = false;
+
+    bool gas = sensor->triggered_gas;
+    uint8_t step = sensor->triggered_step;
+    uint8_t data[DATA_LEN_GAS];
+    size_t data_len = gas ? DATA_LEN_GAS : DATA_LEN;
+    for (int i = 0; i < POLL_MAX; i++) {
+        esp_err_t err = read_regs(sensor, REG_MEAS_STATUS, data, data_len);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (data[0] & STATUS_NEW_DATA) {
+            break;
+        }
+        if (i == POLL_MAX - 1) {
+            return ESP_ERR_TIMEOUT;
+        }
+        esp_rom_delay_us(POLL_INTERVAL_US);
+    }
+
+    // 0x1F..0x21 pressure, 0x22..0x24 temperature (20 bit), 0x25..0x26 humidity (16 bit)
+    uint32_t adc_p = (uint32_t)data[2] << 12 | (uint32_t)data[3] << 4 | data[4] >> 4;
+    uint32_t adc_t = (uint32_t)data[5] << 12 | (uint32_t)data[6] << 4 | data[7] >> 4;
+    uint16_t adc_h = (uint16_t)(data[8] << 8 | data[9]);
+
+    int32_t t_fine;
+    reading->temperature = bme680_compensate_temperature(&sensor->calib, adc_t, &t_fine);
+    reading->pressure = sensor->config.os_pressure != BME680_OS_NONE
+                            ? bme680_compensate_pressure(&sensor->calib, adc_p, t_fine) : 0;
+    reading->humidity = sensor->config.os_humidity != BME680_OS_NONE
+                            ? bme680_compensate_humidity(&sensor->calib, adc_h, t_fine) : 0;
+    sensor->ambient = reading->temperature;
+
+    // 0x2A..0x2B gas resistance (10 bit), valid and heat-stable flags, range
+    reading->heater_step = step;
+    reading->gas_valid = gas && (data[14] & GAS_VALID);
+    reading->heat_stable = gas && (data[14] & GAS_HEAT_STABLE);
+    reading->gas_resistance = 0;
+    if (reading->gas_valid && reading->heat_stable) {
+        uint16_t adc_g = (uint16_t)(data[13] << 2 | data[14] >> 6);
+        reading->gas_resistance = bme680_compensate_gas(&sensor->calib, adc_g, data[14] & GAS_RANGE_MASK);
+    }
+    if (gas && sensor->heater_count > 0) {
+        heater_next_step = (uint8_t)((step + 1) % sensor->heater_count);
+    }
+    return ESP_OK;
+}
+
+esp_err_t bme680_read(bme680_t *sensor, bme680_reading_t *reading) {
+    if (reading == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t duration_us = 0;
+    esp_err_t err = bme680_trigger(sensor, &duration_us);
+    if (err != ESP_OK) {
+        return err;
+    }
+    wait_for_conversion(sensor, duration_us);
+    return bme680_fetch(sensor, reading);
+}
+
+esp_err_t bme680_set_heater_profile(bme680_t *sensor, const bme680_heater_step_t *steps, size_t count) {
+    if (sensor == NULL || !attached(sensor) || count > BME680_HEATER_MAX_STEPS || (count > 0 && steps == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (steps[i].temperature_c > BME680_HEATER_MAX_TEMP_C || steps[i].duration_ms == 0 ||
+            steps[i].duration_ms > BME680_HEATER_MAX_MS) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    sensor->heater_count = (uint8_t)count;
+    memcpy(sensor->heater, steps, count * sizeof(*steps));
+    esp_err_t err = ESP_OK;
+    if (count > 0) {
+        err = program_heater(sensor);
+    }
+    if (err == ESP_OK) {
+        err = write_reg(sensor, REG_CTRL_GAS_0, count > 0 ? 0 : CTRL_GAS_0_HEAT_OFF);
+    }
+    if (err == ESP_OK && count == 0) {
+        err = write_reg(sensor, REG_CTRL_GAS_1, 0);
+    }
+    if (err != ESP_OK) {
+        sensor->heater_count = 0;
+        ESP_LOGE(TAG, "Heater profile setup failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Heater profile: %u step(s)", (unsigned)count);
+    return ESP_OK;
+}
+
+const bme680_profile_info_t *bme680_profile_info(bme680_profile_t profile) {
+    return (unsigned)profile < BME680_PROFILE_COUNT ? &profiles[profile] : NULL;
+}
+
+esp_err_t bme680_config_set_profile(bme680_config_t *config, bme680_profile_t profile) {
+    const bme680_profile_info_t *info = bme680_profile_info(profile);
+    if (config == NULL || info == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    config->os_temperature = info->os_temperature;
+    config->os_pressure = info->os_pressure;
+    config->os_humidity = info->os_humidity;
+    config->filter = info->filter;
+    return ESP_OK;
+}
+
+uint32_t bme680_measure_duration_us(const bme680_t *sensor) {
+    if (sensor->heater_count == 0) {
+        return sensor->meas_duration_us;
+    }
+    return sensor->meas_duration_us + sensor->heater[heater_next_step % sensor->heater_count].duration_ms * 1000u;
+}
+
+esp_err_t bme680_deinit(bme680_t *sensor) {
+    if (sensor == NULL) {
+        return ESP_OK;
+    }
+    sensor->config.transfer = NULL;
+    if (sensor->dev == NULL) {
+        return ESP_OK;
+    }
+    esp_err_t err = i2c_master_bus_rm_device(sensor->dev);
+    sensor->dev = NULL;
+    return err;
+}
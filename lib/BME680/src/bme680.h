@@ -0,0 +1,273 @@
+/**
+ * @file bme680.h
+ * @brief Bosch BME680 temperature/pressure/humidity driver (I2C, forced mode)
+ *
+ * Each sample triggers one forced-mode conversion and reads all raw
+ * temperature, pressure and humidity data back in a single I2C burst.
+ * The gas heater is off unless a heater profile is set. With a profile,
+ * each sample also runs the next heater step and reads the gas resistance
+ * in the same burst. Calibration coefficients are read once and kept in
+ * the device struct and in RTC memory, so a node waking from deep sleep
+ * goes straight to measuring. Compensation is integer-only, so the driver
+ * never touches the FPU.
+ *
+ * Oversampling and the IIR filter trade conversion time against noise.
+ * Rather than picking the four settings by hand, a caller can start from
+ * one of the named profiles (bme680_config_set_profile()), each of which
+ * states what it costs and what it buys (bme680_profile_info()).
+ *
+ * The driver adds itself to the caller's bus, or, given a transfer
+ * function, leaves the bus to whoever owns it and runs every transaction
+ * through that instead (a bus shared with other drivers).
+ *
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ * @copyright Copyright (c) 2026 John Devine
+ */
+
+#ifndef BME680_H
+#define BME680_H
+
+// =============================
+// Includes
+// =============================
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/i2c_master.h"
+#include "bme680_compensate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define BME680_I2C_ADDR_PRIMARY 0x76            // SDO to GND
+#define BME680_I2C_ADDR_SECONDARY 0x77          // SDO to VDDIO
+#define BME680_CHIP_ID 0x61
+#define BME680_I2C_SPEED_HZ 400000
+#define BME680_I2C_TIMEOUT_MS 50
+#define BME680_HEATER_MAX_STEPS 10              // res_heat_0..9 / gas_wait_0..9
+
+/**
+ * @brief Oversampling setting, as written to the osrs_x register fields
+ */
+typedef enum {
+    BME680_OS_NONE = 0,                         // Measurement skipped
+    BME680_OS_1X,
+    BME680_OS_2X,
+    BME680_OS_4X,
+    BME680_OS_8X,
+    BME680_OS_16X
+} bme680_oversampling_t;
+
+/**
+ * @brief IIR filter coefficient for temperature and pressure
+ */
+typedef enum {
+    BME680_FILTER_OFF = 0,
+    BME680_FILTER_1,
+    BME680_FILTER_3,
+    BME680_FILTER_7,
+    BME680_FILTER_15,
+    BME680_FILTER_31,
+    BME680_FILTER_63,
+    BME680_FILTER_127
+} bme680_filter_t;
+
+/**
+ * @brief Optional transport: write tx, then read rx_len bytes into rx after a repeated start (rx_len 0: write only)
+ */
+typedef esp_err_t (*bme680_transfer_fn)(void *ctx, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len);
+
+/**
+ * @brief Sensor settings
+ */
+typedef struct {
+    i2c_master_bus_handle_t bus;                // Bus created by the caller; unused with a transfer function
+    bme680_transfer_fn transfer;                // NULL: the driver adds the sensor to bus itself
+    void *transfer_ctx;                         // Passed to transfer
+    uint8_t address;                            // BME680_I2C_ADDR_PRIMARY or _SECONDARY
+    bme680_oversampling_t os_temperature;
+    bme680_oversampling_t os_pressure;
+    bme680_oversampling_t os_humidity;
+    bme680_filter_t filter;
+    bool light_sleep;                           // Light-sleep the whole chip while converting (single-purpose nodes only)
+} bme680_config_t;
+
+/**
+ * @brief One heater step: target hot-plate temperature and how long to hold it
+ */
+typedef struct {
+    uint16_t temperature_c;                     // 200..400 is typical
+    uint16_t duration_ms;                       // Up to BME680_HEATER_MAX_MS
+} bme680_heater_step_t;
+
+/**
+ * @brief Named oversampling and filter settings, from the shortest conversion to the quietest
+ */
+typedef enum {
+    BME680_PROFILE_LOW_POWER = 0,               // T, P and H 1x, no filter
+    BME680_PROFILE_BALANCED,                    // T 2x, P 4x, H 1x, no filter
+    BME680_PROFILE_HIGH_PRECISION,              // T 2x, P 16x, H 2x, IIR 1 on T and P
+    BME680_PROFILE_COUNT
+} bme680_profile_t;
+
+/**
+ * @brief What a profile sets and what it costs
+ *
+ * Noise is Bosch's typical RMS figure for the oversampling (the BMx280
+ * tables; the BME680 shares their T/P/H front end), divided by the IIR
+ * filter's noise reduction. The filter delays a step change: step_samples
+ * is how many samples it takes to show 90 % of one.
+ */
+typedef struct {
+    const char *name;                           // "low-power", "balanced", "high-precision"
+    bme680_oversampling_t os_temperature;
+    bme680_oversampling_t os_pressure;
+    bme680_oversampling_t os_humidity;
+    bme680_filter_t filter;
+    uint32_t duration_us;                       // T, P and H conversion; a heater step adds its hold time
+    uint16_t noise_temperature;                 // RMS, 0.001 degC
+    uint16_t noise_pressure;                    // RMS, 0.01 Pa
+    uint16_t noise_humidity;                    // RMS, 0.001 %RH
+    uint8_t step_samples;                       // 1 without a filter
+} bme680_profile_info_t;
+
+/**
+ * @brief One compensated sample, in fixed point
+ */
+typedef struct {
+    int16_t temperature;                        // 0.01 degC: 2345 is 23.45 degC
+    uint32_t pressure;                          // Pa
+    uint32_t humidity;                          // 0.001 %RH: 45123 is 45.123 %
+    uint32_t gas_resistance;                    // Ohm; 0 without a heater profile or if the plate never stabilised
+    uint8_t heater_step;                        // Profile step this sample ran
+    bool gas_valid;
+    bool heat_stable;
+} bme680_reading_t;
+
+/**
+ * @brief Driver state for one sensor
+ */
+typedef struct {
+    i2c_master_dev_handle_t dev;
+    bme680_config_t config;
+    bme680_calib_t calib;
+    uint8_t ctrl_meas;                          // osrs_t | osrs_p, mode bits clear
+    uint32_t meas_duration_us;                  // T, P and H conversion, without the heater
+    bme680_heater_step_t heater[BME680_HEATER_MAX_STEPS];
+    uint8_t heater_count;                       // 0: heater off
+    int16_t heater_ambient;                     // 0.01 degC the heater resistances were computed for
+    int16_t ambient;                            // Last measured temperature, 0.01 degC
+    bool triggered;                             // A conversion is running that bme680_fetch() has not read
+    bool triggered_gas;                         // It runs a heater step
+    uint8_t triggered_step;
+} bme680_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Attach to the sensor, load calibration and apply the settings
+ *
+ * Calibration comes from RTC memory when a previous boot (usually the
+ * wake before deep sleep) already read it for the same address; otherwise
+ * it is read from the sensor and stored there.
+ *
+ * @param sensor Driver state to fill in
+ * @param config Settings; oversampling of 0 skips that measurement
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_FOUND if the chip ID is wrong, or the I2C error
+ */
+esp_err_t bme680_init(bme680_t *sensor, const bme680_config_t *config);
+
+/**
+ * @brief Take one forced-mode sample
+ *
+ * Starts a conversion, sleeps for its duration and reads the result in
+ * one burst. With a heater profile the sample also runs the next step,
+ * which the sensor does straight after the T, P and H conversion. The
+ * task sleeps (or light-sleeps) for the whole cycle and does not poll the
+ * heater. Blocks for about bme680_measure_duration_us().
+ *
+ * @param sensor Initialized sensor
+ * @param reading Compensated values
+ * @return esp_err_t ESP_OK, ESP_ERR_TIMEOUT if no new data arrived, or the I2C error
+ */
+esp_err_t bme680_read(bme680_t *sensor, bme680_reading_t *reading);
+
+/**
+ * @brief Start a forced-mode sample without waiting for it
+ *
+ * The first half of bme680_read(), for a caller that has other work to
+ * do while the sensor converts. Read the result with bme680_fetch() once
+ * duration_us has passed.
+ *
+ * @param sensor Initialized sensor
+ * @param duration_us Receives the conversion time, heater step included; may be NULL
+ * @return esp_err_t ESP_OK or the I2C error
+ */
+esp_err_t bme680_trigger(bme680_t *sensor, uint32_t *duration_us);
+
+/**
+ * @brief Read and compensate the sample bme680_trigger() started
+ *
+ * Polls the status briefly if the conversion is not quite done.
+ *
+ * @param sensor Initialized sensor
+ * @param reading Compensated values
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_STATE without a trigger, ESP_ERR_TIMEOUT if no new data
+ *         arrived, or the I2C error
+ */
+esp_err_t bme680_fetch(bme680_t *sensor, bme680_reading_t *reading);
+
+/**
+ * @brief Program a heater profile that successive samples step through
+ *
+ * All steps are written to the sensor in one I2C transaction. Each
+ * bme680_read() runs the next step and wraps after the last one. The
+ * position survives deep sleep. Resistances are recomputed when the
+ * ambient temperature drifts.
+ *
+ * @param sensor Initialized sensor
+ * @param steps Heater steps, or NULL with count 0 to turn the heater off
+ * @param count Number of steps, up to BME680_HEATER_MAX_STEPS
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG for a bad step, or the I2C error
+ */
+esp_err_t bme680_set_heater_profile(bme680_t *sensor, const bme680_heater_step_t *steps, size_t count);
+
+/**
+ * @brief The settings and costs of a profile
+ *
+ * @return const bme680_profile_info_t* NULL for a value outside bme680_profile_t
+ */
+const bme680_profile_info_t *bme680_profile_info(bme680_profile_t profile);
+
+/**
+ * @brief Fill a config's oversampling and filter from a profile, before bme680_init()
+ *
+ * @return esp_err_t ESP_OK, or ESP_ERR_INVALID_ARG for an unknown profile (config untouched)
+ */
+esp_err_t bme680_config_set_profile(bme680_config_t *config, bme680_profile_t profile);
+
+/**
+ * @brief Time the next sample takes: the conversion plus its heater step
+ */
+uint32_t bme680_measure_duration_us(const bme680_t *sensor);
+
+/**
+ * @brief Detach from the bus, or drop the transfer function (the sensor is already asleep between samples)
+ */
+esp_err_t bme680_deinit(bme680_t *sensor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BME680_H
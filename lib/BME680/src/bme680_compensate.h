@@ -0,0 +1,215 @@
+/**
+ * @file bme680_compensate.h
+ * @brief BME680 calibration coefficients and integer compensation, free of any driver or bus code
+ *
+ * Everything here is plain C on the raw register values: the driver uses
+ * it after each burst read, and it builds unchanged on a host (ESP-IDF's
+ * linux target or a native toolchain) to check the arithmetic against the
+ * datasheet formulas or time it. Functions are static inline so the
+ * driver's read path keeps them inlined.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ * @copyright Copyright (c) 2026 John Devine
+ */
+
+#ifndef BME680_COMPENSATE_H
+#define BME680_COMPENSATE_H
+
+// =============================
+// Includes
+// =============================
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define BME680_HEATER_MAX_TEMP_C 400
+#define BME680_HEATER_MAX_MS 4032               // Largest gas_wait encoding (63 x 64 ms)
+#define BME680_PRESSURE_OVERFLOW 0x80000000u    // Above this doubling would overflow uint32
+#define BME680_HUMIDITY_MAX 100000              // 100.000 %RH
+
+/**
+ * @brief Factory calibration coefficients (datasheet par_* names)
+ */
+typedef struct {
+    uint16_t par_t1;
+    int16_t par_t2;
+    int8_t par_t3;
+    uint16_t par_p1;
+    int16_t par_p2;
+    int8_t par_p3;
+    int16_t par_p4;
+    int16_t par_p5;
+    int8_t par_p6;
+    int8_t par_p7;
+    int16_t par_p8;
+    int16_t par_p9;
+    uint8_t par_p10;
+    uint16_t par_h1;
+    uint16_t par_h2;
+    int8_t par_h3;
+    int8_t par_h4;
+    int8_t par_h5;
+    uint8_t par_h6;
+    int8_t par_h7;
+    int8_t par_g1;
+    int16_t par_g2;
+    int8_t par_g3;
+    uint8_t res_heat_range;
+    int8_t res_heat_val;
+    int8_t range_sw_err;
+} bme680_calib_t;
+
+// Gas resistance range constants, integer form of the datasheet table
+static const uint32_t bme680_gas_range_k1[16] = {
+    2147483647u, 2147483647u, 2147483647u, 2147483647u, 2147483647u, 2126008810u, 2147483647u, 2130303777u,
+    2147483647u, 2147483647u, 2143188679u, 2136746228u, 2147483647u, 2126008810u, 2147483647u, 2147483647u
+};
+static const uint32_t bme680_gas_range_k2[16] = {
+    4096000000u, 2048000000u, 1024000000u, 512000000u, 255744255u, 127110228u, 64000000u, 32258064u,
+    16016016u, 8000000u, 4000000u, 2000000u, 1000000u, 500000u, 250000u, 125000u
+};
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Temperature in 0.01 degC; also returns t_fine for the other two
+ *
+ * Bosch's integer compensation throughout: no FPU use, identical results
+ * on every build. Shifts of possibly negative values are written as
+ * multiplies so the arithmetic stays well defined.
+ */
+static inline int16_t bme680_compensate_temperature(const bme680_calib_t *c, uint32_t adc, int32_t *t_fine) {
+    int64_t var1 = ((int32_t)adc >> 3) - ((int32_t)c->par_t1 << 1);
+    int64_t var2 = (var1 * (int32_t)c->par_t2) >> 11;
+    int64_t var3 = ((var1 >> 1) * (var1 >> 1)) >> 12;
+    var3 = (var3 * ((int32_t)c->par_t3 * 16)) >> 14;
+    *t_fine = (int32_t)(var2 + var3);
+    return (int16_t)((*t_fine * 5 + 128) >> 8);
+}
+
+/**
+ * @brief Pressure in Pa
+ */
+static inline uint32_t bme680_compensate_pressure(const bme680_calib_t *c, uint32_t adc, int32_t t_fine) {
+    int32_t var1 = (t_fine >> 1) - 64000;
+    int32_t var2 = ((((var1 >> 2) * (var1 >> 2)) >> 11) * (int32_t)c->par_p6) >> 2;
+    var2 = var2 + var1 * (int32_t)c->par_p5 * 2;
+    var2 = (var2 >> 2) + (int32_t)c->par_p4 * 65536;
+    var1 = (((((var1 >> 2) * (var1 >> 2)) >> 13) * ((int32_t)c->par_p3 * 32)) >> 3) +
+           (((int32_t)c->par_p2 * var1) >> 1);
+    var1 = var1 >> 18;
+    var1 = ((32768 + var1) * (int32_t)c->par_p1) >> 15;
+    if (var1 <= 0) {
+        return 0;                               // Avoid dividing by zero on bad calibration
+    }
+
+    int32_t diff = 1048576 - (int32_t)adc - (var2 >> 12);
+    if (diff <= 0) {
+        return 0;
+    }
+    // Unsigned, and divide first once doubling would overflow: Bosch's int32 version wraps when cold
+    uint32_t scaled = (uint32_t)diff * 3125u;
+    int32_t p;
+    if (scaled >= BME680_PRESSURE_OVERFLOW) {
+        p = (int32_t)((scaled / (uint32_t)var1) << 1);
+    } else {
+        p = (int32_t)((scaled << 1) / (uint32_t)var1);
+    }
+    var1 = ((int32_t)c->par_p9 * (((p >> 3) * (p >> 3)) >> 13)) >> 12;
+    var2 = ((p >> 2) * (int32_t)c->par_p8) >> 13;
+    int32_t cube = (p >> 8) * (p >> 8) * (p >> 8);
+    int32_t var3 = (int32_t)(((int64_t)cube * c->par_p10) >> 17);  // Exceeds 32 bits above ~100 kPa
+    p = p + ((var1 + var2 + var3 + (int32_t)c->par_p7 * 128) >> 4);
+    return (uint32_t)p;
+}
+
+/**
+ * @brief Relative humidity in 0.001 %, clamped to 0..100000
+ */
+static inline uint32_t bme680_compensate_humidity(const bme680_calib_t *c, uint16_t adc, int32_t t_fine) {
+    int32_t temp = (t_fine * 5 + 128) >> 8;     // 0.01 degC
+    int32_t var1 = ((int32_t)adc - (int32_t)c->par_h1 * 16) - (((temp * (int32_t)c->par_h3) / 100) >> 1);
+    int32_t var2 = ((int32_t)c->par_h2 *
+                    (((temp * (int32_t)c->par_h4) / 100) +
+                     (((temp * ((temp * (int32_t)c->par_h5) / 100)) >> 6) / 100) + (1 << 14))) >> 10;
+    int32_t var3 = var1 * var2;
+    int32_t var4 = (((int32_t)c->par_h6 << 7) + ((temp * (int32_t)c->par_h7) / 100)) >> 4;
+    int64_t var5 = ((int64_t)(var3 >> 14) * (var3 >> 14)) >> 10;  // Exceeds 32 bits near the top of the ADC
+    int64_t var6 = (var4 * var5) >> 1;
+    int64_t hum = (((var3 + var6) >> 10) * 1000) >> 12;
+    if (hum > BME680_HUMIDITY_MAX) {
+        hum = BME680_HUMIDITY_MAX;
+    } else if (hum < 0) {
+        hum = 0;
+    }
+    return (uint32_t)hum;
+}
+
+/**
+ * @brief Gas resistance in Ohm from the ADC value and range
+ */
+static inline uint32_t bme680_compensate_gas(const bme680_calib_t *c, uint16_t adc, uint8_t range) {
+    int64_t var1 = ((1340 + 5 * (int64_t)c->range_sw_err) * (int64_t)bme680_gas_range_k1[range]) >> 16;
+    int64_t var2 = ((int64_t)adc * 32768 - 16777216) + var1;
+    int64_t var3 = ((int64_t)bme680_gas_range_k2[range] * var1) >> 9;
+    if (var2 <= 0) {
+        return 0;
+    }
+    return (uint32_t)((var3 + (var2 >> 1)) / var2);
+}
+
+/**
+ * @brief res_heat_x register value that brings the plate to target_c at this ambient temperature (0.01 degC)
+ *
+ * Bosch's integer version scales the ambient term (par_g3) 10000 times
+ * too small, so it ignores the ambient temperature that the float version
+ * corrects for, several codes across -40..85 degC. Here the term is scaled
+ * to var2's units: par_g3 / 1024 * degC * 2621440.
+ */
+static inline uint8_t bme680_heater_resistance(const bme680_calib_t *c, int16_t ambient, uint16_t target_c) {
+    if (target_c > BME680_HEATER_MAX_TEMP_C) {
+        target_c = BME680_HEATER_MAX_TEMP_C;
+    }
+    int32_t var1 = ((int32_t)ambient * c->par_g3 * 128) / 5;
+    int32_t var2 = (c->par_g1 + 784) * (((((c->par_g2 + 154009) * (int32_t)target_c * 5) / 100) + 3276800) / 10);
+    int32_t var3 = var1 + var2 / 2;
+    int32_t var4 = var3 / (c->res_heat_range + 4);
+    int32_t var5 = 131 * c->res_heat_val + 65536;
+    int32_t res_x100 = (var4 / var5 - 250) * 34;
+    if (res_x100 < 0) {
+        return 0;
+    }
+    int32_t res = (res_x100 + 50) / 100;
+    return (uint8_t)(res > 0xFF ? 0xFF : res);
+}
+
+/**
+ * @brief gas_wait_x encoding: 6-bit count in ms, shifted by a x1/x4/x16/x64 factor
+ */
+static inline uint8_t bme680_heater_wait(uint16_t duration_ms) {
+    if (duration_ms >= BME680_HEATER_MAX_MS) {
+        return 0xFF;
+    }
+    uint8_t factor = 0;
+    while (duration_ms > 0x3F) {
+        duration_ms /= 4;
+        factor++;
+    }
+    return (uint8_t)(duration_ms + factor * 64);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BME680_COMPENSATE_H
@@ -0,0 +1,278 @@
+/**
+ * @file icm20948.c
+ * @brief TDK InvenSense ICM-20948 accelerometer and gyroscope driver (I2C, FIFO batch reads)
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ * @copyright Copyright (c) 2026 John Devine
+ */
+
+// =============================
+// Includes
+// =============================
+#include "icm20948.h"
+#include "../../../include/version.h"
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+static const char *TAG = "ICM20948";
+
+// Register icm20948.c version
+REGISTER_VERSION(ICM20948, "1.0.0", "2026-10-15");
+
+// Registers (datasheet section 7): bank in the high byte, address in the low byte
+#define REG(bank, addr) ((uint16_t)((bank) << 8 | (addr)))
+#define REG_WHO_AM_I REG(0, 0x00)
+#define REG_USER_CTRL REG(0, 0x03)
+#define REG_PWR_MGMT_1 REG(0, 0x06)
+#define REG_PWR_MGMT_2 REG(0, 0x07)
+#define REG_FIFO_EN_2 REG(0, 0x67)
+#define REG_FIFO_RST REG(0, 0x68)
+#define REG_FIFO_MODE REG(0, 0x69)
+#define REG_FIFO_COUNTH REG(0, 0x70)
+#define REG_FIFO_R_W REG(0, 0x72)
+#define REG_GYRO_SMPLRT_DIV REG(2, 0x00)
+#define REG_GYRO_CONFIG_1 REG(2, 0x01)
+#define REG_ODR_ALIGN_EN REG(2, 0x09)
+#define REG_ACCEL_SMPLRT_DIV_1 REG(2, 0x10)
+#define REG_ACCEL_SMPLRT_DIV_2 REG(2, 0x11)
+#define REG_ACCEL_CONFIG REG(2, 0x14)
+#define REG_BANK_SEL 0x7F                       // In every bank
+
+#define WHO_AM_I_VALUE 0xEA
+#define PWR_DEVICE_RESET 0x80
+#define PWR_SLEEP 0x40
+#define PWR_CLKSEL_AUTO 0x01                    // PLL once the gyroscope runs
+#define USER_CTRL_FIFO_EN 0x40
+#define FIFO_EN_2_ACCEL_GYRO 0x1E               // ACCEL_FIFO_EN and GYRO_X/Y/Z_FIFO_EN
+#define FIFO_RST_ALL 0x1F
+#define FIFO_COUNT_MASK 0x1FFF
+// DLPFCFG 3 (about 50 Hz), FS_SEL 1 (+-500 dps, +-4 g), FCHOICE 1 (filter on)
+#define GYRO_CONFIG_1_VALUE (3 << 3 | 1 << 1 | 1)
+#define ACCEL_CONFIG_VALUE (3 << 3 | 1 << 1 | 1)
+#define RESET_MS 10
+#define STARTUP_MS 40                           // Gyroscope start-up time
+
+_Static_assert(sizeof(icm20948_sample_t) == 12, "a FIFO sample is 12 bytes");
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t transfer(icm20948_t *imu, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len);
+static esp_err_t detach(icm20948_t *imu);
+static esp_err_t select_bank(icm20948_t *imu, uint8_t bank);
+static esp_err_t read_regs(icm20948_t *imu, uint16_t reg, uint8_t *buf, size_t len);
+static esp_err_t write_reg(icm20948_t *imu, uint16_t reg, uint8_t value);
+static esp_err_t reset_fifo(icm20948_t *imu);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief One transaction, through the caller's transfer function when there is one
+ */
+static esp_err_t transfer(icm20948_t *imu, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len) {
+    if (imu->config.transfer != NULL) {
+        return imu->config.transfer(imu->config.transfer_ctx, tx, tx_len, rx, rx_len);
+    }
+    if (rx_len == 0) {
+        return i2c_master_transmit(imu->dev, tx, tx_len, ICM20948_I2C_TIMEOUT_MS);
+    }
+    return i2c_master_transmit_receive(imu->dev, tx, tx_len, rx, rx_len, ICM20948_I2C_TIMEOUT_MS);
+}
+
+static esp_err_t detach(icm20948_t *imu) {
+    imu->config.transfer = NULL;
+    if (imu->dev == NULL) {
+        return ESP_OK;
+    }
+    esp_err_t err = i2c_master_bus_rm_device(imu->dev);
+    imu->dev = NULL;
+    return err;
+}
+
+/**
+ * @brief Switch register banks only when the next register needs another one
+ */
+static esp_err_t select_bank(icm20948_t *imu, uint8_t bank) {
+    if (imu->bank == bank) {
+        return ESP_OK;
+    }
+    uint8_t buf[2] = { REG_BANK_SEL, (uint8_t)(bank << 4) };
+    esp_err_t err = transfer(imu, buf, sizeof(buf), NULL, 0);
+    if (err == ESP_OK) {
+        imu->bank = bank;
+    }
+    return err;
+}
+
+static esp_err_t read_regs(icm20948_t *imu, uint16_t reg, uint8_t *buf, size_t len) {
+    esp_err_t err = select_bank(imu, (uint8_t)(reg >> 8));
+    if (err != ESP_OK) {
+        return err;
+    }
+    uint8_t addr = (uint8_t)reg;
+    return transfer(imu, &addr, 1, buf, len);
+}
+
+static esp_err_t write_reg(icm20948_t *imu, uint16_t reg, uint8_t value) {
+    esp_err_t err = select_bank(imu, (uint8_t)(reg >> 8));
+    if (err != ESP_OK) {
+        return err;
+    }
+    uint8_t buf[2] = { (uint8_t)reg, value };
+    return transfer(imu, buf, sizeof(buf), NULL, 0);
+}
+
+static esp_err_t reset_fifo(icm20948_t *imu) {
+    esp_err_t err = write_reg(imu, REG_FIFO_RST, FIFO_RST_ALL);
+    if (err == ESP_OK) {
+        err = write_reg(imu, REG_FIFO_RST, 0);
+    }
+    return err;
+}
+
+esp_err_t icm20948_init(icm20948_t *imu, const icm20948_config_t *config) {
+    if (imu == NULL || config == NULL || (config->bus == NULL && config->transfer == NULL) ||
+        config->rate_divider > 255) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(imu, 0, sizeof(*imu));
+    imu->config = *config;
+    imu->bank = 0xFF;                           // Unknown until the first select
+
+    esp_err_t err = ESP_OK;
+    if (config->transfer == NULL) {
+        i2c_device_config_t dev_cfg = {
+            .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+            .device_address = config->address,
+            .scl_speed_hz = ICM20948_I2C_SPEED_HZ,
+        };
+        err = i2c_master_bus_add_device(config->bus, &dev_cfg, &imu->dev);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to add device 0x%02x: %s", config->address, esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    uint8_t id = 0;
+    err = read_regs(imu, REG_WHO_AM_I, &id, 1);
+    if (err == ESP_OK && id != WHO_AM_I_VALUE) {
+        ESP_LOGE(TAG, "Unexpected WHO_AM_I 0x%02x at 0x%02x", id, config->address);
+        err = ESP_ERR_NOT_FOUND;
+    }
+    if (err == ESP_OK) {
+        err = write_reg(imu, REG_PWR_MGMT_1, PWR_DEVICE_RESET);
+        vTaskDelay(pdMS_TO_TICKS(RESET_MS));
+        imu->bank = 0;                          // A reset selects bank 0
+    }
+    if (err == ESP_OK) {
+        err = write_reg(imu, REG_PWR_MGMT_1, PWR_CLKSEL_AUTO);
+    }
+    if (err == ESP_OK) {
+        err = write_reg(imu, REG_PWR_MGMT_2, 0);
+    }
+
+    // The same divider for both, so each FIFO sample holds one reading of each
+    if (err == ESP_OK) {
+        err = write_reg(imu, REG_ODR_ALIGN_EN, 1);
+    }
+    if (err == ESP_OK) {
+        err = write_reg(imu, REG_GYRO_SMPLRT_DIV, (uint8_t)config->rate_divider);
+    }
+    if (err == ESP_OK) {
+        err = write_reg(imu, REG_GYRO_CONFIG_1, GYRO_CONFIG_1_VALUE);
+    }
+    if (err == ESP_OK) {
+        err = write_reg(imu, REG_ACCEL_SMPLRT_DIV_1, (uint8_t)(config->rate_divider >> 8));
+    }
+    if (err == ESP_OK) {
+        err = write_reg(imu, REG_ACCEL_SMPLRT_DIV_2, (uint8_t)config->rate_divider);
+    }
+    if (err == ESP_OK) {
+        err = write_reg(imu, REG_ACCEL_CONFIG, ACCEL_CONFIG_VALUE);
+    }
+    if (err == ESP_OK) {
+        vTaskDelay(pdMS_TO_TICKS(STARTUP_MS));
+        err = write_reg(imu, REG_FIFO_MODE, 0);             // Stream: full FIFO is an overflow, not a stop
+    }
+    if (err == ESP_OK) {
+        err = write_reg(imu, REG_FIFO_EN_2, FIFO_EN_2_ACCEL_GYRO);
+    }
+    if (err == ESP_OK) {
+        err = write_reg(imu, REG_USER_CTRL, USER_CTRL_FIFO_EN);
+    }
+    if (err == ESP_OK) {
+        err = reset_fifo(imu);
+    }
+    if (err != ESP_OK) {
+        detach(imu);
+        return err;
+    }
+    ESP_LOGI(TAG, "Sampling at %lu mHz into the FIFO", (unsigned long)icm20948_rate_mhz(imu));
+    return ESP_OK;
+}
+
+esp_err_t icm20948_read_fifo(icm20948_t *imu, icm20948_sample_t *samples, size_t max, size_t *count) {
+    if (imu == NULL || samples == NULL || count == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *count = 0;
+
+    uint8_t buf[2];
+    esp_err_t err = read_regs(imu, REG_FIFO_COUNTH, buf, sizeof(buf));
+    if (err != ESP_OK) {
+        return err;
+    }
+    size_t bytes = (size_t)((buf[0] << 8 | buf[1]) & FIFO_COUNT_MASK);
+    if (bytes >= ICM20948_FIFO_BYTES) {
+        // The oldest bytes were overwritten, so sample boundaries are lost
+        imu->overflows++;
+        reset_fifo(imu);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t n = bytes / sizeof(icm20948_sample_t);
+    if (n > max) {
+        n = max;
+    }
+    if (n == 0) {
+        return ESP_OK;
+    }
+
+    // FIFO_R_W does not auto-increment: one burst pops n samples, read straight into the caller's array
+    err = read_regs(imu, REG_FIFO_R_W, (uint8_t *)samples, n * sizeof(icm20948_sample_t));
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint8_t *raw = (uint8_t *)&samples[i];
+        int16_t v[6];
+        for (int k = 0; k < 6; k++) {
+            v[k] = (int16_t)(raw[2 * k] << 8 | raw[2 * k + 1]);
+        }
+        memcpy(samples[i].accel, v, sizeof(samples[i].accel));
+        memcpy(samples[i].gyro, v + 3, sizeof(samples[i].gyro));
+    }
+    *count = n;
+    return ESP_OK;
+}
+
+uint32_t icm20948_rate_mhz(const icm20948_t *imu) {
+    return ICM20948_BASE_RATE_HZ * 1000u / (1u + imu->config.rate_divider);
+}
+
+esp_err_t icm20948_deinit(icm20948_t *imu) {
+    if (imu == NULL || (imu->dev == NULL && imu->config.transfer == NULL)) {
+        return ESP_OK;
+    }
+    write_reg(imu, REG_PWR_MGMT_1, PWR_SLEEP | PWR_CLKSEL_AUTO);
+    return detach(imu);
+}
@@ -0,0 +1,124 @@
+/**
+ * @file icm20948.h
+ * @brief TDK InvenSense ICM-20948 accelerometer and gyroscope driver (I2C, FIFO batch reads)
+ *
+ * Both sensors sample at 1125 / (1 + rate_divider) Hz into the chip's
+ * FIFO, one 12-byte sample each time: accelerometer X, Y, Z, then
+ * gyroscope X, Y, Z. icm20948_read_fifo() takes every whole sample in one
+ * burst, so a reader wakes once per batch instead of once per sample. The
+ * ranges are fixed at +-4 g and +-500 dps with the low-pass filters near
+ * 50 Hz. Samples are raw counts; ICM20948_ACCEL_LSB_PER_G and
+ * ICM20948_GYRO_LSB_PER_DPS_X10 scale them.
+ *
+ * As the BME680 driver, it adds itself to the caller's bus, or runs every
+ * transaction through a transfer function when given one. The
+ * magnetometer is not used.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ * @copyright Copyright (c) 2026 John Devine
+ */
+
+#ifndef ICM20948_H
+#define ICM20948_H
+
+// =============================
+// Includes
+// =============================
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/i2c_master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define ICM20948_I2C_ADDR_DEFAULT 0x68          // AD0 low
+#define ICM20948_I2C_ADDR_ALT 0x69              // AD0 high (most breakout boards)
+#define ICM20948_I2C_SPEED_HZ 400000
+#define ICM20948_I2C_TIMEOUT_MS 50
+#define ICM20948_BASE_RATE_HZ 1125              // Sample rate with a divider of 0
+#define ICM20948_FIFO_BYTES 512                 // FIFO depth assumed; a count this high is treated as overflow
+#define ICM20948_ACCEL_LSB_PER_G 8192           // +-4 g
+#define ICM20948_GYRO_LSB_PER_DPS_X10 655       // +-500 dps: 65.5 counts per degree per second
+
+/**
+ * @brief Optional transport: write tx, then read rx_len bytes into rx after a repeated start (rx_len 0: write only)
+ */
+typedef esp_err_t (*icm20948_transfer_fn)(void *ctx, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len);
+
+/**
+ * @brief Chip settings
+ */
+typedef struct {
+    i2c_master_bus_handle_t bus;                // Bus created by the caller; unused with a transfer function
+    icm20948_transfer_fn transfer;              // NULL: the driver adds the chip to bus itself
+    void *transfer_ctx;                         // Passed to transfer
+    uint8_t address;                            // ICM20948_I2C_ADDR_DEFAULT or ICM20948_I2C_ADDR_ALT
+    uint16_t rate_divider;                      // Sample rate 1125 / (1 + rate_divider) Hz, up to 255
+} icm20948_config_t;
+
+/**
+ * @brief One FIFO sample, raw counts in the chip's axes
+ */
+typedef struct {
+    int16_t accel[3];
+    int16_t gyro[3];
+} icm20948_sample_t;
+
+/**
+ * @brief Driver state for one chip
+ */
+typedef struct {
+    i2c_master_dev_handle_t dev;
+    icm20948_config_t config;
+    uint8_t bank;                               // Register bank selected now
+    uint32_t overflows;                         // FIFO resets after an overflow
+} icm20948_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Attach to the chip, reset it, set ranges and rate and start filling the FIFO
+ *
+ * @param imu Driver state to fill in
+ * @param config Settings
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_NOT_FOUND if WHO_AM_I is wrong, or the I2C error
+ */
+esp_err_t icm20948_init(icm20948_t *imu, const icm20948_config_t *config);
+
+/**
+ * @brief Read every whole sample waiting in the FIFO, up to max
+ *
+ * @param imu Initialized chip
+ * @param samples Receives the samples, oldest first
+ * @param max Room in samples; the rest stay in the FIFO for the next read
+ * @param count Receives the number read
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_SIZE if the FIFO had overflowed (it is reset and count is 0),
+ *         or the I2C error
+ */
+esp_err_t icm20948_read_fifo(icm20948_t *imu, icm20948_sample_t *samples, size_t max, size_t *count);
+
+/**
+ * @brief Sample rate in millihertz
+ */
+uint32_t icm20948_rate_mhz(const icm20948_t *imu);
+
+/**
+ * @brief Put the chip to sleep and detach from the bus, or drop the transfer function
+ */
+esp_err_t icm20948_deinit(icm20948_t *imu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ICM20948_H
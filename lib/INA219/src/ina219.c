@@ -0,0 +1,156 @@
+/**
+ * @file ina219.c
+ * @brief TI INA219 high-side current monitor driver (I2C, continuous shunt conversion)
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ * @copyright Copyright (c) 2026 John Devine
+ */
+
+// =============================
+// Includes
+// =============================
+#include "ina219.h"
+#include "../../../include/version.h"
+#include <string.h>
+#include "esp_log.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+static const char *TAG = "INA219";
+
+// Register ina219.c version
+REGISTER_VERSION(INA219, "1.0.0", "2026-10-15");
+
+// Registers (datasheet section 8.6), all 16-bit big-endian
+#define REG_CONFIG 0x00
+#define REG_SHUNT_VOLTAGE 0x01
+
+#define CONFIG_RESET (1 << 15)
+#define CONFIG_PG_SHIFT 11
+#define CONFIG_SADC_SHIFT 3
+#define ADC_AVG_BASE 0x8                        // SADC 1000: 12-bit, 1 sample; 1111 is 128 samples
+#define MODE_POWER_DOWN 0x0
+#define MODE_SHUNT_CONTINUOUS 0x5
+
+// Conversion time per averaging setting, us
+static const uint32_t avg_conversion_us[] = { 532, 1060, 2130, 4260, 8510, 17020, 34050, 68100 };
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t transfer(ina219_t *monitor, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len);
+static esp_err_t detach(ina219_t *monitor);
+static esp_err_t read_reg(ina219_t *monitor, uint8_t reg, uint16_t *value);
+static esp_err_t write_reg(ina219_t *monitor, uint8_t reg, uint16_t value);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief One transaction, through the caller's transfer function when there is one
+ */
+static esp_err_t transfer(ina219_t *monitor, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len) {
+    if (monitor->config.transfer != NULL) {
+        return monitor->config.transfer(monitor->config.transfer_ctx, tx, tx_len, rx, rx_len);
+    }
+    if (rx_len == 0) {
+        return i2c_master_transmit(monitor->dev, tx, tx_len, INA219_I2C_TIMEOUT_MS);
+    }
+    return i2c_master_transmit_receive(monitor->dev, tx, tx_len, rx, rx_len, INA219_I2C_TIMEOUT_MS);
+}
+
+static esp_err_t detach(ina219_t *monitor) {
+    monitor->config.transfer = NULL;
+    if (monitor->dev == NULL) {
+        return ESP_OK;
+    }
+    esp_err_t err = i2c_master_bus_rm_device(monitor->dev);
+    monitor->dev = NULL;
+    return err;
+}
+
+static esp_err_t read_reg(ina219_t *monitor, uint8_t reg, uint16_t *value) {
+    uint8_t buf[2];
+    esp_err_t err = transfer(monitor, &reg, 1, buf, sizeof(buf));
+    if (err == ESP_OK) {
+        *value = (uint16_t)(buf[0] << 8 | buf[1]);
+    }
+    return err;
+}
+
+static esp_err_t write_reg(ina219_t *monitor, uint8_t reg, uint16_t value) {
+    uint8_t buf[3] = { reg, (uint8_t)(value >> 8), (uint8_t)value };
+    return transfer(monitor, buf, sizeof(buf), NULL, 0);
+}
+
+esp_err_t ina219_init(ina219_t *monitor, const ina219_config_t *config) {
+    if (monitor == NULL || config == NULL || (config->bus == NULL && config->transfer == NULL) ||
+        config->shunt_mohm == 0 ||
+        config->avg > INA219_AVG_128) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(monitor, 0, sizeof(*monitor));
+    monitor->config = *config;
+
+    esp_err_t err = ESP_OK;
+    if (config->transfer == NULL) {
+        i2c_device_config_t dev_cfg = {
+            .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+            .device_address = config->address,
+            .scl_speed_hz = INA219_I2C_SPEED_HZ,
+        };
+        err = i2c_master_bus_add_device(config->bus, &dev_cfg, &monitor->dev);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to add device 0x%02x: %s", config->address, esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    // No ID register: a configuration that reads back as written is the check
+    uint16_t value = (uint16_t)(config->range << CONFIG_PG_SHIFT | (ADC_AVG_BASE | config->avg) << CONFIG_SADC_SHIFT |
+                                MODE_SHUNT_CONTINUOUS);
+    uint16_t readback = 0;
+    err = write_reg(monitor, REG_CONFIG, CONFIG_RESET);
+    if (err == ESP_OK) {
+        err = write_reg(monitor, REG_CONFIG, value);
+    }
+    if (err == ESP_OK) {
+        err = read_reg(monitor, REG_CONFIG, &readback);
+    }
+    if (err == ESP_OK && readback != value) {
+        ESP_LOGE(TAG, "Configuration 0x%04x read back as 0x%04x at 0x%02x", value, readback, config->address);
+        err = ESP_ERR_NOT_FOUND;
+    }
+    if (err != ESP_OK) {
+        detach(monitor);
+    }
+    return err;
+}
+
+esp_err_t ina219_read_current(ina219_t *monitor, int32_t *current_ua) {
+    uint16_t raw;
+    esp_err_t err = read_reg(monitor, REG_SHUNT_VOLTAGE, &raw);
+    if (err == ESP_OK) {
+        // Sign-extended for every range; uV * 1000 / milliohm is uA
+        *current_ua = (int32_t)((int64_t)(int16_t)raw * INA219_SHUNT_LSB_UV * 1000 /
+                                (int64_t)monitor->config.shunt_mohm);
+    }
+    return err;
+}
+
+uint32_t ina219_conversion_us(const ina219_t *monitor) {
+    return avg_conversion_us[monitor->config.avg];
+}
+
+esp_err_t ina219_deinit(ina219_t *monitor) {
+    if (monitor == NULL || (monitor->dev == NULL && monitor->config.transfer == NULL)) {
+        return ESP_OK;
+    }
+    write_reg(monitor, REG_CONFIG, MODE_POWER_DOWN);
+    return detach(monitor);
+}
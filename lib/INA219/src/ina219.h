@@ -0,0 +1,137 @@
+/**
+ * @file ina219.h
+ * @brief TI INA219 high-side current monitor driver (I2C, continuous shunt conversion)
+ *
+ * The chip converts the shunt voltage continuously and averages up to 128
+ * conversions in hardware, so one register read gives the mean current over
+ * the last ina219_conversion_us(). Polling at that period covers the whole
+ * time without gaps, which is what integrating charge needs; the radio's
+ * millisecond bursts are averaged in rather than sampled past. The bus
+ * voltage converter is left off.
+ *
+ * Current is computed from the shunt register and the shunt resistance,
+ * so the calibration register is not used. The shunt LSB is 10 uV: with
+ * a 0.1 ohm shunt that is 100 uA per count, and averaging brings the mean
+ * below that only as far as there is noise to dither it.
+ *
+ * As the BME680 driver, it adds itself to the caller's bus, or runs every
+ * transaction through a transfer function when given one.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ * @copyright Copyright (c) 2026 John Devine
+ */
+
+#ifndef INA219_H
+#define INA219_H
+
+// =============================
+// Includes
+// =============================
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/i2c_master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+#define INA219_I2C_ADDR_DEFAULT 0x40            // A0 and A1 to GND
+#define INA219_I2C_SPEED_HZ 400000
+#define INA219_I2C_TIMEOUT_MS 50
+#define INA219_SHUNT_LSB_UV 10
+
+/**
+ * @brief Shunt full-scale range, as written to the PG field
+ */
+typedef enum {
+    INA219_RANGE_40MV = 0,                      // 400 mA with 0.1 ohm
+    INA219_RANGE_80MV,
+    INA219_RANGE_160MV,
+    INA219_RANGE_320MV,                         // Power-on default
+} ina219_range_t;
+
+/**
+ * @brief Conversions averaged per result
+ */
+typedef enum {
+    INA219_AVG_1 = 0,                           // 0.53 ms
+    INA219_AVG_2,
+    INA219_AVG_4,
+    INA219_AVG_8,
+    INA219_AVG_16,
+    INA219_AVG_32,
+    INA219_AVG_64,
+    INA219_AVG_128,                             // 68.1 ms
+} ina219_avg_t;
+
+/**
+ * @brief Optional transport: write tx, then read rx_len bytes into rx after a repeated start (rx_len 0: write only)
+ */
+typedef esp_err_t (*ina219_transfer_fn)(void *ctx, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len);
+
+/**
+ * @brief Monitor settings
+ */
+typedef struct {
+    i2c_master_bus_handle_t bus;                // Bus created by the caller; unused with a transfer function
+    ina219_transfer_fn transfer;                // NULL: the driver adds the monitor to bus itself
+    void *transfer_ctx;                         // Passed to transfer
+    uint8_t address;                            // INA219_I2C_ADDR_DEFAULT, or 0x41..0x4F by A0/A1
+    uint32_t shunt_mohm;                        // Shunt resistance, milliohm
+    ina219_range_t range;
+    ina219_avg_t avg;
+} ina219_config_t;
+
+/**
+ * @brief Driver state for one monitor
+ */
+typedef struct {
+    i2c_master_dev_handle_t dev;
+    ina219_config_t config;
+} ina219_t;
+
+// =============================
+// Function Prototypes
+// =============================
+
+/**
+ * @brief Attach to the monitor, reset it and start continuous shunt conversion
+ *
+ * @param monitor Driver state to fill in
+ * @param config Settings
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG for a zero shunt, ESP_ERR_NOT_FOUND if the
+ *         configuration did not read back, or the I2C error
+ */
+esp_err_t ina219_init(ina219_t *monitor, const ina219_config_t *config);
+
+/**
+ * @brief Read the latest averaged current
+ *
+ * @param monitor Initialized monitor
+ * @param current_ua Current in microamps; negative when it flows backwards through the shunt
+ * @return esp_err_t ESP_OK or the I2C error
+ */
+esp_err_t ina219_read_current(ina219_t *monitor, int32_t *current_ua);
+
+/**
+ * @brief Time one averaged result takes, and so the period to poll at
+ */
+uint32_t ina219_conversion_us(const ina219_t *monitor);
+
+/**
+ * @brief Power the monitor down (about 6 uA instead of 1 mA) and detach from the bus, or drop the transfer function
+ */
+esp_err_t ina219_deinit(ina219_t *monitor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INA219_H
@@ -9,55 +9,14 @@
  * @copyright Copyright (c) 2025 John Devine
  */
 
-// =============================
-// Function Prototypes
-// =============================
-static const char* format_cpu_frequency(void);
-static const char* format_cpu_temperature(void);
-static const char* format_free_heap(void);
-static const char* format_min_free_heap(void);
-static const char* format_uptime(void);
-static const char* format_reset_reason(void);
-static const char* format_task_runtime_stats(void);
-static const char* format_task_priority(void);
-static const char* format_power_mode(void);
-static const char* format_light_sleep_duration(void);
-static const char* format_deep_sleep_duration(void);
-static const char* format_vdd33_voltage(void);
-static const char* format_current_consumption(void);
-static const char* format_wifi_rssi(void);
-static const char* format_wifi_tx_power(void);
-static const char* format_wifi_tx_rx_bytes(void);
-static const char* format_ip_address(void);
-static const char* format_wifi_status(void);
-static const char* format_network_speed(void);
-static const char* format_bt_ble_rssi(void);
-static const char* format_bt_ble_connected_devices(void);
-static const char* format_flash_usage(void);
-static const char* format_flash_rw_operations(void);
-static const char* format_spiffs_usage(void);
-static const char* format_i2c_bus_errors(void);
-static const char* format_spi_performance(void);
-static const char* format_gpio_status(void);
-static const char* format_chip_id(void);
-static const char* format_mac_address(void);
-static const char* format_flash_size(void);
-static const char* format_chip_revision(void);
-static const char* format_core_count(void);
-static const char* format_task_count(void);
-static const char* format_task_stack_hwm(void);
-static const char* format_boot_count(void);
-static const char* format_crash_count(void);
-static const char* format_ota_update_status(void);
-static const char* format_last_update_time(void);
-static const char* format_app_specific_timers(void);
-
 // =============================
 // Includes
 // =============================
 #include "SystemMetrics.h"
 #include "../../../include/version.h"
+#include "../../../include/storage.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
 #include <time.h>
@@ -69,19 +28,24 @@ static const char* format_app_specific_timers(void);
 #include "esp_wifi.h"
 #include "esp_netif.h"
 #include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
 #include "esp_mac.h"
 #include "esp_pm.h"
 #include "esp_sleep.h"
 #include "esp_ota_ops.h"
+#include "esp_private/esp_clk.h"
 #include "esp_adc/adc_oneshot.h"
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
-#include "esp_spiffs.h"
 #include "esp_partition.h"
 #include "driver/gpio.h"
 #include "driver/i2c.h"
 #include "driver/spi_master.h"
+#include "soc/soc_caps.h"
+#if SOC_TEMP_SENSOR_SUPPORTED
 #include "driver/temperature_sensor.h"
+#endif
 #ifdef CONFIG_BT_ENABLED
 #include "esp_bt.h"
 #include "esp_gap_ble_api.h"
@@ -91,33 +55,349 @@ static const char* format_app_specific_timers(void);
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+// =============================
+// Function Prototypes
+// =============================
+static metric_error_t format_cpu_frequency(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_cpu_temperature(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_free_heap(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_min_free_heap(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_heap_largest_block(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_heap_fragmentation(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_uptime(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_reset_reason(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_task_runtime_stats(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_task_priority(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_power_mode(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_light_sleep_duration(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_deep_sleep_duration(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_vdd33_voltage(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_current_consumption(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_wifi_rssi(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_wifi_tx_power(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_wifi_tx_rx_bytes(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_ip_address(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_wifi_status(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_network_speed(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_bt_ble_rssi(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_bt_ble_connected_devices(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_flash_usage(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_flash_rw_operations(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_spiffs_usage(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_i2c_bus_errors(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_spi_performance(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_gpio_status(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_chip_id(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_mac_address(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_flash_size(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_chip_revision(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_core_count(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_task_count(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_task_stack_hwm(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_boot_count(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_crash_count(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_ota_update_status(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_last_update_time(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_app_specific_timers(metric_batch_t* b, char* buf, size_t len);
+static metric_error_t format_provided(system_metric_t metric, char* buf, size_t len);
+typedef metric_error_t (*metric_reader_fn)(metric_batch_t* b, metric_value_t* v);
+typedef metric_error_t (*metric_formatter_fn)(metric_batch_t* b, char* buf, size_t len);
+static void set_int(metric_value_t* v, int64_t value, const char* unit);
+static void set_float(metric_value_t* v, float value, const char* unit);
+static metric_error_t set_error(metric_value_t* v, metric_error_t err, const char* message);
+static metric_error_t read_metric(metric_batch_t* b, system_metric_t metric, metric_value_t* v, char* buf, size_t len);
+static metric_error_t read_value(metric_batch_t* b, system_metric_t metric, metric_value_t* value);
+static metric_error_t format_value(metric_batch_t* b, system_metric_t metric, char* buf, size_t len);
+static const wifi_ap_record_t* batch_ap_info(metric_batch_t* b);
+static void batch_ota_partitions(metric_batch_t* b);
+static const esp_partition_t* batch_data_partition(metric_batch_t* b);
+static metric_error_t cached_read(metric_batch_t* b, system_metric_t metric, metric_value_t* v);
+static metric_error_t cached_format(metric_batch_t* b, system_metric_t metric, char* buf, size_t len);
+static bool cache_lookup(system_metric_t metric, metric_value_t* v, metric_error_t* err);
+static void cache_store(system_metric_t metric, const metric_value_t* v, metric_error_t err);
+static bool cache_init(void);
+static void account_boot(void);
+static bool is_crash_reset(esp_reset_reason_t reason);
+static metric_error_t read_cpu_frequency(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_cpu_temperature(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_free_heap(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_min_free_heap(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_heap_largest_block(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_heap_fragmentation(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_uptime(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_task_priority(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_vdd33_voltage(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_wifi_rssi(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_wifi_tx_power(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_flash_usage(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_spiffs_usage(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_flash_size(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_core_count(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_task_count(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_task_runtime_stats(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_task_stack_hwm(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_boot_count(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_app_specific_timers(metric_batch_t* b, metric_value_t* v);
+static metric_error_t read_crash_count(metric_batch_t* b, metric_value_t* v);
+
 // =============================
 // Constants & Definitions
 // =============================
 static const char *TAG = "SYSTEM_METRICS";
 
 // Register SystemMetrics library version
-REGISTER_VERSION(SystemMetrics, "1.0.1", "2025-10-18");
+REGISTER_VERSION(SystemMetrics, "1.2.0", "2026-10-15");
 
-#define SYSTEM_METRICS_VERSION "1.0.1"
+#define SYSTEM_METRICS_VERSION "1.2.0"
 #define SYSTEM_METRICS_BUILD_DATE __DATE__
 
-// Static buffer for metric strings
+// metric_batch_t.fetched: shared reads a batch has already made
+#define BATCH_AP_INFO         (1u << 0)
+#define BATCH_OTA_PARTITIONS  (1u << 1)
+#define BATCH_DATA_PARTITION  (1u << 2)
+
+// Static buffer behind the non-reentrant get_system_metric()
 static char metric_buffer[METRIC_MAX_STRING_LENGTH];
+static metric_provider_fn metric_providers[METRIC_COUNT];  // Application-supplied metrics
 
-// Last error code
+// Last error code of get_system_metric()
 static metric_error_t last_error = METRIC_OK;
 
 // Temperature sensor handle
+#if SOC_TEMP_SENSOR_SUPPORTED
 static temperature_sensor_handle_t temp_sensor = NULL;
+#endif
 
 // ADC handle for voltage measurement
 static adc_oneshot_unit_handle_t adc_handle = NULL;
 static adc_cali_handle_t adc_cali_handle = NULL;
+static system_metrics_mv_fn vdd33_reader = NULL;   // Application-supplied METRIC_VDD33_VOLTAGE
 
 // NVS handles for persistent counters
 static nvs_handle_t metrics_nvs_handle = 0;
 
+#define BOOT_RECORD_MAGIC 0x424F4F54  // "BOOT"
+
+// Boot and crash counts, settled once per boot by account_boot() and only
+// read afterwards. RTC memory keeps them across soft resets and deep sleep,
+// so a wake from deep sleep is not counted and costs no NVS write.
+typedef struct {
+    uint32_t magic;
+    uint32_t boot_count;
+    uint32_t crash_count;
+    uint32_t check;                   // ~(boot_count ^ crash_count), catches RTC garbage
+} boot_record_t;
+
+static RTC_NOINIT_ATTR boot_record_t boot_record;
+static esp_reset_reason_t boot_reset_reason = ESP_RST_UNKNOWN;
+static bool boot_accounted = false;
+
+// Last SPIFFS capacity seen by read_spiffs_usage()
+static size_t spiffs_total_bytes = 0;
+
+// Cached result of one metric; text metrics keep their formatted string in value.s
+typedef struct {
+    metric_value_t value;
+    metric_error_t error;
+    int64_t read_at_us;
+    bool valid;
+} metric_cache_entry_t;
+
+// Entries exist only for metrics with a TTL; cache_slot maps metric to entry
+static metric_cache_entry_t* metric_cache = NULL;
+static int8_t cache_slot[METRIC_COUNT];
+static portMUX_TYPE cache_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Everything fixed about a metric, in one row
+ *
+ * ttl_ms is how long a result stays valid. Metrics left at METRIC_TTL_NONE
+ * are read on every call: cheap counters, and the task metrics, which
+ * describe the calling task. read is the typed reader of a numeric metric,
+ * NULL for text; format is NULL for metrics that exist only as providers.
+ */
+typedef struct {
+    const char* name;
+    const char* unit;              // Of the typed value; "" if unitless or text
+    metric_group_t group;
+    uint32_t ttl_ms;
+    metric_reader_fn read;
+    metric_formatter_fn format;
+    const char* description;
+} metric_desc_t;
+
+static const metric_desc_t metric_descs[] = {
+    [METRIC_CPU_FREQUENCY] = { "cpu_frequency", "MHz", METRIC_GROUP_SYSTEM, METRIC_TTL_STATIC,
+        read_cpu_frequency, format_cpu_frequency,
+        "CPU clock frequency in MHz" },
+    [METRIC_CPU_TEMPERATURE] = { "cpu_temperature", "°C", METRIC_GROUP_SYSTEM, 5000,
+        read_cpu_temperature, format_cpu_temperature,
+        "Internal temperature sensor in Celsius" },
+    [METRIC_FREE_HEAP] = { "free_heap", "bytes", METRIC_GROUP_SYSTEM, METRIC_TTL_NONE,
+        read_free_heap, format_free_heap,
+        "Available heap memory in bytes" },
+    [METRIC_MIN_FREE_HEAP] = { "min_free_heap", "bytes", METRIC_GROUP_SYSTEM, METRIC_TTL_NONE,
+        read_min_free_heap, format_min_free_heap,
+        "Minimum free heap size since boot" },
+    [METRIC_UPTIME] = { "uptime", "ms", METRIC_GROUP_SYSTEM, METRIC_TTL_NONE,
+        read_uptime, format_uptime,
+        "Time since boot in milliseconds" },
+    [METRIC_RESET_REASON] = { "reset_reason", "", METRIC_GROUP_SYSTEM, METRIC_TTL_STATIC,
+        NULL, format_reset_reason,
+        "Cause of last reset/reboot" },
+    [METRIC_TASK_RUNTIME_STATS] = { "task_runtime_stats", "tasks", METRIC_GROUP_SYSTEM, METRIC_TTL_NONE,
+        read_task_runtime_stats, format_task_runtime_stats,
+        "CPU time used by current task" },
+    [METRIC_TASK_PRIORITY] = { "task_priority", "", METRIC_GROUP_SYSTEM, METRIC_TTL_NONE,
+        read_task_priority, format_task_priority,
+        "Priority level of current task" },
+    [METRIC_POWER_MODE] = { "power_mode", "", METRIC_GROUP_POWER, METRIC_TTL_STATIC,
+        NULL, format_power_mode,
+        "Current power saving mode" },
+    [METRIC_LIGHT_SLEEP_DURATION] = { "light_sleep_duration", "", METRIC_GROUP_POWER, METRIC_TTL_STATIC,
+        NULL, format_light_sleep_duration,
+        "Total time spent in light sleep mode" },
+    [METRIC_DEEP_SLEEP_DURATION] = { "deep_sleep_duration", "", METRIC_GROUP_POWER, METRIC_TTL_STATIC,
+        NULL, format_deep_sleep_duration,
+        "Total time spent in deep sleep mode" },
+    [METRIC_VDD33_VOLTAGE] = { "vdd33_voltage", "V", METRIC_GROUP_POWER, 2000,
+        read_vdd33_voltage, format_vdd33_voltage,
+        "Supply voltage level (3.3V rail)" },
+    [METRIC_CURRENT_CONSUMPTION] = { "current_consumption", "", METRIC_GROUP_POWER, METRIC_TTL_STATIC,
+        NULL, format_current_consumption,
+        "Current power consumption in microamps" },
+    [METRIC_WIFI_RSSI] = { "wifi_rssi", "dBm", METRIC_GROUP_WIFI, 1000,
+        read_wifi_rssi, format_wifi_rssi,
+        "WiFi signal strength in dBm" },
+    [METRIC_WIFI_TX_POWER] = { "wifi_tx_power", "dBm", METRIC_GROUP_WIFI, 5000,
+        read_wifi_tx_power, format_wifi_tx_power,
+        "WiFi transmission power level" },
+    [METRIC_WIFI_TX_RX_BYTES] = { "wifi_tx_rx_bytes", "", METRIC_GROUP_WIFI, METRIC_TTL_STATIC,
+        NULL, format_wifi_tx_rx_bytes,
+        "Data transmitted/received over WiFi" },
+    [METRIC_IP_ADDRESS] = { "ip_address", "", METRIC_GROUP_WIFI, 2000,
+        NULL, format_ip_address,
+        "Current IP address" },
+    [METRIC_WIFI_STATUS] = { "wifi_status", "", METRIC_GROUP_WIFI, 2000,
+        NULL, format_wifi_status,
+        "WiFi connection status" },
+    [METRIC_NETWORK_SPEED] = { "network_speed", "", METRIC_GROUP_WIFI, 5000,
+        NULL, format_network_speed,
+        "Current network connection speed" },
+    [METRIC_BT_BLE_RSSI] = { "bt_ble_rssi", "", METRIC_GROUP_BLUETOOTH, METRIC_TTL_STATIC,
+        NULL, format_bt_ble_rssi,
+        "Bluetooth/BLE signal strength in dBm" },
+    [METRIC_BT_BLE_CONNECTED_DEVICES] = { "bt_ble_connected_devices", "", METRIC_GROUP_BLUETOOTH, METRIC_TTL_STATIC,
+        NULL, format_bt_ble_connected_devices,
+        "Number of connected BT/BLE devices" },
+    [METRIC_FLASH_USAGE] = { "flash_usage", "bytes", METRIC_GROUP_STORAGE, METRIC_TTL_STATIC,
+        read_flash_usage, format_flash_usage,
+        "Used/available flash storage space" },
+    [METRIC_FLASH_RW_OPERATIONS] = { "flash_rw_operations", "", METRIC_GROUP_STORAGE, METRIC_TTL_STATIC,
+        NULL, format_flash_rw_operations,
+        "Flash read/write operation counters" },
+    [METRIC_SPIFFS_USAGE] = { "spiffs_usage", "bytes", METRIC_GROUP_STORAGE, 10000,
+        read_spiffs_usage, format_spiffs_usage,
+        "SPIFFS filesystem space utilization" },
+    [METRIC_I2C_BUS_ERRORS] = { "i2c_bus_errors", "", METRIC_GROUP_STORAGE, METRIC_TTL_STATIC,
+        NULL, format_i2c_bus_errors,
+        "I2C bus error count" },
+    [METRIC_SPI_PERFORMANCE] = { "spi_performance", "", METRIC_GROUP_STORAGE, METRIC_TTL_STATIC,
+        NULL, format_spi_performance,
+        "SPI bus performance metrics" },
+    [METRIC_GPIO_STATUS] = { "gpio_status", "", METRIC_GROUP_STORAGE, METRIC_TTL_STATIC,
+        NULL, format_gpio_status,
+        "GPIO pin status and configuration" },
+    [METRIC_CHIP_ID] = { "chip_id", "", METRIC_GROUP_HARDWARE, METRIC_TTL_STATIC,
+        NULL, format_chip_id,
+        "Unique ESP32 chip identifier" },
+    [METRIC_MAC_ADDRESS] = { "mac_address", "", METRIC_GROUP_HARDWARE, METRIC_TTL_STATIC,
+        NULL, format_mac_address,
+        "Factory-assigned MAC address" },
+    [METRIC_FLASH_SIZE] = { "flash_size", "bytes", METRIC_GROUP_HARDWARE, METRIC_TTL_STATIC,
+        read_flash_size, format_flash_size,
+        "Flash memory size in bytes" },
+    [METRIC_CHIP_REVISION] = { "chip_revision", "", METRIC_GROUP_HARDWARE, METRIC_TTL_STATIC,
+        NULL, format_chip_revision,
+        "Silicon revision of the chip" },
+    [METRIC_CORE_COUNT] = { "core_count", "cores", METRIC_GROUP_HARDWARE, METRIC_TTL_STATIC,
+        read_core_count, format_core_count,
+        "Number of available CPU cores" },
+    [METRIC_TASK_COUNT] = { "task_count", "tasks", METRIC_GROUP_TASKS, METRIC_TTL_NONE,
+        read_task_count, format_task_count,
+        "Number of active FreeRTOS tasks" },
+    [METRIC_TASK_STACK_HWM] = { "task_stack_hwm", "bytes", METRIC_GROUP_TASKS, METRIC_TTL_NONE,
+        read_task_stack_hwm, format_task_stack_hwm,
+        "Current task stack high water mark" },
+    [METRIC_BOOT_COUNT] = { "boot_count", "boots", METRIC_GROUP_APPLICATION, METRIC_TTL_STATIC,
+        read_boot_count, format_boot_count,
+        "Number of times device has booted" },
+    [METRIC_CRASH_COUNT] = { "crash_count", "crashes", METRIC_GROUP_APPLICATION, METRIC_TTL_STATIC,
+        read_crash_count, format_crash_count,
+        "Number of unexpected resets" },
+    [METRIC_OTA_UPDATE_STATUS] = { "ota_update_status", "", METRIC_GROUP_APPLICATION, 5000,
+        NULL, format_ota_update_status,
+        "OTA update status and version" },
+    [METRIC_LAST_UPDATE_TIME] = { "last_update_time", "", METRIC_GROUP_APPLICATION, 10000,
+        NULL, format_last_update_time,
+        "Timestamp of last system update" },
+    [METRIC_APP_SPECIFIC_TIMERS] = { "app_specific_timers", "s", METRIC_GROUP_APPLICATION, METRIC_TTL_NONE,
+        read_app_specific_timers, format_app_specific_timers,
+        "Application-specific timer values" },
+    [METRIC_HTTP_REQUESTS] = { "http_requests", "", METRIC_GROUP_APPLICATION, METRIC_TTL_NONE,
+        NULL, NULL,
+        "HTTP requests served and failed" },
+    [METRIC_HTTP_LATENCY] = { "http_latency", "", METRIC_GROUP_APPLICATION, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Average and worst HTTP handler latency" },
+    [METRIC_CPU_LOAD] = { "cpu_load", "", METRIC_GROUP_CPU, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Busy percentage of each CPU core" },
+    [METRIC_CPU_IDLE] = { "cpu_idle", "", METRIC_GROUP_CPU, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Idle percentage, last interval and rolling average" },
+    [METRIC_TASK_STACK_MIN] = { "task_stack_min", "", METRIC_GROUP_CPU, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Task with the least free stack across all tasks" },
+    [METRIC_HEAP_LARGEST_BLOCK] = { "heap_largest_block", "bytes", METRIC_GROUP_MEMORY, 1000,
+        read_heap_largest_block, format_heap_largest_block,
+        "Largest free block of internal RAM in bytes" },
+    [METRIC_HEAP_FRAGMENTATION] = { "heap_fragmentation", "%", METRIC_GROUP_MEMORY, 1000,
+        read_heap_fragmentation, format_heap_fragmentation,
+        "Share of free internal RAM outside the largest block" },
+    [METRIC_HEAP_ALLOC_FAILURES] = { "heap_alloc_failures", "", METRIC_GROUP_MEMORY, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Failed allocations since boot and the last one seen" },
+    [METRIC_NET_PACKETS] = { "net_packets", "", METRIC_GROUP_WIFI, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Transmitted/received packets per network interface" },
+    [METRIC_NET_DROPS] = { "net_drops", "", METRIC_GROUP_WIFI, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Packets dropped by the IP stack and failed ESP-NOW sends" },
+    [METRIC_DNS_QUERIES] = { "dns_queries", "", METRIC_GROUP_WIFI, METRIC_TTL_NONE,
+        NULL, NULL,
+        "DNS queries per second, total and dropped by the rate limit" },
+    [METRIC_DNS_TOP_NAMES] = { "dns_top_names", "", METRIC_GROUP_WIFI, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Most frequently queried DNS names" },
+    [METRIC_BOOT_TRACE] = { "boot_trace", "", METRIC_GROUP_APPLICATION, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Time from reset to ready and the slowest startup stage" },
+    [METRIC_SAMPLER_JITTER] = { "sampler_jitter", "", METRIC_GROUP_APPLICATION, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Sensor sampling jitter against the ideal schedule, overruns and dropped samples" },
+    [METRIC_ESPNOW_BATCH] = { "espnow_batch", "", METRIC_GROUP_APPLICATION, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Records per ESP-NOW frame, adaptive batch target, delivery rate and resends" },
+    [METRIC_GATEWAY_NODES] = { "gateway_nodes", "", METRIC_GROUP_APPLICATION, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Nodes reporting to the gateway, and the one with the lowest link quality" },
+    [METRIC_LONG_OP_SLICES] = { "long_op_slices", "", METRIC_GROUP_APPLICATION, METRIC_TTL_NONE,
+        NULL, NULL,
+        "Longest time a flash erase or file read held its task before yielding, per kind of operation" },
+};
+_Static_assert(sizeof(metric_descs) / sizeof(metric_descs[0]) == METRIC_COUNT, "every metric needs a row");
+
 // =============================
 // Function Definitions
 // =============================
@@ -140,12 +420,8 @@ bool system_metrics_init(void)
         ESP_LOGW(TAG, "NVS open failed: %s", esp_err_to_name(ret));
     }
     
-    // Initialize temperature sensor (only on supported ESP32 variants)
-#if defined(CONFIG_IDF_TARGET_ESP32S2) \
- || defined(CONFIG_IDF_TARGET_ESP32S3) \
- || defined(CONFIG_IDF_TARGET_ESP32C2) \
- || defined(CONFIG_IDF_TARGET_ESP32C3) \
- || defined(CONFIG_IDF_TARGET_ESP32C6)
+    // On-die temperature sensor: S2, S3 and the C series have one, the original ESP32 does not
+#if SOC_TEMP_SENSOR_SUPPORTED
     temperature_sensor_config_t temp_config = TEMPERATURE_SENSOR_CONFIG_DEFAULT(-10, 80);
     ret = temperature_sensor_install(&temp_config, &temp_sensor);
     if (ret != ESP_OK) {
@@ -163,7 +439,6 @@ bool system_metrics_init(void)
     }
 #else
     // Original ESP32 - no built-in temperature sensor
-    temp_sensor = NULL;
     ESP_LOGI(TAG, "Temperature sensor not available on ESP32 (use external sensor)");
 #endif
     
@@ -196,241 +471,702 @@ bool system_metrics_init(void)
         }
     }
     
-    // Update boot count
-    if (metrics_nvs_handle != 0) {
-        uint32_t boot_count = 0;
-        size_t required_size = sizeof(boot_count);
-        nvs_get_blob(metrics_nvs_handle, "boot_count", &boot_count, &required_size);
-        boot_count++;
-        nvs_set_blob(metrics_nvs_handle, "boot_count", &boot_count, sizeof(boot_count));
-        nvs_commit(metrics_nvs_handle);
-        ESP_LOGI(TAG, "Boot count: %lu", boot_count);
+    // Count this boot, and the crash behind it if any
+    account_boot();
+    
+    // Static metrics are read once here and served from the cache from then on
+    if (cache_init()) {
+        char value[METRIC_MAX_STRING_LENGTH];
+        metric_batch_t batch;
+        system_metrics_batch_init(&batch, 0, true);
+        for (int i = 0; i < METRIC_COUNT; i++) {
+            if (metric_descs[i].ttl_ms == METRIC_TTL_STATIC) {
+                format_value(&batch, (system_metric_t)i, value, sizeof(value));
+            }
+        }
     }
     
     ESP_LOGI(TAG, "System Metrics Library initialized");
     return true;
 }
 
-const char* get_system_metric(system_metric_t metric)
+const char* get_system_metric_r(system_metric_t metric, char* buf, size_t buf_len, metric_error_t* err)
 {
-    last_error = METRIC_OK;
+    metric_batch_t batch;
+    system_metrics_batch_init(&batch, 0, true);
+    metric_error_t result = format_value(&batch, metric, buf, buf_len);
     
-    if (metric >= METRIC_COUNT) {
-        last_error = METRIC_ERROR_INVALID_ID;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Invalid metric ID (%d)", metric);
-        return metric_buffer;
-    }
-    
-    switch (metric) {
-        case METRIC_CPU_FREQUENCY:
-            return format_cpu_frequency();
-        case METRIC_CPU_TEMPERATURE:
-            return format_cpu_temperature();
-        case METRIC_FREE_HEAP:
-            return format_free_heap();
-        case METRIC_MIN_FREE_HEAP:
-            return format_min_free_heap();
-        case METRIC_UPTIME:
-            return format_uptime();
-        case METRIC_RESET_REASON:
-            return format_reset_reason();
-        case METRIC_TASK_RUNTIME_STATS:
-            return format_task_runtime_stats();
-        case METRIC_TASK_PRIORITY:
-            return format_task_priority();
-        case METRIC_POWER_MODE:
-            return format_power_mode();
-        case METRIC_LIGHT_SLEEP_DURATION:
-            return format_light_sleep_duration();
-        case METRIC_DEEP_SLEEP_DURATION:
-            return format_deep_sleep_duration();
-        case METRIC_VDD33_VOLTAGE:
-            return format_vdd33_voltage();
-        case METRIC_CURRENT_CONSUMPTION:
-            return format_current_consumption();
-        case METRIC_WIFI_RSSI:
-            return format_wifi_rssi();
-        case METRIC_WIFI_TX_POWER:
-            return format_wifi_tx_power();
-        case METRIC_WIFI_TX_RX_BYTES:
-            return format_wifi_tx_rx_bytes();
-        case METRIC_IP_ADDRESS:
-            return format_ip_address();
-        case METRIC_WIFI_STATUS:
-            return format_wifi_status();
-        case METRIC_NETWORK_SPEED:
-            return format_network_speed();
-        case METRIC_BT_BLE_RSSI:
-            return format_bt_ble_rssi();
-        case METRIC_BT_BLE_CONNECTED_DEVICES:
-            return format_bt_ble_connected_devices();
-        case METRIC_FLASH_USAGE:
-            return format_flash_usage();
-        case METRIC_FLASH_RW_OPERATIONS:
-            return format_flash_rw_operations();
-        case METRIC_SPIFFS_USAGE:
-            return format_spiffs_usage();
-        case METRIC_I2C_BUS_ERRORS:
-            return format_i2c_bus_errors();
-        case METRIC_SPI_PERFORMANCE:
-            return format_spi_performance();
-        case METRIC_GPIO_STATUS:
-            return format_gpio_status();
-        case METRIC_CHIP_ID:
-            return format_chip_id();
-        case METRIC_MAC_ADDRESS:
-            return format_mac_address();
-        case METRIC_FLASH_SIZE:
-            return format_flash_size();
-        case METRIC_CHIP_REVISION:
-            return format_chip_revision();
-        case METRIC_CORE_COUNT:
-            return format_core_count();
-        case METRIC_TASK_COUNT:
-            return format_task_count();
-        case METRIC_TASK_STACK_HWM:
-            return format_task_stack_hwm();
-        case METRIC_BOOT_COUNT:
-            return format_boot_count();
-        case METRIC_CRASH_COUNT:
-            return format_crash_count();
-        case METRIC_OTA_UPDATE_STATUS:
-            return format_ota_update_status();
-        case METRIC_LAST_UPDATE_TIME:
-            return format_last_update_time();
-        case METRIC_APP_SPECIFIC_TIMERS:
-            return format_app_specific_timers();
+    if (err != NULL) {
+        *err = result;
+    }
+    return buf;
+}
+
+metric_error_t get_metric_value(system_metric_t metric, metric_value_t* value)
+{
+    if (value == NULL) {
+        return METRIC_ERROR_BUFFER_TOO_SMALL;
+    }
+    metric_batch_t batch;
+    system_metrics_batch_init(&batch, 0, false);
+    return read_value(&batch, metric, value);
+}
+
+void system_metrics_batch_init(metric_batch_t* batch, metric_mask_t metrics, bool text)
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->pending = metrics & METRIC_MASK_ALL;
+    batch->text = text;
+}
+
+size_t system_metrics_collect(metric_batch_t* batch, metric_sample_t* out, size_t out_len)
+{
+    size_t n = 0;
+    while (batch->pending != 0 && n < out_len) {
+        // Lowest id first, so results come out in id order
+        system_metric_t metric = (system_metric_t)__builtin_ctzll(batch->pending);
+        batch->pending &= batch->pending - 1;
+        
+        metric_sample_t* sample = &out[n++];
+        sample->metric = metric;
+        if (batch->text) {
+            sample->value.type = METRIC_VALUE_STRING;
+            sample->value.unit = "";
+            sample->error = format_value(batch, metric, sample->value.s, sizeof(sample->value.s));
+        } else {
+            sample->error = read_value(batch, metric, &sample->value);
+        }
+    }
+    return n;
+}
+
+metric_mask_t get_metric_group_mask(metric_group_t group)
+{
+    metric_mask_t mask = 0;
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        if (metric_descs[i].group == group) {
+            mask |= METRIC_MASK(i);
+        }
+    }
+    return mask;
+}
+
+int format_metric_value(const metric_value_t* value, char* buf, size_t buf_len)
+{
+    const char* unit = value->unit != NULL ? value->unit : "";
+    const char* sep = unit[0] != '\0' ? " " : "";
+    
+    switch (value->type) {
+        case METRIC_VALUE_INT:
+            return snprintf(buf, buf_len, "%" PRId64 "%s%s", value->i, sep, unit);
+        case METRIC_VALUE_FLOAT:
+            return snprintf(buf, buf_len, "%.2f%s%s", value->f, sep, unit);
+        case METRIC_VALUE_STRING:
         default:
-            last_error = METRIC_ERROR_INVALID_ID;
-            snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Unimplemented metric (%d)", metric);
-            return metric_buffer;
+            return snprintf(buf, buf_len, "%s", value->s);
     }
 }
 
+const char* get_system_metric(system_metric_t metric)
+{
+    return get_system_metric_r(metric, metric_buffer, sizeof(metric_buffer), &last_error);
+}
+
 metric_error_t get_metric_error(void)
 {
     return last_error;
 }
 
-const char* get_metric_description(system_metric_t metric)
+void get_system_metrics_snapshot(system_metrics_snapshot_t* snapshot)
 {
-    static const char* descriptions[] = {
-        [METRIC_CPU_FREQUENCY] = "CPU clock frequency in MHz",
-        [METRIC_CPU_TEMPERATURE] = "Internal temperature sensor in Celsius",
-        [METRIC_FREE_HEAP] = "Available heap memory in bytes",
-        [METRIC_MIN_FREE_HEAP] = "Minimum free heap size since boot",
-        [METRIC_UPTIME] = "Time since boot in milliseconds",
-        [METRIC_RESET_REASON] = "Cause of last reset/reboot",
-        [METRIC_TASK_RUNTIME_STATS] = "CPU time used by current task",
-        [METRIC_TASK_PRIORITY] = "Priority level of current task",
-        [METRIC_POWER_MODE] = "Current power saving mode",
-        [METRIC_LIGHT_SLEEP_DURATION] = "Total time spent in light sleep mode",
-        [METRIC_DEEP_SLEEP_DURATION] = "Total time spent in deep sleep mode",
-        [METRIC_VDD33_VOLTAGE] = "Supply voltage level (3.3V rail)",
-        [METRIC_CURRENT_CONSUMPTION] = "Current power consumption in microamps",
-        [METRIC_WIFI_RSSI] = "WiFi signal strength in dBm",
-        [METRIC_WIFI_TX_POWER] = "WiFi transmission power level",
-        [METRIC_WIFI_TX_RX_BYTES] = "Data transmitted/received over WiFi",
-        [METRIC_IP_ADDRESS] = "Current IP address",
-        [METRIC_WIFI_STATUS] = "WiFi connection status",
-        [METRIC_NETWORK_SPEED] = "Current network connection speed",
-        [METRIC_BT_BLE_RSSI] = "Bluetooth/BLE signal strength in dBm",
-        [METRIC_BT_BLE_CONNECTED_DEVICES] = "Number of connected BT/BLE devices",
-        [METRIC_FLASH_USAGE] = "Used/available flash storage space",
-        [METRIC_FLASH_RW_OPERATIONS] = "Flash read/write operation counters",
-        [METRIC_SPIFFS_USAGE] = "SPIFFS filesystem space utilization",
-        [METRIC_I2C_BUS_ERRORS] = "I2C bus error count",
-        [METRIC_SPI_PERFORMANCE] = "SPI bus performance metrics",
-        [METRIC_GPIO_STATUS] = "GPIO pin status and configuration",
-        [METRIC_CHIP_ID] = "Unique ESP32 chip identifier",
-        [METRIC_MAC_ADDRESS] = "Factory-assigned MAC address",
-        [METRIC_FLASH_SIZE] = "Flash memory size in bytes",
-        [METRIC_CHIP_REVISION] = "Silicon revision of the chip",
-        [METRIC_CORE_COUNT] = "Number of available CPU cores",
-        [METRIC_TASK_COUNT] = "Number of active FreeRTOS tasks",
-        [METRIC_TASK_STACK_HWM] = "Current task stack high water mark",
-        [METRIC_BOOT_COUNT] = "Number of times device has booted",
-        [METRIC_CRASH_COUNT] = "Number of unexpected resets",
-        [METRIC_OTA_UPDATE_STATUS] = "OTA update status and version",
-        [METRIC_LAST_UPDATE_TIME] = "Timestamp of last system update",
-        [METRIC_APP_SPECIFIC_TIMERS] = "Application-specific timer values"
-    };
+    if (snapshot == NULL) {
+        return;
+    }
+    memset(snapshot, 0, sizeof(*snapshot));
+    
+    snapshot->uptime_us = esp_timer_get_time();
+    snapshot->free_heap = esp_get_free_heap_size();
+    snapshot->min_free_heap = esp_get_minimum_free_heap_size();
+    snapshot->task_count = uxTaskGetNumberOfTasks();
+    
+    // Driver, sensor and filesystem reads go through the cache like every other consumer
+    metric_batch_t batch;
+    system_metrics_batch_init(&batch, 0, false);
+    metric_value_t v;
+    if (cached_read(&batch, METRIC_WIFI_RSSI, &v) == METRIC_OK) {
+        snapshot->wifi_connected = true;
+        snapshot->wifi_rssi = (int8_t)v.i;
+    }
     
+    if (cached_read(&batch, METRIC_SPIFFS_USAGE, &v) == METRIC_OK) {
+        snapshot->spiffs_mounted = true;
+        snapshot->spiffs_used = (size_t)v.i;
+        snapshot->spiffs_total = spiffs_total_bytes;
+    }
+    
+    if (cached_read(&batch, METRIC_VDD33_VOLTAGE, &v) == METRIC_OK) {
+        snapshot->vdd33_valid = true;
+        snapshot->vdd33_mv = (int)(v.f * 1000.0f + 0.5f);
+    }
+    if (cached_read(&batch, METRIC_CPU_TEMPERATURE, &v) == METRIC_OK) {
+        snapshot->cpu_temperature_valid = true;
+        snapshot->cpu_temperature_c = v.f;
+    }
+}
+
+uint32_t get_metric_ttl_ms(system_metric_t metric)
+{
+    return metric < METRIC_COUNT ? metric_descs[metric].ttl_ms : METRIC_TTL_NONE;
+}
+
+void invalidate_metric_cache(system_metric_t metric)
+{
+    if (metric_cache == NULL) {
+        return;
+    }
+    
+    portENTER_CRITICAL(&cache_lock);
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        if (cache_slot[i] >= 0 && (metric == METRIC_COUNT || metric == (system_metric_t)i)) {
+            metric_cache[cache_slot[i]].valid = false;
+        }
+    }
+    portEXIT_CRITICAL(&cache_lock);
+}
+
+const char* get_metric_description(system_metric_t metric)
+{
     if (metric >= METRIC_COUNT) {
         return "Invalid metric";
     }
     
-    return descriptions[metric];
+    return metric_descs[metric].description;
+}
+
+bool get_metric_info(system_metric_t metric, metric_info_t* info)
+{
+    if (metric >= METRIC_COUNT || info == NULL) {
+        return false;
+    }
+    
+    info->name = metric_descs[metric].name;
+    info->unit = metric_descs[metric].unit;
+    return true;
+}
+
+metric_group_t get_metric_group(system_metric_t metric)
+{
+    return metric < METRIC_COUNT ? metric_descs[metric].group : METRIC_GROUP_COUNT;
+}
+
+const char* get_metric_group_name(metric_group_t group)
+{
+    static const char* group_names[] = {
+        [METRIC_GROUP_SYSTEM] = "system",
+        [METRIC_GROUP_POWER] = "power",
+        [METRIC_GROUP_WIFI] = "wifi",
+        [METRIC_GROUP_BLUETOOTH] = "bluetooth",
+        [METRIC_GROUP_STORAGE] = "storage",
+        [METRIC_GROUP_HARDWARE] = "hardware",
+        [METRIC_GROUP_TASKS] = "tasks",
+        [METRIC_GROUP_APPLICATION] = "application",
+        [METRIC_GROUP_CPU] = "cpu",
+        [METRIC_GROUP_MEMORY] = "memory"
+    };
+    
+    if (group >= METRIC_GROUP_COUNT) {
+        return "unknown";
+    }
+    
+    return group_names[group];
+}
+
+metric_group_t get_metric_group_by_name(const char* name)
+{
+    if (name == NULL) {
+        return METRIC_GROUP_COUNT;
+    }
+    
+    for (int group = 0; group < METRIC_GROUP_COUNT; group++) {
+        if (strcmp(name, get_metric_group_name((metric_group_t)group)) == 0) {
+            return (metric_group_t)group;
+        }
+    }
+    
+    return METRIC_GROUP_COUNT;
+}
+
+const char* get_metric_error_name(metric_error_t error)
+{
+    switch (error) {
+        case METRIC_OK:
+            return "ok";
+        case METRIC_ERROR_INVALID_ID:
+            return "invalid_id";
+        case METRIC_ERROR_NOT_AVAILABLE:
+            return "not_available";
+        case METRIC_ERROR_NOT_SUPPORTED:
+            return "not_supported";
+        case METRIC_ERROR_HARDWARE_FAULT:
+            return "hardware_fault";
+        default:
+            return "unavailable";
+    }
+}
+
+int format_metric_json(char* buf, size_t buf_len, system_metric_t metric,
+                       const char* value, metric_error_t error)
+{
+    if (error == METRIC_OK && value != NULL) {
+        // Escape any quotes in the metric value for JSON safety
+        char escaped_value[192];
+        size_t j = 0;
+        for (int i = 0; value[i] && j < sizeof(escaped_value) - 2; i++) {
+            if (value[i] == '"' || value[i] == '\\') {
+                escaped_value[j++] = '\\';
+            }
+            escaped_value[j++] = value[i];
+        }
+        escaped_value[j] = '\0';
+        
+        return snprintf(buf, buf_len, 
+                "{\"id\":%d,\"value\":\"%s\",\"status\":\"ok\"}", 
+                (int)metric, escaped_value);
+    }
+    
+    // A successful read without a value is reported like any other failure
+    const char* error_msg = (error == METRIC_OK) ? "unavailable" : get_metric_error_name(error);
+    
+    return snprintf(buf, buf_len, 
+            "{\"id\":%d,\"value\":\"%s\",\"status\":\"error\"}", 
+            (int)metric, error_msg);
 }
 
 // =============================
-// =============================
-// Private Metric Formatters
+// Private Metric Readers
 // =============================
 
-static const char* format_cpu_frequency(void)
+static void set_int(metric_value_t* v, int64_t value, const char* unit)
 {
-    esp_chip_info_t chip_info;
-    esp_chip_info(&chip_info);
+    v->type = METRIC_VALUE_INT;
+    v->unit = unit;
+    v->i = value;
+}
+
+static void set_float(metric_value_t* v, float value, const char* unit)
+{
+    v->type = METRIC_VALUE_FLOAT;
+    v->unit = unit;
+    v->f = value;
+}
+
+/**
+ * @brief Fail a read, leaving the error text where get_system_metric_r() expects it
+ */
+static metric_error_t set_error(metric_value_t* v, metric_error_t err, const char* message)
+{
+    v->type = METRIC_VALUE_STRING;
+    v->unit = "";
+    snprintf(v->s, sizeof(v->s), "%s", message);
+    return err;
+}
+
+/**
+ * @brief Read a metric for its formatter, copying the error text to buf on failure
+ */
+static metric_error_t read_metric(metric_batch_t* b, system_metric_t metric, metric_value_t* v, char* buf, size_t len)
+{
+    metric_error_t err = cached_read(b, metric, v);
+    if (err != METRIC_OK) {
+        snprintf(buf, len, "%s", v->s);
+    }
+    return err;
+}
+
+/**
+ * @brief get_metric_value() within a batch
+ */
+static metric_error_t read_value(metric_batch_t* b, system_metric_t metric, metric_value_t* value)
+{
+    if (metric < METRIC_COUNT && metric_descs[metric].read != NULL && metric_providers[metric] == NULL) {
+        return cached_read(b, metric, value);
+    }
     
-    // Default ESP32 frequencies are 240MHz, 160MHz, 80MHz
-    // For simplicity, assume 240MHz as this is most common
-    uint32_t freq_mhz = 240; // Could be read from config
+    // Text-valued metric: its formatted string is the value
+    value->type = METRIC_VALUE_STRING;
+    value->unit = "";
+    return format_value(b, metric, value->s, sizeof(value->s));
+}
+
+/**
+ * @brief get_system_metric_r() within a batch
+ */
+static metric_error_t format_value(metric_batch_t* b, system_metric_t metric, char* buf, size_t len)
+{
+    if (buf == NULL || len == 0) {
+        return METRIC_ERROR_BUFFER_TOO_SMALL;
+    }
+    if (metric >= METRIC_COUNT) {
+        snprintf(buf, len, "ERROR: Invalid metric ID (%d)", metric);
+        return METRIC_ERROR_INVALID_ID;
+    }
+    if (metric_providers[metric] != NULL || metric_descs[metric].format == NULL) {
+        // Application-supplied, either replacing a built-in or provider-only
+        return format_provided(metric, buf, len);
+    }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "%lu MHz (default)", freq_mhz);
-    return metric_buffer;
+    buf[0] = '\0';
+    return cached_format(b, metric, buf, len);
 }
 
-static const char* format_cpu_temperature(void)
+/**
+ * @brief The STA's AP record, asked of the driver once per batch; NULL while not connected
+ */
+static const wifi_ap_record_t* batch_ap_info(metric_batch_t* b)
+{
+    if (!(b->fetched & BATCH_AP_INFO)) {
+        b->ap_err = esp_wifi_sta_get_ap_info(&b->ap);
+        b->fetched |= BATCH_AP_INFO;
+    }
+    return b->ap_err == ESP_OK ? &b->ap : NULL;
+}
+
+/**
+ * @brief Running and boot partitions, looked up once per batch
+ */
+static void batch_ota_partitions(metric_batch_t* b)
+{
+    if (!(b->fetched & BATCH_OTA_PARTITIONS)) {
+        b->running = esp_ota_get_running_partition();
+        b->boot = esp_ota_get_boot_partition();
+        b->fetched |= BATCH_OTA_PARTITIONS;
+    }
+}
+
+/**
+ * @brief First data partition, looked up once per batch
+ */
+static const esp_partition_t* batch_data_partition(metric_batch_t* b)
+{
+    if (!(b->fetched & BATCH_DATA_PARTITION)) {
+        b->data = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, NULL);
+        b->fetched |= BATCH_DATA_PARTITION;
+    }
+    return b->data;
+}
+
+static metric_error_t read_cpu_frequency(metric_batch_t* b, metric_value_t* v)
+{
+    // The current clock: DFS moves it, and the maximum differs per chip (240 MHz ESP32/S3, 160 MHz C3)
+    set_int(v, esp_clk_cpu_freq() / 1000000, "MHz");
+    return METRIC_OK;
+}
+
+static metric_error_t read_cpu_temperature(metric_batch_t* b, metric_value_t* v)
 {
-#if defined(CONFIG_IDF_TARGET_ESP32S2) \
- || defined(CONFIG_IDF_TARGET_ESP32S3) \
- || defined(CONFIG_IDF_TARGET_ESP32C2) \
- || defined(CONFIG_IDF_TARGET_ESP32C3) \
- || defined(CONFIG_IDF_TARGET_ESP32C6)
+#if SOC_TEMP_SENSOR_SUPPORTED
     // ESP32 variants with built-in temperature sensor
     if (temp_sensor == NULL) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Temperature sensor not initialized");
-        return metric_buffer;
+        return set_error(v, METRIC_ERROR_NOT_AVAILABLE, "ERROR: Temperature sensor not initialized");
     }
     
     float temperature;
     esp_err_t ret = temperature_sensor_get_celsius(temp_sensor, &temperature);
     if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_HARDWARE_FAULT;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Temperature read failed");
-        return metric_buffer;
+        return set_error(v, METRIC_ERROR_HARDWARE_FAULT, "ERROR: Temperature read failed");
     }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "%.1f°C", temperature);
-    return metric_buffer;
+    set_float(v, temperature, "°C");
+    return METRIC_OK;
 #else
     // Original ESP32 - no built-in temperature sensor
-    last_error = METRIC_ERROR_NOT_SUPPORTED;
-    snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Temperature sensor not available on ESP32");
-    return metric_buffer;
+    return set_error(v, METRIC_ERROR_NOT_SUPPORTED, "ERROR: Temperature sensor not available on ESP32");
 #endif
 }
 
-static const char* format_free_heap(void)
+static metric_error_t read_free_heap(metric_batch_t* b, metric_value_t* v)
+{
+    set_int(v, esp_get_free_heap_size(), "bytes");
+    return METRIC_OK;
+}
+
+static metric_error_t read_min_free_heap(metric_batch_t* b, metric_value_t* v)
+{
+    set_int(v, esp_get_minimum_free_heap_size(), "bytes");
+    return METRIC_OK;
+}
+
+static metric_error_t read_heap_largest_block(metric_batch_t* b, metric_value_t* v)
+{
+    set_int(v, heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL), "bytes");
+    return METRIC_OK;
+}
+
+static metric_error_t read_heap_fragmentation(metric_batch_t* b, metric_value_t* v)
 {
-    uint32_t free_heap = esp_get_free_heap_size();
-    snprintf(metric_buffer, sizeof(metric_buffer), "%lu bytes", free_heap);
-    return metric_buffer;
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_INTERNAL);
+    if (info.total_free_bytes == 0) {
+        return set_error(v, METRIC_ERROR_NOT_AVAILABLE, "ERROR: No free internal RAM");
+    }
+    
+    // 0% when all free memory is one block, approaching 100% as it splinters
+    set_float(v, 100.0f - 100.0f * info.largest_free_block / info.total_free_bytes, "%");
+    return METRIC_OK;
+}
+
+static metric_error_t read_uptime(metric_batch_t* b, metric_value_t* v)
+{
+    set_int(v, esp_timer_get_time() / 1000, "ms");
+    return METRIC_OK;
+}
+
+static metric_error_t read_task_priority(metric_batch_t* b, metric_value_t* v)
+{
+    set_int(v, uxTaskPriorityGet(NULL), "");
+    return METRIC_OK;
+}
+
+static metric_error_t read_vdd33_voltage(metric_batch_t* b, metric_value_t* v)
+{
+    if (vdd33_reader != NULL) {
+        int mv;
+        if (!vdd33_reader(&mv)) {
+            return set_error(v, METRIC_ERROR_NOT_AVAILABLE, "ERROR: No voltage reading yet");
+        }
+        set_float(v, mv / 1000.0f, "V");
+        return METRIC_OK;
+    }
+    if (adc_handle == NULL || adc_cali_handle == NULL) {
+        return set_error(v, METRIC_ERROR_NOT_AVAILABLE, "ERROR: ADC not initialized");
+    }
+    
+    int adc_reading;
+    esp_err_t ret = adc_oneshot_read(adc_handle, ADC_CHANNEL_0, &adc_reading);
+    
+    if (ret != ESP_OK) {
+        return set_error(v, METRIC_ERROR_HARDWARE_FAULT, "ERROR: ADC read failed");
+    }
+    
+    int voltage_mv;
+    ret = adc_cali_raw_to_voltage(adc_cali_handle, adc_reading, &voltage_mv);
+    
+    if (ret != ESP_OK) {
+        return set_error(v, METRIC_ERROR_HARDWARE_FAULT, "ERROR: ADC calibration failed");
+    }
+    
+    set_float(v, voltage_mv / 1000.0f, "V");
+    return METRIC_OK;
+}
+
+static metric_error_t read_wifi_rssi(metric_batch_t* b, metric_value_t* v)
+{
+    const wifi_ap_record_t* ap_info = batch_ap_info(b);
+    
+    if (ap_info == NULL) {
+        return set_error(v, METRIC_ERROR_NOT_AVAILABLE, "ERROR: WiFi not connected");
+    }
+    
+    set_int(v, ap_info->rssi, "dBm");
+    return METRIC_OK;
+}
+
+static metric_error_t read_wifi_tx_power(metric_batch_t* b, metric_value_t* v)
+{
+    int8_t power;
+    esp_err_t ret = esp_wifi_get_max_tx_power(&power);
+    
+    if (ret != ESP_OK) {
+        return set_error(v, METRIC_ERROR_NOT_AVAILABLE, "ERROR: WiFi power unavailable");
+    }
+    
+    set_int(v, power / 4, "dBm"); // Convert to dBm
+    return METRIC_OK;
+}
+
+static metric_error_t read_flash_usage(metric_batch_t* b, metric_value_t* v)
+{
+    const esp_partition_t* partition = batch_data_partition(b);
+    
+    if (partition == NULL) {
+        return set_error(v, METRIC_ERROR_NOT_AVAILABLE, "ERROR: No data partition found");
+    }
+    
+    // Note: Used space calculation would require filesystem-specific APIs
+    set_int(v, partition->size, "bytes");
+    return METRIC_OK;
 }
 
-static const char* format_min_free_heap(void)
+static metric_error_t read_spiffs_usage(metric_batch_t* b, metric_value_t* v)
 {
-    uint32_t min_free_heap = esp_get_minimum_free_heap_size();
-    snprintf(metric_buffer, sizeof(metric_buffer), "%lu bytes", min_free_heap);
-    return metric_buffer;
+    size_t total = 0, used = 0;
+    esp_err_t ret = storage_info(&total, &used);  // SPIFFS or LittleFS, whichever the build uses
+    
+    if (ret != ESP_OK || total == 0) {
+        return set_error(v, METRIC_ERROR_NOT_AVAILABLE, "ERROR: Filesystem not mounted");
+    }
+    
+    // The capacity only changes with the partition; the formatter needs it next to the cached value
+    spiffs_total_bytes = total;
+    set_int(v, used, "bytes");
+    return METRIC_OK;
 }
 
-static const char* format_uptime(void)
+static metric_error_t read_flash_size(metric_batch_t* b, metric_value_t* v)
 {
-    int64_t uptime_us = esp_timer_get_time();
-    uint64_t uptime_ms = uptime_us / 1000;
+    uint32_t flash_size;
+    esp_err_t ret = esp_flash_get_size(NULL, &flash_size);
+    
+    if (ret != ESP_OK) {
+        return set_error(v, METRIC_ERROR_HARDWARE_FAULT, "ERROR: Cannot read flash size");
+    }
+    
+    set_int(v, flash_size, "bytes");
+    return METRIC_OK;
+}
+
+static metric_error_t read_core_count(metric_batch_t* b, metric_value_t* v)
+{
+    esp_chip_info_t chip_info;
+    esp_chip_info(&chip_info);
+    
+    set_int(v, chip_info.cores, "cores");
+    return METRIC_OK;
+}
+
+static metric_error_t read_task_count(metric_batch_t* b, metric_value_t* v)
+{
+    set_int(v, uxTaskGetNumberOfTasks(), "tasks");
+    return METRIC_OK;
+}
+
+static metric_error_t read_task_runtime_stats(metric_batch_t* b, metric_value_t* v)
+{
+    // Note: Runtime statistics require configGENERATE_RUN_TIME_STATS=1 in FreeRTOS config
+    // For simplicity, return task count instead
+    set_int(v, uxTaskGetNumberOfTasks(), "tasks");
+    return METRIC_OK;
+}
+
+static metric_error_t read_task_stack_hwm(metric_batch_t* b, metric_value_t* v)
+{
+    set_int(v, uxTaskGetStackHighWaterMark(NULL) * sizeof(StackType_t), "bytes");
+    return METRIC_OK;
+}
+
+static metric_error_t read_boot_count(metric_batch_t* b, metric_value_t* v)
+{
+    if (!boot_accounted) {
+        return set_error(v, METRIC_ERROR_NOT_AVAILABLE, "ERROR: Boot count not available");
+    }
+    
+    set_int(v, boot_record.boot_count, "boots");
+    return METRIC_OK;
+}
+
+static metric_error_t read_app_specific_timers(metric_batch_t* b, metric_value_t* v)
+{
+    // Note: Application-specific timers would be defined by the application
+    // This is a placeholder implementation
+    set_int(v, esp_timer_get_time() / 1000000, "s");
+    return METRIC_OK;
+}
+
+static metric_error_t read_crash_count(metric_batch_t* b, metric_value_t* v)
+{
+    if (!boot_accounted) {
+        return set_error(v, METRIC_ERROR_NOT_AVAILABLE, "ERROR: Crash count not available");
+    }
+    
+    set_int(v, boot_record.crash_count, "crashes");
+    return METRIC_OK;
+}
+
+// =============================
+// Private Metric Formatters
+// =============================
+
+static metric_error_t format_cpu_frequency(metric_batch_t* b, char* buf, size_t len)
+{
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_CPU_FREQUENCY, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
+    
+    snprintf(buf, len, "%lu MHz (default)", (unsigned long)v.i);
+    return METRIC_OK;
+}
+
+static metric_error_t format_cpu_temperature(metric_batch_t* b, char* buf, size_t len)
+{
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_CPU_TEMPERATURE, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
+    
+    snprintf(buf, len, "%.1f°C", v.f);
+    return METRIC_OK;
+}
+
+static metric_error_t format_free_heap(metric_batch_t* b, char* buf, size_t len)
+{
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_FREE_HEAP, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
+    
+    snprintf(buf, len, "%lu bytes", (unsigned long)v.i);
+    return METRIC_OK;
+}
+
+static metric_error_t format_min_free_heap(metric_batch_t* b, char* buf, size_t len)
+{
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_MIN_FREE_HEAP, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
+    
+    snprintf(buf, len, "%lu bytes", (unsigned long)v.i);
+    return METRIC_OK;
+}
+
+static metric_error_t format_heap_largest_block(metric_batch_t* b, char* buf, size_t len)
+{
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_HEAP_LARGEST_BLOCK, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
+    
+    snprintf(buf, len, "%lu bytes", (unsigned long)v.i);
+    return METRIC_OK;
+}
+
+static metric_error_t format_heap_fragmentation(metric_batch_t* b, char* buf, size_t len)
+{
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_HEAP_FRAGMENTATION, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
+    
+    snprintf(buf, len, "%.1f%%", v.f);
+    return METRIC_OK;
+}
+
+static metric_error_t format_uptime(metric_batch_t* b, char* buf, size_t len)
+{
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_UPTIME, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
+    
+    uint64_t uptime_ms = (uint64_t)v.i;
     
     // Format as days:hours:minutes:seconds.milliseconds
     uint32_t days = uptime_ms / (24 * 60 * 60 * 1000);
@@ -440,18 +1176,18 @@ static const char* format_uptime(void)
     uint32_t ms = uptime_ms % 1000;
     
     if (days > 0) {
-        snprintf(metric_buffer, sizeof(metric_buffer), "%lud %02lu:%02lu:%02lu.%03lu", 
+        snprintf(buf, len, "%lud %02lu:%02lu:%02lu.%03lu", 
                 days, hours, minutes, seconds, ms);
     } else {
-        snprintf(metric_buffer, sizeof(metric_buffer), "%02lu:%02lu:%02lu.%03lu", 
+        snprintf(buf, len, "%02lu:%02lu:%02lu.%03lu", 
                 hours, minutes, seconds, ms);
     }
-    return metric_buffer;
+    return METRIC_OK;
 }
 
-static const char* format_reset_reason(void)
+static metric_error_t format_reset_reason(metric_batch_t* b, char* buf, size_t len)
 {
-    esp_reset_reason_t reason = esp_reset_reason();
+    esp_reset_reason_t reason = boot_accounted ? boot_reset_reason : esp_reset_reason();
     const char* reason_str;
     
     switch (reason) {
@@ -469,271 +1205,247 @@ static const char* format_reset_reason(void)
         default:                 reason_str = "Undefined"; break;
     }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "%s (%d)", reason_str, reason);
-    return metric_buffer;
+    snprintf(buf, len, "%s (%d)", reason_str, reason);
+    return METRIC_OK;
 }
 
-static const char* format_wifi_rssi(void)
+static metric_error_t format_wifi_rssi(metric_batch_t* b, char* buf, size_t len)
 {
-    wifi_ap_record_t ap_info;
-    esp_err_t ret = esp_wifi_sta_get_ap_info(&ap_info);
-    
-    if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: WiFi not connected");
-        return metric_buffer;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_WIFI_RSSI, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
     }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "%d dBm", ap_info.rssi);
-    return metric_buffer;
+    snprintf(buf, len, "%d dBm", (int)v.i);
+    return METRIC_OK;
 }
 
-static const char* format_wifi_tx_power(void)
+static metric_error_t format_wifi_tx_power(metric_batch_t* b, char* buf, size_t len)
 {
-    int8_t power;
-    esp_err_t ret = esp_wifi_get_max_tx_power(&power);
-    
-    if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: WiFi power unavailable");
-        return metric_buffer;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_WIFI_TX_POWER, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
     }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "%d dBm", power / 4); // Convert to dBm
-    return metric_buffer;
+    snprintf(buf, len, "%d dBm", (int)v.i);
+    return METRIC_OK;
 }
 
-static const char* format_ip_address(void)
+static metric_error_t format_ip_address(metric_batch_t* b, char* buf, size_t len)
 {
     esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
     if (netif == NULL) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: WiFi interface not found");
-        return metric_buffer;
+        snprintf(buf, len, "ERROR: WiFi interface not found");
+        return METRIC_ERROR_NOT_AVAILABLE;
     }
     
     esp_netif_ip_info_t ip_info;
     esp_err_t ret = esp_netif_get_ip_info(netif, &ip_info);
     
     if (ret != ESP_OK || ip_info.ip.addr == 0) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: No IP address assigned");
-        return metric_buffer;
+        snprintf(buf, len, "ERROR: No IP address assigned");
+        return METRIC_ERROR_NOT_AVAILABLE;
     }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), IPSTR, IP2STR(&ip_info.ip));
-    return metric_buffer;
+    snprintf(buf, len, IPSTR, IP2STR(&ip_info.ip));
+    return METRIC_OK;
 }
 
-static const char* format_wifi_status(void)
+static metric_error_t format_wifi_status(metric_batch_t* b, char* buf, size_t len)
 {
     wifi_mode_t mode;
     esp_err_t ret = esp_wifi_get_mode(&mode);
     
     if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: WiFi not initialized");
-        return metric_buffer;
+        snprintf(buf, len, "ERROR: WiFi not initialized");
+        return METRIC_ERROR_NOT_AVAILABLE;
     }
     
-    wifi_ap_record_t ap_info;
-    ret = esp_wifi_sta_get_ap_info(&ap_info);
+    const wifi_ap_record_t* ap_info = batch_ap_info(b);
     
-    if (ret == ESP_OK) {
-        snprintf(metric_buffer, sizeof(metric_buffer), "Connected to %s", (char*)ap_info.ssid);
+    if (ap_info != NULL) {
+        snprintf(buf, len, "Connected to %s", (const char*)ap_info->ssid);
     } else {
-        snprintf(metric_buffer, sizeof(metric_buffer), "Not connected");
+        snprintf(buf, len, "Not connected");
     }
     
-    return metric_buffer;
+    return METRIC_OK;
 }
 
-static const char* format_chip_id(void)
+static metric_error_t format_chip_id(metric_batch_t* b, char* buf, size_t len)
 {
     uint8_t mac[6];
     esp_err_t ret = esp_efuse_mac_get_default(mac);
     
     if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_HARDWARE_FAULT;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Cannot read chip ID");
-        return metric_buffer;
+        snprintf(buf, len, "ERROR: Cannot read chip ID");
+        return METRIC_ERROR_HARDWARE_FAULT;
     }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "%02X%02X%02X%02X%02X%02X", 
+    snprintf(buf, len, "%02X%02X%02X%02X%02X%02X", 
              mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-    return metric_buffer;
+    return METRIC_OK;
 }
 
-static const char* format_mac_address(void)
+static metric_error_t format_mac_address(metric_batch_t* b, char* buf, size_t len)
 {
     uint8_t mac[6];
     esp_err_t ret = esp_read_mac(mac, ESP_MAC_WIFI_STA);
     
     if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_HARDWARE_FAULT;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Cannot read MAC address");
-        return metric_buffer;
+        snprintf(buf, len, "ERROR: Cannot read MAC address");
+        return METRIC_ERROR_HARDWARE_FAULT;
     }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "%02X:%02X:%02X:%02X:%02X:%02X", 
+    snprintf(buf, len, "%02X:%02X:%02X:%02X:%02X:%02X", 
              mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-    return metric_buffer;
+    return METRIC_OK;
 }
 
-static const char* format_flash_size(void)
+static metric_error_t format_flash_size(metric_batch_t* b, char* buf, size_t len)
 {
-    uint32_t flash_size;
-    esp_err_t ret = esp_flash_get_size(NULL, &flash_size);
-    
-    if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_HARDWARE_FAULT;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Cannot read flash size");
-        return metric_buffer;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_FLASH_SIZE, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
     }
     
+    uint32_t flash_size = (uint32_t)v.i;
     if (flash_size >= 1024 * 1024) {
-        snprintf(metric_buffer, sizeof(metric_buffer), "%.1f MB", flash_size / (1024.0 * 1024.0));
+        snprintf(buf, len, "%.1f MB", flash_size / (1024.0 * 1024.0));
     } else {
-        snprintf(metric_buffer, sizeof(metric_buffer), "%lu KB", flash_size / 1024);
+        snprintf(buf, len, "%lu KB", (unsigned long)(flash_size / 1024));
     }
-    return metric_buffer;
+    return METRIC_OK;
 }
 
-static const char* format_chip_revision(void)
+static metric_error_t format_chip_revision(metric_batch_t* b, char* buf, size_t len)
 {
     esp_chip_info_t chip_info;
     esp_chip_info(&chip_info);
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "v%d.%d", 
+    snprintf(buf, len, "v%d.%d", 
              chip_info.revision / 100, chip_info.revision % 100);
-    return metric_buffer;
+    return METRIC_OK;
 }
 
-static const char* format_core_count(void)
+static metric_error_t format_core_count(metric_batch_t* b, char* buf, size_t len)
 {
-    esp_chip_info_t chip_info;
-    esp_chip_info(&chip_info);
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_CORE_COUNT, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "%d cores", chip_info.cores);
-    return metric_buffer;
+    snprintf(buf, len, "%d cores", (int)v.i);
+    return METRIC_OK;
 }
 
-static const char* format_task_count(void)
+static metric_error_t format_task_count(metric_batch_t* b, char* buf, size_t len)
 {
-    UBaseType_t task_count = uxTaskGetNumberOfTasks();
-    snprintf(metric_buffer, sizeof(metric_buffer), "%d tasks", task_count);
-    return metric_buffer;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_TASK_COUNT, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
+    
+    snprintf(buf, len, "%d tasks", (int)v.i);
+    return METRIC_OK;
 }
 
-static const char* format_task_stack_hwm(void)
+static metric_error_t format_task_stack_hwm(metric_batch_t* b, char* buf, size_t len)
 {
-    UBaseType_t hwm = uxTaskGetStackHighWaterMark(NULL);
-    snprintf(metric_buffer, sizeof(metric_buffer), "%d bytes remaining", hwm * sizeof(StackType_t));
-    return metric_buffer;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_TASK_STACK_HWM, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
+    
+    snprintf(buf, len, "%d bytes remaining", (int)v.i);
+    return METRIC_OK;
 }
 
-static const char* format_task_runtime_stats(void)
+static metric_error_t format_task_runtime_stats(metric_batch_t* b, char* buf, size_t len)
 {
-    // Note: Runtime statistics require configGENERATE_RUN_TIME_STATS=1 in FreeRTOS config
-    // For simplicity, return task count instead
-    UBaseType_t task_count = uxTaskGetNumberOfTasks();
-    snprintf(metric_buffer, sizeof(metric_buffer), "%d tasks active", task_count);
-    return metric_buffer;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_TASK_RUNTIME_STATS, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
+    
+    snprintf(buf, len, "%d tasks active", (int)v.i);
+    return METRIC_OK;
 }
 
-static const char* format_task_priority(void)
+static metric_error_t format_task_priority(metric_batch_t* b, char* buf, size_t len)
 {
-    UBaseType_t priority = uxTaskPriorityGet(NULL);
-    snprintf(metric_buffer, sizeof(metric_buffer), "%d", priority);
-    return metric_buffer;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_TASK_PRIORITY, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
+    
+    snprintf(buf, len, "%d", (int)v.i);
+    return METRIC_OK;
 }
 
-static const char* format_power_mode(void)
+static metric_error_t format_power_mode(metric_batch_t* b, char* buf, size_t len)
 {
     esp_pm_config_t pm_config;
     esp_err_t ret = esp_pm_get_configuration(&pm_config);
     
     if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Power management not configured");
-        return metric_buffer;
+        snprintf(buf, len, "ERROR: Power management not configured");
+        return METRIC_ERROR_NOT_AVAILABLE;
     }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "Max: %d MHz, Min: %d MHz", 
+    snprintf(buf, len, "Max: %d MHz, Min: %d MHz", 
              pm_config.max_freq_mhz, pm_config.min_freq_mhz);
-    return metric_buffer;
+    return METRIC_OK;
 }
 
-static const char* format_vdd33_voltage(void)
+static metric_error_t format_vdd33_voltage(metric_batch_t* b, char* buf, size_t len)
 {
-    if (adc_handle == NULL || adc_cali_handle == NULL) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: ADC not initialized");
-        return metric_buffer;
-    }
-    
-    int adc_reading;
-    esp_err_t ret = adc_oneshot_read(adc_handle, ADC_CHANNEL_0, &adc_reading);
-    
-    if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_HARDWARE_FAULT;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: ADC read failed");
-        return metric_buffer;
-    }
-    
-    int voltage_mv;
-    ret = adc_cali_raw_to_voltage(adc_cali_handle, adc_reading, &voltage_mv);
-    
-    if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_HARDWARE_FAULT;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: ADC calibration failed");
-        return metric_buffer;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_VDD33_VOLTAGE, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
     }
     
-    float voltage_v = voltage_mv / 1000.0f;
-    snprintf(metric_buffer, sizeof(metric_buffer), "%.2f V", voltage_v);
-    return metric_buffer;
+    snprintf(buf, len, "%.2f V", v.f);
+    return METRIC_OK;
 }
 
-static const char* format_wifi_tx_rx_bytes(void)
+static metric_error_t format_wifi_tx_rx_bytes(metric_batch_t* b, char* buf, size_t len)
 {
-    wifi_ap_record_t ap_info;
-    esp_err_t ret = esp_wifi_sta_get_ap_info(&ap_info);
-    
-    if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: WiFi not connected");
-        return metric_buffer;
-    }
-    
-    // Note: ESP-IDF doesn't provide direct TX/RX byte counters
-    // This would require custom implementation using packet callbacks
-    snprintf(metric_buffer, sizeof(metric_buffer), "Feature not implemented");
-    return metric_buffer;
+    // ESP-IDF keeps no byte counters; the application counts traffic and
+    // registers a provider for this metric, which replaces this fallback
+    snprintf(buf, len, "ERROR: No traffic counters registered");
+    return METRIC_ERROR_NOT_SUPPORTED;
 }
 
-static const char* format_network_speed(void)
+static metric_error_t format_network_speed(metric_batch_t* b, char* buf, size_t len)
 {
-    wifi_ap_record_t ap_info;
-    esp_err_t ret = esp_wifi_sta_get_ap_info(&ap_info);
+    const wifi_ap_record_t* ap_info = batch_ap_info(b);
     
-    if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: WiFi not connected");
-        return metric_buffer;
+    if (ap_info == NULL) {
+        snprintf(buf, len, "ERROR: WiFi not connected");
+        return METRIC_ERROR_NOT_AVAILABLE;
     }
     
     // Estimate speed based on PHY mode
     const char* phy_mode;
     uint32_t max_speed_mbps = 0;
     
-    switch (ap_info.phy_11b) {
+    switch (ap_info->phy_11b) {
         case 1: phy_mode = "802.11b"; max_speed_mbps = 11; break;
         default:
-            switch (ap_info.phy_11g) {
+            switch (ap_info->phy_11g) {
                 case 1: phy_mode = "802.11g"; max_speed_mbps = 54; break;
                 default:
-                    switch (ap_info.phy_11n) {
+                    switch (ap_info->phy_11n) {
                         case 1: phy_mode = "802.11n"; max_speed_mbps = 150; break;
                         default: phy_mode = "Unknown"; max_speed_mbps = 0; break;
                     }
@@ -742,211 +1454,169 @@ static const char* format_network_speed(void)
             break;
     }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "%s (up to %lu Mbps)", phy_mode, max_speed_mbps);
-    return metric_buffer;
+    snprintf(buf, len, "%s (up to %lu Mbps)", phy_mode, max_speed_mbps);
+    return METRIC_OK;
 }
 
-static const char* format_flash_usage(void)
+static metric_error_t format_flash_usage(metric_batch_t* b, char* buf, size_t len)
 {
-    const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, NULL);
-    
-    if (partition == NULL) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: No data partition found");
-        return metric_buffer;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_FLASH_USAGE, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
     }
     
-    size_t total_size = partition->size;
-    // Note: Used space calculation would require filesystem-specific APIs
-    snprintf(metric_buffer, sizeof(metric_buffer), "Total: %zu bytes", total_size);
-    return metric_buffer;
+    snprintf(buf, len, "Total: %zu bytes", (size_t)v.i);
+    return METRIC_OK;
 }
 
-static const char* format_spiffs_usage(void)
+static metric_error_t format_spiffs_usage(metric_batch_t* b, char* buf, size_t len)
 {
-    size_t total = 0, used = 0;
-    esp_err_t ret = esp_spiffs_info(NULL, &total, &used);
-    
-    if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: SPIFFS not mounted");
-        return metric_buffer;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_SPIFFS_USAGE, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
     }
     
+    size_t used = (size_t)v.i;
+    size_t total = spiffs_total_bytes;
     float usage_percent = (float)used / total * 100.0f;
-    snprintf(metric_buffer, sizeof(metric_buffer), "%zu/%zu bytes (%.1f%%)", used, total, usage_percent);
-    return metric_buffer;
+    snprintf(buf, len, "%zu/%zu bytes (%.1f%%)", used, total, usage_percent);
+    return METRIC_OK;
 }
 
-static const char* format_boot_count(void)
+static metric_error_t format_boot_count(metric_batch_t* b, char* buf, size_t len)
 {
-    if (metrics_nvs_handle == 0) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: NVS not available");
-        return metric_buffer;
-    }
-    
-    uint32_t boot_count = 0;
-    size_t required_size = sizeof(boot_count);
-    esp_err_t ret = nvs_get_blob(metrics_nvs_handle, "boot_count", &boot_count, &required_size);
-    
-    if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Boot count not available");
-        return metric_buffer;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_BOOT_COUNT, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
     }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "%lu boots", boot_count);
-    return metric_buffer;
+    snprintf(buf, len, "%lu boots", (unsigned long)v.i);
+    return METRIC_OK;
 }
 
-static const char* format_crash_count(void)
+static metric_error_t format_crash_count(metric_batch_t* b, char* buf, size_t len)
 {
-    if (metrics_nvs_handle == 0) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: NVS not available");
-        return metric_buffer;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_CRASH_COUNT, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
     }
     
-    uint32_t crash_count = 0;
-    size_t required_size = sizeof(crash_count);
-    esp_err_t ret = nvs_get_blob(metrics_nvs_handle, "crash_count", &crash_count, &required_size);
-    
-    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-        // First time - check if last reset was due to crash
-        esp_reset_reason_t reason = esp_reset_reason();
-        if (reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT || reason == ESP_RST_WDT) {
-            crash_count = 1;
-            nvs_set_blob(metrics_nvs_handle, "crash_count", &crash_count, sizeof(crash_count));
-            nvs_commit(metrics_nvs_handle);
-        }
-    } else if (ret != ESP_OK) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Crash count not available");
-        return metric_buffer;
-    }
-    
-    snprintf(metric_buffer, sizeof(metric_buffer), "%lu crashes", crash_count);
-    return metric_buffer;
+    snprintf(buf, len, "%lu crashes", (unsigned long)v.i);
+    return METRIC_OK;
 }
 
-static const char* format_light_sleep_duration(void)
+static metric_error_t format_light_sleep_duration(metric_batch_t* b, char* buf, size_t len)
 {
-    // Note: ESP-IDF doesn't provide direct sleep time tracking
-    // This would require custom implementation with sleep/wake callbacks
-    last_error = METRIC_ERROR_NOT_AVAILABLE;
-    snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Light sleep duration tracking not implemented");
-    return metric_buffer;
+    // ESP-IDF keeps no sleep totals; the application counts them from the
+    // light sleep callbacks and registers a provider, which replaces this fallback
+    snprintf(buf, len, "ERROR: Light sleep duration tracking not implemented");
+    return METRIC_ERROR_NOT_AVAILABLE;
 }
 
-static const char* format_deep_sleep_duration(void)
+static metric_error_t format_deep_sleep_duration(metric_batch_t* b, char* buf, size_t len)
 {
-    // Note: Deep sleep duration could be tracked in RTC memory
-    // For now, return not available
-    last_error = METRIC_ERROR_NOT_AVAILABLE;
-    snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Deep sleep duration tracking not implemented");
-    return metric_buffer;
+    // Tracked by the application in RTC memory across wakes; its provider
+    // replaces this fallback
+    snprintf(buf, len, "ERROR: Deep sleep duration tracking not implemented");
+    return METRIC_ERROR_NOT_AVAILABLE;
 }
 
-static const char* format_current_consumption(void)
+static metric_error_t format_current_consumption(metric_batch_t* b, char* buf, size_t len)
 {
-    // Note: Current consumption measurement requires external hardware
-    // This is typically measured with a current sense resistor and ADC
-    last_error = METRIC_ERROR_NOT_SUPPORTED;
-    snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Current measurement requires external hardware");
-    return metric_buffer;
+    // Note: Current consumption measurement requires external hardware.
+    // The node's energy benchmark reads an INA219 and registers a provider,
+    // which replaces this fallback
+    snprintf(buf, len, "ERROR: Current measurement requires external hardware");
+    return METRIC_ERROR_NOT_SUPPORTED;
 }
 
-static const char* format_bt_ble_rssi(void)
+static metric_error_t format_bt_ble_rssi(metric_batch_t* b, char* buf, size_t len)
 {
 #ifdef CONFIG_BT_ENABLED
     // Note: BT/BLE RSSI requires active connection
-    last_error = METRIC_ERROR_NOT_AVAILABLE;
-    snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: BT/BLE not connected");
-    return metric_buffer;
+    snprintf(buf, len, "ERROR: BT/BLE not connected");
+    return METRIC_ERROR_NOT_AVAILABLE;
 #else
-    last_error = METRIC_ERROR_NOT_SUPPORTED;
-    snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Bluetooth not enabled in configuration");
-    return metric_buffer;
+    snprintf(buf, len, "ERROR: Bluetooth not enabled in configuration");
+    return METRIC_ERROR_NOT_SUPPORTED;
 #endif
 }
 
-static const char* format_bt_ble_connected_devices(void)
+static metric_error_t format_bt_ble_connected_devices(metric_batch_t* b, char* buf, size_t len)
 {
 #ifdef CONFIG_BT_ENABLED
     // Note: Would require BT/BLE stack initialization and connection tracking
-    last_error = METRIC_ERROR_NOT_AVAILABLE;
-    snprintf(metric_buffer, sizeof(metric_buffer), "0 devices");
-    return metric_buffer;
+    snprintf(buf, len, "0 devices");
+    return METRIC_ERROR_NOT_AVAILABLE;
 #else
-    last_error = METRIC_ERROR_NOT_SUPPORTED;
-    snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Bluetooth not enabled in configuration");
-    return metric_buffer;
+    snprintf(buf, len, "ERROR: Bluetooth not enabled in configuration");
+    return METRIC_ERROR_NOT_SUPPORTED;
 #endif
 }
 
-static const char* format_flash_rw_operations(void)
+static metric_error_t format_flash_rw_operations(metric_batch_t* b, char* buf, size_t len)
 {
-    // Note: Flash R/W operation counting requires custom implementation
-    // ESP-IDF doesn't provide built-in counters for this
-    last_error = METRIC_ERROR_NOT_AVAILABLE;
-    snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: Flash R/W operation counting not implemented");
-    return metric_buffer;
+    // Note: ESP-IDF doesn't count flash operations. The firmware's flash
+    // wrappers count them and register a provider, which replaces this fallback
+    snprintf(buf, len, "ERROR: Flash R/W operation counting not implemented");
+    return METRIC_ERROR_NOT_AVAILABLE;
 }
 
-static const char* format_i2c_bus_errors(void)
+static metric_error_t format_i2c_bus_errors(metric_batch_t* b, char* buf, size_t len)
 {
-    // Note: I2C error counting requires custom implementation in I2C driver
-    last_error = METRIC_ERROR_NOT_AVAILABLE;
-    snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: I2C error counting not implemented");
-    return metric_buffer;
+    // Note: I2C error counting requires custom implementation in I2C driver.
+    // The node's shared bus manager counts them and registers a provider,
+    // which replaces this fallback
+    snprintf(buf, len, "ERROR: I2C error counting not implemented");
+    return METRIC_ERROR_NOT_AVAILABLE;
 }
 
-static const char* format_spi_performance(void)
+static metric_error_t format_spi_performance(metric_batch_t* b, char* buf, size_t len)
 {
     // Note: SPI performance metrics require custom implementation
-    last_error = METRIC_ERROR_NOT_AVAILABLE;
-    snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: SPI performance monitoring not implemented");
-    return metric_buffer;
+    snprintf(buf, len, "ERROR: SPI performance monitoring not implemented");
+    return METRIC_ERROR_NOT_AVAILABLE;
 }
 
-static const char* format_gpio_status(void)
+static metric_error_t format_gpio_status(metric_batch_t* b, char* buf, size_t len)
 {
     // Note: GPIO status could be implemented by reading all pin states
     // For now, return a simple placeholder
-    last_error = METRIC_ERROR_NOT_AVAILABLE;
-    snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: GPIO status monitoring not implemented");
-    return metric_buffer;
+    snprintf(buf, len, "ERROR: GPIO status monitoring not implemented");
+    return METRIC_ERROR_NOT_AVAILABLE;
 }
 
-static const char* format_ota_update_status(void)
+static metric_error_t format_ota_update_status(metric_batch_t* b, char* buf, size_t len)
 {
     // Check if an OTA update is available or in progress
-    const esp_partition_t* running = esp_ota_get_running_partition();
-    const esp_partition_t* boot = esp_ota_get_boot_partition();
+    batch_ota_partitions(b);
+    const esp_partition_t* running = b->running;
+    const esp_partition_t* boot = b->boot;
     
     if (!running || !boot) {
         // OTA partitions not found or not properly initialized
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: OTA partition info not available");
-        return metric_buffer;
+        snprintf(buf, len, "ERROR: OTA partition info not available");
+        return METRIC_ERROR_NOT_AVAILABLE;
     }
     
     if (running != boot) {
-        snprintf(metric_buffer, sizeof(metric_buffer), "Update pending (boot from %s)", boot->label);
+        snprintf(buf, len, "Update pending (boot from %s)", boot->label);
     } else {
-        snprintf(metric_buffer, sizeof(metric_buffer), "Up to date (running %s)", running->label);
+        snprintf(buf, len, "Up to date (running %s)", running->label);
     }
-    return metric_buffer;
+    return METRIC_OK;
 }
 
-static const char* format_last_update_time(void)
+static metric_error_t format_last_update_time(metric_batch_t* b, char* buf, size_t len)
 {
     // Note: This would require storing update timestamps in NVS
     if (metrics_nvs_handle == 0) {
-        last_error = METRIC_ERROR_NOT_AVAILABLE;
-        snprintf(metric_buffer, sizeof(metric_buffer), "ERROR: NVS not available");
-        return metric_buffer;
+        snprintf(buf, len, "ERROR: NVS not available");
+        return METRIC_ERROR_NOT_AVAILABLE;
     }
     
     uint64_t last_update = 0;
@@ -954,28 +1624,153 @@ static const char* format_last_update_time(void)
     esp_err_t ret = nvs_get_blob(metrics_nvs_handle, "last_update", &last_update, &required_size);
     
     if (ret != ESP_OK) {
-        snprintf(metric_buffer, sizeof(metric_buffer), "Never updated");
+        snprintf(buf, len, "Never updated");
     } else {
         // Convert timestamp to readable format
         time_t timestamp = (time_t)(last_update / 1000000); // Convert microseconds to seconds
         struct tm timeinfo;
         localtime_r(&timestamp, &timeinfo);
-        strftime(metric_buffer, sizeof(metric_buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
+        strftime(buf, len, "%Y-%m-%d %H:%M:%S", &timeinfo);
     }
-    return metric_buffer;
+    return METRIC_OK;
 }
 
-static const char* format_app_specific_timers(void)
+static metric_error_t format_app_specific_timers(metric_batch_t* b, char* buf, size_t len)
 {
-    // Note: Application-specific timers would be defined by the application
-    // This is a placeholder implementation
-    uint64_t uptime_us = esp_timer_get_time();
-    uint32_t uptime_seconds = uptime_us / 1000000;
+    metric_value_t v;
+    metric_error_t err = read_metric(b, METRIC_APP_SPECIFIC_TIMERS, &v, buf, len);
+    if (err != METRIC_OK) {
+        return err;
+    }
+    
+    snprintf(buf, len, "App timer: %lu seconds", (unsigned long)v.i);
+    return METRIC_OK;
+}
+
+static metric_error_t format_provided(system_metric_t metric, char* buf, size_t len)
+{
+    metric_provider_fn provider = metric_providers[metric];
+    if (provider == NULL) {
+        snprintf(buf, len, "ERROR: No provider registered");
+        return METRIC_ERROR_NOT_AVAILABLE;
+    }
+    
+    return provider(buf, len);
+}
+
+// =============================
+// Private Metric Cache
+// =============================
+
+/**
+ * @brief Allocate one entry per metric that has a TTL
+ */
+static bool cache_init(void)
+{
+    if (metric_cache != NULL) {
+        return true;
+    }
     
-    snprintf(metric_buffer, sizeof(metric_buffer), "App timer: %lu seconds", uptime_seconds);
-    return metric_buffer;
+    int entries = 0;
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        cache_slot[i] = metric_descs[i].ttl_ms != METRIC_TTL_NONE ? (int8_t)entries++ : -1;
+    }
+    
+    metric_cache = calloc(entries, sizeof(metric_cache_entry_t));
+    if (metric_cache == NULL) {
+        ESP_LOGW(TAG, "No memory for the metric cache, every read will hit the hardware");
+        return false;
+    }
+    return true;
+}
+
+static bool cache_lookup(system_metric_t metric, metric_value_t* v, metric_error_t* err)
+{
+    if (metric_cache == NULL || cache_slot[metric] < 0) {
+        return false;
+    }
+    
+    bool hit = false;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&cache_lock);
+    const metric_cache_entry_t* entry = &metric_cache[cache_slot[metric]];
+    uint32_t ttl_ms = metric_descs[metric].ttl_ms;
+    if (entry->valid && (ttl_ms == METRIC_TTL_STATIC || now - entry->read_at_us < (int64_t)ttl_ms * 1000)) {
+        *v = entry->value;
+        *err = entry->error;
+        hit = true;
+    }
+    portEXIT_CRITICAL(&cache_lock);
+    return hit;
+}
+
+static void cache_store(system_metric_t metric, const metric_value_t* v, metric_error_t err)
+{
+    if (metric_cache == NULL || cache_slot[metric] < 0) {
+        return;
+    }
+    
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&cache_lock);
+    metric_cache_entry_t* entry = &metric_cache[cache_slot[metric]];
+    entry->value = *v;
+    entry->error = err;
+    entry->read_at_us = now;
+    entry->valid = true;
+    portEXIT_CRITICAL(&cache_lock);
 }
 
+/**
+ * @brief Typed read of a metric that has a reader, served from the cache while fresh
+ */
+static metric_error_t cached_read(metric_batch_t* b, system_metric_t metric, metric_value_t* v)
+{
+    metric_error_t err;
+    if (cache_lookup(metric, v, &err)) {
+        return err;
+    }
+    
+    err = metric_descs[metric].read(b, v);
+    cache_store(metric, v, err);
+    return err;
+}
+
+/**
+ * @brief Format a metric; text metrics cache the string itself
+ *
+ * Metrics with a reader are cached at the value level by read_metric(), so
+ * only the (cheap) snprintf runs again.
+ */
+static metric_error_t cached_format(metric_batch_t* b, system_metric_t metric, char* buf, size_t len)
+{
+    if (metric_descs[metric].read != NULL || cache_slot[metric] < 0 || metric_cache == NULL) {
+        return metric_descs[metric].format(b, buf, len);
+    }
+    
+    metric_value_t v;
+    metric_error_t err;
+    if (!cache_lookup(metric, &v, &err)) {
+        v.type = METRIC_VALUE_STRING;
+        v.unit = "";
+        v.s[0] = '\0';
+        err = metric_descs[metric].format(b, v.s, sizeof(v.s));
+        cache_store(metric, &v, err);
+    }
+    snprintf(buf, len, "%s", v.s);
+    return err;
+}
+
+#if SYSTEM_METRICS_PROVIDERS
+bool set_metric_provider(system_metric_t metric, metric_provider_fn provider)
+{
+    if (metric >= METRIC_COUNT) {
+        return false;
+    }
+    metric_providers[metric] = provider;
+    return true;
+}
+#endif
+
 bool update_boot_count(uint32_t new_count)
 {
     if (metrics_nvs_handle == 0) {
@@ -987,6 +1782,9 @@ bool update_boot_count(uint32_t new_count)
     if (ret == ESP_OK) {
         ret = nvs_commit(metrics_nvs_handle);
         if (ret == ESP_OK) {
+            boot_record.boot_count = new_count;
+            boot_record.check = ~(boot_record.boot_count ^ boot_record.crash_count);
+            invalidate_metric_cache(METRIC_BOOT_COUNT);
             ESP_LOGI(TAG, "Updated boot count to: %lu", new_count);
             return true;
         } else {
@@ -1006,22 +1804,103 @@ bool get_boot_count(uint32_t *count)
         return false;
     }
     
-    if (metrics_nvs_handle == 0) {
+    if (!boot_accounted) {
         ESP_LOGE(TAG, "SystemMetrics not initialized - cannot get boot count");
         return false;
     }
     
-    size_t required_size = sizeof(*count);
-    esp_err_t ret = nvs_get_blob(metrics_nvs_handle, "boot_count", count, &required_size);
+    *count = boot_record.boot_count;
+    return true;
+}
+
+void system_metrics_release_adc(void)
+{
+    if (adc_cali_handle != NULL) {
+        adc_cali_delete_scheme_line_fitting(adc_cali_handle);
+        adc_cali_handle = NULL;
+    }
+    if (adc_handle != NULL) {
+        adc_oneshot_del_unit(adc_handle);
+        adc_handle = NULL;
+    }
+    invalidate_metric_cache(METRIC_VDD33_VOLTAGE);
+}
+
+adc_oneshot_unit_handle_t system_metrics_adc_unit(void)
+{
+    return adc_handle;
+}
+
+void system_metrics_set_vdd33_reader(system_metrics_mv_fn reader)
+{
+    vdd33_reader = reader;
+    invalidate_metric_cache(METRIC_VDD33_VOLTAGE);
+}
+
+// =============================
+// Private Boot Accounting
+// =============================
+
+static bool is_crash_reset(esp_reset_reason_t reason)
+{
+    return reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT ||
+           reason == ESP_RST_TASK_WDT || reason == ESP_RST_WDT;
+}
+
+/**
+ * @brief Count this boot and any crash behind it, with at most one NVS commit
+ *
+ * NVS holds the counts across power cycles; the RTC copy is what the metric
+ * readers use, so polling them never touches flash.
+ */
+static void account_boot(void)
+{
+    if (boot_accounted) {
+        return;
+    }
+    boot_reset_reason = esp_reset_reason();
     
-    if (ret == ESP_OK) {
-        return true;
-    } else if (ret == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "Boot count not found in NVS, returning 0");
-        *count = 0;
-        return true;
-    } else {
-        ESP_LOGE(TAG, "Failed to get boot count from NVS: %s", esp_err_to_name(ret));
-        return false;
+    bool rtc_valid = boot_record.magic == BOOT_RECORD_MAGIC &&
+                     boot_record.check == ~(boot_record.boot_count ^ boot_record.crash_count) &&
+                     boot_reset_reason != ESP_RST_POWERON;
+    
+    // Waking from deep sleep continues the same boot session
+    if (rtc_valid && boot_reset_reason == ESP_RST_DEEPSLEEP) {
+        boot_accounted = true;
+        return;
     }
-}
\ No newline at end of file
+    
+    uint32_t boot_count = 0;
+    uint32_t crash_count = 0;
+    if (metrics_nvs_handle != 0) {
+        size_t required_size = sizeof(boot_count);
+        nvs_get_blob(metrics_nvs_handle, "boot_count", &boot_count, &required_size);
+        required_size = sizeof(crash_count);
+        nvs_get_blob(metrics_nvs_handle, "crash_count", &crash_count, &required_size);
+    } else if (rtc_valid) {
+        // No NVS: soft resets still count from the RTC copy
+        boot_count = boot_record.boot_count;
+        crash_count = boot_record.crash_count;
+    }
+    
+    boot_count++;
+    if (is_crash_reset(boot_reset_reason)) {
+        crash_count++;
+    }
+    
+    boot_record.magic = BOOT_RECORD_MAGIC;
+    boot_record.boot_count = boot_count;
+    boot_record.crash_count = crash_count;
+    boot_record.check = ~(boot_count ^ crash_count);
+    boot_accounted = true;
+    
+    if (metrics_nvs_handle != 0) {
+        nvs_set_blob(metrics_nvs_handle, "boot_count", &boot_count, sizeof(boot_count));
+        nvs_set_blob(metrics_nvs_handle, "crash_count", &crash_count, sizeof(crash_count));
+        esp_err_t ret = nvs_commit(metrics_nvs_handle);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to save boot counters: %s", esp_err_to_name(ret));
+        }
+    }
+    ESP_LOGI(TAG, "Boot count: %lu, crash count: %lu", (unsigned long)boot_count, (unsigned long)crash_count);
+}
@@ -19,8 +19,12 @@
 // =============================
 // Includes
 // =============================
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "esp_adc/adc_oneshot.h"
+#include "esp_partition.h"
+#include "esp_wifi_types.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,6 +38,18 @@ extern "C" {
  * @brief Maximum length for metric string values
  */
 #define METRIC_MAX_STRING_LENGTH 128
+#define METRIC_TTL_NONE 0                ///< Read on every call
+#define METRIC_TTL_STATIC UINT32_MAX     ///< Read once at system_metrics_init()
+#define METRIC_COLLECT_CHUNK 4           ///< Samples per system_metrics_collect() call that suit a task stack
+
+/**
+ * @brief 0 drops every set_metric_provider() call, and with it the provider's formatting code
+ *
+ * For firmware with no page or topic that reads the metrics ([env:node-minimal]).
+ */
+#ifndef SYSTEM_METRICS_PROVIDERS
+#define SYSTEM_METRICS_PROVIDERS 1
+#endif
 
 /**
  * @brief System metric identifiers
@@ -96,10 +112,66 @@ typedef enum {
     METRIC_OTA_UPDATE_STATUS,      ///< Status of over-the-air firmware updates
     METRIC_LAST_UPDATE_TIME,       ///< Timestamp of last firmware update
     METRIC_APP_SPECIFIC_TIMERS,    ///< Custom timing metrics for application logic
+    METRIC_HTTP_REQUESTS,          ///< HTTP requests served and failed (provider)
+    METRIC_HTTP_LATENCY,           ///< Average and worst HTTP handler latency (provider)
+    
+    // CPU Profiling Metrics
+    METRIC_CPU_LOAD,               ///< Busy percentage per core (provider)
+    METRIC_CPU_IDLE,               ///< Idle percentage, last interval and rolling (provider)
+    METRIC_TASK_STACK_MIN,         ///< Lowest stack high-water mark of any task (provider)
+    
+    // Heap Profiling Metrics
+    METRIC_HEAP_LARGEST_BLOCK,     ///< Largest free block of internal RAM in bytes
+    METRIC_HEAP_FRAGMENTATION,     ///< Share of free internal RAM outside the largest block
+    METRIC_HEAP_ALLOC_FAILURES,    ///< Failed allocations since boot (provider)
+    
+    // Network Accounting Metrics (reported in the wifi group)
+    METRIC_NET_PACKETS,            ///< TX/RX packets per interface (provider)
+    METRIC_NET_DROPS,              ///< lwIP drops and failed ESP-NOW sends (provider)
+    METRIC_DNS_QUERIES,            ///< DNS query rate, totals and rate-limited drops (provider)
+    METRIC_DNS_TOP_NAMES,          ///< Most queried DNS names with counts (provider)
+    
+    // Boot Profiling Metrics (reported in the application group)
+    METRIC_BOOT_TRACE,             ///< Time from reset to ready and the slowest stage (provider)
+    
+    // Sensor Sampling Metrics (reported in the application group)
+    METRIC_SAMPLER_JITTER,         ///< Per-sensor sampling jitter, overruns and drops (provider)
+    METRIC_ESPNOW_BATCH,           ///< ESP-NOW batch size, delivery rate and resends (provider)
+    METRIC_GATEWAY_NODES,          ///< Nodes reporting to the gateway and the weakest link (provider)
+    
+    // Flash and Filesystem Metrics (reported in the application group)
+    METRIC_LONG_OP_SLICES,         ///< Longest slice of each long flash or file operation (provider)
     
     METRIC_COUNT                   ///< Total number of available metrics
 } system_metric_t;
 
+/**
+ * @brief Metric groups, matching the sections of system_metric_t
+ */
+typedef enum {
+    METRIC_GROUP_SYSTEM,           ///< System performance & resource metrics
+    METRIC_GROUP_POWER,            ///< Power management metrics
+    METRIC_GROUP_WIFI,             ///< WiFi connectivity metrics
+    METRIC_GROUP_BLUETOOTH,        ///< Bluetooth connectivity metrics
+    METRIC_GROUP_STORAGE,          ///< Storage & peripheral metrics
+    METRIC_GROUP_HARDWARE,         ///< Hardware information
+    METRIC_GROUP_TASKS,            ///< Task and runtime information
+    METRIC_GROUP_APPLICATION,      ///< Application-specific metrics
+    METRIC_GROUP_CPU,              ///< CPU load and per-task profiling
+    METRIC_GROUP_MEMORY,           ///< Heap fragmentation and allocation profiling
+    METRIC_GROUP_COUNT             ///< Total number of metric groups
+} metric_group_t;
+
+/**
+ * @brief A set of metrics, bit n for metric n
+ */
+typedef uint64_t metric_mask_t;
+
+#define METRIC_MASK(metric) ((metric_mask_t)1 << (metric))
+#define METRIC_MASK_ALL (METRIC_MASK(METRIC_COUNT) - 1)
+
+_Static_assert(METRIC_COUNT < 64, "metric_mask_t has a bit per metric");
+
 /**
  * @brief Error codes for system metrics
  */
@@ -112,6 +184,85 @@ typedef enum {
     METRIC_ERROR_BUFFER_TOO_SMALL  ///< Output buffer too small
 } metric_error_t;
 
+/**
+ * @brief Kind of value held by a metric_value_t
+ */
+typedef enum {
+    METRIC_VALUE_INT,              ///< i is valid
+    METRIC_VALUE_FLOAT,            ///< f is valid
+    METRIC_VALUE_STRING            ///< s is valid (text metrics, and error messages)
+} metric_value_type_t;
+
+/**
+ * @brief A metric as a number plus unit, before any string formatting
+ */
+typedef struct {
+    metric_value_type_t type;      ///< Which member of the union is valid
+    const char* unit;              ///< Static unit string, e.g. "bytes", "dBm"; "" if unitless
+    union {
+        int64_t i;
+        float f;
+        char s[METRIC_MAX_STRING_LENGTH];
+    };
+} metric_value_t;
+
+/**
+ * @brief One metric read by system_metrics_collect()
+ */
+typedef struct {
+    system_metric_t metric;
+    metric_error_t error;          ///< As get_metric_value() or get_system_metric_r() would report it
+    metric_value_t value;          ///< Typed, or the display string in a text batch; the error text on error
+} metric_sample_t;
+
+/**
+ * @brief A batch of metrics being collected
+ * 
+ * Reads that several metrics need (the AP record, partition handles) are
+ * made once per batch, the first time a metric asks, and kept here. Set up
+ * with system_metrics_batch_init(); the other fields are the library's.
+ */
+typedef struct {
+    metric_mask_t pending;         ///< Metrics still to collect
+    bool text;                     ///< Display strings as get_system_metric_r() formats them, else typed values
+    uint8_t fetched;               ///< Which shared reads below are done
+    esp_err_t ap_err;
+    wifi_ap_record_t ap;
+    const esp_partition_t* running;
+    const esp_partition_t* boot;
+    const esp_partition_t* data;
+} metric_batch_t;
+
+/**
+ * @brief What a metric is, independent of its current value
+ */
+typedef struct {
+    const char* name;              ///< Short lowercase name, e.g. "free_heap"
+    const char* unit;              ///< Unit of the built-in typed value; "" if unitless or text
+} metric_info_t;
+
+/**
+ * @brief Raw values of the most-used metrics, filled in one call
+ * 
+ * Each *_valid / *_connected / *_mounted flag says whether the fields next
+ * to it were read successfully.
+ */
+typedef struct {
+    int64_t uptime_us;             ///< Time since boot
+    uint32_t free_heap;            ///< Bytes
+    uint32_t min_free_heap;        ///< Bytes, low-water mark since boot
+    uint32_t task_count;           ///< FreeRTOS tasks
+    bool wifi_connected;           ///< STA associated; wifi_rssi is valid
+    int8_t wifi_rssi;              ///< dBm
+    bool spiffs_mounted;           ///< spiffs_total/spiffs_used are valid
+    size_t spiffs_total;           ///< Bytes
+    size_t spiffs_used;            ///< Bytes
+    bool vdd33_valid;              ///< vdd33_mv is valid
+    int vdd33_mv;                  ///< Millivolts
+    bool cpu_temperature_valid;    ///< cpu_temperature_c is valid
+    float cpu_temperature_c;       ///< Degrees Celsius
+} system_metrics_snapshot_t;
+
 // =============================
 // Function Prototypes
 // =============================
@@ -138,8 +289,9 @@ bool system_metrics_init(void);
  *         or error message if metric is unavailable. The returned pointer
  *         points to internal static storage and should not be freed.
  * 
- * @note The returned string is valid until the next call to this function.
- *       Copy the string if you need to retain it across multiple calls.
+ * @note The returned string is valid until the next call to this function,
+ *       from any task. Use get_system_metric_r() when more than one task
+ *       reads metrics.
  * 
  * @example
  * ```c
@@ -149,6 +301,92 @@ bool system_metrics_init(void);
  */
 const char* get_system_metric(system_metric_t metric);
 
+/**
+ * @brief Reentrant variant of get_system_metric()
+ * 
+ * Formats the metric into the caller's buffer and reports the error through
+ * err instead of get_metric_error(), so any number of tasks can read metrics
+ * at the same time without locking.
+ * 
+ * @param metric The metric to retrieve
+ * @param buf Output buffer; METRIC_MAX_STRING_LENGTH bytes fit every metric
+ * @param buf_len Size of the output buffer
+ * @param err Receives the error code; may be NULL
+ * @return buf
+ * 
+ * @example
+ * ```c
+ * char value[METRIC_MAX_STRING_LENGTH];
+ * metric_error_t err;
+ * get_system_metric_r(METRIC_FREE_HEAP, value, sizeof(value), &err);
+ * ```
+ */
+const char* get_system_metric_r(system_metric_t metric, char* buf, size_t buf_len, metric_error_t* err);
+
+/**
+ * @brief Get a metric as a typed value without formatting it
+ * 
+ * Numeric metrics come back as METRIC_VALUE_INT or METRIC_VALUE_FLOAT with
+ * their unit; text-only metrics (IP address, status strings) come back as
+ * METRIC_VALUE_STRING. On error, s holds the error message. Reentrant like
+ * get_system_metric_r().
+ * 
+ * @param metric The metric to retrieve
+ * @param value Receives the value
+ * @return METRIC_OK, or the reason the value is unavailable
+ */
+metric_error_t get_metric_value(system_metric_t metric, metric_value_t* value);
+
+/**
+ * @brief Format a typed value generically as "<number> <unit>" or the string
+ * 
+ * Integers print in full, floats with two decimals. This is the compact
+ * on-demand formatting; get_system_metric_r() keeps each metric's own layout.
+ * 
+ * @param value Value from get_metric_value()
+ * @param buf Output buffer
+ * @param buf_len Size of the output buffer
+ * @return Length snprintf() would have written, excluding the terminator
+ */
+int format_metric_value(const metric_value_t* value, char* buf, size_t buf_len);
+
+/**
+ * @brief Start collecting a set of metrics in one batch
+ * 
+ * @param batch Batch to set up
+ * @param metrics Metrics to collect, e.g. METRIC_MASK_ALL or get_metric_group_mask()
+ * @param text true for display strings (/api/metrics, MQTT, the live stream),
+ *             false for typed values (/metrics, alarms)
+ */
+void system_metrics_batch_init(metric_batch_t* batch, metric_mask_t metrics, bool text);
+
+/**
+ * @brief Collect the next metrics of a batch, in id order
+ * 
+ * Each result is what get_metric_value() (or, in a text batch,
+ * get_system_metric_r()) returns for the metric, cache and providers
+ * included. Call until it returns 0; METRIC_COLLECT_CHUNK samples at a time
+ * keep the caller's stack small while the batch still shares its reads.
+ * Reentrant: each batch belongs to its caller.
+ * 
+ * @param batch Batch from system_metrics_batch_init()
+ * @param out Receives the samples
+ * @param out_len Room in out
+ * @return Samples written; 0 once the batch is done
+ * 
+ * @example
+ * ```c
+ * metric_batch_t batch;
+ * metric_sample_t samples[METRIC_COLLECT_CHUNK];
+ * system_metrics_batch_init(&batch, get_metric_group_mask(METRIC_GROUP_WIFI), false);
+ * size_t n;
+ * while ((n = system_metrics_collect(&batch, samples, METRIC_COLLECT_CHUNK)) > 0) {
+ *     ...
+ * }
+ * ```
+ */
+size_t system_metrics_collect(metric_batch_t* batch, metric_sample_t* out, size_t out_len);
+
 /**
  * @brief Get the last error code from metric retrieval
  * 
@@ -156,6 +394,33 @@ const char* get_system_metric(system_metric_t metric);
  */
 metric_error_t get_metric_error(void);
 
+/**
+ * @brief Read the most-used metrics as numbers into a caller-owned struct
+ * 
+ * Reentrant and lock-free like get_system_metric_r(); no string formatting.
+ * 
+ * @param snapshot Receives the values
+ */
+void get_system_metrics_snapshot(system_metrics_snapshot_t* snapshot);
+
+/**
+ * @brief How long a metric's result is cached
+ * 
+ * Expensive reads (sensors, SPIFFS, Wi-Fi driver queries) are reused for
+ * their TTL by every caller, so concurrent clients cost the same as one.
+ * 
+ * @param metric The metric to ask about
+ * @return TTL in milliseconds, METRIC_TTL_STATIC or METRIC_TTL_NONE
+ */
+uint32_t get_metric_ttl_ms(system_metric_t metric);
+
+/**
+ * @brief Drop a cached result so the next read goes to the hardware
+ * 
+ * @param metric The metric to refresh, or METRIC_COUNT for all of them
+ */
+void invalidate_metric_cache(system_metric_t metric);
+
 /**
  * @brief Get a human-readable description of a metric
  * 
@@ -164,6 +429,104 @@ metric_error_t get_metric_error(void);
  */
 const char* get_metric_description(system_metric_t metric);
 
+/**
+ * @brief Get the short name and unit of a metric
+ * 
+ * For self-describing APIs. The answer is fixed at compile time, so it does
+ * not change when a provider (set_metric_provider()) replaces a reading.
+ * 
+ * @param metric The metric to describe
+ * @param info Receives the facts
+ * @return false for an invalid metric
+ */
+bool get_metric_info(system_metric_t metric, metric_info_t* info);
+
+/**
+ * @brief Get the group a metric belongs to
+ * 
+ * @param metric The metric to classify
+ * @return Group of the metric, or METRIC_GROUP_COUNT for an invalid metric
+ */
+metric_group_t get_metric_group(system_metric_t metric);
+
+/**
+ * @brief Get the metrics of a group as a mask; OR several for a multi-group batch
+ * 
+ * @param group The group
+ * @return Its metrics, 0 for an invalid group
+ */
+metric_mask_t get_metric_group_mask(metric_group_t group);
+
+/**
+ * @brief Get the short lowercase name of a metric group (e.g. "wifi")
+ * 
+ * @param group The group to name
+ * @return Pointer to null-terminated group name, or "unknown"
+ */
+const char* get_metric_group_name(metric_group_t group);
+
+/**
+ * @brief Look up a metric group by its short name
+ * 
+ * @param name Group name as returned by get_metric_group_name()
+ * @return Matching group, or METRIC_GROUP_COUNT if the name is unknown
+ */
+metric_group_t get_metric_group_by_name(const char* name);
+
+/**
+ * @brief Get the short lowercase name of a metric error (e.g. "not_available")
+ * 
+ * @param error The error code to name
+ * @return Pointer to null-terminated error name
+ */
+const char* get_metric_error_name(metric_error_t error);
+
+/**
+ * @brief Format a metric result as {"id":N,"value":"...","status":"ok"|"error"}
+ * 
+ * Error results carry get_metric_error_name() as their value. This is the
+ * shape used by /get_metric, /api/metrics and the live metrics stream.
+ * 
+ * @param buf Output buffer
+ * @param buf_len Size of the output buffer
+ * @param metric The metric the result belongs to
+ * @param value Value returned by get_system_metric()
+ * @param error Error returned by get_metric_error() for that read
+ * @return Length snprintf() would have written, excluding the terminator
+ */
+int format_metric_json(char* buf, size_t buf_len, system_metric_t metric,
+                       const char* value, metric_error_t error);
+
+/**
+ * @brief Formats an application-supplied metric into buf
+ * 
+ * @return METRIC_OK, or the error to report for the metric
+ */
+typedef metric_error_t (*metric_provider_fn)(char* buf, size_t buf_len);
+
+/**
+ * @brief Let the application supply the value of a metric
+ * 
+ * For metrics whose data lives outside this library (e.g. the web server's
+ * request statistics). Metrics that exist only as providers report
+ * not_available until one is set. A provider on a built-in metric replaces
+ * the built-in reading (e.g. METRIC_TASK_RUNTIME_STATS once real run-time
+ * stats exist); providers are never cached.
+ * 
+ * @param metric Any metric
+ * @param provider Formatter, or NULL to remove it
+ * @return false for an invalid metric
+ */
+#if SYSTEM_METRICS_PROVIDERS
+bool set_metric_provider(system_metric_t metric, metric_provider_fn provider);
+#else
+static inline bool set_metric_provider(system_metric_t metric, metric_provider_fn provider)
+{
+    (void)provider;
+    return metric < METRIC_COUNT;
+}
+#endif
+
 /**
  * @brief Update the boot count value in NVS
  * 
@@ -186,6 +549,44 @@ bool update_boot_count(uint32_t new_count);
  */
 bool get_boot_count(uint32_t *count);
 
+/**
+ * @brief Release ADC1, which METRIC_VDD33_VOLTAGE holds, so the ULP can sample it in deep sleep
+ * 
+ * METRIC_VDD33_VOLTAGE reports not available afterwards; the next boot
+ * claims the ADC again in system_metrics_init().
+ */
+void system_metrics_release_adc(void);
+
+/**
+ * @brief The ADC1 unit METRIC_VDD33_VOLTAGE reads, for modules sampling other ADC1 channels
+ * 
+ * ESP32 ADC2 is unusable while WiFi runs, so every analog input shares this
+ * unit. Callers configure their own channel with adc_oneshot_config_channel().
+ * A read that finds the unit busy fails with ESP_ERR_TIMEOUT instead of waiting.
+ * 
+ * @return The unit, or NULL if it could not be claimed or was released
+ */
+adc_oneshot_unit_handle_t system_metrics_adc_unit(void);
+
+/**
+ * @brief Reads a voltage supplied by the application
+ * 
+ * @param mv Millivolts
+ * @return true if mv holds a reading
+ */
+typedef bool (*system_metrics_mv_fn)(int* mv);
+
+/**
+ * @brief Take METRIC_VDD33_VOLTAGE from the application instead of a oneshot conversion
+ * 
+ * For an application that released ADC1 (system_metrics_release_adc()) to
+ * sample it continuously. The value is typed and cached as the built-in
+ * reading is, so snapshots and history keep working.
+ * 
+ * @param reader Reader, or NULL to go back to the oneshot unit
+ */
+void system_metrics_set_vdd33_reader(system_metrics_mv_fn reader);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,400 @@
+#!/usr/bin/env python3
+"""
+Pre-build script for ESP32-WeatherStation-Boat
+Stages the web UI from data/ into the filesystem image directory and stores a
+gzip-compressed copy of every compressible asset next to the original.
+
+The web server sends the .gz variant with "Content-Encoding: gzip" whenever the
+client advertises gzip support, and falls back to the plain file otherwise.
+
+Each HTML page is staged as a single document: the styles.css rules the page
+can use, the shared scripts.js and the favicon (as a data: URI) are inlined and
+the result is minified, so a captive-portal browser gets to first paint in one
+round trip instead of four. The separate files are still staged for anything
+that asks for them. WEB_BUNDLE_PAGES=0 in the build flags stages the pages as
+written, for debugging in the browser.
+
+A manifest of strong ETags (a content hash of every staged file) is written
+alongside so the server can answer If-None-Match without hashing at runtime.
+
+The URI routing table (src/web_routes_table.h) is generated from the same
+listing: every asset plus the OS captive-portal probe paths, placed in a
+collision-free hash table so the server resolves any URI with one hash and one
+string compare.
+
+With WEB_EMBED_ASSETS=1 in the build flags the staged assets (the .gz copy where
+there is one) are also packed into one blob that src/CMakeLists.txt embeds in the
+app image, described by a generated table (src/web_assets_table.h) of offsets,
+sizes, content types and ETags. Other builds get no blob, so nothing is embedded.
+"""
+
+Import("env")
+import gzip
+import hashlib
+import base64
+import os
+import re
+import shutil
+from pathlib import Path
+
+# File types worth compressing (already-compressed formats are left alone)
+COMPRESSIBLE_EXTENSIONS = {".html", ".css", ".js", ".json", ".svg", ".txt", ".ico"}
+
+# Only keep a .gz copy when it saves at least this fraction of the original
+MIN_SAVING_RATIO = 0.10
+
+# Must match ASSET_MANIFEST_FILE in include/asset_cache.h
+MANIFEST_NAME = "etags.txt"
+
+# Content types by extension; anything else is served as text/plain
+MIME_TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+    ".png": "image/png",
+    ".txt": "text/plain",
+}
+
+# Connectivity-check paths requested by phone and desktop OSes after joining the AP.
+# Probes answered with 204 make the OS treat the network as online.
+CAPTIVE_PROBES = {
+    "/generate_204": "WEB_ROUTE_PROBE_NO_CONTENT",          # Android / Chrome
+    "/gen_204": "WEB_ROUTE_PROBE_NO_CONTENT",               # Android
+    "/ncsi.txt": "WEB_ROUTE_PROBE_NO_CONTENT",              # Windows (legacy)
+    "/hotspot-detect.html": "WEB_ROUTE_PROBE_REDIRECT",     # Apple
+    "/library/test/success.html": "WEB_ROUTE_PROBE_REDIRECT",  # Apple (legacy)
+    "/connecttest.txt": "WEB_ROUTE_PROBE_REDIRECT",         # Windows
+    "/redirect": "WEB_ROUTE_PROBE_REDIRECT",                # Windows
+    "/success.txt": "WEB_ROUTE_PROBE_REDIRECT",             # Firefox
+    "/canonical.html": "WEB_ROUTE_PROBE_REDIRECT",          # Firefox
+    "/connectivity-check.html": "WEB_ROUTE_PROBE_REDIRECT", # GNOME NetworkManager
+    "/check_network_status.txt": "WEB_ROUTE_PROBE_REDIRECT",  # KDE
+    "/kindle-wifi/wifistub.html": "WEB_ROUTE_PROBE_REDIRECT",  # Kindle
+}
+
+# Shared assets inlined into every page that links them
+BUNDLE_STYLESHEET = "styles.css"
+BUNDLE_SCRIPT = "scripts.js"
+BUNDLE_ICON = "favicon.ico"
+
+# Content left exactly as written when a page is minified
+PRESERVED_TAGS = re.compile(r"(<(pre|textarea)\b.*?</\2>)", re.S | re.I)
+
+# Must match the EMBED_FILES path in src/CMakeLists.txt; the name gives the _binary_web_assets_bin_* symbols
+EMBED_BLOB = Path(".pio") / "embed" / "web_assets.bin"
+
+# Must match route_hash() in src/web_routes.c
+FNV_PRIME = 16777619
+FNV_OFFSET = 2166136261
+
+ROUTE_TABLE_HEADER = """/**
+ * @file web_routes_table.h
+ * @brief URI routing table - generated by scripts/build_web_assets.py, do not edit
+ */
+
+#ifndef WEB_ROUTES_TABLE_H
+#define WEB_ROUTES_TABLE_H
+
+"""
+
+
+def gzip_bytes(data):
+    """Compress deterministically (mtime=0) so unchanged assets give identical images"""
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def etag_of(data):
+    """Quoted strong ETag, as the manifest gives it and the asset cache serves it"""
+    return '"' + hashlib.sha256(data).hexdigest()[:16] + '"'
+
+
+def route_hash(uri, seed):
+    h = seed
+    for byte in uri.encode():
+        h = ((h ^ byte) * FNV_PRIME) & 0xFFFFFFFF
+    return h
+
+
+def write_route_table(source_dir, out_path):
+    """Generate a perfect-hash URI table from the asset listing and the probe paths"""
+    routes = [("/", "/index.html", "text/html", "WEB_ROUTE_ASSET")]
+    for src in sorted(source_dir.rglob("*")):
+        if not src.is_file() or src.suffix == ".gz" or src.name == MANIFEST_NAME:
+            continue
+        uri = "/" + src.relative_to(source_dir).as_posix()
+        routes.append((uri, uri, MIME_TYPES.get(src.suffix.lower(), "text/plain"), "WEB_ROUTE_ASSET"))
+    for uri, kind in sorted(CAPTIVE_PROBES.items()):
+        if uri not in {r[0] for r in routes}:
+            routes.append((uri, None, None, kind))
+
+    # Smallest power-of-two table with at most 50% load, then hunt for a seed without collisions
+    slots = 1
+    while slots < len(routes) * 2:
+        slots *= 2
+    while True:
+        for seed in range(FNV_OFFSET, FNV_OFFSET + 100000):
+            buckets = {}
+            for i, (uri, _, _, _) in enumerate(routes):
+                buckets.setdefault(route_hash(uri, seed) & (slots - 1), []).append(i)
+            if all(len(b) == 1 for b in buckets.values()):
+                break
+        else:
+            slots *= 2
+            continue
+        break
+
+    table = [-1] * slots
+    for slot, (index,) in buckets.items():
+        table[slot] = index
+
+    def c_str(value):
+        return "NULL" if value is None else '"' + value + '"'
+
+    lines = [ROUTE_TABLE_HEADER]
+    lines.append(f"#define WEB_ROUTE_COUNT {len(routes)}\n")
+    lines.append(f"#define WEB_ROUTE_SLOT_COUNT {slots}\n")
+    lines.append(f"#define WEB_ROUTE_HASH_SEED 0x{seed:08X}u\n\n")
+    lines.append("static const web_route_t web_route_table[WEB_ROUTE_COUNT] = {\n")
+    for uri, path, mime, kind in routes:
+        lines.append(f"    {{ {c_str(uri)}, {c_str(path)}, {c_str(mime)}, {kind} }},\n")
+    lines.append("};\n\n")
+    lines.append("// Route index per hash slot, -1 for an empty slot\n")
+    lines.append("static const int8_t web_route_slots[WEB_ROUTE_SLOT_COUNT] = {\n")
+    for i in range(0, slots, 16):
+        lines.append("    " + ", ".join(f"{v:2d}" for v in table[i:i + 16]) + ",\n")
+    lines.append("};\n\n#endif // WEB_ROUTES_TABLE_H\n")
+
+    text = "".join(lines)
+    if not out_path.exists() or out_path.read_text() != text:
+        out_path.write_text(text)
+        print(f"🧭 Routing table: {len(routes)} URIs in {slots} slots (seed 0x{seed:08X})")
+
+
+def css_blocks(css):
+    """Split a stylesheet into top-level (prelude, body) pairs; nested braces stay in the body"""
+    blocks = []
+    depth = 0
+    start = 0
+    prelude = ""
+    for i, ch in enumerate(css):
+        if ch == "{":
+            if depth == 0:
+                prelude = css[start:i].strip()
+                start = i + 1
+            depth += 1
+        elif ch == "}":
+            depth -= 1
+            if depth == 0:
+                blocks.append((prelude, css[start:i]))
+                start = i + 1
+    return blocks
+
+
+def minify_css(css):
+    """Drop comments and the whitespace the browser ignores"""
+    css = re.sub(r"/\*.*?\*/", "", css, flags=re.S)
+    css = re.sub(r"\s+", " ", css)
+    css = re.sub(r"\s*([{};,>])\s*", r"\1", css)
+    return css.replace(";}", "}").strip()
+
+
+def selector_used(selector, words):
+    """A selector can match if every class and id it names appears somewhere in the page or its scripts"""
+    names = re.findall(r"[.#]([A-Za-z_][\w-]*)", re.sub(r"\[[^\]]*\]|\([^)]*\)", "", selector))
+    return all(name in words for name in names)
+
+
+def critical_css(css, words):
+    """The rules of css that the page can use, minified; @keyframes and the like are kept whole"""
+    out = []
+    for prelude, body in css_blocks(re.sub(r"/\*.*?\*/", "", css, flags=re.S)):
+        if prelude.startswith("@media") or prelude.startswith("@supports"):
+            inner = critical_css(body, words)
+            if inner:
+                out.append(f"{minify_css(prelude)}{{{inner}}}")
+        elif prelude.startswith("@"):
+            out.append(minify_css(f"{prelude}{{{body}}}"))
+        else:
+            used = [sel.strip() for sel in prelude.split(",") if selector_used(sel, words)]
+            if used:
+                out.append(minify_css(f"{','.join(used)}{{{body}}}"))
+    return "".join(out)
+
+
+def minify_html(html):
+    """Drop comments, indentation and blank lines, outside <pre> and <textarea>"""
+    parts = PRESERVED_TAGS.split(html)
+    out = []
+    # split() with two groups gives text, whole match, tag name, text, ...
+    for i in range(0, len(parts), 3):
+        text = re.sub(r"<!--(?!\[if).*?-->", "", parts[i], flags=re.S)
+        out.append("\n".join(line.strip() for line in text.splitlines() if line.strip()))
+        if i + 1 < len(parts):
+            out.append(parts[i + 1])
+    return "".join(out)
+
+
+def bundle_page(src, source_dir):
+    """One self-contained, minified document for an HTML page"""
+    html = src.read_text(encoding="utf-8")
+    stylesheet = source_dir / BUNDLE_STYLESHEET
+    script = source_dir / BUNDLE_SCRIPT
+    icon = source_dir / BUNDLE_ICON
+    shared_js = script.read_text(encoding="utf-8") if script.exists() else ""
+
+    link_css = re.compile(r'<link\s+rel="stylesheet"\s+href="/?' + re.escape(BUNDLE_STYLESHEET) + r'"\s*/?>')
+    if stylesheet.exists() and link_css.search(html):
+        # Class names the page uses, including ones its scripts add; unknown words only keep extra rules
+        words = set(re.findall(r"[\w-]+", html + (shared_js if BUNDLE_SCRIPT in html else "")))
+        css = critical_css(stylesheet.read_text(encoding="utf-8"), words)
+        html = link_css.sub(lambda m: f"<style>{css}</style>", html, count=1)
+
+    script_tag = re.compile(r'<script\s+src="/?' + re.escape(BUNDLE_SCRIPT) + r'"\s*>\s*</script>')
+    if shared_js and script_tag.search(html):
+        html = script_tag.sub(lambda m: "<script>\n" + shared_js.replace("</script", "<\\/script") + "\n</script>",
+                              html, count=1)
+
+    link_icon = re.compile(r'<link\s+rel="icon"\s+href="/?' + re.escape(BUNDLE_ICON) + r'"([^>]*)>')
+    if icon.exists():
+        # A page without an icon link would still cost the browser a /favicon.ico request
+        uri = "data:image/x-icon;base64," + base64.b64encode(icon.read_bytes()).decode()
+        if link_icon.search(html):
+            html = link_icon.sub(lambda m: f'<link rel="icon" href="{uri}"{m.group(1)}>', html, count=1)
+        else:
+            html = html.replace("</head>", f'<link rel="icon" href="{uri}" type="image/x-icon">\n</head>', 1)
+
+    # Inline <style> blocks the page carries itself are minified but not pruned
+    html = re.sub(r"(<style>)(.*?)(</style>)", lambda m: m.group(1) + minify_css(m.group(2)) + m.group(3),
+                  html, flags=re.S)
+    return minify_html(html).encode("utf-8")
+
+
+def stage_web_assets(project_dir, source_dir, stage_dir, bundle):
+    """Mirror source_dir into stage_dir, adding .gz siblings for compressible files"""
+    print("=" * 50)
+    print("🗜️  Staging web assets for filesystem image...")
+    if bundle:
+        print(f"   Pages bundled with {BUNDLE_STYLESHEET}, {BUNDLE_SCRIPT} and {BUNDLE_ICON} inlined")
+
+    stage_dir.mkdir(parents=True, exist_ok=True)
+    expected = set()
+    total_raw = 0
+    total_gz = 0
+
+    for src in sorted(source_dir.rglob("*")):
+        if not src.is_file() or src.suffix == ".gz" or src.name == MANIFEST_NAME:
+            continue
+
+        rel = src.relative_to(source_dir)
+        dst = stage_dir / rel
+        dst.parent.mkdir(parents=True, exist_ok=True)
+        expected.add(dst)
+
+        if src.suffix.lower() == ".html":
+            # Compared by content: the staged page also changes with the shared assets and the flag
+            content = bundle_page(src, source_dir) if bundle else src.read_bytes()
+            if not dst.exists() or dst.read_bytes() != content:
+                dst.write_bytes(content)
+        elif not dst.exists() or dst.stat().st_mtime < src.stat().st_mtime:
+            shutil.copy2(src, dst)
+
+        raw_size = dst.stat().st_size
+        total_raw += raw_size
+
+        if src.suffix.lower() not in COMPRESSIBLE_EXTENSIONS:
+            total_gz += raw_size
+            continue
+
+        gz_dst = dst.with_name(dst.name + ".gz")
+        compressed = gzip_bytes(dst.read_bytes())
+
+        if len(compressed) > raw_size * (1.0 - MIN_SAVING_RATIO):
+            # Not worth it - serve the plain file
+            total_gz += raw_size
+            print(f"   {rel}: {raw_size:,} bytes (kept uncompressed)")
+            continue
+
+        expected.add(gz_dst)
+        if not gz_dst.exists() or gz_dst.read_bytes() != compressed:
+            gz_dst.write_bytes(compressed)
+        total_gz += len(compressed)
+        print(f"   {rel}: {raw_size:,} → {len(compressed):,} bytes gzip")
+
+    # One "<path> <etag>" line per staged file, keyed exactly as the server looks them up
+    manifest = stage_dir / MANIFEST_NAME
+    expected.add(manifest)
+    lines = []
+    for staged in sorted(expected - {manifest}):
+        digest = hashlib.sha256(staged.read_bytes()).hexdigest()[:16]
+        lines.append(f"/{staged.relative_to(stage_dir).as_posix()} {digest}\n")
+    manifest_text = "".join(lines)
+    if not manifest.exists() or manifest.read_text() != manifest_text:
+        manifest.write_text(manifest_text)
+
+    # Remove anything left over from assets that were deleted or renamed
+    for stale in [p for p in stage_dir.rglob("*") if p.is_file() and p not in expected]:
+        stale.unlink()
+
+    if total_gz > 0:
+        print(f"✅ Web assets: {total_raw:,} bytes raw, {total_gz:,} bytes on the wire with gzip "
+              f"({total_raw / total_gz:.1f}x)")
+    print("=" * 50)
+
+
+ASSET_TABLE_HEADER = """/**
+ * @file web_assets_table.h
+ * @brief Embedded web asset table - generated by scripts/build_web_assets.py, do not edit
+ */
+
+#ifndef WEB_ASSETS_TABLE_H
+#define WEB_ASSETS_TABLE_H
+
+"""
+
+
+def write_embedded_assets(stage_dir, table_path, blob_path, embed):
+    """Pack the staged assets into the blob for EMBED_FILES and describe them in table_path"""
+    entries = []
+    blob = bytearray()
+    for staged in sorted(stage_dir.rglob("*")):
+        if not staged.is_file() or staged.suffix == ".gz" or staged.name == MANIFEST_NAME:
+            continue
+        gz = staged.with_name(staged.name + ".gz")
+        data = (gz if gz.exists() else staged).read_bytes()
+        path = "/" + staged.relative_to(stage_dir).as_posix()
+        mime = MIME_TYPES.get(staged.suffix.lower(), "text/plain")
+        entries.append((path, mime, etag_of(data), len(blob), len(data), gz.exists()))
+        blob += data
+
+    lines = [ASSET_TABLE_HEADER]
+    lines.append(f"#define WEB_ASSET_COUNT {len(entries)}\n")
+    lines.append(f"#define WEB_ASSET_BLOB_SIZE {len(blob)}\n\n")
+    lines.append("static const web_asset_t web_asset_table[WEB_ASSET_COUNT] = {\n")
+    for path, mime, etag, offset, size, gzipped in entries:
+        etag_c = etag.replace('"', '\\"')
+        lines.append(f'    {{ "{path}", "{mime}", "{etag_c}", {offset}, {size}, {"true" if gzipped else "false"} }},\n')
+    lines.append("};\n\n#endif // WEB_ASSETS_TABLE_H\n")
+    text = "".join(lines)
+    if not table_path.exists() or table_path.read_text() != text:
+        table_path.write_text(text)
+
+    # The blob's presence is what makes src/CMakeLists.txt embed it
+    if embed:
+        blob_path.parent.mkdir(parents=True, exist_ok=True)
+        if not blob_path.exists() or blob_path.read_bytes() != bytes(blob):
+            blob_path.write_bytes(bytes(blob))
+        print(f"📦 Embedded assets: {len(entries)} files, {len(blob):,} bytes in the app image")
+    elif blob_path.exists():
+        blob_path.unlink()
+
+
+project_dir = Path(env["PROJECT_DIR"])
+build_flags = env.GetProjectOption("build_flags", "")
+stage_web_assets(project_dir, project_dir / "data", Path(env.subst("$PROJECT_DATA_DIR")),
+                 "WEB_BUNDLE_PAGES=0" not in build_flags)
+write_route_table(project_dir / "data", project_dir / "src" / "web_routes_table.h")
+write_embedded_assets(Path(env.subst("$PROJECT_DATA_DIR")), project_dir / "src" / "web_assets_table.h",
+                      project_dir / EMBED_BLOB, "WEB_EMBED_ASSETS=1" in build_flags)
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""
+Post-build script for ESP32-WeatherStation-Boat
+Checks the link map of an IRAM_HOT_PATHS=1 build ([env:iram], see
+include/iram_profile.h) for the hot-path functions and their data.
+
+The app is built with -ffunction-sections and -fdata-sections, so a function
+the linker put in flash shows in the map as a ".text.<name>" (or
+".literal.<name>") input section of its object, and flash-resident data as
+".rodata.<name>". IRAM_ATTR code goes to ".iram1.<n>" sections instead, which
+carry no name. A listed function found under a flash section, or listed data
+under rodata, fails the build with the list of offenders. Sections the linker
+discarded are not counted.
+
+Other builds are not checked.
+
+Run by hand on any map:  python3 scripts/iram_audit.py .pio/build/iram/firmware.map
+"""
+
+import re
+import sys
+from pathlib import Path
+
+# Object (source file stem) -> functions that must be in IRAM
+HOT_FUNCTIONS = {
+    "espnow_link": ["recv_cb", "send_cb"],
+    "spsc_ring": ["spsc_ring_acquire", "spsc_ring_commit", "spsc_ring_front", "spsc_ring_release",
+                  "spsc_ring_count", "spsc_ring_space"],
+    "boot_trace": ["boot_trace_first_tx"],
+    "rain_gauge": ["tip_isr"],
+}
+
+# Object -> data those functions read, which must not be in flash
+HOT_DATA = {
+    "espnow_link": ["rx_ring", "rx_slots", "tx_ring", "link_task_handle", "rx_dropped"],
+    "boot_trace": ["first_tx_seen", "trace_lock"],
+    "rain_gauge": ["rain_lock", "pending", "held", "last_tip_us"],
+}
+
+FLASH_CODE_PREFIXES = (".text.", ".literal.")
+FLASH_DATA_PREFIXES = (".rodata.",)
+SECTION_LINE = re.compile(r"^ (\.[\w.$]+)(?:\s+0x[0-9a-f]+\s+0x[0-9a-f]+\s+(\S+))?\s*$")
+OBJECT_LINE = re.compile(r"^\s+0x[0-9a-f]+\s+0x[0-9a-f]+\s+(\S+)\s*$")
+
+
+def linked_sections(map_path):
+    """(section name, object path) of every input section the linker kept"""
+    lines = map_path.read_text(errors="replace").splitlines()
+    try:
+        start = next(i for i, line in enumerate(lines) if line.startswith("Linker script and memory map"))
+    except StopIteration:
+        return []
+
+    sections = []
+    pending = None
+    for line in lines[start:]:
+        if pending is not None:
+            # A long section name is printed alone, with its address and object on the next line
+            match = OBJECT_LINE.match(line)
+            if match:
+                sections.append((pending, match.group(1)))
+            pending = None
+            continue
+        match = SECTION_LINE.match(line)
+        if match:
+            if match.group(2):
+                sections.append((match.group(1), match.group(2)))
+            else:
+                pending = match.group(1)
+    return sections
+
+
+def object_stem(path):
+    """'.../libsrc.a(espnow_link.c.obj)' -> 'espnow_link'"""
+    name = path.rsplit("(", 1)[-1].rstrip(")")
+    name = Path(name).name
+    for suffix in (".c.obj", ".c.o", ".obj", ".o"):
+        if name.endswith(suffix):
+            return name[: -len(suffix)]
+    return name
+
+
+def audit(map_path):
+    """Print the offenders; True when there are none"""
+    offenders = []
+    for section, obj in linked_sections(map_path):
+        stem = object_stem(obj)
+        for prefix in FLASH_CODE_PREFIXES:
+            if section.startswith(prefix) and section[len(prefix):] in HOT_FUNCTIONS.get(stem, ()):
+                offenders.append(f"{stem}: {section[len(prefix):]}() is in flash ({section})")
+        for prefix in FLASH_DATA_PREFIXES:
+            if section.startswith(prefix) and section[len(prefix):] in HOT_DATA.get(stem, ()):
+                offenders.append(f"{stem}: {section[len(prefix):]} is in flash rodata")
+
+    if offenders:
+        print("❌ IRAM audit failed:")
+        for offender in offenders:
+            print(f"   {offender}")
+        return False
+    count = sum(len(names) for names in HOT_FUNCTIONS.values())
+    print(f"✅ IRAM audit: {count} hot-path functions are in IRAM, their data in DRAM")
+    return True
+
+
+def audit_build(source, target, env):
+    """Post action on the ELF: the map is written next to it"""
+    map_path = Path(str(target[0])).with_suffix(".map")
+    if not map_path.exists():
+        print(f"❌ IRAM audit: no link map at {map_path}")
+        env.Exit(1)
+    if not audit(map_path):
+        env.Exit(1)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        print(__doc__)
+        sys.exit(2)
+    sys.exit(0 if audit(Path(sys.argv[1])) else 1)
+
+Import("env")
+
+if "IRAM_HOT_PATHS=1" in env.GetProjectOption("build_flags", ""):
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", audit_build)
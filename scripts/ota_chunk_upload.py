@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""
+Resumable OTA upload over the portal's /api/ota/chunk API.
+
+Asks the device where the current session stands, then sends the missing
+chunks one PUT at a time, retrying through dropouts. Run it again after an
+interruption and it carries on from the last committed chunk. --json writes
+the bytes sent by this run, the time taken and the rate to a file, for
+scripts/perf_dashboard.py.
+
+Usage: ota_chunk_upload.py IMAGE [--host 192.168.4.1] [--type firmware|filesystem] [--json out.json]
+"""
+
+import argparse
+import hashlib
+import json
+import sys
+import time
+import urllib.error
+import urllib.request
+from pathlib import Path
+
+RETRY_DELAY_S = 2
+MAX_RETRIES = 20
+
+
+def request(method, url, body=None, timeout=30):
+    req = urllib.request.Request(url, data=body, method=method)
+    if body is not None:
+        req.add_header("Content-Type", "application/octet-stream")
+    with urllib.request.urlopen(req, timeout=timeout) as resp:
+        return json.loads(resp.read().decode() or "{}")
+
+
+def upload(image, host, image_type, json_out=None):
+    data = Path(image).read_bytes()
+    digest = hashlib.sha256(data).hexdigest()
+    base = f"http://{host}/api/ota/chunk"
+    params = f"size={len(data)}&type={image_type}&sha256={digest}"
+    print(f"📦 {image}: {len(data):,} bytes, SHA-256 {digest}")
+
+    # Resume only if the device holds a session for this exact image
+    state = request("GET", base)
+    same = state.get("active") and state.get("size") == len(data) and state.get("sha256") == digest \
+        and state.get("type") == image_type
+    offset = state["next_offset"] if same else 0
+    chunk_size = state["chunk_size"]
+    if offset:
+        print(f"↪️  Resuming at {offset:,} bytes")
+
+    resumed_at = offset
+    started = time.monotonic()
+    retries = 0
+    while True:
+        chunk = data[offset:offset + chunk_size]
+        try:
+            state = request("PUT", f"{base}?offset={offset}&{params}", chunk)
+        except (urllib.error.URLError, OSError) as e:
+            if isinstance(e, urllib.error.HTTPError) and e.code < 500 and e.code != 408:
+                print(f"❌ Device refused chunk at {offset}: {e.code} {e.read().decode()}")
+                return 1
+            retries += 1
+            if retries > MAX_RETRIES:
+                print(f"❌ Giving up at {offset:,} bytes: {e}")
+                return 1
+            print(f"⚠️  Chunk at {offset:,} failed ({e}), retrying...")
+            time.sleep(RETRY_DELAY_S)
+            continue
+
+        retries = 0
+        if state.get("complete"):
+            print(f"✅ Upload complete, device rebooting (SHA-256 {state.get('sha256')})")
+            if json_out:
+                write_result(json_out, len(data) - resumed_at, time.monotonic() - started, resumed_at)
+            return 0
+        offset = state["next_offset"]
+        print(f"   {state['chunks_done']}/{state['chunks_total']} chunks", end="\r")
+
+
+def write_result(path, sent, seconds, resumed_at):
+    """Bytes this run sent and how fast; retry pauses count, as they do for a user"""
+    kib_s = sent / 1024 / seconds if seconds > 0 else 0.0
+    result = {"kind": "ota_upload", "bytes": sent, "seconds": round(seconds, 3), "kib_s": round(kib_s, 1),
+              "resumed_at": resumed_at}
+    with open(path, "w") as f:
+        json.dump(result, f, indent=2)
+    print(f"💾 {sent:,} bytes in {seconds:.1f} s ({kib_s:.1f} KiB/s), written to {path}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("image")
+    parser.add_argument("--host", default="192.168.4.1")
+    parser.add_argument("--type", default="firmware", choices=["firmware", "filesystem"])
+    parser.add_argument("--json", help="also write the upload speed to this file")
+    args = parser.parse_args()
+    sys.exit(upload(args.image, args.host, args.type, args.json))
@@ -0,0 +1,335 @@
+#!/usr/bin/env python3
+"""
+Performance history per firmware version, with trend plots and regression flags.
+
+`add` reads what the benchmarks already write and files the numbers under the
+firmware version, taken from PROJECT_VERSION in platformio.ini (--version to
+override, e.g. when capturing an older build):
+
+  bench console capture   the BENCH_JSON_BEGIN/END document of bench_suite.h
+                          (the document alone is accepted too)
+  portal_load_test --json per-kind latency percentiles and error rate
+  ota_chunk_upload --json upload speed
+  /api/boot_trace         the boot trace JSON (include/boot_trace.h)
+  console log             the "ready ... ms since reset" line of boot_trace,
+                          the "Benchmark charge" lines of energy_bench and the
+                          "Best goodput" line of link_test
+
+Each input is stored as one run under perf/<version>/; a version's value for a
+metric is the median of its runs. `report` (also run after `add`) writes
+perf/dashboard.html, one SVG trend chart per area (boot time, energy per
+sample, HTTP latency, ESP-NOW throughput, OTA speed, other bench cases), and
+compares the newest version with the one before: a metric that got worse by
+more than --threshold percent is flagged and the exit status is 1.
+
+Usage: perf_dashboard.py add FILE... [--version 1.2.0] [--store perf]
+       perf_dashboard.py report [--threshold 10] [--store perf] [--out perf/dashboard.html]
+"""
+
+import argparse
+import html
+import json
+import re
+import statistics
+import sys
+import time
+from pathlib import Path
+
+PROJECT_DIR = Path(__file__).resolve().parent.parent
+DEFAULT_STORE = PROJECT_DIR / "perf"
+DEFAULT_THRESHOLD = 10.0
+
+# Chart order; a metric's area comes from the first matching name prefix
+AREAS = ["Boot time", "Energy per sample", "HTTP latency", "ESP-NOW throughput", "OTA speed", "Other bench cases"]
+AREA_PREFIXES = [
+    ("boot.", "Boot time"),
+    ("energy.", "Energy per sample"),
+    ("portal.", "HTTP latency"),
+    ("bench.http_ota", "OTA speed"),
+    ("bench.http", "HTTP latency"),
+    ("bench.tcp_", "HTTP latency"),
+    ("bench.tls_", "HTTP latency"),
+    ("link.", "ESP-NOW throughput"),
+    ("bench.espnow", "ESP-NOW throughput"),
+    ("ota.", "OTA speed"),
+    ("bench.flash_", "OTA speed"),
+    ("bench.sha256", "OTA speed"),
+]
+
+# Unit by metric name suffix, and whether more is better
+UNITS = [
+    ("kib_s", "KiB/s", True),
+    ("kbit_s", "kbit/s", True),
+    ("_ms", "ms", False),
+    ("_us", "µs", False),
+    ("_uah", "µAh", False),
+    ("_ratio", "ratio", False),
+]
+
+LOG_PATTERNS = [
+    # boot_trace_log(): "  ready             1234 ms since reset"
+    (re.compile(r"\bready\s+(\d+) ms since reset"), lambda m: {"boot.ready_ms": int(m[1])}),
+    # energy_bench_log()
+    (re.compile(r"Benchmark: (\d+) cycles, (\d+) samples in (\d+) ms; awake (\d+) ms, radio (\d+) ms"),
+     lambda m: {"energy.awake_per_sample_ms": int(m[4]) / int(m[2]),
+                "energy.radio_per_sample_ms": int(m[5]) / int(m[2])} if int(m[2]) > 0 else {}),
+    (re.compile(r"Benchmark charge: .* - (\d+)\.(\d{3}) uAh per sample"),
+     lambda m: {"energy.per_sample_uah": int(m[1]) + int(m[2]) / 1000}),
+    # link_test_log()
+    (re.compile(r"Best goodput .*?, (\d+) kbit/s"), lambda m: {"link.goodput_kbit_s": int(m[1])}),
+]
+
+
+def project_version():
+    """PROJECT_VERSION from the build flags in platformio.ini"""
+    text = (PROJECT_DIR / "platformio.ini").read_text()
+    match = re.search(r'-D\s*PROJECT_VERSION=\\?"([^"\\]+)\\?"', text)
+    if match is None:
+        sys.exit("❌ PROJECT_VERSION not found in platformio.ini; pass --version")
+    return match[1]
+
+
+def version_key(version):
+    """Sort 1.10.0 after 1.9.2; anything not numeric sorts by its text"""
+    parts = re.split(r"[.\-+]", version)
+    return [(0, int(p), "") if p.isdigit() else (1, 0, p) for p in parts]
+
+
+def unit_of(name):
+    for suffix, unit, higher_better in UNITS:
+        if name.endswith(suffix):
+            return unit, higher_better
+    return "", False
+
+
+def area_of(name):
+    for prefix, area in AREA_PREFIXES:
+        if name.startswith(prefix):
+            return area
+    return "Other bench cases"
+
+
+def bench_metrics(doc):
+    """Per case (and size): time per operation, and throughput where bytes moved"""
+    metrics = {}
+    for r in doc.get("results", []):
+        if r.get("err", "ESP_OK") != "ESP_OK" or not r.get("ops"):
+            continue
+        key = r["case"] + (f"_{r['size']}" if r.get("size") else "")
+        metrics[f"bench.{key}.per_op_us"] = r["us"] / r["ops"]
+        if r.get("bytes") and r.get("kib_s"):
+            metrics[f"bench.{key}.kib_s"] = r["kib_s"]
+    return metrics
+
+
+def portal_metrics(doc):
+    metrics = {}
+    for kind, row in doc["kinds"].items():
+        if not row.get("requests"):
+            continue
+        for p in ("p50", "p90", "p99"):
+            metrics[f"portal.{kind}.{p}_ms"] = row[f"{p}_ms"]
+        metrics[f"portal.{kind}.error_ratio"] = row["error_rate"]
+    return metrics
+
+
+def boot_metrics(doc):
+    trace = doc["current"]
+    if not trace.get("complete") or not trace.get("stages"):
+        return {}
+    metrics = {"boot.ready_ms": trace["stages"][-1]["atUs"] / 1000}
+    if trace.get("firstTxUs"):
+        metrics["boot.first_tx_ms"] = trace["firstTxUs"] / 1000
+    return metrics
+
+
+def parse_input(path):
+    """(kind, embedded version or None, metrics) of one benchmark output"""
+    text = Path(path).read_text(errors="replace")
+    try:
+        doc = json.loads(text)
+    except json.JSONDecodeError:
+        doc = None
+    if isinstance(doc, dict):
+        if "results" in doc:
+            return "bench", doc.get("version"), bench_metrics(doc)
+        if "kinds" in doc:
+            return "portal", None, portal_metrics(doc)
+        if "current" in doc:
+            return "boot", None, boot_metrics(doc)
+        if doc.get("kind") == "ota_upload":
+            return "ota", None, {"ota.upload_kib_s": doc["kib_s"]} if doc.get("kib_s") else {}
+        raise ValueError("unrecognised JSON document")
+
+    # A console log, possibly holding a bench run; the last occurrence of each line wins
+    kind, version, metrics = "log", None, {}
+    begin, end = text.find("BENCH_JSON_BEGIN"), text.find("BENCH_JSON_END")
+    if begin >= 0 and end > begin:
+        doc = json.loads(text[text.index("\n", begin):end])
+        kind, version, metrics = "bench", doc.get("version"), bench_metrics(doc)
+    for line in text.splitlines():
+        for pattern, extract in LOG_PATTERNS:
+            match = pattern.search(line)
+            if match:
+                metrics.update(extract(match))
+    return kind, version, metrics
+
+
+def add(files, version, store):
+    for path in files:
+        try:
+            kind, embedded, metrics = parse_input(path)
+        except (OSError, ValueError, KeyError, TypeError) as e:
+            print(f"❌ {path}: {e}")
+            return 1
+        if not metrics:
+            print(f"⚠️  {path}: no metrics found, skipped")
+            continue
+        run_version = version or embedded or project_version()
+        if embedded and not version and embedded != project_version():
+            print(f"ℹ️  {path} is from version {embedded}, filed under it")
+        out_dir = store / run_version
+        out_dir.mkdir(parents=True, exist_ok=True)
+        stamp = time.strftime("%Y%m%d-%H%M%S")
+        out = out_dir / f"{kind}-{stamp}-{Path(path).stem}.json"
+        out.write_text(json.dumps({"kind": kind, "source": Path(path).name, "added": stamp,
+                                   "metrics": metrics}, indent=2, sort_keys=True))
+        print(f"💾 {path}: {len(metrics)} metrics -> {out.relative_to(store.parent)}")
+    return 0
+
+
+def load_history(store):
+    """{version: {metric: median over the version's runs}}"""
+    history = {}
+    for run in sorted(store.glob("*/*.json")):
+        values = history.setdefault(run.parent.name, {})
+        for name, value in json.loads(run.read_text())["metrics"].items():
+            values.setdefault(name, []).append(value)
+    return {v: {name: statistics.median(vals) for name, vals in m.items()}
+            for v, m in sorted(history.items(), key=lambda item: version_key(item[0]))}
+
+
+def find_regressions(history, threshold):
+    """Metrics worse by more than threshold percent in the newest version than the one before"""
+    versions = list(history)
+    if len(versions) < 2:
+        return []
+    old, new = history[versions[-2]], history[versions[-1]]
+    regressions = []
+    for name in sorted(set(old) & set(new)):
+        if old[name] == 0:
+            continue
+        _, higher_better = unit_of(name)
+        change = (new[name] - old[name]) * 100.0 / abs(old[name])
+        worse = -change if higher_better else change
+        if worse > threshold:
+            regressions.append((name, old[name], new[name], change))
+    return regressions
+
+
+def svg_chart(title, unit, versions, series, flagged):
+    """One line per metric, versions along x; flagged metrics drawn in red"""
+    width, height, left, right, top, bottom = 720, 260, 60, 200, 24, 40
+    plot_w, plot_h = width - left - right, height - top - bottom
+    values = [v for points in series.values() for v in points if v is not None]
+    lo, hi = min(values + [0]), max(values)
+    hi = hi if hi > lo else lo + 1
+    step = plot_w / max(len(versions) - 1, 1)
+
+    def x(i):
+        return left + i * step
+
+    def y(v):
+        return top + plot_h - (v - lo) * plot_h / (hi - lo)
+
+    out = [f'<svg xmlns="http://www.w3.org/2000/svg" width="{width}" height="{height}" font-size="11">',
+           f'<text x="{left}" y="14" font-weight="bold">{html.escape(title)} ({html.escape(unit)})</text>',
+           f'<line x1="{left}" y1="{top + plot_h}" x2="{left + plot_w}" y2="{top + plot_h}" stroke="#888"/>',
+           f'<line x1="{left}" y1="{top}" x2="{left}" y2="{top + plot_h}" stroke="#888"/>',
+           f'<text x="{left - 4}" y="{top + 4}" text-anchor="end">{hi:.4g}</text>',
+           f'<text x="{left - 4}" y="{top + plot_h}" text-anchor="end">{lo:.4g}</text>']
+    for i, version in enumerate(versions):
+        out.append(f'<text x="{x(i):.1f}" y="{height - bottom + 16}" text-anchor="middle">'
+                   f'{html.escape(version)}</text>')
+    palette = ["#1f77b4", "#2ca02c", "#9467bd", "#8c564b", "#17becf", "#7f7f7f", "#bcbd22", "#e377c2"]
+    for n, (name, points) in enumerate(sorted(series.items())):
+        colour = "#d62728" if name in flagged else palette[n % len(palette)]
+        coords = [(x(i), y(v)) for i, v in enumerate(points) if v is not None]
+        out.append(f'<polyline fill="none" stroke="{colour}" stroke-width="2" points="'
+                   + " ".join(f"{px:.1f},{py:.1f}" for px, py in coords) + '"/>')
+        out.extend(f'<circle cx="{px:.1f}" cy="{py:.1f}" r="3" fill="{colour}"/>' for px, py in coords)
+        out.append(f'<text x="{left + plot_w + 8}" y="{top + 12 + n * 14}" fill="{colour}">'
+                   f'{html.escape(name)}</text>')
+    out.append("</svg>")
+    return "\n".join(out)
+
+
+def write_dashboard(history, regressions, threshold, out):
+    versions = list(history)
+    flagged = {r[0] for r in regressions}
+    names = sorted({name for metrics in history.values() for name in metrics})
+
+    # One chart per area and unit, so every line shares its axis
+    charts = {}
+    for name in names:
+        unit, _ = unit_of(name)
+        charts.setdefault((AREAS.index(area_of(name)), area_of(name), unit), {})[name] = \
+            [history[v].get(name) for v in versions]
+
+    body = [f"<h1>Performance by firmware version</h1>",
+            f"<p>{len(versions)} versions, {len(names)} metrics; newest {html.escape(versions[-1])}. "
+            f"Regression threshold {threshold:g}%.</p>"]
+    if regressions:
+        body.append("<h2>Regressions</h2><table><tr><th>metric</th><th>before</th><th>now</th><th>change</th></tr>")
+        body.extend(f"<tr><td>{html.escape(n)}</td><td>{o:.4g}</td><td>{v:.4g}</td><td>{c:+.1f}%</td></tr>"
+                    for n, o, v, c in regressions)
+        body.append("</table>")
+    for (_, area, unit), series in sorted(charts.items()):
+        body.append(svg_chart(area, unit or "value", versions, series, flagged))
+    out.parent.mkdir(parents=True, exist_ok=True)
+    out.write_text("<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Performance history</title>"
+                   "<style>body{font-family:sans-serif} svg{display:block;margin:12px 0} "
+                   "td,th{padding:2px 10px;text-align:left}</style></head><body>\n"
+                   + "\n".join(body) + "\n</body></html>\n")
+
+
+def report(store, threshold, out):
+    history = load_history(store)
+    if not history:
+        print(f"❌ No results under {store}; add some first")
+        return 1
+    regressions = find_regressions(history, threshold)
+    write_dashboard(history, regressions, threshold, out)
+    versions = list(history)
+    print("=" * 50)
+    print(f"📈 {len(versions)} versions ({versions[0]} .. {versions[-1]}), dashboard {out}")
+    if len(versions) < 2:
+        print("   One version only, nothing to compare")
+    elif regressions:
+        print(f"❌ {len(regressions)} regressions from {versions[-2]} to {versions[-1]} (over {threshold:g}%):")
+        for name, old, new, change in regressions:
+            unit, _ = unit_of(name)
+            print(f"   {name:<44} {old:>10.4g} -> {new:<10.4g} {unit:<6} {change:+.1f}%")
+    else:
+        print(f"✅ No regressions from {versions[-2]} to {versions[-1]} (over {threshold:g}%)")
+    print("=" * 50)
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--store", type=Path, default=DEFAULT_STORE, help="history directory (default perf/)")
+    parser.add_argument("--threshold", type=float, default=DEFAULT_THRESHOLD,
+                        help="percent a metric may get worse before it is flagged")
+    parser.add_argument("--out", type=Path, help="dashboard file (default <store>/dashboard.html)")
+    commands = parser.add_subparsers(dest="command", required=True)
+    add_cmd = commands.add_parser("add", help="file benchmark outputs under a version, then report")
+    add_cmd.add_argument("files", nargs="+")
+    add_cmd.add_argument("--version", help="firmware version (default PROJECT_VERSION, or the bench document's)")
+    commands.add_parser("report", help="write the dashboard and check the newest version")
+    args = parser.parse_args()
+
+    out = args.out or args.store / "dashboard.html"
+    if args.command == "add" and add(args.files, args.version, args.store) != 0:
+        sys.exit(1)
+    sys.exit(report(args.store, args.threshold, out))
@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+"""
+Load generator for the captive portal: several phones on the AP at once.
+
+Each simulated client behaves like a phone that just joined the network:
+  probe    the OS connectivity checks, on a fresh connection each time
+  page     index.html and its assets, then information.html, fetched the way a
+           browser does (a few keep-alive connections in parallel, with
+           If-None-Match on every reload once the ETags are known)
+  poll     /api/metrics?ids=... at the information page's refresh interval
+
+It runs for a fixed time and reports per request kind the latency percentiles,
+the error rate and how the errors split: refused connects (the server is out
+of sockets or backlog), resets, timeouts and HTTP errors. --json writes the
+same numbers to a file, so two firmware builds can be compared.
+
+Usage: portal_load_test.py [--host 192.168.4.1] [--clients 6] [--duration 60]
+                           [--poll-interval 2] [--probe-interval 10]
+                           [--page-interval 20] [--conns 3] [--json out.json]
+"""
+
+import argparse
+import http.client
+import json
+import random
+import socket
+import sys
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+# What index.html and information.html pull in (see data/)
+PAGE_ASSETS = ["/styles.css", "/scripts.js", "/favicon.ico"]
+PAGE_SEQUENCE = [
+    ("/", PAGE_ASSETS, ["/get_config"]),
+    ("/information.html", PAGE_ASSETS, ["/get_version_info"]),
+]
+
+# Metric ids shown on information.html (metricMappings)
+METRIC_IDS = [0, 1, 2, 3, 4, 5, 7, 8, 13, 14, 15, 16]
+
+# A subset of CAPTIVE_PROBES in scripts/build_web_assets.py, one per OS family
+PROBE_PATHS = [
+    "/generate_204",            # Android / Chrome
+    "/hotspot-detect.html",     # Apple
+    "/connecttest.txt",         # Windows
+    "/success.txt",             # Firefox
+]
+
+# Statuses the portal answers with on success; probes redirect or return 204
+OK_STATUSES = {200, 204, 302, 304}
+
+PERCENTILES = [50, 90, 99]
+
+
+class Stats:
+    """Latencies and error counts per request kind, shared by all clients."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.kinds = {}
+
+    def _kind(self, kind):
+        return self.kinds.setdefault(kind, {
+            "latencies_ms": [], "ok": 0, "refused": 0, "reset": 0, "timeout": 0, "http_error": 0,
+        })
+
+    def record(self, kind, outcome, latency_ms=None):
+        with self.lock:
+            k = self._kind(kind)
+            k[outcome] += 1
+            if latency_ms is not None:
+                k["latencies_ms"].append(latency_ms)
+
+    def summary(self):
+        with self.lock:
+            out = {}
+            for kind, k in sorted(self.kinds.items()):
+                lat = sorted(k["latencies_ms"])
+                errors = k["refused"] + k["reset"] + k["timeout"] + k["http_error"]
+                total = k["ok"] + errors
+                row = {key: k[key] for key in ("ok", "refused", "reset", "timeout", "http_error")}
+                row["requests"] = total
+                row["error_rate"] = round(errors / total, 4) if total else 0.0
+                for p in PERCENTILES:
+                    row[f"p{p}_ms"] = round(percentile(lat, p), 1) if lat else None
+                row["max_ms"] = round(lat[-1], 1) if lat else None
+                out[kind] = row
+            return out
+
+
+def percentile(sorted_values, p):
+    """Nearest-rank percentile of an already sorted list."""
+    rank = max(1, -(-len(sorted_values) * p // 100))
+    return sorted_values[rank - 1]
+
+
+class Connection:
+    """One keep-alive connection that reconnects after the server drops it."""
+
+    def __init__(self, host, port, timeout):
+        self.host, self.port, self.timeout = host, port, timeout
+        self.conn = None
+
+    def close(self):
+        if self.conn is not None:
+            self.conn.close()
+            self.conn = None
+
+    def get(self, path, headers=None):
+        """Returns (status, headers, latency_ms); a connect failure raises ConnectionRefusedError."""
+        if self.conn is None:
+            self.conn = http.client.HTTPConnection(self.host, self.port, timeout=self.timeout)
+        start = time.perf_counter()
+        try:
+            self.conn.request("GET", path, headers=headers or {})
+            resp = self.conn.getresponse()
+            resp.read()
+        except Exception:
+            self.close()
+            raise
+        latency_ms = (time.perf_counter() - start) * 1000
+        if resp.getheader("Connection", "").lower() == "close":
+            self.close()
+        return resp.status, resp, latency_ms
+
+
+def classify(exc):
+    if isinstance(exc, ConnectionRefusedError):
+        return "refused"
+    if isinstance(exc, (socket.timeout, TimeoutError)):
+        return "timeout"
+    return "reset"                      # Reset, broken pipe, or closed before the response
+
+
+def fetch(stats, kind, conn, path, etags=None):
+    headers = {"Accept-Encoding": "gzip"}
+    if etags is not None and path in etags:
+        headers["If-None-Match"] = etags[path]
+    try:
+        status, resp, latency_ms = conn.get(path, headers)
+    except (OSError, http.client.HTTPException) as e:
+        stats.record(kind, classify(e))
+        return False
+    if status not in OK_STATUSES:
+        stats.record(kind, "http_error", latency_ms)
+        return False
+    if etags is not None and resp.getheader("ETag"):
+        etags[path] = resp.getheader("ETag")
+    stats.record(kind, "ok", latency_ms)
+    return True
+
+
+class Client(threading.Thread):
+    """One phone: probes, page loads and metric polling until the deadline."""
+
+    def __init__(self, index, args, stats, deadline):
+        super().__init__(name=f"client-{index}", daemon=True)
+        self.args, self.stats, self.deadline = args, stats, deadline
+        self.conns = [Connection(args.host, args.port, args.timeout) for _ in range(args.conns)]
+        self.pool = ThreadPoolExecutor(max_workers=args.conns)
+        self.etags = {}
+        self.rng = random.Random(index)
+
+    def probe(self):
+        conn = Connection(self.args.host, self.args.port, self.args.timeout)
+        fetch(self.stats, "probe", conn, self.rng.choice(PROBE_PATHS))
+        conn.close()
+
+    def load_page(self):
+        for page, assets, apis in PAGE_SEQUENCE:
+            if not fetch(self.stats, "page", self.conns[0], page, self.etags):
+                return
+            # Assets go out in parallel over the other connections, as a browser does
+            jobs = [self.pool.submit(fetch, self.stats, "asset", self.conns[i % len(self.conns)], path, self.etags)
+                    for i, path in enumerate(assets)]
+            for job in jobs:
+                job.result()
+            for api in apis:
+                fetch(self.stats, "api", self.conns[0], api)
+
+    def poll(self):
+        ids = ",".join(str(i) for i in METRIC_IDS)
+        fetch(self.stats, "metrics", self.conns[0], f"/api/metrics?ids={ids}")
+
+    def run(self):
+        # Stagger the start like phones joining one after another
+        time.sleep(self.rng.uniform(0, self.args.ramp))
+        self.probe()
+        self.load_page()
+        now = time.monotonic()
+        next_poll = now + self.args.poll_interval
+        next_probe = now + self.args.probe_interval
+        next_page = now + self.args.page_interval
+        while True:
+            now = time.monotonic()
+            if now >= self.deadline:
+                break
+            if now >= next_probe:
+                self.probe()
+                next_probe += self.args.probe_interval
+            if now >= next_page:
+                self.load_page()
+                next_page += self.args.page_interval
+            if now >= next_poll:
+                self.poll()
+                next_poll += self.args.poll_interval
+            time.sleep(max(0.0, min(next_poll, next_probe, next_page, self.deadline) - time.monotonic()))
+        for conn in self.conns:
+            conn.close()
+        self.pool.shutdown()
+
+
+def print_report(summary, elapsed_s):
+    print(f"\n📊 {elapsed_s:.0f} s run")
+    header = f"{'kind':<8} {'reqs':>6} {'err%':>6} {'refused':>8} {'reset':>6} {'timeout':>8} {'http':>5}" \
+             + "".join(f" {'p' + str(p):>7}" for p in PERCENTILES) + f" {'max':>7}"
+    print(header)
+    for kind, row in summary.items():
+        lat = "".join(f" {row[f'p{p}_ms'] if row[f'p{p}_ms'] is not None else '-':>7}" for p in PERCENTILES)
+        print(f"{kind:<8} {row['requests']:>6} {row['error_rate'] * 100:>5.1f}% {row['refused']:>8} {row['reset']:>6} "
+              f"{row['timeout']:>8} {row['http_error']:>5}{lat} {row['max_ms'] if row['max_ms'] is not None else '-':>7}")
+    print("Latencies in ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--host", default="192.168.4.1")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--clients", type=int, default=6, help="simulated phones")
+    parser.add_argument("--duration", type=float, default=60, help="seconds to run")
+    parser.add_argument("--ramp", type=float, default=5, help="seconds over which clients join")
+    parser.add_argument("--conns", type=int, default=3, help="keep-alive connections per client")
+    parser.add_argument("--poll-interval", type=float, default=2, help="/api/metrics period (s)")
+    parser.add_argument("--probe-interval", type=float, default=10, help="connectivity probe period (s)")
+    parser.add_argument("--page-interval", type=float, default=20, help="page reload period (s)")
+    parser.add_argument("--timeout", type=float, default=10, help="per-request timeout (s)")
+    parser.add_argument("--json", help="also write the results to this file")
+    args = parser.parse_args()
+
+    print(f"🚀 {args.clients} clients x {args.conns} connections against http://{args.host}:{args.port} "
+          f"for {args.duration:.0f} s")
+    stats = Stats()
+    start = time.monotonic()
+    deadline = start + args.ramp + args.duration
+    clients = [Client(i, args, stats, deadline) for i in range(args.clients)]
+    for c in clients:
+        c.start()
+    for c in clients:
+        c.join()
+    elapsed_s = time.monotonic() - start
+
+    summary = stats.summary()
+    print_report(summary, elapsed_s)
+    if args.json:
+        result = {"host": args.host, "clients": args.clients, "conns": args.conns,
+                  "duration_s": round(elapsed_s, 1), "kinds": summary}
+        with open(args.json, "w") as f:
+            json.dump(result, f, indent=2)
+        print(f"💾 Results written to {args.json}")
+    failed = sum(row["requests"] - row["ok"] for row in summary.values())
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""
+Post-build script for ESP32-WeatherStation-Boat
+Compares a NODE_MINIMAL=1 build ([env:node-minimal], see include/node.h) with
+the full firmware ([env:esp32doit-devkit-v1]): app image size, flash code and
+data, IRAM and static DRAM. Static DRAM is what the heap starts without, so
+its saving is RAM the node gains.
+
+Build the full env first (`pio run -e esp32doit-devkit-v1`) for the
+comparison; without it only the minimal build is listed. Boot time is not in
+the image: flash each build and compare the "ready ... ms since reset" line
+boot_trace prints (include/boot_trace.h), after a power-on and after a deep
+sleep wake.
+
+Other builds are not reported.
+
+Run by hand on any two builds:  python3 scripts/size_report.py <full.elf> <minimal.elf>
+"""
+
+import subprocess
+import sys
+from pathlib import Path
+
+FULL_ENV = "esp32doit-devkit-v1"
+
+# Row -> section name prefixes from `size -A`
+REGIONS = [
+    ("flash code", (".flash.text",)),
+    ("flash data", (".flash.rodata", ".flash.appdesc")),
+    ("IRAM", (".iram0.",)),
+    ("static DRAM", (".dram0.data", ".dram0.bss", ".noinit")),
+    ("RTC", (".rtc.", ".rtc_noinit")),
+]
+
+
+def region_sizes(size_tool, elf):
+    """Bytes per REGIONS row, from the section table"""
+    out = subprocess.run([size_tool, "-A", str(elf)], capture_output=True, text=True, check=True).stdout
+    totals = dict.fromkeys((name for name, _ in REGIONS), 0)
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) < 2 or not fields[1].isdigit():
+            continue
+        for name, prefixes in REGIONS:
+            if fields[0].startswith(prefixes):
+                totals[name] += int(fields[1])
+                break
+    return totals
+
+
+def report(size_tool, full_elf, minimal_elf, hint=True):
+    """Print the table; the full column is left out when full_elf is None"""
+    minimal = region_sizes(size_tool, minimal_elf)
+    full = region_sizes(size_tool, full_elf) if full_elf is not None else None
+    rows = [(name, full[name] if full else None, minimal[name]) for name, _ in REGIONS]
+    minimal_bin = minimal_elf.with_suffix(".bin")
+    if minimal_bin.exists():
+        full_bin = full_elf.with_suffix(".bin") if full else None
+        full_size = full_bin.stat().st_size if full_bin is not None and full_bin.exists() else None
+        rows.insert(0, ("app image", full_size, minimal_bin.stat().st_size))
+
+    print("=" * 50)
+    if full:
+        print("📏 Node-only build against the full firmware")
+        print(f"   {'':<12} {'full':>10} {'minimal':>10} {'saved':>10}")
+    else:
+        print("📏 Node-only build")
+    for name, full_size, size in rows:
+        if full_size is None:
+            print(f"   {name:<12} {'':>10} {size:>10,}")
+        else:
+            print(f"   {name:<12} {full_size:>10,} {size:>10,} {full_size - size:>10,}"
+                  f"  ({(full_size - size) * 100 // max(full_size, 1)}%)")
+    if not full and hint:
+        print(f"   Build [env:{FULL_ENV}] to compare against the full firmware")
+    print("   Boot time: compare the \"ready\" line boot_trace prints in each build")
+    print("=" * 50)
+
+
+def size_report_build(source, target, env):
+    """Post action on the app image, so its size is known; the ELF is beside it"""
+    minimal_elf = Path(str(target[0])).with_suffix(".elf")
+    full_elf = Path(env.subst("$PROJECT_BUILD_DIR")) / FULL_ENV / minimal_elf.name
+    # Only a build for the same board compares ([env:c3-node] is listed alone)
+    same_board = env.GetProjectConfig().get(f"env:{FULL_ENV}", "board") == env.GetProjectOption("board")
+    try:
+        report(env.subst("$SIZETOOL"), full_elf if same_board and full_elf.exists() else None, minimal_elf,
+               hint=same_board)
+    except (OSError, subprocess.CalledProcessError) as err:
+        print(f"⚠️  Size report unavailable: {err}")
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        print(__doc__)
+        sys.exit(2)
+    report("xtensa-esp32-elf-size", Path(sys.argv[1]), Path(sys.argv[2]))
+    sys.exit(0)
+
+Import("env")
+
+if "NODE_MINIMAL=1" in env.GetProjectOption("build_flags", ""):
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", size_report_build)
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""
+Pre-build script for ESP32-WeatherStation-Boat
+Provides the certificate and key the HTTPS portal (include/https_portal.h) is
+built with.
+
+With HTTPS_PORTAL=1 in the build flags, certs/servercert.pem and
+certs/prvtkey.pem are used as they are, or generated once with openssl when
+missing: a self-signed ECDSA P-256 certificate for weatherstation.local and the
+AP address, valid ten years. certs/ is not committed, so every checkout gets its
+own key; put a certificate from your own CA there instead to avoid the browser
+warning. The pair is copied to .pio/embed/ for src/CMakeLists.txt to embed.
+Other builds get no copy, so nothing is embedded.
+"""
+
+Import("env")
+import shutil
+import subprocess
+import sys
+from pathlib import Path
+
+CERT_NAME = "servercert.pem"
+KEY_NAME = "prvtkey.pem"
+EMBED_DIR = Path(".pio") / "embed"
+SUBJECT = "/CN=weatherstation.local"
+SUBJECT_ALT_NAMES = "subjectAltName=DNS:weatherstation.local,IP:192.168.4.1"
+VALID_DAYS = "3650"
+
+
+def generate_credentials(cert_path, key_path):
+    """Write a self-signed P-256 certificate and its key"""
+    cert_path.parent.mkdir(parents=True, exist_ok=True)
+    command = [
+        "openssl", "req", "-x509", "-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:prime256v1",
+        "-nodes", "-days", VALID_DAYS, "-subj", SUBJECT, "-addext", SUBJECT_ALT_NAMES,
+        "-keyout", str(key_path), "-out", str(cert_path),
+    ]
+    try:
+        subprocess.run(command, check=True, capture_output=True)
+    except (OSError, subprocess.CalledProcessError) as err:
+        print(f"❌ Could not generate the HTTPS certificate with openssl: {err}")
+        print(f"   Put a PEM certificate and key in {cert_path.parent} as {CERT_NAME} and {KEY_NAME}")
+        sys.exit(1)
+    print(f"🔐 Generated a self-signed certificate for weatherstation.local in {cert_path.parent}")
+
+
+def stage_credentials(project_dir, https):
+    """Copy the pair to .pio/embed/ for an HTTPS build, remove it for any other"""
+    source_dir = project_dir / "certs"
+    embed_dir = project_dir / EMBED_DIR
+    if not https:
+        for name in (CERT_NAME, KEY_NAME):
+            (embed_dir / name).unlink(missing_ok=True)
+        return
+
+    cert_path = source_dir / CERT_NAME
+    key_path = source_dir / KEY_NAME
+    if not cert_path.exists() or not key_path.exists():
+        generate_credentials(cert_path, key_path)
+    embed_dir.mkdir(parents=True, exist_ok=True)
+    for path in (cert_path, key_path):
+        target = embed_dir / path.name
+        if not target.exists() or target.read_bytes() != path.read_bytes():
+            shutil.copyfile(path, target)
+    print(f"🔐 HTTPS portal: embedding {cert_path.relative_to(project_dir)} and its key")
+
+
+stage_credentials(Path(env["PROJECT_DIR"]), "HTTPS_PORTAL=1" in env.GetProjectOption("build_flags", ""))
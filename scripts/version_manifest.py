@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""
+Pre-build script for ESP32-WeatherStation-Boat
+Generates the component version manifest (src/version_manifest.h) from the
+REGISTER_VERSION() lines of every source file in src/ and lib/.
+
+The manifest holds the component list as string literals, once as HTML list
+items and once as JSON objects; src/version.c joins them with the project
+name, version and build date into constant strings that /get_version_info
+sends as they are. A new component only needs its REGISTER_VERSION() line.
+
+The same registrations are also linked into the version_registry section
+(see include/version.h); print_version_info() lists those, and warns when
+their count differs from VERSION_MANIFEST_COUNT.
+"""
+
+Import("env")
+import re
+from pathlib import Path
+
+SOURCE_SUFFIXES = {".c", ".cpp"}
+
+# REGISTER_VERSION(Name, "1.0.0", "2026-10-15"); registrations built from macros are skipped
+REGISTRATION = re.compile(r'^\s*REGISTER_VERSION\(\s*(\w+)\s*,\s*"([^"]*)"\s*,\s*"([^"]*)"\s*\)', re.MULTILINE)
+
+MANIFEST_HEADER = """/**
+ * @file version_manifest.h
+ * @brief Component version manifest - generated by scripts/version_manifest.py, do not edit
+ */
+
+#ifndef VERSION_MANIFEST_H
+#define VERSION_MANIFEST_H
+
+"""
+
+
+def find_registrations(project_dir):
+    """(name, version, date, file) for every literal REGISTER_VERSION(), sorted by name"""
+    found = []
+    for root in (project_dir / "src", project_dir / "lib"):
+        for src in sorted(root.rglob("*")):
+            if not src.is_file() or src.suffix not in SOURCE_SUFFIXES:
+                continue
+            for name, version, date in REGISTRATION.findall(src.read_text(errors="replace")):
+                found.append((name, version, date, src.relative_to(project_dir).as_posix()))
+    found.sort(key=lambda r: r[0].lower())
+    return found
+
+
+def write_manifest(project_dir, out_path):
+    """Write the manifest header, only when it changed"""
+    registrations = find_registrations(project_dir)
+    seen = {}
+    for name, _, _, path in registrations:
+        if name in seen:
+            print(f"⚠️  REGISTER_VERSION({name}) in both {seen[name]} and {path}")
+        seen[name] = path
+
+    lines = [MANIFEST_HEADER]
+    lines.append(f"#define VERSION_MANIFEST_COUNT {len(registrations)}\n\n")
+    lines.append("// One <li> per component\n")
+    lines.append("#define VERSION_MANIFEST_HTML_ITEMS \\\n")
+    for name, version, date, _ in registrations:
+        lines.append(f'    "<li><strong>{name}:</strong> v{version} ({date})</li>" \\\n')
+    lines.append('    ""\n\n')
+    lines.append("// Comma-separated JSON objects, one per component\n")
+    lines.append("#define VERSION_MANIFEST_JSON_ITEMS \\\n")
+    for i, (name, version, date, _) in enumerate(registrations):
+        comma = "," if i + 1 < len(registrations) else ""
+        lines.append(f'    "{{\\"name\\":\\"{name}\\",\\"version\\":\\"{version}\\",\\"date\\":\\"{date}\\"}}{comma}" \\\n')
+    lines.append('    ""\n\n#endif // VERSION_MANIFEST_H\n')
+
+    text = "".join(lines)
+    if not out_path.exists() or out_path.read_text() != text:
+        out_path.write_text(text)
+        print(f"🏷️  Version manifest: {len(registrations)} components")
+
+
+project_dir = Path(env["PROJECT_DIR"])
+write_manifest(project_dir, project_dir / "src" / "version_manifest.h")
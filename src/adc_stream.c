@@ -0,0 +1,417 @@
+/**
+ * @file adc_stream.c
+ * @brief Continuous ADC1 sampling over DMA: oversampled, decimated and filtered per channel, read in O(1)
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "adc_stream.h"
+#include "calib.h"
+#include "sensor_hal.h"
+#include "static_mem.h"
+#include "task_plan.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include <string.h>
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register adc_stream.c version
+REGISTER_VERSION(AdcStream, "1.0.0", "2026-10-15");
+
+static const char *TAG = "ADC_STREAM";
+
+// Result layout: the ESP32 and S2 DMA write type 1 results, later chips type 2
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define RESULT_CHANNEL(p) ((p)->type1.channel)
+#define RESULT_DATA(p) ((p)->type1.data)
+#else
+#define OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define RESULT_CHANNEL(p) ((p)->type2.channel)
+#define RESULT_DATA(p) ((p)->type2.data)
+#endif
+
+#define ADC1_CHANNELS 10                        // Channel numbers a result can carry
+#define NO_SLOT 0xFF
+#define FILTER_BITS 4                           // Fraction bits of the filter state
+
+/**
+ * @brief One streamed channel
+ */
+typedef struct {
+    char name[ADC_STREAM_NAME_LEN];
+    uint8_t channel;
+    uint8_t shift;
+    int32_t filtered;                           // Stream task only: raw << FILTER_BITS
+    bool primed;                                // ... filtered holds a value
+    bool valid;                                 // lock: value holds a frame
+    adc_stream_value_t value;                   // lock
+} stream_channel_t;
+
+static stream_channel_t channels[ADC_STREAM_CHANNELS];
+static uint8_t channel_count = 0;
+static uint8_t slot_of[ADC1_CHANNELS];          // ADC1 channel to its index in channels[]
+static adc_stream_stats_t stats;                // lock
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool running = false;
+static volatile bool stopping = false;
+static adc_continuous_handle_t adc_handle = NULL;
+static adc_cali_handle_t cali_handle = NULL;
+static uint8_t frame[ADC_STREAM_FRAME_BYTES];   // Stream task only
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(stream_task_slot, ADC_STREAM_TASK_STACK_SIZE);
+static SemaphoreHandle_t stopped_sem = NULL;
+
+// =============================
+// Function Prototypes
+// =============================
+static bool IRAM_ATTR frame_done(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata,
+                                 void *user_data);
+static bool IRAM_ATTR pool_overflow(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata,
+                                    void *user_data);
+static void process_frame(const uint8_t *buf, uint32_t len);
+static void stream_task(void *arg);
+static bool vdd_reader(int *mv);
+static esp_err_t supply_init(void **state);
+static esp_err_t supply_read(void *state, sensor_sample_t *sample);
+static void release(void);
+
+// Supply voltage as a sampled sensor, from the stream's filtered ADC_STREAM_VDD_CHANNEL
+REGISTER_SENSOR_DRIVER(Supply, .name = "supply", .init = supply_init, .read = supply_read);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief DMA frame complete (ISR): wake the stream task
+ */
+static bool IRAM_ATTR frame_done(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata,
+                                 void *user_data) {
+    BaseType_t woken = pdFALSE;
+    if (task_handle != NULL) {
+        vTaskNotifyGiveFromISR(task_handle, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+/**
+ * @brief The driver's pool was full and a frame was dropped (ISR)
+ */
+static bool IRAM_ATTR pool_overflow(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata,
+                                    void *user_data) {
+    portENTER_CRITICAL_ISR(&lock);
+    stats.overflows++;
+    portEXIT_CRITICAL_ISR(&lock);
+    return false;
+}
+
+/**
+ * @brief Decimate a frame to one mean per channel, filter it and publish it
+ */
+static void process_frame(const uint8_t *buf, uint32_t len) {
+    uint32_t sum[ADC_STREAM_CHANNELS] = { 0 };
+    uint16_t n[ADC_STREAM_CHANNELS] = { 0 };
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= len; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        const adc_digi_output_data_t *r = (const adc_digi_output_data_t *)&buf[i];
+        uint32_t ch = RESULT_CHANNEL(r);
+        uint8_t slot = ch < ADC1_CHANNELS ? slot_of[ch] : NO_SLOT;
+        if (slot != NO_SLOT) {
+            sum[slot] += RESULT_DATA(r);
+            n[slot]++;
+        }
+    }
+
+    int64_t now = esp_timer_get_time();
+    for (uint8_t i = 0; i < channel_count; i++) {
+        stream_channel_t *c = &channels[i];
+        if (n[i] == 0) {
+            continue;
+        }
+        int32_t mean = (int32_t)((sum[i] << FILTER_BITS) / n[i]);
+        if (!c->primed || c->shift == 0) {
+            c->filtered = mean;
+            c->primed = true;
+        } else {
+            c->filtered += (mean - c->filtered) >> c->shift;
+        }
+        uint16_t raw = (uint16_t)((c->filtered + (1 << (FILTER_BITS - 1))) >> FILTER_BITS);
+        int mv = -1;
+        if (cali_handle != NULL && adc_cali_raw_to_voltage(cali_handle, raw, &mv) != ESP_OK) {
+            mv = -1;
+        }
+
+        portENTER_CRITICAL(&lock);
+        c->value.raw = raw;
+        c->value.mv = (int16_t)mv;
+        c->value.conversions = n[i];
+        c->value.time_us = now;
+        c->valid = true;
+        portEXIT_CRITICAL(&lock);
+    }
+}
+
+/**
+ * @brief Read every completed frame once per DMA interrupt, until stopped
+ */
+static void stream_task(void *arg) {
+    while (!stopping) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t len = 0;
+        while (!stopping && adc_continuous_read(adc_handle, frame, sizeof(frame), &len, 0) == ESP_OK) {
+            int64_t start = esp_timer_get_time();
+            process_frame(frame, len);
+            uint32_t took = (uint32_t)(esp_timer_get_time() - start);
+            portENTER_CRITICAL(&lock);
+            stats.frames++;
+            if (took > stats.read_us_max) {
+                stats.read_us_max = took;
+            }
+            portEXIT_CRITICAL(&lock);
+        }
+    }
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+static bool vdd_reader(int *mv) {
+    uint8_t id;
+    adc_stream_value_t v;
+    if (!adc_stream_find(ADC_STREAM_VDD_CHANNEL, &id) || !adc_stream_get(id, &v) || v.mv < 0) {
+        return false;
+    }
+    *mv = v.mv;
+    return true;
+}
+
+/**
+ * @brief Supply driver: present while the stream carries the supply channel
+ */
+static esp_err_t supply_init(void **state) {
+    uint8_t id;
+    return running && adc_stream_find(ADC_STREAM_VDD_CHANNEL, &id) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief Supply driver: the filtered value is already there, so no trigger and no wait
+ */
+static esp_err_t supply_read(void *state, sensor_sample_t *sample) {
+    int mv;
+    if (!vdd_reader(&mv)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sample->quantity[0] = SENSOR_VOLTAGE;
+    sample->value[0] = calib_apply(CALIB_SUPPLY, mv);    // The battery behind the divider
+    sample->count = 1;
+    return ESP_OK;
+}
+
+static void release(void) {
+    if (adc_handle != NULL) {
+        adc_continuous_deinit(adc_handle);
+        adc_handle = NULL;
+    }
+    if (cali_handle != NULL) {
+        adc_cali_delete_scheme_line_fitting(cali_handle);
+        cali_handle = NULL;
+    }
+}
+
+esp_err_t adc_stream_add(const char *name, uint8_t channel, uint8_t shift, uint8_t *id) {
+    if (name == NULL || channel >= ADC1_CHANNELS || shift > 8) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint8_t existing;
+    if (adc_stream_find(channel, &existing)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (channel_count >= ADC_STREAM_CHANNELS) {
+        return ESP_ERR_NO_MEM;
+    }
+    stream_channel_t *c = &channels[channel_count];
+    memset(c, 0, sizeof(*c));
+    strlcpy(c->name, name, sizeof(c->name));
+    c->channel = channel;
+    c->shift = shift;
+    if (id != NULL) {
+        *id = channel_count;
+    }
+    channel_count++;
+    return ESP_OK;
+}
+
+esp_err_t adc_stream_start(void) {
+    if (running || channel_count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Continuous mode cannot share the unit with oneshot reads
+    system_metrics_release_adc();
+
+    adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = 2 * ADC_STREAM_FRAME_BYTES,   // Double buffer: one frame fills while one is read
+        .conv_frame_size = ADC_STREAM_FRAME_BYTES,
+    };
+    esp_err_t err = adc_continuous_new_handle(&handle_cfg, &adc_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the continuous ADC: %s", esp_err_to_name(err));
+        adc_handle = NULL;
+        return err;
+    }
+
+    memset(slot_of, NO_SLOT, sizeof(slot_of));
+    adc_digi_pattern_config_t pattern[ADC_STREAM_CHANNELS];
+    for (uint8_t i = 0; i < channel_count; i++) {
+        pattern[i] = (adc_digi_pattern_config_t){
+            .atten = ADC_ATTEN_DB_12,
+            .channel = channels[i].channel,
+            .unit = ADC_UNIT_1,
+            .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+        };
+        slot_of[channels[i].channel] = i;
+        channels[i].primed = false;
+        channels[i].valid = false;
+    }
+    adc_continuous_config_t cfg = {
+        .pattern_num = channel_count,
+        .adc_pattern = pattern,
+        .sample_freq_hz = ADC_STREAM_SAMPLE_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = OUTPUT_FORMAT,
+    };
+    err = adc_continuous_config(adc_handle, &cfg);
+
+    // Without a scheme (no eFuse values) the stream still gives raw values
+    adc_cali_line_fitting_config_t cali_cfg = {
+        .unit_id = ADC_UNIT_1,
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_12,
+    };
+    if (err == ESP_OK && adc_cali_create_scheme_line_fitting(&cali_cfg, &cali_handle) != ESP_OK) {
+        ESP_LOGW(TAG, "No ADC calibration - raw values only");
+        cali_handle = NULL;
+    }
+
+    adc_continuous_evt_cbs_t cbs = {
+        .on_conv_done = frame_done,
+        .on_pool_ovf = pool_overflow,
+    };
+    if (err == ESP_OK) {
+        err = adc_continuous_register_event_callbacks(adc_handle, &cbs, NULL);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Continuous ADC setup failed: %s", esp_err_to_name(err));
+        release();
+        return err;
+    }
+
+    if (stopped_sem == NULL) {
+        stopped_sem = xSemaphoreCreateBinary();
+    }
+    stopping = false;
+    if (stopped_sem == NULL ||
+        static_task_create(stream_task_slot, stream_task, ADC_STREAM_TASK_NAME, ADC_STREAM_TASK_STACK_SIZE, NULL,
+                           ADC_STREAM_TASK_PRIORITY, &task_handle, TASK_CORE_APP) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the stream task");
+        task_handle = NULL;
+        release();
+        return ESP_ERR_NO_MEM;
+    }
+    err = adc_continuous_start(adc_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Continuous ADC start failed: %s", esp_err_to_name(err));
+        stopping = true;
+        xTaskNotifyGive(task_handle);
+        xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(ADC_STREAM_STOP_TIMEOUT_MS));
+        task_handle = NULL;
+        release();
+        return err;
+    }
+
+    portENTER_CRITICAL(&lock);
+    memset(&stats, 0, sizeof(stats));
+    stats.running = true;
+    stats.channels = channel_count;
+    portEXIT_CRITICAL(&lock);
+    running = true;
+
+    uint8_t vdd;
+    if (adc_stream_find(ADC_STREAM_VDD_CHANNEL, &vdd)) {
+        system_metrics_set_vdd33_reader(vdd_reader);
+    }
+    for (uint8_t i = 0; i < channel_count; i++) {
+        ESP_LOGI(TAG, "%s on ADC1_CH%u, filter shift %u", channels[i].name, channels[i].channel, channels[i].shift);
+    }
+    ESP_LOGI(TAG, "Streaming %u channels at %d Hz, a frame every %d ms", channel_count, ADC_STREAM_SAMPLE_HZ,
+             ADC_STREAM_FRAME_MS);
+    return ESP_OK;
+}
+
+bool adc_stream_get(uint8_t id, adc_stream_value_t *value) {
+    if (id >= channel_count) {
+        return false;
+    }
+    portENTER_CRITICAL(&lock);
+    bool valid = channels[id].valid;
+    *value = channels[id].value;
+    portEXIT_CRITICAL(&lock);
+    return valid;
+}
+
+bool adc_stream_find(uint8_t channel, uint8_t *id) {
+    for (uint8_t i = 0; i < channel_count; i++) {
+        if (channels[i].channel == channel) {
+            *id = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void adc_stream_get_stats(adc_stream_stats_t *out) {
+    portENTER_CRITICAL(&lock);
+    *out = stats;
+    portEXIT_CRITICAL(&lock);
+}
+
+void adc_stream_stop(void) {
+    if (!running) {
+        channel_count = 0;
+        return;
+    }
+    running = false;
+    system_metrics_set_vdd33_reader(NULL);
+    adc_continuous_stop(adc_handle);
+    stopping = true;
+    xTaskNotifyGive(task_handle);
+    if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(ADC_STREAM_STOP_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Stream task did not stop within %d ms", ADC_STREAM_STOP_TIMEOUT_MS);
+        return;                                 // Still reading; leave the driver to it
+    }
+    task_handle = NULL;
+    release();
+    channel_count = 0;
+    portENTER_CRITICAL(&lock);
+    stats.running = false;
+    portEXIT_CRITICAL(&lock);
+}
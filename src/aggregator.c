@@ -0,0 +1,673 @@
+/**
+ * @file aggregator.c
+ * @brief Streaming window aggregates on the gateway: count, min, max, mean and stddev per node and metric
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "aggregator.h"
+#include "version.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register aggregator.c version
+REGISTER_VERSION(Aggregator, "1.0.0", "2026-10-15");
+
+static const char *TAG = "AGGREGATOR";
+
+/**
+ * @brief Windows per metric; grouped by metric, SPEC_FIRST indexes the groups
+ */
+static const struct {
+    aggregator_metric_t metric;
+    uint32_t window_s;
+} SPECS[] = {
+    { AGGREGATOR_TEMPERATURE, 600 },
+    { AGGREGATOR_TEMPERATURE, 3600 },
+    { AGGREGATOR_TEMPERATURE, 86400 },
+    { AGGREGATOR_PRESSURE, 3600 },
+    { AGGREGATOR_HUMIDITY, 3600 },
+    { AGGREGATOR_WIND_SPEED, 600 },
+    { AGGREGATOR_WIND_SPEED, 3600 },
+};
+
+#define SPEC_COUNT (sizeof(SPECS) / sizeof(SPECS[0]))
+#define SPECS_PER_METRIC_MAX 3
+
+static const uint8_t SPEC_FIRST[AGGREGATOR_METRICS + 1] = { 0, 3, 4, 5, SPEC_COUNT };
+
+static const char *const METRIC_NAMES[AGGREGATOR_METRICS] = {
+    [AGGREGATOR_TEMPERATURE] = "temperature",
+    [AGGREGATOR_PRESSURE]    = "pressure",
+    [AGGREGATOR_HUMIDITY]    = "humidity",
+    [AGGREGATOR_WIND_SPEED]  = "windSpeed",
+};
+
+/**
+ * @brief Welford accumulator for the open window
+ *
+ * Samples are folded in relative to the window's first one, so the float
+ * only carries the spread, not a pressure's 100000-odd offset.
+ */
+typedef struct {
+    bool open;
+    uint32_t window;                            // time_s / window_s of the open window
+    uint32_t next;                              // Lowest window still accepted: the one after the last closed
+    uint32_t count;
+    int32_t shift;                              // First sample; the accumulators hold value - shift
+    float mean;
+    float m2;                                   // Sum of squared differences from the mean
+    int32_t min;
+    int32_t max;
+    int32_t first;
+    int32_t last;
+    uint32_t first_s;
+    uint32_t last_s;
+    int64_t close_us;                           // Uptime at which it closes without another sample
+} accum_t;
+
+typedef struct {
+    uint32_t node_id;
+    bool have_prev;                             // prev_* hold its last record, for step-hold
+    uint32_t prev_seq;
+    uint32_t prev_s;
+    int32_t prev[AGGREGATOR_WIND_SPEED];        // Temperature, pressure and humidity of it
+    accum_t acc[SPEC_COUNT];
+    aggregator_result_t closed[SPEC_COUNT];     // count 0 until a window closes
+} node_agg_t;
+
+static const uint32_t ROSE_WINDOWS[AGGREGATOR_ROSE_WINDOW_COUNT] = AGGREGATOR_ROSE_WINDOWS;
+static const uint16_t ROSE_EDGES[AGGREGATOR_ROSE_BINS - 1] = AGGREGATOR_ROSE_EDGES;
+
+#define DEG_TO_RAD 0.017453292f
+
+/**
+ * @brief A wind rose's open window: the counts, and the direction sums for the circular mean
+ */
+typedef struct {
+    bool open;
+    uint32_t window;                            // time_s / window_s of the open window
+    uint32_t next;                              // Lowest window still accepted
+    uint32_t last_s;
+    int64_t close_us;                           // Uptime at which it closes without another sample
+    float sum_sin;                              // Of the directions that were not calm
+    float sum_cos;
+    aggregator_rose_t rose;                     // Counts so far; the mean is filled in on summary
+} rose_acc_t;
+
+typedef struct {
+    uint32_t node_id;
+    rose_acc_t acc[AGGREGATOR_ROSE_WINDOW_COUNT];
+    aggregator_rose_t closed[AGGREGATOR_ROSE_WINDOW_COUNT];  // count 0 until a window closes
+} node_rose_t;
+
+static node_agg_t *nodes = NULL;
+static size_t node_count = 0;
+static size_t node_last = 0;                    // A record's metrics all come from the same node
+static node_rose_t *roses = NULL;
+static size_t rose_count = 0;
+static aggregator_emit_t emit_hook = NULL;
+static aggregator_rose_emit_t rose_hook = NULL;
+static aggregator_stats_t stats;
+static portMUX_TYPE agg_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static node_agg_t *node_for(uint32_t node_id);
+static void summarize(const node_agg_t *n, size_t spec, const accum_t *a, aggregator_result_t *out);
+static void close_window(node_agg_t *n, size_t spec, aggregator_result_t *out);
+static bool fold(node_agg_t *n, size_t spec, int32_t value, uint32_t time_s, int64_t now_us,
+                 aggregator_result_t *out);
+static void hold(uint32_t node_id, const telemetry_record_t *rec);
+static node_rose_t *rose_for(uint32_t node_id);
+static void rose_summarize(const rose_acc_t *a, aggregator_rose_t *out);
+static void rose_close(node_rose_t *n, size_t k, aggregator_rose_t *out);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief A node's accumulators, taken on first use; call with agg_lock held
+ */
+static node_agg_t *node_for(uint32_t node_id) {
+    if (node_last < node_count && nodes[node_last].node_id == node_id) {
+        return &nodes[node_last];
+    }
+    for (size_t i = 0; i < node_count; i++) {
+        if (nodes[i].node_id == node_id) {
+            node_last = i;
+            return &nodes[i];
+        }
+    }
+    if (node_count >= AGGREGATOR_NODES) {
+        return NULL;
+    }
+    node_agg_t *n = &nodes[node_count];
+    memset(n, 0, sizeof(*n));
+    n->node_id = node_id;
+    node_last = node_count++;
+    stats.nodes = node_count;
+    return n;
+}
+
+/**
+ * @brief Summary of an accumulator as it stands
+ */
+static void summarize(const node_agg_t *n, size_t spec, const accum_t *a, aggregator_result_t *out) {
+    out->node_id = n->node_id;
+    out->metric = SPECS[spec].metric;
+    out->window_s = SPECS[spec].window_s;
+    out->start_s = a->window * SPECS[spec].window_s;
+    out->count = a->count;
+    out->min = a->min;
+    out->max = a->max;
+    out->first = a->first;
+    out->last = a->last;
+    out->mean = (float)a->shift + a->mean;
+    out->stddev = a->count > 1 ? sqrtf(a->m2 / (float)(a->count - 1)) : 0.0f;
+}
+
+/**
+ * @brief Close the open window into out and the node's last-closed slot; call with agg_lock held
+ */
+static void close_window(node_agg_t *n, size_t spec, aggregator_result_t *out) {
+    accum_t *a = &n->acc[spec];
+    summarize(n, spec, a, out);
+    n->closed[spec] = *out;
+    a->open = false;
+    a->next = a->window + 1;
+    stats.closed++;
+}
+
+/**
+ * @brief Fold one sample into one window; call with agg_lock held
+ *
+ * @return bool true if it closed the previous window into out
+ */
+static bool fold(node_agg_t *n, size_t spec, int32_t value, uint32_t time_s, int64_t now_us,
+                 aggregator_result_t *out) {
+    accum_t *a = &n->acc[spec];
+    uint32_t window_s = SPECS[spec].window_s;
+    uint32_t window = time_s / window_s;
+    bool closed = false;
+
+    if (a->open ? window < a->window : window < a->next) {
+        stats.late++;
+        return false;
+    }
+    if (a->open && window > a->window) {
+        close_window(n, spec, out);
+        closed = true;
+    }
+    if (!a->open) {
+        a->open = true;
+        a->window = window;
+        a->count = 0;
+        a->shift = value;
+        a->mean = 0.0f;
+        a->m2 = 0.0f;
+        a->min = a->max = a->first = a->last = value;
+        a->first_s = a->last_s = time_s;
+    }
+
+    a->count++;
+    float x = (float)(value - a->shift);
+    float delta = x - a->mean;
+    a->mean += delta / (float)a->count;
+    a->m2 += delta * (x - a->mean);
+    if (value < a->min) {
+        a->min = value;
+    }
+    if (value > a->max) {
+        a->max = value;
+    }
+    if (time_s < a->first_s) {
+        a->first = value;
+        a->first_s = time_s;
+    }
+    if (time_s >= a->last_s) {
+        a->last = value;
+        a->last_s = time_s;
+        uint32_t left_s = (window + 1) * window_s - time_s;
+        a->close_us = now_us + ((int64_t)left_s + AGGREGATOR_GRACE_S) * 1000000;
+    }
+    stats.samples++;
+    return closed;
+}
+
+esp_err_t aggregator_init(aggregator_emit_t emit, aggregator_rose_emit_t emit_rose) {
+    if (nodes == NULL) {
+        nodes = malloc(AGGREGATOR_NODES * sizeof(node_agg_t));
+        if (nodes == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (roses == NULL) {
+        roses = malloc(AGGREGATOR_ROSE_NODES * sizeof(node_rose_t));
+        if (roses == NULL) {
+            free(nodes);
+            nodes = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    portENTER_CRITICAL(&agg_lock);
+    node_count = 0;
+    node_last = 0;
+    rose_count = 0;
+    memset(&stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&agg_lock);
+    emit_hook = emit;
+    rose_hook = emit_rose;
+    ESP_LOGI(TAG, "%u windows per node for up to %d nodes, %d wind roses for up to %d (%u bytes)",
+             (unsigned)SPEC_COUNT, AGGREGATOR_NODES, AGGREGATOR_ROSE_WINDOW_COUNT, AGGREGATOR_ROSE_NODES,
+             (unsigned)(AGGREGATOR_NODES * sizeof(node_agg_t) + AGGREGATOR_ROSE_NODES * sizeof(node_rose_t)));
+    return ESP_OK;
+}
+
+void aggregator_deinit(void) {
+    portENTER_CRITICAL(&agg_lock);
+    node_agg_t *old = nodes;
+    node_rose_t *old_roses = roses;
+    nodes = NULL;
+    node_count = 0;
+    roses = NULL;
+    rose_count = 0;
+    portEXIT_CRITICAL(&agg_lock);
+    free(old);
+    free(old_roses);
+    emit_hook = NULL;
+    rose_hook = NULL;
+}
+
+void aggregator_add(uint32_t node_id, aggregator_metric_t metric, int32_t value, uint32_t time_s) {
+    if (nodes == NULL || metric >= AGGREGATOR_METRICS) {
+        return;
+    }
+    aggregator_result_t closed[SPECS_PER_METRIC_MAX];
+    size_t count = 0;
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&agg_lock);
+    node_agg_t *n = node_for(node_id);
+    if (n == NULL) {
+        stats.overflow++;
+    } else {
+        for (size_t spec = SPEC_FIRST[metric]; spec < SPEC_FIRST[metric + 1]; spec++) {
+            if (fold(n, spec, value, time_s, now_us, &closed[count])) {
+                count++;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&agg_lock);
+
+    for (size_t i = 0; i < count && emit_hook != NULL; i++) {
+        emit_hook(&closed[i]);
+    }
+}
+
+/**
+ * @brief Step-hold: fold the node's previous values in at the start of each window up to rec's
+ *
+ * One window at a time, so the lock is never held across the emit hook.
+ */
+static void hold(uint32_t node_id, const telemetry_record_t *rec) {
+    int32_t value[AGGREGATOR_WIND_SPEED];
+    uint32_t from_s = 0;
+    bool held = false;
+
+    portENTER_CRITICAL(&agg_lock);
+    node_agg_t *n = node_for(node_id);
+    if (n != NULL) {
+        held = rec->held && n->have_prev && rec->seq == n->prev_seq + 1 && rec->time_s > n->prev_s &&
+               rec->time_s - n->prev_s <= AGGREGATOR_HOLD_MAX_S;
+        from_s = n->prev_s;
+        memcpy(value, n->prev, sizeof(value));
+        n->have_prev = true;
+        n->prev_seq = rec->seq;
+        n->prev_s = rec->time_s;
+        n->prev[AGGREGATOR_TEMPERATURE] = rec->temperature;
+        n->prev[AGGREGATOR_PRESSURE] = (int32_t)rec->pressure;
+        n->prev[AGGREGATOR_HUMIDITY] = (int32_t)rec->humidity;
+    }
+    portEXIT_CRITICAL(&agg_lock);
+    if (!held) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    for (size_t spec = 0; spec < SPEC_FIRST[AGGREGATOR_WIND_SPEED]; spec++) {
+        uint32_t window_s = SPECS[spec].window_s;
+        for (uint32_t window = from_s / window_s + 1; window <= rec->time_s / window_s; window++) {
+            aggregator_result_t closed;
+            bool emit = false;
+            portENTER_CRITICAL(&agg_lock);
+            n = node_for(node_id);
+            if (n != NULL) {
+                emit = fold(n, spec, value[SPECS[spec].metric], window * window_s, now_us, &closed);
+                stats.held++;
+            }
+            portEXIT_CRITICAL(&agg_lock);
+            if (emit && emit_hook != NULL) {
+                emit_hook(&closed);
+            }
+        }
+    }
+}
+
+void aggregator_add_record(uint32_t node_id, const telemetry_record_t *rec) {
+    if (nodes == NULL) {
+        return;
+    }
+    hold(node_id, rec);
+    aggregator_add(node_id, AGGREGATOR_TEMPERATURE, rec->temperature, rec->time_s);
+    aggregator_add(node_id, AGGREGATOR_PRESSURE, (int32_t)rec->pressure, rec->time_s);
+    aggregator_add(node_id, AGGREGATOR_HUMIDITY, (int32_t)rec->humidity, rec->time_s);
+}
+
+/**
+ * @brief A node's roses, taken on first use; call with agg_lock held
+ */
+static node_rose_t *rose_for(uint32_t node_id) {
+    for (size_t i = 0; i < rose_count; i++) {
+        if (roses[i].node_id == node_id) {
+            return &roses[i];
+        }
+    }
+    if (rose_count >= AGGREGATOR_ROSE_NODES) {
+        return NULL;
+    }
+    node_rose_t *n = &roses[rose_count++];
+    memset(n, 0, sizeof(*n));
+    n->node_id = node_id;
+    stats.rose_nodes = rose_count;
+    return n;
+}
+
+/**
+ * @brief A rose as it stands, with its circular mean
+ */
+static void rose_summarize(const rose_acc_t *a, aggregator_rose_t *out) {
+    *out = a->rose;
+    uint32_t directed = a->rose.count - a->rose.calm;
+    out->mean_dir = -1;
+    out->steadiness = 0.0f;
+    if (directed > 0) {
+        float deg = atan2f(a->sum_sin, a->sum_cos) / DEG_TO_RAD;
+        int32_t mean = (int32_t)lroundf(deg < 0.0f ? deg + 360.0f : deg);
+        out->mean_dir = (int16_t)(mean % 360);
+        out->steadiness = sqrtf(a->sum_sin * a->sum_sin + a->sum_cos * a->sum_cos) / (float)directed;
+    }
+}
+
+/**
+ * @brief Close a rose's open window into out and the node's last-closed slot; call with agg_lock held
+ */
+static void rose_close(node_rose_t *n, size_t k, aggregator_rose_t *out) {
+    rose_acc_t *a = &n->acc[k];
+    rose_summarize(a, out);
+    n->closed[k] = *out;
+    a->open = false;
+    a->next = a->window + 1;
+    stats.roses_closed++;
+}
+
+void aggregator_add_wind(uint32_t node_id, int16_t dir_deg, uint16_t speed, uint32_t time_s) {
+    if (roses == NULL) {
+        return;
+    }
+    // Where the sample falls, worked out before the lock
+    bool calm = dir_deg < 0 || speed < AGGREGATOR_ROSE_CALM;
+    size_t sector = 0;
+    size_t bin = 0;
+    float sin_dir = 0.0f;
+    float cos_dir = 0.0f;
+    if (!calm) {
+        uint32_t dir = (uint32_t)dir_deg % 360;
+        sector = (dir * AGGREGATOR_ROSE_SECTORS * 2 + 360) / 720 % AGGREGATOR_ROSE_SECTORS;
+        for (size_t e = 0; e < AGGREGATOR_ROSE_BINS - 1; e++) {
+            bin += speed >= ROSE_EDGES[e];
+        }
+        sin_dir = sinf((float)dir * DEG_TO_RAD);
+        cos_dir = cosf((float)dir * DEG_TO_RAD);
+    }
+    aggregator_rose_t closed[AGGREGATOR_ROSE_WINDOW_COUNT];
+    size_t count = 0;
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&agg_lock);
+    node_rose_t *n = rose_for(node_id);
+    if (n == NULL) {
+        stats.overflow++;
+    }
+    for (size_t k = 0; n != NULL && k < AGGREGATOR_ROSE_WINDOW_COUNT; k++) {
+        rose_acc_t *a = &n->acc[k];
+        uint32_t window = time_s / ROSE_WINDOWS[k];
+        if (a->open ? window < a->window : window < a->next) {
+            stats.late++;
+            continue;
+        }
+        if (a->open && window > a->window) {
+            rose_close(n, k, &closed[count++]);
+        }
+        if (!a->open) {
+            memset(a, 0, sizeof(*a));
+            a->open = true;
+            a->window = window;
+            a->rose.node_id = node_id;
+            a->rose.window_s = ROSE_WINDOWS[k];
+            a->rose.start_s = window * ROSE_WINDOWS[k];
+        }
+        a->rose.count++;
+        if (calm) {
+            a->rose.calm++;
+        } else {
+            uint16_t *cell = &a->rose.sectors[sector][bin];
+            *cell += *cell < UINT16_MAX;
+            a->sum_sin += sin_dir;
+            a->sum_cos += cos_dir;
+        }
+        if (speed > a->rose.speed_max) {
+            a->rose.speed_max = speed;
+        }
+        if (time_s >= a->last_s) {
+            a->last_s = time_s;
+            uint32_t left_s = (window + 1) * ROSE_WINDOWS[k] - time_s;
+            a->close_us = now_us + ((int64_t)left_s + AGGREGATOR_GRACE_S) * 1000000;
+        }
+        stats.rose_samples++;
+    }
+    portEXIT_CRITICAL(&agg_lock);
+
+    for (size_t i = 0; i < count && rose_hook != NULL; i++) {
+        rose_hook(&closed[i]);
+    }
+}
+
+void aggregator_poll(void) {
+    if (nodes == NULL) {
+        return;
+    }
+    int64_t now_us = esp_timer_get_time();
+    for (size_t i = 0; i < node_count; i++) {
+        aggregator_result_t closed[SPEC_COUNT];
+        size_t count = 0;
+        portENTER_CRITICAL(&agg_lock);
+        for (size_t spec = 0; spec < SPEC_COUNT; spec++) {
+            if (nodes[i].acc[spec].open && now_us >= nodes[i].acc[spec].close_us) {
+                close_window(&nodes[i], spec, &closed[count++]);
+            }
+        }
+        portEXIT_CRITICAL(&agg_lock);
+
+        for (size_t c = 0; c < count && emit_hook != NULL; c++) {
+            emit_hook(&closed[c]);
+        }
+    }
+    for (size_t i = 0; roses != NULL && i < rose_count; i++) {
+        aggregator_rose_t closed[AGGREGATOR_ROSE_WINDOW_COUNT];
+        size_t count = 0;
+        portENTER_CRITICAL(&agg_lock);
+        for (size_t k = 0; k < AGGREGATOR_ROSE_WINDOW_COUNT; k++) {
+            if (roses[i].acc[k].open && now_us >= roses[i].acc[k].close_us) {
+                rose_close(&roses[i], k, &closed[count++]);
+            }
+        }
+        portEXIT_CRITICAL(&agg_lock);
+
+        for (size_t c = 0; c < count && rose_hook != NULL; c++) {
+            rose_hook(&closed[c]);
+        }
+    }
+}
+
+const char *aggregator_metric_name(aggregator_metric_t metric) {
+    return metric < AGGREGATOR_METRICS ? METRIC_NAMES[metric] : "unknown";
+}
+
+void aggregator_get_stats(aggregator_stats_t *out) {
+    portENTER_CRITICAL(&agg_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&agg_lock);
+}
+
+void aggregator_write_result(json_writer_t *w, const aggregator_result_t *r) {
+    char id[9];
+    snprintf(id, sizeof(id), "%08lx", (unsigned long)r->node_id);
+    json_obj_begin(w);
+    json_kv_str(w, "node", id);
+    json_kv_str(w, "metric", aggregator_metric_name(r->metric));
+    json_kv_uint(w, "window", r->window_s);
+    json_kv_uint(w, "start", r->start_s);
+    json_kv_uint(w, "n", r->count);
+    json_kv_int(w, "min", r->min);
+    json_kv_int(w, "max", r->max);
+    json_kv_int(w, "first", r->first);
+    json_kv_int(w, "last", r->last);
+    json_key(w, "mean");
+    json_double(w, r->mean, 2);
+    json_key(w, "sd");
+    json_double(w, r->stddev, 2);
+    json_obj_end(w);
+}
+
+void aggregator_write_rose(json_writer_t *w, const aggregator_rose_t *r) {
+    char id[9];
+    snprintf(id, sizeof(id), "%08lx", (unsigned long)r->node_id);
+    json_obj_begin(w);
+    json_kv_str(w, "node", id);
+    json_kv_uint(w, "window", r->window_s);
+    json_kv_uint(w, "start", r->start_s);
+    json_kv_uint(w, "n", r->count);
+    json_kv_uint(w, "calm", r->calm);
+    json_kv_int(w, "dir", r->mean_dir);
+    json_key(w, "steadiness");
+    json_double(w, r->steadiness, 3);
+    json_kv_uint(w, "max", r->speed_max);
+    json_key(w, "edges");
+    json_arr_begin(w);
+    for (size_t e = 0; e < AGGREGATOR_ROSE_BINS - 1; e++) {
+        json_uint(w, ROSE_EDGES[e]);
+    }
+    json_arr_end(w);
+    json_key(w, "sectors");
+    json_arr_begin(w);
+    for (size_t sector = 0; sector < AGGREGATOR_ROSE_SECTORS; sector++) {
+        json_arr_begin(w);
+        for (size_t bin = 0; bin < AGGREGATOR_ROSE_BINS; bin++) {
+            json_uint(w, r->sectors[sector][bin]);
+        }
+        json_arr_end(w);
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
+
+void aggregator_write_json(json_writer_t *w) {
+    aggregator_stats_t st;
+    aggregator_get_stats(&st);
+
+    json_obj_begin(w);
+    json_kv_uint(w, "capacity", AGGREGATOR_NODES);
+    json_kv_uint(w, "nodes", st.nodes);
+    json_kv_uint(w, "samples", st.samples);
+    json_kv_uint(w, "closed", st.closed);
+    json_kv_uint(w, "late", st.late);
+    json_kv_uint(w, "held", st.held);
+    json_kv_uint(w, "overflow", st.overflow);
+    json_kv_uint(w, "roseNodes", st.rose_nodes);
+    json_kv_uint(w, "roseSamples", st.rose_samples);
+    json_kv_uint(w, "rosesClosed", st.roses_closed);
+
+    // One summary copied out under the lock at a time; the table is only appended to
+    for (int pass = 0; pass < 2; pass++) {
+        json_key(w, pass == 0 ? "open" : "last");
+        json_arr_begin(w);
+        for (size_t i = 0; i < st.nodes; i++) {
+            for (size_t spec = 0; spec < SPEC_COUNT; spec++) {
+                aggregator_result_t r;
+                bool have = false;
+                portENTER_CRITICAL(&agg_lock);
+                if (nodes != NULL && i < node_count) {
+                    if (pass == 0 && nodes[i].acc[spec].open) {
+                        summarize(&nodes[i], spec, &nodes[i].acc[spec], &r);
+                        have = true;
+                    } else if (pass == 1 && nodes[i].closed[spec].count > 0) {
+                        r = nodes[i].closed[spec];
+                        have = true;
+                    }
+                }
+                portEXIT_CRITICAL(&agg_lock);
+                if (have) {
+                    aggregator_write_result(w, &r);
+                }
+            }
+        }
+        json_arr_end(w);
+    }
+
+    // The roses likewise
+    json_key(w, "roses");
+    json_obj_begin(w);
+    for (int pass = 0; pass < 2; pass++) {
+        json_key(w, pass == 0 ? "open" : "last");
+        json_arr_begin(w);
+        for (size_t i = 0; i < st.rose_nodes; i++) {
+            for (size_t k = 0; k < AGGREGATOR_ROSE_WINDOW_COUNT; k++) {
+                aggregator_rose_t r;
+                bool have = false;
+                portENTER_CRITICAL(&agg_lock);
+                if (roses != NULL && i < rose_count) {
+                    if (pass == 0 && roses[i].acc[k].open) {
+                        rose_summarize(&roses[i].acc[k], &r);
+                        have = true;
+                    } else if (pass == 1 && roses[i].closed[k].count > 0) {
+                        r = roses[i].closed[k];
+                        have = true;
+                    }
+                }
+                portEXIT_CRITICAL(&agg_lock);
+                if (have) {
+                    aggregator_write_rose(w, &r);
+                }
+            }
+        }
+        json_arr_end(w);
+    }
+    json_obj_end(w);
+    json_obj_end(w);
+}
@@ -0,0 +1,305 @@
+/**
+ * @file asset_cache.c
+ * @brief In-RAM cache for static web UI assets
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "asset_cache.h"
+#include "long_op.h"
+#include "mem_policy.h"
+#include "ts_store.h"
+#include "version.h"
+#include "esp_log.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register asset_cache.c version
+REGISTER_VERSION(AssetCache, "1.0.0", "2026-10-14");
+static const char *TAG = "ASSET_CACHE";
+
+#define ASSET_NOT_CACHED ((size_t)-1)
+
+typedef struct {
+    char path[ASSET_CACHE_PATH_MAX_LEN];        // Path relative to the mount point, with leading '/'
+    char etag[ASSET_ETAG_MAX_LEN];              // Quoted strong ETag, empty if unknown
+    size_t offset;                              // Offset into the shared cache buffer, or ASSET_NOT_CACHED
+    size_t size;                                // File size in bytes
+} asset_slot_t;
+
+static uint8_t *cache_buffer = NULL;            // Single allocation holding every cached file
+static asset_slot_t asset_slots[ASSET_CACHE_MAX_ENTRIES];
+static uint32_t asset_count = 0;                // Every asset found on the filesystem
+static uint32_t cache_entry_count = 0;          // Assets held in cache_buffer
+static size_t cache_bytes_used = 0;
+static size_t cache_budget = 0;
+static uint32_t cache_hits = 0;
+static uint32_t cache_misses = 0;
+
+// =============================
+// Function Prototypes
+// =============================
+static int compare_candidates(const void *a, const void *b);
+static bool is_gzip_path(const char *path);
+static asset_slot_t *find_slot(const char *path);
+static void load_etag_manifest(const char *base_path);
+
+// =============================
+// Function Definitions
+// =============================
+
+static bool is_gzip_path(const char *path) {
+    size_t len = strlen(path);
+    return len > 3 && strcmp(path + len - 3, ".gz") == 0;
+}
+
+/**
+ * @brief Order candidates so .gz variants come first, then smaller files
+ */
+static int compare_candidates(const void *a, const void *b) {
+    const asset_slot_t *sa = (const asset_slot_t *)a;
+    const asset_slot_t *sb = (const asset_slot_t *)b;
+    bool gz_a = is_gzip_path(sa->path);
+    bool gz_b = is_gzip_path(sb->path);
+
+    if (gz_a != gz_b) {
+        return gz_a ? -1 : 1;
+    }
+    if (sa->size != sb->size) {
+        return sa->size < sb->size ? -1 : 1;
+    }
+    return 0;
+}
+
+static asset_slot_t *find_slot(const char *path) {
+    for (uint32_t i = 0; i < asset_count; i++) {
+        if (strcmp(asset_slots[i].path, path) == 0) {
+            return &asset_slots[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Attach build-time ETags from the "<path> <hash>" manifest to known assets
+ */
+static void load_etag_manifest(const char *base_path) {
+    char filepath[ASSET_CACHE_PATH_MAX_LEN + 16];
+    snprintf(filepath, sizeof(filepath), "%s/%s", base_path, ASSET_MANIFEST_FILE);
+
+    FILE *fd = fopen(filepath, "r");
+    if (fd == NULL) {
+        ESP_LOGW(TAG, "No ETag manifest (%s), only cached assets get ETags", ASSET_MANIFEST_FILE);
+        return;
+    }
+
+    char line[ASSET_CACHE_PATH_MAX_LEN + ASSET_ETAG_MAX_LEN + 8];
+    uint32_t matched = 0;
+    while (fgets(line, sizeof(line), fd) != NULL) {
+        char *sep = strchr(line, ' ');
+        if (sep == NULL) {
+            continue;
+        }
+        *sep = '\0';
+        char *hash = sep + 1;
+        hash[strcspn(hash, "\r\n")] = '\0';
+
+        asset_slot_t *slot = find_slot(line);
+        if (slot != NULL && strlen(hash) + 3 <= sizeof(slot->etag)) {
+            snprintf(slot->etag, sizeof(slot->etag), "\"%s\"", hash);
+            matched++;
+        }
+    }
+    fclose(fd);
+
+    ESP_LOGI(TAG, "Loaded ETags for %lu assets", (unsigned long)matched);
+}
+
+esp_err_t asset_cache_init(const char *base_path, size_t budget_bytes) {
+    if (base_path == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    asset_cache_deinit();
+    cache_budget = budget_bytes;
+
+    DIR *dir = opendir(base_path);
+    if (dir == NULL) {
+        ESP_LOGE(TAG, "Failed to open %s for scanning", base_path);
+        return ESP_FAIL;
+    }
+
+    // Collect every asset and its size
+    char filepath[ASSET_CACHE_PATH_MAX_LEN + 16];
+    struct dirent *ent;
+
+    while ((ent = readdir(dir)) != NULL && asset_count < ASSET_CACHE_MAX_ENTRIES) {
+        if (strlen(ent->d_name) + 2 > ASSET_CACHE_PATH_MAX_LEN || strcmp(ent->d_name, ASSET_MANIFEST_FILE) == 0 ||
+            ts_store_owns_file(ent->d_name)) {
+            continue;  // Name too long to key on, the manifest itself, or stored history
+        }
+
+        asset_slot_t *slot = &asset_slots[asset_count];
+        snprintf(slot->path, sizeof(slot->path), "/%s", ent->d_name);
+        snprintf(filepath, sizeof(filepath), "%s%s", base_path, slot->path);
+
+        struct stat st;
+        if (stat(filepath, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+            continue;
+        }
+        slot->size = (size_t)st.st_size;
+        slot->offset = ASSET_NOT_CACHED;
+        slot->etag[0] = '\0';
+        asset_count++;
+    }
+    closedir(dir);
+
+    load_etag_manifest(base_path);
+
+    // Pick what fits in the budget and lay it out back to back
+    qsort(asset_slots, asset_count, sizeof(asset_slot_t), compare_candidates);
+
+    size_t total = 0;
+    for (uint32_t i = 0; i < asset_count; i++) {
+        if (total + asset_slots[i].size <= budget_bytes) {
+            asset_slots[i].offset = total;
+            total += asset_slots[i].size;
+        }
+    }
+
+    if (total == 0) {
+        if (budget_bytes > 0) {
+            ESP_LOGW(TAG, "No assets fit in the %zu byte cache budget", budget_bytes);
+        }
+        return ESP_OK;
+    }
+
+    cache_buffer = mem_policy_malloc(MEM_BULK, total);
+    if (cache_buffer == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %zu bytes for asset cache", total);
+        for (uint32_t i = 0; i < asset_count; i++) {
+            asset_slots[i].offset = ASSET_NOT_CACHED;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Load each selected file, compacting over any that fail to read completely
+    size_t write_offset = 0;
+    long_op_slice_t op;
+    long_op_begin(&op, LONG_OP_FILE_LOAD);
+    for (uint32_t i = 0; i < asset_count; i++) {
+        asset_slot_t *slot = &asset_slots[i];
+        if (slot->offset == ASSET_NOT_CACHED) {
+            continue;
+        }
+        slot->offset = ASSET_NOT_CACHED;
+        snprintf(filepath, sizeof(filepath), "%s%s", base_path, slot->path);
+
+        FILE *fd = fopen(filepath, "r");
+        if (fd == NULL) {
+            ESP_LOGW(TAG, "Failed to open %s, leaving it uncached", filepath);
+            continue;
+        }
+        // In steps, so a large file does not hold the filesystem and this task in one read
+        size_t read = 0;
+        while (read < slot->size) {
+            size_t want = slot->size - read;
+            if (want > LONG_OP_READ_STEP) {
+                want = LONG_OP_READ_STEP;
+            }
+            size_t got = fread(cache_buffer + write_offset + read, 1, want, fd);
+            read += got;
+            if (got < want) {
+                break;
+            }
+            long_op_step(&op);
+        }
+        fclose(fd);
+
+        if (read != slot->size) {
+            ESP_LOGW(TAG, "Short read on %s (%zu of %zu bytes), leaving it uncached", filepath, read, slot->size);
+            continue;
+        }
+
+        // Images built without a manifest still get a validator for what we hold in RAM
+        if (slot->etag[0] == '\0') {
+            uint32_t hash = 2166136261u;  // FNV-1a
+            for (size_t b = 0; b < slot->size; b++) {
+                hash = (hash ^ cache_buffer[write_offset + b]) * 16777619u;
+            }
+            snprintf(slot->etag, sizeof(slot->etag), "\"%08lx%08lx\"",
+                     (unsigned long)hash, (unsigned long)slot->size);
+        }
+
+        slot->offset = write_offset;
+        write_offset += slot->size;
+        cache_entry_count++;
+    }
+    long_op_end(&op);
+
+    cache_bytes_used = write_offset;
+
+    ESP_LOGI(TAG, "Cached %lu of %lu assets (%zu of %zu budget bytes)",
+             (unsigned long)cache_entry_count, (unsigned long)asset_count,
+             cache_bytes_used, cache_budget);
+    return ESP_OK;
+}
+
+void asset_cache_deinit(void) {
+    free(cache_buffer);
+    cache_buffer = NULL;
+    asset_count = 0;
+    cache_entry_count = 0;
+    cache_bytes_used = 0;
+}
+
+bool asset_cache_lookup(const char *path, asset_cache_entry_t *entry) {
+    if (path == NULL || entry == NULL || cache_buffer == NULL) {
+        return false;
+    }
+
+    asset_slot_t *slot = find_slot(path);
+    if (slot == NULL || slot->offset == ASSET_NOT_CACHED) {
+        return false;
+    }
+
+    entry->data = cache_buffer + slot->offset;
+    entry->size = slot->size;
+    entry->etag = slot->etag[0] != '\0' ? slot->etag : NULL;
+    cache_hits++;
+    return true;
+}
+
+const char *asset_cache_get_etag(const char *path) {
+    if (path == NULL) {
+        return NULL;
+    }
+    asset_slot_t *slot = find_slot(path);
+    return (slot != NULL && slot->etag[0] != '\0') ? slot->etag : NULL;
+}
+
+void asset_cache_record_miss(void) {
+    cache_misses++;
+}
+
+void asset_cache_get_stats(asset_cache_stats_t *stats) {
+    if (stats == NULL) {
+        return;
+    }
+    stats->hits = cache_hits;
+    stats->misses = cache_misses;
+    stats->entries = cache_entry_count;
+    stats->bytes_used = cache_bytes_used;
+    stats->budget_bytes = cache_budget;
+}
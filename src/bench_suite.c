@@ -0,0 +1,1127 @@
+/**
+ * @file bench_suite.c
+ * @brief On-target micro-benchmarks with cycle-counter timing, printed as JSON
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "bench_suite.h"
+#include "version.h"
+#include "json_writer.h"
+#include "ota_manager.h"
+#include "discovery.h"
+#include "https_portal.h"
+#include "storage.h"
+#include "web_server.h"
+#include "wifi_ap.h"
+#include "nvs_utils.h"
+#include "http_io.h"
+#include "web_handlers.h"
+#include "web_routes.h"
+#include "iram_profile.h"
+#include "spsc_ring.h"
+#include "task_plan.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sdkconfig.h"
+#include "esp_app_desc.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_now.h"
+#include "esp_wifi.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "spi_flash_mmap.h"
+#include "esp_timer.h"
+#include "esp_private/esp_clk.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+#if HTTPS_PORTAL
+#include "esp_http_server.h"
+#include "esp_netif.h"
+#include "esp_tls.h"
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register bench_suite.c version
+REGISTER_VERSION(BenchSuite, "1.0.0", "2026-10-15");
+
+static const char *TAG = "BENCH_SUITE";
+
+#define BENCH_MAX_RESULTS 40
+#define BENCH_WORK_BUF_SIZE (16 * 1024)         // Largest flash chunk and filesystem buffer
+#define BENCH_ESPNOW_PAYLOAD 32
+#define BENCH_FS_MAX_FILES 4
+#define BENCH_FS_SCRATCH SPIFFS_BASE_PATH "/bench.tmp"  // fs_append's file; deleted again
+#define BENCH_FS_SERVE_BUFFER 1024              // file_get_handler's chunk
+#define BENCH_RX_SLOTS 8                        // Receive ring slots, as a power of two
+#define BENCH_OTA_BOUNDARY "bench0boundary"      // Multipart boundary of the synthetic upload
+
+#if HTTPS_PORTAL
+#ifndef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+#error "The tls_connect_resumed case needs CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS (sdkconfig.https.defaults)"
+#endif
+#define BENCH_LOOPBACK "127.0.0.1"
+#define BENCH_HTTP_PORT 8080                    // Plain twin of the TLS server, for the baseline cases
+#define BENCH_HTTPS_PORT 8443
+#define BENCH_HTTP_URI "/bench"
+#define BENCH_HTTP_PAYLOAD BENCH_WORK_BUF_SIZE  // Body of every GET, sent from work_buf
+#define BENCH_HTTP_RX_BUFFER 1024
+#endif
+
+#ifdef CONFIG_MBEDTLS_HARDWARE_SHA
+#define BENCH_SHA_CASE "sha256_hw"
+#else
+#define BENCH_SHA_CASE "sha256_sw"
+#endif
+
+/**
+ * @brief One case at one size: per-operation cycles and wall time for the whole case
+ */
+typedef struct {
+    const char *name;
+    uint32_t size;                              // Chunk, buffer or payload size; 0 where it does not apply
+    uint32_t ops;
+    uint64_t bytes;
+    uint64_t us;
+    uint32_t cycles_min;
+    uint32_t cycles_max;
+    uint64_t cycles_total;
+    esp_err_t err;
+    int64_t start_us;
+} bench_result_t;
+
+// Flash chunk sizes around OTA_CHUNK_SIZE, filesystem buffers around file_get_handler's 1 KB
+static const uint32_t flash_chunks[] = { 1024, 4096, OTA_CHUNK_SIZE, 16384 };
+static const uint32_t fs_buffers[] = { 512, 1024, 4096, 8192 };
+// Appends: one ts_store index entry, a small block, one full ts_store block
+static const uint32_t fs_appends[] = { 16, 256, 1024 };
+
+static bench_result_t results[BENCH_MAX_RESULTS];
+static bench_result_t overflow;                 // Takes cases past BENCH_MAX_RESULTS; never printed
+static size_t result_count = 0;
+static uint8_t *work_buf = NULL;
+
+// ESP-NOW send callback, written on the WiFi task
+static TaskHandle_t bench_task = NULL;
+static volatile int64_t send_done_us = 0;
+
+/**
+ * @brief One frame of the rx_path cases, stamped by the producer
+ */
+typedef struct {
+    int64_t sent_us;
+    uint8_t len;
+    uint8_t data[BENCH_ESPNOW_PAYLOAD];
+} bench_rx_item_t;
+
+// rx_path cases: bench_rx produces, the suite's task consumes, bench_flash keeps flash busy
+static spsc_ring_t rx_ring;
+static bench_rx_item_t rx_slots[BENCH_RX_SLOTS];
+static volatile bool rx_done = false;
+static volatile uint32_t rx_dropped = 0;
+static const esp_partition_t *flash_load_part = NULL;
+static volatile bool flash_load_run = false;
+static volatile bool flash_load_stopped = true;
+
+// =============================
+// Function Prototypes
+// =============================
+static bench_result_t *case_begin(const char *name, uint32_t size);
+static void case_op(bench_result_t *r, uint32_t cycles, size_t bytes);
+static void case_end(bench_result_t *r, esp_err_t err);
+static void run_flash(void);
+static void run_sha256(void);
+static void run_fs_serve(void);
+static void run_fs_append(void);
+static void run_fs(void);
+static void run_nvs(void);
+static void run_nvs_config(void);
+static esp_err_t null_sink_begin(void *ctx, const web_ota_form_t *form, const char *filename);
+static esp_err_t null_sink_write(void *ctx, const uint8_t *data, size_t len);
+static size_t build_upload(char *buf, size_t cap);
+static void run_http_handlers(void);
+static HOT_IRAM_ATTR void rx_produce(const uint8_t *data);
+static void rx_producer_task(void *arg);
+static void flash_load_task(void *arg);
+static void run_rx_case(const char *name, bool flash_busy);
+static void run_rx_path(void);
+#if HTTPS_PORTAL
+static esp_err_t payload_handler(httpd_req_t *req);
+static esp_tls_t *bench_connect(uint16_t port, bool tls, esp_tls_client_session_t *session, uint32_t *cycles);
+static esp_err_t bench_get(esp_tls_t *conn);
+static void run_connects(const char *name, uint16_t port, bool tls, bool resume);
+static void run_gets(const char *name, uint16_t port, bool tls);
+static void run_https(void);
+#endif
+static void run_espnow(void);
+static void espnow_send_cb(const uint8_t *mac, esp_now_send_status_t status);
+static esp_err_t stdout_flush(void *ctx, const char *data, size_t len);
+static void print_results(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+static bench_result_t *case_begin(const char *name, uint32_t size) {
+    bench_result_t *r = result_count < BENCH_MAX_RESULTS ? &results[result_count++] : &overflow;
+    *r = (bench_result_t){
+        .name = name,
+        .size = size,
+        .cycles_min = UINT32_MAX,
+        .err = ESP_OK,
+    };
+    r->start_us = esp_timer_get_time();
+    return r;
+}
+
+static void case_op(bench_result_t *r, uint32_t cycles, size_t bytes) {
+    r->ops++;
+    r->bytes += bytes;
+    r->cycles_total += cycles;
+    if (cycles < r->cycles_min) {
+        r->cycles_min = cycles;
+    }
+    if (cycles > r->cycles_max) {
+        r->cycles_max = cycles;
+    }
+}
+
+static void case_end(bench_result_t *r, esp_err_t err) {
+    r->us = (uint64_t)(esp_timer_get_time() - r->start_us);
+    if (r->err == ESP_OK) {
+        r->err = err;
+    }
+    if (r->ops == 0) {
+        r->cycles_min = 0;
+    }
+}
+
+/**
+ * @brief Erase, write and read the inactive OTA slot in each chunk size
+ *
+ * Erase is timed once per sector, the granularity esp_ota_write() erases
+ * in; the later passes erase untimed so every write pass starts clean.
+ */
+static void run_flash(void) {
+    const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+    if (part == NULL || part->size < BENCH_FLASH_BYTES) {
+        case_end(case_begin("flash_erase", SPI_FLASH_SEC_SIZE), ESP_ERR_NOT_FOUND);
+        return;
+    }
+    for (size_t i = 0; i < BENCH_WORK_BUF_SIZE; i++) {
+        work_buf[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    for (size_t c = 0; c < sizeof(flash_chunks) / sizeof(flash_chunks[0]); c++) {
+        uint32_t chunk = flash_chunks[c];
+        esp_err_t err = ESP_OK;
+
+        if (c == 0) {
+            bench_result_t *r = case_begin("flash_erase", SPI_FLASH_SEC_SIZE);
+            for (uint32_t off = 0; off < BENCH_FLASH_BYTES && err == ESP_OK; off += SPI_FLASH_SEC_SIZE) {
+                uint32_t t0 = esp_cpu_get_cycle_count();
+                err = esp_partition_erase_range(part, off, SPI_FLASH_SEC_SIZE);
+                case_op(r, esp_cpu_get_cycle_count() - t0, SPI_FLASH_SEC_SIZE);
+            }
+            case_end(r, err);
+        } else {
+            err = esp_partition_erase_range(part, 0, BENCH_FLASH_BYTES);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Erase before the %lu-byte pass failed: %s", (unsigned long)chunk, esp_err_to_name(err));
+            continue;
+        }
+
+        bench_result_t *r = case_begin("flash_write", chunk);
+        for (uint32_t off = 0; off < BENCH_FLASH_BYTES && err == ESP_OK; off += chunk) {
+            uint32_t t0 = esp_cpu_get_cycle_count();
+            err = esp_partition_write(part, off, work_buf, chunk);
+            case_op(r, esp_cpu_get_cycle_count() - t0, chunk);
+        }
+        case_end(r, err);
+
+        r = case_begin("flash_read", chunk);
+        for (uint32_t off = 0; off < BENCH_FLASH_BYTES && err == ESP_OK; off += chunk) {
+            uint32_t t0 = esp_cpu_get_cycle_count();
+            err = esp_partition_read(part, off, work_buf, chunk);
+            case_op(r, esp_cpu_get_cycle_count() - t0, chunk);
+        }
+        case_end(r, err);
+    }
+
+    // Leave the slot blank rather than holding a pattern that looks like a partial image
+    esp_partition_erase_range(part, 0, BENCH_FLASH_BYTES);
+}
+
+/**
+ * @brief Hash BENCH_SHA_BYTES per operation, context setup included, as the OTA image check does
+ */
+static void run_sha256(void) {
+    uint8_t digest[32];
+    bench_result_t *r = case_begin(BENCH_SHA_CASE, BENCH_SHA_BYTES);
+    int ret = 0;
+
+    for (int i = 0; i < BENCH_SHA_ROUNDS && ret == 0; i++) {
+        mbedtls_sha256_context ctx;
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        mbedtls_sha256_init(&ctx);
+        ret = mbedtls_sha256_starts(&ctx, 0);
+        if (ret == 0) {
+            ret = mbedtls_sha256_update(&ctx, work_buf, BENCH_SHA_BYTES);
+        }
+        if (ret == 0) {
+            ret = mbedtls_sha256_finish(&ctx, digest);
+        }
+        mbedtls_sha256_free(&ctx);
+        case_op(r, esp_cpu_get_cycle_count() - t0, BENCH_SHA_BYTES);
+    }
+    case_end(r, ret == 0 ? ESP_OK : ESP_FAIL);
+}
+
+/**
+ * @brief Serve every asset once per operation as file_get_handler does: stat, open, 1 KB reads, close
+ */
+static void run_fs_serve(void) {
+    bench_result_t *r = case_begin("fs_serve", BENCH_FS_SERVE_BUFFER);
+    esp_err_t err = ESP_OK;
+    for (int pass = 0; pass < BENCH_FS_PASSES && err == ESP_OK; pass++) {
+        DIR *dir = opendir(SPIFFS_BASE_PATH);
+        if (dir == NULL) {
+            err = ESP_FAIL;
+            break;
+        }
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL && err == ESP_OK) {
+            char path[64];
+            struct stat st;
+            snprintf(path, sizeof(path), "%s/%s", SPIFFS_BASE_PATH, entry->d_name);
+            size_t total = 0;
+            uint32_t t0 = esp_cpu_get_cycle_count();
+            if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+                continue;
+            }
+            FILE *f = fopen(path, "r");
+            if (f == NULL) {
+                err = ESP_FAIL;
+                break;
+            }
+            size_t n;
+            while ((n = fread(work_buf, 1, BENCH_FS_SERVE_BUFFER, f)) > 0) {
+                total += n;
+            }
+            fclose(f);
+            case_op(r, esp_cpu_get_cycle_count() - t0, total);
+        }
+        closedir(dir);
+    }
+    case_end(r, err);
+}
+
+/**
+ * @brief Append BENCH_FS_APPEND_BYTES to a scratch file in each record size, reopening per append
+ *
+ * One operation is one durable append (open, write, close), the way
+ * ts_store writes its blocks and index entries.
+ */
+static void run_fs_append(void) {
+    size_t total = 0, used = 0;
+    if (storage_info(&total, &used) != ESP_OK || total - used < 2 * BENCH_FS_APPEND_BYTES) {
+        case_end(case_begin("fs_append", 0), ESP_ERR_NO_MEM);
+        return;
+    }
+    memset(work_buf, 0x5a, BENCH_WORK_BUF_SIZE);
+
+    for (size_t a = 0; a < sizeof(fs_appends) / sizeof(fs_appends[0]); a++) {
+        bench_result_t *r = case_begin("fs_append", fs_appends[a]);
+        esp_err_t err = ESP_OK;
+        unlink(BENCH_FS_SCRATCH);
+        for (uint32_t written = 0; written < BENCH_FS_APPEND_BYTES && err == ESP_OK; written += fs_appends[a]) {
+            uint32_t t0 = esp_cpu_get_cycle_count();
+            FILE *f = fopen(BENCH_FS_SCRATCH, "ab");
+            if (f == NULL) {
+                err = ESP_FAIL;
+                break;
+            }
+            if (fwrite(work_buf, 1, fs_appends[a], f) != fs_appends[a]) {
+                err = ESP_FAIL;
+            }
+            if (fclose(f) != 0) {
+                err = ESP_FAIL;
+            }
+            case_op(r, esp_cpu_get_cycle_count() - t0, fs_appends[a]);
+        }
+        case_end(r, err);
+    }
+    unlink(BENCH_FS_SCRATCH);
+}
+
+/**
+ * @brief Filesystem cases on the built-in backend (storage.h): mount, whole-file reads, serving, appends
+ *
+ * Case names do not carry the backend; the "fs" field of the output does,
+ * so a SPIFFS and a LittleFS build diff case by case.
+ */
+static void run_fs(void) {
+    bool mounted_here = false;
+    if (!storage_mounted()) {
+        // An empty filesystem has nothing to measure, so no formatting
+        bench_result_t *r = case_begin("fs_mount", 0);
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        esp_err_t err = storage_mount(SPIFFS_BASE_PATH, BENCH_FS_MAX_FILES, false);
+        case_op(r, esp_cpu_get_cycle_count() - t0, 0);
+        case_end(r, err);
+        if (err != ESP_OK) {
+            return;
+        }
+        mounted_here = true;
+    }
+
+    // Pick the largest file, so the per-read cost dominates the open/close
+    char path[64] = "";
+    off_t largest = 0;
+    DIR *dir = opendir(SPIFFS_BASE_PATH);
+    if (dir != NULL) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            char candidate[64];
+            struct stat st;
+            snprintf(candidate, sizeof(candidate), "%s/%s", SPIFFS_BASE_PATH, entry->d_name);
+            if (stat(candidate, &st) == 0 && st.st_size > largest) {
+                largest = st.st_size;
+                strlcpy(path, candidate, sizeof(path));
+            }
+        }
+        closedir(dir);
+    }
+
+    if (largest == 0) {
+        case_end(case_begin("fs_read", 0), ESP_ERR_NOT_FOUND);
+    } else {
+        ESP_LOGI(TAG, "%s cases read %s (%ld bytes)", storage_name(), path, (long)largest);
+    }
+    for (size_t b = 0; largest > 0 && b < sizeof(fs_buffers) / sizeof(fs_buffers[0]); b++) {
+        bench_result_t *r = case_begin("fs_read", fs_buffers[b]);
+        esp_err_t err = ESP_OK;
+        for (int pass = 0; pass < BENCH_FS_PASSES && err == ESP_OK; pass++) {
+            FILE *f = fopen(path, "r");
+            if (f == NULL) {
+                err = ESP_FAIL;
+                break;
+            }
+            size_t n;
+            do {
+                uint32_t t0 = esp_cpu_get_cycle_count();
+                n = fread(work_buf, 1, fs_buffers[b], f);
+                case_op(r, esp_cpu_get_cycle_count() - t0, n);
+            } while (n > 0);
+            fclose(f);
+        }
+        case_end(r, err);
+    }
+
+    run_fs_serve();
+    run_fs_append();
+
+    if (mounted_here) {
+        storage_unmount();
+    }
+}
+
+/**
+ * @brief Open/close cost, then BENCH_NVS_BATCH keys committed one by one against committed together
+ */
+static void run_nvs(void) {
+    nvs_handle_t handle;
+    esp_err_t err = ESP_OK;
+
+    bench_result_t *r = case_begin("nvs_open", 0);
+    for (int i = 0; i < BENCH_NVS_ROUNDS && err == ESP_OK; i++) {
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        err = nvs_open(BENCH_NVS_NAMESPACE, NVS_READWRITE, &handle);
+        if (err == ESP_OK) {
+            nvs_close(handle);
+        }
+        case_op(r, esp_cpu_get_cycle_count() - t0, 0);
+    }
+    case_end(r, err);
+    if (err != ESP_OK || nvs_open(BENCH_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+
+    // One operation is one key made durable: set + commit each time, or a share of a batched commit
+    r = case_begin("nvs_commit_each", sizeof(uint32_t));
+    for (int i = 0; i < BENCH_NVS_ROUNDS * BENCH_NVS_BATCH && err == ESP_OK; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "k%d", i % BENCH_NVS_BATCH);
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        err = nvs_set_u32(handle, key, (uint32_t)i);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        case_op(r, esp_cpu_get_cycle_count() - t0, sizeof(uint32_t));
+    }
+    case_end(r, err);
+
+    r = case_begin("nvs_commit_batch", sizeof(uint32_t) * BENCH_NVS_BATCH);
+    for (int i = 0; i < BENCH_NVS_ROUNDS && err == ESP_OK; i++) {
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        for (int k = 0; k < BENCH_NVS_BATCH && err == ESP_OK; k++) {
+            char key[8];
+            snprintf(key, sizeof(key), "k%d", k);
+            err = nvs_set_u32(handle, key, (uint32_t)(i + k));
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        case_op(r, esp_cpu_get_cycle_count() - t0, sizeof(uint32_t) * BENCH_NVS_BATCH);
+    }
+    case_end(r, err);
+
+    nvs_erase_all(handle);
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+/**
+ * @brief The bulk config path: load every field, store with one field changed, and the RAM cache read
+ *
+ * Run on [env:bench-secure] and [env:bench] to see what NVS encryption
+ * adds; nvs_config_get is the read every other module does instead.
+ */
+static void run_nvs_config(void) {
+    static device_config_t saved;
+    static device_config_t cfg;
+    esp_err_t err = nvs_load_config(&saved);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Config load failed (%s); nvs_config cases skipped", esp_err_to_name(err));
+        return;
+    }
+    // The module logs every load and store; that is not what is being timed
+    esp_log_level_t level = esp_log_level_get("NVS_UTILS");
+    esp_log_level_set("NVS_UTILS", ESP_LOG_WARN);
+
+    bench_result_t *r = case_begin("nvs_config_load", sizeof(device_config_t));
+    for (int i = 0; i < BENCH_NVS_ROUNDS && err == ESP_OK; i++) {
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        err = nvs_load_config(&cfg);
+        case_op(r, esp_cpu_get_cycle_count() - t0, sizeof(device_config_t));
+    }
+    case_end(r, err);
+
+    // A config page save: every key compared, one password rewritten, one commit
+    cfg = saved;
+    r = case_begin("nvs_config_store", sizeof(device_config_t));
+    for (int i = 0; i < BENCH_NVS_ROUNDS && err == ESP_OK; i++) {
+        snprintf(cfg.mqtt_password, sizeof(cfg.mqtt_password), "bench%d", i);
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        err = nvs_store_config(&cfg);
+        case_op(r, esp_cpu_get_cycle_count() - t0, sizeof(device_config_t));
+    }
+    case_end(r, err);
+    if (nvs_store_config(&saved) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to restore the stored config");
+    }
+
+    r = case_begin("nvs_config_get", sizeof(device_config_t));
+    for (int i = 0; i < BENCH_NVS_ROUNDS && err == ESP_OK; i++) {
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        err = nvs_config_get(&cfg);
+        case_op(r, esp_cpu_get_cycle_count() - t0, sizeof(device_config_t));
+    }
+    case_end(r, err);
+    esp_log_level_set("NVS_UTILS", level);
+}
+
+static esp_err_t null_sink_begin(void *ctx, const web_ota_form_t *form, const char *filename) {
+    *(size_t *)ctx = 0;
+    return ESP_OK;
+}
+
+static esp_err_t null_sink_write(void *ctx, const uint8_t *data, size_t len) {
+    *(size_t *)ctx += len;
+    return ESP_OK;
+}
+
+/**
+ * @brief A /api/ota form as the page sends it: the hash field, then the file part filling the rest of buf
+ *
+ * @return Body length
+ */
+static size_t build_upload(char *buf, size_t cap) {
+    static const char closing[] = "\r\n--" BENCH_OTA_BOUNDARY "--\r\n";
+    int len = snprintf(buf, cap,
+                       "--" BENCH_OTA_BOUNDARY "\r\nContent-Disposition: form-data; name=\"hash\"\r\n\r\n"
+                       "%064d\r\n--" BENCH_OTA_BOUNDARY "\r\nContent-Disposition: form-data; name=\"file\"; "
+                       "filename=\"firmware.bin\"\r\nContent-Type: application/octet-stream\r\n\r\n", 0);
+    size_t file_end = cap - sizeof(closing) + 1;
+    for (size_t i = (size_t)len; i < file_end; i++) {
+        buf[i] = (char)(i * 31 + 7);            // Binary, so boundary-like bytes turn up
+    }
+    memcpy(buf + file_end, closing, sizeof(closing) - 1);
+    return cap;
+}
+
+/**
+ * @brief The portal's request logic without a socket: synthetic requests through http_io_init_mem()
+ *
+ * The same web_handlers.h code the server runs, so parser and JSON
+ * throughput can be told apart from the network. Bodies are handed over
+ * in TCP-segment-sized reads, as httpd_req_recv() returns them.
+ *
+ *   http_route          web_route_find() on every routed URI
+ *   http_config_get     /get_config's JSON, from the cached config
+ *   http_config_save    /save_config's parse of that JSON
+ *   http_ota_multipart  /api/ota's multipart parse into a sink that only counts
+ */
+static void run_http_handlers(void) {
+    size_t route_count;
+    const web_route_t *routes = web_routes_get(&route_count);
+    bench_result_t *r = case_begin("http_route", (uint32_t)route_count);
+    esp_err_t err = ESP_OK;
+    for (int pass = 0; pass < BENCH_HTTP_ROUNDS && err == ESP_OK; pass++) {
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        for (size_t i = 0; i < route_count; i++) {
+            if (web_route_find(routes[i].uri) != &routes[i]) {
+                err = ESP_ERR_NOT_FOUND;
+            }
+        }
+        case_op(r, esp_cpu_get_cycle_count() - t0, 0);
+    }
+    case_end(r, err);
+
+    // The config JSON lands in work_buf, and is the body of the save case
+    web_config_body_t body;
+    http_io_t io;
+    http_io_mem_t mem = { .out = (char *)work_buf, .out_cap = BENCH_WORK_BUF_SIZE };
+    err = nvs_config_get(&body.cfg);
+    r = case_begin("http_config_get", 0);
+    for (int i = 0; i < BENCH_HTTP_ROUNDS && err == ESP_OK; i++) {
+        http_io_init_mem(&io, &mem);
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        err = web_config_send(&io, &body.cfg, 0);
+        case_op(r, esp_cpu_get_cycle_count() - t0, mem.out_len);
+    }
+    if (err == ESP_OK && mem.out_len > mem.out_cap) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    r->size = (uint32_t)mem.out_len;
+    case_end(r, err);
+
+    // Parsed onto a copy: nothing is saved
+    http_io_mem_t save = { .body = (const char *)work_buf, .body_len = mem.out_len, .recv_max = BENCH_HTTP_SEGMENT };
+    device_config_t current = body.cfg;
+    r = case_begin("http_config_save", (uint32_t)save.body_len);
+    for (int i = 0; i < BENCH_HTTP_ROUNDS && err == ESP_OK; i++) {
+        body.cfg = current;
+        http_io_init_mem(&io, &save);
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        err = web_config_receive(&io, &body);
+        case_op(r, esp_cpu_get_cycle_count() - t0, save.body_len);
+    }
+    case_end(r, err);
+
+    static const web_ota_sink_t sink = { .begin = null_sink_begin, .write = null_sink_write };
+    uint8_t *recv_buf = malloc(OTA_CHUNK_SIZE);
+    size_t file_bytes = 0;
+    web_ota_form_t form;
+    http_io_mem_t upload = {
+        .body = (const char *)work_buf,
+        .body_len = build_upload((char *)work_buf, BENCH_WORK_BUF_SIZE),
+        .recv_max = BENCH_HTTP_SEGMENT,
+        .headers = "Content-Type: multipart/form-data; boundary=" BENCH_OTA_BOUNDARY "\n",
+    };
+    err = recv_buf != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+    r = case_begin("http_ota_multipart", (uint32_t)upload.body_len);
+    for (int i = 0; i < BENCH_HTTP_ROUNDS && err == ESP_OK; i++) {
+        http_io_init_mem(&io, &upload);
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        err = web_ota_receive(&io, &sink, &file_bytes, recv_buf, OTA_CHUNK_SIZE, &form);
+        case_op(r, esp_cpu_get_cycle_count() - t0, upload.body_len);
+    }
+    if (err == ESP_OK && file_bytes == 0) {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    case_end(r, err);
+    free(recv_buf);
+}
+
+/**
+ * @brief espnow_link's recv_cb without the radio: copy the frame into the next slot and wake the consumer
+ */
+static HOT_IRAM_ATTR void rx_produce(const uint8_t *data) {
+    int64_t now_us = esp_timer_get_time();
+    bench_rx_item_t *item = spsc_ring_acquire(&rx_ring);
+    if (item == NULL) {
+        rx_dropped++;
+        return;
+    }
+    item->sent_us = now_us;
+    item->len = BENCH_ESPNOW_PAYLOAD;
+    memcpy(item->data, data, BENCH_ESPNOW_PAYLOAD);
+    spsc_ring_commit(&rx_ring);
+    xTaskNotifyGive(bench_task);
+}
+
+/**
+ * @brief Network core, as the Wi-Fi task is: one frame per tick
+ */
+static void rx_producer_task(void *arg) {
+    (void)arg;
+    uint8_t frame[BENCH_ESPNOW_PAYLOAD];
+    memset(frame, 0xa5, sizeof(frame));
+    for (int i = 0; i < BENCH_RX_FRAMES; i++) {
+        rx_produce(frame);
+        vTaskDelay(1);
+    }
+    rx_done = true;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Erase and write the inactive OTA slot sector by sector until told to stop, as an OTA does
+ */
+static void flash_load_task(void *arg) {
+    (void)arg;
+    uint32_t off = 0;
+    while (flash_load_run) {
+        if (esp_partition_erase_range(flash_load_part, off, SPI_FLASH_SEC_SIZE) != ESP_OK ||
+            esp_partition_write(flash_load_part, off, work_buf, SPI_FLASH_SEC_SIZE) != ESP_OK) {
+            break;
+        }
+        off = (off + SPI_FLASH_SEC_SIZE) % BENCH_FLASH_BYTES;
+    }
+    flash_load_stopped = true;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Time frames from the producer's stamp to the consumer reading them out of the ring
+ *
+ * @param flash_busy Run bench_flash beside the producer on the network core
+ */
+static void run_rx_case(const char *name, bool flash_busy) {
+    uint32_t cycles_per_us = (uint32_t)(esp_clk_cpu_freq() / 1000000);
+    if (flash_busy) {
+        flash_load_part = esp_ota_get_next_update_partition(NULL);
+        if (flash_load_part == NULL || flash_load_part->size < BENCH_FLASH_BYTES) {
+            case_end(case_begin(name, BENCH_ESPNOW_PAYLOAD), ESP_ERR_NOT_FOUND);
+            return;
+        }
+        memset(work_buf, 0x3c, SPI_FLASH_SEC_SIZE);
+        flash_load_run = true;
+        flash_load_stopped = false;
+        if (xTaskCreatePinnedToCore(flash_load_task, BENCH_FLASH_TASK_NAME, BENCH_FLASH_TASK_STACK_SIZE, NULL,
+                                    BENCH_FLASH_TASK_PRIORITY, NULL, TASK_CORE_NET) != pdPASS) {
+            flash_load_stopped = true;
+            case_end(case_begin(name, BENCH_ESPNOW_PAYLOAD), ESP_ERR_NO_MEM);
+            return;
+        }
+    }
+
+    spsc_ring_init(&rx_ring, rx_slots, sizeof(rx_slots[0]), BENCH_RX_SLOTS);
+    rx_done = false;
+    rx_dropped = 0;
+    bench_task = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0);
+    bench_result_t *r = case_begin(name, BENCH_ESPNOW_PAYLOAD);
+    esp_err_t err = ESP_OK;
+    if (xTaskCreatePinnedToCore(rx_producer_task, BENCH_RX_TASK_NAME, BENCH_RX_TASK_STACK_SIZE, NULL,
+                                BENCH_RX_TASK_PRIORITY, NULL, TASK_CORE_NET) != pdPASS) {
+        err = ESP_ERR_NO_MEM;
+        rx_done = true;
+    }
+    while (!rx_done || spsc_ring_count(&rx_ring) > 0) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BENCH_RX_WAIT_MS));
+        bench_rx_item_t *item;
+        while ((item = spsc_ring_front(&rx_ring)) != NULL) {
+            int64_t latency_us = esp_timer_get_time() - item->sent_us;
+            case_op(r, (uint32_t)latency_us * cycles_per_us, item->len);
+            spsc_ring_release(&rx_ring);
+        }
+    }
+    if (err == ESP_OK && rx_dropped > 0) {
+        err = ESP_ERR_NO_MEM;                   // The ring filled: ops is short of BENCH_RX_FRAMES
+    }
+    case_end(r, err);
+    bench_task = NULL;
+
+    if (flash_busy) {
+        flash_load_run = false;
+        while (!flash_load_stopped) {
+            vTaskDelay(1);
+        }
+        esp_partition_erase_range(flash_load_part, 0, BENCH_FLASH_BYTES);
+    }
+}
+
+/**
+ * @brief The ESP-NOW receive hand-off across the cores, alone and while the network core writes flash
+ *
+ * A [env:bench] and a [env:bench-iram] capture show what the IRAM
+ * placement of iram_profile.h changes on this path.
+ */
+static void run_rx_path(void) {
+    run_rx_case("rx_path", false);
+    run_rx_case("rx_path_flash", true);
+}
+
+/**
+ * @brief WiFi task: note when the frame left
+ */
+static void espnow_send_cb(const uint8_t *mac, esp_now_send_status_t status) {
+    (void)mac;
+    (void)status;
+    send_done_us = esp_timer_get_time();
+    xTaskNotifyGive(bench_task);
+}
+
+#if HTTPS_PORTAL
+
+static esp_err_t payload_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "application/octet-stream");
+    return httpd_resp_send(req, (const char *)work_buf, BENCH_HTTP_PAYLOAD);
+}
+
+/**
+ * @brief Connect over loopback, plain or TLS (verified against the built-in certificate)
+ *
+ * @param cycles Set to the cycles spent connecting, handshake included
+ * @return The connection, or NULL
+ */
+static esp_tls_t *bench_connect(uint16_t port, bool tls, esp_tls_client_session_t *session, uint32_t *cycles) {
+    const uint8_t *cert;
+    size_t cert_len;
+    https_portal_certificate(&cert, &cert_len);
+    esp_tls_cfg_t cfg = {
+        .cacert_buf = cert,
+        .cacert_bytes = cert_len,
+        .common_name = DISCOVERY_HOSTNAME ".local",
+        .client_session = session,
+        .is_plain_tcp = !tls,
+        .timeout_ms = BENCH_HTTPS_TIMEOUT_MS,
+    };
+    esp_tls_t *conn = esp_tls_init();
+    if (conn == NULL) {
+        return NULL;
+    }
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    int ret = esp_tls_conn_new_sync(BENCH_LOOPBACK, strlen(BENCH_LOOPBACK), port, &cfg, conn);
+    *cycles = esp_cpu_get_cycle_count() - t0;
+    if (ret != 1) {
+        esp_tls_conn_destroy(conn);
+        return NULL;
+    }
+    return conn;
+}
+
+/**
+ * @brief One keep-alive GET: send the request, read until the whole body is in
+ */
+static esp_err_t bench_get(esp_tls_t *conn) {
+    static const char request[] = "GET " BENCH_HTTP_URI " HTTP/1.1\r\nHost: " BENCH_LOOPBACK "\r\n\r\n";
+    static const char header_end[] = "\r\n\r\n";
+    static char rx[BENCH_HTTP_RX_BUFFER];
+
+    for (size_t sent = 0; sent < sizeof(request) - 1;) {
+        ssize_t n = esp_tls_conn_write(conn, request + sent, sizeof(request) - 1 - sent);
+        if (n <= 0) {
+            return ESP_FAIL;
+        }
+        sent += (size_t)n;
+    }
+
+    // The body is the payload exactly, so the headers only need their end found
+    size_t matched = 0;
+    size_t body = 0;
+    while (body < BENCH_HTTP_PAYLOAD) {
+        ssize_t n = esp_tls_conn_read(conn, rx, sizeof(rx));
+        if (n <= 0) {
+            return ESP_FAIL;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            if (matched == sizeof(header_end) - 1) {
+                body += (size_t)(n - i);
+                break;
+            }
+            matched = rx[i] == header_end[matched] ? matched + 1 : (rx[i] == '\r' ? 1 : 0);
+        }
+    }
+    return body == BENCH_HTTP_PAYLOAD ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+/**
+ * @brief BENCH_HTTPS_CONNECTS connects; resume reuses the ticket from the previous one
+ */
+static void run_connects(const char *name, uint16_t port, bool tls, bool resume) {
+    esp_tls_client_session_t *session = NULL;
+    esp_err_t err = ESP_OK;
+    uint32_t cycles;
+
+    if (resume) {
+        // The first, full handshake only fetches the ticket
+        esp_tls_t *conn = bench_connect(port, tls, NULL, &cycles);
+        session = conn != NULL ? esp_tls_get_client_session(conn) : NULL;
+        if (conn != NULL) {
+            esp_tls_conn_destroy(conn);
+        }
+        if (session == NULL) {
+            err = ESP_ERR_NOT_FOUND;
+        }
+    }
+
+    bench_result_t *r = case_begin(name, 0);
+    for (int i = 0; i < BENCH_HTTPS_CONNECTS && err == ESP_OK; i++) {
+        esp_tls_t *conn = bench_connect(port, tls, session, &cycles);
+        if (conn == NULL) {
+            err = ESP_FAIL;
+            break;
+        }
+        case_op(r, cycles, 0);
+        if (resume) {
+            esp_tls_free_client_session(session);
+            session = esp_tls_get_client_session(conn);
+        }
+        esp_tls_conn_destroy(conn);
+    }
+    case_end(r, err);
+    if (session != NULL) {
+        esp_tls_free_client_session(session);
+    }
+}
+
+/**
+ * @brief BENCH_HTTPS_GETS keep-alive GETs of the payload on one connection
+ */
+static void run_gets(const char *name, uint16_t port, bool tls) {
+    uint32_t cycles;
+    esp_tls_t *conn = bench_connect(port, tls, NULL, &cycles);
+    esp_err_t err = conn != NULL ? ESP_OK : ESP_FAIL;
+
+    bench_result_t *r = case_begin(name, BENCH_HTTP_PAYLOAD);
+    for (int i = 0; i < BENCH_HTTPS_GETS && err == ESP_OK; i++) {
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        err = bench_get(conn);
+        case_op(r, esp_cpu_get_cycle_count() - t0, BENCH_HTTP_PAYLOAD);
+    }
+    case_end(r, err);
+    if (conn != NULL) {
+        esp_tls_conn_destroy(conn);
+    }
+}
+
+/**
+ * @brief Connect and GET over loopback against the HTTPS portal's server and a plain twin
+ *
+ * Client and server share the chip, so a case's cycles are both ends'
+ * work; the plain cases beside them are the baseline for the overhead.
+ */
+static void run_https(void) {
+    esp_err_t err = esp_netif_init();
+    httpd_handle_t plain = NULL;
+    httpd_handle_t secure = NULL;
+    for (size_t i = 0; i < BENCH_WORK_BUF_SIZE; i++) {
+        work_buf[i] = (uint8_t)(i * 13 + 5);
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = BENCH_HTTPS_PORT;
+    config.max_open_sockets = HTTPS_PORTAL_MAX_SOCKETS;
+    config.stack_size = HTTPS_PORTAL_STACK_SIZE;
+    if (err == ESP_OK) {
+        err = https_portal_start(&secure, &config);
+    }
+    config.server_port = BENCH_HTTP_PORT;
+    config.ctrl_port += 2;                      // + 1 is the redirect server's
+    if (err == ESP_OK) {
+        err = httpd_start(&plain, &config);
+    }
+    if (err != ESP_OK) {
+        case_end(case_begin("tls_connect_full", 0), err);
+        if (secure != NULL) {
+            https_portal_stop(secure);
+        }
+        return;
+    }
+    static const httpd_uri_t payload_uri = { .uri = BENCH_HTTP_URI, .method = HTTP_GET, .handler = payload_handler };
+    httpd_register_uri_handler(secure, &payload_uri);
+    httpd_register_uri_handler(plain, &payload_uri);
+
+    run_connects("tcp_connect", BENCH_HTTP_PORT, false, false);
+    run_connects("tls_connect_full", BENCH_HTTPS_PORT, true, false);
+    run_connects("tls_connect_resumed", BENCH_HTTPS_PORT, true, true);
+    run_gets("http_get", BENCH_HTTP_PORT, false);
+    run_gets("https_get", BENCH_HTTPS_PORT, true);
+
+    httpd_stop(plain);
+    https_portal_stop(secure);
+}
+
+#endif
+
+/**
+ * @brief Broadcast frames: cycles inside esp_now_send(), and time from the call to the send callback
+ *
+ * The callback runs on the WiFi task, which may sit on the other core, so
+ * the second case is taken from esp_timer and converted to cycles. Then
+ * the LMK of an encrypted peer is changed over and over: what a key
+ * rotation costs per peer (espnow_rekey.h).
+ */
+static void run_espnow(void) {
+    static const uint8_t broadcast[ESP_NOW_ETH_ALEN] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    uint32_t cycles_per_us = (uint32_t)(esp_clk_cpu_freq() / 1000000);
+
+    esp_err_t err = wifi_espnow_init(BENCH_ESPNOW_CHANNEL);
+    if (err == ESP_OK) {
+        err = esp_now_init();
+    }
+    if (err != ESP_OK) {
+        case_end(case_begin("espnow_send", BENCH_ESPNOW_PAYLOAD), err);
+        return;
+    }
+    esp_now_peer_info_t peer = { .channel = 0, .ifidx = WIFI_IF_STA, .encrypt = false };
+    memcpy(peer.peer_addr, broadcast, ESP_NOW_ETH_ALEN);
+    bench_task = xTaskGetCurrentTaskHandle();
+    err = esp_now_register_send_cb(espnow_send_cb);
+    if (err == ESP_OK) {
+        err = esp_now_add_peer(&peer);
+    }
+
+    bench_result_t *send = case_begin("espnow_send", BENCH_ESPNOW_PAYLOAD);
+    bench_result_t *done = case_begin("espnow_send_done", BENCH_ESPNOW_PAYLOAD);
+    memset(work_buf, 0xa5, BENCH_ESPNOW_PAYLOAD);
+    for (int i = 0; i < BENCH_ESPNOW_FRAMES && err == ESP_OK; i++) {
+        ulTaskNotifyTake(pdTRUE, 0);
+        int64_t start_us = esp_timer_get_time();
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        err = esp_now_send(broadcast, work_buf, BENCH_ESPNOW_PAYLOAD);
+        case_op(send, esp_cpu_get_cycle_count() - t0, BENCH_ESPNOW_PAYLOAD);
+        if (err != ESP_OK) {
+            break;
+        }
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BENCH_ESPNOW_TIMEOUT_MS)) == 0) {
+            err = ESP_ERR_TIMEOUT;
+            break;
+        }
+        case_op(done, (uint32_t)(send_done_us - start_us) * cycles_per_us, BENCH_ESPNOW_PAYLOAD);
+    }
+    case_end(send, err);
+    case_end(done, err);
+
+    // Locally administered and never sent to
+    esp_now_peer_info_t keyed = { .channel = 0, .ifidx = WIFI_IF_STA, .encrypt = true,
+                                  .peer_addr = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 } };
+    memset(keyed.lmk, 0x5a, ESP_NOW_KEY_LEN);
+    err = esp_now_add_peer(&keyed);
+    bench_result_t *mod = case_begin("espnow_mod_peer", ESP_NOW_KEY_LEN);
+    for (int i = 0; i < BENCH_ESPNOW_FRAMES && err == ESP_OK; i++) {
+        memset(keyed.lmk, i, ESP_NOW_KEY_LEN);
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        err = esp_now_mod_peer(&keyed);
+        case_op(mod, esp_cpu_get_cycle_count() - t0, ESP_NOW_KEY_LEN);
+    }
+    case_end(mod, err);
+
+    esp_now_deinit();
+    bench_task = NULL;
+}
+
+static esp_err_t stdout_flush(void *ctx, const char *data, size_t len) {
+    (void)ctx;
+    if (data == NULL) {
+        fputc('\n', stdout);
+    } else if (fwrite(data, 1, len, stdout) != len) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Print every result as one JSON document between the marker lines
+ */
+static void print_results(void) {
+    const esp_app_desc_t *app = esp_app_get_description();
+    json_writer_t w;
+    json_writer_init(&w, stdout_flush, NULL);
+
+    fflush(stdout);
+    printf("%s\n", BENCH_JSON_BEGIN);
+    json_obj_begin(&w);
+    json_kv_str(&w, "version", app->version);
+    json_kv_str(&w, "idf", app->idf_ver);
+    json_kv_str(&w, "built", app->date);
+    json_kv_uint(&w, "cpu_mhz", (uint64_t)(esp_clk_cpu_freq() / 1000000));
+    json_kv_str(&w, "fs", storage_name());
+    json_kv_bool(&w, "nvs_encrypted", nvs_utils_encrypted());
+    json_key(&w, "results");
+    json_arr_begin(&w);
+    for (size_t i = 0; i < result_count; i++) {
+        const bench_result_t *r = &results[i];
+        json_obj_begin(&w);
+        json_kv_str(&w, "case", r->name);
+        json_kv_uint(&w, "size", r->size);
+        json_kv_uint(&w, "ops", r->ops);
+        json_kv_uint(&w, "bytes", r->bytes);
+        json_kv_uint(&w, "us", r->us);
+        json_kv_uint(&w, "cycles_min", r->cycles_min);
+        json_kv_uint(&w, "cycles_mean", r->ops > 0 ? r->cycles_total / r->ops : 0);
+        json_kv_uint(&w, "cycles_max", r->cycles_max);
+        json_key(&w, "kib_s");
+        json_double(&w, r->us > 0 ? (double)r->bytes * 1000000.0 / 1024.0 / (double)r->us : 0.0, 1);
+        json_kv_str(&w, "err", esp_err_to_name(r->err));
+        json_obj_end(&w);
+    }
+    json_arr_end(&w);
+    json_obj_end(&w);
+    json_writer_finish(&w);
+    printf("%s\n", BENCH_JSON_END);
+    fflush(stdout);
+}
+
+esp_err_t bench_suite_run(void) {
+    work_buf = malloc(BENCH_WORK_BUF_SIZE);
+    if (work_buf == NULL) {
+        ESP_LOGE(TAG, "No memory for the %d-byte work buffer", BENCH_WORK_BUF_SIZE);
+        return ESP_ERR_NO_MEM;
+    }
+    result_count = 0;
+    ESP_LOGI(TAG, "Running the benchmark suite on core %d at %lu MHz", xPortGetCoreID(),
+             (unsigned long)(esp_clk_cpu_freq() / 1000000));
+
+    run_flash();
+    run_sha256();
+    run_fs();
+    run_nvs();
+    run_nvs_config();
+    run_http_handlers();
+    run_rx_path();
+#if HTTPS_PORTAL
+    run_https();
+#endif
+    run_espnow();
+
+    for (size_t i = 0; i < result_count; i++) {
+        if (results[i].err != ESP_OK) {
+            ESP_LOGW(TAG, "%s/%lu failed: %s", results[i].name, (unsigned long)results[i].size,
+                     esp_err_to_name(results[i].err));
+        }
+    }
+    print_results();
+    free(work_buf);
+    work_buf = NULL;
+    ESP_LOGI(TAG, "Benchmark suite done: %u results", (unsigned)result_count);
+    return ESP_OK;
+}
@@ -0,0 +1,295 @@
+/**
+ * @file ble_beacon.c
+ * @brief Current readings broadcast as BTHome v2 BLE advertisements, for phones nearby
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "ble_beacon.h"
+#include "version.h"
+#include "sdkconfig.h"
+#if CONFIG_BT_NIMBLE_ENABLED
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "host/ble_gap.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register ble_beacon.c version
+REGISTER_VERSION(BleBeacon, "1.0.0", "2026-10-15");
+
+#if CONFIG_BT_NIMBLE_ENABLED
+
+static const char *TAG = "BLE_BEACON";
+
+// AD types (Bluetooth Assigned Numbers, 2.3)
+#define AD_FLAGS 0x01
+#define AD_COMPLETE_NAME 0x09
+#define AD_SERVICE_DATA_16 0x16
+#define AD_FLAG_GENERAL_DISC 0x02
+#define AD_FLAG_NO_BREDR 0x04
+
+// BTHome v2 (bthome.io/format)
+#define BTHOME_UUID 0xFCD2
+#define BTHOME_INFO 0x40                        // Version 2, unencrypted, sent at a regular interval
+#define BTHOME_PACKET_ID 0x00
+#define BTHOME_TEMPERATURE 0x02
+#define BTHOME_HUMIDITY 0x03
+#define BTHOME_PRESSURE 0x04
+
+#define NAME_LEN (sizeof(BLE_BEACON_NAME_PREFIX) - 1 + 4)
+
+// The NimBLE host task writes synced and advertising; the rest belongs to the forwarder
+static volatile bool synced = false;            // Host and controller agree; commands may be sent
+static volatile bool advertising = false;
+static uint8_t own_addr_type = 0;
+static bool running = false;
+static uint32_t node = 0;                       // Node on the air, once one is chosen
+static telemetry_record_t latest;
+static bool have_latest = false;
+static bool dirty = false;                      // latest is not on the air yet
+static uint8_t packet_id = 0;
+static ble_beacon_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#endif
+
+// =============================
+// Function Prototypes
+// =============================
+#if CONFIG_BT_NIMBLE_ENABLED
+static void on_sync(void);
+static void on_reset(int reason);
+static void host_task(void *param);
+static size_t build_adv(uint8_t *buf);
+static void count_error(void);
+#endif
+
+// =============================
+// Function Definitions
+// =============================
+#if CONFIG_BT_NIMBLE_ENABLED
+
+static void count_error(void) {
+    portENTER_CRITICAL(&stats_lock);
+    stats.errors++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief NimBLE host task: runs the host until nimble_port_stop()
+ */
+static void host_task(void *param) {
+    (void)param;
+    nimble_port_run();
+    nimble_port_freertos_deinit();
+}
+
+/**
+ * @brief Host synced with the controller (at start and after a reset); the next poll starts advertising
+ */
+static void on_sync(void) {
+    int rc = ble_hs_util_ensure_addr(0);
+    if (rc == 0) {
+        rc = ble_hs_id_infer_auto(0, &own_addr_type);
+    }
+    if (rc != 0) {
+        ESP_LOGE(TAG, "No Bluetooth address: %d", rc);
+        return;
+    }
+    advertising = false;
+    synced = true;
+}
+
+static void on_reset(int reason) {
+    ESP_LOGW(TAG, "Host reset: %d", reason);
+    synced = false;
+    advertising = false;
+}
+
+/**
+ * @brief Advertising data for the latest reading
+ *
+ * @param buf Output, BLE_BEACON_ADV_MAX bytes
+ * @return size_t Bytes used
+ */
+static size_t build_adv(uint8_t *buf) {
+    size_t n = 0;
+    buf[n++] = 2;
+    buf[n++] = AD_FLAGS;
+    buf[n++] = AD_FLAG_GENERAL_DISC | AD_FLAG_NO_BREDR;
+
+    // Objects in ascending id order, as BTHome requires
+    uint16_t humidity = (uint16_t)(latest.humidity / 10);
+    uint32_t pressure = latest.pressure > 0xFFFFFF ? 0xFFFFFF : latest.pressure;
+    size_t len_at = n++;
+    buf[n++] = AD_SERVICE_DATA_16;
+    buf[n++] = (uint8_t)BTHOME_UUID;
+    buf[n++] = (uint8_t)(BTHOME_UUID >> 8);
+    buf[n++] = BTHOME_INFO;
+    buf[n++] = BTHOME_PACKET_ID;
+    buf[n++] = packet_id;
+    buf[n++] = BTHOME_TEMPERATURE;
+    buf[n++] = (uint8_t)latest.temperature;
+    buf[n++] = (uint8_t)((uint16_t)latest.temperature >> 8);
+    buf[n++] = BTHOME_HUMIDITY;
+    buf[n++] = (uint8_t)humidity;
+    buf[n++] = (uint8_t)(humidity >> 8);
+    buf[n++] = BTHOME_PRESSURE;
+    buf[n++] = (uint8_t)pressure;
+    buf[n++] = (uint8_t)(pressure >> 8);
+    buf[n++] = (uint8_t)(pressure >> 16);
+    buf[len_at] = (uint8_t)(n - len_at - 1);
+
+    char name[NAME_LEN + 1];
+    snprintf(name, sizeof(name), BLE_BEACON_NAME_PREFIX "%04x", (unsigned)(node & 0xFFFF));
+    buf[n++] = (uint8_t)(NAME_LEN + 1);
+    buf[n++] = AD_COMPLETE_NAME;
+    memcpy(buf + n, name, NAME_LEN);
+    n += NAME_LEN;
+    return n;
+}
+
+_Static_assert(3 + 17 + 2 + NAME_LEN <= BLE_BEACON_ADV_MAX, "Advertisement fits a legacy PDU");
+
+esp_err_t ble_beacon_start(void) {
+    if (running) {
+        return ESP_OK;
+    }
+    memset(&stats, 0, sizeof(stats));
+    node = BLE_BEACON_NODE_ID;
+    have_latest = false;
+    dirty = false;
+    synced = false;
+    advertising = false;
+
+    esp_err_t err = nimble_port_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NimBLE init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    ble_hs_cfg.sync_cb = on_sync;
+    ble_hs_cfg.reset_cb = on_reset;
+    nimble_port_freertos_init(host_task);
+    running = true;
+    ESP_LOGI(TAG, "Beacon started for %s", BLE_BEACON_NODE_ID != 0 ? "one node" : "the first node heard");
+    return ESP_OK;
+}
+
+void ble_beacon_stop(void) {
+    if (!running) {
+        return;
+    }
+    if (advertising) {
+        ble_gap_adv_stop();
+    }
+    if (nimble_port_stop() == 0) {
+        nimble_port_deinit();
+    }
+    synced = false;
+    advertising = false;
+    running = false;
+}
+
+void ble_beacon_update(uint32_t node_id, const telemetry_record_t *rec) {
+    if (!running) {
+        return;
+    }
+    if (node == 0) {
+        node = node_id;
+    } else if (node_id != node) {
+        return;
+    }
+    if (have_latest && rec->time_s < latest.time_s) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.stale++;
+        portEXIT_CRITICAL(&stats_lock);
+        return;
+    }
+    latest = *rec;
+    have_latest = true;
+    dirty = true;
+}
+
+void ble_beacon_poll(void) {
+    if (!running || !synced || !have_latest || (!dirty && advertising)) {
+        return;
+    }
+    if (dirty) {
+        packet_id++;
+    }
+    uint8_t adv[BLE_BEACON_ADV_MAX];
+    size_t len = build_adv(adv);
+    int rc = ble_gap_adv_set_data(adv, (int)len);
+    if (rc != 0) {
+        ESP_LOGW(TAG, "Advertising data refused: %d", rc);
+        count_error();
+        return;
+    }
+    dirty = false;
+    portENTER_CRITICAL(&stats_lock);
+    stats.updates++;
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (!advertising) {
+        struct ble_gap_adv_params params;
+        memset(&params, 0, sizeof(params));
+        params.conn_mode = BLE_GAP_CONN_MODE_NON;
+        params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+        params.itvl_min = BLE_GAP_ADV_ITVL_MS(BLE_BEACON_INTERVAL_MS);
+        params.itvl_max = BLE_GAP_ADV_ITVL_MS(BLE_BEACON_INTERVAL_MS);
+        rc = ble_gap_adv_start(own_addr_type, NULL, BLE_HS_FOREVER, &params, NULL, NULL);
+        if (rc != 0 && rc != BLE_HS_EALREADY) {
+            ESP_LOGW(TAG, "Advertising not started: %d", rc);
+            count_error();
+            return;
+        }
+        advertising = true;
+        ESP_LOGI(TAG, "Advertising node %08lx as " BLE_BEACON_NAME_PREFIX "%04x", (unsigned long)node,
+                 (unsigned)(node & 0xFFFF));
+    }
+}
+
+void ble_beacon_get_stats(ble_beacon_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+    out->advertising = advertising;
+    out->node_id = node;
+}
+
+#else
+
+esp_err_t ble_beacon_start(void) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void ble_beacon_stop(void) {
+}
+
+void ble_beacon_update(uint32_t node_id, const telemetry_record_t *rec) {
+    (void)node_id;
+    (void)rec;
+}
+
+void ble_beacon_poll(void) {
+}
+
+void ble_beacon_get_stats(ble_beacon_stats_t *out) {
+    *out = (ble_beacon_stats_t){ 0 };
+}
+
+#endif
@@ -0,0 +1,334 @@
+/**
+ * @file ble_config.c
+ * @brief Configuration over a BLE GATT service, opened by a boot button press while the role runs
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "ble_config.h"
+#include "version.h"
+#include "sdkconfig.h"
+#if BLE_CONFIG
+#include <stdio.h>
+#include <string.h>
+#include "config_schema.h"
+#include "nvs_utils.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "host/ble_hs.h"
+#include "host/ble_uuid.h"
+#include "host/util/util.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register ble_config.c version
+REGISTER_VERSION(BleConfig, "1.0.0", "2026-10-15");
+
+#if BLE_CONFIG
+
+#if !defined(CONFIG_BT_NIMBLE_ENABLED) || !defined(CONFIG_BT_NIMBLE_ROLE_PERIPHERAL) || \
+    !defined(CONFIG_BT_NIMBLE_SECURITY_ENABLE)
+#error "BLE_CONFIG needs NimBLE with the peripheral role and security (sdkconfig.ble-config.defaults)"
+#endif
+
+static const char *TAG = "BLE_CONFIG";
+
+// BLE_CONFIG_*_UUID, least significant byte first; they differ only in byte 12
+#define CONFIG_UUID(n) BLE_UUID128_INIT(0x40, 0x6a, 0x0b, 0x1f, 0x8e, 0x3c, 0x2a, 0x9d, \
+                                        0x6e, 0x4f, 0x3c, 0x7b, (n), 0x00, 0x1e, 0x5a)
+
+#define NAME_LEN (sizeof(BLE_CONFIG_NAME_PREFIX) - 1 + 4)
+
+static const ble_uuid128_t service_uuid = CONFIG_UUID(0x01);
+static const ble_uuid128_t values_uuid = CONFIG_UUID(0x02);
+static const ble_uuid128_t schema_uuid = CONFIG_UUID(0x03);
+
+static int chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+static const struct ble_gatt_svc_def services[] = {
+    {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid = &service_uuid.u,
+        .characteristics = (struct ble_gatt_chr_def[]) {
+            {
+                .uuid = &values_uuid.u,
+                .access_cb = chr_access,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_READ_ENC | BLE_GATT_CHR_F_WRITE |
+                         BLE_GATT_CHR_F_WRITE_ENC,
+            },
+            {
+                .uuid = &schema_uuid.u,
+                .access_cb = chr_access,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_READ_ENC,
+            },
+            { 0 },
+        },
+    },
+    { 0 },
+};
+
+// Set by ble_config_open(); the rest belongs to the NimBLE host task
+static bool started = false;
+static volatile int64_t window_end_us = 0;      // Advertising stops here
+static volatile bool synced = false;
+static volatile bool advertising = false;
+static volatile bool connected = false;
+static bool written = false;                    // A write was committed: restart on disconnect
+static uint8_t own_addr_type = 0;
+static char name[NAME_LEN + 1];
+static uint8_t scratch[CONFIG_SCHEMA_BINARY_MAX];
+
+#endif
+
+// =============================
+// Function Prototypes
+// =============================
+#if BLE_CONFIG
+static void host_task(void *param);
+static void on_sync(void);
+static void on_reset(int reason);
+static void start_advertising(void);
+static int gap_event(struct ble_gap_event *event, void *arg);
+static int write_values(struct os_mbuf *om);
+#endif
+
+// =============================
+// Function Definitions
+// =============================
+#if BLE_CONFIG
+
+static void host_task(void *param) {
+    (void)param;
+    nimble_port_run();
+    nimble_port_freertos_deinit();
+}
+
+/**
+ * @brief Host synced with the controller: name the device after its address and advertise if a window is open
+ */
+static void on_sync(void) {
+    int rc = ble_hs_util_ensure_addr(0);
+    if (rc == 0) {
+        rc = ble_hs_id_infer_auto(0, &own_addr_type);
+    }
+    uint8_t addr[6] = { 0 };
+    if (rc == 0) {
+        rc = ble_hs_id_copy_addr(own_addr_type, addr, NULL);
+    }
+    if (rc != 0) {
+        ESP_LOGE(TAG, "No Bluetooth address: %d", rc);
+        return;
+    }
+    snprintf(name, sizeof(name), BLE_CONFIG_NAME_PREFIX "%02X%02X", addr[1], addr[0]);
+    ble_svc_gap_device_name_set(name);
+    synced = true;
+    advertising = false;
+    if (!connected) {
+        start_advertising();
+    }
+}
+
+static void on_reset(int reason) {
+    ESP_LOGW(TAG, "Host reset: %d", reason);
+    synced = false;
+    advertising = false;
+}
+
+/**
+ * @brief Advertise the service, connectable, for what is left of the window
+ */
+static void start_advertising(void) {
+    int64_t left_ms = (window_end_us - esp_timer_get_time()) / 1000;
+    if (!synced || advertising || left_ms <= 0) {
+        return;
+    }
+
+    struct ble_hs_adv_fields fields;
+    memset(&fields, 0, sizeof(fields));
+    fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+    fields.uuids128 = &service_uuid;
+    fields.num_uuids128 = 1;
+    fields.uuids128_is_complete = 1;
+    int rc = ble_gap_adv_set_fields(&fields);
+    if (rc == 0) {
+        struct ble_hs_adv_fields rsp;
+        memset(&rsp, 0, sizeof(rsp));
+        rsp.name = (const uint8_t *)name;
+        rsp.name_len = (uint8_t)strlen(name);
+        rsp.name_is_complete = 1;
+        rc = ble_gap_adv_rsp_set_fields(&rsp);
+    }
+    if (rc == 0) {
+        struct ble_gap_adv_params params;
+        memset(&params, 0, sizeof(params));
+        params.conn_mode = BLE_GAP_CONN_MODE_UND;
+        params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+        rc = ble_gap_adv_start(own_addr_type, NULL, (int32_t)left_ms, &params, gap_event, NULL);
+    }
+    if (rc != 0) {
+        ESP_LOGW(TAG, "Advertising not started: %d", rc);
+        return;
+    }
+    advertising = true;
+    ESP_LOGI(TAG, "Advertising as %s for %lu s", name, (unsigned long)(left_ms / 1000));
+}
+
+static int gap_event(struct ble_gap_event *event, void *arg) {
+    (void)arg;
+    switch (event->type) {
+        case BLE_GAP_EVENT_CONNECT:
+            advertising = false;
+            if (event->connect.status != 0) {
+                start_advertising();
+                break;
+            }
+            connected = true;
+            ESP_LOGI(TAG, "Phone connected");
+            // Ask for encryption now rather than on the first refused read
+            ble_gap_security_initiate(event->connect.conn_handle);
+            break;
+        case BLE_GAP_EVENT_DISCONNECT:
+            connected = false;
+            ESP_LOGI(TAG, "Phone disconnected: reason 0x%x", event->disconnect.reason);
+            if (written) {
+                ESP_LOGI(TAG, "Restarting with the new configuration");
+                esp_restart();
+            }
+            start_advertising();
+            break;
+        case BLE_GAP_EVENT_ADV_COMPLETE:
+            advertising = false;
+            if (!connected) {
+                ESP_LOGI(TAG, "Configuration window closed");
+            }
+            break;
+        case BLE_GAP_EVENT_ENC_CHANGE:
+            if (event->enc_change.status != 0) {
+                ESP_LOGW(TAG, "Pairing failed: %d", event->enc_change.status);
+            }
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+/**
+ * @brief Apply a write to BLE_CONFIG_VALUES_UUID and commit it
+ *
+ * @return int 0, or the ATT error the phone gets
+ */
+static int write_values(struct os_mbuf *om) {
+    uint16_t len = 0;
+    if (OS_MBUF_PKTLEN(om) > sizeof(scratch) || ble_hs_mbuf_to_flat(om, scratch, sizeof(scratch), &len) != 0) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+
+    device_config_t cfg;
+    if (nvs_config_get(&cfg) != ESP_OK) {
+        ESP_LOGW(TAG, "Some stored config values failed to load, saving over them");
+    }
+    if (config_schema_apply_binary(&cfg, scratch, len) != ESP_OK) {
+        return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
+    }
+    esp_err_t err = nvs_config_update(&cfg);
+    if (err == ESP_OK) {
+        err = nvs_config_flush();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save configuration: %s", esp_err_to_name(err));
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+    written = true;
+    ESP_LOGI(TAG, "Configuration saved (%u bytes); restarting on disconnect", len);
+    return 0;
+}
+
+static int chr_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg) {
+    (void)conn_handle;
+    (void)attr_handle;
+    (void)arg;
+    bool schema = ble_uuid_cmp(ctxt->chr->uuid, &schema_uuid.u) == 0;
+    size_t len;
+    switch (ctxt->op) {
+        case BLE_GATT_ACCESS_OP_READ_CHR:
+            // The host trims a long read to its offset, so the whole value is built each time
+            if (schema) {
+                len = config_schema_encode_meta(scratch, sizeof(scratch));
+            } else {
+                device_config_t cfg;
+                nvs_config_get(&cfg);
+                len = config_schema_encode(&cfg, scratch, sizeof(scratch));
+            }
+            return os_mbuf_append(ctxt->om, scratch, len) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+        case BLE_GATT_ACCESS_OP_WRITE_CHR:
+            return schema ? BLE_ATT_ERR_WRITE_NOT_PERMITTED : write_values(ctxt->om);
+        default:
+            return BLE_ATT_ERR_UNLIKELY;
+    }
+}
+
+esp_err_t ble_config_open(void) {
+    window_end_us = esp_timer_get_time() + (int64_t)BLE_CONFIG_WINDOW_MS * 1000;
+    if (started) {
+        if (!connected) {
+            start_advertising();
+        }
+        return ESP_OK;
+    }
+
+    esp_err_t err = nimble_port_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NimBLE init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    ble_hs_cfg.sync_cb = on_sync;
+    ble_hs_cfg.reset_cb = on_reset;
+    ble_hs_cfg.sm_io_cap = BLE_HS_IO_NO_INPUT_OUTPUT;
+    ble_hs_cfg.sm_sc = 1;
+    ble_hs_cfg.sm_bonding = 0;
+
+    ble_svc_gap_init();
+    ble_svc_gatt_init();
+    int rc = ble_gatts_count_cfg(services);
+    if (rc == 0) {
+        rc = ble_gatts_add_svcs(services);
+    }
+    if (rc != 0) {
+        ESP_LOGE(TAG, "GATT service not registered: %d", rc);
+        nimble_port_deinit();
+        return ESP_FAIL;
+    }
+
+    nimble_port_freertos_init(host_task);
+    started = true;
+    return ESP_OK;
+}
+
+bool ble_config_is_open(void) {
+    return advertising || connected;
+}
+
+#else
+
+esp_err_t ble_config_open(void) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+bool ble_config_is_open(void) {
+    return false;
+}
+
+#endif
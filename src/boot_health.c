@@ -0,0 +1,167 @@
+/**
+ * @file boot_health.c
+ * @brief Post-boot health gate that confirms a newly updated image or rolls it back
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "boot_health.h"
+#include "version.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register boot_health.c version
+REGISTER_VERSION(BootHealth, "1.0.0", "2026-10-15");
+
+static const char *TAG = "BOOT_HEALTH";
+
+static portMUX_TYPE health_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool on_trial = false;                   // Running image is ESP_OTA_IMG_PENDING_VERIFY
+static uint32_t required = 0;                   // boot_health_check_t mask
+static uint32_t passed = 0;
+static esp_timer_handle_t deadline_timer = NULL;
+
+// =============================
+// Function Prototypes
+// =============================
+static void roll_back(const char *reason);
+static void evaluate(void);
+static void deadline_cb(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Abort the image on trial and restart into the previous one
+ */
+static void roll_back(const char *reason) {
+    uint32_t missing;
+    portENTER_CRITICAL(&health_lock);
+    missing = required & ~passed;
+    portEXIT_CRITICAL(&health_lock);
+    ESP_LOGE(TAG, "New image failed its health check (%s, missing 0x%02lx) - rolling back", reason,
+             (unsigned long)missing);
+    esp_err_t err = esp_ota_mark_app_invalid_rollback_and_reboot();
+    // Only returns when there is no previous image to go back to
+    ESP_LOGE(TAG, "Rollback failed: %s - keeping this image", esp_err_to_name(err));
+    portENTER_CRITICAL(&health_lock);
+    on_trial = false;
+    portEXIT_CRITICAL(&health_lock);
+}
+
+/**
+ * @brief Confirm the image once every required check passed, with the heap still healthy
+ */
+static void evaluate(void) {
+    bool done;
+    portENTER_CRITICAL(&health_lock);
+    done = on_trial && (passed & required) == required;
+    portEXIT_CRITICAL(&health_lock);
+    if (!done) {
+        return;
+    }
+
+    uint32_t min_heap = esp_get_minimum_free_heap_size();
+    if (min_heap < BOOT_HEALTH_MIN_HEAP) {
+        ESP_LOGE(TAG, "Free heap fell to %lu bytes (floor %d)", (unsigned long)min_heap, BOOT_HEALTH_MIN_HEAP);
+        roll_back("heap");
+        return;
+    }
+
+    esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not confirm the image: %s", esp_err_to_name(err));
+        return;
+    }
+    portENTER_CRITICAL(&health_lock);
+    on_trial = false;
+    portEXIT_CRITICAL(&health_lock);
+    if (deadline_timer != NULL) {
+        esp_timer_stop(deadline_timer);
+    }
+    ESP_LOGI(TAG, "New image confirmed after %lu ms, lowest free heap %lu bytes",
+             (unsigned long)(esp_timer_get_time() / 1000), (unsigned long)min_heap);
+}
+
+/**
+ * @brief The checks did not pass in time; runs in the esp_timer task
+ */
+static void deadline_cb(void *arg) {
+    if (boot_health_pending()) {
+        roll_back("deadline");
+    }
+}
+
+esp_err_t boot_health_start(uint32_t checks) {
+    esp_ota_img_states_t state;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (running == NULL || esp_ota_get_state_partition(running, &state) != ESP_OK ||
+        state != ESP_OTA_IMG_PENDING_VERIFY) {
+        return ESP_OK;
+    }
+
+    portENTER_CRITICAL(&health_lock);
+    on_trial = true;
+    required = checks;
+    passed = 0;
+    portEXIT_CRITICAL(&health_lock);
+    ESP_LOGW(TAG, "New image in %s on trial: checks 0x%02lx within %d s", running->label, (unsigned long)checks,
+             BOOT_HEALTH_DEADLINE_MS / 1000);
+
+    if (deadline_timer == NULL) {
+        const esp_timer_create_args_t args = {
+            .callback = deadline_cb,
+            .name = "boot_health",
+        };
+        esp_err_t err = esp_timer_create(&args, &deadline_timer);
+        if (err != ESP_OK) {
+            // A reset still rolls back an image that never confirms
+            ESP_LOGW(TAG, "No deadline timer: %s", esp_err_to_name(err));
+            evaluate();
+            return err;
+        }
+    }
+    esp_timer_start_once(deadline_timer, (uint64_t)BOOT_HEALTH_DEADLINE_MS * 1000);
+    evaluate();
+    return ESP_OK;
+}
+
+void boot_health_pass(boot_health_check_t check) {
+    bool fresh;
+    portENTER_CRITICAL(&health_lock);
+    fresh = on_trial && (passed & check) == 0;
+    if (fresh) {
+        passed |= check;
+    }
+    portEXIT_CRITICAL(&health_lock);
+    if (fresh) {
+        ESP_LOGI(TAG, "Check 0x%02x passed", (unsigned)check);
+        evaluate();
+    }
+}
+
+bool boot_health_pending(void) {
+    bool pending;
+    portENTER_CRITICAL(&health_lock);
+    pending = on_trial;
+    portEXIT_CRITICAL(&health_lock);
+    return pending;
+}
+
+void boot_health_settle(void) {
+    if (boot_health_pending()) {
+        roll_back("sleeping");
+    }
+}
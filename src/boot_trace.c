@@ -0,0 +1,267 @@
+/**
+ * @file boot_trace.c
+ * @brief Startup checkpoints kept in RTC memory, with a summary table, metric and JSON
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "boot_trace.h"
+#include "iram_profile.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include "metrics_export.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register boot_trace.c version
+REGISTER_VERSION(BootTrace, "1.0.0", "2026-10-14");
+
+static const char *TAG = "BOOT_TRACE";
+
+#define BOOT_TRACE_MAGIC 0xB007720Du            // Marks RTC contents written by this module, in this layout
+
+// RTC_NOINIT memory is left alone by the startup code and holds garbage after power-on
+typedef struct {
+    uint32_t magic;
+    boot_trace_t trace;
+} boot_trace_rtc_t;
+
+static RTC_NOINIT_ATTR boot_trace_rtc_t rtc_trace;
+static boot_trace_t previous_trace;
+static bool have_previous = false;
+static uint32_t last_mark_us;
+static volatile bool first_tx_seen = false;     // Keeps the WiFi task out of trace_lock after the first frame
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static const boot_trace_stage_t *slowest_stage(const boot_trace_t *trace);
+static metric_error_t boot_trace_provider(char *buf, size_t buf_len);
+static void write_trace_metrics(metrics_export_writer_t *w);
+static void write_trace_json(json_writer_t *w, const boot_trace_t *trace);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief The stage that took longest, NULL if there are none
+ */
+static const boot_trace_stage_t *slowest_stage(const boot_trace_t *trace) {
+    const boot_trace_stage_t *slowest = NULL;
+    for (uint32_t i = 0; i < trace->stage_count; i++) {
+        if (slowest == NULL || trace->stages[i].duration_us > slowest->duration_us) {
+            slowest = &trace->stages[i];
+        }
+    }
+    return slowest;
+}
+
+/**
+ * @brief METRIC_BOOT_TRACE: time to ready and the slowest stage
+ */
+static metric_error_t boot_trace_provider(char *buf, size_t buf_len) {
+    boot_trace_t trace;
+    boot_trace_get(false, &trace);
+    if (trace.stage_count == 0) {
+        snprintf(buf, buf_len, "No checkpoints");
+        return METRIC_OK;
+    }
+
+    const boot_trace_stage_t *slowest = slowest_stage(&trace);
+    const boot_trace_stage_t *last = &trace.stages[trace.stage_count - 1];
+    int len = snprintf(buf, buf_len, "%lu ms to %s, slowest %s %lu ms", (unsigned long)(last->at_us / 1000),
+                       trace.complete ? "ready" : last->name, slowest->name,
+                       (unsigned long)(slowest->duration_us / 1000));
+    if (trace.first_tx_us != 0 && len > 0 && (size_t)len < buf_len) {
+        snprintf(buf + len, buf_len - len, ", first frame at %lu ms", (unsigned long)(trace.first_tx_us / 1000));
+    }
+    return METRIC_OK;
+}
+
+/**
+ * @brief Boot duration and per-stage durations for /metrics
+ */
+static void write_trace_metrics(metrics_export_writer_t *w) {
+    boot_trace_t trace;
+    boot_trace_get(false, &trace);
+    if (trace.stage_count == 0) {
+        return;
+    }
+
+    metrics_export_family(w, "boot_duration_seconds", METRICS_EXPORT_GAUGE, "seconds",
+                          "Time from reset to the last startup checkpoint");
+    metrics_export_sample(w, "boot_duration_seconds", "", NULL,
+                          trace.stages[trace.stage_count - 1].at_us / 1e6);
+    if (trace.first_tx_us != 0) {
+        metrics_export_family(w, "boot_wake_to_tx_seconds", METRICS_EXPORT_GAUGE, "seconds",
+                              "Time from reset to the first ESP-NOW frame acknowledged");
+        metrics_export_sample(w, "boot_wake_to_tx_seconds", "", NULL, trace.first_tx_us / 1e6);
+    }
+
+    char labels[METRICS_EXPORT_LABEL_MAX + 16];
+    metrics_export_family(w, "boot_stage_duration_seconds", METRICS_EXPORT_GAUGE, "seconds",
+                          "Time spent in each startup stage");
+    snprintf(labels, sizeof(labels), "stage=\"pre_app_main\"");
+    metrics_export_sample(w, "boot_stage_duration_seconds", "", labels, trace.app_start_us / 1e6);
+    for (uint32_t i = 0; i < trace.stage_count; i++) {
+        char escaped[METRICS_EXPORT_LABEL_MAX];
+        snprintf(labels, sizeof(labels), "stage=\"%s\"",
+                 metrics_export_escape(escaped, sizeof(escaped), trace.stages[i].name));
+        metrics_export_sample(w, "boot_stage_duration_seconds", "", labels, trace.stages[i].duration_us / 1e6);
+    }
+}
+
+/**
+ * @brief One trace as {"complete":…,"appStartUs":…,"radioUs":…,"firstTxUs":…,"stages":[{"name","atUs","durationUs"}]}
+ */
+static void write_trace_json(json_writer_t *w, const boot_trace_t *trace) {
+    json_obj_begin(w);
+    json_kv_bool(w, "complete", trace->complete);
+    json_kv_uint(w, "appStartUs", trace->app_start_us);
+    json_kv_uint(w, "dropped", trace->dropped);
+    json_kv_uint(w, "radioUs", trace->radio_us);
+    json_kv_uint(w, "firstTxUs", trace->first_tx_us);
+    json_key(w, "stages");
+    json_arr_begin(w);
+    for (uint32_t i = 0; i < trace->stage_count; i++) {
+        json_obj_begin(w);
+        json_kv_str(w, "name", trace->stages[i].name);
+        json_kv_uint(w, "atUs", trace->stages[i].at_us);
+        json_kv_uint(w, "durationUs", trace->stages[i].duration_us);
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
+
+void boot_trace_start(void) {
+    uint32_t now = (uint32_t)esp_timer_get_time();
+
+    // Keep what the last boot got through before this one overwrites it
+    if (esp_reset_reason() != ESP_RST_POWERON && rtc_trace.magic == BOOT_TRACE_MAGIC &&
+        rtc_trace.trace.stage_count <= BOOT_TRACE_MAX_STAGES) {
+        previous_trace = rtc_trace.trace;
+        for (uint32_t i = 0; i < previous_trace.stage_count; i++) {
+            previous_trace.stages[i].name[BOOT_TRACE_NAME_LEN - 1] = '\0';
+        }
+        have_previous = true;
+    }
+
+    memset(&rtc_trace, 0, sizeof(rtc_trace));
+    rtc_trace.magic = BOOT_TRACE_MAGIC;
+    rtc_trace.trace.app_start_us = now;
+    last_mark_us = now;
+}
+
+void boot_trace_mark(const char *name) {
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    boot_trace_t *trace = &rtc_trace.trace;
+
+    portENTER_CRITICAL(&trace_lock);
+    if (trace->stage_count < BOOT_TRACE_MAX_STAGES) {
+        boot_trace_stage_t *stage = &trace->stages[trace->stage_count++];
+        strlcpy(stage->name, name, sizeof(stage->name));
+        stage->at_us = now;
+        stage->duration_us = now - last_mark_us;
+    } else {
+        trace->dropped++;
+    }
+    last_mark_us = now;
+    portEXIT_CRITICAL(&trace_lock);
+}
+
+void boot_trace_radio_up(void) {
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    portENTER_CRITICAL(&trace_lock);
+    if (rtc_trace.trace.radio_us == 0) {
+        rtc_trace.trace.radio_us = now;
+    }
+    portEXIT_CRITICAL(&trace_lock);
+}
+
+HOT_IRAM_ATTR void boot_trace_first_tx(void) {
+    if (first_tx_seen) {
+        return;
+    }
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    portENTER_CRITICAL(&trace_lock);
+    if (rtc_trace.trace.first_tx_us == 0) {
+        rtc_trace.trace.first_tx_us = now;
+    }
+    first_tx_seen = true;
+    portEXIT_CRITICAL(&trace_lock);
+}
+
+void boot_trace_done(void) {
+    portENTER_CRITICAL(&trace_lock);
+    rtc_trace.trace.complete = true;
+    portEXIT_CRITICAL(&trace_lock);
+
+    boot_trace_t trace;
+    boot_trace_get(false, &trace);
+    ESP_LOGI(TAG, "=== Boot time budget ===");
+    ESP_LOGI(TAG, "  %-16s %6lu ms", "before app_main", (unsigned long)(trace.app_start_us / 1000));
+    for (uint32_t i = 0; i < trace.stage_count; i++) {
+        ESP_LOGI(TAG, "  %-16s %6lu ms  (at %lu ms)", trace.stages[i].name,
+                 (unsigned long)(trace.stages[i].duration_us / 1000), (unsigned long)(trace.stages[i].at_us / 1000));
+    }
+    if (trace.dropped > 0) {
+        ESP_LOGW(TAG, "  %lu checkpoints past the first %d not stored", (unsigned long)trace.dropped,
+                 BOOT_TRACE_MAX_STAGES);
+    }
+    uint32_t ready_us = trace.stage_count > 0 ? trace.stages[trace.stage_count - 1].at_us : trace.app_start_us;
+    ESP_LOGI(TAG, "  %-16s %6lu ms since reset", "ready", (unsigned long)(ready_us / 1000));
+
+    if (have_previous && !previous_trace.complete) {
+        const char *reached = previous_trace.stage_count > 0
+                                  ? previous_trace.stages[previous_trace.stage_count - 1].name
+                                  : "app_main";
+        ESP_LOGW(TAG, "Previous boot did not finish starting up, last checkpoint: %s", reached);
+    }
+
+    set_metric_provider(METRIC_BOOT_TRACE, boot_trace_provider);
+    metrics_export_add_source(write_trace_metrics);
+}
+
+esp_err_t boot_trace_get(bool previous, boot_trace_t *trace) {
+    if (previous) {
+        if (!have_previous) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        *trace = previous_trace;
+        return ESP_OK;
+    }
+
+    portENTER_CRITICAL(&trace_lock);
+    *trace = rtc_trace.trace;
+    portEXIT_CRITICAL(&trace_lock);
+    return ESP_OK;
+}
+
+void boot_trace_write_json(json_writer_t *w) {
+    boot_trace_t trace;
+    json_obj_begin(w);
+    boot_trace_get(false, &trace);
+    json_key(w, "current");
+    write_trace_json(w, &trace);
+    if (boot_trace_get(true, &trace) == ESP_OK) {
+        json_key(w, "previous");
+        write_trace_json(w, &trace);
+    }
+    json_obj_end(w);
+}
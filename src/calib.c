@@ -0,0 +1,272 @@
+/**
+ * @file calib.c
+ * @brief Per-unit sensor calibration: piecewise-linear tables in the config, applied in fixed point
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "calib.h"
+#include "version.h"
+#include "wind.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register calib.c version
+REGISTER_VERSION(Calib, "1.0.0", "2026-10-15");
+
+static const char *TAG = "CALIB";
+
+#define SEGMENTS (CALIB_POINTS - 1)
+#define EDGES (CALIB_POINTS - 2)                // Inner points, where one segment gives way to the next
+#define SLOPE_SHIFT 16
+#define EDGE_NONE INT32_MAX                     // Past the last inner point: never reached
+
+#define VANE_FULL_SCALE 4096                    // As wind.c's ADC_FULL_SCALE
+#define ANEMOMETER_HZ_X100 10000                // Second point of the default line: 100 Hz
+
+_Static_assert(CALIB_POINTS >= 2, "a table needs two points");
+
+/**
+ * @brief A table as segments; a segment runs from its point to the next
+ */
+typedef struct {
+    int32_t edge[EDGES];                        // x of inner points, then EDGE_NONE
+    int32_t x0[SEGMENTS];
+    int32_t y0[SEGMENTS];
+    int32_t slope[SEGMENTS];                    // dy/dx, Q16
+} calib_lut_t;
+
+/**
+ * @brief One sensor: name, units, and where its table lives in the config
+ */
+typedef struct {
+    const char *name;
+    const char *input;
+    const char *output;
+    size_t offset;                              // In device_config_t
+    calib_table_t fallback;                     // The build's constants as points
+} calib_info_t;
+
+static const calib_info_t sensors[CALIB_COUNT] = {
+    [CALIB_VANE] = {
+        "vane", "raw ADC", "0.1 deg", offsetof(device_config_t, calib_vane),
+        { .count = 2, .x = { 0, VANE_FULL_SCALE },
+          .y = { WIND_VANE_OFFSET_DEG * 10, 3600 + WIND_VANE_OFFSET_DEG * 10 } },
+    },
+    [CALIB_ANEMOMETER] = {
+        "anemometer", "0.01 Hz", "0.01 m/s", offsetof(device_config_t, calib_wind),
+        { .count = 2, .x = { 0, ANEMOMETER_HZ_X100 },
+          .y = { 0, ANEMOMETER_HZ_X100 * WIND_MPS_PER_HZ_X1000 / 1000 } },
+    },
+    [CALIB_SUPPLY] = {
+        "supply", "pin mV", "battery mV", offsetof(device_config_t, calib_supply),
+        { .count = 2, .x = { 0, 1000 }, .y = { 0, 1000 } },
+    },
+};
+
+static calib_lut_t luts[2][CALIB_COUNT];        // Live set and the one calib_load() fills
+static uint32_t live = 0;                       // Index of the live set
+static bool stored[CALIB_COUNT];                // The live table came from the config
+static bool loaded = false;
+
+// =============================
+// Function Prototypes
+// =============================
+static void build(const calib_table_t *table, calib_lut_t *lut);
+static const calib_table_t *table_in(const device_config_t *cfg, calib_sensor_t sensor);
+static void ensure_loaded(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Segments of a valid table; a table with fewer than 2 points must not get here
+ */
+static void build(const calib_table_t *table, calib_lut_t *lut) {
+    int n = table->count;
+    for (int i = 0; i < SEGMENTS; i++) {
+        int s = i < n - 1 ? i : n - 2;          // Unused segments repeat the last one
+        int32_t dx = table->x[s + 1] - table->x[s];
+        int32_t dy = table->y[s + 1] - table->y[s];
+        int64_t q = (int64_t)dy * (1 << SLOPE_SHIFT);
+        lut->x0[i] = table->x[s];
+        lut->y0[i] = table->y[s];
+        lut->slope[i] = (int32_t)((q + (q < 0 ? -dx / 2 : dx / 2)) / dx);
+    }
+    for (int i = 0; i < EDGES; i++) {
+        lut->edge[i] = i + 1 < n - 1 ? table->x[i + 1] : EDGE_NONE;
+    }
+}
+
+static const calib_table_t *table_in(const device_config_t *cfg, calib_sensor_t sensor) {
+    return (const calib_table_t *)((const uint8_t *)cfg + sensors[sensor].offset);
+}
+
+/**
+ * @brief Build the constants' segments into the live set, for calib_apply() before calib_load()
+ */
+static void ensure_loaded(void) {
+    if (__atomic_load_n(&loaded, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    for (int s = 0; s < CALIB_COUNT; s++) {
+        build(&sensors[s].fallback, &luts[live][s]);
+    }
+    __atomic_store_n(&loaded, true, __ATOMIC_RELEASE);
+}
+
+void calib_load(void) {
+    device_config_t cfg;
+    bool have_cfg = nvs_config_get(&cfg) == ESP_OK;
+    uint32_t idle = __atomic_load_n(&live, __ATOMIC_RELAXED) ^ 1;
+    for (int s = 0; s < CALIB_COUNT; s++) {
+        const calib_table_t *table = have_cfg ? table_in(&cfg, s) : NULL;
+        bool ok = table != NULL && table->count != 0 && calib_validate(table) == ESP_OK;
+        if (table != NULL && table->count != 0 && !ok) {
+            ESP_LOGW(TAG, "Stored %s table is invalid; using the build's constants", sensors[s].name);
+        }
+        build(ok ? table : &sensors[s].fallback, &luts[idle][s]);
+        stored[s] = ok;
+    }
+    __atomic_store_n(&live, idle, __ATOMIC_RELEASE);
+    __atomic_store_n(&loaded, true, __ATOMIC_RELEASE);
+    ESP_LOGI(TAG, "Calibration: vane %s, anemometer %s, supply %s", stored[CALIB_VANE] ? "stored" : "default",
+             stored[CALIB_ANEMOMETER] ? "stored" : "default", stored[CALIB_SUPPLY] ? "stored" : "default");
+}
+
+int32_t calib_apply(calib_sensor_t sensor, int32_t x) {
+    ensure_loaded();
+    const calib_lut_t *lut = &luts[__atomic_load_n(&live, __ATOMIC_ACQUIRE)][sensor];
+    uint32_t i = 0;
+    for (int k = 0; k < EDGES; k++) {
+        i += (uint32_t)(x >= lut->edge[k]);     // A compare and an add: no branch on x
+    }
+    int64_t d = (int64_t)(x - lut->x0[i]) * lut->slope[i];
+    return lut->y0[i] + (int32_t)((d + (1 << (SLOPE_SHIFT - 1))) >> SLOPE_SHIFT);
+}
+
+esp_err_t calib_validate(const calib_table_t *table) {
+    if (table->count == 0) {
+        return ESP_OK;
+    }
+    if (table->count < 2 || table->count > CALIB_POINTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i + 1 < table->count; i++) {
+        int32_t dx = table->x[i + 1] - table->x[i];
+        int32_t dy = table->y[i + 1] - table->y[i];
+        if (dx <= 0 || abs(dy) / dx >= 32768) {
+            return ESP_ERR_INVALID_ARG;         // Inputs must rise; the Q16 slope must fit 32 bits
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t calib_parse(const char *text, calib_table_t *table) {
+    memset(table, 0, sizeof(*table));
+    const char *p = text;
+    while (*p != '\0') {
+        char *end;
+        long x = strtol(p, &end, 10);
+        if (end == p || *end != ':' || table->count == CALIB_POINTS) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        p = end + 1;
+        long y = strtol(p, &end, 10);
+        if (end == p || (*end != ',' && *end != '\0') || x < INT16_MIN || x > INT16_MAX || y < INT16_MIN ||
+            y > INT16_MAX) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        table->x[table->count] = (int16_t)x;
+        table->y[table->count] = (int16_t)y;
+        table->count++;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return calib_validate(table);
+}
+
+esp_err_t calib_set(calib_sensor_t sensor, const calib_table_t *table) {
+    if (sensor >= CALIB_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = calib_validate(table);
+    device_config_t cfg;
+    if (err == ESP_OK) {
+        err = nvs_config_get(&cfg);
+    }
+    if (err == ESP_OK) {
+        memcpy((uint8_t *)&cfg + sensors[sensor].offset, table, sizeof(*table));
+        err = nvs_config_update(&cfg);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    calib_load();
+    ESP_LOGI(TAG, "%s table set: %u points", sensors[sensor].name, table->count);
+    return ESP_OK;
+}
+
+bool calib_get(calib_sensor_t sensor, calib_table_t *table) {
+    device_config_t cfg;
+    if (sensor < CALIB_COUNT && nvs_config_get(&cfg) == ESP_OK) {
+        const calib_table_t *t = table_in(&cfg, sensor);
+        if (t->count != 0 && calib_validate(t) == ESP_OK) {
+            *table = *t;
+            return true;
+        }
+    }
+    *table = sensors[sensor < CALIB_COUNT ? sensor : 0].fallback;
+    return false;
+}
+
+const char *calib_name(calib_sensor_t sensor) {
+    return sensor < CALIB_COUNT ? sensors[sensor].name : NULL;
+}
+
+bool calib_find(const char *name, calib_sensor_t *sensor) {
+    for (int s = 0; s < CALIB_COUNT; s++) {
+        if (strcmp(name, sensors[s].name) == 0) {
+            *sensor = (calib_sensor_t)s;
+            return true;
+        }
+    }
+    return false;
+}
+
+void calib_write_json(json_writer_t *w) {
+    calib_table_t table;
+    json_obj_begin(w);
+    json_key(w, "sensors");
+    json_arr_begin(w);
+    for (int s = 0; s < CALIB_COUNT; s++) {
+        bool is_stored = calib_get((calib_sensor_t)s, &table);
+        json_obj_begin(w);
+        json_kv_str(w, "name", sensors[s].name);
+        json_kv_str(w, "input", sensors[s].input);
+        json_kv_str(w, "output", sensors[s].output);
+        json_kv_bool(w, "stored", is_stored);
+        json_key(w, "points");
+        json_arr_begin(w);
+        for (int i = 0; i < table.count; i++) {
+            json_arr_begin(w);
+            json_int(w, table.x[i]);
+            json_int(w, table.y[i]);
+            json_arr_end(w);
+        }
+        json_arr_end(w);
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+    json_kv_uint(w, "maxPoints", CALIB_POINTS);
+    json_obj_end(w);
+}
@@ -0,0 +1,73 @@
+/**
+ * @file capture_file.c
+ * @brief Byte layout of the ESP-NOW capture files frame_capture.h writes and replays
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "capture_file.h"
+#include "version.h"
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register capture_file.c version
+REGISTER_VERSION(CaptureFile, "1.0.0", "2026-10-15");
+
+// =============================
+// Function Prototypes
+// =============================
+static void put_le32(uint8_t *p, uint32_t v);
+static uint32_t get_le32(const uint8_t *p);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void capture_file_write_header(uint8_t *out, uint32_t start) {
+    memset(out, 0, CAPTURE_FILE_HEADER_LEN);
+    put_le32(out, CAPTURE_FILE_MAGIC);
+    put_le32(out + 4, start);
+}
+
+esp_err_t capture_file_read_header(const uint8_t *buf, uint32_t *start) {
+    if (get_le32(buf) != CAPTURE_FILE_MAGIC) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (start != NULL) {
+        *start = get_le32(buf + 4);
+    }
+    return ESP_OK;
+}
+
+void capture_file_write_record(uint8_t *out, const capture_file_record_t *rec) {
+    put_le32(out, rec->t_ms);
+    memcpy(out + 4, rec->mac, CAPTURE_FILE_MAC_LEN);
+    out[10] = (uint8_t)rec->rssi;
+    out[11] = rec->len;
+}
+
+esp_err_t capture_file_read_record(const uint8_t *buf, capture_file_record_t *rec) {
+    rec->t_ms = get_le32(buf);
+    memcpy(rec->mac, buf + 4, CAPTURE_FILE_MAC_LEN);
+    rec->rssi = (int8_t)buf[10];
+    rec->len = buf[11];
+    return rec->len == 0 || rec->len > CAPTURE_FILE_FRAME_MAX ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
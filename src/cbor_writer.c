@@ -0,0 +1,129 @@
+/**
+ * @file cbor_writer.c
+ * @brief Minimal CBOR (RFC 8949) encoder into a caller-supplied buffer
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "cbor_writer.h"
+#include "version.h"
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register cbor_writer.c version
+REGISTER_VERSION(CborWriter, "1.0.0", "2026-10-15");
+
+#define MAJOR_UINT 0
+#define MAJOR_NEGINT 1
+#define MAJOR_TEXT 3
+#define MAJOR_ARRAY 4
+#define MAJOR_MAP 5
+#define SIMPLE_NULL 0xF6
+
+// =============================
+// Function Prototypes
+// =============================
+static bool reserve(cbor_writer_t *w, size_t n);
+static void put_head(cbor_writer_t *w, uint8_t major, uint64_t value);
+
+// =============================
+// Function Definitions
+// =============================
+
+static bool reserve(cbor_writer_t *w, size_t n) {
+    if (w->err != ESP_OK) {
+        return false;
+    }
+    if (w->len + n > w->cap) {
+        w->err = ESP_ERR_INVALID_SIZE;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Initial byte plus the argument in the fewest bytes (big-endian)
+ */
+static void put_head(cbor_writer_t *w, uint8_t major, uint64_t value) {
+    uint8_t extra;
+    uint8_t info;
+    if (value < 24) {
+        extra = 0;
+        info = (uint8_t)value;
+    } else if (value <= UINT8_MAX) {
+        extra = 1;
+        info = 24;
+    } else if (value <= UINT16_MAX) {
+        extra = 2;
+        info = 25;
+    } else if (value <= UINT32_MAX) {
+        extra = 4;
+        info = 26;
+    } else {
+        extra = 8;
+        info = 27;
+    }
+    if (!reserve(w, 1 + extra)) {
+        return;
+    }
+    w->buf[w->len++] = (uint8_t)(major << 5) | info;
+    for (int shift = (extra - 1) * 8; shift >= 0; shift -= 8) {
+        w->buf[w->len++] = (uint8_t)(value >> shift);
+    }
+}
+
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t cap) {
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->err = ESP_OK;
+}
+
+esp_err_t cbor_writer_finish(const cbor_writer_t *w, size_t *len) {
+    if (w->err == ESP_OK) {
+        *len = w->len;
+    }
+    return w->err;
+}
+
+void cbor_map(cbor_writer_t *w, size_t pairs) {
+    put_head(w, MAJOR_MAP, pairs);
+}
+
+void cbor_array(cbor_writer_t *w, size_t count) {
+    put_head(w, MAJOR_ARRAY, count);
+}
+
+void cbor_uint(cbor_writer_t *w, uint64_t value) {
+    put_head(w, MAJOR_UINT, value);
+}
+
+void cbor_int(cbor_writer_t *w, int64_t value) {
+    if (value >= 0) {
+        put_head(w, MAJOR_UINT, (uint64_t)value);
+    } else {
+        put_head(w, MAJOR_NEGINT, (uint64_t)(-1 - value));
+    }
+}
+
+void cbor_text(cbor_writer_t *w, const char *value) {
+    size_t n = strlen(value);
+    put_head(w, MAJOR_TEXT, n);
+    if (reserve(w, n)) {
+        memcpy(w->buf + w->len, value, n);
+        w->len += n;
+    }
+}
+
+void cbor_null(cbor_writer_t *w) {
+    if (reserve(w, 1)) {
+        w->buf[w->len++] = SIMPLE_NULL;
+    }
+}
@@ -0,0 +1,531 @@
+/**
+ * @file config_schema.c
+ * @brief Configuration schema table and the code generated from it
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "config_schema.h"
+#include "version.h"
+#include <stdlib.h>
+#include <string.h>
+#include "nvs.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register config_schema.c version
+REGISTER_VERSION(ConfigSchema, "1.0.0", "2026-10-15");
+static const char *TAG = "CONFIG_SCHEMA";
+
+#define MEMBER_SIZE(member) sizeof(((device_config_t *)0)->member)
+
+#define CONFIG_SCHEMA_ENTRY(member, nvs, json, field_type, lo, hi, def) \
+    { .nvs_key = (nvs), .json_key = (json), .type = (field_type), \
+      .offset = offsetof(device_config_t, member), .size = MEMBER_SIZE(member), \
+      .min = (lo), .max = (hi), def },
+
+const config_field_t config_schema[CONFIG_SCHEMA_COUNT] = {
+    CONFIG_SCHEMA(CONFIG_SCHEMA_ENTRY)
+};
+
+// Caught at build time rather than as an NVS error or a torn copy at run time
+#define CONFIG_SCHEMA_CHECK(member, nvs, json, field_type, lo, hi, def) \
+    _Static_assert(sizeof(nvs) <= NVS_KEY_NAME_MAX_SIZE, "NVS key of " #member " is too long"); \
+    _Static_assert((field_type) != CONFIG_TYPE_U8 || MEMBER_SIZE(member) == 1, #member " is not a uint8_t"); \
+    _Static_assert((field_type) != CONFIG_TYPE_U16 || MEMBER_SIZE(member) == 2, #member " is not a uint16_t"); \
+    _Static_assert(MEMBER_SIZE(member) <= CONFIG_SCHEMA_MAX_SIZE, #member " is larger than CONFIG_SCHEMA_MAX_SIZE");
+
+CONFIG_SCHEMA(CONFIG_SCHEMA_CHECK)
+
+// Every field the binary form carries (those with a JSON member) at its largest, with its index and length bytes
+#define CONFIG_SCHEMA_BINARY_LEN(member, nvs, json, ...) + ((json) != NULL ? 2 + MEMBER_SIZE(member) : 0)
+_Static_assert(0 CONFIG_SCHEMA(CONFIG_SCHEMA_BINARY_LEN) <= CONFIG_SCHEMA_BINARY_MAX,
+               "the binary form outgrew CONFIG_SCHEMA_BINARY_MAX");
+
+// Blob framing: magic, version, flags and entries length ahead, CRC-32 behind
+#define BLOB_MAGIC "WSCF"
+#define BLOB_HEADER_LEN 8
+#define BLOB_CRC_LEN 4
+
+// Every field at its largest: key length, key, value length, value
+#define CONFIG_SCHEMA_BLOB_LEN(member, nvs, ...) + (sizeof(nvs) + 1 + MEMBER_SIZE(member))
+_Static_assert(BLOB_HEADER_LEN + 0 CONFIG_SCHEMA(CONFIG_SCHEMA_BLOB_LEN) + BLOB_CRC_LEN <= CONFIG_SCHEMA_BLOB_MAX,
+               "the export blob outgrew CONFIG_SCHEMA_BLOB_MAX");
+
+// =============================
+// Function Prototypes
+// =============================
+static int hex_digit(char c);
+static bool apply_number(device_config_t *cfg, const config_field_t *field, const char *value);
+static bool apply_hex(device_config_t *cfg, const config_field_t *field, const char *value, size_t len);
+static const char *type_name(config_type_t type);
+static size_t value_max(const config_field_t *field);
+static void put_value(const config_field_t *field, const uint8_t *src, size_t len, uint8_t *out);
+static esp_err_t apply_value(device_config_t *cfg, const config_field_t *field, const uint8_t *value,
+                             size_t value_len);
+static const config_field_t *find_nvs(const char *key, size_t key_len);
+
+// =============================
+// Function Definitions
+// =============================
+
+void config_schema_defaults(device_config_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    for (size_t i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_field_t *field = &config_schema[i];
+        uint8_t *dest = (uint8_t *)cfg + field->offset;
+        switch (field->type) {
+            case CONFIG_TYPE_STR:
+                strlcpy((char *)dest, field->def_str != NULL ? field->def_str : "", field->size);
+                break;
+            case CONFIG_TYPE_U8:
+                *dest = (uint8_t)field->def_num;
+                break;
+            case CONFIG_TYPE_U16:
+                memcpy(dest, &field->def_num, sizeof(uint16_t));
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+esp_err_t config_schema_validate(const device_config_t *cfg) {
+    for (size_t i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_field_t *field = &config_schema[i];
+        const uint8_t *src = (const uint8_t *)cfg + field->offset;
+        uint16_t number;
+        switch (field->type) {
+            case CONFIG_TYPE_STR:
+                if (strnlen((const char *)src, field->size) >= field->size) {
+                    ESP_LOGE(TAG, "Config field %s is not terminated", field->nvs_key);
+                    return ESP_ERR_INVALID_ARG;
+                }
+                break;
+            case CONFIG_TYPE_U8:
+            case CONFIG_TYPE_U16:
+                number = field->type == CONFIG_TYPE_U8 ? *src : *(const uint16_t *)src;
+                if (number < field->min || number > field->max) {
+                    ESP_LOGE(TAG, "Invalid %s: %u (must be %u to %u)",
+                             field->nvs_key, number, field->min, field->max);
+                    return ESP_ERR_INVALID_ARG;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return ESP_OK;
+}
+
+const config_field_t *config_schema_find_json(const char *json_key) {
+    for (size_t i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_field_t *field = &config_schema[i];
+        if (field->json_key != NULL && strcmp(field->json_key, json_key) == 0) {
+            return field;
+        }
+    }
+    return NULL;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool apply_number(device_config_t *cfg, const config_field_t *field, const char *value) {
+    long number = strtol(value, NULL, 10);
+    if (number < field->min || number > field->max) {
+        ESP_LOGW(TAG, "Invalid %s %ld, defaulting to %u", field->json_key, number, field->def_num);
+        number = field->def_num;
+    }
+
+    uint8_t *dest = (uint8_t *)cfg + field->offset;
+    if (field->type == CONFIG_TYPE_U8) {
+        *dest = (uint8_t)number;
+    } else {
+        uint16_t u16 = (uint16_t)number;
+        memcpy(dest, &u16, sizeof(u16));
+    }
+    return true;
+}
+
+static bool apply_hex(device_config_t *cfg, const config_field_t *field, const char *value, size_t len) {
+    uint8_t bytes[CONFIG_SCHEMA_MAX_SIZE];
+    if (len != (size_t)field->size * 2) {
+        ESP_LOGE(TAG, "Invalid hex format for %s", field->json_key);
+        return false;
+    }
+    for (size_t i = 0; i < field->size; i++) {
+        int high = hex_digit(value[i * 2]);
+        int low = hex_digit(value[i * 2 + 1]);
+        if (high < 0 || low < 0) {
+            ESP_LOGE(TAG, "Invalid hex format for %s", field->json_key);
+            return false;
+        }
+        bytes[i] = (uint8_t)(high << 4 | low);
+    }
+    memcpy((uint8_t *)cfg + field->offset, bytes, field->size);
+    return true;
+}
+
+bool config_schema_apply_json(device_config_t *cfg, const config_field_t *field, const char *value, size_t len) {
+    if (len == 0) {
+        return false;
+    }
+
+    switch (field->type) {
+        case CONFIG_TYPE_STR:
+            if (len >= field->size) {
+                ESP_LOGW(TAG, "Ignoring %s: %zu characters exceeds the %u allowed",
+                         field->json_key, len, field->size - 1);
+                return false;
+            }
+            memcpy((char *)cfg + field->offset, value, len + 1);
+            return true;
+        case CONFIG_TYPE_HEX:
+            return apply_hex(cfg, field, value, len);
+        case CONFIG_TYPE_U8:
+        case CONFIG_TYPE_U16:
+            return apply_number(cfg, field, value);
+        default:
+            return false;
+    }
+}
+
+void config_schema_write_json(json_writer_t *w, const device_config_t *cfg) {
+    for (size_t i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_field_t *field = &config_schema[i];
+        const uint8_t *src = (const uint8_t *)cfg + field->offset;
+        if (field->json_key == NULL) {
+            continue;
+        }
+        switch (field->type) {
+            case CONFIG_TYPE_STR:
+                json_kv_str(w, field->json_key, (const char *)src);
+                break;
+            case CONFIG_TYPE_HEX:
+                json_key(w, field->json_key);
+                json_hex(w, src, field->size);
+                break;
+            case CONFIG_TYPE_U8:
+                json_kv_uint(w, field->json_key, *src);
+                break;
+            case CONFIG_TYPE_U16:
+                json_kv_uint(w, field->json_key, *(const uint16_t *)src);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static const char *type_name(config_type_t type) {
+    switch (type) {
+        case CONFIG_TYPE_STR:
+            return "string";
+        case CONFIG_TYPE_HEX:
+            return "hex";
+        default:
+            return "number";
+    }
+}
+
+void config_schema_write_meta(json_writer_t *w) {
+    json_arr_begin(w);
+    for (size_t i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_field_t *field = &config_schema[i];
+        if (field->json_key == NULL) {
+            continue;
+        }
+        json_obj_begin(w);
+        json_kv_str(w, "key", field->json_key);
+        json_kv_str(w, "type", type_name(field->type));
+        switch (field->type) {
+            case CONFIG_TYPE_STR:
+                json_kv_uint(w, "maxLength", field->size - 1);
+                json_kv_str(w, "default", field->def_str != NULL ? field->def_str : "");
+                break;
+            case CONFIG_TYPE_HEX:
+                json_kv_uint(w, "maxLength", field->size * 2);
+                break;
+            default:
+                json_kv_uint(w, "min", field->min);
+                json_kv_uint(w, "max", field->max);
+                json_kv_uint(w, "default", field->def_num);
+                break;
+        }
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+}
+
+/**
+ * @brief Longest value of a field in binary form
+ */
+static size_t value_max(const config_field_t *field) {
+    return field->type == CONFIG_TYPE_STR ? (size_t)field->size - 1 : field->size;
+}
+
+/**
+ * @brief A field's value in binary form: a string without its terminator, bytes as they are, numbers little-endian
+ */
+static void put_value(const config_field_t *field, const uint8_t *src, size_t len, uint8_t *out) {
+    if (field->type == CONFIG_TYPE_U16) {
+        uint16_t number;
+        memcpy(&number, src, sizeof(number));
+        out[0] = (uint8_t)number;
+        out[1] = (uint8_t)(number >> 8);
+    } else {
+        memcpy(out, src, len);
+    }
+}
+
+/**
+ * @brief Copy one binary value into its field, if it fits the field exactly
+ */
+static esp_err_t apply_value(device_config_t *cfg, const config_field_t *field, const uint8_t *value,
+                             size_t value_len) {
+    uint8_t *dest = (uint8_t *)cfg + field->offset;
+    uint16_t number = 0;
+    switch (field->type) {
+        case CONFIG_TYPE_STR:
+            if (value_len > value_max(field)) {
+                ESP_LOGE(TAG, "%s: %u characters exceeds the %u allowed", field->nvs_key, (unsigned)value_len,
+                         (unsigned)value_max(field));
+                return ESP_ERR_INVALID_ARG;
+            }
+            memcpy(dest, value, value_len);
+            dest[value_len] = '\0';
+            return ESP_OK;
+        case CONFIG_TYPE_HEX:
+        case CONFIG_TYPE_BLOB:
+            if (value_len != field->size) {
+                ESP_LOGE(TAG, "%s: %u bytes, must be %u", field->nvs_key, (unsigned)value_len, field->size);
+                return ESP_ERR_INVALID_ARG;
+            }
+            memcpy(dest, value, value_len);
+            return ESP_OK;
+        case CONFIG_TYPE_U8:
+        case CONFIG_TYPE_U16:
+            if (value_len != field->size) {
+                ESP_LOGE(TAG, "%s: %u bytes, must be %u", field->nvs_key, (unsigned)value_len, field->size);
+                return ESP_ERR_INVALID_ARG;
+            }
+            number = field->type == CONFIG_TYPE_U8 ? value[0] : (uint16_t)(value[0] | value[1] << 8);
+            if (number < field->min || number > field->max) {
+                ESP_LOGE(TAG, "Invalid %s: %u (must be %u to %u)", field->nvs_key, number, field->min, field->max);
+                return ESP_ERR_INVALID_ARG;
+            }
+            memcpy(dest, &number, field->size);
+            return ESP_OK;
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+}
+
+size_t config_schema_encode(const device_config_t *cfg, uint8_t *out, size_t cap) {
+    size_t n = 0;
+    for (size_t i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_field_t *field = &config_schema[i];
+        const uint8_t *src = (const uint8_t *)cfg + field->offset;
+        if (field->json_key == NULL) {
+            continue;
+        }
+        size_t len = field->type == CONFIG_TYPE_STR ? strnlen((const char *)src, value_max(field)) : field->size;
+        if (n + 2 + len > cap) {
+            break;
+        }
+        out[n++] = (uint8_t)i;
+        out[n++] = (uint8_t)len;
+        put_value(field, src, len, out + n);
+        n += len;
+    }
+    return n;
+}
+
+esp_err_t config_schema_apply_binary(device_config_t *cfg, const uint8_t *data, size_t len) {
+    device_config_t next = *cfg;
+    size_t pos = 0;
+    while (pos < len) {
+        if (len - pos < 2) {
+            ESP_LOGE(TAG, "Truncated entry at byte %u", (unsigned)pos);
+            return ESP_ERR_INVALID_ARG;
+        }
+        uint8_t index = data[pos];
+        size_t value_len = data[pos + 1];
+        const uint8_t *value = data + pos + 2;
+        pos += 2 + value_len;
+        if (index >= CONFIG_SCHEMA_COUNT || config_schema[index].json_key == NULL || pos > len) {
+            ESP_LOGE(TAG, "Bad entry for field %u", index);
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        esp_err_t err = apply_value(&next, &config_schema[index], value, value_len);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    *cfg = next;
+    return ESP_OK;
+}
+
+size_t config_schema_encode_meta(uint8_t *out, size_t cap) {
+    size_t n = 0;
+    for (size_t i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_field_t *field = &config_schema[i];
+        if (field->json_key == NULL) {
+            continue;
+        }
+        size_t key_len = strlen(field->json_key);
+        if (n + 8 + key_len > cap) {
+            return 0;
+        }
+        bool number = field->type == CONFIG_TYPE_U8 || field->type == CONFIG_TYPE_U16;
+        uint16_t min = number ? field->min : 0;
+        uint16_t max = number ? field->max : 0;
+        out[n++] = (uint8_t)i;
+        out[n++] = (uint8_t)field->type;
+        out[n++] = (uint8_t)value_max(field);
+        out[n++] = (uint8_t)min;
+        out[n++] = (uint8_t)(min >> 8);
+        out[n++] = (uint8_t)max;
+        out[n++] = (uint8_t)(max >> 8);
+        out[n++] = (uint8_t)key_len;
+        memcpy(out + n, field->json_key, key_len);
+        n += key_len;
+    }
+    return n;
+}
+
+static const config_field_t *find_nvs(const char *key, size_t key_len) {
+    for (size_t i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_field_t *field = &config_schema[i];
+        if (strncmp(field->nvs_key, key, key_len) == 0 && field->nvs_key[key_len] == '\0') {
+            return field;
+        }
+    }
+    return NULL;
+}
+
+bool config_schema_per_unit(const config_field_t *field) {
+    return field->offset == offsetof(device_config_t, node_settings) ||
+           field->offset == offsetof(device_config_t, calib_vane) ||
+           field->offset == offsetof(device_config_t, calib_wind) ||
+           field->offset == offsetof(device_config_t, calib_supply);
+}
+
+size_t config_schema_export_blob(const device_config_t *cfg, bool unit, uint8_t *out, size_t cap) {
+    if (cap < BLOB_HEADER_LEN + BLOB_CRC_LEN) {
+        return 0;
+    }
+    size_t n = BLOB_HEADER_LEN;
+    for (size_t i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_field_t *field = &config_schema[i];
+        const uint8_t *src = (const uint8_t *)cfg + field->offset;
+        if (!unit && config_schema_per_unit(field)) {
+            continue;
+        }
+        size_t key_len = strlen(field->nvs_key);
+        size_t len = field->type == CONFIG_TYPE_STR ? strnlen((const char *)src, value_max(field)) : field->size;
+        if (n + 2 + key_len + len + BLOB_CRC_LEN > cap) {
+            return 0;
+        }
+        out[n++] = (uint8_t)key_len;
+        memcpy(out + n, field->nvs_key, key_len);
+        n += key_len;
+        out[n++] = (uint8_t)len;
+        put_value(field, src, len, out + n);
+        n += len;
+    }
+
+    size_t entries_len = n - BLOB_HEADER_LEN;
+    memcpy(out, BLOB_MAGIC, 4);
+    out[4] = CONFIG_SCHEMA_BLOB_VERSION;
+    out[5] = unit ? CONFIG_SCHEMA_BLOB_UNIT : 0;
+    out[6] = (uint8_t)entries_len;
+    out[7] = (uint8_t)(entries_len >> 8);
+    uint32_t crc = esp_rom_crc32_le(0, out, n);
+    for (int i = 0; i < BLOB_CRC_LEN; i++) {
+        out[n++] = (uint8_t)(crc >> (8 * i));
+    }
+    return n;
+}
+
+esp_err_t config_schema_import_blob(device_config_t *cfg, const uint8_t *blob, size_t len,
+                                    config_import_result_t *result) {
+    config_import_result_t counts = { 0 };
+    if (len < BLOB_HEADER_LEN + BLOB_CRC_LEN || memcmp(blob, BLOB_MAGIC, 4) != 0) {
+        ESP_LOGE(TAG, "Not a config blob");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (blob[4] != CONFIG_SCHEMA_BLOB_VERSION) {
+        ESP_LOGE(TAG, "Config blob version %u, this build reads %u", blob[4], CONFIG_SCHEMA_BLOB_VERSION);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    size_t entries_len = (size_t)(blob[6] | blob[7] << 8);
+    if (BLOB_HEADER_LEN + entries_len + BLOB_CRC_LEN != len) {
+        ESP_LOGE(TAG, "Config blob is %u bytes, its header says %u", (unsigned)len,
+                 (unsigned)(BLOB_HEADER_LEN + entries_len + BLOB_CRC_LEN));
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const uint8_t *tail = blob + len - BLOB_CRC_LEN;
+    uint32_t crc = (uint32_t)tail[0] | (uint32_t)tail[1] << 8 | (uint32_t)tail[2] << 16 | (uint32_t)tail[3] << 24;
+    if (esp_rom_crc32_le(0, blob, len - BLOB_CRC_LEN) != crc) {
+        ESP_LOGE(TAG, "Config blob CRC mismatch");
+        return ESP_ERR_INVALID_CRC;
+    }
+    counts.flags = blob[5];
+
+    device_config_t next = *cfg;
+    const uint8_t *end = tail;
+    const uint8_t *p = blob + BLOB_HEADER_LEN;
+    while (p < end) {
+        size_t key_len = p[0];
+        if ((size_t)(end - p) < 2 + key_len || (size_t)(end - p) < 2 + key_len + p[1 + key_len]) {
+            ESP_LOGE(TAG, "Truncated entry at byte %u", (unsigned)(p - blob));
+            return ESP_ERR_INVALID_SIZE;
+        }
+        const char *key = (const char *)p + 1;
+        size_t value_len = p[1 + key_len];
+        const uint8_t *value = p + 2 + key_len;
+        p = value + value_len;
+
+        const config_field_t *field = find_nvs(key, key_len);
+        if (field == NULL) {
+            counts.unknown++;                   // From a newer build; the rest still applies
+            continue;
+        }
+        esp_err_t err = apply_value(&next, field, value, value_len);
+        if (err != ESP_OK) {
+            return err;
+        }
+        counts.applied++;
+    }
+
+    esp_err_t err = config_schema_validate(&next);
+    if (err != ESP_OK) {
+        return err;
+    }
+    *cfg = next;
+    if (result != NULL) {
+        *result = counts;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,189 @@
+/**
+ * @file coredump.c
+ * @brief Access to the ESP-IDF core dump stored in the coredump partition
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "coredump.h"
+#include "flash_io.h"
+#include "version.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "sdkconfig.h"
+#if CONFIG_ESP_COREDUMP_ENABLE_TO_FLASH
+#include "esp_core_dump.h"
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register coredump.c version
+REGISTER_VERSION(CoreDump, "1.0.0", "2026-10-14");
+
+static const char *TAG = "COREDUMP";
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t image_location(const esp_partition_t **part, size_t *offset, size_t *size);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Find the partition holding the image and the image's place in it
+ */
+static esp_err_t image_location(const esp_partition_t **part, size_t *offset, size_t *size) {
+#if CONFIG_ESP_COREDUMP_ENABLE_TO_FLASH
+    size_t addr = 0;
+    esp_err_t err = esp_core_dump_image_get(&addr, size);
+    if (err != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_COREDUMP, NULL);
+    if (*part == NULL || addr < (*part)->address || addr + *size > (*part)->address + (*part)->size) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *offset = addr - (*part)->address;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+bool coredump_check_boot(void) {
+    coredump_info_t info;
+    esp_err_t err = coredump_get_info(&info);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGI(TAG, "Core dump to flash is disabled");
+        return false;
+    }
+    if (!info.present) {
+        ESP_LOGI(TAG, "No core dump stored");
+        return false;
+    }
+    if (!info.valid) {
+        ESP_LOGW(TAG, "Stored core dump (%u bytes) fails its checksum", (unsigned)info.size);
+        return false;
+    }
+
+    ESP_LOGW(TAG, "Core dump from previous crash stored (%u bytes), fetch it from /api/coredump",
+             (unsigned)info.size);
+    if (info.panic_reason[0] != '\0') {
+        ESP_LOGW(TAG, "Panic reason: %s", info.panic_reason);
+    }
+    if (info.summary_valid) {
+        ESP_LOGW(TAG, "Crashed in task '%s' at PC 0x%08lx", info.task, (unsigned long)info.pc);
+    }
+    return true;
+}
+
+esp_err_t coredump_get_info(coredump_info_t *info) {
+    memset(info, 0, sizeof(*info));
+#if CONFIG_ESP_COREDUMP_ENABLE_TO_FLASH
+    const esp_partition_t *part;
+    size_t offset;
+    if (image_location(&part, &offset, &info->size) != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    info->present = true;
+    info->valid = esp_core_dump_image_check() == ESP_OK;
+    if (!info->valid) {
+        return ESP_OK;
+    }
+
+    if (esp_core_dump_get_panic_reason(info->panic_reason, sizeof(info->panic_reason)) != ESP_OK) {
+        info->panic_reason[0] = '\0';
+    }
+
+#if CONFIG_ESP_COREDUMP_DATA_FORMAT_ELF
+    // The summary is decoded from the ELF notes; it is a few hundred bytes, too big for some caller stacks
+    static esp_core_dump_summary_t summary;
+    if (esp_core_dump_get_summary(&summary) == ESP_OK) {
+        info->summary_valid = true;
+        strlcpy(info->task, summary.exc_task, sizeof(info->task));
+        info->pc = summary.exc_pc;
+        info->backtrace_depth = summary.exc_bt_info.depth;
+        if (info->backtrace_depth > COREDUMP_MAX_BACKTRACE) {
+            info->backtrace_depth = COREDUMP_MAX_BACKTRACE;
+        }
+        memcpy(info->backtrace, summary.exc_bt_info.bt, info->backtrace_depth * sizeof(uint32_t));
+        info->backtrace_corrupted = summary.exc_bt_info.corrupted;
+        strlcpy(info->app_sha256, (const char *)summary.app_elf_sha256, sizeof(info->app_sha256));
+    }
+#endif
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t coredump_read(size_t offset, void *buf, size_t len) {
+    const esp_partition_t *part;
+    size_t image_offset;
+    size_t size;
+    esp_err_t err = image_location(&part, &image_offset, &size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (offset > size || len > size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return flash_io_read(FLASH_IO_COREDUMP, part, image_offset + offset, buf, len);
+}
+
+esp_err_t coredump_erase(void) {
+#if CONFIG_ESP_COREDUMP_ENABLE_TO_FLASH
+    esp_err_t err = esp_core_dump_image_erase();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Core dump erased");
+    } else {
+        ESP_LOGE(TAG, "Failed to erase core dump: %s", esp_err_to_name(err));
+    }
+    return err;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void coredump_write_json(json_writer_t *w) {
+    coredump_info_t info;
+    esp_err_t err = coredump_get_info(&info);
+
+    json_obj_begin(w);
+    json_kv_bool(w, "supported", err != ESP_ERR_NOT_SUPPORTED);
+    json_kv_bool(w, "present", info.present);
+    if (info.present) {
+        json_kv_bool(w, "valid", info.valid);
+        json_kv_uint(w, "size", info.size);
+    }
+    if (info.panic_reason[0] != '\0') {
+        json_kv_str(w, "panicReason", info.panic_reason);
+    }
+    if (info.summary_valid) {
+        char hex[11];
+        json_kv_str(w, "task", info.task);
+        snprintf(hex, sizeof(hex), "0x%08lx", (unsigned long)info.pc);
+        json_kv_str(w, "pc", hex);
+        json_key(w, "backtrace");
+        json_arr_begin(w);
+        for (uint32_t i = 0; i < info.backtrace_depth; i++) {
+            snprintf(hex, sizeof(hex), "0x%08lx", (unsigned long)info.backtrace[i]);
+            json_str(w, hex);
+        }
+        json_arr_end(w);
+        json_kv_bool(w, "backtraceCorrupted", info.backtrace_corrupted);
+        json_kv_str(w, "appSha256", info.app_sha256);
+    }
+    json_obj_end(w);
+}
@@ -0,0 +1,338 @@
+/**
+ * @file cpu_monitor.c
+ * @brief Per-task CPU usage, per-core load and stack high-water marks from FreeRTOS run-time stats
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "cpu_monitor.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register cpu_monitor.c version
+REGISTER_VERSION(CpuMonitor, "1.0.0", "2026-10-14");
+
+static const char *TAG = "CPU_MONITOR";
+
+#define STATS_AVAILABLE (configUSE_TRACE_FACILITY == 1 && configGENERATE_RUN_TIME_STATS == 1)
+
+// Run-time counter of one task at the previous sample, matched by task number
+typedef struct {
+    UBaseType_t task_number;
+    configRUN_TIME_COUNTER_TYPE runtime;
+} task_prev_t;
+
+// Working state, touched only by the esp_timer callback
+static TaskStatus_t status[CPU_MONITOR_MAX_TASKS];
+static task_prev_t prev[CPU_MONITOR_MAX_TASKS];
+static size_t prev_count;
+static configRUN_TIME_COUNTER_TYPE prev_total;
+static bool have_prev;
+static float idle_window[CPU_MONITOR_WINDOW];
+static size_t idle_window_len;
+static size_t idle_window_pos;
+
+// Published results, copied in and out under the lock
+static cpu_task_stats_t published_tasks[CPU_MONITOR_MAX_TASKS];
+static size_t published_count;
+static cpu_load_t published_load;
+static portMUX_TYPE publish_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_timer_handle_t sample_timer;
+
+// =============================
+// Function Prototypes
+// =============================
+static void sample_cb(void *arg);
+static configRUN_TIME_COUNTER_TYPE prev_runtime(UBaseType_t task_number, bool *found);
+static metric_error_t load_provider(char *buf, size_t buf_len);
+static metric_error_t idle_provider(char *buf, size_t buf_len);
+static metric_error_t stack_min_provider(char *buf, size_t buf_len);
+static metric_error_t runtime_provider(char *buf, size_t buf_len);
+
+// =============================
+// Function Definitions
+// =============================
+
+static configRUN_TIME_COUNTER_TYPE prev_runtime(UBaseType_t task_number, bool *found) {
+    for (size_t i = 0; i < prev_count; i++) {
+        if (prev[i].task_number == task_number) {
+            *found = true;
+            return prev[i].runtime;
+        }
+    }
+    *found = false;
+    return 0;
+}
+
+/**
+ * @brief Take one sample and publish the deltas against the previous one
+ */
+static void sample_cb(void *arg) {
+    (void)arg;
+#if STATS_AVAILABLE
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count = uxTaskGetSystemState(status, CPU_MONITOR_MAX_TASKS, &total);
+    if (count == 0) {
+        ESP_LOGW(TAG, "More than %d tasks, sample skipped", CPU_MONITOR_MAX_TASKS);
+        return;
+    }
+
+    configRUN_TIME_COUNTER_TYPE elapsed = total - prev_total;
+    bool have_delta = have_prev && elapsed > 0;
+
+    cpu_task_stats_t tasks[CPU_MONITOR_MAX_TASKS];
+    cpu_load_t load = { .valid = have_delta, .cores = portNUM_PROCESSORS, .task_count = count };
+    float idle_total = 0.0f;
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *t = &status[i];
+        cpu_task_stats_t *out = &tasks[i];
+        bool found = false;
+        configRUN_TIME_COUNTER_TYPE before = prev_runtime(t->xTaskNumber, &found);
+        float share = 0.0f;
+        if (have_delta && found) {
+            // Fraction of one core's time; tasks that started mid-interval report from next time
+            share = (float)(t->ulRunTimeCounter - before) / (float)elapsed;
+        }
+
+        snprintf(out->name, sizeof(out->name), "%s", t->pcTaskName);
+        BaseType_t core = xTaskGetCoreID(t->xHandle);
+        out->core = (core >= 0 && core < portNUM_PROCESSORS) ? (int8_t)core : CPU_MONITOR_NO_AFFINITY;
+        out->priority = (uint8_t)t->uxCurrentPriority;
+        out->stack_hwm = (uint32_t)t->usStackHighWaterMark * sizeof(StackType_t);
+        out->cpu_percent = share * 100.0f / portNUM_PROCESSORS;
+
+        for (int c = 0; c < portNUM_PROCESSORS; c++) {
+            if (t->xHandle == xTaskGetIdleTaskHandleForCore(c)) {
+                float idle = share > 1.0f ? 1.0f : share;
+                load.core_load[c] = (1.0f - idle) * 100.0f;
+                idle_total += idle;
+            }
+        }
+    }
+
+    // Remember this sample's counters for the next delta
+    for (UBaseType_t i = 0; i < count; i++) {
+        prev[i].task_number = status[i].xTaskNumber;
+        prev[i].runtime = status[i].ulRunTimeCounter;
+    }
+    prev_count = count;
+    prev_total = total;
+    have_prev = true;
+
+    if (!have_delta) {
+        return;
+    }
+
+    load.idle_percent = idle_total * 100.0f / portNUM_PROCESSORS;
+    idle_window[idle_window_pos] = load.idle_percent;
+    idle_window_pos = (idle_window_pos + 1) % CPU_MONITOR_WINDOW;
+    if (idle_window_len < CPU_MONITOR_WINDOW) {
+        idle_window_len++;
+    }
+    float sum = 0.0f;
+    for (size_t i = 0; i < idle_window_len; i++) {
+        sum += idle_window[i];
+    }
+    load.idle_rolling = sum / idle_window_len;
+
+    // Busiest first; the list is short, so insertion sort is plenty
+    for (UBaseType_t i = 1; i < count; i++) {
+        cpu_task_stats_t key = tasks[i];
+        UBaseType_t j = i;
+        while (j > 0 && tasks[j - 1].cpu_percent < key.cpu_percent) {
+            tasks[j] = tasks[j - 1];
+            j--;
+        }
+        tasks[j] = key;
+    }
+
+    portENTER_CRITICAL(&publish_lock);
+    memcpy(published_tasks, tasks, count * sizeof(tasks[0]));
+    published_count = count;
+    published_load = load;
+    portEXIT_CRITICAL(&publish_lock);
+#endif
+}
+
+esp_err_t cpu_monitor_start(void) {
+#if STATS_AVAILABLE
+    if (sample_timer != NULL) {
+        return ESP_OK;
+    }
+
+    const esp_timer_create_args_t args = {
+        .callback = sample_cb,
+        .name = "cpu_monitor"
+    };
+    esp_err_t err = esp_timer_create(&args, &sample_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(sample_timer, (uint64_t)CPU_MONITOR_INTERVAL_MS * 1000);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start sampling: %s", esp_err_to_name(err));
+        if (sample_timer != NULL) {
+            esp_timer_delete(sample_timer);
+            sample_timer = NULL;
+        }
+        return err;
+    }
+
+    sample_cb(NULL);  // Baseline, so the first published interval is a full one
+    set_metric_provider(METRIC_CPU_LOAD, load_provider);
+    set_metric_provider(METRIC_CPU_IDLE, idle_provider);
+    set_metric_provider(METRIC_TASK_STACK_MIN, stack_min_provider);
+    set_metric_provider(METRIC_TASK_RUNTIME_STATS, runtime_provider);
+    ESP_LOGI(TAG, "Sampling every %d ms", CPU_MONITOR_INTERVAL_MS);
+    return ESP_OK;
+#else
+    ESP_LOGW(TAG, "FreeRTOS run-time stats are disabled, CPU monitor unavailable");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void cpu_monitor_stop(void) {
+    if (sample_timer == NULL) {
+        return;
+    }
+    esp_timer_stop(sample_timer);
+    esp_timer_delete(sample_timer);
+    sample_timer = NULL;
+    have_prev = false;
+}
+
+void cpu_monitor_get_load(cpu_load_t *load) {
+    portENTER_CRITICAL(&publish_lock);
+    *load = published_load;
+    portEXIT_CRITICAL(&publish_lock);
+}
+
+size_t cpu_monitor_get_tasks(cpu_task_stats_t *tasks, size_t max) {
+    portENTER_CRITICAL(&publish_lock);
+    size_t n = published_count < max ? published_count : max;
+    memcpy(tasks, published_tasks, n * sizeof(tasks[0]));
+    portEXIT_CRITICAL(&publish_lock);
+    return n;
+}
+
+void cpu_monitor_write_json(json_writer_t *w) {
+    cpu_load_t load;
+    cpu_monitor_get_load(&load);
+    cpu_task_stats_t tasks[CPU_MONITOR_MAX_TASKS];
+    size_t count = cpu_monitor_get_tasks(tasks, CPU_MONITOR_MAX_TASKS);
+
+    json_obj_begin(w);
+    json_kv_bool(w, "valid", load.valid);
+    json_kv_uint(w, "intervalMs", CPU_MONITOR_INTERVAL_MS);
+    json_key(w, "coreLoad");
+    json_arr_begin(w);
+    for (int c = 0; c < load.cores; c++) {
+        json_double(w, load.core_load[c], 1);
+    }
+    json_arr_end(w);
+    json_key(w, "idlePercent");
+    json_double(w, load.idle_percent, 1);
+    json_key(w, "idleRolling");
+    json_double(w, load.idle_rolling, 1);
+
+    json_key(w, "tasks");
+    json_arr_begin(w);
+    for (size_t i = 0; i < count; i++) {
+        json_obj_begin(w);
+        json_kv_str(w, "name", tasks[i].name);
+        json_kv_int(w, "core", tasks[i].core);
+        json_kv_uint(w, "priority", tasks[i].priority);
+        json_key(w, "cpuPercent");
+        json_double(w, tasks[i].cpu_percent, 1);
+        json_kv_uint(w, "stackHwm", tasks[i].stack_hwm);
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
+
+/**
+ * @brief METRIC_CPU_LOAD: busy percent per core
+ */
+static metric_error_t load_provider(char *buf, size_t buf_len) {
+    cpu_load_t load;
+    cpu_monitor_get_load(&load);
+    if (!load.valid) {
+        snprintf(buf, buf_len, "ERROR: No sample yet");
+        return METRIC_ERROR_NOT_AVAILABLE;
+    }
+
+    int pos = 0;
+    for (int c = 0; c < load.cores && pos >= 0 && (size_t)pos < buf_len; c++) {
+        pos += snprintf(buf + pos, buf_len - pos, "%sCore %d: %.1f%%", c ? ", " : "", c, load.core_load[c]);
+    }
+    return METRIC_OK;
+}
+
+/**
+ * @brief METRIC_CPU_IDLE: idle share now and over the rolling window
+ */
+static metric_error_t idle_provider(char *buf, size_t buf_len) {
+    cpu_load_t load;
+    cpu_monitor_get_load(&load);
+    if (!load.valid) {
+        snprintf(buf, buf_len, "ERROR: No sample yet");
+        return METRIC_ERROR_NOT_AVAILABLE;
+    }
+    snprintf(buf, buf_len, "%.1f%% (%ds avg %.1f%%)", load.idle_percent,
+             CPU_MONITOR_WINDOW * CPU_MONITOR_INTERVAL_MS / 1000, load.idle_rolling);
+    return METRIC_OK;
+}
+
+/**
+ * @brief METRIC_TASK_STACK_MIN: the task closest to overflowing its stack
+ */
+static metric_error_t stack_min_provider(char *buf, size_t buf_len) {
+    cpu_task_stats_t tasks[CPU_MONITOR_MAX_TASKS];
+    size_t count = cpu_monitor_get_tasks(tasks, CPU_MONITOR_MAX_TASKS);
+    if (count == 0) {
+        snprintf(buf, buf_len, "ERROR: No sample yet");
+        return METRIC_ERROR_NOT_AVAILABLE;
+    }
+
+    size_t lowest = 0;
+    for (size_t i = 1; i < count; i++) {
+        if (tasks[i].stack_hwm < tasks[lowest].stack_hwm) {
+            lowest = i;
+        }
+    }
+    snprintf(buf, buf_len, "%s: %lu bytes free", tasks[lowest].name, (unsigned long)tasks[lowest].stack_hwm);
+    return METRIC_OK;
+}
+
+/**
+ * @brief METRIC_TASK_RUNTIME_STATS: the three busiest tasks
+ */
+static metric_error_t runtime_provider(char *buf, size_t buf_len) {
+    cpu_task_stats_t tasks[3];
+    size_t count = cpu_monitor_get_tasks(tasks, 3);
+    if (count == 0) {
+        snprintf(buf, buf_len, "ERROR: No sample yet");
+        return METRIC_ERROR_NOT_AVAILABLE;
+    }
+
+    int pos = 0;
+    for (size_t i = 0; i < count && pos >= 0 && (size_t)pos < buf_len; i++) {
+        pos += snprintf(buf + pos, buf_len - pos, "%s%s %.1f%%", i ? ", " : "", tasks[i].name, tasks[i].cpu_percent);
+    }
+    return METRIC_OK;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file deadband.c
+ * @brief Send-on-change filter: a sample goes out only when a field leaves its deadband or the heartbeat runs out
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "deadband.h"
+#include "version.h"
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register deadband.c version
+REGISTER_VERSION(Deadband, "1.0.0", "2026-10-15");
+
+// =============================
+// Function Prototypes
+// =============================
+static bool outside(const deadband_field_t *field, int32_t sent, int32_t value);
+
+// =============================
+// Function Definitions
+// =============================
+
+void deadband_init(deadband_t *db) {
+    memset(db, 0, sizeof(*db));
+}
+
+/**
+ * @brief Whether a value moved past its band from the one sent
+ */
+static bool outside(const deadband_field_t *field, int32_t sent, int32_t value) {
+    int64_t change = (int64_t)value - sent;
+    if (change < 0) {
+        change = -change;
+    }
+    if (!field->relative) {
+        return change > field->band;
+    }
+    int64_t base = sent < 0 ? -(int64_t)sent : sent;
+    return change * 1000 > base * field->band;
+}
+
+bool deadband_check(deadband_t *db, const deadband_field_t *fields, const int32_t *values, size_t count,
+                    uint32_t time_s, uint32_t heartbeat_s, bool force, bool *held) {
+    if (count > DEADBAND_FIELDS_MAX) {
+        count = DEADBAND_FIELDS_MAX;
+    }
+
+    // A clock that stepped back counts as an expired heartbeat
+    bool send = force || !db->primed || time_s < db->sent_s ||
+                (heartbeat_s != 0 && time_s - db->sent_s >= heartbeat_s);
+    for (size_t i = 0; i < count && !send; i++) {
+        send = outside(&fields[i], db->sent[i], values[i]);
+    }
+
+    if (!send) {
+        db->held = true;
+        db->suppressed++;
+        return false;
+    }
+    if (held != NULL) {
+        *held = db->primed && db->held;
+    }
+    db->primed = true;
+    db->held = false;
+    db->sent_s = time_s;
+    memcpy(db->sent, values, count * sizeof(values[0]));
+    db->passed++;
+    return true;
+}
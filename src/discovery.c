@@ -0,0 +1,144 @@
+/**
+ * @file discovery.c
+ * @brief mDNS/DNS-SD advertisement of the web interface and telemetry
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "discovery.h"
+#include "version.h"
+#include "nvs_utils.h"
+#include "metrics_export.h"
+#include "metrics_stream.h"
+#include "https_portal.h"
+#include <stdio.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "mdns.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register discovery.c version
+REGISTER_VERSION(Discovery, "1.0.0", "2026-10-14");
+
+static const char *TAG = "DISCOVERY";
+
+static bool discovery_running = false;
+
+// =============================
+// Function Prototypes
+// =============================
+static void instance_name(char *buf, size_t len);
+static esp_err_t set_telemetry_txt(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief "ESP32 Weather Station a1b2c3" from the soft AP MAC, unique per device
+ */
+static void instance_name(char *buf, size_t len) {
+    uint8_t mac[6] = { 0 };
+    esp_read_mac(mac, ESP_MAC_WIFI_SOFTAP);
+    snprintf(buf, len, "%s %02x%02x%02x", DISCOVERY_INSTANCE_PREFIX, mac[3], mac[4], mac[5]);
+}
+
+/**
+ * @brief Publish the MQTT destination from the current configuration
+ */
+static esp_err_t set_telemetry_txt(void) {
+    device_config_t cfg;
+    esp_err_t err = nvs_config_get(&cfg);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    char broker[MQTT_IP_MAX_LEN + 8];
+    snprintf(broker, sizeof(broker), "%s:%u", cfg.mqtt_server_ip, cfg.mqtt_port);
+    err = mdns_service_txt_item_set(DISCOVERY_TELEMETRY_SERVICE, "_tcp", "broker", broker);
+    if (err == ESP_OK) {
+        err = mdns_service_txt_item_set(DISCOVERY_TELEMETRY_SERVICE, "_tcp", "topic", cfg.mqtt_base_topic);
+    }
+    return err;
+}
+
+esp_err_t discovery_start(void) {
+    if (discovery_running) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = mdns_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start mDNS responder: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    char instance[DISCOVERY_INSTANCE_MAX_LEN];
+    instance_name(instance, sizeof(instance));
+    mdns_hostname_set(DISCOVERY_HOSTNAME);
+    mdns_instance_name_set(instance);
+
+    // An HTTPS build advertises the portal as _https; port 80 only redirects there
+    const char *web_service = HTTPS_PORTAL != 0 ? "_https" : "_http";
+    uint16_t web_port = HTTPS_PORTAL != 0 ? HTTPS_PORTAL_PORT : DISCOVERY_HTTP_PORT;
+    mdns_txt_item_t http_txt[] = {
+        { "path", "/" },
+        { "version", PROJECT_VERSION },
+    };
+    err = mdns_service_add(NULL, web_service, "_tcp", web_port, http_txt,
+                           sizeof(http_txt) / sizeof(http_txt[0]));
+
+    // Readings are pushed to the MQTT broker; this service tells collectors where, and where to pull them instead
+    mdns_txt_item_t telemetry_txt[] = {
+        { "metrics", METRICS_EXPORT_URI },
+        { "stream", METRICS_STREAM_URI },
+        { "scheme", HTTPS_PORTAL != 0 ? "https" : "http" },
+        { "version", PROJECT_VERSION },
+    };
+    if (err == ESP_OK) {
+        err = mdns_service_add(NULL, DISCOVERY_TELEMETRY_SERVICE, "_tcp", web_port, telemetry_txt,
+                               sizeof(telemetry_txt) / sizeof(telemetry_txt[0]));
+    }
+    if (err == ESP_OK) {
+        err = set_telemetry_txt();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to advertise services: %s", esp_err_to_name(err));
+        mdns_free();
+        return err;
+    }
+
+    discovery_running = true;
+    ESP_LOGI(TAG, "Advertising '%s' as %s.local (%s._tcp, %s._tcp)", instance, DISCOVERY_HOSTNAME, web_service,
+             DISCOVERY_TELEMETRY_SERVICE);
+    return ESP_OK;
+}
+
+esp_err_t discovery_stop(void) {
+    if (!discovery_running) {
+        return ESP_OK;
+    }
+    mdns_service_remove_all();
+    mdns_free();
+    discovery_running = false;
+    ESP_LOGI(TAG, "mDNS responder stopped");
+    return ESP_OK;
+}
+
+esp_err_t discovery_update_telemetry(void) {
+    if (!discovery_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return set_telemetry_txt();
+}
+
+bool discovery_is_running(void) {
+    return discovery_running;
+}
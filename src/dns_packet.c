@@ -0,0 +1,137 @@
+/**
+ * @file dns_packet.c
+ * @brief DNS wire format: question parsing, name skipping and record TTL/EDNS rewriting
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "dns_packet.h"
+#include "version.h"
+#include <ctype.h>
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register dns_packet.c version
+REGISTER_VERSION(DnsPacket, "1.0.0", "2026-10-15");
+
+// =============================
+// Function Definitions
+// =============================
+
+bool dns_packet_parse_question(const uint8_t *pkt, int len, dns_question_t *q) {
+    q->name_len = 0;
+    int pos = DNS_HEADER_SIZE;
+    while (pos < len) {
+        uint8_t label = pkt[pos++];
+        if (label == 0) {
+            q->name[q->name_len] = '\0';
+            if (pos + 4 > len) {
+                return false;
+            }
+            q->qtype = (pkt[pos] << 8) | pkt[pos + 1];
+            q->qclass = (pkt[pos + 2] << 8) | pkt[pos + 3];
+            q->end = pos + 4;
+            return true;
+        }
+        if ((label & 0xC0) != 0 || pos + label > len || q->name_len + label + 1 > DNS_MAX_NAME_LEN) {
+            return false;
+        }
+        if (q->name_len > 0) {
+            q->name[q->name_len++] = '.';
+        }
+        for (uint8_t i = 0; i < label; i++) {
+            q->name[q->name_len++] = (char)tolower(pkt[pos + i]);
+        }
+        pos += label;
+    }
+    return false;
+}
+
+int dns_packet_skip_name(const uint8_t *pkt, int len, int pos) {
+    while (pos < len) {
+        uint8_t label = pkt[pos];
+        if (label == 0) {
+            return pos + 1;
+        }
+        if ((label & 0xC0) == 0xC0) {
+            return pos + 2 <= len ? pos + 2 : -1;
+        }
+        if ((label & 0xC0) != 0) {
+            return -1;
+        }
+        pos += label + 1;
+    }
+    return -1;
+}
+
+bool dns_packet_adjust_records(uint8_t *pkt, int len, dns_record_ctx_t *ctx) {
+    if (len < DNS_HEADER_SIZE) {
+        return false;
+    }
+    int qdcount = (pkt[4] << 8) | pkt[5];
+    int rrcount = ((pkt[6] << 8) | pkt[7]) + ((pkt[8] << 8) | pkt[9]) + ((pkt[10] << 8) | pkt[11]);
+
+    int pos = DNS_HEADER_SIZE;
+    for (int i = 0; i < qdcount; i++) {
+        pos = dns_packet_skip_name(pkt, len, pos);
+        if (pos < 0 || pos + 4 > len) {
+            return false;
+        }
+        pos += 4;
+    }
+
+    ctx->min_ttl = UINT32_MAX;
+    for (int i = 0; i < rrcount; i++) {
+        pos = dns_packet_skip_name(pkt, len, pos);
+        if (pos < 0 || pos + 10 > len) {
+            return false;
+        }
+        uint8_t *rr = &pkt[pos];
+        uint16_t type = (rr[0] << 8) | rr[1];
+        uint16_t rdlength = (rr[8] << 8) | rr[9];
+
+        if (type == DNS_TYPE_OPT) {
+            uint16_t payload = (rr[2] << 8) | rr[3];
+            if (ctx->max_payload != 0 && payload > ctx->max_payload) {
+                rr[2] = ctx->max_payload >> 8;
+                rr[3] = ctx->max_payload & 0xFF;
+            }
+        } else {
+            uint32_t ttl = ((uint32_t)rr[4] << 24) | ((uint32_t)rr[5] << 16) | ((uint32_t)rr[6] << 8) | rr[7];
+            ttl = ttl > ctx->elapsed_s ? ttl - ctx->elapsed_s : 0;
+            rr[4] = ttl >> 24;
+            rr[5] = (ttl >> 16) & 0xFF;
+            rr[6] = (ttl >> 8) & 0xFF;
+            rr[7] = ttl & 0xFF;
+            if (ttl < ctx->min_ttl) {
+                ctx->min_ttl = ttl;
+            }
+        }
+
+        pos += 10 + rdlength;
+        if (pos > len) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void dns_packet_a_answer(uint32_t ip, uint32_t ttl_s, uint8_t out[DNS_A_ANSWER_LEN]) {
+    const uint8_t *addr = (const uint8_t *)&ip;  // Network byte order already
+    const uint8_t answer[DNS_A_ANSWER_LEN] = {
+        0xC0, DNS_HEADER_SIZE,                  // Name: pointer to the question
+        0x00, DNS_TYPE_A,
+        0x00, DNS_CLASS_IN,
+        (ttl_s >> 24) & 0xFF, (ttl_s >> 16) & 0xFF, (ttl_s >> 8) & 0xFF, ttl_s & 0xFF,
+        0x00, 0x04,                             // RDLENGTH
+        addr[0], addr[1], addr[2], addr[3],
+    };
+    memcpy(out, answer, sizeof(answer));
+}
@@ -11,12 +11,22 @@
 // Includes
 // =============================
 #include "dns_server.h"
+#include "dns_packet.h"
+#include "pipeline_trace.h"
 #include "version.h"
+#include "SystemMetrics.h"
+#include "task_plan.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/event_groups.h"
 #include "lwip/sockets.h"
 #include "lwip/netdb.h"
+#include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_timer.h"
 #include "esp_log.h"
+#include <fcntl.h>
+#include <stdio.h>
 #include <string.h>
 
 // =============================
@@ -25,184 +35,868 @@
 // Register dns_server.c version
 REGISTER_VERSION(DnsServer, "1.0.0", "2025-10-18");
 static const char *TAG = "DNS_SERVER";
-static TaskHandle_t dns_task_handle = NULL;
+#define DNS_MAX_PACKET_SIZE 512
+#define DNS_SELECT_TIMEOUT_MS 500               // Housekeeping interval (qps window, upstream timeouts)
+#define DNS_START_TIMEOUT_MS 1000               // dns_server_start() waits this long for the socket
+#define DNS_STOP_TIMEOUT_MS 2000                // dns_server_stop() waits this long for the task to exit
+
+// Lifecycle event bits
+#define DNS_EVT_RUN (1 << 0)                    // Set by start, cleared by stop: the task keeps serving
+#define DNS_EVT_SERVING (1 << 1)                // Set by the task once its socket is bound
+#define DNS_EVT_EXITED (1 << 2)                 // Set by the task after cleanup; it then waits to be deleted
+
+// The task and its stack are static so repeated start/stop cycles cannot fragment or leak heap
+static StaticTask_t dns_task_tcb;
+static StackType_t dns_task_stack[DNS_TASK_STACK_SIZE];
+static StaticEventGroup_t dns_events_buf;
+static EventGroupHandle_t dns_events = NULL;
+static TaskHandle_t dns_task_handle = NULL;     // Owned by the start/stop caller, never written by the task
 static int dns_socket = -1;
-static bool dns_running = false;
+static int upstream_socket = -1;                // Connected to the upstream resolver in forward mode
 
-#define DNS_MAX_PACKET_SIZE 512
-#define DNS_TASK_STACK_SIZE 4096
-#define DNS_TASK_PRIORITY 5
+/**
+ * @brief Kinds of reply; each has a precomputed template
+ */
+typedef enum {
+    DNS_REPLY_A,                                // Our address
+    DNS_REPLY_NODATA,                           // Name exists, no record of that type (AAAA, HTTPS, ...)
+    DNS_REPLY_NXDOMAIN,                         // Reverse lookups: no such name
+    DNS_REPLY_NOTIMP,                           // Opcode or class we do not serve
+    DNS_REPLY_FORMERR,                          // Malformed question
+    DNS_REPLY_SERVFAIL,                         // Forward mode: no room to track another upstream query
+    DNS_REPLY_COUNT,
+    DNS_REPLY_FORWARD = DNS_REPLY_COUNT         // Not a template: ask the upstream resolver
+} dns_reply_t;
+
+/**
+ * @brief Header fields and answer section of one reply kind
+ */
+typedef struct {
+    uint16_t flags;                             // QR/AA/RA and the RCODE; RD is copied from the query
+    uint8_t answer[DNS_A_ANSWER_LEN];           // Answer RRs appended after the echoed question
+    uint8_t answer_len;
+    uint8_t ancount;
+} dns_template_t;
+
+/**
+ * @brief A query waiting for the upstream resolver, keyed by the ID we sent
+ */
+typedef struct {
+    bool used;
+    uint16_t upstream_id;                       // Random ID on the upstream leg
+    uint16_t client_id;                         // ID to restore in the reply
+    struct sockaddr_in client;
+    int64_t sent_us;
+    char name[DNS_CACHE_NAME_LEN];              // Cache key; empty if too long to cache
+    uint16_t qtype;
+    bool edns;                                  // Query carried additional records (EDNS OPT)
+} dns_pending_t;
+
+/**
+ * @brief A cached upstream reply
+ */
+typedef struct {
+    int64_t stored_us;
+    int64_t expires_us;                         // 0 = free slot
+    int64_t used_us;                            // For least-recently-used eviction
+    char name[DNS_CACHE_NAME_LEN];
+    uint16_t qtype;
+    bool edns;
+    uint16_t len;
+    uint8_t response[DNS_CACHE_MAX_RESPONSE];
+} dns_cache_entry_t;
+
+/**
+ * @brief Token bucket and counters of one source
+ */
+typedef struct {
+    dns_client_stats_t stats;
+    int64_t last_us;                            // Last packet; 0 = free slot
+    uint32_t tokens_milli;                      // Queries it may still send, in thousandths
+} dns_client_t;
+
+// Names answered locally in forward mode; in hijack mode every name is
+static const char *const local_names[] = { "portal", "portal.local", "weatherstation.local" };
+
+static dns_template_t templates[DNS_REPLY_COUNT];
+static dns_server_stats_t dns_stats;
+
+// Forward mode state; only the server task touches it
+static dns_server_mode_t active_mode = DNS_MODE_HIJACK;
+static dns_pending_t pending[DNS_FORWARD_MAX_PENDING];
+static dns_cache_entry_t cache[DNS_CACHE_ENTRIES];
+static uint8_t upstream_packet[DNS_FORWARD_MAX_PACKET];
+
+// Per-source and per-name accounting, copied out by other tasks under stats_lock
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static dns_client_t clients[DNS_MAX_CLIENTS];
+static dns_name_stats_t top_names[DNS_TOP_NAMES];
+static int64_t qps_window_start_us;
+static uint32_t qps_window_queries;
+
+// Mode requested by dns_server_set_mode(), applied by the server task
+static portMUX_TYPE mode_lock = portMUX_INITIALIZER_UNLOCKED;
+static dns_server_mode_t requested_mode = DNS_MODE_HIJACK;
+static uint32_t requested_upstream;             // IPv4, network byte order
+static bool mode_changed;
 
 // =============================
 // Function Prototypes
 // =============================
+static void build_templates(void);
+static bool rate_limit_allow(const struct sockaddr_in *source, int64_t now);
+static void count_name(const dns_question_t *q);
+static void update_qps(int64_t now);
+static metric_error_t queries_provider(char *buf, size_t buf_len);
+static metric_error_t top_names_provider(char *buf, size_t buf_len);
+static bool is_local_name(const dns_question_t *q);
+static dns_reply_t classify(const uint8_t *pkt, int len, dns_question_t *q, int *end);
+static int write_reply(uint8_t *pkt, int end, bool have_question, dns_reply_t reply, uint16_t query_flags);
+static dns_cache_entry_t *cache_find(const dns_question_t *q, bool edns, int64_t now);
+static void cache_store(const dns_pending_t *p, const uint8_t *pkt, int len, int64_t now);
+static void apply_mode(void);
+static void forward_query(uint8_t *pkt, int len, const dns_question_t *q, const struct sockaddr_in *client);
+static void handle_query(uint8_t *pkt, int len, const struct sockaddr_in *client);
+static void handle_upstream_reply(int len);
+static void expire_pending(int64_t now);
+static int open_socket(void);
+static void wake_task(void);
+static esp_err_t join_task(uint32_t timeout_ms);
 static void dns_server_task(void *pvParameters);
 
 // =============================
 // Function Definitions
 // =============================
 
-static void dns_server_task(void *pvParameters) {
-    char rx_buffer[DNS_MAX_PACKET_SIZE];
-    char addr_str[128];
-    int addr_family = AF_INET;
-    int ip_protocol = IPPROTO_UDP;
+/**
+ * @brief Precompute every reply for the AP's current address
+ *
+ * The A answer is a compression pointer to the question name (offset 12),
+ * so the same 16 bytes answer any name.
+ */
+static void build_templates(void) {
+    uint32_t ip = inet_addr(DNS_RESPONSE_IP);
+    esp_netif_t *ap = esp_netif_get_handle_from_ifkey("WIFI_AP_DEF");
+    esp_netif_ip_info_t ip_info;
+    if (ap != NULL && esp_netif_get_ip_info(ap, &ip_info) == ESP_OK && ip_info.ip.addr != 0) {
+        ip = ip_info.ip.addr;
+    }
+
+    const uint16_t base = DNS_FLAG_QR | DNS_FLAG_AA | DNS_FLAG_RA;
+    memset(templates, 0, sizeof(templates));
+    templates[DNS_REPLY_A].flags = base;
+    templates[DNS_REPLY_NODATA].flags = base;
+    templates[DNS_REPLY_NXDOMAIN].flags = base | DNS_RCODE_NXDOMAIN;
+    templates[DNS_REPLY_NOTIMP].flags = DNS_FLAG_QR | DNS_FLAG_RA | DNS_RCODE_NOTIMP;
+    templates[DNS_REPLY_FORMERR].flags = DNS_FLAG_QR | DNS_FLAG_RA | DNS_RCODE_FORMERR;
+    templates[DNS_REPLY_SERVFAIL].flags = DNS_FLAG_QR | DNS_FLAG_RA | DNS_RCODE_SERVFAIL;
+
+    dns_packet_a_answer(ip, DNS_ANSWER_TTL_S, templates[DNS_REPLY_A].answer);
+    templates[DNS_REPLY_A].answer_len = DNS_A_ANSWER_LEN;
+    templates[DNS_REPLY_A].ancount = 1;
+
+    const uint8_t *addr = (const uint8_t *)&ip;
+    ESP_LOGI(TAG, "Answering A queries with %u.%u.%u.%u", addr[0], addr[1], addr[2], addr[3]);
+}
+
+/**
+ * @brief Charge one packet to its source's token bucket
+ *
+ * Buckets refill at DNS_RATE_LIMIT_QPS up to DNS_RATE_LIMIT_BURST. A new
+ * source takes the slot of the one seen least recently, starting full.
+ *
+ * @return false if the source is over its rate and the packet should be dropped
+ */
+static bool rate_limit_allow(const struct sockaddr_in *source, int64_t now) {
+    const uint32_t full = DNS_RATE_LIMIT_BURST * 1000;
+    uint32_t addr = source->sin_addr.s_addr;
+
+    portENTER_CRITICAL(&stats_lock);
+    dns_client_t *c = NULL;
+    dns_client_t *oldest = &clients[0];
+    for (int i = 0; i < DNS_MAX_CLIENTS; i++) {
+        if (clients[i].last_us != 0 && clients[i].stats.addr == addr) {
+            c = &clients[i];
+            break;
+        }
+        if (clients[i].last_us < oldest->last_us) {
+            oldest = &clients[i];
+        }
+    }
+    if (c == NULL) {
+        c = oldest;
+        memset(c, 0, sizeof(*c));
+        c->stats.addr = addr;
+        c->tokens_milli = full;
+    } else {
+        // µs * queries/s / 1000 = thousandths of a query
+        int64_t refill = (now - c->last_us) * DNS_RATE_LIMIT_QPS / 1000;
+        c->tokens_milli = refill >= full - c->tokens_milli ? full : c->tokens_milli + (uint32_t)refill;
+    }
+    c->last_us = now;
+
+    bool allow = c->tokens_milli >= 1000;
+    if (allow) {
+        c->tokens_milli -= 1000;
+        c->stats.queries++;
+    } else {
+        c->stats.rate_limited++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    return allow;
+}
+
+/**
+ * @brief Count a queried name with the space-saving algorithm
+ *
+ * An untracked name replaces the least counted one and inherits its count,
+ * so names queried often always surface within DNS_TOP_NAMES slots.
+ */
+static void count_name(const dns_question_t *q) {
+    char key[DNS_CACHE_NAME_LEN];
+    strlcpy(key, q->name, sizeof(key));
+
+    portENTER_CRITICAL(&stats_lock);
+    dns_name_stats_t *least = &top_names[0];
+    for (int i = 0; i < DNS_TOP_NAMES; i++) {
+        if (top_names[i].count != 0 && strcmp(top_names[i].name, key) == 0) {
+            top_names[i].count++;
+            portEXIT_CRITICAL(&stats_lock);
+            return;
+        }
+        if (top_names[i].count < least->count) {
+            least = &top_names[i];
+        }
+    }
+    memcpy(least->name, key, sizeof(key));
+    least->error = least->count;
+    least->count++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief Close the query-rate window once DNS_QPS_WINDOW_MS has passed
+ */
+static void update_qps(int64_t now) {
+    int64_t elapsed = now - qps_window_start_us;
+    if (elapsed >= DNS_QPS_WINDOW_MS * 1000LL) {
+        dns_stats.qps = qps_window_queries * 1e6f / elapsed;
+        qps_window_start_us = now;
+        qps_window_queries = 0;
+    }
+}
+
+/**
+ * @brief METRIC_DNS_QUERIES: query rate, totals and drops
+ */
+static metric_error_t queries_provider(char *buf, size_t buf_len) {
+    dns_server_stats_t s = dns_stats;
+    snprintf(buf, buf_len, "%.1f qps, %lu queries, %lu rate limited, %lu dropped", s.qps,
+             (unsigned long)s.queries, (unsigned long)s.rate_limited,
+             (unsigned long)(s.dropped + s.send_failures));
+    return METRIC_OK;
+}
+
+/**
+ * @brief METRIC_DNS_TOP_NAMES: most queried names with their counts, as many as fit
+ */
+static metric_error_t top_names_provider(char *buf, size_t buf_len) {
+    dns_name_stats_t names[DNS_TOP_NAMES];
+    size_t n = dns_server_get_top_names(names, DNS_TOP_NAMES);
+    if (n == 0) {
+        snprintf(buf, buf_len, "No queries yet");
+        return METRIC_OK;
+    }
+
+    size_t pos = 0;
+    buf[0] = '\0';
+    for (size_t i = 0; i < n; i++) {
+        char entry[DNS_CACHE_NAME_LEN + 16];
+        int len = snprintf(entry, sizeof(entry), "%s%s %lu", i ? ", " : "", names[i].name,
+                           (unsigned long)names[i].count);
+        if (pos + len >= buf_len) {
+            break;                              // Whole entries only
+        }
+        memcpy(buf + pos, entry, len + 1);
+        pos += len;
+    }
+    return METRIC_OK;
+}
+
+static bool is_local_name(const dns_question_t *q) {
+    for (size_t i = 0; i < sizeof(local_names) / sizeof(local_names[0]); i++) {
+        if (strcmp(q->name, local_names[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Decide how to answer the query in pkt
+ *
+ * @param q Receives the question when there is one
+ * @param end Receives the length of the header and question to keep in the reply
+ */
+static dns_reply_t classify(const uint8_t *pkt, int len, dns_question_t *q, int *end) {
+    uint16_t flags = (pkt[2] << 8) | pkt[3];
+    uint16_t qdcount = (pkt[4] << 8) | pkt[5];
+
+    *end = DNS_HEADER_SIZE;
+    if (DNS_OPCODE(flags) != 0) {
+        return DNS_REPLY_NOTIMP;
+    }
+    if (qdcount != 1 || !dns_packet_parse_question(pkt, len, q)) {
+        return DNS_REPLY_FORMERR;
+    }
+    *end = q->end;
+
+    if (q->qclass != DNS_CLASS_IN && q->qclass != DNS_CLASS_ANY) {
+        return DNS_REPLY_NOTIMP;
+    }
+    if (active_mode == DNS_MODE_FORWARD && !is_local_name(q)) {
+        return DNS_REPLY_FORWARD;
+    }
+
+    const char *arpa = ".arpa";
+    size_t arpa_len = strlen(arpa);
+    if (q->name_len >= arpa_len && strcmp(q->name + q->name_len - arpa_len, arpa) == 0) {
+        return DNS_REPLY_NXDOMAIN;
+    }
+    if (q->qtype == DNS_TYPE_A || q->qtype == DNS_TYPE_ANY) {
+        return DNS_REPLY_A;
+    }
+    return DNS_REPLY_NODATA;
+}
+
+/**
+ * @brief Overwrite the query in pkt with a templated reply
+ *
+ * The question is echoed exactly as received (clients that randomise the
+ * case of the name check it), everything after it is dropped, and the
+ * template for the outcome is appended.
+ *
+ * @return Reply length
+ */
+static int write_reply(uint8_t *pkt, int end, bool have_question, dns_reply_t reply, uint16_t query_flags) {
+    const dns_template_t *t = &templates[reply];
+    uint16_t out_flags = t->flags | (query_flags & DNS_FLAG_RD);
+    pkt[2] = out_flags >> 8;
+    pkt[3] = out_flags & 0xFF;
+    pkt[4] = 0;
+    pkt[5] = have_question ? 1 : 0;
+    pkt[6] = 0;
+    pkt[7] = t->ancount;
+    memset(&pkt[8], 0, 4);                      // No authority or additional records (EDNS OPT dropped)
+    memcpy(&pkt[end], t->answer, t->answer_len);
+
+    switch (reply) {
+        case DNS_REPLY_A:        dns_stats.answered++; break;
+        case DNS_REPLY_NODATA:   dns_stats.nodata++;   break;
+        case DNS_REPLY_NXDOMAIN: dns_stats.nxdomain++; break;
+        default:                 dns_stats.errors++;   break;
+    }
+    return end + t->answer_len;
+}
+
+/**
+ * @brief Unexpired cached reply for a question, or NULL
+ */
+static dns_cache_entry_t *cache_find(const dns_question_t *q, bool edns, int64_t now) {
+    for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+        dns_cache_entry_t *e = &cache[i];
+        if (e->expires_us > now && e->qtype == q->qtype && e->edns == edns && strcmp(e->name, q->name) == 0) {
+            e->used_us = now;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Cache a successful or negative upstream reply for its lowest TTL
+ *
+ * Replaces a free or expired slot, else the least recently used one.
+ */
+static void cache_store(const dns_pending_t *p, const uint8_t *pkt, int len, int64_t now) {
+    uint16_t flags = (pkt[2] << 8) | pkt[3];
+    uint8_t rcode = DNS_RCODE(flags);
+    if (p->name[0] == '\0' || len > DNS_CACHE_MAX_RESPONSE || (flags & DNS_FLAG_TC) ||
+        (rcode != DNS_RCODE_NOERROR && rcode != DNS_RCODE_NXDOMAIN)) {
+        return;
+    }
+
+    dns_cache_entry_t *slot = &cache[0];
+    for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+        if (cache[i].expires_us <= now) {
+            slot = &cache[i];
+            break;
+        }
+        if (cache[i].used_us < slot->used_us) {
+            slot = &cache[i];
+        }
+    }
+
+    memcpy(slot->response, pkt, len);
+    dns_record_ctx_t ctx = { 0 };
+    if (!dns_packet_adjust_records(slot->response, len, &ctx)) {
+        slot->expires_us = 0;
+        return;
+    }
+    // No records at all (bare NODATA/NXDOMAIN) falls back to the negative TTL
+    uint32_t ttl = ctx.min_ttl == UINT32_MAX ? DNS_CACHE_NEGATIVE_TTL_S : ctx.min_ttl;
+    if (ttl > DNS_CACHE_MAX_TTL_S) {
+        ttl = DNS_CACHE_MAX_TTL_S;
+    }
+    if (ttl == 0) {
+        slot->expires_us = 0;
+        return;
+    }
+
+    strlcpy(slot->name, p->name, sizeof(slot->name));
+    slot->qtype = p->qtype;
+    slot->edns = p->edns;
+    slot->len = len;
+    slot->stored_us = now;
+    slot->used_us = now;
+    slot->expires_us = now + (int64_t)ttl * 1000000;
+}
+
+/**
+ * @brief Switch to the mode requested by dns_server_set_mode()
+ *
+ * Runs on the server task, so the forwarding state needs no lock.
+ */
+static void apply_mode(void) {
+    portENTER_CRITICAL(&mode_lock);
+    dns_server_mode_t mode = requested_mode;
+    uint32_t upstream = requested_upstream;
+    mode_changed = false;
+    portEXIT_CRITICAL(&mode_lock);
+
+    if (upstream_socket != -1) {
+        close(upstream_socket);
+        upstream_socket = -1;
+    }
+    memset(pending, 0, sizeof(pending));
+    memset(cache, 0, sizeof(cache));
+    active_mode = DNS_MODE_HIJACK;
+
+    if (mode != DNS_MODE_FORWARD) {
+        ESP_LOGI(TAG, "Hijack mode: every name resolves to the portal");
+        return;
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(DNS_SERVER_PORT),
+        .sin_addr.s_addr = upstream,
+    };
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "Unable to reach upstream resolver: errno %d, staying in hijack mode", errno);
+        if (sock >= 0) {
+            close(sock);
+        }
+        return;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+    upstream_socket = sock;
+    active_mode = DNS_MODE_FORWARD;
+    const uint8_t *a = (const uint8_t *)&upstream;
+    ESP_LOGI(TAG, "Forward mode: upstream %u.%u.%u.%u", a[0], a[1], a[2], a[3]);
+}
 
+/**
+ * @brief Send a query upstream under a fresh ID and remember who asked
+ */
+static void forward_query(uint8_t *pkt, int len, const dns_question_t *q, const struct sockaddr_in *client) {
+    dns_pending_t *slot = NULL;
+    for (int i = 0; i < DNS_FORWARD_MAX_PENDING; i++) {
+        if (!pending[i].used) {
+            slot = &pending[i];
+            break;
+        }
+    }
+    if (slot == NULL) {
+        uint16_t flags = (pkt[2] << 8) | pkt[3];
+        int reply_len = write_reply(pkt, q->end, true, DNS_REPLY_SERVFAIL, flags);
+        sendto(dns_socket, pkt, reply_len, 0, (const struct sockaddr *)client, sizeof(*client));
+        return;
+    }
+
+    // A random ID per upstream query, unique among those in flight, so replies cannot be confused or spoofed by guessing
+    uint16_t id;
+    bool clash;
+    do {
+        id = (uint16_t)esp_random();
+        clash = false;
+        for (int i = 0; i < DNS_FORWARD_MAX_PENDING; i++) {
+            clash |= pending[i].used && pending[i].upstream_id == id;
+        }
+    } while (clash);
+
+    slot->client_id = (pkt[0] << 8) | pkt[1];
+    slot->upstream_id = id;
+    slot->client = *client;
+    slot->qtype = q->qtype;
+    slot->edns = ((pkt[10] << 8) | pkt[11]) != 0;
+    if (q->name_len < sizeof(slot->name)) {
+        memcpy(slot->name, q->name, q->name_len + 1);
+    } else {
+        slot->name[0] = '\0';
+    }
+
+    // Keep the upstream reply within our receive buffer
+    dns_record_ctx_t ctx = { .max_payload = DNS_FORWARD_MAX_PACKET };
+    dns_packet_adjust_records(pkt, len, &ctx);
+
+    pkt[0] = id >> 8;
+    pkt[1] = id & 0xFF;
+    if (send(upstream_socket, pkt, len, 0) < 0) {
+        dns_stats.send_failures++;
+        ESP_LOGD(TAG, "Error forwarding DNS query: errno %d", errno);
+        return;
+    }
+    slot->sent_us = esp_timer_get_time();
+    slot->used = true;
+    dns_stats.forwarded++;
+}
+
+/**
+ * @brief Answer one datagram from a client
+ */
+static void handle_query(uint8_t *pkt, int len, const struct sockaddr_in *client) {
+    int64_t now = esp_timer_get_time();
+    if (!rate_limit_allow(client, now)) {
+        dns_stats.rate_limited++;
+        return;                                 // Silently: answering would cost as much as the query
+    }
+    if (len < DNS_HEADER_SIZE) {
+        dns_stats.dropped++;
+        return;                                 // Not even an ID to answer
+    }
+    uint16_t flags = (pkt[2] << 8) | pkt[3];
+    if (flags & DNS_FLAG_QR) {
+        dns_stats.dropped++;
+        return;                                 // A response; never answer those
+    }
+    dns_stats.queries++;
+    qps_window_queries++;
+
+    dns_question_t q;
+    int end;
+    dns_reply_t reply = classify(pkt, len, &q, &end);
+    int reply_len;
+    if (end > DNS_HEADER_SIZE) {
+        count_name(&q);
+    }
+
+    if (reply == DNS_REPLY_FORWARD) {
+        bool edns = ((pkt[10] << 8) | pkt[11]) != 0;
+        dns_cache_entry_t *hit = cache_find(&q, edns, now);
+        if (hit == NULL) {
+            forward_query(pkt, len, &q, client);
+            return;
+        }
+
+        // Cached header and answers behind the client's own ID and question bytes
+        uint8_t id[2] = { pkt[0], pkt[1] };
+        memcpy(pkt, hit->response, DNS_HEADER_SIZE);
+        memcpy(pkt, id, sizeof(id));
+        memcpy(&pkt[q.end], &hit->response[q.end], hit->len - q.end);
+        reply_len = hit->len;
+
+        dns_record_ctx_t ctx = { .elapsed_s = (uint32_t)((now - hit->stored_us) / 1000000) };
+        dns_packet_adjust_records(pkt, reply_len, &ctx);
+        dns_stats.cache_hits++;
+    } else {
+        reply_len = write_reply(pkt, end, end > DNS_HEADER_SIZE, reply, flags);
+    }
+
+    if (sendto(dns_socket, pkt, reply_len, 0, (const struct sockaddr *)client, sizeof(*client)) < 0) {
+        dns_stats.send_failures++;
+        ESP_LOGD(TAG, "Error sending DNS response: errno %d", errno);
+    }
+}
+
+/**
+ * @brief Relay one reply from the upstream resolver back to the client that asked
+ */
+static void handle_upstream_reply(int len) {
+    if (len < DNS_HEADER_SIZE || !(upstream_packet[2] & (DNS_FLAG_QR >> 8))) {
+        dns_stats.dropped++;
+        return;
+    }
+
+    uint16_t id = (upstream_packet[0] << 8) | upstream_packet[1];
+    dns_pending_t *p = NULL;
+    for (int i = 0; i < DNS_FORWARD_MAX_PENDING; i++) {
+        if (pending[i].used && pending[i].upstream_id == id) {
+            p = &pending[i];
+            break;
+        }
+    }
+
+    // The question must match too, not just the 16-bit ID
+    dns_question_t q;
+    if (p == NULL || !dns_packet_parse_question(upstream_packet, len, &q) || q.qtype != p->qtype ||
+        (p->name[0] != '\0' && strcmp(q.name, p->name) != 0)) {
+        dns_stats.dropped++;
+        return;
+    }
+    p->used = false;
+
+    cache_store(p, upstream_packet, len, esp_timer_get_time());
+
+    upstream_packet[0] = p->client_id >> 8;
+    upstream_packet[1] = p->client_id & 0xFF;
+    if (sendto(dns_socket, upstream_packet, len, 0, (const struct sockaddr *)&p->client, sizeof(p->client)) < 0) {
+        dns_stats.send_failures++;
+        ESP_LOGD(TAG, "Error relaying DNS response: errno %d", errno);
+    }
+}
+
+/**
+ * @brief Give up on upstream queries unanswered for DNS_FORWARD_TIMEOUT_MS; the client retries
+ */
+static void expire_pending(int64_t now) {
+    for (int i = 0; i < DNS_FORWARD_MAX_PENDING; i++) {
+        if (pending[i].used && now - pending[i].sent_us > DNS_FORWARD_TIMEOUT_MS * 1000LL) {
+            pending[i].used = false;
+            dns_stats.upstream_timeouts++;
+        }
+    }
+}
+
+/**
+ * @brief Create the non-blocking UDP socket bound to port 53
+ *
+ * @return Socket, or -1 with the error logged
+ */
+static int open_socket(void) {
     struct sockaddr_in dest_addr;
     dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
     dest_addr.sin_family = AF_INET;
     dest_addr.sin_port = htons(DNS_SERVER_PORT);
 
     // Create socket
-    dns_socket = socket(addr_family, SOCK_DGRAM, ip_protocol);
-    if (dns_socket < 0) {
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
         ESP_LOGE(TAG, "Unable to create DNS socket: errno %d", errno);
-        dns_running = false;
-        vTaskDelete(NULL);
-        return;
+        return -1;
     }
-    ESP_LOGI(TAG, "DNS socket created successfully");
 
     // Bind socket
-    int err = bind(dns_socket, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-    if (err < 0) {
+    if (bind(sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr)) < 0) {
         ESP_LOGE(TAG, "Socket unable to bind: errno %d", errno);
-        close(dns_socket);
-        dns_socket = -1;
-        dns_running = false;
-        vTaskDelete(NULL);
-        return;
+        close(sock);
+        return -1;
     }
+
+    // Non-blocking, so each wake-up drains every queued query and then waits in select()
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
     ESP_LOGI(TAG, "DNS server socket bound to port %d", DNS_SERVER_PORT);
+    return sock;
+}
 
-    dns_running = true;
+/**
+ * @brief End the task's select() wait at once with an empty datagram to port 53
+ */
+static void wake_task(void) {
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        return;                                 // The select() timeout still ends the wait
+    }
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(DNS_SERVER_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    sendto(sock, "", 0, 0, (struct sockaddr *)&addr, sizeof(addr));
+    close(sock);
+}
+
+/**
+ * @brief Wait for the task to finish its cleanup, then delete it
+ *
+ * The task parks after setting DNS_EVT_EXITED instead of deleting itself:
+ * a self-deleted task is reclaimed later by the idle task, and until then
+ * its static TCB and stack must not be reused. Deleting a blocked task from
+ * here is immediate, so the buffers are free when this returns ESP_OK.
+ */
+static esp_err_t join_task(uint32_t timeout_ms) {
+    EventBits_t bits = xEventGroupWaitBits(dns_events, DNS_EVT_EXITED, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(timeout_ms));
+    if (!(bits & DNS_EVT_EXITED)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    vTaskDelete(dns_task_handle);
+    dns_task_handle = NULL;
+    return ESP_OK;
+}
+
+static void dns_server_task(void *pvParameters) {
+    // Room for the answer after the longest question we accept
+    uint8_t packet[DNS_MAX_PACKET_SIZE + 16];
+
+    dns_socket = open_socket();
+    if (dns_socket >= 0) {
+        xEventGroupSetBits(dns_events, DNS_EVT_SERVING);
+    }
+
+    while (dns_socket >= 0 && (xEventGroupGetBits(dns_events) & DNS_EVT_RUN)) {
+        if (mode_changed) {
+            apply_mode();
+        }
+        int64_t now = esp_timer_get_time();
+        update_qps(now);
+        if (active_mode == DNS_MODE_FORWARD) {
+            expire_pending(now);
+        }
 
-    while (dns_running) {
-        struct sockaddr_storage source_addr;
-        socklen_t socklen = sizeof(source_addr);
-        
-        int len = recvfrom(dns_socket, rx_buffer, sizeof(rx_buffer) - 1, 0,
-                          (struct sockaddr *)&source_addr, &socklen);
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        FD_SET(dns_socket, &read_fds);
+        int max_fd = dns_socket;
+        if (upstream_socket != -1) {
+            FD_SET(upstream_socket, &read_fds);
+            max_fd = upstream_socket > max_fd ? upstream_socket : max_fd;
+        }
+        struct timeval timeout = {
+            .tv_sec = 0,
+            .tv_usec = DNS_SELECT_TIMEOUT_MS * 1000,
+        };
 
-        if (len < 0) {
-            if (dns_running) {  // Only log error if we're still supposed to be running
-                ESP_LOGE(TAG, "DNS recvfrom failed: errno %d", errno);
+        int ready = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
             }
+            ESP_LOGE(TAG, "DNS select failed: errno %d", errno);
             break;
         }
+        if (ready == 0) {
+            continue;                           // Timeout: re-check the run bit and the mode
+        }
+
+        if (upstream_socket != -1 && FD_ISSET(upstream_socket, &read_fds)) {
+            int len;
+            while ((len = recv(upstream_socket, upstream_packet, sizeof(upstream_packet), 0)) >= 0) {
+                PIPELINE_TRACE_BEGIN(PIPELINE_TRACE_DNS_REPLY);
+                handle_upstream_reply(len);
+                PIPELINE_TRACE_END(PIPELINE_TRACE_DNS_REPLY);
+            }
+        }
 
-        // Get sender's IP address
-        if (source_addr.ss_family == PF_INET) {
-            inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, 
-                       addr_str, sizeof(addr_str) - 1);
-        }
-
-        ESP_LOGD(TAG, "DNS query received from %s, length: %d", addr_str, len);
-
-        // Create DNS response - redirect all queries to our IP
-        if (len >= 12) {  // Minimum DNS header size
-            uint8_t response[DNS_MAX_PACKET_SIZE];
-            memcpy(response, rx_buffer, len);  // Copy query
-
-            // Set response flags
-            response[2] = 0x81;  // Response, no error
-            response[3] = 0x80;  // Recursive available
-
-            // Answer count = 1
-            response[6] = 0x00;
-            response[7] = 0x01;
-
-            // Add answer (A record pointing to our IP: 192.168.4.1)
-            int pos = len;
-            response[pos++] = 0xC0;  // Pointer to domain name
-            response[pos++] = 0x0C;
-            response[pos++] = 0x00;  // Type A
-            response[pos++] = 0x01;
-            response[pos++] = 0x00;  // Class IN
-            response[pos++] = 0x01;
-            response[pos++] = 0x00;  // TTL (60 seconds)
-            response[pos++] = 0x00;
-            response[pos++] = 0x00;
-            response[pos++] = 0x3C;
-            response[pos++] = 0x00;  // Data length
-            response[pos++] = 0x04;
-            response[pos++] = 192;   // IP: 192.168.4.1
-            response[pos++] = 168;
-            response[pos++] = 4;
-            response[pos++] = 1;
-
-            // Send response
-            int send_err = sendto(dns_socket, response, pos, 0,
-                                 (struct sockaddr *)&source_addr, sizeof(source_addr));
-            if (send_err < 0) {
-                ESP_LOGE(TAG, "Error sending DNS response: errno %d", errno);
-            } else {
-                ESP_LOGD(TAG, "DNS response sent successfully to %s", addr_str);
+        if (FD_ISSET(dns_socket, &read_fds)) {
+            for (;;) {
+                struct sockaddr_in source_addr;
+                socklen_t socklen = sizeof(source_addr);
+                int len = recvfrom(dns_socket, packet, DNS_MAX_PACKET_SIZE, 0,
+                                   (struct sockaddr *)&source_addr, &socklen);
+                if (len < 0) {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                        ESP_LOGE(TAG, "DNS recvfrom failed: errno %d", errno);
+                    }
+                    break;
+                }
+                if (len == 0) {
+                    continue;                   // Nothing to answer; dns_server_stop() sends these to wake us
+                }
+                PIPELINE_TRACE_BEGIN(PIPELINE_TRACE_DNS_REPLY);
+                handle_query(packet, len, &source_addr);
+                PIPELINE_TRACE_END(PIPELINE_TRACE_DNS_REPLY);
             }
         }
     }
 
     // Clean up
+    if (upstream_socket != -1) {
+        close(upstream_socket);
+        upstream_socket = -1;
+    }
+    active_mode = DNS_MODE_HIJACK;
     if (dns_socket != -1) {
         ESP_LOGI(TAG, "Shutting down DNS server socket");
         shutdown(dns_socket, 0);
         close(dns_socket);
         dns_socket = -1;
     }
-    
-    dns_running = false;
-    dns_task_handle = NULL;
-    vTaskDelete(NULL);
+
+    xEventGroupClearBits(dns_events, DNS_EVT_SERVING);
+    xEventGroupSetBits(dns_events, DNS_EVT_EXITED);
+    for (;;) {
+        vTaskSuspend(NULL);                     // Until join_task() deletes us
+    }
 }
 
 esp_err_t dns_server_start(void) {
-    if (dns_running) {
-        ESP_LOGW(TAG, "DNS server is already running");
-        return ESP_OK;
+    if (dns_events == NULL) {
+        dns_events = xEventGroupCreateStatic(&dns_events_buf);
+    }
+    if (dns_task_handle != NULL) {
+        if (xEventGroupGetBits(dns_events) & DNS_EVT_SERVING) {
+            ESP_LOGW(TAG, "DNS server is already running");
+            return ESP_OK;
+        }
+        // The task gave up on its own (select failure); reap it before reusing its buffers
+        xEventGroupClearBits(dns_events, DNS_EVT_RUN);
+        if (join_task(DNS_STOP_TIMEOUT_MS) != ESP_OK) {
+            ESP_LOGE(TAG, "Previous DNS server task has not exited");
+            return ESP_ERR_INVALID_STATE;
+        }
     }
 
     ESP_LOGI(TAG, "Starting DNS server task...");
-    
-    BaseType_t result = xTaskCreate(dns_server_task, "dns_server", 
-                                   DNS_TASK_STACK_SIZE, NULL, 
-                                   DNS_TASK_PRIORITY, &dns_task_handle);
-    
-    if (result != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create DNS server task");
+    build_templates();
+    memset(&dns_stats, 0, sizeof(dns_stats));
+    memset(clients, 0, sizeof(clients));
+    memset(top_names, 0, sizeof(top_names));
+    qps_window_start_us = esp_timer_get_time();
+    qps_window_queries = 0;
+    set_metric_provider(METRIC_DNS_QUERIES, queries_provider);
+    set_metric_provider(METRIC_DNS_TOP_NAMES, top_names_provider);
+
+    // The task starts in the last requested mode
+    portENTER_CRITICAL(&mode_lock);
+    mode_changed = requested_mode != DNS_MODE_HIJACK;
+    portEXIT_CRITICAL(&mode_lock);
+
+    xEventGroupClearBits(dns_events, DNS_EVT_SERVING | DNS_EVT_EXITED);
+    xEventGroupSetBits(dns_events, DNS_EVT_RUN);
+    dns_task_handle = xTaskCreateStaticPinnedToCore(dns_server_task, DNS_TASK_NAME, DNS_TASK_STACK_SIZE, NULL,
+                                                    DNS_TASK_PRIORITY, dns_task_stack, &dns_task_tcb, TASK_CORE_NET);
+
+    // Return only once the socket is bound, or the task has given up
+    EventBits_t bits = xEventGroupWaitBits(dns_events, DNS_EVT_SERVING | DNS_EVT_EXITED, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(DNS_START_TIMEOUT_MS));
+    if (!(bits & DNS_EVT_SERVING)) {
+        ESP_LOGE(TAG, "DNS server task failed to start");
+        xEventGroupClearBits(dns_events, DNS_EVT_RUN);
+        join_task(DNS_STOP_TIMEOUT_MS);
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "DNS server task created successfully");
+    ESP_LOGI(TAG, "DNS server task started");
     return ESP_OK;
 }
 
 esp_err_t dns_server_stop(void) {
-    if (!dns_running) {
+    if (dns_task_handle == NULL) {
         ESP_LOGW(TAG, "DNS server is not running");
         return ESP_OK;
     }
 
     ESP_LOGI(TAG, "Stopping DNS server...");
-    
-    dns_running = false;
-
-    // Close socket to break out of recvfrom
-    if (dns_socket != -1) {
-        shutdown(dns_socket, SHUT_RDWR);
-        close(dns_socket);
-        dns_socket = -1;
-    }
 
-    // Wait for task to complete
-    if (dns_task_handle != NULL) {
-        // Give task some time to clean up
-        vTaskDelay(pdMS_TO_TICKS(100));
-        
-        // If task is still running, delete it
-        if (dns_task_handle != NULL) {
-            vTaskDelete(dns_task_handle);
-            dns_task_handle = NULL;
-        }
+    // The task closes its own sockets; the wake-up spares waiting out a select() timeout
+    xEventGroupClearBits(dns_events, DNS_EVT_RUN);
+    wake_task();
+    if (join_task(DNS_STOP_TIMEOUT_MS) != ESP_OK) {
+        ESP_LOGW(TAG, "DNS server task did not exit in time");
+        return ESP_ERR_TIMEOUT;
     }
 
     ESP_LOGI(TAG, "DNS server stopped successfully");
@@ -210,5 +904,70 @@ esp_err_t dns_server_stop(void) {
 }
 
 bool dns_server_is_running(void) {
-    return dns_running;
-}
\ No newline at end of file
+    return dns_events != NULL && (xEventGroupGetBits(dns_events) & DNS_EVT_SERVING);
+}
+
+esp_err_t dns_server_set_mode(dns_server_mode_t mode, const char *upstream) {
+    struct in_addr addr = { 0 };
+    if (mode == DNS_MODE_FORWARD && (upstream == NULL || inet_aton(upstream, &addr) == 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&mode_lock);
+    requested_mode = mode;
+    requested_upstream = addr.s_addr;
+    mode_changed = true;
+    portEXIT_CRITICAL(&mode_lock);
+    return ESP_OK;
+}
+
+dns_server_mode_t dns_server_get_mode(void) {
+    return active_mode;
+}
+
+void dns_server_get_stats(dns_server_stats_t *stats) {
+    *stats = dns_stats;
+}
+
+size_t dns_server_get_clients(dns_client_stats_t *out, size_t max) {
+    size_t n = 0;
+    portENTER_CRITICAL(&stats_lock);
+    for (int i = 0; i < DNS_MAX_CLIENTS && n < max; i++) {
+        if (clients[i].last_us != 0) {
+            out[n++] = clients[i].stats;
+        }
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    // Busiest first; insertion sort, at most DNS_MAX_CLIENTS entries
+    for (size_t i = 1; i < n; i++) {
+        dns_client_stats_t c = out[i];
+        size_t j = i;
+        for (; j > 0 && out[j - 1].queries + out[j - 1].rate_limited < c.queries + c.rate_limited; j--) {
+            out[j] = out[j - 1];
+        }
+        out[j] = c;
+    }
+    return n;
+}
+
+size_t dns_server_get_top_names(dns_name_stats_t *out, size_t max) {
+    size_t n = 0;
+    portENTER_CRITICAL(&stats_lock);
+    for (int i = 0; i < DNS_TOP_NAMES && n < max; i++) {
+        if (top_names[i].count != 0) {
+            out[n++] = top_names[i];
+        }
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    for (size_t i = 1; i < n; i++) {
+        dns_name_stats_t e = out[i];
+        size_t j = i;
+        for (; j > 0 && out[j - 1].count < e.count; j--) {
+            out[j] = out[j - 1];
+        }
+        out[j] = e;
+    }
+    return n;
+}
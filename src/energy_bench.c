@@ -0,0 +1,271 @@
+/**
+ * @file energy_bench.c
+ * @brief Energy-per-sample benchmark: awake time, radio time, bytes sent and integrated charge
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "energy_bench.h"
+#include "version.h"
+#include "i2c_bus.h"
+#include "ina219.h"
+#include "net_stats.h"
+#include "power_profile.h"
+#include "SystemMetrics.h"
+#include <stdio.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register energy_bench.c version
+REGISTER_VERSION(EnergyBench, "1.0.0", "2026-10-15");
+
+static const char *TAG = "BENCH";
+
+#define UAUS_PER_NAH 3600000ULL                 // 1 nAh = 3.6 uA for 1 s
+
+static ina219_t ina219;
+static i2c_bus_device_handle_t ina219_dev = NULL;
+static bool metered = false;
+static TaskHandle_t meter_task_handle = NULL;
+static SemaphoreHandle_t stopped_sem = NULL;
+static portMUX_TYPE bench_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Meter, written by the meter task
+static uint64_t charge_uaus = 0;                // uA x us since init
+static int32_t last_ua = 0;
+static uint32_t peak_ua = 0;                    // Since energy_bench_begin()
+
+/**
+ * @brief Counter readings at the start of the run, and at its end once it stopped
+ */
+typedef struct {
+    int64_t time_us;
+    uint64_t charge_uaus;
+    uint64_t light_sleep_us;
+    uint64_t bytes_sent;
+} bench_mark_t;
+
+static bool running = false;
+static bench_mark_t begin_mark;
+static bench_mark_t end_mark;
+static uint32_t cycles = 0;
+static uint32_t samples = 0;
+static uint64_t radio_us = 0;
+
+// =============================
+// Function Prototypes
+// =============================
+static void meter_task(void *arg);
+static void take_mark(bench_mark_t *mark);
+static metric_error_t current_provider(char *buf, size_t buf_len);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Read the INA219 once per averaging period and integrate the mean over the time since the last read
+ */
+static void meter_task(void *arg) {
+    TickType_t period = pdMS_TO_TICKS(ina219_conversion_us(&ina219) / 1000);
+    int64_t last_us = esp_timer_get_time();
+
+    while (ulTaskNotifyTake(pdTRUE, period > 0 ? period : 1) == 0) {
+        int32_t ua;
+        if (ina219_read_current(&ina219, &ua) != ESP_OK) {
+            continue;                           // The next reading covers the gap
+        }
+        int64_t now_us = esp_timer_get_time();
+        if (ua < 0) {
+            ua = 0;                             // Offset noise around zero; the node never feeds the supply
+        }
+        portENTER_CRITICAL(&bench_lock);
+        charge_uaus += (uint64_t)ua * (uint64_t)(now_us - last_us);
+        last_ua = ua;
+        if ((uint32_t)ua > peak_ua) {
+            peak_ua = (uint32_t)ua;
+        }
+        portEXIT_CRITICAL(&bench_lock);
+        last_us = now_us;
+    }
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+static void take_mark(bench_mark_t *mark) {
+    power_sleep_stats_t ps;
+    power_profile_get_sleep_stats(&ps);
+    net_if_stats_t ns = { 0 };
+    net_stats_get(NET_STATS_IF_ESPNOW, &ns);
+
+    mark->time_us = esp_timer_get_time();
+    mark->light_sleep_us = ps.light_sleep_us;
+    mark->bytes_sent = ns.tx_bytes;
+    portENTER_CRITICAL(&bench_lock);
+    mark->charge_uaus = charge_uaus;
+    portEXIT_CRITICAL(&bench_lock);
+}
+
+static metric_error_t current_provider(char *buf, size_t buf_len) {
+    energy_bench_result_t r;
+    energy_bench_get(&r);
+    portENTER_CRITICAL(&bench_lock);
+    int32_t now_ua = last_ua;
+    portEXIT_CRITICAL(&bench_lock);
+
+    int n = snprintf(buf, buf_len, "%ld uA (avg %lu uA, peak %lu uA)", (long)now_ua, (unsigned long)r.avg_ua,
+                     (unsigned long)r.peak_ua);
+    if (r.samples > 0 && n > 0 && (size_t)n < buf_len) {
+        snprintf(buf + n, buf_len - n, ", %lu.%03lu uAh per sample%s", (unsigned long)(r.nah_per_sample / 1000),
+                 (unsigned long)(r.nah_per_sample % 1000), r.running ? " so far" : "");
+    }
+    return METRIC_OK;
+}
+
+esp_err_t energy_bench_init(void) {
+    if (metered) {
+        return ESP_OK;
+    }
+    esp_err_t err = i2c_bus_add_device("ina219", ENERGY_BENCH_INA219_ADDRESS, INA219_I2C_SPEED_HZ, &ina219_dev);
+    if (err != ESP_OK) {
+        return err;
+    }
+    ina219_config_t cfg = {
+        .transfer = i2c_bus_transfer,
+        .transfer_ctx = ina219_dev,
+        .address = ENERGY_BENCH_INA219_ADDRESS,
+        .shunt_mohm = ENERGY_BENCH_SHUNT_MOHM,
+        .range = ENERGY_BENCH_INA219_RANGE,
+        .avg = ENERGY_BENCH_INA219_AVG,
+    };
+    err = ina219_init(&ina219, &cfg);
+    if (err != ESP_OK) {
+        i2c_bus_remove_device(ina219_dev);
+        return err;
+    }
+
+    if (stopped_sem == NULL) {
+        stopped_sem = xSemaphoreCreateBinary();
+    }
+    if (stopped_sem == NULL ||
+        xTaskCreatePinnedToCore(meter_task, ENERGY_BENCH_TASK_NAME, ENERGY_BENCH_TASK_STACK_SIZE, NULL,
+                                ENERGY_BENCH_TASK_PRIORITY, &meter_task_handle, TASK_CORE_APP) != pdPASS) {
+        ina219_deinit(&ina219);
+        i2c_bus_remove_device(ina219_dev);
+        return ESP_ERR_NO_MEM;
+    }
+    metered = true;
+    set_metric_provider(METRIC_CURRENT_CONSUMPTION, current_provider);
+    ESP_LOGI(TAG, "INA219 at 0x%02x, %lu mohm shunt, reading every %lu ms", ENERGY_BENCH_INA219_ADDRESS,
+             (unsigned long)ENERGY_BENCH_SHUNT_MOHM, (unsigned long)(ina219_conversion_us(&ina219) / 1000));
+    return ESP_OK;
+}
+
+void energy_bench_begin(void) {
+    portENTER_CRITICAL(&bench_lock);
+    peak_ua = 0;
+    portEXIT_CRITICAL(&bench_lock);
+    cycles = 0;
+    samples = 0;
+    radio_us = 0;
+    take_mark(&begin_mark);
+    running = true;
+}
+
+void energy_bench_add(uint32_t cycle_samples, uint32_t cycle_radio_us) {
+    if (!running) {
+        return;
+    }
+    cycles++;
+    samples += cycle_samples;
+    radio_us += cycle_radio_us;
+}
+
+void energy_bench_end(void) {
+    if (running) {
+        take_mark(&end_mark);
+        running = false;
+    }
+}
+
+void energy_bench_get(energy_bench_result_t *result) {
+    bench_mark_t end;
+    if (running) {
+        take_mark(&end);
+    } else {
+        end = end_mark;
+    }
+
+    *result = (energy_bench_result_t){
+        .running = running,
+        .metered = metered,
+        .cycles = cycles,
+        .samples = samples,
+        .radio_ms = (uint32_t)(radio_us / 1000),
+    };
+    if (end.time_us <= begin_mark.time_us) {
+        return;                                 // Never started
+    }
+    uint64_t elapsed_us = (uint64_t)(end.time_us - begin_mark.time_us);
+    uint64_t slept_us = end.light_sleep_us - begin_mark.light_sleep_us;
+    result->elapsed_ms = (uint32_t)(elapsed_us / 1000);
+    result->awake_ms = slept_us < elapsed_us ? (uint32_t)((elapsed_us - slept_us) / 1000) : 0;
+    result->bytes_sent = end.bytes_sent - begin_mark.bytes_sent;
+    if (!metered) {
+        return;
+    }
+
+    uint64_t uaus = end.charge_uaus - begin_mark.charge_uaus;
+    result->charge_nah = uaus / UAUS_PER_NAH;
+    result->avg_ua = (uint32_t)(uaus / elapsed_us);
+    portENTER_CRITICAL(&bench_lock);
+    result->peak_ua = peak_ua;
+    portEXIT_CRITICAL(&bench_lock);
+    if (samples > 0) {
+        result->nah_per_sample = (uint32_t)(result->charge_nah / samples);
+    }
+}
+
+void energy_bench_log(void) {
+    energy_bench_result_t r;
+    energy_bench_get(&r);
+    ESP_LOGI(TAG, "Benchmark%s: %lu cycles, %lu samples in %lu ms; awake %lu ms, radio %lu ms, %llu bytes sent",
+             r.running ? " (running)" : "", (unsigned long)r.cycles, (unsigned long)r.samples,
+             (unsigned long)r.elapsed_ms, (unsigned long)r.awake_ms, (unsigned long)r.radio_ms,
+             (unsigned long long)r.bytes_sent);
+    if (!r.metered) {
+        ESP_LOGI(TAG, "Benchmark charge: not metered (no INA219 at 0x%02x)", ENERGY_BENCH_INA219_ADDRESS);
+        return;
+    }
+    ESP_LOGI(TAG, "Benchmark charge: %llu.%03llu uAh, avg %lu uA, peak %lu uA - %lu.%03lu uAh per sample",
+             (unsigned long long)(r.charge_nah / 1000), (unsigned long long)(r.charge_nah % 1000),
+             (unsigned long)r.avg_ua, (unsigned long)r.peak_ua, (unsigned long)(r.nah_per_sample / 1000),
+             (unsigned long)(r.nah_per_sample % 1000));
+}
+
+void energy_bench_deinit(void) {
+    if (!metered) {
+        return;
+    }
+    xTaskNotifyGive(meter_task_handle);
+    if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(ENERGY_BENCH_STOP_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Meter task did not stop within %d ms", ENERGY_BENCH_STOP_TIMEOUT_MS);
+        return;                                 // Still reading; leave the INA219 attached
+    }
+    meter_task_handle = NULL;
+    ina219_deinit(&ina219);
+    i2c_bus_remove_device(ina219_dev);
+    metered = false;
+    set_metric_provider(METRIC_CURRENT_CONSUMPTION, NULL);
+}
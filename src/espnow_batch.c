@@ -0,0 +1,324 @@
+/**
+ * @file espnow_batch.c
+ * @brief Adaptive aggregation of telemetry records into full-sized ESP-NOW frames
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "espnow_batch.h"
+#include "flash_backlog.h"
+#include "power_profile.h"
+#include "pipeline_trace.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register espnow_batch.c version
+REGISTER_VERSION(EspnowBatch, "1.0.0", "2026-10-15");
+
+static const char *TAG = "ESPNOW_BATCH";
+
+_Static_assert(ESPNOW_BATCH_MIN_RECORDS >= 1 && ESPNOW_BATCH_MIN_RECORDS <= ESPNOW_BATCH_LR_MAX_RECORDS,
+               "adaptive target range is empty");
+
+static const char *FLUSH_NAMES[ESPNOW_BATCH_FLUSH_COUNT] = { "size", "age", "priority", "break", "explicit" };
+
+static bool initialised = false;
+static uint32_t frame_node_id;
+static uint32_t max_age_us;
+static uint8_t frame[ESPNOW_RELIABLE_MAX_PAYLOAD];
+static size_t frame_cap = ESPNOW_RELIABLE_MAX_PAYLOAD; // ESPNOW_BATCH_LR_PAYLOAD in Long Range mode
+static uint8_t max_records = ESPNOW_BATCH_MAX_RECORDS;
+static telemetry_writer_t writer;
+static espnow_batch_frame_hook_t frame_hook = NULL;
+static int64_t oldest_us;                       // When the first waiting record was added
+static uint32_t rate_permille = 1000;           // Delivery rate EWMA; starts optimistic at the full frame
+static espnow_batch_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static void start_frame(void);
+static esp_err_t send_batch(espnow_batch_flush_t reason);
+static uint8_t spill_batch(void);
+static void update_rate(bool delivered);
+static void adapt_target(uint8_t retries, bool delivered);
+static metric_error_t batch_provider(char *buf, size_t buf_len);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Start an empty frame, headed by the node's current awake share and the hook's extensions
+ */
+static void start_frame(void) {
+    power_sleep_stats_t ps;
+    power_profile_get_sleep_stats(&ps);
+    telemetry_writer_init(&writer, frame, frame_cap, frame_node_id, 0);
+    telemetry_writer_set_power(&writer, ps.awake_bp, ps.wake_ms);
+    if (frame_hook != NULL) {
+        frame_hook(&writer);
+    }
+}
+
+/**
+ * @brief Hand the waiting frame to the reliable layer and start an empty one
+ *
+ * While the flash backlog holds unsent records the frame joins them rather
+ * than overtaking them, and a full reliable window pages it out too. A
+ * priority batch is the exception: it goes in the reliable layer's alarm
+ * lane, ahead of the backlog. Only a failed flash write loses the frame; a
+ * missing MAC ACK leaves it in the window to be resent.
+ */
+static esp_err_t send_batch(espnow_batch_flush_t reason) {
+    if (writer.count == 0) {
+        return ESP_OK;
+    }
+
+    uint8_t retries = 0;
+    esp_err_t err = ESP_ERR_NO_MEM;
+    bool urgent = reason == ESPNOW_BATCH_FLUSH_PRIORITY;
+    bool queued_behind = !urgent && flash_backlog_unsent() > 0;
+    if (urgent) {
+        err = espnow_reliable_send_urgent(writer.buf, writer.len, &retries);
+    } else if (!queued_behind) {
+        err = espnow_reliable_send(writer.buf, writer.len, &retries);
+    }
+    bool taken = err != ESP_ERR_NO_MEM && err != ESP_ERR_INVALID_STATE;
+    uint8_t spilled = taken ? 0 : spill_batch();
+    if (!queued_behind) {
+        for (uint8_t i = 0; i < retries; i++) {
+            update_rate(false);
+        }
+        if (taken) {
+            update_rate(err == ESP_OK);
+        }
+        adapt_target(retries, err == ESP_OK);
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    if (taken) {
+        stats.batches++;
+        stats.records += writer.count;
+        stats.bytes += writer.len;
+    } else {
+        stats.spilled += spilled;
+        if (spilled < writer.count) {
+            stats.failed++;
+            stats.records_lost += writer.count - spilled;
+        }
+    }
+    stats.retries += retries;
+    stats.flushes[reason]++;
+    stats.last_records = writer.count;
+    stats.last_bytes = (uint16_t)writer.len;
+    stats.last_retries = retries;
+    stats.last_reason = reason;
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (taken) {
+        ESP_LOGD(TAG, "Batch seq %lu: %u records, %u bytes, %u resends (%s), next target %u",
+                 (unsigned long)writer.base_seq, writer.count, (unsigned)writer.len, retries,
+                 FLUSH_NAMES[reason], stats.target);
+        err = ESP_OK;
+    } else if (spilled == writer.count) {
+        ESP_LOGD(TAG, "Batch seq %lu: %u records paged out to flash", (unsigned long)writer.base_seq,
+                 writer.count);
+        err = ESP_OK;
+    } else {
+        ESP_LOGW(TAG, "Batch seq %lu lost: %u of %u records (%s)", (unsigned long)writer.base_seq,
+                 writer.count - spilled, writer.count, esp_err_to_name(err));
+        err = ESP_ERR_NO_MEM;
+    }
+    start_frame();
+    return err;
+}
+
+/**
+ * @brief Page the waiting frame's records out to the flash backlog
+ *
+ * @return Records stored, counted from the first
+ */
+static uint8_t spill_batch(void) {
+    telemetry_header_t hdr;
+    if (telemetry_decode_header(writer.buf, writer.len, &hdr) != ESP_OK) {
+        return 0;
+    }
+    uint8_t stored = 0;
+    for (uint8_t i = 0; i < hdr.count; i++) {
+        telemetry_record_t rec;
+        if (telemetry_decode_record(writer.buf, &hdr, i, &rec) != ESP_OK || flash_backlog_push(hdr.node_id, &rec) != ESP_OK) {
+            break;
+        }
+        stored++;
+    }
+    return stored;
+}
+
+/**
+ * @brief Fold one send result into the delivery rate
+ */
+static void update_rate(bool delivered) {
+    uint32_t sample = delivered ? 1000 : 0;
+    rate_permille = (rate_permille * (ESPNOW_BATCH_RATE_WEIGHT - 1) + sample) / ESPNOW_BATCH_RATE_WEIGHT;
+}
+
+/**
+ * @brief Additive increase while the link is clean, multiplicative decrease when it is not
+ */
+static void adapt_target(uint8_t retries, bool delivered) {
+    uint32_t percent = rate_permille / 10;
+    uint8_t target = stats.target;
+    if (delivered && retries == 0 && percent >= ESPNOW_BATCH_GROW_PERCENT) {
+        target = target + ESPNOW_BATCH_GROW_STEP > max_records ? max_records : target + ESPNOW_BATCH_GROW_STEP;
+    } else if (percent < ESPNOW_BATCH_SHRINK_PERCENT) {
+        target = target / 2 < ESPNOW_BATCH_MIN_RECORDS ? ESPNOW_BATCH_MIN_RECORDS : target / 2;
+    }
+
+    if (target != stats.target) {
+        ESP_LOGI(TAG, "Delivery %lu%% - batch target %u -> %u records", (unsigned long)percent, stats.target,
+                 target);
+    }
+    portENTER_CRITICAL(&stats_lock);
+    stats.target = target;
+    stats.delivery_percent = (uint8_t)percent;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief METRIC_ESPNOW_BATCH: aggregation, delivery and the adaptive target
+ */
+static metric_error_t batch_provider(char *buf, size_t buf_len) {
+    espnow_batch_stats_t s;
+    espnow_batch_get_stats(&s);
+    uint32_t per_frame_x10 = s.batches ? s.records * 10 / s.batches : 0;
+    snprintf(buf, buf_len, "%lu batches, %lu.%lu records/frame (target %u), %u%% delivered, %lu resends, "
+             "%lu paged out, %lu lost; last %u records %u bytes (%s)", (unsigned long)s.batches,
+             (unsigned long)(per_frame_x10 / 10), (unsigned long)(per_frame_x10 % 10), s.target,
+             s.delivery_percent, (unsigned long)s.retries, (unsigned long)s.spilled,
+             (unsigned long)s.records_lost, s.last_records,
+             s.last_bytes, FLUSH_NAMES[s.last_reason]);
+    return METRIC_OK;
+}
+
+void espnow_batch_set_frame_hook(espnow_batch_frame_hook_t hook) {
+    frame_hook = hook;
+}
+
+esp_err_t espnow_batch_init(uint32_t node_id, uint32_t max_age_ms) {
+    if (max_age_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    frame_node_id = node_id;
+    max_age_us = max_age_ms * 1000;
+    rate_permille = 1000;
+    start_frame();
+
+    portENTER_CRITICAL(&stats_lock);
+    memset(&stats, 0, sizeof(stats));
+    stats.target = max_records;
+    stats.delivery_percent = 100;
+    stats.last_reason = ESPNOW_BATCH_FLUSH_SIZE;
+    portEXIT_CRITICAL(&stats_lock);
+
+    initialised = true;
+    set_metric_provider(METRIC_ESPNOW_BATCH, batch_provider);
+    ESP_LOGI(TAG, "Batching up to %u records per frame, at most %lu ms old", max_records,
+             (unsigned long)max_age_ms);
+    return ESP_OK;
+}
+
+void espnow_batch_set_long_range(bool lr) {
+    uint8_t records = lr ? ESPNOW_BATCH_LR_MAX_RECORDS : ESPNOW_BATCH_MAX_RECORDS;
+    if (records == max_records) {
+        return;
+    }
+    frame_cap = lr ? ESPNOW_BATCH_LR_PAYLOAD : ESPNOW_RELIABLE_MAX_PAYLOAD;
+    max_records = records;
+    portENTER_CRITICAL(&stats_lock);
+    if (stats.target > max_records || !lr) {
+        stats.target = max_records;             // Back in range a full frame is tried again at once
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    if (initialised && writer.count == 0) {
+        start_frame();
+    }
+    ESP_LOGI(TAG, "%s: up to %u records per frame", lr ? "Long Range" : "Normal range", max_records);
+}
+
+esp_err_t espnow_batch_add(const telemetry_record_t *rec, bool priority) {
+    if (!initialised) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (rec == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    PIPELINE_TRACE_BEGIN(PIPELINE_TRACE_ESPNOW_ENCODE);
+    esp_err_t err = telemetry_writer_add(&writer, rec);
+    PIPELINE_TRACE_END(PIPELINE_TRACE_ESPNOW_ENCODE);
+    if (err != ESP_OK) {
+        // Full, or not consecutive: what is waiting goes first, and this record starts the next frame
+        espnow_batch_flush_t reason = err == ESP_ERR_NO_MEM ? ESPNOW_BATCH_FLUSH_SIZE : ESPNOW_BATCH_FLUSH_BREAK;
+        err = send_batch(reason);
+        PIPELINE_TRACE_BEGIN(PIPELINE_TRACE_ESPNOW_ENCODE);
+        telemetry_writer_add(&writer, rec);
+        PIPELINE_TRACE_END(PIPELINE_TRACE_ESPNOW_ENCODE);
+    }
+    if (writer.count == 1) {
+        oldest_us = esp_timer_get_time();
+    }
+
+    if (priority) {
+        return send_batch(ESPNOW_BATCH_FLUSH_PRIORITY);
+    }
+    if (writer.count >= stats.target) {
+        return send_batch(ESPNOW_BATCH_FLUSH_SIZE);
+    }
+    return err;
+}
+
+uint32_t espnow_batch_poll(void) {
+    if (!initialised || writer.count == 0) {
+        return ESPNOW_BATCH_WAIT_FOREVER;
+    }
+
+    int64_t age_us = esp_timer_get_time() - oldest_us;
+    if (age_us >= (int64_t)max_age_us) {
+        send_batch(ESPNOW_BATCH_FLUSH_AGE);
+        return ESPNOW_BATCH_WAIT_FOREVER;
+    }
+    return (uint32_t)((max_age_us - age_us + 999) / 1000);
+}
+
+esp_err_t espnow_batch_flush(void) {
+    if (!initialised) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return send_batch(ESPNOW_BATCH_FLUSH_EXPLICIT);
+}
+
+void espnow_batch_get_stats(espnow_batch_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+const char *espnow_batch_flush_name(espnow_batch_flush_t reason) {
+    return reason < ESPNOW_BATCH_FLUSH_COUNT ? FLUSH_NAMES[reason] : "unknown";
+}
@@ -0,0 +1,492 @@
+/**
+ * @file espnow_channel.c
+ * @brief ESP-NOW channel choice on the gateway and announced channel switches to the nodes
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "espnow_channel.h"
+#include "espnow_link.h"
+#include "flash_io.h"
+#include "version.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_private/esp_clk.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register espnow_channel.c version
+REGISTER_VERSION(EspnowChannel, "1.0.0", "2026-10-15");
+
+static const char *TAG = "ESPNOW_CHANNEL";
+
+#define CHANNEL_NVS_NAMESPACE "espnow_chan"
+#define CHANNEL_NVS_KEY "channel"
+#define SCAN_MAX_APS 48                         // Records read back from a scan; the rest are not scored
+#define OVERLAP_SPAN 4                          // A 20 MHz channel reaches this many 5 MHz steps either side
+
+static const uint8_t broadcast_mac[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+/**
+ * @brief A node told, or owed, the pending switch; under lock
+ */
+typedef struct {
+    uint8_t mac[6];
+    bool used;
+    bool due;                                   // Announcement owed; sent from the poll
+    bool told;
+} told_entry_t;
+
+/**
+ * @brief A node's channel; RTC_DATA_ATTR, so it survives deep sleep
+ */
+typedef struct {
+    uint8_t channel;                            // 0 after a power-on
+    uint8_t next;                               // Announced channel, 0 if none
+    uint64_t switch_rtc_us;                     // RTC clock of the switch
+    uint8_t quiet_wakes;
+    uint32_t switches;
+    uint32_t lost_moves;
+} node_channel_t;
+
+// Gateway
+static bool serving = false;
+static bool follows = false;
+static uint8_t current = 0;
+static uint8_t next = 0;                        // lock
+static int64_t switch_us = 0;                   // esp_timer clock of the switch
+static int64_t last_beacon_us = 0;
+static told_entry_t nodes[ESPNOW_CHANNEL_NODES];
+static uint32_t switches = 0;
+static void (*wake_cb)(void) = NULL;
+
+// Node
+static RTC_DATA_ATTR node_channel_t rtc_channel;
+static uint8_t gateway[6];
+static bool node_ready = false;
+static bool heard = false;                      // Any frame from the gateway this wake
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static void put_u32(uint8_t *p, uint32_t v);
+static uint32_t get_u32(const uint8_t *p);
+static esp_err_t set_channel(uint8_t channel);
+static void store_channel(uint8_t channel);
+static uint8_t pick_channel(void);
+static void gateway_receive(const uint8_t *mac);
+static void node_receive(const uint8_t *data, size_t len);
+static void send_announce(const uint8_t *mac, uint8_t channel, uint32_t in_ms);
+static uint32_t switch_in_ms(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static esp_err_t set_channel(uint8_t channel) {
+    esp_err_t err = esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot move to channel %u: %s", channel, esp_err_to_name(err));
+    }
+    return err;
+}
+
+static void store_channel(uint8_t channel) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(CHANNEL_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        int64_t start = esp_timer_get_time();
+        err = nvs_set_u8(handle, CHANNEL_NVS_KEY, channel);
+        flash_io_record_nvs(CHANNEL_NVS_KEY, sizeof(channel), start, err);
+        if (err == ESP_OK) {
+            err = flash_io_nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Channel not saved: %s", esp_err_to_name(err));
+    }
+}
+
+/**
+ * @brief Scan every channel and score it by the APs that reach it
+ *
+ * An AP adds its signal above -100 dBm, weighted by how much of its
+ * channel overlaps: fully on its own, fading to nothing OVERLAP_SPAN
+ * channels away.
+ *
+ * @return uint8_t The quietest channel, or the current one if the scan failed or nothing beats it
+ */
+static uint8_t pick_channel(void) {
+    wifi_scan_config_t cfg = {
+        .show_hidden = true,
+        .scan_type = WIFI_SCAN_TYPE_PASSIVE,
+        .scan_time = { .passive = ESPNOW_CHANNEL_SCAN_MS },
+    };
+    esp_err_t err = esp_wifi_scan_start(&cfg, true);
+    set_channel(current);                       // The scan leaves the radio on the last channel it visited
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Channel scan failed: %s", esp_err_to_name(err));
+        return current;
+    }
+
+    uint16_t count = SCAN_MAX_APS;
+    wifi_ap_record_t *aps = malloc(SCAN_MAX_APS * sizeof(wifi_ap_record_t));
+    if (aps == NULL || esp_wifi_scan_get_ap_records(&count, aps) != ESP_OK) {
+        esp_wifi_clear_ap_list();
+        free(aps);
+        return current;
+    }
+
+    uint32_t score[ESPNOW_CHANNEL_MAX + 1] = { 0 };
+    for (uint16_t i = 0; i < count; i++) {
+        int strength = aps[i].rssi + 100;
+        if (strength <= 0) {
+            continue;
+        }
+        for (int ch = 1; ch <= ESPNOW_CHANNEL_MAX; ch++) {
+            int overlap = OVERLAP_SPAN - abs(ch - aps[i].primary);
+            if (overlap > 0) {
+                score[ch] += (uint32_t)(strength * overlap);
+            }
+        }
+    }
+    free(aps);
+
+    uint8_t best = 1;
+    char line[ESPNOW_CHANNEL_MAX * 12];
+    size_t used = 0;
+    for (uint8_t ch = 1; ch <= ESPNOW_CHANNEL_MAX; ch++) {
+        if (score[ch] < score[best]) {
+            best = ch;
+        }
+        int n = snprintf(line + used, sizeof(line) - used, " %u:%lu", ch, (unsigned long)score[ch]);
+        used += n > 0 && (size_t)n < sizeof(line) - used ? (size_t)n : 0;
+    }
+    ESP_LOGI(TAG, "%u APs heard; channel scores%s", count, line);
+    // The radio may be on a channel above ESPNOW_CHANNEL_MAX, left by an uplink; always move off it
+    uint32_t here = current <= ESPNOW_CHANNEL_MAX ? score[current] : UINT32_MAX;
+    if (best == current || score[best] + ESPNOW_CHANNEL_SWITCH_MARGIN > here) {
+        return current;
+    }
+    return best;
+}
+
+/**
+ * @brief A frame from a node: owe it the pending switch if it was not told yet; runs in the link task
+ */
+static void gateway_receive(const uint8_t *mac) {
+    bool owed = false;
+    portENTER_CRITICAL(&lock);
+    if (next != 0) {
+        told_entry_t *free_entry = NULL;
+        told_entry_t *entry = NULL;
+        for (int i = 0; i < ESPNOW_CHANNEL_NODES && entry == NULL; i++) {
+            if (nodes[i].used && memcmp(nodes[i].mac, mac, 6) == 0) {
+                entry = &nodes[i];
+            } else if (!nodes[i].used && free_entry == NULL) {
+                free_entry = &nodes[i];
+            }
+        }
+        if (entry == NULL && free_entry != NULL) {
+            entry = free_entry;
+            memcpy(entry->mac, mac, 6);
+            entry->used = true;
+        }
+        if (entry != NULL && !entry->told && !entry->due) {
+            entry->due = true;
+            owed = true;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+    if (owed && wake_cb != NULL) {
+        wake_cb();
+    }
+}
+
+/**
+ * @brief An announcement from the gateway; runs in the link task
+ */
+static void node_receive(const uint8_t *data, size_t len) {
+    if (len < ESPNOW_CHANNEL_ANNOUNCE_LEN || data[2] == 0 || data[2] > ESPNOW_CHANNEL_MAX) {
+        return;
+    }
+    uint32_t in_ms = get_u32(data + 3);
+    bool fresh;
+    portENTER_CRITICAL(&lock);
+    fresh = rtc_channel.next != data[2];
+    rtc_channel.next = data[2];
+    rtc_channel.switch_rtc_us = esp_clk_rtc_time() + (uint64_t)in_ms * 1000;
+    portEXIT_CRITICAL(&lock);
+    if (fresh) {
+        ESP_LOGI(TAG, "Gateway moves to channel %u in %lu s", data[2], (unsigned long)(in_ms / 1000));
+    }
+}
+
+bool espnow_channel_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    (void)rssi;
+    if (node_ready && memcmp(mac, gateway, sizeof(gateway)) == 0) {
+        heard = true;
+    } else if (serving && !follows) {
+        gateway_receive(mac);
+    }
+    if (len < 2 || data[0] != ESPNOW_CHANNEL_MAGIC) {
+        return false;
+    }
+    if (data[1] == ESPNOW_CHANNEL_KIND_ANNOUNCE && node_ready && memcmp(mac, gateway, sizeof(gateway)) == 0) {
+        node_receive(data, len);
+    }
+    return true;
+}
+
+uint8_t espnow_channel_gateway_home(uint8_t fallback) {
+    uint8_t channel = 0;
+    nvs_handle_t handle;
+    if (nvs_open(CHANNEL_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        nvs_get_u8(handle, CHANNEL_NVS_KEY, &channel);
+        nvs_close(handle);
+    }
+    return channel >= 1 && channel <= ESPNOW_CHANNEL_MAX ? channel : fallback;
+}
+
+static void send_announce(const uint8_t *mac, uint8_t channel, uint32_t in_ms) {
+    uint8_t frame[ESPNOW_CHANNEL_ANNOUNCE_LEN];
+    frame[0] = ESPNOW_CHANNEL_MAGIC;
+    frame[1] = ESPNOW_CHANNEL_KIND_ANNOUNCE;
+    frame[2] = channel;
+    put_u32(frame + 3, in_ms);
+    esp_err_t err = espnow_link_add_peer(mac);
+    if (err == ESP_OK) {
+        err = espnow_link_send(mac, frame, sizeof(frame));
+    }
+
+    bool unicast = memcmp(mac, broadcast_mac, sizeof(broadcast_mac)) != 0;
+    if (unicast && err == ESP_OK) {
+        portENTER_CRITICAL(&lock);
+        for (int i = 0; i < ESPNOW_CHANNEL_NODES; i++) {
+            if (nodes[i].used && memcmp(nodes[i].mac, mac, 6) == 0) {
+                nodes[i].told = true;
+            }
+        }
+        portEXIT_CRITICAL(&lock);
+    } else if (unicast) {
+        ESP_LOGW(TAG, "Announcement to " MACSTR " not sent: %s", MAC2STR(mac), esp_err_to_name(err));
+    }
+}
+
+static uint32_t switch_in_ms(void) {
+    int64_t left_us = switch_us - esp_timer_get_time();
+    return left_us > 0 ? (uint32_t)(left_us / 1000) : 0;
+}
+
+esp_err_t espnow_channel_gateway_start(bool follows_uplink, void (*wake)(void)) {
+    wifi_second_chan_t second;
+    esp_err_t err = esp_wifi_get_channel(&current, &second);
+    if (err != ESP_OK) {
+        return err;
+    }
+    memset(nodes, 0, sizeof(nodes));
+    wake_cb = wake;
+    follows = follows_uplink;
+    next = 0;
+
+    if (follows) {
+        // Where the uplink put the radio; a restart without the uplink starts here too
+        if (espnow_channel_gateway_home(0) != current) {
+            store_channel(current);
+        }
+        ESP_LOGI(TAG, "ESP-NOW on channel %u, set by the uplink", current);
+    } else {
+        uint8_t best = pick_channel();
+        if (best != current) {
+            portENTER_CRITICAL(&lock);
+            next = best;
+            portEXIT_CRITICAL(&lock);
+            switch_us = esp_timer_get_time() + (int64_t)ESPNOW_CHANNEL_ANNOUNCE_S * 1000000;
+            last_beacon_us = esp_timer_get_time() - (int64_t)ESPNOW_CHANNEL_BEACON_MS * 1000;
+            ESP_LOGW(TAG, "Channel %u is quieter than %u - switching in %d s", best, current,
+                     ESPNOW_CHANNEL_ANNOUNCE_S);
+        } else {
+            ESP_LOGI(TAG, "ESP-NOW stays on channel %u", current);
+        }
+    }
+    serving = true;
+    return ESP_OK;
+}
+
+void espnow_channel_gateway_poll(void) {
+    uint8_t to;
+    portENTER_CRITICAL(&lock);
+    to = next;
+    portEXIT_CRITICAL(&lock);
+    if (!serving || to == 0) {
+        return;
+    }
+
+    uint32_t in_ms = switch_in_ms();
+    if (in_ms == 0) {
+        if (set_channel(to) == ESP_OK) {
+            store_channel(to);
+            current = to;
+            switches++;
+            ESP_LOGI(TAG, "ESP-NOW moved to channel %u", to);
+        }
+        portENTER_CRITICAL(&lock);
+        next = 0;
+        memset(nodes, 0, sizeof(nodes));
+        portEXIT_CRITICAL(&lock);
+        return;
+    }
+
+    for (int i = 0; i < ESPNOW_CHANNEL_NODES; i++) {
+        uint8_t mac[6];
+        bool due;
+        portENTER_CRITICAL(&lock);
+        due = nodes[i].due;
+        nodes[i].due = false;
+        memcpy(mac, nodes[i].mac, 6);
+        portEXIT_CRITICAL(&lock);
+        if (due) {
+            send_announce(mac, to, in_ms);
+        }
+    }
+    if (esp_timer_get_time() - last_beacon_us >= (int64_t)ESPNOW_CHANNEL_BEACON_MS * 1000) {
+        last_beacon_us = esp_timer_get_time();
+        send_announce(broadcast_mac, to, in_ms);
+    }
+}
+
+uint32_t espnow_channel_gateway_poll_due_ms(void) {
+    uint8_t to;
+    portENTER_CRITICAL(&lock);
+    to = next;
+    portEXIT_CRITICAL(&lock);
+    if (!serving || to == 0) {
+        return UINT32_MAX;
+    }
+    int64_t since_ms = (esp_timer_get_time() - last_beacon_us) / 1000;
+    uint32_t beacon_ms = since_ms < ESPNOW_CHANNEL_BEACON_MS ? ESPNOW_CHANNEL_BEACON_MS - (uint32_t)since_ms : 0;
+    uint32_t in_ms = switch_in_ms();
+    return in_ms < beacon_ms ? in_ms : beacon_ms;
+}
+
+void espnow_channel_gateway_stop(void) {
+    serving = false;
+    portENTER_CRITICAL(&lock);
+    next = 0;
+    portEXIT_CRITICAL(&lock);
+}
+
+uint8_t espnow_channel_node_home(uint8_t fallback) {
+    if (rtc_channel.channel == 0 || rtc_channel.channel > ESPNOW_CHANNEL_MAX) {
+        rtc_channel.channel = fallback;
+    }
+    return rtc_channel.channel;
+}
+
+void espnow_channel_node_set_home(uint8_t channel) {
+    portENTER_CRITICAL(&lock);
+    rtc_channel.channel = channel;
+    rtc_channel.next = 0;
+    rtc_channel.quiet_wakes = 0;
+    portEXIT_CRITICAL(&lock);
+}
+
+void espnow_channel_node_init(const uint8_t *gateway_mac) {
+    memcpy(gateway, gateway_mac, sizeof(gateway));
+    heard = false;
+    node_ready = true;
+}
+
+void espnow_channel_node_poll(void) {
+    uint8_t to = 0;
+    portENTER_CRITICAL(&lock);
+    if (rtc_channel.next != 0 && esp_clk_rtc_time() >= rtc_channel.switch_rtc_us) {
+        to = rtc_channel.next;
+        rtc_channel.next = 0;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (!node_ready || to == 0 || to == rtc_channel.channel) {
+        return;
+    }
+    if (set_channel(to) == ESP_OK) {
+        rtc_channel.channel = to;
+        rtc_channel.switches++;
+        rtc_channel.quiet_wakes = 0;
+        ESP_LOGI(TAG, "Followed the gateway to channel %u", to);
+    }
+}
+
+void espnow_channel_node_settle(void) {
+    if (!node_ready) {
+        return;
+    }
+    espnow_channel_node_poll();
+    if (heard) {
+        rtc_channel.quiet_wakes = 0;
+        return;
+    }
+    if (++rtc_channel.quiet_wakes < ESPNOW_CHANNEL_LOST_WAKES) {
+        return;
+    }
+    // Lost: the next wake comes up on the next channel, round the band
+    uint8_t from = rtc_channel.channel;
+    rtc_channel.channel = from % ESPNOW_CHANNEL_MAX + 1;
+    rtc_channel.quiet_wakes = 0;
+    rtc_channel.lost_moves++;
+    ESP_LOGW(TAG, "Nothing from the gateway for %d wakes on channel %u - trying %u", ESPNOW_CHANNEL_LOST_WAKES,
+             from, rtc_channel.channel);
+}
+
+void espnow_channel_get_stats(espnow_channel_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    portENTER_CRITICAL(&lock);
+    if (node_ready) {
+        stats->channel = rtc_channel.channel;
+        stats->next = rtc_channel.next;
+        uint64_t now = esp_clk_rtc_time();
+        stats->switch_in_ms = rtc_channel.next != 0 && rtc_channel.switch_rtc_us > now
+                                  ? (uint32_t)((rtc_channel.switch_rtc_us - now) / 1000)
+                                  : 0;
+        stats->switches = rtc_channel.switches;
+        stats->lost_moves = rtc_channel.lost_moves;
+    } else {
+        stats->channel = current;
+        stats->next = next;
+        stats->follows_uplink = follows;
+        stats->switches = switches;
+        for (int i = 0; i < ESPNOW_CHANNEL_NODES; i++) {
+            stats->told += nodes[i].told ? 1 : 0;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+    if (!node_ready && stats->next != 0) {
+        stats->switch_in_ms = switch_in_ms();
+    }
+}
@@ -0,0 +1,402 @@
+/**
+ * @file espnow_config.c
+ * @brief Remote node configuration: the gateway pushes sampling settings on its ACKs, the node confirms the version
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "espnow_config.h"
+#include "flash_io.h"
+#include "json_reader.h"
+#include "version.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register espnow_config.c version
+REGISTER_VERSION(EspnowConfig, "1.0.0", "2026-10-15");
+
+static const char *TAG = "ESPNOW_CONFIG";
+
+#define TABLE_NVS_NAMESPACE "node_cfg"
+#define TABLE_NVS_KEY "table"
+
+/**
+ * @brief Desired settings of one node, as kept in NVS
+ */
+typedef struct {
+    uint32_t node_id;                           // 0 = free
+    node_settings_t desired;
+} stored_entry_t;
+
+/**
+ * @brief One node on the gateway; under lock
+ */
+typedef struct {
+    stored_entry_t stored;
+    uint8_t mac[6];                             // Where its frames come from, once seen
+    bool seen;
+    uint16_t confirmed;                         // Version it last reported
+} config_entry_t;
+
+/**
+ * @brief JSON parse state for espnow_config_gateway_set_json()
+ */
+typedef struct {
+    node_settings_t settings;
+} json_parse_t;
+
+// Gateway
+static config_entry_t table[ESPNOW_CONFIG_NODES];
+static espnow_config_stats_t stats;             // lock
+
+// Node
+static uint16_t in_force = 0;                   // lock
+static bool offered = false;                    // pushed differs from in_force; lock
+static node_settings_t pushed;                  // lock
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static void put_u16(uint8_t *p, uint16_t v);
+static void put_u32(uint8_t *p, uint32_t v);
+static uint16_t get_u16(const uint8_t *p);
+static uint32_t get_u32(const uint8_t *p);
+static bool same_settings(const node_settings_t *a, const node_settings_t *b);
+static config_entry_t *find_locked(uint32_t node_id);
+static void load_table(void);
+static void save_table(void);
+static esp_err_t on_json_event(void *ctx, const json_event_t *event);
+static size_t ack_hook(const uint8_t *mac, uint32_t cumulative, uint8_t *buf, size_t cap);
+static size_t trailer_hook(const uint8_t *data, size_t len);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Equal in everything but the version
+ */
+static bool same_settings(const node_settings_t *a, const node_settings_t *b) {
+    return a->batch_samples == b->batch_samples && a->sample_ms == b->sample_ms &&
+           a->heater_temp_c == b->heater_temp_c && a->heater_ms == b->heater_ms && a->flags == b->flags;
+}
+
+bool espnow_config_valid(const node_settings_t *settings) {
+    return (settings->sample_ms == 0 ||
+            (settings->sample_ms >= ESPNOW_CONFIG_SAMPLE_MS_MIN && settings->sample_ms <= ESPNOW_CONFIG_SAMPLE_MS_MAX)) &&
+           settings->batch_samples <= ESPNOW_BATCH_MAX_RECORDS &&
+           (settings->heater_temp_c == 0 ||
+            (settings->heater_temp_c >= ESPNOW_CONFIG_HEATER_C_MIN && settings->heater_temp_c <= ESPNOW_CONFIG_HEATER_C_MAX)) &&
+           settings->heater_ms <= ESPNOW_CONFIG_HEATER_MS_MAX && (settings->flags & ~NODE_SETTINGS_LR) == 0;
+}
+
+static config_entry_t *find_locked(uint32_t node_id) {
+    for (size_t i = 0; i < ESPNOW_CONFIG_NODES; i++) {
+        if (table[i].stored.node_id == node_id) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Desired settings from before a restart; each is confirmed again by the node's next frame
+ */
+static void load_table(void) {
+    stored_entry_t stored[ESPNOW_CONFIG_NODES] = { 0 };
+    size_t len = sizeof(stored);
+    nvs_handle_t handle;
+    if (nvs_open(TABLE_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    esp_err_t err = nvs_get_blob(handle, TABLE_NVS_KEY, stored, &len);
+    nvs_close(handle);
+    if (err != ESP_OK || len != sizeof(stored)) {
+        return;
+    }
+
+    uint32_t nodes = 0;
+    portENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < ESPNOW_CONFIG_NODES; i++) {
+        table[i].stored = stored[i];
+        nodes += stored[i].node_id != 0 ? 1 : 0;
+    }
+    portEXIT_CRITICAL(&lock);
+    ESP_LOGI(TAG, "Desired settings kept for %lu nodes", (unsigned long)nodes);
+}
+
+static void save_table(void) {
+    stored_entry_t stored[ESPNOW_CONFIG_NODES];
+    portENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < ESPNOW_CONFIG_NODES; i++) {
+        stored[i] = table[i].stored;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(TABLE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = flash_io_nvs_set_blob(handle, TABLE_NVS_KEY, stored, sizeof(stored));
+        if (err == ESP_OK) {
+            err = flash_io_nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Desired settings not saved: %s", esp_err_to_name(err));
+    }
+}
+
+esp_err_t espnow_config_gateway_start(void) {
+    memset(table, 0, sizeof(table));
+    memset(&stats, 0, sizeof(stats));
+    load_table();
+    espnow_reliable_set_ack_hook(ESPNOW_RELIABLE_TRAILER_CONFIG, ack_hook);
+    return ESP_OK;
+}
+
+esp_err_t espnow_config_gateway_set(uint32_t node_id, const node_settings_t *settings) {
+    if (node_id == 0 || settings == NULL || !espnow_config_valid(settings)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool changed = false;
+    uint16_t version = 0;
+    portENTER_CRITICAL(&lock);
+    config_entry_t *e = find_locked(node_id);
+    if (e == NULL) {
+        e = find_locked(0);
+        if (e != NULL) {
+            memset(e, 0, sizeof(*e));
+            e->stored.node_id = node_id;
+        }
+    }
+    if (e != NULL && (e->stored.desired.version == 0 || !same_settings(&e->stored.desired, settings))) {
+        // Past both the last desired and the last reported version, so a node never takes it for one it runs
+        version = (uint16_t)((e->stored.desired.version > e->confirmed ? e->stored.desired.version : e->confirmed) + 1);
+        if (version == 0) {
+            version = 1;
+        }
+        e->stored.desired = *settings;
+        e->stored.desired.version = version;
+        stats.sets++;
+        changed = true;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (e == NULL) {
+        ESP_LOGW(TAG, "No room for node %08lx's settings (%d nodes kept)", (unsigned long)node_id,
+                 ESPNOW_CONFIG_NODES);
+        return ESP_ERR_NO_MEM;
+    }
+    if (changed) {
+        save_table();
+        ESP_LOGI(TAG, "Node %08lx: config v%u - sample %lu ms, batch %u, heater %u degC / %u ms (0: default)%s",
+                 (unsigned long)node_id, version, (unsigned long)settings->sample_ms, settings->batch_samples,
+                 settings->heater_temp_c, settings->heater_ms,
+                 (settings->flags & NODE_SETTINGS_LR) ? ", Long Range" : "");
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Members of the root object; unknown ones are ignored
+ */
+static esp_err_t on_json_event(void *ctx, const json_event_t *event) {
+    json_parse_t *parse = (json_parse_t *)ctx;
+    if (event->depth != 1 || event->key == NULL) {
+        return ESP_OK;
+    }
+    if (event->type != JSON_EVENT_NUMBER) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    char *end;
+    unsigned long v = strtoul(event->value, &end, 10);
+    if (*end != '\0' || event->value[0] == '-') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (strcmp(event->key, "sample_ms") == 0) {
+        parse->settings.sample_ms = (uint32_t)v;
+    } else if (strcmp(event->key, "batch") == 0) {
+        parse->settings.batch_samples = v > UINT8_MAX ? UINT8_MAX : (uint8_t)v;
+    } else if (strcmp(event->key, "heater_c") == 0) {
+        parse->settings.heater_temp_c = v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+    } else if (strcmp(event->key, "heater_ms") == 0) {
+        parse->settings.heater_ms = v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+    } else if (strcmp(event->key, "lr") == 0) {
+        parse->settings.flags = v != 0 ? parse->settings.flags | NODE_SETTINGS_LR
+                                       : parse->settings.flags & ~NODE_SETTINGS_LR;
+    }
+    return ESP_OK;
+}
+
+esp_err_t espnow_config_gateway_set_json(uint32_t node_id, const char *json, size_t len) {
+    json_parse_t parse = { 0 };
+    portENTER_CRITICAL(&lock);
+    const config_entry_t *e = find_locked(node_id);
+    if (e != NULL) {
+        parse.settings = e->stored.desired;     // Members left out keep their value
+    }
+    portEXIT_CRITICAL(&lock);
+
+    json_reader_t reader;
+    json_reader_init(&reader, on_json_event, &parse);
+    esp_err_t err = json_reader_feed(&reader, json, len);
+    if (err == ESP_OK) {
+        err = json_reader_finish(&reader);
+    }
+    if (err == ESP_OK) {
+        err = espnow_config_gateway_set(node_id, &parse.settings);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Node %08lx: config not taken: %s", (unsigned long)node_id, esp_err_to_name(err));
+    }
+    return err;
+}
+
+void espnow_config_gateway_seen(const uint8_t *mac, uint32_t node_id, uint16_t version) {
+    bool confirmed = false;
+    portENTER_CRITICAL(&lock);
+    config_entry_t *e = find_locked(node_id);
+    if (e != NULL) {
+        memcpy(e->mac, mac, sizeof(e->mac));
+        e->seen = true;
+        confirmed = version != e->confirmed && version == e->stored.desired.version;
+        e->confirmed = version;
+        stats.confirmed += confirmed ? 1 : 0;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (confirmed) {
+        ESP_LOGI(TAG, "Node %08lx runs config v%u", (unsigned long)node_id, version);
+    }
+}
+
+/**
+ * @brief ACK task: the desired settings, for a node that does not run them yet
+ */
+static size_t ack_hook(const uint8_t *mac, uint32_t cumulative, uint8_t *buf, size_t cap) {
+    (void)cumulative;
+    if (cap < ESPNOW_CONFIG_TRAILER_LEN) {
+        return 0;
+    }
+    size_t len = 0;
+    portENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < ESPNOW_CONFIG_NODES; i++) {
+        const config_entry_t *e = &table[i];
+        if (e->stored.node_id == 0 || !e->seen || memcmp(e->mac, mac, 6) != 0) {
+            continue;
+        }
+        const node_settings_t *s = &e->stored.desired;
+        if (s->version != 0 && s->version != e->confirmed) {
+            buf[0] = ESPNOW_CONFIG_MAGIC;
+            put_u16(buf + 1, s->version);
+            put_u32(buf + 3, s->sample_ms);
+            buf[7] = s->batch_samples;
+            put_u16(buf + 8, s->heater_temp_c);
+            put_u16(buf + 10, s->heater_ms);
+            buf[12] = s->flags;
+            len = ESPNOW_CONFIG_TRAILER_LEN;
+            stats.pushes++;
+        }
+        break;
+    }
+    portEXIT_CRITICAL(&lock);
+    return len;
+}
+
+void espnow_config_get_stats(espnow_config_stats_t *out) {
+    portENTER_CRITICAL(&lock);
+    *out = stats;
+    out->nodes = 0;
+    out->pending = 0;
+    for (size_t i = 0; i < ESPNOW_CONFIG_NODES; i++) {
+        if (table[i].stored.node_id != 0) {
+            out->nodes++;
+            out->pending += table[i].confirmed != table[i].stored.desired.version ? 1 : 0;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+/**
+ * @brief Link task: settings on an ACK from the gateway sent to
+ */
+static size_t trailer_hook(const uint8_t *data, size_t len) {
+    if (len < ESPNOW_CONFIG_TRAILER_LEN || data[0] != ESPNOW_CONFIG_MAGIC) {
+        return 0;
+    }
+    node_settings_t s = { 0 };
+    s.version = get_u16(data + 1);
+    s.sample_ms = get_u32(data + 3);
+    s.batch_samples = data[7];
+    s.heater_temp_c = get_u16(data + 8);
+    s.heater_ms = get_u16(data + 10);
+    s.flags = data[12];
+    if (s.version == 0 || !espnow_config_valid(&s)) {
+        return ESPNOW_CONFIG_TRAILER_LEN;
+    }
+    portENTER_CRITICAL(&lock);
+    if (s.version != in_force) {
+        pushed = s;
+        offered = true;
+    }
+    portEXIT_CRITICAL(&lock);
+    return ESPNOW_CONFIG_TRAILER_LEN;
+}
+
+void espnow_config_node_init(uint16_t version) {
+    portENTER_CRITICAL(&lock);
+    in_force = version;
+    offered = false;
+    portEXIT_CRITICAL(&lock);
+    espnow_reliable_set_trailer_hook(ESPNOW_RELIABLE_TRAILER_CONFIG, trailer_hook);
+}
+
+bool espnow_config_node_take(node_settings_t *settings) {
+    portENTER_CRITICAL(&lock);
+    bool have = offered;
+    if (have) {
+        *settings = pushed;
+    }
+    portEXIT_CRITICAL(&lock);
+    return have;
+}
+
+void espnow_config_node_applied(uint16_t version) {
+    portENTER_CRITICAL(&lock);
+    in_force = version;
+    offered = offered && pushed.version != version;
+    portEXIT_CRITICAL(&lock);
+}
@@ -0,0 +1,179 @@
+/**
+ * @file espnow_failover.c
+ * @brief Node-side failover between redundant gateways, ranked by recent link quality
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "espnow_failover.h"
+#include "espnow_time.h"
+#include "version.h"
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register espnow_failover.c version
+REGISTER_VERSION(EspnowFailover, "1.0.0", "2026-10-15");
+
+static const char *TAG = "GW_FAILOVER";
+
+/**
+ * @brief A known gateway
+ */
+typedef struct {
+    uint8_t mac[6];
+    uint8_t misses;                             // Unacknowledged cycles in a row, since its last beacon
+    int16_t rssi_x8;                            // Smoothed beacon RSSI in 1/8 dB, 0 until heard
+    bool relay;                                 // Its beacon is repeated (ESPNOW_TIME_SOURCE_RELAY)
+} gateway_t;
+
+/**
+ * @brief The list; RTC_DATA_ATTR, so it survives deep sleep. Entry 0 is the configured gateway.
+ */
+typedef struct {
+    uint8_t count;                              // 0 after a power-on
+    uint8_t current;
+    gateway_t gateways[ESPNOW_FAILOVER_GATEWAYS];
+    uint32_t failovers;
+    uint32_t upgrades;
+} failover_t;
+
+static RTC_DATA_ATTR failover_t rtc_failover;
+static bool ready = false;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static int score(const gateway_t *g);
+static gateway_t *find_locked(const uint8_t *mac);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Link quality in dB, less the misses; call with lock held
+ */
+static int score(const gateway_t *g) {
+    int rssi = g->rssi_x8 != 0 ? g->rssi_x8 / 8 : ESPNOW_FAILOVER_UNHEARD_RSSI;
+    return rssi - g->misses * ESPNOW_FAILOVER_MISS_PENALTY_DB - (g->relay ? ESPNOW_FAILOVER_RELAY_PENALTY_DB : 0);
+}
+
+static gateway_t *find_locked(const uint8_t *mac) {
+    for (uint8_t i = 0; i < rtc_failover.count; i++) {
+        if (memcmp(rtc_failover.gateways[i].mac, mac, 6) == 0) {
+            return &rtc_failover.gateways[i];
+        }
+    }
+    return NULL;
+}
+
+bool espnow_failover_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    if (!ready || len < ESPNOW_TIME_BEACON_LEN || data[0] != ESPNOW_TIME_MAGIC ||
+        data[1] != ESPNOW_TIME_KIND_BEACON) {
+        return false;
+    }
+
+    bool learned = false;
+    portENTER_CRITICAL(&lock);
+    gateway_t *g = find_locked(mac);
+    if (g == NULL && ESPNOW_FAILOVER != 0 && rtc_failover.count < ESPNOW_FAILOVER_GATEWAYS) {
+        g = &rtc_failover.gateways[rtc_failover.count++];
+        memcpy(g->mac, mac, 6);
+        g->rssi_x8 = 0;
+        learned = true;
+    }
+    if (g != NULL) {
+        g->misses = 0;                          // Up again
+        g->relay = data[2] == ESPNOW_TIME_SOURCE_RELAY;
+        int16_t x8 = (int16_t)(rssi * 8);
+        g->rssi_x8 = g->rssi_x8 == 0 ? x8 : (int16_t)(g->rssi_x8 + (x8 - g->rssi_x8) / 4);
+    }
+    portEXIT_CRITICAL(&lock);
+    if (learned) {
+        ESP_LOGI(TAG, "Gateway " MACSTR " heard at %d dBm - kept for failover%s", MAC2STR(mac), rssi,
+                 data[2] == ESPNOW_TIME_SOURCE_RELAY ? " (relay)" : "");
+    }
+    return false;
+}
+
+void espnow_failover_init(const uint8_t *configured, uint8_t *active) {
+    portENTER_CRITICAL(&lock);
+    if (rtc_failover.count == 0 || rtc_failover.current >= rtc_failover.count ||
+        memcmp(rtc_failover.gateways[0].mac, configured, 6) != 0) {
+        memset(&rtc_failover, 0, sizeof(rtc_failover));
+        memcpy(rtc_failover.gateways[0].mac, configured, 6);
+        rtc_failover.count = 1;
+    }
+    memcpy(active, rtc_failover.gateways[rtc_failover.current].mac, 6);
+    ready = true;
+    portEXIT_CRITICAL(&lock);
+}
+
+bool espnow_failover_report(bool delivered, uint8_t *next) {
+    if (!ready) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&lock);
+    gateway_t *cur = &rtc_failover.gateways[rtc_failover.current];
+    if (delivered) {
+        cur->misses = 0;
+    } else if (cur->misses < UINT8_MAX) {
+        cur->misses++;
+    }
+    int best = -1;
+    for (uint8_t i = 0; i < rtc_failover.count; i++) {
+        if (i != rtc_failover.current && (best < 0 || score(&rtc_failover.gateways[i]) >
+                                                          score(&rtc_failover.gateways[best]))) {
+            best = i;
+        }
+    }
+    bool move = best >= 0 &&
+                (!delivered || score(&rtc_failover.gateways[best]) >= score(cur) + ESPNOW_FAILOVER_HYSTERESIS_DB);
+    uint8_t misses = cur->misses;
+    if (move) {
+        rtc_failover.current = (uint8_t)best;
+        memcpy(next, rtc_failover.gateways[best].mac, 6);
+        if (delivered) {
+            rtc_failover.upgrades++;
+        } else {
+            rtc_failover.failovers++;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (move) {
+        ESP_LOGW(TAG, "%s - moving to gateway " MACSTR, delivered ? "Better link found" : "Gateway silent",
+                 MAC2STR(next));
+    } else if (!delivered) {
+        ESP_LOGW(TAG, "Gateway missed %u cycles, no other one known", misses);
+    }
+    return move;
+}
+
+void espnow_failover_get_stats(espnow_failover_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    portENTER_CRITICAL(&lock);
+    if (ready) {
+        const gateway_t *cur = &rtc_failover.gateways[rtc_failover.current];
+        stats->gateways = rtc_failover.count;
+        memcpy(stats->mac, cur->mac, 6);
+        stats->rssi = (int8_t)(cur->rssi_x8 != 0 ? cur->rssi_x8 / 8 : ESPNOW_FAILOVER_UNHEARD_RSSI);
+        stats->misses = cur->misses;
+        stats->failovers = rtc_failover.failovers;
+        stats->upgrades = rtc_failover.upgrades;
+    }
+    portEXIT_CRITICAL(&lock);
+}
@@ -0,0 +1,1097 @@
+/**
+ * @file espnow_link.c
+ * @brief Encrypted ESP-NOW transport shared by node and gateway
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "espnow_link.h"
+#include "boot_trace.h"
+#include "fault_inject.h"
+#include "iram_profile.h"
+#include "net_stats.h"
+#include "nvs_utils.h"
+#include "power_profile.h"
+#include "spsc_ring.h"
+#include "pipeline_trace.h"
+#include "version.h"
+#include "static_mem.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_now.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_private/esp_clk.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/ringbuf.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mbedtls/sha256.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register espnow_link.c version
+REGISTER_VERSION(EspnowLink, "1.0.0", "2026-10-14");
+
+static const char *TAG = "ESPNOW";
+
+_Static_assert(sizeof(ESPNOW_LINK_PMK) - 1 == ESP_NOW_KEY_LEN, "ESPNOW_LINK_PMK must be 16 characters");
+_Static_assert(ESPNOW_KEY_LEN == ESP_NOW_KEY_LEN, "NVS key length differs from the ESP-NOW LMK");
+_Static_assert((ESPNOW_LINK_RX_SLOTS & (ESPNOW_LINK_RX_SLOTS - 1)) == 0, "ESPNOW_LINK_RX_SLOTS must be a power of two");
+
+#define WAKE_BIT (1u << 0)                      // Link task notification: a ring has items
+#define STOP_BIT (1u << 31)                     // Link task notification: exit
+#define STOP_TIMEOUT_MS 1000
+#define BUSY_RETRY_MS 10                        // A send is in flight; end the rotation after it
+
+#define KEY_CURRENT 0
+#define KEY_PREVIOUS 1                          // Only set inside the grace window
+
+/**
+ * @brief A received frame as copied in by the receive callback; one ring slot
+ */
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    int8_t rssi;
+    uint8_t len;
+    uint8_t data[ESP_NOW_MAX_DATA_LEN];
+} rx_item_t;
+
+/**
+ * @brief A send result as queued by the send callback
+ */
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    esp_now_send_status_t status;
+} tx_item_t;
+
+/**
+ * @brief Registered peer
+ */
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    uint8_t key;                                // KEY_CURRENT or KEY_PREVIOUS
+    bool used;
+    uint8_t rate;                               // Index into link_rates
+    int8_t power;                               // 0.25 dBm units
+    uint8_t sent;                               // Sends in the current adaptation window
+    uint8_t failed;
+    int16_t rssi_x8;                            // Smoothed RSSI in 1/8 dB, 0 until heard; written by the link task
+    bool lr;                                    // Sent at the LR rates
+    volatile bool lr_wanted;                    // espnow_link_peer_set_lr(); applied at the next send
+} peer_t;
+
+/**
+ * @brief An ESP-NOW PHY rate and the RSSI it needs (ESP32 datasheet receiver sensitivity)
+ */
+typedef struct {
+    const char *name;
+    wifi_phy_mode_t mode;
+    wifi_phy_rate_t rate;
+    int8_t sensitivity;                         // dBm
+} link_rate_t;
+
+static const link_rate_t link_rates[] = {
+    { "1M", WIFI_PHY_MODE_11B, WIFI_PHY_RATE_1M_L, -97 },
+    { "6M", WIFI_PHY_MODE_11G, WIFI_PHY_RATE_6M, -92 },
+    { "12M", WIFI_PHY_MODE_11G, WIFI_PHY_RATE_12M, -89 },
+    { "24M", WIFI_PHY_MODE_11G, WIFI_PHY_RATE_24M, -86 },
+    { "MCS4", WIFI_PHY_MODE_HT20, WIFI_PHY_RATE_MCS4_LGI, -79 },
+    { "MCS7", WIFI_PHY_MODE_HT20, WIFI_PHY_RATE_MCS7_LGI, -73 },
+    // Long Range peers only; Espressif rates LR about 4 dB more sensitive than 1 Mbps, 250K 3 dB more again
+    { "LR250K", WIFI_PHY_MODE_LR, WIFI_PHY_RATE_LORA_250K, -104 },
+    { "LR500K", WIFI_PHY_MODE_LR, WIFI_PHY_RATE_LORA_500K, -101 },
+};
+#define LINK_RATE_COUNT (sizeof(link_rates) / sizeof(link_rates[0]))
+#define LINK_RATE_LR 6                          // First LR entry; normal peers adapt below it
+
+/**
+ * @brief Link adaptation settings of a peer, kept across deep sleep
+ */
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    uint8_t rate;
+    int8_t power;
+    int16_t rssi_x8;
+} adapt_memo_t;
+
+static bool started = false;
+static espnow_link_rx_t rx_handler = NULL;
+static spsc_ring_t rx_ring;                     // WiFi task in, link task out
+static rx_item_t *rx_slots = NULL;
+static RingbufHandle_t tx_ring = NULL;
+static RingbufHandle_t inject_ring = NULL;      // espnow_link_inject() in, link task out; rx_item_t, trimmed
+static volatile uint32_t inject_pending = 0;
+static QueueHandle_t send_result = NULL;        // Length 1: status of the send in flight
+static SemaphoreHandle_t send_mutex = NULL;
+static SemaphoreHandle_t stopped_sem = NULL;
+static TaskHandle_t link_task_handle = NULL;
+STATIC_TASK_SLOT(link_task_slot, ESPNOW_LINK_TASK_STACK_SIZE);
+static peer_t peers[ESPNOW_LINK_MAX_PEERS];
+static uint8_t keys[2][ESP_NOW_KEY_LEN];
+static bool rotating = false;
+static bool lr_ready = false;                   // The station interface has LR enabled
+static uint8_t key_epoch = 0;                   // Rotations started since espnow_link_init()
+static uint32_t key_fingerprint = 0;            // Of keys[KEY_CURRENT] during a rotation
+static volatile uint32_t rx_dropped = 0;        // Written only by the receive callback
+#if FAULT_INJECT != 0
+static rx_item_t fault_held;                    // A frame held back to arrive after the next one
+static bool fault_holding = false;
+static int64_t fault_held_us = 0;
+static rx_item_t fault_delayed[FAULT_INJECT_DELAY_SLOTS];  // Frames held up until their due time
+static int64_t fault_due_us[FAULT_INJECT_DELAY_SLOTS];     // 0: slot free
+#endif
+static espnow_link_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Rotation in progress, kept across deep sleep so a duty-cycled node's window keeps running
+static RTC_DATA_ATTR uint8_t rtc_rotation_key[ESP_NOW_KEY_LEN];
+static RTC_DATA_ATTR uint64_t rtc_rotation_start_us;
+
+// Link adaptation of the last peers that changed, for a duty-cycled node's next wake
+static RTC_DATA_ATTR adapt_memo_t rtc_adapt[ESPNOW_LINK_ADAPT_MEMO];
+static RTC_DATA_ATTR uint8_t rtc_adapt_next;
+
+// =============================
+// Function Prototypes
+// =============================
+static HOT_IRAM_ATTR void recv_cb(const esp_now_recv_info_t *info, const uint8_t *data, int len);
+static HOT_IRAM_ATTR void send_cb(const uint8_t *mac, esp_now_send_status_t status);
+static void link_task(void *arg);
+static void drain_rings(void);
+static void deliver(const rx_item_t *rx);
+#if FAULT_INJECT != 0
+static bool hold_delayed(const rx_item_t *rx);
+static void release_faults(void);
+static TickType_t fault_wait(TickType_t wait);
+#endif
+static bool key_is_set(const uint8_t *key);
+static bool is_broadcast(const uint8_t *mac);
+static peer_t *find_peer(const uint8_t *mac);
+static esp_err_t apply_peer_key(peer_t *peer, uint8_t key, bool add);
+static esp_err_t send_once(const uint8_t *mac, const uint8_t *data, size_t len);
+static void start_rotation(const uint8_t *pending, bool resume);
+static bool finish_rotation(void);
+static void drop_previous_key(void);
+static void save_rotation(void);
+static uint32_t grace_remaining_ms(void);
+static uint8_t rate_first(const peer_t *peer);
+static uint8_t rate_end(const peer_t *peer);
+static void lr_apply(peer_t *peer);
+static void adapt_start(peer_t *peer);
+static esp_err_t adapt_apply_rate(const peer_t *peer);
+static int adapt_margin_db(const peer_t *peer, uint8_t rate, int8_t power);
+static void adapt_result(peer_t *peer, bool ok);
+static void adapt_remember(const peer_t *peer);
+static void adapt_note_rssi(const uint8_t *mac, int8_t rssi);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief WiFi task: copy the frame into the next receive slot and wake the link task
+ *
+ * No lock and no allocation: the slot is written in place and published with one store.
+ */
+static HOT_IRAM_ATTR void recv_cb(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
+    rx_item_t *item = len > 0 && len <= ESP_NOW_MAX_DATA_LEN ? spsc_ring_acquire(&rx_ring) : NULL;
+    if (item == NULL) {
+        rx_dropped++;
+        return;
+    }
+    memcpy(item->mac, info->src_addr, ESP_NOW_ETH_ALEN);
+    item->rssi = info->rx_ctrl != NULL ? info->rx_ctrl->rssi : 0;
+    item->len = (uint8_t)len;
+    memcpy(item->data, data, len);
+    spsc_ring_commit(&rx_ring);
+    xTaskNotify(link_task_handle, WAKE_BIT, eSetBits);
+}
+
+/**
+ * @brief WiFi task: queue the send result and wake the link task
+ */
+static HOT_IRAM_ATTR void send_cb(const uint8_t *mac, esp_now_send_status_t status) {
+    tx_item_t item = { .status = status };
+    if (status == ESP_NOW_SEND_SUCCESS) {
+        boot_trace_first_tx();
+    }
+    if (mac != NULL) {
+        memcpy(item.mac, mac, ESP_NOW_ETH_ALEN);
+    }
+    xRingbufferSend(tx_ring, &item, sizeof(item), 0);
+    xTaskNotify(link_task_handle, WAKE_BIT, eSetBits);
+}
+
+/**
+ * @brief Hand queued frames to the receive handler and queued send results to the sender
+ */
+static void drain_rings(void) {
+    size_t size;
+    tx_item_t *tx;
+    while ((tx = xRingbufferReceive(tx_ring, &size, 0)) != NULL) {
+        bool ok = tx->status == ESP_NOW_SEND_SUCCESS;
+        vRingbufferReturnItem(tx_ring, tx);
+        net_stats_espnow_send_done(ok);
+        xQueueOverwrite(send_result, &ok);
+    }
+
+    // The handler reads the frame in its slot; the slot is only reused once it returns
+    rx_item_t *rx;
+    while ((rx = xRingbufferReceive(inject_ring, &size, 0)) != NULL) {
+        deliver(rx);
+        vRingbufferReturnItem(inject_ring, rx);
+        __atomic_sub_fetch(&inject_pending, 1, __ATOMIC_RELAXED);
+    }
+    uint32_t frames = 0;
+    while ((rx = spsc_ring_front(&rx_ring)) != NULL) {
+        net_stats_espnow_received(rx->len);
+        if (ESPNOW_LINK_ADAPT != 0) {
+            adapt_note_rssi(rx->mac, rx->rssi);
+        }
+        deliver(rx);
+        spsc_ring_release(&rx_ring);
+        frames++;
+    }
+#if FAULT_INJECT != 0
+    release_faults();
+#endif
+    if (frames > 0) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.rx_frames += frames;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+}
+
+/**
+ * @brief Pass one received frame to the handler, through the fault injection point (fault_inject.h)
+ */
+static void deliver(const rx_item_t *rx) {
+    if (rx_handler == NULL) {
+        return;
+    }
+    switch (FAULT_INJECT_DECIDE(FAULT_INJECT_ESPNOW_RX)) {
+    case FAULT_INJECT_DROP:
+        return;
+    case FAULT_INJECT_DELAY:
+#if FAULT_INJECT != 0
+        if (hold_delayed(rx)) {
+            return;
+        }
+#endif
+        break;                                  // Every slot taken: this one passes
+    case FAULT_INJECT_DUPLICATE:
+        rx_handler(rx->mac, rx->data, rx->len, rx->rssi);
+        break;
+    case FAULT_INJECT_REORDER:
+#if FAULT_INJECT != 0
+        // One frame at a time is held; with one already held this one simply passes
+        if (!fault_holding) {
+            memcpy(&fault_held, rx, sizeof(fault_held));
+            fault_held_us = esp_timer_get_time();
+            fault_holding = true;
+            return;
+        }
+#endif
+        break;
+    default:
+        break;
+    }
+    rx_handler(rx->mac, rx->data, rx->len, rx->rssi);
+#if FAULT_INJECT != 0
+    if (fault_holding) {
+        fault_holding = false;
+        rx_handler(fault_held.mac, fault_held.data, fault_held.len, fault_held.rssi);
+    }
+#endif
+}
+
+#if FAULT_INJECT != 0
+/**
+ * @brief Keep a copy of the frame to deliver after the point's delay; frames behind it carry on
+ *
+ * @return false with every slot taken
+ */
+static bool hold_delayed(const rx_item_t *rx) {
+    for (int i = 0; i < FAULT_INJECT_DELAY_SLOTS; i++) {
+        if (fault_due_us[i] == 0) {
+            memcpy(&fault_delayed[i], rx, sizeof(fault_delayed[i]));
+            fault_due_us[i] = esp_timer_get_time() + (int64_t)fault_inject_delay_ms(FAULT_INJECT_ESPNOW_RX) * 1000;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Deliver the delayed frames that are due, and a reordered one that waited FAULT_INJECT_HOLD_MS
+ */
+static void release_faults(void) {
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < FAULT_INJECT_DELAY_SLOTS; i++) {
+        if (fault_due_us[i] != 0 && now >= fault_due_us[i]) {
+            fault_due_us[i] = 0;
+            if (rx_handler != NULL) {
+                rx_handler(fault_delayed[i].mac, fault_delayed[i].data, fault_delayed[i].len, fault_delayed[i].rssi);
+            }
+        }
+    }
+    if (fault_holding && now - fault_held_us >= (int64_t)FAULT_INJECT_HOLD_MS * 1000) {
+        fault_holding = false;
+        if (rx_handler != NULL) {
+            rx_handler(fault_held.mac, fault_held.data, fault_held.len, fault_held.rssi);
+        }
+    }
+}
+
+/**
+ * @brief The link task's wait, cut short for the next held frame to come due
+ */
+static TickType_t fault_wait(TickType_t wait) {
+    int64_t now = esp_timer_get_time();
+    int64_t next_us = fault_holding ? fault_held_us + (int64_t)FAULT_INJECT_HOLD_MS * 1000 : INT64_MAX;
+    for (int i = 0; i < FAULT_INJECT_DELAY_SLOTS; i++) {
+        if (fault_due_us[i] != 0 && fault_due_us[i] < next_us) {
+            next_us = fault_due_us[i];
+        }
+    }
+    if (next_us == INT64_MAX) {
+        return wait;
+    }
+    TickType_t due = next_us > now ? pdMS_TO_TICKS((next_us - now + 999) / 1000) + 1 : 0;
+    return wait < due ? wait : due;
+}
+#endif
+
+/**
+ * @brief Drain the rings when woken; end a key rotation when its window runs out
+ */
+static void link_task(void *arg) {
+    uint32_t bits = 0;
+    while (!(bits & STOP_BIT)) {
+        TickType_t wait = portMAX_DELAY;
+        if (rotating) {
+            uint32_t remaining_ms = grace_remaining_ms();
+            if (remaining_ms == 0 && !finish_rotation()) {
+                remaining_ms = BUSY_RETRY_MS;
+            }
+            if (rotating) {
+                wait = pdMS_TO_TICKS(remaining_ms) + 1;
+            }
+        }
+#if FAULT_INJECT != 0
+        wait = fault_wait(wait);
+#endif
+        bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, wait);
+        drain_rings();
+    }
+
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+/** @brief All-zero means no key */
+static bool key_is_set(const uint8_t *key) {
+    for (size_t i = 0; i < ESP_NOW_KEY_LEN; i++) {
+        if (key[i] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @brief FF:FF:FF:FF:FF:FF */
+static bool is_broadcast(const uint8_t *mac) {
+    for (size_t i = 0; i < ESP_NOW_ETH_ALEN; i++) {
+        if (mac[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** @brief Peer table entry for mac, or NULL */
+static peer_t *find_peer(const uint8_t *mac) {
+    for (size_t i = 0; i < ESPNOW_LINK_MAX_PEERS; i++) {
+        if (peers[i].used && memcmp(peers[i].mac, mac, ESP_NOW_ETH_ALEN) == 0) {
+            return &peers[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Add the peer to ESP-NOW, or change its LMK, using one of the two keys
+ *
+ * ESP-NOW cannot encrypt broadcasts, so the broadcast peer stays open.
+ */
+static esp_err_t apply_peer_key(peer_t *peer, uint8_t key, bool add) {
+    esp_now_peer_info_t info = {
+        .channel = 0,                           // Whatever channel the radio is on
+        .ifidx = WIFI_IF_STA,
+        .encrypt = key_is_set(keys[key]) && !is_broadcast(peer->mac),
+    };
+    memcpy(info.peer_addr, peer->mac, ESP_NOW_ETH_ALEN);
+    memcpy(info.lmk, keys[key], ESP_NOW_KEY_LEN);
+    esp_err_t err = add ? esp_now_add_peer(&info) : esp_now_mod_peer(&info);
+    if (err == ESP_OK) {
+        peer->key = key;
+    }
+    return err;
+}
+
+/**
+ * @brief esp_now_send() and wait for the send callback, through the link task
+ */
+static esp_err_t send_once(const uint8_t *mac, const uint8_t *data, size_t len) {
+    bool ok = false;
+    xQueueReset(send_result);
+    PIPELINE_TRACE_BEGIN(PIPELINE_TRACE_ESPNOW_SEND);
+    esp_err_t err = esp_now_send(mac, data, len);
+    if (err == ESP_OK) {
+        net_stats_espnow_sent(len);
+        if (xQueueReceive(send_result, &ok, pdMS_TO_TICKS(ESPNOW_LINK_SEND_TIMEOUT_MS)) != pdTRUE) {
+            err = ESP_ERR_TIMEOUT;
+        } else if (!ok) {
+            err = ESP_FAIL;
+        }
+    }
+    PIPELINE_TRACE_END(PIPELINE_TRACE_ESPNOW_SEND);
+    return err;
+}
+
+/**
+ * @brief Make the pending key current, keep the old one, and move every peer over
+ *
+ * @param pending Key to rotate to
+ * @param resume The window started on an earlier boot; keep its start time
+ */
+static void start_rotation(const uint8_t *pending, bool resume) {
+    uint8_t hash[32];
+    memcpy(keys[KEY_PREVIOUS], keys[KEY_CURRENT], ESP_NOW_KEY_LEN);
+    memcpy(keys[KEY_CURRENT], pending, ESP_NOW_KEY_LEN);
+    mbedtls_sha256(keys[KEY_CURRENT], ESP_NOW_KEY_LEN, hash, 0);
+    key_fingerprint = (uint32_t)hash[0] | ((uint32_t)hash[1] << 8) | ((uint32_t)hash[2] << 16) |
+                      ((uint32_t)hash[3] << 24);
+    key_epoch++;
+    if (!resume) {
+        memcpy(rtc_rotation_key, pending, ESP_NOW_KEY_LEN);
+        rtc_rotation_start_us = esp_clk_rtc_time();
+    }
+    rotating = true;
+
+    for (size_t i = 0; i < ESPNOW_LINK_MAX_PEERS; i++) {
+        if (!peers[i].used) {
+            continue;
+        }
+        if (ESPNOW_LINK_KEY_STAGED != 0) {
+            // Registered with the old key, which is KEY_PREVIOUS now; espnow_link_peer_switch_key() moves it
+            peers[i].key = is_broadcast(peers[i].mac) ? KEY_CURRENT : KEY_PREVIOUS;
+        } else if (apply_peer_key(&peers[i], KEY_CURRENT, false) != ESP_OK) {
+            ESP_LOGW(TAG, "Peer " MACSTR " kept the old key", MAC2STR(peers[i].mac));
+            peers[i].key = KEY_PREVIOUS;
+        }
+    }
+    ESP_LOGI(TAG, "Key rotation %s: old key accepted for another %lu s", resume ? "resumed" : "started",
+             (unsigned long)(grace_remaining_ms() / 1000));
+}
+
+/**
+ * @brief End of the grace window: drop the old key and make the pending key the active one in NVS
+ *
+ * Runs in the link task, which must not block on a sender that waits for it.
+ *
+ * @return bool False if a send was in flight and nothing was done
+ */
+static bool finish_rotation(void) {
+    if (xSemaphoreTake(send_mutex, 0) != pdTRUE) {
+        return false;
+    }
+    drop_previous_key();
+    xSemaphoreGive(send_mutex);
+    save_rotation();
+    return true;
+}
+
+/**
+ * @brief Move the peers still on the old key and forget it; send mutex held
+ */
+static void drop_previous_key(void) {
+    for (size_t i = 0; i < ESPNOW_LINK_MAX_PEERS; i++) {
+        if (peers[i].used && peers[i].key != KEY_CURRENT) {
+            apply_peer_key(&peers[i], KEY_CURRENT, false);
+        }
+    }
+    memset(keys[KEY_PREVIOUS], 0, ESP_NOW_KEY_LEN);
+    rotating = false;
+}
+
+/**
+ * @brief Make the new key the active one in NVS, and end the rotation kept across deep sleep
+ */
+static void save_rotation(void) {
+    static const uint8_t none[ESPNOW_KEY_LEN] = { 0 };
+
+    esp_err_t err = nvs_store_espnow_active_key(keys[KEY_CURRENT]);
+    if (err == ESP_OK) {
+        err = nvs_store_espnow_pending_key(none);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Key rotation done, but saving it failed: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "Key rotation done");
+    }
+    memset(rtc_rotation_key, 0, ESP_NOW_KEY_LEN);
+}
+
+/** @brief Milliseconds left in the key grace window */
+static uint32_t grace_remaining_ms(void) {
+    uint64_t now_us = esp_clk_rtc_time();
+    uint64_t grace_us = (uint64_t)ESPNOW_LINK_KEY_GRACE_S * 1000000;
+    if (now_us < rtc_rotation_start_us || now_us - rtc_rotation_start_us >= grace_us) {
+        return 0;                               // Ended, or the RTC was reset by a power cycle
+    }
+    uint64_t elapsed_us = now_us - rtc_rotation_start_us;
+    return (uint32_t)((grace_us - elapsed_us) / 1000);
+}
+
+/** @brief Slowest rate the peer is sent at: 1 Mbps, or LR 250 kbps */
+static uint8_t rate_first(const peer_t *peer) {
+    return peer->lr ? LINK_RATE_LR : 0;
+}
+
+/** @brief One past the fastest */
+static uint8_t rate_end(const peer_t *peer) {
+    return peer->lr ? LINK_RATE_COUNT : LINK_RATE_LR;
+}
+
+/**
+ * @brief Move the peer into or out of LR mode, as last asked; with the send mutex held
+ */
+static void lr_apply(peer_t *peer) {
+    bool wanted = peer->lr_wanted;
+    peer->lr = wanted;
+    adapt_start(peer);
+    if (peer->rate == 0) {
+        adapt_apply_rate(peer);                 // Out of LR: 1 Mbps has to be set back explicitly
+    }
+    if (peer->lr != wanted) {
+        ESP_LOGW(TAG, "Peer " MACSTR " cannot be sent to in Long Range mode", MAC2STR(peer->mac));
+        return;
+    }
+    ESP_LOGI(TAG, "Peer " MACSTR " %s, at %s", MAC2STR(peer->mac), wanted ? "in Long Range mode" : "back to 802.11",
+             link_rates[peer->rate].name);
+}
+
+/**
+ * @brief A new peer, or one changing mode: full power at its slowest rate, or the settings it had before deep sleep
+ */
+static void adapt_start(peer_t *peer) {
+    peer->rate = rate_first(peer);
+    peer->power = ESPNOW_LINK_ADAPT_POWER_MAX;
+    peer->sent = 0;
+    peer->failed = 0;
+    peer->rssi_x8 = 0;
+    for (size_t i = 0; i < ESPNOW_LINK_ADAPT_MEMO && ESPNOW_LINK_ADAPT != 0 && !is_broadcast(peer->mac); i++) {
+        const adapt_memo_t *memo = &rtc_adapt[i];
+        if (memcmp(memo->mac, peer->mac, ESP_NOW_ETH_ALEN) == 0 && memo->rate >= rate_first(peer) &&
+            memo->rate < rate_end(peer) && memo->power >= ESPNOW_LINK_ADAPT_POWER_MIN &&
+            memo->power <= ESPNOW_LINK_ADAPT_POWER_MAX) {
+            peer->rate = memo->rate;
+            peer->power = memo->power;
+            peer->rssi_x8 = memo->rssi_x8;
+            break;
+        }
+    }
+    // 1 Mbps is the driver's default; any other rate, LR included, is set per peer
+    if (peer->rate != 0 && adapt_apply_rate(peer) != ESP_OK) {
+        peer->rate = 0;
+        peer->lr = false;
+        peer->lr_wanted = false;
+    }
+}
+
+/** @brief Send to the peer at its rate from now on */
+static esp_err_t adapt_apply_rate(const peer_t *peer) {
+    esp_now_rate_config_t cfg = {
+        .phymode = link_rates[peer->rate].mode,
+        .rate = link_rates[peer->rate].rate,
+    };
+    return esp_now_set_peer_rate_config(peer->mac, &cfg);
+}
+
+/**
+ * @brief Estimated margin at the peer over a rate's sensitivity, sending at a given power
+ *
+ * Assumes the path loss is the same both ways and the peer sends at full power.
+ */
+static int adapt_margin_db(const peer_t *peer, uint8_t rate, int8_t power) {
+    int rssi = peer->rssi_x8 / 8;
+    return rssi - (ESPNOW_LINK_ADAPT_POWER_MAX - power) / 4 - link_rates[rate].sensitivity;
+}
+
+/**
+ * @brief Count a send to the peer; step at the end of a clean window, or back after losses
+ *
+ * Called with the send mutex held.
+ */
+static void adapt_result(peer_t *peer, bool ok) {
+    peer->sent++;
+    if (!ok) {
+        peer->failed++;
+    }
+
+    uint8_t rate = peer->rate;
+    int8_t power = peer->power;
+    bool backoff = peer->failed >= ESPNOW_LINK_ADAPT_LOSS;
+    if (backoff) {
+        rate = rate > rate_first(peer) ? rate - 1 : rate;
+        power = power + ESPNOW_LINK_ADAPT_POWER_STEP < ESPNOW_LINK_ADAPT_POWER_MAX
+                    ? power + ESPNOW_LINK_ADAPT_POWER_STEP
+                    : ESPNOW_LINK_ADAPT_POWER_MAX;
+    } else if (peer->sent >= ESPNOW_LINK_ADAPT_WINDOW && peer->failed == 0 && peer->rssi_x8 != 0) {
+        if (rate + 1u < rate_end(peer) && adapt_margin_db(peer, rate + 1, power) >= ESPNOW_LINK_ADAPT_MARGIN_DB) {
+            rate++;
+        } else if (power - ESPNOW_LINK_ADAPT_POWER_STEP >= ESPNOW_LINK_ADAPT_POWER_MIN &&
+                   adapt_margin_db(peer, rate, power - ESPNOW_LINK_ADAPT_POWER_STEP) >= ESPNOW_LINK_ADAPT_MARGIN_DB) {
+            power -= ESPNOW_LINK_ADAPT_POWER_STEP;
+        }
+    }
+    if (backoff || peer->sent >= ESPNOW_LINK_ADAPT_WINDOW) {
+        peer->sent = 0;
+        peer->failed = 0;
+    }
+    if (rate == peer->rate && power == peer->power) {
+        return;
+    }
+
+    uint8_t old_rate = peer->rate;
+    peer->rate = rate;
+    if (rate != old_rate && adapt_apply_rate(peer) != ESP_OK) {
+        peer->rate = old_rate;
+    }
+    peer->power = power;
+    adapt_remember(peer);
+
+    portENTER_CRITICAL(&stats_lock);
+    if (backoff) {
+        stats.adapt_backoffs++;
+    } else {
+        stats.adapt_steps++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    ESP_LOGI(TAG, "Peer " MACSTR " %s: %s at %d.%02d dBm, RSSI %d", MAC2STR(peer->mac),
+             backoff ? "backs off" : "steps up", link_rates[peer->rate].name, power / 4, (power % 4) * 25,
+             peer->rssi_x8 / 8);
+}
+
+/** @brief Keep the peer's settings in RTC memory, replacing the oldest entry for a new peer */
+static void adapt_remember(const peer_t *peer) {
+    adapt_memo_t *memo = NULL;
+    for (size_t i = 0; i < ESPNOW_LINK_ADAPT_MEMO && memo == NULL; i++) {
+        if (memcmp(rtc_adapt[i].mac, peer->mac, ESP_NOW_ETH_ALEN) == 0) {
+            memo = &rtc_adapt[i];
+        }
+    }
+    if (memo == NULL) {
+        memo = &rtc_adapt[rtc_adapt_next % ESPNOW_LINK_ADAPT_MEMO];
+        rtc_adapt_next = (rtc_adapt_next + 1) % ESPNOW_LINK_ADAPT_MEMO;
+        memcpy(memo->mac, peer->mac, ESP_NOW_ETH_ALEN);
+    }
+    memo->rate = peer->rate;
+    memo->power = peer->power;
+    memo->rssi_x8 = peer->rssi_x8;
+}
+
+/**
+ * @brief Smooth the RSSI of a frame into its sender's estimate; link task
+ */
+static void adapt_note_rssi(const uint8_t *mac, int8_t rssi) {
+    peer_t *peer = rssi < 0 ? find_peer(mac) : NULL;
+    if (peer == NULL) {
+        return;
+    }
+    int16_t x8 = (int16_t)(rssi * 8);
+    peer->rssi_x8 = peer->rssi_x8 == 0 ? x8 : (int16_t)(peer->rssi_x8 + (x8 - peer->rssi_x8) / 8);
+}
+
+esp_err_t espnow_link_parse_mac(const char *str, uint8_t *mac) {
+    unsigned int b[ESP_NOW_ETH_ALEN];
+    char end;
+    if (str == NULL ||
+        sscanf(str, "%2x:%2x:%2x:%2x:%2x:%2x%c", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &end) != 6) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool zero = true;
+    for (size_t i = 0; i < ESP_NOW_ETH_ALEN; i++) {
+        mac[i] = (uint8_t)b[i];
+        zero = zero && mac[i] == 0;
+    }
+    return zero ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+esp_err_t espnow_link_init(espnow_link_rx_t rx) {
+    if (started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t pending[ESPNOW_KEY_LEN];
+    nvs_load_espnow_active_key(keys[KEY_CURRENT]);
+    nvs_load_espnow_pending_key(pending);
+
+    rx_handler = rx;
+#if FAULT_INJECT != 0
+    fault_holding = false;                      // Frames held when the link last stopped are lost with it
+    memset(fault_due_us, 0, sizeof(fault_due_us));
+#endif
+    rx_slots = malloc(ESPNOW_LINK_RX_SLOTS * sizeof(rx_item_t));
+    if (rx_slots != NULL) {
+        spsc_ring_init(&rx_ring, rx_slots, sizeof(rx_item_t), ESPNOW_LINK_RX_SLOTS);
+    }
+    tx_ring = xRingbufferCreate(ESPNOW_LINK_TX_RING_BYTES, RINGBUF_TYPE_NOSPLIT);
+    inject_ring = xRingbufferCreate(ESPNOW_LINK_INJECT_RING_BYTES, RINGBUF_TYPE_NOSPLIT);
+    inject_pending = 0;
+    send_result = xQueueCreate(1, sizeof(bool));
+    send_mutex = xSemaphoreCreateMutex();
+    stopped_sem = xSemaphoreCreateBinary();
+    if (rx_slots == NULL || tx_ring == NULL || inject_ring == NULL || send_result == NULL || send_mutex == NULL || stopped_sem == NULL ||
+        static_task_create(link_task_slot, link_task, ESPNOW_LINK_TASK_NAME, ESPNOW_LINK_TASK_STACK_SIZE, NULL,
+                           ESPNOW_LINK_TASK_PRIORITY, &link_task_handle, ESPNOW_LINK_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to allocate the link");
+        link_task_handle = NULL;
+        espnow_link_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+    started = true;
+
+    esp_err_t err = esp_now_init();
+    if (err == ESP_OK) {
+        err = esp_now_set_pmk((const uint8_t *)ESPNOW_LINK_PMK);
+    }
+    if (err == ESP_OK) {
+        err = esp_now_register_recv_cb(recv_cb);
+    }
+    if (err == ESP_OK) {
+        err = esp_now_register_send_cb(send_cb);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ESP-NOW start failed: %s", esp_err_to_name(err));
+        espnow_link_deinit();
+        return err;
+    }
+    if (ESPNOW_LINK_LR != 0) {
+        // b/g/n stays on, so normal peers and the uplink are unaffected
+        esp_err_t lr_err = esp_wifi_set_protocol(WIFI_IF_STA, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G |
+                                                                   WIFI_PROTOCOL_11N | WIFI_PROTOCOL_LR);
+        lr_ready = lr_err == ESP_OK;
+        if (!lr_ready) {
+            ESP_LOGW(TAG, "No Long Range mode: %s", esp_err_to_name(lr_err));
+        }
+    }
+
+    if (key_is_set(pending) && memcmp(pending, keys[KEY_CURRENT], ESP_NOW_KEY_LEN) != 0) {
+        start_rotation(pending, memcmp(pending, rtc_rotation_key, ESP_NOW_KEY_LEN) == 0);
+        xTaskNotify(link_task_handle, WAKE_BIT, eSetBits);
+    } else if (!key_is_set(keys[KEY_CURRENT])) {
+        ESP_LOGW(TAG, "No ESP-NOW key stored - peers are unencrypted");
+    }
+    memset(pending, 0, sizeof(pending));
+
+    ESP_LOGI(TAG, "ESP-NOW link up (%s)", key_is_set(keys[KEY_CURRENT]) ? "encrypted" : "open");
+    return ESP_OK;
+}
+
+esp_err_t espnow_link_add_peer(const uint8_t *mac) {
+    if (!started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(send_mutex, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (find_peer(mac) == NULL) {
+        peer_t *slot = NULL;
+        for (size_t i = 0; i < ESPNOW_LINK_MAX_PEERS && slot == NULL; i++) {
+            if (!peers[i].used) {
+                slot = &peers[i];
+            }
+        }
+        if (slot == NULL) {
+            err = ESP_ERR_NO_MEM;
+        } else {
+            memcpy(slot->mac, mac, ESP_NOW_ETH_ALEN);
+            slot->lr = false;
+            slot->lr_wanted = false;
+            // A staged rotation moves peers when told, so a new one starts where the others did
+            bool staged = rotating && ESPNOW_LINK_KEY_STAGED != 0 && !is_broadcast(mac);
+            err = apply_peer_key(slot, staged ? KEY_PREVIOUS : KEY_CURRENT, true);
+            if (err == ESP_OK) {
+                adapt_start(slot);
+            }
+            slot->used = err == ESP_OK;
+        }
+    }
+    xSemaphoreGive(send_mutex);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot add peer " MACSTR ": %s", MAC2STR(mac), esp_err_to_name(err));
+    }
+    return err;
+}
+
+bool espnow_link_encrypted(void) {
+    return started && key_is_set(keys[KEY_CURRENT]);
+}
+
+esp_err_t espnow_link_send(const uint8_t *mac, const uint8_t *data, size_t len) {
+    if (!started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (len == 0 || len > ESP_NOW_MAX_DATA_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    xSemaphoreTake(send_mutex, portMAX_DELAY);
+    power_profile_acquire(POWER_LOCK_RADIO);   // Awake until the send callback
+    peer_t *peer = find_peer(mac);
+    if (peer != NULL && peer->lr != peer->lr_wanted) {
+        lr_apply(peer);
+    }
+    bool adapt = ESPNOW_LINK_ADAPT != 0 && peer != NULL && !is_broadcast(mac);
+    bool weaker = adapt && peer->power < ESPNOW_LINK_ADAPT_POWER_MAX &&
+                  esp_wifi_set_max_tx_power(peer->power) == ESP_OK;
+    esp_err_t err = send_once(mac, data, len);
+    bool fallback = false;
+    if (err == ESP_FAIL && rotating && ESPNOW_LINK_KEY_STAGED == 0 && peer != NULL &&
+        apply_peer_key(peer, peer->key == KEY_CURRENT ? KEY_PREVIOUS : KEY_CURRENT, false) == ESP_OK) {
+        // Inside the window the peer may not have switched yet (or already has)
+        err = send_once(mac, data, len);
+        fallback = err == ESP_OK;
+    }
+    if (weaker) {
+        esp_wifi_set_max_tx_power(ESPNOW_LINK_ADAPT_POWER_MAX);
+    }
+    if (adapt && (err == ESP_OK || err == ESP_FAIL || err == ESP_ERR_TIMEOUT)) {
+        adapt_result(peer, err == ESP_OK);
+    }
+    power_profile_release(POWER_LOCK_RADIO);
+    xSemaphoreGive(send_mutex);
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.tx_frames++;
+    if (err != ESP_OK) {
+        stats.tx_failed++;
+    }
+    if (fallback) {
+        stats.key_fallbacks++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    return err;
+}
+
+esp_err_t espnow_link_inject(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi, uint32_t wait_ms) {
+    if (!started || link_task_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (mac == NULL || data == NULL || len == 0 || len > ESP_NOW_MAX_DATA_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Only as much of the slot layout as the frame fills
+    rx_item_t *item = NULL;
+    size_t size = offsetof(rx_item_t, data) + len;
+    if (xRingbufferSendAcquire(inject_ring, (void **)&item, size, pdMS_TO_TICKS(wait_ms)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    memcpy(item->mac, mac, ESP_NOW_ETH_ALEN);
+    item->rssi = rssi;
+    item->len = (uint8_t)len;
+    memcpy(item->data, data, len);
+    __atomic_add_fetch(&inject_pending, 1, __ATOMIC_RELAXED);
+    xRingbufferSendComplete(inject_ring, item);
+    xTaskNotify(link_task_handle, WAKE_BIT, eSetBits);
+    return ESP_OK;
+}
+
+size_t espnow_link_injected_pending(void) {
+    return __atomic_load_n(&inject_pending, __ATOMIC_RELAXED);
+}
+
+esp_err_t espnow_link_rotate_key(void) {
+    if (!started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t pending[ESPNOW_KEY_LEN];
+    nvs_load_espnow_pending_key(pending);
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if (key_is_set(pending) && memcmp(pending, keys[KEY_CURRENT], ESP_NOW_KEY_LEN) != 0) {
+        xSemaphoreTake(send_mutex, portMAX_DELAY);
+        start_rotation(pending, false);
+        xSemaphoreGive(send_mutex);
+        xTaskNotify(link_task_handle, WAKE_BIT, eSetBits);
+        err = ESP_OK;
+    }
+    memset(pending, 0, sizeof(pending));
+    return err;
+}
+
+bool espnow_link_rotation(uint32_t *fingerprint) {
+    bool active = started && rotating;
+    if (fingerprint != NULL) {
+        *fingerprint = active ? key_fingerprint : 0;
+    }
+    return active;
+}
+
+esp_err_t espnow_link_peer_switch_key(const uint8_t *mac, bool finish) {
+    if (!started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(send_mutex, portMAX_DELAY);
+    peer_t *peer = find_peer(mac);
+    esp_err_t err = !rotating ? ESP_ERR_INVALID_STATE : peer == NULL ? ESP_ERR_NOT_FOUND : ESP_OK;
+    bool moved = false;
+    uint32_t us = 0;
+    if (err == ESP_OK && peer->key != KEY_CURRENT) {
+        int64_t t0 = esp_timer_get_time();
+        err = apply_peer_key(peer, KEY_CURRENT, false);
+        us = (uint32_t)(esp_timer_get_time() - t0);
+        moved = err == ESP_OK;
+    }
+    bool done = err == ESP_OK && finish;
+    for (size_t i = 0; i < ESPNOW_LINK_MAX_PEERS && done; i++) {
+        done = !peers[i].used || is_broadcast(peers[i].mac) || peers[i].key == KEY_CURRENT;
+    }
+    if (done) {
+        drop_previous_key();
+    }
+    xSemaphoreGive(send_mutex);
+
+    if (moved) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.key_switches++;
+        stats.key_switch_us = us;
+        if (us > stats.key_switch_us_max) {
+            stats.key_switch_us_max = us;
+        }
+        portEXIT_CRITICAL(&stats_lock);
+        ESP_LOGI(TAG, "Peer " MACSTR " moved to the new key in %lu us", MAC2STR(mac), (unsigned long)us);
+    }
+    if (done) {
+        save_rotation();
+    }
+    return err;
+}
+
+uint8_t espnow_link_peer_epoch(const uint8_t *mac) {
+    if (!started) {
+        return ESPNOW_LINK_EPOCH_NONE;
+    }
+    xSemaphoreTake(send_mutex, portMAX_DELAY);
+    peer_t *peer = find_peer(mac);
+    uint8_t epoch = peer == NULL ? ESPNOW_LINK_EPOCH_NONE : peer->key == KEY_CURRENT ? key_epoch : key_epoch - 1;
+    xSemaphoreGive(send_mutex);
+    return epoch;
+}
+
+esp_err_t espnow_link_peer_set_lr(const uint8_t *mac, bool lr) {
+    if (!started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (lr && !lr_ready) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    // Read without the send mutex, as adapt_note_rssi() does; the send that applies it holds it
+    peer_t *peer = is_broadcast(mac) ? NULL : find_peer(mac);
+    if (peer == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    peer->lr_wanted = lr;
+    return ESP_OK;
+}
+
+esp_err_t espnow_link_peer_radio(const uint8_t *mac, espnow_link_radio_t *radio) {
+    if (!started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(send_mutex, portMAX_DELAY);
+    peer_t *peer = find_peer(mac);
+    if (peer != NULL) {
+        radio->rate = link_rates[peer->rate].name;
+        radio->power = peer->power;
+        radio->rssi = (int8_t)(peer->rssi_x8 / 8);
+        radio->margin_db = peer->rssi_x8 != 0 ? (int8_t)adapt_margin_db(peer, peer->rate, peer->power) : 0;
+        radio->lr = peer->lr;
+    }
+    xSemaphoreGive(send_mutex);
+    return peer != NULL ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void espnow_link_get_stats(espnow_link_stats_t *s) {
+    portENTER_CRITICAL(&stats_lock);
+    *s = stats;
+    portEXIT_CRITICAL(&stats_lock);
+    s->rx_dropped = rx_dropped;
+    s->rx_high_water = rx_slots != NULL ? rx_ring.high_water : 0;
+    s->rotating = rotating;
+}
+
+esp_err_t espnow_link_deinit(void) {
+    if (started) {
+        esp_now_unregister_recv_cb();
+        esp_now_unregister_send_cb();
+        esp_now_deinit();
+    }
+    if (link_task_handle != NULL) {
+        xTaskNotify(link_task_handle, STOP_BIT, eSetBits);
+        if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(STOP_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGW(TAG, "Link task did not stop within %d ms", STOP_TIMEOUT_MS);
+            return ESP_ERR_TIMEOUT;
+        }
+        link_task_handle = NULL;
+    }
+
+    free(rx_slots);
+    rx_slots = NULL;
+    if (tx_ring != NULL) {
+        vRingbufferDelete(tx_ring);
+        tx_ring = NULL;
+    }
+    if (inject_ring != NULL) {
+        vRingbufferDelete(inject_ring);
+        inject_ring = NULL;
+    }
+    if (send_result != NULL) {
+        vQueueDelete(send_result);
+        send_result = NULL;
+    }
+    if (send_mutex != NULL) {
+        vSemaphoreDelete(send_mutex);
+        send_mutex = NULL;
+    }
+    if (stopped_sem != NULL) {
+        vSemaphoreDelete(stopped_sem);
+        stopped_sem = NULL;
+    }
+    memset(peers, 0, sizeof(peers));
+    memset(keys, 0, sizeof(keys));
+    rotating = false;
+    lr_ready = false;
+    key_epoch = 0;
+    key_fingerprint = 0;
+    started = false;
+    return ESP_OK;
+}
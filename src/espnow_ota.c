@@ -0,0 +1,1066 @@
+/**
+ * @file espnow_ota.c
+ * @brief Node firmware distributed by the gateway over ESP-NOW, to several nodes in one pass
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "espnow_ota.h"
+#include "espnow_link.h"
+#include "flash_io.h"
+#include "long_op.h"
+#include "ota_manager.h"
+#include "power_profile.h"
+#include "static_mem.h"
+#include "version.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_app_desc.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_ota_ops.h"
+#include "esp_private/esp_clk.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register espnow_ota.c version
+REGISTER_VERSION(EspnowOta, "1.0.0", "2026-10-15");
+
+static const char *TAG = "ESPNOW_OTA";
+
+#define IMAGE_NVS_NAMESPACE "espnow_ota"
+#define IMAGE_NVS_KEY "image"
+#define ELF_PREFIX_LEN 8                        // Of the app's ELF SHA-256, in a QUERY
+#define MAX_BLOCKS ((OTA_MAX_FIRMWARE_SIZE + ESPNOW_OTA_BLOCK_SIZE - 1) / ESPNOW_OTA_BLOCK_SIZE)
+
+#define QUERY_LEN (2 + ELF_PREFIX_LEN)
+#define OFFER_LEN 44
+#define JOIN_LEN 4
+#define BLOCK_HEADER_LEN 6
+#define POLL_LEN 6
+#define REPORT_LEN 14
+#define END_LEN 4
+#define DONE_LEN 5
+
+_Static_assert(BLOCK_HEADER_LEN + ESPNOW_OTA_BLOCK_SIZE <= 250, "a BLOCK must fit one ESP-NOW frame");
+_Static_assert(MAX_BLOCKS <= UINT16_MAX, "block indexes are 16 bits");
+
+#define WAKE_BIT (1u << 0)                      // Gateway task notification: a node's state changed
+#define STOP_BIT (1u << 31)                     // Gateway task notification: exit
+#define STOP_TIMEOUT_MS 2000
+
+#define EVT_OFFER (1u << 0)                     // Node events, set by the receive handler
+#define EVT_POLL (1u << 1)
+#define EVT_END (1u << 2)
+
+static const uint8_t broadcast_mac[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+/**
+ * @brief The image being served, as stored in NVS
+ */
+typedef struct {
+    char label[17];                             // App partition holding it
+    uint32_t size;
+    uint8_t sha256[32];                         // esp_partition_get_sha256() of the image
+    uint8_t elf[ELF_PREFIX_LEN];                // Nodes running this need nothing
+    char version[32];
+} staged_image_t;
+
+/**
+ * @brief Where a node stands in the gateway's current session
+ */
+typedef enum {
+    NODE_FREE = 0,
+    NODE_OFFER_DUE,                             // Asked; the task sends it the OFFER
+    NODE_OFFERED,
+    NODE_JOINED,
+    NODE_DONE,                                  // Sent DONE; result says how it went
+    NODE_DROPPED,
+} node_state_t;
+
+/**
+ * @brief A node on the gateway; state, result and the REPORT fields under lock
+ */
+typedef struct {
+    uint8_t mac[6];
+    uint8_t state;                              // node_state_t
+    uint8_t result;                             // ESPNOW_OTA_RESULT_* from its DONE
+    bool peered;                                // Added as an ESP-NOW peer (task only)
+    uint8_t silent;                             // POLLs unanswered in a row (task only)
+    bool reported;                              // A REPORT came in since the last POLL
+    uint16_t report_base;
+    uint64_t missing;
+} ota_node_t;
+
+/**
+ * @brief An offer held by a node; RTC_DATA_ATTR, so it survives deep sleep until the start
+ */
+typedef struct {
+    bool valid;
+    uint16_t session;
+    uint32_t size;
+    uint64_t start_us;                          // RTC clock
+    uint8_t sha256[32];
+} node_offer_t;
+
+// Gateway
+static staged_image_t image;
+static const esp_partition_t *image_part = NULL;
+static volatile bool serving = false;           // The receive handler takes gateway frames
+static volatile bool stopping = false;
+static uint16_t session = 0;                    // lock
+static bool gathering = false;                  // An OFFER went out; the session starts at start_us
+static bool joining = false;                    // JOINs accepted; lock
+static int64_t start_us = 0;
+static ota_node_t nodes[ESPNOW_OTA_MAX_NODES];
+static uint8_t *window_buf = NULL;              // One window of the image, during a session
+static TaskHandle_t task_handle = NULL;
+static SemaphoreHandle_t stopped_sem = NULL;
+static espnow_ota_stats_t stats;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Node
+static RTC_DATA_ATTR node_offer_t rtc_offer;
+static uint8_t gateway[6];
+static bool node_ready = false;
+static EventGroupHandle_t node_events = NULL;
+static StaticEventGroup_t node_events_buf;
+static SemaphoreHandle_t write_mutex = NULL;    // Held by the link task for each block write
+static bool receiving = false;                  // write_mutex, with the fields below
+static esp_ota_handle_t ota_handle = 0;
+static const esp_partition_t *ota_part = NULL;  // Partition ota_handle writes to
+static uint8_t *received_map = NULL;            // Bit i: block i is in flash
+static uint32_t node_blocks = 0;
+static uint32_t received_blocks = 0;
+static esp_err_t write_err = ESP_OK;
+static uint16_t poll_base = 0;                  // lock
+
+// =============================
+// Function Prototypes
+// =============================
+static void put_u16(uint8_t *p, uint16_t v);
+static void put_u32(uint8_t *p, uint32_t v);
+static uint16_t get_u16(const uint8_t *p);
+static uint32_t get_u32(const uint8_t *p);
+static uint32_t block_count(uint32_t size);
+static uint64_t window_mask(uint32_t n);
+static void gateway_receive(const uint8_t *mac, const uint8_t *data, size_t len);
+static ota_node_t *find_node(const uint8_t *mac, bool create);
+static uint8_t node_state(const ota_node_t *node);
+static void set_node_state(ota_node_t *node, node_state_t state);
+static uint32_t count_nodes(node_state_t state);
+static esp_err_t send_to(ota_node_t *node, const uint8_t *frame, size_t len);
+static void wait_wake(TickType_t ticks);
+static void send_offers(void);
+static void broadcast_blocks(uint32_t base, uint32_t n, uint64_t bits, bool resend);
+static bool wait_report(ota_node_t *node, uint32_t base);
+static uint64_t poll_nodes(uint32_t base, uint32_t n, bool *unanswered);
+static void drop_nodes(const char *why, uint32_t base, bool all);
+static void send_window(uint32_t base, uint32_t blocks);
+static void finish_session(void);
+static void run_session(void);
+static void end_session(void);
+static void gateway_task(void *arg);
+static void node_receive(const uint8_t *mac, const uint8_t *data, size_t len);
+static void store_offer(const uint8_t *data);
+static void write_block(uint32_t index, const uint8_t *data, size_t len);
+static esp_err_t send_report(uint16_t offer_session);
+static esp_err_t receive_image(const node_offer_t *offer);
+static esp_err_t finish_image(const esp_partition_t *part, esp_ota_handle_t handle, const node_offer_t *offer);
+
+// =============================
+// Function Definitions
+// =============================
+
+/** @brief Store little-endian */
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+/** @brief Store little-endian */
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+/** @brief Load little-endian */
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/** @brief Load little-endian */
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+/** @brief Blocks in an image of size bytes */
+static uint32_t block_count(uint32_t size) {
+    return (size + ESPNOW_OTA_BLOCK_SIZE - 1) / ESPNOW_OTA_BLOCK_SIZE;
+}
+
+/** @brief The low n bits of a window bitmap */
+static uint64_t window_mask(uint32_t n) {
+    return n >= ESPNOW_OTA_WINDOW ? UINT64_MAX : (1ull << n) - 1;
+}
+
+/**
+ * @brief Link task: record what a node asked for and wake the gateway task, which does the sending
+ */
+static void gateway_receive(const uint8_t *mac, const uint8_t *data, size_t len) {
+    if (!serving || len < JOIN_LEN) {
+        return;
+    }
+
+    bool wake = false;
+    portENTER_CRITICAL(&lock);
+    if (data[1] == ESPNOW_OTA_KIND_QUERY) {
+        // A node already on the image, or in the session, needs no OFFER
+        ota_node_t *node = len >= QUERY_LEN && memcmp(data + 2, image.elf, ELF_PREFIX_LEN) != 0 ?
+                           find_node(mac, true) : NULL;
+        if (node != NULL && (node->state == NODE_FREE || node->state == NODE_OFFERED)) {
+            node->state = NODE_OFFER_DUE;
+            wake = true;
+        }
+    } else if (get_u16(data + 2) == session) {
+        ota_node_t *node = find_node(mac, false);
+        if (node == NULL) {
+            // Not in this session
+        } else if (data[1] == ESPNOW_OTA_KIND_JOIN && node->state == NODE_OFFERED && joining) {
+            node->state = NODE_JOINED;
+            wake = true;
+        } else if (data[1] == ESPNOW_OTA_KIND_REPORT && len >= REPORT_LEN && node->state == NODE_JOINED) {
+            node->report_base = get_u16(data + 4);
+            node->missing = get_u32(data + 6) | ((uint64_t)get_u32(data + 10) << 32);
+            node->reported = true;
+            wake = true;
+        } else if (data[1] == ESPNOW_OTA_KIND_DONE && len >= DONE_LEN && node->state == NODE_JOINED) {
+            node->state = NODE_DONE;
+            node->result = data[4];
+            wake = true;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (wake) {
+        xTaskNotify(task_handle, WAKE_BIT, eSetBits);
+    }
+}
+
+/**
+ * @brief Table entry for mac, or a new one if create; call under lock
+ */
+static ota_node_t *find_node(const uint8_t *mac, bool create) {
+    ota_node_t *free_slot = NULL;
+    for (size_t i = 0; i < ESPNOW_OTA_MAX_NODES; i++) {
+        if (nodes[i].state == NODE_FREE) {
+            free_slot = free_slot == NULL ? &nodes[i] : free_slot;
+        } else if (memcmp(nodes[i].mac, mac, sizeof(nodes[i].mac)) == 0) {
+            return &nodes[i];
+        }
+    }
+    if (!create || free_slot == NULL) {
+        return NULL;
+    }
+    memset(free_slot, 0, sizeof(*free_slot));
+    memcpy(free_slot->mac, mac, sizeof(free_slot->mac));
+    return free_slot;
+}
+
+static uint8_t node_state(const ota_node_t *node) {
+    portENTER_CRITICAL(&lock);
+    uint8_t state = node->state;
+    portEXIT_CRITICAL(&lock);
+    return state;
+}
+
+static void set_node_state(ota_node_t *node, node_state_t state) {
+    portENTER_CRITICAL(&lock);
+    node->state = state;
+    portEXIT_CRITICAL(&lock);
+}
+
+static uint32_t count_nodes(node_state_t state) {
+    uint32_t n = 0;
+    portENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < ESPNOW_OTA_MAX_NODES; i++) {
+        n += nodes[i].state == state;
+    }
+    portEXIT_CRITICAL(&lock);
+    return n;
+}
+
+/**
+ * @brief Unicast to a node, adding it as a peer first if needed; gateway task only
+ */
+static esp_err_t send_to(ota_node_t *node, const uint8_t *frame, size_t len) {
+    if (!node->peered) {
+        node->peered = espnow_link_add_peer(node->mac) == ESP_OK;
+    }
+    return node->peered ? espnow_link_send(node->mac, frame, len) : ESP_ERR_NO_MEM;
+}
+
+/**
+ * @brief Sleep until the receive handler wakes the task, the timeout, or a stop
+ */
+static void wait_wake(TickType_t ticks) {
+    uint32_t bits = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &bits, ticks);
+    if (bits & STOP_BIT) {
+        stopping = true;
+    }
+}
+
+/**
+ * @brief OFFER the session to every node that asked; the first one sets its start
+ */
+static void send_offers(void) {
+    for (size_t i = 0; i < ESPNOW_OTA_MAX_NODES && !stopping; i++) {
+        ota_node_t *node = &nodes[i];
+        int64_t now = esp_timer_get_time();
+        if (node_state(node) != NODE_OFFER_DUE || (gathering && now >= start_us)) {
+            continue;                           // Too late for this session; offered for the next
+        }
+
+        portENTER_CRITICAL(&lock);
+        if (!gathering) {
+            session++;
+            joining = true;
+        }
+        uint16_t s = session;
+        portEXIT_CRITICAL(&lock);
+        if (!gathering) {
+            gathering = true;
+            start_us = now + (int64_t)ESPNOW_OTA_GATHER_MS * 1000;
+            ESP_LOGI(TAG, "Node " MACSTR " runs other firmware - session %04x starts in %d s", MAC2STR(node->mac),
+                     s, ESPNOW_OTA_GATHER_MS / 1000);
+        }
+
+        uint8_t frame[OFFER_LEN];
+        frame[0] = ESPNOW_OTA_MAGIC;
+        frame[1] = ESPNOW_OTA_KIND_OFFER;
+        put_u16(frame + 2, s);
+        put_u32(frame + 4, image.size);
+        put_u32(frame + 8, (uint32_t)((start_us - now) / 1000));
+        memcpy(frame + 12, image.sha256, sizeof(image.sha256));
+        esp_err_t err = send_to(node, frame, sizeof(frame));
+
+        // Unreachable: it asks again after its next batch
+        set_node_state(node, err == ESP_OK ? NODE_OFFERED : NODE_FREE);
+        if (err == ESP_OK) {
+            portENTER_CRITICAL(&lock);
+            stats.offers++;
+            portEXIT_CRITICAL(&lock);
+        }
+    }
+}
+
+/**
+ * @brief Broadcast the blocks of a window whose bits are set, in short bursts
+ *
+ * Each send waits for its send callback; the pause after a burst lets the
+ * nodes' link tasks write what they received before the receive ring fills.
+ */
+static void broadcast_blocks(uint32_t base, uint32_t n, uint64_t bits, bool resend) {
+    uint8_t frame[BLOCK_HEADER_LEN + ESPNOW_OTA_BLOCK_SIZE];
+    frame[0] = ESPNOW_OTA_MAGIC;
+    frame[1] = ESPNOW_OTA_KIND_BLOCK;
+    put_u16(frame + 2, session);
+
+    uint32_t sent = 0;
+    for (uint32_t i = 0; i < n && !stopping; i++) {
+        if (!(bits & (1ull << i))) {
+            continue;
+        }
+        size_t offset = (size_t)(base + i) * ESPNOW_OTA_BLOCK_SIZE;
+        size_t len = image.size - offset < ESPNOW_OTA_BLOCK_SIZE ? image.size - offset : ESPNOW_OTA_BLOCK_SIZE;
+        put_u16(frame + 4, (uint16_t)(base + i));
+        memcpy(frame + BLOCK_HEADER_LEN, window_buf + (size_t)i * ESPNOW_OTA_BLOCK_SIZE, len);
+        espnow_link_send(broadcast_mac, frame, BLOCK_HEADER_LEN + len);
+        if (++sent % ESPNOW_OTA_BURST == 0) {
+            vTaskDelay(1);
+        }
+    }
+
+    portENTER_CRITICAL(&lock);
+    if (resend) {
+        stats.blocks_resent += sent;
+    } else {
+        stats.blocks_sent += sent;
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+/**
+ * @brief Wait for the node's REPORT on the window at base
+ */
+static bool wait_report(ota_node_t *node, uint32_t base) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)ESPNOW_OTA_POLL_WAIT_MS * 1000;
+    while (!stopping) {
+        portENTER_CRITICAL(&lock);
+        bool reported = node->reported && node->report_base == base;
+        portEXIT_CRITICAL(&lock);
+        int64_t left_us = deadline - esp_timer_get_time();
+        if (reported || left_us <= 0) {
+            return reported;
+        }
+        wait_wake(pdMS_TO_TICKS(left_us / 1000) + 1);
+    }
+    return false;
+}
+
+/**
+ * @brief POLL every joined node on the window at base
+ *
+ * @param unanswered Set if any node did not REPORT
+ * @return uint64_t The blocks some node misses
+ */
+static uint64_t poll_nodes(uint32_t base, uint32_t n, bool *unanswered) {
+    uint64_t missing = 0;
+    *unanswered = false;
+    for (size_t i = 0; i < ESPNOW_OTA_MAX_NODES && !stopping; i++) {
+        ota_node_t *node = &nodes[i];
+        if (node_state(node) != NODE_JOINED) {
+            continue;
+        }
+
+        portENTER_CRITICAL(&lock);
+        node->reported = false;
+        portEXIT_CRITICAL(&lock);
+        uint8_t frame[POLL_LEN];
+        frame[0] = ESPNOW_OTA_MAGIC;
+        frame[1] = ESPNOW_OTA_KIND_POLL;
+        put_u16(frame + 2, session);
+        put_u16(frame + 4, (uint16_t)base);
+        if (send_to(node, frame, sizeof(frame)) != ESP_OK || !wait_report(node, base)) {
+            *unanswered = true;
+            if (++node->silent >= ESPNOW_OTA_SILENT_POLLS) {
+                ESP_LOGW(TAG, "Node " MACSTR " stopped answering at block %lu - dropped", MAC2STR(node->mac),
+                         (unsigned long)base);
+                set_node_state(node, NODE_DROPPED);
+            }
+            continue;
+        }
+        node->silent = 0;
+        portENTER_CRITICAL(&lock);
+        missing |= node->missing & window_mask(n);
+        portEXIT_CRITICAL(&lock);
+    }
+    return missing;
+}
+
+/**
+ * @brief Drop the joined nodes that still miss blocks of the window at base (all: every joined node)
+ */
+static void drop_nodes(const char *why, uint32_t base, bool all) {
+    for (size_t i = 0; i < ESPNOW_OTA_MAX_NODES; i++) {
+        ota_node_t *node = &nodes[i];
+        portENTER_CRITICAL(&lock);
+        bool drop = node->state == NODE_JOINED &&
+                    (all || !node->reported || node->report_base != base || node->missing != 0);
+        if (drop) {
+            node->state = NODE_DROPPED;
+        }
+        portEXIT_CRITICAL(&lock);
+        if (drop) {
+            ESP_LOGW(TAG, "Node " MACSTR " dropped at block %lu: %s", MAC2STR(node->mac), (unsigned long)base, why);
+        }
+    }
+}
+
+/**
+ * @brief One window: broadcast it, then resend what the nodes report missing until none does
+ */
+static void send_window(uint32_t base, uint32_t blocks) {
+    uint32_t n = blocks - base < ESPNOW_OTA_WINDOW ? blocks - base : ESPNOW_OTA_WINDOW;
+    size_t offset = (size_t)base * ESPNOW_OTA_BLOCK_SIZE;
+    size_t bytes = (size_t)n * ESPNOW_OTA_BLOCK_SIZE;
+    if (bytes > image.size - offset) {
+        bytes = image.size - offset;
+    }
+    esp_err_t err = flash_io_read(FLASH_IO_OTA, image_part, offset, window_buf, bytes);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Reading the image at %u failed: %s", (unsigned)offset, esp_err_to_name(err));
+        drop_nodes("image unreadable", base, true);
+        return;
+    }
+
+    uint64_t resend = window_mask(n);
+    for (uint32_t round = 0; round <= ESPNOW_OTA_ROUNDS && !stopping; round++) {
+        if (resend != 0) {
+            broadcast_blocks(base, n, resend, round > 0);
+        }
+        bool unanswered;
+        resend = poll_nodes(base, n, &unanswered);
+        if (resend == 0 && !unanswered) {
+            return;                             // Every joined node has the window
+        }
+    }
+    drop_nodes("blocks still missing", base, false);
+}
+
+/**
+ * @brief END to every node that has the whole image, and wait for their DONEs
+ */
+static void finish_session(void) {
+    for (size_t i = 0; i < ESPNOW_OTA_MAX_NODES && !stopping; i++) {
+        ota_node_t *node = &nodes[i];
+        if (node_state(node) != NODE_JOINED) {
+            continue;
+        }
+        uint8_t frame[END_LEN];
+        frame[0] = ESPNOW_OTA_MAGIC;
+        frame[1] = ESPNOW_OTA_KIND_END;
+        put_u16(frame + 2, session);
+        if (send_to(node, frame, sizeof(frame)) != ESP_OK) {
+            ESP_LOGW(TAG, "Node " MACSTR " missed the END - dropped", MAC2STR(node->mac));
+            set_node_state(node, NODE_DROPPED);
+        }
+    }
+
+    int64_t deadline = esp_timer_get_time() + (int64_t)ESPNOW_OTA_DONE_WAIT_MS * 1000;
+    int64_t left_us;
+    while (!stopping && count_nodes(NODE_JOINED) > 0 && (left_us = deadline - esp_timer_get_time()) > 0) {
+        wait_wake(pdMS_TO_TICKS(left_us / 1000) + 1);
+    }
+}
+
+/**
+ * @brief Wait for the offered nodes to JOIN, then send them the image window by window
+ */
+static void run_session(void) {
+    int64_t t0 = esp_timer_get_time();
+    int64_t join_end = t0 + (int64_t)ESPNOW_OTA_JOIN_MS * 1000;
+    int64_t left_us;
+    while (!stopping && count_nodes(NODE_OFFERED) > 0 && (left_us = join_end - esp_timer_get_time()) > 0) {
+        wait_wake(pdMS_TO_TICKS(left_us / 1000) + 1);
+    }
+    portENTER_CRITICAL(&lock);
+    joining = false;
+    portEXIT_CRITICAL(&lock);
+
+    uint32_t joined = count_nodes(NODE_JOINED);
+    if (stopping || joined == 0) {
+        ESP_LOGW(TAG, "Session %04x: no node joined", session);
+        return;
+    }
+    uint32_t blocks = block_count(image.size);
+    window_buf = malloc((size_t)ESPNOW_OTA_WINDOW * ESPNOW_OTA_BLOCK_SIZE);
+    if (window_buf == NULL) {
+        ESP_LOGE(TAG, "Session %04x: no memory for a window", session);
+        drop_nodes("out of memory", 0, true);
+        return;
+    }
+    ESP_LOGI(TAG, "Session %04x: sending %s (%lu bytes, %lu blocks) to %lu nodes", session, image.version,
+             (unsigned long)image.size, (unsigned long)blocks, (unsigned long)joined);
+    portENTER_CRITICAL(&lock);
+    stats.sessions++;
+    portEXIT_CRITICAL(&lock);
+
+    for (uint32_t base = 0; base < blocks && !stopping && count_nodes(NODE_JOINED) > 0; base += ESPNOW_OTA_WINDOW) {
+        send_window(base, blocks);
+    }
+    free(window_buf);
+    window_buf = NULL;
+    finish_session();
+
+    uint32_t session_ms = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+    portENTER_CRITICAL(&lock);
+    stats.last_session_ms = session_ms;
+    portEXIT_CRITICAL(&lock);
+    ESP_LOGI(TAG, "Session %04x done in %lu s", session, (unsigned long)(session_ms / 1000));
+}
+
+/**
+ * @brief Count the outcome of each node and free the table; nodes that asked meanwhile stay for the next session
+ */
+static void end_session(void) {
+    for (size_t i = 0; i < ESPNOW_OTA_MAX_NODES; i++) {
+        ota_node_t *node = &nodes[i];
+        portENTER_CRITICAL(&lock);
+        uint8_t state = node->state;
+        uint8_t result = node->result;
+        if (state == NODE_DONE && result == ESPNOW_OTA_RESULT_OK) {
+            stats.updated++;
+        } else if (state == NODE_DONE) {
+            stats.failed++;
+        } else if (state == NODE_JOINED || state == NODE_DROPPED) {
+            stats.dropped++;
+        }
+        if (state != NODE_OFFER_DUE) {
+            node->state = NODE_FREE;
+        }
+        portEXIT_CRITICAL(&lock);
+
+        if (state == NODE_DONE) {
+            ESP_LOGI(TAG, "Node " MACSTR " %s", MAC2STR(node->mac),
+                     result == ESPNOW_OTA_RESULT_OK ? "updated" : "failed to verify the image");
+        } else if (state == NODE_JOINED) {
+            ESP_LOGW(TAG, "Node " MACSTR " sent no DONE", MAC2STR(node->mac));
+        }
+    }
+    portENTER_CRITICAL(&lock);
+    joining = false;
+    portEXIT_CRITICAL(&lock);
+    gathering = false;
+}
+
+/**
+ * @brief Offer the image to the nodes that ask, and run each session once its start comes
+ */
+static void gateway_task(void *arg) {
+    while (!stopping) {
+        send_offers();
+        int64_t now = esp_timer_get_time();
+        if (gathering && now >= start_us) {
+            run_session();
+            end_session();
+            continue;
+        }
+        wait_wake(gathering ? pdMS_TO_TICKS((start_us - now) / 1000) + 1 : portMAX_DELAY);
+    }
+
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Link task: the gateway's frames to a node
+ */
+static void node_receive(const uint8_t *mac, const uint8_t *data, size_t len) {
+    if (!node_ready || len < JOIN_LEN || memcmp(mac, gateway, sizeof(gateway)) != 0) {
+        return;
+    }
+
+    uint16_t s = get_u16(data + 2);
+    switch (data[1]) {
+    case ESPNOW_OTA_KIND_OFFER:
+        if (len >= OFFER_LEN && !rtc_offer.valid) {
+            store_offer(data);
+            xEventGroupSetBits(node_events, EVT_OFFER);
+        }
+        break;
+    case ESPNOW_OTA_KIND_BLOCK:
+        if (len > BLOCK_HEADER_LEN && rtc_offer.valid && s == rtc_offer.session) {
+            write_block(get_u16(data + 4), data + BLOCK_HEADER_LEN, len - BLOCK_HEADER_LEN);
+        }
+        break;
+    case ESPNOW_OTA_KIND_POLL:
+        if (len >= POLL_LEN && rtc_offer.valid && s == rtc_offer.session) {
+            portENTER_CRITICAL(&lock);
+            poll_base = get_u16(data + 4);
+            portEXIT_CRITICAL(&lock);
+            xEventGroupSetBits(node_events, EVT_POLL);
+        }
+        break;
+    case ESPNOW_OTA_KIND_END:
+        if (rtc_offer.valid && s == rtc_offer.session) {
+            xEventGroupSetBits(node_events, EVT_END);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Keep an OFFER in RTC memory, if the image fits the slot it would go to
+ */
+static void store_offer(const uint8_t *data) {
+    uint32_t size = get_u32(data + 4);
+    uint32_t start_in_ms = get_u32(data + 8);
+    const esp_partition_t *next = esp_ota_get_next_update_partition(NULL);
+    if (size == 0 || size > OTA_MAX_FIRMWARE_SIZE || next == NULL || size > next->size) {
+        ESP_LOGW(TAG, "Offer of a %lu-byte image does not fit - ignored", (unsigned long)size);
+        return;
+    }
+    rtc_offer.session = get_u16(data + 2);
+    rtc_offer.size = size;
+    rtc_offer.start_us = esp_clk_rtc_time() + (uint64_t)start_in_ms * 1000;
+    memcpy(rtc_offer.sha256, data + 12, sizeof(rtc_offer.sha256));
+    rtc_offer.valid = true;
+    ESP_LOGI(TAG, "Firmware update offered: %lu bytes, session %04x starts in %lu s", (unsigned long)size,
+             rtc_offer.session, (unsigned long)(start_in_ms / 1000));
+}
+
+/**
+ * @brief Link task: write a block at its offset, once
+ *
+ * Blocks are written as they arrive rather than through the sequential
+ * esp_ota_write(): resends fill gaps out of order.
+ */
+static void write_block(uint32_t index, const uint8_t *data, size_t len) {
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    size_t offset = (size_t)index * ESPNOW_OTA_BLOCK_SIZE;
+    bool wanted = receiving && write_err == ESP_OK && index < node_blocks &&
+                  !(received_map[index / 8] & (1u << (index % 8))) &&
+                  len == (rtc_offer.size - offset < ESPNOW_OTA_BLOCK_SIZE ? rtc_offer.size - offset
+                                                                          : ESPNOW_OTA_BLOCK_SIZE);
+    if (wanted) {
+        esp_err_t err = flash_io_ota_write_at(ota_part, ota_handle, data, len, offset);
+        if (err == ESP_OK) {
+            received_map[index / 8] |= 1u << (index % 8);
+            received_blocks++;
+        } else {
+            write_err = err;
+        }
+    }
+    xSemaphoreGive(write_mutex);
+}
+
+/**
+ * @brief Answer a POLL with the blocks of its window not yet written
+ */
+static esp_err_t send_report(uint16_t offer_session) {
+    portENTER_CRITICAL(&lock);
+    uint16_t base = poll_base;
+    portEXIT_CRITICAL(&lock);
+
+    uint64_t missing = 0;
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    for (uint32_t i = 0; i < ESPNOW_OTA_WINDOW && base + i < node_blocks; i++) {
+        uint32_t index = base + i;
+        if (!(received_map[index / 8] & (1u << (index % 8)))) {
+            missing |= 1ull << i;
+        }
+    }
+    xSemaphoreGive(write_mutex);
+
+    uint8_t frame[REPORT_LEN];
+    frame[0] = ESPNOW_OTA_MAGIC;
+    frame[1] = ESPNOW_OTA_KIND_REPORT;
+    put_u16(frame + 2, offer_session);
+    put_u16(frame + 4, base);
+    put_u32(frame + 6, (uint32_t)missing);
+    put_u32(frame + 10, (uint32_t)(missing >> 32));
+    return espnow_link_send(gateway, frame, sizeof(frame));
+}
+
+/**
+ * @brief Answer POLLs until the END, or until the gateway goes quiet
+ */
+static esp_err_t receive_image(const node_offer_t *offer) {
+    // The first POLL only follows the JOIN window and the first window's blocks
+    uint64_t now = esp_clk_rtc_time();
+    uint64_t first_us = offer->start_us + (uint64_t)(ESPNOW_OTA_JOIN_MS + ESPNOW_OTA_NODE_IDLE_MS) * 1000;
+    TickType_t wait = pdMS_TO_TICKS(first_us > now ? (first_us - now) / 1000 : ESPNOW_OTA_NODE_IDLE_MS);
+    while (true) {
+        EventBits_t bits = xEventGroupWaitBits(node_events, EVT_POLL | EVT_END, pdTRUE, pdFALSE, wait);
+        if (bits & EVT_END) {
+            return ESP_OK;
+        }
+        if (!(bits & EVT_POLL)) {
+            return ESP_ERR_TIMEOUT;
+        }
+        send_report(offer->session);
+        wait = pdMS_TO_TICKS(ESPNOW_OTA_NODE_IDLE_MS);
+    }
+}
+
+/**
+ * @brief Close the image, check it against the offered hash and make it the boot partition
+ */
+static esp_err_t finish_image(const esp_partition_t *part, esp_ota_handle_t handle, const node_offer_t *offer) {
+    esp_err_t err = esp_ota_end(handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Image did not validate: %s", esp_err_to_name(err));
+        return err;
+    }
+    uint8_t sha256[sizeof(offer->sha256)];
+    err = esp_partition_get_sha256(part, sha256);
+    if (err != ESP_OK || memcmp(sha256, offer->sha256, sizeof(sha256)) != 0) {
+        ESP_LOGE(TAG, "Image SHA-256 differs from the offer");
+        return ESP_ERR_INVALID_CRC;
+    }
+    return esp_ota_set_boot_partition(part);
+}
+
+bool espnow_ota_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    (void)rssi;
+    if (len < 2 || data[0] != ESPNOW_OTA_MAGIC) {
+        return false;
+    }
+    switch (data[1]) {
+    case ESPNOW_OTA_KIND_QUERY:
+    case ESPNOW_OTA_KIND_JOIN:
+    case ESPNOW_OTA_KIND_REPORT:
+    case ESPNOW_OTA_KIND_DONE:
+        gateway_receive(mac, data, len);
+        break;
+    default:
+        node_receive(mac, data, len);
+        break;
+    }
+    return true;
+}
+
+esp_err_t espnow_ota_stage(const esp_partition_t *part, size_t size) {
+    staged_image_t rec = { 0 };
+    esp_app_desc_t desc;
+    if (part == NULL || size == 0 || size > OTA_MAX_FIRMWARE_SIZE ||
+        esp_partition_get_sha256(part, rec.sha256) != ESP_OK ||
+        esp_ota_get_partition_description(part, &desc) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    strlcpy(rec.label, part->label, sizeof(rec.label));
+    rec.size = (uint32_t)size;
+    memcpy(rec.elf, desc.app_elf_sha256, ELF_PREFIX_LEN);
+    strlcpy(rec.version, desc.version, sizeof(rec.version));
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(IMAGE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = flash_io_nvs_set_blob(handle, IMAGE_NVS_KEY, &rec, sizeof(rec));
+    if (err == ESP_OK) {
+        err = flash_io_nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Node firmware %s (%lu bytes) staged in %s", rec.version, (unsigned long)rec.size, rec.label);
+    }
+    return err;
+}
+
+void espnow_ota_unstage(void) {
+    nvs_handle_t handle;
+    if (nvs_open(IMAGE_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_erase_key(handle, IMAGE_NVS_KEY) == ESP_OK) {
+        flash_io_nvs_commit(handle);
+        ESP_LOGI(TAG, "Node firmware unstaged");
+    }
+    nvs_close(handle);
+}
+
+esp_err_t espnow_ota_gateway_start(void) {
+    if (task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    nvs_handle_t handle;
+    size_t len = sizeof(image);
+    esp_err_t err = nvs_open(IMAGE_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_OK) {
+        err = nvs_get_blob(handle, IMAGE_NVS_KEY, &image, &len);
+        nvs_close(handle);
+    }
+    if (err != ESP_OK || len != sizeof(image)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // The slot is shared with the gateway's own updates; the hash says whether it still holds the image
+    uint8_t sha256[sizeof(image.sha256)];
+    image_part = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, image.label);
+    if (image_part == NULL || esp_partition_get_sha256(image_part, sha256) != ESP_OK ||
+        memcmp(sha256, image.sha256, sizeof(sha256)) != 0) {
+        ESP_LOGW(TAG, "Staged node firmware is no longer in %s", image.label);
+        espnow_ota_unstage();
+        return ESP_ERR_NOT_FOUND;
+    }
+    err = espnow_link_add_peer(broadcast_mac);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    memset(nodes, 0, sizeof(nodes));
+    memset(&stats, 0, sizeof(stats));
+    stats.staged = true;
+    stats.size = image.size;
+    strlcpy(stats.version, image.version, sizeof(stats.version));
+    session = (uint16_t)esp_random();           // A node's offer from before a reboot must not match
+    gathering = false;
+    joining = false;
+    stopping = false;
+    serving = true;
+    stopped_sem = xSemaphoreCreateBinary();
+    if (stopped_sem == NULL ||
+        static_task_create(NULL, gateway_task, ESPNOW_OTA_TASK_NAME, ESPNOW_OTA_TASK_STACK_SIZE, NULL,
+                           ESPNOW_OTA_TASK_PRIORITY, &task_handle, TASK_CORE_NET) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the task");
+        task_handle = NULL;
+        espnow_ota_gateway_stop();
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Serving node firmware %s (%lu bytes) from %s", image.version, (unsigned long)image.size,
+             image.label);
+    return ESP_OK;
+}
+
+void espnow_ota_gateway_stop(void) {
+    serving = false;
+    if (task_handle != NULL) {
+        stopping = true;
+        xTaskNotify(task_handle, STOP_BIT, eSetBits);
+        if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(STOP_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGW(TAG, "Task did not stop within %d ms", STOP_TIMEOUT_MS);
+            return;
+        }
+        task_handle = NULL;
+    }
+    if (stopped_sem != NULL) {
+        vSemaphoreDelete(stopped_sem);
+        stopped_sem = NULL;
+    }
+    free(window_buf);
+    window_buf = NULL;
+    stats.staged = false;
+}
+
+void espnow_ota_get_stats(espnow_ota_stats_t *s) {
+    portENTER_CRITICAL(&lock);
+    *s = stats;
+    portEXIT_CRITICAL(&lock);
+}
+
+void espnow_ota_node_init(const uint8_t *gateway_mac) {
+    memcpy(gateway, gateway_mac, sizeof(gateway));
+    if (node_events == NULL) {
+        node_events = xEventGroupCreateStatic(&node_events_buf);
+    }
+    if (write_mutex == NULL) {
+        write_mutex = xSemaphoreCreateMutex();
+    }
+    node_ready = write_mutex != NULL;
+}
+
+esp_err_t espnow_ota_node_query(uint32_t wait_ms) {
+    if (!node_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (rtc_offer.valid) {
+        return ESP_OK;
+    }
+
+    uint8_t frame[QUERY_LEN];
+    frame[0] = ESPNOW_OTA_MAGIC;
+    frame[1] = ESPNOW_OTA_KIND_QUERY;
+    memcpy(frame + 2, esp_app_get_description()->app_elf_sha256, ELF_PREFIX_LEN);
+    xEventGroupClearBits(node_events, EVT_OFFER);
+    esp_err_t err = espnow_link_send(gateway, frame, sizeof(frame));
+    if (err != ESP_OK) {
+        return err;
+    }
+    // Only a gateway serving other firmware answers
+    xEventGroupWaitBits(node_events, EVT_OFFER, pdTRUE, pdFALSE, pdMS_TO_TICKS(wait_ms));
+    return rtc_offer.valid ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+uint32_t espnow_ota_node_wake_in_ms(void) {
+    if (!rtc_offer.valid) {
+        return ESPNOW_OTA_NONE;
+    }
+    uint64_t now = esp_clk_rtc_time();
+    uint64_t early_us = (uint64_t)ESPNOW_OTA_WAKE_EARLY_MS * 1000;
+    if (rtc_offer.start_us <= early_us || now >= rtc_offer.start_us - early_us) {
+        return 0;
+    }
+    return (uint32_t)((rtc_offer.start_us - early_us - now) / 1000);
+}
+
+esp_err_t espnow_ota_node_run(void) {
+    if (!node_ready || !rtc_offer.valid) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    node_offer_t offer = rtc_offer;
+    if (esp_clk_rtc_time() > offer.start_us + (uint64_t)ESPNOW_OTA_JOIN_MS * 1000) {
+        ESP_LOGW(TAG, "Session %04x started without this node", offer.session);
+        rtc_offer.valid = false;
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint32_t blocks = block_count(offer.size);
+    const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+    uint8_t *map = calloc((blocks + 7) / 8, 1);
+    if (part == NULL || map == NULL) {
+        free(map);
+        rtc_offer.valid = false;
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Broadcast blocks are only heard while the radio stays up
+    power_profile_acquire(POWER_LOCK_RADIO);
+    esp_ota_handle_t handle = 0;
+    esp_err_t err = esp_ota_begin(part, OTA_WITH_SEQUENTIAL_WRITES, &handle);
+    if (err == ESP_OK) {
+        // Written at their own offsets, blocks are not erased ahead of by the OTA writer: erase it all first
+        size_t erase = (offer.size + OTA_FLASH_SECTOR_SIZE - 1) / OTA_FLASH_SECTOR_SIZE * OTA_FLASH_SECTOR_SIZE;
+        err = long_op_erase(part, 0, erase, LONG_OP_OTA_ERASE);
+    }
+    if (err == ESP_OK) {
+        xSemaphoreTake(write_mutex, portMAX_DELAY);
+        ota_handle = handle;
+        ota_part = part;
+        received_map = map;
+        node_blocks = blocks;
+        received_blocks = 0;
+        write_err = ESP_OK;
+        receiving = true;
+        xSemaphoreGive(write_mutex);
+
+        uint8_t frame[JOIN_LEN];
+        frame[0] = ESPNOW_OTA_MAGIC;
+        frame[1] = ESPNOW_OTA_KIND_JOIN;
+        put_u16(frame + 2, offer.session);
+        xEventGroupClearBits(node_events, EVT_POLL | EVT_END);
+        err = espnow_link_send(gateway, frame, sizeof(frame));
+    }
+    bool ended = false;
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Joined session %04x: %lu blocks into %s", offer.session, (unsigned long)blocks, part->label);
+        err = receive_image(&offer);
+        ended = err == ESP_OK;
+    }
+
+    // No more blocks once the handle is closed
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    receiving = false;
+    received_map = NULL;
+    uint32_t got = received_blocks;
+    esp_err_t werr = write_err;
+    xSemaphoreGive(write_mutex);
+    if (err == ESP_OK && werr != ESP_OK) {
+        err = werr;
+    }
+    if (err == ESP_OK && got != blocks) {
+        ESP_LOGE(TAG, "END with %lu of %lu blocks", (unsigned long)got, (unsigned long)blocks);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err == ESP_OK) {
+        err = finish_image(part, handle, &offer);
+    } else if (handle != 0) {
+        esp_ota_abort(handle);
+    }
+
+    if (ended) {
+        uint8_t frame[DONE_LEN];
+        frame[0] = ESPNOW_OTA_MAGIC;
+        frame[1] = ESPNOW_OTA_KIND_DONE;
+        put_u16(frame + 2, offer.session);
+        frame[4] = err == ESP_OK ? ESPNOW_OTA_RESULT_OK : ESPNOW_OTA_RESULT_FAILED;
+        espnow_link_send(gateway, frame, sizeof(frame));
+    }
+    rtc_offer.valid = false;
+    power_profile_release(POWER_LOCK_RADIO);
+    free(map);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Firmware from session %04x verified and set to boot", offer.session);
+    }
+    return err;
+}
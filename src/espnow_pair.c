@@ -0,0 +1,404 @@
+/**
+ * @file espnow_pair.c
+ * @brief Automatic ESP-NOW pairing: a node with no server MAC finds its gateway once and keeps it
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "espnow_pair.h"
+#include "espnow_channel.h"
+#include "espnow_link.h"
+#include "nvs_utils.h"
+#include "version.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "esp_wifi.h"
+#include "mbedtls/md.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register espnow_pair.c version
+REGISTER_VERSION(EspnowPair, "1.0.0", "2026-10-15");
+
+static const char *TAG = "ESPNOW_PAIR";
+
+static const uint8_t broadcast_mac[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static uint8_t key[ESPNOW_KEY_LEN];             // espnow_active, loaded when a role starts
+static bool serving = false;                    // Gateway
+static bool seeking = false;                    // Node: a request is out; lock
+static uint32_t nonce = 0;                      // Node: of the request out; lock
+static uint8_t own_mac[6];                      // Node
+static uint8_t best_mac[6];                     // Node: strongest offer to the request out; lock
+static uint8_t best_channel = 0;                // lock; 0 = none yet
+static int8_t best_rssi = 0;                    // lock
+static espnow_pair_stats_t stats;               // lock
+static nvs_espnow_nodes_t nodes;                // Gateway: link task once serving
+
+_Static_assert(NVS_ESPNOW_NODES_MAX < ESPNOW_LINK_MAX_PEERS, "every paired node must fit the peer table");
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static void put_u32(uint8_t *p, uint32_t v);
+static uint32_t get_u32(const uint8_t *p);
+static bool load_key(void);
+static void sign(const uint8_t *frame, size_t len, const uint8_t *sender, uint8_t *tag);
+static bool tag_ok(const uint8_t *frame, size_t len, const uint8_t *sender);
+static void gateway_receive(const uint8_t *mac, const uint8_t *data, size_t len);
+static void node_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+static void count_rejected(void);
+static void remember(const uint8_t *mac);
+static void discover(uint8_t *frame, uint32_t request_nonce);
+static bool request(uint8_t channel);
+static void record(const uint8_t *gateway_mac, uint8_t channel);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Load the active key; false if none is set
+ */
+static bool load_key(void) {
+    uint8_t any = 0;
+    if (nvs_load_espnow_active_key(key) != ESP_OK) {
+        memset(key, 0, sizeof(key));
+    }
+    for (size_t i = 0; i < sizeof(key); i++) {
+        any |= key[i];
+    }
+    return any != 0;
+}
+
+/**
+ * @brief HMAC-SHA256 under the active key of the frame's first len bytes and the sender's MAC, truncated
+ */
+static void sign(const uint8_t *frame, size_t len, const uint8_t *sender, uint8_t *tag) {
+    uint8_t msg[ESPNOW_PAIR_OFFER_LEN + 6];
+    uint8_t hmac[32];
+    memcpy(msg, frame, len);
+    memcpy(msg + len, sender, 6);
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), key, sizeof(key), msg, len + 6, hmac);
+    memcpy(tag, hmac, ESPNOW_PAIR_TAG_LEN);
+}
+
+/**
+ * @brief Whether the tag after the first len bytes is the sender's; compares every byte whatever the result
+ */
+static bool tag_ok(const uint8_t *frame, size_t len, const uint8_t *sender) {
+    uint8_t tag[ESPNOW_PAIR_TAG_LEN];
+    uint8_t diff = 0;
+    sign(frame, len, sender, tag);
+    for (size_t i = 0; i < sizeof(tag); i++) {
+        diff |= tag[i] ^ frame[len + i];
+    }
+    return diff == 0;
+}
+
+static void count_rejected(void) {
+    portENTER_CRITICAL(&lock);
+    stats.rejected++;
+    portEXIT_CRITICAL(&lock);
+}
+
+/**
+ * @brief Gateway, link task: keep a new node in NVS for espnow_pair_gateway_restore(); the oldest makes way
+ */
+static void remember(const uint8_t *mac) {
+    for (uint8_t i = 0; i < nodes.count; i++) {
+        if (memcmp(nodes.mac[i], mac, 6) == 0) {
+            return;
+        }
+    }
+    if (nodes.count == NVS_ESPNOW_NODES_MAX) {
+        memmove(nodes.mac[0], nodes.mac[1], (NVS_ESPNOW_NODES_MAX - 1) * 6);
+        nodes.count--;
+    }
+    memcpy(nodes.mac[nodes.count++], mac, 6);
+    if (nvs_store_espnow_nodes(&nodes) != ESP_OK) {
+        ESP_LOGW(TAG, MACSTR " is a peer until reboot only", MAC2STR(mac));
+    }
+}
+
+/**
+ * @brief Gateway, link task: take a node that holds the key as a peer and answer with this gateway's channel
+ */
+static void gateway_receive(const uint8_t *mac, const uint8_t *data, size_t len) {
+    if (len < ESPNOW_PAIR_DISCOVER_LEN || !tag_ok(data, ESPNOW_PAIR_DISCOVER_LEN - ESPNOW_PAIR_TAG_LEN, mac)) {
+        count_rejected();
+        return;
+    }
+    uint8_t channel = 0;
+    wifi_second_chan_t second;
+    uint8_t gateway_mac[6];
+    esp_err_t err = esp_wifi_get_channel(&channel, &second);
+    if (err == ESP_OK) {
+        err = esp_wifi_get_mac(WIFI_IF_STA, gateway_mac);
+    }
+
+    uint8_t frame[ESPNOW_PAIR_OFFER_LEN];
+    frame[0] = ESPNOW_PAIR_MAGIC;
+    frame[1] = ESPNOW_PAIR_KIND_OFFER;
+    memcpy(frame + 2, data + 2, 4);             // The node's nonce
+    frame[6] = channel;
+    memcpy(frame + 7, mac, 6);
+    sign(frame, ESPNOW_PAIR_OFFER_LEN - ESPNOW_PAIR_TAG_LEN, gateway_mac,
+         frame + ESPNOW_PAIR_OFFER_LEN - ESPNOW_PAIR_TAG_LEN);
+    if (err == ESP_OK) {
+        err = espnow_link_add_peer(mac);        // Encrypted, so the node's unicasts after pairing get through
+    }
+    if (err == ESP_OK) {
+        remember(mac);
+    }
+    if (err == ESP_OK) {
+        err = espnow_link_add_peer(broadcast_mac);
+    }
+    if (err == ESP_OK) {
+        err = espnow_link_send(broadcast_mac, frame, sizeof(frame));
+    }
+
+    portENTER_CRITICAL(&lock);
+    stats.requests++;
+    stats.offers += err == ESP_OK ? 1 : 0;
+    portEXIT_CRITICAL(&lock);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Offered channel %u to " MACSTR, channel, MAC2STR(mac));
+    } else {
+        ESP_LOGW(TAG, "Offer to " MACSTR " not sent: %s", MAC2STR(mac), esp_err_to_name(err));
+    }
+}
+
+/**
+ * @brief Node, link task: keep the strongest signed offer to the request out
+ */
+static void node_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    if (len < ESPNOW_PAIR_OFFER_LEN || memcmp(data + 7, own_mac, 6) != 0 || data[6] == 0 ||
+        data[6] > ESPNOW_CHANNEL_MAX || !tag_ok(data, ESPNOW_PAIR_OFFER_LEN - ESPNOW_PAIR_TAG_LEN, mac)) {
+        count_rejected();
+        return;
+    }
+    bool taken = false;
+    portENTER_CRITICAL(&lock);
+    if (seeking && get_u32(data + 2) == nonce) {
+        stats.offers++;
+        if (best_channel == 0 || rssi > best_rssi) {
+            memcpy(best_mac, mac, 6);
+            best_channel = data[6];
+            best_rssi = rssi;
+        }
+        taken = true;
+    } else {
+        stats.rejected++;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (taken) {
+        ESP_LOGI(TAG, "Offer from " MACSTR " on channel %u at %d dBm", MAC2STR(mac), data[6], rssi);
+    }
+}
+
+bool espnow_pair_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    if (len < 2 || data[0] != ESPNOW_PAIR_MAGIC) {
+        return false;
+    }
+    if (data[1] == ESPNOW_PAIR_KIND_DISCOVER && serving) {
+        gateway_receive(mac, data, len);
+    } else if (data[1] == ESPNOW_PAIR_KIND_OFFER && seeking) {
+        node_receive(mac, data, len, rssi);
+    }
+    return true;
+}
+
+esp_err_t espnow_pair_gateway_start(void) {
+    if (ESPNOW_PAIR == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!load_key()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    serving = true;
+    ESP_LOGI(TAG, "Answering pairing requests");
+    return ESP_OK;
+}
+
+void espnow_pair_gateway_stop(void) {
+    serving = false;
+}
+
+esp_err_t espnow_pair_gateway_restore(void) {
+    esp_err_t err = nvs_load_espnow_nodes(&nodes);
+    size_t restored = 0;
+    for (uint8_t i = 0; i < nodes.count && err == ESP_OK; i++) {
+        err = espnow_link_add_peer(nodes.mac[i]);
+        restored += err == ESP_OK ? 1 : 0;
+    }
+    if (restored > 0) {
+        ESP_LOGI(TAG, "%u paired nodes are peers again", (unsigned)restored);
+    }
+    return err;
+}
+
+/**
+ * @brief Node: a signed DISCOVER carrying request_nonce
+ */
+static void discover(uint8_t *frame, uint32_t request_nonce) {
+    frame[0] = ESPNOW_PAIR_MAGIC;
+    frame[1] = ESPNOW_PAIR_KIND_DISCOVER;
+    put_u32(frame + 2, request_nonce);
+    sign(frame, ESPNOW_PAIR_DISCOVER_LEN - ESPNOW_PAIR_TAG_LEN, own_mac,
+         frame + ESPNOW_PAIR_DISCOVER_LEN - ESPNOW_PAIR_TAG_LEN);
+}
+
+/**
+ * @brief Node: broadcast one request on the current channel and wait out the listen window
+ *
+ * @return bool An offer came in
+ */
+static bool request(uint8_t channel) {
+    uint8_t frame[ESPNOW_PAIR_DISCOVER_LEN];
+    uint32_t request_nonce = esp_random();
+    portENTER_CRITICAL(&lock);
+    nonce = request_nonce;
+    seeking = true;
+    stats.requests++;
+    portEXIT_CRITICAL(&lock);
+    discover(frame, request_nonce);
+
+    esp_err_t err = espnow_link_send(broadcast_mac, frame, sizeof(frame));
+    if (err != ESP_OK) {
+        ESP_LOGD(TAG, "Request on channel %u not sent: %s", channel, esp_err_to_name(err));
+    }
+    vTaskDelay(pdMS_TO_TICKS(ESPNOW_PAIR_LISTEN_MS));
+
+    portENTER_CRITICAL(&lock);
+    seeking = false;
+    bool offered = best_channel != 0;
+    portEXIT_CRITICAL(&lock);
+    return offered;
+}
+
+/**
+ * @brief Node: keep the gateway as the server MAC and channel (one NVS commit) and as the RTC home channel
+ */
+static void record(const uint8_t *gateway_mac, uint8_t channel) {
+    espnow_channel_node_set_home(channel);
+
+    device_config_t cfg;
+    esp_err_t err = nvs_config_get(&cfg);
+    if (err == ESP_OK) {
+        snprintf(cfg.server_mac, sizeof(cfg.server_mac), MACSTR, MAC2STR(gateway_mac));
+        cfg.server_channel = channel;
+        err = nvs_config_update(&cfg);
+    }
+    if (err == ESP_OK) {
+        err = nvs_config_flush();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Gateway not saved, pairing again next boot: %s", esp_err_to_name(err));
+    }
+}
+
+esp_err_t espnow_pair_node_run(uint8_t first_channel, uint8_t *gateway_mac) {
+    if (ESPNOW_PAIR == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!load_key()) {
+        ESP_LOGW(TAG, "No active key to pair with");
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = esp_wifi_get_mac(WIFI_IF_STA, own_mac);
+    if (err == ESP_OK) {
+        err = espnow_link_add_peer(broadcast_mac);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    portENTER_CRITICAL(&lock);
+    best_channel = 0;
+    stats.channel = 0;
+    portEXIT_CRITICAL(&lock);
+    bool found = false;
+    uint8_t channel = first_channel;
+    for (int n = 0; n < ESPNOW_CHANNEL_MAX && !found; n++) {
+        if (n > 0 && esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE) != ESP_OK) {
+            channel = channel % ESPNOW_CHANNEL_MAX + 1;
+            continue;
+        }
+        for (int t = 0; t < ESPNOW_PAIR_TRIES && !found; t++) {
+            found = request(channel);
+        }
+        if (!found) {
+            channel = channel % ESPNOW_CHANNEL_MAX + 1;
+        }
+    }
+    if (!found) {
+        ESP_LOGW(TAG, "No gateway answered on channels 1-%d", ESPNOW_CHANNEL_MAX);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    portENTER_CRITICAL(&lock);
+    memcpy(gateway_mac, best_mac, 6);
+    channel = best_channel;
+    stats.channel = channel;
+    portEXIT_CRITICAL(&lock);
+    if (esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE) != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot move to the gateway's channel %u", channel);
+    }
+    record(gateway_mac, channel);
+    ESP_LOGI(TAG, "Paired with gateway " MACSTR " on channel %u", MAC2STR(gateway_mac), channel);
+    return ESP_OK;
+}
+
+esp_err_t espnow_pair_node_announce(void) {
+    if (ESPNOW_PAIR == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!load_key()) {
+        return ESP_ERR_INVALID_STATE;           // Open link: the gateway peers the node with its first frame
+    }
+    esp_err_t err = esp_wifi_get_mac(WIFI_IF_STA, own_mac);
+    if (err == ESP_OK) {
+        err = espnow_link_add_peer(broadcast_mac);
+    }
+    if (err == ESP_OK) {
+        uint8_t frame[ESPNOW_PAIR_DISCOVER_LEN];
+        discover(frame, esp_random());          // No one waits for the offer it draws
+        err = espnow_link_send(broadcast_mac, frame, sizeof(frame));
+    }
+    if (err == ESP_OK) {
+        portENTER_CRITICAL(&lock);
+        stats.requests++;
+        portEXIT_CRITICAL(&lock);
+    }
+    return err;
+}
+
+void espnow_pair_get_stats(espnow_pair_stats_t *stats_out) {
+    portENTER_CRITICAL(&lock);
+    *stats_out = stats;
+    portEXIT_CRITICAL(&lock);
+}
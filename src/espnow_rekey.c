@@ -0,0 +1,321 @@
+/**
+ * @file espnow_rekey.c
+ * @brief ESP-NOW key rotation without dropped frames: each node changes keys at a seq the gateway names on its ACKs
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "espnow_rekey.h"
+#include "espnow_link.h"
+#include "version.h"
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register espnow_rekey.c version
+REGISTER_VERSION(EspnowRekey, "1.0.0", "2026-10-15");
+
+static const char *TAG = "ESPNOW_REKEY";
+
+/**
+ * @brief One node on the gateway; under lock
+ */
+typedef struct {
+    uint8_t mac[6];
+    bool used;
+    bool ready;                                 // Reported the gateway's new key
+    bool direct;                                // Its last ACK went to it, not through a relay
+    bool switched;
+    bool committing;                            // The ACK being sent carries the commit
+    bool warned;                                // Logged that it holds another key
+    uint32_t fingerprint;                       // Of the rotation this entry is for
+    uint32_t switch_seq;                        // Named on its ACKs, 0 none
+    uint32_t reported_seq;                      // As its telemetry reported back
+} rekey_node_t;
+
+// Gateway
+static rekey_node_t table[ESPNOW_REKEY_NODES];
+static espnow_rekey_stats_t stats;              // lock
+
+// Node; the switch seq survives deep sleep with the reliable window it belongs to
+static RTC_DATA_ATTR uint8_t rtc_gateway[6];     // Who named it
+static RTC_DATA_ATTR uint32_t rtc_fingerprint;
+static RTC_DATA_ATTR uint32_t rtc_switch_seq;
+static uint8_t gateway[6];
+static uint32_t retransmits_at_named = 0;       // Reliable resends and MAC retries when the seq was named
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static void put_u32(uint8_t *p, uint32_t v);
+static uint32_t get_u32(const uint8_t *p);
+static rekey_node_t *find_locked(const uint8_t *mac, bool create);
+static size_t ack_hook(const uint8_t *mac, uint32_t cumulative, uint8_t *buf, size_t cap);
+static void ack_sent(const uint8_t *mac, bool direct, bool delivered);
+static size_t trailer_hook(const uint8_t *data, size_t len);
+static uint32_t retransmits_now(void);
+static void on_barrier(uint32_t seq);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/** @brief Table entry for a node, claiming a free one if asked; call with lock held */
+static rekey_node_t *find_locked(const uint8_t *mac, bool create) {
+    rekey_node_t *free_entry = NULL;
+    for (size_t i = 0; i < ESPNOW_REKEY_NODES; i++) {
+        if (table[i].used && memcmp(table[i].mac, mac, 6) == 0) {
+            return &table[i];
+        }
+        if (!table[i].used && free_entry == NULL) {
+            free_entry = &table[i];
+        }
+    }
+    if (!create || free_entry == NULL) {
+        return NULL;
+    }
+    memset(free_entry, 0, sizeof(*free_entry));
+    memcpy(free_entry->mac, mac, 6);
+    free_entry->used = true;
+    return free_entry;
+}
+
+esp_err_t espnow_rekey_gateway_start(void) {
+    portENTER_CRITICAL(&lock);
+    memset(table, 0, sizeof(table));
+    memset(&stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&lock);
+    espnow_reliable_set_ack_hook(ESPNOW_RELIABLE_TRAILER_REKEY, ack_hook);
+    espnow_reliable_set_ack_sent_hook(ack_sent);
+    return ESP_OK;
+}
+
+void espnow_rekey_gateway_seen(const uint8_t *mac, uint32_t fingerprint, uint32_t switch_seq) {
+    uint32_t ours;
+    if (!espnow_link_rotation(&ours)) {
+        return;
+    }
+    bool warn = false;
+    portENTER_CRITICAL(&lock);
+    rekey_node_t *e = find_locked(mac, true);
+    if (e != NULL) {
+        if (e->fingerprint != ours) {
+            // An earlier rotation's state
+            uint8_t keep[6];
+            memcpy(keep, e->mac, sizeof(keep));
+            memset(e, 0, sizeof(*e));
+            memcpy(e->mac, keep, sizeof(keep));
+            e->used = true;
+            e->fingerprint = ours;
+        }
+        e->ready = fingerprint == ours;
+        e->reported_seq = switch_seq;
+        warn = !e->ready && !e->warned;
+        e->warned = e->warned || warn;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (warn) {
+        ESP_LOGW(TAG, "Node " MACSTR " holds another pending key; it moves when the grace window ends",
+                 MAC2STR(mac));
+    }
+}
+
+/**
+ * @brief ACK task: name the switch seq to a ready node, and commit once everything below it is in
+ */
+static size_t ack_hook(const uint8_t *mac, uint32_t cumulative, uint8_t *buf, size_t cap) {
+    uint32_t fingerprint;
+    if (cap < ESPNOW_REKEY_TRAILER_LEN || !espnow_link_rotation(&fingerprint)) {
+        return 0;
+    }
+    portENTER_CRITICAL(&lock);
+    rekey_node_t *e = find_locked(mac, false);
+    if (e == NULL || !e->ready || !e->direct || e->switched || e->fingerprint != fingerprint) {
+        portEXIT_CRITICAL(&lock);
+        return 0;
+    }
+    // Named again when it passed without the node stopping there, or after a new session restarted the seqs
+    int32_t ahead = (int32_t)(e->switch_seq - cumulative);
+    if (e->switch_seq == 0 || ahead > ESPNOW_REKEY_LEAD || (ahead <= 0 && e->reported_seq != e->switch_seq)) {
+        e->switch_seq = cumulative + ESPNOW_REKEY_LEAD;
+        ahead = ESPNOW_REKEY_LEAD;
+    }
+    e->committing = ahead <= 0;
+    uint32_t seq = e->switch_seq;
+    bool commit = e->committing;
+    stats.announced++;
+    portEXIT_CRITICAL(&lock);
+
+    buf[0] = ESPNOW_REKEY_MAGIC;
+    buf[1] = commit ? ESPNOW_REKEY_COMMIT : 0;
+    put_u32(buf + 2, fingerprint);
+    put_u32(buf + 6, seq);
+    return ESPNOW_REKEY_TRAILER_LEN;
+}
+
+/**
+ * @brief ACK task: move the node right after its radio took the commit, before it can send with the new key
+ */
+static void ack_sent(const uint8_t *mac, bool direct, bool delivered) {
+    bool commit = false;
+    uint32_t seq = 0;
+    portENTER_CRITICAL(&lock);
+    rekey_node_t *e = find_locked(mac, false);
+    if (e != NULL) {
+        commit = e->committing && direct && delivered;
+        e->committing = false;
+        e->direct = direct;
+        seq = e->switch_seq;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (!commit) {
+        return;
+    }
+
+    esp_err_t err = espnow_link_peer_switch_key(mac, false);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Node " MACSTR " could not be moved at seq %lu: %s", MAC2STR(mac), (unsigned long)seq,
+                 esp_err_to_name(err));
+        return;
+    }
+    portENTER_CRITICAL(&lock);
+    e->switched = true;
+    stats.commits++;
+    portEXIT_CRITICAL(&lock);
+    ESP_LOGI(TAG, "Node " MACSTR " on the new key from seq %lu", MAC2STR(mac), (unsigned long)seq);
+}
+
+/** @brief Reliable-layer resends and MAC retries so far */
+static uint32_t retransmits_now(void) {
+    espnow_reliable_tx_stats_t ts;
+    espnow_reliable_get_tx_stats(&ts);
+    return ts.resends + ts.mac_retries;
+}
+
+/**
+ * @brief Link task: stop at a switch seq the gateway named, and let the barrier open on its commit
+ */
+static size_t trailer_hook(const uint8_t *data, size_t len) {
+    if (len < ESPNOW_REKEY_TRAILER_LEN || data[0] != ESPNOW_REKEY_MAGIC) {
+        return 0;
+    }
+    uint8_t flags = data[1];
+    uint32_t fingerprint = get_u32(data + 2);
+    uint32_t seq = get_u32(data + 6);
+    uint32_t ours;
+    if (!espnow_link_rotation(&ours) || fingerprint != ours) {
+        return ESPNOW_REKEY_TRAILER_LEN;        // Not the key this node holds: it stays on the old one
+    }
+
+    bool named = false;
+    if (seq != rtc_switch_seq && (int32_t)(seq - espnow_reliable_next_seq()) >= 0) {
+        // Nothing from seq on was sent yet, so the node can still stop there
+        memcpy(rtc_gateway, gateway, sizeof(rtc_gateway));
+        rtc_fingerprint = fingerprint;
+        rtc_switch_seq = seq;
+        retransmits_at_named = retransmits_now();
+        espnow_reliable_set_barrier(seq, on_barrier);
+        named = true;
+    }
+    if ((flags & ESPNOW_REKEY_COMMIT) && seq == rtc_switch_seq) {
+        espnow_reliable_open_barrier();
+    }
+    portENTER_CRITICAL(&lock);
+    stats.switch_seq = rtc_switch_seq;
+    portEXIT_CRITICAL(&lock);
+    if (named) {
+        ESP_LOGI(TAG, "Changing keys at seq %lu", (unsigned long)seq);
+    }
+    return ESPNOW_REKEY_TRAILER_LEN;
+}
+
+/**
+ * @brief Sending task: everything below the switch seq is acknowledged and the gateway committed
+ */
+static void on_barrier(uint32_t seq) {
+    vTaskDelay(pdMS_TO_TICKS(ESPNOW_REKEY_SETTLE_MS));
+    esp_err_t err = espnow_link_peer_switch_key(gateway, true);
+    uint32_t retransmits = retransmits_now() - retransmits_at_named;
+    rtc_switch_seq = 0;
+    portENTER_CRITICAL(&lock);
+    stats.switch_seq = 0;
+    stats.node_switched = err == ESP_OK;
+    stats.retransmits = retransmits;
+    portEXIT_CRITICAL(&lock);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Key change at seq %lu failed: %s", (unsigned long)seq, esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "On the new key from seq %lu, %lu retransmits since it was named", (unsigned long)seq,
+                 (unsigned long)retransmits);
+    }
+}
+
+void espnow_rekey_node_init(const uint8_t *gateway_mac) {
+    memcpy(gateway, gateway_mac, sizeof(gateway));
+    espnow_reliable_set_trailer_hook(ESPNOW_RELIABLE_TRAILER_REKEY, trailer_hook);
+
+    uint32_t ours;
+    bool resume = rtc_switch_seq != 0 && memcmp(rtc_gateway, gateway, sizeof(gateway)) == 0 &&
+                  espnow_link_rotation(&ours) && ours == rtc_fingerprint &&
+                  (int32_t)(rtc_switch_seq - espnow_reliable_next_seq()) >= 0;
+    if (resume) {
+        retransmits_at_named = retransmits_now();
+        espnow_reliable_set_barrier(rtc_switch_seq, on_barrier);
+        ESP_LOGI(TAG, "Changing keys at seq %lu", (unsigned long)rtc_switch_seq);
+    } else {
+        rtc_switch_seq = 0;
+        espnow_reliable_clear_barrier();
+    }
+    portENTER_CRITICAL(&lock);
+    stats.switch_seq = rtc_switch_seq;
+    portEXIT_CRITICAL(&lock);
+}
+
+bool espnow_rekey_node_report(uint32_t *fingerprint, uint32_t *switch_seq) {
+    if (!espnow_link_rotation(fingerprint)) {
+        if (rtc_switch_seq != 0) {
+            // The grace window moved every peer already
+            rtc_switch_seq = 0;
+            espnow_reliable_clear_barrier();
+        }
+        *switch_seq = 0;
+        return false;
+    }
+    *switch_seq = rtc_switch_seq;
+    return true;
+}
+
+void espnow_rekey_get_stats(espnow_rekey_stats_t *out) {
+    portENTER_CRITICAL(&lock);
+    *out = stats;
+    out->ready = 0;
+    out->switched = 0;
+    for (size_t i = 0; i < ESPNOW_REKEY_NODES; i++) {
+        out->ready += table[i].used && table[i].ready ? 1 : 0;
+        out->switched += table[i].used && table[i].switched ? 1 : 0;
+    }
+    portEXIT_CRITICAL(&lock);
+}
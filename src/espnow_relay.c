@@ -0,0 +1,514 @@
+/**
+ * @file espnow_relay.c
+ * @brief Relay role: a mains-powered node forwards other nodes' frames to the gateway and their ACKs back
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "espnow_relay.h"
+#include "espnow_failover.h"
+#include "espnow_time.h"
+#include "power_profile.h"
+#include "static_mem.h"
+#include "task_plan.h"
+#include "version.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register espnow_relay.c version
+REGISTER_VERSION(EspnowRelay, "1.0.0", "2026-10-15");
+
+static const char *TAG = "ESPNOW_RELAY";
+
+#define STOP_TIMEOUT_MS 1000
+
+static const uint8_t broadcast_mac[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+/**
+ * @brief A node heard through this relay (or, on the gateway, through any); under lock
+ */
+typedef struct {
+    uint8_t origin[6];
+    uint8_t via[6];                             // Neighbour it was last heard from; origin itself if direct
+    bool used;
+    int64_t seen_us;
+    // Relay only
+    uint16_t session;
+    bool have_ack;
+    uint8_t ack[ESPNOW_RELIABLE_ACK_LEN];       // Last ACK sent down to it, hold cleared
+    uint32_t fwd_seq;                           // Last DATA seq forwarded up
+    int64_t fwd_us;
+} route_t;
+
+/**
+ * @brief A frame for the relay task
+ */
+typedef struct {
+    uint8_t dest[6];                            // Ignored for upstream frames: sent to the current upstream
+    bool up;                                    // Paced, towards the gateway
+    bool stop;
+    uint8_t len;
+    uint8_t data[ESPNOW_RELIABLE_FRAME_MAX];
+} relay_item_t;
+
+static route_t routes[ESPNOW_RELAY_ROUTES];
+static espnow_relay_stats_t stats;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Gateway
+static espnow_link_rx_t deliver_fn = NULL;
+
+// Node
+static bool relaying = false;
+static uint8_t upstream_mac[6];                 // lock
+static QueueHandle_t queue = NULL;
+static StaticQueue_t queue_buf;
+static uint8_t queue_storage[ESPNOW_RELAY_QUEUE * sizeof(relay_item_t)];
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(relay_task_slot, ESPNOW_RELAY_TASK_STACK_SIZE);
+static SemaphoreHandle_t stopped_sem = NULL;
+
+// =============================
+// Function Prototypes
+// =============================
+static uint16_t get_u16(const uint8_t *p);
+static uint32_t get_u32(const uint8_t *p);
+static route_t *route_locked(const uint8_t *origin, bool create);
+static bool enqueue(const uint8_t *dest, bool up, const uint8_t *data, size_t len);
+static void gateway_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+static void relay_data(const uint8_t *origin, const uint8_t *via, const uint8_t *frame, size_t len, uint8_t hops);
+static void relay_down(const uint8_t *mac, const uint8_t *data, size_t len);
+static void send_beacon(void);
+static void relay_task(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+/**
+ * @brief A node's entry; a full table gives up the one heard longest ago. Call with lock held.
+ */
+static route_t *route_locked(const uint8_t *origin, bool create) {
+    route_t *oldest = NULL;
+    for (size_t i = 0; i < ESPNOW_RELAY_ROUTES; i++) {
+        route_t *r = &routes[i];
+        if (r->used && memcmp(r->origin, origin, 6) == 0) {
+            return r;
+        }
+        if (oldest == NULL || !r->used || (oldest->used && r->seen_us < oldest->seen_us)) {
+            oldest = r;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    if (!oldest->used) {
+        stats.routes++;
+    }
+    memset(oldest, 0, sizeof(*oldest));
+    oldest->used = true;
+    memcpy(oldest->origin, origin, 6);
+    return oldest;
+}
+
+/**
+ * @brief Hand a frame to the relay task; link task, so it never blocks
+ */
+static bool enqueue(const uint8_t *dest, bool up, const uint8_t *data, size_t len) {
+    relay_item_t item;
+    memcpy(item.dest, dest, 6);
+    item.up = up;
+    item.stop = false;
+    item.len = (uint8_t)len;
+    memcpy(item.data, data, len);
+    if (xQueueSend(queue, &item, 0) != pdTRUE) {
+        portENTER_CRITICAL(&lock);
+        stats.dropped++;
+        portEXIT_CRITICAL(&lock);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Gateway: unwrap a relayed DATA frame and note the relay it came through
+ */
+static void gateway_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    const uint8_t *origin = data + 3;
+    bool too_far = data[2] > ESPNOW_RELAY_MAX_HOPS;
+    portENTER_CRITICAL(&lock);
+    if (too_far) {
+        stats.dropped++;
+    } else {
+        route_t *r = route_locked(origin, true);
+        memcpy(r->via, mac, 6);
+        r->seen_us = esp_timer_get_time();
+        stats.up++;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (!too_far) {
+        deliver_fn(origin, data + ESPNOW_RELAY_HEADER_LEN, len - ESPNOW_RELAY_HEADER_LEN, rssi);
+    }
+}
+
+/**
+ * @brief Relay: forward a node's DATA frame up, unless its kept ACK answers it or it was just sent
+ *
+ * @param frame The reliable DATA frame
+ * @param hops Relays it passed before this one
+ */
+static void relay_data(const uint8_t *origin, const uint8_t *via, const uint8_t *frame, size_t len, uint8_t hops) {
+    if (len < ESPNOW_RELIABLE_DATA_HEADER_LEN || len + ESPNOW_RELAY_HEADER_LEN > ESPNOW_RELIABLE_FRAME_MAX ||
+        hops >= ESPNOW_RELAY_MAX_HOPS) {
+        portENTER_CRITICAL(&lock);
+        stats.dropped++;
+        portEXIT_CRITICAL(&lock);
+        return;
+    }
+    uint16_t session = get_u16(frame + 2);
+    uint32_t seq = get_u32(frame + 4);
+    int64_t now = esp_timer_get_time();
+    uint8_t ack[ESPNOW_RELIABLE_ACK_LEN];
+    bool answer = false;
+    bool suppress = false;
+
+    portENTER_CRITICAL(&lock);
+    route_t *r = route_locked(origin, true);
+    memcpy(r->via, via, 6);
+    r->seen_us = now;
+    if (r->session != session) {
+        r->session = session;
+        r->have_ack = false;
+        r->fwd_us = 0;
+    }
+    if (r->have_ack && (int32_t)(seq - get_u32(r->ack + 4)) < 0) {
+        memcpy(ack, r->ack, sizeof(ack));
+        answer = true;
+        stats.answered++;
+    } else if (r->fwd_us != 0 && seq == r->fwd_seq && now - r->fwd_us < (int64_t)ESPNOW_RELAY_DUP_MS * 1000) {
+        suppress = true;
+        stats.suppressed++;
+    } else {
+        r->fwd_seq = seq;
+        r->fwd_us = now;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (suppress) {
+        return;
+    }
+    uint8_t wrapped[ESPNOW_RELIABLE_FRAME_MAX];
+    wrapped[0] = ESPNOW_RELAY_MAGIC;
+    wrapped[2] = (uint8_t)(hops + 1);
+    memcpy(wrapped + 3, origin, 6);
+    if (answer) {
+        // Straight to the node, or wrapped for the relay below that passed it on
+        wrapped[1] = ESPNOW_RELAY_KIND_DOWN;
+        memcpy(wrapped + ESPNOW_RELAY_HEADER_LEN, ack, sizeof(ack));
+        if (hops == 0) {
+            enqueue(via, false, ack, sizeof(ack));
+        } else {
+            enqueue(via, false, wrapped, ESPNOW_RELAY_HEADER_LEN + sizeof(ack));
+        }
+        return;
+    }
+    wrapped[1] = ESPNOW_RELAY_KIND_UP;
+    memcpy(wrapped + ESPNOW_RELAY_HEADER_LEN, frame, len);
+    enqueue(broadcast_mac, true, wrapped, len + ESPNOW_RELAY_HEADER_LEN);
+}
+
+/**
+ * @brief Relay: pass an ACK back towards its node, keeping it for resends
+ */
+static void relay_down(const uint8_t *mac, const uint8_t *data, size_t len) {
+    const uint8_t *origin = data + 3;
+    const uint8_t *inner = data + ESPNOW_RELAY_HEADER_LEN;
+    size_t inner_len = len - ESPNOW_RELAY_HEADER_LEN;
+    uint8_t via[6];
+    bool known = false;
+
+    portENTER_CRITICAL(&lock);
+    bool from_upstream = memcmp(mac, upstream_mac, 6) == 0;
+    route_t *r = from_upstream ? route_locked(origin, false) : NULL;
+    if (r != NULL) {
+        known = true;
+        memcpy(via, r->via, 6);
+        if (inner_len >= ESPNOW_RELIABLE_ACK_LEN && inner[0] == ESPNOW_RELIABLE_MAGIC &&
+            inner[1] == ESPNOW_RELIABLE_KIND_ACK && get_u16(inner + 2) == r->session) {
+            memcpy(r->ack, inner, ESPNOW_RELIABLE_ACK_LEN);
+            r->ack[12] = 0;                     // A replayed ACK must not repeat a stale hold
+            r->ack[13] = 0;
+            r->have_ack = true;
+        }
+    } else {
+        stats.dropped++;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (!known) {
+        return;
+    }
+
+    // The last relay unwraps; others pass the frame on as it is
+    if (memcmp(via, origin, 6) == 0) {
+        enqueue(via, false, inner, inner_len);
+    } else {
+        enqueue(via, false, data, len);
+    }
+}
+
+bool espnow_relay_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    if (len < 2) {
+        return false;
+    }
+    if (deliver_fn != NULL) {
+        if (data[0] == ESPNOW_RELAY_MAGIC) {
+            if (data[1] == ESPNOW_RELAY_KIND_UP && len > ESPNOW_RELAY_HEADER_LEN) {
+                gateway_receive(mac, data, len, rssi);
+            }
+            return true;
+        }
+        portENTER_CRITICAL(&lock);
+        route_t *r = route_locked(mac, false);
+        if (r != NULL) {
+            memcpy(r->via, mac, 6);             // In reach again: answer it directly
+            r->seen_us = esp_timer_get_time();
+        }
+        portEXIT_CRITICAL(&lock);
+        return false;
+    }
+    if (!relaying) {
+        return false;
+    }
+    if (data[0] == ESPNOW_RELIABLE_MAGIC && data[1] == ESPNOW_RELIABLE_KIND_DATA) {
+        relay_data(mac, mac, data, len, 0);
+        return true;
+    }
+    if (data[0] != ESPNOW_RELAY_MAGIC) {
+        return false;
+    }
+    if (len > ESPNOW_RELAY_HEADER_LEN && data[1] == ESPNOW_RELAY_KIND_UP) {
+        relay_data(data + 3, mac, data + ESPNOW_RELAY_HEADER_LEN, len - ESPNOW_RELAY_HEADER_LEN, data[2]);
+    } else if (len > ESPNOW_RELAY_HEADER_LEN && data[1] == ESPNOW_RELAY_KIND_DOWN) {
+        relay_down(mac, data, len);
+    }
+    return true;
+}
+
+esp_err_t espnow_relay_gateway_start(espnow_link_rx_t deliver) {
+    if (deliver == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(routes, 0, sizeof(routes));
+    memset(&stats, 0, sizeof(stats));
+    stats.running = true;
+    deliver_fn = deliver;
+    return ESP_OK;
+}
+
+esp_err_t espnow_relay_send(const uint8_t *mac, const uint8_t *data, size_t len) {
+    if (deliver_fn == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint8_t via[6];
+    bool relayed = false;
+    portENTER_CRITICAL(&lock);
+    route_t *r = route_locked(mac, false);
+    if (r != NULL && memcmp(r->via, mac, 6) != 0) {
+        memcpy(via, r->via, 6);
+        relayed = true;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (!relayed) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (len + ESPNOW_RELAY_HEADER_LEN > ESPNOW_RELIABLE_FRAME_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t frame[ESPNOW_RELIABLE_FRAME_MAX];
+    frame[0] = ESPNOW_RELAY_MAGIC;
+    frame[1] = ESPNOW_RELAY_KIND_DOWN;
+    frame[2] = 0;
+    memcpy(frame + 3, mac, 6);
+    memcpy(frame + ESPNOW_RELAY_HEADER_LEN, data, len);
+    esp_err_t err = espnow_link_add_peer(via);
+    if (err == ESP_OK) {
+        err = espnow_link_send(via, frame, len + ESPNOW_RELAY_HEADER_LEN);
+    }
+    if (err == ESP_OK) {
+        portENTER_CRITICAL(&lock);
+        stats.down++;
+        portEXIT_CRITICAL(&lock);
+    }
+    return err;
+}
+
+/**
+ * @brief Repeat the time beacon from the relay's own clock, while the gateway still acknowledges it
+ */
+static void send_beacon(void) {
+    espnow_time_stats_t ts;
+    espnow_time_get_stats(&ts);
+    espnow_failover_stats_t fs;
+    espnow_failover_get_stats(&fs);
+    if (!ts.synced || fs.misses != 0) {
+        return;                                 // Cut off itself: nodes must not fail over to it
+    }
+    uint8_t frame[ESPNOW_TIME_BEACON_LEN];
+    frame[0] = ESPNOW_TIME_MAGIC;
+    frame[1] = ESPNOW_TIME_KIND_BEACON;
+    frame[2] = ESPNOW_TIME_SOURCE_RELAY;
+    uint64_t now_us = (uint64_t)espnow_time_now_us();
+    for (int i = 0; i < 8; i++) {
+        frame[3 + i] = (uint8_t)(now_us >> (8 * i));
+    }
+    if (espnow_link_send(broadcast_mac, frame, sizeof(frame)) == ESP_OK) {
+        portENTER_CRITICAL(&lock);
+        stats.beacons++;
+        portEXIT_CRITICAL(&lock);
+    }
+}
+
+/**
+ * @brief Send queued frames, upstream ones within the rate, and repeat the beacon
+ */
+static void relay_task(void *arg) {
+    (void)arg;
+    relay_item_t item;
+    int64_t tokens_us = (int64_t)ESPNOW_RELAY_BURST * 1000000;     // Bucket, in microseconds of rate
+    int64_t last_us = esp_timer_get_time();
+    int64_t beacon_us = last_us;
+    for (;;) {
+        int64_t now = esp_timer_get_time();
+        int64_t beacon_in_ms = (beacon_us + (int64_t)ESPNOW_TIME_BEACON_MS * 1000 - now) / 1000;
+        if (beacon_in_ms <= 0) {
+            send_beacon();
+            beacon_us = now;
+            beacon_in_ms = ESPNOW_TIME_BEACON_MS;
+        }
+        if (xQueueReceive(queue, &item, pdMS_TO_TICKS(beacon_in_ms) + 1) != pdTRUE) {
+            continue;
+        }
+        if (item.stop) {
+            break;
+        }
+
+        if (item.up) {
+            now = esp_timer_get_time();
+            tokens_us += (now - last_us) * ESPNOW_RELAY_RATE;
+            last_us = now;
+            if (tokens_us > (int64_t)ESPNOW_RELAY_BURST * 1000000) {
+                tokens_us = (int64_t)ESPNOW_RELAY_BURST * 1000000;
+            }
+            if (tokens_us < 1000000) {
+                int64_t wait_us = (1000000 - tokens_us) / ESPNOW_RELAY_RATE;
+                vTaskDelay(pdMS_TO_TICKS(wait_us / 1000) + 1);
+                now = esp_timer_get_time();
+                tokens_us += (now - last_us) * ESPNOW_RELAY_RATE;
+                last_us = now;
+            }
+            tokens_us -= 1000000;
+            portENTER_CRITICAL(&lock);
+            memcpy(item.dest, upstream_mac, 6);
+            portEXIT_CRITICAL(&lock);
+        } else if (espnow_link_add_peer(item.dest) != ESP_OK) {
+            continue;
+        }
+
+        if (espnow_link_send(item.dest, item.data, item.len) == ESP_OK) {
+            portENTER_CRITICAL(&lock);
+            if (item.up) {
+                stats.up++;
+            } else {
+                stats.down++;
+            }
+            portEXIT_CRITICAL(&lock);
+        }
+    }
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t espnow_relay_node_start(const uint8_t *upstream) {
+    if (relaying) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(routes, 0, sizeof(routes));
+    memset(&stats, 0, sizeof(stats));
+    memcpy(upstream_mac, upstream, 6);
+    esp_err_t err = espnow_link_add_peer(broadcast_mac);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (queue == NULL) {
+        queue = xQueueCreateStatic(ESPNOW_RELAY_QUEUE, sizeof(relay_item_t), queue_storage, &queue_buf);
+    }
+    if (stopped_sem == NULL) {
+        stopped_sem = xSemaphoreCreateBinary();
+    }
+    if (queue == NULL || stopped_sem == NULL ||
+        static_task_create(relay_task_slot, relay_task, ESPNOW_RELAY_TASK_NAME, ESPNOW_RELAY_TASK_STACK_SIZE, NULL,
+                           ESPNOW_RELAY_TASK_PRIORITY, &task_handle, TASK_CORE_NET) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the relay task");
+        task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Nodes send at any time, so the relay listens all the time
+    power_profile_acquire(POWER_LOCK_RADIO);
+    stats.running = true;
+    relaying = true;
+    ESP_LOGI(TAG, "Relaying for out-of-range nodes to " MACSTR ", up to %d frames/s", MAC2STR(upstream),
+             ESPNOW_RELAY_RATE);
+    return ESP_OK;
+}
+
+void espnow_relay_node_retarget(const uint8_t *upstream) {
+    portENTER_CRITICAL(&lock);
+    memcpy(upstream_mac, upstream, 6);
+    portEXIT_CRITICAL(&lock);
+}
+
+void espnow_relay_node_stop(void) {
+    if (!relaying) {
+        return;
+    }
+    relaying = false;
+    relay_item_t item = { .stop = true };
+    xQueueReset(queue);
+    xQueueSend(queue, &item, portMAX_DELAY);
+    if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(STOP_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Relay task did not stop within %d ms", STOP_TIMEOUT_MS);
+    }
+    task_handle = NULL;
+    power_profile_release(POWER_LOCK_RADIO);
+    stats.running = false;
+}
+
+void espnow_relay_get_stats(espnow_relay_stats_t *out) {
+    portENTER_CRITICAL(&lock);
+    *out = stats;
+    portEXIT_CRITICAL(&lock);
+}
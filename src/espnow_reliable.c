@@ -0,0 +1,861 @@
+/**
+ * @file espnow_reliable.c
+ * @brief End-to-end delivery over ESP-NOW: sequence numbers, selective ACK and windowed retransmit
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "espnow_reliable.h"
+#include "espnow_relay.h"
+#include "espnow_link.h"
+#include "version.h"
+#include "static_mem.h"
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register espnow_reliable.c version
+REGISTER_VERSION(EspnowReliable, "1.0.0", "2026-10-15");
+
+static const char *TAG = "ESPNOW_REL";
+
+_Static_assert((ESPNOW_RELIABLE_MAX_NODES & (ESPNOW_RELIABLE_MAX_NODES - 1)) == 0,
+               "node table size must be a power of two");
+_Static_assert(ESPNOW_RELIABLE_DUP_WINDOW == 64, "the duplicate window is one uint64_t");
+
+#define WINDOW_MAGIC 0x5E17D0A7u                // Marks RTC contents written by this module
+#define WAKE_BIT (1u << 0)                      // ACK task notification: an ACK is due
+#define STOP_BIT (1u << 31)                     // ACK task notification: exit
+#define STOP_TIMEOUT_MS 1000
+#define RTT_WEIGHT 8
+
+/**
+ * @brief One unacknowledged frame
+ *
+ * Only the sending task writes data and fills a slot; the link task only
+ * frees slots (len = 0) and sets lost, so a frame can be read for a resend
+ * without holding the lock.
+ */
+typedef struct {
+    uint32_t seq;
+    uint32_t crc;                               // Of the payload, checked when the window is resumed
+    uint16_t len;                               // Whole frame, header included; 0: free
+    uint8_t sends;                              // Transmissions so far
+    bool lost;                                  // A later frame was selectively ACKed
+    int64_t sent_us;                            // Last transmission on this boot; 0: due now
+    uint8_t data[ESPNOW_RELIABLE_FRAME_MAX];
+} tx_slot_t;
+
+/**
+ * @brief The node's window; RTC_NOINIT, so only the magic and the CRCs tell it from garbage
+ */
+typedef struct {
+    uint32_t magic;
+    uint8_t peer[6];
+    uint16_t session;
+    uint32_t next_seq;
+    tx_slot_t slots[ESPNOW_RELIABLE_WINDOW];
+} tx_window_t;
+
+/**
+ * @brief Per-node receive state on the gateway
+ */
+typedef struct {
+    uint8_t mac[6];
+    bool used;
+    bool peered;                                // An ESP-NOW peer: open link, added here; encrypted, by pairing
+    bool ack_due;
+    uint16_t session;
+    uint32_t cumulative;                        // Every seq below was delivered
+    uint64_t received;                          // Bit i: seq cumulative + i delivered; bit 0 stays clear
+} rx_node_t;
+
+// Node
+static RTC_NOINIT_ATTR tx_window_t window;
+static bool sender_ready = false;
+static SemaphoreHandle_t ack_sem = NULL;        // Given on every ACK, for espnow_reliable_flush()
+static int64_t hold_until_us = 0;               // Gateway hold; tx_lock
+static espnow_reliable_tx_stats_t tx_stats;
+static portMUX_TYPE tx_lock = portMUX_INITIALIZER_UNLOCKED;
+static espnow_reliable_trailer_hook_t trailer_hooks[ESPNOW_RELIABLE_TRAILER_SLOTS];
+static bool barrier_set = false;                // tx_lock, with the three below
+static bool barrier_open = false;
+static uint32_t barrier_seq = 0;
+static espnow_reliable_barrier_t barrier_handler = NULL;
+
+// Gateway
+static espnow_reliable_deliver_t deliver_fn = NULL;
+static espnow_reliable_ack_hook_t ack_hooks[ESPNOW_RELIABLE_TRAILER_SLOTS];
+static espnow_reliable_ack_sent_t ack_sent_hook = NULL;
+static rx_node_t nodes[ESPNOW_RELIABLE_MAX_NODES];
+static TaskHandle_t ack_task_handle = NULL;
+STATIC_TASK_SLOT(ack_task_slot, ESPNOW_RELIABLE_ACK_TASK_STACK_SIZE);
+static SemaphoreHandle_t ack_stopped_sem = NULL;
+static espnow_reliable_rx_stats_t rx_stats;
+static uint16_t hold_ms = 0;                    // Carried by every ACK; rx_lock
+static portMUX_TYPE rx_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static void put_u16(uint8_t *p, uint16_t v);
+static void put_u32(uint8_t *p, uint32_t v);
+static uint16_t get_u16(const uint8_t *p);
+static uint32_t get_u32(const uint8_t *p);
+static bool seq_before(uint32_t a, uint32_t b);
+static uint32_t payload_crc(const tx_slot_t *slot);
+static bool window_valid(const uint8_t *peer);
+static uint32_t window_base(void);
+static uint8_t sorted_slots(uint8_t *order);
+static uint32_t slot_rto_ms(const tx_slot_t *slot);
+static esp_err_t transmit(tx_slot_t *slot, uint8_t *mac_retries);
+static esp_err_t send_lane(const uint8_t *data, size_t len, uint8_t *mac_retries, bool urgent);
+static void pass_barrier(void);
+static void handle_ack(const uint8_t *mac, const uint8_t *data, size_t len);
+static rx_node_t *find_node(const uint8_t *mac, bool create);
+static void advance(rx_node_t *node, uint32_t to);
+static void handle_data(const uint8_t *mac, const uint8_t *data, size_t len);
+static void ack_task(void *arg);
+static void send_ack(rx_node_t *node);
+
+// =============================
+// Function Definitions
+// =============================
+
+/** @brief Store little-endian */
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+/** @brief Store little-endian */
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+/** @brief Load little-endian */
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/** @brief Load little-endian */
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+/** @brief Sequence order that survives wrap-around */
+static bool seq_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+/** @brief CRC of a slot's payload; the header is rewritten on every send, so it is not covered */
+static uint32_t payload_crc(const tx_slot_t *slot) {
+    return esp_rom_crc32_le(0, slot->data + ESPNOW_RELIABLE_DATA_HEADER_LEN,
+                            slot->len - ESPNOW_RELIABLE_DATA_HEADER_LEN);
+}
+
+/**
+ * @brief Check the window left in RTC memory, dropping slots that do not check out
+ *
+ * @return bool False if the window as a whole is unusable
+ */
+static bool window_valid(const uint8_t *peer) {
+    if (window.magic != WINDOW_MAGIC || window.session == 0 ||
+        memcmp(window.peer, peer, sizeof(window.peer)) != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < ESPNOW_RELIABLE_WINDOW; i++) {
+        tx_slot_t *slot = &window.slots[i];
+        if (slot->len == 0) {
+            continue;
+        }
+        if (slot->len <= ESPNOW_RELIABLE_DATA_HEADER_LEN || slot->len > ESPNOW_RELIABLE_FRAME_MAX ||
+            !seq_before(slot->seq, window.next_seq) || payload_crc(slot) != slot->crc) {
+            slot->len = 0;
+            continue;
+        }
+        slot->sent_us = 0;                      // esp_timer restarted; resend on the first pump
+        slot->lost = false;
+    }
+    return true;
+}
+
+/** @brief Oldest seq still held, or next_seq with an empty window; call with tx_lock held */
+static uint32_t window_base(void) {
+    uint32_t base = window.next_seq;
+    for (size_t i = 0; i < ESPNOW_RELIABLE_WINDOW; i++) {
+        if (window.slots[i].len != 0 && seq_before(window.slots[i].seq, base)) {
+            base = window.slots[i].seq;
+        }
+    }
+    return base;
+}
+
+/**
+ * @brief Indices of the used slots, oldest seq first, so resends go out in order
+ *
+ * @return Number of indices written
+ */
+static uint8_t sorted_slots(uint8_t *order) {
+    uint8_t n = 0;
+    portENTER_CRITICAL(&tx_lock);
+    for (uint8_t i = 0; i < ESPNOW_RELIABLE_WINDOW; i++) {
+        if (window.slots[i].len == 0) {
+            continue;
+        }
+        uint8_t j = n++;
+        while (j > 0 && seq_before(window.slots[i].seq, window.slots[order[j - 1]].seq)) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    portEXIT_CRITICAL(&tx_lock);
+    return n;
+}
+
+/** @brief Retransmit timeout of a slot: doubles per send, capped */
+static uint32_t slot_rto_ms(const tx_slot_t *slot) {
+    uint8_t doublings = slot->sends > 1 ? slot->sends - 1 : 0;
+    uint32_t rto = ESPNOW_RELIABLE_RTO_MS << (doublings > 10 ? 10 : doublings);
+    return rto > ESPNOW_RELIABLE_RTO_MAX_MS ? ESPNOW_RELIABLE_RTO_MAX_MS : rto;
+}
+
+/**
+ * @brief Write the header with the current base and send, resending at once on a missing MAC ACK
+ */
+static esp_err_t transmit(tx_slot_t *slot, uint8_t *mac_retries) {
+    portENTER_CRITICAL(&tx_lock);
+    uint32_t base = window_base();
+    portEXIT_CRITICAL(&tx_lock);
+    slot->data[0] = ESPNOW_RELIABLE_MAGIC;
+    slot->data[1] = ESPNOW_RELIABLE_KIND_DATA;
+    put_u16(slot->data + 2, window.session);
+    put_u32(slot->data + 4, slot->seq);
+    put_u32(slot->data + 8, base);
+
+    esp_err_t err = ESP_FAIL;
+    uint8_t retries = 0;
+    int64_t sent_us = esp_timer_get_time();
+    for (;;) {
+        err = espnow_link_send(window.peer, slot->data, slot->len);
+        if (err == ESP_OK || retries >= ESPNOW_RELIABLE_MAC_RETRIES) {
+            break;
+        }
+        retries++;
+        vTaskDelay(pdMS_TO_TICKS(ESPNOW_RELIABLE_MAC_RETRY_DELAY_MS));
+        sent_us = esp_timer_get_time();
+    }
+
+    portENTER_CRITICAL(&tx_lock);
+    if (slot->len != 0) {                       // An ACK may have freed it meanwhile
+        slot->sends = slot->sends < UINT8_MAX ? slot->sends + 1 : UINT8_MAX;
+        slot->sent_us = sent_us;
+        slot->lost = false;
+    }
+    tx_stats.mac_retries += retries;
+    portEXIT_CRITICAL(&tx_lock);
+    if (mac_retries != NULL) {
+        *mac_retries = retries;
+    }
+    return err;
+}
+
+/**
+ * @brief Take a payload into a free slot of its lane and transmit it
+ */
+static esp_err_t send_lane(const uint8_t *data, size_t len, uint8_t *mac_retries, bool urgent) {
+    if (mac_retries != NULL) {
+        *mac_retries = 0;
+    }
+    if (!sender_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (data == NULL || len == 0 || len > ESPNOW_RELIABLE_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    pass_barrier();
+    tx_slot_t *slot = NULL;
+    portENTER_CRITICAL(&tx_lock);
+    if (!urgent && esp_timer_get_time() < hold_until_us) {
+        tx_stats.held++;
+        portEXIT_CRITICAL(&tx_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    if (barrier_set && !seq_before(window.next_seq, barrier_seq)) {
+        tx_stats.barrier_waits++;
+        portEXIT_CRITICAL(&tx_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    uint8_t used = 0;
+    for (size_t i = 0; i < ESPNOW_RELIABLE_WINDOW; i++) {
+        if (window.slots[i].len != 0) {
+            used++;
+        } else if (slot == NULL) {
+            slot = &window.slots[i];
+        }
+    }
+    if (!urgent && used >= ESPNOW_RELIABLE_BULK_WINDOW) {
+        slot = NULL;                            // The rest is kept for alarms
+    }
+    if (slot == NULL) {
+        tx_stats.window_full++;
+    }
+    portEXIT_CRITICAL(&tx_lock);
+    if (slot == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The slot is free, so the link task will not touch it until len is set
+    memcpy(slot->data + ESPNOW_RELIABLE_DATA_HEADER_LEN, data, len);
+    slot->sends = 0;
+    slot->lost = false;
+    slot->sent_us = 0;
+    portENTER_CRITICAL(&tx_lock);
+    slot->seq = window.next_seq++;
+    slot->len = (uint16_t)(len + ESPNOW_RELIABLE_DATA_HEADER_LEN);
+    slot->crc = payload_crc(slot);
+    tx_stats.frames++;
+    tx_stats.urgent += urgent;
+    portEXIT_CRITICAL(&tx_lock);
+    return transmit(slot, mac_retries);
+}
+
+/**
+ * @brief Run the barrier's handler once it is open and everything below it was acknowledged; sending task
+ */
+static void pass_barrier(void) {
+    espnow_reliable_barrier_t handler = NULL;
+    uint32_t seq = 0;
+    portENTER_CRITICAL(&tx_lock);
+    if (barrier_set && barrier_open && !seq_before(window_base(), barrier_seq)) {
+        barrier_set = false;
+        handler = barrier_handler;
+        seq = barrier_seq;
+    }
+    portEXIT_CRITICAL(&tx_lock);
+    if (handler != NULL) {
+        handler(seq);
+    }
+}
+
+/**
+ * @brief Link task: free what the gateway acknowledged and mark what it skipped
+ */
+static void handle_ack(const uint8_t *mac, const uint8_t *data, size_t len) {
+    if (!sender_ready || len < ESPNOW_RELIABLE_ACK_LEN || memcmp(mac, window.peer, sizeof(window.peer)) != 0 ||
+        get_u16(data + 2) != window.session) {
+        return;
+    }
+    uint32_t cumulative = get_u32(data + 4);
+    uint32_t selective = get_u32(data + 8);
+    uint16_t hold = get_u16(data + 12);
+    int64_t now = esp_timer_get_time();
+    int64_t newest_acked_us = 0;                // Send time of the latest frame acknowledged out of order
+
+    portENTER_CRITICAL(&tx_lock);
+    bool hold_started = hold != 0 && now >= hold_until_us;
+    hold_until_us = hold != 0 ? now + (int64_t)hold * 1000 : 0;
+    tx_stats.holds += hold != 0;
+    for (size_t i = 0; i < ESPNOW_RELIABLE_WINDOW; i++) {
+        tx_slot_t *slot = &window.slots[i];
+        if (slot->len == 0) {
+            continue;
+        }
+        int32_t d = (int32_t)(slot->seq - cumulative);
+        bool acked = d < 0 || (d >= 1 && d <= 32 && (selective >> (d - 1)) & 1);
+        if (!acked) {
+            continue;
+        }
+        if (d >= 1 && slot->sent_us > newest_acked_us) {
+            newest_acked_us = slot->sent_us;
+        }
+        if (slot->sends == 1 && slot->sent_us != 0) {
+            uint32_t rtt = (uint32_t)((now - slot->sent_us) / 1000);
+            tx_stats.rtt_ms = tx_stats.rtt_ms ? (tx_stats.rtt_ms * (RTT_WEIGHT - 1) + rtt) / RTT_WEIGHT : rtt;
+        }
+        slot->len = 0;
+        tx_stats.acked++;
+    }
+    // A frame sent before one that arrived is lost: ESP-NOW delivers in order
+    for (size_t i = 0; i < ESPNOW_RELIABLE_WINDOW && newest_acked_us != 0; i++) {
+        tx_slot_t *slot = &window.slots[i];
+        if (slot->len != 0 && slot->sends > 0 && slot->sent_us < newest_acked_us) {
+            slot->lost = true;
+        }
+    }
+    portEXIT_CRITICAL(&tx_lock);
+    if (hold_started) {
+        ESP_LOGI(TAG, "Gateway full, holding off for %u ms", hold);
+    }
+    // Each item goes to the hook that knows its magic; an unknown one ends the walk
+    size_t offset = ESPNOW_RELIABLE_ACK_LEN;
+    while (offset < len) {
+        size_t used = 0;
+        for (size_t i = 0; i < ESPNOW_RELIABLE_TRAILER_SLOTS && used == 0; i++) {
+            espnow_reliable_trailer_hook_t hook = trailer_hooks[i];
+            used = hook != NULL ? hook(data + offset, len - offset) : 0;
+        }
+        if (used == 0) {
+            break;
+        }
+        offset += used;
+    }
+    xSemaphoreGive(ack_sem);
+}
+
+/**
+ * @brief Receive state of a node: hash on the MAC, linear probing
+ *
+ * @param create Claim a free entry if the node is new
+ * @return Entry, or NULL if the node is unknown (or the table is full)
+ */
+static rx_node_t *find_node(const uint8_t *mac, bool create) {
+    uint32_t h = ((uint32_t)mac[3] * 31u + (uint32_t)mac[4] * 7u + mac[5]) & (ESPNOW_RELIABLE_MAX_NODES - 1);
+    for (uint32_t probe = 0; probe < ESPNOW_RELIABLE_MAX_NODES; probe++) {
+        rx_node_t *node = &nodes[(h + probe) & (ESPNOW_RELIABLE_MAX_NODES - 1)];
+        if (node->used && memcmp(node->mac, mac, sizeof(node->mac)) == 0) {
+            return node;
+        }
+        if (!node->used) {
+            if (!create) {
+                return NULL;
+            }
+            memset(node, 0, sizeof(*node));
+            memcpy(node->mac, mac, sizeof(node->mac));
+            node->used = true;
+            rx_stats.nodes++;
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/** @brief Move the cumulative seq up to at least to, then past any run of delivered seqs */
+static void advance(rx_node_t *node, uint32_t to) {
+    if (seq_before(node->cumulative, to)) {
+        uint32_t shift = to - node->cumulative;
+        node->received = shift >= ESPNOW_RELIABLE_DUP_WINDOW ? 0 : node->received >> shift;
+        node->cumulative = to;
+    }
+    while (node->received & 1) {
+        node->received >>= 1;
+        node->cumulative++;
+    }
+}
+
+/**
+ * @brief Link task: deliver a new frame once, and have it (or a duplicate) acknowledged
+ */
+static void handle_data(const uint8_t *mac, const uint8_t *data, size_t len) {
+    if (deliver_fn == NULL) {
+        return;
+    }
+    if (len <= ESPNOW_RELIABLE_DATA_HEADER_LEN) {
+        portENTER_CRITICAL(&rx_lock);
+        rx_stats.rejected++;
+        portEXIT_CRITICAL(&rx_lock);
+        return;
+    }
+    uint16_t session = get_u16(data + 2);
+    uint32_t seq = get_u32(data + 4);
+    uint32_t base = get_u32(data + 8);
+
+    portENTER_CRITICAL(&rx_lock);
+    rx_node_t *node = find_node(mac, true);
+    bool fresh = node != NULL && node->session != session;
+    if (fresh) {
+        // New node, new session after a power cut, or a gateway restart: start from the node's base
+        node->session = session;
+        node->cumulative = base;
+        node->received = 0;
+    }
+    int32_t d = 0;
+    if (node != NULL) {
+        advance(node, base);
+        d = (int32_t)(seq - node->cumulative);
+    }
+    bool rejected = node == NULL || d >= ESPNOW_RELIABLE_DUP_WINDOW;
+    bool duplicate = !rejected && (d < 0 || ((node->received >> d) & 1));
+    if (rejected || duplicate) {
+        rx_stats.rejected += rejected;
+        rx_stats.duplicates += duplicate;
+        if (duplicate) {
+            node->ack_due = true;               // Its ACK was lost; say so again
+        }
+    }
+    portEXIT_CRITICAL(&rx_lock);
+
+    if (fresh) {
+        ESP_LOGI(TAG, "Node " MACSTR " session %04x from seq %lu", MAC2STR(mac), session, (unsigned long)base);
+    }
+    if (rejected) {
+        ESP_LOGW(TAG, "Frame seq %lu from " MACSTR " outside the window", (unsigned long)seq, MAC2STR(mac));
+        return;
+    }
+    if (!duplicate) {
+        esp_err_t err = deliver_fn(mac, data + ESPNOW_RELIABLE_DATA_HEADER_LEN,
+                                   len - ESPNOW_RELIABLE_DATA_HEADER_LEN);
+        portENTER_CRITICAL(&rx_lock);
+        if (err == ESP_ERR_NO_MEM) {
+            rx_stats.deferred++;
+        } else {
+            node->received |= 1ull << d;
+            advance(node, node->cumulative);
+            rx_stats.delivered++;
+        }
+        node->ack_due = true;
+        portEXIT_CRITICAL(&rx_lock);
+    }
+    xTaskNotify(ack_task_handle, WAKE_BIT, eSetBits);
+}
+
+/**
+ * @brief Send a node its ACK, adding it as a peer first if needed; ACK task only
+ */
+static void send_ack(rx_node_t *node) {
+    uint8_t mac[6];
+    uint8_t frame[ESPNOW_RELIABLE_ACK_LEN + ESPNOW_RELIABLE_ACK_TRAILER_MAX];
+    portENTER_CRITICAL(&rx_lock);
+    memcpy(mac, node->mac, sizeof(mac));
+    frame[0] = ESPNOW_RELIABLE_MAGIC;
+    frame[1] = ESPNOW_RELIABLE_KIND_ACK;
+    put_u16(frame + 2, node->session);
+    uint32_t cumulative = node->cumulative;
+    put_u32(frame + 4, cumulative);
+    put_u32(frame + 8, (uint32_t)(node->received >> 1));
+    put_u16(frame + 12, hold_ms);
+    bool hold = hold_ms != 0;
+    node->ack_due = false;
+    portEXIT_CRITICAL(&rx_lock);
+    size_t len = ESPNOW_RELIABLE_ACK_LEN;
+    for (size_t i = 0; i < ESPNOW_RELIABLE_TRAILER_SLOTS; i++) {
+        espnow_reliable_ack_hook_t hook = ack_hooks[i];
+        if (hook != NULL) {
+            len += hook(mac, cumulative, frame + len, sizeof(frame) - len);
+        }
+    }
+
+    esp_err_t err = espnow_relay_send(mac, frame, len);     // Back the way it came, if through a relay
+    bool direct = err == ESP_ERR_NOT_FOUND;
+    if (direct) {
+        // An encrypted node is a peer from pairing (espnow_pair.h), or its frame would not be here
+        if (!node->peered) {
+            node->peered = espnow_link_encrypted() || espnow_link_add_peer(mac) == ESP_OK;
+        }
+        err = node->peered ? espnow_link_send(mac, frame, len) : ESP_ERR_NO_MEM;
+    }
+    portENTER_CRITICAL(&rx_lock);
+    if (err == ESP_OK) {
+        rx_stats.acks++;
+        rx_stats.hold_acks += hold;
+    } else {
+        rx_stats.ack_failed++;
+    }
+    portEXIT_CRITICAL(&rx_lock);
+    espnow_reliable_ack_sent_t sent = ack_sent_hook;
+    if (sent != NULL) {
+        sent(mac, direct, err == ESP_OK);
+    }
+}
+
+/**
+ * @brief Send the ACKs that are due; several frames from one node share one ACK
+ */
+static void ack_task(void *arg) {
+    uint32_t bits = 0;
+    while (!(bits & STOP_BIT)) {
+        xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+        for (size_t i = 0; i < ESPNOW_RELIABLE_MAX_NODES && !(bits & STOP_BIT); i++) {
+            if (nodes[i].used && nodes[i].ack_due) {
+                send_ack(&nodes[i]);
+            }
+        }
+    }
+
+    xSemaphoreGive(ack_stopped_sem);
+    vTaskDelete(NULL);
+}
+
+bool espnow_reliable_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    (void)rssi;
+    if (len < 2 || data[0] != ESPNOW_RELIABLE_MAGIC) {
+        return false;
+    }
+    if (data[1] == ESPNOW_RELIABLE_KIND_ACK) {
+        handle_ack(mac, data, len);
+    } else if (data[1] == ESPNOW_RELIABLE_KIND_DATA) {
+        handle_data(mac, data, len);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+esp_err_t espnow_reliable_sender_init(const uint8_t *peer) {
+    if (peer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ack_sem == NULL) {
+        ack_sem = xSemaphoreCreateBinary();
+        if (ack_sem == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    memset(&tx_stats, 0, sizeof(tx_stats));
+    if (!window_valid(peer)) {
+        memset(&window, 0, sizeof(window));
+        memcpy(window.peer, peer, sizeof(window.peer));
+        do {
+            window.session = (uint16_t)esp_random();
+        } while (window.session == 0);
+        window.magic = WINDOW_MAGIC;
+        ESP_LOGI(TAG, "New session %04x", window.session);
+    } else {
+        ESP_LOGI(TAG, "Session %04x resumed with %u frames waiting", window.session, espnow_reliable_backlog());
+    }
+    tx_stats.session = window.session;
+    sender_ready = true;
+    return ESP_OK;
+}
+
+esp_err_t espnow_reliable_sender_retarget(const uint8_t *peer) {
+    if (peer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!sender_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    portENTER_CRITICAL(&tx_lock);
+    memcpy(window.peer, peer, sizeof(window.peer));
+    for (size_t i = 0; i < ESPNOW_RELIABLE_WINDOW; i++) {
+        window.slots[i].sends = 0;              // Fresh timeouts for the new gateway
+        window.slots[i].sent_us = 0;
+        window.slots[i].lost = false;
+    }
+    hold_until_us = 0;                          // The hold was the old gateway's
+    portEXIT_CRITICAL(&tx_lock);
+    ESP_LOGI(TAG, "Session %04x moved to " MACSTR " with %u frames waiting", window.session, MAC2STR(peer),
+             espnow_reliable_backlog());
+    return ESP_OK;
+}
+
+esp_err_t espnow_reliable_send(const uint8_t *data, size_t len, uint8_t *mac_retries) {
+    return send_lane(data, len, mac_retries, false);
+}
+
+esp_err_t espnow_reliable_send_urgent(const uint8_t *data, size_t len, uint8_t *mac_retries) {
+    return send_lane(data, len, mac_retries, true);
+}
+
+uint32_t espnow_reliable_pump(void) {
+    if (!sender_ready) {
+        return ESPNOW_RELIABLE_WAIT_FOREVER;
+    }
+
+    pass_barrier();
+    uint8_t order[ESPNOW_RELIABLE_WINDOW];
+    uint8_t n = sorted_slots(order);
+    if (n == 0) {
+        return ESPNOW_RELIABLE_WAIT_FOREVER;
+    }
+    portENTER_CRITICAL(&tx_lock);
+    int64_t hold_left_us = hold_until_us - esp_timer_get_time();
+    portEXIT_CRITICAL(&tx_lock);
+    if (hold_left_us > 0) {
+        return (uint32_t)((hold_left_us + 999) / 1000);
+    }
+
+    uint32_t next_ms = ESPNOW_RELIABLE_WAIT_FOREVER;
+    for (uint8_t k = 0; k < n; k++) {
+        tx_slot_t *slot = &window.slots[order[k]];
+        portENTER_CRITICAL(&tx_lock);
+        bool used = slot->len != 0;
+        bool due = slot->lost || slot->sent_us == 0;
+        int64_t due_us = slot->sent_us + (int64_t)slot_rto_ms(slot) * 1000;
+        portEXIT_CRITICAL(&tx_lock);
+        if (!used) {
+            continue;
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (due || now >= due_us) {
+            if (slot->sends > 0) {
+                portENTER_CRITICAL(&tx_lock);
+                tx_stats.resends++;
+                portEXIT_CRITICAL(&tx_lock);
+            }
+            transmit(slot, NULL);
+            now = esp_timer_get_time();
+            due_us = now + (int64_t)slot_rto_ms(slot) * 1000;
+        }
+        uint32_t wait_ms = (uint32_t)((due_us - now + 999) / 1000);
+        if (wait_ms < next_ms) {
+            next_ms = wait_ms;
+        }
+    }
+    return next_ms;
+}
+
+esp_err_t espnow_reliable_flush(uint32_t timeout_ms) {
+    if (!sender_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (espnow_reliable_backlog() > 0) {
+        uint32_t wait_ms = espnow_reliable_pump();
+        int64_t remaining_ms = (deadline - esp_timer_get_time()) / 1000;
+        if (remaining_ms <= 0) {
+            return ESP_ERR_TIMEOUT;
+        }
+        if (wait_ms > remaining_ms) {
+            wait_ms = (uint32_t)remaining_ms;
+        }
+        xSemaphoreTake(ack_sem, pdMS_TO_TICKS(wait_ms) + 1);
+    }
+    return ESP_OK;
+}
+
+uint8_t espnow_reliable_backlog(void) {
+    uint8_t n = 0;
+    portENTER_CRITICAL(&tx_lock);
+    for (size_t i = 0; i < ESPNOW_RELIABLE_WINDOW; i++) {
+        n += window.slots[i].len != 0;
+    }
+    portEXIT_CRITICAL(&tx_lock);
+    return n;
+}
+
+void espnow_reliable_get_tx_stats(espnow_reliable_tx_stats_t *stats) {
+    uint8_t backlog = espnow_reliable_backlog();
+    portENTER_CRITICAL(&tx_lock);
+    *stats = tx_stats;
+    portEXIT_CRITICAL(&tx_lock);
+    stats->backlog = backlog;
+}
+
+void espnow_reliable_set_trailer_hook(uint8_t slot, espnow_reliable_trailer_hook_t hook) {
+    if (slot < ESPNOW_RELIABLE_TRAILER_SLOTS) {
+        trailer_hooks[slot] = hook;
+    }
+}
+
+void espnow_reliable_set_barrier(uint32_t seq, espnow_reliable_barrier_t handler) {
+    portENTER_CRITICAL(&tx_lock);
+    barrier_set = true;
+    barrier_open = false;
+    barrier_seq = seq;
+    barrier_handler = handler;
+    portEXIT_CRITICAL(&tx_lock);
+}
+
+void espnow_reliable_open_barrier(void) {
+    portENTER_CRITICAL(&tx_lock);
+    barrier_open = barrier_set;
+    portEXIT_CRITICAL(&tx_lock);
+}
+
+void espnow_reliable_clear_barrier(void) {
+    portENTER_CRITICAL(&tx_lock);
+    barrier_set = false;
+    barrier_open = false;
+    portEXIT_CRITICAL(&tx_lock);
+}
+
+uint32_t espnow_reliable_next_seq(void) {
+    portENTER_CRITICAL(&tx_lock);
+    uint32_t seq = window.next_seq;
+    portEXIT_CRITICAL(&tx_lock);
+    return seq;
+}
+
+esp_err_t espnow_reliable_receiver_init(espnow_reliable_deliver_t deliver) {
+    if (deliver == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ack_task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memset(nodes, 0, sizeof(nodes));
+    memset(&rx_stats, 0, sizeof(rx_stats));
+    hold_ms = 0;
+    ack_stopped_sem = xSemaphoreCreateBinary();
+    if (ack_stopped_sem == NULL ||
+        static_task_create(ack_task_slot, ack_task, ESPNOW_RELIABLE_ACK_TASK_NAME, ESPNOW_RELIABLE_ACK_TASK_STACK_SIZE, NULL,
+                           ESPNOW_RELIABLE_ACK_TASK_PRIORITY, &ack_task_handle, TASK_CORE_NET) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the ACK task");
+        ack_task_handle = NULL;
+        if (ack_stopped_sem != NULL) {
+            vSemaphoreDelete(ack_stopped_sem);
+            ack_stopped_sem = NULL;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    deliver_fn = deliver;
+    return ESP_OK;
+}
+
+esp_err_t espnow_reliable_receiver_deinit(void) {
+    deliver_fn = NULL;
+    if (ack_task_handle != NULL) {
+        xTaskNotify(ack_task_handle, STOP_BIT, eSetBits);
+        if (xSemaphoreTake(ack_stopped_sem, pdMS_TO_TICKS(STOP_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGW(TAG, "ACK task did not stop within %d ms", STOP_TIMEOUT_MS);
+            return ESP_ERR_TIMEOUT;
+        }
+        ack_task_handle = NULL;
+    }
+    if (ack_stopped_sem != NULL) {
+        vSemaphoreDelete(ack_stopped_sem);
+        ack_stopped_sem = NULL;
+    }
+    memset(nodes, 0, sizeof(nodes));
+    return ESP_OK;
+}
+
+void espnow_reliable_set_ack_hook(uint8_t slot, espnow_reliable_ack_hook_t hook) {
+    if (slot < ESPNOW_RELIABLE_TRAILER_SLOTS) {
+        ack_hooks[slot] = hook;
+    }
+}
+
+void espnow_reliable_set_ack_sent_hook(espnow_reliable_ack_sent_t hook) {
+    ack_sent_hook = hook;
+}
+
+void espnow_reliable_set_hold(uint32_t hold) {
+    portENTER_CRITICAL(&rx_lock);
+    bool changed = (hold_ms != 0) != (hold != 0);
+    hold_ms = hold > UINT16_MAX ? UINT16_MAX : (uint16_t)hold;
+    portEXIT_CRITICAL(&rx_lock);
+    if (changed) {
+        ESP_LOGI(TAG, hold ? "Holding nodes off (%lu ms)" : "Hold lifted", (unsigned long)hold);
+    }
+}
+
+void espnow_reliable_get_rx_stats(espnow_reliable_rx_stats_t *stats) {
+    portENTER_CRITICAL(&rx_lock);
+    *stats = rx_stats;
+    portEXIT_CRITICAL(&rx_lock);
+}
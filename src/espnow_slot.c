@@ -0,0 +1,482 @@
+/**
+ * @file espnow_slot.c
+ * @brief Transmit slots for duty-cycled nodes, on the gateway's time beacon (TDMA)
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "espnow_slot.h"
+#include "flash_io.h"
+#include "espnow_link.h"
+#include "espnow_time.h"
+#include "power_profile.h"
+#include "version.h"
+#include <string.h>
+#include <sys/time.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register espnow_slot.c version
+REGISTER_VERSION(EspnowSlot, "1.0.0", "2026-10-15");
+
+static const char *TAG = "ESPNOW_SLOT";
+
+#define TABLE_NVS_NAMESPACE "espnow_slot"
+#define TABLE_NVS_KEY "table"
+#define CLOCK_RECHECK_MS 1000                   // Gateway clock not set yet: look again this often
+
+// Window layout, microseconds from the start of a cycle
+#define CYCLE_US ((int64_t)ESPNOW_SLOT_CYCLE_S * 1000000)
+#define WINDOW_END_US ((int64_t)(ESPNOW_SLOT_COUNT * ESPNOW_SLOT_MS + ESPNOW_SLOT_OPEN_MS + ESPNOW_SLOT_GUARD_MS) * 1000)
+#define WINDOW_OPEN_US (CYCLE_US - (int64_t)ESPNOW_SLOT_GUARD_MS * 1000)
+
+/**
+ * @brief One slot on the gateway; under lock
+ */
+typedef struct {
+    uint8_t mac[6];
+    bool used;
+    bool reply_due;                             // An ASSIGN is owed; sent from the poll
+    int64_t seen_us;                            // Last REQUEST, esp_timer clock
+} slot_entry_t;
+
+/**
+ * @brief A node's slot; RTC_DATA_ATTR, so it survives deep sleep
+ */
+typedef struct {
+    bool valid;
+    uint8_t gateway[6];                         // Gateway that assigned it
+    uint8_t slot;
+    uint8_t count;
+    uint16_t slot_ms;
+    uint16_t cycle_s;
+    uint16_t open_ms;
+    uint32_t assigned_s;                        // Unix seconds of the ASSIGN
+    uint32_t requests;
+    uint32_t late;
+} node_slot_t;
+
+// Gateway
+static slot_entry_t table[ESPNOW_SLOT_COUNT];
+static bool serving = false;
+static bool sleep_windows = false;
+static bool table_dirty = false;                // lock
+static bool radio_held = false;                 // Poll only
+static void (*wake_cb)(void) = NULL;
+static espnow_slot_stats_t stats;               // lock
+
+// Node
+static RTC_DATA_ATTR node_slot_t rtc_slot;
+static uint8_t gateway[6];
+static bool node_ready = false;
+static SemaphoreHandle_t assigned_sem = NULL;   // Given by the receive handler on an ASSIGN
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static void put_u16(uint8_t *p, uint16_t v);
+static uint16_t get_u16(const uint8_t *p);
+static int64_t unix_us(void);
+static void gateway_receive(const uint8_t *mac);
+static void node_receive(const uint8_t *data, size_t len);
+static void load_table(void);
+static void save_table(void);
+static void send_assigns(void);
+static void hold_radio(bool hold);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**
+ * @brief Gateway system time in Unix microseconds, 0 while it is not set
+ */
+static int64_t unix_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    if (tv.tv_sec < ESPNOW_TIME_VALID_AFTER) {
+        return 0;
+    }
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/**
+ * @brief A REQUEST: renew the node's slot or give it a free one; runs in the link task
+ */
+static void gateway_receive(const uint8_t *mac) {
+    int64_t now = esp_timer_get_time();
+    int found = -1;
+    int free_slot = -1;
+    portENTER_CRITICAL(&lock);
+    stats.requests++;
+    for (int i = 0; i < ESPNOW_SLOT_COUNT && found < 0; i++) {
+        if (table[i].used && memcmp(table[i].mac, mac, 6) == 0) {
+            found = i;
+        } else if (free_slot < 0 && (!table[i].used || now - table[i].seen_us > (int64_t)ESPNOW_SLOT_LEASE_S * 1000000)) {
+            free_slot = i;
+        }
+    }
+    if (found < 0 && free_slot >= 0) {
+        found = free_slot;
+        memcpy(table[found].mac, mac, 6);
+        table[found].used = true;
+        table_dirty = true;
+    }
+    if (found >= 0) {
+        table[found].reply_due = true;
+        table[found].seen_us = now;
+    } else {
+        stats.refused++;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (found < 0) {
+        ESP_LOGW(TAG, "No slot left for " MACSTR, MAC2STR(mac));
+    } else if (wake_cb != NULL) {
+        wake_cb();
+    }
+}
+
+/**
+ * @brief An ASSIGN from the gateway; runs in the link task
+ */
+static void node_receive(const uint8_t *data, size_t len) {
+    if (len < ESPNOW_SLOT_ASSIGN_LEN || data[2] >= data[3] || get_u16(data + 6) == 0) {
+        return;
+    }
+    portENTER_CRITICAL(&lock);
+    rtc_slot.valid = true;
+    memcpy(rtc_slot.gateway, gateway, sizeof(gateway));
+    rtc_slot.slot = data[2];
+    rtc_slot.count = data[3];
+    rtc_slot.slot_ms = get_u16(data + 4);
+    rtc_slot.cycle_s = get_u16(data + 6);
+    rtc_slot.open_ms = get_u16(data + 8);
+    rtc_slot.assigned_s = espnow_time_now();
+    portEXIT_CRITICAL(&lock);
+    xSemaphoreGive(assigned_sem);
+    ESP_LOGI(TAG, "Slot %u of %u (%u ms every %u s)", data[2], data[3], get_u16(data + 4), get_u16(data + 6));
+}
+
+bool espnow_slot_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    (void)rssi;
+    if (len < 2 || data[0] != ESPNOW_SLOT_MAGIC) {
+        return false;
+    }
+    if (data[1] == ESPNOW_SLOT_KIND_REQUEST && serving) {
+        gateway_receive(mac);
+    } else if (data[1] == ESPNOW_SLOT_KIND_ASSIGN && node_ready && memcmp(mac, gateway, sizeof(gateway)) == 0) {
+        node_receive(data, len);
+    }
+    return true;
+}
+
+/**
+ * @brief Slots from before a restart; their leases start over
+ */
+static void load_table(void) {
+    uint8_t macs[ESPNOW_SLOT_COUNT][6] = { 0 };
+    size_t len = sizeof(macs);
+    nvs_handle_t handle;
+    if (nvs_open(TABLE_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    esp_err_t err = nvs_get_blob(handle, TABLE_NVS_KEY, macs, &len);
+    nvs_close(handle);
+    if (err != ESP_OK || len != sizeof(macs)) {
+        return;
+    }
+
+    static const uint8_t none[6] = { 0 };
+    int64_t now = esp_timer_get_time();
+    uint32_t used = 0;
+    for (int i = 0; i < ESPNOW_SLOT_COUNT; i++) {
+        table[i].used = memcmp(macs[i], none, 6) != 0;
+        memcpy(table[i].mac, macs[i], 6);
+        table[i].seen_us = now;
+        used += table[i].used ? 1 : 0;
+    }
+    ESP_LOGI(TAG, "%lu slots held from before the restart", (unsigned long)used);
+}
+
+static void save_table(void) {
+    uint8_t macs[ESPNOW_SLOT_COUNT][6] = { 0 };
+    portENTER_CRITICAL(&lock);
+    for (int i = 0; i < ESPNOW_SLOT_COUNT; i++) {
+        if (table[i].used) {
+            memcpy(macs[i], table[i].mac, 6);
+        }
+    }
+    table_dirty = false;
+    portEXIT_CRITICAL(&lock);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(TABLE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = flash_io_nvs_set_blob(handle, TABLE_NVS_KEY, macs, sizeof(macs));
+        if (err == ESP_OK) {
+            err = flash_io_nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Slot table not saved: %s", esp_err_to_name(err));
+    }
+}
+
+/**
+ * @brief Send the ASSIGNs the link task marked due
+ */
+static void send_assigns(void) {
+    for (int i = 0; i < ESPNOW_SLOT_COUNT; i++) {
+        uint8_t mac[6];
+        bool due;
+        portENTER_CRITICAL(&lock);
+        due = table[i].reply_due;
+        table[i].reply_due = false;
+        memcpy(mac, table[i].mac, 6);
+        portEXIT_CRITICAL(&lock);
+        if (!due) {
+            continue;
+        }
+
+        uint8_t frame[ESPNOW_SLOT_ASSIGN_LEN];
+        frame[0] = ESPNOW_SLOT_MAGIC;
+        frame[1] = ESPNOW_SLOT_KIND_ASSIGN;
+        frame[2] = (uint8_t)i;
+        frame[3] = ESPNOW_SLOT_COUNT;
+        put_u16(frame + 4, ESPNOW_SLOT_MS);
+        put_u16(frame + 6, ESPNOW_SLOT_CYCLE_S);
+        put_u16(frame + 8, ESPNOW_SLOT_OPEN_MS);
+        esp_err_t err = espnow_link_add_peer(mac);
+        if (err == ESP_OK) {
+            err = espnow_link_send(mac, frame, sizeof(frame));
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "ASSIGN to " MACSTR " not sent: %s", MAC2STR(mac), esp_err_to_name(err));
+        }
+    }
+}
+
+static void hold_radio(bool hold) {
+    if (hold == radio_held) {
+        return;
+    }
+    radio_held = hold;
+    if (hold) {
+        power_profile_acquire(POWER_LOCK_RADIO);
+        portENTER_CRITICAL(&lock);
+        stats.windows++;
+        portEXIT_CRITICAL(&lock);
+    } else {
+        power_profile_release(POWER_LOCK_RADIO);
+    }
+}
+
+esp_err_t espnow_slot_gateway_start(bool sleep_between, void (*wake)(void)) {
+    memset(table, 0, sizeof(table));
+    memset(&stats, 0, sizeof(stats));
+    load_table();
+    wake_cb = wake;
+    sleep_windows = sleep_between;
+    hold_radio(true);                           // Until the clock places the first window
+    serving = true;
+    ESP_LOGI(TAG, "%d slots of %d ms every %d s%s", ESPNOW_SLOT_COUNT, ESPNOW_SLOT_MS, ESPNOW_SLOT_CYCLE_S,
+             sleep_between ? ", radio asleep between windows" : "");
+    return ESP_OK;
+}
+
+void espnow_slot_gateway_poll(void) {
+    if (!serving) {
+        return;
+    }
+    send_assigns();
+    bool dirty;
+    portENTER_CRITICAL(&lock);
+    dirty = table_dirty;
+    portEXIT_CRITICAL(&lock);
+    if (dirty) {
+        save_table();
+    }
+
+    if (sleep_windows) {
+        int64_t now = unix_us();
+        int64_t pos = now % CYCLE_US;
+        hold_radio(now == 0 || pos < WINDOW_END_US || pos >= WINDOW_OPEN_US);
+    }
+}
+
+uint32_t espnow_slot_gateway_poll_due_ms(void) {
+    if (!serving) {
+        return UINT32_MAX;
+    }
+    bool due = false;
+    portENTER_CRITICAL(&lock);
+    for (int i = 0; i < ESPNOW_SLOT_COUNT && !due; i++) {
+        due = table[i].reply_due;
+    }
+    due = due || table_dirty;
+    portEXIT_CRITICAL(&lock);
+    if (due) {
+        return 0;
+    }
+    if (!sleep_windows) {
+        return UINT32_MAX;
+    }
+
+    int64_t now = unix_us();
+    if (now == 0) {
+        return CLOCK_RECHECK_MS;
+    }
+    int64_t pos = now % CYCLE_US;
+    int64_t edge;
+    if (pos < WINDOW_END_US) {
+        edge = WINDOW_END_US - pos;
+    } else if (pos < WINDOW_OPEN_US) {
+        edge = WINDOW_OPEN_US - pos;
+    } else {
+        edge = CYCLE_US - pos + WINDOW_END_US;
+    }
+    return (uint32_t)((edge + 999) / 1000);
+}
+
+void espnow_slot_gateway_stop(void) {
+    serving = false;
+    hold_radio(false);
+}
+
+void espnow_slot_node_init(const uint8_t *gateway_mac) {
+    memcpy(gateway, gateway_mac, sizeof(gateway));
+    portENTER_CRITICAL(&lock);
+    if (memcmp(rtc_slot.gateway, gateway, sizeof(gateway)) != 0) {
+        rtc_slot.valid = false;                 // Another gateway's schedule (failover)
+    }
+    portEXIT_CRITICAL(&lock);
+    if (assigned_sem == NULL) {
+        assigned_sem = xSemaphoreCreateBinary();
+    }
+    node_ready = assigned_sem != NULL;
+}
+
+bool espnow_slot_node_due(void) {
+    bool due;
+    uint32_t now = espnow_time_now();
+    portENTER_CRITICAL(&lock);
+    due = !rtc_slot.valid || now - rtc_slot.assigned_s >= ESPNOW_SLOT_RENEW_S;
+    portEXIT_CRITICAL(&lock);
+    return due;
+}
+
+esp_err_t espnow_slot_node_request(uint32_t wait_ms) {
+    espnow_time_stats_t ts;
+    espnow_time_get_stats(&ts);
+    if (!node_ready || !ts.synced) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t frame[ESPNOW_SLOT_REQUEST_LEN] = { ESPNOW_SLOT_MAGIC, ESPNOW_SLOT_KIND_REQUEST };
+    xSemaphoreTake(assigned_sem, 0);
+    portENTER_CRITICAL(&lock);
+    rtc_slot.requests++;
+    portEXIT_CRITICAL(&lock);
+    esp_err_t err = espnow_link_send(gateway, frame, sizeof(frame));
+    if (err != ESP_OK) {
+        return err;
+    }
+    return xSemaphoreTake(assigned_sem, pdMS_TO_TICKS(wait_ms)) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+int64_t espnow_slot_node_next_us(int64_t after_us) {
+    espnow_time_stats_t ts;
+    espnow_time_get_stats(&ts);
+    if (!ts.synced || after_us <= 0) {
+        return 0;
+    }
+
+    node_slot_t s;
+    portENTER_CRITICAL(&lock);
+    s = rtc_slot;
+    portEXIT_CRITICAL(&lock);
+    int64_t offset_ms;
+    int64_t cycle_us;
+    if (s.valid) {
+        offset_ms = (int64_t)s.slot * s.slot_ms;
+        cycle_us = (int64_t)s.cycle_s * 1000000;
+    } else {
+        // Somewhere in the open period, leaving a slot's time for the exchange
+        offset_ms = ESPNOW_SLOT_COUNT * ESPNOW_SLOT_MS + esp_random() % (ESPNOW_SLOT_OPEN_MS - ESPNOW_SLOT_MS);
+        cycle_us = CYCLE_US;
+    }
+    int64_t at = after_us - after_us % cycle_us + offset_ms * 1000;
+    return at < after_us ? at + cycle_us : at;
+}
+
+void espnow_slot_node_wait(void) {
+    node_slot_t s;
+    portENTER_CRITICAL(&lock);
+    s = rtc_slot;
+    portEXIT_CRITICAL(&lock);
+    if (!s.valid) {
+        return;
+    }
+
+    int64_t now = espnow_time_now_us();
+    int64_t start = espnow_slot_node_next_us(now - (int64_t)s.slot_ms * 1000);
+    if (start == 0 || start <= now) {
+        return;                                 // Inside the slot already
+    }
+    int64_t early_ms = (start - now) / 1000;
+    if (early_ms <= ESPNOW_SLOT_LEAD_MS + ESPNOW_SLOT_GUARD_MS) {
+        vTaskDelay(pdMS_TO_TICKS(early_ms));
+        return;
+    }
+    // The slot went by while booting: send anyway, and count it
+    portENTER_CRITICAL(&lock);
+    rtc_slot.late++;
+    portEXIT_CRITICAL(&lock);
+    ESP_LOGD(TAG, "Slot missed by the wake, sending outside it");
+}
+
+void espnow_slot_get_stats(espnow_slot_stats_t *out) {
+    portENTER_CRITICAL(&lock);
+    if (node_ready) {
+        memset(out, 0, sizeof(*out));
+        out->assigned = rtc_slot.valid ? 1 : 0;
+        out->slot = rtc_slot.slot;
+        out->requests = rtc_slot.requests;
+        out->late = rtc_slot.late;
+    } else {
+        *out = stats;
+        out->assigned = 0;
+        for (int i = 0; i < ESPNOW_SLOT_COUNT; i++) {
+            out->assigned += table[i].used ? 1 : 0;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+}
@@ -0,0 +1,322 @@
+/**
+ * @file espnow_time.c
+ * @brief Gateway time beacon over ESP-NOW; nodes keep their clock from it, with offset and drift
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "espnow_time.h"
+#include "espnow_link.h"
+#include "version.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_netif_sntp.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register espnow_time.c version
+REGISTER_VERSION(EspnowTime, "1.0.0", "2026-10-15");
+
+static const char *TAG = "ESPNOW_TIME";
+
+static const uint8_t broadcast_mac[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+/**
+ * @brief A node's clock model; RTC_DATA_ATTR, so it survives deep sleep with the system time
+ */
+typedef struct {
+    bool synced;
+    uint8_t source;                             // ESPNOW_TIME_SOURCE_* of the last beacon taken
+    bool drift_known;
+    int32_t drift_ppm;                          // Smoothed over syncs
+    int64_t sync_us;                            // Unix microseconds the clock was set to at the last sync
+    int32_t last_offset_ms;
+    uint32_t syncs;
+} node_clock_t;
+
+// Gateway
+static bool beaconing = false;
+static bool sntp_running = false;
+static bool sntp_synced = false;                // lock
+static uint32_t sntp_syncs = 0;                 // lock
+static int64_t last_beacon_us = 0;
+static uint32_t beacons_sent = 0;
+
+// Node
+static RTC_DATA_ATTR node_clock_t rtc_clock;
+static uint8_t gateway[6];
+static bool node_ready = false;
+static uint32_t beacons_heard = 0;              // lock
+static SemaphoreHandle_t synced_sem = NULL;     // Given by the receive handler after a sync
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static void put_u64(uint8_t *p, uint64_t v);
+static uint64_t get_u64(const uint8_t *p);
+static int64_t clock_us(void);
+static bool clock_valid(void);
+static void on_sntp_sync(struct timeval *tv);
+static bool due_locked(int64_t now_us);
+static void take_beacon(uint8_t source, int64_t gateway_us);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void put_u64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/**
+ * @brief System time in Unix microseconds
+ */
+static int64_t clock_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static bool clock_valid(void) {
+    return time(NULL) >= ESPNOW_TIME_VALID_AFTER;
+}
+
+/**
+ * @brief SNTP set the clock; runs in the lwIP task
+ */
+static void on_sntp_sync(struct timeval *tv) {
+    (void)tv;
+    bool first;
+    portENTER_CRITICAL(&lock);
+    first = !sntp_synced;
+    sntp_synced = true;
+    sntp_syncs++;
+    portEXIT_CRITICAL(&lock);
+    if (first) {
+        ESP_LOGI(TAG, "Clock set over SNTP - beaconing it to the nodes");
+    }
+}
+
+/**
+ * @brief Whether the node clock needs a beacon
+ */
+static bool due_locked(int64_t now_us) {
+    if (!rtc_clock.synced) {
+        return true;
+    }
+    int64_t period_s = rtc_clock.drift_known ? ESPNOW_TIME_RESYNC_S : ESPNOW_TIME_DRIFT_SPAN_S;
+    return now_us - rtc_clock.sync_us >= period_s * 1000000;
+}
+
+/**
+ * @brief Measure the drift since the last sync and set the clock; runs in the link task
+ *
+ * The clock ran free since it was last set to sync_us, so its error now
+ * over the span it covered is the rate error of the clock.
+ */
+static void take_beacon(uint8_t source, int64_t gateway_us) {
+    int64_t local_us = clock_us();
+    int64_t offset_us = gateway_us - local_us;
+    bool measured = false;
+    int32_t drift = 0;
+
+    portENTER_CRITICAL(&lock);
+    int64_t span_us = local_us - rtc_clock.sync_us;
+    if (rtc_clock.synced && span_us >= (int64_t)ESPNOW_TIME_DRIFT_SPAN_S * 1000000) {
+        int64_t ppm = offset_us * 1000000 / span_us;
+        if (llabs(ppm) <= ESPNOW_TIME_DRIFT_MAX_PPM) {
+            rtc_clock.drift_ppm = rtc_clock.drift_known ? (int32_t)((3 * (int64_t)rtc_clock.drift_ppm + ppm) / 4)
+                                                        : (int32_t)ppm;
+            rtc_clock.drift_known = true;
+            measured = true;
+        }
+    }
+    rtc_clock.synced = true;
+    rtc_clock.source = source;
+    rtc_clock.sync_us = gateway_us;
+    rtc_clock.last_offset_ms = (int32_t)(offset_us / 1000);
+    rtc_clock.syncs++;
+    drift = rtc_clock.drift_ppm;
+    portEXIT_CRITICAL(&lock);
+
+    struct timeval tv = {
+        .tv_sec = (time_t)(gateway_us / 1000000),
+        .tv_usec = (suseconds_t)(gateway_us % 1000000),
+    };
+    settimeofday(&tv, NULL);
+    xSemaphoreGive(synced_sem);
+    ESP_LOGI(TAG, "Clock set from the gateway%s: offset %ld ms, drift %ld ppm%s",
+             source == ESPNOW_TIME_SOURCE_HOLDOVER ? " (holdover)" : "", (long)(offset_us / 1000), (long)drift,
+             measured ? "" : " (not measured)");
+}
+
+bool espnow_time_on_receive(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    (void)rssi;
+    if (len < 2 || data[0] != ESPNOW_TIME_MAGIC) {
+        return false;
+    }
+    if (!node_ready || data[1] != ESPNOW_TIME_KIND_BEACON || len < ESPNOW_TIME_BEACON_LEN ||
+        memcmp(mac, gateway, sizeof(gateway)) != 0) {
+        return true;
+    }
+
+    int64_t gateway_us = (int64_t)get_u64(data + 3);
+    bool due;
+    portENTER_CRITICAL(&lock);
+    beacons_heard++;
+    due = due_locked(clock_us());
+    portEXIT_CRITICAL(&lock);
+    if (due && gateway_us >= (int64_t)ESPNOW_TIME_VALID_AFTER * 1000000) {
+        take_beacon(data[2], gateway_us);
+    }
+    return true;
+}
+
+esp_err_t espnow_time_gateway_start(void) {
+    esp_err_t err = espnow_link_add_peer(broadcast_mac);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Without an uplink SNTP never answers; the beacon then carries the clock kept from an earlier sync
+    esp_sntp_config_t cfg = ESP_NETIF_SNTP_DEFAULT_CONFIG(ESPNOW_TIME_SNTP_SERVER);
+    cfg.sync_cb = on_sntp_sync;
+    err = esp_netif_sntp_init(&cfg);
+    sntp_running = err == ESP_OK;
+    if (!sntp_running) {
+        ESP_LOGW(TAG, "SNTP unavailable, beaconing the clock as held: %s", esp_err_to_name(err));
+    }
+    last_beacon_us = esp_timer_get_time() - (int64_t)ESPNOW_TIME_BEACON_MS * 1000;
+    beaconing = true;
+    ESP_LOGI(TAG, "Time beacon every %d ms%s", ESPNOW_TIME_BEACON_MS,
+             clock_valid() ? "" : ", once the clock is set");
+    return ESP_OK;
+}
+
+void espnow_time_gateway_poll(void) {
+    if (!beaconing || espnow_time_gateway_poll_due_ms() > 0) {
+        return;
+    }
+    last_beacon_us = esp_timer_get_time();
+    if (!clock_valid()) {
+        return;
+    }
+
+    bool synced;
+    portENTER_CRITICAL(&lock);
+    synced = sntp_synced;
+    portEXIT_CRITICAL(&lock);
+    uint8_t frame[ESPNOW_TIME_BEACON_LEN];
+    frame[0] = ESPNOW_TIME_MAGIC;
+    frame[1] = ESPNOW_TIME_KIND_BEACON;
+    frame[2] = synced ? ESPNOW_TIME_SOURCE_SNTP : ESPNOW_TIME_SOURCE_HOLDOVER;
+    put_u64(frame + 3, (uint64_t)clock_us());
+    if (espnow_link_send(broadcast_mac, frame, sizeof(frame)) == ESP_OK) {
+        beacons_sent++;
+    }
+}
+
+uint32_t espnow_time_gateway_poll_due_ms(void) {
+    if (!beaconing) {
+        return UINT32_MAX;
+    }
+    int64_t since_ms = (esp_timer_get_time() - last_beacon_us) / 1000;
+    return since_ms < ESPNOW_TIME_BEACON_MS ? ESPNOW_TIME_BEACON_MS - (uint32_t)since_ms : 0;
+}
+
+void espnow_time_gateway_stop(void) {
+    beaconing = false;
+    if (sntp_running) {
+        esp_netif_sntp_deinit();
+        sntp_running = false;
+    }
+}
+
+void espnow_time_node_init(const uint8_t *gateway_mac) {
+    memcpy(gateway, gateway_mac, sizeof(gateway));
+    if (synced_sem == NULL) {
+        synced_sem = xSemaphoreCreateBinary();
+    }
+    node_ready = synced_sem != NULL;
+}
+
+bool espnow_time_node_due(void) {
+    bool due;
+    portENTER_CRITICAL(&lock);
+    due = due_locked(clock_us());
+    portEXIT_CRITICAL(&lock);
+    return due;
+}
+
+esp_err_t espnow_time_node_sync(uint32_t wait_ms) {
+    if (!node_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(synced_sem, 0);              // A sync from before this call does not count
+    if (!espnow_time_node_due()) {
+        return ESP_OK;
+    }
+    return xSemaphoreTake(synced_sem, pdMS_TO_TICKS(wait_ms)) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+int64_t espnow_time_now_us(void) {
+    int64_t now_us = clock_us();
+    portENTER_CRITICAL(&lock);
+    if (rtc_clock.synced && rtc_clock.drift_known) {
+        now_us += (now_us - rtc_clock.sync_us) * rtc_clock.drift_ppm / 1000000;
+    }
+    portEXIT_CRITICAL(&lock);
+    return now_us;
+}
+
+uint32_t espnow_time_now(void) {
+    return (uint32_t)(espnow_time_now_us() / 1000000);
+}
+
+void espnow_time_get_stats(espnow_time_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    portENTER_CRITICAL(&lock);
+    if (node_ready) {
+        stats->synced = rtc_clock.synced;
+        stats->source = rtc_clock.source;
+        stats->beacons = beacons_heard;
+        stats->syncs = rtc_clock.syncs;
+        stats->last_offset_ms = rtc_clock.last_offset_ms;
+        stats->drift_ppm = rtc_clock.drift_ppm;
+        stats->drift_known = rtc_clock.drift_known;
+        stats->last_sync_s = rtc_clock.synced ? (uint32_t)(rtc_clock.sync_us / 1000000) : 0;
+    } else {
+        stats->source = sntp_synced ? ESPNOW_TIME_SOURCE_SNTP : ESPNOW_TIME_SOURCE_HOLDOVER;
+        stats->beacons = beacons_sent;
+        stats->syncs = sntp_syncs;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (!node_ready) {
+        stats->synced = clock_valid();
+    }
+}
@@ -0,0 +1,207 @@
+/**
+ * @file event_log.c
+ * @brief Binary event log: call sites record a format and raw arguments, text is made only when read
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "event_log.h"
+#include <stdio.h>
+#include <string.h>
+#include "version.h"
+#include "static_mem.h"
+#include "task_plan.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register event_log.c version
+REGISTER_VERSION(EventLog, "1.0.0", "2026-10-15");
+
+static const char *TAG = "EVENT_LOG";
+
+#define SLOT_MASK (EVENT_LOG_SLOTS - 1)
+
+_Static_assert((EVENT_LOG_SLOTS & SLOT_MASK) == 0, "EVENT_LOG_SLOTS must be a power of two");
+
+/**
+ * @brief One ring slot; seq is written last, so a reader that sees it sees the rest
+ */
+typedef struct {
+    uint32_t seq;                               // Event seq + 1 once published, 0 while being written
+    uint8_t level;
+    uint8_t core;
+    uint8_t argc;
+    const char *tag;
+    const char *format;
+    int64_t time_us;
+    uint32_t args[EVENT_LOG_MAX_ARGS];
+} slot_t;
+
+static slot_t slots[EVENT_LOG_SLOTS];
+static uint32_t head = 0;                       // Next seq; claimed with an atomic add by every producer
+
+// Drain task state; only it writes these
+static uint32_t drained = 0;
+static uint32_t drain_lost = 0;
+static TaskHandle_t drain_task_handle = NULL;
+STATIC_TASK_SLOT(drain_task_slot, EVENT_LOG_TASK_STACK_SIZE);
+
+// =============================
+// Function Prototypes
+// =============================
+static void drain_task(void *param);
+
+// =============================
+// Function Definitions
+// =============================
+
+void event_log_record(esp_log_level_t level, const char *tag, const char *format, const uint32_t *args,
+                      size_t argc) {
+    uint32_t seq = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+    slot_t *slot = &slots[seq & SLOT_MASK];
+
+    // Unpublish first: a reader copying the old event now sees the change and drops its copy
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (argc > EVENT_LOG_MAX_ARGS) {
+        argc = EVENT_LOG_MAX_ARGS;
+    }
+    slot->level = (uint8_t)level;
+    slot->core = (uint8_t)xPortGetCoreID();
+    slot->argc = (uint8_t)argc;
+    slot->tag = tag;
+    slot->format = format;
+    slot->time_us = esp_timer_get_time();
+    for (size_t i = 0; i < argc; i++) {
+        slot->args[i] = args[i];
+    }
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+bool event_log_read(uint32_t *cursor, event_log_entry_t *entry, uint32_t *lost) {
+    uint32_t skipped = 0;
+    uint32_t c = *cursor;
+    bool found = false;
+    while (!found) {
+        uint32_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+        if ((int32_t)(h - c) > EVENT_LOG_SLOTS) {
+            skipped += h - EVENT_LOG_SLOTS - c;
+            c = h - EVENT_LOG_SLOTS;
+        }
+        if ((int32_t)(h - c) <= 0) {
+            break;
+        }
+
+        const slot_t *slot = &slots[c & SLOT_MASK];
+        uint32_t v = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (v != c + 1) {
+            if (v != 0 && (int32_t)(v - (c + 1)) > 0) {
+                // Already overwritten by a later event
+                skipped++;
+                c++;
+                continue;
+            }
+            // Claimed but still being written; keep the order and come back for it
+            break;
+        }
+
+        entry->seq = c;
+        entry->level = slot->level;
+        entry->core = slot->core;
+        entry->argc = slot->argc;
+        entry->tag = slot->tag;
+        entry->format = slot->format;
+        entry->time_us = slot->time_us;
+        memcpy(entry->args, slot->args, sizeof(entry->args));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != v) {
+            // Overwritten while it was copied
+            skipped++;
+            c++;
+            continue;
+        }
+        c++;
+        found = true;
+    }
+    *cursor = c;
+    if (lost != NULL) {
+        *lost = skipped;
+    }
+    return found;
+}
+
+size_t event_log_format(const event_log_entry_t *entry, char *buf, size_t size) {
+    static const char letters[] = "NEWIDV";
+    char letter = entry->level < sizeof(letters) - 1 ? letters[entry->level] : '?';
+    int n = snprintf(buf, size, "%c (%lu) %s: ", letter, (unsigned long)(entry->time_us / 1000), entry->tag);
+    if (n < 0 || (size_t)n >= size) {
+        return n < 0 ? 0 : size - 1;
+    }
+    // Every conversion takes a 32-bit integer; unused arguments are ignored
+    const uint32_t *a = entry->args;
+    int m = snprintf(buf + n, size - (size_t)n, entry->format, a[0], a[1], a[2], a[3], a[4], a[5]);
+    if (m < 0) {
+        return (size_t)n;
+    }
+    return (size_t)n + ((size_t)m < size - (size_t)n ? (size_t)m : size - (size_t)n - 1);
+}
+
+uint32_t event_log_head(void) {
+    return __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+}
+
+void event_log_get_stats(event_log_stats_t *stats) {
+    stats->recorded = event_log_head();
+    stats->drained = drained;
+    stats->overwritten = drain_lost;
+}
+
+/**
+ * @brief Print the events the tags' log levels let through, a batch per period
+ */
+static void drain_task(void *param) {
+    (void)param;
+    uint32_t cursor = 0;
+    char line[EVENT_LOG_LINE_MAX];
+    event_log_entry_t entry;
+    while (1) {
+        uint32_t lost;
+        while (event_log_read(&cursor, &entry, &lost)) {
+            if (lost > 0) {
+                drain_lost += lost;
+                esp_log_write(ESP_LOG_WARN, TAG, "W (%lu) %s: %lu events overwritten before they were printed\n",
+                              (unsigned long)(esp_timer_get_time() / 1000), TAG, (unsigned long)lost);
+            }
+            if (entry.level > esp_log_level_get(entry.tag)) {
+                continue;
+            }
+            // Through the log output, so a hook on it (syslog_sink.h) gets these lines too
+            event_log_format(&entry, line, sizeof(line));
+            esp_log_write((esp_log_level_t)entry.level, entry.tag, "%s\n", line);
+            drained++;
+        }
+        vTaskDelay(pdMS_TO_TICKS(EVENT_LOG_DRAIN_MS));
+    }
+}
+
+esp_err_t event_log_start(void) {
+    if (EVENT_LOG_UART == 0 || drain_task_handle != NULL) {
+        return ESP_OK;
+    }
+    if (static_task_create(drain_task_slot, drain_task, EVENT_LOG_TASK_NAME, EVENT_LOG_TASK_STACK_SIZE, NULL,
+                           EVENT_LOG_TASK_PRIORITY, &drain_task_handle, TASK_CORE_NET) != pdPASS) {
+        drain_task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,188 @@
+/**
+ * @file fault_inject.c
+ * @brief Controlled loss on the ESP-NOW and MQTT paths, for reliability benchmarks
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "fault_inject.h"
+#include "metrics_export.h"
+#include "version.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register fault_inject.c version
+REGISTER_VERSION(FaultInject, "1.0.0", "2026-10-15");
+
+static const char *TAG = "FAULT_INJECT";
+
+_Static_assert(FAULT_INJECT_DROP_PERMILLE + FAULT_INJECT_DELAY_PERMILLE + FAULT_INJECT_DUPLICATE_PERMILLE +
+               FAULT_INJECT_REORDER_PERMILLE <= 1000, "FAULT_INJECT_*_PERMILLE add up to more than 1000");
+
+static const char *const POINT_NAMES[FAULT_INJECT_POINT_COUNT] = {
+    [FAULT_INJECT_ESPNOW_RX] = "espnow_rx",
+    [FAULT_INJECT_MQTT] = "mqtt",
+};
+
+static const char *const ACTION_NAMES[FAULT_INJECT_ACTION_COUNT] = {
+    [FAULT_INJECT_PASS] = "pass",
+    [FAULT_INJECT_DROP] = "drop",
+    [FAULT_INJECT_DELAY] = "delay",
+    [FAULT_INJECT_DUPLICATE] = "duplicate",
+    [FAULT_INJECT_REORDER] = "reorder",
+};
+
+static fault_inject_profile_t profiles[FAULT_INJECT_POINT_COUNT];
+static uint32_t counts[FAULT_INJECT_POINT_COUNT][FAULT_INJECT_ACTION_COUNT];
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static bool started = false;
+
+// =============================
+// Function Prototypes
+// =============================
+static void write_fault_metrics(metrics_export_writer_t *w);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Actions drawn per point, and the probabilities in force
+ */
+static void write_fault_metrics(metrics_export_writer_t *w) {
+    char labels[64];
+    metrics_export_family(w, "fault_injected", METRICS_EXPORT_COUNTER, NULL,
+                          "Frames and messages by injected fault (FAULT_INJECT builds)");
+    for (int p = 0; p < FAULT_INJECT_POINT_COUNT; p++) {
+        for (int a = 0; a < FAULT_INJECT_ACTION_COUNT; a++) {
+            snprintf(labels, sizeof(labels), "point=\"%s\",action=\"%s\"", POINT_NAMES[p], ACTION_NAMES[a]);
+            metrics_export_sample_int(w, "fault_injected", "_total", labels, fault_inject_count(p, a));
+        }
+    }
+    metrics_export_family(w, "fault_probability_permille", METRICS_EXPORT_GAUGE, NULL,
+                          "Probability of each injected fault");
+    for (int p = 0; p < FAULT_INJECT_POINT_COUNT; p++) {
+        fault_inject_profile_t prof;
+        fault_inject_get(p, &prof);
+        const uint16_t values[FAULT_INJECT_ACTION_COUNT] = {
+            [FAULT_INJECT_PASS] = 1000 - prof.drop - prof.delay - prof.duplicate - prof.reorder,
+            [FAULT_INJECT_DROP] = prof.drop,
+            [FAULT_INJECT_DELAY] = prof.delay,
+            [FAULT_INJECT_DUPLICATE] = prof.duplicate,
+            [FAULT_INJECT_REORDER] = prof.reorder,
+        };
+        for (int a = 0; a < FAULT_INJECT_ACTION_COUNT; a++) {
+            snprintf(labels, sizeof(labels), "point=\"%s\",action=\"%s\"", POINT_NAMES[p], ACTION_NAMES[a]);
+            metrics_export_sample_int(w, "fault_probability_permille", "", labels, values[a]);
+        }
+    }
+}
+
+esp_err_t fault_inject_init(void) {
+    if (FAULT_INJECT == 0 || started) {
+        return ESP_OK;
+    }
+    for (int p = 0; p < FAULT_INJECT_POINT_COUNT; p++) {
+        profiles[p] = (fault_inject_profile_t){
+            .drop = FAULT_INJECT_DROP_PERMILLE,
+            .delay = FAULT_INJECT_DELAY_PERMILLE,
+            .duplicate = FAULT_INJECT_DUPLICATE_PERMILLE,
+            .reorder = FAULT_INJECT_REORDER_PERMILLE,
+            .delay_ms = FAULT_INJECT_DELAY_MS,
+        };
+    }
+    started = true;
+    metrics_export_add_source(write_fault_metrics);
+    ESP_LOGW(TAG, "Fault injection on: drop %d, delay %d (%d ms), duplicate %d, reorder %d permille",
+             FAULT_INJECT_DROP_PERMILLE, FAULT_INJECT_DELAY_PERMILLE, FAULT_INJECT_DELAY_MS,
+             FAULT_INJECT_DUPLICATE_PERMILLE, FAULT_INJECT_REORDER_PERMILLE);
+    return ESP_OK;
+}
+
+esp_err_t fault_inject_set(fault_inject_point_t point, const fault_inject_profile_t *profile) {
+    if (FAULT_INJECT == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (point >= FAULT_INJECT_POINT_COUNT || profile == NULL ||
+        (uint32_t)profile->drop + profile->delay + profile->duplicate + profile->reorder > 1000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&lock);
+    profiles[point] = *profile;
+    portEXIT_CRITICAL(&lock);
+    ESP_LOGI(TAG, "%s: drop %u, delay %u (%u ms), duplicate %u, reorder %u permille", POINT_NAMES[point],
+             profile->drop, profile->delay, profile->delay_ms, profile->duplicate, profile->reorder);
+    return ESP_OK;
+}
+
+bool fault_inject_point_from_name(const char *name, fault_inject_point_t *point) {
+    for (int p = 0; p < FAULT_INJECT_POINT_COUNT; p++) {
+        if (strcmp(name, POINT_NAMES[p]) == 0) {
+            *point = (fault_inject_point_t)p;
+            return true;
+        }
+    }
+    return false;
+}
+
+void fault_inject_get(fault_inject_point_t point, fault_inject_profile_t *profile) {
+    if (point >= FAULT_INJECT_POINT_COUNT) {
+        *profile = (fault_inject_profile_t){ 0 };
+        return;
+    }
+    portENTER_CRITICAL(&lock);
+    *profile = profiles[point];
+    portEXIT_CRITICAL(&lock);
+}
+
+fault_inject_action_t fault_inject_decide(fault_inject_point_t point) {
+    if (!started || point >= FAULT_INJECT_POINT_COUNT) {
+        return FAULT_INJECT_PASS;
+    }
+    // One draw over the stacked probabilities, so each frame gets at most one fault
+    uint32_t draw = esp_random() % 1000;
+    fault_inject_action_t action = FAULT_INJECT_PASS;
+    portENTER_CRITICAL(&lock);
+    const fault_inject_profile_t *prof = &profiles[point];
+    uint32_t edge = prof->drop;
+    if (draw < edge) {
+        action = FAULT_INJECT_DROP;
+    } else if (draw < (edge += prof->delay)) {
+        action = FAULT_INJECT_DELAY;
+    } else if (draw < (edge += prof->duplicate)) {
+        action = FAULT_INJECT_DUPLICATE;
+    } else if (draw < edge + prof->reorder) {
+        action = FAULT_INJECT_REORDER;
+    }
+    counts[point][action]++;
+    portEXIT_CRITICAL(&lock);
+    return action;
+}
+
+uint32_t fault_inject_delay_ms(fault_inject_point_t point) {
+    fault_inject_profile_t prof;
+    fault_inject_get(point, &prof);
+    return prof.delay_ms;
+}
+
+uint32_t fault_inject_count(fault_inject_point_t point, fault_inject_action_t action) {
+    if (point >= FAULT_INJECT_POINT_COUNT || action >= FAULT_INJECT_ACTION_COUNT) {
+        return 0;
+    }
+    portENTER_CRITICAL(&lock);
+    uint32_t n = counts[point][action];
+    portEXIT_CRITICAL(&lock);
+    return n;
+}
@@ -0,0 +1,516 @@
+/**
+ * @file flash_backlog.c
+ * @brief Store-and-forward queue of telemetry records in a dedicated flash partition
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "flash_backlog.h"
+#include "long_op.h"
+#include "flash_io.h"
+#include "version.h"
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register flash_backlog.c version
+REGISTER_VERSION(FlashBacklog, "1.0.0", "2026-10-15");
+
+static const char *TAG = "FLASH_BACKLOG";
+
+#define SECTOR_SIZE 4096
+#define RECORD_SIZE sizeof(flash_backlog_record_t)
+#define RECORDS_PER_SECTOR (SECTOR_SIZE / RECORD_SIZE)
+#define STATE_QUEUED 0xFF
+#define STATE_DELIVERED 0x00
+#define FLAG_GAS_VALID (1 << 0)
+#define FLAG_HEAT_STABLE (1 << 1)
+#define FLAG_STEP_SHIFT 2
+#define FLAG_STEP_MASK 0x3C
+#define FLAG_HELD (1 << 6)
+#define U24_MAX 0xFFFFFFu
+#define REPLAY_MAGIC 0x464C4251                 // "FLBQ"
+#define SHUTDOWN_LOCK_MS 200                    // How long a restart waits for a running flush
+
+_Static_assert(RECORD_SIZE == 32, "flash_backlog_record_t must stay 32 bytes");
+_Static_assert(FLASH_BACKLOG_BATCH == RECORDS_PER_SECTOR, "the write batch is one sector");
+
+/**
+ * @brief Replay cursor, kept across deep sleep and soft resets
+ *
+ * Records between tail and cursor were handed on (on a node, to the
+ * reliable window, which also survives); without this they would be
+ * handed over again after a wake.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t tail;                              // Tail the cursor belongs to
+    uint32_t cursor;
+} replay_state_t;
+
+static RTC_NOINIT_ATTR replay_state_t replay;
+
+// Log state. [tail, next_seq) is queued, [cursor, next_seq) not yet handed on,
+// and [flushed_seq, next_seq) still in batch[].
+static const esp_partition_t *part;
+static uint32_t capacity;
+static uint32_t next_seq;
+static uint32_t flushed_seq;
+static uint32_t tail;
+static uint32_t cursor;
+static flash_backlog_record_t batch[FLASH_BACKLOG_BATCH];
+static uint32_t stored;
+static uint32_t replayed;
+static uint32_t dropped;
+static SemaphoreHandle_t backlog_lock;
+
+// =============================
+// Function Prototypes
+// =============================
+static void put_u24(uint8_t *p, uint32_t v);
+static uint32_t get_u24(const uint8_t *p);
+static uint16_t record_crc(const flash_backlog_record_t *rec);
+static bool record_valid(const flash_backlog_record_t *rec, uint32_t slot);
+static bool record_erased(const flash_backlog_record_t *rec);
+static esp_err_t read_slot(uint32_t slot, flash_backlog_record_t *rec);
+static bool read_record(uint32_t qseq, flash_backlog_record_t *rec);
+static esp_err_t find_head(void);
+static uint32_t find_tail(void);
+static uint32_t oldest_seq(void);
+static void save_replay(void);
+static esp_err_t flush_locked(void);
+static void shutdown_flush(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void put_u24(uint8_t *p, uint32_t v) {
+    if (v > U24_MAX) {
+        v = U24_MAX;
+    }
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+}
+
+static uint32_t get_u24(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+static uint16_t record_crc(const flash_backlog_record_t *rec) {
+    return esp_rom_crc16_le(0, (const uint8_t *)rec, offsetof(flash_backlog_record_t, crc));
+}
+
+/**
+ * @brief Intact and written for this slot, not left over from an earlier lap
+ */
+static bool record_valid(const flash_backlog_record_t *rec, uint32_t slot) {
+    return rec->crc == record_crc(rec) && rec->qseq % capacity == slot;
+}
+
+static bool record_erased(const flash_backlog_record_t *rec) {
+    const uint8_t *p = (const uint8_t *)rec;
+    for (size_t i = 0; i < RECORD_SIZE; i++) {
+        if (p[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static esp_err_t read_slot(uint32_t slot, flash_backlog_record_t *rec) {
+    return flash_io_read(FLASH_IO_BACKLOG, part, slot * RECORD_SIZE, rec, RECORD_SIZE);
+}
+
+/**
+ * @brief Fetch one queued record from the batch or flash; call with backlog_lock held
+ *
+ * @return bool false for a torn record, which is skipped
+ */
+static bool read_record(uint32_t qseq, flash_backlog_record_t *rec) {
+    if (qseq >= flushed_seq) {
+        *rec = batch[qseq - flushed_seq];
+        return true;
+    }
+    uint32_t slot = qseq % capacity;
+    return read_slot(slot, rec) == ESP_OK && record_valid(rec, slot) && rec->qseq == qseq;
+}
+
+/**
+ * @brief Locate the newest record and the first free slot after it
+ *
+ * As in metric_history: the sector whose first record has the highest qseq
+ * is the head, and writing resumes at its first erased slot.
+ */
+static esp_err_t find_head(void) {
+    uint32_t sectors = capacity / RECORDS_PER_SECTOR;
+    uint32_t head = 0;
+    uint32_t last_seq = 0;
+    bool found = false;
+    flash_backlog_record_t rec;
+
+    for (uint32_t s = 0; s < sectors; s++) {
+        uint32_t slot = s * RECORDS_PER_SECTOR;
+        if (read_slot(slot, &rec) == ESP_OK && record_valid(&rec, slot) && (!found || rec.qseq > last_seq)) {
+            head = s;
+            last_seq = rec.qseq;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        ESP_LOGI(TAG, "No backlog found, erasing %lu KB", (unsigned long)(part->size / 1024));
+        next_seq = 0;
+        flushed_seq = 0;
+        return long_op_erase(part, 0, sectors * SECTOR_SIZE, LONG_OP_LOG_ERASE);
+    }
+
+    uint32_t free_slot = ((head + 1) % sectors) * RECORDS_PER_SECTOR;
+    for (uint32_t i = 1; i < RECORDS_PER_SECTOR; i++) {
+        uint32_t slot = head * RECORDS_PER_SECTOR + i;
+        if (read_slot(slot, &rec) != ESP_OK) {
+            continue;
+        }
+        if (record_erased(&rec)) {
+            free_slot = slot;
+            break;
+        }
+        if (record_valid(&rec, slot) && rec.qseq > last_seq) {
+            last_seq = rec.qseq;
+        }
+    }
+
+    uint32_t seq = last_seq + 1;
+    next_seq = seq + (free_slot + capacity - seq % capacity) % capacity;
+    flushed_seq = next_seq;
+    return ESP_OK;
+}
+
+/**
+ * @brief The record after the newest one marked delivered, searching back from the head
+ *
+ * The search stops at the first mark, so it reads only the records still queued.
+ */
+static uint32_t find_tail(void) {
+    uint32_t oldest = oldest_seq();
+    flash_backlog_record_t rec;
+
+    for (uint32_t qseq = next_seq; qseq > oldest; qseq--) {
+        uint32_t slot = (qseq - 1) % capacity;
+        if (read_slot(slot, &rec) == ESP_OK && record_valid(&rec, slot) && rec.qseq == qseq - 1 &&
+            rec.state == STATE_DELIVERED) {
+            return qseq;
+        }
+    }
+    return oldest;
+}
+
+/**
+ * @brief First qseq not yet overwritten: the sector after the head holds it
+ */
+static uint32_t oldest_seq(void) {
+    if (next_seq == 0) {
+        return 0;
+    }
+    uint32_t head_start = (next_seq - 1) / RECORDS_PER_SECTOR * RECORDS_PER_SECTOR;
+    return head_start + RECORDS_PER_SECTOR >= capacity ? head_start + RECORDS_PER_SECTOR - capacity : 0;
+}
+
+static void save_replay(void) {
+    replay.tail = tail;
+    replay.cursor = cursor;
+    replay.magic = REPLAY_MAGIC;
+}
+
+/**
+ * @brief Write the batch in runs that stay within one sector; call with backlog_lock held
+ *
+ * A sector is erased only when the first record of a lap reaches it.
+ */
+static esp_err_t flush_locked(void) {
+    uint32_t pending = next_seq - flushed_seq;
+    esp_err_t result = ESP_OK;
+
+    for (uint32_t i = 0; i < pending;) {
+        uint32_t slot = (flushed_seq + i) % capacity;
+        uint32_t offset_in_sector = slot % RECORDS_PER_SECTOR;
+        uint32_t run = RECORDS_PER_SECTOR - offset_in_sector;
+        if (run > pending - i) {
+            run = pending - i;
+        }
+
+        esp_err_t err = ESP_OK;
+        if (offset_in_sector == 0) {
+            err = flash_io_erase(FLASH_IO_BACKLOG, part, slot * RECORD_SIZE, SECTOR_SIZE);
+        }
+        if (err == ESP_OK) {
+            err = flash_io_write(FLASH_IO_BACKLOG, part, slot * RECORD_SIZE, &batch[i], run * RECORD_SIZE);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write %lu records at slot %lu: %s",
+                     (unsigned long)run, (unsigned long)slot, esp_err_to_name(err));
+            result = err;
+        }
+        i += run;
+    }
+
+    flushed_seq = next_seq;
+    return result;
+}
+
+/**
+ * @brief Save buffered records on esp_restart(); skipped if a flush is stuck
+ */
+static void shutdown_flush(void) {
+    if (xSemaphoreTake(backlog_lock, pdMS_TO_TICKS(SHUTDOWN_LOCK_MS)) == pdTRUE) {
+        flush_locked();
+        xSemaphoreGive(backlog_lock);
+    }
+}
+
+esp_err_t flash_backlog_init(void) {
+    if (backlog_lock != NULL) {
+        return ESP_OK;
+    }
+
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FLASH_BACKLOG_PARTITION);
+    if (part == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition, records the window cannot take are dropped", FLASH_BACKLOG_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    capacity = part->size / SECTOR_SIZE * RECORDS_PER_SECTOR;
+    if (capacity < 2 * RECORDS_PER_SECTOR) {
+        ESP_LOGE(TAG, "Backlog partition needs at least two sectors");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err = find_head();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to prepare backlog partition: %s", esp_err_to_name(err));
+        return err;
+    }
+    tail = find_tail();
+    bool resumed = replay.magic == REPLAY_MAGIC && replay.tail == tail && replay.cursor >= tail &&
+                   replay.cursor <= next_seq;
+    cursor = resumed ? replay.cursor : tail;
+    save_replay();
+
+    backlog_lock = xSemaphoreCreateMutex();
+    if (backlog_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_register_shutdown_handler(shutdown_flush);
+
+    ESP_LOGI(TAG, "%lu of %lu records queued (%lu awaiting ACK)", (unsigned long)(next_seq - tail),
+             (unsigned long)capacity, (unsigned long)(cursor - tail));
+    return ESP_OK;
+}
+
+esp_err_t flash_backlog_push(uint32_t node_id, const telemetry_record_t *rec) {
+    if (backlog_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    flash_backlog_record_t r = {
+        .node_id = node_id,
+        .seq = rec->seq,
+        .time_s = rec->time_s,
+        .gas_resistance = rec->gas_resistance,
+        .temperature = rec->temperature,
+        .flags = (uint8_t)((rec->heater_step << FLAG_STEP_SHIFT) & FLAG_STEP_MASK) |
+                 (rec->gas_valid ? FLAG_GAS_VALID : 0) | (rec->heat_stable ? FLAG_HEAT_STABLE : 0) |
+                 (rec->held ? FLAG_HELD : 0),
+        .state = STATE_QUEUED,
+    };
+    put_u24(r.pressure, rec->pressure);
+    put_u24(r.humidity, rec->humidity);
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(backlog_lock, portMAX_DELAY);
+    r.qseq = next_seq;
+    r.crc = record_crc(&r);
+    batch[next_seq - flushed_seq] = r;
+    next_seq++;
+    stored++;
+
+    // Entering a sector lapped the records it held; those already handed on are in the window
+    uint32_t oldest = oldest_seq();
+    if (tail < oldest) {
+        if (cursor < oldest) {
+            dropped += oldest - cursor;
+            cursor = oldest;
+        }
+        tail = oldest;
+        save_replay();
+    }
+    if (next_seq % RECORDS_PER_SECTOR == 0) {
+        err = flush_locked();
+    }
+    xSemaphoreGive(backlog_lock);
+    return err;
+}
+
+esp_err_t flash_backlog_flush(void) {
+    if (backlog_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(backlog_lock, portMAX_DELAY);
+    esp_err_t err = flush_locked();
+    xSemaphoreGive(backlog_lock);
+    return err;
+}
+
+size_t flash_backlog_peek(telemetry_record_t *records, uint32_t *node_ids, size_t max) {
+    if (backlog_lock == NULL) {
+        return 0;
+    }
+
+    size_t n = 0;
+    xSemaphoreTake(backlog_lock, portMAX_DELAY);
+    for (uint32_t qseq = cursor; qseq < next_seq && n < max; qseq++) {
+        flash_backlog_record_t r;
+        if (!read_record(qseq, &r)) {
+            if (n > 0) {
+                break;                          // Hand over the run so far; advance() then reaches this one
+            }
+            cursor = qseq + 1;                  // Torn: nothing to send
+            save_replay();
+            continue;
+        }
+        if (node_ids != NULL) {
+            node_ids[n] = r.node_id;
+        }
+        telemetry_record_t *rec = &records[n++];
+        rec->seq = r.seq;
+        rec->time_s = r.time_s;
+        rec->temperature = r.temperature;
+        rec->pressure = get_u24(r.pressure);
+        rec->humidity = get_u24(r.humidity);
+        rec->gas_resistance = r.gas_resistance;
+        rec->heater_step = (r.flags & FLAG_STEP_MASK) >> FLAG_STEP_SHIFT;
+        rec->gas_valid = (r.flags & FLAG_GAS_VALID) != 0;
+        rec->heat_stable = (r.flags & FLAG_HEAT_STABLE) != 0;
+        rec->held = (r.flags & FLAG_HELD) != 0;
+        rec->urgent = false;                    // Paged out or spooled: it goes in turn with the rest
+    }
+    xSemaphoreGive(backlog_lock);
+    return n;
+}
+
+void flash_backlog_advance(size_t count) {
+    if (backlog_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(backlog_lock, portMAX_DELAY);
+    if (count > next_seq - cursor) {
+        count = next_seq - cursor;
+    }
+    cursor += count;
+    replayed += count;
+    save_replay();
+    xSemaphoreGive(backlog_lock);
+}
+
+esp_err_t flash_backlog_commit(void) {
+    return flash_backlog_commit_to(UINT32_MAX);
+}
+
+uint32_t flash_backlog_position(void) {
+    if (backlog_lock == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(backlog_lock, portMAX_DELAY);
+    uint32_t position = cursor;
+    xSemaphoreGive(backlog_lock);
+    return position;
+}
+
+esp_err_t flash_backlog_commit_to(uint32_t position) {
+    if (backlog_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(backlog_lock, portMAX_DELAY);
+    uint32_t end = position < cursor ? position : cursor;
+    if (end > tail) {
+        uint32_t last = end - 1;
+        if (last >= flushed_seq) {
+            batch[last - flushed_seq].state = STATE_DELIVERED;
+        } else {
+            static const uint8_t delivered = STATE_DELIVERED;
+            size_t offset = (last % capacity) * RECORD_SIZE + offsetof(flash_backlog_record_t, state);
+            err = flash_io_write(FLASH_IO_BACKLOG, part, offset, &delivered, 1);
+        }
+        if (err == ESP_OK) {
+            tail = end;
+            save_replay();
+        } else {
+            ESP_LOGE(TAG, "Failed to mark qseq %lu delivered: %s", (unsigned long)last, esp_err_to_name(err));
+        }
+    }
+    xSemaphoreGive(backlog_lock);
+    return err;
+}
+
+void flash_backlog_rewind(void) {
+    if (backlog_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(backlog_lock, portMAX_DELAY);
+    cursor = tail;
+    save_replay();
+    xSemaphoreGive(backlog_lock);
+}
+
+uint32_t flash_backlog_unsent(void) {
+    if (backlog_lock == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(backlog_lock, portMAX_DELAY);
+    uint32_t unsent = next_seq - cursor;
+    xSemaphoreGive(backlog_lock);
+    return unsent;
+}
+
+uint32_t flash_backlog_space(void) {
+    if (backlog_lock == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(backlog_lock, portMAX_DELAY);
+    uint32_t used = next_seq - cursor + RECORDS_PER_SECTOR;
+    uint32_t space = used < capacity ? capacity - used : 0;
+    xSemaphoreGive(backlog_lock);
+    return space;
+}
+
+void flash_backlog_get_info(flash_backlog_info_t *info) {
+    memset(info, 0, sizeof(*info));
+    if (backlog_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(backlog_lock, portMAX_DELAY);
+    info->ready = true;
+    info->capacity = capacity;
+    info->queued = next_seq - tail;
+    info->unsent = next_seq - cursor;
+    info->buffered = next_seq - flushed_seq;
+    info->stored = stored;
+    info->replayed = replayed;
+    info->dropped = dropped;
+    xSemaphoreGive(backlog_lock);
+}
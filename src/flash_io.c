@@ -0,0 +1,223 @@
+/**
+ * @file flash_io.c
+ * @brief Counted and timed flash reads, writes and erases, per subsystem and per partition
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "flash_io.h"
+#include "nvs_wear.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register flash_io.c version
+REGISTER_VERSION(FlashIo, "1.0.0", "2026-10-15");
+
+// A page program takes well under a millisecond, a sector erase tens of them
+static const uint32_t BUCKET_US[FLASH_IO_BUCKETS - 1] = { 100, 500, 2000, 10000, 50000, 200000, 1000000 };
+
+static const char *const SUB_NAMES[FLASH_IO_SUB_COUNT] = {
+    "nvs", "ota", "history", "backlog", "files", "coredump", "other"
+};
+
+static const char *const OP_NAMES[FLASH_IO_OP_COUNT] = { "read", "write", "erase", "commit" };
+
+static flash_io_stats_t stats[FLASH_IO_SUB_COUNT][FLASH_IO_OP_COUNT];
+static flash_io_part_stats_t parts[FLASH_IO_MAX_PARTITIONS];
+static size_t part_count;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static flash_io_part_stats_t *find_part(const char *label);
+static metric_error_t flash_io_provider(char *buf, size_t buf_len);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Slot of a partition, added on first use; called with stats_lock held
+ */
+static flash_io_part_stats_t *find_part(const char *label) {
+    for (size_t i = 0; i < part_count; i++) {
+        if (strcmp(parts[i].label, label) == 0) {
+            return &parts[i];
+        }
+    }
+    if (part_count < FLASH_IO_MAX_PARTITIONS - 1) {
+        flash_io_part_stats_t *p = &parts[part_count++];
+        strlcpy(p->label, label, sizeof(p->label));
+        return p;
+    }
+    flash_io_part_stats_t *p = &parts[FLASH_IO_MAX_PARTITIONS - 1];
+    if (part_count < FLASH_IO_MAX_PARTITIONS) {
+        part_count = FLASH_IO_MAX_PARTITIONS;
+        strlcpy(p->label, "other", sizeof(p->label));
+    }
+    return p;
+}
+
+void flash_io_record(flash_io_sub_t sub, flash_io_op_t op, const char *label, size_t bytes, int64_t start_us,
+                     esp_err_t err) {
+    if (sub >= FLASH_IO_SUB_COUNT || op >= FLASH_IO_OP_COUNT) {
+        return;
+    }
+    int64_t elapsed = esp_timer_get_time() - start_us;
+    uint32_t us = elapsed < 0 ? 0 : elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+    size_t bucket = 0;
+    while (bucket < FLASH_IO_BUCKETS - 1 && us > BUCKET_US[bucket]) {
+        bucket++;
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    flash_io_stats_t *s = &stats[sub][op];
+    s->count++;
+    s->bytes += bytes;
+    s->total_us += us;
+    s->histogram[bucket]++;
+    if (us > s->max_us) {
+        s->max_us = us;
+    }
+    if (err != ESP_OK) {
+        s->errors++;
+    }
+    if (label != NULL) {
+        flash_io_part_stats_t *p = find_part(label);
+        p->count[op]++;
+        p->bytes[op] += bytes;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void flash_io_record_nvs(const char *key, size_t bytes, int64_t start_us, esp_err_t err) {
+    flash_io_record(FLASH_IO_NVS, FLASH_IO_WRITE, FLASH_IO_NVS_LABEL, bytes, start_us, err);
+    if (err == ESP_OK) {
+        nvs_wear_note(key, bytes);
+    }
+}
+
+esp_err_t flash_io_read(flash_io_sub_t sub, const esp_partition_t *part, size_t offset, void *dst, size_t len) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_partition_read(part, offset, dst, len);
+    flash_io_record(sub, FLASH_IO_READ, part != NULL ? part->label : NULL, len, start, err);
+    return err;
+}
+
+esp_err_t flash_io_write(flash_io_sub_t sub, const esp_partition_t *part, size_t offset, const void *src,
+                         size_t len) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_partition_write(part, offset, src, len);
+    flash_io_record(sub, FLASH_IO_WRITE, part != NULL ? part->label : NULL, len, start, err);
+    return err;
+}
+
+esp_err_t flash_io_erase(flash_io_sub_t sub, const esp_partition_t *part, size_t offset, size_t len) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_partition_erase_range(part, offset, len);
+    flash_io_record(sub, FLASH_IO_ERASE, part != NULL ? part->label : NULL, len, start, err);
+    return err;
+}
+
+esp_err_t flash_io_ota_write(const esp_partition_t *part, esp_ota_handle_t handle, const void *data, size_t len) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_ota_write(handle, data, len);
+    flash_io_record(FLASH_IO_OTA, FLASH_IO_WRITE, part != NULL ? part->label : NULL, len, start, err);
+    return err;
+}
+
+esp_err_t flash_io_ota_write_at(const esp_partition_t *part, esp_ota_handle_t handle, const void *data,
+                                size_t len, uint32_t offset) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_ota_write_with_offset(handle, data, len, offset);
+    flash_io_record(FLASH_IO_OTA, FLASH_IO_WRITE, part != NULL ? part->label : NULL, len, start, err);
+    return err;
+}
+
+esp_err_t flash_io_nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t len) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = nvs_set_blob(handle, key, value, len);
+    flash_io_record_nvs(key, len, start, err);
+    return err;
+}
+
+esp_err_t flash_io_nvs_commit(nvs_handle_t handle) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = nvs_commit(handle);
+    flash_io_record(FLASH_IO_NVS, FLASH_IO_COMMIT, FLASH_IO_NVS_LABEL, 0, start, err);
+    return err;
+}
+
+esp_err_t flash_io_get(flash_io_sub_t sub, flash_io_op_t op, flash_io_stats_t *out) {
+    if (sub >= FLASH_IO_SUB_COUNT || op >= FLASH_IO_OP_COUNT || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats[sub][op];
+    portEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
+size_t flash_io_get_partitions(flash_io_part_stats_t *out, size_t max) {
+    portENTER_CRITICAL(&stats_lock);
+    size_t n = part_count < max ? part_count : max;
+    memcpy(out, parts, n * sizeof(parts[0]));
+    portEXIT_CRITICAL(&stats_lock);
+    return n;
+}
+
+uint32_t flash_io_bucket_us(size_t bucket) {
+    return bucket < FLASH_IO_BUCKETS - 1 ? BUCKET_US[bucket] : 0;
+}
+
+const char *flash_io_sub_name(flash_io_sub_t sub) {
+    return sub < FLASH_IO_SUB_COUNT ? SUB_NAMES[sub] : "unknown";
+}
+
+const char *flash_io_op_name(flash_io_op_t op) {
+    return op < FLASH_IO_OP_COUNT ? OP_NAMES[op] : "unknown";
+}
+
+/**
+ * @brief METRIC_FLASH_RW_OPERATIONS: totals over all subsystems and the slowest call
+ */
+static metric_error_t flash_io_provider(char *buf, size_t buf_len) {
+    uint32_t count[FLASH_IO_OP_COUNT] = { 0 };
+    uint64_t bytes[FLASH_IO_OP_COUNT] = { 0 };
+    uint32_t slowest_us = 0;
+    portENTER_CRITICAL(&stats_lock);
+    for (size_t s = 0; s < FLASH_IO_SUB_COUNT; s++) {
+        for (size_t op = 0; op < FLASH_IO_OP_COUNT; op++) {
+            count[op] += stats[s][op].count;
+            bytes[op] += stats[s][op].bytes;
+            if (stats[s][op].max_us > slowest_us) {
+                slowest_us = stats[s][op].max_us;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    snprintf(buf, buf_len, "R %lu (%lu KB), W %lu (%lu KB), E %lu (%lu KB), C %lu, slowest %lu ms",
+             (unsigned long)count[FLASH_IO_READ], (unsigned long)(bytes[FLASH_IO_READ] / 1024),
+             (unsigned long)count[FLASH_IO_WRITE], (unsigned long)(bytes[FLASH_IO_WRITE] / 1024),
+             (unsigned long)count[FLASH_IO_ERASE], (unsigned long)(bytes[FLASH_IO_ERASE] / 1024),
+             (unsigned long)count[FLASH_IO_COMMIT], (unsigned long)(slowest_us / 1000));
+    return METRIC_OK;
+}
+
+void flash_io_init(void) {
+    set_metric_provider(METRIC_FLASH_RW_OPERATIONS, flash_io_provider);
+}
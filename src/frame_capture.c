@@ -0,0 +1,417 @@
+/**
+ * @file frame_capture.c
+ * @brief Raw ESP-NOW traffic captured to the SD card, and captures replayed through the gateway
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "frame_capture.h"
+#include "espnow_link.h"
+#include "static_mem.h"
+#include "version.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_now.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register frame_capture.c version
+REGISTER_VERSION(FrameCapture, "1.0.0", "2026-10-15");
+static const char *TAG = "CAPTURE";
+
+#define STOP_TIMEOUT_MS 5000
+#define POLL_MS 1000                            // The writer looks for a stop this often
+#define MIN_VALID_UNIX 1704067200               // 2024-01-01: before this the clock has not been set
+
+_Static_assert(FRAME_CAPTURE_BUF_BYTES % SD_ARCHIVE_SECTOR == 0, "The stdio buffer is written as whole sectors");
+_Static_assert(CAPTURE_FILE_FRAME_MAX == ESP_NOW_MAX_DATA_LEN, "A capture record holds any ESP-NOW frame");
+_Static_assert(CAPTURE_FILE_MAC_LEN == ESP_NOW_ETH_ALEN, "Captured senders are ESP-NOW MACs");
+
+/**
+ * @brief A frame as queued by the link task
+ */
+typedef struct {
+    int64_t t_us;
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    int8_t rssi;
+    uint8_t len;
+    uint8_t data[];
+} capture_item_t;
+
+/**
+ * @brief A replay run
+ */
+typedef struct {
+    char path[SD_ARCHIVE_PATH_LEN];
+    uint32_t speed;
+    frame_capture_room_t room;
+} replay_job_t;
+
+static RingbufHandle_t ring = NULL;
+static FILE *file = NULL;                       // Writer task only
+static char *file_buf = NULL;
+static uint32_t file_bytes = 0;
+static uint32_t file_number = 0;
+static int64_t file_start_us = 0;
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(capture_task_slot, FRAME_CAPTURE_TASK_STACK_SIZE);
+static volatile bool run = false;
+static volatile bool replaying = false;
+static replay_job_t replay_job;
+static frame_capture_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static uint32_t last_file_number(void);
+static bool open_next_file(void);
+static void close_file(void);
+static void write_item(const capture_item_t *item);
+static void capture_task(void *arg);
+static void replay_task(void *arg);
+static void count_error(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void count_error(void) {
+    portENTER_CRITICAL(&stats_lock);
+    stats.errors++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief Highest capture file number on the card, 0 if there is none
+ */
+static uint32_t last_file_number(void) {
+    uint32_t last = 0;
+    DIR *dir = opendir(SD_ARCHIVE_MOUNT);
+    if (dir == NULL) {
+        return 0;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned n;
+        char ext[5];
+        if (sscanf(entry->d_name, "CAP%5u%4s", &n, ext) == 2 && strcmp(ext, FRAME_CAPTURE_EXT) == 0 && n > last) {
+            last = n;
+        }
+    }
+    closedir(dir);
+    return last;
+}
+
+/**
+ * @brief Close the current file, if any, and start the next number with its header
+ */
+static bool open_next_file(void) {
+    close_file();
+    if (file_number >= FRAME_CAPTURE_MAX_FILES) {
+        ESP_LOGE(TAG, "No capture file numbers left");
+        return false;
+    }
+    char path[SD_ARCHIVE_PATH_LEN];
+    frame_capture_path(path, ++file_number);
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        count_error();
+        return false;
+    }
+    setvbuf(file, file_buf, _IOFBF, FRAME_CAPTURE_BUF_BYTES);
+
+    uint8_t header[CAPTURE_FILE_HEADER_LEN];
+    time_t now = time(NULL);
+    capture_file_write_header(header, now >= MIN_VALID_UNIX ? (uint32_t)now : 0);
+    file_start_us = esp_timer_get_time();
+    file_bytes = CAPTURE_FILE_HEADER_LEN;
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+        count_error();
+    }
+    portENTER_CRITICAL(&stats_lock);
+    stats.files++;
+    stats.bytes += CAPTURE_FILE_HEADER_LEN;
+    portEXIT_CRITICAL(&stats_lock);
+    ESP_LOGI(TAG, "Capturing to %s", path);
+    return true;
+}
+
+static void close_file(void) {
+    if (file != NULL) {
+        fflush(file);
+        fsync(fileno(file));
+        fclose(file);
+        file = NULL;
+    }
+}
+
+/**
+ * @brief Append one frame, moving to the next file when this one is full
+ */
+static void write_item(const capture_item_t *item) {
+    if (file != NULL && file_bytes + CAPTURE_FILE_RECORD_LEN + item->len > FRAME_CAPTURE_FILE_MAX) {
+        open_next_file();
+    }
+    if (file == NULL) {
+        return;
+    }
+    capture_file_record_t record = {
+        .t_ms = (uint32_t)((item->t_us - file_start_us) / 1000),
+        .rssi = item->rssi,
+        .len = item->len,
+    };
+    memcpy(record.mac, item->mac, ESP_NOW_ETH_ALEN);
+    uint8_t rec[CAPTURE_FILE_RECORD_LEN];
+    capture_file_write_record(rec, &record);
+    bool ok = fwrite(rec, 1, sizeof(rec), file) == sizeof(rec) &&
+              fwrite(item->data, 1, item->len, file) == item->len;
+    portENTER_CRITICAL(&stats_lock);
+    if (ok) {
+        stats.frames++;
+        stats.bytes += CAPTURE_FILE_RECORD_LEN + item->len;
+    } else {
+        stats.errors++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    file_bytes += CAPTURE_FILE_RECORD_LEN + item->len;
+}
+
+/**
+ * @brief Append queued frames; sync every SD_ARCHIVE_SYNC_MS
+ */
+static void capture_task(void *arg) {
+    (void)arg;
+    int64_t last_sync_us = esp_timer_get_time();
+    bool dirty = false;
+    while (run) {
+        size_t size;
+        capture_item_t *item = xRingbufferReceive(ring, &size, pdMS_TO_TICKS(POLL_MS));
+        if (item != NULL) {
+            write_item(item);
+            vRingbufferReturnItem(ring, item);
+            dirty = true;
+        }
+        int64_t now_us = esp_timer_get_time();
+        if (dirty && file != NULL && now_us - last_sync_us >= (int64_t)SD_ARCHIVE_SYNC_MS * 1000) {
+            last_sync_us = now_us;
+            dirty = false;
+            if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+                count_error();
+            }
+        }
+    }
+
+    // Whatever the link task queued before the stop
+    size_t size;
+    capture_item_t *item;
+    while ((item = xRingbufferReceive(ring, &size, 0)) != NULL) {
+        write_item(item);
+        vRingbufferReturnItem(ring, item);
+    }
+    close_file();
+    task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Read the capture and inject its frames, paced by speed or by the room callback
+ */
+static void replay_task(void *arg) {
+    replay_job_t *job = (replay_job_t *)arg;
+    FILE *in = fopen(job->path, "rb");
+    uint8_t header[CAPTURE_FILE_HEADER_LEN];
+    uint32_t captured_at = 0;
+    if (in == NULL || fread(header, 1, sizeof(header), in) != sizeof(header) ||
+        capture_file_read_header(header, &captured_at) != ESP_OK) {
+        ESP_LOGE(TAG, "%s is not a capture", job->path);
+        if (in != NULL) {
+            fclose(in);
+        }
+        replaying = false;
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_LOGI(TAG, "Replaying %s (captured at %lu), speed %lu", job->path, (unsigned long)captured_at,
+             (unsigned long)job->speed);
+
+    uint8_t rec[CAPTURE_FILE_RECORD_LEN];
+    capture_file_record_t record;
+    uint8_t frame[CAPTURE_FILE_FRAME_MAX];
+    uint32_t frames = 0;
+    uint32_t failed = 0;
+    int64_t start_us = esp_timer_get_time();
+    while (fread(rec, 1, sizeof(rec), in) == sizeof(rec)) {
+        if (capture_file_read_record(rec, &record) != ESP_OK || fread(frame, 1, record.len, in) != record.len) {
+            ESP_LOGW(TAG, "Capture ends in a partial or malformed record");
+            break;
+        }
+        if (job->speed > 0) {
+            int64_t due_us = start_us + (int64_t)record.t_ms * 1000 / job->speed;
+            int64_t wait_us = due_us - esp_timer_get_time();
+            if (wait_us > 0) {
+                vTaskDelay(pdMS_TO_TICKS(wait_us / 1000) + 1);
+            }
+        } else {
+            // One frame in the link task at a time, and only once the records of a full one fit
+            while (espnow_link_injected_pending() > 0 || (job->room != NULL && !job->room())) {
+                vTaskDelay(1);
+            }
+        }
+        if (espnow_link_inject(record.mac, frame, record.len, record.rssi, FRAME_CAPTURE_INJECT_WAIT_MS) == ESP_OK) {
+            frames++;
+        } else {
+            failed++;
+        }
+        portENTER_CRITICAL(&stats_lock);
+        stats.replayed = frames;
+        stats.replay_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+        portEXIT_CRITICAL(&stats_lock);
+    }
+    fclose(in);
+
+    uint32_t took_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    ESP_LOGI(TAG, "Replay done: %lu frames (%lu not taken) in %lu ms, %lu frames/s", (unsigned long)frames,
+             (unsigned long)failed, (unsigned long)took_ms,
+             (unsigned long)(took_ms > 0 ? (uint64_t)frames * 1000 / took_ms : frames));
+    replaying = false;
+    vTaskDelete(NULL);
+}
+
+esp_err_t frame_capture_start(void) {
+    if (task_handle != NULL) {
+        return ESP_OK;
+    }
+    sd_archive_stats_t as;
+    sd_archive_get_stats(&as);
+    if (!as.mounted) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ring = xRingbufferCreate(FRAME_CAPTURE_RING_BYTES, RINGBUF_TYPE_NOSPLIT);
+    file_buf = malloc(FRAME_CAPTURE_BUF_BYTES);
+    if (ring == NULL || file_buf == NULL) {
+        frame_capture_stop();
+        return ESP_ERR_NO_MEM;
+    }
+    file_number = last_file_number();
+    if (!open_next_file()) {
+        frame_capture_stop();
+        return ESP_FAIL;
+    }
+
+    run = true;
+    if (static_task_create(capture_task_slot, capture_task, FRAME_CAPTURE_TASK_NAME, FRAME_CAPTURE_TASK_STACK_SIZE,
+                           NULL, FRAME_CAPTURE_TASK_PRIORITY, &task_handle, TASK_CORE_NET) != pdPASS) {
+        run = false;
+        task_handle = NULL;
+        frame_capture_stop();
+        return ESP_ERR_NO_MEM;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    stats.capturing = true;
+    portEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
+void frame_capture_stop(void) {
+    portENTER_CRITICAL(&stats_lock);
+    stats.capturing = false;
+    portEXIT_CRITICAL(&stats_lock);
+    if (task_handle != NULL) {
+        run = false;
+        int waited = 0;
+        while (task_handle != NULL && waited < STOP_TIMEOUT_MS) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            waited += 10;
+        }
+        if (task_handle != NULL) {
+            ESP_LOGW(TAG, "Writer task did not stop");
+            return;
+        }
+    }
+    close_file();
+    if (ring != NULL) {
+        vRingbufferDelete(ring);
+        ring = NULL;
+    }
+    free(file_buf);
+    file_buf = NULL;
+}
+
+void frame_capture_add(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    if (!run || replaying || len == 0 || len > ESP_NOW_MAX_DATA_LEN) {
+        return;
+    }
+    capture_item_t *item = NULL;
+    if (xRingbufferSendAcquire(ring, (void **)&item, sizeof(capture_item_t) + len, 0) != pdTRUE) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.dropped++;
+        portEXIT_CRITICAL(&stats_lock);
+        return;
+    }
+    item->t_us = esp_timer_get_time();
+    memcpy(item->mac, mac, ESP_NOW_ETH_ALEN);
+    item->rssi = rssi;
+    item->len = (uint8_t)len;
+    memcpy(item->data, data, len);
+    xRingbufferSendComplete(ring, item);
+}
+
+esp_err_t frame_capture_replay_start(const char *path, uint32_t speed, frame_capture_room_t room) {
+    if (replaying) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (path != NULL) {
+        snprintf(replay_job.path, sizeof(replay_job.path), "%s", path);
+    } else {
+        uint32_t n = last_file_number();
+        if (n == 0) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        frame_capture_path(replay_job.path, n);
+    }
+    if (access(replay_job.path, R_OK) != 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    replay_job.speed = speed;
+    replay_job.room = room;
+
+    replaying = true;
+    portENTER_CRITICAL(&stats_lock);
+    stats.replayed = 0;
+    stats.replay_ms = 0;
+    portEXIT_CRITICAL(&stats_lock);
+    if (static_task_create(NULL, replay_task, FRAME_REPLAY_TASK_NAME, FRAME_REPLAY_TASK_STACK_SIZE, &replay_job,
+                           FRAME_REPLAY_TASK_PRIORITY, NULL, TASK_CORE_NET) != pdPASS) {
+        replaying = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void frame_capture_path(char *path, uint32_t n) {
+    snprintf(path, SD_ARCHIVE_PATH_LEN, SD_ARCHIVE_MOUNT "/CAP%05lu" FRAME_CAPTURE_EXT, (unsigned long)n);
+}
+
+void frame_capture_get_stats(frame_capture_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    out->replaying = replaying;
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -11,49 +11,1668 @@
 // Includes
 // =============================
 #include "gateway.h"
+#include "aggregator.h"
+#include "ble_beacon.h"
+#include "boot_health.h"
+#include "espnow_channel.h"
+#include "espnow_config.h"
+#include "espnow_rekey.h"
+#include "espnow_link.h"
+#include "espnow_ota.h"
+#include "espnow_pair.h"
+#include "espnow_time.h"
+#include "event_log.h"
+#include "espnow_relay.h"
+#include "espnow_reliable.h"
+#include "espnow_slot.h"
+#include "flash_backlog.h"
+#include "gps.h"
+#include "health_watch.h"
+#include "frame_capture.h"
+#include "ha_discovery.h"
+#include "i2c_bus.h"
+#include "mem_policy.h"
+#include "influx_writer.h"
+#include "metrics_export.h"
+#include "metrics_stream.h"
+#include "motion.h"
+#include "mqtt_cmd.h"
+#include "mqtt_forwarder.h"
+#include "n2k.h"
+#include "nmea.h"
+#include "ota_pull.h"
+#include "signalk.h"
+#include "syslog_sink.h"
+#include "telemetry_mcast.h"
+#include "latest_values.h"
+#include "node_table.h"
+#include "pressure_trend.h"
+#include "sample_bus.h"
+#include "sd_archive.h"
+#include "spsc_ring.h"
+#include "telemetry.h"
+#include "ts_store.h"
+#include "wifi_ap.h"
+#include "wind.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "sdkconfig.h"
 
 // =============================
 // Constants & Definitions
 // =============================
 static const char *TAG = "GATEWAY";
 
+_Static_assert((GATEWAY_RECORD_SLOTS & (GATEWAY_RECORD_SLOTS - 1)) == 0, "GATEWAY_RECORD_SLOTS must be a power of two");
+_Static_assert(GATEWAY_RECORD_SLOTS >= 2 * TELEMETRY_PACKED_MAX_RECORDS,
+               "the record ring must hold a frame while one is forwarded");
+_Static_assert((GATEWAY_ALARM_SLOTS & (GATEWAY_ALARM_SLOTS - 1)) == 0, "GATEWAY_ALARM_SLOTS must be a power of two");
+_Static_assert(GATEWAY_ALARM_SLOTS >= TELEMETRY_MAX_RECORDS, "the alarm ring must hold a node's live frame");
+
+#if GATEWAY_BLE_BEACON && !defined(CONFIG_BT_NIMBLE_ENABLED)
+#error "GATEWAY_BLE_BEACON needs CONFIG_BT_NIMBLE_ENABLED (sdkconfig.ble.defaults)"
+#endif
+
+// Forwarder wake-ups
+#define GATEWAY_EVT_RECORDS (1 << 0)            // Link task queued a frame, or turned one away
+#define GATEWAY_EVT_MQTT (1 << 1)               // Broker connection changed, or the window got room
+#define GATEWAY_EVT_REPLY (1 << 2)              // A slot ASSIGN or channel announcement is owed to a node
+
+/**
+ * @brief One decoded record waiting for the forwarder; one ring slot
+ */
+typedef struct {
+    uint32_t node_id;
+    telemetry_record_t rec;
+} gateway_record_t;
+
+/**
+ * @brief One alarm-lane record waiting for the forwarder, with its arrival time; one ring slot
+ */
+typedef struct {
+    uint32_t node_id;
+    telemetry_record_t rec;
+    int64_t rx_us;
+} gateway_alarm_t;
+
+/**
+ * @brief Pipeline counters since gateway_init()
+ */
+typedef struct {
+    uint32_t frames;                            // Telemetry frames queued
+    uint32_t records;                           // Records queued
+    uint32_t deferred;                          // Frames turned away while the forwarder was behind
+    uint32_t malformed;
+    uint32_t forwarded;                         // Records forwarded
+    uint32_t unpublished;                       // Records MQTT could not take in full
+    uint32_t batches;                           // Forwarder batches
+    uint32_t spooled;                           // Records written to flash while MQTT was down
+    uint32_t replayed;                          // Spooled records published after it came back
+    uint32_t aggregates;                        // Closed windows and wind roses published
+    uint32_t aggregates_unpublished;            // Closed windows MQTT refused or was not set up for
+    uint32_t alarms_raised;                     // Pressure alarms raised, over all nodes
+    uint32_t alarms_cleared;
+    uint32_t urgent_frames;                     // Frames queued in the alarm lane
+    uint32_t urgent_forwarded;                  // Alarm-lane records handed to the sink
+    uint32_t urgent_spooled;                    // ... written to the spool instead, while the sink was down
+    uint32_t urgent_late;                       // ... handed over more than GATEWAY_ALARM_TARGET_MS after arrival
+    uint32_t urgent_last_ms;                    // Arrival to hand-over, last alarm-lane record
+    uint32_t urgent_max_ms;
+    int32_t urgent_age_s;                       // Node sample to hand-over, last record; -1 without a clock
+} gateway_stats_t;
+
+/**
+ * @brief One node's pressure trend
+ */
+typedef struct {
+    uint32_t node_id;
+    pressure_trend_t trend;
+} gateway_trend_t;
+
+static spsc_ring_t record_ring;                 // Link task in, forwarder out
+static gateway_record_t *record_slots = NULL;
+static spsc_ring_t alarm_ring;                  // Alarm lane: link task in, forwarder out, ahead of record_ring
+static gateway_alarm_t alarm_slots[GATEWAY_ALARM_SLOTS];
+static telemetry_record_t frame_records[TELEMETRY_PACKED_MAX_RECORDS]; // Link task: the frame being queued
+static EventGroupHandle_t events = NULL;
+static StaticEventGroup_t events_buf;
+static uint32_t wait_ms = 0;                    // Until the next timed job; set at the end of each pass
+static gateway_record_t forward_batch[GATEWAY_FORWARD_BATCH];
+static gateway_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t last_stats_us = 0;
+static bool mqtt_ready = false;                 // Records are only logged without it
+static bool influx_ready = false;
+static bool sink_ready = false;                 // Raw records have a destination: MQTT or InfluxDB
+static bool spool_ready = false;                // Flash spool for records the sink cannot take
+static bool outbox_ready = false;               // The spool is the MQTT outbox: every record goes through it
+static bool checkpoint_pending = false;         // Outbox: records before checkpoint_position await checkpoint_ticket
+static uint32_t checkpoint_position = 0;
+static uint32_t checkpoint_ticket = 0;
+static int64_t checkpoint_us = 0;
+static uint32_t outbox_expired = 0;             // Forwarder's expired count when last checked
+static telemetry_record_t replay_records[GATEWAY_FORWARD_BATCH];
+static uint32_t replay_nodes[GATEWAY_FORWARD_BATCH];
+static bool aggregate_ready = false;
+static bool history_ready = false;
+static bool archive_ready = false;             // Records are archived to the SD card
+static bool capture_ready = false;              // Received frames are captured to the SD card
+static bool beacon_ready = false;               // One node's readings are advertised over BLE
+static gateway_trend_t *trends = NULL;          // GATEWAY_TREND_NODES, forwarder task only
+static size_t trend_count = 0;
+static int64_t last_wind_us = 0;
+static bool bus_ready = false;
+static sample_bus_sub_t *observe_sub = NULL;    // NULL: records are observed as they leave the ring
+static bool ota_ready = false;                  // Node firmware is staged and being served
+static bool pull_ready = false;                 // Firmware is checked for over the uplink
+static bool time_ready = false;                 // The time beacon is running
+static bool slot_ready = false;                 // Node transmit slots are handed out
+static bool channel_ready = false;              // Channel switches are announced to the nodes
+static bool pair_ready = false;                 // Unpaired nodes are answered with this gateway's MAC and channel
+static bool discovery_ready = false;            // Node sensors are announced to Home Assistant
+
+// =============================
+// Function Prototypes
+// =============================
+static void espnow_rx(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+static size_t sink_room(void);
+static esp_err_t sink_publish(uint32_t node_id, const telemetry_record_t *rec);
+static size_t sink_urgent_room(void);
+static esp_err_t sink_publish_urgent(uint32_t node_id, const telemetry_record_t *rec);
+static bool sink_connected(void);
+static void sink_flush(void);
+static bool sink_idle(void);
+static esp_err_t deliver_telemetry(const uint8_t *mac, const uint8_t *data, size_t len);
+static void relayed_rx(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+static void forward_records(const gateway_record_t *batch, size_t count);
+static void observe_record(uint32_t node_id, const telemetry_record_t *rec);
+static void observe_bus(void);
+static void publish_record(uint32_t node_id, const telemetry_record_t *rec);
+static void track_pressure(uint32_t node_id, const telemetry_record_t *rec);
+static void publish_health(const char *json, size_t len);
+static void publish_aggregate(const aggregator_result_t *result);
+static void publish_rose(const aggregator_rose_t *rose);
+static void sample_wind(void);
+static bool drain_ring(void);
+static void forward_alarms(bool online);
+static void time_alarm(const gateway_alarm_t *alarm);
+static bool spool_ring(void);
+static void replay_spool(void);
+static void outbox_commit(void);
+static void wake_on_mqtt(void);
+static void wake_on_reply(void);
+static void node_image_slot(bool in_use);
+static uint32_t next_wait_ms(void);
+static void log_stats(void);
+static void write_gateway_metrics(metrics_export_writer_t *w);
+static bool replay_room(void);
+
 // =============================
 // Function Definitions
 // =============================
 
+/**
+ * @brief ESP-NOW receive handler; runs in the link task
+ *
+ * Firmware requests go to espnow_ota. Sequenced frames go through the
+ * reliable layer, which delivers each once and acknowledges it; a bare
+ * telemetry frame is handled as it stands. Relayed frames are unwrapped
+ * and come back through relayed_rx().
+ */
+static void espnow_rx(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    EVENT_LOGD(TAG, "%u bytes from %04lx%08lx at %d dBm", len, (mac[0] << 8) | mac[1],
+               ((uint32_t)mac[2] << 24) | (mac[3] << 16) | (mac[4] << 8) | mac[5], rssi);
+    if (capture_ready) {
+        frame_capture_add(mac, data, len, rssi);
+    }
+    node_table_on_frame(mac, rssi);
+    if (!espnow_relay_on_receive(mac, data, len, rssi) && !espnow_channel_on_receive(mac, data, len, rssi) && !espnow_pair_on_receive(mac, data, len, rssi) &&
+        !espnow_slot_on_receive(mac, data, len, rssi) &&
+        !espnow_ota_on_receive(mac, data, len, rssi) && !espnow_reliable_on_receive(mac, data, len, rssi)) {
+        gateway_handle_telemetry(mac, data, len);
+    }
+}
+
+/**
+ * @brief A frame a relay passed on, as from the node that sent it; runs in the link task
+ *
+ * Only telemetry is relayed, so it skips the channel, slot and firmware handlers.
+ */
+static void relayed_rx(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    if (!espnow_reliable_on_receive(mac, data, len, rssi)) {
+        gateway_handle_telemetry(mac, data, len);
+    }
+}
+
+/**
+ * @brief Reliable layer handler: a new, not yet seen frame from a node
+ *
+ * ESP_ERR_NO_MEM from a full record ring leaves the frame unacknowledged,
+ * so the node holds it and resends it once the forwarder has caught up.
+ */
+static esp_err_t deliver_telemetry(const uint8_t *mac, const uint8_t *data, size_t len) {
+    return gateway_handle_telemetry(mac, data, len);
+}
+
+// Raw records go to one sink, chosen at build time; both keep the same
+// room/publish/flush/idle contract, so the ring and the spool drive either.
+
+static size_t sink_room(void) {
+    return GATEWAY_INFLUX != 0 ? influx_writer_room() : mqtt_forwarder_room();
+}
+
+static esp_err_t sink_publish(uint32_t node_id, const telemetry_record_t *rec) {
+    return GATEWAY_INFLUX != 0 ? influx_writer_publish(node_id, rec) : mqtt_forwarder_publish(node_id, rec);
+}
+
+/**
+ * @brief Alarm lane: room including what bulk records may not use; InfluxDB has one lane
+ */
+static size_t sink_urgent_room(void) {
+    return GATEWAY_INFLUX != 0 ? influx_writer_room() : mqtt_forwarder_urgent_room();
+}
+
+/**
+ * @brief Alarm lane: publish now, past any open batch; InfluxDB posts its buffer at once
+ */
+static esp_err_t sink_publish_urgent(uint32_t node_id, const telemetry_record_t *rec) {
+    if (GATEWAY_INFLUX == 0) {
+        return mqtt_forwarder_publish_urgent(node_id, rec);
+    }
+    esp_err_t err = influx_writer_publish(node_id, rec);
+    influx_writer_flush();
+    return err;
+}
+
+static bool sink_connected(void) {
+    return GATEWAY_INFLUX != 0 ? influx_writer_connected() : mqtt_forwarder_connected();
+}
+
+static void sink_flush(void) {
+    if (GATEWAY_INFLUX != 0) {
+        influx_writer_flush();
+    } else {
+        mqtt_forwarder_flush();
+    }
+}
+
+static bool sink_idle(void) {
+    return GATEWAY_INFLUX != 0 ? influx_writer_idle() : mqtt_forwarder_idle();
+}
+
+/**
+ * @brief Forward one batch of decoded records
+ */
+static void forward_records(const gateway_record_t *batch, size_t count) {
+    uint32_t unpublished = 0;
+    for (size_t i = 0; i < count; i++) {
+        const telemetry_record_t *rec = &batch[i].rec;
+        if (observe_sub == NULL) {
+            observe_record(batch[i].node_id, rec);
+        }
+        if (sink_ready && sink_publish(batch[i].node_id, rec) != ESP_OK) {
+            unpublished++;
+        }
+        // Raw fixed point: formatting every record here would cost the forwarder more than the forward
+        EVENT_LOGD(TAG, "Node %08lx #%lu: %ld (0.01 C), %lu Pa, %lu (0.001 %%RH), %lu ohm", batch[i].node_id, rec->seq,
+                   rec->temperature, rec->pressure, rec->humidity, rec->gas_valid ? rec->gas_resistance : 0);
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.forwarded += count;
+    stats.unpublished += unpublished;
+    stats.batches++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief Everything that watches each record once, as it leaves the ring: aggregates, pressure alarms, history
+ */
+static void observe_record(uint32_t node_id, const telemetry_record_t *rec) {
+    if (aggregate_ready) {
+        aggregator_add_record(node_id, rec);
+    }
+    if (history_ready) {
+        ts_store_add(node_id, rec);
+    }
+    if (archive_ready) {
+        sd_archive_add(node_id, rec);
+    }
+    if (beacon_ready) {
+        ble_beacon_update(node_id, rec);
+    }
+    if (trends != NULL) {
+        track_pressure(node_id, rec);
+    }
+}
+
+/**
+ * @brief Observe the records the bus has queued for the forwarder, whatever MQTT and the spool are doing
+ */
+static void observe_bus(void) {
+    const sample_block_t *block;
+    while ((block = sample_bus_receive(observe_sub, 0)) != NULL) {
+        observe_record(block->node_id, &block->rec);
+        sample_bus_release(block);
+    }
+}
+
+/**
+ * @brief Publish one decoded record on the sample bus; link task
+ */
+static void publish_record(uint32_t node_id, const telemetry_record_t *rec) {
+    sample_block_t *block = sample_bus_alloc();
+    if (block == NULL) {
+        return;
+    }
+    block->node_id = node_id;
+    block->rec = *rec;
+    sample_bus_publish(block);
+}
+
+/**
+ * @brief Feed a node's pressure trend and send an alarm change straight out, on MQTT and the web stream
+ */
+static void track_pressure(uint32_t node_id, const telemetry_record_t *rec) {
+    gateway_trend_t *t = NULL;
+    for (size_t i = 0; i < trend_count; i++) {
+        if (trends[i].node_id == node_id) {
+            t = &trends[i];
+            break;
+        }
+    }
+    if (t == NULL) {
+        if (trend_count >= GATEWAY_TREND_NODES) {
+            return;
+        }
+        t = &trends[trend_count++];
+        t->node_id = node_id;
+        pressure_trend_init(&t->trend);
+    }
+
+    pressure_trend_alarm_t before = (pressure_trend_alarm_t)t->trend.alarm;
+    if (!pressure_trend_add(&t->trend, rec->time_s, rec->pressure)) {
+        return;
+    }
+    pressure_trend_reading_t r;
+    pressure_trend_get(&t->trend, &r);
+    char json[160];
+    int len = pressure_trend_alert_json(json, sizeof(json), node_id, &r);
+    if (len <= 0 || len >= (int)sizeof(json)) {
+        return;
+    }
+    if (r.alarm > before) {
+        ESP_LOGW(TAG, "Node %08lx pressure alarm %s: %ld Pa over 3 h", (unsigned long)node_id,
+                 pressure_trend_alarm_name(r.alarm), (long)r.change_pa_3h);
+    } else {
+        ESP_LOGI(TAG, "Node %08lx pressure alarm down to %s", (unsigned long)node_id,
+                 pressure_trend_alarm_name(r.alarm));
+    }
+    if (mqtt_ready && mqtt_forwarder_publish_alert(node_id, json, (size_t)len) != ESP_OK) {
+        ESP_LOGW(TAG, "Alert for node %08lx not published", (unsigned long)node_id);
+    }
+    metrics_stream_push_event("alert", json, (size_t)len);
+    portENTER_CRITICAL(&stats_lock);
+    if (r.alarm > before) {
+        stats.alarms_raised++;
+    } else {
+        stats.alarms_cleared++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief health_watch publisher: the gateway's own alarms, from the watcher task
+ */
+static void publish_health(const char *json, size_t len) {
+    if (mqtt_forwarder_connected() && mqtt_forwarder_publish_health(json, len) != ESP_OK) {
+        ESP_LOGW(TAG, "Health alarm not published");
+    }
+}
+
+/**
+ * @brief aggregator emit hook: publish a closed window; forwarder task
+ *
+ * Not spooled: a window that closes while the broker is unreachable is
+ * only kept for /api/aggregates.
+ */
+static void publish_aggregate(const aggregator_result_t *result) {
+    bool published = mqtt_ready && mqtt_forwarder_connected() && mqtt_forwarder_publish_aggregate(result) == ESP_OK;
+    ESP_LOGD(TAG, "Node %08lx %s %lus window: n=%lu min %ld max %ld mean %ld sd %ld%s",
+             (unsigned long)result->node_id, aggregator_metric_name(result->metric),
+             (unsigned long)result->window_s, (unsigned long)result->count, (long)result->min, (long)result->max,
+             lroundf(result->mean), lroundf(result->stddev), published ? "" : " (not published)");
+    portENTER_CRITICAL(&stats_lock);
+    if (published) {
+        stats.aggregates++;
+    } else {
+        stats.aggregates_unpublished++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief aggregator rose hook: publish a closed wind rose, counted with the windows; forwarder task
+ */
+static void publish_rose(const aggregator_rose_t *rose) {
+    bool published = mqtt_ready && mqtt_forwarder_connected() && mqtt_forwarder_publish_rose(rose) == ESP_OK;
+    ESP_LOGD(TAG, "Node %08lx %lus wind rose: n=%lu calm %lu mean %d deg steadiness %.2f%s",
+             (unsigned long)rose->node_id, (unsigned long)rose->window_s, (unsigned long)rose->count,
+             (unsigned long)rose->calm, rose->mean_dir, (double)rose->steadiness, published ? "" : " (not published)");
+    portENTER_CRITICAL(&stats_lock);
+    if (published) {
+        stats.aggregates++;
+    } else {
+        stats.aggregates_unpublished++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief Local wind speed and direction into the aggregator, under this board's own node id
+ */
+static void sample_wind(void) {
+    wind_reading_t w;
+    wind_get(&w);
+    if (!w.running) {
+        return;
+    }
+    uint8_t mac[6] = { 0 };
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    uint32_t node_id = ((uint32_t)mac[2] << 24) | ((uint32_t)mac[3] << 16) | ((uint32_t)mac[4] << 8) | mac[5];
+    uint32_t now_s = (uint32_t)time(NULL);
+    aggregator_add(node_id, AGGREGATOR_WIND_SPEED, w.speed_3s, now_s);
+    aggregator_add_wind(node_id, w.dir_now, w.speed_3s, now_s);
+}
+
+/**
+ * @brief Forward the record ring to the sink as far as the in-flight window allows
+ *
+ * Each batch is copied out so its slots go back to the link task before the
+ * slow part. Only what the window has room for is taken; the rest waits in
+ * the ring until a confirmation wakes the forwarder.
+ *
+ * @return bool true if records were left behind because the window is full
+ */
+static bool drain_ring(void) {
+    for (;;) {
+        size_t limit = GATEWAY_FORWARD_BATCH;
+        if (sink_ready) {
+            size_t room = sink_room();
+            if (room == 0) {
+                return spsc_ring_count(&record_ring) > 0;
+            }
+            if (room < limit) {
+                limit = room;
+            }
+        }
+        size_t n = 0;
+        gateway_record_t *slot;
+        while (n < limit && (slot = spsc_ring_front(&record_ring)) != NULL) {
+            forward_batch[n++] = *slot;
+            spsc_ring_release(&record_ring);
+        }
+        if (n == 0) {
+            return false;
+        }
+        forward_records(forward_batch, n);
+    }
+}
+
+/**
+ * @brief Forward the alarm ring ahead of the record ring and the spool
+ *
+ * With the sink up (or no spool to fall back on) alarm records go to its
+ * alarm lane, whatever backlog the bulk records have; with it down they
+ * join the spool and go out in turn once it is back. A record the sink
+ * has no room for waits in the ring for the next pass.
+ */
+static void forward_alarms(bool online) {
+    uint32_t spooled = 0;
+    gateway_alarm_t *slot;
+    while ((slot = spsc_ring_front(&alarm_ring)) != NULL) {
+        if (sink_ready && (online || !spool_ready)) {
+            if (sink_urgent_room() == 0) {
+                break;
+            }
+            esp_err_t err = sink_publish_urgent(slot->node_id, &slot->rec);
+            time_alarm(slot);
+            if (err != ESP_OK) {
+                portENTER_CRITICAL(&stats_lock);
+                stats.unpublished++;
+                portEXIT_CRITICAL(&stats_lock);
+            }
+        } else if (sink_ready) {
+            if (flash_backlog_space() == 0 || flash_backlog_push(slot->node_id, &slot->rec) != ESP_OK) {
+                break;
+            }
+            spooled++;
+        }
+        if (observe_sub == NULL) {
+            observe_record(slot->node_id, &slot->rec);
+        }
+        spsc_ring_release(&alarm_ring);
+    }
+    if (spooled > 0) {
+        flash_backlog_flush();
+        portENTER_CRITICAL(&stats_lock);
+        stats.urgent_spooled += spooled;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+}
+
+/**
+ * @brief Count an alarm-lane record handed to the sink, and how long it took from the radio and from its sample
+ */
+static void time_alarm(const gateway_alarm_t *alarm) {
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - alarm->rx_us) / 1000);
+    time_t now = time(NULL);
+    int32_t age_s = now >= ESPNOW_TIME_VALID_AFTER ? (int32_t)(now - (time_t)alarm->rec.time_s) : -1;
+    portENTER_CRITICAL(&stats_lock);
+    stats.urgent_forwarded++;
+    stats.urgent_last_ms = ms;
+    if (ms > stats.urgent_max_ms) {
+        stats.urgent_max_ms = ms;
+    }
+    stats.urgent_late += ms > GATEWAY_ALARM_TARGET_MS;
+    stats.urgent_age_s = age_s;
+    portEXIT_CRITICAL(&stats_lock);
+    if (ms > GATEWAY_ALARM_TARGET_MS) {
+        ESP_LOGW(TAG, "Alarm from node %08lx took %lu ms to forward", (unsigned long)alarm->node_id,
+                 (unsigned long)ms);
+    }
+}
+
+/**
+ * @brief Move the record ring into the flash spool, as far as it has space
+ *
+ * The tail of the spool is flushed each pass, so a power cut loses at most
+ * one pass of records.
+ *
+ * @return bool true if records were left behind because the spool is full
+ */
+static bool spool_ring(void) {
+    uint32_t space = flash_backlog_space();
+    uint32_t n = 0;
+    gateway_record_t *slot;
+    while (n < space && (slot = spsc_ring_front(&record_ring)) != NULL) {
+        if (flash_backlog_push(slot->node_id, &slot->rec) != ESP_OK) {
+            break;
+        }
+        if (observe_sub == NULL) {
+            observe_record(slot->node_id, &slot->rec);
+        }
+        spsc_ring_release(&record_ring);
+        n++;
+    }
+    if (n > 0) {
+        flash_backlog_flush();
+        portENTER_CRITICAL(&stats_lock);
+        stats.spooled += n;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+    return spsc_ring_count(&record_ring) > 0;
+}
+
+/**
+ * @brief Publish spooled records, oldest first, as far as the in-flight window allows
+ *
+ * A record the sink refuses outright is counted as unpublished and not kept:
+ * retrying it would stall the spool behind it. Once everything has been
+ * handed over, the open batches are sent and, when the server has confirmed
+ * them, the spool is released.
+ */
+static void replay_spool(void) {
+    size_t room;
+    while ((room = sink_room()) > 0) {
+        size_t n = flash_backlog_peek(replay_records, replay_nodes,
+                                      room < GATEWAY_FORWARD_BATCH ? room : GATEWAY_FORWARD_BATCH);
+        if (n == 0) {
+            break;
+        }
+        uint32_t unpublished = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (sink_publish(replay_nodes[i], &replay_records[i]) != ESP_OK) {
+                unpublished++;
+            }
+        }
+        flash_backlog_advance(n);
+        portENTER_CRITICAL(&stats_lock);
+        stats.replayed += n;
+        stats.unpublished += unpublished;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+
+    if (outbox_ready) {
+        outbox_commit();
+        return;
+    }
+    flash_backlog_info_t info;
+    flash_backlog_get_info(&info);
+    if (info.unsent == 0 && info.queued > 0) {
+        sink_flush();
+        if (sink_idle() && flash_backlog_commit() == ESP_OK) {
+            ESP_LOGI(TAG, "Spool replayed (%lu records)", (unsigned long)info.queued);
+        }
+    }
+}
+
+/**
+ * @brief Outbox: release the spool up to the last checkpoint the broker has confirmed, and set the next
+ *
+ * A checkpoint pairs the spool position with the forwarder's ticket at
+ * that moment, once every record before the position is in a message.
+ * Without batches that is always so; with them the open batches are sent
+ * first, at most every GATEWAY_OUTBOX_CHECKPOINT_MS. A message that
+ * expired unconfirmed was lost, so the spool is resent from its tail.
+ */
+static void outbox_commit(void) {
+    mqtt_forwarder_stats_t ms;
+    mqtt_forwarder_get_stats(&ms);
+    if (ms.expired != outbox_expired) {
+        outbox_expired = ms.expired;
+        checkpoint_pending = false;
+        flash_backlog_rewind();
+        ESP_LOGW(TAG, "MQTT messages expired unconfirmed; resending the spool from its tail");
+        return;
+    }
+    if (checkpoint_pending) {
+        if (!mqtt_forwarder_settled(checkpoint_ticket)) {
+            return;
+        }
+        flash_backlog_commit_to(checkpoint_position);
+        checkpoint_pending = false;
+    }
+
+    flash_backlog_info_t info;
+    flash_backlog_get_info(&info);
+    int64_t now_us = esp_timer_get_time();
+    if (info.queued == info.unsent) {
+        return;                                 // Nothing handed over awaits confirmation
+    }
+    if (ms.format != MQTT_FORMAT_FIELDS) {
+        if (now_us - checkpoint_us < (int64_t)GATEWAY_OUTBOX_CHECKPOINT_MS * 1000) {
+            return;
+        }
+        sink_flush();
+    }
+    checkpoint_position = flash_backlog_position();
+    checkpoint_ticket = mqtt_forwarder_ticket();
+    checkpoint_us = now_us;
+    checkpoint_pending = true;
+    if (mqtt_forwarder_settled(checkpoint_ticket)) {
+        // Already confirmed: no later PUBACK would bring the forwarder back for it
+        flash_backlog_commit_to(checkpoint_position);
+        checkpoint_pending = false;
+    }
+}
+
+/**
+ * @brief mqtt_forwarder and influx_writer wake hook; runs in the esp-mqtt or the writer task
+ */
+static void wake_on_mqtt(void) {
+    xEventGroupSetBits(events, GATEWAY_EVT_MQTT);
+}
+
+/**
+ * @brief A node is owed a slot ASSIGN or a channel announcement; the forwarder sends it
+ */
+static void wake_on_reply(void) {
+    xEventGroupSetBits(events, GATEWAY_EVT_REPLY);
+}
+
+/**
+ * @brief ota_pull hook: stop serving the node image while its slot is rewritten, serve what is staged after
+ */
+static void node_image_slot(bool in_use) {
+    if (in_use) {
+        if (ota_ready) {
+            espnow_ota_gateway_stop();
+            ota_ready = false;
+        }
+        return;
+    }
+    esp_err_t err = espnow_ota_gateway_start();
+    ota_ready = err == ESP_OK;
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "Node firmware not served: %s", esp_err_to_name(err));
+    }
+}
+
+/**
+ * @brief How long the forwarder may sleep when nothing wakes it
+ */
+static uint32_t next_wait_ms(void) {
+    int64_t since_stats_ms = (esp_timer_get_time() - last_stats_us) / 1000;
+    uint32_t wait = 0;
+    if (since_stats_ms < GATEWAY_STATS_INTERVAL_MS) {
+        wait = GATEWAY_STATS_INTERVAL_MS - (uint32_t)since_stats_ms;
+    }
+    if (mqtt_ready) {
+        uint32_t due = mqtt_forwarder_poll_due_ms();
+        if (due < wait) {
+            wait = due;
+        }
+    }
+    if (discovery_ready) {
+        uint32_t due = ha_discovery_poll_due_ms();
+        if (due < wait) {
+            wait = due;
+        }
+    }
+    if (influx_ready) {
+        uint32_t due = influx_writer_poll_due_ms();
+        if (due < wait) {
+            wait = due;
+        }
+    }
+    if (aggregate_ready && GATEWAY_WIND != 0) {
+        int64_t since_wind_ms = (esp_timer_get_time() - last_wind_us) / 1000;
+        uint32_t due = since_wind_ms < GATEWAY_WIND_SAMPLE_MS ? GATEWAY_WIND_SAMPLE_MS - (uint32_t)since_wind_ms : 0;
+        if (due < wait) {
+            wait = due;
+        }
+    }
+    if (history_ready) {
+        uint32_t due = ts_store_poll_due_ms();
+        if (due < wait) {
+            wait = due;
+        }
+    }
+    if (archive_ready) {
+        uint32_t due = sd_archive_poll_due_ms();
+        if (due < wait) {
+            wait = due;
+        }
+    }
+    if (time_ready) {
+        uint32_t due = espnow_time_gateway_poll_due_ms();
+        if (due < wait) {
+            wait = due;
+        }
+    }
+    if (slot_ready) {
+        uint32_t due = espnow_slot_gateway_poll_due_ms();
+        if (due < wait) {
+            wait = due;
+        }
+    }
+    if (channel_ready) {
+        uint32_t due = espnow_channel_gateway_poll_due_ms();
+        if (due < wait) {
+            wait = due;
+        }
+    }
+    // Records that could not move: a full spool or an unreachable broker gives no wake-up
+    if ((spsc_ring_count(&record_ring) > 0 || spsc_ring_count(&alarm_ring) > 0) && wait > GATEWAY_RETRY_INTERVAL_MS) {
+        wait = GATEWAY_RETRY_INTERVAL_MS;
+    }
+    return wait;
+}
+
+/**
+ * @brief The pipeline counters and queue depths on /metrics, for soak tests (node_sim.h) and dashboards
+ */
+static void write_gateway_metrics(metrics_export_writer_t *w) {
+    espnow_link_stats_t ls;
+    gateway_stats_t gs;
+    espnow_link_get_stats(&ls);
+    portENTER_CRITICAL(&stats_lock);
+    gs = stats;
+    portEXIT_CRITICAL(&stats_lock);
+
+    metrics_export_family(w, "espnow_rx_frames", METRICS_EXPORT_COUNTER, NULL, "ESP-NOW frames received");
+    metrics_export_sample_int(w, "espnow_rx_frames", "_total", NULL, ls.rx_frames);
+    metrics_export_family(w, "espnow_rx_dropped", METRICS_EXPORT_COUNTER, NULL,
+                          "ESP-NOW frames lost to a full receive ring");
+    metrics_export_sample_int(w, "espnow_rx_dropped", "_total", NULL, ls.rx_dropped);
+    metrics_export_family(w, "espnow_rx_ring_frames", METRICS_EXPORT_GAUGE, NULL,
+                          "Most frames ever waiting for the link task, and the ring's size");
+    metrics_export_sample_int(w, "espnow_rx_ring_frames", "", "state=\"peak\"", ls.rx_high_water);
+    metrics_export_sample_int(w, "espnow_rx_ring_frames", "", "state=\"capacity\"", ESPNOW_LINK_RX_SLOTS);
+
+    metrics_export_family(w, "gateway_frames", METRICS_EXPORT_COUNTER, NULL, "Telemetry frames by outcome");
+    metrics_export_sample_int(w, "gateway_frames", "_total", "outcome=\"queued\"", gs.frames);
+    metrics_export_sample_int(w, "gateway_frames", "_total", "outcome=\"deferred\"", gs.deferred);
+    metrics_export_sample_int(w, "gateway_frames", "_total", "outcome=\"malformed\"", gs.malformed);
+    metrics_export_family(w, "gateway_records", METRICS_EXPORT_COUNTER, NULL, "Records by pipeline stage");
+    metrics_export_sample_int(w, "gateway_records", "_total", "stage=\"queued\"", gs.records);
+    metrics_export_sample_int(w, "gateway_records", "_total", "stage=\"forwarded\"", gs.forwarded);
+    metrics_export_sample_int(w, "gateway_records", "_total", "stage=\"unpublished\"", gs.unpublished);
+    metrics_export_sample_int(w, "gateway_records", "_total", "stage=\"spooled\"", gs.spooled);
+    metrics_export_sample_int(w, "gateway_records", "_total", "stage=\"replayed\"", gs.replayed);
+    metrics_export_family(w, "gateway_record_ring_records", METRICS_EXPORT_GAUGE, NULL,
+                          "Decoded records waiting for the forwarder");
+    metrics_export_sample_int(w, "gateway_record_ring_records", "", "state=\"queued\"",
+                              spsc_ring_count(&record_ring));
+    metrics_export_sample_int(w, "gateway_record_ring_records", "", "state=\"peak\"", record_ring.high_water);
+    metrics_export_sample_int(w, "gateway_record_ring_records", "", "state=\"capacity\"", GATEWAY_RECORD_SLOTS);
+    metrics_export_family(w, "gateway_alarm_frames", METRICS_EXPORT_COUNTER, NULL,
+                          "Telemetry frames queued in the alarm lane (also counted as queued)");
+    metrics_export_sample_int(w, "gateway_alarm_frames", "_total", NULL, gs.urgent_frames);
+    metrics_export_family(w, "gateway_alarm_records", METRICS_EXPORT_COUNTER, NULL,
+                          "Alarm-lane records by outcome; late ones took over GATEWAY_ALARM_TARGET_MS");
+    metrics_export_sample_int(w, "gateway_alarm_records", "_total", "outcome=\"forwarded\"", gs.urgent_forwarded);
+    metrics_export_sample_int(w, "gateway_alarm_records", "_total", "outcome=\"late\"", gs.urgent_late);
+    metrics_export_sample_int(w, "gateway_alarm_records", "_total", "outcome=\"spooled\"", gs.urgent_spooled);
+    metrics_export_family(w, "gateway_alarm_latency_ms", METRICS_EXPORT_GAUGE, NULL,
+                          "Alarm-lane records: radio to sink, last and worst since boot");
+    metrics_export_sample_int(w, "gateway_alarm_latency_ms", "", "stat=\"last\"", gs.urgent_last_ms);
+    metrics_export_sample_int(w, "gateway_alarm_latency_ms", "", "stat=\"max\"", gs.urgent_max_ms);
+    metrics_export_sample_int(w, "gateway_alarm_latency_ms", "", "stat=\"target\"", GATEWAY_ALARM_TARGET_MS);
+    metrics_export_family(w, "gateway_alarm_age_seconds", METRICS_EXPORT_GAUGE, NULL,
+                          "Last alarm-lane record: node sample to sink, -1 without a clock");
+    metrics_export_sample_int(w, "gateway_alarm_age_seconds", "", NULL, gs.urgent_age_s);
+    node_table_write_metrics(w);
+
+    if (GATEWAY_CAPTURE != 0 || GATEWAY_REPLAY != 0) {
+        frame_capture_stats_t cs;
+        frame_capture_get_stats(&cs);
+        metrics_export_family(w, "capture_frames", METRICS_EXPORT_COUNTER, NULL,
+                              "Received frames captured to the SD card, lost to a full ring, and replayed");
+        metrics_export_sample_int(w, "capture_frames", "_total", "outcome=\"written\"", cs.frames);
+        metrics_export_sample_int(w, "capture_frames", "_total", "outcome=\"dropped\"", cs.dropped);
+        metrics_export_sample_int(w, "capture_frames", "_total", "outcome=\"replayed\"", cs.replayed);
+    }
+
+    if (mqtt_ready) {
+        mqtt_forwarder_stats_t ms;
+        mqtt_forwarder_get_stats(&ms);
+        metrics_export_family(w, "mqtt_messages", METRICS_EXPORT_COUNTER, NULL, "MQTT messages by outcome");
+        metrics_export_sample_int(w, "mqtt_messages", "_total", "outcome=\"published\"", ms.published);
+        metrics_export_sample_int(w, "mqtt_messages", "_total", "outcome=\"acked\"", ms.acked);
+        metrics_export_sample_int(w, "mqtt_messages", "_total", "outcome=\"expired\"", ms.expired);
+        metrics_export_sample_int(w, "mqtt_messages", "_total", "outcome=\"failed\"", ms.failed);
+        metrics_export_family(w, "mqtt_samples", METRICS_EXPORT_COUNTER, NULL, "Samples carried by MQTT messages");
+        metrics_export_sample_int(w, "mqtt_samples", "_total", NULL, ms.samples);
+        metrics_export_family(w, "mqtt_in_flight_messages", METRICS_EXPORT_GAUGE, NULL,
+                              "MQTT messages awaiting the broker's confirmation");
+        metrics_export_sample_int(w, "mqtt_in_flight_messages", "", "state=\"current\"", ms.in_flight);
+        metrics_export_sample_int(w, "mqtt_in_flight_messages", "", "state=\"peak\"", ms.in_flight_peak);
+        metrics_export_sample_int(w, "mqtt_in_flight_messages", "", "state=\"capacity\"", MQTT_FORWARDER_WINDOW);
+        metrics_export_family(w, "mqtt_connected", METRICS_EXPORT_GAUGE, NULL, "1 while the broker is connected");
+        metrics_export_sample_int(w, "mqtt_connected", "", NULL, ms.connected ? 1 : 0);
+    }
+}
+
+/**
+ * @brief Replay pacing: the record ring can take the largest frame's records (a snapshot from the replay task)
+ */
+static bool replay_room(void) {
+    return spsc_ring_space(&record_ring) >= TELEMETRY_PACKED_MAX_RECORDS;
+}
+
+/**
+ * @brief Log the pipeline counters, from the radio to the forwarder
+ */
+static void log_stats(void) {
+    espnow_link_stats_t ls;
+    espnow_reliable_rx_stats_t rs;
+    gateway_stats_t gs;
+    espnow_link_get_stats(&ls);
+    espnow_reliable_get_rx_stats(&rs);
+    portENTER_CRITICAL(&stats_lock);
+    gs = stats;
+    portEXIT_CRITICAL(&stats_lock);
+
+    ESP_LOGI(TAG, "Receive: %lu frames (%lu dropped, ring peak %lu/%d), %lu delivered, %lu duplicates, "
+             "%u nodes", (unsigned long)ls.rx_frames, (unsigned long)ls.rx_dropped,
+             (unsigned long)ls.rx_high_water, ESPNOW_LINK_RX_SLOTS, (unsigned long)rs.delivered,
+             (unsigned long)rs.duplicates, rs.nodes);
+    if (ESPNOW_LINK_ADAPT != 0) {
+        ESP_LOGI(TAG, "Link adaptation: %lu steps up, %lu backoffs, %lu of %lu sends failed",
+                 (unsigned long)ls.adapt_steps, (unsigned long)ls.adapt_backoffs, (unsigned long)ls.tx_failed,
+                 (unsigned long)ls.tx_frames);
+    }
+    ESP_LOGI(TAG, "Forward: %lu records in %lu batches, %lu deferred, %lu malformed, ring peak %lu/%d",
+             (unsigned long)gs.forwarded, (unsigned long)gs.batches, (unsigned long)gs.deferred,
+             (unsigned long)gs.malformed, (unsigned long)record_ring.high_water, GATEWAY_RECORD_SLOTS);
+    if (mqtt_ready) {
+        mqtt_forwarder_stats_t ms;
+        mqtt_forwarder_get_stats(&ms);
+        ESP_LOGI(TAG, "MQTT: %s, %lu messages (%lu samples) at QoS %u, %lu acked, %lu in flight (peak %lu/%d), "
+                 "%lu expired, %lu failed, %lu records unpublished", ms.connected ? "connected" : "disconnected",
+                 (unsigned long)ms.published, (unsigned long)ms.samples, ms.qos, (unsigned long)ms.acked,
+                 (unsigned long)ms.in_flight,
+                 (unsigned long)ms.in_flight_peak, MQTT_FORWARDER_WINDOW, (unsigned long)ms.expired,
+                 (unsigned long)ms.failed, (unsigned long)gs.unpublished);
+        if (MQTT_FORWARDER_CLAIMS != 0) {
+            ESP_LOGI(TAG, "MQTT claims: %lu sent, %lu records already published by another gateway",
+                     (unsigned long)ms.claims, (unsigned long)ms.deduped);
+        }
+    }
+    if (influx_ready) {
+        influx_writer_stats_t is;
+        influx_writer_get_stats(&is);
+        ESP_LOGI(TAG, "InfluxDB: %s, %lu points, %lu batches (%lu -> %lu bytes), %lu failed POSTs, %lu refused, "
+                 "last HTTP %d in %lu ms",
+                 influx_writer_connected() ? "reachable" : "unreachable", (unsigned long)is.points,
+                 (unsigned long)is.batches, (unsigned long)is.bytes_raw, (unsigned long)is.bytes_sent,
+                 (unsigned long)is.failures, (unsigned long)is.rejected, is.last_status,
+                 (unsigned long)is.last_ms);
+    }
+    if (aggregate_ready) {
+        aggregator_stats_t as;
+        aggregator_get_stats(&as);
+        ESP_LOGI(TAG, "Aggregates: %lu samples from %lu nodes, %lu windows and %lu roses closed (%lu published, "
+                 "%lu not), %lu late, %lu held, %lu over capacity", (unsigned long)as.samples, (unsigned long)as.nodes,
+                 (unsigned long)as.closed, (unsigned long)as.roses_closed, (unsigned long)gs.aggregates,
+                 (unsigned long)gs.aggregates_unpublished, (unsigned long)as.late, (unsigned long)as.held,
+                 (unsigned long)as.overflow);
+    }
+    espnow_config_stats_t cs;
+    espnow_config_get_stats(&cs);
+    if (cs.nodes > 0) {
+        ESP_LOGI(TAG, "Node config: %u nodes set, %u not running theirs yet, %lu versions, %lu pushed on ACKs, "
+                 "%lu confirmed", cs.nodes, cs.pending, (unsigned long)cs.sets, (unsigned long)cs.pushes,
+                 (unsigned long)cs.confirmed);
+    }
+    if (ls.rotating) {
+        espnow_rekey_stats_t ks;
+        espnow_rekey_get_stats(&ks);
+        ESP_LOGI(TAG, "Key rotation: %u nodes hold the new key, %u moved (%lu commits, %lu ACKs named a seq), "
+                 "%lu send fallbacks, peer move %lu us (max %lu)", ks.ready, ks.switched, (unsigned long)ks.commits,
+                 (unsigned long)ks.announced, (unsigned long)ls.key_fallbacks, (unsigned long)ls.key_switch_us,
+                 (unsigned long)ls.key_switch_us_max);
+    }
+    if (bus_ready) {
+        sample_bus_log();
+    }
+    if (trends != NULL) {
+        ESP_LOGI(TAG, "Pressure trend: %u nodes tracked, %lu alarms raised, %lu cleared", (unsigned)trend_count,
+                 (unsigned long)gs.alarms_raised, (unsigned long)gs.alarms_cleared);
+    }
+    if (history_ready) {
+        ts_store_info_t hs;
+        ts_store_get_info(&hs);
+        ESP_LOGI(TAG, "History: %s, %lu segments (%lu bytes), %lu records in %lu blocks, %lu pending, %lu dropped, "
+                 "%lu without a clock, %lu days expired", hs.ready ? "ready" : "waiting for SPIFFS",
+                 (unsigned long)hs.segments, (unsigned long)hs.bytes, (unsigned long)hs.records,
+                 (unsigned long)hs.blocks, (unsigned long)hs.pending, (unsigned long)hs.dropped,
+                 (unsigned long)hs.no_clock, (unsigned long)hs.expired);
+    }
+    if (mem_policy_psram()) {
+        mem_policy_stats_t ps;
+        mem_policy_get_stats(&ps);
+        ESP_LOGI(TAG, "PSRAM: %lu of %lu KB free, %lu buffers (%lu KB) placed there, %lu in internal RAM "
+                 "(%lu KB, %lu after PSRAM ran out)", (unsigned long)(ps.psram_free / 1024),
+                 (unsigned long)(ps.psram_total / 1024), (unsigned long)ps.bulk_psram_allocs,
+                 (unsigned long)(ps.bulk_psram_bytes / 1024), (unsigned long)ps.bulk_internal_allocs,
+                 (unsigned long)(ps.bulk_internal_bytes / 1024), (unsigned long)ps.fallbacks);
+    }
+    if (archive_ready) {
+        sd_archive_stats_t as;
+        sd_archive_get_stats(&as);
+        ESP_LOGI(TAG, "SD archive: %lu records, %lu dropped, %lu writes (%lu KB, slowest %lu ms), %lu syncs, "
+                 "%lu files, %lu errors", (unsigned long)as.records, (unsigned long)as.dropped,
+                 (unsigned long)as.writes, (unsigned long)(as.bytes / 1024), (unsigned long)as.write_ms_max,
+                 (unsigned long)as.syncs, (unsigned long)as.files, (unsigned long)as.errors);
+    }
+    if (beacon_ready) {
+        ble_beacon_stats_t bs;
+        ble_beacon_get_stats(&bs);
+        ESP_LOGI(TAG, "BLE beacon: %s node %08lx, %lu updates, %lu stale, %lu errors",
+                 bs.advertising ? "advertising" : "waiting for", (unsigned long)bs.node_id,
+                 (unsigned long)bs.updates, (unsigned long)bs.stale, (unsigned long)bs.errors);
+    }
+    if (GATEWAY_NMEA != 0) {
+        nmea_stats_t ns;
+        nmea_get_stats(&ns);
+        ESP_LOGI(TAG, "NMEA: %lu sentences, %lu UART bytes, %lu UDP, %lu TCP clients (%lu dropped)",
+                 (unsigned long)ns.sentences, (unsigned long)ns.uart_bytes, (unsigned long)ns.udp_sent,
+                 (unsigned long)ns.tcp_clients, (unsigned long)ns.tcp_dropped);
+    }
+    if (GATEWAY_SIGNALK != 0) {
+        signalk_stats_t ks;
+        signalk_get_stats(&ks);
+        ESP_LOGI(TAG, "Signal K: %lu clients, %lu updates, %lu frames built, %lu sent, %lu clients dropped",
+                 (unsigned long)ks.clients, (unsigned long)ks.updates, (unsigned long)ks.frames,
+                 (unsigned long)ks.sent, (unsigned long)ks.dropped);
+    }
+    if (GATEWAY_MULTICAST != 0) {
+        telemetry_mcast_stats_t ms;
+        telemetry_mcast_get_stats(&ms);
+        ESP_LOGI(TAG, "Multicast: %lu datagrams, %lu dropped (%lu queue full, %lu no uplink), %lu send errors",
+                 (unsigned long)ms.sent, (unsigned long)(ms.queue_full + ms.no_uplink),
+                 (unsigned long)ms.queue_full, (unsigned long)ms.no_uplink, (unsigned long)ms.errors);
+    }
+    if (GATEWAY_SYSLOG != 0) {
+        syslog_sink_stats_t ys;
+        syslog_sink_get_stats(&ys);
+        ESP_LOGI(TAG, "Syslog: %s, %lu lines in %lu datagrams, %lu dropped (ring full), %lu without uplink, "
+                 "%lu send errors", ys.running ? "running" : "stopped", (unsigned long)ys.lines,
+                 (unsigned long)ys.datagrams, (unsigned long)ys.dropped, (unsigned long)ys.no_uplink,
+                 (unsigned long)ys.errors);
+    }
+    if (GATEWAY_GPS != 0) {
+        gps_fix_t gf;
+        gps_stats_t gst;
+        gps_get_fix(&gf);
+        gps_get_stats(&gst);
+        if (gst.running) {
+            ESP_LOGI(TAG, "GPS: %s, %u satellites, %lu bytes, %lu sentences (%lu skipped), %lu checksum errors, "
+                     "%lu malformed, %lu overruns, %lu fixes published, tokenizer %lu ppm of a core",
+                     gf.valid ? "fix" : "no fix", gf.satellites, (unsigned long)gst.bytes,
+                     (unsigned long)gst.sentences, (unsigned long)gst.skipped, (unsigned long)gst.checksum_errors,
+                     (unsigned long)gst.malformed, (unsigned long)gst.overruns, (unsigned long)gst.published,
+                     (unsigned long)gst.load_ppm);
+        }
+    }
+    if (GATEWAY_N2K != 0) {
+        n2k_stats_t n2k;
+        n2k_get_stats(&n2k);
+        ESP_LOGI(TAG, "NMEA 2000: address %u, %lu frames, %lu dropped, %lu records skipped, %lu claims lost, %lu bus-off",
+                 n2k.address, (unsigned long)n2k.frames, (unsigned long)n2k.dropped, (unsigned long)n2k.skipped,
+                 (unsigned long)n2k.claims_lost, (unsigned long)n2k.bus_off);
+    }
+    if (GATEWAY_WIND != 0) {
+        wind_log();
+    }
+    if (GATEWAY_MOTION != 0) {
+        motion_attitude_t ma;
+        motion_stats_t mst;
+        motion_get(&ma);
+        motion_get_stats(&mst);
+        if (mst.running) {
+            ESP_LOGI(TAG, "Motion: heel %s%d.%02d, pitch %s%d.%02d deg, %lu samples in %lu batches (%lu without "
+                     "accelerometer), %lu overflows, %lu errors, fusion %u.%u%% of a core (max %lu us)",
+                     ma.roll < 0 ? "-" : "", abs(ma.roll) / 100, abs(ma.roll) % 100, ma.pitch < 0 ? "-" : "",
+                     abs(ma.pitch) / 100, abs(ma.pitch) % 100,
+                     (unsigned long)mst.samples, (unsigned long)mst.batches, (unsigned long)mst.gated,
+                     (unsigned long)mst.overflows, (unsigned long)mst.errors, mst.load_permille / 10,
+                     mst.load_permille % 10, (unsigned long)mst.fuse_us_max);
+        }
+    }
+    if (ota_ready) {
+        espnow_ota_stats_t os;
+        espnow_ota_get_stats(&os);
+        ESP_LOGI(TAG, "Node firmware %s: %lu offers, %lu sessions, %lu nodes updated, %lu failed, %lu dropped, "
+                 "%lu blocks (%lu resent), last session %lu s", os.version, (unsigned long)os.offers,
+                 (unsigned long)os.sessions, (unsigned long)os.updated, (unsigned long)os.failed,
+                 (unsigned long)os.dropped, (unsigned long)os.blocks_sent, (unsigned long)os.blocks_resent,
+                 (unsigned long)(os.last_session_ms / 1000));
+    }
+    if (pull_ready) {
+        ota_pull_stats_t ps;
+        ota_pull_get_stats(&ps);
+        ESP_LOGI(TAG, "Firmware pull: %lu checks (%lu failed, %lu bytes), %lu gateway updates, %lu node images, "
+                 "%lu failed, %lu refused, %lu KB downloaded in %lu resumes", (unsigned long)ps.checks,
+                 (unsigned long)ps.check_failures, (unsigned long)ps.manifest_bytes,
+                 (unsigned long)ps.gateway_updates, (unsigned long)ps.node_images, (unsigned long)ps.failures,
+                 (unsigned long)ps.refused, (unsigned long)(ps.bytes / 1024), (unsigned long)ps.resumes);
+    }
+    if (time_ready) {
+        espnow_time_stats_t ts;
+        espnow_time_get_stats(&ts);
+        ESP_LOGI(TAG, "Time beacon: %s, %lu sent, %lu SNTP syncs", !ts.synced ? "clock not set" :
+                 ts.source == ESPNOW_TIME_SOURCE_SNTP ? "SNTP" : "holdover", (unsigned long)ts.beacons,
+                 (unsigned long)ts.syncs);
+    }
+    if (channel_ready) {
+        espnow_channel_stats_t cs;
+        espnow_channel_get_stats(&cs);
+        if (cs.next != 0) {
+            ESP_LOGI(TAG, "Channel: %u, moving to %u in %lu s, %lu nodes told", cs.channel, cs.next,
+                     (unsigned long)(cs.switch_in_ms / 1000), (unsigned long)cs.told);
+        } else {
+            ESP_LOGI(TAG, "Channel: %u%s, %lu switches", cs.channel, cs.follows_uplink ? " (uplink)" : "",
+                     (unsigned long)cs.switches);
+        }
+    }
+    if (pair_ready) {
+        espnow_pair_stats_t ps;
+        espnow_pair_get_stats(&ps);
+        ESP_LOGI(TAG, "Pairing: %lu requests, %lu offers, %lu rejected", (unsigned long)ps.requests,
+                 (unsigned long)ps.offers, (unsigned long)ps.rejected);
+    }
+    if (slot_ready) {
+        espnow_slot_stats_t ss;
+        espnow_slot_get_stats(&ss);
+        ESP_LOGI(TAG, "Slots: %u of %d held, %lu requests (%lu refused), %lu windows", ss.assigned,
+                 ESPNOW_SLOT_COUNT, (unsigned long)ss.requests, (unsigned long)ss.refused,
+                 (unsigned long)ss.windows);
+    }
+    espnow_relay_stats_t rl;
+    espnow_relay_get_stats(&rl);
+    if (rl.up > 0) {
+        ESP_LOGI(TAG, "Relayed: %lu frames from %u nodes, %lu ACKs sent back, %lu dropped", (unsigned long)rl.up,
+                 rl.routes, (unsigned long)rl.down, (unsigned long)rl.dropped);
+    }
+    if (spool_ready) {
+        flash_backlog_info_t info;
+        flash_backlog_get_info(&info);
+        ESP_LOGI(TAG, "Spool: %lu queued (%lu unsent) of %lu, %lu spooled, %lu replayed, %lu dropped, "
+                 "%lu held-off ACKs", (unsigned long)info.queued, (unsigned long)info.unsent,
+                 (unsigned long)info.capacity, (unsigned long)gs.spooled, (unsigned long)gs.replayed,
+                 (unsigned long)info.dropped, (unsigned long)rs.hold_acks);
+    }
+}
+
 esp_err_t gateway_init(void) {
     ESP_LOGI(TAG, "Initializing gateway mode...");
+    esp_err_t err;
 
-    // TODO: Initialize WiFi station mode
-    // TODO: Initialize MQTT client
-    // TODO: Initialize ESP-NOW for receiving data from nodes
-    // TODO: Set up data forwarding mechanisms
+    // First, so the rest of the gateway's start goes to the collector too
+    if (GATEWAY_SYSLOG != 0) {
+        err = syslog_sink_start();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Remote syslog unavailable: %s", esp_err_to_name(err));
+        }
+    }
 
-    ESP_LOGI(TAG, "Gateway initialization completed");
+    // Allocated once; nothing on the receive path allocates per frame
+    record_slots = malloc(GATEWAY_RECORD_SLOTS * sizeof(gateway_record_t));
+    if (events == NULL) {
+        events = xEventGroupCreateStatic(&events_buf);
+    }
+    if (record_slots == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate the record ring");
+        gateway_cleanup();
+        return ESP_ERR_NO_MEM;
+    }
+    spsc_ring_init(&record_ring, record_slots, sizeof(gateway_record_t), GATEWAY_RECORD_SLOTS);
+    spsc_ring_init(&alarm_ring, alarm_slots, sizeof(gateway_alarm_t), GATEWAY_ALARM_SLOTS);
+    memset(&stats, 0, sizeof(stats));
+    stats.urgent_age_s = -1;
+    last_stats_us = esp_timer_get_time();
+    node_table_init();
+
+    // Before the NMEA outputs start, so they can subscribe
+    err = sample_bus_init();
+    bus_ready = err == ESP_OK;
+    if (!bus_ready) {
+        ESP_LOGW(TAG, "No sample bus, records are observed from the ring: %s", esp_err_to_name(err));
+    }
+
+    // Node settings first, so the retained config/set messages find them loaded
+    espnow_config_gateway_start();
+    espnow_rekey_gateway_start();
+    mqtt_forwarder_set_config_handler(espnow_config_gateway_set_json);
+    if (GATEWAY_MQTT_CMD != 0) {
+        err = mqtt_cmd_start();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "No MQTT commands: %s", esp_err_to_name(err));
+        }
+    }
+    err = mqtt_forwarder_init(wake_on_mqtt);
+    mqtt_ready = err == ESP_OK;
+    if (!mqtt_ready) {
+        ESP_LOGW(TAG, "MQTT unavailable: %s", esp_err_to_name(err));
+    } else {
+        health_watch_set_publisher(publish_health);
+    }
+    if (GATEWAY_RAW_SAMPLES != 0 && GATEWAY_INFLUX != 0) {
+        err = influx_writer_init(wake_on_mqtt);
+        influx_ready = err == ESP_OK;
+        if (!influx_ready) {
+            ESP_LOGW(TAG, "InfluxDB writer unavailable: %s", esp_err_to_name(err));
+        }
+    }
+    sink_ready = GATEWAY_RAW_SAMPLES != 0 && (GATEWAY_INFLUX != 0 ? influx_ready : mqtt_ready);
+    // Only records published on MQTT have state topics to point at
+    if (GATEWAY_HA_DISCOVERY != 0 && GATEWAY_RAW_SAMPLES != 0 && GATEWAY_INFLUX == 0 && mqtt_ready) {
+        err = ha_discovery_start();
+        discovery_ready = err == ESP_OK;
+        if (!discovery_ready) {
+            ESP_LOGW(TAG, "No Home Assistant discovery: %s", esp_err_to_name(err));
+        }
+    }
+    if (GATEWAY_RAW_SAMPLES != 0 && !sink_ready) {
+        ESP_LOGW(TAG, "Records will only be logged");
+    } else if (sink_ready) {
+        // The node backlog partition; a board is either a node or the gateway
+        err = flash_backlog_init();
+        spool_ready = err == ESP_OK;
+        if (!spool_ready) {
+            ESP_LOGW(TAG, "No flash spool, records wait in RAM while the sink is down: %s", esp_err_to_name(err));
+        }
+        if (spool_ready && GATEWAY_MQTT_OUTBOX != 0 && GATEWAY_INFLUX == 0 && mqtt_ready) {
+            mqtt_forwarder_stats_t ms;
+            mqtt_forwarder_get_stats(&ms);
+            outbox_ready = ms.qos > 0;
+        }
+        if (outbox_ready) {
+            // esp-mqtt's outbox did not survive the reset: what was handed to it goes again
+            flash_backlog_rewind();
+            flash_backlog_info_t info;
+            flash_backlog_get_info(&info);
+            ESP_LOGI(TAG, "MQTT outbox on the flash spool, %lu records to send", (unsigned long)info.queued);
+        }
+    }
+
+    if (GATEWAY_AGGREGATE != 0) {
+        err = aggregator_init(publish_aggregate, publish_rose);
+        aggregate_ready = err == ESP_OK;
+        if (!aggregate_ready) {
+            ESP_LOGW(TAG, "No aggregates: %s", esp_err_to_name(err));
+        }
+    }
+
+    if (GATEWAY_HISTORY != 0) {
+        err = ts_store_init();
+        history_ready = err == ESP_OK;
+        if (!history_ready) {
+            ESP_LOGW(TAG, "No local history: %s", esp_err_to_name(err));
+        }
+    }
+
+    if (GATEWAY_SD_ARCHIVE != 0) {
+        err = sd_archive_start();
+        archive_ready = err == ESP_OK;
+        if (!archive_ready) {
+            ESP_LOGW(TAG, "No SD archive: %s", esp_err_to_name(err));
+        }
+    }
+    if (GATEWAY_CAPTURE != 0 && archive_ready) {
+        err = frame_capture_start();
+        capture_ready = err == ESP_OK;
+        if (!capture_ready) {
+            ESP_LOGW(TAG, "No frame capture: %s", esp_err_to_name(err));
+        }
+    }
+
+    if (GATEWAY_BLE_BEACON != 0) {
+        err = ble_beacon_start();
+        beacon_ready = err == ESP_OK;
+        if (!beacon_ready) {
+            ESP_LOGW(TAG, "No BLE beacon: %s", esp_err_to_name(err));
+        }
+    }
+
+    if (GATEWAY_PRESSURE_ALERTS != 0) {
+        trend_count = 0;
+        trends = malloc(GATEWAY_TREND_NODES * sizeof(gateway_trend_t));
+        if (trends == NULL) {
+            ESP_LOGW(TAG, "No pressure alarms: out of memory");
+        }
+    }
+
+    // Observation leaves the ring for the bus, so a broker outage or a full window does not delay it
+    if (bus_ready && (aggregate_ready || history_ready || archive_ready || beacon_ready || trends != NULL)) {
+        err = sample_bus_subscribe("observe", GATEWAY_OBSERVE_DEPTH, &observe_sub);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Records are observed from the ring: %s", esp_err_to_name(err));
+        }
+    }
+
+    // The uplink already started the radio unless it is not configured; its channel wins then
+    wifi_sta_status_t sta;
+    wifi_ap_get_sta_status(&sta);
+    bool uplink = sta.state != WIFI_STA_DISABLED;
+    err = wifi_espnow_init(espnow_channel_gateway_home(AP_CHANNEL));
+    if (err == ESP_OK) {
+        err = espnow_reliable_receiver_init(deliver_telemetry);
+    }
+    if (err == ESP_OK) {
+        err = espnow_relay_gateway_start(relayed_rx);
+    }
+    if (err == ESP_OK) {
+        err = espnow_link_init(espnow_rx);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ESP-NOW receive unavailable: %s", esp_err_to_name(err));
+        return err;
+    }
+    // Nodes paired on earlier boots, so their encrypted frames are not dropped before espnow_rx()
+    err = espnow_pair_gateway_restore();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Paired nodes not all restored, they are taken again as they announce: %s",
+                 esp_err_to_name(err));
+    }
+
+    // A new image is confirmed once a node's telemetry gets through; see gateway_main()
+    boot_health_start(BOOT_HEALTH_PEER);
+    metrics_export_add_source(write_gateway_metrics);
+
+    err = espnow_ota_gateway_start();
+    ota_ready = err == ESP_OK;
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "Node firmware not served: %s", esp_err_to_name(err));
+    }
+    if (GATEWAY_OTA_PULL != 0) {
+        err = uplink ? ota_pull_start(node_image_slot) : ESP_ERR_INVALID_STATE;
+        pull_ready = err == ESP_OK;
+        if (!pull_ready) {
+            ESP_LOGW(TAG, "Firmware not pulled over the uplink: %s", uplink ? esp_err_to_name(err) : "no uplink");
+        }
+    }
+    err = espnow_time_gateway_start();
+    time_ready = err == ESP_OK;
+    if (!time_ready) {
+        ESP_LOGW(TAG, "No time beacon for the nodes: %s", esp_err_to_name(err));
+    }
+    err = espnow_channel_gateway_start(uplink, wake_on_reply);
+    channel_ready = err == ESP_OK;
+    if (!channel_ready) {
+        ESP_LOGW(TAG, "ESP-NOW channel stays as it is: %s", esp_err_to_name(err));
+    }
+    err = espnow_pair_gateway_start();
+    pair_ready = err == ESP_OK;
+    if (!pair_ready && err != ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGW(TAG, "Nodes cannot pair: %s", esp_err_to_name(err));
+    }
+    err = espnow_slot_gateway_start(GATEWAY_SLOT_SLEEP != 0, wake_on_reply);
+    slot_ready = err == ESP_OK;
+    if (!slot_ready) {
+        ESP_LOGW(TAG, "No transmit slots for the nodes: %s", esp_err_to_name(err));
+    }
+
+    if (GATEWAY_WIND != 0) {
+        err = wind_start();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Wind unavailable: %s", esp_err_to_name(err));
+        }
+    }
+    if (GATEWAY_WIND != 0 && GATEWAY_MOTION != 0) {
+        err = i2c_bus_start(GATEWAY_I2C_PORT, GATEWAY_I2C_SDA_GPIO, GATEWAY_I2C_SCL_GPIO);
+        if (err == ESP_OK) {
+            err = motion_start();
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Motion unavailable - wind not corrected for heel: %s", esp_err_to_name(err));
+        }
+    }
+    if (GATEWAY_GPS != 0) {
+        err = gps_start();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "GPS unavailable - no true wind or position: %s", esp_err_to_name(err));
+        }
+    }
+    if (GATEWAY_NMEA != 0) {
+        err = nmea_start();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "NMEA output unavailable: %s", esp_err_to_name(err));
+        }
+    }
+    if (GATEWAY_SIGNALK != 0) {
+        err = signalk_start();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Signal K deltas unavailable: %s", esp_err_to_name(err));
+        }
+    }
+    if (GATEWAY_MULTICAST != 0) {
+        err = telemetry_mcast_start();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Multicast telemetry unavailable: %s", esp_err_to_name(err));
+        }
+    }
+    if (GATEWAY_N2K != 0) {
+        err = n2k_start();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "NMEA 2000 output unavailable: %s", esp_err_to_name(err));
+        }
+    }
+
+    // Last, so the capture meets the same pipeline live frames do
+    if (GATEWAY_REPLAY != 0 && archive_ready) {
+#ifdef GATEWAY_REPLAY_FILE
+        const char *replay_file = GATEWAY_REPLAY_FILE;
+#else
+        const char *replay_file = NULL;
+#endif
+        err = frame_capture_replay_start(replay_file, GATEWAY_REPLAY_SPEED, replay_room);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "No capture replayed: %s", esp_err_to_name(err));
+        }
+    }
+
+    ESP_LOGI(TAG, "Gateway initialization completed (%d record slots)", GATEWAY_RECORD_SLOTS);
     return ESP_OK;
 }
 
 void gateway_main(void) {
-    // TODO: Main gateway processing loop
-    // TODO: Receive data from nodes via ESP-NOW
-    // TODO: Forward data to MQTT broker
     // TODO: Handle connection management
-    // TODO: Implement data buffering for offline scenarios
+    xEventGroupWaitBits(events, GATEWAY_EVT_RECORDS | GATEWAY_EVT_MQTT | GATEWAY_EVT_REPLY, pdTRUE, pdFALSE,
+                        pdMS_TO_TICKS(wait_ms));
+
+    // While the broker is unreachable, records go to the flash spool; once it is back the
+    // spool is replayed first, and new records keep going behind it until it is empty so
+    // each node's samples stay in order. With the outbox every record takes the spool, up
+    // or down. When neither can take more, the ring fills and the nodes are told to hold
+    // off rather than resend into it. Alarm-lane records go before all of that.
+    bool online = sink_ready && sink_connected();
+    forward_alarms(online);
+    if (online && spool_ready) {
+        replay_spool();
+    }
+    if (observe_sub != NULL) {
+        observe_bus();
+    }
+    bool stuck;
+    if (spool_ready && (outbox_ready || !online || flash_backlog_unsent() > 0)) {
+        stuck = spool_ring();
+        if (outbox_ready && online) {
+            replay_spool();                     // What was just spooled goes out in this pass
+        }
+    } else {
+        stuck = drain_ring();
+    }
+    // Only once the ring is turning frames away; a briefly full window is not worth a hold
+    bool blocked = stuck && spsc_ring_space(&record_ring) < TELEMETRY_PACKED_MAX_RECORDS;
+    espnow_reliable_set_hold(blocked ? GATEWAY_HOLD_MS : 0);
+    if (boot_health_pending()) {
+        portENTER_CRITICAL(&stats_lock);
+        bool heard = stats.frames > 0;
+        portEXIT_CRITICAL(&stats_lock);
+        if (heard) {
+            boot_health_pass(BOOT_HEALTH_PEER);
+        }
+    }
+    if (aggregate_ready) {
+        aggregator_poll();
+    }
+    if (history_ready) {
+        ts_store_poll();
+    }
+    if (archive_ready) {
+        sd_archive_poll();
+    }
+    if (beacon_ready) {
+        ble_beacon_poll();
+    }
+    if (time_ready) {
+        espnow_time_gateway_poll();
+    }
+    if (slot_ready) {
+        espnow_slot_gateway_poll();
+    }
+    if (channel_ready) {
+        espnow_channel_gateway_poll();
+    }
+    if (mqtt_ready) {
+        mqtt_forwarder_poll();
+    }
+    if (discovery_ready) {
+        ha_discovery_poll();
+    }
+    if (influx_ready) {
+        influx_writer_poll();
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    if (aggregate_ready && GATEWAY_WIND != 0 && now_us - last_wind_us >= (int64_t)GATEWAY_WIND_SAMPLE_MS * 1000) {
+        last_wind_us = now_us;
+        sample_wind();
+    }
+    if (now_us - last_stats_us >= (int64_t)GATEWAY_STATS_INTERVAL_MS * 1000) {
+        last_stats_us = now_us;
+        log_stats();
+    }
+    wait_ms = next_wait_ms();
+}
+
+esp_err_t gateway_handle_telemetry(const uint8_t *mac, const uint8_t *data, size_t len) {
+    if (record_slots == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    telemetry_header_t hdr;
+    esp_err_t err = telemetry_decode_header(data, len, &hdr);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Dropped %u-byte frame: %s", (unsigned)len, esp_err_to_name(err));
+        portENTER_CRITICAL(&stats_lock);
+        stats.malformed++;
+        portEXIT_CRITICAL(&stats_lock);
+        return err;
+    }
+    // Decoded first, so the frame's lane is known before either ring is touched: a frame with
+    // an alarm record goes whole into the alarm lane, ahead of whatever the record ring holds
+    telemetry_reader_t reader;
+    telemetry_reader_init(&reader, data, &hdr);
+    bool urgent = false;
+    for (uint8_t i = 0; i < hdr.count; i++) {
+        telemetry_reader_next(&reader, &frame_records[i]);
+        urgent |= frame_records[i].urgent;
+    }
+    bool alarm = urgent && spsc_ring_space(&alarm_ring) >= hdr.count;
+    if (!alarm && spsc_ring_space(&record_ring) < hdr.count) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.deferred++;
+        portEXIT_CRITICAL(&stats_lock);
+        xEventGroupSetBits(events, GATEWAY_EVT_RECORDS);
+        return ESP_ERR_NO_MEM;
+    }
 
-    ESP_LOGI(TAG, "Gateway mode activated - main processing loop started");
+    if (hdr.flags & TELEMETRY_FLAG_SAMPLES_LOST) {
+        ESP_LOGW(TAG, "Node %08lx lost samples before seq %lu", (unsigned long)hdr.node_id,
+                 (unsigned long)hdr.base_seq);
+    }
+    espnow_config_gateway_seen(mac, hdr.node_id, hdr.config_version);
+    if (hdr.flags & TELEMETRY_FLAG_KEY) {
+        espnow_rekey_gateway_seen(mac, hdr.key_fingerprint, hdr.key_switch_seq);
+    }
+    int64_t rx_us = esp_timer_get_time();
+    for (uint8_t i = 0; i < hdr.count; i++) {
+        const telemetry_record_t *rec = &frame_records[i];
+        if (alarm) {
+            gateway_alarm_t *slot = spsc_ring_acquire(&alarm_ring);
+            slot->node_id = hdr.node_id;
+            slot->rec = *rec;
+            slot->rx_us = rx_us;
+            spsc_ring_commit(&alarm_ring);
+        } else {
+            gateway_record_t *slot = spsc_ring_acquire(&record_ring);
+            slot->node_id = hdr.node_id;
+            slot->rec = *rec;
+            spsc_ring_commit(&record_ring);
+        }
+        if (bus_ready) {
+            publish_record(hdr.node_id, rec);
+        } else if (GATEWAY_N2K != 0 && i + 1 == hdr.count) {
+            n2k_publish(hdr.node_id, rec);
+        }
+    }
 
-    // For now, just log that we're running
-    // In the full implementation, this would be the main event loop
+    node_table_on_telemetry(mac, &hdr, hdr.count > 0 ? &frame_records[hdr.count - 1] : NULL);
+    if (hdr.count > 0) {
+        latest_values_put(hdr.node_id, &frame_records[hdr.count - 1]);
+    }
+    if (GATEWAY_MULTICAST != 0) {
+        telemetry_mcast_send(data, len);
+    }
+    portENTER_CRITICAL(&stats_lock);
+    stats.frames++;
+    stats.records += hdr.count;
+    stats.urgent_frames += alarm;
+    portEXIT_CRITICAL(&stats_lock);
+    xEventGroupSetBits(events, GATEWAY_EVT_RECORDS);
+    return ESP_OK;
 }
 
 esp_err_t gateway_cleanup(void) {
     ESP_LOGI(TAG, "Cleaning up gateway resources...");
 
-    // TODO: Disconnect from MQTT broker
+    n2k_stop();
+    telemetry_mcast_stop();
+    signalk_stop();
+    nmea_stop();
+    gps_stop();
+    motion_stop();
+    i2c_bus_stop();
+    wind_stop();
+    sample_bus_unsubscribe(observe_sub);
+    observe_sub = NULL;
+
+    if (aggregate_ready) {
+        aggregator_deinit();
+        aggregate_ready = false;
+    }
+    if (history_ready) {
+        ts_store_deinit();
+        history_ready = false;
+    }
+    if (capture_ready) {
+        frame_capture_stop();
+        capture_ready = false;
+    }
+    if (archive_ready) {
+        sd_archive_stop();
+        archive_ready = false;
+    }
+    if (beacon_ready) {
+        ble_beacon_stop();
+        beacon_ready = false;
+    }
+    free(trends);
+    trends = NULL;
+    discovery_ready = false;
+    if (mqtt_ready) {
+        health_watch_set_publisher(NULL);
+        mqtt_forwarder_deinit();
+        mqtt_ready = false;
+    }
+    if (influx_ready) {
+        influx_writer_deinit();
+        influx_ready = false;
+    }
+    sink_ready = false;
+    outbox_ready = false;
+    checkpoint_pending = false;
+    if (spool_ready) {
+        flash_backlog_flush();
+        spool_ready = false;
+    }
     // TODO: Disconnect from WiFi
-    // TODO: Clean up ESP-NOW resources
-    // TODO: Free any allocated memory
+    if (pull_ready) {
+        ota_pull_stop();                        // Before the node image it may be restaging
+        pull_ready = false;
+    }
+    if (ota_ready) {
+        espnow_ota_gateway_stop();              // It sends through the link
+        ota_ready = false;
+    }
+    if (time_ready) {
+        espnow_time_gateway_stop();
+        time_ready = false;
+    }
+    if (slot_ready) {
+        espnow_slot_gateway_stop();
+        slot_ready = false;
+    }
+    if (channel_ready) {
+        espnow_channel_gateway_stop();
+        channel_ready = false;
+    }
+    if (pair_ready) {
+        espnow_pair_gateway_stop();
+        pair_ready = false;
+    }
+    espnow_link_deinit();
+    espnow_reliable_receiver_deinit();
+    free(record_slots);
+    record_slots = NULL;
+    if (bus_ready) {
+        sample_bus_deinit();
+        bus_ready = false;
+    }
+    syslog_sink_stop();
 
     ESP_LOGI(TAG, "Gateway cleanup completed");
     return ESP_OK;
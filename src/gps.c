@@ -0,0 +1,829 @@
+/**
+ * @file gps.c
+ * @brief GPS input on its own UART: event-driven reads and an incremental NMEA 0183 tokenizer
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "gps.h"
+#include "espnow_time.h"
+#include "mem_policy.h"
+#include "sample_bus.h"
+#include "static_mem.h"
+#include "version.h"
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register gps.c version
+REGISTER_VERSION(Gps, "1.0.0", "2026-10-15");
+
+static const char *TAG = "GPS";
+
+#define KNOTS_PER_MPS_X100000 194384            // 1.94384 kn per m/s
+#define FIELD_DECIMALS_MAX 5                    // Fraction digits kept; ddmm.mmmmm is the finest field taken
+#define DAY_MS 86400000LL
+
+/**
+ * @brief Where the tokenizer is in a sentence
+ */
+typedef enum {
+    SCAN_IDLE,                                  // Waiting for '$'
+    SCAN_FIELDS,                                // Address and data fields, up to '*'
+    SCAN_SUM_HIGH,                              // First checksum digit
+    SCAN_SUM_LOW,                               // Second checksum digit
+} scan_state_t;
+
+/**
+ * @brief Sentences taken
+ */
+typedef enum {
+    KIND_OTHER,
+    KIND_RMC,
+    KIND_GGA,
+    KIND_VTG,
+} kind_t;
+
+// pending_t.seen bits
+#define HAVE_TIME 0x0001
+#define HAVE_DATE 0x0002
+#define HAVE_LAT 0x0004
+#define HAVE_LON 0x0008
+#define HAVE_SOG 0x0010
+#define HAVE_COG 0x0020
+#define HAVE_QUALITY 0x0040
+#define HAVE_SATELLITES 0x0080
+#define HAVE_HDOP 0x0100
+#define HAVE_ALTITUDE 0x0200
+
+/**
+ * @brief Values of the sentence being read; merged into the fix only once its checksum matches
+ */
+typedef struct {
+    uint16_t seen;                              // HAVE_*
+    char status;                                // RMC status: A valid, V warning
+    char mode;                                  // RMC and VTG mode indicator (NMEA 2.3); 0 when absent
+    uint32_t time_ms;                           // UTC time of day
+    uint32_t date;                              // ddmmyy
+    int32_t lat;                                // 1e-7 deg
+    int32_t lon;
+    int32_t altitude;                           // 0.1 m
+    uint16_t sog;                               // 0.01 m/s
+    int16_t cog;                                // 0.1 deg
+    uint8_t quality;
+    uint8_t satellites;
+    uint16_t hdop;                              // 0.01
+} pending_t;
+
+/**
+ * @brief Tokenizer state; gps task only
+ *
+ * The field being read is kept as a mantissa with its count of fraction
+ * digits, built digit by digit, plus its first character for the letter
+ * fields.
+ */
+typedef struct {
+    scan_state_t state;
+    kind_t kind;
+    uint8_t sum;                                // XOR of the characters since '$'
+    uint8_t given;                              // Checksum digits read so far
+    uint8_t length;                             // Characters since '$'
+    uint8_t field;                              // 0: the address
+    char address[5];                            // Address: talker and sentence type
+    uint8_t address_len;
+    uint32_t mantissa;
+    uint8_t decimals;                           // Fraction digits in mantissa
+    uint8_t digits;
+    bool point;
+    bool negative;
+    bool bad;                                   // Not a number (a letter field, or malformed)
+    char letter;                                // First character, 0 for an empty field
+    pending_t p;
+} scanner_t;
+
+static scanner_t scan;                          // gps task only
+static bool dirty = false;                      // The fix changed since the last publish; gps task only
+static uint8_t chunk[GPS_READ_CHUNK];           // gps task only
+
+static gps_fix_t fix;                           // lock
+static gps_stats_t stats;                       // lock
+static uint64_t parse_us_total = 0;             // lock
+static int64_t started_us = 0;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static QueueHandle_t uart_queue = NULL;
+static volatile bool stopping = false;
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(gps_task_slot, GPS_TASK_STACK_SIZE);
+static SemaphoreHandle_t stopped_sem = NULL;
+
+// =============================
+// Function Prototypes
+// =============================
+static int hex_value(char c);
+static void field_reset(void);
+static void field_add(char c);
+static bool field_value(uint8_t decimals, uint32_t *value);
+static bool field_coordinate(int32_t *value);
+static bool field_time(uint32_t *time_ms);
+static void field_end(void);
+static void field_end_rmc(void);
+static void field_end_gga(void);
+static void field_end_vtg(void);
+static int64_t days_from_civil(int32_t y, uint32_t m, uint32_t d);
+static void commit(void);
+static void set_clock(int64_t utc_ms);
+static void scan_byte(char c);
+static void publish(void);
+static void read_input(void);
+static void gps_task(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static void field_reset(void) {
+    scan.mantissa = 0;
+    scan.decimals = 0;
+    scan.digits = 0;
+    scan.point = false;
+    scan.negative = false;
+    scan.bad = false;
+    scan.letter = 0;
+}
+
+/**
+ * @brief Take one character of a data field into the accumulator
+ */
+static void field_add(char c) {
+    if (scan.letter == 0) {
+        scan.letter = c;
+    }
+    if (c >= '0' && c <= '9') {
+        if (scan.point && scan.decimals >= FIELD_DECIMALS_MAX) {
+            return;                             // Finer than any field needs: truncate
+        }
+        if (scan.mantissa > (UINT32_MAX - 9) / 10) {
+            scan.bad = true;
+            return;
+        }
+        scan.mantissa = scan.mantissa * 10 + (uint32_t)(c - '0');
+        scan.digits++;
+        if (scan.point) {
+            scan.decimals++;
+        }
+    } else if (c == '.' && !scan.point) {
+        scan.point = true;
+    } else if (c == '-' && scan.digits == 0 && !scan.point && !scan.negative) {
+        scan.negative = true;
+    } else {
+        scan.bad = true;
+    }
+}
+
+/**
+ * @brief The field as value * 10^decimals, truncated; the sign is left to the caller
+ *
+ * @return bool false for an empty field, a letter field or one out of range
+ */
+static bool field_value(uint8_t decimals, uint32_t *value) {
+    if (scan.digits == 0 || scan.bad) {
+        return false;
+    }
+    uint64_t v = scan.mantissa;
+    for (uint8_t d = scan.decimals; d < decimals; d++) {
+        v *= 10;
+    }
+    for (uint8_t d = decimals; d < scan.decimals; d++) {
+        v /= 10;
+    }
+    if (v > UINT32_MAX) {
+        return false;
+    }
+    *value = (uint32_t)v;
+    return true;
+}
+
+/**
+ * @brief A (d)ddmm.mmmmm field as 1e-7 degrees
+ */
+static bool field_coordinate(int32_t *value) {
+    uint32_t v;
+    if (!field_value(5, &v)) {
+        return false;
+    }
+    uint32_t degrees = v / 10000000;
+    uint32_t minutes_e5 = v % 10000000;
+    if (degrees > 180 || minutes_e5 >= 6000000) {
+        return false;
+    }
+    // 1e-5 minutes to 1e-7 degrees: x100 / 60
+    *value = (int32_t)(degrees * 10000000 + ((uint64_t)minutes_e5 * 100 + 30) / 60);
+    return true;
+}
+
+/**
+ * @brief An hhmmss.sss field as milliseconds of the day
+ */
+static bool field_time(uint32_t *time_ms) {
+    uint32_t v;
+    if (!field_value(3, &v)) {
+        return false;
+    }
+    uint32_t hours = v / 10000000;
+    uint32_t minutes = v / 100000 % 100;
+    uint32_t seconds = v / 1000 % 100;
+    if (hours > 23 || minutes > 59 || seconds > 60) {
+        return false;
+    }
+    *time_ms = ((hours * 60 + minutes) * 60 + seconds) * 1000 + v % 1000;
+    return true;
+}
+
+/**
+ * @brief RMC: 1 time, 2 status, 3-4 latitude, 5-6 longitude, 7 knots, 8 course, 9 date, 12 mode
+ */
+static void field_end_rmc(void) {
+    pending_t *p = &scan.p;
+    uint32_t v;
+    switch (scan.field) {
+    case 1:
+        if (field_time(&p->time_ms)) {
+            p->seen |= HAVE_TIME;
+        }
+        break;
+    case 2:
+        p->status = scan.letter;
+        break;
+    case 3:
+        if (field_coordinate(&p->lat)) {
+            p->seen |= HAVE_LAT;
+        }
+        break;
+    case 4:
+        if (scan.letter == 'S') {
+            p->lat = -p->lat;
+        } else if (scan.letter != 'N') {
+            p->seen &= (uint16_t)~HAVE_LAT;
+        }
+        break;
+    case 5:
+        if (field_coordinate(&p->lon)) {
+            p->seen |= HAVE_LON;
+        }
+        break;
+    case 6:
+        if (scan.letter == 'W') {
+            p->lon = -p->lon;
+        } else if (scan.letter != 'E') {
+            p->seen &= (uint16_t)~HAVE_LON;
+        }
+        break;
+    case 7:
+        if (field_value(3, &v)) {
+            uint64_t sog = ((uint64_t)v * 10000 + KNOTS_PER_MPS_X100000 / 2) / KNOTS_PER_MPS_X100000;
+            p->sog = sog > UINT16_MAX ? UINT16_MAX : (uint16_t)sog;
+            p->seen |= HAVE_SOG;
+        }
+        break;
+    case 8:
+        if (field_value(1, &v)) {
+            p->cog = (int16_t)(v % 3600);
+            p->seen |= HAVE_COG;
+        }
+        break;
+    case 9:
+        if (field_value(0, &p->date) && scan.digits == 6) {
+            p->seen |= HAVE_DATE;
+        }
+        break;
+    case 12:
+        p->mode = scan.letter;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief GGA: 1 time, 2-3 latitude, 4-5 longitude, 6 quality, 7 satellites, 8 HDOP, 9 altitude
+ */
+static void field_end_gga(void) {
+    pending_t *p = &scan.p;
+    uint32_t v;
+    switch (scan.field) {
+    case 1:
+        if (field_time(&p->time_ms)) {
+            p->seen |= HAVE_TIME;
+        }
+        break;
+    case 2:
+        if (field_coordinate(&p->lat)) {
+            p->seen |= HAVE_LAT;
+        }
+        break;
+    case 3:
+        if (scan.letter == 'S') {
+            p->lat = -p->lat;
+        } else if (scan.letter != 'N') {
+            p->seen &= (uint16_t)~HAVE_LAT;
+        }
+        break;
+    case 4:
+        if (field_coordinate(&p->lon)) {
+            p->seen |= HAVE_LON;
+        }
+        break;
+    case 5:
+        if (scan.letter == 'W') {
+            p->lon = -p->lon;
+        } else if (scan.letter != 'E') {
+            p->seen &= (uint16_t)~HAVE_LON;
+        }
+        break;
+    case 6:
+        if (field_value(0, &v) && v <= UINT8_MAX) {
+            p->quality = (uint8_t)v;
+            p->seen |= HAVE_QUALITY;
+        }
+        break;
+    case 7:
+        if (field_value(0, &v) && v <= UINT8_MAX) {
+            p->satellites = (uint8_t)v;
+            p->seen |= HAVE_SATELLITES;
+        }
+        break;
+    case 8:
+        if (field_value(2, &v)) {
+            p->hdop = v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+            p->seen |= HAVE_HDOP;
+        }
+        break;
+    case 9:
+        if (field_value(1, &v) && v <= INT32_MAX) {
+            p->altitude = scan.negative ? -(int32_t)v : (int32_t)v;
+            p->seen |= HAVE_ALTITUDE;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief VTG: 1 true course, 5 knots, 9 mode
+ */
+static void field_end_vtg(void) {
+    pending_t *p = &scan.p;
+    uint32_t v;
+    switch (scan.field) {
+    case 1:
+        if (field_value(1, &v)) {
+            p->cog = (int16_t)(v % 3600);
+            p->seen |= HAVE_COG;
+        }
+        break;
+    case 5:
+        if (field_value(3, &v)) {
+            uint64_t sog = ((uint64_t)v * 10000 + KNOTS_PER_MPS_X100000 / 2) / KNOTS_PER_MPS_X100000;
+            p->sog = sog > UINT16_MAX ? UINT16_MAX : (uint16_t)sog;
+            p->seen |= HAVE_SOG;
+        }
+        break;
+    case 9:
+        p->mode = scan.letter;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief A field ended at ',' or '*': the address picks the sentence, data fields go to its handler
+ */
+static void field_end(void) {
+    if (scan.field == 0) {
+        // Talker (two letters) and type; proprietary ($P...) and odd addresses are not taken
+        const char *type = scan.address + 2;
+        if (scan.address_len != sizeof(scan.address)) {
+            scan.kind = KIND_OTHER;
+        } else if (memcmp(type, "RMC", 3) == 0) {
+            scan.kind = KIND_RMC;
+        } else if (memcmp(type, "GGA", 3) == 0) {
+            scan.kind = KIND_GGA;
+        } else if (memcmp(type, "VTG", 3) == 0) {
+            scan.kind = KIND_VTG;
+        } else {
+            scan.kind = KIND_OTHER;
+        }
+    } else if (scan.kind == KIND_RMC) {
+        field_end_rmc();
+    } else if (scan.kind == KIND_GGA) {
+        field_end_gga();
+    } else if (scan.kind == KIND_VTG) {
+        field_end_vtg();
+    }
+    scan.field++;
+    field_reset();
+}
+
+/**
+ * @brief Days from 1970-01-01 to a Gregorian date
+ */
+static int64_t days_from_civil(int32_t y, uint32_t m, uint32_t d) {
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int64_t)era * 146097 + doe - 719468;
+}
+
+/**
+ * @brief Merge a checksummed sentence into the fix
+ */
+static void commit(void) {
+    const pending_t *p = &scan.p;
+    bool fixed;
+    switch (scan.kind) {
+    case KIND_RMC:
+        fixed = p->status == 'A' && p->mode != 'N';
+        break;
+    case KIND_GGA:
+        fixed = (p->seen & HAVE_QUALITY) != 0 && p->quality > 0;
+        break;
+    case KIND_VTG:
+        fixed = p->mode != 'N';
+        break;
+    default:
+        return;
+    }
+
+    int64_t utc_ms = 0;
+    if (scan.kind == KIND_RMC && fixed && (p->seen & (HAVE_TIME | HAVE_DATE)) == (HAVE_TIME | HAVE_DATE)) {
+        uint32_t day = p->date / 10000;
+        uint32_t month = p->date / 100 % 100;
+        int32_t year = 2000 + (int32_t)(p->date % 100);
+        if (day >= 1 && day <= 31 && month >= 1 && month <= 12) {
+            utc_ms = days_from_civil(year, month, day) * DAY_MS + p->time_ms;
+        }
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    bool set = false;
+    portENTER_CRITICAL(&lock);
+    stats.sentences++;
+    if (!fixed) {
+        if (scan.kind != KIND_VTG) {
+            fix.valid = false;                  // The receiver says it has lost the fix
+        }
+        if (scan.kind == KIND_GGA) {
+            fix.quality = 0;
+        }
+        portEXIT_CRITICAL(&lock);
+        return;
+    }
+    if ((p->seen & (HAVE_LAT | HAVE_LON)) == (HAVE_LAT | HAVE_LON)) {
+        fix.lat = p->lat;
+        fix.lon = p->lon;
+        fix.valid = true;
+    }
+    if (p->seen & HAVE_SOG) {
+        fix.sog = p->sog;
+    }
+    if (scan.kind != KIND_GGA) {
+        fix.cog = (p->seen & HAVE_COG) ? p->cog : -1;
+    }
+    if (p->seen & HAVE_QUALITY) {
+        fix.quality = p->quality;
+    }
+    if (p->seen & HAVE_SATELLITES) {
+        fix.satellites = p->satellites;
+    }
+    if (p->seen & HAVE_HDOP) {
+        fix.hdop = p->hdop;
+    }
+    if (p->seen & HAVE_ALTITUDE) {
+        fix.altitude = p->altitude;
+    }
+    if (utc_ms != 0) {
+        fix.utc_ms = utc_ms;
+        set = stats.clock_sets == 0;
+    } else if (scan.kind == KIND_GGA && (p->seen & HAVE_TIME) && fix.utc_ms != 0) {
+        // GGA has no date: keep the last RMC's, a day on if the time of day wrapped past midnight
+        int64_t midnight = fix.utc_ms - fix.utc_ms % DAY_MS;
+        int64_t t = midnight + p->time_ms;
+        fix.utc_ms = t < fix.utc_ms - DAY_MS / 2 ? t + DAY_MS : t;
+    }
+    fix.time_us = now_us;
+    portEXIT_CRITICAL(&lock);
+    dirty = true;
+
+    if (GPS_SET_CLOCK != 0 && set) {
+        set_clock(utc_ms);
+    }
+}
+
+/**
+ * @brief Set the system clock from the GPS while nothing else has; gps task
+ */
+static void set_clock(int64_t utc_ms) {
+    if (time(NULL) >= ESPNOW_TIME_VALID_AFTER) {
+        return;                                 // SNTP or an earlier sync was first
+    }
+    struct timeval tv = {
+        .tv_sec = (time_t)(utc_ms / 1000),
+        .tv_usec = (suseconds_t)(utc_ms % 1000 * 1000),
+    };
+    settimeofday(&tv, NULL);
+    portENTER_CRITICAL(&lock);
+    stats.clock_sets++;
+    portEXIT_CRITICAL(&lock);
+    ESP_LOGI(TAG, "Clock set from GPS time");
+}
+
+/**
+ * @brief Advance the tokenizer by one input byte
+ */
+static void scan_byte(char c) {
+    if (c == '$') {
+        if (scan.state != SCAN_IDLE) {
+            portENTER_CRITICAL(&lock);
+            stats.malformed++;                  // A sentence cut short by the next one
+            portEXIT_CRITICAL(&lock);
+        }
+        memset(&scan.p, 0, sizeof(scan.p));
+        scan.state = SCAN_FIELDS;
+        scan.kind = KIND_OTHER;
+        scan.sum = 0;
+        scan.given = 0;
+        scan.length = 1;
+        scan.field = 0;
+        scan.address_len = 0;
+        field_reset();
+        return;
+    }
+    if (scan.state == SCAN_IDLE) {
+        return;
+    }
+
+    if (++scan.length > GPS_SENTENCE_MAX - 2 || c == '\r' || c == '\n') {
+        // Too long, or the line ended without a checksum
+        scan.state = SCAN_IDLE;
+        portENTER_CRITICAL(&lock);
+        stats.malformed++;
+        portEXIT_CRITICAL(&lock);
+        return;
+    }
+
+    switch (scan.state) {
+    case SCAN_FIELDS:
+        if (c == '*') {
+            field_end();
+            scan.state = SCAN_SUM_HIGH;
+            return;
+        }
+        scan.sum ^= (uint8_t)c;
+        if (c == ',') {
+            field_end();
+        } else if (scan.field == 0) {
+            if (scan.address_len < sizeof(scan.address)) {
+                scan.address[scan.address_len] = c;
+            }
+            scan.address_len++;
+        } else if (scan.kind != KIND_OTHER) {
+            field_add(c);
+        }
+        return;
+    case SCAN_SUM_HIGH:
+    case SCAN_SUM_LOW: {
+        int digit = hex_value(c);
+        if (digit < 0) {
+            scan.state = SCAN_IDLE;
+            portENTER_CRITICAL(&lock);
+            stats.malformed++;
+            portEXIT_CRITICAL(&lock);
+            return;
+        }
+        scan.given = (uint8_t)(scan.given << 4 | digit);
+        if (scan.state == SCAN_SUM_HIGH) {
+            scan.state = SCAN_SUM_LOW;
+            return;
+        }
+        scan.state = SCAN_IDLE;
+        if (scan.given != scan.sum) {
+            portENTER_CRITICAL(&lock);
+            stats.checksum_errors++;
+            portEXIT_CRITICAL(&lock);
+        } else if (scan.kind == KIND_OTHER) {
+            portENTER_CRITICAL(&lock);
+            stats.skipped++;
+            portEXIT_CRITICAL(&lock);
+        } else {
+            commit();
+        }
+        return;
+    }
+    default:
+        scan.state = SCAN_IDLE;
+        return;
+    }
+}
+
+/**
+ * @brief Put the fix on the sample bus; without the bus, gps_get_fix() is the only way to it
+ */
+static void publish(void) {
+    dirty = false;
+    sample_block_t *block = sample_bus_alloc();
+    if (block == NULL) {
+        return;
+    }
+    block->topic = SAMPLE_TOPIC_POSITION;
+    block->node_id = 0;
+    portENTER_CRITICAL(&lock);
+    block->fix = fix;
+    portEXIT_CRITICAL(&lock);
+    sample_bus_publish(block);
+    portENTER_CRITICAL(&lock);
+    stats.published++;
+    portEXIT_CRITICAL(&lock);
+}
+
+/**
+ * @brief Drain the ring buffer through the tokenizer
+ */
+static void read_input(void) {
+    int n;
+    while ((n = uart_read_bytes(GPS_UART_NUM, chunk, sizeof(chunk), 0)) > 0) {
+        int64_t start = esp_timer_get_time();
+        for (int i = 0; i < n; i++) {
+            scan_byte((char)chunk[i]);
+        }
+        uint32_t took = (uint32_t)(esp_timer_get_time() - start);
+        portENTER_CRITICAL(&lock);
+        stats.bytes += (uint32_t)n;
+        parse_us_total += took;
+        portEXIT_CRITICAL(&lock);
+    }
+    if (dirty) {
+        publish();
+    }
+}
+
+/**
+ * @brief Sleep on the UART driver's events; read on data, count and flush on lost input
+ */
+static void gps_task(void *arg) {
+    (void)arg;
+    uart_event_t event;
+    while (!stopping) {
+        if (xQueueReceive(uart_queue, &event, pdMS_TO_TICKS(GPS_WAIT_MS)) != pdTRUE) {
+            continue;
+        }
+        switch (event.type) {
+        case UART_DATA:
+            read_input();
+            break;
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // Bytes are missing: the sentence in progress cannot check, so start afresh
+            uart_flush_input(GPS_UART_NUM);
+            xQueueReset(uart_queue);
+            scan.state = SCAN_IDLE;
+            portENTER_CRITICAL(&lock);
+            stats.overruns++;
+            portEXIT_CRITICAL(&lock);
+            break;
+        default:
+            break;                              // Framing and parity errors surface as checksum errors
+        }
+    }
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t gps_start(void) {
+    if (task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (mem_policy_pin_taken(GPS_UART_RX_GPIO)) {
+        ESP_LOGE(TAG, "GPIO%d is wired to PSRAM on this board", GPS_UART_RX_GPIO);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    uart_config_t cfg = {
+        .baud_rate = GPS_UART_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    esp_err_t err = uart_driver_install(GPS_UART_NUM, GPS_UART_RX_BUFFER, 0, GPS_UART_EVENT_DEPTH, &uart_queue, 0);
+    if (err == ESP_OK) {
+        err = uart_param_config(GPS_UART_NUM, &cfg);
+    }
+    if (err == ESP_OK) {
+        err = uart_set_pin(GPS_UART_NUM, UART_PIN_NO_CHANGE, GPS_UART_RX_GPIO, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    }
+    if (err != ESP_OK) {
+        uart_driver_delete(GPS_UART_NUM);
+        uart_queue = NULL;
+        return err;
+    }
+
+    memset(&scan, 0, sizeof(scan));
+    dirty = false;
+    portENTER_CRITICAL(&lock);
+    memset(&fix, 0, sizeof(fix));
+    fix.cog = -1;
+    memset(&stats, 0, sizeof(stats));
+    stats.running = true;
+    parse_us_total = 0;
+    portEXIT_CRITICAL(&lock);
+    started_us = esp_timer_get_time();
+
+    if (stopped_sem == NULL) {
+        stopped_sem = xSemaphoreCreateBinary();
+    }
+    stopping = false;
+    if (stopped_sem == NULL ||
+        static_task_create(gps_task_slot, gps_task, GPS_TASK_NAME, GPS_TASK_STACK_SIZE, NULL, GPS_TASK_PRIORITY,
+                           &task_handle, TASK_CORE_APP) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the gps task");
+        task_handle = NULL;
+        uart_driver_delete(GPS_UART_NUM);
+        uart_queue = NULL;
+        portENTER_CRITICAL(&lock);
+        stats.running = false;
+        portEXIT_CRITICAL(&lock);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "GPS in: UART %d RX GPIO %d at %d baud", GPS_UART_NUM, GPS_UART_RX_GPIO, GPS_UART_BAUD);
+    return ESP_OK;
+}
+
+bool gps_get_fix(gps_fix_t *out) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&lock);
+    *out = fix;
+    portEXIT_CRITICAL(&lock);
+    out->valid = out->valid && now - out->time_us < (int64_t)GPS_FIX_STALE_MS * 1000;
+    return out->valid;
+}
+
+void gps_get_stats(gps_stats_t *out) {
+    int64_t elapsed = esp_timer_get_time() - started_us;
+    portENTER_CRITICAL(&lock);
+    *out = stats;
+    uint64_t busy = parse_us_total;
+    portEXIT_CRITICAL(&lock);
+    out->load_ppm = elapsed > 0 ? (uint32_t)(busy * 1000000 / (uint64_t)elapsed) : 0;
+}
+
+void gps_stop(void) {
+    if (task_handle == NULL) {
+        return;
+    }
+    stopping = true;
+    if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(GPS_STOP_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "GPS task did not stop within %d ms", GPS_STOP_TIMEOUT_MS);
+        return;                                 // Still reading; leave the driver to it
+    }
+    task_handle = NULL;
+    uart_driver_delete(GPS_UART_NUM);
+    uart_queue = NULL;
+    portENTER_CRITICAL(&lock);
+    stats.running = false;
+    fix.valid = false;
+    portEXIT_CRITICAL(&lock);
+}
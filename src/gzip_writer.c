@@ -0,0 +1,324 @@
+/**
+ * @file gzip_writer.c
+ * @brief Small gzip (RFC 1952) compressor: greedy LZ77 and the fixed Huffman codes
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "gzip_writer.h"
+#include "version.h"
+#include "esp_rom_crc.h"
+#include <stdbool.h>
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register gzip_writer.c version
+REGISTER_VERSION(GzipWriter, "1.0.0", "2026-10-15");
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define WINDOW 32768
+#define END_OF_BLOCK 256
+
+_Static_assert(GZIP_STREAM_WINDOW >= MAX_MATCH, "a pass must leave a whole window of history");
+_Static_assert(2 * GZIP_STREAM_WINDOW <= WINDOW && 2 * GZIP_STREAM_WINDOW < UINT16_MAX,
+               "stream positions are 16-bit and every distance must be codable");
+
+/**
+ * @brief Output bit stream, least significant bit first
+ */
+typedef struct {
+    uint8_t *out;
+    size_t cap;
+    size_t len;
+    uint32_t bits;
+    uint8_t count;                              // Bits held in bits
+    bool overflow;
+    gzip_stream_t *stream;                      // Full output goes to its sink rather than overflowing
+} bit_writer_t;
+
+// Length codes 257..285 and distance codes 0..29: base value and extra bits
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static const uint8_t gzip_header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+
+// =============================
+// Function Prototypes
+// =============================
+static void put_bits(bit_writer_t *w, uint32_t value, uint8_t count);
+static void put_code(bit_writer_t *w, uint32_t code, uint8_t count);
+static void put_literal(bit_writer_t *w, uint32_t symbol);
+static void put_match(bit_writer_t *w, size_t length, size_t distance);
+static void put_u32(uint8_t *p, uint32_t v);
+static uint32_t hash3(const uint8_t *p, unsigned hash_bits);
+static size_t encode(bit_writer_t *w, uint16_t *head, unsigned hash_bits, const uint8_t *in, size_t pos,
+                     size_t stop, size_t len);
+static bit_writer_t stream_bits(gzip_stream_t *gz);
+static void stream_save(gzip_stream_t *gz, const bit_writer_t *w);
+static void stream_send(gzip_stream_t *gz, const uint8_t *data, size_t len);
+static void stream_encode(gzip_stream_t *gz, size_t stop);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void put_bits(bit_writer_t *w, uint32_t value, uint8_t count) {
+    w->bits |= value << w->count;
+    w->count += count;
+    while (w->count >= 8) {
+        if (w->len == w->cap && w->stream != NULL) {
+            stream_send(w->stream, w->out, w->len);
+            w->len = 0;
+        }
+        if (w->len < w->cap) {
+            w->out[w->len++] = (uint8_t)w->bits;
+        } else {
+            w->overflow = true;
+        }
+        w->bits >>= 8;
+        w->count -= 8;
+    }
+}
+
+/**
+ * @brief A Huffman code, which DEFLATE sends most significant bit first
+ */
+static void put_code(bit_writer_t *w, uint32_t code, uint8_t count) {
+    uint32_t reversed = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    put_bits(w, reversed, count);
+}
+
+/**
+ * @brief A literal/length symbol in the fixed code (RFC 1951 3.2.6)
+ */
+static void put_literal(bit_writer_t *w, uint32_t symbol) {
+    if (symbol < 144) {
+        put_code(w, 0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        put_code(w, 0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        put_code(w, symbol - 256, 7);
+    } else {
+        put_code(w, 0xc0 + symbol - 280, 8);
+    }
+}
+
+static void put_match(bit_writer_t *w, size_t length, size_t distance) {
+    uint32_t code = 28;
+    while (length_base[code] > length) {
+        code--;
+    }
+    put_literal(w, 257 + code);
+    put_bits(w, (uint32_t)(length - length_base[code]), length_extra[code]);
+
+    code = 29;
+    while (dist_base[code] > distance) {
+        code--;
+    }
+    put_code(w, code, 5);
+    put_bits(w, (uint32_t)(distance - dist_base[code]), dist_extra[code]);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t hash3(const uint8_t *p, unsigned hash_bits) {
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - hash_bits);
+}
+
+/**
+ * @brief Greedy LZ77 over in[pos, stop) as fixed-code symbols; matches may run on to len
+ *
+ * @return size_t Where encoding stopped: stop or a little past it, or earlier on overflow
+ */
+static size_t encode(bit_writer_t *w, uint16_t *head, unsigned hash_bits, const uint8_t *in, size_t pos,
+                     size_t stop, size_t len) {
+    while (pos < stop && !w->overflow) {
+        size_t best = 0;
+        size_t distance = 0;
+        if (pos + MIN_MATCH <= len) {
+            uint32_t h = hash3(in + pos, hash_bits);
+            size_t candidate = head[h];
+            head[h] = (uint16_t)(pos + 1);
+            if (candidate != 0 && pos - (candidate - 1) <= WINDOW) {
+                const uint8_t *a = in + candidate - 1;
+                const uint8_t *b = in + pos;
+                size_t limit = len - pos < MAX_MATCH ? len - pos : MAX_MATCH;
+                while (best < limit && a[best] == b[best]) {
+                    best++;
+                }
+                distance = pos - (candidate - 1);
+            }
+        }
+
+        if (best >= MIN_MATCH) {
+            put_match(w, best, distance);
+            // Index the bytes the match covers, so later text can refer into it
+            for (size_t i = 1; i < best && pos + i + MIN_MATCH <= len; i++) {
+                head[hash3(in + pos + i, hash_bits)] = (uint16_t)(pos + i + 1);
+            }
+            pos += best;
+        } else {
+            put_literal(w, in[pos]);
+            pos++;
+        }
+    }
+    return pos;
+}
+
+esp_err_t gzip_compress(gzip_work_t *work, const uint8_t *in, size_t len, uint8_t *out, size_t cap,
+                        size_t *out_len) {
+    if (len > GZIP_INPUT_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (cap < GZIP_OVERHEAD + 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(work->head, 0, sizeof(work->head));
+    memcpy(out, gzip_header, sizeof(gzip_header));
+
+    // One final block in the fixed code; the trailer's room is kept back
+    bit_writer_t w = { .out = out, .cap = cap - 8, .len = sizeof(gzip_header) };
+    put_bits(&w, 1, 1);
+    put_bits(&w, 1, 2);
+
+    encode(&w, work->head, GZIP_HASH_BITS, in, 0, len, len);
+    put_literal(&w, END_OF_BLOCK);
+    put_bits(&w, 0, 7);                         // Pad to a byte boundary
+    if (w.overflow) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    put_u32(out + w.len, esp_rom_crc32_le(0, in, len));
+    put_u32(out + w.len + 4, (uint32_t)len);
+    *out_len = w.len + 8;
+    return ESP_OK;
+}
+
+static bit_writer_t stream_bits(gzip_stream_t *gz) {
+    return (bit_writer_t){ .out = gz->out, .cap = sizeof(gz->out), .len = gz->out_len, .bits = gz->bits,
+                           .count = gz->count, .stream = gz };
+}
+
+static void stream_save(gzip_stream_t *gz, const bit_writer_t *w) {
+    gz->out_len = w->len;
+    gz->bits = w->bits;
+    gz->count = w->count;
+}
+
+static void stream_send(gzip_stream_t *gz, const uint8_t *data, size_t len) {
+    if (gz->err == ESP_OK && len > 0) {
+        gz->err = gz->sink(gz->ctx, (const char *)data, len);
+        gz->sent += (uint32_t)len;
+    }
+}
+
+/**
+ * @brief Encode the window's input up to stop
+ */
+static void stream_encode(gzip_stream_t *gz, size_t stop) {
+    bit_writer_t w = stream_bits(gz);
+    gz->pos = encode(&w, gz->head, GZIP_STREAM_HASH_BITS, gz->in, gz->pos, stop, gz->fill);
+    stream_save(gz, &w);
+}
+
+void gzip_stream_init(gzip_stream_t *gz, gzip_sink_fn_t sink, void *ctx) {
+    memset(gz->head, 0, sizeof(gz->head));
+    gz->fill = 0;
+    gz->pos = 0;
+    gz->out_len = 0;
+    gz->bits = 0;
+    gz->count = 0;
+    gz->crc = 0;
+    gz->total = 0;
+    gz->sent = 0;
+    gz->sink = sink;
+    gz->ctx = ctx;
+    gz->err = sink != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+
+    memcpy(gz->out, gzip_header, sizeof(gzip_header));
+    gz->out_len = sizeof(gzip_header);
+    bit_writer_t w = stream_bits(gz);
+    put_bits(&w, 1, 1);                         // The one and final block, in the fixed code
+    put_bits(&w, 1, 2);
+    stream_save(gz, &w);
+}
+
+esp_err_t gzip_stream_write(gzip_stream_t *gz, const void *data, size_t len) {
+    const uint8_t *p = data;
+    if (gz->err != ESP_OK) {
+        return gz->err;
+    }
+    gz->crc = esp_rom_crc32_le(gz->crc, p, len);
+    gz->total += (uint32_t)len;
+    while (len > 0 && gz->err == ESP_OK) {
+        size_t room = sizeof(gz->in) - gz->fill;
+        size_t n = len < room ? len : room;
+        memcpy(gz->in + gz->fill, p, n);
+        gz->fill += n;
+        p += n;
+        len -= n;
+        if (gz->fill < sizeof(gz->in)) {
+            break;
+        }
+
+        // Keep a longest match of lookahead, then drop the older half of the window
+        stream_encode(gz, gz->fill - MAX_MATCH);
+        memmove(gz->in, gz->in + GZIP_STREAM_WINDOW, gz->fill - GZIP_STREAM_WINDOW);
+        gz->fill -= GZIP_STREAM_WINDOW;
+        gz->pos -= GZIP_STREAM_WINDOW;
+        for (size_t i = 0; i < sizeof(gz->head) / sizeof(gz->head[0]); i++) {
+            gz->head[i] = gz->head[i] > GZIP_STREAM_WINDOW ? (uint16_t)(gz->head[i] - GZIP_STREAM_WINDOW) : 0;
+        }
+    }
+    return gz->err;
+}
+
+esp_err_t gzip_stream_finish(gzip_stream_t *gz) {
+    stream_encode(gz, gz->fill);
+    bit_writer_t w = stream_bits(gz);
+    put_literal(&w, END_OF_BLOCK);
+    put_bits(&w, 0, 7);                         // Pad to a byte boundary
+    w.bits = 0;
+    w.count = 0;
+    uint8_t trailer[8];
+    put_u32(trailer, gz->crc);
+    put_u32(trailer + 4, gz->total);
+    for (size_t i = 0; i < sizeof(trailer); i++) {
+        put_bits(&w, trailer[i], 8);
+    }
+    stream_send(gz, w.out, w.len);
+    w.len = 0;
+    stream_save(gz, &w);
+    if (gz->err == ESP_OK) {
+        gz->err = gz->sink(gz->ctx, NULL, 0);
+    }
+    return gz->err;
+}
@@ -0,0 +1,276 @@
+/**
+ * @file ha_discovery.c
+ * @brief Home Assistant MQTT discovery: one retained config per node sensor, published when it first appears
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "ha_discovery.h"
+#include "json_writer.h"
+#include "node_table.h"
+#include "nvs_utils.h"
+#include "sensor_hal.h"
+#include "version.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register ha_discovery.c version
+REGISTER_VERSION(HaDiscovery, "1.0.0", "2026-10-15");
+
+static const char *TAG = "HA_DISCOVERY";
+
+#define TOPIC_MAX (sizeof(HA_DISCOVERY_PREFIX) + sizeof("/sensor/wx_00000000/") + 16 + sizeof("/config"))
+#define TEMPLATE_MAX 128
+
+/**
+ * @brief A published quantity and its column in a JSON batch (mqtt_forwarder.h)
+ */
+static const struct {
+    sensor_quantity_t quantity;
+    const char *column;
+    bool nullable;                              // null when the reading was not valid
+} SENSORS[] = {
+    { SENSOR_TEMPERATURE, "temp", false },
+    { SENSOR_HUMIDITY, "hum", false },
+    { SENSOR_PRESSURE, "press", false },
+    { SENSOR_GAS_RESISTANCE, "gas", true },
+};
+
+#define SENSOR_COUNT (sizeof(SENSORS) / sizeof(SENSORS[0]))
+
+/**
+ * @brief Sensors announced for a node
+ */
+typedef struct {
+    uint32_t node_id;
+    uint8_t sent;                               // Bit per sensor_quantity_t, as node_table_entry_t.sensors
+} announced_t;
+
+/**
+ * @brief json_writer sink into the payload buffer
+ */
+typedef struct {
+    char *data;
+    size_t len;
+} payload_builder_t;
+
+static bool started = false;
+static char base_topic[MQTT_BASE_TOPIC_MAX_LEN];
+static uint8_t format = MQTT_FORMAT_FIELDS;
+static uint8_t published_mask = 0;              // Quantities in SENSORS
+static announced_t announced[HA_DISCOVERY_NODES];   // Forwarder task only
+static size_t announced_count = 0;
+static uint32_t seen_generation = 0;            // node_table_generation() at the last complete poll
+static bool waiting = false;                    // Configs left for the next poll
+static char payload[HA_DISCOVERY_PAYLOAD_MAX];  // Forwarder task only; esp-mqtt copies it
+static ha_discovery_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t payload_flush(void *ctx, const char *data, size_t len);
+static announced_t *announced_for(uint32_t node_id);
+static esp_err_t send_config(uint32_t node_id, size_t sensor);
+
+// =============================
+// Function Definitions
+// =============================
+
+static esp_err_t payload_flush(void *ctx, const char *data, size_t len) {
+    payload_builder_t *pb = (payload_builder_t *)ctx;
+    if (data == NULL) {
+        return ESP_OK;  // End of document
+    }
+    if (pb->len + len > sizeof(payload)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(pb->data + pb->len, data, len);
+    pb->len += len;
+    return ESP_OK;
+}
+
+/**
+ * @brief A node's entry, added on first use
+ *
+ * @return Entry, or NULL when the table is full
+ */
+static announced_t *announced_for(uint32_t node_id) {
+    for (size_t i = 0; i < announced_count; i++) {
+        if (announced[i].node_id == node_id) {
+            return &announced[i];
+        }
+    }
+    if (announced_count >= HA_DISCOVERY_NODES) {
+        return NULL;
+    }
+    announced_t *a = &announced[announced_count++];
+    a->node_id = node_id;
+    a->sent = 0;
+    return a;
+}
+
+/**
+ * @brief One sensor's retained config, in Home Assistant's abbreviated keys
+ */
+static esp_err_t send_config(uint32_t node_id, size_t sensor) {
+    const sensor_quantity_info_t *info = sensor_quantity_info(SENSORS[sensor].quantity);
+    char node[12];
+    char text[MQTT_BASE_TOPIC_MAX_LEN + 32];
+    char topic[TOPIC_MAX];
+    snprintf(node, sizeof(node), "wx_%08lx", (unsigned long)node_id);
+    snprintf(topic, sizeof(topic), HA_DISCOVERY_PREFIX "/sensor/%s/%s/config", node, info->key);
+
+    payload_builder_t pb = { .data = payload, .len = 0 };
+    json_writer_t w;
+    json_writer_init(&w, payload_flush, &pb);
+    json_obj_begin(&w);
+    json_kv_str(&w, "name", info->label);
+    snprintf(text, sizeof(text), "%s_%s", node, info->key);
+    json_kv_str(&w, "uniq_id", text);
+    json_kv_str(&w, "obj_id", text);
+    if (format == MQTT_FORMAT_FIELDS) {
+        // Already in the display unit
+        snprintf(text, sizeof(text), "%s/%08lx/%s", base_topic, (unsigned long)node_id, info->key);
+        json_kv_str(&w, "stat_t", text);
+    } else {
+        // The newest sample of the batch column, out of fixed point
+        snprintf(text, sizeof(text), "%s/%08lx/batch", base_topic, (unsigned long)node_id);
+        json_kv_str(&w, "stat_t", text);
+        char tpl[TEMPLATE_MAX];
+        if (SENSORS[sensor].nullable) {
+            // A batch of invalid readings keeps the last state
+            snprintf(tpl, sizeof(tpl), "{%% set v = value_json.%s | reject('none') | list %%}"
+                     "{{ (v | last) / %u if v else this.state }}", SENSORS[sensor].column, info->divisor);
+        } else {
+            snprintf(tpl, sizeof(tpl), "{{ (value_json.%s | last) / %u }}", SENSORS[sensor].column, info->divisor);
+        }
+        json_kv_str(&w, "val_tpl", tpl);
+    }
+    if (info->device_class != NULL) {
+        json_kv_str(&w, "dev_cla", info->device_class);
+    }
+    json_kv_str(&w, "unit_of_meas", info->unit);
+    json_kv_str(&w, "stat_cla", "measurement");
+    json_kv_uint(&w, "sug_dsp_prc", info->decimals);
+    json_key(&w, "dev");
+    json_obj_begin(&w);
+    json_key(&w, "ids");
+    json_arr_begin(&w);
+    json_str(&w, node);
+    json_arr_end(&w);
+    snprintf(text, sizeof(text), "Weather node %08lx", (unsigned long)node_id);
+    json_kv_str(&w, "name", text);
+    json_kv_str(&w, "mdl", "ESP-NOW sensor node");
+    json_obj_end(&w);
+    json_obj_end(&w);
+    esp_err_t err = json_writer_finish(&w);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Config for %s too large: %s", topic, esp_err_to_name(err));
+        return err;
+    }
+    return mqtt_forwarder_publish_retained(topic, payload, pb.len);
+}
+
+esp_err_t ha_discovery_start(void) {
+    device_config_t cfg;
+    esp_err_t err = nvs_config_get(&cfg);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (cfg.mqtt_format == MQTT_FORMAT_CBOR) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    strlcpy(base_topic, cfg.mqtt_base_topic, sizeof(base_topic));
+    size_t base_len = strlen(base_topic);
+    while (base_len > 0 && base_topic[base_len - 1] == '/') {
+        base_topic[--base_len] = '\0';
+    }
+    format = cfg.mqtt_format;
+    published_mask = 0;
+    for (size_t i = 0; i < SENSOR_COUNT; i++) {
+        published_mask |= 1 << SENSORS[i].quantity;
+    }
+    announced_count = 0;
+    seen_generation = node_table_generation() - 1;  // The first poll looks at the table
+    waiting = false;
+    memset(&stats, 0, sizeof(stats));
+    started = true;
+    ESP_LOGI(TAG, "Announcing node sensors under " HA_DISCOVERY_PREFIX "/sensor/, retained");
+    return ESP_OK;
+}
+
+void ha_discovery_poll(void) {
+    uint32_t generation = node_table_generation();
+    if (!started || (generation == seen_generation && !waiting) || !mqtt_forwarder_connected()) {
+        return;
+    }
+
+    bool left = false;
+    size_t count = node_table_count();
+    for (size_t n = 0; n < count && !left; n++) {
+        node_table_entry_t e;
+        if (!node_table_get(n, &e)) {
+            break;
+        }
+        uint8_t want = e.sensors & published_mask;
+        if (e.node_id == 0 || want == 0) {
+            continue;
+        }
+        announced_t *a = announced_for(e.node_id);
+        if (a == NULL) {
+            continue;                           // Beyond HA_DISCOVERY_NODES; never announced
+        }
+        bool new_node = a->sent == 0;
+        for (size_t i = 0; i < SENSOR_COUNT; i++) {
+            uint8_t bit = 1 << SENSORS[i].quantity;
+            if (!(want & bit) || (a->sent & bit)) {
+                continue;
+            }
+            // Bulk room only: discovery never takes the alarm lane's reserve
+            if (mqtt_forwarder_room() == 0 || send_config(e.node_id, i) != ESP_OK) {
+                left = true;
+                break;
+            }
+            a->sent |= bit;
+            portENTER_CRITICAL(&stats_lock);
+            stats.configs++;
+            portEXIT_CRITICAL(&stats_lock);
+        }
+        if (new_node && a->sent != 0) {
+            portENTER_CRITICAL(&stats_lock);
+            stats.nodes++;
+            portEXIT_CRITICAL(&stats_lock);
+            ESP_LOGI(TAG, "Node %08lx announced", (unsigned long)e.node_id);
+        }
+    }
+
+    waiting = left;
+    if (left) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.deferred++;
+        portEXIT_CRITICAL(&stats_lock);
+    } else {
+        seen_generation = generation;
+    }
+}
+
+uint32_t ha_discovery_poll_due_ms(void) {
+    return started && waiting ? HA_DISCOVERY_RETRY_MS : UINT32_MAX;
+}
+
+void ha_discovery_get_stats(ha_discovery_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
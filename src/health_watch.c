@@ -0,0 +1,285 @@
+/**
+ * @file health_watch.c
+ * @brief Threshold alarms on the firmware's own metrics: low heap, heat, a sagging supply, a shrinking stack
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "health_watch.h"
+#include "cpu_monitor.h"
+#include "event_log.h"
+#include "metrics_stream.h"
+#include "nvs_wear.h"
+#include "static_mem.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register health_watch.c version
+REGISTER_VERSION(HealthWatch, "1.0.0", "2026-10-15");
+
+static const char *TAG = "HEALTH_WATCH";
+
+/**
+ * @brief One threshold rule; see the table in health_watch.h
+ */
+typedef struct {
+    const char *name;
+    system_metric_t metric;
+    bool (*read)(int64_t *value);               // Read instead of the metric when set
+    bool above;                                 // Raised above limit rather than below it
+    int32_t scale;                              // A float metric is multiplied by this first
+    int32_t limit;
+    int32_t clear;                              // Back on the healthy side of this to clear
+    const char *unit;                           // Of the scaled value
+    const char *raise_text;                     // Event log formats; one %ld, the value
+    const char *clear_text;
+} health_rule_t;
+
+static bool read_stack_min(int64_t *value);
+
+static const health_rule_t RULES[] = {
+    { "heap_low", METRIC_FREE_HEAP, NULL, false, 1, 20 * 1024, 32 * 1024, "bytes",
+      "Free heap low: %ld bytes", "Free heap recovered: %ld bytes" },
+    { "heap_floor", METRIC_MIN_FREE_HEAP, NULL, false, 1, 12 * 1024, 12 * 1024, "bytes",
+      "Free heap fell to %ld bytes since boot", "Free heap floor cleared: %ld bytes" },
+    { "heap_block", METRIC_HEAP_LARGEST_BLOCK, NULL, false, 1, 8 * 1024, 12 * 1024, "bytes",
+      "Largest free block down to %ld bytes", "Largest free block recovered: %ld bytes" },
+    { "hot", METRIC_CPU_TEMPERATURE, NULL, true, 1, 85, 75, "degC",
+      "Chip temperature high: %ld degC", "Chip temperature back to %ld degC" },
+    { "vdd_sag", METRIC_VDD33_VOLTAGE, NULL, false, 1000, 3000, 3100, "mV",
+      "Supply sagging: %ld mV", "Supply recovered: %ld mV" },
+    { "stack_low", METRIC_COUNT, read_stack_min, false, 1, 512, 768, "bytes",
+      "A task is down to %ld bytes of free stack", "Least free stack back to %ld bytes" },
+    { "nvs_wear", METRIC_COUNT, nvs_wear_life_days, false, 1, NVS_WEAR_DEPLOYMENT_DAYS,
+      NVS_WEAR_DEPLOYMENT_DAYS + NVS_WEAR_DEPLOYMENT_DAYS / 10, "days",
+      "NVS write rate wears the partition out in %ld days", "NVS write rate back to %ld days of wear" },
+};
+
+#define RULE_COUNT (sizeof(RULES) / sizeof(RULES[0]))
+
+// Watcher task only, but for the counters
+static int64_t due_us[RULE_COUNT];
+static bool raised[RULE_COUNT];
+static bool dropped[RULE_COUNT];
+static cpu_task_stats_t task_stats[CPU_MONITOR_MAX_TASKS];
+static metric_sample_t samples[RULE_COUNT];     // The due rules' metrics, read as one batch
+static health_watch_publish_fn_t publisher = NULL;
+static TaskHandle_t task_handle = NULL;
+static health_watch_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+STATIC_TASK_SLOT(watch_task_slot, HEALTH_WATCH_TASK_STACK_SIZE);
+
+// =============================
+// Function Prototypes
+// =============================
+static uint32_t rule_period_ms(const health_rule_t *r);
+static bool read_rule(size_t i, const metric_sample_t *sample, int64_t *value);
+static void report(size_t i, bool up, int64_t value);
+static void check_rule(size_t i, const metric_sample_t *sample);
+static const metric_sample_t *find_sample(system_metric_t metric, size_t count);
+static void watch_task(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Least free stack of any task at the last cpu_monitor sample
+ */
+static bool read_stack_min(int64_t *value) {
+    size_t n = cpu_monitor_get_tasks(task_stats, CPU_MONITOR_MAX_TASKS);
+    if (n == 0) {
+        return false;
+    }
+    uint32_t least = UINT32_MAX;
+    for (size_t i = 0; i < n; i++) {
+        if (task_stats[i].stack_hwm < least) {
+            least = task_stats[i].stack_hwm;
+        }
+    }
+    *value = least;
+    return true;
+}
+
+static uint32_t rule_period_ms(const health_rule_t *r) {
+    if (r->read != NULL) {
+        return HEALTH_WATCH_PERIOD_MS;
+    }
+    uint32_t ttl = get_metric_ttl_ms(r->metric);
+    if (ttl == METRIC_TTL_NONE || ttl == METRIC_TTL_STATIC) {
+        return HEALTH_WATCH_PERIOD_MS;
+    }
+    return ttl < HEALTH_WATCH_MIN_PERIOD_MS ? HEALTH_WATCH_MIN_PERIOD_MS : ttl;
+}
+
+/**
+ * @brief Read a rule's value in its own unit; drops the rule when the metric can never be read
+ *
+ * @param sample The rule's metric from this round's batch; unused for rules with their own reader
+ */
+static bool read_rule(size_t i, const metric_sample_t *sample, int64_t *value) {
+    const health_rule_t *r = &RULES[i];
+    portENTER_CRITICAL(&stats_lock);
+    stats.reads++;
+    portEXIT_CRITICAL(&stats_lock);
+    if (r->read != NULL) {
+        return r->read(value);
+    }
+
+    if (sample == NULL) {
+        return false;
+    }
+    metric_error_t err = sample->error;
+    const metric_value_t *v = &sample->value;
+    if (err == METRIC_OK && v->type == METRIC_VALUE_INT) {
+        *value = v->i * r->scale;
+        return true;
+    }
+    if (err == METRIC_OK && v->type == METRIC_VALUE_FLOAT) {
+        *value = (int64_t)(v->f * (float)r->scale);
+        return true;
+    }
+    if (err == METRIC_OK || err == METRIC_ERROR_NOT_SUPPORTED || err == METRIC_ERROR_INVALID_ID) {
+        dropped[i] = true;
+        portENTER_CRITICAL(&stats_lock);
+        stats.rules--;
+        portEXIT_CRITICAL(&stats_lock);
+        ESP_LOGI(TAG, "Not watching %s: %s", r->name,
+                 err == METRIC_OK ? "not a number" : get_metric_error_name(err));
+    }
+    return false;
+}
+
+/**
+ * @brief Send a raise or clear to the event log, the live stream and the publisher
+ */
+static void report(size_t i, bool up, int64_t value) {
+    const health_rule_t *r = &RULES[i];
+    if (up) {
+        EVENT_LOGW(TAG, r->raise_text, (uint32_t)(int32_t)value);
+    } else {
+        EVENT_LOGI(TAG, r->clear_text, (uint32_t)(int32_t)value);
+    }
+
+    char json[HEALTH_WATCH_JSON_MAX];
+    int len = snprintf(json, sizeof(json),
+                       "{\"rule\":\"%s\",\"state\":\"%s\",\"value\":%ld,\"limit\":%ld,\"unit\":\"%s\"}", r->name,
+                       up ? "raised" : "cleared", (long)value, (long)(up ? r->limit : r->clear), r->unit);
+    if (len > 0 && len < (int)sizeof(json)) {
+        metrics_stream_push_event("health", json, (size_t)len);
+        health_watch_publish_fn_t publish = publisher;
+        if (publish != NULL) {
+            publish(json, (size_t)len);
+        }
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    if (up) {
+        stats.raised++;
+        stats.active++;
+    } else {
+        stats.cleared++;
+        stats.active--;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+static void check_rule(size_t i, const metric_sample_t *sample) {
+    const health_rule_t *r = &RULES[i];
+    int64_t value;
+    if (!read_rule(i, sample, &value)) {
+        return;
+    }
+    if (!raised[i] && (r->above ? value > r->limit : value < r->limit)) {
+        raised[i] = true;
+        report(i, true, value);
+    } else if (raised[i] && (r->above ? value < r->clear : value > r->clear)) {
+        raised[i] = false;
+        report(i, false, value);
+    }
+}
+
+static const metric_sample_t *find_sample(system_metric_t metric, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (samples[i].metric == metric) {
+            return &samples[i];
+        }
+    }
+    return NULL;
+}
+
+static void watch_task(void *arg) {
+    metric_batch_t batch;
+    for (;;) {
+        int64_t now = esp_timer_get_time();
+        int64_t next = now + (int64_t)HEALTH_WATCH_PERIOD_MS * 1000;
+
+        // Every metric a due rule watches, in one batch
+        metric_mask_t metrics = 0;
+        for (size_t i = 0; i < RULE_COUNT; i++) {
+            if (!dropped[i] && due_us[i] <= now && RULES[i].read == NULL) {
+                metrics |= METRIC_MASK(RULES[i].metric);
+            }
+        }
+        system_metrics_batch_init(&batch, metrics, false);
+        size_t count = system_metrics_collect(&batch, samples, RULE_COUNT);
+
+        for (size_t i = 0; i < RULE_COUNT; i++) {
+            if (dropped[i]) {
+                continue;
+            }
+            if (due_us[i] <= now) {
+                check_rule(i, RULES[i].read == NULL ? find_sample(RULES[i].metric, count) : NULL);
+                due_us[i] = now + (int64_t)rule_period_ms(&RULES[i]) * 1000;
+            }
+            if (due_us[i] < next) {
+                next = due_us[i];
+            }
+        }
+        int64_t wait_us = next - esp_timer_get_time();
+        vTaskDelay(wait_us > 0 ? pdMS_TO_TICKS(wait_us / 1000) + 1 : 1);
+    }
+}
+
+esp_err_t health_watch_start(void) {
+    if (task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(due_us, 0, sizeof(due_us));
+    memset(raised, 0, sizeof(raised));
+    memset(dropped, 0, sizeof(dropped));
+    memset(&stats, 0, sizeof(stats));
+    stats.rules = RULE_COUNT;
+    if (static_task_create(watch_task_slot, watch_task, HEALTH_WATCH_TASK_NAME, HEALTH_WATCH_TASK_STACK_SIZE, NULL,
+                           HEALTH_WATCH_TASK_PRIORITY, &task_handle, TASK_CORE_NET) != pdPASS) {
+        task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    stats.running = true;
+    ESP_LOGI(TAG, "Watching %u rules", (unsigned)RULE_COUNT);
+    return ESP_OK;
+}
+
+void health_watch_set_publisher(health_watch_publish_fn_t publish) {
+    publisher = publish;
+}
+
+void health_watch_get_stats(health_watch_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
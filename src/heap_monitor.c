@@ -0,0 +1,329 @@
+/**
+ * @file heap_monitor.c
+ * @brief Heap fragmentation per memory capability and allocation counts per task
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "heap_monitor.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register heap_monitor.c version
+REGISTER_VERSION(HeapMonitor, "1.0.0", "2026-10-14");
+
+static const char *TAG = "HEAP_MONITOR";
+
+// Capability classes reported, most constrained first
+static const struct {
+    const char *name;
+    uint32_t caps;
+} cap_classes[] = {
+    { "internal", MALLOC_CAP_INTERNAL },
+    { "dma", MALLOC_CAP_DMA },
+    { "8bit", MALLOC_CAP_8BIT },
+#if CONFIG_SPIRAM
+    { "spiram", MALLOC_CAP_SPIRAM },
+#endif
+};
+
+#define CAP_CLASS_COUNT (sizeof(cap_classes) / sizeof(cap_classes[0]))
+
+// Allocations outside any task (ISRs) are keyed by NULL and shown under this name
+#define NO_TASK_NAME "(isr)"
+
+// Taken from the allocation hooks, so it must stay usable from IRAM and ISRs
+static DRAM_ATTR portMUX_TYPE heap_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static heap_failure_stats_t failures;
+
+#if CONFIG_HEAP_USE_HOOKS
+// Per-task counters, filled by the hooks; a task keeps its slot for the whole run
+static DRAM_ATTR TaskHandle_t task_handles[HEAP_MONITOR_MAX_TASKS];
+static DRAM_ATTR heap_task_stats_t task_stats[HEAP_MONITOR_MAX_TASKS];
+static DRAM_ATTR size_t task_count;
+static DRAM_ATTR uint32_t untracked_allocs;     // Allocations after the table filled up
+static DRAM_ATTR volatile bool hooks_enabled;
+#endif
+
+// =============================
+// Function Prototypes
+// =============================
+static void alloc_failed_cb(size_t size, uint32_t caps, const char *function_name);
+static void copy_task_name(char *dst, TaskHandle_t task);
+static metric_error_t failures_provider(char *buf, size_t buf_len);
+#if CONFIG_HEAP_USE_HOOKS
+static heap_task_stats_t *task_entry(void);
+#endif
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Copy a task name without library calls, so it is safe in the hooks
+ */
+static IRAM_ATTR void copy_task_name(char *dst, TaskHandle_t task) {
+    const char *src = task != NULL ? pcTaskGetName(task) : NO_TASK_NAME;
+    size_t i = 0;
+    for (; i < configMAX_TASK_NAME_LEN - 1 && src[i] != '\0'; i++) {
+        dst[i] = src[i];
+    }
+    dst[i] = '\0';
+}
+
+#if CONFIG_HEAP_USE_HOOKS
+/**
+ * @brief Counters of the calling task, claiming a slot on first use; call with heap_lock held
+ */
+static IRAM_ATTR heap_task_stats_t *task_entry(void) {
+    TaskHandle_t self = xPortInIsrContext() ? NULL : xTaskGetCurrentTaskHandle();
+    for (size_t i = 0; i < task_count; i++) {
+        if (task_handles[i] == self) {
+            return &task_stats[i];
+        }
+    }
+    if (task_count >= HEAP_MONITOR_MAX_TASKS) {
+        return NULL;
+    }
+
+    heap_task_stats_t *entry = &task_stats[task_count];
+    task_handles[task_count++] = self;
+    copy_task_name(entry->name, self);
+    return entry;
+}
+
+// Called by the heap component after every successful allocation
+IRAM_ATTR void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) {
+    (void)ptr;
+    (void)caps;
+    if (!hooks_enabled) {
+        return;
+    }
+
+    portENTER_CRITICAL_SAFE(&heap_lock);
+    heap_task_stats_t *entry = task_entry();
+    if (entry != NULL) {
+        entry->allocs++;
+        entry->bytes_allocated += size;
+        if (size > entry->largest_alloc) {
+            entry->largest_alloc = size;
+        }
+    } else {
+        untracked_allocs++;
+    }
+    portEXIT_CRITICAL_SAFE(&heap_lock);
+}
+
+// Called by the heap component before every free
+IRAM_ATTR void esp_heap_trace_free_hook(void *ptr) {
+    if (!hooks_enabled || ptr == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL_SAFE(&heap_lock);
+    heap_task_stats_t *entry = task_entry();
+    if (entry != NULL) {
+        entry->frees++;
+    }
+    portEXIT_CRITICAL_SAFE(&heap_lock);
+}
+#endif
+
+/**
+ * @brief Record an allocation the heap could not satisfy
+ */
+static void alloc_failed_cb(size_t size, uint32_t caps, const char *function_name) {
+    (void)function_name;
+    TaskHandle_t self = xPortInIsrContext() ? NULL : xTaskGetCurrentTaskHandle();
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL_SAFE(&heap_lock);
+    failures.count++;
+    failures.last_size = size;
+    failures.last_caps = caps;
+    failures.last_time_us = now;
+    copy_task_name(failures.last_task, self);
+    portEXIT_CRITICAL_SAFE(&heap_lock);
+}
+
+esp_err_t heap_monitor_start(void) {
+    esp_err_t err = heap_caps_register_failed_alloc_callback(alloc_failed_cb);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register allocation failure callback: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    set_metric_provider(METRIC_HEAP_ALLOC_FAILURES, failures_provider);
+
+#if CONFIG_HEAP_USE_HOOKS
+    hooks_enabled = true;
+    ESP_LOGI(TAG, "Heap monitor started, tracking up to %d tasks", HEAP_MONITOR_MAX_TASKS);
+#else
+    ESP_LOGI(TAG, "Heap monitor started without per-task tracking (CONFIG_HEAP_USE_HOOKS off)");
+#endif
+    return ESP_OK;
+}
+
+bool heap_monitor_tracking_tasks(void) {
+#if CONFIG_HEAP_USE_HOOKS
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t heap_monitor_get_caps(heap_caps_stats_t *stats, size_t max) {
+    size_t n = CAP_CLASS_COUNT < max ? CAP_CLASS_COUNT : max;
+    for (size_t i = 0; i < n; i++) {
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, cap_classes[i].caps);
+
+        heap_caps_stats_t *s = &stats[i];
+        s->name = cap_classes[i].name;
+        s->caps = cap_classes[i].caps;
+        s->total_bytes = heap_caps_get_total_size(cap_classes[i].caps);
+        s->free_bytes = info.total_free_bytes;
+        s->largest_free_block = info.largest_free_block;
+        s->minimum_free_bytes = info.minimum_free_bytes;
+        s->allocated_blocks = info.allocated_blocks;
+        s->free_blocks = info.free_blocks;
+        s->fragmentation = info.total_free_bytes
+            ? 100.0f - 100.0f * info.largest_free_block / info.total_free_bytes
+            : 0.0f;
+    }
+    return n;
+}
+
+size_t heap_monitor_get_tasks(heap_task_stats_t *tasks, size_t max) {
+#if CONFIG_HEAP_USE_HOOKS
+    portENTER_CRITICAL(&heap_lock);
+    size_t n = task_count < max ? task_count : max;
+    memcpy(tasks, task_stats, n * sizeof(tasks[0]));
+    portEXIT_CRITICAL(&heap_lock);
+
+    // Insertion sort, most allocations first; n is small
+    for (size_t i = 1; i < n; i++) {
+        heap_task_stats_t t = tasks[i];
+        size_t j = i;
+        while (j > 0 && tasks[j - 1].allocs < t.allocs) {
+            tasks[j] = tasks[j - 1];
+            j--;
+        }
+        tasks[j] = t;
+    }
+    return n;
+#else
+    (void)tasks;
+    (void)max;
+    return 0;
+#endif
+}
+
+void heap_monitor_get_failures(heap_failure_stats_t *out) {
+    portENTER_CRITICAL(&heap_lock);
+    *out = failures;
+    portEXIT_CRITICAL(&heap_lock);
+}
+
+void heap_monitor_reset(void) {
+#if CONFIG_HEAP_USE_HOOKS
+    portENTER_CRITICAL(&heap_lock);
+    for (size_t i = 0; i < task_count; i++) {
+        task_stats[i].allocs = 0;
+        task_stats[i].frees = 0;
+        task_stats[i].bytes_allocated = 0;
+        task_stats[i].largest_alloc = 0;
+    }
+    untracked_allocs = 0;
+    portEXIT_CRITICAL(&heap_lock);
+#endif
+}
+
+void heap_monitor_write_json(json_writer_t *w) {
+    heap_caps_stats_t caps[HEAP_MONITOR_MAX_CAPS];
+    size_t cap_count = heap_monitor_get_caps(caps, HEAP_MONITOR_MAX_CAPS);
+    heap_failure_stats_t fail;
+    heap_monitor_get_failures(&fail);
+    // Static: the table is too large for the httpd stack and only one request runs at a time
+    static heap_task_stats_t tasks[HEAP_MONITOR_MAX_TASKS];
+    size_t count = heap_monitor_get_tasks(tasks, HEAP_MONITOR_MAX_TASKS);
+
+    json_obj_begin(w);
+    json_key(w, "caps");
+    json_arr_begin(w);
+    for (size_t i = 0; i < cap_count; i++) {
+        json_obj_begin(w);
+        json_kv_str(w, "name", caps[i].name);
+        json_kv_uint(w, "caps", caps[i].caps);
+        json_kv_uint(w, "totalBytes", caps[i].total_bytes);
+        json_kv_uint(w, "freeBytes", caps[i].free_bytes);
+        json_kv_uint(w, "largestFreeBlock", caps[i].largest_free_block);
+        json_kv_uint(w, "minimumFreeBytes", caps[i].minimum_free_bytes);
+        json_kv_uint(w, "allocatedBlocks", caps[i].allocated_blocks);
+        json_kv_uint(w, "freeBlocks", caps[i].free_blocks);
+        json_key(w, "fragmentation");
+        json_double(w, caps[i].fragmentation, 1);
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+
+    json_key(w, "failures");
+    json_obj_begin(w);
+    json_kv_uint(w, "count", fail.count);
+    if (fail.count > 0) {
+        json_kv_uint(w, "lastSize", fail.last_size);
+        json_kv_uint(w, "lastCaps", fail.last_caps);
+        json_kv_str(w, "lastTask", fail.last_task);
+        json_kv_int(w, "lastUptimeMs", fail.last_time_us / 1000);
+    }
+    json_obj_end(w);
+
+    json_kv_bool(w, "taskTracking", heap_monitor_tracking_tasks());
+    json_key(w, "tasks");
+    json_arr_begin(w);
+    for (size_t i = 0; i < count; i++) {
+        json_obj_begin(w);
+        json_kv_str(w, "name", tasks[i].name);
+        json_kv_uint(w, "allocs", tasks[i].allocs);
+        json_kv_uint(w, "frees", tasks[i].frees);
+        json_kv_uint(w, "bytesAllocated", tasks[i].bytes_allocated);
+        json_kv_uint(w, "largestAlloc", tasks[i].largest_alloc);
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+#if CONFIG_HEAP_USE_HOOKS
+    json_kv_uint(w, "untrackedAllocs", untracked_allocs);
+#endif
+    json_obj_end(w);
+}
+
+/**
+ * @brief METRIC_HEAP_ALLOC_FAILURES: count and the most recent failure
+ */
+static metric_error_t failures_provider(char *buf, size_t buf_len) {
+    heap_failure_stats_t fail;
+    heap_monitor_get_failures(&fail);
+    if (fail.count == 0) {
+        snprintf(buf, buf_len, "0 failed");
+        return METRIC_OK;
+    }
+    snprintf(buf, buf_len, "%lu failed, last %u bytes by %s",
+             (unsigned long)fail.count, (unsigned)fail.last_size, fail.last_task);
+    return METRIC_OK;
+}
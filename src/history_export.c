@@ -0,0 +1,611 @@
+/**
+ * @file history_export.c
+ * @brief Bulk export of stored records as CSV or NDJSON, streamed and resumable with HTTP Range
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "history_export.h"
+#include "http_arena.h"
+#include "http_gzip.h"
+#include "http_perf.h"
+#include "json_writer.h"
+#include "sd_archive.h"
+#include "ts_store.h"
+#include "version.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "esp_log.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register history_export.c version
+REGISTER_VERSION(HistoryExport, "1.0.0", "2026-10-15");
+static const char *TAG = "HIST_EXPORT";
+
+#define LINE_MAX_LEN 160
+#define FIELD_MAX 16
+#define RANGE_HDR_MAX 64
+
+// Field widths; every line of a format is the same length
+#define W_TIME 10
+#define W_SEQ 10
+#define W_TEMPERATURE 7                         // -327.68
+#define W_PRESSURE 6                            // Pa
+#define W_HUMIDITY 7                            // 100.000
+#define W_GAS 10
+
+// Which row fields hold a value
+#define ROW_SEQ (1 << 0)
+#define ROW_PRESSURE (1 << 1)
+#define ROW_HUMIDITY (1 << 2)
+#define ROW_GAS (1 << 3)
+
+static const char csv_header[] = "time,node,seq,temperature,pressure,humidity,gas\n";
+
+typedef enum {
+    FORMAT_CSV = 0,
+    FORMAT_NDJSON,
+    FORMAT_RAW,                                 // Archive file bytes as they are
+} export_format_t;
+
+typedef enum {
+    RANGE_NONE = 0,                             // No usable Range header: send everything
+    RANGE_OK,
+    RANGE_UNSATISFIABLE,
+} range_result_t;
+
+/**
+ * @brief One record, whichever store it came from
+ */
+typedef struct {
+    uint32_t time_s;
+    uint32_t node_id;
+    uint32_t seq;
+    uint32_t pressure;                          // Pa
+    uint32_t humidity;                          // 0.001 %RH
+    uint32_t gas;                               // Ohm
+    int16_t temperature;                        // 0.01 degC
+    uint8_t has;                                // ROW_*
+} export_row_t;
+
+/**
+ * @brief Where the records come from: the time-series store or one archive file
+ */
+typedef struct {
+    bool archive;
+    ts_store_cursor_t cursor;                   // Store
+    int fd;                                     // Archive
+    uint32_t pos;                               // Archive: offset of the next record
+    uint32_t end;                               // Archive: file size when the request came in
+} export_source_t;
+
+/**
+ * @brief Request working memory, from the request's arena
+ */
+typedef struct {
+    char buf[EXPORT_BUF_BYTES];
+    export_row_t rows[EXPORT_READ_RECORDS];
+    union {
+        ts_store_record_t stored[EXPORT_READ_RECORDS];
+        uint8_t raw[EXPORT_READ_RECORDS * SD_ARCHIVE_RECORD_LEN];
+    };
+    char line[LINE_MAX_LEN];
+} export_work_t;
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t parse_format(const char *query, bool allow_raw, export_format_t *format);
+static range_result_t parse_range(const char *value, uint64_t total, uint64_t *first, uint64_t *last);
+static void field_uint(char *out, int width, bool has, uint32_t value, bool json);
+static void field_fixed(char *out, int width, bool has, int32_t value, int decimals, bool json);
+static size_t format_line(export_format_t format, const export_row_t *row, char *line);
+static size_t source_read(export_source_t *src, export_work_t *work, export_row_t *rows, size_t max);
+static esp_err_t send_export(httpd_req_t *req, export_work_t *work, export_source_t *src, export_format_t format,
+                             const char *filename);
+static esp_err_t stream_rows(httpd_req_t *req, gzip_stream_t *gz, export_work_t *work, export_source_t *src,
+                             export_format_t format, uint64_t first, uint64_t last);
+static esp_err_t stream_raw(httpd_req_t *req, gzip_stream_t *gz, export_work_t *work, export_source_t *src,
+                            uint64_t first, uint64_t last);
+static esp_err_t history_export_handler(httpd_req_t *req);
+static esp_err_t archive_list(httpd_req_t *req);
+static esp_err_t archive_handler(httpd_req_t *req);
+
+// =============================
+// Function Definitions
+// =============================
+
+static esp_err_t parse_format(const char *query, bool allow_raw, export_format_t *format) {
+    char value[8];
+    *format = FORMAT_CSV;
+    if (query == NULL || httpd_query_key_value(query, "format", value, sizeof(value)) != ESP_OK) {
+        return ESP_OK;
+    }
+    if (strcmp(value, "csv") == 0) {
+        *format = FORMAT_CSV;
+    } else if (strcmp(value, "ndjson") == 0) {
+        *format = FORMAT_NDJSON;
+    } else if (allow_raw && strcmp(value, "raw") == 0) {
+        *format = FORMAT_RAW;
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief One "bytes=" range against a body of total bytes (RFC 9110 14.1.2)
+ *
+ * Several ranges, or anything malformed, are answered with the whole body.
+ */
+static range_result_t parse_range(const char *value, uint64_t total, uint64_t *first, uint64_t *last) {
+    if (strncmp(value, "bytes=", 6) != 0 || strchr(value, ',') != NULL) {
+        return RANGE_NONE;
+    }
+    const char *spec = value + 6;
+    char *end;
+    if (*spec == '-') {
+        uint64_t n = strtoull(spec + 1, &end, 10);
+        if (end == spec + 1 || *end != '\0') {
+            return RANGE_NONE;
+        }
+        if (n == 0 || total == 0) {
+            return RANGE_UNSATISFIABLE;
+        }
+        *first = n < total ? total - n : 0;
+        *last = total - 1;
+        return RANGE_OK;
+    }
+
+    uint64_t a = strtoull(spec, &end, 10);
+    if (end == spec || *end != '-') {
+        return RANGE_NONE;
+    }
+    const char *b_str = end + 1;
+    uint64_t b = UINT64_MAX;
+    if (*b_str != '\0') {
+        b = strtoull(b_str, &end, 10);
+        if (end == b_str || *end != '\0' || b < a) {
+            return RANGE_NONE;
+        }
+    }
+    if (a >= total) {
+        return RANGE_UNSATISFIABLE;
+    }
+    *first = a;
+    *last = b < total ? b : total - 1;
+    return RANGE_OK;
+}
+
+/**
+ * @brief An unsigned field, right-aligned in width; missing or too wide is null/blank
+ */
+static void field_uint(char *out, int width, bool has, uint32_t value, bool json) {
+    char text[FIELD_MAX];
+    int n = snprintf(text, sizeof(text), "%lu", (unsigned long)value);
+    if (!has || n > width) {
+        strcpy(text, json ? "null" : "");
+    }
+    snprintf(out, FIELD_MAX, "%*s", width, text);
+}
+
+/**
+ * @brief A fixed-point field (value / 10^decimals), right-aligned in width
+ */
+static void field_fixed(char *out, int width, bool has, int32_t value, int decimals, bool json) {
+    char text[FIELD_MAX];
+    uint32_t scale = 1;
+    for (int i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    uint32_t mag = value < 0 ? (uint32_t)-(int64_t)value : (uint32_t)value;
+    int n = snprintf(text, sizeof(text), "%s%lu.%0*lu", value < 0 ? "-" : "", (unsigned long)(mag / scale), decimals,
+                     (unsigned long)(mag % scale));
+    if (!has || n > width) {
+        strcpy(text, json ? "null" : "");
+    }
+    snprintf(out, FIELD_MAX, "%*s", width, text);
+}
+
+/**
+ * @brief Encode one row; every row of a format comes out the same length
+ */
+static size_t format_line(export_format_t format, const export_row_t *row, char *line) {
+    bool json = format == FORMAT_NDJSON;
+    char time_s[FIELD_MAX], seq[FIELD_MAX], temperature[FIELD_MAX], pressure[FIELD_MAX], humidity[FIELD_MAX],
+        gas[FIELD_MAX];
+    field_uint(time_s, W_TIME, true, row->time_s, json);
+    field_uint(seq, W_SEQ, (row->has & ROW_SEQ) != 0, row->seq, json);
+    field_fixed(temperature, W_TEMPERATURE, true, row->temperature, 2, json);
+    field_uint(pressure, W_PRESSURE, (row->has & ROW_PRESSURE) != 0, row->pressure, json);
+    field_fixed(humidity, W_HUMIDITY, (row->has & ROW_HUMIDITY) != 0, (int32_t)row->humidity, 3, json);
+    field_uint(gas, W_GAS, (row->has & ROW_GAS) != 0, row->gas, json);
+
+    int n;
+    if (json) {
+        n = snprintf(line, LINE_MAX_LEN, "{\"time\":%s,\"node\":\"%08lx\",\"seq\":%s,\"temperature\":%s,"
+                     "\"pressure\":%s,\"humidity\":%s,\"gas\":%s}\n", time_s, (unsigned long)row->node_id, seq,
+                     temperature, pressure, humidity, gas);
+    } else {
+        n = snprintf(line, LINE_MAX_LEN, "%s,%08lx,%s,%s,%s,%s,%s\n", time_s, (unsigned long)row->node_id, seq,
+                     temperature, pressure, humidity, gas);
+    }
+    return (size_t)n;
+}
+
+/**
+ * @brief Read the next rows, or skip them when rows is NULL
+ *
+ * @param max At most EXPORT_READ_RECORDS when reading; anything when skipping
+ * @return size_t Rows read or skipped; less than max only at the end
+ */
+static size_t source_read(export_source_t *src, export_work_t *work, export_row_t *rows, size_t max) {
+    if (!src->archive) {
+        size_t n = ts_store_export_read(&src->cursor, rows != NULL ? work->stored : NULL, max);
+        for (size_t i = 0; rows != NULL && i < n; i++) {
+            const ts_store_record_t *r = &work->stored[i];
+            rows[i] = (export_row_t){
+                .time_s = r->time_s,
+                .node_id = r->node_id,
+                .temperature = r->temperature,
+                .pressure = (uint32_t)r->pressure + TS_STORE_PRESSURE_BASE,
+                .humidity = (uint32_t)r->humidity * 10,
+                .has = ((r->flags & TS_STORE_HAS_PRESSURE) != 0 ? ROW_PRESSURE : 0) |
+                       ((r->flags & TS_STORE_HAS_HUMIDITY) != 0 ? ROW_HUMIDITY : 0),
+            };
+        }
+        return n;
+    }
+
+    size_t produced = 0;
+    while (produced < max) {
+        size_t want = (src->end - src->pos) / SD_ARCHIVE_RECORD_LEN;
+        if (want > EXPORT_READ_RECORDS) {
+            want = EXPORT_READ_RECORDS;
+        }
+        if (want == 0 || lseek(src->fd, (off_t)src->pos, SEEK_SET) < 0) {
+            break;
+        }
+        ssize_t got = read(src->fd, work->raw, want * SD_ARCHIVE_RECORD_LEN);
+        size_t records = got > 0 ? (size_t)got / SD_ARCHIVE_RECORD_LEN : 0;
+        if (records == 0) {
+            break;
+        }
+        size_t used = 0;
+        while (used < records && produced < max) {
+            uint32_t node_id;
+            telemetry_record_t rec;
+            if (sd_archive_decode(work->raw + used * SD_ARCHIVE_RECORD_LEN, &node_id, &rec)) {
+                if (rows != NULL) {
+                    rows[produced] = (export_row_t){
+                        .time_s = rec.time_s,
+                        .node_id = node_id,
+                        .seq = rec.seq,
+                        .temperature = rec.temperature,
+                        .pressure = rec.pressure,
+                        .humidity = rec.humidity,
+                        .gas = rec.gas_resistance,
+                        .has = ROW_SEQ | ROW_PRESSURE | ROW_HUMIDITY | (rec.gas_valid ? ROW_GAS : 0),
+                    };
+                }
+                produced++;
+            }
+            used++;
+        }
+        src->pos += used * SD_ARCHIVE_RECORD_LEN;
+    }
+    return produced;
+}
+
+/**
+ * @brief Bytes [first, last] of the encoded export: the CSV header, then whole and cut lines
+ */
+static esp_err_t stream_rows(httpd_req_t *req, gzip_stream_t *gz, export_work_t *work, export_source_t *src,
+                             export_format_t format, uint64_t first, uint64_t last) {
+    size_t header_len = format == FORMAT_CSV ? strlen(csv_header) : 0;
+    size_t line_len = format_line(format, &(export_row_t){ 0 }, work->line);
+    uint64_t offset = first;
+    size_t fill = 0;
+
+    if (offset < header_len) {
+        size_t n = (size_t)((last + 1 < header_len ? last + 1 : header_len) - offset);
+        memcpy(work->buf, csv_header + offset, n);
+        fill = n;
+        offset += n;
+    }
+    if (offset <= last) {
+        // Straight to the line the range starts in
+        uint64_t index = (offset - header_len) / line_len;
+        size_t cut = (size_t)((offset - header_len) % line_len);
+        if (source_read(src, work, NULL, (size_t)index) < index) {
+            ESP_LOGW(TAG, "Records went away during the export");
+            offset = last + 1;
+        }
+        while (offset <= last) {
+            size_t n = source_read(src, work, work->rows, EXPORT_READ_RECORDS);
+            if (n == 0) {
+                break;
+            }
+            for (size_t i = 0; i < n && offset <= last; i++) {
+                format_line(format, &work->rows[i], work->line);
+                size_t take = line_len - cut;
+                if (take > last + 1 - offset) {
+                    take = (size_t)(last + 1 - offset);
+                }
+                if (fill + take > sizeof(work->buf)) {
+                    if (http_gzip_send_chunk(req, gz, work->buf, fill) != ESP_OK) {
+                        return ESP_FAIL;
+                    }
+                    fill = 0;
+                }
+                memcpy(work->buf + fill, work->line + cut, take);
+                fill += take;
+                offset += take;
+                cut = 0;
+            }
+        }
+    }
+    if (fill > 0 && http_gzip_send_chunk(req, gz, work->buf, fill) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return http_gzip_send_chunk(req, gz, NULL, 0);
+}
+
+/**
+ * @brief Bytes [first, last] of an archive file as they are
+ */
+static esp_err_t stream_raw(httpd_req_t *req, gzip_stream_t *gz, export_work_t *work, export_source_t *src,
+                            uint64_t first, uint64_t last) {
+    if (lseek(src->fd, (off_t)first, SEEK_SET) < 0) {
+        return http_gzip_send_chunk(req, gz, NULL, 0);
+    }
+    uint64_t left = last + 1 - first;
+    while (left > 0) {
+        size_t want = left < sizeof(work->buf) ? (size_t)left : sizeof(work->buf);
+        ssize_t got = read(src->fd, work->buf, want);
+        if (got <= 0) {
+            break;
+        }
+        if (http_gzip_send_chunk(req, gz, work->buf, (size_t)got) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        left -= (uint64_t)got;
+    }
+    return http_gzip_send_chunk(req, gz, NULL, 0);
+}
+
+/**
+ * @brief Size the export, honour a Range header, and stream it
+ */
+static esp_err_t send_export(httpd_req_t *req, export_work_t *work, export_source_t *src, export_format_t format,
+                             const char *filename) {
+    uint64_t total;
+    if (format == FORMAT_RAW) {
+        total = src->end;
+    } else {
+        // Count, then rewind
+        ts_store_cursor_t start = src->cursor;
+        size_t rows = source_read(src, work, NULL, SIZE_MAX);
+        src->cursor = start;
+        src->pos = 0;
+        size_t header_len = format == FORMAT_CSV ? strlen(csv_header) : 0;
+        total = header_len + (uint64_t)rows * format_line(format, &(export_row_t){ 0 }, work->line);
+    }
+
+    uint64_t first = 0;
+    uint64_t last = total > 0 ? total - 1 : 0;
+    range_result_t range = RANGE_NONE;
+    char range_hdr[RANGE_HDR_MAX];
+    if (httpd_req_get_hdr_value_str(req, "Range", range_hdr, sizeof(range_hdr)) == ESP_OK) {
+        range = parse_range(range_hdr, total, &first, &last);
+    }
+
+    // Ranges count the plain bytes, so only a whole export may go compressed
+    gzip_stream_t *gz = range == RANGE_NONE && total > 0 ? http_gzip_begin(req) : NULL;
+
+    char content_range[48];
+    char disposition[64];
+    static const char *const types[] = { "text/csv", "application/x-ndjson", "application/octet-stream" };
+    snprintf(disposition, sizeof(disposition), "attachment; filename=\"%s\"", filename);
+    httpd_resp_set_type(req, types[format]);
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    if (gz == NULL) {
+        httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+    }
+    httpd_resp_set_hdr(req, "Content-Disposition", disposition);
+
+    if (range == RANGE_UNSATISFIABLE) {
+        snprintf(content_range, sizeof(content_range), "bytes */%llu", (unsigned long long)total);
+        httpd_resp_set_status(req, "416 Range Not Satisfiable");
+        httpd_resp_set_hdr(req, "Content-Range", content_range);
+        return httpd_resp_send(req, NULL, 0);
+    }
+    if (range == RANGE_OK) {
+        snprintf(content_range, sizeof(content_range), "bytes %llu-%llu/%llu", (unsigned long long)first,
+                 (unsigned long long)last, (unsigned long long)total);
+        httpd_resp_set_status(req, "206 Partial Content");
+        httpd_resp_set_hdr(req, "Content-Range", content_range);
+    }
+    if (total == 0) {
+        return httpd_resp_send(req, NULL, 0);
+    }
+    return format == FORMAT_RAW ? stream_raw(req, gz, work, src, first, last)
+                                : stream_rows(req, gz, work, src, format, first, last);
+}
+
+/**
+ * @brief Stored records: GET /api/history/export?format=csv|ndjson&from=&to=
+ */
+static esp_err_t history_export_handler(httpd_req_t *req) {
+    char query[96];
+    char value[12];
+    bool have_query = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK;
+    export_format_t format;
+    if (parse_format(have_query ? query : NULL, false, &format) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "format is csv or ndjson");
+        return ESP_FAIL;
+    }
+
+    ts_store_info_t info;
+    ts_store_get_info(&info);
+    uint32_t from = info.oldest_s;
+    uint32_t to = info.newest_s + 1;
+    if (have_query && httpd_query_key_value(query, "from", value, sizeof(value)) == ESP_OK) {
+        from = strtoul(value, NULL, 10);
+    }
+    if (have_query && httpd_query_key_value(query, "to", value, sizeof(value)) == ESP_OK) {
+        to = strtoul(value, NULL, 10);
+    }
+
+    export_work_t *work = http_arena_alloc(req, sizeof(export_work_t));
+    if (work == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    export_source_t src = { .archive = false, .fd = -1 };
+    esp_err_t err = ts_store_export_begin(&src.cursor, from, to);
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad range");
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_type(req, "text/plain");
+        httpd_resp_sendstr(req, "History not ready");
+        return ESP_FAIL;
+    }
+
+    char filename[48];
+    snprintf(filename, sizeof(filename), "history-%lu-%lu.%s", (unsigned long)from, (unsigned long)to,
+             format == FORMAT_CSV ? "csv" : "ndjson");
+    return send_export(req, work, &src, format, filename);
+}
+
+/**
+ * @brief The archive's daily files: GET /api/archive
+ */
+static esp_err_t archive_list(httpd_req_t *req) {
+    sd_archive_stats_t stats;
+    sd_archive_get_stats(&stats);
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    json_obj_begin(&w);
+    json_kv_bool(&w, "mounted", stats.mounted);
+    json_key(&w, "files");
+    json_arr_begin(&w);
+    DIR *dir = stats.mounted ? opendir(SD_ARCHIVE_MOUNT) : NULL;
+    if (dir != NULL) {
+        struct dirent *ent;
+        while ((ent = readdir(dir)) != NULL) {
+            char *end;
+            unsigned long day = strtoul(ent->d_name, &end, 10);
+            if (end != ent->d_name + 8 || strcasecmp(end, SD_ARCHIVE_EXT) != 0) {
+                continue;
+            }
+            char path[SD_ARCHIVE_PATH_LEN];
+            struct stat st;
+            sd_archive_path(path, (uint32_t)day);
+            json_obj_begin(&w);
+            json_kv_uint(&w, "day", day);
+            json_kv_uint(&w, "bytes", stat(path, &st) == 0 ? (uint64_t)st.st_size : 0);
+            json_obj_end(&w);
+        }
+        closedir(dir);
+    }
+    json_arr_end(&w);
+    json_obj_end(&w);
+    return json_writer_finish(&w);
+}
+
+/**
+ * @brief One day of the SD archive: GET /api/archive?day=YYYYMMDD&format=csv|ndjson|raw
+ */
+static esp_err_t archive_handler(httpd_req_t *req) {
+    char query[64];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "day", value, sizeof(value)) != ESP_OK) {
+        return archive_list(req);
+    }
+    export_format_t format;
+    if (parse_format(query, true, &format) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "format is csv, ndjson or raw");
+        return ESP_FAIL;
+    }
+    char *end;
+    uint32_t day = strtoul(value, &end, 10);
+    if (end != value + 8 || *end != '\0') {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "day is YYYYMMDD");
+        return ESP_FAIL;
+    }
+
+    sd_archive_stats_t stats;
+    sd_archive_get_stats(&stats);
+    char path[SD_ARCHIVE_PATH_LEN];
+    sd_archive_path(path, day);
+    struct stat st;
+    int fd = stats.mounted ? open(path, O_RDONLY) : -1;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, stats.mounted ? "No archive for that day" : "No SD card");
+        return ESP_FAIL;
+    }
+
+    export_work_t *work = http_arena_alloc(req, sizeof(export_work_t));
+    if (work == NULL) {
+        close(fd);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    // Today's file grows while it is read; the export stops where it ended when the request came in
+    export_source_t src = { .archive = true, .fd = fd, .pos = 0, .end = (uint32_t)st.st_size };
+    if (format != FORMAT_RAW) {
+        src.end -= src.end % SD_ARCHIVE_RECORD_LEN;
+    }
+    char filename[24];
+    snprintf(filename, sizeof(filename), "%08lu%s", (unsigned long)day,
+             format == FORMAT_CSV ? ".csv" : format == FORMAT_NDJSON ? ".ndjson" : SD_ARCHIVE_EXT);
+    esp_err_t err = send_export(req, work, &src, format, filename);
+    close(fd);
+    return err;
+}
+
+esp_err_t history_export_register(httpd_handle_t server) {
+    httpd_uri_t export_uri = {
+        .uri = HISTORY_EXPORT_URI,
+        .method = HTTP_GET,
+        .handler = history_export_handler,
+        .user_ctx = NULL
+    };
+    esp_err_t err = http_perf_register(server, &export_uri);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    httpd_uri_t archive_uri = {
+        .uri = HISTORY_EXPORT_ARCHIVE_URI,
+        .method = HTTP_GET,
+        .handler = archive_handler,
+        .user_ctx = NULL
+    };
+    return http_perf_register(server, &archive_uri);
+}
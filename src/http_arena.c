@@ -0,0 +1,192 @@
+/**
+ * @file http_arena.c
+ * @brief Per-request arena for the HTTP server: handler buffers freed in one shot when the handler returns
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "http_arena.h"
+#include "version.h"
+#include "static_mem.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register http_arena.c version
+REGISTER_VERSION(HttpArena, "1.0.0", "2026-10-15");
+
+static const char *TAG = "HTTP_ARENA";
+
+typedef struct {
+    uint8_t *base;
+    size_t used;
+    bool bound;
+    TaskHandle_t task;                          // Task inside the request
+    httpd_req_t *req;                           // NULL for server work outside a request
+} arena_t;
+
+// Arena ownership changes under the lock; an arena's contents belong to its bound task
+static portMUX_TYPE arena_lock = portMUX_INITIALIZER_UNLOCKED;
+static arena_t arenas[HTTP_ARENA_COUNT];
+static http_arena_stats_t totals;               // Under arena_lock
+
+#if STATIC_MEMORY
+static uint8_t arena_pool[HTTP_ARENA_COUNT][HTTP_ARENA_BYTES] __attribute__((aligned(HTTP_ARENA_ALIGN)));
+#endif
+
+// =============================
+// Function Prototypes
+// =============================
+static arena_t *find_bound(TaskHandle_t task, const httpd_req_t *req, bool any_req);
+static void *take(arena_t *a, size_t size);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief The arena bound to this task and request (or to this task, whatever the request)
+ */
+static arena_t *find_bound(TaskHandle_t task, const httpd_req_t *req, bool any_req) {
+    for (int i = 0; i < HTTP_ARENA_COUNT; i++) {
+        if (arenas[i].bound && arenas[i].task == task && (any_req || arenas[i].req == req)) {
+            return &arenas[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Bump-allocate from a bound arena; only its task calls this
+ */
+static void *take(arena_t *a, size_t size) {
+    size_t need = (size + HTTP_ARENA_ALIGN - 1) & ~(size_t)(HTTP_ARENA_ALIGN - 1);
+    if (need > HTTP_ARENA_BYTES - a->used) {
+        portENTER_CRITICAL(&arena_lock);
+        totals.failures++;
+        portEXIT_CRITICAL(&arena_lock);
+        ESP_LOGW(TAG, "%zu bytes do not fit the arena (%zu of %u used)", size, a->used, (unsigned)HTTP_ARENA_BYTES);
+        return NULL;
+    }
+    void *ptr = a->base + a->used;
+    a->used += need;
+    portENTER_CRITICAL(&arena_lock);
+    totals.allocs++;
+    if (a->used > totals.peak) {
+        totals.peak = a->used;
+    }
+    portEXIT_CRITICAL(&arena_lock);
+    return ptr;
+}
+
+esp_err_t http_arena_init(void) {
+    for (int i = 0; i < HTTP_ARENA_COUNT; i++) {
+        if (arenas[i].base != NULL) {
+            continue;
+        }
+#if STATIC_MEMORY
+        arenas[i].base = arena_pool[i];
+#else
+        arenas[i].base = malloc(HTTP_ARENA_BYTES);
+        if (arenas[i].base == NULL) {
+            ESP_LOGE(TAG, "No memory for a %u byte request arena", (unsigned)HTTP_ARENA_BYTES);
+            return ESP_ERR_NO_MEM;
+        }
+#endif
+    }
+    totals.bytes = HTTP_ARENA_BYTES;
+    totals.count = HTTP_ARENA_COUNT;
+    return ESP_OK;
+}
+
+void http_arena_begin(httpd_req_t *req) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    bool bound = false;
+    portENTER_CRITICAL(&arena_lock);
+    for (int i = 0; i < HTTP_ARENA_COUNT && !bound; i++) {
+        arena_t *a = &arenas[i];
+        if (a->base != NULL && !a->bound) {
+            a->bound = true;
+            a->task = self;
+            a->req = req;
+            a->used = 0;
+            bound = true;
+        }
+    }
+    if (bound) {
+        totals.requests++;
+    } else {
+        totals.unbound++;
+    }
+    portEXIT_CRITICAL(&arena_lock);
+}
+
+void http_arena_end(httpd_req_t *req) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&arena_lock);
+    arena_t *a = find_bound(self, req, false);
+    if (a != NULL) {
+        a->bound = false;
+        a->used = 0;
+        a->task = NULL;
+        a->req = NULL;
+    }
+    portEXIT_CRITICAL(&arena_lock);
+}
+
+void *http_arena_alloc(httpd_req_t *req, size_t size) {
+    arena_t *a = find_bound(xTaskGetCurrentTaskHandle(), req, false);
+    if (a == NULL) {
+        portENTER_CRITICAL(&arena_lock);
+        totals.failures++;
+        portEXIT_CRITICAL(&arena_lock);
+        return NULL;
+    }
+    return take(a, size);
+}
+
+void *http_arena_malloc(size_t size) {
+    arena_t *a = find_bound(xTaskGetCurrentTaskHandle(), NULL, true);
+    void *ptr = a != NULL ? take(a, size) : NULL;
+    return ptr != NULL ? ptr : malloc(size);
+}
+
+void http_arena_free(void *ptr) {
+    for (int i = 0; i < HTTP_ARENA_COUNT; i++) {
+        if (arenas[i].base != NULL && (uint8_t *)ptr >= arenas[i].base &&
+            (uint8_t *)ptr < arenas[i].base + HTTP_ARENA_BYTES) {
+            return;
+        }
+    }
+    free(ptr);
+}
+
+void http_arena_get_stats(http_arena_stats_t *stats) {
+    portENTER_CRITICAL(&arena_lock);
+    *stats = totals;
+    portEXIT_CRITICAL(&arena_lock);
+}
+
+void http_arena_write_json(json_writer_t *w) {
+    http_arena_stats_t s;
+    http_arena_get_stats(&s);
+    json_obj_begin(w);
+    json_kv_uint(w, "bytes", s.bytes);
+    json_kv_uint(w, "count", s.count);
+    json_kv_uint(w, "requests", s.requests);
+    json_kv_uint(w, "unbound", s.unbound);
+    json_kv_uint(w, "allocs", s.allocs);
+    json_kv_uint(w, "failures", s.failures);
+    json_kv_uint(w, "peak", s.peak);
+    json_obj_end(w);
+}
@@ -0,0 +1,112 @@
+/**
+ * @file http_gzip.c
+ * @brief gzip for large dynamic responses, compressed as they stream out when the client accepts it
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "http_gzip.h"
+#include "http_arena.h"
+#include "version.h"
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register http_gzip.c version
+REGISTER_VERSION(HttpGzip, "1.0.0", "2026-10-15");
+
+static const char *TAG = "HTTP_GZIP";
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static http_gzip_stats_t stats;                 // Under stats_lock
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t httpd_sink(void *ctx, const char *data, size_t len);
+static esp_err_t json_sink(void *ctx, const char *data, size_t len);
+static esp_err_t finish(gzip_stream_t *gz);
+
+// =============================
+// Function Definitions
+// =============================
+
+static esp_err_t httpd_sink(void *ctx, const char *data, size_t len) {
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, (ssize_t)len);
+}
+
+/**
+ * @brief json_writer flush with the stream as ctx; (NULL, 0) ends the response
+ */
+static esp_err_t json_sink(void *ctx, const char *data, size_t len) {
+    return data == NULL ? finish(ctx) : gzip_stream_write(ctx, data, len);
+}
+
+static esp_err_t finish(gzip_stream_t *gz) {
+    esp_err_t err = gzip_stream_finish(gz);
+    portENTER_CRITICAL(&stats_lock);
+    stats.responses++;
+    stats.bytes_in += gz->total;
+    stats.bytes_out += gz->sent;
+    portEXIT_CRITICAL(&stats_lock);
+    ESP_LOGD(TAG, "%s: %lu bytes sent as %lu", ((httpd_req_t *)gz->ctx)->uri, (unsigned long)gz->total,
+             (unsigned long)gz->sent);
+    return err;
+}
+
+bool http_gzip_accepted(httpd_req_t *req) {
+    char accept_encoding[64];
+    // A truncated header value still contains the leading encodings, which is where gzip sits
+    esp_err_t ret = httpd_req_get_hdr_value_str(req, "Accept-Encoding", accept_encoding, sizeof(accept_encoding));
+    if (ret != ESP_OK && ret != ESP_ERR_HTTPD_RESULT_TRUNC) {
+        return false;
+    }
+    return strstr(accept_encoding, "gzip") != NULL;
+}
+
+gzip_stream_t *http_gzip_begin(httpd_req_t *req) {
+    if (HTTP_GZIP == 0 || !http_gzip_accepted(req)) {
+        return NULL;
+    }
+    gzip_stream_t *gz = http_arena_alloc(req, sizeof(gzip_stream_t));
+    if (gz == NULL) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.skipped++;
+        portEXIT_CRITICAL(&stats_lock);
+        return NULL;
+    }
+    gzip_stream_init(gz, httpd_sink, req);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    return gz;
+}
+
+esp_err_t http_gzip_send_chunk(httpd_req_t *req, gzip_stream_t *gz, const char *data, size_t len) {
+    if (gz == NULL) {
+        return httpd_resp_send_chunk(req, data, (ssize_t)len);
+    }
+    return data == NULL || len == 0 ? finish(gz) : gzip_stream_write(gz, data, len);
+}
+
+void http_gzip_init_json(json_writer_t *w, httpd_req_t *req) {
+    gzip_stream_t *gz = http_gzip_begin(req);
+    if (gz == NULL) {
+        json_writer_init_httpd(w, req);
+    } else {
+        json_writer_init(w, json_sink, gz);
+    }
+}
+
+void http_gzip_get_stats(http_gzip_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,268 @@
+/**
+ * @file http_io.c
+ * @brief Thin HTTP request/response interface, so handler logic runs on esp_http_server or on a host
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "http_io.h"
+#include "version.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register http_io.c version
+REGISTER_VERSION(HttpIo, "1.0.0", "2026-10-15");
+
+// =============================
+// Function Prototypes
+// =============================
+#ifdef ESP_PLATFORM
+static int httpd_io_recv(void *ctx, char *buf, size_t len);
+static esp_err_t httpd_io_get_header(void *ctx, const char *name, char *out, size_t out_len);
+static esp_err_t httpd_io_set_status(void *ctx, const char *status);
+static esp_err_t httpd_io_set_type(void *ctx, const char *type);
+static esp_err_t httpd_io_send(void *ctx, const char *data, size_t len);
+static esp_err_t httpd_io_send_chunk(void *ctx, const char *data, size_t len);
+static esp_err_t httpd_io_send_error(void *ctx, int code, const char *message);
+#endif
+static int mem_recv(void *ctx, char *buf, size_t len);
+static esp_err_t mem_get_header(void *ctx, const char *name, char *out, size_t out_len);
+static esp_err_t mem_set_status(void *ctx, const char *status);
+static esp_err_t mem_set_type(void *ctx, const char *type);
+static void mem_append(http_io_mem_t *mem, const char *data, size_t len);
+static esp_err_t mem_send(void *ctx, const char *data, size_t len);
+static esp_err_t mem_send_chunk(void *ctx, const char *data, size_t len);
+static esp_err_t mem_send_error(void *ctx, int code, const char *message);
+static esp_err_t json_flush(void *ctx, const char *data, size_t len);
+
+// =============================
+// Function Definitions
+// =============================
+
+#ifdef ESP_PLATFORM
+_Static_assert(HTTP_IO_RECV_TIMEOUT == HTTPD_SOCK_ERR_TIMEOUT, "recv results pass through unchanged");
+
+static const http_io_ops_t httpd_ops = {
+    .recv = httpd_io_recv,
+    .get_header = httpd_io_get_header,
+    .set_status = httpd_io_set_status,
+    .set_type = httpd_io_set_type,
+    .send = httpd_io_send,
+    .send_chunk = httpd_io_send_chunk,
+    .send_error = httpd_io_send_error,
+};
+
+static int httpd_io_recv(void *ctx, char *buf, size_t len) {
+    return httpd_req_recv((httpd_req_t *)ctx, buf, len);
+}
+
+static esp_err_t httpd_io_get_header(void *ctx, const char *name, char *out, size_t out_len) {
+    esp_err_t err = httpd_req_get_hdr_value_str((httpd_req_t *)ctx, name, out, out_len);
+    return err == ESP_ERR_HTTPD_RESULT_TRUNC ? ESP_ERR_INVALID_SIZE : err;
+}
+
+static esp_err_t httpd_io_set_status(void *ctx, const char *status) {
+    return httpd_resp_set_status((httpd_req_t *)ctx, status);
+}
+
+static esp_err_t httpd_io_set_type(void *ctx, const char *type) {
+    return httpd_resp_set_type((httpd_req_t *)ctx, type);
+}
+
+static esp_err_t httpd_io_send(void *ctx, const char *data, size_t len) {
+    return httpd_resp_send((httpd_req_t *)ctx, data, (ssize_t)len);
+}
+
+static esp_err_t httpd_io_send_chunk(void *ctx, const char *data, size_t len) {
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, (ssize_t)len);
+}
+
+static esp_err_t httpd_io_send_error(void *ctx, int code, const char *message) {
+    httpd_err_code_t err;
+    switch (code) {
+    case 400: err = HTTPD_400_BAD_REQUEST; break;
+    case 404: err = HTTPD_404_NOT_FOUND; break;
+    case 408: err = HTTPD_408_REQ_TIMEOUT; break;
+    case 413: err = HTTPD_413_CONTENT_TOO_LARGE; break;
+    default: err = HTTPD_500_INTERNAL_SERVER_ERROR; break;
+    }
+    return httpd_resp_send_err((httpd_req_t *)ctx, err, message);
+}
+
+void http_io_init_httpd(http_io_t *io, httpd_req_t *req) {
+    io->ops = &httpd_ops;
+    io->ctx = req;
+    io->content_len = req->content_len;
+    io->head = req->method == HTTP_HEAD;
+}
+#endif
+
+static const http_io_ops_t mem_ops = {
+    .recv = mem_recv,
+    .get_header = mem_get_header,
+    .set_status = mem_set_status,
+    .set_type = mem_set_type,
+    .send = mem_send,
+    .send_chunk = mem_send_chunk,
+    .send_error = mem_send_error,
+};
+
+static int mem_recv(void *ctx, char *buf, size_t len) {
+    http_io_mem_t *mem = (http_io_mem_t *)ctx;
+    size_t n = mem->body_len - mem->pos;
+    if (n > len) {
+        n = len;
+    }
+    if (mem->recv_max != 0 && n > mem->recv_max) {
+        n = mem->recv_max;
+    }
+    memcpy(buf, mem->body + mem->pos, n);
+    mem->pos += n;
+    return (int)n;
+}
+
+/**
+ * @brief Find name in the "Name: value\n" lines, case-insensitively as HTTP does
+ */
+static esp_err_t mem_get_header(void *ctx, const char *name, char *out, size_t out_len) {
+    http_io_mem_t *mem = (http_io_mem_t *)ctx;
+    size_t name_len = strlen(name);
+    for (const char *line = mem->headers; line != NULL && *line != '\0';) {
+        const char *end = strchr(line, '\n');
+        size_t line_len = end != NULL ? (size_t)(end - line) : strlen(line);
+        if (line_len > name_len && line[name_len] == ':' && strncasecmp(line, name, name_len) == 0) {
+            const char *value = line + name_len + 1;
+            while (*value == ' ') {
+                value++;
+            }
+            size_t value_len = line_len - (size_t)(value - line);
+            if (value_len > 0 && value[value_len - 1] == '\r') {
+                value_len--;
+            }
+            if (value_len >= out_len) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            memcpy(out, value, value_len);
+            out[value_len] = '\0';
+            return ESP_OK;
+        }
+        line = end != NULL ? end + 1 : NULL;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+static esp_err_t mem_set_status(void *ctx, const char *status) {
+    ((http_io_mem_t *)ctx)->status = atoi(status);
+    return ESP_OK;
+}
+
+static esp_err_t mem_set_type(void *ctx, const char *type) {
+    http_io_mem_t *mem = (http_io_mem_t *)ctx;
+    strlcpy(mem->type, type, sizeof(mem->type));
+    return ESP_OK;
+}
+
+/**
+ * @brief Keep what fits out; out_len counts it all, so a bench can run without a buffer
+ */
+static void mem_append(http_io_mem_t *mem, const char *data, size_t len) {
+    if (mem->out != NULL && mem->out_len < mem->out_cap) {
+        size_t room = mem->out_cap - mem->out_len;
+        memcpy(mem->out + mem->out_len, data, len < room ? len : room);
+    }
+    mem->out_len += len;
+}
+
+static esp_err_t mem_send(void *ctx, const char *data, size_t len) {
+    http_io_mem_t *mem = (http_io_mem_t *)ctx;
+    if (mem->ended) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!mem->head && data != NULL) {
+        mem_append(mem, data, len);
+    }
+    mem->ended = true;
+    return ESP_OK;
+}
+
+static esp_err_t mem_send_chunk(void *ctx, const char *data, size_t len) {
+    http_io_mem_t *mem = (http_io_mem_t *)ctx;
+    if (mem->ended) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (data == NULL || len == 0) {
+        mem->ended = true;
+    } else if (!mem->head) {
+        mem_append(mem, data, len);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t mem_send_error(void *ctx, int code, const char *message) {
+    http_io_mem_t *mem = (http_io_mem_t *)ctx;
+    mem->status = code;
+    strlcpy(mem->type, "text/html", sizeof(mem->type));
+    return mem_send(ctx, message, strlen(message));
+}
+
+void http_io_init_mem(http_io_t *io, http_io_mem_t *mem) {
+    mem->out_len = 0;
+    mem->status = 200;
+    strlcpy(mem->type, "text/html", sizeof(mem->type));
+    mem->ended = false;
+    mem->pos = 0;
+    io->ops = &mem_ops;
+    io->ctx = mem;
+    io->content_len = mem->body_len;
+    io->head = mem->head;
+}
+
+int http_io_recv(http_io_t *io, char *buf, size_t len) {
+    return io->ops->recv(io->ctx, buf, len);
+}
+
+esp_err_t http_io_get_header(http_io_t *io, const char *name, char *out, size_t out_len) {
+    return io->ops->get_header(io->ctx, name, out, out_len);
+}
+
+esp_err_t http_io_set_status(http_io_t *io, const char *status) {
+    return io->ops->set_status(io->ctx, status);
+}
+
+esp_err_t http_io_set_type(http_io_t *io, const char *type) {
+    return io->ops->set_type(io->ctx, type);
+}
+
+esp_err_t http_io_send(http_io_t *io, const char *data, size_t len) {
+    return io->ops->send(io->ctx, data, len);
+}
+
+esp_err_t http_io_send_str(http_io_t *io, const char *str) {
+    return io->ops->send(io->ctx, str, strlen(str));
+}
+
+esp_err_t http_io_send_chunk(http_io_t *io, const char *data, size_t len) {
+    return io->ops->send_chunk(io->ctx, data, len);
+}
+
+esp_err_t http_io_send_error(http_io_t *io, int code, const char *message) {
+    return io->ops->send_error(io->ctx, code, message);
+}
+
+static esp_err_t json_flush(void *ctx, const char *data, size_t len) {
+    return http_io_send_chunk((http_io_t *)ctx, data, data != NULL ? len : 0);
+}
+
+void http_io_init_json(json_writer_t *w, http_io_t *io) {
+    json_writer_init(w, json_flush, io);
+    http_io_set_type(io, "application/json");
+}
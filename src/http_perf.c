@@ -0,0 +1,324 @@
+/**
+ * @file http_perf.c
+ * @brief Per-handler request count, bytes and latency histogram for the web server
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "http_perf.h"
+#include "power_profile.h"
+#include "version.h"
+#include "http_arena.h"
+#include "http_session.h"
+#include "SystemMetrics.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register http_perf.c version
+REGISTER_VERSION(HttpPerf, "1.0.0", "2026-10-14");
+
+static const char *TAG = "HTTP_PERF";
+
+// Bucket upper bounds; a request lands in the first bucket it does not exceed
+static const uint32_t bucket_ms[HTTP_PERF_BUCKETS - 1] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 5000 };
+
+// One wrapped handler: what httpd would have called, plus its counters
+typedef struct perf_slot {
+    esp_err_t (*handler)(httpd_req_t *req);
+    void *user_ctx;
+    http_perf_stats_t stats;
+    struct perf_slot *next;                     // Overflow slots only
+} perf_slot_t;
+
+static perf_slot_t slots[HTTP_PERF_MAX_HANDLERS];
+static size_t slot_count;
+
+// Past HTTP_PERF_MAX_HANDLERS: still wrapped, so the handler gets its arena, but not listed
+static perf_slot_t *overflow;
+
+// Handlers run one at a time on the httpd task; readers may be on other tasks
+static portMUX_TYPE perf_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Socket of the request being handled, so async sends to other sockets (e.g.
+// WebSocket pushes from the metrics task) are not billed to it
+static volatile int active_fd = -1;
+static TaskHandle_t active_task;
+static uint32_t active_bytes_out;
+
+// When the last handler finished, for the config mode idle check
+static int64_t last_request_us;
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t perf_trampoline(httpd_req_t *req);
+static size_t bucket_for(uint32_t us);
+static metric_error_t requests_provider(char *buf, size_t buf_len);
+static metric_error_t latency_provider(char *buf, size_t buf_len);
+
+// =============================
+// Function Definitions
+// =============================
+
+static size_t bucket_for(uint32_t us) {
+    for (size_t i = 0; i < HTTP_PERF_BUCKETS - 1; i++) {
+        if (us <= bucket_ms[i] * 1000U) {
+            return i;
+        }
+    }
+    return HTTP_PERF_BUCKETS - 1;
+}
+
+/**
+ * @brief Time the wrapped handler and account for the request
+ */
+static esp_err_t perf_trampoline(httpd_req_t *req) {
+    perf_slot_t *slot = (perf_slot_t *)req->user_ctx;
+    req->user_ctx = slot->user_ctx;
+
+    active_bytes_out = 0;
+    active_task = xTaskGetCurrentTaskHandle();
+    active_fd = httpd_req_to_sockfd(req);
+
+    // Full clock for the handler, so DFS does not add to its latency
+    power_profile_acquire(POWER_LOCK_CPU);
+    http_arena_begin(req);
+    http_session_request(req);
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = slot->handler(req);
+    int64_t elapsed = esp_timer_get_time() - start_us;
+    http_arena_end(req);                        // Every buffer the handler took goes back here
+    power_profile_release(POWER_LOCK_CPU);
+
+    active_fd = -1;
+    __atomic_store_n(&last_request_us, start_us + elapsed, __ATOMIC_RELAXED);
+    uint32_t us = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+
+    portENTER_CRITICAL(&perf_lock);
+    http_perf_stats_t *s = &slot->stats;
+    s->count++;
+    if (ret != ESP_OK) {
+        s->errors++;
+    }
+    s->bytes_in += req->content_len;
+    s->bytes_out += active_bytes_out;
+    s->total_us += us;
+    if (us > s->max_us) {
+        s->max_us = us;
+    }
+    s->histogram[bucket_for(us)]++;
+    portEXIT_CRITICAL(&perf_lock);
+
+    return ret;
+}
+
+int http_perf_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags) {
+    (void)hd;
+    if (buf == NULL) {
+        return HTTPD_SOCK_ERR_INVALID;
+    }
+
+    int ret = send(sockfd, buf, buf_len, flags);
+    if (ret < 0) {
+        // Same mapping as httpd's default send: retry on timeouts, drop the session otherwise
+        return (errno == EAGAIN || errno == EINTR) ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL;
+    }
+
+    if (sockfd == active_fd && xTaskGetCurrentTaskHandle() == active_task) {
+        active_bytes_out += (uint32_t)ret;
+    }
+    return ret;
+}
+
+esp_err_t http_perf_register(httpd_handle_t server, const httpd_uri_t *uri) {
+    if (server == NULL || uri == NULL || uri->handler == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool listed = slot_count < HTTP_PERF_MAX_HANDLERS;
+    perf_slot_t *slot = listed ? &slots[slot_count] : calloc(1, sizeof(perf_slot_t));
+    if (slot == NULL) {
+        ESP_LOGE(TAG, "No memory to wrap %s", uri->uri);
+        return ESP_ERR_NO_MEM;
+    }
+    if (!listed) {
+        ESP_LOGW(TAG, "No slot left for %s; it gets its arena but no stats", uri->uri);
+    }
+    memset(slot, 0, sizeof(*slot));
+    slot->handler = uri->handler;
+    slot->user_ctx = uri->user_ctx;
+    slot->stats.uri = uri->uri;
+    slot->stats.method = uri->method;
+
+    httpd_uri_t wrapped = *uri;
+    wrapped.handler = perf_trampoline;
+    wrapped.user_ctx = slot;
+
+    esp_err_t err = httpd_register_uri_handler(server, &wrapped);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register %s: %s", uri->uri, esp_err_to_name(err));
+        if (listed) {
+            slot->handler = NULL;
+        } else {
+            free(slot);
+        }
+        return err;
+    }
+    if (!listed) {
+        slot->next = overflow;
+        overflow = slot;
+        return ESP_OK;
+    }
+
+    if (slot_count == 0) {
+        set_metric_provider(METRIC_HTTP_REQUESTS, requests_provider);
+        set_metric_provider(METRIC_HTTP_LATENCY, latency_provider);
+    }
+    slot_count++;
+    return ESP_OK;
+}
+
+size_t http_perf_count(void) {
+    return slot_count;
+}
+
+esp_err_t http_perf_get(size_t index, http_perf_stats_t *stats) {
+    if (index >= slot_count || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&perf_lock);
+    *stats = slots[index].stats;
+    portEXIT_CRITICAL(&perf_lock);
+    return ESP_OK;
+}
+
+uint32_t http_perf_bucket_ms(size_t bucket) {
+    return bucket < HTTP_PERF_BUCKETS - 1 ? bucket_ms[bucket] : 0;
+}
+
+int64_t http_perf_last_request_us(void) {
+    return __atomic_load_n(&last_request_us, __ATOMIC_RELAXED);
+}
+
+void http_perf_reset(void) {
+    portENTER_CRITICAL(&perf_lock);
+    for (size_t i = 0; i < slot_count; i++) {
+        http_perf_stats_t *s = &slots[i].stats;
+        const char *uri = s->uri;
+        httpd_method_t method = s->method;
+        memset(s, 0, sizeof(*s));
+        s->uri = uri;
+        s->method = method;
+    }
+    portEXIT_CRITICAL(&perf_lock);
+}
+
+void http_perf_write_json(json_writer_t *w) {
+    json_obj_begin(w);
+    json_key(w, "bucketsMs");
+    json_arr_begin(w);
+    for (size_t b = 0; b < HTTP_PERF_BUCKETS - 1; b++) {
+        json_uint(w, bucket_ms[b]);
+    }
+    json_arr_end(w);
+
+    json_key(w, "handlers");
+    json_arr_begin(w);
+    for (size_t i = 0; i < slot_count; i++) {
+        http_perf_stats_t s;
+        if (http_perf_get(i, &s) != ESP_OK) {
+            continue;
+        }
+        json_obj_begin(w);
+        json_kv_str(w, "uri", s.uri);
+        json_kv_str(w, "method", http_method_str(s.method));
+        json_kv_uint(w, "count", s.count);
+        json_kv_uint(w, "errors", s.errors);
+        json_kv_uint(w, "bytesIn", s.bytes_in);
+        json_kv_uint(w, "bytesOut", s.bytes_out);
+        json_kv_uint(w, "avgUs", s.count ? s.total_us / s.count : 0);
+        json_kv_uint(w, "maxUs", s.max_us);
+        json_key(w, "histogram");
+        json_arr_begin(w);
+        for (size_t b = 0; b < HTTP_PERF_BUCKETS; b++) {
+            json_uint(w, s.histogram[b]);
+        }
+        json_arr_end(w);
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
+
+void http_perf_clear(void) {
+    portENTER_CRITICAL(&perf_lock);
+    slot_count = 0;
+    perf_slot_t *list = overflow;
+    overflow = NULL;
+    portEXIT_CRITICAL(&perf_lock);
+    while (list != NULL) {
+        perf_slot_t *next = list->next;
+        free(list);
+        list = next;
+    }
+}
+
+/**
+ * @brief METRIC_HTTP_REQUESTS: totals over all handlers
+ */
+static metric_error_t requests_provider(char *buf, size_t buf_len) {
+    uint32_t count = 0;
+    uint32_t errors = 0;
+    portENTER_CRITICAL(&perf_lock);
+    for (size_t i = 0; i < slot_count; i++) {
+        count += slots[i].stats.count;
+        errors += slots[i].stats.errors;
+    }
+    portEXIT_CRITICAL(&perf_lock);
+
+    snprintf(buf, buf_len, "%lu served, %lu failed", (unsigned long)count, (unsigned long)errors);
+    return METRIC_OK;
+}
+
+/**
+ * @brief METRIC_HTTP_LATENCY: request-weighted average and the slowest handler
+ */
+static metric_error_t latency_provider(char *buf, size_t buf_len) {
+    uint32_t count = 0;
+    uint64_t total_us = 0;
+    uint32_t max_us = 0;
+    const char *slowest = NULL;
+    portENTER_CRITICAL(&perf_lock);
+    for (size_t i = 0; i < slot_count; i++) {
+        const http_perf_stats_t *s = &slots[i].stats;
+        count += s->count;
+        total_us += s->total_us;
+        if (s->max_us > max_us) {
+            max_us = s->max_us;
+            slowest = s->uri;
+        }
+    }
+    portEXIT_CRITICAL(&perf_lock);
+
+    if (count == 0) {
+        snprintf(buf, buf_len, "No requests yet");
+        return METRIC_ERROR_NOT_AVAILABLE;
+    }
+    snprintf(buf, buf_len, "avg %lu us, max %lu us (%s)",
+             (unsigned long)(total_us / count), (unsigned long)max_us, slowest);
+    return METRIC_OK;
+}
@@ -0,0 +1,195 @@
+/**
+ * @file http_session.c
+ * @brief Persistent portal connections: per-session context, advertised keep-alive and idle reaping
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "http_session.h"
+#include "version.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register http_session.c version
+REGISTER_VERSION(HttpSession, "1.0.0", "2026-10-15");
+
+static const char *TAG = "HTTP_SESSION";
+
+static http_session_t sessions[HTTP_SESSION_MAX];  // httpd task only
+static httpd_handle_t server_handle = NULL;
+static esp_timer_handle_t sweep_timer = NULL;
+static bool sweep_pending = false;              // A sweep is queued on the httpd task
+static char keep_alive_hdr[24];                 // Response headers keep the pointer, so it must outlive them
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static http_session_stats_t stats;              // Under stats_lock
+
+// =============================
+// Function Prototypes
+// =============================
+static http_session_t *find(int fd);
+static void keep_ctx(void *ctx);
+static void sweep_cb(void *arg);
+static void sweep(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+static http_session_t *find(int fd) {
+    for (int i = 0; i < HTTP_SESSION_MAX; i++) {
+        if (sessions[i].fd == fd) {
+            return &sessions[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Session context free_fn: the slot is static and http_session_close() releases it
+ */
+static void keep_ctx(void *ctx) {
+    (void)ctx;
+}
+
+/**
+ * @brief Timer callback: hand the sweep to the httpd task, which owns the table
+ */
+static void sweep_cb(void *arg) {
+    (void)arg;
+    httpd_handle_t server = server_handle;
+    if (server == NULL || __atomic_load_n(&sweep_pending, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    __atomic_store_n(&sweep_pending, true, __ATOMIC_RELEASE);
+    if (httpd_queue_work(server, sweep, server) != ESP_OK) {
+        __atomic_store_n(&sweep_pending, false, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief Close plain HTTP sessions idle past HTTP_SESSION_IDLE_S
+ */
+static void sweep(void *arg) {
+    httpd_handle_t server = (httpd_handle_t)arg;
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < HTTP_SESSION_MAX; i++) {
+        http_session_t *s = &sessions[i];
+        if (s->fd < 0 || now - s->last_us < (int64_t)HTTP_SESSION_IDLE_S * 1000000) {
+            continue;
+        }
+        if (httpd_ws_get_fd_info(server, s->fd) == HTTPD_WS_CLIENT_WEBSOCKET) {
+            continue;                           // Quiet by design between pushes
+        }
+        if (httpd_sess_trigger_close(server, s->fd) == ESP_OK) {
+            ESP_LOGD(TAG, "Closing idle session (fd %d) after %lu requests", s->fd, (unsigned long)s->requests);
+            s->last_us = now;                   // Not again before the close lands
+            portENTER_CRITICAL(&stats_lock);
+            stats.idle_closed++;
+            portEXIT_CRITICAL(&stats_lock);
+        }
+    }
+    __atomic_store_n(&sweep_pending, false, __ATOMIC_RELEASE);
+}
+
+esp_err_t http_session_start(httpd_handle_t server) {
+    for (int i = 0; i < HTTP_SESSION_MAX; i++) {
+        sessions[i].fd = -1;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    memset(&stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&stats_lock);
+    snprintf(keep_alive_hdr, sizeof(keep_alive_hdr), "timeout=%d", HTTP_SESSION_IDLE_S - HTTP_SESSION_MARGIN_S);
+    server_handle = server;
+
+    esp_err_t err = ESP_OK;
+    if (sweep_timer == NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = sweep_cb,
+            .name = "http_session",
+        };
+        err = esp_timer_create(&timer_args, &sweep_timer);
+    }
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(sweep_timer, HTTP_SESSION_SWEEP_MS * 1000);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Idle sweep not started: %s; sessions close on the LRU purge only", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Keep-alive %s, idle sessions closed after %d s", keep_alive_hdr, HTTP_SESSION_IDLE_S);
+    return ESP_OK;
+}
+
+void http_session_stop(void) {
+    if (sweep_timer != NULL) {
+        esp_timer_stop(sweep_timer);
+    }
+    server_handle = NULL;
+}
+
+esp_err_t http_session_open(int fd) {
+    http_session_t *s = find(-1);
+    if (s == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s->fd = fd;
+    s->opened_us = esp_timer_get_time();
+    s->last_us = s->opened_us;
+    s->requests = 0;
+    portENTER_CRITICAL(&stats_lock);
+    stats.sessions++;
+    portEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
+void http_session_close(int fd) {
+    http_session_t *s = find(fd);
+    if (s != NULL) {
+        s->fd = -1;
+    }
+}
+
+void http_session_request(httpd_req_t *req) {
+    http_session_t *s = find(httpd_req_to_sockfd(req));
+    if (s == NULL) {
+        return;
+    }
+    if (req->sess_ctx == NULL) {
+        httpd_sess_set_ctx(req, s, keep_ctx);
+    }
+    s->last_us = esp_timer_get_time();
+    s->requests++;
+    httpd_resp_set_hdr(req, "Keep-Alive", keep_alive_hdr);
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.requests++;
+    if (s->requests > 1) {
+        stats.reused++;
+    }
+    if (s->requests > stats.most_requests) {
+        stats.most_requests = s->requests;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+http_session_t *http_session_get(httpd_req_t *req) {
+    return find(httpd_req_to_sockfd(req));
+}
+
+void http_session_get_stats(http_session_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,179 @@
+/**
+ * @file https_portal.c
+ * @brief Portal over TLS (esp_https_server) with session ticket resumption
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "https_portal.h"
+#include "version.h"
+#if HTTPS_PORTAL
+#include "portal_probe.h"
+#include "web_routes.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_https_server.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register https_portal.c version
+REGISTER_VERSION(HttpsPortal, "1.0.0", "2026-10-15");
+
+#if HTTPS_PORTAL
+
+#if !defined(CONFIG_ESP_HTTPS_SERVER_ENABLE) || !defined(CONFIG_ESP_TLS_SERVER_SESSION_TICKETS)
+#error "HTTPS_PORTAL needs CONFIG_ESP_HTTPS_SERVER_ENABLE and CONFIG_ESP_TLS_SERVER_SESSION_TICKETS (sdkconfig.https.defaults)"
+#endif
+
+static const char *TAG = "HTTPS_PORTAL";
+
+// Written by scripts/tls_credentials.py, embedded by src/CMakeLists.txt (text files: the length includes the NUL)
+extern const uint8_t servercert_start[] asm("_binary_servercert_pem_start");
+extern const uint8_t servercert_end[] asm("_binary_servercert_pem_end");
+extern const uint8_t prvtkey_start[] asm("_binary_prvtkey_pem_start");
+extern const uint8_t prvtkey_end[] asm("_binary_prvtkey_pem_end");
+
+#define LOCATION_MAX_LEN (HTTPS_PORTAL_HOST_MAX_LEN + 160)
+
+static httpd_handle_t redirect_handle = NULL;
+
+#endif
+
+// =============================
+// Function Prototypes
+// =============================
+#if HTTPS_PORTAL
+static esp_err_t redirect_handler(httpd_req_t *req);
+static esp_err_t start_redirect(const httpd_config_t *secure);
+#endif
+
+// =============================
+// Function Definitions
+// =============================
+
+#if HTTPS_PORTAL
+
+/**
+ * @brief Send any plain request to the same host and path over HTTPS
+ *
+ * 302 rather than 301, so a browser does not remember it if the device is
+ * later flashed with a plain HTTP build.
+ */
+static esp_err_t redirect_handler(httpd_req_t *req) {
+    char host[HTTPS_PORTAL_HOST_MAX_LEN];
+    if (httpd_req_get_hdr_value_str(req, "Host", host, sizeof(host)) != ESP_OK || host[0] == '\0') {
+        strlcpy(host, HTTPS_PORTAL_FALLBACK_HOST, sizeof(host));
+    }
+    char *port = strchr(host, ':');
+    if (port != NULL) {
+        *port = '\0';
+    }
+
+    // A path too long for the buffer goes to the portal root instead of being cut
+    char location[LOCATION_MAX_LEN];
+    int len = snprintf(location, sizeof(location), "https://%s%s", host, req->uri);
+    if (len < 0 || (size_t)len >= sizeof(location)) {
+        snprintf(location, sizeof(location), "https://%s/", host);
+    }
+    httpd_resp_set_status(req, "302 Found");
+    httpd_resp_set_hdr(req, "Location", location);
+    httpd_resp_set_hdr(req, "Connection", "close");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+static esp_err_t start_redirect(const httpd_config_t *secure) {
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = HTTPS_PORTAL_REDIRECT_PORT;
+    config.ctrl_port = secure->ctrl_port + 1;
+    config.max_open_sockets = HTTPS_PORTAL_REDIRECT_SOCKETS;
+    config.max_uri_handlers = 2 + WEB_ROUTES_MAX;  // The wildcard for GET and HEAD, and the probes
+    config.stack_size = HTTPS_PORTAL_REDIRECT_STACK_SIZE;
+    config.core_id = secure->core_id;
+    config.task_priority = secure->task_priority;
+    config.lru_purge_enable = true;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+
+    esp_err_t err = httpd_start(&redirect_handle, &config);
+    if (err != ESP_OK) {
+        return err;
+    }
+    portal_probe_register(redirect_handle);     // Exact probe URIs ahead of the wildcard
+    static const httpd_uri_t redirect_get = { .uri = "/*", .method = HTTP_GET, .handler = redirect_handler };
+    static const httpd_uri_t redirect_head = { .uri = "/*", .method = HTTP_HEAD, .handler = redirect_handler };
+    httpd_register_uri_handler(redirect_handle, &redirect_get);
+    httpd_register_uri_handler(redirect_handle, &redirect_head);
+    return ESP_OK;
+}
+
+esp_err_t https_portal_start(httpd_handle_t *handle, const httpd_config_t *config) {
+    httpd_ssl_config_t ssl = HTTPD_SSL_CONFIG_DEFAULT();
+    ssl.httpd = *config;
+    ssl.port_secure = config->server_port;
+    ssl.servercert = servercert_start;
+    ssl.servercert_len = servercert_end - servercert_start;
+    ssl.prvtkey_pem = prvtkey_start;
+    ssl.prvtkey_len = prvtkey_end - prvtkey_start;
+    ssl.session_tickets = true;
+
+    // The certificate and key are parsed here, once, into the context every session shares
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = httpd_ssl_start(handle, &ssl);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the HTTPS server: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "HTTPS on port %u: %u sessions, session tickets, started in %" PRId64 " ms",
+             (unsigned)ssl.port_secure, (unsigned)config->max_open_sockets, (esp_timer_get_time() - start_us) / 1000);
+
+    err = start_redirect(config);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No HTTP redirect on port %u: %s", (unsigned)HTTPS_PORTAL_REDIRECT_PORT, esp_err_to_name(err));
+    }
+    return ESP_OK;
+}
+
+esp_err_t https_portal_stop(httpd_handle_t handle) {
+    if (redirect_handle != NULL) {
+        httpd_stop(redirect_handle);
+        redirect_handle = NULL;
+    }
+    return httpd_ssl_stop(handle);
+}
+
+esp_err_t https_portal_certificate(const uint8_t **pem, size_t *len) {
+    *pem = servercert_start;
+    *len = servercert_end - servercert_start;
+    return ESP_OK;
+}
+
+#else
+
+esp_err_t https_portal_start(httpd_handle_t *handle, const httpd_config_t *config) {
+    (void)handle;
+    (void)config;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t https_portal_stop(httpd_handle_t handle) {
+    (void)handle;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t https_portal_certificate(const uint8_t **pem, size_t *len) {
+    *pem = NULL;
+    *len = 0;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
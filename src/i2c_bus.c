@@ -0,0 +1,351 @@
+/**
+ * @file i2c_bus.c
+ * @brief Shared I2C bus: one task runs the transactions of every driver on it, with retries and per-device counters
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "i2c_bus.h"
+#include "static_mem.h"
+#include "task_plan.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/i2c_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register i2c_bus.c version
+REGISTER_VERSION(I2cBus, "1.0.0", "2026-10-15");
+
+static const char *TAG = "I2C_BUS";
+
+/**
+ * @brief A device slot; a removed device keeps its slot and counters until the bus starts again
+ */
+struct i2c_bus_device {
+    i2c_master_dev_handle_t handle;             // NULL once removed
+    SemaphoreHandle_t done_sem;                 // i2c_bus_transfer() waits on it; kept across restarts
+    esp_err_t result;
+    i2c_bus_device_stats_t stats;               // lock; an empty name is a free slot
+};
+
+static struct i2c_bus_device devices[I2C_BUS_DEVICES];
+static uint8_t queue_peak = 0;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool running = false;
+static i2c_master_bus_handle_t bus = NULL;
+static QueueHandle_t queue = NULL;
+static StaticQueue_t queue_buf;
+static uint8_t queue_storage[I2C_BUS_QUEUE * sizeof(i2c_bus_txn_t)];
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(bus_task_slot, I2C_BUS_TASK_STACK_SIZE);
+static SemaphoreHandle_t stopped_sem = NULL;
+
+// =============================
+// Function Prototypes
+// =============================
+static bool retryable(esp_err_t err);
+static esp_err_t run(const i2c_bus_txn_t *txn);
+static void bus_task(void *arg);
+static void transfer_done(void *ctx, esp_err_t err);
+static metric_error_t i2c_errors_provider(char *buf, size_t buf_len);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief A NACK (ESP_ERR_INVALID_STATE before ESP-IDF 5.2, ESP_ERR_INVALID_RESPONSE since) or a timeout
+ */
+static bool retryable(esp_err_t err) {
+    return err == ESP_ERR_INVALID_STATE || err == ESP_ERR_INVALID_RESPONSE || err == ESP_ERR_TIMEOUT;
+}
+
+/**
+ * @brief Run one transaction with its retries, and count it
+ */
+static esp_err_t run(const i2c_bus_txn_t *txn) {
+    struct i2c_bus_device *d = txn->dev;
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    uint32_t retries = 0;
+    int64_t bus_us = 0;
+    for (int attempt = 0; attempt <= I2C_BUS_RETRIES; attempt++) {
+        if (attempt > 0) {
+            vTaskDelay(pdMS_TO_TICKS(I2C_BUS_RETRY_DELAY_MS) + 1);
+            retries++;
+        }
+        int64_t start = esp_timer_get_time();
+        if (txn->rx_len == 0) {
+            err = i2c_master_transmit(d->handle, txn->tx, txn->tx_len, I2C_BUS_TIMEOUT_MS);
+        } else {
+            err = i2c_master_transmit_receive(d->handle, txn->tx, txn->tx_len, txn->rx, txn->rx_len,
+                                              I2C_BUS_TIMEOUT_MS);
+        }
+        bus_us += esp_timer_get_time() - start;
+        if (err == ESP_OK || !retryable(err)) {
+            break;
+        }
+    }
+
+    portENTER_CRITICAL(&lock);
+    d->stats.transactions++;
+    d->stats.retries += retries;
+    d->stats.bus_us += (uint64_t)bus_us;
+    if (err != ESP_OK) {
+        d->stats.errors++;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "%s at 0x%02x: %s after %lu retries", d->stats.name, d->stats.address, esp_err_to_name(err),
+                 (unsigned long)retries);
+    }
+    return err;
+}
+
+/**
+ * @brief Run the queued transactions in order until the stop marker (a NULL device)
+ */
+static void bus_task(void *arg) {
+    i2c_bus_txn_t txn;
+    for (;;) {
+        xQueueReceive(queue, &txn, portMAX_DELAY);
+        if (txn.dev == NULL) {
+            break;
+        }
+        esp_err_t err = run(&txn);
+        if (txn.done != NULL) {
+            txn.done(txn.ctx, err);
+        }
+    }
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+static void transfer_done(void *ctx, esp_err_t err) {
+    struct i2c_bus_device *d = ctx;
+    d->result = err;
+    xSemaphoreGive(d->done_sem);
+}
+
+static metric_error_t i2c_errors_provider(char *buf, size_t buf_len) {
+    i2c_bus_stats_t st;
+    i2c_bus_get_stats(&st);
+    if (st.devices == 0) {
+        snprintf(buf, buf_len, "No devices");
+        return METRIC_OK;
+    }
+
+    size_t pos = 0;
+    buf[0] = '\0';
+    for (uint8_t i = 0; i < st.devices; i++) {
+        const i2c_bus_device_stats_t *d = &st.device[i];
+        char entry[96];
+        int len = snprintf(entry, sizeof(entry), "%s%s: %lu errors, %lu retries in %lu transactions, %lu ms on the bus",
+                           i ? "; " : "", d->name, (unsigned long)d->errors, (unsigned long)d->retries,
+                           (unsigned long)d->transactions, (unsigned long)(d->bus_us / 1000));
+        if (pos + len >= buf_len) {
+            break;                              // Whole entries only
+        }
+        memcpy(buf + pos, entry, len + 1);
+        pos += len;
+    }
+    return METRIC_OK;
+}
+
+esp_err_t i2c_bus_start(int port, int sda_gpio, int scl_gpio) {
+    if (running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    i2c_master_bus_config_t bus_cfg = {
+        .i2c_port = port,
+        .sda_io_num = sda_gpio,
+        .scl_io_num = scl_gpio,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t err = i2c_new_master_bus(&bus_cfg, &bus);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create I2C bus: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    portENTER_CRITICAL(&lock);
+    for (int i = 0; i < I2C_BUS_DEVICES; i++) {
+        devices[i].handle = NULL;
+        memset(&devices[i].stats, 0, sizeof(devices[i].stats));
+    }
+    queue_peak = 0;
+    portEXIT_CRITICAL(&lock);
+
+    if (queue == NULL) {
+        queue = xQueueCreateStatic(I2C_BUS_QUEUE, sizeof(i2c_bus_txn_t), queue_storage, &queue_buf);
+    }
+    if (stopped_sem == NULL) {
+        stopped_sem = xSemaphoreCreateBinary();
+    }
+    if (queue == NULL || stopped_sem == NULL ||
+        static_task_create(bus_task_slot, bus_task, I2C_BUS_TASK_NAME, I2C_BUS_TASK_STACK_SIZE, NULL,
+                           I2C_BUS_TASK_PRIORITY, &task_handle, TASK_CORE_APP) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the bus task");
+        task_handle = NULL;
+        i2c_del_master_bus(bus);
+        bus = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    running = true;
+    set_metric_provider(METRIC_I2C_BUS_ERRORS, i2c_errors_provider);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_add_device(const char *name, uint8_t address, uint32_t speed_hz, i2c_bus_device_handle_t *dev) {
+    if (name == NULL || dev == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // The same device again continues its counters
+    struct i2c_bus_device *d = NULL;
+    for (int i = 0; i < I2C_BUS_DEVICES && d == NULL; i++) {
+        if (devices[i].handle == NULL && strncmp(devices[i].stats.name, name, I2C_BUS_NAME_LEN - 1) == 0 &&
+            devices[i].stats.address == address) {
+            d = &devices[i];
+        }
+    }
+    for (int i = 0; i < I2C_BUS_DEVICES && d == NULL; i++) {
+        if (devices[i].stats.name[0] == '\0') {
+            d = &devices[i];
+        }
+    }
+    if (d == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (d->done_sem == NULL) {
+        d->done_sem = xSemaphoreCreateBinary();
+        if (d->done_sem == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = address,
+        .scl_speed_hz = speed_hz,
+    };
+    i2c_master_dev_handle_t handle;
+    esp_err_t err = i2c_master_bus_add_device(bus, &dev_cfg, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add %s at 0x%02x: %s", name, address, esp_err_to_name(err));
+        return err;
+    }
+    portENTER_CRITICAL(&lock);
+    d->handle = handle;
+    if (d->stats.name[0] == '\0') {
+        strlcpy(d->stats.name, name, sizeof(d->stats.name));
+        d->stats.address = address;
+    }
+    portEXIT_CRITICAL(&lock);
+    *dev = d;
+    return ESP_OK;
+}
+
+void i2c_bus_remove_device(i2c_bus_device_handle_t dev) {
+    if (dev == NULL || dev->handle == NULL) {
+        return;
+    }
+    i2c_master_bus_rm_device(dev->handle);
+    dev->handle = NULL;
+}
+
+esp_err_t i2c_bus_submit(const i2c_bus_txn_t *txn) {
+    if (txn == NULL || txn->dev == NULL || (txn->tx_len > 0 && txn->tx == NULL) ||
+        (txn->rx_len > 0 && txn->rx == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!running || txn->dev->handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xQueueSend(queue, txn, pdMS_TO_TICKS(I2C_BUS_SUBMIT_WAIT_MS)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    UBaseType_t waiting = uxQueueMessagesWaiting(queue);
+    portENTER_CRITICAL(&lock);
+    if (waiting > queue_peak) {
+        queue_peak = (uint8_t)waiting;
+    }
+    portEXIT_CRITICAL(&lock);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_transfer(void *dev, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len) {
+    struct i2c_bus_device *d = dev;
+    i2c_bus_txn_t txn = {
+        .dev = d,
+        .tx = tx,
+        .tx_len = tx_len,
+        .rx = rx,
+        .rx_len = rx_len,
+        .done = transfer_done,
+        .ctx = d,
+    };
+    if (running && d != NULL && d->handle != NULL && xTaskGetCurrentTaskHandle() == task_handle) {
+        return run(&txn);                       // From a completion callback: waiting would deadlock
+    }
+    esp_err_t err = i2c_bus_submit(&txn);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Every attempt is bounded by I2C_BUS_TIMEOUT_MS, so the bus task always answers
+    xSemaphoreTake(d->done_sem, portMAX_DELAY);
+    return d->result;
+}
+
+void i2c_bus_get_stats(i2c_bus_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    portENTER_CRITICAL(&lock);
+    stats->running = running;
+    stats->queue_peak = queue_peak;
+    for (int i = 0; i < I2C_BUS_DEVICES; i++) {
+        if (devices[i].stats.name[0] != '\0') {
+            stats->device[stats->devices++] = devices[i].stats;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+void i2c_bus_stop(void) {
+    if (!running) {
+        return;
+    }
+    running = false;
+    i2c_bus_txn_t stop = { .dev = NULL };
+    xQueueSend(queue, &stop, portMAX_DELAY);
+    if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(I2C_BUS_STOP_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Bus task did not stop within %d ms - leaving the bus", I2C_BUS_STOP_TIMEOUT_MS);
+        return;
+    }
+    task_handle = NULL;
+    for (int i = 0; i < I2C_BUS_DEVICES; i++) {
+        i2c_bus_remove_device(&devices[i]);
+    }
+    i2c_del_master_bus(bus);
+    bus = NULL;
+}
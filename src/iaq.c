@@ -0,0 +1,428 @@
+/**
+ * @file iaq.c
+ * @brief Indoor air quality from the BME680 gas resistance, through Bosch BSEC, with its state kept across sleep
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "iaq.h"
+#include "flash_io.h"
+#include "node.h"
+#include "version.h"
+#if NODE_BSEC
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_private/esp_clk.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "nvs.h"
+#if !__has_include("bsec_interface.h")
+#error "NODE_BSEC needs Bosch's BSEC library and headers in lib/BSEC (see iaq.h)"
+#endif
+#include "bsec_interface.h"
+#if __has_include(IAQ_BSEC_CONFIG_H)
+#include IAQ_BSEC_CONFIG_H
+#define HAVE_BSEC_CONFIG 1
+#endif
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register iaq.c version
+REGISTER_VERSION(Iaq, "1.0.0", "2026-10-15");
+
+#if NODE_BSEC
+
+static const char *TAG = "IAQ";
+
+#define IAQ_NVS_NAMESPACE "bsec"
+#define IAQ_NVS_KEY "state"
+#define RTC_MAGIC 0x42534543                    // "BSEC"
+
+_Static_assert(BSEC_MAX_STATE_BLOB_SIZE <= IAQ_STATE_MAX, "IAQ_STATE_MAX too small for this BSEC");
+
+/**
+ * @brief What a deep sleep keeps; a power-on or reset zeroes it, and magic then says so
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t len;
+    uint16_t crc;                               // CRC-16 of state[0..len)
+    uint8_t state[IAQ_STATE_MAX];
+    int64_t saved_us;                           // RTC clock when the last NVS save fell due
+    bool nvs_due;                               // state holds a save NVS has not had
+    bool calibrated_saved;                      // The save at accuracy 3 is done
+    int64_t next_us;                            // BSEC's next call, RTC clock
+    iaq_result_t result;
+} iaq_rtc_t;
+
+static RTC_DATA_ATTR iaq_rtc_t rtc;
+static portMUX_TYPE rtc_lock = portMUX_INITIALIZER_UNLOCKED;    // state, len, crc, nvs_due and result
+
+// The sampling task's
+static bool started = false;
+static bool pending = false;                    // iaq_prepare() said due; iaq_process() not yet called
+static int64_t stamp_ns = 0;                    // Time of that iaq_prepare()
+static uint32_t process_data = 0;               // BSEC_PROCESS_* inputs it wants
+static uint8_t work[BSEC_MAX_WORKBUFFER_SIZE];
+
+#endif
+
+// =============================
+// Function Prototypes
+// =============================
+#if NODE_BSEC
+static void restore_state(void);
+static void take_state(bool for_nvs);
+static void apply_heater(bme680_t *sensor, const bsec_bme_settings_t *s);
+static void read_outputs(const bsec_output_t *out, uint8_t n, iaq_result_t *r);
+#endif
+
+// =============================
+// Function Definitions
+// =============================
+#if NODE_BSEC
+
+/**
+ * @brief Hand BSEC the state from RTC memory, or after a power-on or reset from NVS
+ */
+static void restore_state(void) {
+    uint8_t buf[IAQ_STATE_MAX];
+    uint32_t len = 0;
+    const char *from = "RTC memory";
+    if (rtc.magic == RTC_MAGIC && rtc.len <= sizeof(rtc.state) &&
+        esp_rom_crc16_le(0, rtc.state, rtc.len) == rtc.crc) {
+        len = rtc.len;
+        memcpy(buf, rtc.state, len);
+    } else {
+        memset(&rtc, 0, sizeof(rtc));
+        rtc.saved_us = (int64_t)esp_clk_rtc_time();
+        from = "NVS";
+        nvs_handle_t handle;
+        if (nvs_open(IAQ_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+            size_t size = sizeof(buf);
+            if (nvs_get_blob(handle, IAQ_NVS_KEY, buf, &size) == ESP_OK) {
+                len = (uint32_t)size;
+            }
+            nvs_close(handle);
+        }
+    }
+    if (len == 0) {
+        ESP_LOGI(TAG, "No saved BSEC state - calibrating from scratch, which takes hours");
+        return;
+    }
+    bsec_library_return_t rc = bsec_set_state(buf, len, work, sizeof(work));
+    if (rc != BSEC_OK) {
+        ESP_LOGW(TAG, "BSEC state from %s refused (%d) - calibrating from scratch", from, (int)rc);
+        memset(&rtc, 0, sizeof(rtc));
+        return;
+    }
+    ESP_LOGD(TAG, "BSEC state restored from %s (%lu bytes)", from, (unsigned long)len);
+}
+
+/**
+ * @brief Serialize the state into RTC memory, and mark it for NVS
+ */
+static void take_state(bool for_nvs) {
+    uint8_t buf[IAQ_STATE_MAX];
+    uint32_t len = 0;
+    bsec_library_return_t rc = bsec_get_state(0, buf, sizeof(buf), work, sizeof(work), &len);
+    if (rc != BSEC_OK || len == 0 || len > sizeof(buf)) {
+        ESP_LOGW(TAG, "BSEC state not taken: %d", (int)rc);
+        return;
+    }
+    uint16_t crc = esp_rom_crc16_le(0, buf, len);
+    portENTER_CRITICAL(&rtc_lock);
+    memcpy(rtc.state, buf, len);
+    rtc.len = (uint16_t)len;
+    rtc.crc = crc;
+    rtc.magic = RTC_MAGIC;
+    if (for_nvs) {
+        rtc.nvs_due = true;
+    }
+    portEXIT_CRITICAL(&rtc_lock);
+}
+
+/**
+ * @brief Program the heater step BSEC asked for, or turn the heater off; only when it changed
+ */
+static void apply_heater(bme680_t *sensor, const bsec_bme_settings_t *s) {
+    esp_err_t err = ESP_OK;
+    if (s->run_gas) {
+        const bme680_heater_step_t step = { s->heater_temperature, s->heating_duration };
+        if (sensor->heater_count != 1 || sensor->heater[0].temperature_c != step.temperature_c ||
+            sensor->heater[0].duration_ms != step.duration_ms) {
+            err = bme680_set_heater_profile(sensor, &step, 1);
+        }
+    } else if (sensor->heater_count != 0) {
+        err = bme680_set_heater_profile(sensor, NULL, 0);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Heater not set for BSEC: %s", esp_err_to_name(err));
+    }
+}
+
+static void read_outputs(const bsec_output_t *out, uint8_t n, iaq_result_t *r) {
+    for (uint8_t i = 0; i < n; i++) {
+        float v = out[i].signal < 0 ? 0 : out[i].signal;
+        switch (out[i].sensor_id) {
+            case BSEC_OUTPUT_IAQ:
+                r->iaq = (uint16_t)(v * 10 + 0.5f);
+                r->accuracy = out[i].accuracy;
+                r->valid = true;
+                break;
+            case BSEC_OUTPUT_STATIC_IAQ:
+                r->static_iaq = (uint16_t)(v * 10 + 0.5f);
+                break;
+            case BSEC_OUTPUT_CO2_EQUIVALENT:
+                r->co2_ppm = v < 65535 ? (uint16_t)(v + 0.5f) : 65535;
+                break;
+            case BSEC_OUTPUT_BREATH_VOC_EQUIVALENT:
+                r->bvoc_ppb = (uint32_t)(v * 1000 + 0.5f);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+esp_err_t iaq_start(bool duty_cycled) {
+    if (started) {
+        return ESP_OK;
+    }
+    bsec_library_return_t rc = bsec_init();
+#ifdef HAVE_BSEC_CONFIG
+    if (rc == BSEC_OK) {
+        rc = bsec_set_configuration(bsec_config_iaq, sizeof(bsec_config_iaq), work, sizeof(work));
+    }
+#endif
+    if (rc != BSEC_OK) {
+        ESP_LOGE(TAG, "BSEC not started: %d", (int)rc);
+        return ESP_FAIL;
+    }
+    restore_state();
+
+    const float rate = duty_cycled ? BSEC_SAMPLE_RATE_ULP : BSEC_SAMPLE_RATE_LP;
+    const bsec_sensor_configuration_t requested[] = {
+        { rate, BSEC_OUTPUT_IAQ },
+        { rate, BSEC_OUTPUT_STATIC_IAQ },
+        { rate, BSEC_OUTPUT_CO2_EQUIVALENT },
+        { rate, BSEC_OUTPUT_BREATH_VOC_EQUIVALENT },
+    };
+    bsec_sensor_configuration_t required[BSEC_MAX_PHYSICAL_SENSOR];
+    uint8_t n_required = BSEC_MAX_PHYSICAL_SENSOR;
+    rc = bsec_update_subscription(requested, sizeof(requested) / sizeof(requested[0]), required, &n_required);
+    if (rc != BSEC_OK) {
+        ESP_LOGE(TAG, "BSEC outputs not subscribed: %d", (int)rc);
+        return ESP_FAIL;
+    }
+    started = true;
+    pending = false;
+    if (!rtc.result.valid) {
+        bsec_version_t version;
+        bsec_get_version(&version);
+        ESP_LOGI(TAG, "BSEC %u.%u.%u.%u, a sample every %lu s", version.major, version.minor,
+                 version.major_bugfix, version.minor_bugfix,
+                 (unsigned long)((duty_cycled ? IAQ_ULP_PERIOD_MS : IAQ_LP_PERIOD_MS) / 1000));
+    }
+    return ESP_OK;
+}
+
+esp_err_t iaq_prepare(bme680_t *sensor, bool *due) {
+    *due = false;
+    if (!started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    bsec_bme_settings_t s;
+    memset(&s, 0, sizeof(s));
+    int64_t now_ns = (int64_t)esp_clk_rtc_time() * 1000;
+    bsec_library_return_t rc = bsec_sensor_control(now_ns, &s);
+    if (rc < BSEC_OK) {
+        ESP_LOGW(TAG, "BSEC sensor control failed: %d", (int)rc);
+        return ESP_FAIL;
+    } else if (rc != BSEC_OK) {
+        ESP_LOGD(TAG, "BSEC sensor control warning %d", (int)rc);   // Mostly a late call: it still runs
+    }
+    rtc.next_us = s.next_call / 1000;
+    pending = s.trigger_measurement != 0;
+    if (!pending) {
+        return ESP_OK;
+    }
+    stamp_ns = now_ns;
+    process_data = s.process_data;
+    apply_heater(sensor, &s);
+    *due = true;
+    return ESP_OK;
+}
+
+esp_err_t iaq_process(const bme680_reading_t *reading, iaq_result_t *result) {
+    if (!started || !pending) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pending = false;
+
+    bsec_input_t in[BSEC_MAX_PHYSICAL_SENSOR];
+    uint8_t n = 0;
+    memset(in, 0, sizeof(in));
+    if (process_data & BSEC_PROCESS_TEMPERATURE) {
+        in[n].sensor_id = BSEC_INPUT_TEMPERATURE;
+        in[n++].signal = reading->temperature / 100.0f;
+    }
+    if (process_data & BSEC_PROCESS_HUMIDITY) {
+        in[n].sensor_id = BSEC_INPUT_HUMIDITY;
+        in[n++].signal = reading->humidity / 1000.0f;
+    }
+    if (process_data & BSEC_PROCESS_PRESSURE) {
+        in[n].sensor_id = BSEC_INPUT_PRESSURE;
+        in[n++].signal = (float)reading->pressure;
+    }
+    if ((process_data & BSEC_PROCESS_GAS) && reading->gas_valid && reading->heat_stable) {
+        in[n].sensor_id = BSEC_INPUT_GASRESISTOR;
+        in[n++].signal = (float)reading->gas_resistance;
+    }
+    for (uint8_t i = 0; i < n; i++) {
+        in[i].time_stamp = stamp_ns;
+    }
+
+    bsec_output_t out[BSEC_NUMBER_OUTPUTS];
+    uint8_t n_out = BSEC_NUMBER_OUTPUTS;
+    bsec_library_return_t rc = bsec_do_steps(in, n, out, &n_out);
+    if (rc < BSEC_OK) {
+        ESP_LOGW(TAG, "BSEC refused the sample: %d", (int)rc);
+        return ESP_FAIL;
+    }
+
+    iaq_result_t r = rtc.result;
+    read_outputs(out, n_out, &r);
+    if (r.accuracy != rtc.result.accuracy) {
+        ESP_LOGI(TAG, "IAQ accuracy %u -> %u", rtc.result.accuracy, r.accuracy);
+    }
+    ESP_LOGD(TAG, "IAQ %u.%u (accuracy %u), static %u.%u, CO2-eq %u ppm, bVOC %lu ppb", r.iaq / 10, r.iaq % 10,
+             r.accuracy, r.static_iaq / 10, r.static_iaq % 10, r.co2_ppm, (unsigned long)r.bvoc_ppb);
+    portENTER_CRITICAL(&rtc_lock);
+    rtc.result = r;
+    portEXIT_CRITICAL(&rtc_lock);
+
+    // Save points are taken here, in the sampling task; iaq_save() only writes them
+    int64_t now_us = (int64_t)esp_clk_rtc_time();
+    bool calibrated = r.accuracy >= 3 && !rtc.calibrated_saved;
+    if (calibrated || now_us - rtc.saved_us >= (int64_t)IAQ_NVS_SAVE_S * 1000000) {
+        take_state(true);
+        rtc.saved_us = now_us;
+        if (calibrated) {
+            rtc.calibrated_saved = true;
+        }
+    }
+    if (result != NULL) {
+        *result = r;
+    }
+    return ESP_OK;
+}
+
+int64_t iaq_next_us(void) {
+    return rtc.next_us;
+}
+
+void iaq_suspend(void) {
+    if (started) {
+        take_state(false);
+    }
+}
+
+esp_err_t iaq_save(void) {
+    uint8_t buf[IAQ_STATE_MAX];
+    uint16_t len = 0;
+    uint8_t accuracy = 0;
+    portENTER_CRITICAL(&rtc_lock);
+    if (rtc.nvs_due && rtc.magic == RTC_MAGIC) {
+        len = rtc.len;
+        memcpy(buf, rtc.state, len);
+        accuracy = rtc.result.accuracy;
+    }
+    portEXIT_CRITICAL(&rtc_lock);
+    if (len == 0) {
+        return ESP_OK;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(IAQ_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = flash_io_nvs_set_blob(handle, IAQ_NVS_KEY, buf, len);
+        if (err == ESP_OK) {
+            err = flash_io_nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "BSEC state not saved: %s", esp_err_to_name(err));
+        return err;
+    }
+    portENTER_CRITICAL(&rtc_lock);
+    rtc.nvs_due = false;
+    portEXIT_CRITICAL(&rtc_lock);
+    ESP_LOGI(TAG, "BSEC state saved to NVS (%u bytes, accuracy %u)", len, accuracy);
+    return ESP_OK;
+}
+
+esp_err_t iaq_stop(void) {
+    if (!started) {
+        return ESP_OK;
+    }
+    take_state(true);
+    rtc.saved_us = (int64_t)esp_clk_rtc_time();
+    started = false;
+    return iaq_save();
+}
+
+void iaq_get(iaq_result_t *result) {
+    portENTER_CRITICAL(&rtc_lock);
+    *result = rtc.result;
+    portEXIT_CRITICAL(&rtc_lock);
+}
+
+#else
+
+esp_err_t iaq_start(bool duty_cycled) {
+    (void)duty_cycled;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t iaq_prepare(bme680_t *sensor, bool *due) {
+    (void)sensor;
+    *due = false;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t iaq_process(const bme680_reading_t *reading, iaq_result_t *result) {
+    (void)reading;
+    (void)result;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+int64_t iaq_next_us(void) {
+    return 0;
+}
+
+void iaq_suspend(void) {
+}
+
+esp_err_t iaq_save(void) {
+    return ESP_OK;
+}
+
+esp_err_t iaq_stop(void) {
+    return ESP_OK;
+}
+
+void iaq_get(iaq_result_t *result) {
+    *result = (iaq_result_t){ 0 };
+}
+
+#endif
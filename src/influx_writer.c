@@ -0,0 +1,333 @@
+/**
+ * @file influx_writer.c
+ * @brief Gateway InfluxDB writer: node samples as line protocol, POSTed in gzip batches
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "influx_writer.h"
+#include "gzip_writer.h"
+#include "static_mem.h"
+#include "version.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register influx_writer.c version
+REGISTER_VERSION(InfluxWriter, "1.0.0", "2026-10-15");
+static const char *TAG = "INFLUX";
+
+#define STOP_TIMEOUT_MS (INFLUX_TIMEOUT_MS + 1000)  // A POST in progress finishes first
+
+_Static_assert(INFLUX_BATCH_BYTES <= GZIP_INPUT_MAX, "A batch is compressed in one call");
+
+// The open batch belongs to the forwarder task. The send buffer belongs to
+// the forwarder while send_busy is false and to the writer task while it is
+// true; the flag hands it over.
+static char *fill_buf = NULL;
+static size_t fill_len = 0;
+static int64_t fill_opened_us = 0;              // When the open batch got its first line
+static uint8_t *send_buf = NULL;
+static size_t send_len = 0;
+static size_t send_raw_len = 0;                 // Line protocol it holds
+static bool send_gzip = false;
+static volatile bool send_busy = false;
+static volatile bool online = true;
+static gzip_work_t *gzip_work = NULL;
+static esp_http_client_handle_t client = NULL;
+static influx_writer_wake_t wake_fn = NULL;
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(writer_task_slot, INFLUX_WRITER_TASK_STACK_SIZE);
+static volatile bool run = false;
+static influx_writer_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static bool seal(void);
+static int post(void);
+static void writer_task(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Compress the open batch into the send buffer and hand it to the writer task
+ *
+ * @return bool false if the previous batch is still in flight
+ */
+static bool seal(void) {
+    if (send_busy) {
+        return false;
+    }
+    if (fill_len == 0) {
+        return true;
+    }
+    send_gzip = INFLUX_GZIP != 0 && gzip_compress(gzip_work, (const uint8_t *)fill_buf, fill_len, send_buf,
+                                                  INFLUX_BATCH_BYTES, &send_len) == ESP_OK;
+    if (!send_gzip) {
+        memcpy(send_buf, fill_buf, fill_len);   // Incompressible, or gzip off
+        send_len = fill_len;
+    }
+    send_raw_len = fill_len;
+    fill_len = 0;
+    send_busy = true;
+    xTaskNotifyGive(task_handle);
+    return true;
+}
+
+/**
+ * @brief POST the send buffer
+ *
+ * @return int HTTP status, or -1 if there was no answer
+ */
+static int post(void) {
+    esp_http_client_set_post_field(client, (const char *)send_buf, (int)send_len);
+    if (send_gzip) {
+        esp_http_client_set_header(client, "Content-Encoding", "gzip");
+    } else {
+        esp_http_client_delete_header(client, "Content-Encoding");
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = esp_http_client_perform(client);
+    int status = err == ESP_OK ? esp_http_client_get_status_code(client) : -1;
+    portENTER_CRITICAL(&stats_lock);
+    stats.last_status = status > 0 ? status : 0;
+    stats.last_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    portEXIT_CRITICAL(&stats_lock);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "POST failed: %s", esp_err_to_name(err));
+        // The next perform() opens a fresh connection
+        esp_http_client_close(client);
+    }
+    return status;
+}
+
+/**
+ * @brief Send each sealed batch, retrying it until the server takes or refuses it
+ */
+static void writer_task(void *arg) {
+    (void)arg;
+    while (run) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t backoff_ms = INFLUX_RETRY_MIN_MS;
+        while (run && send_busy) {
+            int status = post();
+            bool accepted = status >= 200 && status < 300;
+            bool refused = status >= 400 && status < 500 && status != 408 && status != 429;
+            if (accepted || refused) {
+                portENTER_CRITICAL(&stats_lock);
+                if (accepted) {
+                    stats.batches++;
+                    stats.bytes_raw += send_raw_len;
+                    stats.bytes_sent += send_len;
+                } else {
+                    stats.rejected++;
+                }
+                portEXIT_CRITICAL(&stats_lock);
+                if (refused) {
+                    ESP_LOGW(TAG, "Server refused a batch of %u bytes (HTTP %d); dropped",
+                             (unsigned)send_raw_len, status);
+                }
+                bool was_online = online;
+                online = true;
+                send_busy = false;
+                if (!was_online) {
+                    ESP_LOGI(TAG, "InfluxDB reachable again");
+                }
+                if (wake_fn != NULL) {
+                    wake_fn();
+                }
+                break;
+            }
+
+            portENTER_CRITICAL(&stats_lock);
+            stats.failures++;
+            portEXIT_CRITICAL(&stats_lock);
+            if (online) {
+                ESP_LOGW(TAG, "Batch not accepted (HTTP %d), retrying every %d..%d s", status,
+                         INFLUX_RETRY_MIN_MS / 1000, INFLUX_RETRY_MAX_MS / 1000);
+            }
+            online = false;
+            // A stop cuts the wait short
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(backoff_ms));
+            backoff_ms = backoff_ms * 2 > INFLUX_RETRY_MAX_MS ? INFLUX_RETRY_MAX_MS : backoff_ms * 2;
+        }
+    }
+    task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t influx_writer_init(influx_writer_wake_t wake) {
+    if (task_handle != NULL) {
+        return ESP_OK;
+    }
+    fill_buf = malloc(INFLUX_BATCH_BYTES);
+    send_buf = malloc(INFLUX_BATCH_BYTES);
+    gzip_work = INFLUX_GZIP != 0 ? malloc(sizeof(gzip_work_t)) : NULL;
+    if (fill_buf == NULL || send_buf == NULL || (INFLUX_GZIP != 0 && gzip_work == NULL)) {
+        influx_writer_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_http_client_config_t config = {
+        .url = INFLUX_URL,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = INFLUX_TIMEOUT_MS,
+        .keep_alive_enable = true,
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        .crt_bundle_attach = esp_crt_bundle_attach,
+#endif
+    };
+    client = esp_http_client_init(&config);
+    if (client == NULL) {
+        influx_writer_deinit();
+        return ESP_FAIL;
+    }
+    esp_http_client_set_header(client, "Content-Type", "text/plain; charset=utf-8");
+    if (INFLUX_TOKEN[0] != '\0') {
+        esp_http_client_set_header(client, "Authorization", "Token " INFLUX_TOKEN);
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    fill_len = 0;
+    send_busy = false;
+    online = true;
+    wake_fn = wake;
+    run = true;
+    if (static_task_create(writer_task_slot, writer_task, INFLUX_WRITER_TASK_NAME, INFLUX_WRITER_TASK_STACK_SIZE,
+                           NULL, INFLUX_WRITER_TASK_PRIORITY, &task_handle, TASK_CORE_NET) != pdPASS) {
+        run = false;
+        task_handle = NULL;
+        influx_writer_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Writing to %s in batches of up to %d bytes%s", INFLUX_URL, INFLUX_BATCH_BYTES,
+             INFLUX_GZIP != 0 ? ", gzip" : "");
+    return ESP_OK;
+}
+
+void influx_writer_deinit(void) {
+    if (task_handle != NULL) {
+        run = false;
+        xTaskNotifyGive(task_handle);
+        for (int waited = 0; task_handle != NULL && waited < STOP_TIMEOUT_MS; waited += 10) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        if (task_handle != NULL) {
+            ESP_LOGW(TAG, "Writer task did not stop");
+            return;
+        }
+    }
+    if (client != NULL) {
+        esp_http_client_cleanup(client);
+        client = NULL;
+    }
+    free(fill_buf);
+    free(send_buf);
+    free(gzip_work);
+    fill_buf = NULL;
+    send_buf = NULL;
+    gzip_work = NULL;
+    fill_len = 0;
+    send_busy = false;
+}
+
+size_t influx_writer_room(void) {
+    if (fill_buf == NULL) {
+        return 0;
+    }
+    size_t room = (INFLUX_BATCH_BYTES - fill_len) / INFLUX_LINE_MAX;
+    if (!send_busy) {
+        room += INFLUX_BATCH_BYTES / INFLUX_LINE_MAX;  // Sealing this batch starts an empty one
+    }
+    return room;
+}
+
+esp_err_t influx_writer_publish(uint32_t node_id, const telemetry_record_t *rec) {
+    if (fill_buf == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (fill_len + INFLUX_LINE_MAX > INFLUX_BATCH_BYTES && !seal()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    int t = rec->temperature;
+    char *line = fill_buf + fill_len;
+    size_t cap = INFLUX_BATCH_BYTES - fill_len;
+    int n = snprintf(line, cap, INFLUX_MEASUREMENT ",node=%08lx temperature=%s%d.%02d,pressure=%lui,"
+                     "humidity=%lu.%03lu", (unsigned long)node_id, t < 0 ? "-" : "", abs(t) / 100, abs(t) % 100,
+                     (unsigned long)rec->pressure, (unsigned long)(rec->humidity / 1000),
+                     (unsigned long)(rec->humidity % 1000));
+    if (rec->gas_valid && n > 0 && (size_t)n < cap) {
+        n += snprintf(line + n, cap - n, ",gas=%lui", (unsigned long)rec->gas_resistance);
+    }
+    if (n > 0 && (size_t)n < cap) {
+        n += snprintf(line + n, cap - n, ",seq=%lui %lu\n", (unsigned long)rec->seq, (unsigned long)rec->time_s);
+    }
+    if (n <= 0 || (size_t)n >= cap) {
+        return ESP_ERR_INVALID_SIZE;            // Cannot happen within INFLUX_LINE_MAX
+    }
+
+    if (fill_len == 0) {
+        fill_opened_us = esp_timer_get_time();
+    }
+    fill_len += (size_t)n;
+    portENTER_CRITICAL(&stats_lock);
+    stats.points++;
+    portEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
+void influx_writer_poll(void) {
+    if (fill_len > 0 && esp_timer_get_time() - fill_opened_us >= (int64_t)INFLUX_BATCH_WINDOW_MS * 1000) {
+        seal();
+    }
+}
+
+uint32_t influx_writer_poll_due_ms(void) {
+    // A batch in flight wakes the forwarder when it is done
+    if (fill_len == 0 || send_busy) {
+        return UINT32_MAX;
+    }
+    int64_t age_ms = (esp_timer_get_time() - fill_opened_us) / 1000;
+    return age_ms >= INFLUX_BATCH_WINDOW_MS ? 0 : (uint32_t)(INFLUX_BATCH_WINDOW_MS - age_ms);
+}
+
+void influx_writer_flush(void) {
+    seal();
+}
+
+bool influx_writer_connected(void) {
+    return fill_buf != NULL && online;
+}
+
+bool influx_writer_idle(void) {
+    return fill_len == 0 && !send_busy;
+}
+
+void influx_writer_get_stats(influx_writer_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,380 @@
+/**
+ * @file json_reader.c
+ * @brief Incremental (push) JSON tokenizer with constant memory use
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "json_reader.h"
+#include "version.h"
+#include <stdlib.h>
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register json_reader.c version
+REGISTER_VERSION(JsonReader, "1.0.0", "2026-10-14");
+
+typedef enum {
+    STATE_VALUE,                                // Expecting any value
+    STATE_ARRAY_FIRST,                          // After '[': a value or ']'
+    STATE_OBJECT_FIRST,                         // After '{': a key or '}'
+    STATE_KEY,                                  // After ',' in an object: a key
+    STATE_COLON,                                // After a key: ':'
+    STATE_AFTER_VALUE,                          // After a value: ',' or a closing bracket
+    STATE_STRING,
+    STATE_ESCAPE,
+    STATE_UNICODE,
+    STATE_LITERAL,                              // Inside a number, true, false or null
+    STATE_DONE                                  // Root value complete; only whitespace allowed
+} reader_state_t;
+
+_Static_assert(JSON_READER_MAX_DEPTH <= 16, "array_mask holds one bit per nesting level");
+
+// =============================
+// Function Prototypes
+// =============================
+static bool is_space(char c);
+static bool is_literal_char(char c);
+static bool in_array(const json_reader_t *r);
+static esp_err_t emit(json_reader_t *r, json_event_type_t type, const char *value, size_t len);
+static esp_err_t value_done(json_reader_t *r);
+static esp_err_t token_append(json_reader_t *r, char c);
+static esp_err_t token_append_utf8(json_reader_t *r, uint16_t code);
+static esp_err_t finish_string(json_reader_t *r);
+static esp_err_t finish_literal(json_reader_t *r);
+static esp_err_t open_container(json_reader_t *r, bool is_array);
+static esp_err_t close_container(json_reader_t *r, bool is_array);
+static esp_err_t begin_value(json_reader_t *r, char c);
+static esp_err_t step(json_reader_t *r, char c);
+
+// =============================
+// Function Definitions
+// =============================
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool is_literal_char(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           c == '-' || c == '+' || c == '.';
+}
+
+static bool in_array(const json_reader_t *r) {
+    return r->depth > 0 && (r->array_mask & (1U << (r->depth - 1)));
+}
+
+static esp_err_t emit(json_reader_t *r, json_event_type_t type, const char *value, size_t len) {
+    json_event_t event = {
+        .type = type,
+        .key = (r->has_key && !in_array(r)) ? r->key : NULL,
+        .value = value,
+        .value_len = len,
+        .depth = r->depth
+    };
+    return r->on_event(r->ctx, &event);
+}
+
+/**
+ * @brief Move on after a complete value at the current depth
+ */
+static esp_err_t value_done(json_reader_t *r) {
+    r->has_key = false;
+    r->state = r->depth == 0 ? STATE_DONE : STATE_AFTER_VALUE;
+    return ESP_OK;
+}
+
+static esp_err_t token_append(json_reader_t *r, char c) {
+    if (r->string_is_key) {
+        if (r->key_len + 1 >= sizeof(r->key)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        r->key[r->key_len++] = c;
+    } else {
+        if (r->token_len + 1 >= sizeof(r->token)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        r->token[r->token_len++] = c;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Append a \uXXXX code unit as UTF-8 (unpaired surrogates become '?')
+ */
+static esp_err_t token_append_utf8(json_reader_t *r, uint16_t code) {
+    esp_err_t err;
+    if (code < 0x80) {
+        return token_append(r, (char)code);
+    }
+    if (code >= 0xD800 && code <= 0xDFFF) {
+        return token_append(r, '?');
+    }
+    if (code < 0x800) {
+        err = token_append(r, (char)(0xC0 | (code >> 6)));
+    } else {
+        err = token_append(r, (char)(0xE0 | (code >> 12)));
+        if (err == ESP_OK) {
+            err = token_append(r, (char)(0x80 | ((code >> 6) & 0x3F)));
+        }
+    }
+    if (err == ESP_OK) {
+        err = token_append(r, (char)(0x80 | (code & 0x3F)));
+    }
+    return err;
+}
+
+static esp_err_t finish_string(json_reader_t *r) {
+    if (r->string_is_key) {
+        r->key[r->key_len] = '\0';
+        r->has_key = true;
+        r->string_is_key = false;
+        r->state = STATE_COLON;
+        return ESP_OK;
+    }
+
+    r->token[r->token_len] = '\0';
+    esp_err_t err = emit(r, JSON_EVENT_STRING, r->token, r->token_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return value_done(r);
+}
+
+static esp_err_t finish_literal(json_reader_t *r) {
+    r->token[r->token_len] = '\0';
+
+    json_event_type_t type;
+    if (strcmp(r->token, "true") == 0 || strcmp(r->token, "false") == 0) {
+        type = JSON_EVENT_BOOL;
+    } else if (strcmp(r->token, "null") == 0) {
+        type = JSON_EVENT_NULL;
+    } else {
+        // Anything else must be a complete number
+        char *end = NULL;
+        strtod(r->token, &end);
+        if (r->token_len == 0 || end != r->token + r->token_len ||
+            !(r->token[0] == '-' || (r->token[0] >= '0' && r->token[0] <= '9'))) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        type = JSON_EVENT_NUMBER;
+    }
+
+    esp_err_t err = emit(r, type, r->token, r->token_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return value_done(r);
+}
+
+static esp_err_t open_container(json_reader_t *r, bool is_array) {
+    if (r->depth >= JSON_READER_MAX_DEPTH) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err = emit(r, is_array ? JSON_EVENT_ARRAY_BEGIN : JSON_EVENT_OBJECT_BEGIN, NULL, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    r->depth++;
+    if (is_array) {
+        r->array_mask |= (uint16_t)(1U << (r->depth - 1));
+    } else {
+        r->array_mask &= (uint16_t)~(1U << (r->depth - 1));
+    }
+    r->has_key = false;
+    r->state = is_array ? STATE_ARRAY_FIRST : STATE_OBJECT_FIRST;
+    return ESP_OK;
+}
+
+static esp_err_t close_container(json_reader_t *r, bool is_array) {
+    if (r->depth == 0 || in_array(r) != is_array) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    r->depth--;
+    r->has_key = false;
+    esp_err_t err = emit(r, is_array ? JSON_EVENT_ARRAY_END : JSON_EVENT_OBJECT_END, NULL, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return value_done(r);
+}
+
+/**
+ * @brief Start whatever value begins with character c
+ */
+static esp_err_t begin_value(json_reader_t *r, char c) {
+    if (c == '{') {
+        return open_container(r, false);
+    }
+    if (c == '[') {
+        return open_container(r, true);
+    }
+    if (c == '"') {
+        r->string_is_key = false;
+        r->token_len = 0;
+        r->state = STATE_STRING;
+        return ESP_OK;
+    }
+    if (is_literal_char(c)) {
+        r->token_len = 0;
+        r->state = STATE_LITERAL;
+        return token_append(r, c);
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t step(json_reader_t *r, char c) {
+    switch ((reader_state_t)r->state) {
+        case STATE_STRING:
+            if (c == '"') {
+                return finish_string(r);
+            }
+            if (c == '\\') {
+                r->state = STATE_ESCAPE;
+                return ESP_OK;
+            }
+            if ((unsigned char)c < 0x20) {
+                return ESP_ERR_INVALID_ARG;  // Raw control characters must be escaped
+            }
+            return token_append(r, c);
+
+        case STATE_ESCAPE:
+            r->state = STATE_STRING;
+            switch (c) {
+                case '"':  return token_append(r, '"');
+                case '\\': return token_append(r, '\\');
+                case '/':  return token_append(r, '/');
+                case 'b':  return token_append(r, '\b');
+                case 'f':  return token_append(r, '\f');
+                case 'n':  return token_append(r, '\n');
+                case 'r':  return token_append(r, '\r');
+                case 't':  return token_append(r, '\t');
+                case 'u':
+                    r->state = STATE_UNICODE;
+                    r->unicode_digits = 0;
+                    r->unicode_value = 0;
+                    return ESP_OK;
+                default:
+                    return ESP_ERR_INVALID_ARG;
+            }
+
+        case STATE_UNICODE: {
+            uint8_t nibble;
+            if (c >= '0' && c <= '9') {
+                nibble = (uint8_t)(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                nibble = (uint8_t)(c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                nibble = (uint8_t)(c - 'A' + 10);
+            } else {
+                return ESP_ERR_INVALID_ARG;
+            }
+            r->unicode_value = (uint16_t)((r->unicode_value << 4) | nibble);
+            if (++r->unicode_digits < 4) {
+                return ESP_OK;
+            }
+            r->state = STATE_STRING;
+            return token_append_utf8(r, r->unicode_value);
+        }
+
+        case STATE_LITERAL:
+            if (is_literal_char(c)) {
+                return token_append(r, c);
+            }
+            {
+                esp_err_t err = finish_literal(r);
+                if (err != ESP_OK) {
+                    return err;
+                }
+            }
+            return step(r, c);  // The terminator belongs to the next state
+
+        default:
+            break;
+    }
+
+    if (is_space(c)) {
+        return ESP_OK;
+    }
+
+    switch ((reader_state_t)r->state) {
+        case STATE_VALUE:
+            return begin_value(r, c);
+
+        case STATE_ARRAY_FIRST:
+            if (c == ']') {
+                return close_container(r, true);
+            }
+            return begin_value(r, c);
+
+        case STATE_OBJECT_FIRST:
+            if (c == '}') {
+                return close_container(r, false);
+            }
+            // fall through
+        case STATE_KEY:
+            if (c != '"') {
+                return ESP_ERR_INVALID_ARG;
+            }
+            r->string_is_key = true;
+            r->key_len = 0;
+            r->state = STATE_STRING;
+            return ESP_OK;
+
+        case STATE_COLON:
+            if (c != ':') {
+                return ESP_ERR_INVALID_ARG;
+            }
+            r->state = STATE_VALUE;
+            return ESP_OK;
+
+        case STATE_AFTER_VALUE:
+            if (c == ',') {
+                r->state = in_array(r) ? STATE_VALUE : STATE_KEY;
+                return ESP_OK;
+            }
+            if (c == ']' || c == '}') {
+                return close_container(r, c == ']');
+            }
+            return ESP_ERR_INVALID_ARG;
+
+        case STATE_DONE:
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+}
+
+void json_reader_init(json_reader_t *r, json_event_fn_t on_event, void *ctx) {
+    memset(r, 0, sizeof(*r));
+    r->on_event = on_event;
+    r->ctx = ctx;
+    r->err = on_event != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+    r->state = STATE_VALUE;
+}
+
+esp_err_t json_reader_feed(json_reader_t *r, const char *data, size_t len) {
+    for (size_t i = 0; i < len && r->err == ESP_OK; i++) {
+        r->err = step(r, data[i]);
+    }
+    return r->err;
+}
+
+esp_err_t json_reader_finish(json_reader_t *r) {
+    if (r->err == ESP_OK && r->state == STATE_LITERAL && r->depth == 0) {
+        r->err = finish_literal(r);  // A bare root number has no terminator
+    }
+    if (r->err == ESP_OK && r->state != STATE_DONE) {
+        r->err = ESP_ERR_INVALID_ARG;  // Truncated document
+    }
+    return r->err;
+}
@@ -0,0 +1,304 @@
+/**
+ * @file json_writer.c
+ * @brief Streaming JSON emitter with a fixed scratch buffer
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "json_writer.h"
+#include "version.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register json_writer.c version
+REGISTER_VERSION(JsonWriter, "1.0.0", "2026-10-14");
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+// =============================
+// Function Prototypes
+// =============================
+static void flush_buffer(json_writer_t *w);
+static void put_char(json_writer_t *w, char c);
+static void put_raw(json_writer_t *w, const char *data, size_t len);
+static void put_escaped(json_writer_t *w, const char *value);
+static void begin_value(json_writer_t *w);
+static void open_container(json_writer_t *w, char open);
+static void close_container(json_writer_t *w, char close);
+#ifdef ESP_PLATFORM
+static esp_err_t httpd_flush(void *ctx, const char *data, size_t len);
+#endif
+
+// =============================
+// Function Definitions
+// =============================
+
+static void flush_buffer(json_writer_t *w) {
+    if (w->len > 0 && w->err == ESP_OK) {
+        w->err = w->flush(w->ctx, w->buf, w->len);
+    }
+    w->len = 0;
+}
+
+static void put_char(json_writer_t *w, char c) {
+    if (w->len == sizeof(w->buf)) {
+        flush_buffer(w);
+    }
+    w->buf[w->len++] = c;
+}
+
+static void put_raw(json_writer_t *w, const char *data, size_t len) {
+    while (len > 0 && w->err == ESP_OK) {
+        if (w->len == sizeof(w->buf)) {
+            flush_buffer(w);
+        }
+        size_t room = sizeof(w->buf) - w->len;
+        size_t n = len < room ? len : room;
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief Write a quoted string, escaping quotes, backslashes and control characters
+ */
+static void put_escaped(json_writer_t *w, const char *value) {
+    put_char(w, '"');
+
+    const char *run = value;
+    for (const char *p = value; *p != '\0'; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        // Copy the plain run before this character in one go
+        put_raw(w, run, (size_t)(p - run));
+        run = p + 1;
+
+        char esc[6] = { '\\', 0 };
+        size_t esc_len = 2;
+        switch (c) {
+            case '"':  esc[1] = '"';  break;
+            case '\\': esc[1] = '\\'; break;
+            case '\n': esc[1] = 'n';  break;
+            case '\r': esc[1] = 'r';  break;
+            case '\t': esc[1] = 't';  break;
+            case '\b': esc[1] = 'b';  break;
+            case '\f': esc[1] = 'f';  break;
+            default:
+                esc[1] = 'u';
+                esc[2] = '0';
+                esc[3] = '0';
+                esc[4] = HEX_DIGITS[c >> 4];
+                esc[5] = HEX_DIGITS[c & 0x0F];
+                esc_len = 6;
+                break;
+        }
+        put_raw(w, esc, esc_len);
+    }
+    put_raw(w, run, strlen(run));
+
+    put_char(w, '"');
+}
+
+/**
+ * @brief Emit the separator a new value needs in its container
+ */
+static void begin_value(json_writer_t *w) {
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->depth > 0) {
+        uint32_t bit = 1UL << (w->depth - 1);
+        if (w->has_items & bit) {
+            put_char(w, ',');
+        }
+        w->has_items |= bit;
+    }
+}
+
+static void open_container(json_writer_t *w, char open) {
+    begin_value(w);
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        w->err = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    put_char(w, open);
+    w->depth++;
+    w->has_items &= ~(1UL << (w->depth - 1));
+}
+
+static void close_container(json_writer_t *w, char close) {
+    if (w->depth == 0) {
+        w->err = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    w->depth--;
+    put_char(w, close);
+}
+
+void json_writer_init(json_writer_t *w, json_flush_fn_t flush, void *ctx) {
+    w->len = 0;
+    w->flush = flush;
+    w->ctx = ctx;
+    w->err = flush != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+    w->depth = 0;
+    w->has_items = 0;
+    w->after_key = false;
+}
+
+#ifdef ESP_PLATFORM
+static esp_err_t httpd_flush(void *ctx, const char *data, size_t len) {
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, (ssize_t)len);
+}
+
+void json_writer_init_httpd(json_writer_t *w, httpd_req_t *req) {
+    json_writer_init(w, httpd_flush, req);
+    httpd_resp_set_type(req, "application/json");
+}
+#endif
+
+esp_err_t json_writer_finish(json_writer_t *w) {
+    if (w->err == ESP_OK && w->depth != 0) {
+        w->err = ESP_ERR_INVALID_STATE;  // Unbalanced document; still end the stream below
+    }
+    esp_err_t err = w->err;
+    flush_buffer(w);
+    if (err == ESP_OK) {
+        err = w->err;
+    }
+    if (w->flush != NULL) {
+        esp_err_t end_err = w->flush(w->ctx, NULL, 0);
+        if (err == ESP_OK) {
+            err = end_err;
+        }
+    }
+    return err;
+}
+
+void json_obj_begin(json_writer_t *w) {
+    open_container(w, '{');
+}
+
+void json_obj_end(json_writer_t *w) {
+    close_container(w, '}');
+}
+
+void json_arr_begin(json_writer_t *w) {
+    open_container(w, '[');
+}
+
+void json_arr_end(json_writer_t *w) {
+    close_container(w, ']');
+}
+
+void json_key(json_writer_t *w, const char *key) {
+    begin_value(w);
+    put_escaped(w, key != NULL ? key : "");
+    put_char(w, ':');
+    w->after_key = true;
+}
+
+void json_str(json_writer_t *w, const char *value) {
+    if (value == NULL) {
+        json_null(w);
+        return;
+    }
+    begin_value(w);
+    put_escaped(w, value);
+}
+
+void json_uint(json_writer_t *w, uint64_t value) {
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    begin_value(w);
+    put_raw(w, digits + sizeof(digits) - n, n);
+}
+
+void json_int(json_writer_t *w, int64_t value) {
+    if (value >= 0) {
+        json_uint(w, (uint64_t)value);
+        return;
+    }
+    begin_value(w);
+    put_char(w, '-');
+    w->after_key = true;  // The digits belong to the same value
+    json_uint(w, (uint64_t)(-(value + 1)) + 1);
+}
+
+void json_double(json_writer_t *w, double value, int decimals) {
+    if (isnan(value) || isinf(value)) {
+        json_null(w);
+        return;
+    }
+    char num[32];
+    int len = snprintf(num, sizeof(num), "%.*f", decimals, value);
+    if (len < 0 || len >= (int)sizeof(num)) {
+        json_null(w);
+        return;
+    }
+    begin_value(w);
+    put_raw(w, num, (size_t)len);
+}
+
+void json_bool(json_writer_t *w, bool value) {
+    begin_value(w);
+    if (value) {
+        put_raw(w, "true", 4);
+    } else {
+        put_raw(w, "false", 5);
+    }
+}
+
+void json_null(json_writer_t *w) {
+    begin_value(w);
+    put_raw(w, "null", 4);
+}
+
+void json_hex(json_writer_t *w, const uint8_t *data, size_t len) {
+    begin_value(w);
+    put_char(w, '"');
+    for (size_t i = 0; i < len; i++) {
+        put_char(w, HEX_DIGITS[data[i] >> 4]);
+        put_char(w, HEX_DIGITS[data[i] & 0x0F]);
+    }
+    put_char(w, '"');
+}
+
+void json_kv_str(json_writer_t *w, const char *key, const char *value) {
+    json_key(w, key);
+    json_str(w, value);
+}
+
+void json_kv_int(json_writer_t *w, const char *key, int64_t value) {
+    json_key(w, key);
+    json_int(w, value);
+}
+
+void json_kv_uint(json_writer_t *w, const char *key, uint64_t value) {
+    json_key(w, key);
+    json_uint(w, value);
+}
+
+void json_kv_bool(json_writer_t *w, const char *key, bool value) {
+    json_key(w, key);
+    json_bool(w, value);
+}
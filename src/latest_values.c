@@ -0,0 +1,206 @@
+/**
+ * @file latest_values.c
+ * @brief Gateway per-node latest readings behind a seqlock, for readers that only want the current value
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "latest_values.h"
+#include "version.h"
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register latest_values.c version
+REGISTER_VERSION(LatestValues, "1.0.0", "2026-10-15");
+
+/**
+ * @brief One node; seq is odd while the link task writes the fields after it
+ */
+typedef struct {
+    uint32_t seq;
+    uint32_t node_id;                           // Set before the slot is counted, then fixed
+    uint32_t rx_ms;
+    telemetry_record_t rec;
+} __attribute__((aligned(LATEST_VALUES_ALIGN))) latest_slot_t;
+
+static latest_slot_t slots[LATEST_VALUES_MAX_NODES];
+static uint32_t slot_count = 0;                 // Published with release once the slot holds a reading
+static uint32_t newest = 0;                     // Slot written last
+
+// Written by the link task only
+static uint32_t writes = 0;
+static uint32_t skipped = 0;
+static uint32_t overflows = 0;
+// Written by every reader
+static uint32_t reads = 0;
+static uint32_t retries = 0;
+
+// =============================
+// Function Prototypes
+// =============================
+static void write_slot(latest_slot_t *slot, uint32_t now_ms, const telemetry_record_t *rec);
+static void read_slot(const latest_slot_t *slot, latest_value_t *out);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void write_slot(latest_slot_t *slot, uint32_t now_ms, const telemetry_record_t *rec) {
+    uint32_t seq = slot->seq;
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);                            // Odd before any field changes
+    slot->rx_ms = now_ms;
+    slot->rec = *rec;
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);            // Fields before the even seq
+}
+
+/**
+ * @brief Copy a slot between two equal, even reads of its seq
+ *
+ * The writer may be preempted mid-write by a reader on its own core, so
+ * after LATEST_VALUES_SPINS failed tries the reader sleeps a tick and
+ * lets it finish.
+ */
+static void read_slot(const latest_slot_t *slot, latest_value_t *out) {
+    __atomic_fetch_add(&reads, 1, __ATOMIC_RELAXED);
+    for (uint32_t spins = 1;; spins++) {
+        uint32_t begin = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if ((begin & 1) == 0) {
+            out->node_id = slot->node_id;
+            out->rx_ms = slot->rx_ms;
+            out->rec = slot->rec;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);                    // Copy done before seq is read again
+            if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == begin) {
+                return;
+            }
+        }
+        __atomic_fetch_add(&retries, 1, __ATOMIC_RELAXED);
+        if (spins % LATEST_VALUES_SPINS == 0) {
+            vTaskDelay(1);
+        }
+    }
+}
+
+void latest_values_put(uint32_t node_id, const telemetry_record_t *rec) {
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    uint32_t count = __atomic_load_n(&slot_count, __ATOMIC_RELAXED);
+    uint32_t i = 0;
+    while (i < count && slots[i].node_id != node_id) {
+        i++;
+    }
+
+    if (i == count) {
+        if (count == LATEST_VALUES_MAX_NODES) {
+            __atomic_store_n(&overflows, overflows + 1, __ATOMIC_RELAXED);
+            return;
+        }
+        slots[i].node_id = node_id;
+        write_slot(&slots[i], now_ms, rec);
+        __atomic_store_n(&slot_count, count + 1, __ATOMIC_RELEASE);
+    } else {
+        // Replayed backlog records are older than the reading held; a stale one gives way
+        latest_slot_t *slot = &slots[i];
+        if (rec->time_s < slot->rec.time_s && now_ms - slot->rx_ms < LATEST_VALUES_STALE_MS) {
+            __atomic_store_n(&skipped, skipped + 1, __ATOMIC_RELAXED);
+            return;
+        }
+        write_slot(slot, now_ms, rec);
+    }
+    __atomic_store_n(&newest, i, __ATOMIC_RELAXED);
+    __atomic_store_n(&writes, writes + 1, __ATOMIC_RELAXED);
+}
+
+bool latest_values_get(uint32_t node_id, latest_value_t *out) {
+    uint32_t count = __atomic_load_n(&slot_count, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < count; i++) {
+        if (slots[i].node_id == node_id) {
+            read_slot(&slots[i], out);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool latest_values_newest(latest_value_t *out) {
+    if (__atomic_load_n(&slot_count, __ATOMIC_ACQUIRE) == 0) {
+        return false;
+    }
+    read_slot(&slots[__atomic_load_n(&newest, __ATOMIC_RELAXED)], out);
+    return true;
+}
+
+size_t latest_values_count(void) {
+    return __atomic_load_n(&slot_count, __ATOMIC_ACQUIRE);
+}
+
+bool latest_values_get_nth(size_t n, latest_value_t *out) {
+    if (n >= __atomic_load_n(&slot_count, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    read_slot(&slots[n], out);
+    return true;
+}
+
+void latest_values_get_stats(latest_values_stats_t *stats) {
+    stats->nodes = __atomic_load_n(&slot_count, __ATOMIC_ACQUIRE);
+    stats->writes = __atomic_load_n(&writes, __ATOMIC_RELAXED);
+    stats->skipped = __atomic_load_n(&skipped, __ATOMIC_RELAXED);
+    stats->overflows = __atomic_load_n(&overflows, __ATOMIC_RELAXED);
+    stats->reads = __atomic_load_n(&reads, __ATOMIC_RELAXED);
+    stats->retries = __atomic_load_n(&retries, __ATOMIC_RELAXED);
+}
+
+void latest_values_write_json(json_writer_t *w) {
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    size_t count = latest_values_count();
+    latest_values_stats_t stats;
+    latest_value_t v;
+    char id[9];
+
+    json_obj_begin(w);
+    json_key(w, "nodes");
+    json_arr_begin(w);
+    for (size_t n = 0; n < count && latest_values_get_nth(n, &v); n++) {
+        snprintf(id, sizeof(id), "%08lx", (unsigned long)v.node_id);
+        json_obj_begin(w);
+        json_kv_str(w, "nodeId", id);
+        json_kv_uint(w, "ageMs", now_ms - v.rx_ms);
+        json_kv_uint(w, "seq", v.rec.seq);
+        json_kv_uint(w, "time", v.rec.time_s);
+        json_key(w, "temperature");
+        json_double(w, v.rec.temperature / 100.0, 2);
+        json_key(w, "humidity");
+        json_double(w, v.rec.humidity / 1000.0, 2);
+        json_kv_uint(w, "pressure", v.rec.pressure);
+        json_key(w, "gasResistance");
+        if (v.rec.gas_valid) {
+            json_uint(w, v.rec.gas_resistance);
+        } else {
+            json_null(w);
+        }
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+
+    latest_values_get_stats(&stats);
+    json_key(w, "stats");
+    json_obj_begin(w);
+    json_kv_uint(w, "capacity", LATEST_VALUES_MAX_NODES);
+    json_kv_uint(w, "writes", stats.writes);
+    json_kv_uint(w, "skipped", stats.skipped);
+    json_kv_uint(w, "overflows", stats.overflows);
+    json_kv_uint(w, "reads", stats.reads);
+    json_kv_uint(w, "retries", stats.retries);
+    json_obj_end(w);
+    json_obj_end(w);
+}
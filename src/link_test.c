@@ -0,0 +1,552 @@
+/**
+ * @file link_test.c
+ * @brief Paired ESP-NOW throughput/latency test between two boards
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "link_test.h"
+#include "version.h"
+#include "power_profile.h"
+#include "wifi_ap.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_now.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register link_test.c version
+REGISTER_VERSION(LinkTest, "1.0.0", "2026-10-15");
+
+static const char *TAG = "LINK_TEST";
+
+#define LT_MAGIC 0x544C                         // "LT"
+#define LT_HOME_RATE 0                          // 1M, the ESP-NOW default
+#define LT_HOME_PAYLOAD ESP_NOW_MAX_DATA_LEN
+#define LT_STEP_HOME 0xFF                       // Step id that sends both boards back to the home settings
+#define SENT_OK_BIT (1UL << 0)
+#define SENT_FAIL_BIT (1UL << 1)
+
+typedef enum {
+    LT_HELLO = 1,                               // Initiator, broadcast: looking for a reflector
+    LT_HELLO_ACK,
+    LT_STEP,                                    // Initiator: switch to these settings after acknowledging
+    LT_STEP_ACK,
+    LT_ECHO_REQ,
+    LT_ECHO,
+    LT_FLOOD,                                   // Counted, not answered
+    LT_COUNT_REQ,
+    LT_COUNT,                                   // value = flood frames counted in this step
+} lt_type_t;
+
+/**
+ * @brief Start of every test frame; the rest of the payload is padding up to payload_len
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t type;
+    uint8_t step;
+    uint32_t seq;
+    uint32_t value;
+    uint8_t channel;                            // LT_STEP: the step's settings
+    uint8_t rate;
+    int8_t power;
+    uint8_t reserved;
+    uint16_t payload_len;
+} lt_hdr_t;
+
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    int8_t rssi;
+    int64_t rx_us;
+    lt_hdr_t hdr;
+} rx_item_t;
+
+typedef struct {
+    const char *name;
+    wifi_phy_mode_t mode;
+    wifi_phy_rate_t rate;
+} lt_rate_t;
+
+static const lt_rate_t rates[] = {
+    { "1M", WIFI_PHY_MODE_11B, WIFI_PHY_RATE_1M_L },
+    { "11M", WIFI_PHY_MODE_11B, WIFI_PHY_RATE_11M_L },
+    { "6M", WIFI_PHY_MODE_11G, WIFI_PHY_RATE_6M },
+    { "24M", WIFI_PHY_MODE_11G, WIFI_PHY_RATE_24M },
+    { "MCS0", WIFI_PHY_MODE_HT20, WIFI_PHY_RATE_MCS0_LGI },
+    { "MCS7", WIFI_PHY_MODE_HT20, WIFI_PHY_RATE_MCS7_LGI },
+};
+#define LT_RATE_COUNT (sizeof(rates) / sizeof(rates[0]))
+
+// Sweep values; each is tried with the other three settings at home
+static const uint16_t sweep_sizes[] = { 32, 64, 128, 200, LT_HOME_PAYLOAD };
+static const int8_t sweep_powers[] = { 8, 34, 60, LINK_TEST_HOME_POWER };  // 2, 8.5, 15, 19.5 dBm
+static const uint8_t sweep_channels[] = { LINK_TEST_HOME_CHANNEL, 6, 11 };
+#define LT_ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+#define LT_MAX_STEPS (LT_ARRAY_LEN(sweep_sizes) + LT_RATE_COUNT + LT_ARRAY_LEN(sweep_powers) + \
+                      LT_ARRAY_LEN(sweep_channels))
+
+static const uint8_t broadcast_mac[ESP_NOW_ETH_ALEN] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+
+static bool initiator = false;
+static QueueHandle_t rx_queue = NULL;
+static TaskHandle_t sender_task = NULL;         // Main task; the send callback notifies it
+static uint8_t peer_mac[ESP_NOW_ETH_ALEN];
+static bool have_peer = false;
+static uint8_t tx_frame[ESP_NOW_MAX_DATA_LEN];
+static uint32_t ctrl_seq = 0;
+
+// Settings both boards are on right now
+static uint8_t cur_channel = LINK_TEST_HOME_CHANNEL;
+static uint8_t cur_rate = LT_HOME_RATE;
+static int8_t cur_power = LINK_TEST_HOME_POWER;
+
+// Initiator
+static link_test_step_t steps[LT_MAX_STEPS];
+static size_t step_count = 0;
+static uint32_t rtt_us[LINK_TEST_RTT_FRAMES];
+
+// Reflector
+static uint8_t cur_step = LT_STEP_HOME;
+static uint32_t flood_count = 0;
+
+// =============================
+// Function Prototypes
+// =============================
+static void recv_cb(const esp_now_recv_info_t *info, const uint8_t *data, int len);
+static void send_cb(const uint8_t *mac, esp_now_send_status_t status);
+static esp_err_t add_peer(const uint8_t *mac);
+static esp_err_t apply_settings(uint8_t channel, uint8_t rate, int8_t power);
+static esp_err_t send_frame(const uint8_t *mac, const lt_hdr_t *hdr, uint16_t len);
+static bool wait_frame(uint8_t type, uint32_t seq, uint32_t timeout_ms, rx_item_t *out);
+static bool control(const lt_hdr_t *hdr, uint8_t reply_type, rx_item_t *reply);
+static void build_sweep(void);
+static void find_reflector(void);
+static bool switch_step(uint8_t step, uint8_t channel, uint8_t rate, int8_t power);
+static void run_step(uint8_t index, link_test_step_t *s);
+static int compare_u32(const void *a, const void *b);
+static void log_step(const char *prefix, const link_test_step_t *s);
+static void reflect(const rx_item_t *item);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief WiFi task: queue the header of every test frame
+ */
+static void recv_cb(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
+    rx_item_t item;
+    if (len < (int)sizeof(lt_hdr_t)) {
+        return;
+    }
+    item.rx_us = esp_timer_get_time();
+    memcpy(&item.hdr, data, sizeof(item.hdr));
+    if (item.hdr.magic != LT_MAGIC) {
+        return;
+    }
+    memcpy(item.mac, info->src_addr, ESP_NOW_ETH_ALEN);
+    item.rssi = info->rx_ctrl != NULL ? info->rx_ctrl->rssi : 0;
+    xQueueSend(rx_queue, &item, 0);             // A full queue drops, and that counts as loss
+}
+
+/**
+ * @brief WiFi task: wake the sender with the result
+ */
+static void send_cb(const uint8_t *mac, esp_now_send_status_t status) {
+    (void)mac;
+    if (sender_task != NULL) {
+        xTaskNotify(sender_task, status == ESP_NOW_SEND_SUCCESS ? SENT_OK_BIT : SENT_FAIL_BIT, eSetBits);
+    }
+}
+
+static esp_err_t add_peer(const uint8_t *mac) {
+    esp_now_peer_info_t info = {
+        .channel = 0,                           // Whatever channel the radio is on
+        .ifidx = WIFI_IF_STA,
+        .encrypt = false,
+    };
+    memcpy(info.peer_addr, mac, ESP_NOW_ETH_ALEN);
+    esp_err_t err = esp_now_add_peer(&info);
+    return err == ESP_ERR_ESPNOW_EXIST ? ESP_OK : err;
+}
+
+/**
+ * @brief Move the radio to a step's settings; the rate applies to frames sent to the peer
+ */
+static esp_err_t apply_settings(uint8_t channel, uint8_t rate, int8_t power) {
+    esp_err_t err = ESP_OK;
+    if (channel != cur_channel) {
+        err = esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+    }
+    if (err == ESP_OK && power != cur_power) {
+        err = esp_wifi_set_max_tx_power(power);
+    }
+    if (err == ESP_OK && rate != cur_rate && have_peer) {
+        esp_now_rate_config_t cfg = { .phymode = rates[rate].mode, .rate = rates[rate].rate };
+        err = esp_now_set_peer_rate_config(peer_mac, &cfg);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to switch to channel %u, %s, power %d: %s", channel, rates[rate].name, power,
+                 esp_err_to_name(err));
+        return err;
+    }
+    cur_channel = channel;
+    cur_rate = rate;
+    cur_power = power;
+    return ESP_OK;
+}
+
+/**
+ * @brief Send one frame padded to len and wait for its send callback
+ *
+ * @return esp_err_t ESP_OK when the peer's MAC acknowledged it (always for broadcast),
+ *         ESP_FAIL when it did not, ESP_ERR_TIMEOUT without a callback, or the esp_now_send() error
+ */
+static esp_err_t send_frame(const uint8_t *mac, const lt_hdr_t *hdr, uint16_t len) {
+    if (len < sizeof(lt_hdr_t)) {
+        len = sizeof(lt_hdr_t);
+    }
+    memcpy(tx_frame, hdr, sizeof(lt_hdr_t));
+    ((lt_hdr_t *)tx_frame)->magic = LT_MAGIC;
+
+    uint32_t bits;
+    xTaskNotifyWait(0, SENT_OK_BIT | SENT_FAIL_BIT, &bits, 0);      // Clear a late callback
+    esp_err_t err = esp_now_send(mac, tx_frame, len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (xTaskNotifyWait(0, SENT_OK_BIT | SENT_FAIL_BIT, &bits, pdMS_TO_TICKS(LINK_TEST_SEND_TIMEOUT_MS)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    return (bits & SENT_OK_BIT) ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief Wait for a frame of one type and sequence from the peer, dropping anything else
+ */
+static bool wait_frame(uint8_t type, uint32_t seq, uint32_t timeout_ms, rx_item_t *out) {
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    int64_t left_us;
+    while ((left_us = deadline_us - esp_timer_get_time()) > 0) {
+        TickType_t ticks = pdMS_TO_TICKS((left_us + 999) / 1000);
+        if (xQueueReceive(rx_queue, out, ticks > 0 ? ticks : 1) != pdTRUE) {
+            return false;
+        }
+        if (out->hdr.type == type && out->hdr.seq == seq &&
+            (type == LT_HELLO_ACK || memcmp(out->mac, peer_mac, ESP_NOW_ETH_ALEN) == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Send a control frame until its reply arrives
+ */
+static bool control(const lt_hdr_t *hdr, uint8_t reply_type, rx_item_t *reply) {
+    const uint8_t *dest = hdr->type == LT_HELLO ? broadcast_mac : peer_mac;
+    for (int i = 0; i < LINK_TEST_CTRL_RETRIES; i++) {
+        if (send_frame(dest, hdr, sizeof(lt_hdr_t)) == ESP_OK &&
+            wait_frame(reply_type, hdr->seq, LINK_TEST_CTRL_TIMEOUT_MS, reply)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief One setting at a time away from the home settings, so the sweep stays short
+ */
+static void build_sweep(void) {
+    step_count = 0;
+    for (size_t i = 0; i < LT_ARRAY_LEN(sweep_sizes); i++) {
+        steps[step_count++] = (link_test_step_t){ .channel = LINK_TEST_HOME_CHANNEL, .rate = LT_HOME_RATE,
+                                                  .power = LINK_TEST_HOME_POWER, .payload_len = sweep_sizes[i] };
+    }
+    for (uint8_t r = 0; r < LT_RATE_COUNT; r++) {
+        if (r != LT_HOME_RATE) {
+            steps[step_count++] = (link_test_step_t){ .channel = LINK_TEST_HOME_CHANNEL, .rate = r,
+                                                      .power = LINK_TEST_HOME_POWER, .payload_len = LT_HOME_PAYLOAD };
+        }
+    }
+    for (size_t i = 0; i < LT_ARRAY_LEN(sweep_powers); i++) {
+        if (sweep_powers[i] != LINK_TEST_HOME_POWER) {
+            steps[step_count++] = (link_test_step_t){ .channel = LINK_TEST_HOME_CHANNEL, .rate = LT_HOME_RATE,
+                                                      .power = sweep_powers[i], .payload_len = LT_HOME_PAYLOAD };
+        }
+    }
+    for (size_t i = 0; i < LT_ARRAY_LEN(sweep_channels); i++) {
+        if (sweep_channels[i] != LINK_TEST_HOME_CHANNEL) {
+            steps[step_count++] = (link_test_step_t){ .channel = sweep_channels[i], .rate = LT_HOME_RATE,
+                                                      .power = LINK_TEST_HOME_POWER, .payload_len = LT_HOME_PAYLOAD };
+        }
+    }
+}
+
+/**
+ * @brief Broadcast hellos on the home settings until a reflector answers
+ */
+static void find_reflector(void) {
+    lt_hdr_t hdr = { .type = LT_HELLO };
+    rx_item_t reply;
+    while (true) {
+        hdr.seq = ++ctrl_seq;
+        if (send_frame(broadcast_mac, &hdr, sizeof(hdr)) == ESP_OK &&
+            wait_frame(LT_HELLO_ACK, hdr.seq, LINK_TEST_HELLO_INTERVAL_MS, &reply)) {
+            break;
+        }
+        ESP_LOGD(TAG, "No reflector on channel %u yet", LINK_TEST_HOME_CHANNEL);
+    }
+    memcpy(peer_mac, reply.mac, ESP_NOW_ETH_ALEN);
+    if (add_peer(peer_mac) == ESP_OK) {
+        have_peer = true;
+    }
+    ESP_LOGI(TAG, "Reflector " MACSTR " answered, RSSI %d", MAC2STR(peer_mac), reply.rssi);
+}
+
+/**
+ * @brief Have the reflector acknowledge a step, then follow it there
+ *
+ * If the acknowledgement is lost the reflector may already have switched;
+ * going home and waiting out its idle reset brings both boards back together.
+ */
+static bool switch_step(uint8_t step, uint8_t channel, uint8_t rate, int8_t power) {
+    lt_hdr_t hdr = { .type = LT_STEP, .step = step, .seq = ++ctrl_seq, .channel = channel, .rate = rate,
+                     .power = power };
+    rx_item_t reply;
+    if (!control(&hdr, LT_STEP_ACK, &reply)) {
+        apply_settings(LINK_TEST_HOME_CHANNEL, LT_HOME_RATE, LINK_TEST_HOME_POWER);
+        vTaskDelay(pdMS_TO_TICKS(LINK_TEST_IDLE_RESET_MS + LINK_TEST_CTRL_TIMEOUT_MS));
+        return false;
+    }
+    esp_err_t err = apply_settings(channel, rate, power);
+    vTaskDelay(pdMS_TO_TICKS(LINK_TEST_SETTLE_MS));
+    return err == ESP_OK;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Round trips one at a time, then a flood, on the step's settings
+ */
+static void run_step(uint8_t index, link_test_step_t *s) {
+    if (!switch_step(index, s->channel, s->rate, s->power)) {
+        log_step("skipped", s);
+        return;
+    }
+
+    // Round trips: send one, wait for its echo
+    lt_hdr_t hdr = { .step = index, .payload_len = s->payload_len };
+    rx_item_t item;
+    size_t echoed = 0;
+    int32_t rssi_sum = 0;
+    for (uint32_t i = 0; i < LINK_TEST_RTT_FRAMES; i++) {
+        hdr.type = LT_ECHO_REQ;
+        hdr.seq = i;
+        int64_t start_us = esp_timer_get_time();
+        if (send_frame(peer_mac, &hdr, s->payload_len) == ESP_OK &&
+            wait_frame(LT_ECHO, i, LINK_TEST_RTT_TIMEOUT_MS, &item)) {
+            rtt_us[echoed++] = (uint32_t)(item.rx_us - start_us);
+            rssi_sum += item.rssi;
+        }
+    }
+    s->rtt_lost = (uint16_t)(LINK_TEST_RTT_FRAMES - echoed);
+    if (echoed > 0) {
+        qsort(rtt_us, echoed, sizeof(rtt_us[0]), compare_u32);
+        s->rtt_p50_us = (uint16_t)MIN(rtt_us[(echoed * 50 - 1) / 100], UINT16_MAX);
+        s->rtt_p90_us = (uint16_t)MIN(rtt_us[(echoed * 90 - 1) / 100], UINT16_MAX);
+        s->rtt_p99_us = (uint16_t)MIN(rtt_us[(echoed * 99 - 1) / 100], UINT16_MAX);
+        s->rssi = (int8_t)(rssi_sum / (int32_t)echoed);
+    }
+    xQueueReset(rx_queue);                      // Late echoes
+
+    // Flood: back to back, paced only by the send callback
+    hdr.type = LT_FLOOD;
+    int64_t start_us = esp_timer_get_time();
+    for (uint32_t i = 0; i < LINK_TEST_FLOOD_FRAMES; i++) {
+        hdr.seq = i;
+        if (send_frame(peer_mac, &hdr, s->payload_len) != ESP_OK) {
+            s->mac_failures++;
+        }
+    }
+    uint64_t elapsed_us = (uint64_t)(esp_timer_get_time() - start_us);
+
+    lt_hdr_t req = { .type = LT_COUNT_REQ, .step = index, .seq = ++ctrl_seq };
+    if (!control(&req, LT_COUNT, &item) || elapsed_us == 0) {
+        log_step("no count", s);
+        return;
+    }
+    uint32_t received = MIN(item.hdr.value, LINK_TEST_FLOOD_FRAMES);
+    s->frames_per_s = (uint32_t)(LINK_TEST_FLOOD_FRAMES * 1000000ULL / elapsed_us);
+    s->goodput_kbps = (uint32_t)((uint64_t)received * s->payload_len * 8 * 1000 / elapsed_us);
+    s->lost_permille = (uint16_t)((LINK_TEST_FLOOD_FRAMES - received) * 1000 / LINK_TEST_FLOOD_FRAMES);
+    s->completed = true;
+    log_step("", s);
+}
+
+static void log_step(const char *prefix, const link_test_step_t *s) {
+    if (!s->completed) {
+        ESP_LOGW(TAG, "ch %2u %-4s %2d.%02d dBm %3u B: %s", s->channel, rates[s->rate].name, s->power / 4,
+                 (s->power % 4) * 25, s->payload_len, prefix);
+        return;
+    }
+    ESP_LOGI(TAG,
+             "ch %2u %-4s %2d.%02d dBm %3u B: rtt p50/p90/p99 %u/%u/%u us (%u lost), %lu frames/s, %lu kbit/s, "
+             "%u MAC failures, loss %u.%u%%, RSSI %d",
+             s->channel, rates[s->rate].name, s->power / 4, (s->power % 4) * 25, s->payload_len, s->rtt_p50_us,
+             s->rtt_p90_us, s->rtt_p99_us, s->rtt_lost, (unsigned long)s->frames_per_s,
+             (unsigned long)s->goodput_kbps, s->mac_failures, s->lost_permille / 10, s->lost_permille % 10, s->rssi);
+}
+
+/**
+ * @brief Reflector: answer one frame
+ */
+static void reflect(const rx_item_t *item) {
+    lt_hdr_t hdr = item->hdr;
+    switch (hdr.type) {
+    case LT_HELLO:
+        // A (re)started initiator always calls from the home settings
+        apply_settings(LINK_TEST_HOME_CHANNEL, LT_HOME_RATE, LINK_TEST_HOME_POWER);
+        if (!have_peer || memcmp(peer_mac, item->mac, ESP_NOW_ETH_ALEN) != 0) {
+            memcpy(peer_mac, item->mac, ESP_NOW_ETH_ALEN);
+            have_peer = add_peer(peer_mac) == ESP_OK;
+            ESP_LOGI(TAG, "Initiator " MACSTR ", RSSI %d", MAC2STR(peer_mac), item->rssi);
+        }
+        hdr.type = LT_HELLO_ACK;
+        send_frame(item->mac, &hdr, sizeof(hdr));
+        break;
+    case LT_STEP:
+        hdr.type = LT_STEP_ACK;
+        send_frame(peer_mac, &hdr, sizeof(hdr));
+        if (hdr.step == LT_STEP_HOME) {
+            apply_settings(LINK_TEST_HOME_CHANNEL, LT_HOME_RATE, LINK_TEST_HOME_POWER);
+        } else {
+            apply_settings(hdr.channel, hdr.rate < LT_RATE_COUNT ? hdr.rate : LT_HOME_RATE, hdr.power);
+        }
+        cur_step = hdr.step;
+        flood_count = 0;
+        break;
+    case LT_ECHO_REQ:
+        hdr.type = LT_ECHO;
+        send_frame(peer_mac, &hdr, hdr.payload_len);
+        break;
+    case LT_FLOOD:
+        if (hdr.step == cur_step) {
+            flood_count++;
+        }
+        break;
+    case LT_COUNT_REQ:
+        hdr.type = LT_COUNT;
+        hdr.value = hdr.step == cur_step ? flood_count : 0;
+        send_frame(peer_mac, &hdr, sizeof(hdr));
+        break;
+    default:
+        break;
+    }
+}
+
+esp_err_t link_test_init(bool is_initiator) {
+    initiator = is_initiator;
+    sender_task = xTaskGetCurrentTaskHandle();
+    rx_queue = xQueueCreate(LINK_TEST_RX_QUEUE_LEN, sizeof(rx_item_t));
+    if (rx_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = wifi_espnow_init(LINK_TEST_HOME_CHANNEL);
+    if (err == ESP_OK) {
+        err = esp_now_init();
+    }
+    if (err == ESP_OK) {
+        err = esp_now_register_recv_cb(recv_cb);
+    }
+    if (err == ESP_OK) {
+        err = esp_now_register_send_cb(send_cb);
+    }
+    if (err == ESP_OK) {
+        err = add_peer(broadcast_mac);
+    }
+    if (err == ESP_OK) {
+        err = esp_wifi_set_max_tx_power(LINK_TEST_HOME_POWER);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ESP-NOW start failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Steady clock and no light sleep, so the numbers measure the link and not the power profile
+    power_profile_acquire(POWER_LOCK_CPU);
+    power_profile_acquire(POWER_LOCK_RADIO);
+    if (initiator) {
+        build_sweep();
+    }
+    ESP_LOGI(TAG, "Link test %s on channel %u", initiator ? "initiator" : "reflector", LINK_TEST_HOME_CHANNEL);
+    return ESP_OK;
+}
+
+void link_test_main(void) {
+    if (!initiator) {
+        rx_item_t item;
+        if (xQueueReceive(rx_queue, &item, pdMS_TO_TICKS(LINK_TEST_IDLE_RESET_MS)) == pdTRUE) {
+            reflect(&item);
+        } else if (cur_channel != LINK_TEST_HOME_CHANNEL || cur_rate != LT_HOME_RATE ||
+                   cur_power != LINK_TEST_HOME_POWER) {
+            ESP_LOGD(TAG, "Initiator silent, back to the home settings");
+            apply_settings(LINK_TEST_HOME_CHANNEL, LT_HOME_RATE, LINK_TEST_HOME_POWER);
+            cur_step = LT_STEP_HOME;
+        }
+        return;
+    }
+
+    find_reflector();
+    ESP_LOGI(TAG, "Sweep of %u steps: %u frames round trip, %u flooded per step", (unsigned)step_count,
+             LINK_TEST_RTT_FRAMES, LINK_TEST_FLOOD_FRAMES);
+    for (size_t i = 0; i < step_count; i++) {
+        link_test_step_t *s = &steps[i];
+        *s = (link_test_step_t){ .channel = s->channel, .rate = s->rate, .power = s->power,
+                                 .payload_len = s->payload_len };
+        run_step((uint8_t)i, s);
+    }
+    switch_step(LT_STEP_HOME, LINK_TEST_HOME_CHANNEL, LT_HOME_RATE, LINK_TEST_HOME_POWER);
+
+    const link_test_step_t *best = NULL;
+    for (size_t i = 0; i < step_count; i++) {
+        if (steps[i].completed && steps[i].lost_permille <= LINK_TEST_GOOD_LOSS_PERMILLE &&
+            (best == NULL || steps[i].goodput_kbps > best->goodput_kbps)) {
+            best = &steps[i];
+        }
+    }
+    if (best != NULL) {
+        ESP_LOGI(TAG, "Best goodput with loss under %u.%u%%: ch %u %s %d.%02d dBm %u B, %lu kbit/s",
+                 LINK_TEST_GOOD_LOSS_PERMILLE / 10, LINK_TEST_GOOD_LOSS_PERMILLE % 10, best->channel,
+                 rates[best->rate].name, best->power / 4, (best->power % 4) * 25, best->payload_len,
+                 (unsigned long)best->goodput_kbps);
+    } else {
+        ESP_LOGW(TAG, "No step kept loss under %u.%u%%", LINK_TEST_GOOD_LOSS_PERMILLE / 10,
+                 LINK_TEST_GOOD_LOSS_PERMILLE % 10);
+    }
+    vTaskDelay(pdMS_TO_TICKS(LINK_TEST_PAUSE_MS));
+}
+
+const char *link_test_rate_name(uint8_t rate) {
+    return rate < LT_RATE_COUNT ? rates[rate].name : "?";
+}
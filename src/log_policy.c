@@ -0,0 +1,321 @@
+/**
+ * @file log_policy.c
+ * @brief Per-subsystem runtime log levels and token-bucket rate limiting
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "log_policy.h"
+#include "version.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+#include <strings.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register log_policy.c version
+REGISTER_VERSION(LogPolicy, "1.0.0", "2026-10-14");
+static const char *TAG = "LOG_POLICY";
+
+#define BOOST_CHECK_PERIOD_US (1000 * 1000)
+
+typedef struct {
+    const char *tag;
+    esp_log_level_t default_level;
+    esp_log_level_t level;
+    int64_t boost_until_us;                     // 0 when not boosted
+} policy_slot_t;
+
+// Hot-path chatter in these subsystems logs at DEBUG; the defaults keep it off the UART
+static policy_slot_t policy[] = {
+    { "WEB_SERVER",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "DNS_SERVER",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "METRICS_STREAM", ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ASSET_CACHE",    ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "WEB_ASSETS",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "HTTP_PERF",      ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "CPU_MONITOR",    ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "HEAP_MONITOR",   ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "NET_STATS",      ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "METRIC_HISTORY", ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "COREDUMP",       ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "METRICS_EXPORT", ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "DISCOVERY",      ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "BOOT_TRACE",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "BOOT_HEALTH",    ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "OTA_MANAGER",    ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "OTA_RESUME",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "NVS_UTILS",      ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "CONFIG_SCHEMA",  ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "WIFI_AP",        ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "SYSTEM_METRICS", ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "GATEWAY",        ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "SAMPLER",        ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ULP_MONITOR",    ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ESPNOW",         ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ESPNOW_BATCH",   ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ESPNOW_REL",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ESPNOW_RELAY",   ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ESPNOW_OTA",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "GW_FAILOVER",    ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ESPNOW_CHANNEL", ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ESPNOW_CONFIG",  ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ESPNOW_REKEY",   ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ESPNOW_SLOT",    ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ESPNOW_TIME",    ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "FLASH_BACKLOG",  ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "NODE_TABLE",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "MQTT_FWD",       ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "MQTT_CMD",       ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "HA_DISCOVERY",   ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "POWER",          ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "BENCH",          ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "BENCH_SUITE",    ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "LINK_TEST",      ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "NODE",           ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "BME680",         ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "I2C_BUS",        ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ADC_STREAM",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "MOTION",         ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "GPS",            ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "SENSOR_HAL",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "WIND",           ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "RAIN_GAUGE",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "NMEA",           ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "N2K",            ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "SIGNALK",        ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "TELEM_MCAST",    ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "INFLUX",         ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "SD_ARCHIVE",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "HIST_EXPORT",    ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "BLE_BEACON",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "BLE_CONFIG",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "IAQ",            ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "SERVICE_MGR",    ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "EVENT_LOG",      ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "SYSLOG",         ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "PIPE_TRACE",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "MEM_POLICY",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "OTA_PULL",       ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "HEALTH_WATCH",   ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "NVS_WEAR",       ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "NODE_SIM",       ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "FAULT_INJECT",   ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "CAPTURE",        ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "AGGREGATOR",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "TS_STORE",       ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "STATIC_MEM",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "HTTP_ARENA",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "HTTPS_PORTAL",   ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "SAMPLE_BUS",     ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "TASK_PLAN",      ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "LONG_OP",        ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "INA219",         ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "ICM20948",       ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "MAIN",           ESP_LOG_INFO, ESP_LOG_INFO, 0 },
+    { "httpd_uri",      ESP_LOG_WARN, ESP_LOG_WARN, 0 },
+    { "httpd_txrx",     ESP_LOG_WARN, ESP_LOG_WARN, 0 },
+};
+
+#define POLICY_COUNT (sizeof(policy) / sizeof(policy[0]))
+
+static const char *LEVEL_NAMES[] = { "none", "error", "warn", "info", "debug", "verbose" };
+
+static portMUX_TYPE policy_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t boost_timer = NULL;
+
+// =============================
+// Function Prototypes
+// =============================
+static void boost_timer_cb(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Restore the default level of every expired boost; stops itself when none remain
+ */
+static void boost_timer_cb(void *arg) {
+    (void)arg;
+    int64_t now = esp_timer_get_time();
+    bool any_active = false;
+
+    for (size_t i = 0; i < POLICY_COUNT; i++) {
+        policy_slot_t *slot = &policy[i];
+        bool expired = false;
+
+        taskENTER_CRITICAL(&policy_lock);
+        if (slot->boost_until_us != 0 && now >= slot->boost_until_us) {
+            slot->boost_until_us = 0;
+            slot->level = slot->default_level;
+            expired = true;
+        } else if (slot->boost_until_us != 0) {
+            any_active = true;
+        }
+        taskEXIT_CRITICAL(&policy_lock);
+
+        if (expired) {
+            esp_log_level_set(slot->tag, slot->level);
+            ESP_LOGI(TAG, "%s back to %s", slot->tag, log_policy_level_name(slot->level));
+        }
+    }
+
+    if (!any_active) {
+        esp_timer_stop(boost_timer);
+    }
+}
+
+esp_err_t log_policy_init(void) {
+    for (size_t i = 0; i < POLICY_COUNT; i++) {
+        esp_log_level_set(policy[i].tag, policy[i].default_level);
+    }
+
+    if (boost_timer == NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = boost_timer_cb,
+            .arg = NULL,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "log_boost"
+        };
+        esp_err_t err = esp_timer_create(&timer_args, &boost_timer);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create boost timer: %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    ESP_LOGI(TAG, "Log policy applied to %u subsystems", (unsigned)POLICY_COUNT);
+    return ESP_OK;
+}
+
+esp_err_t log_policy_set_level(const char *tag, esp_log_level_t level, uint32_t duration_s) {
+    if (tag == NULL || level > ESP_LOG_VERBOSE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (duration_s > LOG_POLICY_MAX_BOOST_S) {
+        duration_s = LOG_POLICY_MAX_BOOST_S;
+    }
+
+    bool all = strcmp(tag, LOG_POLICY_ALL_TAGS) == 0;
+    int64_t until = duration_s > 0 ? esp_timer_get_time() + (int64_t)duration_s * 1000000 : 0;
+    bool matched = false;
+
+    for (size_t i = 0; i < POLICY_COUNT; i++) {
+        policy_slot_t *slot = &policy[i];
+        if (!all && strcmp(slot->tag, tag) != 0) {
+            continue;
+        }
+        matched = true;
+
+        taskENTER_CRITICAL(&policy_lock);
+        slot->level = level;
+        slot->boost_until_us = until;
+        if (duration_s == 0) {
+            slot->default_level = level;
+        }
+        taskEXIT_CRITICAL(&policy_lock);
+        esp_log_level_set(slot->tag, level);
+    }
+
+    if (!matched) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (duration_s > 0 && boost_timer != NULL && !esp_timer_is_active(boost_timer)) {
+        esp_timer_start_periodic(boost_timer, BOOST_CHECK_PERIOD_US);
+    }
+
+    ESP_LOGI(TAG, "%s set to %s%s", tag, log_policy_level_name(level),
+             duration_s > 0 ? " temporarily" : "");
+    return ESP_OK;
+}
+
+size_t log_policy_count(void) {
+    return POLICY_COUNT;
+}
+
+esp_err_t log_policy_get(size_t index, log_policy_entry_t *entry) {
+    if (index >= POLICY_COUNT || entry == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL(&policy_lock);
+    const policy_slot_t slot = policy[index];
+    taskEXIT_CRITICAL(&policy_lock);
+
+    entry->tag = slot.tag;
+    entry->default_level = slot.default_level;
+    entry->level = slot.level;
+    entry->boost_remaining_s = 0;
+    if (slot.boost_until_us != 0) {
+        int64_t remaining_us = slot.boost_until_us - esp_timer_get_time();
+        entry->boost_remaining_s = remaining_us > 0 ? (uint32_t)((remaining_us + 999999) / 1000000) : 0;
+    }
+    return ESP_OK;
+}
+
+const char *log_policy_level_name(esp_log_level_t level) {
+    if (level > ESP_LOG_VERBOSE) {
+        return "unknown";
+    }
+    return LEVEL_NAMES[level];
+}
+
+bool log_policy_level_from_name(const char *name, esp_log_level_t *level) {
+    if (name == NULL || level == NULL) {
+        return false;
+    }
+    for (int i = ESP_LOG_NONE; i <= ESP_LOG_VERBOSE; i++) {
+        if (strcasecmp(name, LEVEL_NAMES[i]) == 0) {
+            *level = (esp_log_level_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool log_rate_allow(log_rate_limit_t *bucket, uint32_t *suppressed) {
+    int64_t now = esp_timer_get_time();
+    bool allowed = false;
+
+    taskENTER_CRITICAL(&policy_lock);
+    if (bucket->last_refill_us == 0) {
+        bucket->last_refill_us = now;
+    }
+
+    // Earn whole tokens for the time passed, keeping the remainder for next time
+    int64_t refill_us = (int64_t)bucket->refill_ms * 1000;
+    if (refill_us > 0 && bucket->tokens < bucket->burst) {
+        int64_t earned = (now - bucket->last_refill_us) / refill_us;
+        if (earned > 0) {
+            int64_t tokens = bucket->tokens + earned;
+            bucket->tokens = (uint16_t)(tokens > bucket->burst ? bucket->burst : tokens);
+            bucket->last_refill_us = bucket->tokens == bucket->burst ? now
+                                     : bucket->last_refill_us + earned * refill_us;
+        }
+    } else {
+        bucket->last_refill_us = now;
+    }
+
+    *suppressed = 0;
+    if (bucket->tokens > 0) {
+        bucket->tokens--;
+        *suppressed = bucket->suppressed;
+        bucket->suppressed = 0;
+        allowed = true;
+    } else {
+        bucket->suppressed++;
+    }
+    taskEXIT_CRITICAL(&policy_lock);
+
+    return allowed;
+}
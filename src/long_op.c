@@ -0,0 +1,168 @@
+/**
+ * @file long_op.c
+ * @brief Long flash and filesystem operations in bounded slices that yield and feed the task watchdog
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "long_op.h"
+#include "flash_io.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register long_op.c version
+REGISTER_VERSION(LongOp, "1.0.0", "2026-10-15");
+
+static const char *TAG = "LONG_OP";
+
+#define LONG_OP_SLICE_WARN_MS 200               // A new longest slice above this is logged
+
+static const char *const op_names[LONG_OP_COUNT] = {
+    [LONG_OP_OTA_ERASE] = "ota_erase",
+    [LONG_OP_LOG_ERASE] = "log_erase",
+    [LONG_OP_FILE_LOAD] = "file_load",
+    [LONG_OP_HISTORY_SCAN] = "history_scan",
+};
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static long_op_stats_t stats[LONG_OP_COUNT];
+
+// =============================
+// Function Prototypes
+// =============================
+static void record_slice(long_op_slice_t *s, int64_t now);
+static metric_error_t slices_provider(char *buf, size_t buf_len);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void record_slice(long_op_slice_t *s, int64_t now) {
+    uint32_t slice_us = (uint32_t)(now - s->slice_start_us);
+    bool new_max = false;
+    s->slices++;
+    portENTER_CRITICAL(&stats_lock);
+    stats[s->op].slices++;
+    if (slice_us > stats[s->op].max_slice_us) {
+        stats[s->op].max_slice_us = slice_us;
+        new_max = true;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    if (new_max && slice_us > LONG_OP_SLICE_WARN_MS * 1000) {
+        ESP_LOGW(TAG, "%s held its task %lu ms without yielding", op_names[s->op],
+                 (unsigned long)(slice_us / 1000));
+    }
+}
+
+/**
+ * @brief METRIC_LONG_OP_SLICES: runs and longest slice of each kind that has run
+ */
+static metric_error_t slices_provider(char *buf, size_t buf_len) {
+    long_op_stats_t snap[LONG_OP_COUNT];
+    portENTER_CRITICAL(&stats_lock);
+    memcpy(snap, stats, sizeof(snap));
+    portEXIT_CRITICAL(&stats_lock);
+
+    size_t used = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < LONG_OP_COUNT && used < buf_len; i++) {
+        if (snap[i].runs == 0) {
+            continue;
+        }
+        int n = snprintf(buf + used, buf_len - used, "%s%s %lu runs, max slice %lu ms", used > 0 ? "; " : "",
+                         op_names[i], (unsigned long)snap[i].runs,
+                         (unsigned long)((snap[i].max_slice_us + 999) / 1000));
+        if (n < 0) {
+            break;
+        }
+        used += (size_t)n;
+    }
+    if (used == 0) {
+        snprintf(buf, buf_len, "None yet");
+    }
+    return METRIC_OK;
+}
+
+void long_op_init(void) {
+    set_metric_provider(METRIC_LONG_OP_SLICES, slices_provider);
+}
+
+void long_op_begin(long_op_slice_t *s, long_op_t op) {
+    s->op = op;
+    s->slices = 0;
+    s->run_start_us = esp_timer_get_time();
+    s->slice_start_us = s->run_start_us;
+}
+
+void long_op_step(long_op_slice_t *s) {
+    int64_t now = esp_timer_get_time();
+    if (now - s->slice_start_us < (int64_t)LONG_OP_SLICE_BUDGET_MS * 1000) {
+        return;
+    }
+    record_slice(s, now);
+
+    // Only tasks that subscribed may reset; the idle task is fed by the delay
+    if (esp_task_wdt_status(NULL) == ESP_OK) {
+        esp_task_wdt_reset();
+    }
+    vTaskDelay(1);
+    s->slice_start_us = esp_timer_get_time();
+}
+
+void long_op_end(long_op_slice_t *s) {
+    int64_t now = esp_timer_get_time();
+    record_slice(s, now);
+    uint32_t run_ms = (uint32_t)((now - s->run_start_us) / 1000);
+    portENTER_CRITICAL(&stats_lock);
+    stats[s->op].runs++;
+    if (run_ms > stats[s->op].max_run_ms) {
+        stats[s->op].max_run_ms = run_ms;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    ESP_LOGD(TAG, "%s: %lu ms in %lu slices", op_names[s->op], (unsigned long)run_ms, (unsigned long)s->slices);
+}
+
+esp_err_t long_op_erase(const esp_partition_t *part, size_t offset, size_t len, long_op_t op) {
+    long_op_slice_t s;
+    long_op_begin(&s, op);
+    flash_io_sub_t sub = op == LONG_OP_OTA_ERASE ? FLASH_IO_OTA : FLASH_IO_OTHER;
+    esp_err_t err = ESP_OK;
+    size_t end = offset + len;
+    while (offset < end) {
+        // Up to the next block boundary, so a misaligned start does not split every block after it
+        size_t step = LONG_OP_ERASE_STEP - (offset % LONG_OP_ERASE_STEP);
+        if (step > end - offset) {
+            step = end - offset;
+        }
+        err = flash_io_erase(sub, part, offset, step);
+        if (err != ESP_OK) {
+            break;
+        }
+        offset += step;
+        long_op_step(&s);
+    }
+    long_op_end(&s);
+    return err;
+}
+
+void long_op_get_stats(long_op_t op, long_op_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats[op];
+    portEXIT_CRITICAL(&stats_lock);
+}
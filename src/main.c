@@ -15,23 +15,63 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_system.h"
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "version.h"
+#include "static_mem.h"
+#include "task_plan.h"
+#include "log_policy.h"
+#include "pipeline_trace.h"
+#include "iram_profile.h"
+#include "event_log.h"
 #include "nvs_utils.h"
 #include "wifi_ap.h"
 #include "dns_server.h"
 #include "web_server.h"
+#include "https_portal.h"
+#include "ble_config.h"
+#include "discovery.h"
+#include "service_manager.h"
+#include "asset_cache.h"
+#include "web_assets.h"
 #include "SystemMetrics.h"
+#include "cpu_monitor.h"
+#include "heap_monitor.h"
+#include "flash_io.h"
+#include "nvs_wear.h"
+#include "calib.h"
+#include "mem_policy.h"
+#include "long_op.h"
+#include "http_perf.h"
+#include "net_stats.h"
+#include "metric_history.h"
+#include "health_watch.h"
+#include "coredump.h"
+#include "boot_trace.h"
+#include "boot_health.h"
+#include "power_profile.h"
 #include "gateway.h"
 #include "node.h"
+#include "bench_suite.h"
+#include "link_test.h"
+#include "node_sim.h"
+#include "fault_inject.h"
 
 // =============================
 // Function Prototypes
 // =============================
 static void init_system(void);
 static void init_config_hardware(void);
-static bool wait_for_boot_button(void);
+static void service_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data);
+static bool config_mode_requested(void);
+static void boot_button_isr(void *arg);
+static void boot_button_task(void *arg);
+static void boot_button_arm(void);
+static void init_role_services(uint8_t device_role);
+static uint32_t portal_idle_step(void);
 
 // =============================
 // Constants & Definitions
@@ -40,10 +80,38 @@ static bool wait_for_boot_button(void);
 REGISTER_VERSION(Main, "1.0.0", "2025-10-18");
 static const char *TAG = "MAIN";
 
-// Boot button configuration (GPIO 0 on ESP32 DevKit V1)
-#define BOOT_BUTTON_GPIO GPIO_NUM_0
-#define BOOT_BUTTON_WAIT_TIME_MS 10000  // 10 seconds
-#define BOOT_BUTTON_POLL_INTERVAL_MS 100  // 100ms polling
+// Both bring up their own NimBLE host
+#if BLE_CONFIG && GATEWAY_BLE_BEACON
+#error "BLE_CONFIG and GATEWAY_BLE_BEACON cannot share a build"
+#endif
+
+// A node-only build has no portal for the button to open and no bench role
+#if NODE_MINIMAL && (BLE_CONFIG || BENCH_BUILD)
+#error "NODE_MINIMAL cannot be combined with BLE_CONFIG or BENCH_BUILD"
+#endif
+
+// Boot button configuration (GPIO 0 on ESP32 DevKit V1 and the S3, GPIO 9 on the C3)
+#define BOOT_BUTTON_GPIO NODE_CONFIG_BUTTON_GPIO
+#define BOOT_BUTTON_DEBOUNCE_MS 50        // Button must still be down this long after the edge
+
+// Config mode status log; a service state change wakes the loop sooner
+#define CONFIG_STATUS_PERIOD_MS 30000
+
+// Config mode portal stopped after this long with no station associated and no request; 0 keeps it up
+#ifndef PORTAL_IDLE_TIMEOUT_MS
+#define PORTAL_IDLE_TIMEOUT_MS (10 * 60 * 1000)
+#endif
+
+// Survives esp_restart() (but not power loss): a press during normal boot lands here
+#define CONFIG_REQUEST_MAGIC 0xC0F16B00
+static RTC_NOINIT_ATTR uint32_t config_request;
+static TaskHandle_t boot_button_task_handle = NULL;
+static TaskHandle_t config_main_task = NULL;
+static service_id_t portal_ap_id;
+static bool portal_asleep = false;
+static volatile bool portal_wake = false;       // Set by the boot button in config mode
+static int64_t portal_used_us;                  // Last station seen or request handled
+STATIC_TASK_SLOT(boot_button_slot, BOOT_BUTTON_TASK_STACK_SIZE);
 
 // =============================
 // Function Definitions
@@ -58,8 +126,25 @@ static const char *TAG = "MAIN";
 static void init_system(void) {
     ESP_LOGI(TAG, "Initializing core system components...");
 
+    // Per-subsystem log levels first, so everything after starts quiet
+    if (log_policy_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Log policy unavailable, using build-time levels");
+    }
+    boot_trace_mark("log_policy");
+
+    // Hot paths record binary events; this prints them off the call site
+    if (event_log_start() != ESP_OK) {
+        ESP_LOGW(TAG, "Event log drain unavailable; events are only served over /api/log");
+    }
+    pipeline_trace_init();
+    fault_inject_init();
+
+    // Before anything allocates its large buffers
+    mem_policy_init();
+
     // Initialize NVS storage (required first for SystemMetrics)
     ESP_ERROR_CHECK(nvs_utils_init());
+    boot_trace_mark("nvs");
 
     // Initialize SystemMetrics FIRST (includes boot count tracking)
     // This ensures boot count is updated even if other features are bypassed
@@ -69,21 +154,68 @@ static void init_system(void) {
     } else {
         ESP_LOGI(TAG, "SystemMetrics initialization successful");
     }
+    flash_io_init();
+    nvs_wear_start();
+    calib_load();                               // Before the first wind or supply reading
+    boot_trace_mark("system_metrics");
+
+    // Longest slice of flash erases and file loads; metric history may format its region next
+    long_op_init();
+
+    // The monitors and the history only feed pages and topics a node-only build does not have
+    if (NODE_MINIMAL == 0) {
+        // Per-task CPU profiling feeds the cpu metric group and /api/perf
+        esp_err_t cpu_ret = cpu_monitor_start();
+        if (cpu_ret != ESP_OK) {
+            ESP_LOGW(TAG, "CPU monitor unavailable: %s", esp_err_to_name(cpu_ret));
+        }
+        boot_trace_mark("cpu_monitor");
+
+        // Heap fragmentation and per-task allocation counts for the memory group and /api/heap
+        esp_err_t heap_ret = heap_monitor_start();
+        if (heap_ret != ESP_OK) {
+            ESP_LOGW(TAG, "Heap monitor unavailable: %s", esp_err_to_name(heap_ret));
+        }
+        boot_trace_mark("heap_monitor");
+
+        // Heap/VDD/temperature/RSSI trend log that survives reboots, served at /api/history
+        esp_err_t history_ret = metric_history_start();
+        if (history_ret != ESP_OK) {
+            ESP_LOGW(TAG, "Metric history unavailable: %s", esp_err_to_name(history_ret));
+        }
+        boot_trace_mark("metric_history");
+    }
+
+    // Report a post-mortem left by the last crash; it stays in flash until fetched from /api/coredump
+    coredump_check_boot();
+    boot_trace_mark("coredump");
 
     ESP_LOGI(TAG, "Core system components initialized successfully");
 }
 
 /**
- * @brief Wait for boot button press with timeout
- * 
- * @return true if boot button was pressed within timeout period
- * @return false if timeout occurred without button press
+ * @brief Decide at once, without waiting, whether to enter configuration mode
+ *
+ * Config mode is entered when the previous boot saw a button press and
+ * restarted (RTC flag), when GPIO0 woke the chip from deep sleep, or when
+ * the button is already held down now.
+ *
+ * @return true to enter configuration mode
  */
-static bool wait_for_boot_button(void) {
-    ESP_LOGI(TAG, "Waiting %d seconds for boot button press (GPIO %d)...", 
-             BOOT_BUTTON_WAIT_TIME_MS / 1000, BOOT_BUTTON_GPIO);
-    
-    // Configure boot button GPIO as input with pull-up
+static bool config_mode_requested(void) {
+    // RTC_NOINIT memory holds garbage after power-on; the magic value tells a real request apart
+    bool requested = esp_reset_reason() != ESP_RST_POWERON && config_request == CONFIG_REQUEST_MAGIC;
+    config_request = 0;
+    if (requested) {
+        ESP_LOGI(TAG, "Configuration mode requested before restart");
+        return true;
+    }
+
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0) {
+        ESP_LOGI(TAG, "Woken by boot button");
+        return true;
+    }
+
     gpio_config_t io_conf = {
         .pin_bit_mask = (1ULL << BOOT_BUTTON_GPIO),
         .mode = GPIO_MODE_INPUT,
@@ -92,41 +224,230 @@ static bool wait_for_boot_button(void) {
         .intr_type = GPIO_INTR_DISABLE
     };
     ESP_ERROR_CHECK(gpio_config(&io_conf));
+    if (gpio_get_level(BOOT_BUTTON_GPIO) == 0) {
+        ESP_LOGI(TAG, "Boot button held at boot");
+        return true;
+    }
+    return false;
+}
 
-    // Poll for button press (active LOW)
-    int poll_count = BOOT_BUTTON_WAIT_TIME_MS / BOOT_BUTTON_POLL_INTERVAL_MS;
-    for (int i = 0; i < poll_count; i++) {
-        if (gpio_get_level(BOOT_BUTTON_GPIO) == 0) {
-            ESP_LOGI(TAG, "Boot button pressed! Entering configuration mode...");
-            return true;
+static void IRAM_ATTR boot_button_isr(void *arg) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(boot_button_task_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * @brief Restart into config mode on a debounced press
+ *
+ * The portal is never started in normal operation; this is how it is
+ * reached on demand. With BLE_CONFIG a press opens the BLE configuration
+ * service instead, without a restart, and a press while it is open goes
+ * on to the portal. In config mode a press wakes a portal stopped for
+ * idling. The task sleeps on its notification, so watching costs nothing
+ * between presses.
+ */
+static void boot_button_task(void *arg) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(BOOT_BUTTON_DEBOUNCE_MS));
+        if (gpio_get_level(BOOT_BUTTON_GPIO) == 0 && config_main_task != NULL) {
+            portal_wake = true;
+            xTaskNotifyGive(config_main_task);
+        } else if (gpio_get_level(BOOT_BUTTON_GPIO) == 0) {
+            if (BLE_CONFIG != 0 && !ble_config_is_open()) {
+                esp_err_t err = ble_config_open();
+                if (err == ESP_OK) {
+                    ESP_LOGI(TAG, "Boot button pressed! BLE configuration open; press again for the portal");
+                    continue;
+                }
+                ESP_LOGW(TAG, "BLE configuration unavailable: %s", esp_err_to_name(err));
+            }
+            ESP_LOGI(TAG, "Boot button pressed! Restarting into configuration mode...");
+            config_request = CONFIG_REQUEST_MAGIC;
+            esp_restart();
         }
-        vTaskDelay(pdMS_TO_TICKS(BOOT_BUTTON_POLL_INTERVAL_MS));
     }
+}
 
-    ESP_LOGI(TAG, "Boot button NOT pressed.");
-    return false;
+/**
+ * @brief Watch the boot button by interrupt during normal operation
+ *
+ * Replaces the old 10 s blocking poll: normal boots go straight on, and a
+ * press at any time restarts into config mode.
+ */
+static void boot_button_arm(void) {
+    if (static_task_create(boot_button_slot, boot_button_task, BOOT_BUTTON_TASK_NAME, BOOT_BUTTON_TASK_STACK_SIZE, NULL,
+                           BOOT_BUTTON_TASK_PRIORITY, &boot_button_task_handle, TASK_CORE_NET) != pdPASS) {
+        ESP_LOGW(TAG, "Boot button watch unavailable");
+        return;
+    }
+
+    // The first install sets the service's flags (the rain gauge installs it too); both handlers suit IRAM
+    esp_err_t ret = gpio_install_isr_service(HOT_INTR_FLAGS);
+    if (ret == ESP_OK || ret == ESP_ERR_INVALID_STATE) {
+        gpio_set_intr_type(BOOT_BUTTON_GPIO, GPIO_INTR_NEGEDGE);
+        ret = gpio_isr_handler_add(BOOT_BUTTON_GPIO, boot_button_isr, NULL);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Boot button interrupt unavailable: %s", esp_err_to_name(ret));
+    }
+    ESP_LOGI(TAG, "Press the boot button (GPIO %d) for %s", BOOT_BUTTON_GPIO,
+             config_main_task != NULL ? "the portal" : BLE_CONFIG != 0 ? "BLE configuration" : "configuration mode");
+}
+
+/**
+ * @brief Bring up only what the role needs in normal operation
+ *
+ * Nodes start no networking here: their ESP-NOW link belongs to node_init().
+ * The gateway joins the bridge uplink as a plain station for its MQTT and
+ * ESP-NOW traffic. SPIFFS, the AP, DNS and httpd stay down in both roles;
+ * the portal is reached by a boot button press.
+ *
+ * @param device_role DEVICE_ROLE_GATEWAY or DEVICE_ROLE_RESPONDER
+ */
+static void init_role_services(uint8_t device_role) {
+    if (device_role != DEVICE_ROLE_GATEWAY) {
+        return;
+    }
+
+    wifi_set_profile(GATEWAY_WIFI_LOW_POWER != 0 ? WIFI_PROFILE_LOW_POWER : WIFI_PROFILE_PORTAL_FAST);
+    esp_err_t ret = wifi_sta_init();
+    boot_trace_mark("wifi_sta");
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Gateway uplink unavailable: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    // Per-interface traffic counters for the wifi metrics
+    ret = net_stats_start();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Network counters unavailable: %s", esp_err_to_name(ret));
+    }
+    boot_trace_mark("net_stats");
+
+    // Alarms on heap, temperature, supply and stacks; MQTT once gateway_init() sets the publisher
+    ret = health_watch_start();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Health watch unavailable: %s", esp_err_to_name(ret));
+    }
+}
+
+/**
+ * @brief Stop the portal after PORTAL_IDLE_TIMEOUT_MS unused, and bring it back on a boot button press
+ *
+ * Used means a station associated to the AP or a request handled by
+ * httpd. Stopping the AP service takes the services that need it down
+ * first (mDNS, httpd, DNS, the traffic counters), and with it the radio,
+ * the WiFi driver's buffers and the httpd and DNS tasks. SPIFFS and the
+ * asset cache stay, so the portal comes back in the time the AP takes.
+ *
+ * @return ms until the next check is due
+ */
+static uint32_t portal_idle_step(void) {
+    int64_t now = esp_timer_get_time();
+    if (portal_asleep) {
+        if (!portal_wake) {
+            return CONFIG_STATUS_PERIOD_MS;
+        }
+        portal_wake = false;
+        ESP_LOGI(TAG, "Boot button pressed, starting the portal again");
+        esp_err_t ret = service_manager_start_all();
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Configuration services failed to start: %s - rebooting...", esp_err_to_name(ret));
+            vTaskDelay(pdMS_TO_TICKS(5000));
+            esp_restart();
+        }
+        portal_asleep = false;
+        portal_used_us = esp_timer_get_time();
+        return PORTAL_IDLE_TIMEOUT_MS;
+    }
+
+    // A press while the portal is up just starts the count again
+    int64_t last_request = http_perf_last_request_us();
+    if (portal_wake || wifi_ap_station_count() > 0) {
+        portal_wake = false;
+        portal_used_us = now;
+    } else if (last_request > portal_used_us) {
+        portal_used_us = last_request;
+    }
+    int64_t idle_ms = (now - portal_used_us) / 1000;
+    if (idle_ms < PORTAL_IDLE_TIMEOUT_MS) {
+        return (uint32_t)(PORTAL_IDLE_TIMEOUT_MS - idle_ms);
+    }
+
+    ESP_LOGI(TAG, "Portal unused for %lu s, stopping it; press the boot button to start it again",
+             (unsigned long)(idle_ms / 1000));
+    esp_err_t ret = service_manager_stop(portal_ap_id);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Portal not stopped: %s", esp_err_to_name(ret));
+        portal_used_us = now;                   // Try again after another timeout, not on every wake
+        return PORTAL_IDLE_TIMEOUT_MS;
+    }
+    portal_asleep = true;
+    ESP_LOGI(TAG, "Portal stopped, %lu bytes free", (unsigned long)esp_get_free_heap_size());
+    return CONFIG_STATUS_PERIOD_MS;
+}
+
+/**
+ * @brief A config mode service changed state: wake the main loop to re-check the health pass
+ */
+static void service_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    (void)arg;
+    (void)base;
+    (void)id;
+    (void)data;
+    if (config_main_task != NULL) {
+        xTaskNotifyGive(config_main_task);
+    }
 }
 
 /**
  * @brief Initialize configuration hardware components (WiFi AP, DNS, Web server)
  * 
- * Initializes components needed for configuration mode: SPIFFS filesystem,
- * WiFi Access Point, DNS server, and HTTP web server.
+ * Registers the components needed for configuration mode with the service
+ * manager, which starts them in dependency order: the SPIFFS mount and the
+ * WiFi Access Point side by side, then the DNS server, the web server and
+ * the optional network counters and mDNS once the AP is up.
  */
 static void init_config_hardware(void) {
     ESP_LOGI(TAG, "Initializing configuration hardware components...");
+    wifi_set_profile(WIFI_AP_PROFILE);
+
+    // SPIFFS mounts on a background task; asset requests wait for it
+    const service_def_t spiffs = { .name = "spiffs", .start = web_server_init_spiffs };
+    const service_def_t ap = { .name = "wifi_ap", .start = wifi_ap_init, .stop = wifi_ap_stop };
+    service_id_t spiffs_id, ap_id, id;
+    ESP_ERROR_CHECK(service_manager_add(&spiffs, &spiffs_id));
+    ESP_ERROR_CHECK(service_manager_add(&ap, &ap_id));
+    portal_ap_id = ap_id;
+
+    // Everything else serves on the AP
+    const service_def_t on_ap[] = {
+        // Per-interface traffic counters for the wifi metrics and /api/perf
+        { .name = "net_stats", .start = net_stats_start, .stop = net_stats_stop, .depends = SERVICE_DEP(ap_id),
+          .optional = true },
+        // Captive portal DNS
+        { .name = "dns_server", .start = dns_server_start, .stop = dns_server_stop, .depends = SERVICE_DEP(ap_id) },
+        { .name = "web_server", .start = web_server_start, .stop = web_server_stop, .depends = SERVICE_DEP(ap_id) },
+        // Advertise weatherstation.local and its services over mDNS
+        { .name = "discovery", .start = discovery_start, .stop = discovery_stop, .depends = SERVICE_DEP(ap_id),
+          .optional = true },
+    };
+    for (size_t i = 0; i < sizeof(on_ap) / sizeof(on_ap[0]); i++) {
+        ESP_ERROR_CHECK(service_manager_add(&on_ap[i], &id));
+    }
 
-    // Initialize SPIFFS file system
-    ESP_ERROR_CHECK(web_server_init_spiffs());
-
-    // Initialize WiFi Access Point
-    ESP_ERROR_CHECK(wifi_ap_init());
-
-    // Start DNS server for captive portal
-    ESP_ERROR_CHECK(dns_server_start());
-
-    // Start HTTP web server
-    ESP_ERROR_CHECK(web_server_start());
+    config_main_task = xTaskGetCurrentTaskHandle();
+    esp_err_t ret = service_manager_start_all();
+    boot_trace_mark("services");
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Configuration services failed to start: %s - rebooting...", esp_err_to_name(ret));
+        vTaskDelay(pdMS_TO_TICKS(5000));  // Wait 5 seconds before reboot
+        esp_restart();
+    }
+    // The loop created by the manager; later state changes wake the config mode loop
+    ESP_ERROR_CHECK(esp_event_handler_register(SERVICE_EVENT, SERVICE_EVENT_STATE, service_event_handler, NULL));
 
     ESP_LOGI(TAG, "All configuration hardware components initialized successfully");
 }
@@ -135,39 +456,97 @@ static void init_config_hardware(void) {
 // ESP-IDF Entry Point
 // =============================
 void app_main(void) {
+    // Checkpoints from here on land in RTC memory and /api/boot
+    boot_trace_start();
+    power_profile_boot();
+
+    // A duty-cycled node waking for one sample goes back to sleep from here, before the full boot
+    node_duty_cycle_wake();
     ESP_LOGI(TAG, "ESP32 Access Point + Captive Portal starting...");
     
     // Print project version information
     print_version_info();
+    boot_trace_mark("version_info");
 
     // Initialize core system components (always required)
     init_system();
 
-    // Wait for boot button press to determine execution path
-    if (wait_for_boot_button()) {
+    // The [env:bench] firmware runs its suite instead of a role and then idles
+    if (BENCH_BUILD != 0) {
+        boot_trace_done();
+        boot_health_start(0);
+        bench_suite_run();
+        while (1) {
+            vTaskDelay(portMAX_DELAY);
+        }
+    }
+
+    // Decide the execution path without waiting; a later press restarts into config mode.
+    // A node-only build has no config mode, so none of the portal is linked.
+    bool config_mode = NODE_MINIMAL == 0 && config_mode_requested();
+    boot_trace_mark("mode_select");
+    if (config_mode) {
         // Boot button was pressed - enter configuration mode
         ESP_LOGI(TAG, "Entering configuration mode...");
         
         // Initialize configuration hardware components
+        power_profile_apply(POWER_PROFILE_CONFIG);
         init_config_hardware();
+        if (health_watch_start() != ESP_OK) {
+            ESP_LOGW(TAG, "Health watch unavailable");
+        }
+        boot_trace_done();
+        task_plan_check();
+        boot_health_start(BOOT_HEALTH_SERVICES);
 
         ESP_LOGI(TAG, "=== Configuration Mode Ready ===");
         ESP_LOGI(TAG, "WiFi AP: %s", AP_SSID);
         ESP_LOGI(TAG, "IP Address: 192.168.4.1");
-        ESP_LOGI(TAG, "Web Interface: http://192.168.4.1/");
+        ESP_LOGI(TAG, "Web Interface: %s://192.168.4.1/", HTTPS_PORTAL != 0 ? "https" : "http");
         ESP_LOGI(TAG, "DNS Server: Running on port 53");
-        ESP_LOGI(TAG, "HTTP Server: Running on port 80");
+        ESP_LOGI(TAG, "HTTP Server: Running on port %d%s", HTTPS_PORTAL != 0 ? HTTPS_PORTAL_PORT : WEB_SERVER_PORT,
+                 HTTPS_PORTAL != 0 ? " (TLS)" : "");
         ESP_LOGI(TAG, "=====================================");
 
+        // The button wakes the portal once it has stopped for idling
+        portal_used_us = esp_timer_get_time();
+        if (PORTAL_IDLE_TIMEOUT_MS != 0) {
+            boot_button_arm();
+        }
+
         // Main configuration mode loop (keep alive)
+        TickType_t status_at = xTaskGetTickCount();
+        bool first = true;
         while (1) {
+            // Services report their state changes; one going down withholds the health pass
+            if (service_manager_all_running()) {
+                boot_health_pass(BOOT_HEALTH_SERVICES);
+            }
+            uint32_t wait_ms = CONFIG_STATUS_PERIOD_MS;
+            if (PORTAL_IDLE_TIMEOUT_MS != 0) {
+                uint32_t idle_ms = portal_idle_step();
+                wait_ms = idle_ms < wait_ms ? idle_ms : wait_ms;
+            }
+
             // Log system status every 30 seconds
-            ESP_LOGI(TAG, "System status - WiFi AP: %s, DNS: %s, Web: %s",
-                    wifi_ap_is_running() ? "Running" : "Stopped",
-                    dns_server_is_running() ? "Running" : "Stopped",
-                    web_server_is_running() ? "Running" : "Stopped");
+            if (first || xTaskGetTickCount() - status_at >= pdMS_TO_TICKS(CONFIG_STATUS_PERIOD_MS)) {
+                first = false;
+                status_at = xTaskGetTickCount();
+                asset_cache_stats_t cache_stats;
+                asset_cache_get_stats(&cache_stats);
+                ESP_LOGI(TAG, "Asset cache - %lu hits, %lu misses, %lu files, %zu/%zu bytes",
+                        (unsigned long)cache_stats.hits, (unsigned long)cache_stats.misses,
+                        (unsigned long)cache_stats.entries, cache_stats.bytes_used, cache_stats.budget_bytes);
+                if (WEB_EMBED_ASSETS != 0) {
+                    web_assets_stats_t embed_stats;
+                    web_assets_get_stats(&embed_stats);
+                    ESP_LOGI(TAG, "Embedded assets - %lu served, %lu of %lu overridden by the filesystem",
+                            (unsigned long)embed_stats.served, (unsigned long)embed_stats.overridden,
+                            (unsigned long)embed_stats.assets);
+                }
+            }
 
-            vTaskDelay(pdMS_TO_TICKS(30000));  // 30 seconds
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
         }
         
         // Note: If we ever exit the loop, reboot the system
@@ -177,33 +556,79 @@ void app_main(void) {
     } else {
         // Boot button was NOT pressed - normal operation mode
         ESP_LOGI(TAG, "Boot button NOT pressed - entering normal operation mode");
-
-        // Always initialize configuration hardware for web interface access
-        init_config_hardware();
+        if (NODE_MINIMAL == 0) {
+            boot_button_arm();
+        }
 
         // Now check device role and fork main processing logic
         ESP_LOGI(TAG, "Checking device role for main processing logic...");
 
-        // Load device role from NVS
+        // Load device role from the config cache
         uint8_t device_role = DEVICE_ROLE_RESPONDER; // Default fallback
-        if (nvs_load_device_role(&device_role) != ESP_OK) {
+        device_config_t cfg;
+        if (NODE_MINIMAL != 0) {
+            // The only role a node-only build has; the others are not linked
+            ESP_LOGI(TAG, "Node-only build");
+        } else if (nvs_config_get(&cfg) == ESP_OK) {
+            device_role = cfg.device_role;
+        } else {
             ESP_LOGW(TAG, "Failed to load device role, using default (Responder)");
-            device_role = DEVICE_ROLE_RESPONDER;
         }
 
+        // Role-specific boot profile; the configuration portal is not started
+        bool link_test = device_role == DEVICE_ROLE_LINK_TEST_TX || device_role == DEVICE_ROLE_LINK_TEST_RX;
+        bool always_on = device_role == DEVICE_ROLE_GATEWAY || link_test || device_role == DEVICE_ROLE_NODE_SIM;
+        if (device_role == DEVICE_ROLE_GATEWAY && GATEWAY_SLOT_SLEEP != 0) {
+            power_profile_apply(POWER_PROFILE_GATEWAY_SLOTTED);
+        } else {
+            power_profile_apply(always_on ? POWER_PROFILE_GATEWAY : POWER_PROFILE_NODE);
+        }
+        if (NODE_MINIMAL == 0) {
+            init_role_services(device_role);
+        }
+        boot_trace_done();
+
         // Fork main processing logic based on device role
-        if (device_role == DEVICE_ROLE_GATEWAY) {
+        if (link_test) {
+            ESP_LOGI(TAG, "Device role: ESP-NOW link test %s", device_role == DEVICE_ROLE_LINK_TEST_TX ?
+                     "initiator" : "reflector");
+            if (link_test_init(device_role == DEVICE_ROLE_LINK_TEST_TX) == ESP_OK) {
+                task_plan_check();
+                boot_health_start(0);
+                while (1) {
+                    link_test_main();
+                }
+            } else {
+                ESP_LOGE(TAG, "Link test initialization failed - rebooting...");
+                vTaskDelay(pdMS_TO_TICKS(5000));  // Wait 5 seconds before reboot
+                esp_restart();
+            }
+
+        } else if (device_role == DEVICE_ROLE_NODE_SIM) {
+            ESP_LOGI(TAG, "Device role: node simulator");
+            if (node_sim_init() == ESP_OK) {
+                task_plan_check();
+                while (1) {
+                    node_sim_main();
+                }
+            } else {
+                ESP_LOGE(TAG, "Node simulator initialization failed - rebooting...");
+                vTaskDelay(pdMS_TO_TICKS(5000));  // Wait 5 seconds before reboot
+                esp_restart();
+            }
+
+        } else if (device_role == DEVICE_ROLE_GATEWAY) {
             ESP_LOGI(TAG, "Device role: Gateway - initializing gateway mode...");
             ESP_LOGI(TAG, "=== Gateway Mode Starting ===");
 
             // Initialize gateway functionality
             if (gateway_init() == ESP_OK) {
                 ESP_LOGI(TAG, "Gateway initialization successful");
+                task_plan_check();
 
-                // Main gateway processing loop
+                // Main gateway processing loop: the forwarder, which sleeps until there is work
                 while (1) {
                     gateway_main();
-                    vTaskDelay(pdMS_TO_TICKS(1000));  // 1 second delay between iterations
                 }
             } else {
                 ESP_LOGE(TAG, "Gateway initialization failed - rebooting...");
@@ -219,10 +644,15 @@ void app_main(void) {
             if (node_init() == ESP_OK) {
                 ESP_LOGI(TAG, "Node initialization successful");
 
+                // Battery nodes send the buffered batch and go back to deep sleep here
+                node_sleep_if_duty_cycled();
+                task_plan_check();
+
                 // Main node processing loop
+                // Sampling runs on its own timer; this loop only reports on it
                 while (1) {
+                    vTaskDelay(pdMS_TO_TICKS(NODE_MAIN_INTERVAL_MS));
                     node_main();
-                    vTaskDelay(pdMS_TO_TICKS(1000));  // 1 second delay between iterations
                 }
             } else {
                 ESP_LOGE(TAG, "Node initialization failed - rebooting...");
@@ -0,0 +1,106 @@
+/**
+ * @file mem_policy.c
+ * @brief Capability-aware allocation: large buffers in PSRAM when the board has it, internal RAM otherwise
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "mem_policy.h"
+#include "version.h"
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register mem_policy.c version
+REGISTER_VERSION(MemPolicy, "1.0.0", "2026-10-15");
+
+static const char *TAG = "MEM_POLICY";
+
+#define PSRAM_CAPS (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define INTERNAL_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+static bool psram_present = false;
+
+// Bumped by whichever task allocates
+static uint32_t bulk_psram_allocs = 0;
+static uint32_t bulk_psram_bytes = 0;
+static uint32_t bulk_internal_allocs = 0;
+static uint32_t bulk_internal_bytes = 0;
+static uint32_t fallbacks = 0;
+
+// =============================
+// Function Definitions
+// =============================
+
+esp_err_t mem_policy_init(void) {
+    // Zero without CONFIG_SPIRAM, or when the chip did not answer at boot
+    size_t total = heap_caps_get_total_size(MALLOC_CAP_SPIRAM);
+    psram_present = total > 0;
+    if (psram_present) {
+        ESP_LOGI(TAG, "PSRAM: %zu KB, large buffers go there", total / 1024);
+    } else {
+        ESP_LOGI(TAG, "No PSRAM, large buffers stay in internal RAM");
+    }
+    return ESP_OK;
+}
+
+bool mem_policy_psram(void) {
+    return psram_present;
+}
+
+void *mem_policy_malloc(mem_class_t cls, size_t size) {
+    if (cls == MEM_INTERNAL) {
+        return heap_caps_malloc(size, INTERNAL_CAPS);
+    }
+
+    if (psram_present) {
+        void *p = heap_caps_malloc(size, PSRAM_CAPS);
+        if (p != NULL) {
+            __atomic_fetch_add(&bulk_psram_allocs, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&bulk_psram_bytes, (uint32_t)size, __ATOMIC_RELAXED);
+            return p;
+        }
+        __atomic_fetch_add(&fallbacks, 1, __ATOMIC_RELAXED);
+        ESP_LOGW(TAG, "PSRAM full, %zu bytes from internal RAM", size);
+    }
+    void *p = heap_caps_malloc(size, INTERNAL_CAPS);
+    if (p != NULL) {
+        __atomic_fetch_add(&bulk_internal_allocs, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&bulk_internal_bytes, (uint32_t)size, __ATOMIC_RELAXED);
+    }
+    return p;
+}
+
+void *mem_policy_calloc(mem_class_t cls, size_t n, size_t size) {
+    if (size != 0 && n > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *p = mem_policy_malloc(cls, n * size);
+    if (p != NULL) {
+        memset(p, 0, n * size);
+    }
+    return p;
+}
+
+bool mem_policy_pin_taken(int gpio) {
+    return psram_present && (gpio == MEM_POLICY_PSRAM_CS_GPIO || gpio == MEM_POLICY_PSRAM_CLK_GPIO);
+}
+
+void mem_policy_get_stats(mem_policy_stats_t *stats) {
+    stats->psram = psram_present;
+    stats->psram_total = (uint32_t)heap_caps_get_total_size(MALLOC_CAP_SPIRAM);
+    stats->psram_free = (uint32_t)heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    stats->bulk_psram_allocs = __atomic_load_n(&bulk_psram_allocs, __ATOMIC_RELAXED);
+    stats->bulk_psram_bytes = __atomic_load_n(&bulk_psram_bytes, __ATOMIC_RELAXED);
+    stats->bulk_internal_allocs = __atomic_load_n(&bulk_internal_allocs, __ATOMIC_RELAXED);
+    stats->bulk_internal_bytes = __atomic_load_n(&bulk_internal_bytes, __ATOMIC_RELAXED);
+    stats->fallbacks = __atomic_load_n(&fallbacks, __ATOMIC_RELAXED);
+}
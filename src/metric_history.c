@@ -0,0 +1,415 @@
+/**
+ * @file metric_history.c
+ * @brief Fixed-record ring log of key metrics in a dedicated flash partition
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "metric_history.h"
+#include "long_op.h"
+#include "flash_io.h"
+#include "version.h"
+#include "static_mem.h"
+#include "SystemMetrics.h"
+#include <string.h>
+#include "esp_partition.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register metric_history.c version
+REGISTER_VERSION(MetricHistory, "1.0.0", "2026-10-14");
+
+static const char *TAG = "METRIC_HISTORY";
+
+#define SECTOR_SIZE 4096
+#define RECORD_SIZE sizeof(metric_history_record_t)
+#define RECORDS_PER_SECTOR (SECTOR_SIZE / RECORD_SIZE)
+#define READ_CHUNK 32                           // Records per read when streaming JSON
+#define SHUTDOWN_LOCK_MS 200                    // How long a restart waits for a running flush
+
+_Static_assert(SECTOR_SIZE % sizeof(metric_history_record_t) == 0, "records must tile a sector");
+
+// Ring state. Records [flushed_seq, next_seq) are still in batch[].
+static const esp_partition_t *part;
+static uint32_t capacity;
+static uint32_t next_seq;
+static uint32_t flushed_seq;
+static metric_history_record_t batch[METRIC_HISTORY_BATCH];
+static SemaphoreHandle_t history_lock;
+static TaskHandle_t history_task_handle;
+STATIC_TASK_SLOT(history_task_slot, METRIC_HISTORY_TASK_STACK_SIZE);
+
+// =============================
+// Function Prototypes
+// =============================
+static uint16_t record_crc(const metric_history_record_t *rec);
+static bool record_valid(const metric_history_record_t *rec, uint32_t slot);
+static bool record_erased(const metric_history_record_t *rec);
+static esp_err_t read_slot(uint32_t slot, metric_history_record_t *rec);
+static esp_err_t find_head(void);
+static uint32_t oldest_seq(void);
+static esp_err_t flush_locked(void);
+static void take_sample(void);
+static void history_task(void *arg);
+static void shutdown_flush(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+static uint16_t record_crc(const metric_history_record_t *rec) {
+    return esp_rom_crc16_le(0, (const uint8_t *)rec, offsetof(metric_history_record_t, crc));
+}
+
+/**
+ * @brief Intact and written for this slot, not left over from an earlier lap
+ */
+static bool record_valid(const metric_history_record_t *rec, uint32_t slot) {
+    return rec->crc == record_crc(rec) && rec->seq % capacity == slot;
+}
+
+static bool record_erased(const metric_history_record_t *rec) {
+    const uint8_t *p = (const uint8_t *)rec;
+    for (size_t i = 0; i < RECORD_SIZE; i++) {
+        if (p[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static esp_err_t read_slot(uint32_t slot, metric_history_record_t *rec) {
+    return flash_io_read(FLASH_IO_HISTORY, part, slot * RECORD_SIZE, rec, RECORD_SIZE);
+}
+
+/**
+ * @brief Locate the newest record and the first free slot after it
+ *
+ * The sector whose first record has the highest seq is the head; the first
+ * erased slot in it (or the start of the next sector) is where writing
+ * resumes. next_seq is advanced past any torn record so it lands on that slot.
+ */
+static esp_err_t find_head(void) {
+    uint32_t sectors = capacity / RECORDS_PER_SECTOR;
+    uint32_t head = 0;
+    uint32_t last_seq = 0;
+    bool found = false;
+    metric_history_record_t rec;
+
+    for (uint32_t s = 0; s < sectors; s++) {
+        uint32_t slot = s * RECORDS_PER_SECTOR;
+        if (read_slot(slot, &rec) == ESP_OK && record_valid(&rec, slot) && (!found || rec.seq > last_seq)) {
+            head = s;
+            last_seq = rec.seq;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        // Blank, or holding whatever the region was used for before
+        ESP_LOGI(TAG, "No history found, erasing %lu KB", (unsigned long)(part->size / 1024));
+        next_seq = 0;
+        flushed_seq = 0;
+        return long_op_erase(part, 0, capacity / RECORDS_PER_SECTOR * SECTOR_SIZE, LONG_OP_LOG_ERASE);
+    }
+
+    uint32_t free_slot = ((head + 1) % sectors) * RECORDS_PER_SECTOR;
+    for (uint32_t i = 1; i < RECORDS_PER_SECTOR; i++) {
+        uint32_t slot = head * RECORDS_PER_SECTOR + i;
+        if (read_slot(slot, &rec) != ESP_OK) {
+            continue;
+        }
+        if (record_erased(&rec)) {
+            free_slot = slot;
+            break;
+        }
+        if (record_valid(&rec, slot) && rec.seq > last_seq) {
+            last_seq = rec.seq;
+        }
+    }
+
+    uint32_t seq = last_seq + 1;
+    next_seq = seq + (free_slot + capacity - seq % capacity) % capacity;
+    flushed_seq = next_seq;
+    ESP_LOGI(TAG, "History resumes at seq %lu (slot %lu of %lu)",
+             (unsigned long)next_seq, (unsigned long)free_slot, (unsigned long)capacity);
+    return ESP_OK;
+}
+
+/**
+ * @brief First seq not yet overwritten: the sector after the head holds it
+ */
+static uint32_t oldest_seq(void) {
+    if (next_seq == 0) {
+        return 0;
+    }
+    uint32_t head_start = (next_seq - 1) / RECORDS_PER_SECTOR * RECORDS_PER_SECTOR;
+    return head_start + RECORDS_PER_SECTOR >= capacity ? head_start + RECORDS_PER_SECTOR - capacity : 0;
+}
+
+/**
+ * @brief Write the batch in runs that stay within one sector; call with history_lock held
+ *
+ * A sector is erased only when the first record of a lap reaches it, so each
+ * sector wears once per trip round the ring.
+ */
+static esp_err_t flush_locked(void) {
+    uint32_t pending = next_seq - flushed_seq;
+    esp_err_t result = ESP_OK;
+
+    for (uint32_t i = 0; i < pending;) {
+        uint32_t slot = (flushed_seq + i) % capacity;
+        uint32_t offset_in_sector = slot % RECORDS_PER_SECTOR;
+        uint32_t run = RECORDS_PER_SECTOR - offset_in_sector;
+        if (run > pending - i) {
+            run = pending - i;
+        }
+
+        esp_err_t err = ESP_OK;
+        if (offset_in_sector == 0) {
+            err = flash_io_erase(FLASH_IO_HISTORY, part, slot * RECORD_SIZE, SECTOR_SIZE);
+        }
+        if (err == ESP_OK) {
+            err = flash_io_write(FLASH_IO_HISTORY, part, slot * RECORD_SIZE, &batch[i], run * RECORD_SIZE);
+        }
+        if (err != ESP_OK) {
+            // Drop the run rather than retrying into a failing sector forever
+            ESP_LOGE(TAG, "Failed to write %lu records at slot %lu: %s",
+                     (unsigned long)run, (unsigned long)slot, esp_err_to_name(err));
+            result = err;
+        }
+        i += run;
+    }
+
+    flushed_seq = next_seq;
+    return result;
+}
+
+/**
+ * @brief Append one record from the current metric values
+ */
+static void take_sample(void) {
+    system_metrics_snapshot_t snap;
+    get_system_metrics_snapshot(&snap);
+    uint32_t boot = 0;
+    get_boot_count(&boot);
+
+    metric_history_record_t rec = {
+        .boot = boot,
+        .uptime_s = (uint32_t)(snap.uptime_us / 1000000),
+        .free_heap = snap.free_heap,
+        .min_free_heap = snap.min_free_heap,
+        .largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+    };
+    if (snap.wifi_connected) {
+        rec.rssi = snap.wifi_rssi;
+        rec.flags |= METRIC_HISTORY_HAS_RSSI;
+    }
+    if (snap.vdd33_valid) {
+        rec.vdd_mv = (uint16_t)snap.vdd33_mv;
+        rec.flags |= METRIC_HISTORY_HAS_VDD;
+    }
+    if (snap.cpu_temperature_valid) {
+        rec.temperature_c10 = (int16_t)(snap.cpu_temperature_c * 10.0f);
+        rec.flags |= METRIC_HISTORY_HAS_TEMPERATURE;
+    }
+
+    xSemaphoreTake(history_lock, portMAX_DELAY);
+    rec.seq = next_seq;
+    rec.crc = record_crc(&rec);
+    batch[next_seq - flushed_seq] = rec;
+    next_seq++;
+    if (next_seq - flushed_seq >= METRIC_HISTORY_BATCH) {
+        flush_locked();
+    }
+    xSemaphoreGive(history_lock);
+}
+
+static void history_task(void *arg) {
+    TickType_t last_wake = xTaskGetTickCount();
+    for (;;) {
+        take_sample();
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(METRIC_HISTORY_INTERVAL_S * 1000));
+    }
+}
+
+/**
+ * @brief Save buffered samples on esp_restart(); skipped if a flush is stuck
+ */
+static void shutdown_flush(void) {
+    if (xSemaphoreTake(history_lock, pdMS_TO_TICKS(SHUTDOWN_LOCK_MS)) == pdTRUE) {
+        flush_locked();
+        xSemaphoreGive(history_lock);
+    }
+}
+
+esp_err_t metric_history_start(void) {
+    if (history_task_handle != NULL) {
+        return ESP_OK;
+    }
+
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, METRIC_HISTORY_PARTITION);
+    if (part == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition, history disabled", METRIC_HISTORY_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    capacity = part->size / SECTOR_SIZE * RECORDS_PER_SECTOR;
+    if (capacity < 2 * RECORDS_PER_SECTOR) {
+        ESP_LOGE(TAG, "History partition needs at least two sectors");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    history_lock = xSemaphoreCreateMutex();
+    if (history_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = find_head();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to prepare history partition: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    esp_register_shutdown_handler(shutdown_flush);
+
+    BaseType_t created = static_task_create(history_task_slot, history_task, METRIC_HISTORY_TASK_NAME,
+                                            METRIC_HISTORY_TASK_STACK_SIZE, NULL, METRIC_HISTORY_TASK_PRIORITY,
+                                            &history_task_handle, TASK_CORE_NET);
+    if (created != pdPASS) {
+        history_task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Recording every %d s, %lu records (%lu h)", METRIC_HISTORY_INTERVAL_S,
+             (unsigned long)capacity, (unsigned long)(capacity * METRIC_HISTORY_INTERVAL_S / 3600));
+    return ESP_OK;
+}
+
+esp_err_t metric_history_flush(void) {
+    if (history_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(history_lock, portMAX_DELAY);
+    esp_err_t err = flush_locked();
+    xSemaphoreGive(history_lock);
+    return err;
+}
+
+void metric_history_get_info(metric_history_info_t *info) {
+    memset(info, 0, sizeof(*info));
+    if (history_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(history_lock, portMAX_DELAY);
+    info->ready = true;
+    info->capacity = capacity;
+    info->oldest_seq = oldest_seq();
+    info->next_seq = next_seq;
+    info->pending = next_seq - flushed_seq;
+    xSemaphoreGive(history_lock);
+}
+
+size_t metric_history_read(uint32_t from_seq, metric_history_record_t *records, size_t max, uint32_t *next) {
+    if (history_lock == NULL) {
+        if (next != NULL) {
+            *next = from_seq;
+        }
+        return 0;
+    }
+
+    xSemaphoreTake(history_lock, portMAX_DELAY);
+    uint32_t seq = from_seq < oldest_seq() ? oldest_seq() : from_seq;
+    size_t n = 0;
+    for (; seq < next_seq && n < max; seq++) {
+        if (seq >= flushed_seq) {
+            records[n++] = batch[seq - flushed_seq];
+            continue;
+        }
+        metric_history_record_t rec;
+        uint32_t slot = seq % capacity;
+        if (read_slot(slot, &rec) == ESP_OK && record_valid(&rec, slot) && rec.seq == seq) {
+            records[n++] = rec;
+        }
+    }
+    xSemaphoreGive(history_lock);
+
+    if (next != NULL) {
+        *next = seq;
+    }
+    return n;
+}
+
+void metric_history_write_json(json_writer_t *w, uint32_t from_seq, uint32_t count) {
+    metric_history_info_t info;
+    metric_history_get_info(&info);
+    if (count > METRIC_HISTORY_MAX_QUERY) {
+        count = METRIC_HISTORY_MAX_QUERY;
+    }
+
+    json_obj_begin(w);
+    json_kv_bool(w, "ready", info.ready);
+    json_kv_uint(w, "intervalS", METRIC_HISTORY_INTERVAL_S);
+    json_kv_uint(w, "capacity", info.capacity);
+    json_kv_uint(w, "oldest", info.oldest_seq);
+    json_kv_uint(w, "newest", info.next_seq ? info.next_seq - 1 : 0);
+    json_kv_uint(w, "pending", info.pending);
+
+    json_key(w, "records");
+    json_arr_begin(w);
+    metric_history_record_t chunk[READ_CHUNK];
+    uint32_t seq = from_seq;
+    uint32_t returned = 0;
+    while (returned < count && seq < info.next_seq) {
+        size_t want = count - returned < READ_CHUNK ? count - returned : READ_CHUNK;
+        size_t n = metric_history_read(seq, chunk, want, &seq);
+        for (size_t i = 0; i < n; i++) {
+            const metric_history_record_t *r = &chunk[i];
+            json_obj_begin(w);
+            json_kv_uint(w, "seq", r->seq);
+            json_kv_uint(w, "boot", r->boot);
+            json_kv_uint(w, "uptimeS", r->uptime_s);
+            json_kv_uint(w, "freeHeap", r->free_heap);
+            json_kv_uint(w, "minFreeHeap", r->min_free_heap);
+            json_kv_uint(w, "largestBlock", r->largest_block);
+            json_key(w, "vddMv");
+            if (r->flags & METRIC_HISTORY_HAS_VDD) {
+                json_uint(w, r->vdd_mv);
+            } else {
+                json_null(w);
+            }
+            json_key(w, "temperatureC");
+            if (r->flags & METRIC_HISTORY_HAS_TEMPERATURE) {
+                json_double(w, r->temperature_c10 / 10.0, 1);
+            } else {
+                json_null(w);
+            }
+            json_key(w, "rssi");
+            if (r->flags & METRIC_HISTORY_HAS_RSSI) {
+                json_int(w, r->rssi);
+            } else {
+                json_null(w);
+            }
+            json_obj_end(w);
+        }
+        returned += n;
+        if (n == 0) {
+            break;
+        }
+    }
+    json_arr_end(w);
+    json_kv_uint(w, "next", seq);
+    json_obj_end(w);
+}
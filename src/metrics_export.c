@@ -0,0 +1,761 @@
+/**
+ * @file metrics_export.c
+ * @brief Prometheus/OpenMetrics text exposition of the system metrics
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "metrics_export.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include "http_gzip.h"
+#include "http_perf.h"
+#include "cpu_monitor.h"
+#include "heap_monitor.h"
+#include "net_stats.h"
+#include "dns_server.h"
+#include "flash_io.h"
+#include "json_writer.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register metrics_export.c version
+REGISTER_VERSION(MetricsExport, "1.0.0", "2026-10-14");
+
+static const char *TAG = "METRICS_EXPORT";
+
+#define CONTENT_TYPE_OPENMETRICS "application/openmetrics-text; version=1.0.0; charset=utf-8"
+#define CONTENT_TYPE_PROMETHEUS "text/plain; version=0.0.4; charset=utf-8"
+
+/**
+ * @brief How one system_metric_t is exposed
+ *
+ * Numeric values are multiplied by scale to reach the base unit; a metric
+ * that reads as text is exposed as <name>_info{value="..."} 1 instead.
+ */
+typedef struct {
+    const char *name;
+    const char *unit;                           // OpenMetrics unit, NULL if none
+    double scale;
+} export_metric_t;
+
+static const export_metric_t export_metrics[] = {
+    [METRIC_CPU_FREQUENCY]            = { "cpu_frequency_hertz", "hertz", 1e6 },
+    [METRIC_CPU_TEMPERATURE]          = { "cpu_temperature_celsius", "celsius", 1 },
+    [METRIC_FREE_HEAP]                = { "free_heap_bytes", "bytes", 1 },
+    [METRIC_MIN_FREE_HEAP]            = { "min_free_heap_bytes", "bytes", 1 },
+    [METRIC_UPTIME]                   = { "uptime_seconds", "seconds", 1e-3 },
+    [METRIC_RESET_REASON]             = { "reset_reason", NULL, 1 },
+    [METRIC_TASK_RUNTIME_STATS]       = { "task_runtime_stats", NULL, 1 },
+    [METRIC_TASK_PRIORITY]            = { "task_priority", NULL, 1 },
+    [METRIC_POWER_MODE]               = { "power_mode", NULL, 1 },
+    [METRIC_LIGHT_SLEEP_DURATION]     = { "light_sleep_duration", NULL, 1 },
+    [METRIC_DEEP_SLEEP_DURATION]      = { "deep_sleep_duration", NULL, 1 },
+    [METRIC_VDD33_VOLTAGE]            = { "vdd33_volts", "volts", 1 },
+    [METRIC_CURRENT_CONSUMPTION]      = { "current_consumption", NULL, 1 },
+    [METRIC_WIFI_RSSI]                = { "wifi_rssi_dbm", "dbm", 1 },
+    [METRIC_WIFI_TX_POWER]            = { "wifi_tx_power_dbm", "dbm", 1 },
+    [METRIC_WIFI_TX_RX_BYTES]         = { "wifi_traffic", NULL, 1 },
+    [METRIC_IP_ADDRESS]               = { "ip_address", NULL, 1 },
+    [METRIC_WIFI_STATUS]              = { "wifi_status", NULL, 1 },
+    [METRIC_NETWORK_SPEED]            = { "network_speed", NULL, 1 },
+    [METRIC_BT_BLE_RSSI]              = { "bt_ble_rssi", NULL, 1 },
+    [METRIC_BT_BLE_CONNECTED_DEVICES] = { "bt_ble_connected_devices", NULL, 1 },
+    [METRIC_FLASH_USAGE]              = { "flash_data_partition_bytes", "bytes", 1 },
+    [METRIC_FLASH_RW_OPERATIONS]      = { "flash_rw_operations", NULL, 1 },
+    [METRIC_SPIFFS_USAGE]             = { "spiffs_used_bytes", "bytes", 1 },
+    [METRIC_I2C_BUS_ERRORS]           = { "i2c_bus_errors", NULL, 1 },
+    [METRIC_SPI_PERFORMANCE]          = { "spi_performance", NULL, 1 },
+    [METRIC_GPIO_STATUS]              = { "gpio_status", NULL, 1 },
+    [METRIC_CHIP_ID]                  = { "chip_id", NULL, 1 },
+    [METRIC_MAC_ADDRESS]              = { "mac_address", NULL, 1 },
+    [METRIC_FLASH_SIZE]               = { "flash_size_bytes", "bytes", 1 },
+    [METRIC_CHIP_REVISION]            = { "chip_revision", NULL, 1 },
+    [METRIC_CORE_COUNT]               = { "cores", NULL, 1 },
+    [METRIC_TASK_COUNT]               = { "tasks", NULL, 1 },
+    [METRIC_TASK_STACK_HWM]           = { "task_stack_hwm_bytes", "bytes", 1 },
+    [METRIC_BOOT_COUNT]               = { "boots", NULL, 1 },
+    [METRIC_CRASH_COUNT]              = { "crashes", NULL, 1 },
+    [METRIC_OTA_UPDATE_STATUS]        = { "ota_update_status", NULL, 1 },
+    [METRIC_LAST_UPDATE_TIME]         = { "last_update_time", NULL, 1 },
+    [METRIC_APP_SPECIFIC_TIMERS]      = { "app_timer_seconds", "seconds", 1 },
+    [METRIC_HTTP_REQUESTS]            = { "http_requests_summary", NULL, 1 },
+    [METRIC_HTTP_LATENCY]             = { "http_latency_summary", NULL, 1 },
+    [METRIC_CPU_LOAD]                 = { "cpu_load_summary", NULL, 1 },
+    [METRIC_CPU_IDLE]                 = { "cpu_idle_summary", NULL, 1 },
+    [METRIC_TASK_STACK_MIN]           = { "task_stack_min_summary", NULL, 1 },
+    [METRIC_HEAP_LARGEST_BLOCK]       = { "heap_largest_block_bytes", "bytes", 1 },
+    [METRIC_HEAP_FRAGMENTATION]       = { "heap_fragmentation_ratio", "ratio", 0.01 },
+    [METRIC_HEAP_ALLOC_FAILURES]      = { "heap_alloc_failures_summary", NULL, 1 },
+    [METRIC_NET_PACKETS]              = { "net_packets_summary", NULL, 1 },
+    [METRIC_NET_DROPS]                = { "net_drops_summary", NULL, 1 },
+    [METRIC_DNS_QUERIES]              = { "dns_queries_summary", NULL, 1 },
+    [METRIC_DNS_TOP_NAMES]            = { "dns_top_names_summary", NULL, 1 },
+    [METRIC_BOOT_TRACE]               = { "boot_trace_summary", NULL, 1 },
+    [METRIC_SAMPLER_JITTER]           = { "sampler_jitter_summary", NULL, 1 },
+    [METRIC_ESPNOW_BATCH]             = { "espnow_batch_summary", NULL, 1 },
+    [METRIC_GATEWAY_NODES]            = { "gateway_nodes_summary", NULL, 1 },
+    [METRIC_LONG_OP_SLICES]           = { "long_op_summary", NULL, 1 },
+};
+
+_Static_assert(sizeof(export_metrics) / sizeof(export_metrics[0]) == METRIC_COUNT,
+               "every system_metric_t needs an export name");
+
+static metrics_export_source_fn sources[METRICS_EXPORT_MAX_SOURCES];
+static size_t source_count;
+static char schema_version[9];                  // Hex CRC-32; httpd task only
+
+// =============================
+// Function Prototypes
+// =============================
+static void flush_buffer(metrics_export_writer_t *w);
+static void put_raw(metrics_export_writer_t *w, const char *data, size_t len);
+static void put_str(metrics_export_writer_t *w, const char *s);
+static void put_family_name(metrics_export_writer_t *w, const char *name, metrics_export_type_t type);
+static void put_sample_name(metrics_export_writer_t *w, const char *name, const char *suffix, const char *labels);
+static void write_system_metrics(metrics_export_writer_t *w);
+static void write_http_stats(metrics_export_writer_t *w);
+static void write_cpu_stats(metrics_export_writer_t *w);
+static void write_heap_stats(metrics_export_writer_t *w);
+static void write_net_stats(metrics_export_writer_t *w);
+static void write_dns_stats(metrics_export_writer_t *w);
+static void write_flash_stats(metrics_export_writer_t *w);
+static void write_schema_body(json_writer_t *w);
+static esp_err_t crc_flush(void *ctx, const char *data, size_t len);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void flush_buffer(metrics_export_writer_t *w) {
+    if (w->len > 0 && w->err == ESP_OK) {
+        w->err = http_gzip_send_chunk(w->req, w->gz, w->buf, w->len);
+    }
+    w->len = 0;
+}
+
+static void put_raw(metrics_export_writer_t *w, const char *data, size_t len) {
+    while (len > 0 && w->err == ESP_OK) {
+        if (w->len == sizeof(w->buf)) {
+            flush_buffer(w);
+        }
+        size_t room = sizeof(w->buf) - w->len;
+        size_t n = len < room ? len : room;
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static void put_str(metrics_export_writer_t *w, const char *s) {
+    put_raw(w, s, strlen(s));
+}
+
+/**
+ * @brief Name as used on TYPE/HELP lines, which differs between the two formats
+ *
+ * OpenMetrics names the family; Prometheus text names the sample, so its
+ * counters and info gauges carry the suffix.
+ */
+static void put_family_name(metrics_export_writer_t *w, const char *name, metrics_export_type_t type) {
+    put_str(w, METRICS_EXPORT_PREFIX);
+    put_str(w, name);
+    if (!w->openmetrics && type == METRICS_EXPORT_COUNTER) {
+        put_str(w, "_total");
+    } else if (!w->openmetrics && type == METRICS_EXPORT_INFO) {
+        put_str(w, "_info");
+    }
+}
+
+static void put_sample_name(metrics_export_writer_t *w, const char *name, const char *suffix, const char *labels) {
+    put_str(w, METRICS_EXPORT_PREFIX);
+    put_str(w, name);
+    put_str(w, suffix);
+    if (labels != NULL && labels[0] != '\0') {
+        put_raw(w, "{", 1);
+        put_str(w, labels);
+        put_raw(w, "}", 1);
+    }
+    put_raw(w, " ", 1);
+}
+
+#if METRICS_EXPORT_SOURCES
+esp_err_t metrics_export_add_source(metrics_export_source_fn source) {
+    if (source == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (source_count >= METRICS_EXPORT_MAX_SOURCES) {
+        ESP_LOGE(TAG, "No room for another metrics source (max %d)", METRICS_EXPORT_MAX_SOURCES);
+        return ESP_ERR_NO_MEM;
+    }
+    sources[source_count++] = source;
+    return ESP_OK;
+}
+#endif
+
+void metrics_export_family(metrics_export_writer_t *w, const char *name, metrics_export_type_t type,
+                           const char *unit, const char *help) {
+    static const char *const type_names[] = {
+        [METRICS_EXPORT_GAUGE] = "gauge",
+        [METRICS_EXPORT_COUNTER] = "counter",
+        [METRICS_EXPORT_INFO] = "info",
+        [METRICS_EXPORT_HISTOGRAM] = "histogram",
+    };
+
+    put_str(w, "# TYPE ");
+    put_family_name(w, name, type);
+    put_raw(w, " ", 1);
+    put_str(w, !w->openmetrics && type == METRICS_EXPORT_INFO ? "gauge" : type_names[type]);
+    put_raw(w, "\n", 1);
+
+    if (w->openmetrics && unit != NULL) {
+        put_str(w, "# UNIT ");
+        put_family_name(w, name, type);
+        put_raw(w, " ", 1);
+        put_str(w, unit);
+        put_raw(w, "\n", 1);
+    }
+
+    if (help != NULL) {
+        put_str(w, "# HELP ");
+        put_family_name(w, name, type);
+        put_raw(w, " ", 1);
+        put_str(w, help);
+        put_raw(w, "\n", 1);
+    }
+}
+
+void metrics_export_sample(metrics_export_writer_t *w, const char *name, const char *suffix,
+                           const char *labels, double value) {
+    char num[24];
+    if (isnan(value)) {
+        strcpy(num, "NaN");
+    } else if (isinf(value)) {
+        strcpy(num, value > 0 ? "+Inf" : "-Inf");
+    } else {
+        snprintf(num, sizeof(num), "%.9g", value);
+    }
+    put_sample_name(w, name, suffix, labels);
+    put_str(w, num);
+    put_raw(w, "\n", 1);
+}
+
+void metrics_export_sample_int(metrics_export_writer_t *w, const char *name, const char *suffix,
+                               const char *labels, int64_t value) {
+    char num[24];
+    snprintf(num, sizeof(num), "%" PRId64, value);
+    put_sample_name(w, name, suffix, labels);
+    put_str(w, num);
+    put_raw(w, "\n", 1);
+}
+
+const char *metrics_export_escape(char *out, size_t out_len, const char *value) {
+    size_t pos = 0;
+    for (const char *p = value; *p != '\0' && pos + 2 < out_len; p++) {
+        if (*p == '\\' || *p == '"') {
+            out[pos++] = '\\';
+            out[pos++] = *p;
+        } else if (*p == '\n') {
+            out[pos++] = '\\';
+            out[pos++] = 'n';
+        } else {
+            out[pos++] = *p;
+        }
+    }
+    if (out_len > 0) {
+        out[pos] = '\0';
+    }
+    return out;
+}
+
+/**
+ * @brief One family per system_metric_t, collected as one typed batch
+ */
+static void write_system_metrics(metrics_export_writer_t *w) {
+    metric_batch_t batch;
+    metric_sample_t samples[METRIC_COLLECT_CHUNK];
+    size_t n;
+    system_metrics_batch_init(&batch, METRIC_MASK_ALL, false);
+    while (w->err == ESP_OK && (n = system_metrics_collect(&batch, samples, METRIC_COLLECT_CHUNK)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            const metric_value_t *value = &samples[i].value;
+            const export_metric_t *m = &export_metrics[samples[i].metric];
+            if (samples[i].error != METRIC_OK) {
+                continue;
+            }
+
+            const char *help = get_metric_description(samples[i].metric);
+            if (value->type == METRIC_VALUE_STRING) {
+                char labels[METRICS_EXPORT_LABEL_MAX + 8];
+                char escaped[METRICS_EXPORT_LABEL_MAX];
+                snprintf(labels, sizeof(labels), "value=\"%s\"",
+                         metrics_export_escape(escaped, sizeof(escaped), value->s));
+                metrics_export_family(w, m->name, METRICS_EXPORT_INFO, NULL, help);
+                metrics_export_sample_int(w, m->name, "_info", labels, 1);
+                continue;
+            }
+
+            metrics_export_family(w, m->name, METRICS_EXPORT_GAUGE, m->unit, help);
+            if (value->type == METRIC_VALUE_INT && m->scale == 1) {
+                metrics_export_sample_int(w, m->name, "", NULL, value->i);
+            } else {
+                double raw = value->type == METRIC_VALUE_INT ? (double)value->i : value->f;
+                metrics_export_sample(w, m->name, "", NULL, raw * m->scale);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Request counters and a latency histogram per URI handler
+ */
+static void write_http_stats(metrics_export_writer_t *w) {
+    size_t count = http_perf_count();
+    if (count == 0) {
+        return;
+    }
+
+    char uri[METRICS_EXPORT_LABEL_MAX];
+    char labels[METRICS_EXPORT_LABEL_MAX + 48];
+    http_perf_stats_t s;
+
+    metrics_export_family(w, "http_requests", METRICS_EXPORT_COUNTER, NULL, "Requests handled per URI handler");
+    for (size_t i = 0; i < count; i++) {
+        if (http_perf_get(i, &s) == ESP_OK) {
+            snprintf(labels, sizeof(labels), "uri=\"%s\",method=\"%s\"",
+                     metrics_export_escape(uri, sizeof(uri), s.uri), http_method_str(s.method));
+            metrics_export_sample_int(w, "http_requests", "_total", labels, s.count);
+        }
+    }
+
+    metrics_export_family(w, "http_errors", METRICS_EXPORT_COUNTER, NULL, "Requests whose handler failed");
+    for (size_t i = 0; i < count; i++) {
+        if (http_perf_get(i, &s) == ESP_OK) {
+            snprintf(labels, sizeof(labels), "uri=\"%s\",method=\"%s\"",
+                     metrics_export_escape(uri, sizeof(uri), s.uri), http_method_str(s.method));
+            metrics_export_sample_int(w, "http_errors", "_total", labels, s.errors);
+        }
+    }
+
+    metrics_export_family(w, "http_response_bytes", METRICS_EXPORT_COUNTER, "bytes", "Bytes sent by each handler");
+    for (size_t i = 0; i < count; i++) {
+        if (http_perf_get(i, &s) == ESP_OK) {
+            snprintf(labels, sizeof(labels), "uri=\"%s\",method=\"%s\"",
+                     metrics_export_escape(uri, sizeof(uri), s.uri), http_method_str(s.method));
+            metrics_export_sample_int(w, "http_response_bytes", "_total", labels, (int64_t)s.bytes_out);
+        }
+    }
+
+    metrics_export_family(w, "http_request_duration_seconds", METRICS_EXPORT_HISTOGRAM, "seconds",
+                          "Handler run time");
+    for (size_t i = 0; i < count && w->err == ESP_OK; i++) {
+        if (http_perf_get(i, &s) != ESP_OK) {
+            continue;
+        }
+        metrics_export_escape(uri, sizeof(uri), s.uri);
+        const char *method = http_method_str(s.method);
+
+        // http_perf counts per bucket; the exposition wants running totals
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < HTTP_PERF_BUCKETS; b++) {
+            cumulative += s.histogram[b];
+            uint32_t bound_ms = http_perf_bucket_ms(b);
+            if (bound_ms == 0) {
+                snprintf(labels, sizeof(labels), "uri=\"%s\",method=\"%s\",le=\"+Inf\"", uri, method);
+            } else {
+                snprintf(labels, sizeof(labels), "uri=\"%s\",method=\"%s\",le=\"%g\"", uri, method, bound_ms / 1000.0);
+            }
+            metrics_export_sample_int(w, "http_request_duration_seconds", "_bucket", labels, (int64_t)cumulative);
+        }
+        snprintf(labels, sizeof(labels), "uri=\"%s\",method=\"%s\"", uri, method);
+        metrics_export_sample(w, "http_request_duration_seconds", "_sum", labels, s.total_us / 1e6);
+        metrics_export_sample_int(w, "http_request_duration_seconds", "_count", labels, s.count);
+    }
+}
+
+/**
+ * @brief Busy share per core and overall idle share
+ */
+static void write_cpu_stats(metrics_export_writer_t *w) {
+    cpu_load_t load;
+    cpu_monitor_get_load(&load);
+    if (!load.valid) {
+        return;
+    }
+
+    char labels[16];
+    metrics_export_family(w, "cpu_core_load_ratio", METRICS_EXPORT_GAUGE, "ratio",
+                          "Busy share of each core over the last sampling interval");
+    for (uint8_t core = 0; core < load.cores; core++) {
+        snprintf(labels, sizeof(labels), "core=\"%u\"", core);
+        metrics_export_sample(w, "cpu_core_load_ratio", "", labels, load.core_load[core] / 100.0);
+    }
+    metrics_export_family(w, "cpu_idle_ratio", METRICS_EXPORT_GAUGE, "ratio", "Idle share of all cores, rolling");
+    metrics_export_sample(w, "cpu_idle_ratio", "", NULL, load.idle_rolling / 100.0);
+}
+
+/**
+ * @brief Per-capability heap sizes and the allocation failure count
+ */
+static void write_heap_stats(metrics_export_writer_t *w) {
+    heap_caps_stats_t caps[HEAP_MONITOR_MAX_CAPS];
+    size_t n = heap_monitor_get_caps(caps, HEAP_MONITOR_MAX_CAPS);
+    char labels[24];
+
+    metrics_export_family(w, "heap_total_bytes", METRICS_EXPORT_GAUGE, "bytes", "Heap size per capability class");
+    for (size_t i = 0; i < n; i++) {
+        snprintf(labels, sizeof(labels), "caps=\"%s\"", caps[i].name);
+        metrics_export_sample_int(w, "heap_total_bytes", "", labels, caps[i].total_bytes);
+    }
+    metrics_export_family(w, "heap_free_bytes", METRICS_EXPORT_GAUGE, "bytes", "Free heap per capability class");
+    for (size_t i = 0; i < n; i++) {
+        snprintf(labels, sizeof(labels), "caps=\"%s\"", caps[i].name);
+        metrics_export_sample_int(w, "heap_free_bytes", "", labels, caps[i].free_bytes);
+    }
+    metrics_export_family(w, "heap_min_free_bytes", METRICS_EXPORT_GAUGE, "bytes",
+                          "Lowest free heap since boot per capability class");
+    for (size_t i = 0; i < n; i++) {
+        snprintf(labels, sizeof(labels), "caps=\"%s\"", caps[i].name);
+        metrics_export_sample_int(w, "heap_min_free_bytes", "", labels, caps[i].minimum_free_bytes);
+    }
+    metrics_export_family(w, "heap_largest_free_block_bytes", METRICS_EXPORT_GAUGE, "bytes",
+                          "Largest free block per capability class");
+    for (size_t i = 0; i < n; i++) {
+        snprintf(labels, sizeof(labels), "caps=\"%s\"", caps[i].name);
+        metrics_export_sample_int(w, "heap_largest_free_block_bytes", "", labels, caps[i].largest_free_block);
+    }
+
+    heap_failure_stats_t fail;
+    heap_monitor_get_failures(&fail);
+    metrics_export_family(w, "heap_alloc_failures", METRICS_EXPORT_COUNTER, NULL, "Allocations the heap could not satisfy");
+    metrics_export_sample_int(w, "heap_alloc_failures", "_total", NULL, fail.count);
+}
+
+/**
+ * @brief Traffic per interface, ESP-NOW included, and lwIP drop counts
+ */
+static void write_net_stats(metrics_export_writer_t *w) {
+    net_if_stats_t s[NET_STATS_IF_COUNT];
+    for (int i = 0; i < NET_STATS_IF_COUNT; i++) {
+        net_stats_get((net_stats_if_t)i, &s[i]);
+    }
+
+    static const struct {
+        const char *name;
+        const char *unit;
+        const char *help;
+        size_t offset;
+        bool wide;                              // uint64_t field rather than uint32_t
+    } fields[] = {
+        { "net_transmit_bytes", "bytes", "Bytes sent per interface", offsetof(net_if_stats_t, tx_bytes), true },
+        { "net_receive_bytes", "bytes", "Bytes received per interface", offsetof(net_if_stats_t, rx_bytes), true },
+        { "net_transmit_packets", NULL, "Packets sent per interface", offsetof(net_if_stats_t, tx_packets), false },
+        { "net_receive_packets", NULL, "Packets received per interface", offsetof(net_if_stats_t, rx_packets), false },
+        { "net_transmit_failures", NULL, "Frames not acknowledged by the peer", offsetof(net_if_stats_t, tx_failed), false },
+    };
+
+    char labels[24];
+    for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+        metrics_export_family(w, fields[f].name, METRICS_EXPORT_COUNTER, fields[f].unit, fields[f].help);
+        for (int i = 0; i < NET_STATS_IF_COUNT; i++) {
+            const uint8_t *base = (const uint8_t *)&s[i] + fields[f].offset;
+            int64_t v = fields[f].wide ? (int64_t)*(const uint64_t *)base : (int64_t)*(const uint32_t *)base;
+            snprintf(labels, sizeof(labels), "interface=\"%s\"", net_stats_if_name((net_stats_if_t)i));
+            metrics_export_sample_int(w, fields[f].name, "_total", labels, v);
+        }
+    }
+
+    net_drop_stats_t drops;
+    net_stats_get_drops(&drops);
+    if (!drops.valid) {
+        return;
+    }
+    metrics_export_family(w, "net_drops", METRICS_EXPORT_COUNTER, NULL,
+                          "Packets dropped by the lwIP stack per layer (16-bit, wraps)");
+    metrics_export_sample_int(w, "net_drops", "_total", "layer=\"link\"", drops.link_drop + drops.link_err);
+    metrics_export_sample_int(w, "net_drops", "_total", "layer=\"ip\"", drops.ip_drop);
+    metrics_export_sample_int(w, "net_drops", "_total", "layer=\"tcp\"", drops.tcp_drop + drops.tcp_memerr);
+    metrics_export_sample_int(w, "net_drops", "_total", "layer=\"udp\"", drops.udp_drop);
+}
+
+/**
+ * @brief Captive portal DNS replies by outcome, drops, rate and per-source counts
+ */
+static void write_dns_stats(metrics_export_writer_t *w) {
+    if (!dns_server_is_running()) {
+        return;
+    }
+    dns_server_stats_t s;
+    dns_server_get_stats(&s);
+    metrics_export_family(w, "dns_replies", METRICS_EXPORT_COUNTER, NULL, "Captive portal DNS replies by outcome");
+    metrics_export_sample_int(w, "dns_replies", "_total", "result=\"address\"", s.answered);
+    metrics_export_sample_int(w, "dns_replies", "_total", "result=\"nodata\"", s.nodata);
+    metrics_export_sample_int(w, "dns_replies", "_total", "result=\"nxdomain\"", s.nxdomain);
+    metrics_export_sample_int(w, "dns_replies", "_total", "result=\"error\"", s.errors);
+    metrics_export_sample_int(w, "dns_replies", "_total", "result=\"forwarded\"", s.forwarded);
+    metrics_export_sample_int(w, "dns_replies", "_total", "result=\"cached\"", s.cache_hits);
+    metrics_export_family(w, "dns_dropped", METRICS_EXPORT_COUNTER, NULL, "DNS packets ignored or not sent");
+    metrics_export_sample_int(w, "dns_dropped", "_total", "reason=\"invalid\"", s.dropped);
+    metrics_export_sample_int(w, "dns_dropped", "_total", "reason=\"send\"", s.send_failures);
+    metrics_export_sample_int(w, "dns_dropped", "_total", "reason=\"upstream_timeout\"", s.upstream_timeouts);
+    metrics_export_sample_int(w, "dns_dropped", "_total", "reason=\"rate_limit\"", s.rate_limited);
+    metrics_export_family(w, "dns_queries_per_second", METRICS_EXPORT_GAUGE, NULL,
+                          "DNS query rate over the last averaging window");
+    metrics_export_sample(w, "dns_queries_per_second", "", NULL, s.qps);
+
+    dns_client_stats_t clients[DNS_MAX_CLIENTS];
+    size_t n = dns_server_get_clients(clients, DNS_MAX_CLIENTS);
+    char labels[METRICS_EXPORT_LABEL_MAX + 16];
+    metrics_export_family(w, "dns_client_queries", METRICS_EXPORT_COUNTER, NULL,
+                          "DNS queries accepted per tracked source");
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t *a = (const uint8_t *)&clients[i].addr;
+        snprintf(labels, sizeof(labels), "client=\"%u.%u.%u.%u\"", a[0], a[1], a[2], a[3]);
+        metrics_export_sample_int(w, "dns_client_queries", "_total", labels, clients[i].queries);
+    }
+    metrics_export_family(w, "dns_client_rate_limited", METRICS_EXPORT_COUNTER, NULL,
+                          "DNS packets dropped per tracked source by the rate limit");
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t *a = (const uint8_t *)&clients[i].addr;
+        snprintf(labels, sizeof(labels), "client=\"%u.%u.%u.%u\"", a[0], a[1], a[2], a[3]);
+        metrics_export_sample_int(w, "dns_client_rate_limited", "_total", labels, clients[i].rate_limited);
+    }
+
+    // Gauges: a name can drop out of the table, so its count is not monotonic
+    dns_name_stats_t names[DNS_TOP_NAMES];
+    n = dns_server_get_top_names(names, DNS_TOP_NAMES);
+    metrics_export_family(w, "dns_top_name_queries", METRICS_EXPORT_GAUGE, NULL,
+                          "Queries for the most queried names (upper bound)");
+    for (size_t i = 0; i < n; i++) {
+        char escaped[METRICS_EXPORT_LABEL_MAX];
+        snprintf(labels, sizeof(labels), "name=\"%s\"", metrics_export_escape(escaped, sizeof(escaped), names[i].name));
+        metrics_export_sample_int(w, "dns_top_name_queries", "", labels, names[i].count);
+    }
+}
+
+esp_err_t metrics_export_handler(httpd_req_t *req) {
+    metrics_export_writer_t w = { .req = req };
+
+    char accept[96];
+    if (httpd_req_get_hdr_value_str(req, "Accept", accept, sizeof(accept)) == ESP_OK ||
+        httpd_req_get_hdr_value_len(req, "Accept") >= sizeof(accept)) {
+        // A truncated header still starts with the scraper's preferred type
+        w.openmetrics = strstr(accept, "application/openmetrics-text") != NULL;
+    }
+
+    httpd_resp_set_type(req, w.openmetrics ? CONTENT_TYPE_OPENMETRICS : CONTENT_TYPE_PROMETHEUS);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    w.gz = http_gzip_begin(req);                // Prometheus asks for gzip on every scrape
+
+    write_system_metrics(&w);
+    write_http_stats(&w);
+    write_cpu_stats(&w);
+    write_heap_stats(&w);
+    write_net_stats(&w);
+    write_dns_stats(&w);
+    write_flash_stats(&w);
+    for (size_t i = 0; i < source_count && w.err == ESP_OK; i++) {
+        sources[i](&w);
+    }
+    if (w.openmetrics) {
+        put_str(&w, "# EOF\n");
+    }
+
+    flush_buffer(&w);
+    if (w.err != ESP_OK) {
+        ESP_LOGW(TAG, "Scrape aborted: %s", esp_err_to_name(w.err));
+        return w.err;
+    }
+    return http_gzip_send_chunk(req, w.gz, NULL, 0);
+}
+
+/**
+ * @brief Flash operations, bytes and latency per subsystem and kind, and bytes per partition
+ *
+ * Only pairs that have seen an operation are written, so a node without
+ * OTA or history traffic does not export empty histograms.
+ */
+static void write_flash_stats(metrics_export_writer_t *w) {
+    char labels[64];
+    flash_io_stats_t s;
+
+    metrics_export_family(w, "flash_io_operations", METRICS_EXPORT_COUNTER, NULL,
+                          "Flash operations per subsystem and kind");
+    metrics_export_family(w, "flash_io_errors", METRICS_EXPORT_COUNTER, NULL, "Flash operations that failed");
+    metrics_export_family(w, "flash_io_bytes", METRICS_EXPORT_COUNTER, "bytes", "Bytes read, written or erased");
+    for (int sub = 0; sub < FLASH_IO_SUB_COUNT; sub++) {
+        for (int op = 0; op < FLASH_IO_OP_COUNT; op++) {
+            if (flash_io_get((flash_io_sub_t)sub, (flash_io_op_t)op, &s) != ESP_OK || s.count == 0) {
+                continue;
+            }
+            snprintf(labels, sizeof(labels), "subsystem=\"%s\",op=\"%s\"", flash_io_sub_name((flash_io_sub_t)sub),
+                     flash_io_op_name((flash_io_op_t)op));
+            metrics_export_sample_int(w, "flash_io_operations", "_total", labels, s.count);
+            metrics_export_sample_int(w, "flash_io_errors", "_total", labels, s.errors);
+            metrics_export_sample_int(w, "flash_io_bytes", "_total", labels, (int64_t)s.bytes);
+        }
+    }
+
+    metrics_export_family(w, "flash_io_duration_seconds", METRICS_EXPORT_HISTOGRAM, "seconds",
+                          "Time per flash operation");
+    for (int sub = 0; sub < FLASH_IO_SUB_COUNT && w->err == ESP_OK; sub++) {
+        for (int op = 0; op < FLASH_IO_OP_COUNT; op++) {
+            if (flash_io_get((flash_io_sub_t)sub, (flash_io_op_t)op, &s) != ESP_OK || s.count == 0) {
+                continue;
+            }
+            const char *sub_name = flash_io_sub_name((flash_io_sub_t)sub);
+            const char *op_name = flash_io_op_name((flash_io_op_t)op);
+            uint64_t cumulative = 0;
+            for (size_t b = 0; b < FLASH_IO_BUCKETS; b++) {
+                cumulative += s.histogram[b];
+                uint32_t bound_us = flash_io_bucket_us(b);
+                if (bound_us == 0) {
+                    snprintf(labels, sizeof(labels), "subsystem=\"%s\",op=\"%s\",le=\"+Inf\"", sub_name, op_name);
+                } else {
+                    snprintf(labels, sizeof(labels), "subsystem=\"%s\",op=\"%s\",le=\"%g\"", sub_name, op_name,
+                             bound_us / 1e6);
+                }
+                metrics_export_sample_int(w, "flash_io_duration_seconds", "_bucket", labels, (int64_t)cumulative);
+            }
+            snprintf(labels, sizeof(labels), "subsystem=\"%s\",op=\"%s\"", sub_name, op_name);
+            metrics_export_sample(w, "flash_io_duration_seconds", "_sum", labels, s.total_us / 1e6);
+            metrics_export_sample_int(w, "flash_io_duration_seconds", "_count", labels, s.count);
+        }
+    }
+
+    flash_io_part_stats_t parts[FLASH_IO_MAX_PARTITIONS];
+    size_t n = flash_io_get_partitions(parts, FLASH_IO_MAX_PARTITIONS);
+    if (n == 0) {
+        return;
+    }
+    char label[sizeof(parts[0].label) * 2];
+    metrics_export_family(w, "flash_partition_bytes", METRICS_EXPORT_COUNTER, "bytes",
+                          "Bytes read, written or erased per partition");
+    for (size_t i = 0; i < n; i++) {
+        metrics_export_escape(label, sizeof(label), parts[i].label);
+        for (int op = 0; op < FLASH_IO_OP_COUNT; op++) {
+            if (parts[i].count[op] == 0) {
+                continue;
+            }
+            snprintf(labels, sizeof(labels), "partition=\"%s\",op=\"%s\"", label, flash_io_op_name((flash_io_op_t)op));
+            metrics_export_sample_int(w, "flash_partition_bytes", "_total", labels, (int64_t)parts[i].bytes[op]);
+        }
+    }
+}
+
+/**
+ * @brief Schema members after "version": the groups and every metric
+ */
+static void write_schema_body(json_writer_t *w) {
+    json_key(w, "groups");
+    json_arr_begin(w);
+    for (int g = 0; g < METRIC_GROUP_COUNT; g++) {
+        json_str(w, get_metric_group_name((metric_group_t)g));
+    }
+    json_arr_end(w);
+
+    json_key(w, "metrics");
+    json_arr_begin(w);
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        metric_info_t info;
+        if (!get_metric_info((system_metric_t)i, &info)) {
+            continue;
+        }
+        uint32_t ttl = get_metric_ttl_ms((system_metric_t)i);
+        json_obj_begin(w);
+        json_kv_int(w, "id", i);
+        json_kv_str(w, "name", info.name);
+        json_kv_str(w, "unit", info.unit);
+        json_kv_str(w, "group", get_metric_group_name(get_metric_group((system_metric_t)i)));
+        json_key(w, "ttlMs");
+        if (ttl == METRIC_TTL_STATIC) {
+            json_null(w);
+        } else {
+            json_uint(w, ttl);
+        }
+        json_kv_str(w, "description", get_metric_description((system_metric_t)i));
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+}
+
+/**
+ * @brief json_writer sink that only folds the output into a CRC-32
+ */
+static esp_err_t crc_flush(void *ctx, const char *data, size_t len) {
+    uint32_t *crc = ctx;
+    if (len > 0) {
+        *crc = esp_rom_crc32_le(*crc, (const uint8_t *)data, len);
+    }
+    return ESP_OK;
+}
+
+const char *metrics_export_schema_version(void) {
+    if (schema_version[0] == '\0') {
+        uint32_t crc = 0;
+        json_writer_t w;
+        json_writer_init(&w, crc_flush, &crc);
+        json_obj_begin(&w);
+        write_schema_body(&w);
+        json_obj_end(&w);
+        json_writer_finish(&w);
+        snprintf(schema_version, sizeof(schema_version), "%08" PRIx32, crc);
+    }
+    return schema_version;
+}
+
+esp_err_t metrics_export_schema_handler(httpd_req_t *req) {
+    const char *version = metrics_export_schema_version();
+
+    char query[32];
+    char v[sizeof(schema_version)] = "";
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "v", v, sizeof(v));
+    }
+    if (strcmp(v, version) != 0) {
+        // Missing or stale version: send the client to the URL it may cache
+        char location[sizeof(METRICS_EXPORT_SCHEMA_URI) + 16];
+        snprintf(location, sizeof(location), METRICS_EXPORT_SCHEMA_URI "?v=%s", version);
+        httpd_resp_set_status(req, "302 Found");
+        httpd_resp_set_hdr(req, "Location", location);
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    char etag[sizeof(schema_version) + 2];
+    snprintf(etag, sizeof(etag), "\"%s\"", version);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=" METRICS_EXPORT_SCHEMA_MAX_AGE ", immutable");
+
+    char if_none_match[64];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strstr(if_none_match, etag) != NULL) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    json_obj_begin(&w);
+    json_kv_str(&w, "version", version);
+    write_schema_body(&w);
+    json_obj_end(&w);
+    esp_err_t err = json_writer_finish(&w);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Schema aborted: %s", esp_err_to_name(err));
+    }
+    return err;
+}
@@ -0,0 +1,739 @@
+/**
+ * @file metrics_stream.c
+ * @brief WebSocket push stream of live system metrics
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "metrics_stream.h"
+#include "SystemMetrics.h"
+#include "ota_manager.h"
+#include "json_writer.h"
+#include "http_perf.h"
+#include "version.h"
+#include "static_mem.h"
+#include "http_arena.h"
+#include "node_table.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register metrics_stream.c version
+REGISTER_VERSION(MetricsStream, "1.0.0", "2026-10-14");
+static const char *TAG = "METRICS_STREAM";
+
+#define FRAME_HEADER_FULL "{\"type\":\"full\",\"metrics\":["
+#define FRAME_HEADER_DELTA "{\"type\":\"delta\",\"metrics\":["
+#define FRAME_TRAILER "]}"
+#define ENTRY_MAX_LEN 260
+#define OTA_FRAME_MAX 640
+#define EVENT_FRAME_MAX 384
+#define FLEET_HEADER_FULL "{\"type\":\"fleet\",\"full\":true,\"now\":%lu,\"nodes\":["
+#define FLEET_HEADER_DELTA "{\"type\":\"fleet\",\"now\":%lu,\"nodes\":["
+#define FLEET_ENTRY_MAX 288
+#define FLEET_NONE 0x80000000u                  // Field value not known yet: sent as null
+
+typedef struct {
+    int fd;                                     // Socket of the WebSocket client
+    bool needs_full;                            // Next metrics frame must be a full snapshot
+    bool needs_fleet;                           // Next fleet frame must list every node in full
+    bool metrics;                               // Sent the metrics frames ("metrics=0" turns them off)
+    bool fleet;                                 // Sent the fleet frames ("fleet=0" turns them off)
+} stream_subscriber_t;
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;                                 // Room before the trailer
+} frame_builder_t;
+
+/**
+ * @brief Per-node fields of a fleet frame; each is diffed on its own
+ */
+typedef enum {
+    FLEET_ID = 0,                               // Node id from its telemetry, hex
+    FLEET_SEEN,                                 // Uptime ms of its last frame; the page takes "now" minus this
+    FLEET_RSSI,                                 // dBm, smoothed
+    FLEET_QUALITY,                              // Permille of samples received
+    FLEET_LOST,
+    FLEET_SUPPLY,                               // mV
+    FLEET_BACKLOG,                              // Records waiting on the node
+    FLEET_AWAKE,                                // 0.01 %
+    FLEET_TEMPERATURE,                          // 0.01 degC
+    FLEET_HUMIDITY,                             // 0.001 %RH
+    FLEET_PRESSURE,                             // Pa
+    FLEET_READING_TIME,                         // Unix seconds of the reading
+    FLEET_FIELD_COUNT
+} fleet_field_t;
+
+static const char *const fleet_keys[FLEET_FIELD_COUNT] = {
+    "id", "seen", "rssi", "q", "lost", "mv", "bl", "aw", "t", "h", "p", "ts"
+};
+
+// The metric snapshot is only touched on the httpd task. The subscriber list
+// is also read by the sampler task for OTA events, so it and every send
+// (two tasks must not interleave frames on one socket) hold stream_lock.
+static httpd_handle_t stream_server = NULL;
+static SemaphoreHandle_t stream_lock = NULL;
+static TaskHandle_t sampler_task_handle = NULL;
+STATIC_TASK_SLOT(sampler_task_slot, METRICS_STREAM_TASK_STACK_SIZE);
+static stream_subscriber_t subscribers[METRICS_STREAM_MAX_CLIENTS];
+static volatile uint32_t subscriber_count = 0;
+static volatile uint32_t sample_interval_ms = METRICS_STREAM_INTERVAL_MS;
+static volatile bool sample_pending = false;
+static uint32_t last_hash[METRIC_COUNT];        // Hash of each metric's last sent entry
+static bool have_snapshot = false;
+static ota_state_t last_ota_state = OTA_STATE_IDLE;
+static char ota_frame[OTA_FRAME_MAX];           // Sampler task only
+static uint32_t fleet_sent[NODE_TABLE_MAX_NODES][FLEET_FIELD_COUNT];  // Last value sent per node, httpd task
+static bool fleet_known[NODE_TABLE_MAX_NODES];  // fleet_sent holds what every fleet subscriber has
+static bool have_fleet = false;
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t metrics_ws_handler(httpd_req_t *req);
+static void sampler_task(void *pvParameter);
+static void sample_and_send(void *arg);
+static void add_subscriber(int fd);
+static void remove_subscriber(uint32_t index);
+static bool frame_append(frame_builder_t *frame, const char *text, size_t len);
+static void frame_finish(frame_builder_t *frame);
+static void send_frame(const frame_builder_t *frame, bool full, bool fleet);
+static void send_metrics(void);
+static void fleet_values(const node_table_entry_t *e, uint32_t *values);
+static int fleet_entry(char *buf, size_t len, size_t n, const node_table_entry_t *e, const uint32_t *values,
+                       bool all);
+static void send_fleet(void);
+static esp_err_t ota_frame_flush(void *ctx, const char *data, size_t len);
+static bool push_ota_progress(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void add_subscriber(int fd) {
+    xSemaphoreTake(stream_lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < subscriber_count; i++) {
+        if (subscribers[i].fd == fd) {
+            subscribers[i].needs_full = true;
+            subscribers[i].needs_fleet = true;
+            xSemaphoreGive(stream_lock);
+            return;
+        }
+    }
+
+    if (subscriber_count >= METRICS_STREAM_MAX_CLIENTS) {
+        xSemaphoreGive(stream_lock);
+        ESP_LOGW(TAG, "Subscriber limit (%d) reached, fd %d will not receive updates",
+                 METRICS_STREAM_MAX_CLIENTS, fd);
+        return;
+    }
+
+    subscribers[subscriber_count].fd = fd;
+    subscribers[subscriber_count].needs_full = true;
+    subscribers[subscriber_count].needs_fleet = true;
+    subscribers[subscriber_count].metrics = true;
+    subscribers[subscriber_count].fleet = true;
+    subscriber_count++;
+    xSemaphoreGive(stream_lock);
+    ESP_LOGI(TAG, "Subscriber added (fd %d), %lu active", fd, (unsigned long)subscriber_count);
+}
+
+/**
+ * @brief Drop a subscriber (caller holds stream_lock)
+ */
+static void remove_subscriber(uint32_t index) {
+    ESP_LOGI(TAG, "Subscriber removed (fd %d)", subscribers[index].fd);
+    subscribers[index] = subscribers[subscriber_count - 1];
+    subscriber_count--;
+    if (subscriber_count == 0) {
+        have_snapshot = false;
+        have_fleet = false;
+    }
+}
+
+/**
+ * @brief Append to a frame, refusing text that would overflow it
+ */
+static bool frame_append(frame_builder_t *frame, const char *text, size_t len) {
+    if (frame->data == NULL || frame->len + len > frame->cap) {
+        return false;
+    }
+    memcpy(frame->data + frame->len, text, len);
+    frame->len += len;
+    return true;
+}
+
+/**
+ * @brief Close the JSON document (buffers reserve room for the trailer)
+ */
+static void frame_finish(frame_builder_t *frame) {
+    if (frame->data != NULL) {
+        memcpy(frame->data + frame->len, FRAME_TRAILER, strlen(FRAME_TRAILER));
+        frame->len += strlen(FRAME_TRAILER);
+    }
+}
+
+/**
+ * @brief Send a frame to every subscriber that wants this kind of frame (caller holds stream_lock)
+ *
+ * @param full A full snapshot, for the subscribers that need one; else a delta, for the rest
+ * @param fleet A fleet frame rather than a metrics frame
+ */
+static void send_frame(const frame_builder_t *frame, bool full, bool fleet) {
+    httpd_ws_frame_t ws_frame = {
+        .final = true,
+        .fragmented = false,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)frame->data,
+        .len = frame->len
+    };
+
+    uint32_t i = 0;
+    while (i < subscriber_count) {
+        stream_subscriber_t *sub = &subscribers[i];
+        bool *needs = fleet ? &sub->needs_fleet : &sub->needs_full;
+        if (!(fleet ? sub->fleet : sub->metrics) || *needs != full) {
+            i++;
+            continue;
+        }
+
+        if (httpd_ws_get_fd_info(stream_server, sub->fd) != HTTPD_WS_CLIENT_WEBSOCKET ||
+            httpd_ws_send_frame_async(stream_server, sub->fd, &ws_frame) != ESP_OK) {
+            remove_subscriber(i);
+            continue;  // The last subscriber moved into slot i
+        }
+        *needs = false;
+        i++;
+    }
+}
+
+/**
+ * @brief Sample the metrics and the fleet once and fan the results out (runs on the httpd task)
+ */
+static void sample_and_send(void *arg) {
+    (void)arg;
+    sample_pending = false;
+
+    if (stream_server == NULL || subscriber_count == 0) {
+        return;
+    }
+    send_metrics();
+    send_fleet();
+}
+
+/**
+ * @brief Snapshot every metric once and send the full and delta frames
+ */
+static void send_metrics(void) {
+    bool any_full = false;
+    bool any = false;
+    for (uint32_t i = 0; i < subscriber_count; i++) {
+        any |= subscribers[i].metrics;
+        any_full |= subscribers[i].metrics && subscribers[i].needs_full;
+    }
+    if (!any) {
+        have_snapshot = false;
+        return;
+    }
+
+    const size_t alloc_len = METRICS_STREAM_FRAME_MAX + strlen(FRAME_TRAILER);
+    // Server work between requests: the frames come from the request arena, released below
+    http_arena_begin(NULL);
+    frame_builder_t full = { .data = any_full ? http_arena_malloc(alloc_len) : NULL, .len = 0,
+                             .cap = METRICS_STREAM_FRAME_MAX };
+    frame_builder_t delta = { .data = http_arena_malloc(alloc_len), .len = 0, .cap = METRICS_STREAM_FRAME_MAX };
+    if ((any_full && full.data == NULL) || delta.data == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate metrics frame buffers");
+        http_arena_free(delta.data);
+        http_arena_free(full.data);
+        http_arena_end(NULL);
+        return;
+    }
+
+    frame_append(&full, FRAME_HEADER_FULL, strlen(FRAME_HEADER_FULL));
+    frame_append(&delta, FRAME_HEADER_DELTA, strlen(FRAME_HEADER_DELTA));
+    size_t full_header_len = full.len;
+    size_t delta_header_len = delta.len;
+
+    char entry[ENTRY_MAX_LEN + 1];
+    uint32_t changed = 0;
+
+    // One batch, a sample at a time: the task stack has no room for more
+    metric_batch_t batch;
+    metric_sample_t sample;
+    system_metrics_batch_init(&batch, METRIC_MASK_ALL, true);
+    while (system_metrics_collect(&batch, &sample, 1) > 0) {
+        int i = (int)sample.metric;
+
+        // Leading comma is skipped for the first entry of each frame
+        entry[0] = ',';
+        int len = format_metric_json(entry + 1, sizeof(entry) - 1, sample.metric, sample.value.s, sample.error);
+        if (len < 0 || (size_t)len >= sizeof(entry) - 1) {
+            len = (int)strlen(entry + 1);
+        }
+
+        uint32_t hash = 2166136261u;  // FNV-1a
+        for (int b = 1; b <= len; b++) {
+            hash = (hash ^ (uint8_t)entry[b]) * 16777619u;
+        }
+
+        bool first_full = full.len == full_header_len;
+        frame_append(&full, first_full ? entry + 1 : entry, first_full ? len : len + 1);
+
+        // Entries that do not fit this frame stay "changed" and go out next time
+        bool first_delta = delta.len == delta_header_len;
+        if ((!have_snapshot || hash != last_hash[i]) &&
+            frame_append(&delta, first_delta ? entry + 1 : entry, first_delta ? len : len + 1)) {
+            last_hash[i] = hash;
+            changed++;
+        }
+    }
+    have_snapshot = true;
+
+    frame_finish(&full);
+    frame_finish(&delta);
+
+    // Deltas first, so subscribers that just got their snapshot are not sent both
+    xSemaphoreTake(stream_lock, portMAX_DELAY);
+    if (changed > 0) {
+        send_frame(&delta, false, false);
+    }
+    if (any_full) {
+        send_frame(&full, true, false);
+    }
+    xSemaphoreGive(stream_lock);
+
+    ESP_LOGD(TAG, "Pushed %lu changed metrics to %lu subscribers",
+             (unsigned long)changed, (unsigned long)subscriber_count);
+    http_arena_free(delta.data);
+    http_arena_free(full.data);
+    http_arena_end(NULL);
+}
+
+/**
+ * @brief The fleet fields of one node, FLEET_NONE where it has not reported them
+ */
+static void fleet_values(const node_table_entry_t *e, uint32_t *values) {
+    values[FLEET_ID] = e->node_id;
+    values[FLEET_SEEN] = e->last_seen_ms;
+    values[FLEET_RSSI] = (uint32_t)(int32_t)(e->rssi_x16 / 16);
+    values[FLEET_QUALITY] = e->quality_permille;
+    values[FLEET_LOST] = e->lost;
+    values[FLEET_SUPPLY] = e->supply_mv != NODE_TABLE_HEALTH_UNKNOWN ? e->supply_mv : FLEET_NONE;
+    values[FLEET_BACKLOG] = e->backlog != NODE_TABLE_HEALTH_UNKNOWN ? e->backlog : FLEET_NONE;
+    values[FLEET_AWAKE] = e->awake_bp != NODE_TABLE_AWAKE_UNKNOWN ? e->awake_bp : FLEET_NONE;
+    values[FLEET_TEMPERATURE] = e->have_reading ? (uint32_t)(int32_t)e->temperature : FLEET_NONE;
+    values[FLEET_HUMIDITY] = e->have_reading ? e->humidity : FLEET_NONE;
+    values[FLEET_PRESSURE] = e->have_reading ? e->pressure : FLEET_NONE;
+    values[FLEET_READING_TIME] = e->have_reading ? e->reading_s : FLEET_NONE;
+}
+
+/**
+ * @brief Format one node of a fleet frame, with a leading comma: {"i":n,"mac":...,changed fields}
+ *
+ * @param n Node index (node_table_get() order, which never changes)
+ * @param values This pass's values
+ * @param all Every field and the MAC; otherwise only the fields that differ from fleet_sent[n]
+ * @return int Length, 0 if nothing changed, or -1 if it does not fit buf
+ */
+static int fleet_entry(char *buf, size_t len, size_t n, const node_table_entry_t *e, const uint32_t *values,
+                       bool all) {
+    size_t pos = 0;
+    int added = snprintf(buf, len, ",{\"i\":%u", (unsigned)n);
+    if (all) {
+        added += snprintf(buf + added, len - added, ",\"mac\":\"" MACSTR "\"", MAC2STR(e->mac));
+    }
+    pos = (size_t)added;
+    bool changed = all;
+    for (int f = 0; f < FLEET_FIELD_COUNT && pos < len; f++) {
+        if (!all && values[f] == fleet_sent[n][f]) {
+            continue;
+        }
+        changed = true;
+        if (values[f] == FLEET_NONE) {
+            added = snprintf(buf + pos, len - pos, ",\"%s\":null", fleet_keys[f]);
+        } else if (f == FLEET_ID) {
+            added = snprintf(buf + pos, len - pos, ",\"%s\":\"%08lx\"", fleet_keys[f], (unsigned long)values[f]);
+        } else if (f == FLEET_RSSI || f == FLEET_TEMPERATURE) {
+            added = snprintf(buf + pos, len - pos, ",\"%s\":%ld", fleet_keys[f], (long)(int32_t)values[f]);
+        } else {
+            added = snprintf(buf + pos, len - pos, ",\"%s\":%lu", fleet_keys[f], (unsigned long)values[f]);
+        }
+        pos += (size_t)added;
+    }
+    if (pos + 1 >= len) {
+        return -1;
+    }
+    if (!changed) {
+        return 0;
+    }
+    buf[pos++] = '}';
+    return (int)pos;
+}
+
+/**
+ * @brief Send every node's fields that changed since the last pass, and the whole fleet to new subscribers
+ *
+ * The node table is on the gateway; elsewhere it is empty and nothing goes out.
+ * A node that does not fit a frame is marked unknown, so the next delta
+ * carries it in full, to everybody.
+ */
+static void send_fleet(void) {
+    bool any_full = false;
+    bool any = false;
+    for (uint32_t i = 0; i < subscriber_count; i++) {
+        any |= subscribers[i].fleet;
+        any_full |= subscribers[i].fleet && subscribers[i].needs_fleet;
+    }
+    size_t count = node_table_count();
+    if (!any) {
+        have_fleet = false;
+        return;
+    }
+    if (count == 0) {
+        return;
+    }
+    if (!have_fleet) {
+        memset(fleet_known, 0, sizeof(fleet_known));
+        have_fleet = true;
+    }
+
+    const size_t alloc_len = METRICS_STREAM_FLEET_FRAME_MAX + strlen(FRAME_TRAILER);
+    http_arena_begin(NULL);
+    frame_builder_t full = { .data = any_full ? http_arena_malloc(alloc_len) : NULL, .len = 0,
+                             .cap = METRICS_STREAM_FLEET_FRAME_MAX };
+    frame_builder_t delta = { .data = http_arena_malloc(alloc_len), .len = 0,
+                              .cap = METRICS_STREAM_FLEET_FRAME_MAX };
+    if ((any_full && full.data == NULL) || delta.data == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate fleet frame buffers");
+        http_arena_free(delta.data);
+        http_arena_free(full.data);
+        http_arena_end(NULL);
+        return;
+    }
+
+    char entry[FLEET_ENTRY_MAX];
+    unsigned long now_ms = (unsigned long)(esp_timer_get_time() / 1000);
+    int len = snprintf(entry, sizeof(entry), FLEET_HEADER_FULL, now_ms);
+    frame_append(&full, entry, (size_t)len);
+    len = snprintf(entry, sizeof(entry), FLEET_HEADER_DELTA, now_ms);
+    frame_append(&delta, entry, (size_t)len);
+    size_t full_header_len = full.len;
+    size_t delta_header_len = delta.len;
+    uint32_t changed = 0;
+
+    for (size_t n = 0; n < count && n < NODE_TABLE_MAX_NODES; n++) {
+        node_table_entry_t e;
+        uint32_t values[FLEET_FIELD_COUNT];
+        if (!node_table_get(n, &e)) {
+            break;
+        }
+        fleet_values(&e, values);
+
+        // Leading comma is skipped for the first entry of each frame
+        len = fleet_entry(entry, sizeof(entry), n, &e, values, !fleet_known[n]);
+        bool first = delta.len == delta_header_len;
+        if (len > 0 && frame_append(&delta, first ? entry + 1 : entry, first ? len - 1 : len)) {
+            memcpy(fleet_sent[n], values, sizeof(values));
+            fleet_known[n] = true;
+            changed++;
+        }
+
+        len = fleet_entry(entry, sizeof(entry), n, &e, values, true);
+        first = full.len == full_header_len;
+        if (full.data != NULL && (len < 0 || !frame_append(&full, first ? entry + 1 : entry, first ? len - 1 : len))) {
+            fleet_known[n] = false;
+        }
+    }
+
+    frame_finish(&full);
+    frame_finish(&delta);
+
+    xSemaphoreTake(stream_lock, portMAX_DELAY);
+    if (changed > 0) {
+        send_frame(&delta, false, true);
+    }
+    if (any_full) {
+        send_frame(&full, true, true);
+    }
+    xSemaphoreGive(stream_lock);
+
+    ESP_LOGD(TAG, "Pushed %lu changed nodes to %lu subscribers", (unsigned long)changed,
+             (unsigned long)subscriber_count);
+    http_arena_free(delta.data);
+    http_arena_free(full.data);
+    http_arena_end(NULL);
+}
+
+static esp_err_t ota_frame_flush(void *ctx, const char *data, size_t len) {
+    frame_builder_t *frame = (frame_builder_t *)ctx;
+    if (data == NULL) {
+        return ESP_OK;  // End of document
+    }
+    if (frame->len + len > OTA_FRAME_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(frame->data + frame->len, data, len);
+    frame->len += len;
+    return ESP_OK;
+}
+
+/**
+ * @brief Send the OTA status to every subscriber while an update runs (sampler task)
+ * @return true if an update is in progress, so the caller keeps the fast period
+ */
+static bool push_ota_progress(void) {
+    ota_status_t status;
+    ota_get_status(&status);
+
+    bool busy = status.state == OTA_STATE_UPLOADING || status.state == OTA_STATE_VERIFYING ||
+                status.state == OTA_STATE_FLASHING;
+    bool changed = status.state != last_ota_state;
+    last_ota_state = status.state;
+    if ((!busy && !changed) || stream_server == NULL || subscriber_count == 0) {
+        return busy;
+    }
+
+    frame_builder_t frame = { .data = ota_frame, .len = 0 };
+    json_writer_t w;
+    json_writer_init(&w, ota_frame_flush, &frame);
+    json_obj_begin(&w);
+    json_kv_str(&w, "type", "ota");
+    json_key(&w, "ota");
+    json_obj_begin(&w);
+    ota_write_status_json(&w, &status);
+    json_obj_end(&w);
+    json_obj_end(&w);
+    if (json_writer_finish(&w) != ESP_OK) {
+        ESP_LOGW(TAG, "OTA event does not fit %d bytes", OTA_FRAME_MAX);
+        return busy;
+    }
+
+    httpd_ws_frame_t ws_frame = {
+        .final = true,
+        .fragmented = false,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)frame.data,
+        .len = frame.len
+    };
+
+    // Failed clients are left for the httpd-side sender to drop
+    xSemaphoreTake(stream_lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < subscriber_count; i++) {
+        httpd_ws_send_frame_async(stream_server, subscribers[i].fd, &ws_frame);
+    }
+    xSemaphoreGive(stream_lock);
+    return busy;
+}
+
+/**
+ * @brief Queue one sample per period while anybody is subscribed
+ */
+static void sampler_task(void *pvParameter) {
+    (void)pvParameter;
+    bool ota_busy = false;
+    TickType_t last_sample = 0;
+
+    while (1) {
+        // Sleep indefinitely when idle; a new subscriber wakes us straight away
+        TickType_t interval = pdMS_TO_TICKS(sample_interval_ms);
+        TickType_t wait = subscriber_count > 0 ? interval : portMAX_DELAY;
+        if (subscriber_count > 0 && ota_busy) {
+            wait = pdMS_TO_TICKS(METRICS_STREAM_OTA_INTERVAL_MS);
+        }
+        bool notified = ulTaskNotifyTake(pdTRUE, wait) > 0;
+
+        ota_busy = push_ota_progress();
+        if (!notified && xTaskGetTickCount() - last_sample < interval) {
+            continue;  // Woken early for an OTA event only
+        }
+        last_sample = xTaskGetTickCount();
+
+        httpd_handle_t server = stream_server;
+        if (server == NULL || subscriber_count == 0 || sample_pending) {
+            continue;
+        }
+
+        sample_pending = true;
+        if (httpd_queue_work(server, sample_and_send, NULL) != ESP_OK) {
+            sample_pending = false;
+            ESP_LOGW(TAG, "Failed to queue metrics sample");
+        }
+    }
+}
+
+static esp_err_t metrics_ws_handler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) {
+        // Handshake complete - subscribe and get a full snapshot out promptly
+        add_subscriber(httpd_req_to_sockfd(req));
+        if (sampler_task_handle != NULL) {
+            xTaskNotifyGive(sampler_task_handle);
+        }
+        return ESP_OK;
+    }
+
+    httpd_ws_frame_t frame = { .type = HTTPD_WS_TYPE_TEXT };
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read frame length: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    uint8_t payload[32];
+    if (frame.len == 0 || frame.len >= sizeof(payload)) {
+        return ESP_OK;  // Nothing we understand; ignore it
+    }
+
+    frame.payload = payload;
+    err = httpd_ws_recv_frame(req, &frame, frame.len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read frame: %s", esp_err_to_name(err));
+        return err;
+    }
+    payload[frame.len] = '\0';
+
+    unsigned long interval_ms = 0;
+    unsigned on = 0;
+    if (frame.type != HTTPD_WS_TYPE_TEXT) {
+        return ESP_OK;
+    }
+    if (sscanf((const char *)payload, "interval=%lu", &interval_ms) == 1) {
+        metrics_stream_set_interval((uint32_t)interval_ms);
+    } else if (sscanf((const char *)payload, "metrics=%u", &on) == 1 ||
+               sscanf((const char *)payload, "fleet=%u", &on) == 1) {
+        bool fleet = payload[0] == 'f';
+        int fd = httpd_req_to_sockfd(req);
+        xSemaphoreTake(stream_lock, portMAX_DELAY);
+        for (uint32_t i = 0; i < subscriber_count; i++) {
+            if (subscribers[i].fd == fd) {
+                // Turned back on, the next frame of that kind is a full one
+                if (fleet) {
+                    subscribers[i].fleet = on != 0;
+                    subscribers[i].needs_fleet = true;
+                } else {
+                    subscribers[i].metrics = on != 0;
+                    subscribers[i].needs_full = true;
+                }
+            }
+        }
+        xSemaphoreGive(stream_lock);
+    }
+    return ESP_OK;
+}
+
+esp_err_t metrics_stream_start(httpd_handle_t server) {
+    if (server == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (stream_lock == NULL) {
+        stream_lock = xSemaphoreCreateMutex();
+        if (stream_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    httpd_uri_t ws_uri = {
+        .uri = METRICS_STREAM_URI,
+        .method = HTTP_GET,
+        .handler = metrics_ws_handler,
+        .user_ctx = NULL,
+        .is_websocket = true
+    };
+    esp_err_t err = http_perf_register(server, &ws_uri);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register %s: %s", METRICS_STREAM_URI, esp_err_to_name(err));
+        return err;
+    }
+
+    subscriber_count = 0;
+    have_snapshot = false;
+    have_fleet = false;
+    sample_pending = false;
+    stream_server = server;
+
+    if (sampler_task_handle == NULL) {
+        BaseType_t created = static_task_create(sampler_task_slot, sampler_task, METRICS_STREAM_TASK_NAME,
+                                                METRICS_STREAM_TASK_STACK_SIZE, NULL, METRICS_STREAM_TASK_PRIORITY,
+                                                &sampler_task_handle, TASK_CORE_NET);
+        if (created != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create sampler task");
+            stream_server = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    ESP_LOGI(TAG, "Metrics stream ready on %s (every %lu ms)",
+             METRICS_STREAM_URI, (unsigned long)sample_interval_ms);
+    return ESP_OK;
+}
+
+void metrics_stream_stop(void) {
+    // The sampler task stays parked on its notification until the next start
+    if (stream_lock != NULL) {
+        xSemaphoreTake(stream_lock, portMAX_DELAY);
+    }
+    stream_server = NULL;
+    subscriber_count = 0;
+    have_snapshot = false;
+    have_fleet = false;
+    if (stream_lock != NULL) {
+        xSemaphoreGive(stream_lock);
+    }
+}
+
+void metrics_stream_push_event(const char *type, const char *json, size_t len) {
+    if (stream_server == NULL || stream_lock == NULL || subscriber_count == 0) {
+        return;
+    }
+    char frame[EVENT_FRAME_MAX];
+    int n = snprintf(frame, sizeof(frame), "{\"type\":\"%s\",\"%s\":%.*s}", type, type, (int)len, json);
+    if (n < 0 || n >= (int)sizeof(frame)) {
+        ESP_LOGW(TAG, "%s event does not fit %d bytes", type, EVENT_FRAME_MAX);
+        return;
+    }
+
+    httpd_ws_frame_t ws_frame = {
+        .final = true,
+        .fragmented = false,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)frame,
+        .len = (size_t)n
+    };
+
+    // Failed clients are left for the httpd-side sender to drop
+    xSemaphoreTake(stream_lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < subscriber_count; i++) {
+        httpd_ws_send_frame_async(stream_server, subscribers[i].fd, &ws_frame);
+    }
+    xSemaphoreGive(stream_lock);
+}
+
+void metrics_stream_set_interval(uint32_t interval_ms) {
+    if (interval_ms < METRICS_STREAM_MIN_INTERVAL_MS) {
+        interval_ms = METRICS_STREAM_MIN_INTERVAL_MS;
+    } else if (interval_ms > METRICS_STREAM_MAX_INTERVAL_MS) {
+        interval_ms = METRICS_STREAM_MAX_INTERVAL_MS;
+    }
+
+    if (interval_ms != sample_interval_ms) {
+        sample_interval_ms = interval_ms;
+        ESP_LOGI(TAG, "Sampling every %lu ms", (unsigned long)interval_ms);
+    }
+}
@@ -0,0 +1,311 @@
+/**
+ * @file motion.c
+ * @brief Boat attitude from an ICM-20948 on the shared I2C bus: batched complementary filter at about 100 Hz
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "motion.h"
+#include "i2c_bus.h"
+#include "icm20948.h"
+#include "static_mem.h"
+#include "version.h"
+#include <math.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register motion.c version
+REGISTER_VERSION(Motion, "1.0.0", "2026-10-15");
+
+static const char *TAG = "MOTION";
+
+#define DEG_PER_RAD 57.29578f
+#define MAST_SLOTS (MOTION_MAST_AVG_MS / MOTION_BATCH_MS)
+
+static icm20948_t imu;
+static i2c_bus_device_handle_t imu_dev = NULL;
+static icm20948_sample_t batch[MOTION_BATCH_MAX];   // Motion task only
+
+// Filter state, motion task only: radians
+static float roll = 0.0f;
+static float pitch = 0.0f;
+static bool primed = false;
+static float sample_dt = 0.0f;                  // Seconds between IMU samples
+static float gyro_scale = 0.0f;                 // Counts to rad/s
+
+// Masthead velocity per batch, 0.01 m/s, for the MOTION_MAST_AVG_MS mean; motion task only
+static int16_t mast_x[MAST_SLOTS];
+static int16_t mast_y[MAST_SLOTS];
+static int32_t mast_x_sum = 0;
+static int32_t mast_y_sum = 0;
+static uint8_t mast_next = 0;
+static uint8_t mast_filled = 0;
+
+static motion_attitude_t attitude;              // lock
+static motion_stats_t stats;                    // lock
+static uint64_t fuse_us_total = 0;              // lock
+static int64_t started_us = 0;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static volatile bool stopping = false;
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(motion_task_slot, MOTION_TASK_STACK_SIZE);
+static SemaphoreHandle_t stopped_sem = NULL;
+
+// =============================
+// Function Prototypes
+// =============================
+static bool fuse(const icm20948_sample_t *samples, size_t count, motion_attitude_t *out);
+static void mast_add(int16_t vx, int16_t vy, int16_t *mean_x, int16_t *mean_y);
+static void motion_task(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Fuse one batch into roll and pitch
+ *
+ * The chip's axes (X bow, Y port, Z up) are turned into the aerospace
+ * body frame (X bow, Y starboard, Z down) on the fly: p = gx, q = -gy,
+ * r = -gz.
+ *
+ * @return bool Whether the accelerometer corrected the batch
+ */
+static bool fuse(const icm20948_sample_t *samples, size_t count, motion_attitude_t *out) {
+    int32_t ax = 0, ay = 0, az = 0;
+    int32_t gx = 0, gy = 0, gz = 0;
+
+    // Gravity direction from the whole batch, once
+    for (size_t i = 0; i < count; i++) {
+        ax += samples[i].accel[0];
+        ay += samples[i].accel[1];
+        az += samples[i].accel[2];
+    }
+    float fx = (float)ax / count;
+    float fy = (float)ay / count;
+    float fz = (float)az / count;
+    float norm2 = fx * fx + fy * fy + fz * fz;
+    float one_g = (float)ICM20948_ACCEL_LSB_PER_G;
+    float gate = one_g * MOTION_ACCEL_GATE_PCT / 100.0f;
+    float lo = one_g - gate;
+    float hi = one_g + gate;
+    bool accel_ok = norm2 >= lo * lo && norm2 <= hi * hi;
+    float roll_acc = atan2f(fy, fz);
+    float pitch_acc = atan2f(fx, sqrtf(fy * fy + fz * fz));
+    if (!primed) {
+        roll = roll_acc;
+        pitch = pitch_acc;
+        primed = true;
+    }
+
+    // Euler rates from body rates, with the trigonometry of the batch's starting attitude
+    float sr = sinf(roll);
+    float cr = cosf(roll);
+    float tp = tanf(pitch);
+    float k_roll_q = sr * tp * gyro_scale;
+    float k_roll_r = cr * tp * gyro_scale;
+    float k_pitch_q = cr * gyro_scale;
+    float k_pitch_r = -sr * gyro_scale;
+    float p_scale = gyro_scale;
+    for (size_t i = 0; i < count; i++) {
+        float p = samples[i].gyro[0];
+        float q = -samples[i].gyro[1];
+        float r = -samples[i].gyro[2];
+        roll += (p * p_scale + q * k_roll_q + r * k_roll_r) * sample_dt;
+        pitch += (q * k_pitch_q + r * k_pitch_r) * sample_dt;
+        gx += samples[i].gyro[0];
+        gy += samples[i].gyro[1];
+        gz += samples[i].gyro[2];
+    }
+
+    // Complementary step, once per batch: the batch length over the time constant
+    if (accel_ok) {
+        float k = sample_dt * count / (MOTION_FILTER_TAU_MS / 1000.0f + sample_dt * count);
+        roll += k * (roll_acc - roll);
+        pitch += k * (pitch_acc - pitch);
+    }
+
+    // Body rates of the batch, and the masthead velocity they cause: v = w x (0, 0, -h)
+    float p_mean = gx * gyro_scale / count;
+    float q_mean = -gy * gyro_scale / count;
+    float h = MOTION_MAST_HEIGHT_CM / 100.0f;
+    int16_t vx = (int16_t)lroundf(-q_mean * h * 100.0f);
+    int16_t vy = (int16_t)lroundf(p_mean * h * 100.0f);
+
+    out->roll = (int16_t)lroundf(roll * DEG_PER_RAD * 100.0f);
+    out->pitch = (int16_t)lroundf(pitch * DEG_PER_RAD * 100.0f);
+    out->roll_rate = (int16_t)lroundf(p_mean * DEG_PER_RAD * 10.0f);
+    out->pitch_rate = (int16_t)lroundf(q_mean * DEG_PER_RAD * 10.0f);
+    mast_add(vx, vy, &out->mast_vx, &out->mast_vy);
+    return accel_ok;
+}
+
+/**
+ * @brief Slide the masthead velocity window by one batch
+ */
+static void mast_add(int16_t vx, int16_t vy, int16_t *mean_x, int16_t *mean_y) {
+    if (mast_filled == MAST_SLOTS) {
+        mast_x_sum -= mast_x[mast_next];
+        mast_y_sum -= mast_y[mast_next];
+    } else {
+        mast_filled++;
+    }
+    mast_x[mast_next] = vx;
+    mast_y[mast_next] = vy;
+    mast_x_sum += vx;
+    mast_y_sum += vy;
+    mast_next = (uint8_t)((mast_next + 1) % MAST_SLOTS);
+    *mean_x = (int16_t)(mast_x_sum / mast_filled);
+    *mean_y = (int16_t)(mast_y_sum / mast_filled);
+}
+
+/**
+ * @brief Read and fuse one FIFO batch every MOTION_BATCH_MS, until stopped
+ */
+static void motion_task(void *arg) {
+    TickType_t last_wake = xTaskGetTickCount();
+    while (!stopping) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(MOTION_BATCH_MS));
+        size_t count = 0;
+        esp_err_t err = icm20948_read_fifo(&imu, batch, MOTION_BATCH_MAX, &count);
+        if (err != ESP_OK || count == 0) {
+            portENTER_CRITICAL(&lock);
+            if (err == ESP_ERR_INVALID_SIZE) {
+                stats.overflows++;
+            } else if (err != ESP_OK) {
+                stats.errors++;
+            }
+            portEXIT_CRITICAL(&lock);
+            continue;
+        }
+
+        motion_attitude_t next;
+        int64_t start = esp_timer_get_time();
+        bool corrected = fuse(batch, count, &next);
+        int64_t now = esp_timer_get_time();
+        uint32_t took = (uint32_t)(now - start);
+        next.valid = true;
+        next.time_us = now;
+
+        portENTER_CRITICAL(&lock);
+        attitude = next;
+        stats.samples += count;
+        stats.batches++;
+        if (!corrected) {
+            stats.gated++;
+        }
+        if (took > stats.fuse_us_max) {
+            stats.fuse_us_max = took;
+        }
+        fuse_us_total += took;
+        portEXIT_CRITICAL(&lock);
+    }
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t motion_start(void) {
+    if (task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = i2c_bus_add_device("icm20948", MOTION_IMU_ADDRESS, MOTION_IMU_SPEED_HZ, &imu_dev);
+    if (err != ESP_OK) {
+        return err;
+    }
+    icm20948_config_t cfg = {
+        .transfer = i2c_bus_transfer,
+        .transfer_ctx = imu_dev,
+        .address = MOTION_IMU_ADDRESS,
+        .rate_divider = MOTION_RATE_DIVIDER,
+    };
+    err = icm20948_init(&imu, &cfg);
+    if (err != ESP_OK) {
+        i2c_bus_remove_device(imu_dev);
+        imu_dev = NULL;
+        return err;
+    }
+
+    sample_dt = 1000.0f / icm20948_rate_mhz(&imu);
+    gyro_scale = 10.0f / ICM20948_GYRO_LSB_PER_DPS_X10 / DEG_PER_RAD;
+    primed = false;
+    mast_x_sum = mast_y_sum = 0;
+    mast_next = mast_filled = 0;
+    portENTER_CRITICAL(&lock);
+    memset(&attitude, 0, sizeof(attitude));
+    memset(&stats, 0, sizeof(stats));
+    stats.running = true;
+    fuse_us_total = 0;
+    portEXIT_CRITICAL(&lock);
+    started_us = esp_timer_get_time();
+
+    if (stopped_sem == NULL) {
+        stopped_sem = xSemaphoreCreateBinary();
+    }
+    stopping = false;
+    if (stopped_sem == NULL ||
+        static_task_create(motion_task_slot, motion_task, MOTION_TASK_NAME, MOTION_TASK_STACK_SIZE, NULL,
+                           MOTION_TASK_PRIORITY, &task_handle, TASK_CORE_APP) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the motion task");
+        task_handle = NULL;
+        icm20948_deinit(&imu);
+        i2c_bus_remove_device(imu_dev);
+        imu_dev = NULL;
+        portENTER_CRITICAL(&lock);
+        stats.running = false;
+        portEXIT_CRITICAL(&lock);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Fusing batches every %d ms, mast %d cm", MOTION_BATCH_MS, MOTION_MAST_HEIGHT_CM);
+    return ESP_OK;
+}
+
+bool motion_get(motion_attitude_t *out) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&lock);
+    *out = attitude;
+    portEXIT_CRITICAL(&lock);
+    out->valid = out->valid && now - out->time_us < (int64_t)MOTION_STALE_MS * 1000;
+    return out->valid;
+}
+
+void motion_get_stats(motion_stats_t *out) {
+    int64_t elapsed = esp_timer_get_time() - started_us;
+    portENTER_CRITICAL(&lock);
+    *out = stats;
+    uint64_t busy = fuse_us_total;
+    portEXIT_CRITICAL(&lock);
+    out->load_permille = elapsed > 0 ? (uint16_t)(busy * 1000 / (uint64_t)elapsed) : 0;
+}
+
+void motion_stop(void) {
+    if (task_handle == NULL) {
+        return;
+    }
+    stopping = true;
+    if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(MOTION_STOP_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Motion task did not stop within %d ms", MOTION_STOP_TIMEOUT_MS);
+        return;                                 // Still reading; leave the IMU to it
+    }
+    task_handle = NULL;
+    icm20948_deinit(&imu);
+    i2c_bus_remove_device(imu_dev);
+    imu_dev = NULL;
+    portENTER_CRITICAL(&lock);
+    stats.running = false;
+    attitude.valid = false;
+    portEXIT_CRITICAL(&lock);
+}
@@ -0,0 +1,597 @@
+/**
+ * @file mqtt_cmd.c
+ * @brief Gateway remote control over MQTT: commands on <base>/cmd/<name>, answers on <base>/reply/<name>
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "mqtt_cmd.h"
+#include "config_schema.h"
+#include "discovery.h"
+#include "espnow_config.h"
+#include "fault_inject.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "log_policy.h"
+#include "metrics_export.h"
+#include "mqtt_forwarder.h"
+#include "nvs_utils.h"
+#include "ota_pull.h"
+#include "static_mem.h"
+#include "task_plan.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register mqtt_cmd.c version
+REGISTER_VERSION(MqttCmd, "1.0.0", "2026-10-15");
+
+static const char *TAG = "MQTT_CMD";
+
+#define ID_MAX 32                               // Longest "id" echoed back
+#define TAG_MAX 24                              // As log_level_post_handler()
+#define LEVEL_MAX 12
+#define NODE_ID_LEN 8                           // node/<8 hex digits>/config
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+typedef enum {
+    ROUTE_CONFIG = 0,
+    ROUTE_OTA,
+    ROUTE_METRICS,
+    ROUTE_LOG,
+    ROUTE_NODE,
+    ROUTE_FAULT,
+    ROUTE_COUNT
+} route_t;
+
+_Static_assert(MQTT_CMD_ROUTE_SLOTS >= 2 * ROUTE_COUNT &&
+               (MQTT_CMD_ROUTE_SLOTS & (MQTT_CMD_ROUTE_SLOTS - 1)) == 0,
+               "route table: a power of two, at most half full");
+
+static const struct {
+    const char *name;                           // First topic level
+    uint8_t len;
+} ROUTE_NAMES[ROUTE_COUNT] = {
+    [ROUTE_CONFIG]  = { "config", 6 },
+    [ROUTE_OTA]     = { "ota", 3 },
+    [ROUTE_METRICS] = { "metrics", 7 },
+    [ROUTE_LOG]     = { "log", 3 },
+    [ROUTE_NODE]    = { "node", 4 },
+    [ROUTE_FAULT]   = { "fault", 5 },
+};
+
+/**
+ * @brief One command for the worker, routed and copied in the client task
+ */
+typedef struct {
+    uint8_t route;                              // ROUTE_COUNT: answer with error
+    uint8_t name_len;
+    uint16_t len;
+    uint32_t node_id;                           // ROUTE_NODE
+    const char *error;                          // Found while routing, or NULL
+    char name[MQTT_CMD_NAME_MAX];
+    char data[MQTT_CMD_PAYLOAD_MAX];
+} cmd_job_t;
+
+/**
+ * @brief Members of a command payload, filled in by on_json_event()
+ */
+typedef struct {
+    uint8_t route;
+    char id[ID_MAX];
+    bool have_id;
+    bool id_number;                             // Echoed without quotes
+    // config
+    device_config_t cfg;
+    uint32_t fields_set;
+    // metrics
+    char group[16];
+    // log
+    char tag[TAG_MAX];
+    char level[LEVEL_MAX];
+    uint32_t duration_s;
+    // fault
+    char point[16];
+    fault_inject_profile_t fault;               // Members given; the rest keep their values
+    uint8_t fault_set;                          // Bit per FAULT_MEMBERS entry
+} cmd_parse_t;
+
+// cmd/fault members, in fault_inject_profile_t
+static const struct {
+    const char *name;
+    size_t offset;
+} FAULT_MEMBERS[] = {
+    { "drop", offsetof(fault_inject_profile_t, drop) },
+    { "delay", offsetof(fault_inject_profile_t, delay) },
+    { "duplicate", offsetof(fault_inject_profile_t, duplicate) },
+    { "reorder", offsetof(fault_inject_profile_t, reorder) },
+    { "delay_ms", offsetof(fault_inject_profile_t, delay_ms) },
+};
+#define FAULT_MEMBER_COUNT (sizeof(FAULT_MEMBERS) / sizeof(FAULT_MEMBERS[0]))
+
+/**
+ * @brief json_writer sink into the reply buffer
+ */
+typedef struct {
+    char *data;
+    size_t len;
+} reply_builder_t;
+
+static int8_t route_slots[MQTT_CMD_ROUTE_SLOTS];    // route_t, -1 empty; built once at start
+static QueueHandle_t queue = NULL;
+static StaticQueue_t queue_buf;
+static uint8_t queue_storage[MQTT_CMD_QUEUE * sizeof(cmd_job_t)];
+STATIC_TASK_SLOT(cmd_task_slot, MQTT_CMD_TASK_STACK_SIZE);
+static cmd_job_t routed;                        // esp-mqtt task only; the queue copies it out
+static cmd_job_t job;                           // Worker only
+static cmd_parse_t parse;                       // Worker only; too big for its stack with the config
+static char reply[MQTT_CMD_REPLY_MAX];          // Worker only
+static mqtt_cmd_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static uint32_t fnv1a(const char *s, size_t len);
+static int route_find(const char *name, size_t len);
+static void take_command(const char *name, size_t name_len, const char *data, size_t len);
+static esp_err_t on_json_event(void *ctx, const json_event_t *event);
+static esp_err_t reply_flush(void *ctx, const char *data, size_t len);
+static void reply_begin(json_writer_t *w, reply_builder_t *rb, bool ok);
+static const char *run_config(void);
+static const char *run_ota(void);
+static const char *run_metrics(json_writer_t *w);
+static const char *run_log(void);
+static const char *run_node(void);
+static const char *run_fault(json_writer_t *w);
+static void write_cmd_metrics(metrics_export_writer_t *w);
+static void cmd_task(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+static uint32_t fnv1a(const char *s, size_t len) {
+    uint32_t h = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)s[i]) * FNV_PRIME;
+    }
+    return h;
+}
+
+/**
+ * @brief The route for a first topic level, or -1; probes from its hash slot to the next empty one
+ */
+static int route_find(const char *name, size_t len) {
+    for (uint32_t i = fnv1a(name, len);; i++) {
+        int r = route_slots[i & (MQTT_CMD_ROUTE_SLOTS - 1)];
+        if (r < 0) {
+            return -1;
+        }
+        if (ROUTE_NAMES[r].len == len && memcmp(ROUTE_NAMES[r].name, name, len) == 0) {
+            return r;
+        }
+    }
+}
+
+/**
+ * @brief mqtt_forwarder command handler: route and queue; runs in the esp-mqtt task
+ */
+static void take_command(const char *name, size_t name_len, const char *data, size_t len) {
+    portENTER_CRITICAL(&stats_lock);
+    stats.received++;
+    portEXIT_CRITICAL(&stats_lock);
+    if (name_len >= MQTT_CMD_NAME_MAX) {
+        ESP_LOGW(TAG, "Command name too long (%u bytes), dropped", (unsigned)name_len);
+        portENTER_CRITICAL(&stats_lock);
+        stats.dropped++;
+        portEXIT_CRITICAL(&stats_lock);
+        return;
+    }
+
+    cmd_job_t *j = &routed;
+    memset(j, 0, offsetof(cmd_job_t, name));
+    memcpy(j->name, name, name_len);
+    j->name_len = (uint8_t)name_len;
+
+    const char *slash = memchr(name, '/', name_len);
+    size_t first_len = slash != NULL ? (size_t)(slash - name) : name_len;
+    int route = route_find(name, first_len);
+    j->route = route < 0 ? ROUTE_COUNT : (uint8_t)route;
+    if (route < 0) {
+        j->error = "unknown command";
+    } else if (route == ROUTE_NODE) {
+        // node/<id>/config: the only node command is its settings
+        char id_text[NODE_ID_LEN + 1];
+        char *end;
+        if (name_len != first_len + 1 + NODE_ID_LEN + sizeof("/config") - 1 ||
+            memcmp(name + first_len + 1 + NODE_ID_LEN, "/config", sizeof("/config") - 1) != 0) {
+            j->error = "expected node/<node id>/config";
+        } else {
+            memcpy(id_text, name + first_len + 1, NODE_ID_LEN);
+            id_text[NODE_ID_LEN] = '\0';
+            j->node_id = (uint32_t)strtoul(id_text, &end, 16);
+            if (*end != '\0') {
+                j->error = "bad node id";
+            }
+        }
+    } else if (slash != NULL) {
+        j->error = "unknown command";
+    }
+    if (len > MQTT_CMD_PAYLOAD_MAX) {
+        j->error = "payload too large";
+    } else {
+        memcpy(j->data, data, len);
+        j->len = (uint16_t)len;
+    }
+
+    if (xQueueSend(queue, j, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Command queue full, %.*s dropped", (int)name_len, name);
+        portENTER_CRITICAL(&stats_lock);
+        stats.dropped++;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+}
+
+static esp_err_t on_json_event(void *ctx, const json_event_t *event) {
+    cmd_parse_t *p = (cmd_parse_t *)ctx;
+    if (event->depth != 1 || event->key == NULL || event->value == NULL) {
+        return ESP_OK;
+    }
+    if (strcmp(event->key, "id") == 0 && (event->type == JSON_EVENT_STRING || event->type == JSON_EVENT_NUMBER)) {
+        strlcpy(p->id, event->value, sizeof(p->id));
+        p->have_id = true;
+        p->id_number = event->type == JSON_EVENT_NUMBER;
+        return ESP_OK;
+    }
+    switch (p->route) {
+    case ROUTE_CONFIG:
+        if (event->type == JSON_EVENT_STRING || event->type == JSON_EVENT_NUMBER) {
+            const config_field_t *field = config_schema_find_json(event->key);
+            if (field != NULL && config_schema_apply_json(&p->cfg, field, event->value, event->value_len)) {
+                p->fields_set++;
+            }
+        }
+        break;
+    case ROUTE_METRICS:
+        if (strcmp(event->key, "group") == 0) {
+            strlcpy(p->group, event->value, sizeof(p->group));
+        }
+        break;
+    case ROUTE_LOG:
+        if (strcmp(event->key, "tag") == 0) {
+            strlcpy(p->tag, event->value, sizeof(p->tag));
+        } else if (strcmp(event->key, "level") == 0) {
+            strlcpy(p->level, event->value, sizeof(p->level));
+        } else if (strcmp(event->key, "duration") == 0) {
+            p->duration_s = (uint32_t)strtoul(event->value, NULL, 10);
+        }
+        break;
+    case ROUTE_FAULT:
+        if (strcmp(event->key, "point") == 0) {
+            strlcpy(p->point, event->value, sizeof(p->point));
+            break;
+        }
+        for (size_t i = 0; i < FAULT_MEMBER_COUNT; i++) {
+            if (event->type == JSON_EVENT_NUMBER && strcmp(event->key, FAULT_MEMBERS[i].name) == 0) {
+                unsigned long n = strtoul(event->value, NULL, 10);
+                uint16_t v = n > UINT16_MAX ? UINT16_MAX : (uint16_t)n;
+                memcpy((uint8_t *)&p->fault + FAULT_MEMBERS[i].offset, &v, sizeof(v));
+                p->fault_set |= 1u << i;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t reply_flush(void *ctx, const char *data, size_t len) {
+    reply_builder_t *rb = (reply_builder_t *)ctx;
+    if (data == NULL) {
+        return ESP_OK;  // End of document
+    }
+    if (rb->len + len > sizeof(reply)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(rb->data + rb->len, data, len);
+    rb->len += len;
+    return ESP_OK;
+}
+
+/**
+ * @brief Open the answer object with the echoed id and the outcome
+ */
+static void reply_begin(json_writer_t *w, reply_builder_t *rb, bool ok) {
+    rb->data = reply;
+    rb->len = 0;
+    json_writer_init(w, reply_flush, rb);
+    json_obj_begin(w);
+    if (parse.have_id) {
+        json_key(w, "id");
+        if (parse.id_number) {
+            json_int(w, strtoll(parse.id, NULL, 10));
+        } else {
+            json_str(w, parse.id);
+        }
+    }
+    json_kv_bool(w, "ok", ok);
+}
+
+/**
+ * @brief cmd/config: the named settings over the stored ones, saved like a web save
+ */
+static const char *run_config(void) {
+    if (parse.fields_set == 0) {
+        return "no known settings";
+    }
+    if (config_schema_validate(&parse.cfg) != ESP_OK) {
+        return "invalid settings";
+    }
+    if (nvs_config_update(&parse.cfg) != ESP_OK) {
+        return "not saved";
+    }
+    if (discovery_is_running()) {
+        discovery_update_telemetry();           // The advertised broker and topic follow the config
+    }
+    ESP_LOGI(TAG, "%lu settings saved from MQTT", (unsigned long)parse.fields_set);
+    return NULL;
+}
+
+static const char *run_ota(void) {
+    ota_pull_stats_t ota;
+    ota_pull_get_stats(&ota);
+    if (!ota.running) {
+        return "no OTA pull on this gateway";
+    }
+    ota_pull_check_now();
+    return NULL;
+}
+
+/**
+ * @brief cmd/metrics: the members after "ok"; one group, or every metric
+ *
+ * A snapshot that outgrows the reply buffer fails at json_writer_finish().
+ */
+static const char *run_metrics(json_writer_t *w) {
+    metric_group_t group = METRIC_GROUP_COUNT;
+    if (parse.group[0] != '\0') {
+        group = get_metric_group_by_name(parse.group);
+        if (group == METRIC_GROUP_COUNT) {
+            return "unknown metric group";
+        }
+    }
+    metric_batch_t batch;
+    metric_sample_t sample;
+    system_metrics_batch_init(&batch, group != METRIC_GROUP_COUNT ? get_metric_group_mask(group) : METRIC_MASK_ALL,
+                              true);
+    json_key(w, "metrics");
+    json_arr_begin(w);
+    while (w->err == ESP_OK && system_metrics_collect(&batch, &sample, 1) > 0) {
+        // As format_metric_json(), which /api/metrics sends
+        json_obj_begin(w);
+        json_kv_int(w, "id", sample.metric);
+        if (sample.error == METRIC_OK) {
+            json_kv_str(w, "value", sample.value.s);
+            json_kv_str(w, "status", "ok");
+        } else {
+            json_kv_str(w, "value", get_metric_error_name(sample.error));
+            json_kv_str(w, "status", "error");
+        }
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+    return NULL;
+}
+
+/**
+ * @brief cmd/log: as POST /api/log_level
+ */
+static const char *run_log(void) {
+    esp_log_level_t level;
+    if (!log_policy_level_from_name(parse.level, &level)) {
+        return "missing or invalid level";
+    }
+    esp_err_t err = log_policy_set_level(parse.tag, level, parse.duration_s);
+    if (err == ESP_ERR_NOT_FOUND) {
+        return "unknown log tag";
+    }
+    return err == ESP_OK ? NULL : "invalid level";
+}
+
+/**
+ * @brief cmd/node/<id>/config: handed to espnow_config, which pushes it on the node's next frame
+ */
+static const char *run_node(void) {
+    esp_err_t err = espnow_config_gateway_set_json(job.node_id, job.data, job.len);
+    if (err == ESP_ERR_INVALID_ARG || err == ESP_ERR_INVALID_SIZE) {
+        return "invalid node settings";
+    }
+    return err == ESP_OK ? NULL : esp_err_to_name(err);
+}
+
+/**
+ * @brief cmd/fault: change the probabilities at one point; the members after "ok" are the profile in force
+ */
+static const char *run_fault(json_writer_t *w) {
+    fault_inject_point_t point;
+    if (!fault_inject_point_from_name(parse.point, &point)) {
+        return "missing or unknown point";
+    }
+    fault_inject_profile_t prof;
+    fault_inject_get(point, &prof);
+    for (size_t i = 0; i < FAULT_MEMBER_COUNT; i++) {
+        if (parse.fault_set & (1u << i)) {
+            size_t at = FAULT_MEMBERS[i].offset;
+            memcpy((uint8_t *)&prof + at, (const uint8_t *)&parse.fault + at, sizeof(uint16_t));
+        }
+    }
+    esp_err_t err = fault_inject_set(point, &prof);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        return "not a FAULT_INJECT build";
+    }
+    if (err != ESP_OK) {
+        return "more than 1000 permille";
+    }
+    for (size_t i = 0; i < FAULT_MEMBER_COUNT; i++) {
+        uint16_t v;
+        memcpy(&v, (const uint8_t *)&prof + FAULT_MEMBERS[i].offset, sizeof(v));
+        json_kv_uint(w, FAULT_MEMBERS[i].name, v);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Commands by outcome
+ */
+static void write_cmd_metrics(metrics_export_writer_t *w) {
+    mqtt_cmd_stats_t s;
+    mqtt_cmd_get_stats(&s);
+    metrics_export_family(w, "mqtt_commands", METRICS_EXPORT_COUNTER, NULL, "MQTT commands by outcome");
+    metrics_export_sample_int(w, "mqtt_commands", "_total", "outcome=\"ok\"", s.done);
+    metrics_export_sample_int(w, "mqtt_commands", "_total", "outcome=\"error\"", s.failed);
+    metrics_export_sample_int(w, "mqtt_commands", "_total", "outcome=\"dropped\"", s.dropped);
+    metrics_export_sample_int(w, "mqtt_commands", "_total", "outcome=\"unanswered\"", s.unanswered);
+}
+
+/**
+ * @brief Worker: parse each queued command, run it and answer it
+ */
+static void cmd_task(void *arg) {
+    json_reader_t reader;
+    json_writer_t w;
+    reply_builder_t rb;
+    for (;;) {
+        if (xQueueReceive(queue, &job, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        memset(&parse, 0, sizeof(parse));
+        parse.route = job.route;
+        strlcpy(parse.tag, LOG_POLICY_ALL_TAGS, sizeof(parse.tag));
+        parse.duration_s = LOG_POLICY_DEFAULT_BOOST_S;
+        if (job.route == ROUTE_CONFIG && nvs_config_get(&parse.cfg) != ESP_OK) {
+            ESP_LOGW(TAG, "Some stored config values failed to load, saving over them");
+        }
+
+        const char *error = job.error;
+        if (error == NULL && job.len > 0) {
+            json_reader_init(&reader, on_json_event, &parse);
+            esp_err_t err = json_reader_feed(&reader, job.data, job.len);
+            if (err == ESP_OK) {
+                err = json_reader_finish(&reader);
+            }
+            if (err != ESP_OK) {
+                error = "invalid JSON";
+            }
+        }
+
+        reply_begin(&w, &rb, true);
+        if (error == NULL) {
+            switch (job.route) {
+            case ROUTE_CONFIG:
+                error = run_config();
+                if (error == NULL) {
+                    json_kv_uint(&w, "fields", parse.fields_set);
+                }
+                break;
+            case ROUTE_OTA:
+                error = run_ota();
+                break;
+            case ROUTE_METRICS:
+                error = run_metrics(&w);
+                break;
+            case ROUTE_LOG:
+                error = run_log();
+                break;
+            case ROUTE_NODE:
+                error = run_node();
+                break;
+            case ROUTE_FAULT:
+                error = run_fault(&w);
+                break;
+            default:
+                error = "unknown command";
+                break;
+            }
+        }
+        json_obj_end(&w);
+        esp_err_t err = error == NULL ? json_writer_finish(&w) : ESP_OK;
+        if (err == ESP_ERR_INVALID_SIZE) {
+            error = job.route == ROUTE_METRICS ? "snapshot too large, ask for a group" : "answer too large";
+        }
+        if (error != NULL) {
+            // Started over, so a half-written answer does not go out
+            reply_begin(&w, &rb, false);
+            json_kv_str(&w, "error", error);
+            json_obj_end(&w);
+            err = json_writer_finish(&w);
+            ESP_LOGW(TAG, "%.*s: %s", job.name_len, job.name, error);
+        }
+        if (err == ESP_OK) {
+            err = mqtt_forwarder_publish_reply(job.name, job.name_len, rb.data, rb.len);
+        }
+
+        portENTER_CRITICAL(&stats_lock);
+        if (error == NULL) {
+            stats.done++;
+        } else {
+            stats.failed++;
+        }
+        if (err != ESP_OK) {
+            stats.unanswered++;
+        }
+        portEXIT_CRITICAL(&stats_lock);
+    }
+}
+
+esp_err_t mqtt_cmd_start(void) {
+    if (queue != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(route_slots, -1, sizeof(route_slots));
+    for (int r = 0; r < ROUTE_COUNT; r++) {
+        uint32_t i = fnv1a(ROUTE_NAMES[r].name, ROUTE_NAMES[r].len);
+        while (route_slots[i & (MQTT_CMD_ROUTE_SLOTS - 1)] >= 0) {
+            i++;
+        }
+        route_slots[i & (MQTT_CMD_ROUTE_SLOTS - 1)] = (int8_t)r;
+    }
+    memset(&stats, 0, sizeof(stats));
+
+    queue = xQueueCreateStatic(MQTT_CMD_QUEUE, sizeof(cmd_job_t), queue_storage, &queue_buf);
+    if (queue == NULL ||
+        static_task_create(cmd_task_slot, cmd_task, MQTT_CMD_TASK_NAME, MQTT_CMD_TASK_STACK_SIZE, NULL,
+                           MQTT_CMD_TASK_PRIORITY, NULL, TASK_CORE_NET) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the command task");
+        queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    mqtt_forwarder_set_command_handler(take_command);
+    metrics_export_add_source(write_cmd_metrics);
+    ESP_LOGI(TAG, "Taking commands on <base>/cmd/, %d routes", ROUTE_COUNT);
+    return ESP_OK;
+}
+
+void mqtt_cmd_get_stats(mqtt_cmd_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
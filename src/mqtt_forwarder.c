@@ -0,0 +1,1120 @@
+/**
+ * @file mqtt_forwarder.c
+ * @brief Gateway MQTT publisher: node samples to per-node topics with pipelined QoS 1
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "mqtt_forwarder.h"
+#include "cbor_writer.h"
+#include "fault_inject.h"
+#include "json_writer.h"
+#include "nvs_utils.h"
+#include "mem_policy.h"
+#include "pipeline_trace.h"
+#include "task_plan.h"
+#include "version.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "mqtt_client.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register mqtt_forwarder.c version
+REGISTER_VERSION(MqttForwarder, "1.0.0", "2026-10-15");
+
+static const char *TAG = "MQTT_FWD";
+
+#define METRIC_NAME_MAX 11                      // "temperature"
+#define TOPIC_MAX (MQTT_BASE_TOPIC_MAX_LEN + 1 + 8 + 1 + METRIC_NAME_MAX + 1)
+
+typedef enum {
+    PUB_TEMPERATURE = 0,
+    PUB_PRESSURE,
+    PUB_HUMIDITY,
+    PUB_GAS,
+    PUB_BATCH,                                  // Batched formats: every metric of several samples
+    PUB_AGGREGATE,                              // One closed aggregator window
+    PUB_ROSE,                                   // One closed wind rose
+    PUB_ALERT,                                  // A node's alarm changed
+    PUB_COUNT
+} pub_metric_t;
+
+_Static_assert(PUB_BATCH == MQTT_FORWARDER_METRICS, "one per-field topic per metric");
+
+static const struct {
+    const char *name;
+    uint8_t len;
+} METRIC_NAMES[PUB_COUNT] = {
+    [PUB_TEMPERATURE] = { "temperature", 11 },
+    [PUB_PRESSURE]    = { "pressure", 8 },
+    [PUB_HUMIDITY]    = { "humidity", 8 },
+    [PUB_GAS]         = { "gas", 3 },
+    [PUB_BATCH]       = { "batch", 5 },
+    [PUB_AGGREGATE]   = { "aggregate", 9 },
+    [PUB_ROSE]        = { "rose", 4 },
+    [PUB_ALERT]       = { "alert", 5 },
+};
+
+#define GAS_INVALID UINT32_MAX
+#define CLAIM_NAME "claim"
+#define CLAIM_PAYLOAD_MAX 48                    // {"seq":4294967295,"gateway":"aabbccddeeff"}
+#define CONFIG_SET_NAME "config/set"
+#define HEALTH_NAME "health"                    // <base>/<gateway>/health (health_watch.h)
+#define CONFIG_PAYLOAD_MAX 128                  // Node settings JSON (espnow_config.h)
+#define CMD_NAME "cmd"                          // <base>/cmd/<name> (mqtt_cmd.h)
+#define REPLY_NAME "reply"                      // <base>/reply/<name>
+#define REPLY_NAME_MAX 48                       // Longest <name> answered
+
+/**
+ * @brief A node's topics: "<base>/<node id>/" with room for the metric name
+ */
+typedef struct {
+    uint32_t node_id;
+    uint8_t prefix_len;
+    bool claim_due;                             // claim_seq not sent yet
+    uint32_t claim_seq;                         // Newest seq this gateway took from the node
+    char topic[TOPIC_MAX];
+} node_topic_t;
+
+/**
+ * @brief The last claim on a node seen on the broker; claim_lock
+ */
+typedef struct {
+    uint32_t node_id;
+    uint32_t seq;
+    bool foreign;                               // Made by another gateway
+} broker_claim_t;
+
+/**
+ * @brief One node's samples waiting for their batch message, by column
+ */
+typedef struct {
+    node_topic_t *topic;
+    int64_t opened_us;                          // First sample added
+    uint8_t count;                              // 0 = free
+    uint32_t seq[MQTT_FORWARDER_BATCH_MAX];
+    uint32_t time_s[MQTT_FORWARDER_BATCH_MAX];
+    int16_t temperature[MQTT_FORWARDER_BATCH_MAX];
+    uint32_t pressure[MQTT_FORWARDER_BATCH_MAX];
+    uint32_t humidity[MQTT_FORWARDER_BATCH_MAX];
+    uint32_t gas[MQTT_FORWARDER_BATCH_MAX];     // GAS_INVALID when not valid
+} open_batch_t;
+
+#if FAULT_INJECT != 0
+#define HELD_EMPTY 0                            // held_state
+#define HELD_BUSY 1                             // Being filled or sent
+#define HELD_READY 2
+
+/**
+ * @brief A message held back by the fault injection point, to go out after the next one
+ */
+typedef struct {
+    char topic[MQTT_BASE_TOPIC_MAX_LEN + 32];
+    uint8_t data[MQTT_FORWARDER_PAYLOAD_MAX];
+    int len;
+    uint32_t samples;
+    int64_t held_us;
+} held_message_t;
+#endif
+
+/**
+ * @brief json_writer sink into the payload buffer
+ */
+typedef struct {
+    char *data;
+    size_t len;
+} payload_builder_t;
+
+static esp_mqtt_client_handle_t client = NULL;
+static mqtt_forwarder_wake_t wake_forwarder = NULL;
+static node_topic_t *topics = NULL;             // Forwarder task only
+static size_t topic_count = 0;
+static size_t topic_last = 0;                   // Most records in a batch come from the same node
+static char base_topic[MQTT_BASE_TOPIC_MAX_LEN];
+static uint8_t qos = 1;
+static uint8_t format = MQTT_FORMAT_FIELDS;
+static open_batch_t *batches = NULL;            // MQTT_FORWARDER_OPEN_BATCHES and the alarm lane's, batched formats only
+static uint8_t payload[MQTT_FORWARDER_PAYLOAD_MAX];    // esp-mqtt copies it into the outbox
+static uint32_t in_flight = 0;                  // Forwarder adds, event task removes
+static uint32_t handed = 0;                     // QoS 1/2 publishes enqueued since init; the last one's ticket
+static uint32_t settled = 0;                    // ... confirmed or expired, in the order they were enqueued
+static mqtt_forwarder_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static char gateway_id[13];                     // Own STA MAC, in claims and the health topic
+static broker_claim_t *claims = NULL;           // MQTT_FORWARDER_NODES; client task writes, forwarder reads
+static size_t claim_count = 0;
+static portMUX_TYPE claim_lock = portMUX_INITIALIZER_UNLOCKED;
+static mqtt_forwarder_config_t config_handler = NULL;
+static mqtt_forwarder_command_t command_handler = NULL;
+static char cmd_prefix[MQTT_BASE_TOPIC_MAX_LEN + sizeof("/" CMD_NAME "/")];    // "<base>/cmd/", built at init
+static size_t cmd_prefix_len = 0;
+#if FAULT_INJECT != 0
+static held_message_t held;
+static uint8_t held_state = HELD_EMPTY;         // Any publishing task claims it with a compare-and-swap
+#endif
+
+// =============================
+// Function Prototypes
+// =============================
+static void mqtt_event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data);
+static void confirm_one(bool acked);
+static node_topic_t *node_topic(uint32_t node_id);
+static esp_err_t publish_one(node_topic_t *nt, pub_metric_t metric, const char *data, int len, uint32_t samples);
+static esp_err_t publish_topic(const char *topic, const char *data, int len, uint32_t samples);
+static esp_err_t enqueue_topic(const char *topic, const char *data, int len, uint32_t samples, bool retain);
+static void release_held(bool overdue_only);
+static esp_err_t publish_fields(node_topic_t *nt, const telemetry_record_t *rec);
+static esp_err_t payload_flush(void *ctx, const char *data, size_t len);
+static esp_err_t encode_json(const open_batch_t *b, size_t *len);
+static esp_err_t encode_cbor(const open_batch_t *b, size_t *len);
+static esp_err_t send_batch(open_batch_t *b);
+static open_batch_t *batch_for(node_topic_t *nt);
+static void batch_add(open_batch_t *b, const telemetry_record_t *rec);
+static bool claim_record(node_topic_t *nt, uint32_t seq);
+static bool topic_node(const esp_mqtt_event_t *event, const char *name, uint32_t *node_id);
+static void take_config(const esp_mqtt_event_t *event);
+static void take_command(const esp_mqtt_event_t *event);
+static void take_claim(const esp_mqtt_event_t *event);
+static bool claimed_elsewhere(uint32_t node_id, uint32_t seq);
+static void send_claims(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief A window slot is free: the broker confirmed a message, or the outbox gave up on it
+ */
+static void confirm_one(bool acked) {
+    uint32_t left = __atomic_sub_fetch(&in_flight, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&settled, 1, __ATOMIC_RELEASE);
+    portENTER_CRITICAL(&stats_lock);
+    if (acked) {
+        stats.acked++;
+    } else {
+        stats.expired++;
+    }
+    stats.in_flight = left;
+    portEXIT_CRITICAL(&stats_lock);
+    // Not every PUBACK: once half the window is free again, and once it is empty
+    if (left == MQTT_FORWARDER_WINDOW / 2 || left == 0) {
+        wake_forwarder();
+    }
+}
+
+/**
+ * @brief esp-mqtt events; runs in the client task
+ */
+static void mqtt_event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data) {
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+
+    switch ((esp_mqtt_event_id_t)event_id) {
+    case MQTT_EVENT_CONNECTED:
+        portENTER_CRITICAL(&stats_lock);
+        stats.connected = true;
+        stats.connects++;
+        portEXIT_CRITICAL(&stats_lock);
+        ESP_LOGI(TAG, "Connected to the broker (%s session), %lu messages in flight",
+                 event->session_present ? "resumed" : "new",
+                 (unsigned long)__atomic_load_n(&in_flight, __ATOMIC_RELAXED));
+        if (claims != NULL) {
+            char filter[MQTT_BASE_TOPIC_MAX_LEN + sizeof("/+/" CLAIM_NAME)];
+            snprintf(filter, sizeof(filter), "%s/+/" CLAIM_NAME, base_topic);
+            esp_mqtt_client_subscribe(client, filter, 0);
+        }
+        if (config_handler != NULL) {
+            char filter[MQTT_BASE_TOPIC_MAX_LEN + sizeof("/+/" CONFIG_SET_NAME)];
+            snprintf(filter, sizeof(filter), "%s/+/" CONFIG_SET_NAME, base_topic);
+            esp_mqtt_client_subscribe(client, filter, 1);
+        }
+        if (command_handler != NULL) {
+            char filter[MQTT_BASE_TOPIC_MAX_LEN + sizeof("/" CMD_NAME "/#")];
+            snprintf(filter, sizeof(filter), "%s/" CMD_NAME "/#", base_topic);
+            esp_mqtt_client_subscribe(client, filter, 1);
+        }
+        wake_forwarder();
+        break;
+    case MQTT_EVENT_DATA:
+        take_config(event);
+        take_claim(event);
+        take_command(event);
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        portENTER_CRITICAL(&stats_lock);
+        stats.connected = false;
+        portEXIT_CRITICAL(&stats_lock);
+        ESP_LOGW(TAG, "Disconnected from the broker; QoS %u messages stay queued", qos);
+        wake_forwarder();
+        break;
+    case MQTT_EVENT_PUBLISHED:
+        confirm_one(true);
+        break;
+    case MQTT_EVENT_DELETED:
+        ESP_LOGW(TAG, "Message %d expired in the outbox", event->msg_id);
+        confirm_one(false);
+        break;
+    case MQTT_EVENT_ERROR:
+        ESP_LOGW(TAG, "Client error (type %d)", event->error_handle ? (int)event->error_handle->error_type : -1);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief The node id of a <base>/<node id>/<name> topic
+ */
+static bool topic_node(const esp_mqtt_event_t *event, const char *name, uint32_t *node_id) {
+    size_t base_len = strlen(base_topic);
+    if (event->topic == NULL || event->topic_len != (int)(base_len + 1 + 8 + 1 + strlen(name)) ||
+        strncmp(event->topic, base_topic, base_len) != 0 || event->topic[base_len] != '/' ||
+        event->topic[base_len + 9] != '/' || strncmp(event->topic + base_len + 10, name, strlen(name)) != 0) {
+        return false;
+    }
+    char id_text[9];
+    memcpy(id_text, event->topic + base_len + 1, 8);
+    id_text[8] = '\0';
+    char *end;
+    *node_id = (uint32_t)strtoul(id_text, &end, 16);
+    return *end == '\0';
+}
+
+/**
+ * @brief Desired settings for a node (espnow_config.h); runs in the client task
+ *
+ * Topic <base>/<node id>/config/set; only whole messages are taken.
+ */
+static void take_config(const esp_mqtt_event_t *event) {
+    uint32_t node_id;
+    if (config_handler == NULL || event->data == NULL || event->data_len >= CONFIG_PAYLOAD_MAX ||
+        event->current_data_offset != 0 || event->data_len != event->total_data_len ||
+        !topic_node(event, CONFIG_SET_NAME, &node_id)) {
+        return;
+    }
+    char text[CONFIG_PAYLOAD_MAX];
+    memcpy(text, event->data, event->data_len);
+    text[event->data_len] = '\0';
+    config_handler(node_id, text, (size_t)event->data_len);
+}
+
+/**
+ * @brief A command for mqtt_cmd; runs in the client task
+ *
+ * Topic <base>/cmd/<name>; only whole messages are taken.
+ */
+static void take_command(const esp_mqtt_event_t *event) {
+    if (command_handler == NULL || event->topic == NULL || event->topic_len <= (int)cmd_prefix_len ||
+        event->current_data_offset != 0 || event->data_len != event->total_data_len ||
+        memcmp(event->topic, cmd_prefix, cmd_prefix_len) != 0) {
+        return;
+    }
+    command_handler(event->topic + cmd_prefix_len, (size_t)event->topic_len - cmd_prefix_len,
+                    event->data != NULL ? event->data : "", event->data != NULL ? (size_t)event->data_len : 0);
+}
+
+/**
+ * @brief A retained or fresh claim from the broker; runs in the client task
+ *
+ * Topic <base>/<node id>/claim, payload {"seq":N,"gateway":"<mac>"}; the
+ * newest claim on a node wins, whoever made it.
+ */
+static void take_claim(const esp_mqtt_event_t *event) {
+    uint32_t node_id;
+    if (claims == NULL || event->data == NULL || event->data_len >= CLAIM_PAYLOAD_MAX ||
+        !topic_node(event, CLAIM_NAME, &node_id)) {
+        return;
+    }
+    char text[CLAIM_PAYLOAD_MAX];
+    memcpy(text, event->data, event->data_len);
+    text[event->data_len] = '\0';
+
+    unsigned long seq;
+    char from[13];
+    if (sscanf(text, "{\"seq\":%lu,\"gateway\":\"%12[0-9a-f]\"}", &seq, from) != 2) {
+        return;
+    }
+
+    portENTER_CRITICAL(&claim_lock);
+    broker_claim_t *c = NULL;
+    for (size_t i = 0; i < claim_count && c == NULL; i++) {
+        if (claims[i].node_id == node_id) {
+            c = &claims[i];
+        }
+    }
+    if (c == NULL && claim_count < MQTT_FORWARDER_NODES) {
+        c = &claims[claim_count++];
+        c->node_id = node_id;
+    }
+    if (c != NULL) {
+        c->seq = (uint32_t)seq;
+        c->foreign = strcmp(from, gateway_id) != 0;
+    }
+    portEXIT_CRITICAL(&claim_lock);
+}
+
+/**
+ * @brief Whether another gateway already published this record, by the node's last claim
+ */
+static bool claimed_elsewhere(uint32_t node_id, uint32_t seq) {
+    bool claimed = false;
+    portENTER_CRITICAL(&claim_lock);
+    for (size_t i = 0; i < claim_count; i++) {
+        if (claims[i].node_id == node_id) {
+            uint32_t below = claims[i].seq - seq;
+            claimed = claims[i].foreign && below < MQTT_FORWARDER_CLAIM_SPAN;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&claim_lock);
+    return claimed;
+}
+
+/**
+ * @brief Claim the newest seq taken from each node since the last drain; QoS 0, retained
+ */
+static void send_claims(void) {
+    for (size_t i = 0; i < topic_count; i++) {
+        node_topic_t *nt = &topics[i];
+        if (!nt->claim_due) {
+            continue;
+        }
+        char text[CLAIM_PAYLOAD_MAX];
+        int len = snprintf(text, sizeof(text), "{\"seq\":%lu,\"gateway\":\"%s\"}", (unsigned long)nt->claim_seq,
+                           gateway_id);
+        memcpy(nt->topic + nt->prefix_len, CLAIM_NAME, sizeof(CLAIM_NAME));
+        if (esp_mqtt_client_publish(client, nt->topic, text, len, 0, 1) < 0) {
+            return;                             // Not connected; tried again after the next connect
+        }
+        nt->claim_due = false;
+        portENTER_CRITICAL(&stats_lock);
+        stats.claims++;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+}
+
+/**
+ * @brief A node's topic entry, built on first use
+ *
+ * @return Entry, or NULL when the table is full
+ */
+static node_topic_t *node_topic(uint32_t node_id) {
+    if (topic_last < topic_count && topics[topic_last].node_id == node_id) {
+        return &topics[topic_last];
+    }
+    for (size_t i = 0; i < topic_count; i++) {
+        if (topics[i].node_id == node_id) {
+            topic_last = i;
+            return &topics[i];
+        }
+    }
+    if (topic_count >= MQTT_FORWARDER_NODES) {
+        return NULL;
+    }
+
+    node_topic_t *nt = &topics[topic_count];
+    int len = snprintf(nt->topic, sizeof(nt->topic), "%s/%08lx/", base_topic, (unsigned long)node_id);
+    nt->node_id = node_id;
+    nt->prefix_len = (uint8_t)len;
+    nt->claim_due = false;
+    nt->claim_seq = 0;
+    topic_last = topic_count++;
+    ESP_LOGI(TAG, "Node %08lx publishes under %s", (unsigned long)node_id, nt->topic);
+    return nt;
+}
+
+/**
+ * @brief Queue one message; QoS 1/2 take a window slot until confirmed
+ *
+ * @param samples Samples the message carries, for the counters
+ */
+static esp_err_t publish_one(node_topic_t *nt, pub_metric_t metric, const char *data, int len, uint32_t samples) {
+    memcpy(nt->topic + nt->prefix_len, METRIC_NAMES[metric].name, METRIC_NAMES[metric].len + 1);
+    return publish_topic(nt->topic, data, len, samples);
+}
+
+/**
+ * @brief publish_one() on a finished topic, through the fault injection point (fault_inject.h)
+ */
+static esp_err_t publish_topic(const char *topic, const char *data, int len, uint32_t samples) {
+    switch (FAULT_INJECT_DECIDE(FAULT_INJECT_MQTT)) {
+    case FAULT_INJECT_DROP:
+        // Lost on the way: the forwarder goes on as if it had gone out
+        portENTER_CRITICAL(&stats_lock);
+        stats.published++;
+        stats.samples += samples;
+        portEXIT_CRITICAL(&stats_lock);
+        return ESP_OK;
+    case FAULT_INJECT_DELAY:
+        vTaskDelay(pdMS_TO_TICKS(fault_inject_delay_ms(FAULT_INJECT_MQTT)));
+        break;
+    case FAULT_INJECT_DUPLICATE:
+        enqueue_topic(topic, data, len, 0, false);
+        break;
+    case FAULT_INJECT_REORDER:
+#if FAULT_INJECT != 0
+        // One message at a time is held, and only if it fits; otherwise this one simply passes
+        if ((size_t)len <= sizeof(held.data) && strlen(topic) < sizeof(held.topic) &&
+            __atomic_compare_exchange_n(&held_state, &(uint8_t){ HELD_EMPTY }, HELD_BUSY, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            strcpy(held.topic, topic);
+            memcpy(held.data, data, len);
+            held.len = len;
+            held.samples = samples;
+            held.held_us = esp_timer_get_time();
+            __atomic_store_n(&held_state, HELD_READY, __ATOMIC_RELEASE);
+            return ESP_OK;
+        }
+#endif
+        break;
+    default:
+        break;
+    }
+    esp_err_t err = enqueue_topic(topic, data, len, samples, false);
+    release_held(false);
+    return err;
+}
+
+/**
+ * @brief Send the held message, if there is one (and, with overdue_only, it waited FAULT_INJECT_HOLD_MS)
+ */
+static void release_held(bool overdue_only) {
+#if FAULT_INJECT != 0
+    if (__atomic_load_n(&held_state, __ATOMIC_ACQUIRE) != HELD_READY ||
+        (overdue_only && esp_timer_get_time() - held.held_us < (int64_t)FAULT_INJECT_HOLD_MS * 1000) ||
+        !__atomic_compare_exchange_n(&held_state, &(uint8_t){ HELD_READY }, HELD_BUSY, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    enqueue_topic(held.topic, (const char *)held.data, held.len, held.samples, false);
+    __atomic_store_n(&held_state, HELD_EMPTY, __ATOMIC_RELEASE);
+#else
+    (void)overdue_only;
+#endif
+}
+
+/**
+ * @brief Hand one message to esp-mqtt; any task, as the window count is atomic
+ */
+static esp_err_t enqueue_topic(const char *topic, const char *data, int len, uint32_t samples, bool retain) {
+    int msg_id;
+    uint32_t used = 0;
+    PIPELINE_TRACE_BEGIN(PIPELINE_TRACE_MQTT_PUBLISH);
+    if (qos == 0) {
+        msg_id = esp_mqtt_client_publish(client, topic, data, len, 0, retain);
+    } else {
+        // Counted before the client task can see the message, so its PUBACK never comes first
+        used = __atomic_add_fetch(&in_flight, 1, __ATOMIC_RELAXED);
+        msg_id = esp_mqtt_client_enqueue(client, topic, data, len, qos, retain, true);
+        if (msg_id < 0) {
+            used = __atomic_sub_fetch(&in_flight, 1, __ATOMIC_RELAXED);
+        } else {
+            __atomic_add_fetch(&handed, 1, __ATOMIC_RELEASE);
+        }
+    }
+    PIPELINE_TRACE_END(PIPELINE_TRACE_MQTT_PUBLISH);
+
+    portENTER_CRITICAL(&stats_lock);
+    if (msg_id < 0) {
+        stats.failed++;
+    } else {
+        stats.published++;
+        stats.samples += samples;
+    }
+    if (qos > 0) {
+        stats.in_flight = used;
+        if (used > stats.in_flight_peak) {
+            stats.in_flight_peak = used;
+        }
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    return msg_id < 0 ? ESP_FAIL : ESP_OK;
+}
+
+/**
+ * @brief MQTT_FORMAT_FIELDS: one message per metric
+ */
+static esp_err_t publish_fields(node_topic_t *nt, const telemetry_record_t *rec) {
+    char text[16];
+    int len;
+    int t = rec->temperature;
+    esp_err_t ret = ESP_OK;
+
+    len = snprintf(text, sizeof(text), "%s%d.%02d", t < 0 ? "-" : "", abs(t) / 100, abs(t) % 100);
+    if (publish_one(nt, PUB_TEMPERATURE, text, len, 1) != ESP_OK) {
+        ret = ESP_FAIL;
+    }
+    len = snprintf(text, sizeof(text), "%lu.%02lu", (unsigned long)(rec->pressure / 100),
+                   (unsigned long)(rec->pressure % 100));
+    if (publish_one(nt, PUB_PRESSURE, text, len, 0) != ESP_OK) {
+        ret = ESP_FAIL;
+    }
+    len = snprintf(text, sizeof(text), "%lu.%02lu", (unsigned long)(rec->humidity / 1000),
+                   (unsigned long)(rec->humidity % 1000 / 10));
+    if (publish_one(nt, PUB_HUMIDITY, text, len, 0) != ESP_OK) {
+        ret = ESP_FAIL;
+    }
+    if (rec->gas_valid) {
+        len = snprintf(text, sizeof(text), "%lu", (unsigned long)rec->gas_resistance);
+        if (publish_one(nt, PUB_GAS, text, len, 0) != ESP_OK) {
+            ret = ESP_FAIL;
+        }
+    }
+    return ret;
+}
+
+static esp_err_t payload_flush(void *ctx, const char *data, size_t len) {
+    payload_builder_t *pb = (payload_builder_t *)ctx;
+    if (data == NULL) {
+        return ESP_OK;  // End of document
+    }
+    if (pb->len + len > MQTT_FORWARDER_PAYLOAD_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(pb->data + pb->len, data, len);
+    pb->len += len;
+    return ESP_OK;
+}
+
+/**
+ * @brief Columnar JSON batch into payload (layout in mqtt_forwarder.h)
+ */
+static esp_err_t encode_json(const open_batch_t *b, size_t *len) {
+    payload_builder_t pb = { .data = (char *)payload, .len = 0 };
+    json_writer_t w;
+    json_writer_init(&w, payload_flush, &pb);
+
+    char node[9];
+    snprintf(node, sizeof(node), "%08lx", (unsigned long)b->topic->node_id);
+    json_obj_begin(&w);
+    json_kv_str(&w, "node", node);
+    json_kv_uint(&w, "seq", b->seq[0]);
+    json_kv_uint(&w, "time", b->time_s[0]);
+    json_key(&w, "dseq");
+    json_arr_begin(&w);
+    for (uint8_t i = 0; i < b->count; i++) {
+        json_uint(&w, b->seq[i] - b->seq[0]);
+    }
+    json_arr_end(&w);
+    json_key(&w, "dt");
+    json_arr_begin(&w);
+    for (uint8_t i = 0; i < b->count; i++) {
+        json_int(&w, (int32_t)(b->time_s[i] - b->time_s[0]));
+    }
+    json_arr_end(&w);
+    json_key(&w, "temp");
+    json_arr_begin(&w);
+    for (uint8_t i = 0; i < b->count; i++) {
+        json_int(&w, b->temperature[i]);
+    }
+    json_arr_end(&w);
+    json_key(&w, "press");
+    json_arr_begin(&w);
+    for (uint8_t i = 0; i < b->count; i++) {
+        json_uint(&w, b->pressure[i]);
+    }
+    json_arr_end(&w);
+    json_key(&w, "hum");
+    json_arr_begin(&w);
+    for (uint8_t i = 0; i < b->count; i++) {
+        json_uint(&w, b->humidity[i]);
+    }
+    json_arr_end(&w);
+    json_key(&w, "gas");
+    json_arr_begin(&w);
+    for (uint8_t i = 0; i < b->count; i++) {
+        if (b->gas[i] == GAS_INVALID) {
+            json_null(&w);
+        } else {
+            json_uint(&w, b->gas[i]);
+        }
+    }
+    json_arr_end(&w);
+    json_obj_end(&w);
+
+    esp_err_t err = json_writer_finish(&w);
+    *len = pb.len;
+    return err;
+}
+
+/**
+ * @brief The same batch as a CBOR map with the same keys
+ */
+static esp_err_t encode_cbor(const open_batch_t *b, size_t *len) {
+    cbor_writer_t w;
+    cbor_writer_init(&w, payload, sizeof(payload));
+
+    char node[9];
+    snprintf(node, sizeof(node), "%08lx", (unsigned long)b->topic->node_id);
+    cbor_map(&w, 9);
+    cbor_text(&w, "node");
+    cbor_text(&w, node);
+    cbor_text(&w, "seq");
+    cbor_uint(&w, b->seq[0]);
+    cbor_text(&w, "time");
+    cbor_uint(&w, b->time_s[0]);
+    cbor_text(&w, "dseq");
+    cbor_array(&w, b->count);
+    for (uint8_t i = 0; i < b->count; i++) {
+        cbor_uint(&w, b->seq[i] - b->seq[0]);
+    }
+    cbor_text(&w, "dt");
+    cbor_array(&w, b->count);
+    for (uint8_t i = 0; i < b->count; i++) {
+        cbor_int(&w, (int32_t)(b->time_s[i] - b->time_s[0]));
+    }
+    cbor_text(&w, "temp");
+    cbor_array(&w, b->count);
+    for (uint8_t i = 0; i < b->count; i++) {
+        cbor_int(&w, b->temperature[i]);
+    }
+    cbor_text(&w, "press");
+    cbor_array(&w, b->count);
+    for (uint8_t i = 0; i < b->count; i++) {
+        cbor_uint(&w, b->pressure[i]);
+    }
+    cbor_text(&w, "hum");
+    cbor_array(&w, b->count);
+    for (uint8_t i = 0; i < b->count; i++) {
+        cbor_uint(&w, b->humidity[i]);
+    }
+    cbor_text(&w, "gas");
+    cbor_array(&w, b->count);
+    for (uint8_t i = 0; i < b->count; i++) {
+        if (b->gas[i] == GAS_INVALID) {
+            cbor_null(&w);
+        } else {
+            cbor_uint(&w, b->gas[i]);
+        }
+    }
+    return cbor_writer_finish(&w, len);
+}
+
+/**
+ * @brief Encode and publish a batch, then free it whether or not esp-mqtt took it
+ */
+static esp_err_t send_batch(open_batch_t *b) {
+    size_t len = 0;
+    esp_err_t err = format == MQTT_FORMAT_CBOR ? encode_cbor(b, &len) : encode_json(b, &len);
+    if (err == ESP_OK) {
+        err = publish_one(b->topic, PUB_BATCH, (const char *)payload, (int)len, b->count);
+    } else {
+        ESP_LOGE(TAG, "Batch of %u samples does not fit %d bytes", b->count, MQTT_FORWARDER_PAYLOAD_MAX);
+        portENTER_CRITICAL(&stats_lock);
+        stats.failed++;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+    b->count = 0;
+    return err;
+}
+
+/**
+ * @brief The node's open batch, or a free one; sends the oldest when all are taken
+ */
+static open_batch_t *batch_for(node_topic_t *nt) {
+    open_batch_t *free_batch = NULL;
+    open_batch_t *oldest = NULL;
+    for (size_t i = 0; i < MQTT_FORWARDER_OPEN_BATCHES; i++) {
+        open_batch_t *b = &batches[i];
+        if (b->count == 0) {
+            if (free_batch == NULL) {
+                free_batch = b;
+            }
+        } else if (b->topic == nt) {
+            return b;
+        } else if (oldest == NULL || b->opened_us < oldest->opened_us) {
+            oldest = b;
+        }
+    }
+    if (free_batch == NULL) {
+        send_batch(oldest);
+        free_batch = oldest;
+    }
+    free_batch->topic = nt;
+    return free_batch;
+}
+
+/**
+ * @brief Append one sample to a batch's columns
+ */
+static void batch_add(open_batch_t *b, const telemetry_record_t *rec) {
+    uint8_t i = b->count;
+    if (i == 0) {
+        b->opened_us = esp_timer_get_time();
+    }
+    b->seq[i] = rec->seq;
+    b->time_s[i] = rec->time_s;
+    b->temperature[i] = rec->temperature;
+    b->pressure[i] = rec->pressure;
+    b->humidity[i] = rec->humidity;
+    b->gas[i] = rec->gas_valid ? rec->gas_resistance : GAS_INVALID;
+    b->count = i + 1;
+}
+
+/**
+ * @brief Claim a record's seq for this gateway; false if another gateway already published it
+ */
+static bool claim_record(node_topic_t *nt, uint32_t seq) {
+    if (claims == NULL) {
+        return true;
+    }
+    if (claimed_elsewhere(nt->node_id, seq)) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.deduped++;
+        portEXIT_CRITICAL(&stats_lock);
+        return false;
+    }
+    if (!nt->claim_due || (int32_t)(seq - nt->claim_seq) > 0) {
+        nt->claim_seq = seq;
+    }
+    nt->claim_due = true;
+    return true;
+}
+
+esp_err_t mqtt_forwarder_init(mqtt_forwarder_wake_t wake) {
+    device_config_t cfg;
+    esp_err_t err = nvs_config_get(&cfg);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    strlcpy(base_topic, cfg.mqtt_base_topic, sizeof(base_topic));
+    size_t base_len = strlen(base_topic);
+    while (base_len > 0 && base_topic[base_len - 1] == '/') {
+        base_topic[--base_len] = '\0';
+    }
+    cmd_prefix_len = (size_t)snprintf(cmd_prefix, sizeof(cmd_prefix), "%s/" CMD_NAME "/", base_topic);
+    qos = cfg.mqtt_qos;
+    format = cfg.mqtt_format;
+    wake_forwarder = wake;
+    in_flight = 0;
+    handed = 0;
+    settled = 0;
+    topic_count = 0;
+    topic_last = 0;
+    memset(&stats, 0, sizeof(stats));
+    stats.qos = qos;
+    stats.format = format;
+
+    topics = mem_policy_malloc(MEM_BULK, MQTT_FORWARDER_NODES * sizeof(node_topic_t));
+    if (format != MQTT_FORMAT_FIELDS) {
+        batches = mem_policy_calloc(MEM_BULK, MQTT_FORWARDER_OPEN_BATCHES + 1, sizeof(open_batch_t));
+    }
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(gateway_id, sizeof(gateway_id), "%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4],
+             mac[5]);
+    if (MQTT_FORWARDER_CLAIMS != 0) {
+        claim_count = 0;
+        claims = mem_policy_malloc(MEM_BULK, MQTT_FORWARDER_NODES * sizeof(broker_claim_t));
+    }
+    if (topics == NULL || (format != MQTT_FORMAT_FIELDS && batches == NULL) ||
+        (MQTT_FORWARDER_CLAIMS != 0 && claims == NULL)) {
+        mqtt_forwarder_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+
+    char uri[32];
+    snprintf(uri, sizeof(uri), "mqtt://%s:%u", cfg.mqtt_server_ip, cfg.mqtt_port);
+    // esp-mqtt copies the strings it is given
+    esp_mqtt_client_config_t mqtt_cfg = {
+        .broker.address.uri = uri,
+        .credentials.username = cfg.mqtt_username,
+        .credentials.client_id = cfg.mqtt_client_id,
+        .credentials.authentication.password = cfg.mqtt_password,
+        .session.keepalive = MQTT_FORWARDER_KEEPALIVE_S,
+        .session.disable_clean_session = MQTT_FORWARDER_PERSIST != 0,
+        .task.priority = MQTT_TASK_PRIORITY,
+        .task.stack_size = MQTT_TASK_STACK_SIZE,
+    };
+    client = esp_mqtt_client_init(&mqtt_cfg);
+    if (client == NULL) {
+        mqtt_forwarder_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+    esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    err = esp_mqtt_client_start(client);
+    if (err != ESP_OK) {
+        mqtt_forwarder_deinit();
+        return err;
+    }
+
+    if (format == MQTT_FORMAT_FIELDS) {
+        ESP_LOGI(TAG, "Publishing to %s under %s/<node>/<metric> at QoS %u, %d in flight", uri, base_topic, qos,
+                 qos > 0 ? MQTT_FORWARDER_WINDOW : 0);
+    } else {
+        ESP_LOGI(TAG, "Publishing %s batches (%d samples, %d ms) to %s under %s/<node>/batch at QoS %u, %d in flight",
+                 format == MQTT_FORMAT_CBOR ? "CBOR" : "JSON", MQTT_FORWARDER_BATCH_MAX,
+                 MQTT_FORWARDER_BATCH_WINDOW_MS, uri, base_topic, qos, qos > 0 ? MQTT_FORWARDER_WINDOW : 0);
+    }
+    return ESP_OK;
+}
+
+void mqtt_forwarder_set_config_handler(mqtt_forwarder_config_t handler) {
+    config_handler = handler;
+}
+
+void mqtt_forwarder_set_command_handler(mqtt_forwarder_command_t handler) {
+    command_handler = handler;
+}
+
+void mqtt_forwarder_deinit(void) {
+    if (client != NULL) {
+        esp_mqtt_client_stop(client);
+        esp_mqtt_client_destroy(client);
+        client = NULL;
+    }
+    free(batches);
+    batches = NULL;
+    free(topics);
+    topics = NULL;
+    topic_count = 0;
+    portENTER_CRITICAL(&claim_lock);
+    broker_claim_t *old = claims;
+    claims = NULL;
+    claim_count = 0;
+    portEXIT_CRITICAL(&claim_lock);
+    free(old);
+}
+
+size_t mqtt_forwarder_room(void) {
+    if (qos == 0) {
+        return SIZE_MAX;
+    }
+    // A record costs a publish per metric, or at most one batch (its own, or the one it displaces)
+    size_t per_record = format == MQTT_FORMAT_FIELDS ? MQTT_FORWARDER_METRICS : 1;
+    const size_t bulk = MQTT_FORWARDER_WINDOW - MQTT_FORWARDER_URGENT_RESERVE;
+    uint32_t used = __atomic_load_n(&in_flight, __ATOMIC_RELAXED);
+    return used >= bulk ? 0 : (bulk - used) / per_record;
+}
+
+size_t mqtt_forwarder_urgent_room(void) {
+    if (qos == 0) {
+        return SIZE_MAX;
+    }
+    size_t per_record = format == MQTT_FORMAT_FIELDS ? MQTT_FORWARDER_METRICS : 1;
+    uint32_t used = __atomic_load_n(&in_flight, __ATOMIC_RELAXED);
+    return used >= MQTT_FORWARDER_WINDOW ? 0 : (MQTT_FORWARDER_WINDOW - used) / per_record;
+}
+
+esp_err_t mqtt_forwarder_publish(uint32_t node_id, const telemetry_record_t *rec) {
+    if (client == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    node_topic_t *nt = node_topic(node_id);
+    if (nt == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (!claim_record(nt, rec->seq)) {
+        return ESP_OK;
+    }
+
+    if (format == MQTT_FORMAT_FIELDS) {
+        return publish_fields(nt, rec);
+    }
+
+    open_batch_t *b = batch_for(nt);
+    batch_add(b, rec);
+    if (b->count == MQTT_FORWARDER_BATCH_MAX) {
+        return send_batch(b);
+    }
+    return ESP_OK;
+}
+
+esp_err_t mqtt_forwarder_publish_urgent(uint32_t node_id, const telemetry_record_t *rec) {
+    if (client == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    node_topic_t *nt = node_topic(node_id);
+    if (nt == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (!claim_record(nt, rec->seq)) {
+        return ESP_OK;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    stats.urgent++;
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (format == MQTT_FORMAT_FIELDS) {
+        return publish_fields(nt, rec);
+    }
+    // Its own batch, after the open ones: the node's open batch keeps collecting and goes out in turn
+    open_batch_t *b = &batches[MQTT_FORWARDER_OPEN_BATCHES];
+    b->topic = nt;
+    b->count = 0;
+    batch_add(b, rec);
+    return send_batch(b);
+}
+
+esp_err_t mqtt_forwarder_publish_aggregate(const aggregator_result_t *result) {
+    if (client == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    node_topic_t *nt = node_topic(result->node_id);
+    if (nt == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    payload_builder_t pb = { .data = (char *)payload, .len = 0 };
+    json_writer_t w;
+    json_writer_init(&w, payload_flush, &pb);
+    aggregator_write_result(&w, result);
+    esp_err_t err = json_writer_finish(&w);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return publish_one(nt, PUB_AGGREGATE, (const char *)payload, (int)pb.len, 0);
+}
+
+esp_err_t mqtt_forwarder_publish_rose(const aggregator_rose_t *rose) {
+    if (client == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    node_topic_t *nt = node_topic(rose->node_id);
+    if (nt == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    payload_builder_t pb = { .data = (char *)payload, .len = 0 };
+    json_writer_t w;
+    json_writer_init(&w, payload_flush, &pb);
+    aggregator_write_rose(&w, rose);
+    esp_err_t err = json_writer_finish(&w);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return publish_one(nt, PUB_ROSE, (const char *)payload, (int)pb.len, 0);
+}
+
+esp_err_t mqtt_forwarder_publish_alert(uint32_t node_id, const char *json, size_t len) {
+    if (client == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    node_topic_t *nt = node_topic(node_id);
+    if (nt == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    return publish_one(nt, PUB_ALERT, json, (int)len, 0);
+}
+
+esp_err_t mqtt_forwarder_publish_health(const char *json, size_t len) {
+    if (client == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    char topic[MQTT_BASE_TOPIC_MAX_LEN + sizeof(gateway_id) + sizeof("/" HEALTH_NAME) + 1];
+    snprintf(topic, sizeof(topic), "%s/%s/" HEALTH_NAME, base_topic, gateway_id);
+    return publish_topic(topic, json, (int)len, 0);
+}
+
+esp_err_t mqtt_forwarder_publish_retained(const char *topic, const char *json, size_t len) {
+    if (client == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return enqueue_topic(topic, json, (int)len, 0, true);
+}
+
+esp_err_t mqtt_forwarder_publish_reply(const char *name, size_t name_len, const char *json, size_t len) {
+    if (client == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (name_len > REPLY_NAME_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    char topic[MQTT_BASE_TOPIC_MAX_LEN + sizeof("/" REPLY_NAME "/") + REPLY_NAME_MAX];
+    snprintf(topic, sizeof(topic), "%s/" REPLY_NAME "/%.*s", base_topic, (int)name_len, name);
+    return publish_topic(topic, json, (int)len, 0);
+}
+
+void mqtt_forwarder_poll(void) {
+    release_held(true);
+    if (claims != NULL && mqtt_forwarder_connected()) {
+        send_claims();
+    }
+    if (batches == NULL) {
+        return;
+    }
+    int64_t cutoff_us = esp_timer_get_time() - (int64_t)MQTT_FORWARDER_BATCH_WINDOW_MS * 1000;
+    for (size_t i = 0; i < MQTT_FORWARDER_OPEN_BATCHES; i++) {
+        if (batches[i].count > 0 && batches[i].opened_us <= cutoff_us) {
+            send_batch(&batches[i]);
+        }
+    }
+}
+
+uint32_t mqtt_forwarder_poll_due_ms(void) {
+#if FAULT_INJECT != 0
+    if (__atomic_load_n(&held_state, __ATOMIC_ACQUIRE) != HELD_EMPTY) {
+        return FAULT_INJECT_HOLD_MS;
+    }
+#endif
+    for (size_t i = 0; claims != NULL && i < topic_count; i++) {
+        if (topics[i].claim_due && mqtt_forwarder_connected()) {
+            return 0;
+        }
+    }
+    int64_t oldest_us = INT64_MAX;
+    for (size_t i = 0; batches != NULL && i < MQTT_FORWARDER_OPEN_BATCHES; i++) {
+        if (batches[i].count > 0 && batches[i].opened_us < oldest_us) {
+            oldest_us = batches[i].opened_us;
+        }
+    }
+    if (oldest_us == INT64_MAX) {
+        return UINT32_MAX;
+    }
+    int64_t due_us = oldest_us + (int64_t)MQTT_FORWARDER_BATCH_WINDOW_MS * 1000 - esp_timer_get_time();
+    return due_us <= 0 ? 0 : (uint32_t)((due_us + 999) / 1000);
+}
+
+void mqtt_forwarder_flush(void) {
+    release_held(false);
+    if (batches == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < MQTT_FORWARDER_OPEN_BATCHES; i++) {
+        if (batches[i].count > 0) {
+            send_batch(&batches[i]);
+        }
+    }
+}
+
+bool mqtt_forwarder_connected(void) {
+    portENTER_CRITICAL(&stats_lock);
+    bool connected = stats.connected;
+    portEXIT_CRITICAL(&stats_lock);
+    return connected;
+}
+
+bool mqtt_forwarder_idle(void) {
+    for (size_t i = 0; batches != NULL && i < MQTT_FORWARDER_OPEN_BATCHES; i++) {
+        if (batches[i].count > 0) {
+            return false;
+        }
+    }
+    return qos == 0 || __atomic_load_n(&in_flight, __ATOMIC_RELAXED) == 0;
+}
+
+uint32_t mqtt_forwarder_ticket(void) {
+    return __atomic_load_n(&handed, __ATOMIC_ACQUIRE);
+}
+
+bool mqtt_forwarder_settled(uint32_t ticket) {
+    return (int32_t)(__atomic_load_n(&settled, __ATOMIC_ACQUIRE) - ticket) >= 0;
+}
+
+void mqtt_forwarder_get_stats(mqtt_forwarder_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,281 @@
+/**
+ * @file multipart_reader.c
+ * @brief Incremental multipart/form-data parser that streams part bodies without copying
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "multipart_reader.h"
+#include "version.h"
+#include <string.h>
+#include <strings.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register multipart_reader.c version
+REGISTER_VERSION(MultipartReader, "1.0.0", "2026-10-14");
+
+typedef enum {
+    STATE_PREAMBLE,                             // Discarding input until the first boundary
+    STATE_AFTER_BOUNDARY,                       // Boundary matched: "--" ends the body, CRLF starts a part
+    STATE_HEADERS,                              // Collecting part header lines
+    STATE_BODY,                                 // Streaming part data
+    STATE_DONE                                  // Closing boundary seen; the epilogue is ignored
+} reader_state_t;
+
+// =============================
+// Function Prototypes
+// =============================
+static bool header_param(const char *header, const char *key, char *out, size_t out_len);
+static esp_err_t emit_data(multipart_reader_t *r, const uint8_t *data, size_t len);
+static esp_err_t header_line_done(multipart_reader_t *r);
+static esp_err_t feed_body(multipart_reader_t *r, const uint8_t *data, size_t len, size_t *used);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Read a ';'-separated header parameter such as name="file" (quotes optional)
+ */
+static bool header_param(const char *header, const char *key, char *out, size_t out_len) {
+    size_t key_len = strlen(key);
+    const char *p = strchr(header, ';');
+
+    while (p != NULL) {
+        p++;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (strncasecmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            const char *value = p + key_len + 1;
+            const char *end;
+            if (*value == '"') {
+                value++;
+                end = strchr(value, '"');
+            } else {
+                end = value + strcspn(value, "; \t");
+            }
+            if (end == NULL) {
+                return false;
+            }
+            size_t len = (size_t)(end - value);
+            if (len >= out_len) {
+                len = out_len - 1;
+            }
+            memcpy(out, value, len);
+            out[len] = '\0';
+            return true;
+        }
+        p = strchr(p, ';');
+    }
+    return false;
+}
+
+static esp_err_t emit_data(multipart_reader_t *r, const uint8_t *data, size_t len) {
+    if (len == 0 || r->cb.on_part_data == NULL) {
+        return ESP_OK;
+    }
+    return r->cb.on_part_data(r->ctx, data, len);
+}
+
+/**
+ * @brief Handle one complete part header line; the empty line starts the body
+ */
+static esp_err_t header_line_done(multipart_reader_t *r) {
+    r->line[r->line_len] = '\0';
+
+    if (r->line_len == 0) {
+        r->state = STATE_BODY;
+        r->match = 0;
+        r->carry = 0;
+        if (r->cb.on_part_begin == NULL) {
+            return ESP_OK;
+        }
+        return r->cb.on_part_begin(r->ctx, r->name, r->has_filename ? r->filename : NULL);
+    }
+
+    if (strncasecmp(r->line, "Content-Disposition:", 20) == 0) {
+        header_param(r->line, "name", r->name, sizeof(r->name));
+        r->has_filename = header_param(r->line, "filename", r->filename, sizeof(r->filename));
+    }
+    r->line_len = 0;
+    return ESP_OK;
+}
+
+/**
+ * @brief Stream body bytes up to and including the next delimiter
+ *
+ * Plain data is passed on as spans of the input. Bytes that might start a
+ * delimiter are held back; if they turn out to be data they are re-emitted
+ * from the delimiter itself, since they are known to equal its prefix.
+ */
+static esp_err_t feed_body(multipart_reader_t *r, const uint8_t *data, size_t len, size_t *used) {
+    size_t run_start = 0;
+    size_t i = 0;
+    esp_err_t err;
+
+    while (i < len) {
+        if (r->match == 0) {
+            // Fast path: nothing can match before the next CR
+            const uint8_t *cr = memchr(data + i, '\r', len - i);
+            if (cr == NULL) {
+                i = len;
+                break;
+            }
+            i = (size_t)(cr - data);
+        }
+
+        uint8_t c = data[i];
+        if (c == (uint8_t)r->delimiter[r->match]) {
+            r->match++;
+            i++;
+            if (r->match < r->delimiter_len) {
+                continue;
+            }
+
+            // Full delimiter: everything before its first byte in this piece is data
+            err = emit_data(r, data + run_start, i - run_start - (r->match - r->carry));
+            if (err != ESP_OK) {
+                return err;
+            }
+            if (r->cb.on_part_end != NULL && (err = r->cb.on_part_end(r->ctx)) != ESP_OK) {
+                return err;
+            }
+            r->match = 0;
+            r->carry = 0;
+            r->dash_seen = false;
+            r->state = STATE_AFTER_BOUNDARY;
+            *used = i;
+            return ESP_OK;
+        }
+
+        // Mismatch: held-back bytes from earlier pieces were data after all
+        if (r->carry > 0) {
+            err = emit_data(r, (const uint8_t *)r->delimiter, r->carry);
+            if (err != ESP_OK) {
+                return err;
+            }
+            r->carry = 0;
+        }
+        // A delimiter can only restart at CR, which appears nowhere in it but at the front
+        r->match = c == '\r' ? 1 : 0;
+        i++;
+    }
+
+    // Hold back a partial delimiter at the end of this piece
+    err = emit_data(r, data + run_start, len - run_start - (r->match - r->carry));
+    r->carry = r->match;
+    *used = len;
+    return err;
+}
+
+esp_err_t multipart_reader_init(multipart_reader_t *r, const char *content_type,
+                                const multipart_callbacks_t *cb, void *ctx) {
+    if (r == NULL || content_type == NULL || cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(r, 0, sizeof(*r));
+    r->cb = *cb;
+    r->ctx = ctx;
+    r->err = ESP_ERR_INVALID_ARG;
+
+    char boundary[MULTIPART_BOUNDARY_MAX + 2];
+    if (strncasecmp(content_type, "multipart/", 10) != 0 ||
+        !header_param(content_type, "boundary", boundary, sizeof(boundary))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t boundary_len = strlen(boundary);
+    if (boundary_len == 0 || boundary_len > MULTIPART_BOUNDARY_MAX || strpbrk(boundary, "\r\n") != NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(r->delimiter, "\r\n--", 4);
+    memcpy(r->delimiter + 4, boundary, boundary_len);
+    r->delimiter_len = boundary_len + 4;
+
+    // The first boundary usually opens the body, so act as if its CRLF was already seen
+    r->state = STATE_PREAMBLE;
+    r->match = 2;
+    r->err = ESP_OK;
+    return ESP_OK;
+}
+
+esp_err_t multipart_reader_feed(multipart_reader_t *r, const uint8_t *data, size_t len) {
+    size_t i = 0;
+
+    while (i < len && r->err == ESP_OK) {
+        uint8_t c = data[i];
+
+        switch ((reader_state_t)r->state) {
+            case STATE_PREAMBLE:
+                if (c == (uint8_t)r->delimiter[r->match]) {
+                    if (++r->match == r->delimiter_len) {
+                        r->match = 0;
+                        r->dash_seen = false;
+                        r->state = STATE_AFTER_BOUNDARY;
+                    }
+                } else {
+                    r->match = c == '\r' ? 1 : 0;
+                }
+                i++;
+                break;
+
+            case STATE_AFTER_BOUNDARY:
+                i++;
+                if (r->dash_seen) {
+                    r->err = c == '-' ? ESP_OK : ESP_ERR_INVALID_ARG;
+                    r->state = STATE_DONE;
+                } else if (c == '-') {
+                    r->dash_seen = true;
+                } else if (c == '\n') {
+                    r->state = STATE_HEADERS;
+                    r->line_len = 0;
+                    r->name[0] = '\0';
+                    r->filename[0] = '\0';
+                    r->has_filename = false;
+                } else if (c != '\r' && c != ' ' && c != '\t') {
+                    r->err = ESP_ERR_INVALID_ARG;  // Only transport padding may follow a boundary
+                }
+                break;
+
+            case STATE_HEADERS:
+                i++;
+                if (c == '\n') {
+                    if (r->line_len > 0 && r->line[r->line_len - 1] == '\r') {
+                        r->line_len--;
+                    }
+                    r->err = header_line_done(r);
+                } else if (r->line_len < sizeof(r->line) - 1) {
+                    r->line[r->line_len++] = (char)c;
+                }
+                break;
+
+            case STATE_BODY: {
+                size_t used = 0;
+                r->err = feed_body(r, data + i, len - i, &used);
+                i += used;
+                break;
+            }
+
+            case STATE_DONE:
+            default:
+                i = len;
+                break;
+        }
+    }
+    return r->err;
+}
+
+esp_err_t multipart_reader_finish(multipart_reader_t *r) {
+    if (r->err == ESP_OK && r->state != STATE_DONE) {
+        r->err = ESP_ERR_INVALID_ARG;  // Truncated body
+    }
+    return r->err;
+}
@@ -0,0 +1,496 @@
+/**
+ * @file n2k.c
+ * @brief NMEA 2000 output on the TWAI (CAN) controller: environmental, wind and position PGNs
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "n2k.h"
+#include "version.h"
+#include "sample_bus.h"
+#include "static_mem.h"
+#include "true_wind.h"
+#include "wind.h"
+#include <string.h>
+#include "driver/twai.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register n2k.c version
+REGISTER_VERSION(N2k, "1.0.0", "2026-10-15");
+
+static const char *TAG = "N2K";
+
+#define ADDRESS_NONE 254                        // "Cannot claim"; also the source of that claim
+#define ADDRESS_GLOBAL 255
+#define PRIORITY_CLAIM 6
+#define PRIORITY_ENV 5
+#define PRIORITY_WIND 2
+#define PRIORITY_PRODUCT 6
+#define PRIORITY_POSITION 2
+#define COG_REFERENCE_TRUE 0
+#define KELVIN_X100 27315                       // 0 degC in 0.01 K
+#define RAD_X10000_PER_DEG 174533               // x1000: 0.0001 rad per degree is 174.533
+#define TEMPERATURE_SOURCE_OUTSIDE 1
+#define HUMIDITY_SOURCE_OUTSIDE 1
+#define PRESSURE_SOURCE_ATMOSPHERIC 0
+#define WIND_REFERENCE_APPARENT 2
+#define WIND_REFERENCE_TRUE_BOAT 3
+#define PRODUCT_STRING_LEN 32
+#define PRODUCT_INFO_LEN (4 + 4 * PRODUCT_STRING_LEN + 2)
+#define NMEA2000_VERSION 2100                   // Database version 2.100, as 0.001 units
+#define CLAIM_SETTLE_MS 250                     // A claim stands if nobody contests it this long
+#define STOP_TIMEOUT_MS 2000
+
+_Static_assert(PRODUCT_INFO_LEN <= N2K_FAST_PACKET_MAX, "product information must fit one fast packet");
+
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(task_slot, N2K_TASK_STACK_SIZE);
+static volatile bool run = false;
+static volatile uint8_t address = ADDRESS_NONE;
+static sample_bus_sub_t *bus_sub = NULL;        // Gateway records and GPS fixes; NULL without the bus
+static uint64_t name;                           // ISO NAME, fixed after n2k_start()
+static uint8_t sid = 0;                         // Sequence id tying a set of PGNs to one reading
+static uint8_t fast_seq = 0;                    // Fast-packet sequence counter, 3 bits; n2k_send() callers only
+static int64_t last_env_us = 0;
+static n2k_stats_t stats;
+static portMUX_TYPE n2k_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static uint32_t can_id(uint32_t pgn, uint8_t priority, uint8_t dest, uint8_t source);
+static esp_err_t queue_frame(uint32_t id, const uint8_t *data, uint8_t len);
+static void put_u16(uint8_t *p, uint16_t v);
+static void put_u32(uint8_t *p, uint32_t v);
+static uint64_t make_name(void);
+static void send_claim(uint8_t source);
+static void send_product_info(uint8_t dest);
+static void send_wind_frame(uint16_t speed, int16_t angle, uint8_t reference);
+static void send_wind(void);
+static void send_position(const gps_fix_t *fix);
+static void on_frame(const twai_message_t *msg);
+static void check_bus(void);
+static void n2k_task(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+/** @brief Store little-endian */
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+/** @brief Store little-endian */
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+/**
+ * @brief 29-bit identifier: priority, PGN (with the destination in PS for PDU1) and source
+ */
+static uint32_t can_id(uint32_t pgn, uint8_t priority, uint8_t dest, uint8_t source) {
+    uint8_t pf = (pgn >> 8) & 0xFF;
+    if (pf < 240) {
+        pgn = (pgn & 0x3FF00) | dest;
+    }
+    return ((uint32_t)(priority & 7) << 26) | (pgn << 8) | source;
+}
+
+/**
+ * @brief Hand one frame to the driver's transmit queue without waiting
+ */
+static esp_err_t queue_frame(uint32_t id, const uint8_t *data, uint8_t len) {
+    twai_message_t msg = {
+        .extd = 1,
+        .identifier = id,
+        .data_length_code = len,
+    };
+    memcpy(msg.data, data, len);
+    esp_err_t err = twai_transmit(&msg, 0);
+    portENTER_CRITICAL(&n2k_lock);
+    if (err == ESP_OK) {
+        stats.frames++;
+    } else {
+        stats.dropped++;
+    }
+    portEXIT_CRITICAL(&n2k_lock);
+    return err == ESP_OK ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t n2k_send(uint32_t pgn, uint8_t priority, uint8_t dest, const uint8_t *data, size_t len) {
+    uint8_t source = address;
+    if (source == ADDRESS_NONE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (len > N2K_FAST_PACKET_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint32_t id = can_id(pgn, priority, dest, source);
+    if (len <= 8) {
+        return queue_frame(id, data, (uint8_t)len);
+    }
+
+    // A fast packet half on the bus is worse than none: send it only if all of it fits the queue
+    size_t frames = 1 + (len - 6 + 6) / 7;
+    twai_status_info_t st;
+    if (twai_get_status_info(&st) != ESP_OK || N2K_TX_QUEUE_LEN - st.msgs_to_tx < frames) {
+        portENTER_CRITICAL(&n2k_lock);
+        stats.dropped += frames;
+        portEXIT_CRITICAL(&n2k_lock);
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint8_t seq = (fast_seq++ & 0x07) << 5;
+    uint8_t frame[8];
+    frame[0] = seq;
+    frame[1] = (uint8_t)len;
+    memcpy(frame + 2, data, 6);
+    esp_err_t err = queue_frame(id, frame, 8);
+    size_t pos = 6;
+    for (uint8_t counter = 1; err == ESP_OK && pos < len; counter++) {
+        size_t n = len - pos < 7 ? len - pos : 7;
+        memset(frame, 0xFF, sizeof(frame));     // Unused bytes of the last frame
+        frame[0] = seq | counter;
+        memcpy(frame + 1, data + pos, n);
+        err = queue_frame(id, frame, 8);
+        pos += n;
+    }
+    return err;
+}
+
+/**
+ * @brief ISO NAME: unique number from the MAC, arbitrary address capable
+ */
+static uint64_t make_name(void) {
+    uint8_t mac[6] = { 0 };
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    uint32_t unique = (((uint32_t)mac[3] << 16) | ((uint32_t)mac[4] << 8) | mac[5]) & 0x1FFFFF;
+    return (uint64_t)unique |
+           ((uint64_t)(N2K_MANUFACTURER_CODE & 0x7FF) << 21) |
+           ((uint64_t)N2K_DEVICE_FUNCTION << 40) |
+           ((uint64_t)(N2K_DEVICE_CLASS & 0x7F) << 49) |
+           ((uint64_t)(N2K_INDUSTRY_GROUP & 0x07) << 60) |
+           ((uint64_t)1 << 63);
+}
+
+/**
+ * @brief Address claim from source (ADDRESS_NONE: "cannot claim"); bypasses n2k_send(), which needs an address
+ */
+static void send_claim(uint8_t source) {
+    uint8_t data[8];
+    put_u32(data, (uint32_t)name);
+    put_u32(data + 4, (uint32_t)(name >> 32));
+    queue_frame(can_id(N2K_PGN_ADDRESS_CLAIM, PRIORITY_CLAIM, ADDRESS_GLOBAL, source), data, sizeof(data));
+}
+
+/**
+ * @brief 126996 Product Information, fast packet; strings padded with 0xFF
+ */
+static void send_product_info(uint8_t dest) {
+    static const char *const strings[4] = { "ESP32 Weather Station", PROJECT_VERSION, "Gateway", "" };
+    uint8_t data[PRODUCT_INFO_LEN];
+    put_u16(data, NMEA2000_VERSION);
+    put_u16(data + 2, N2K_PRODUCT_CODE);
+    for (size_t i = 0; i < 4; i++) {
+        uint8_t *field = data + 4 + i * PRODUCT_STRING_LEN;
+        size_t n = strlen(strings[i]);
+        memset(field, 0xFF, PRODUCT_STRING_LEN);
+        memcpy(field, strings[i], n < PRODUCT_STRING_LEN ? n : PRODUCT_STRING_LEN);
+    }
+    data[PRODUCT_INFO_LEN - 2] = 1;             // Certification level
+    data[PRODUCT_INFO_LEN - 1] = 1;             // Load equivalency, 50 mA units
+    n2k_send(N2K_PGN_PRODUCT_INFO, PRIORITY_PRODUCT, dest, data, sizeof(data));
+}
+
+void n2k_publish(uint32_t node_id, const telemetry_record_t *rec) {
+    if (task_handle == NULL) {
+        return;
+    }
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&n2k_lock);
+    bool due = now_us - last_env_us >= (int64_t)N2K_ENV_MIN_INTERVAL_MS * 1000;
+    if (due) {
+        last_env_us = now_us;
+    } else {
+        stats.skipped++;
+    }
+    uint8_t id = sid;
+    sid = (sid + 1) % 253;                      // 253..255 mean "no SID"
+    portEXIT_CRITICAL(&n2k_lock);
+    if (!due) {
+        return;
+    }
+
+    uint8_t env[8];
+    env[0] = id;
+    env[1] = (TEMPERATURE_SOURCE_OUTSIDE & 0x3F) | (HUMIDITY_SOURCE_OUTSIDE << 6);
+    put_u16(env + 2, (uint16_t)(rec->temperature + KELVIN_X100));
+    put_u16(env + 4, (uint16_t)(int16_t)(rec->humidity / 4));
+    put_u16(env + 6, (uint16_t)((rec->pressure + 50) / 100));
+    n2k_send(N2K_PGN_ENVIRONMENT, PRIORITY_ENV, ADDRESS_GLOBAL, env, sizeof(env));
+
+    uint8_t pressure[8];
+    pressure[0] = id;
+    pressure[1] = (uint8_t)node_id;             // Instance
+    pressure[2] = PRESSURE_SOURCE_ATMOSPHERIC;
+    put_u32(pressure + 3, rec->pressure * 10);
+    pressure[7] = 0xFF;
+    n2k_send(N2K_PGN_PRESSURE, PRIORITY_ENV, ADDRESS_GLOBAL, pressure, sizeof(pressure));
+}
+
+/**
+ * @brief One 130306 frame; angle -1 is sent as not available
+ */
+static void send_wind_frame(uint16_t speed, int16_t angle, uint8_t reference) {
+    uint8_t data[8];
+    portENTER_CRITICAL(&n2k_lock);
+    data[0] = sid;
+    sid = (sid + 1) % 253;
+    portEXIT_CRITICAL(&n2k_lock);
+    put_u16(data + 1, speed);
+    put_u16(data + 3, angle >= 0 ? (uint16_t)((uint32_t)angle * RAD_X10000_PER_DEG / 1000) : 0xFFFF);
+    data[5] = reference | 0xF8;
+    data[6] = 0xFF;
+    data[7] = 0xFF;
+    n2k_send(N2K_PGN_WIND, PRIORITY_WIND, ADDRESS_GLOBAL, data, sizeof(data));
+}
+
+/**
+ * @brief 130306 apparent wind from the local wind module, then true wind with a GPS fix; angle
+ *        0xFFFF without a vane reading
+ */
+static void send_wind(void) {
+    true_wind_t w;
+    if (!true_wind_get(&w)) {
+        wind_reading_t r;
+        wind_get(&r);
+        if (r.running) {
+            send_wind_frame(r.speed_3s, -1, WIND_REFERENCE_APPARENT);
+        }
+        return;
+    }
+    send_wind_frame(w.aws, w.awa, WIND_REFERENCE_APPARENT);
+    if (w.have_true) {
+        send_wind_frame(w.tws, w.twa, WIND_REFERENCE_TRUE_BOAT);
+    }
+}
+
+/**
+ * @brief 129025 and 129026 for one GPS fix; course 0xFFFF when the GPS left it empty
+ */
+static void send_position(const gps_fix_t *fix) {
+    if (!fix->valid) {
+        return;
+    }
+    uint8_t position[8];
+    put_u32(position, (uint32_t)fix->lat);
+    put_u32(position + 4, (uint32_t)fix->lon);
+    n2k_send(N2K_PGN_POSITION_RAPID, PRIORITY_POSITION, ADDRESS_GLOBAL, position, sizeof(position));
+
+    uint8_t data[8];
+    portENTER_CRITICAL(&n2k_lock);
+    data[0] = sid;
+    sid = (sid + 1) % 253;
+    portEXIT_CRITICAL(&n2k_lock);
+    data[1] = COG_REFERENCE_TRUE | 0xFC;
+    put_u16(data + 2, fix->cog >= 0 ? (uint16_t)((uint32_t)fix->cog * RAD_X10000_PER_DEG / 10000) : 0xFFFF);
+    put_u16(data + 4, fix->sog);
+    data[6] = 0xFF;
+    data[7] = 0xFF;
+    n2k_send(N2K_PGN_COG_SOG_RAPID, PRIORITY_POSITION, ADDRESS_GLOBAL, data, sizeof(data));
+}
+
+/**
+ * @brief Handle a received frame: contested claims and ISO requests
+ */
+static void on_frame(const twai_message_t *msg) {
+    if (!msg->extd) {
+        return;
+    }
+    uint8_t source = msg->identifier & 0xFF;
+    uint8_t pf = (msg->identifier >> 16) & 0xFF;
+    uint8_t ps = (msg->identifier >> 8) & 0xFF;
+    uint32_t pgn = (msg->identifier >> 8) & 0x3FFFF;
+    if (pf < 240) {
+        pgn &= 0x3FF00;
+    }
+
+    if (pgn == N2K_PGN_ADDRESS_CLAIM && msg->data_length_code == 8 && source == address) {
+        uint64_t other = 0;
+        for (int i = 7; i >= 0; i--) {
+            other = (other << 8) | msg->data[i];
+        }
+        if (other < name) {
+            // Lower NAME wins: move to the next address, or give up when none is left
+            uint8_t next = address < N2K_MAX_ADDRESS ? address + 1 : ADDRESS_NONE;
+            portENTER_CRITICAL(&n2k_lock);
+            stats.claims_lost++;
+            portEXIT_CRITICAL(&n2k_lock);
+            ESP_LOGW(TAG, "Address %u taken by a higher-priority device - claiming %u", address, next);
+            address = next;
+        }
+        send_claim(address);
+    } else if (pgn == N2K_PGN_ISO_REQUEST && msg->data_length_code >= 3 &&
+               (ps == address || ps == ADDRESS_GLOBAL)) {
+        uint32_t requested = msg->data[0] | ((uint32_t)msg->data[1] << 8) | ((uint32_t)msg->data[2] << 16);
+        if (requested == N2K_PGN_ADDRESS_CLAIM) {
+            send_claim(address);
+        } else if (requested == N2K_PGN_PRODUCT_INFO && address != ADDRESS_NONE) {
+            send_product_info(ps == ADDRESS_GLOBAL ? ADDRESS_GLOBAL : source);
+        }
+    }
+}
+
+/**
+ * @brief Restart the controller after bus-off; frames queued meanwhile were dropped by the driver
+ */
+static void check_bus(void) {
+    twai_status_info_t st;
+    if (twai_get_status_info(&st) != ESP_OK) {
+        return;
+    }
+    if (st.state == TWAI_STATE_BUS_OFF) {
+        portENTER_CRITICAL(&n2k_lock);
+        stats.bus_off++;
+        portEXIT_CRITICAL(&n2k_lock);
+        ESP_LOGW(TAG, "Bus off - recovering");
+        twai_initiate_recovery();
+    } else if (st.state == TWAI_STATE_STOPPED) {
+        twai_start();
+        send_claim(address);
+    }
+}
+
+/**
+ * @brief Claim an address, then answer the bus and send wind and positions until stopped
+ */
+static void n2k_task(void *arg) {
+    twai_message_t msg;
+    send_claim(N2K_PREFERRED_ADDRESS);
+    address = N2K_PREFERRED_ADDRESS;
+    int64_t claim_us = esp_timer_get_time();
+    while (run && esp_timer_get_time() - claim_us < (int64_t)CLAIM_SETTLE_MS * 1000) {
+        if (twai_receive(&msg, pdMS_TO_TICKS(CLAIM_SETTLE_MS / 5)) == ESP_OK) {
+            on_frame(&msg);
+        }
+    }
+    ESP_LOGI(TAG, "Source address %u", address);
+
+    int64_t next_wind_us = esp_timer_get_time();
+    while (run) {
+        const sample_block_t *block;
+        while ((block = sample_bus_receive(bus_sub, 0)) != NULL) {
+            if (block->topic == SAMPLE_TOPIC_POSITION) {
+                send_position(&block->fix);
+            } else {
+                n2k_publish(block->node_id, &block->rec);
+            }
+            sample_bus_release(block);
+        }
+
+        int64_t wait_us = next_wind_us - esp_timer_get_time();
+        if (wait_us > (int64_t)N2K_BUS_POLL_MS * 1000) {
+            wait_us = (int64_t)N2K_BUS_POLL_MS * 1000;
+        }
+        TickType_t wait = wait_us > 0 ? pdMS_TO_TICKS(wait_us / 1000) : 0;
+        if (twai_receive(&msg, wait) == ESP_OK) {
+            on_frame(&msg);
+            continue;
+        }
+        check_bus();
+        if (esp_timer_get_time() >= next_wind_us) {
+            send_wind();
+            next_wind_us += (int64_t)N2K_WIND_PERIOD_MS * 1000;
+        }
+    }
+
+    task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t n2k_start(void) {
+    if (task_handle != NULL) {
+        return ESP_OK;
+    }
+
+    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(N2K_TX_GPIO, N2K_RX_GPIO, TWAI_MODE_NORMAL);
+    g_config.tx_queue_len = N2K_TX_QUEUE_LEN;
+    g_config.rx_queue_len = N2K_RX_QUEUE_LEN;
+    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_250KBITS();
+    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+    esp_err_t err = twai_driver_install(&g_config, &t_config, &f_config);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = twai_start();
+    if (err != ESP_OK) {
+        twai_driver_uninstall();
+        return err;
+    }
+
+    name = make_name();
+    address = ADDRESS_NONE;
+    portENTER_CRITICAL(&n2k_lock);
+    memset(&stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&n2k_lock);
+    // Without the bus the gateway calls n2k_publish() itself
+    if (sample_bus_subscribe_topics("n2k", N2K_BUS_DEPTH, SAMPLE_TOPIC_RECORD | SAMPLE_TOPIC_POSITION, &bus_sub) ==
+        ESP_ERR_NO_MEM) {
+        ESP_LOGW(TAG, "No sample bus queue, received records will not be sent");
+    }
+    run = true;
+    if (static_task_create(task_slot, n2k_task, N2K_TASK_NAME, N2K_TASK_STACK_SIZE, NULL, N2K_TASK_PRIORITY,
+                           &task_handle, TASK_CORE_APP) != pdPASS) {
+        run = false;
+        task_handle = NULL;
+        twai_stop();
+        twai_driver_uninstall();
+        sample_bus_unsubscribe(bus_sub);
+        bus_sub = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "NMEA 2000 on TWAI TX GPIO %d RX GPIO %d, 250 kbit/s", N2K_TX_GPIO, N2K_RX_GPIO);
+    return ESP_OK;
+}
+
+void n2k_get_stats(n2k_stats_t *out) {
+    portENTER_CRITICAL(&n2k_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&n2k_lock);
+    out->address = address;
+}
+
+void n2k_stop(void) {
+    if (task_handle == NULL) {
+        return;
+    }
+    run = false;
+    for (int waited = 0; task_handle != NULL && waited < STOP_TIMEOUT_MS; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    if (task_handle != NULL) {
+        ESP_LOGW(TAG, "Task did not stop");
+        return;
+    }
+    address = ADDRESS_NONE;
+    twai_stop();
+    twai_driver_uninstall();
+    sample_bus_unsubscribe(bus_sub);
+    bus_sub = NULL;
+}
@@ -0,0 +1,288 @@
+/**
+ * @file net_stats.c
+ * @brief Byte and packet counters per network interface, with lwIP drop counts
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "net_stats.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/stats.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register net_stats.c version
+REGISTER_VERSION(NetStats, "1.0.0", "2026-10-14");
+
+static const char *TAG = "NET_STATS";
+
+static const char *const if_names[NET_STATS_IF_COUNT] = {
+    [NET_STATS_IF_AP] = "ap",
+    [NET_STATS_IF_STA] = "sta",
+    [NET_STATS_IF_ESPNOW] = "espnow",
+};
+
+// Default netif keys, in net_stats_if_t order
+static const char *const if_keys[] = { "WIFI_AP_DEF", "WIFI_STA_DEF" };
+
+static esp_netif_t *netifs[NET_STATS_IF_ESPNOW];
+static net_if_stats_t counters[NET_STATS_IF_COUNT];
+static int64_t started_us;
+static esp_event_handler_instance_t tx_rx_handler;
+
+// Traffic events arrive on the event task, ESP-NOW callbacks on the WiFi task
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static void tx_rx_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data);
+static int format_bytes(char *buf, size_t buf_len, uint64_t bytes);
+static metric_error_t bytes_provider(char *buf, size_t buf_len);
+static metric_error_t packets_provider(char *buf, size_t buf_len);
+static metric_error_t drops_provider(char *buf, size_t buf_len);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Count one packet from an IP_EVENT_TX_RX event
+ */
+static void tx_rx_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data) {
+#if CONFIG_ESP_NETIF_REPORT_DATA_TRAFFIC
+    const ip_event_tx_rx_t *evt = (const ip_event_tx_rx_t *)data;
+    for (int i = 0; i < NET_STATS_IF_ESPNOW; i++) {
+        if (netifs[i] != NULL && netifs[i] == evt->esp_netif) {
+            portENTER_CRITICAL(&stats_lock);
+            if (evt->dir == ESP_NETIF_TX) {
+                counters[i].tx_bytes += evt->len;
+                counters[i].tx_packets++;
+            } else {
+                counters[i].rx_bytes += evt->len;
+                counters[i].rx_packets++;
+            }
+            portEXIT_CRITICAL(&stats_lock);
+            return;
+        }
+    }
+#endif
+}
+
+esp_err_t net_stats_start(void) {
+#if CONFIG_ESP_NETIF_REPORT_DATA_TRAFFIC
+    if (tx_rx_handler != NULL) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = esp_event_handler_instance_register(IP_EVENT, IP_EVENT_TX_RX, tx_rx_event_handler,
+                                                        NULL, &tx_rx_handler);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register traffic handler: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    for (int i = 0; i < NET_STATS_IF_ESPNOW; i++) {
+        netifs[i] = esp_netif_get_handle_from_ifkey(if_keys[i]);
+        if (netifs[i] != NULL) {
+            esp_netif_tx_rx_event_enable(netifs[i]);
+            ESP_LOGI(TAG, "Counting traffic on %s", if_names[i]);
+        }
+    }
+    started_us = esp_timer_get_time();
+
+    set_metric_provider(METRIC_WIFI_TX_RX_BYTES, bytes_provider);
+    set_metric_provider(METRIC_NET_PACKETS, packets_provider);
+    set_metric_provider(METRIC_NET_DROPS, drops_provider);
+    return ESP_OK;
+#else
+    ESP_LOGW(TAG, "CONFIG_ESP_NETIF_REPORT_DATA_TRAFFIC is off, no traffic counters");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t net_stats_stop(void) {
+#if CONFIG_ESP_NETIF_REPORT_DATA_TRAFFIC
+    if (tx_rx_handler == NULL) {
+        return ESP_OK;
+    }
+    esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_TX_RX, tx_rx_handler);
+    tx_rx_handler = NULL;
+    memset(netifs, 0, sizeof(netifs));          // The next start looks them up again
+#endif
+    return ESP_OK;
+}
+
+void net_stats_espnow_sent(size_t len) {
+    portENTER_CRITICAL(&stats_lock);
+    counters[NET_STATS_IF_ESPNOW].tx_bytes += len;
+    counters[NET_STATS_IF_ESPNOW].tx_packets++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void net_stats_espnow_send_done(bool success) {
+    if (success) {
+        return;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    counters[NET_STATS_IF_ESPNOW].tx_failed++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void net_stats_espnow_received(size_t len) {
+    portENTER_CRITICAL(&stats_lock);
+    counters[NET_STATS_IF_ESPNOW].rx_bytes += len;
+    counters[NET_STATS_IF_ESPNOW].rx_packets++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+esp_err_t net_stats_get(net_stats_if_t iface, net_if_stats_t *stats) {
+    if (iface >= NET_STATS_IF_COUNT || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    *stats = counters[iface];
+    portEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
+void net_stats_get_drops(net_drop_stats_t *drops) {
+    memset(drops, 0, sizeof(*drops));
+#if LWIP_STATS
+    // Single 16-bit reads; a torn snapshot across fields is acceptable here
+    drops->valid = true;
+    drops->link_drop = lwip_stats.link.drop;
+    drops->link_err = lwip_stats.link.err;
+    drops->ip_drop = lwip_stats.ip.drop;
+    drops->tcp_drop = lwip_stats.tcp.drop;
+    drops->tcp_memerr = lwip_stats.tcp.memerr;
+    drops->udp_drop = lwip_stats.udp.drop;
+#endif
+}
+
+const char *net_stats_if_name(net_stats_if_t iface) {
+    return iface < NET_STATS_IF_COUNT ? if_names[iface] : "unknown";
+}
+
+void net_stats_write_json(json_writer_t *w) {
+    json_obj_begin(w);
+    json_kv_int(w, "sinceMs", (esp_timer_get_time() - started_us) / 1000);
+
+    json_key(w, "interfaces");
+    json_arr_begin(w);
+    for (int i = 0; i < NET_STATS_IF_COUNT; i++) {
+        net_if_stats_t s;
+        net_stats_get((net_stats_if_t)i, &s);
+        json_obj_begin(w);
+        json_kv_str(w, "name", if_names[i]);
+        json_kv_bool(w, "active", i == NET_STATS_IF_ESPNOW ? s.tx_packets || s.rx_packets : netifs[i] != NULL);
+        json_kv_uint(w, "txBytes", s.tx_bytes);
+        json_kv_uint(w, "rxBytes", s.rx_bytes);
+        json_kv_uint(w, "txPackets", s.tx_packets);
+        json_kv_uint(w, "rxPackets", s.rx_packets);
+        if (i == NET_STATS_IF_ESPNOW) {
+            json_kv_uint(w, "txFailed", s.tx_failed);
+        }
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+
+    net_drop_stats_t drops;
+    net_stats_get_drops(&drops);
+    json_key(w, "drops");
+    if (!drops.valid) {
+        json_null(w);
+    } else {
+        json_obj_begin(w);
+        json_kv_uint(w, "linkDrop", drops.link_drop);
+        json_kv_uint(w, "linkErr", drops.link_err);
+        json_kv_uint(w, "ipDrop", drops.ip_drop);
+        json_kv_uint(w, "tcpDrop", drops.tcp_drop);
+        json_kv_uint(w, "tcpMemErr", drops.tcp_memerr);
+        json_kv_uint(w, "udpDrop", drops.udp_drop);
+        json_obj_end(w);
+    }
+    json_obj_end(w);
+}
+
+/**
+ * @brief Byte count with a binary unit, e.g. "1.2 MB"
+ */
+static int format_bytes(char *buf, size_t buf_len, uint64_t bytes) {
+    if (bytes >= 1024 * 1024) {
+        return snprintf(buf, buf_len, "%.1f MB", bytes / (1024.0 * 1024.0));
+    }
+    if (bytes >= 1024) {
+        return snprintf(buf, buf_len, "%.1f KB", bytes / 1024.0);
+    }
+    return snprintf(buf, buf_len, "%lu B", (unsigned long)bytes);
+}
+
+/**
+ * @brief METRIC_WIFI_TX_RX_BYTES: totals over the WiFi netifs
+ */
+static metric_error_t bytes_provider(char *buf, size_t buf_len) {
+    uint64_t tx = 0;
+    uint64_t rx = 0;
+    portENTER_CRITICAL(&stats_lock);
+    for (int i = 0; i < NET_STATS_IF_ESPNOW; i++) {
+        tx += counters[i].tx_bytes;
+        rx += counters[i].rx_bytes;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    char tx_str[16];
+    char rx_str[16];
+    format_bytes(tx_str, sizeof(tx_str), tx);
+    format_bytes(rx_str, sizeof(rx_str), rx);
+    snprintf(buf, buf_len, "TX: %s, RX: %s", tx_str, rx_str);
+    return METRIC_OK;
+}
+
+/**
+ * @brief METRIC_NET_PACKETS: tx/rx packets per interface
+ */
+static metric_error_t packets_provider(char *buf, size_t buf_len) {
+    int pos = 0;
+    for (int i = 0; i < NET_STATS_IF_COUNT && pos < (int)buf_len; i++) {
+        net_if_stats_t s;
+        net_stats_get((net_stats_if_t)i, &s);
+        pos += snprintf(buf + pos, buf_len - pos, "%s%s %lu/%lu", i ? ", " : "", if_names[i],
+                        (unsigned long)s.tx_packets, (unsigned long)s.rx_packets);
+    }
+    return METRIC_OK;
+}
+
+/**
+ * @brief METRIC_NET_DROPS: lwIP drops and failed ESP-NOW sends
+ */
+static metric_error_t drops_provider(char *buf, size_t buf_len) {
+    net_drop_stats_t drops;
+    net_stats_get_drops(&drops);
+    net_if_stats_t espnow;
+    net_stats_get(NET_STATS_IF_ESPNOW, &espnow);
+
+    if (!drops.valid) {
+        snprintf(buf, buf_len, "espnow %lu failed (lwIP stats off)", (unsigned long)espnow.tx_failed);
+        return METRIC_OK;
+    }
+    snprintf(buf, buf_len, "link %lu, ip %lu, tcp %lu, udp %lu dropped, espnow %lu failed",
+             (unsigned long)(drops.link_drop + drops.link_err), (unsigned long)drops.ip_drop,
+             (unsigned long)(drops.tcp_drop + drops.tcp_memerr), (unsigned long)drops.udp_drop,
+             (unsigned long)espnow.tx_failed);
+    return METRIC_OK;
+}
@@ -0,0 +1,603 @@
+/**
+ * @file nmea.c
+ * @brief NMEA 0183 for navigation instruments: MWV, MDA and XDR out over UART, UDP and TCP
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "nmea.h"
+#include "version.h"
+#include "latest_values.h"
+#include "mem_policy.h"
+#include "static_mem.h"
+#include "true_wind.h"
+#include "wind.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register nmea.c version
+REGISTER_VERSION(Nmea, "1.0.0", "2026-10-15");
+
+static const char *TAG = "NMEA";
+
+#define NMEA_UART_RX_BUFFER 256                 // The driver needs one, though nothing is read
+#define NMEA_SELECT_MAX_MS 1000                 // Longest select() wait, so a stop is noticed
+#define NMEA_STOP_TIMEOUT_MS 2000
+#define PA_PER_INHG_X100 338639                 // 3386.39 Pa per inHg
+#define KNOTS_PER_MPS_X100000 194384            // 1.94384 kn per m/s
+
+/**
+ * @brief Sentences and their schedule
+ */
+typedef enum {
+    SENTENCE_MWV,
+    SENTENCE_MWV_TRUE,
+    SENTENCE_MDA,
+    SENTENCE_XDR,
+    SENTENCE_COUNT
+} sentence_t;
+
+static const uint32_t sentence_period_ms[SENTENCE_COUNT] = { NMEA_MWV_PERIOD_MS, NMEA_MWV_TRUE_PERIOD_MS,
+                                                              NMEA_MDA_PERIOD_MS, NMEA_XDR_PERIOD_MS };
+
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(task_slot, NMEA_TASK_STACK_SIZE);
+static volatile bool run = false;
+static bool uart_ready = false;
+static int udp_sock = -1;
+static int listen_sock = -1;
+static int clients[NMEA_TCP_MAX_CLIENTS];
+static nmea_builder_t builder;                  // Sentence task only
+
+static nmea_stats_t stats;
+static portMUX_TYPE nmea_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static void append(nmea_builder_t *b, const char *s, size_t n);
+static int32_t div_round(int64_t value, int64_t divisor);
+static bool get_env(telemetry_record_t *rec);
+static bool build(sentence_t sentence, nmea_builder_t *b);
+static bool build_mwv(nmea_builder_t *b);
+static bool build_mwv_true(nmea_builder_t *b);
+static bool build_mda(nmea_builder_t *b);
+static bool build_xdr(nmea_builder_t *b);
+static int32_t dew_point_x10(const telemetry_record_t *rec);
+static void emit(const char *sentence, size_t len);
+static void accept_client(void);
+static void close_outputs(void);
+static esp_err_t open_uart(void);
+static int open_udp(void);
+static int open_listener(void);
+static void nmea_task(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+uint8_t nmea_checksum(const char *body, size_t len) {
+    uint8_t sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum ^= (uint8_t)body[i];
+    }
+    return sum;
+}
+
+/**
+ * @brief Append n characters, marking the sentence overflowed if they do not fit with room for "*hh\r\n"
+ */
+static void append(nmea_builder_t *b, const char *s, size_t n) {
+    if (b->overflow || b->len + n + 5 > NMEA_SENTENCE_MAX) {
+        b->overflow = true;
+        return;
+    }
+    memcpy(b->buf + b->len, s, n);
+    b->len += n;
+    b->buf[b->len] = '\0';
+}
+
+void nmea_begin(nmea_builder_t *b, const char *address) {
+    b->len = 0;
+    b->overflow = false;
+    append(b, "$", 1);
+    append(b, address, strlen(address));
+}
+
+void nmea_add_str(nmea_builder_t *b, const char *s) {
+    append(b, ",", 1);
+    append(b, s, strlen(s));
+}
+
+void nmea_add_fixed(nmea_builder_t *b, int32_t value, uint8_t decimals) {
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    uint32_t mag = value < 0 ? (uint32_t)(-(int64_t)value) : (uint32_t)value;
+    char field[16];
+    int n;
+    if (decimals == 0) {
+        n = snprintf(field, sizeof(field), ",%s%lu", value < 0 ? "-" : "", (unsigned long)mag);
+    } else {
+        n = snprintf(field, sizeof(field), ",%s%lu.%0*lu", value < 0 ? "-" : "", (unsigned long)(mag / scale),
+                     decimals, (unsigned long)(mag % scale));
+    }
+    if (n > 0 && (size_t)n < sizeof(field)) {
+        append(b, field, (size_t)n);
+    } else {
+        b->overflow = true;
+    }
+}
+
+size_t nmea_finish(nmea_builder_t *b) {
+    if (b->overflow || b->len < 2) {
+        return 0;
+    }
+    uint8_t sum = nmea_checksum(b->buf + 1, b->len - 1);
+    int n = snprintf(b->buf + b->len, sizeof(b->buf) - b->len, "*%02X\r\n", sum);
+    if (n != 5) {
+        return 0;
+    }
+    b->len += 5;
+    return b->len;
+}
+
+/**
+ * @brief Integer division rounding half away from zero
+ */
+static int32_t div_round(int64_t value, int64_t divisor) {
+    return (int32_t)(value >= 0 ? (value + divisor / 2) / divisor : (value - divisor / 2) / divisor);
+}
+
+/**
+ * @brief Copy the newest reading (latest_values.h) if it is recent enough to send
+ */
+static bool get_env(telemetry_record_t *rec) {
+    latest_value_t v;
+    if (!(NMEA_NODE_ID != 0 ? latest_values_get(NMEA_NODE_ID, &v) : latest_values_newest(&v))) {
+        return false;
+    }
+    *rec = v.rec;
+    return (uint32_t)(esp_timer_get_time() / 1000) - v.rx_ms < NMEA_STALE_MS;
+}
+
+/**
+ * @brief Dew point from the Magnus formula (Sonntag constants), 0.1 degC
+ */
+static int32_t dew_point_x10(const telemetry_record_t *rec) {
+    const float b = 17.62f;
+    const float c = 243.12f;
+    float t = rec->temperature / 100.0f;
+    float rh = rec->humidity / 1000.0f;
+    if (rh < 0.1f) {
+        rh = 0.1f;
+    }
+    float gamma = logf(rh / 100.0f) + b * t / (c + t);
+    return (int32_t)lroundf(c * gamma / (b - gamma) * 10.0f);
+}
+
+/**
+ * @brief $WIMWV: apparent wind angle relative to the bow and speed, corrected for heel and mast motion
+ *        while the motion module runs; status V without a vane reading
+ */
+static bool build_mwv(nmea_builder_t *b) {
+    true_wind_t w;
+    if (!true_wind_get(&w)) {
+        wind_reading_t r;
+        wind_get(&r);
+        if (!r.running) {
+            return false;
+        }
+        nmea_begin(b, NMEA_TALKER "MWV");
+        nmea_add_str(b, "");
+        nmea_add_str(b, "R");
+        nmea_add_fixed(b, div_round(r.speed_3s, 10), 1);
+        nmea_add_str(b, "M");
+        nmea_add_str(b, "V");
+        return true;
+    }
+    nmea_begin(b, NMEA_TALKER "MWV");
+    nmea_add_fixed(b, w.awa * 10, 1);
+    nmea_add_str(b, "R");
+    nmea_add_fixed(b, div_round(w.aws, 10), 1);
+    nmea_add_str(b, "M");
+    nmea_add_str(b, "A");
+    return true;
+}
+
+/**
+ * @brief $WIMWV with reference T: true wind angle relative to the bow and speed; only with a GPS fix
+ */
+static bool build_mwv_true(nmea_builder_t *b) {
+    true_wind_t w;
+    if (!true_wind_get(&w) || !w.have_true) {
+        return false;
+    }
+    nmea_begin(b, NMEA_TALKER "MWV");
+    nmea_add_fixed(b, w.twa * 10, 1);
+    nmea_add_str(b, "T");
+    nmea_add_fixed(b, div_round(w.tws, 10), 1);
+    nmea_add_str(b, "M");
+    nmea_add_str(b, "A");
+    return true;
+}
+
+/**
+ * @brief $WIMDA: meteorological composite; water temperature, absolute humidity and magnetic wind
+ *        direction stay empty, and true direction needs a GPS fix under way
+ */
+static bool build_mda(nmea_builder_t *b) {
+    telemetry_record_t rec;
+    if (!get_env(&rec)) {
+        return false;
+    }
+    wind_reading_t w;
+    wind_get(&w);
+    true_wind_t tw;
+    bool have_twd = true_wind_get(&tw) && tw.twd >= 0;
+
+    nmea_begin(b, NMEA_TALKER "MDA");
+    nmea_add_fixed(b, div_round((int64_t)rec.pressure * 10000, PA_PER_INHG_X100), 2);
+    nmea_add_str(b, "I");
+    nmea_add_fixed(b, div_round(rec.pressure, 100), 3);
+    nmea_add_str(b, "B");
+    nmea_add_fixed(b, div_round(rec.temperature, 10), 1);
+    nmea_add_str(b, "C");
+    nmea_add_str(b, "");
+    nmea_add_str(b, "C");
+    nmea_add_fixed(b, div_round(rec.humidity, 100), 1);
+    nmea_add_str(b, "");
+    nmea_add_fixed(b, dew_point_x10(&rec), 1);
+    nmea_add_str(b, "C");
+    if (have_twd) {
+        nmea_add_fixed(b, tw.twd * 10, 1);
+    } else {
+        nmea_add_str(b, "");
+    }
+    nmea_add_str(b, "T");
+    nmea_add_str(b, "");
+    nmea_add_str(b, "M");
+    if (w.running) {
+        nmea_add_fixed(b, div_round((int64_t)w.avg_2min * KNOTS_PER_MPS_X100000, 1000000), 1);
+        nmea_add_str(b, "N");
+        nmea_add_fixed(b, div_round(w.avg_2min, 10), 1);
+    } else {
+        nmea_add_str(b, "");
+        nmea_add_str(b, "N");
+        nmea_add_str(b, "");
+    }
+    nmea_add_str(b, "M");
+    return true;
+}
+
+/**
+ * @brief $WIXDR: temperature, pressure and humidity as named transducers
+ */
+static bool build_xdr(nmea_builder_t *b) {
+    telemetry_record_t rec;
+    if (!get_env(&rec)) {
+        return false;
+    }
+    nmea_begin(b, NMEA_TALKER "XDR");
+    nmea_add_str(b, "C");
+    nmea_add_fixed(b, div_round(rec.temperature, 10), 1);
+    nmea_add_str(b, "C");
+    nmea_add_str(b, "AIRTEMP");
+    nmea_add_str(b, "P");
+    nmea_add_fixed(b, div_round(rec.pressure, 10), 4);
+    nmea_add_str(b, "B");
+    nmea_add_str(b, "BARO");
+    nmea_add_str(b, "H");
+    nmea_add_fixed(b, div_round(rec.humidity, 100), 1);
+    nmea_add_str(b, "P");
+    nmea_add_str(b, "HUMIDITY");
+    return true;
+}
+
+/**
+ * @brief Build one sentence into b
+ *
+ * @return false when its data is missing or stale
+ */
+static bool build(sentence_t sentence, nmea_builder_t *b) {
+    switch (sentence) {
+    case SENTENCE_MWV:
+        return build_mwv(b);
+    case SENTENCE_MWV_TRUE:
+        return build_mwv_true(b);
+    case SENTENCE_MDA:
+        return build_mda(b);
+    case SENTENCE_XDR:
+        return build_xdr(b);
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Write one finished sentence to every output
+ */
+static void emit(const char *sentence, size_t len) {
+    uint32_t uart_bytes = 0;
+    uint32_t udp_sent = 0;
+    uint32_t dropped = 0;
+    uint32_t connected = 0;
+
+    if (uart_ready) {
+        int n = uart_write_bytes(NMEA_UART_NUM, sentence, len);
+        uart_bytes = n > 0 ? (uint32_t)n : 0;
+    }
+    if (udp_sock >= 0) {
+        struct sockaddr_in dest = {
+            .sin_family = AF_INET,
+            .sin_port = htons(NMEA_NET_PORT),
+            .sin_addr.s_addr = htonl(INADDR_BROADCAST),
+        };
+        if (sendto(udp_sock, sentence, len, 0, (struct sockaddr *)&dest, sizeof(dest)) == (int)len) {
+            udp_sent = 1;
+        }
+    }
+    for (size_t i = 0; i < NMEA_TCP_MAX_CLIENTS; i++) {
+        if (clients[i] < 0) {
+            continue;
+        }
+        // A slow reader would stall every output; drop it instead
+        if (send(clients[i], sentence, len, MSG_DONTWAIT) != (int)len) {
+            close(clients[i]);
+            clients[i] = -1;
+            dropped++;
+        } else {
+            connected++;
+        }
+    }
+
+    portENTER_CRITICAL(&nmea_lock);
+    stats.sentences++;
+    stats.uart_bytes += uart_bytes;
+    stats.udp_sent += udp_sent;
+    stats.tcp_clients = connected;
+    stats.tcp_dropped += dropped;
+    portEXIT_CRITICAL(&nmea_lock);
+}
+
+/**
+ * @brief Take one pending connection, refusing it when every client slot is in use
+ */
+static void accept_client(void) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int sock = accept(listen_sock, (struct sockaddr *)&addr, &addr_len);
+    if (sock < 0) {
+        return;
+    }
+    for (size_t i = 0; i < NMEA_TCP_MAX_CLIENTS; i++) {
+        if (clients[i] < 0) {
+            clients[i] = sock;
+            ESP_LOGI(TAG, "TCP client %s connected", inet_ntoa(addr.sin_addr));
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "TCP client %s refused - %d already connected", inet_ntoa(addr.sin_addr), NMEA_TCP_MAX_CLIENTS);
+    close(sock);
+}
+
+static esp_err_t open_uart(void) {
+    if (mem_policy_pin_taken(NMEA_UART_TX_GPIO)) {
+        ESP_LOGW(TAG, "GPIO%d is wired to PSRAM on this board", NMEA_UART_TX_GPIO);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    uart_config_t cfg = {
+        .baud_rate = NMEA_UART_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    esp_err_t err = uart_driver_install(NMEA_UART_NUM, NMEA_UART_RX_BUFFER, NMEA_UART_TX_BUFFER, 0, NULL, 0);
+    if (err == ESP_OK) {
+        err = uart_param_config(NMEA_UART_NUM, &cfg);
+    }
+    if (err == ESP_OK) {
+        err = uart_set_pin(NMEA_UART_NUM, NMEA_UART_TX_GPIO, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE,
+                           UART_PIN_NO_CHANGE);
+    }
+    if (err != ESP_OK) {
+        uart_driver_delete(NMEA_UART_NUM);
+    }
+    return err;
+}
+
+/**
+ * @brief UDP socket allowed to broadcast
+ *
+ * @return Socket, or -1 with the error logged
+ */
+static int open_udp(void) {
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGW(TAG, "Unable to create UDP socket: errno %d", errno);
+        return -1;
+    }
+    int on = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on)) < 0) {
+        ESP_LOGW(TAG, "UDP broadcast not allowed: errno %d", errno);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/**
+ * @brief Non-blocking TCP listener on NMEA_NET_PORT, every interface
+ *
+ * @return Socket, or -1 with the error logged
+ */
+static int open_listener(void) {
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(NMEA_NET_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) {
+        ESP_LOGW(TAG, "Unable to create TCP socket: errno %d", errno);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 2) < 0) {
+        ESP_LOGW(TAG, "TCP port %d unavailable: errno %d", NMEA_NET_PORT, errno);
+        close(sock);
+        return -1;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    return sock;
+}
+
+static void close_outputs(void) {
+    for (size_t i = 0; i < NMEA_TCP_MAX_CLIENTS; i++) {
+        if (clients[i] >= 0) {
+            close(clients[i]);
+            clients[i] = -1;
+        }
+    }
+    if (listen_sock >= 0) {
+        close(listen_sock);
+        listen_sock = -1;
+    }
+    if (udp_sock >= 0) {
+        close(udp_sock);
+        udp_sock = -1;
+    }
+    if (uart_ready) {
+        uart_driver_delete(NMEA_UART_NUM);
+        uart_ready = false;
+    }
+}
+
+/**
+ * @brief Emit each sentence when due; between sentences, wait in select() for TCP connections
+ */
+static void nmea_task(void *arg) {
+    int64_t next_ms[SENTENCE_COUNT];
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    for (size_t s = 0; s < SENTENCE_COUNT; s++) {
+        next_ms[s] = now_ms + sentence_period_ms[s];
+    }
+
+    while (run) {
+        now_ms = esp_timer_get_time() / 1000;
+        int64_t wait_ms = NMEA_SELECT_MAX_MS;
+        for (size_t s = 0; s < SENTENCE_COUNT; s++) {
+            if (sentence_period_ms[s] == 0) {
+                continue;
+            }
+            if (now_ms >= next_ms[s]) {
+                if (build((sentence_t)s, &builder)) {
+                    size_t len = nmea_finish(&builder);
+                    if (len > 0) {
+                        emit(builder.buf, len);
+                    } else {
+                        ESP_LOGW(TAG, "Sentence %u longer than %d characters - not sent", (unsigned)s,
+                                 NMEA_SENTENCE_MAX);
+                    }
+                }
+                // Keep the cadence, but do not burst to catch up after a stall
+                next_ms[s] += sentence_period_ms[s];
+                if (next_ms[s] <= now_ms) {
+                    next_ms[s] = now_ms + sentence_period_ms[s];
+                }
+            }
+            if (next_ms[s] - now_ms < wait_ms) {
+                wait_ms = next_ms[s] - now_ms;
+            }
+        }
+
+        if (listen_sock < 0) {
+            vTaskDelay(pdMS_TO_TICKS(wait_ms) > 0 ? pdMS_TO_TICKS(wait_ms) : 1);
+            continue;
+        }
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listen_sock, &readable);
+        struct timeval tv = { .tv_sec = wait_ms / 1000, .tv_usec = (wait_ms % 1000) * 1000 };
+        if (select(listen_sock + 1, &readable, NULL, NULL, &tv) > 0 && FD_ISSET(listen_sock, &readable)) {
+            accept_client();
+        }
+    }
+
+    close_outputs();
+    task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t nmea_start(void) {
+    if (task_handle != NULL) {
+        return ESP_OK;
+    }
+
+    for (size_t i = 0; i < NMEA_TCP_MAX_CLIENTS; i++) {
+        clients[i] = -1;
+    }
+    portENTER_CRITICAL(&nmea_lock);
+    memset(&stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&nmea_lock);
+
+    esp_err_t err = open_uart();
+    uart_ready = err == ESP_OK;
+    if (!uart_ready) {
+        ESP_LOGW(TAG, "UART %d unavailable: %s", NMEA_UART_NUM, esp_err_to_name(err));
+    }
+    udp_sock = open_udp();
+    listen_sock = open_listener();
+    run = true;
+    if (static_task_create(task_slot, nmea_task, NMEA_TASK_NAME, NMEA_TASK_STACK_SIZE, NULL, NMEA_TASK_PRIORITY,
+                           &task_handle, TASK_CORE_NET) != pdPASS) {
+        run = false;
+        task_handle = NULL;
+        close_outputs();
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "NMEA 0183 out: UART %d TX GPIO %d at %d baud%s, UDP broadcast and TCP on port %d",
+             NMEA_UART_NUM, NMEA_UART_TX_GPIO, NMEA_UART_BAUD, uart_ready ? "" : " (down)", NMEA_NET_PORT);
+    return ESP_OK;
+}
+
+void nmea_get_stats(nmea_stats_t *out) {
+    portENTER_CRITICAL(&nmea_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&nmea_lock);
+}
+
+void nmea_stop(void) {
+    if (task_handle == NULL) {
+        return;
+    }
+    run = false;
+    for (int waited = 0; task_handle != NULL && waited < NMEA_STOP_TIMEOUT_MS; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    if (task_handle != NULL) {
+        ESP_LOGW(TAG, "Sentence task did not stop");
+    }
+}
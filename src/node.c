@@ -11,48 +11,1646 @@
 // Includes
 // =============================
 #include "node.h"
+#include "adc_stream.h"
+#include "bme680.h"
+#include "boot_health.h"
+#include "boot_trace.h"
+#include "deadband.h"
+#include "energy_bench.h"
+#include "espnow_batch.h"
+#include "espnow_channel.h"
+#include "espnow_config.h"
+#include "espnow_rekey.h"
+#include "espnow_failover.h"
+#include "espnow_link.h"
+#include "espnow_ota.h"
+#include "espnow_pair.h"
+#include "espnow_slot.h"
+#include "espnow_time.h"
+#include "espnow_relay.h"
+#include "espnow_reliable.h"
+#include "flash_backlog.h"
+#include "i2c_bus.h"
+#include "iaq.h"
+#include "power_profile.h"
+#include "pressure_trend.h"
+#include "nvs_utils.h"
+#include "rain_gauge.h"
+#include "sample_rate.h"
+#include "sampler.h"
+#include "sensor_hal.h"
+#include "telemetry.h"
+#include "ulp_monitor.h"
+#include "wifi_ap.h"
+#include "wind.h"
+#include "SystemMetrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_private/esp_clk.h"
+#include "esp_sleep.h"
+#include "soc/soc_caps.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 // =============================
 // Constants & Definitions
 // =============================
 static const char *TAG = "NODE";
 
+static bme680_t bme680;
+static bool bme680_ready = false;
+static uint8_t gateway_mac[6];                  // The gateway sent to; espnow_failover picks it
+static uint32_t acked_before = 0;               // Awake node: ACKs at the previous node_main()
+static bool gateway_configured = false;         // A server MAC is set, so a new image must reach it
+static bool link_ready = false;
+static bool backlog_ready = false;              // Records the window cannot take are paged out to flash
+static bool batching = false;
+static bme680_reading_t last_reading;           // Transmit stage: previous reading, for priority steps
+static bool have_last_reading = false;
+static uint32_t record_seq = 0;                 // Transmit stage with NODE_DEADBAND: seq of the last record sent
+static bool benchmarked = false;              // The energy benchmark ran this boot
+static bool relaying = false;
+
+_Static_assert(sizeof(bme680_reading_t) <= SAMPLER_PAYLOAD_MAX, "BME680 reading does not fit a sample");
+_Static_assert(SENSOR_PROFILE_LOW_POWER == BME680_PROFILE_LOW_POWER && SENSOR_PROFILE_BALANCED == BME680_PROFILE_BALANCED &&
+               SENSOR_PROFILE_HIGH_PRECISION == BME680_PROFILE_HIGH_PRECISION, "config profiles are the driver's");
+_Static_assert(NODE_BATCH_SAMPLES <= ESPNOW_BATCH_MAX_RECORDS, "a batch must fit one telemetry frame");
+_Static_assert(ESPNOW_BATCH_WAIT_FOREVER == SAMPLER_WAIT_FOREVER, "batch and sampler deadlines differ");
+_Static_assert(NODE_DEEP_SLEEP_PERIOD_S * NODE_BATCH_SAMPLES * 1000 < ESPNOW_OTA_GATHER_MS,
+               "a duty-cycled node must ask for firmware while the gateway gathers a session");
+_Static_assert(NODE_RATE_MAX_S * 1000 < ESPNOW_OTA_GATHER_MS,
+               "an adaptive period must stay within the firmware gather window");
+_Static_assert((TELEMETRY_REC_STEP_MASK >> TELEMETRY_REC_STEP_SHIFT) >= BME680_HEATER_MAX_STEPS - 1,
+               "telemetry heater step field too narrow");
+
+/**
+ * @brief One sample taken during a duty-cycle wake
+ */
+typedef struct {
+    uint32_t seq;
+    uint32_t time_s;                            // System time, kept by the RTC across deep sleep
+    bme680_reading_t reading;
+    bool held;                                  // Samples before it were held back by the deadband
+    bool urgent;                                // It raised an alarm
+} node_rtc_sample_t;
+
+/**
+ * @brief Samples waiting for the next batch send
+ *
+ * RTC_DATA_ATTR keeps this across deep sleep; any other reset zeroes it.
+ */
+typedef struct {
+    bool active;                                // The node went to sleep on purpose
+    uint32_t seq;                               // Samples taken since the first sleep
+    uint8_t head;                               // Next slot to write
+    uint8_t count;
+    uint32_t overwritten;                       // Oldest samples lost while the batch could not be sent
+    uint16_t ulp_low;                           // ULP thresholds in force, 0 before the first arm
+    uint16_t ulp_high;
+    uint64_t due_us;                            // RTC clock when the next sample is due
+    node_rtc_sample_t samples[NODE_RTC_BUFFER_LEN];
+} node_rtc_batch_t;
+
+static RTC_DATA_ATTR node_rtc_batch_t rtc_batch;
+static RTC_DATA_ATTR pressure_trend_t trend;    // Zeroed at power-on, which is an empty tracker
+static RTC_DATA_ATTR node_settings_t settings;  // In force, resolved; kept for the duty-cycle fast path
+static RTC_DATA_ATTR deadband_t deadband;       // Last BME680 sample sent; zeroed at power-on, so the first goes out
+static RTC_DATA_ATTR uint8_t bme680_profile;    // SENSOR_PROFILE_*, from the config; kept for the duty-cycle fast path
+static RTC_DATA_ATTR sample_rate_t rate;        // Period and batch in force; interval_ms is 0 until the first update
+static int64_t rate_checked_us = 0;             // Awake node, transmit stage: last rate_update()
+
+// Order of the values deadband_pass() hands the filter
+static const deadband_field_t DEADBAND_FIELDS[] = {
+    { NODE_DEADBAND_TEMP, false },
+    { NODE_DEADBAND_PRESSURE_PA, false },
+    { NODE_DEADBAND_HUMIDITY, false },
+    { NODE_DEADBAND_GAS_PERMILLE, true },
+};
+_Static_assert(sizeof(DEADBAND_FIELDS) / sizeof(DEADBAND_FIELDS[0]) <= DEADBAND_FIELDS_MAX, "too many deadband fields");
+static bool sampled_this_boot = false;
+static bool ulp_data_pending = false;           // The ULP ran during the last sleep; its buffer is unread
+static bool tip_wake = false;                   // This wake only counts a rain tip; the sample is not due
+static bool trend_alert = false;                // This wake's sample raised a pressure alarm
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t sensors_start(void);
+static void analog_start(void);
+static void sensors_stop(void);
+static void link_start(void);
+static void espnow_rx(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi);
+static void log_reading(uint32_t seq, const bme680_reading_t *reading);
+static esp_err_t bme680_hal_init(void **state);
+static esp_err_t bme680_hal_trigger(void *state, uint32_t *ready_us);
+static esp_err_t bme680_hal_read(void *state, sensor_sample_t *sample);
+static void from_sample(const sensor_sample_t *sample, bme680_reading_t *reading);
+static void log_sample(const char *name, uint32_t seq, const sensor_sample_t *sample);
+static void transmit_sample(const sampler_sample_t *sample);
+static bool is_priority(const bme680_reading_t *reading);
+static bool deadband_pass(const bme680_reading_t *reading, uint32_t time_s, bool force, bool *held);
+static bool trend_raised(uint32_t time_s, uint32_t pressure);
+static void rate_update(bool measure_supply);
+static uint32_t rate_interval_ms(void);
+static uint8_t rate_batch(void);
+static uint32_t transmit_idle(void);
+static uint32_t node_id(void);
+static void to_record(uint32_t seq, uint32_t time_s, const bme680_reading_t *reading, telemetry_record_t *rec);
+static void start_frame(telemetry_writer_t *w, uint8_t *frame, size_t cap, uint8_t flags);
+static void start_backlog_frame(telemetry_writer_t *w, uint8_t *frame, size_t cap, uint8_t flags);
+static void add_extensions(telemetry_writer_t *w);
+static esp_err_t send_frame(const telemetry_writer_t *w, bool urgent);
+static void backlog_replay(void);
+static uint8_t rtc_batch_take(bool urgent);
+static void rtc_batch_append(const bme680_reading_t *reading, uint32_t time_s, bool held, bool urgent);
+static void rtc_batch_page_out(void);
+static void rtc_batch_send(void);
+static void log_power(void);
+static void ota_check(void);
+static void take_rtc_sample(void);
+static void report_ulp(void);
+static void arm_ulp(void);
+static void enter_deep_sleep(void);
+static void node_time_sync(void);
+static bool gateway_failover(bool delivered);
+static void run_benchmark(void);
+static void settings_resolve(const node_settings_t *pushed);
+static void config_apply(void);
+static void apply_long_range(void);
+
+// The node's BME680, sampled through the sensor HAL; the duty-cycle wake still reads it directly
+REGISTER_SENSOR_DRIVER(Bme680, .name = "bme680", .init = bme680_hal_init, .trigger = bme680_hal_trigger,
+                       .read = bme680_hal_read);
+
 // =============================
 // Function Definitions
 // =============================
 
+/**
+ * @brief Start the shared I2C bus and bring up the BME680 on it, with the configured profile
+ *
+ * A missing sensor is logged but does not stop the node; it still relays and reports.
+ * The profile's conversion time is what bme680_trigger() hands the sampler, so
+ * the read is scheduled for when that profile's sample is ready.
+ */
+static esp_err_t sensors_start(void) {
+    esp_err_t err = i2c_bus_start(NODE_I2C_PORT, NODE_I2C_SDA_GPIO, NODE_I2C_SCL_GPIO);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    i2c_bus_device_handle_t dev = NULL;
+    bme680_config_t sensor_cfg = {
+        .transfer = i2c_bus_transfer,
+        .address = NODE_BME680_ADDRESS,
+        .light_sleep = true,                    // Nothing else runs on a node while the plate heats
+    };
+    if (bme680_config_set_profile(&sensor_cfg, (bme680_profile_t)bme680_profile) != ESP_OK) {
+        bme680_config_set_profile(&sensor_cfg, (bme680_profile_t)SENSOR_DEFAULT_PROFILE);
+    }
+    // Gas heater, one step per sample (Bosch's recommended 320 degC / 150 ms for indoor air quality by default)
+    const bme680_heater_step_t heater = { settings.heater_temp_c, settings.heater_ms };
+    bme680_ready = i2c_bus_add_device("bme680", NODE_BME680_ADDRESS, BME680_I2C_SPEED_HZ, &dev) == ESP_OK;
+    if (bme680_ready) {
+        sensor_cfg.transfer_ctx = dev;
+        bme680_ready = bme680_init(&bme680, &sensor_cfg) == ESP_OK;
+    }
+    if (!bme680_ready) {
+        ESP_LOGW(TAG, "BME680 not available - running without environmental readings");
+    } else if (bme680_set_heater_profile(&bme680, &heater, 1) != ESP_OK) {
+        ESP_LOGW(TAG, "BME680 heater profile not applied - running without gas readings");
+    }
+    if (bme680_ready && NODE_BSEC != 0) {
+        err = iaq_start(NODE_DEEP_SLEEP_PERIOD_S != 0);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "No IAQ: %s", esp_err_to_name(err));
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Stream the supply and the vane; before wind_start(), which looks for the vane in the stream
+ */
+static void analog_start(void) {
+    esp_err_t err = adc_stream_add("supply", ADC_STREAM_VDD_CHANNEL, ADC_STREAM_VDD_SHIFT, NULL);
+    if (err == ESP_OK && NODE_WIND != 0) {
+        err = adc_stream_add("vane", WIND_VANE_ADC_CHANNEL, 0, NULL);   // Unfiltered: the wind code averages it
+    }
+    if (err == ESP_OK) {
+        err = adc_stream_start();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "ADC stream unavailable: %s", esp_err_to_name(err));
+        adc_stream_stop();
+    }
+}
+
+static void sensors_stop(void) {
+    bme680_deinit(&bme680);
+    bme680_ready = false;
+    i2c_bus_stop();
+}
+
+/**
+ * @brief Bring up the radio and an encrypted ESP-NOW link to the configured gateway
+ *
+ * Without a server MAC the node pairs (espnow_pair.h), which stores one;
+ * if no gateway answers, or pairing is built out, it keeps sampling and
+ * only logs. With one it announces itself on power-on, so the gateway
+ * takes it as a peer.
+ */
+static void link_start(void) {
+    device_config_t cfg;
+    if (nvs_config_get(&cfg) != ESP_OK) {
+        ESP_LOGW(TAG, "No config - readings are only logged");
+        return;
+    }
+    bool paired = espnow_link_parse_mac(cfg.server_mac, gateway_mac) == ESP_OK;
+    if (!paired && ESPNOW_PAIR == 0) {
+        ESP_LOGW(TAG, "No gateway MAC configured - readings are only logged");
+        return;
+    }
+
+    // The channel the gateway was last heard on, else the one it paired on, so a wake never scans
+    uint8_t home = espnow_channel_node_home(cfg.server_channel != 0 ? cfg.server_channel : NODE_ESPNOW_CHANNEL);
+    esp_err_t err = wifi_espnow_init(home);
+    if (err == ESP_OK) {
+        boot_trace_radio_up();
+        err = espnow_link_init(espnow_rx);
+    }
+    if (!paired) {
+        if (err == ESP_OK) {
+            err = espnow_pair_node_run(home, gateway_mac);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Not paired with a gateway - readings are only logged: %s", esp_err_to_name(err));
+            return;
+        }
+        snprintf(cfg.server_mac, sizeof(cfg.server_mac), MACSTR, MAC2STR(gateway_mac));
+    } else if (err == ESP_OK && esp_reset_reason() != ESP_RST_DEEPSLEEP) {
+        // A typed-in gateway has not got this node as an encrypted peer until it hears from it
+        esp_err_t announce_err = espnow_pair_node_announce();
+        if (announce_err != ESP_OK && announce_err != ESP_ERR_INVALID_STATE && announce_err != ESP_ERR_NOT_SUPPORTED) {
+            ESP_LOGW(TAG, "Not announced to the gateway: %s", esp_err_to_name(announce_err));
+        }
+    }
+    gateway_configured = true;
+    uint8_t configured[6];
+    memcpy(configured, gateway_mac, sizeof(configured));
+    espnow_failover_init(configured, gateway_mac);
+    if (err == ESP_OK) {
+        err = espnow_link_add_peer(gateway_mac);
+    }
+    if (err == ESP_OK) {
+        err = espnow_reliable_sender_init(gateway_mac);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "ESP-NOW link unavailable: %s", esp_err_to_name(err));
+        return;
+    }
+    espnow_ota_node_init(gateway_mac);
+    espnow_time_node_init(gateway_mac);
+    espnow_slot_node_init(gateway_mac);
+    espnow_channel_node_init(gateway_mac);
+    espnow_config_node_init(settings.version);
+    espnow_rekey_node_init(gateway_mac);
+    link_ready = true;
+    apply_long_range();
+    backlog_ready = flash_backlog_init() == ESP_OK;
+    if (memcmp(configured, gateway_mac, sizeof(configured)) != 0) {
+        ESP_LOGI(TAG, "Sending to gateway " MACSTR " (failed over from %s)", MAC2STR(gateway_mac), cfg.server_mac);
+    } else {
+        ESP_LOGI(TAG, "Sending to gateway %s", cfg.server_mac);
+    }
+}
+
+/**
+ * @brief ESP-NOW receive handler; runs in the link task. The gateway sends ACKs, time, slots and firmware.
+ *
+ * A relay also gets other nodes' frames, and the ACKs for them.
+ */
+static void espnow_rx(const uint8_t *mac, const uint8_t *data, size_t len, int8_t rssi) {
+    espnow_failover_on_receive(mac, data, len, rssi);
+    if (!espnow_relay_on_receive(mac, data, len, rssi) && !espnow_channel_on_receive(mac, data, len, rssi) && !espnow_time_on_receive(mac, data, len, rssi) &&
+        !espnow_pair_on_receive(mac, data, len, rssi) && !espnow_slot_on_receive(mac, data, len, rssi) && !espnow_ota_on_receive(mac, data, len, rssi) &&
+        !espnow_reliable_on_receive(mac, data, len, rssi)) {
+        ESP_LOGD(TAG, "Ignored %u-byte frame from " MACSTR, (unsigned)len, MAC2STR(mac));
+    }
+}
+
+/**
+ * @brief Log one BME680 reading in fixed point
+ */
+static void log_reading(uint32_t seq, const bme680_reading_t *reading) {
+    int t = reading->temperature;
+    ESP_LOGI(TAG, "BME680 #%lu: %s%d.%02d C, %lu.%02lu hPa, %lu.%01lu %%RH", (unsigned long)seq,
+             t < 0 ? "-" : "", abs(t) / 100, abs(t) % 100, (unsigned long)(reading->pressure / 100),
+             (unsigned long)(reading->pressure % 100), (unsigned long)(reading->humidity / 1000),
+             (unsigned long)(reading->humidity % 1000 / 100));
+    if (reading->gas_resistance > 0) {
+        ESP_LOGI(TAG, "BME680 gas (step %u): %lu ohm", reading->heater_step,
+                 (unsigned long)reading->gas_resistance);
+    } else if (bme680.heater_count > 0) {
+        ESP_LOGW(TAG, "BME680 gas (step %u): heater did not stabilise", reading->heater_step);
+    }
+    iaq_result_t iaq;
+    iaq_get(&iaq);
+    if (iaq.valid) {
+        ESP_LOGI(TAG, "IAQ %u.%u (accuracy %u), CO2-eq %u ppm, bVOC %lu ppb", iaq.iaq / 10, iaq.iaq % 10,
+                 iaq.accuracy, iaq.co2_ppm, (unsigned long)iaq.bvoc_ppb);
+    }
+}
+
+/**
+ * @brief BME680 driver: present once sensors_start() brought it up
+ */
+static esp_err_t bme680_hal_init(void **state) {
+    *state = &bme680;
+    return bme680_ready ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+static esp_err_t bme680_hal_trigger(void *state, uint32_t *ready_us) {
+    if (NODE_BSEC != 0) {
+        bool due = false;
+        iaq_prepare((bme680_t *)state, &due);   // Before the trigger, which times the heater step
+    }
+    return bme680_trigger((bme680_t *)state, ready_us);
+}
+
+static esp_err_t bme680_hal_read(void *state, sensor_sample_t *sample) {
+    bme680_reading_t reading;
+    esp_err_t err = bme680_fetch((bme680_t *)state, &reading);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (NODE_BSEC != 0) {
+        iaq_process(&reading, NULL);
+    }
+    sample->quantity[0] = SENSOR_TEMPERATURE;
+    sample->value[0] = reading.temperature;
+    sample->quantity[1] = SENSOR_PRESSURE;
+    sample->value[1] = (int32_t)reading.pressure;
+    sample->quantity[2] = SENSOR_HUMIDITY;
+    sample->value[2] = (int32_t)reading.humidity;
+    sample->quantity[3] = SENSOR_GAS_RESISTANCE;
+    sample->value[3] = (int32_t)reading.gas_resistance;
+    sample->quantity[4] = SENSOR_HEATER_STEP;
+    sample->value[4] = reading.heater_step;
+    sample->quantity[5] = SENSOR_GAS_STATUS;
+    sample->value[5] = (reading.gas_valid ? SENSOR_GAS_VALID : 0) | (reading.heat_stable ? SENSOR_GAS_HEAT_STABLE : 0);
+    sample->count = 6;
+    return ESP_OK;
+}
+
+/**
+ * @brief Back from the HAL sample to the reading the telemetry path works on
+ */
+static void from_sample(const sensor_sample_t *sample, bme680_reading_t *reading) {
+    int32_t v = 0;
+    memset(reading, 0, sizeof(*reading));
+    if (sensor_sample_find(sample, SENSOR_TEMPERATURE, &v)) {
+        reading->temperature = (int16_t)v;
+    }
+    if (sensor_sample_find(sample, SENSOR_PRESSURE, &v)) {
+        reading->pressure = (uint32_t)v;
+    }
+    if (sensor_sample_find(sample, SENSOR_HUMIDITY, &v)) {
+        reading->humidity = (uint32_t)v;
+    }
+    if (sensor_sample_find(sample, SENSOR_GAS_RESISTANCE, &v)) {
+        reading->gas_resistance = (uint32_t)v;
+    }
+    if (sensor_sample_find(sample, SENSOR_HEATER_STEP, &v)) {
+        reading->heater_step = (uint8_t)v;
+    }
+    if (sensor_sample_find(sample, SENSOR_GAS_STATUS, &v)) {
+        reading->gas_valid = (v & SENSOR_GAS_VALID) != 0;
+        reading->heat_stable = (v & SENSOR_GAS_HEAT_STABLE) != 0;
+    }
+}
+
+/**
+ * @brief Log a sample of a driver the telemetry record does not carry
+ */
+static void log_sample(const char *name, uint32_t seq, const sensor_sample_t *sample) {
+    for (uint8_t i = 0; i < sample->count && i < SENSOR_SAMPLE_VALUES; i++) {
+        ESP_LOGD(TAG, "%s #%lu: %s %ld", name, (unsigned long)seq,
+                 sensor_quantity_name((sensor_quantity_t)sample->quantity[i]), (long)sample->value[i]);
+    }
+}
+
+/**
+ * @brief Sampler transmit stage: runs in its own task, so a slow link never delays sampling
+ */
+static void transmit_sample(const sampler_sample_t *sample) {
+    const sensor_driver_t *driver = sensor_hal_driver(sample->sensor);
+    const char *name = driver != NULL ? driver->name : "sensor";
+    if (sample->status != ESP_OK) {
+        ESP_LOGW(TAG, "%s read failed: %s", name, esp_err_to_name(sample->status));
+        return;
+    }
+    const sensor_sample_t *values = (const sensor_sample_t *)sample->data;
+    if (driver != &Bme680_sensor_driver) {
+        log_sample(name, sample->seq, values);
+        return;
+    }
+
+    bme680_reading_t reading;
+    from_sample(values, &reading);
+    uint32_t time_s = espnow_time_now();
+    log_reading(sample->seq, &reading);
+    bool priority = is_priority(&reading);
+    if (trend_raised(time_s, reading.pressure)) {
+        priority = true;
+    }
+    int64_t now_us = esp_timer_get_time();
+    if (NODE_DEEP_SLEEP_PERIOD_S == 0 && now_us - rate_checked_us >= (int64_t)NODE_RATE_CHECK_MS * 1000) {
+        rate_checked_us = now_us;
+        rate_update(true);
+    }
+    if (!batching) {
+        return;
+    }
+    bool held = false;
+    if (!deadband_pass(&reading, time_s, priority, &held)) {
+        return;
+    }
+
+    // Held-back samples take no seq, so the gateway sees a run and not losses
+    telemetry_record_t rec;
+    to_record(NODE_DEADBAND != 0 ? ++record_seq : sample->seq, time_s, &reading, &rec);
+    rec.held = held;
+    rec.urgent = priority;
+    espnow_batch_add(&rec, priority);
+}
+
+/**
+ * @brief A reading that jumped from the previous one goes out at once instead of waiting for its batch
+ */
+static bool is_priority(const bme680_reading_t *reading) {
+    bool step = have_last_reading &&
+                (abs(reading->temperature - last_reading.temperature) >= NODE_PRIORITY_TEMP_STEP ||
+                 labs((long)reading->pressure - (long)last_reading.pressure) >= NODE_PRIORITY_PRESSURE_STEP_PA);
+    last_reading = *reading;
+    have_last_reading = true;
+    if (step) {
+        ESP_LOGI(TAG, "Step change in BME680 reading - sending now");
+    }
+    return step;
+}
+
+/**
+ * @brief Send-on-change: whether a reading left its deadbands or the heartbeat ran out
+ *
+ * @param held Receives whether readings before it were held back, which its record then says
+ */
+static bool deadband_pass(const bme680_reading_t *reading, uint32_t time_s, bool force, bool *held) {
+    *held = false;
+    if (NODE_DEADBAND == 0) {
+        return true;
+    }
+    const int32_t values[] = {
+        reading->temperature,
+        (int32_t)reading->pressure,
+        (int32_t)reading->humidity,
+        reading->gas_valid ? (int32_t)reading->gas_resistance : 0,
+    };
+    _Static_assert(sizeof(values) / sizeof(values[0]) == sizeof(DEADBAND_FIELDS) / sizeof(DEADBAND_FIELDS[0]),
+                   "one value per deadband field");
+    bool send = deadband_check(&deadband, DEADBAND_FIELDS, values, sizeof(values) / sizeof(values[0]), time_s,
+                               NODE_DEADBAND_HEARTBEAT_S, force, held);
+    if (!send) {
+        ESP_LOGD(TAG, "Reading within its deadbands - held back (%lu so far)", (unsigned long)deadband.suppressed);
+    }
+    return send;
+}
+
+/**
+ * @brief Feed the pressure trend; true when this sample raised its alarm (a clearing waits for its batch)
+ */
+static bool trend_raised(uint32_t time_s, uint32_t pressure) {
+    if (NODE_PRESSURE_TREND == 0) {
+        return false;
+    }
+    pressure_trend_alarm_t before = (pressure_trend_alarm_t)trend.alarm;
+    if (!pressure_trend_add(&trend, time_s, pressure)) {
+        return false;
+    }
+    pressure_trend_reading_t r;
+    pressure_trend_get(&trend, &r);
+    bool raised = r.alarm > before;
+    if (raised) {
+        ESP_LOGW(TAG, "Pressure alarm %s: %ld Pa over 3 h - sending now", pressure_trend_alarm_name(r.alarm),
+                 (long)r.change_pa_3h);
+    } else {
+        ESP_LOGI(TAG, "Pressure alarm down to %s: %ld Pa over 3 h", pressure_trend_alarm_name(r.alarm),
+                 (long)r.change_pa_3h);
+    }
+    return raised;
+}
+
+/**
+ * @brief Work the period and batch out again from the configured ones, the supply, the trend and the wind
+ *
+ * A duty-cycled node calls it on every wake. An awake node calls it every
+ * NODE_RATE_CHECK_MS from the transmit stage, which owns the trend, and
+ * moves the sampler's timers on a change. Each change is logged as one
+ * "Rate:" line of key=value pairs, for scripts to collect.
+ *
+ * @param measure_supply Read METRIC_VDD33_VOLTAGE now (the ADC stream's value while it runs); otherwise the
+ *        last reading stands, as on a fast duty-cycle wake
+ */
+static void rate_update(bool measure_supply) {
+    bool duty = NODE_DEEP_SLEEP_PERIOD_S != 0;
+    if (NODE_ADAPTIVE_RATE == 0 || NODE_BSEC != 0) {
+        rate.interval_ms = settings.sample_ms;
+        rate.batch = settings.batch_samples;
+        return;
+    }
+    if (rate.interval_ms == 0) {
+        sample_rate_init(&rate);
+    }
+
+    sample_rate_inputs_t in = { .supply_mv = SAMPLE_RATE_UNKNOWN };
+    metric_value_t supply;
+    if (measure_supply && get_metric_value(METRIC_VDD33_VOLTAGE, &supply) == METRIC_OK &&
+        supply.type == METRIC_VALUE_FLOAT && supply.f > 0.0f) {
+        in.supply_mv = (uint16_t)(supply.f * 1000.0f + 0.5f);
+    }
+    if (NODE_PRESSURE_TREND != 0) {
+        pressure_trend_reading_t r;
+        pressure_trend_get(&trend, &r);
+        in.have_trend = r.valid;
+        in.change_pa_3h = r.change_pa_3h;
+    }
+    if (NODE_WIND != 0 && !duty) {
+        wind_reading_t w;
+        wind_get(&w);
+        in.have_wind = w.running;
+        in.wind_avg = w.avg_2min;
+        in.wind_gust = w.gust;
+    }
+
+    // Batches are the duty cycle's; an awake node's frames fill on their own (espnow_batch.h)
+    sample_rate_limits_t limits = {
+        .min_ms = duty ? NODE_RATE_MIN_S * 1000 : NODE_RATE_AWAKE_MIN_MS,
+        .max_ms = duty ? NODE_RATE_MAX_S * 1000 : NODE_RATE_AWAKE_MAX_MS,
+        .step_ms = duty ? 1000 : 1,
+        .max_batch = duty ? ESPNOW_BATCH_MAX_RECORDS : 1,
+        .max_batch_ms = duty ? ESPNOW_OTA_GATHER_MS : 0,
+    };
+    if (!sample_rate_update(&rate, settings.sample_ms, duty ? settings.batch_samples : 1, &in, &limits)) {
+        return;
+    }
+
+    char weather[48] = "";
+    int n = 0;
+    if (in.have_trend) {
+        n = snprintf(weather, sizeof(weather), " trend_pa_3h=%ld", (long)in.change_pa_3h);
+    }
+    if (in.have_wind && n >= 0 && (size_t)n < sizeof(weather)) {
+        snprintf(weather + n, sizeof(weather) - n, " wind=%u gust=%u", in.wind_avg, in.wind_gust);
+    }
+    ESP_LOGI(TAG, "Rate: interval_ms=%lu batch=%u base_ms=%lu base_batch=%u charge=%d volatility=%d supply_mv=%d%s",
+             (unsigned long)rate.interval_ms, rate.batch, (unsigned long)settings.sample_ms, settings.batch_samples,
+             rate.charge_permille != SAMPLE_RATE_UNKNOWN ? rate.charge_permille : -1,
+             rate.volatility_permille != SAMPLE_RATE_UNKNOWN ? rate.volatility_permille : -1,
+             rate.supply_mv != SAMPLE_RATE_UNKNOWN ? rate.supply_mv : -1, weather);
+
+    if (!duty && sampler_sensor_count() > 0) {
+        esp_err_t err = sensor_hal_set_interval(rate.interval_ms);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Sampling period not moved: %s", esp_err_to_name(err));
+        }
+    }
+}
+
+/**
+ * @brief Period in force: the adaptive one once worked out, else the configured one
+ */
+static uint32_t rate_interval_ms(void) {
+    return rate.interval_ms != 0 ? rate.interval_ms : settings.sample_ms;
+}
+
+/**
+ * @brief Duty-cycle batch in force, as rate_interval_ms()
+ */
+static uint8_t rate_batch(void) {
+    return rate.batch != 0 ? rate.batch : settings.batch_samples;
+}
+
+/**
+ * @brief Sampler idle hook: send a batch that reached its age deadline, resend unacknowledged frames
+ *        and replay the flash backlog into any room the ACKs made
+ */
+static uint32_t transmit_idle(void) {
+    uint32_t batch_ms = espnow_batch_poll();
+    uint32_t resend_ms = espnow_reliable_pump();
+    backlog_replay();
+    return batch_ms < resend_ms ? batch_ms : resend_ms;
+}
+
+/**
+ * @brief Telemetry node id: the low four bytes of the station MAC
+ */
+static uint32_t node_id(void) {
+    static uint32_t id = 0;
+    if (id == 0) {
+        uint8_t mac[6] = { 0 };
+        esp_read_mac(mac, ESP_MAC_WIFI_STA);
+        id = ((uint32_t)mac[2] << 24) | ((uint32_t)mac[3] << 16) | ((uint32_t)mac[4] << 8) | mac[5];
+    }
+    return id;
+}
+
+/**
+ * @brief Convert a BME680 reading to a telemetry record
+ */
+static void to_record(uint32_t seq, uint32_t time_s, const bme680_reading_t *reading, telemetry_record_t *rec) {
+    rec->seq = seq;
+    rec->time_s = time_s;
+    rec->temperature = reading->temperature;
+    rec->pressure = reading->pressure;
+    rec->humidity = reading->humidity;
+    rec->gas_resistance = reading->gas_resistance;
+    rec->heater_step = reading->heater_step;
+    rec->gas_valid = reading->gas_valid;
+    rec->heat_stable = reading->heat_stable;
+    rec->held = false;
+    rec->urgent = false;
+}
+
+/**
+ * @brief Start a frame, headed by the node's current awake share and rain; cut short in Long Range mode
+ */
+static void start_frame(telemetry_writer_t *w, uint8_t *frame, size_t cap, uint8_t flags) {
+    power_sleep_stats_t ps;
+    power_profile_get_sleep_stats(&ps);
+    if ((settings.flags & NODE_SETTINGS_LR) && cap > ESPNOW_BATCH_LR_PAYLOAD) {
+        cap = ESPNOW_BATCH_LR_PAYLOAD;
+    }
+    telemetry_writer_init(w, frame, cap, node_id(), flags);
+    telemetry_writer_set_power(w, ps.awake_bp, ps.wake_ms);
+    add_extensions(w);
+}
+
+/**
+ * @brief Start a frame for stored samples: a duty-cycle batch or the flash backlog, packed with NODE_PACKED_BACKLOG
+ */
+static void start_backlog_frame(telemetry_writer_t *w, uint8_t *frame, size_t cap, uint8_t flags) {
+    start_frame(w, frame, cap, flags);
+    if (NODE_PACKED_BACKLOG != 0) {
+        telemetry_writer_set_packed(w);
+    }
+}
+
+/**
+ * @brief Add the rain, config and health extensions to a frame with no records yet; also the espnow_batch frame hook
+ *
+ * The config version confirms pushed settings to the gateway; a node that never got any sends none.
+ * The health extension gives the gateway's fleet view the supply and what the node has yet to deliver.
+ * The key extension, only during a key rotation, agrees the switch seq with the gateway (espnow_rekey.h).
+ * TELEMETRY_FLAG_LR has the gateway answer in Long Range mode.
+ */
+static void add_extensions(telemetry_writer_t *w) {
+    if (settings.flags & NODE_SETTINGS_LR) {
+        telemetry_writer_set_lr(w);
+    }
+    if (NODE_RAIN != 0) {
+        rain_gauge_reading_t r;
+        rain_gauge_get(&r);
+        telemetry_writer_set_rain(w, r.tips, r.rate);
+    }
+    if (settings.version != 0) {
+        telemetry_writer_set_config(w, settings.version);
+    }
+
+    uint8_t id;
+    adc_stream_value_t v;
+    uint16_t supply_mv = TELEMETRY_HEALTH_UNKNOWN;
+    if (adc_stream_find(ADC_STREAM_VDD_CHANNEL, &id) && adc_stream_get(id, &v) && v.mv >= 0) {
+        supply_mv = (uint16_t)v.mv;
+    }
+    uint32_t backlog = (backlog_ready ? flash_backlog_unsent() : 0) + rtc_batch.count;
+    telemetry_writer_set_health(w, supply_mv, backlog);
+
+    uint32_t fingerprint;
+    uint32_t switch_seq;
+    if (link_ready && espnow_rekey_node_report(&fingerprint, &switch_seq)) {
+        telemetry_writer_set_key(w, fingerprint, switch_seq);
+    }
+}
+
+/**
+ * @brief Hand one encoded frame to the reliable layer
+ *
+ * @param urgent In the alarm lane, ahead of the backlog
+ * @return esp_err_t ESP_OK once the frame is held until the gateway acknowledges it (even if this
+ *         first send went unheard), or ESP_ERR_NO_MEM if the window is full
+ */
+static esp_err_t send_frame(const telemetry_writer_t *w, bool urgent) {
+    if (!link_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = urgent ? espnow_reliable_send_urgent(w->buf, w->len, NULL)
+                           : espnow_reliable_send(w->buf, w->len, NULL);
+    ESP_LOGD(TAG, "Telemetry frame: seq %lu, %u records, %u bytes: %s", (unsigned long)w->base_seq, w->count,
+             (unsigned)w->len, esp_err_to_name(err));
+    return err == ESP_ERR_NO_MEM || err == ESP_ERR_INVALID_STATE || err == ESP_ERR_INVALID_SIZE ? err : ESP_OK;
+}
+
+/**
+ * @brief Move records paged out to flash back into the reliable window, oldest first
+ *
+ * The window only empties as ACKs arrive, so the backlog drains at the pace
+ * the gateway acknowledges it and stays put while the gateway is away. An
+ * empty window means everything handed over so far was delivered, and the
+ * flash tail moves past it. Called from one task at a time (the sampler
+ * transmit task, or the main task when duty cycling), so the buffers are static.
+ */
+static void backlog_replay(void) {
+    static telemetry_record_t records[NODE_REPLAY_RECORDS];
+    static uint8_t frame[ESPNOW_RELIABLE_MAX_PAYLOAD];
+    if (!backlog_ready) {
+        return;
+    }
+    if (espnow_reliable_backlog() == 0) {
+        flash_backlog_commit();
+    }
+
+    while (espnow_reliable_backlog() < ESPNOW_RELIABLE_BULK_WINDOW) {
+        size_t n = flash_backlog_peek(records, NULL, NODE_REPLAY_RECORDS);
+        if (n == 0) {
+            break;
+        }
+        telemetry_writer_t w;
+        start_backlog_frame(&w, frame, sizeof(frame), 0);
+        for (size_t i = 0; i < n && telemetry_writer_add(&w, &records[i]) == ESP_OK; i++) {
+        }
+        if (send_frame(&w, false) != ESP_OK) {
+            break;
+        }
+        flash_backlog_advance(w.count);
+    }
+}
+
+/**
+ * @brief Add a sample to the RTC ring, overwriting the oldest when full
+ */
+static void rtc_batch_append(const bme680_reading_t *reading, uint32_t time_s, bool held, bool urgent) {
+    node_rtc_sample_t *slot = &rtc_batch.samples[rtc_batch.head];
+    slot->seq = ++rtc_batch.seq;
+    slot->time_s = time_s;
+    slot->reading = *reading;
+    slot->held = held;
+    slot->urgent = urgent;
+    rtc_batch.head = (rtc_batch.head + 1) % NODE_RTC_BUFFER_LEN;
+    if (rtc_batch.count < NODE_RTC_BUFFER_LEN) {
+        rtc_batch.count++;
+    } else {
+        rtc_batch.overwritten++;
+    }
+}
+
+/**
+ * @brief Page the whole RTC ring out to the flash backlog, in one write
+ */
+static void rtc_batch_page_out(void) {
+    uint8_t oldest = (rtc_batch.head + NODE_RTC_BUFFER_LEN - rtc_batch.count) % NODE_RTC_BUFFER_LEN;
+    uint8_t stored = 0;
+    while (stored < rtc_batch.count) {
+        const node_rtc_sample_t *sample = &rtc_batch.samples[(oldest + stored) % NODE_RTC_BUFFER_LEN];
+        telemetry_record_t rec;
+        to_record(sample->seq, sample->time_s, &sample->reading, &rec);
+        rec.held = sample->held;
+        if (flash_backlog_push(node_id(), &rec) != ESP_OK) {
+            break;
+        }
+        stored++;
+    }
+    esp_err_t err = flash_backlog_flush();      // RAM does not survive deep sleep
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Flash backlog write failed: %s", esp_err_to_name(err));
+    }
+    ESP_LOGI(TAG, "Paged %u samples out to flash", stored);
+    rtc_batch.count -= stored;
+}
+
+/**
+ * @brief Hand the buffered samples, oldest first, to the reliable layer
+ *
+ * @param urgent In the alarm lane, ahead of the flash backlog
+ * @return Samples taken, counted from the oldest
+ */
+static uint8_t rtc_batch_take(bool urgent) {
+    uint8_t oldest = (rtc_batch.head + NODE_RTC_BUFFER_LEN - rtc_batch.count) % NODE_RTC_BUFFER_LEN;
+    uint8_t flags = rtc_batch.overwritten > 0 ? TELEMETRY_FLAG_SAMPLES_LOST : 0;
+    uint8_t frame[ESPNOW_RELIABLE_MAX_PAYLOAD];
+    telemetry_writer_t w;
+    uint8_t taken = 0;
+
+    // One frame normally; split only after a backlog or a clock step breaks the time deltas
+    esp_err_t err = ESP_OK;
+    start_backlog_frame(&w, frame, sizeof(frame), flags);
+    for (uint8_t i = 0; i < rtc_batch.count && err == ESP_OK; i++) {
+        const node_rtc_sample_t *sample = &rtc_batch.samples[(oldest + i) % NODE_RTC_BUFFER_LEN];
+        telemetry_record_t rec;
+        log_reading(sample->seq, &sample->reading);
+        to_record(sample->seq, sample->time_s, &sample->reading, &rec);
+        rec.held = sample->held;
+        rec.urgent = sample->urgent;
+        if (telemetry_writer_add(&w, &rec) != ESP_OK) {
+            telemetry_writer_set_flags(&w, flags | TELEMETRY_FLAG_MORE);
+            err = send_frame(&w, urgent);
+            if (err != ESP_OK) {
+                break;
+            }
+            taken += w.count;
+            start_backlog_frame(&w, frame, sizeof(frame), 0);
+            telemetry_writer_add(&w, &rec);
+        }
+    }
+    if (err == ESP_OK && w.count > 0 && send_frame(&w, urgent) == ESP_OK) {
+        taken += w.count;
+    }
+    return taken;
+}
+
+/**
+ * @brief Move the buffered samples into the reliable window and wait briefly for the gateway's ACKs
+ *
+ * Frames left from earlier wakes go first, then the flash backlog, then
+ * the ring; after a pressure alarm the ring goes first, in the reliable
+ * layer's alarm lane. Samples the window cannot take stay in the ring for the next
+ * wake, and are paged out to flash before another batch would overwrite
+ * them; frames not yet acknowledged stay in the window, which is also kept
+ * in RTC memory.
+ */
+static void rtc_batch_send(void) {
+    if (!link_ready) {
+        ESP_LOGW(TAG, "No link - %u samples kept for the next wake", rtc_batch.count);
+        return;
+    }
+    uint32_t in_flash = backlog_ready ? flash_backlog_unsent() : 0;
+    if (trend_alert && rtc_batch.count > 0) {
+        ESP_LOGI(TAG, "Sending alarm batch of %u samples ahead of %lu in flash", rtc_batch.count,
+                 (unsigned long)in_flash);
+        uint8_t taken = rtc_batch_take(true);
+        rtc_batch.count -= taken;
+        if (taken > 0) {
+            rtc_batch.overwritten = 0;
+        }
+    }
+    espnow_reliable_pump();
+    backlog_replay();
+
+    in_flash = backlog_ready ? flash_backlog_unsent() : 0;
+    if (in_flash == 0 && rtc_batch.count > 0) {
+        ESP_LOGI(TAG, "Sending batch of %u samples (%lu overwritten)", rtc_batch.count,
+                 (unsigned long)rtc_batch.overwritten);
+        uint8_t taken = rtc_batch_take(false);
+        rtc_batch.count -= taken;
+        if (taken > 0) {
+            rtc_batch.overwritten = 0;          // Reported in the first frame
+        }
+    }
+    if (rtc_batch.count > 0) {
+        ESP_LOGW(TAG, "Delivery window full - %u samples kept, %lu more in flash", rtc_batch.count,
+                 (unsigned long)in_flash);
+    }
+    if (backlog_ready && rtc_batch.count + rate_batch() > NODE_RTC_BUFFER_LEN) {
+        rtc_batch_page_out();
+    }
+
+    // A silent gateway costs one flush: the frames go to the next one in the same wake
+    esp_err_t err = espnow_reliable_flush(NODE_ACK_WAIT_MS);
+    if (gateway_failover(err == ESP_OK) && err != ESP_OK) {
+        err = espnow_reliable_flush(NODE_ACK_WAIT_MS);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "%u frames not acknowledged yet - kept for the next wake", espnow_reliable_backlog());
+    } else if (backlog_ready) {
+        flash_backlog_commit();
+    }
+    log_power();
+}
+
+/**
+ * @brief Ask the gateway for new firmware, and take part in the offered session once it is close
+ *
+ * A duty-cycled node runs it when it woke early for it; an awake node when
+ * it starts before the next check. After an update the node restarts into
+ * the new image.
+ */
+static void ota_check(void) {
+    if (!link_ready) {
+        return;
+    }
+    espnow_ota_node_query(ESPNOW_OTA_QUERY_WAIT_MS);
+    uint32_t wake_ms = espnow_ota_node_wake_in_ms();
+    if (wake_ms == ESPNOW_OTA_NONE || wake_ms > (NODE_DEEP_SLEEP_PERIOD_S != 0 ? 0 : NODE_MAIN_INTERVAL_MS)) {
+        return;
+    }
+
+    esp_err_t err = espnow_ota_node_run();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Firmware update failed: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "Firmware updated - restarting");
+    node_cleanup();
+    esp_restart();
+}
+
+/**
+ * @brief Log the awake share and how long the wakes from deep sleep last
+ */
+static void log_power(void) {
+    power_sleep_stats_t ps;
+    power_profile_get_sleep_stats(&ps);
+    char hist[96];
+    int n = 0;
+    for (size_t i = 0; i < POWER_AWAKE_BUCKETS && n >= 0 && (size_t)n < sizeof(hist); i++) {
+        if (i < POWER_AWAKE_BUCKETS - 1) {
+            n += snprintf(hist + n, sizeof(hist) - n, " <=%u:%lu", power_awake_bucket_ms[i],
+                          (unsigned long)ps.awake_histogram[i]);
+        } else {
+            n += snprintf(hist + n, sizeof(hist) - n, " more:%lu", (unsigned long)ps.awake_histogram[i]);
+        }
+    }
+    ESP_LOGI(TAG, "Power: awake %u.%02u%%, %lu deep sleeps, %lu ms per wake; wake ms%s", ps.awake_bp / 100,
+             ps.awake_bp % 100, (unsigned long)ps.deep_sleeps, (unsigned long)ps.wake_ms, hist);
+}
+
+/**
+ * @brief Read the BME680 once into the RTC ring, unless it stayed within its deadbands
+ */
+static void take_rtc_sample(void) {
+    bme680_reading_t reading;
+    bool iaq_due = false;
+    if (bme680_ready && NODE_BSEC != 0) {
+        iaq_prepare(&bme680, &iaq_due);
+    }
+    if (bme680_ready && bme680_read(&bme680, &reading) == ESP_OK) {
+        boot_health_pass(BOOT_HEALTH_SENSOR);
+        if (iaq_due) {
+            iaq_process(&reading, NULL);
+        }
+        uint32_t time_s = espnow_time_now();
+        bool raised = trend_raised(time_s, reading.pressure);
+        if (raised) {
+            trend_alert = true;
+        }
+        bool held = false;
+        if (deadband_pass(&reading, time_s, raised, &held)) {
+            rtc_batch_append(&reading, time_s, held, raised);
+        }
+    } else {
+        ESP_LOGW(TAG, "Duty-cycle sample skipped - BME680 not readable");
+    }
+    sampled_this_boot = true;
+}
+
+/**
+ * @brief Log what the ULP buffered and move a crossed threshold past the last value
+ *
+ * Without the move, a supply that stays low would wake the node every ULP period.
+ * The summary stays in the log: its samples are raw ADC counts of the pin,
+ * and the gateway already gets the supply in mV in the health extension.
+ */
+static void report_ulp(void) {
+    if (!ulp_data_pending) {
+        return;
+    }
+    ulp_data_pending = false;
+
+    ulp_monitor_summary_t s;
+    ulp_monitor_drain(NULL, 0, &s);
+    ESP_LOGI(TAG, "ULP supply watch: %u samples, raw %u..%u, last %u%s", s.count, s.min, s.max, s.last,
+             s.reason == ULP_MONITOR_WAKE_THRESHOLD ? " - threshold crossed" : "");
+
+    rtc_batch.ulp_low = NODE_ULP_LOW_RAW;
+    rtc_batch.ulp_high = NODE_ULP_HIGH_RAW;
+    if (s.reason == ULP_MONITOR_WAKE_THRESHOLD && s.last < NODE_ULP_LOW_RAW) {
+        rtc_batch.ulp_low = s.last > NODE_ULP_HYSTERESIS_RAW ? s.last - NODE_ULP_HYSTERESIS_RAW : 0;
+    } else if (s.reason == ULP_MONITOR_WAKE_THRESHOLD) {
+        rtc_batch.ulp_high = s.last + NODE_ULP_HYSTERESIS_RAW;
+    }
+}
+
+/**
+ * @brief Keep the ULP watching through the next sleep, starting it if it is not already running
+ */
+static void arm_ulp(void) {
+    if (!ulp_monitor_running()) {
+        if (rtc_batch.ulp_low == 0 && rtc_batch.ulp_high == 0) {
+            rtc_batch.ulp_low = NODE_ULP_LOW_RAW;
+            rtc_batch.ulp_high = NODE_ULP_HIGH_RAW;
+        }
+        system_metrics_release_adc();           // The ULP needs ADC1 to itself
+        esp_err_t err = ulp_monitor_start(rtc_batch.ulp_low, rtc_batch.ulp_high);
+        if (err != ESP_OK) {
+            if (err != ESP_ERR_NOT_SUPPORTED) {
+                ESP_LOGW(TAG, "ULP supply watch not started: %s", esp_err_to_name(err));
+            }
+            return;
+        }
+    }
+    esp_sleep_enable_ulp_wakeup();
+}
+
+/**
+ * @brief Deep-sleep until the next sample is due, a rain tip, or the config button is pressed (not on the C3)
+ *
+ * The period counts from this boot's start, so time spent awake does not
+ * push later samples back. A tip wake sleeps on to the time already due.
+ * Once the clock is synced the wake is moved to the node's transmit slot
+ * (or the open period without one), at most a cycle later. With NODE_BSEC
+ * the wake is when BSEC wants its next sample instead, which it does not
+ * take late, so the slot only times the send.
+ */
+static void enter_deep_sleep(void) {
+    int64_t awake_us = esp_timer_get_time();
+    int64_t sleep_us = (int64_t)rate_interval_ms() * 1000 - awake_us;
+    int64_t iaq_at_us = NODE_BSEC != 0 ? iaq_next_us() : 0;
+    if (iaq_at_us != 0) {
+        sleep_us = iaq_at_us - (int64_t)esp_clk_rtc_time();
+    }
+    if (tip_wake) {
+        sleep_us = (int64_t)(rtc_batch.due_us - esp_clk_rtc_time());
+    }
+    if (sleep_us < NODE_DEEP_SLEEP_MIN_US) {
+        sleep_us = NODE_DEEP_SLEEP_MIN_US;
+    }
+    if (!tip_wake && link_ready && iaq_at_us == 0) {
+        int64_t now_us = espnow_time_now_us();
+        int64_t at_us = espnow_slot_node_next_us(now_us + sleep_us);
+        if (at_us != 0) {
+            sleep_us = at_us - (int64_t)ESPNOW_SLOT_LEAD_MS * 1000 - now_us;
+            if (sleep_us < NODE_DEEP_SLEEP_MIN_US) {
+                sleep_us = NODE_DEEP_SLEEP_MIN_US;
+            }
+        }
+    }
+
+    rtc_batch.active = true;
+    iaq_suspend();
+    if (NODE_RAIN != 0) {
+        rain_gauge_arm_sleep();
+    }
+    arm_ulp();
+    rtc_batch.due_us = esp_clk_rtc_time() + (uint64_t)sleep_us;
+
+    // A firmware session wakes the node early; due_us keeps the sample time
+    uint32_t ota_ms = espnow_ota_node_wake_in_ms();
+    if (ota_ms != ESPNOW_OTA_NONE && (int64_t)ota_ms * 1000 < sleep_us) {
+        sleep_us = (int64_t)ota_ms * 1000 > NODE_DEEP_SLEEP_MIN_US ? (int64_t)ota_ms * 1000 : NODE_DEEP_SLEEP_MIN_US;
+    }
+    esp_sleep_enable_timer_wakeup((uint64_t)sleep_us);
+#if SOC_PM_SUPPORT_EXT0_WAKEUP
+    esp_sleep_enable_ext0_wakeup(NODE_CONFIG_BUTTON_GPIO, 0);
+#endif
+    ESP_LOGI(TAG, "Awake %lu ms, %u/%u samples buffered - sleeping %lu ms", (unsigned long)(awake_us / 1000),
+             rtc_batch.count, rate_batch(), (unsigned long)(sleep_us / 1000));
+    boot_trace_t trace;
+    boot_trace_get(false, &trace);
+    if (trace.first_tx_us != 0) {
+        ESP_LOGI(TAG, "Wake to transmit %lu ms (radio up at %lu ms)", (unsigned long)(trace.first_tx_us / 1000),
+                 (unsigned long)(trace.radio_us / 1000));
+    }
+    esp_deep_sleep_start();
+}
+
+/**
+ * @brief Energy benchmark: one BME680 sample per cycle, a frame every NODE_BENCHMARK_BATCH samples
+ *
+ * Each frame is sent and waited on until the gateway acknowledges it, and
+ * that whole wait counts as radio time. Cycles keep a fixed period, so the
+ * light sleep between them is part of the measured charge, as it would be
+ * on a timer-sampled node.
+ */
+static void run_benchmark(void) {
+    esp_err_t err = energy_bench_init();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No INA219 (%s) - benchmark runs without charge", esp_err_to_name(err));
+    }
+    ESP_LOGI(TAG, "Energy benchmark: %d cycles of %d ms, %d samples per frame", NODE_BENCHMARK_CYCLES,
+             NODE_BENCHMARK_PERIOD_MS, NODE_BENCHMARK_BATCH);
+
+    uint8_t frame[ESPNOW_RELIABLE_MAX_PAYLOAD];
+    telemetry_writer_t w;
+    uint32_t seq = 0;
+    uint32_t unacked = 0;
+    start_frame(&w, frame, sizeof(frame), 0);
+    energy_bench_begin();
+    TickType_t wake = xTaskGetTickCount();
+    for (uint32_t cycle = 0; cycle < NODE_BENCHMARK_CYCLES; cycle++) {
+        uint32_t taken = 0;
+        uint32_t radio_us = 0;
+        bme680_reading_t reading;
+        if (bme680_ready && bme680_read(&bme680, &reading) == ESP_OK) {
+            telemetry_record_t rec;
+            to_record(++seq, espnow_time_now(), &reading, &rec);
+            taken = telemetry_writer_add(&w, &rec) == ESP_OK ? 1 : 0;
+        }
+        if (w.count > 0 && (w.count >= NODE_BENCHMARK_BATCH || cycle + 1 == NODE_BENCHMARK_CYCLES)) {
+            int64_t start_us = esp_timer_get_time();
+            if (send_frame(&w, false) == ESP_OK && espnow_reliable_flush(NODE_ACK_WAIT_MS) != ESP_OK) {
+                unacked++;
+            }
+            radio_us = (uint32_t)(esp_timer_get_time() - start_us);
+            start_frame(&w, frame, sizeof(frame), 0);
+        }
+        energy_bench_add(taken, radio_us);
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(NODE_BENCHMARK_PERIOD_MS));
+    }
+    energy_bench_end();
+    benchmarked = true;
+
+    if (unacked > 0) {
+        ESP_LOGW(TAG, "Benchmark: %lu frames not acknowledged in time", (unsigned long)unacked);
+    }
+    energy_bench_log();
+}
+
+/**
+ * @brief Listen for a time beacon when the clock is due one
+ */
+static void node_time_sync(void) {
+    if (espnow_time_node_sync(ESPNOW_TIME_LISTEN_MS) != ESP_OK) {
+        ESP_LOGW(TAG, "No time beacon from the gateway - the clock runs on its drift estimate");
+    }
+}
+
+/**
+ * @brief Report a transmit cycle to espnow_failover, and move every ESP-NOW user to the gateway it picks
+ *
+ * @return bool Whether the node moved
+ */
+static bool gateway_failover(bool delivered) {
+    uint8_t next[6];
+    if (!espnow_failover_report(delivered, next)) {
+        return false;
+    }
+    esp_err_t err = espnow_link_add_peer(next);
+    if (err == ESP_OK) {
+        err = espnow_reliable_sender_retarget(next);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot move to gateway " MACSTR ": %s", MAC2STR(next), esp_err_to_name(err));
+        return false;
+    }
+    memcpy(gateway_mac, next, sizeof(gateway_mac));
+    apply_long_range();
+    espnow_ota_node_init(gateway_mac);
+    espnow_time_node_init(gateway_mac);
+    espnow_slot_node_init(gateway_mac);
+    espnow_channel_node_init(gateway_mac);
+    espnow_rekey_node_init(gateway_mac);
+    if (relaying) {
+        espnow_relay_node_retarget(gateway_mac);
+    }
+    return true;
+}
+
+/**
+ * @brief Settle the settings in force: the pushed ones, with the build defaults for any left at 0
+ *
+ * A duty-cycled node samples on whole seconds, and keeps a batch within
+ * ESPNOW_OTA_GATHER_MS, as the build defaults are, so it still asks for
+ * firmware while a session gathers. With NODE_BSEC the period is BSEC's
+ * rate whatever was pushed, and BSEC sets the heater (iaq.h).
+ */
+static void settings_resolve(const node_settings_t *pushed) {
+    node_settings_t s = *pushed;
+    if (NODE_DEEP_SLEEP_PERIOD_S != 0) {
+        s.sample_ms = s.sample_ms != 0 ? (s.sample_ms + 500) / 1000 * 1000 : NODE_DEEP_SLEEP_PERIOD_S * 1000;
+        if (s.sample_ms < 1000) {
+            s.sample_ms = 1000;
+        } else if (s.sample_ms >= ESPNOW_OTA_GATHER_MS) {
+            s.sample_ms = ESPNOW_OTA_GATHER_MS - 1000;
+        }
+    } else if (s.sample_ms == 0) {
+        s.sample_ms = NODE_BME680_INTERVAL_MS;
+    }
+    if (NODE_BSEC != 0) {
+        s.sample_ms = NODE_DEEP_SLEEP_PERIOD_S != 0 ? IAQ_ULP_PERIOD_MS : IAQ_LP_PERIOD_MS;   // BSEC's rates only
+    }
+    if (s.batch_samples == 0 || s.batch_samples > ESPNOW_BATCH_MAX_RECORDS) {
+        s.batch_samples = NODE_BATCH_SAMPLES;
+    }
+    while (NODE_DEEP_SLEEP_PERIOD_S != 0 && s.batch_samples > 1 &&
+           (uint64_t)s.sample_ms * s.batch_samples >= ESPNOW_OTA_GATHER_MS) {
+        s.batch_samples--;
+    }
+    if (s.heater_temp_c == 0) {
+        s.heater_temp_c = NODE_BME680_HEATER_TEMP_C;
+    }
+    if (s.heater_ms == 0) {
+        s.heater_ms = NODE_BME680_HEATER_MS;
+    }
+    if (NODE_ESPNOW_LR != 0) {
+        s.flags |= NODE_SETTINGS_LR;
+    }
+    settings = s;
+}
+
+/**
+ * @brief Send to the gateway in Long Range mode or not, as the settings say, with frames sized to match
+ */
+static void apply_long_range(void) {
+    bool lr = (settings.flags & NODE_SETTINGS_LR) != 0;
+    espnow_batch_set_long_range(lr);
+    esp_err_t err = link_ready ? espnow_link_peer_set_lr(gateway_mac, lr) : ESP_OK;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Gateway link stays at the normal rates: %s", esp_err_to_name(err));
+    }
+}
+
+/**
+ * @brief Store the settings the gateway pushed on its ACKs (espnow_config.h), and run them
+ *
+ * A duty-cycled node runs them from its next sleep on. An awake node sets
+ * up its sampler and heater once, so it restarts for a new period or
+ * heater. A store that fails is tried again with the next ACK.
+ */
+static void config_apply(void) {
+    node_settings_t pushed;
+    if (!link_ready || !espnow_config_node_take(&pushed)) {
+        return;
+    }
+    device_config_t cfg;
+    esp_err_t err = nvs_config_get(&cfg);
+    if (err == ESP_OK) {
+        cfg.node_settings = pushed;
+        err = nvs_store_config(&cfg);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Config v%u from the gateway not stored: %s", pushed.version, esp_err_to_name(err));
+        return;
+    }
+    espnow_config_node_applied(pushed.version);
+
+    node_settings_t before = settings;
+    settings_resolve(&pushed);
+    if (settings.flags != before.flags) {
+        apply_long_range();
+    }
+    ESP_LOGI(TAG, "Config v%u from the gateway: sample every %lu ms, batches of %u, heater %u degC for %u ms",
+             settings.version, (unsigned long)settings.sample_ms, settings.batch_samples, settings.heater_temp_c,
+             settings.heater_ms);
+    if (NODE_DEEP_SLEEP_PERIOD_S == 0 &&
+        (settings.sample_ms != before.sample_ms || settings.heater_temp_c != before.heater_temp_c ||
+         settings.heater_ms != before.heater_ms)) {
+        ESP_LOGI(TAG, "Restarting to sample with it");
+        node_cleanup();
+        esp_restart();
+    }
+}
+
+void node_duty_cycle_wake(void) {
+    if (NODE_DEEP_SLEEP_PERIOD_S == 0 || NODE_BENCHMARK_CYCLES != 0 || !rtc_batch.active) {
+        return;
+    }
+
+    // A tip is counted and the node sleeps on, unless the sample fell due meanwhile
+    ulp_data_pending = ulp_monitor_running();
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    if (NODE_RAIN != 0 && rain_gauge_woke()) {
+        rain_gauge_count_wake();
+        if (esp_clk_rtc_time() + NODE_DEEP_SLEEP_MIN_US < rtc_batch.due_us) {
+            tip_wake = true;
+            enter_deep_sleep();
+        }
+        cause = ESP_SLEEP_WAKEUP_TIMER;
+    }
+
+    // A ULP or button wake goes straight to the full boot, which needs ADC1 back
+    if (cause != ESP_SLEEP_WAKEUP_TIMER) {
+        ulp_monitor_stop();
+        return;
+    }
+
+    // Sensor and bus only: calibration comes from RTC memory, so this is a few ms of I2C
+    if (settings.sample_ms == 0) {
+        settings_resolve(&(node_settings_t){ 0 });      // RTC memory of an older image
+    }
+    if (sensors_start() == ESP_OK) {
+        take_rtc_sample();
+        sensors_stop();
+    }
+    rate_update(false);
+    bool ota_due = espnow_ota_node_wake_in_ms() == 0;
+    if (rtc_batch.count < rate_batch() && !trend_alert && !ota_due) {
+        enter_deep_sleep();
+    }
+    ulp_monitor_stop();
+    if (ota_due) {
+        ESP_LOGI(TAG, "Firmware session due - full boot");
+    } else if (trend_alert) {
+        ESP_LOGI(TAG, "Pressure alarm - full boot to send %u samples now", rtc_batch.count);
+    } else {
+        ESP_LOGI(TAG, "Batch of %u samples due - full boot", rtc_batch.count);
+    }
+}
+
+void node_sleep_if_duty_cycled(void) {
+    if (NODE_DEEP_SLEEP_PERIOD_S == 0 || benchmarked) {
+        return;
+    }
+
+    // The radio is up anyway; stay for a time beacon when the clock is due one. With a slot
+    // that waits until after the batch, so the send stays inside it.
+    espnow_slot_stats_t ss;
+    espnow_slot_get_stats(&ss);
+    if (link_ready && ss.assigned == 0) {
+        node_time_sync();
+    }
+    if (!sampled_this_boot) {
+        take_rtc_sample();                      // First boot, or any boot not started by the sleep timer
+    }
+    if (link_ready) {
+        espnow_slot_node_wait();
+    }
+    rtc_batch_send();
+    if (link_ready) {
+        if (ss.assigned != 0) {
+            node_time_sync();
+        }
+        if (espnow_slot_node_due() && espnow_slot_node_request(ESPNOW_SLOT_REQUEST_WAIT_MS) == ESP_ERR_TIMEOUT) {
+            ESP_LOGW(TAG, "No transmit slot from the gateway - asking again on the next send");
+        }
+        espnow_reliable_tx_stats_t rs;
+        espnow_reliable_get_tx_stats(&rs);
+        if (rs.acked > 0) {
+            boot_health_pass(BOOT_HEALTH_PEER);
+        }
+    }
+    if (link_ready) {
+        espnow_channel_node_settle();
+    }
+    config_apply();
+    rate_update(true);
+    boot_health_settle();                       // A new image must be confirmed before the first sleep
+    ota_check();
+    report_ulp();
+    iaq_save();                                 // With the radio boot, not every wake
+    if (NODE_RAIN != 0) {
+        rain_gauge_log();
+    }
+    sensors_stop();
+    enter_deep_sleep();
+}
+
 esp_err_t node_init(void) {
     ESP_LOGI(TAG, "Initializing node mode...");
 
-    // TODO: Initialize sensors (BME680, etc.)
-    // TODO: Initialize ESP-NOW for sending data to gateway
-    // TODO: Set up data collection timers
-    // TODO: Configure power management for battery operation
+    device_config_t cfg;
+    if (nvs_config_get(&cfg) != ESP_OK) {
+        nvs_config_set_defaults(&cfg);
+    }
+    settings_resolve(&cfg.node_settings);
+    bme680_profile = cfg.bme680_profile;
+    const bme680_profile_info_t *profile = bme680_profile_info((bme680_profile_t)bme680_profile);
+    if (profile != NULL) {
+        ESP_LOGI(TAG, "BME680 %s profile: %lu us per conversion, noise %u.%03u degC / %u.%02u Pa / %u.%03u %%RH RMS%s",
+                 profile->name, (unsigned long)profile->duration_us, profile->noise_temperature / 1000,
+                 profile->noise_temperature % 1000, profile->noise_pressure / 100, profile->noise_pressure % 100,
+                 profile->noise_humidity / 1000, profile->noise_humidity % 1000,
+                 profile->step_samples > 1 ? ", filtered" : "");
+    }
+    esp_err_t err = sensors_start();
+    if (err != ESP_OK) {
+        return err;
+    }
+    link_start();
+
+    // A new image is confirmed once it has read the sensor and, with a gateway set, been acknowledged
+    boot_health_start(BOOT_HEALTH_SENSOR | (gateway_configured ? BOOT_HEALTH_PEER : 0));
+
+    // Tips are counted in both modes: by interrupt while awake, by EXT1 wake in deep sleep
+    if (NODE_RAIN != 0) {
+        err = rain_gauge_start();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Rain gauge unavailable: %s", esp_err_to_name(err));
+        }
+    }
+
+    if (NODE_BENCHMARK_CYCLES != 0) {
+        run_benchmark();
+        ESP_LOGI(TAG, "Node initialization completed (benchmark finished, sampling stopped)");
+        return ESP_OK;
+    }
+
+    // Duty-cycled nodes sample into RTC memory from node_sleep_if_duty_cycled() instead
+    if (NODE_DEEP_SLEEP_PERIOD_S != 0) {
+        if (NODE_WIND != 0) {
+            ESP_LOGW(TAG, "Wind needs an awake node; not started while duty cycling");
+        }
+        if (NODE_RELAY != 0) {
+            ESP_LOGW(TAG, "Relaying needs an awake node; not started while duty cycling");
+        }
+        ESP_LOGI(TAG, "Node initialization completed (deep sleep every %lu s, batches of %u, config v%u)",
+                 (unsigned long)(settings.sample_ms / 1000), settings.batch_samples, settings.version);
+        return ESP_OK;
+    }
+
+    if (NODE_RELAY != 0 && link_ready) {
+        err = espnow_relay_node_start(gateway_mac);
+        relaying = err == ESP_OK;
+        if (!relaying) {
+            ESP_LOGW(TAG, "Relay unavailable: %s", esp_err_to_name(err));
+        }
+    }
+
+    // Before the sensor HAL, which samples the supply from the stream
+    if (NODE_ADC_STREAM != 0) {
+        analog_start();
+    }
+
+    // Timer-driven sampling: reads and transmission run in separate tasks at a fixed rate
+    if (link_ready) {
+        deadband_init(&deadband);               // Seqs start over, so the first record must not claim a hold
+        espnow_batch_set_frame_hook(add_extensions);
+        batching = espnow_batch_init(node_id(), NODE_BATCH_MAX_AGE_MS) == ESP_OK;
+        sampler_set_idle(batching ? transmit_idle : NULL);
+    }
+    sample_rate_init(&rate);                    // The timers start at the configured period
+    err = sensor_hal_start(settings.sample_ms);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No sensor to sample: %s", esp_err_to_name(err));
+    }
+    if (sampler_sensor_count() > 0) {
+        err = sampler_start(transmit_sample);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start sampling: %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    if (NODE_WIND != 0) {
+        err = wind_start();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Wind unavailable: %s", esp_err_to_name(err));
+        }
+    }
+
+    // TODO: Initialize other sensors
 
     ESP_LOGI(TAG, "Node initialization completed");
     return ESP_OK;
 }
 
 void node_main(void) {
-    // TODO: Main node processing loop
-    // TODO: Collect sensor data at regular intervals
-    // TODO: Send data to gateway via ESP-NOW
-    // TODO: Handle sleep/wake cycles for power management
-    // TODO: Implement data buffering for when gateway is unavailable
+    for (uint8_t id = 0; id < sampler_sensor_count(); id++) {
+        sampler_stats_t st;
+        if (sampler_get_stats(id, &st) != ESP_OK) {
+            continue;
+        }
+        if (st.samples > st.failed) {
+            boot_health_pass(BOOT_HEALTH_SENSOR);
+        }
+        ESP_LOGI(TAG, "%s: %lu samples (%lu failed), jitter %ld..%ld us avg %lu, latency max %lu us, "
+                 "%lu overruns, %lu dropped", st.name, (unsigned long)st.samples, (unsigned long)st.failed,
+                 (long)st.jitter_min_us, (long)st.jitter_max_us, (unsigned long)st.jitter_mean_us,
+                 (unsigned long)st.latency_max_us, (unsigned long)st.overruns, (unsigned long)st.dropped);
+    }
+
+    i2c_bus_stats_t ib;
+    i2c_bus_get_stats(&ib);
+    for (uint8_t i = 0; i < ib.devices; i++) {
+        const i2c_bus_device_stats_t *d = &ib.device[i];
+        ESP_LOGI(TAG, "I2C %s: %lu transactions, %lu failed, %lu retries, %llu us on the bus", d->name,
+                 (unsigned long)d->transactions, (unsigned long)d->errors, (unsigned long)d->retries,
+                 (unsigned long long)d->bus_us);
+    }
+
+    adc_stream_stats_t as;
+    adc_stream_get_stats(&as);
+    if (as.running) {
+        ESP_LOGI(TAG, "ADC stream: %u channels, %lu frames, %lu dropped, longest read %lu us", as.channels,
+                 (unsigned long)as.frames, (unsigned long)as.overflows, (unsigned long)as.read_us_max);
+    }
 
-    ESP_LOGI(TAG, "Node mode activated - main processing loop started");
+    if (batching) {
+        espnow_batch_stats_t bs;
+        espnow_batch_get_stats(&bs);
+        ESP_LOGI(TAG, "ESP-NOW: %lu batches, %lu records, %llu bytes, %lu resends, %lu lost, target %u, %u%% delivered",
+                 (unsigned long)bs.batches, (unsigned long)bs.records, (unsigned long long)bs.bytes,
+                 (unsigned long)bs.retries, (unsigned long)bs.records_lost, bs.target, bs.delivery_percent);
+    }
+    uint32_t filtered = deadband.passed + deadband.suppressed;
+    if (NODE_DEADBAND != 0 && filtered > 0) {
+        ESP_LOGI(TAG, "Deadband: %lu readings sent, %lu held back (%lu%%)", (unsigned long)deadband.passed,
+                 (unsigned long)deadband.suppressed, (unsigned long)((uint64_t)deadband.suppressed * 100 / filtered));
+    }
+    if (link_ready) {
+        espnow_reliable_tx_stats_t rs;
+        espnow_reliable_get_tx_stats(&rs);
+        ESP_LOGI(TAG, "Delivery: %lu frames, %lu acknowledged, %lu resent, %lu refused (%lu on hold), %u waiting, "
+                 "rtt %lu ms", (unsigned long)rs.frames, (unsigned long)rs.acked, (unsigned long)rs.resends,
+                 (unsigned long)(rs.window_full + rs.held), (unsigned long)rs.held, rs.backlog,
+                 (unsigned long)rs.rtt_ms);
+        if (rs.acked > 0) {
+            boot_health_pass(BOOT_HEALTH_PEER);
+        }
 
-    // For now, just log that we're running
-    // In the full implementation, this would be the main event loop
+        // Awake node: a period with frames waiting and no ACK at all is a missed cycle
+        gateway_failover(rs.backlog == 0 || rs.acked != acked_before);
+        acked_before = rs.acked;
+        espnow_failover_stats_t fs;
+        espnow_failover_get_stats(&fs);
+        if (fs.gateways > 1) {
+            ESP_LOGI(TAG, "Gateways: %u known, sending to " MACSTR " (beacon RSSI %d, %u misses), %lu failovers, "
+                     "%lu moves to a better one", fs.gateways, MAC2STR(fs.mac), fs.rssi, fs.misses,
+                     (unsigned long)fs.failovers, (unsigned long)fs.upgrades);
+        }
+    }
+    if (backlog_ready) {
+        flash_backlog_info_t fb;
+        flash_backlog_get_info(&fb);
+        ESP_LOGI(TAG, "Flash backlog: %lu queued (%lu unsent), %lu paged out, %lu replayed, %lu dropped",
+                 (unsigned long)fb.queued, (unsigned long)fb.unsent, (unsigned long)fb.stored,
+                 (unsigned long)fb.replayed, (unsigned long)fb.dropped);
+    }
+    if (link_ready) {
+        espnow_time_stats_t ts;
+        espnow_time_get_stats(&ts);
+        ESP_LOGI(TAG, "Clock: %s, %lu beacons heard, %lu syncs, offset %ld ms at the last, drift %ld ppm%s",
+                 ts.synced ? "synced" : "not synced", (unsigned long)ts.beacons, (unsigned long)ts.syncs,
+                 (long)ts.last_offset_ms, (long)ts.drift_ppm, ts.drift_known ? "" : " (not measured yet)");
+        espnow_channel_node_poll();
+        espnow_link_radio_t radio;
+        if (ESPNOW_LINK_ADAPT != 0 && espnow_link_peer_radio(gateway_mac, &radio) == ESP_OK) {
+            ESP_LOGI(TAG, "Radio to the gateway: %s at %d.%02d dBm, RSSI %d, margin %d dB", radio.rate,
+                     radio.power / 4, (radio.power % 4) * 25, radio.rssi, radio.margin_db);
+        }
+        espnow_slot_stats_t ss;
+        espnow_slot_get_stats(&ss);
+        if (ss.assigned != 0) {
+            ESP_LOGI(TAG, "Transmit slot %u of %d, %lu late wakes", ss.slot, ESPNOW_SLOT_COUNT,
+                     (unsigned long)ss.late);
+        }
+    }
+    if (relaying) {
+        espnow_relay_stats_t rl;
+        espnow_relay_get_stats(&rl);
+        ESP_LOGI(TAG, "Relay: %u nodes, %lu frames up, %lu ACKs down (%lu from the kept ACK), %lu resends "
+                 "suppressed, %lu dropped, %lu beacons", rl.routes, (unsigned long)rl.up, (unsigned long)rl.down,
+                 (unsigned long)rl.answered, (unsigned long)rl.suppressed, (unsigned long)rl.dropped,
+                 (unsigned long)rl.beacons);
+    }
+    if (!benchmarked) {
+        config_apply();
+        ota_check();
+    }
+    iaq_save();
+    wind_log();
+    if (NODE_RAIN != 0) {
+        rain_gauge_log();
+    }
+    log_power();
+    if (benchmarked) {
+        energy_bench_log();
+    }
 }
 
 esp_err_t node_cleanup(void) {
     ESP_LOGI(TAG, "Cleaning up node resources...");
 
-    // TODO: Stop sensor readings
-    // TODO: Clean up ESP-NOW resources
-    // TODO: Cancel timers
+    sampler_stop();
+    sensor_hal_stop();
+    iaq_stop();                                 // Sampling has stopped; the state goes to NVS for the restart
+    wind_stop();
+    adc_stream_stop();
+    rain_gauge_stop();
+    if (batching) {
+        espnow_batch_flush();                   // The transmit task has exited, so nothing else sends
+        batching = false;
+    }
+    if (link_ready && espnow_reliable_flush(NODE_ACK_WAIT_MS) != ESP_OK) {
+        ESP_LOGW(TAG, "%u frames unacknowledged - kept in RTC memory", espnow_reliable_backlog());
+    } else if (backlog_ready) {
+        flash_backlog_commit();
+    }
+    if (backlog_ready) {
+        flash_backlog_flush();
+    }
+    espnow_relay_node_stop();
+    relaying = false;
+    energy_bench_deinit();                      // Shares the I2C bus
+    sensors_stop();
+    espnow_link_deinit();
+    link_ready = false;
+    backlog_ready = false;
     // TODO: Free any allocated memory
 
     ESP_LOGI(TAG, "Node cleanup completed");
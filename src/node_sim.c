@@ -0,0 +1,270 @@
+/**
+ * @file node_sim.c
+ * @brief Many virtual nodes on one board, to soak the gateway's ingest pipeline
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "node_sim.h"
+#include "version.h"
+#include "espnow_channel.h"
+#include "espnow_link.h"
+#include "node.h"
+#include "nvs_utils.h"
+#include "telemetry.h"
+#include "wifi_ap.h"
+#include <string.h>
+#include <time.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register node_sim.c version
+REGISTER_VERSION(NodeSim, "1.0.0", "2026-10-15");
+
+static const char *TAG = "NODE_SIM";
+
+_Static_assert(NODE_SIM_NODES >= 1 && NODE_SIM_NODES <= NODE_SIM_MAX_NODES, "NODE_SIM_NODES out of range");
+
+/**
+ * @brief One virtual node
+ */
+typedef struct {
+    uint32_t node_id;
+    uint32_t seq;                               // Next record's
+    int64_t next_us;                            // When the next record is due
+    uint16_t held;                              // Records held back in an outage; 0 when online
+    uint32_t held_time_s;                       // Time of the first of them
+    uint32_t held_step_ms;                      // Period while they were held
+} sim_node_t;
+
+static sim_node_t nodes[NODE_SIM_NODES];
+static uint8_t gateway_mac[6];
+static uint8_t frame[TELEMETRY_FRAME_MAX];
+static node_sim_stats_t stats;
+static uint32_t interval_ms = NODE_SIM_INTERVAL_MS;
+static int64_t ramp_us = 0;                     // Next ramp step
+static int64_t log_us = 0;                      // Next stats line
+static node_sim_stats_t last_logged;            // Counters at the previous stats line
+
+// =============================
+// Function Prototypes
+// =============================
+static void make_record(const sim_node_t *n, uint32_t seq, uint32_t time_s, telemetry_record_t *rec);
+static void send_frame(const telemetry_writer_t *w);
+static void send_live(sim_node_t *n, uint32_t now_s);
+static void send_held(sim_node_t *n);
+static void step_node(sim_node_t *n, int64_t now_us);
+static void log_stats(int64_t now_us);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Plausible readings, a little different per node and per record
+ */
+static void make_record(const sim_node_t *n, uint32_t seq, uint32_t time_s, telemetry_record_t *rec) {
+    uint32_t index = n->node_id & 0xFF;
+    memset(rec, 0, sizeof(*rec));
+    rec->seq = seq;
+    rec->time_s = time_s;
+    rec->temperature = (int16_t)(1500 + index * 25 + (int32_t)(seq % 64) - 32);
+    rec->pressure = 101325 - index * 40 + (seq % 16) * 2;
+    rec->humidity = 45000 + index * 300 + (seq % 32) * 10;
+    rec->gas_resistance = 50000 + index * 1000;
+    rec->gas_valid = true;
+    rec->heat_stable = true;
+}
+
+static void send_frame(const telemetry_writer_t *w) {
+    esp_err_t err = espnow_link_send(gateway_mac, w->buf, w->len);
+    if (err == ESP_OK) {
+        stats.frames++;
+        stats.records += w->count;
+    } else {
+        stats.failed++;
+    }
+}
+
+/**
+ * @brief One record in its own frame, or a deliberate gap in the node's seqs
+ */
+static void send_live(sim_node_t *n, uint32_t now_s) {
+    uint32_t seq = n->seq++;
+    if (esp_random() % 1000 < NODE_SIM_LOSS_PERMILLE) {
+        stats.skipped++;
+        return;
+    }
+    telemetry_writer_t w;
+    telemetry_record_t rec;
+    telemetry_writer_init(&w, frame, sizeof(frame), n->node_id, 0);
+    telemetry_writer_set_health(&w, TELEMETRY_HEALTH_UNKNOWN, 0);
+    make_record(n, seq, now_s, &rec);
+    if (esp_random() % 1000 < NODE_SIM_ALARM_PERMILLE) {
+        rec.urgent = true;
+        stats.alarms++;
+    }
+    telemetry_writer_add(&w, &rec);
+    send_frame(&w);
+}
+
+/**
+ * @brief Replay an outage's records back to back, in as few packed frames as they fit
+ */
+static void send_held(sim_node_t *n) {
+    uint32_t first = n->seq - n->held;
+    uint32_t sent = 0;
+    while (sent < n->held) {
+        telemetry_writer_t w;
+        telemetry_writer_init(&w, frame, sizeof(frame), n->node_id, 0);
+        telemetry_writer_set_health(&w, TELEMETRY_HEALTH_UNKNOWN, n->held - sent);
+        telemetry_writer_set_packed(&w);
+        while (sent < n->held) {
+            telemetry_record_t rec;
+            make_record(n, first + sent, n->held_time_s + (uint32_t)((uint64_t)sent * n->held_step_ms / 1000),
+                        &rec);
+            if (telemetry_writer_add(&w, &rec) != ESP_OK) {
+                break;
+            }
+            sent++;
+        }
+        telemetry_writer_set_flags(&w, sent < n->held ? TELEMETRY_FLAG_MORE : 0);
+        send_frame(&w);
+    }
+    n->held = 0;
+    stats.replays++;
+}
+
+/**
+ * @brief A node's record is due: send it, hold it through an outage, or replay the outage
+ */
+static void step_node(sim_node_t *n, int64_t now_us) {
+    uint32_t now_s = (uint32_t)time(NULL);
+    if (n->held > 0) {
+        n->seq++;
+        if (++n->held >= NODE_SIM_OUTAGE_RECORDS) {
+            send_held(n);
+        }
+    } else if (esp_random() % 1000 < NODE_SIM_OUTAGE_PERMILLE) {
+        n->held = 1;
+        n->held_time_s = now_s;
+        n->held_step_ms = interval_ms;
+        n->seq++;
+    } else {
+        send_live(n, now_s);
+    }
+
+    // Up to a tenth either way, so the nodes do not stay in step
+    int64_t period_us = (int64_t)interval_ms * 1000;
+    int64_t jitter_us = (int64_t)(esp_random() % (uint32_t)(period_us / 5)) - period_us / 10;
+    n->next_us += period_us + jitter_us;
+    if (n->next_us < now_us - period_us) {
+        stats.late++;
+        n->next_us = now_us;
+    }
+}
+
+/**
+ * @brief One line per NODE_SIM_LOG_INTERVAL_MS: the load offered, what the gateway's radio took, and misses
+ */
+static void log_stats(int64_t now_us) {
+    uint32_t period_s = NODE_SIM_LOG_INTERVAL_MS / 1000;
+    uint32_t offered_mpps = (uint32_t)((uint64_t)NODE_SIM_NODES * 1000000 / interval_ms);
+    ESP_LOGI(TAG, "%u nodes every %lu ms (%lu.%03lu frames/s offered): %lu frames/s, %lu records/s delivered, "
+             "%lu failed, %lu skipped, %lu replays, %lu alarms, %lu late", (unsigned)NODE_SIM_NODES, (unsigned long)interval_ms,
+             (unsigned long)(offered_mpps / 1000), (unsigned long)(offered_mpps % 1000),
+             (unsigned long)((stats.frames - last_logged.frames) / period_s),
+             (unsigned long)((stats.records - last_logged.records) / period_s),
+             (unsigned long)(stats.failed - last_logged.failed), (unsigned long)(stats.skipped - last_logged.skipped),
+             (unsigned long)(stats.replays - last_logged.replays), (unsigned long)(stats.alarms - last_logged.alarms),
+             (unsigned long)(stats.late - last_logged.late));
+    last_logged = stats;
+    log_us = now_us + (int64_t)NODE_SIM_LOG_INTERVAL_MS * 1000;
+}
+
+esp_err_t node_sim_init(void) {
+    device_config_t cfg;
+    if (nvs_config_get(&cfg) != ESP_OK || espnow_link_parse_mac(cfg.server_mac, gateway_mac) != ESP_OK) {
+        ESP_LOGE(TAG, "No gateway MAC configured");
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = wifi_espnow_init(espnow_channel_node_home(NODE_ESPNOW_CHANNEL));
+    if (err == ESP_OK) {
+        err = espnow_link_init(NULL);
+    }
+    if (err == ESP_OK) {
+        err = espnow_link_add_peer(gateway_mac);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ESP-NOW link unavailable: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    uint8_t mac[6] = { 0 };
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    uint32_t base = ((uint32_t)mac[3] << 24) | ((uint32_t)mac[4] << 16) | ((uint32_t)mac[5] << 8);
+    int64_t now = esp_timer_get_time();
+    for (size_t i = 0; i < NODE_SIM_NODES; i++) {
+        nodes[i].node_id = base | (uint32_t)i;
+        // Spread evenly over the first period
+        nodes[i].next_us = now + (int64_t)NODE_SIM_INTERVAL_MS * 1000 * i / NODE_SIM_NODES;
+    }
+    memset(&stats, 0, sizeof(stats));
+    stats.nodes = NODE_SIM_NODES;
+    interval_ms = NODE_SIM_INTERVAL_MS;
+    ramp_us = now + (int64_t)NODE_SIM_RAMP_STEP_MS * 1000;
+    log_us = now + (int64_t)NODE_SIM_LOG_INTERVAL_MS * 1000;
+    ESP_LOGI(TAG, "Imitating %u nodes %08lx..%08lx for gateway %s, every %lu ms", (unsigned)NODE_SIM_NODES,
+             (unsigned long)nodes[0].node_id, (unsigned long)nodes[NODE_SIM_NODES - 1].node_id, cfg.server_mac,
+             (unsigned long)interval_ms);
+    return ESP_OK;
+}
+
+void node_sim_main(void) {
+    int64_t now = esp_timer_get_time();
+    int64_t due = log_us;
+    for (size_t i = 0; i < NODE_SIM_NODES; i++) {
+        if (nodes[i].next_us < due) {
+            due = nodes[i].next_us;
+        }
+    }
+    if (due > now) {
+        TickType_t ticks = pdMS_TO_TICKS((due - now) / 1000);
+        vTaskDelay(ticks > 0 ? ticks : 1);
+        now = esp_timer_get_time();
+    }
+
+    for (size_t i = 0; i < NODE_SIM_NODES; i++) {
+        if (nodes[i].next_us <= now) {
+            step_node(&nodes[i], now);
+        }
+    }
+    if (now >= log_us) {
+        log_stats(now);
+    }
+    if (NODE_SIM_RAMP_STEP_MS != 0 && now >= ramp_us && interval_ms > NODE_SIM_INTERVAL_MIN_MS) {
+        interval_ms -= interval_ms / 4;
+        if (interval_ms < NODE_SIM_INTERVAL_MIN_MS) {
+            interval_ms = NODE_SIM_INTERVAL_MIN_MS;
+        }
+        ramp_us = now + (int64_t)NODE_SIM_RAMP_STEP_MS * 1000;
+        ESP_LOGI(TAG, "Ramp: every %lu ms per node", (unsigned long)interval_ms);
+    }
+}
+
+void node_sim_get_stats(node_sim_stats_t *out) {
+    *out = stats;
+    out->interval_ms = interval_ms;
+}
@@ -0,0 +1,594 @@
+/**
+ * @file node_table.c
+ * @brief Gateway per-node state: last seq, RSSI, key epoch, link quality, health and latest reading, O(1) by MAC
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "node_table.h"
+#include "espnow_link.h"
+#include "espnow_time.h"
+#include "sensor_hal.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register node_table.c version
+REGISTER_VERSION(NodeTable, "1.0.0", "2026-10-15");
+
+static const char *TAG = "NODE_TABLE";
+
+_Static_assert((NODE_TABLE_CAPACITY & (NODE_TABLE_CAPACITY - 1)) == 0, "NODE_TABLE_CAPACITY must be a power of two");
+_Static_assert(NODE_TABLE_MAX_NODES < NODE_TABLE_CAPACITY, "the table needs free slots to end a probe");
+_Static_assert(SENSOR_QUANTITY_COUNT <= 8, "node sensors are a byte of quantity bits");
+_Static_assert(NODE_TABLE_SEQ_WINDOW == 64, "the seq window is one 64-bit map");
+_Static_assert(TELEMETRY_PACKED_MAX_RECORDS <= NODE_TABLE_SEQ_WINDOW, "a frame's seqs must fit the window");
+
+#define HASH_SHIFT (32 - __builtin_ctz(NODE_TABLE_CAPACITY))
+#define NO_SLOT 0xFF
+
+/**
+ * @brief The table, by field rather than by node
+ *
+ * A MAC is stored as a 48-bit integer, so a probe compares one word; 0 marks
+ * a free slot (no station has an all-zero MAC).
+ */
+typedef struct {
+    // Probed on every lookup
+    uint64_t key[NODE_TABLE_CAPACITY];
+    // Written on every frame
+    uint32_t last_seq[NODE_TABLE_CAPACITY];
+    uint32_t last_seen_ms[NODE_TABLE_CAPACITY];
+    int16_t rssi_x16[NODE_TABLE_CAPACITY];
+    uint16_t quality[NODE_TABLE_CAPACITY];      // Permille
+    uint32_t frames[NODE_TABLE_CAPACITY];
+    // Written per telemetry frame, or only read
+    uint64_t seen[NODE_TABLE_CAPACITY];         // Bit n: seq last_seq - n received
+    uint32_t node_id[NODE_TABLE_CAPACITY];
+    uint32_t records[NODE_TABLE_CAPACITY];
+    uint32_t lost[NODE_TABLE_CAPACITY];
+    uint32_t duplicates[NODE_TABLE_CAPACITY];
+    uint32_t late[NODE_TABLE_CAPACITY];
+    int32_t clock_lead_s[NODE_TABLE_CAPACITY];
+    uint16_t restarts[NODE_TABLE_CAPACITY];
+    uint16_t clock_faults[NODE_TABLE_CAPACITY];
+    uint16_t awake_bp[NODE_TABLE_CAPACITY];
+    uint16_t wake_ms[NODE_TABLE_CAPACITY];
+    uint32_t rain_tips[NODE_TABLE_CAPACITY];
+    uint16_t rain_raw[NODE_TABLE_CAPACITY];     // Last tip count as sent, 16 bits wrapping
+    uint16_t rain_rate[NODE_TABLE_CAPACITY];
+    uint16_t supply_mv[NODE_TABLE_CAPACITY];
+    uint16_t backlog[NODE_TABLE_CAPACITY];
+    // Latest reading, written per telemetry frame
+    uint32_t humidity[NODE_TABLE_CAPACITY];
+    uint32_t pressure[NODE_TABLE_CAPACITY];
+    uint32_t reading_s[NODE_TABLE_CAPACITY];
+    int16_t temperature[NODE_TABLE_CAPACITY];
+    bool have_reading[NODE_TABLE_CAPACITY];
+    uint8_t sensors[NODE_TABLE_CAPACITY];       // Bit per sensor_quantity_t
+    int8_t rssi_min[NODE_TABLE_CAPACITY];
+    bool have_seq[NODE_TABLE_CAPACITY];
+    bool lr[NODE_TABLE_CAPACITY];               // Its peer is set to Long Range mode, as its frames ask
+} node_columns_t;
+
+static node_columns_t table;
+static uint8_t order[NODE_TABLE_MAX_NODES];     // Slots in the order the nodes first reported
+static uint8_t node_count = 0;
+static uint32_t overflow = 0;                   // Frames from nodes the table had no room for
+static uint32_t generation = 0;                 // Bumped when any node's sensors gain a bit
+static portMUX_TYPE table_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static uint64_t mac_key(const uint8_t *mac);
+static uint8_t find_slot(uint64_t key, bool create);
+static uint64_t seq_bits(uint32_t width, uint32_t offset);
+static void copy_entry(uint8_t slot, node_table_entry_t *entry);
+static bool copy_nth(size_t n, node_table_entry_t *entry);
+static metric_error_t nodes_provider(char *buf, size_t buf_len);
+
+// =============================
+// Function Definitions
+// =============================
+
+static uint64_t mac_key(const uint8_t *mac) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < 6; i++) {
+        key = (key << 8) | mac[i];
+    }
+    return key;
+}
+
+/**
+ * @brief Slot of a node: multiplicative hash, then linear probing; call with table_lock held
+ *
+ * @param create Claim a free slot if the node is new and there is room
+ * @return Slot, or NO_SLOT
+ */
+static uint8_t find_slot(uint64_t key, bool create) {
+    uint32_t folded = (uint32_t)key ^ (uint32_t)(key >> 32);
+    uint32_t slot = (folded * 2654435761u) >> HASH_SHIFT;
+    for (;;) {
+        if (table.key[slot] == key) {
+            return (uint8_t)slot;
+        }
+        if (table.key[slot] == 0) {
+            break;                              // The load cap guarantees a free slot ends every probe
+        }
+        slot = (slot + 1) & (NODE_TABLE_CAPACITY - 1);
+    }
+    if (!create || node_count >= NODE_TABLE_MAX_NODES) {
+        return NO_SLOT;
+    }
+
+    table.key[slot] = key;
+    table.last_seq[slot] = 0;
+    table.last_seen_ms[slot] = 0;
+    table.rssi_x16[slot] = 0;
+    table.quality[slot] = 1000;
+    table.frames[slot] = 0;
+    table.node_id[slot] = 0;
+    table.records[slot] = 0;
+    table.lost[slot] = 0;
+    table.seen[slot] = 0;
+    table.duplicates[slot] = 0;
+    table.late[slot] = 0;
+    table.clock_lead_s[slot] = NODE_TABLE_LEAD_UNKNOWN;
+    table.restarts[slot] = 0;
+    table.clock_faults[slot] = 0;
+    table.awake_bp[slot] = NODE_TABLE_AWAKE_UNKNOWN;
+    table.wake_ms[slot] = 0;
+    table.rain_tips[slot] = 0;
+    table.rain_raw[slot] = 0;
+    table.rain_rate[slot] = NODE_TABLE_RAIN_UNKNOWN;
+    table.supply_mv[slot] = NODE_TABLE_HEALTH_UNKNOWN;
+    table.backlog[slot] = NODE_TABLE_HEALTH_UNKNOWN;
+    table.have_reading[slot] = false;
+    table.rssi_min[slot] = 0;
+    table.have_seq[slot] = false;
+    table.lr[slot] = false;
+    order[node_count++] = (uint8_t)slot;
+    return (uint8_t)slot;
+}
+
+/**
+ * @brief Window bits offset .. offset + width - 1: the seqs last_seq - offset down, width of them
+ */
+static uint64_t seq_bits(uint32_t width, uint32_t offset) {
+    uint64_t bits = width >= NODE_TABLE_SEQ_WINDOW ? UINT64_MAX : (1ULL << width) - 1;
+    return bits << offset;
+}
+
+static void copy_entry(uint8_t slot, node_table_entry_t *entry) {
+    uint64_t key = table.key[slot];
+    for (int i = 5; i >= 0; i--) {
+        entry->mac[i] = (uint8_t)key;
+        key >>= 8;
+    }
+    entry->node_id = table.node_id[slot];
+    entry->last_seq = table.last_seq[slot];
+    entry->last_seen_ms = table.last_seen_ms[slot];
+    entry->rssi_x16 = table.rssi_x16[slot];
+    entry->rssi_min = table.rssi_min[slot];
+    entry->quality_permille = table.quality[slot];
+    entry->frames = table.frames[slot];
+    entry->records = table.records[slot];
+    entry->lost = table.lost[slot];
+    entry->duplicates = table.duplicates[slot];
+    entry->late = table.late[slot];
+    uint64_t expected = (uint64_t)entry->records + entry->lost;
+    entry->completeness_permille = expected > 0 ? (uint16_t)(entry->records * 1000ULL / expected) : 1000;
+    entry->restarts = table.restarts[slot];
+    entry->clock_faults = table.clock_faults[slot];
+    entry->clock_lead_s = table.clock_lead_s[slot];
+    entry->awake_bp = table.awake_bp[slot];
+    entry->wake_ms = table.wake_ms[slot];
+    entry->rain_tips = table.rain_tips[slot];
+    entry->rain_rate = table.rain_rate[slot];
+    entry->supply_mv = table.supply_mv[slot];
+    entry->backlog = table.backlog[slot];
+    entry->lr = table.lr[slot];
+    entry->have_reading = table.have_reading[slot];
+    entry->temperature = table.temperature[slot];
+    entry->humidity = table.humidity[slot];
+    entry->pressure = table.pressure[slot];
+    entry->reading_s = table.reading_s[slot];
+    entry->sensors = table.sensors[slot];
+}
+
+/**
+ * @brief Copy the nth node without its key epoch, for a reader that does not need the link's mutex
+ */
+static bool copy_nth(size_t n, node_table_entry_t *entry) {
+    bool found = false;
+    portENTER_CRITICAL(&table_lock);
+    if (n < node_count) {
+        copy_entry(order[n], entry);
+        found = true;
+    }
+    portEXIT_CRITICAL(&table_lock);
+    return found;
+}
+
+/**
+ * @brief METRIC_GATEWAY_NODES: how many nodes report, and the one with the worst link
+ */
+static metric_error_t nodes_provider(char *buf, size_t buf_len) {
+    size_t count = node_table_count();
+    node_table_entry_t worst = { 0 };
+    bool found = false;
+    for (size_t n = 0; n < count; n++) {
+        node_table_entry_t e;
+        if (node_table_get(n, &e) && (!found || e.quality_permille < worst.quality_permille)) {
+            worst = e;
+            found = true;
+        }
+    }
+    if (!found) {
+        snprintf(buf, buf_len, "No nodes");
+        return METRIC_OK;
+    }
+
+    uint32_t age_s = ((uint32_t)(esp_timer_get_time() / 1000) - worst.last_seen_ms) / 1000;
+    snprintf(buf, buf_len, "%u nodes; worst " MACSTR " %u.%u%%, %d dBm, seen %lu s ago, %lu lost, %lu duplicate",
+             (unsigned)count, MAC2STR(worst.mac), worst.quality_permille / 10, worst.quality_permille % 10,
+             worst.rssi_x16 / 16, (unsigned long)age_s, (unsigned long)worst.lost, (unsigned long)worst.duplicates);
+    return METRIC_OK;
+}
+
+esp_err_t node_table_init(void) {
+    portENTER_CRITICAL(&table_lock);
+    memset(&table, 0, sizeof(table));
+    node_count = 0;
+    overflow = 0;
+    generation++;
+    portEXIT_CRITICAL(&table_lock);
+
+    set_metric_provider(METRIC_GATEWAY_NODES, nodes_provider);
+    ESP_LOGI(TAG, "Tracking up to %d nodes", NODE_TABLE_MAX_NODES);
+    return ESP_OK;
+}
+
+void node_table_on_frame(const uint8_t *mac, int8_t rssi) {
+    uint64_t key = mac_key(mac);
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    bool added = false;
+
+    portENTER_CRITICAL(&table_lock);
+    uint8_t before = node_count;
+    uint8_t slot = find_slot(key, true);
+    if (slot == NO_SLOT) {
+        overflow++;
+    } else {
+        added = node_count != before;
+        if (added || rssi < table.rssi_min[slot]) {
+            table.rssi_min[slot] = rssi;
+        }
+        int32_t x16 = (int32_t)rssi * 16;
+        if (!added) {
+            x16 = table.rssi_x16[slot] + (x16 - table.rssi_x16[slot]) / NODE_TABLE_EWMA_WEIGHT;
+        }
+        table.rssi_x16[slot] = (int16_t)x16;
+        table.last_seen_ms[slot] = now_ms;
+        table.frames[slot]++;
+    }
+    portEXIT_CRITICAL(&table_lock);
+
+    if (added) {
+        ESP_LOGI(TAG, "New node " MACSTR " at %d dBm", MAC2STR(mac), rssi);
+    } else if (slot == NO_SLOT && overflow == 1) {
+        ESP_LOGW(TAG, "Node table full - " MACSTR " not tracked", MAC2STR(mac));
+    }
+}
+
+void node_table_on_telemetry(const uint8_t *mac, const telemetry_header_t *hdr, const telemetry_record_t *last) {
+    if (hdr->count == 0) {
+        return;
+    }
+    uint64_t key = mac_key(mac);
+    bool restarted = false;
+    bool lr = (hdr->flags & TELEMETRY_FLAG_LR) != 0;
+    bool lr_changed = false;
+    uint32_t newest = hdr->base_seq + hdr->count - 1;
+    time_t now_s = time(NULL);
+
+    portENTER_CRITICAL(&table_lock);
+    uint8_t slot = find_slot(key, false);
+    if (slot != NO_SLOT) {
+        lr_changed = table.lr[slot] != lr;
+        uint32_t gap = 0;
+        uint32_t fresh = hdr->count;            // Samples not received before
+        bool advances = true;                   // The frame carries the node's newest sample
+        bool clock_fault = false;
+        uint32_t last_seq = table.last_seq[slot];
+        uint32_t ahead = hdr->base_seq - (last_seq + 1);
+        uint32_t behind = last_seq - hdr->base_seq;
+        // Seqs behind the newest are a resend, unless newer in time: then the node started over
+        bool resent = behind < NODE_TABLE_SEQ_WINDOW &&
+                      !(newest <= last_seq && last != NULL && table.have_reading[slot] &&
+                        last->time_s > table.reading_s[slot]);
+        if (table.have_seq[slot] && ahead <= NODE_TABLE_SEQ_JUMP) {
+            // Slide the window up to the frame's newest seq; the seqs skipped are lost
+            gap = ahead;
+            uint32_t shift = gap + hdr->count;
+            table.seen[slot] = shift < NODE_TABLE_SEQ_WINDOW ? table.seen[slot] << shift : 0;
+            table.seen[slot] |= seq_bits(hdr->count, 0);
+            table.last_seq[slot] = newest;
+            clock_fault = table.have_reading[slot] && hdr->base_time_s < table.reading_s[slot];
+        } else if (table.have_seq[slot] && resent) {
+            // Any part above the newest seq slides the window; the rest is checked against it
+            uint32_t rise = newest > last_seq ? newest - last_seq : 0;
+            uint32_t low = newest > last_seq ? 0 : last_seq - newest;
+            uint32_t high = rise + behind;      // Offset of the frame's first seq
+            if (high >= NODE_TABLE_SEQ_WINDOW) {
+                high = NODE_TABLE_SEQ_WINDOW - 1;   // Older than the window: neither new nor duplicate
+            }
+            uint64_t mask = seq_bits(high - low + 1, low);
+            table.seen[slot] <<= rise;
+            fresh = (uint32_t)__builtin_popcountll(mask & ~table.seen[slot]);
+            uint32_t late = fresh - rise;
+            table.duplicates[slot] += (uint32_t)__builtin_popcountll(mask) - fresh;
+            table.late[slot] += late;
+            table.lost[slot] -= late < table.lost[slot] ? late : table.lost[slot];
+            table.seen[slot] |= mask;
+            table.last_seq[slot] += rise;
+            advances = rise > 0;
+        } else {
+            if (table.have_seq[slot]) {
+                table.restarts[slot]++;
+                restarted = true;
+            }
+            table.seen[slot] = seq_bits(hdr->count, 0);
+            table.last_seq[slot] = newest;
+        }
+        if (fresh + gap > 0) {
+            uint32_t sample = fresh * 1000 / (fresh + gap);
+            table.quality[slot] = (uint16_t)((table.quality[slot] * (NODE_TABLE_EWMA_WEIGHT - 1) + sample) /
+                                             NODE_TABLE_EWMA_WEIGHT);
+        }
+        table.lost[slot] += gap;
+        table.records[slot] += fresh;
+        table.have_seq[slot] = true;
+        if (advances && last != NULL && now_s >= ESPNOW_TIME_VALID_AFTER && last->time_s >= ESPNOW_TIME_VALID_AFTER) {
+            int64_t lead = (int64_t)last->time_s - now_s;
+            table.clock_lead_s[slot] = (int32_t)lead;
+            clock_fault |= lead > NODE_TABLE_CLOCK_SLACK_S;
+        }
+        if (clock_fault) {
+            table.clock_faults[slot]++;
+        }
+        table.node_id[slot] = hdr->node_id;
+        if (hdr->flags & TELEMETRY_FLAG_POWER) {
+            table.awake_bp[slot] = hdr->awake_bp;
+            table.wake_ms[slot] = hdr->wake_ms;
+        }
+        if (hdr->flags & TELEMETRY_FLAG_RAIN) {
+            // The node counts from its power-on; a resent older frame would step back, so is skipped
+            uint16_t delta = restarted || table.rain_rate[slot] == NODE_TABLE_RAIN_UNKNOWN
+                                 ? hdr->rain_tips
+                                 : (uint16_t)(hdr->rain_tips - table.rain_raw[slot]);
+            if (delta < 0x8000) {
+                table.rain_tips[slot] += delta;
+                table.rain_raw[slot] = hdr->rain_tips;
+                table.rain_rate[slot] = hdr->rain_rate;
+            }
+        }
+        if (hdr->flags & TELEMETRY_FLAG_HEALTH) {
+            table.supply_mv[slot] = hdr->supply_mv;
+            // A saturated count must not read as unknown
+            table.backlog[slot] = hdr->backlog == NODE_TABLE_HEALTH_UNKNOWN ? hdr->backlog - 1 : hdr->backlog;
+        }
+        if (last != NULL && (!table.have_reading[slot] || advances)) {
+            table.temperature[slot] = last->temperature;
+            table.humidity[slot] = last->humidity;
+            table.pressure[slot] = last->pressure;
+            table.reading_s[slot] = last->time_s;
+            table.have_reading[slot] = true;
+        }
+        if (last != NULL) {
+            uint8_t seen = (1 << SENSOR_TEMPERATURE) | (1 << SENSOR_HUMIDITY) | (1 << SENSOR_PRESSURE) |
+                           (last->gas_valid ? 1 << SENSOR_GAS_RESISTANCE : 0);
+            if ((seen & ~table.sensors[slot]) != 0) {
+                table.sensors[slot] |= seen;
+                generation++;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&table_lock);
+
+    if (restarted) {
+        ESP_LOGI(TAG, "Node " MACSTR " restarted its sequence at %lu", MAC2STR(mac), (unsigned long)hdr->base_seq);
+    }
+    // The ACKs only reach it in the mode it sends in; a node not yet a peer is set by its next frame
+    if (lr_changed && espnow_link_peer_set_lr(mac, lr) == ESP_OK) {
+        portENTER_CRITICAL(&table_lock);
+        table.lr[slot] = lr;
+        portEXIT_CRITICAL(&table_lock);
+        ESP_LOGI(TAG, "Node " MACSTR " %s Long Range mode", MAC2STR(mac), lr ? "is answered in" : "left");
+    }
+}
+
+size_t node_table_count(void) {
+    portENTER_CRITICAL(&table_lock);
+    size_t count = node_count;
+    portEXIT_CRITICAL(&table_lock);
+    return count;
+}
+
+uint32_t node_table_generation(void) {
+    portENTER_CRITICAL(&table_lock);
+    uint32_t g = generation;
+    portEXIT_CRITICAL(&table_lock);
+    return g;
+}
+
+bool node_table_get(size_t n, node_table_entry_t *entry) {
+    bool found = copy_nth(n, entry);
+
+    // Outside the spinlock: the link takes a mutex for its peer table
+    if (found) {
+        entry->key_epoch = espnow_link_peer_epoch(entry->mac);
+    }
+    return found;
+}
+
+void node_table_write_json(json_writer_t *w) {
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    size_t count = node_table_count();
+    char mac[18];
+    char id[9];
+
+    json_obj_begin(w);
+    json_kv_uint(w, "capacity", NODE_TABLE_MAX_NODES);
+    json_kv_uint(w, "count", count);
+    portENTER_CRITICAL(&table_lock);
+    uint32_t overflowed = overflow;
+    portEXIT_CRITICAL(&table_lock);
+    json_kv_uint(w, "overflow", overflowed);
+
+    json_key(w, "nodes");
+    json_arr_begin(w);
+    for (size_t n = 0; n < count; n++) {
+        node_table_entry_t e;
+        if (!node_table_get(n, &e)) {
+            break;
+        }
+        snprintf(mac, sizeof(mac), MACSTR, MAC2STR(e.mac));
+        snprintf(id, sizeof(id), "%08lx", (unsigned long)e.node_id);
+        json_obj_begin(w);
+        json_kv_str(w, "mac", mac);
+        json_kv_str(w, "nodeId", id);
+        json_kv_uint(w, "lastSeq", e.last_seq);
+        json_kv_uint(w, "ageMs", now_ms - e.last_seen_ms);
+        json_key(w, "rssi");
+        json_double(w, e.rssi_x16 / 16.0, 1);
+        json_kv_int(w, "rssiMin", e.rssi_min);
+        json_key(w, "quality");
+        json_double(w, e.quality_permille / 10.0, 1);
+        json_key(w, "keyEpoch");
+        if (e.key_epoch != ESPNOW_LINK_EPOCH_NONE) {
+            json_uint(w, e.key_epoch);
+        } else {
+            json_null(w);
+        }
+        json_kv_uint(w, "frames", e.frames);
+        json_kv_uint(w, "records", e.records);
+        json_kv_uint(w, "lost", e.lost);
+        json_kv_uint(w, "duplicates", e.duplicates);
+        json_kv_uint(w, "late", e.late);
+        json_key(w, "completeness");
+        json_double(w, e.completeness_permille / 10.0, 1);
+        json_kv_uint(w, "restarts", e.restarts);
+        json_kv_uint(w, "clockFaults", e.clock_faults);
+        json_key(w, "clockLeadS");
+        if (e.clock_lead_s != NODE_TABLE_LEAD_UNKNOWN) {
+            json_int(w, e.clock_lead_s);
+        } else {
+            json_null(w);
+        }
+        json_key(w, "awake");
+        if (e.awake_bp != NODE_TABLE_AWAKE_UNKNOWN) {
+            json_double(w, e.awake_bp / 100.0, 2);
+        } else {
+            json_null(w);
+        }
+        json_kv_uint(w, "wakeMs", e.wake_ms);
+        json_kv_uint(w, "rainTips", e.rain_tips);
+        json_key(w, "rainRate");
+        if (e.rain_rate != NODE_TABLE_RAIN_UNKNOWN) {
+            json_double(w, e.rain_rate / 100.0, 2);
+        } else {
+            json_null(w);
+        }
+        json_key(w, "supplyMv");
+        if (e.supply_mv != NODE_TABLE_HEALTH_UNKNOWN) {
+            json_uint(w, e.supply_mv);
+        } else {
+            json_null(w);
+        }
+        json_key(w, "backlog");
+        if (e.backlog != NODE_TABLE_HEALTH_UNKNOWN) {
+            json_uint(w, e.backlog);
+        } else {
+            json_null(w);
+        }
+        json_kv_bool(w, "lr", e.lr);
+        json_key(w, "reading");
+        if (e.have_reading) {
+            json_obj_begin(w);
+            json_kv_uint(w, "time", e.reading_s);
+            json_key(w, "temperature");
+            json_double(w, e.temperature / 100.0, 2);
+            json_key(w, "humidity");
+            json_double(w, e.humidity / 1000.0, 2);
+            json_kv_uint(w, "pressure", e.pressure);
+            json_obj_end(w);
+        } else {
+            json_null(w);
+        }
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
+
+void node_table_write_metrics(metrics_export_writer_t *w) {
+    size_t count = node_table_count();
+    node_table_entry_t e;
+    char labels[40];
+
+    // Each family is written whole, so the table is walked once per family
+    metrics_export_family(w, "node_samples", METRICS_EXPORT_COUNTER, NULL,
+                          "Samples per node by outcome; late ones filled a gap and are also received");
+    for (size_t n = 0; n < count && copy_nth(n, &e); n++) {
+        snprintf(labels, sizeof(labels), "node=\"%08lx\",outcome=\"received\"", (unsigned long)e.node_id);
+        metrics_export_sample_int(w, "node_samples", "_total", labels, e.records);
+        snprintf(labels, sizeof(labels), "node=\"%08lx\",outcome=\"lost\"", (unsigned long)e.node_id);
+        metrics_export_sample_int(w, "node_samples", "_total", labels, e.lost);
+        snprintf(labels, sizeof(labels), "node=\"%08lx\",outcome=\"duplicate\"", (unsigned long)e.node_id);
+        metrics_export_sample_int(w, "node_samples", "_total", labels, e.duplicates);
+        snprintf(labels, sizeof(labels), "node=\"%08lx\",outcome=\"late\"", (unsigned long)e.node_id);
+        metrics_export_sample_int(w, "node_samples", "_total", labels, e.late);
+    }
+    metrics_export_family(w, "node_completeness_ratio", METRICS_EXPORT_GAUGE, NULL,
+                          "Share of each node's samples received, since the gateway started");
+    for (size_t n = 0; n < count && copy_nth(n, &e); n++) {
+        snprintf(labels, sizeof(labels), "node=\"%08lx\"", (unsigned long)e.node_id);
+        metrics_export_sample(w, "node_completeness_ratio", "", labels, e.completeness_permille / 1000.0);
+    }
+    metrics_export_family(w, "node_seq_restarts", METRICS_EXPORT_COUNTER, NULL,
+                          "Times a node's sample seq started over");
+    for (size_t n = 0; n < count && copy_nth(n, &e); n++) {
+        snprintf(labels, sizeof(labels), "node=\"%08lx\"", (unsigned long)e.node_id);
+        metrics_export_sample_int(w, "node_seq_restarts", "_total", labels, e.restarts);
+    }
+    metrics_export_family(w, "node_clock_faults", METRICS_EXPORT_COUNTER, NULL,
+                          "Frames whose sample times went back, or led the gateway's clock");
+    for (size_t n = 0; n < count && copy_nth(n, &e); n++) {
+        snprintf(labels, sizeof(labels), "node=\"%08lx\"", (unsigned long)e.node_id);
+        metrics_export_sample_int(w, "node_clock_faults", "_total", labels, e.clock_faults);
+    }
+    metrics_export_family(w, "node_clock_lead_seconds", METRICS_EXPORT_GAUGE, "seconds",
+                          "Newest sample time less the gateway's clock on arrival; batching makes it negative");
+    for (size_t n = 0; n < count && copy_nth(n, &e); n++) {
+        if (e.clock_lead_s != NODE_TABLE_LEAD_UNKNOWN) {
+            snprintf(labels, sizeof(labels), "node=\"%08lx\"", (unsigned long)e.node_id);
+            metrics_export_sample_int(w, "node_clock_lead_seconds", "", labels, e.clock_lead_s);
+        }
+    }
+}
@@ -11,12 +11,24 @@
 // Includes
 // =============================
 #include "nvs_utils.h"
+#include "config_schema.h"
+#include "flash_io.h"
 #include "version.h"
+#include "static_mem.h"
+#include "task_plan.h"
 #include "SystemMetrics.h"
+#include <stddef.h>
 #include <string.h>
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "sdkconfig.h"
+#include "esp_flash_encrypt.h"
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 
 // =============================
 // Constants & Definitions
@@ -25,22 +37,41 @@
 REGISTER_VERSION(NvsUtils, "1.0.0", "2025-10-18");
 static const char *TAG = "NVS_UTILS";
 
-// NVS Keys (max 15 characters)
-#define KEY_SERVER_MAC "server_mac"
-#define KEY_IP_ADDR "ip_addr"
-#define KEY_WIFI_PASS "wifi_pass"
-#define KEY_ESPNOW_ACTIVE "espnow_active"
-#define KEY_ESPNOW_PENDING "espnow_pending"
-#define KEY_DEVICE_ROLE "device_role"
-#define KEY_BRIDGE_SSID "bridge_ssid"
-#define KEY_BRIDGE_PASS "bridge_pass"
-#define KEY_MQTT_IP "mqtt_ip"
-#define KEY_MQTT_PORT "mqtt_port"
-#define KEY_MQTT_USER "mqtt_user"
-#define KEY_MQTT_PASS "mqtt_pass"
-#define KEY_MQTT_CLIENT "mqtt_client"
-#define KEY_MQTT_QOS "mqtt_qos"
-#define KEY_MQTT_TOPIC "mqtt_topic"
+#ifdef CONFIG_NVS_ENCRYPTION
+#define NVS_ENCRYPTION 1                        // [env:secure]: entries are XTS-AES encrypted
+#else
+#define NVS_ENCRYPTION 0
+#endif
+
+// Keys of the config namespace outside device_config_t (max 15 characters)
+#define KEY_STA_CACHE "sta_cache"
+#define KEY_ESPNOW_NODES "espnow_nodes"
+
+_Static_assert(CONFIG_SCHEMA_COUNT <= 32, "Dirty mask holds one bit per config field");
+
+#define CONFIG_FIELD_ALL ((uint32_t)((1ULL << CONFIG_SCHEMA_COUNT) - 1))
+
+// RAM copy of the "config" namespace, filled by nvs_utils_init()
+static device_config_t config_cache;
+static bool config_cache_valid = false;
+static volatile uint32_t config_dirty_mask = 0;     // Bit i set = config_schema[i] not yet in NVS
+static portMUX_TYPE config_cache_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t config_flush_mutex = NULL;
+static TaskHandle_t config_flush_task_handle = NULL;
+STATIC_TASK_SLOT(config_flush_task_slot, NVS_CONFIG_FLUSH_TASK_STACK_SIZE);
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t get_field(nvs_handle_t nvs_handle, const config_field_t *field, uint8_t *dest);
+static esp_err_t set_field(nvs_handle_t nvs_handle, const config_field_t *field, const uint8_t *src);
+static esp_err_t store_config_fields(const device_config_t *cfg, uint32_t field_mask);
+static esp_err_t store_field(config_field_index_t index, const void *value);
+static esp_err_t load_field(config_field_index_t index, void *value);
+static void config_cache_sync_field(config_field_index_t index, const void *value);
+static esp_err_t config_cache_flush(TickType_t wait);
+static void config_flush_task(void *pvParameter);
+static void config_flush_on_shutdown(void);
 
 // =============================
 // Function Definitions
@@ -49,6 +80,7 @@ static const char *TAG = "NVS_UTILS";
 esp_err_t nvs_utils_init(void) {
     ESP_LOGI(TAG, "Initializing NVS...");
     
+    // With CONFIG_NVS_ENCRYPTION this also reads the XTS-AES keys, generating them on the first boot
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
         ESP_LOGW(TAG, "NVS partition was truncated and needs to be erased");
@@ -57,189 +89,406 @@ esp_err_t nvs_utils_init(void) {
     }
     
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "NVS initialized successfully");
+        ESP_LOGI(TAG, "NVS initialized successfully (%s)", nvs_utils_encrypted() ? "encrypted" : "plaintext");
     } else {
+        if (NVS_ENCRYPTION != 0 && ret == ESP_ERR_NOT_FOUND) {
+            ESP_LOGE(TAG, "No nvs_keys partition - flash the partitions_secure.csv table");
+        }
         ESP_LOGE(TAG, "Failed to initialize NVS: %s", esp_err_to_name(ret));
+        return ret;
     }
-    
-    return ret;
-}
 
-esp_err_t nvs_store_server_mac(const char *mac) {
-    if (!mac || strlen(mac) >= MAC_ADDR_STR_LEN) {
-        ESP_LOGE(TAG, "Invalid MAC address parameter");
-        return ESP_ERR_INVALID_ARG;
+    // Fill the RAM config cache once; readers use nvs_config_get() from here on, so
+    // decryption is paid here and by the deferred flush, never on a read
+    int64_t fill_start_us = esp_timer_get_time();
+    if (nvs_load_config(&config_cache) != ESP_OK) {
+        ESP_LOGW(TAG, "Some config values failed to load, cache holds defaults for them");
     }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
+    ESP_LOGI(TAG, "Config cache filled in %lu us", (unsigned long)(esp_timer_get_time() - fill_start_us));
+    config_dirty_mask = 0;
+    config_cache_valid = true;
+
+    if (config_flush_mutex == NULL) {
+        config_flush_mutex = xSemaphoreCreateMutex();
     }
-    
-    err = nvs_set_str(nvs_handle, KEY_SERVER_MAC, mac);
-    if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored server MAC: %s", mac);
+    if (config_flush_mutex != NULL && config_flush_task_handle == NULL) {
+        if (static_task_create(config_flush_task_slot, config_flush_task, NVS_CONFIG_FLUSH_TASK_NAME,
+                               NVS_CONFIG_FLUSH_TASK_STACK_SIZE, NULL, NVS_CONFIG_FLUSH_TASK_PRIORITY,
+                               &config_flush_task_handle, TASK_CORE_NET) != pdPASS) {
+            ESP_LOGW(TAG, "Failed to create config flush task, updates will be written immediately");
+            config_flush_task_handle = NULL;
         } else {
-            ESP_LOGE(TAG, "Failed to commit MAC to NVS: %s", esp_err_to_name(err));
+            esp_register_shutdown_handler(config_flush_on_shutdown);
         }
-    } else {
-        ESP_LOGE(TAG, "Failed to set MAC in NVS: %s", esp_err_to_name(err));
     }
     
-    nvs_close(nvs_handle);
-    return err;
+    return ret;
+}
+
+bool nvs_utils_encrypted(void) {
+    return NVS_ENCRYPTION != 0 && esp_flash_encryption_enabled();
+}
+
+void nvs_config_set_defaults(device_config_t *cfg) {
+    if (!cfg) {
+        return;
+    }
+
+    config_schema_defaults(cfg);
 }
 
-esp_err_t nvs_load_server_mac(char *mac, size_t len) {
-    if (!mac || len < MAC_ADDR_STR_LEN) {
-        ESP_LOGE(TAG, "Invalid MAC buffer parameter");
+esp_err_t nvs_load_config(device_config_t *cfg) {
+    if (!cfg) {
+        ESP_LOGE(TAG, "Invalid config parameter");
         return ESP_ERR_INVALID_ARG;
     }
-    
+
+    nvs_config_set_defaults(cfg);
+
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
     if (err != ESP_OK) {
         if (err == ESP_ERR_NVS_NOT_FOUND) {
-            ESP_LOGW(TAG, "NVS namespace not found (first boot), using default MAC");
-            strcpy(mac, "00:00:00:00:00:00");
+            ESP_LOGW(TAG, "NVS namespace not found (first boot), using default config");
             return ESP_OK;
         }
         ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
         return err;
     }
-    
-    size_t required_size = len;
-    err = nvs_get_str(nvs_handle, KEY_SERVER_MAC, mac, &required_size);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded server MAC: %s", mac);
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "Server MAC not found in NVS, using default");
-        strcpy(mac, "00:00:00:00:00:00");
-        err = ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Failed to get MAC from NVS: %s", esp_err_to_name(err));
+
+    esp_err_t result = ESP_OK;
+    uint32_t defaulted = 0;
+
+    for (size_t i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_field_t *field = &config_schema[i];
+        err = get_field(nvs_handle, field, (uint8_t *)cfg + field->offset);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            defaulted++;
+        } else if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to get %s from NVS: %s", field->nvs_key, esp_err_to_name(err));
+            if (result == ESP_OK) {
+                result = err;
+            }
+        }
     }
-    
+
     nvs_close(nvs_handle);
+
+    ESP_LOGI(TAG, "Loaded config (%u keys, %lu defaulted)",
+             (unsigned)CONFIG_SCHEMA_COUNT, (unsigned long)defaulted);
+    return result;
+}
+
+/**
+ * @brief Read one field into its place in a configuration; a failed read leaves it as it was
+ */
+static esp_err_t get_field(nvs_handle_t nvs_handle, const config_field_t *field, uint8_t *dest) {
+    // Read into scratch space so a failed read leaves the default in place
+    union {
+        char str[CONFIG_SCHEMA_MAX_SIZE];
+        uint8_t bytes[CONFIG_SCHEMA_MAX_SIZE];
+        uint16_t u16;
+    } value;
+    size_t len = field->size;
+    esp_err_t err;
+
+    switch (field->type) {
+        case CONFIG_TYPE_STR:
+            err = nvs_get_str(nvs_handle, field->nvs_key, value.str, &len);
+            break;
+        case CONFIG_TYPE_HEX:
+        case CONFIG_TYPE_BLOB:
+            err = nvs_get_blob(nvs_handle, field->nvs_key, value.bytes, &len);
+            break;
+        case CONFIG_TYPE_U8:
+            err = nvs_get_u8(nvs_handle, field->nvs_key, value.bytes);
+            break;
+        case CONFIG_TYPE_U16:
+            err = nvs_get_u16(nvs_handle, field->nvs_key, &value.u16);
+            break;
+        default:
+            err = ESP_ERR_NOT_SUPPORTED;
+            break;
+    }
+
+    if (err == ESP_OK) {
+        memcpy(dest, value.bytes, field->type == CONFIG_TYPE_STR ? len : field->size);
+    }
     return err;
 }
 
-esp_err_t nvs_store_ip_address(const char *ip) {
-    if (!ip || strlen(ip) >= IP_ADDR_STR_LEN) {
-        ESP_LOGE(TAG, "Invalid IP address parameter");
-        return ESP_ERR_INVALID_ARG;
+/**
+ * @brief Write one field of a configuration, without a commit
+ */
+static esp_err_t set_field(nvs_handle_t nvs_handle, const config_field_t *field, const uint8_t *src) {
+    switch (field->type) {
+        case CONFIG_TYPE_STR:
+            return nvs_set_str(nvs_handle, field->nvs_key, (const char *)src);
+        case CONFIG_TYPE_HEX:
+        case CONFIG_TYPE_BLOB:
+            return nvs_set_blob(nvs_handle, field->nvs_key, src, field->size);
+        case CONFIG_TYPE_U8:
+            return nvs_set_u8(nvs_handle, field->nvs_key, *src);
+        case CONFIG_TYPE_U16:
+            return nvs_set_u16(nvs_handle, field->nvs_key, *(const uint16_t *)src);
+        default:
+            return ESP_ERR_NOT_SUPPORTED;
     }
-    
+}
+
+/**
+ * @brief Write the fields selected by field_mask (bit i = config_schema[i]) with one commit
+ */
+static esp_err_t store_config_fields(const device_config_t *cfg, uint32_t field_mask) {
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
         return err;
     }
-    
-    err = nvs_set_str(nvs_handle, KEY_IP_ADDR, ip);
+
+    uint32_t written = 0;
+    for (size_t i = 0; i < CONFIG_SCHEMA_COUNT && err == ESP_OK; i++) {
+        if (!(field_mask & (1UL << i))) {
+            continue;
+        }
+
+        const config_field_t *field = &config_schema[i];
+        int64_t start = esp_timer_get_time();
+        err = set_field(nvs_handle, field, (const uint8_t *)cfg + field->offset);
+        flash_io_record_nvs(field->nvs_key, field->size, start, err);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to set %s in NVS: %s", field->nvs_key, esp_err_to_name(err));
+        }
+        written++;
+    }
+
     if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
+        err = flash_io_nvs_commit(nvs_handle);
         if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored IP address: %s", ip);
+            ESP_LOGI(TAG, "Stored config (%lu keys, one commit)", (unsigned long)written);
         } else {
-            ESP_LOGE(TAG, "Failed to commit IP to NVS: %s", esp_err_to_name(err));
+            ESP_LOGE(TAG, "Failed to commit config to NVS: %s", esp_err_to_name(err));
         }
-    } else {
-        ESP_LOGE(TAG, "Failed to set IP in NVS: %s", esp_err_to_name(err));
     }
-    
+
     nvs_close(nvs_handle);
     return err;
 }
 
-esp_err_t nvs_load_ip_address(char *ip, size_t len) {
-    if (!ip || len < IP_ADDR_STR_LEN) {
-        ESP_LOGE(TAG, "Invalid IP buffer parameter");
+esp_err_t nvs_store_config(const device_config_t *cfg) {
+    if (!cfg) {
+        ESP_LOGE(TAG, "Invalid config parameter");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+
+    // Validate everything up front so a bad field never leaves a half-written config
+    esp_err_t err = config_schema_validate(cfg);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
         return err;
     }
-    
-    size_t required_size = len;
-    err = nvs_get_str(nvs_handle, KEY_IP_ADDR, ip, &required_size);
+
+    err = store_config_fields(cfg, CONFIG_FIELD_ALL);
     if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded IP address: %s", ip);
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "IP address not found in NVS, using default");
-        strcpy(ip, "192.168.1.100");
-        err = ESP_OK;
+        taskENTER_CRITICAL(&config_cache_lock);
+        memcpy(&config_cache, cfg, sizeof(config_cache));
+        config_dirty_mask = 0;
+        taskEXIT_CRITICAL(&config_cache_lock);
+    }
+    return err;
+}
+
+/**
+ * @brief Keep the RAM cache in step with a single-field store that went straight to NVS
+ */
+static void config_cache_sync_field(config_field_index_t index, const void *value) {
+    const config_field_t *field = &config_schema[index];
+    uint8_t *dest = (uint8_t *)&config_cache + field->offset;
+    taskENTER_CRITICAL(&config_cache_lock);
+    if (field->type == CONFIG_TYPE_STR) {
+        strlcpy((char *)dest, (const char *)value, field->size);
     } else {
-        ESP_LOGE(TAG, "Failed to get IP from NVS: %s", esp_err_to_name(err));
+        memcpy(dest, value, field->size);
     }
-    
-    nvs_close(nvs_handle);
+    config_dirty_mask &= ~(1UL << index);
+    taskEXIT_CRITICAL(&config_cache_lock);
+}
+
+/**
+ * @brief Snapshot the dirty fields and write them out (serialised by config_flush_mutex)
+ */
+static esp_err_t config_cache_flush(TickType_t wait) {
+    if (config_flush_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xSemaphoreTake(config_flush_mutex, wait) != pdTRUE) {
+        ESP_LOGW(TAG, "Config flush already in progress");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    device_config_t snapshot;
+    taskENTER_CRITICAL(&config_cache_lock);
+    uint32_t mask = config_dirty_mask;
+    config_dirty_mask = 0;
+    memcpy(&snapshot, &config_cache, sizeof(snapshot));
+    taskEXIT_CRITICAL(&config_cache_lock);
+
+    esp_err_t err = ESP_OK;
+    if (mask != 0) {
+        err = store_config_fields(&snapshot, mask);
+        if (err != ESP_OK) {
+            // Keep the fields dirty so the next save or flush retries them
+            taskENTER_CRITICAL(&config_cache_lock);
+            config_dirty_mask |= mask;
+            taskEXIT_CRITICAL(&config_cache_lock);
+        }
+    }
+
+    xSemaphoreGive(config_flush_mutex);
     return err;
 }
 
-esp_err_t nvs_store_wifi_password(const char *password) {
-    if (!password || strlen(password) >= WIFI_PASS_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid WiFi password parameter");
+/**
+ * @brief Coalesce bursts of updates into one NVS commit
+ */
+static void config_flush_task(void *pvParameter) {
+    (void)pvParameter;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Keep absorbing saves until things go quiet, but never hold data back for too long
+        TickType_t first = xTaskGetTickCount();
+        while ((xTaskGetTickCount() - first) < pdMS_TO_TICKS(NVS_CONFIG_FLUSH_MAX_DELAY_MS) &&
+               ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NVS_CONFIG_FLUSH_DELAY_MS)) > 0) {
+        }
+
+        config_cache_flush(portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief Write pending config changes before esp_restart()
+ */
+static void config_flush_on_shutdown(void) {
+    if (config_dirty_mask != 0) {
+        ESP_LOGI(TAG, "Flushing pending config before restart");
+        config_cache_flush(pdMS_TO_TICKS(1000));
+    }
+}
+
+esp_err_t nvs_config_get(device_config_t *cfg) {
+    if (!cfg) {
         return ESP_ERR_INVALID_ARG;
     }
-    
+    if (!config_cache_valid) {
+        return nvs_load_config(cfg);
+    }
+
+    taskENTER_CRITICAL(&config_cache_lock);
+    memcpy(cfg, &config_cache, sizeof(*cfg));
+    taskEXIT_CRITICAL(&config_cache_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_config_update(const device_config_t *cfg) {
+    if (!cfg) {
+        ESP_LOGE(TAG, "Invalid config parameter");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = config_schema_validate(cfg);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!config_cache_valid || config_flush_task_handle == NULL) {
+        return nvs_store_config(cfg);
+    }
+
+    uint32_t changed = 0;
+    taskENTER_CRITICAL(&config_cache_lock);
+    for (size_t i = 0; i < CONFIG_SCHEMA_COUNT; i++) {
+        const config_field_t *field = &config_schema[i];
+        if (memcmp((const uint8_t *)cfg + field->offset, (const uint8_t *)&config_cache + field->offset,
+                   field->size) != 0) {
+            changed |= 1UL << i;
+        }
+    }
+    memcpy(&config_cache, cfg, sizeof(config_cache));
+    config_dirty_mask |= changed;
+    taskEXIT_CRITICAL(&config_cache_lock);
+
+    if (changed != 0) {
+        xTaskNotifyGive(config_flush_task_handle);
+    }
+    ESP_LOGI(TAG, "Config updated in RAM (%d fields changed)", __builtin_popcount(changed));
+    return ESP_OK;
+}
+
+esp_err_t nvs_config_flush(void) {
+    return config_cache_flush(portMAX_DELAY);
+}
+
+/**
+ * @brief Store one field straight to NVS with its own commit, and into the RAM cache
+ */
+static esp_err_t store_field(config_field_index_t index, const void *value) {
+    const config_field_t *field = &config_schema[index];
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
         return err;
     }
-    
-    err = nvs_set_str(nvs_handle, KEY_WIFI_PASS, password);
+
+    int64_t start = esp_timer_get_time();
+    err = set_field(nvs_handle, field, value);
+    flash_io_record_nvs(field->nvs_key, field->size, start, err);
     if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
+        err = flash_io_nvs_commit(nvs_handle);
         if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored WiFi password");
+            ESP_LOGI(TAG, "Stored %s", field->nvs_key);
         } else {
-            ESP_LOGE(TAG, "Failed to commit WiFi password to NVS: %s", esp_err_to_name(err));
+            ESP_LOGE(TAG, "Failed to commit %s to NVS: %s", field->nvs_key, esp_err_to_name(err));
         }
     } else {
-        ESP_LOGE(TAG, "Failed to set WiFi password in NVS: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to set %s in NVS: %s", field->nvs_key, esp_err_to_name(err));
     }
-    
+
     nvs_close(nvs_handle);
+    if (err == ESP_OK) {
+        config_cache_sync_field(index, value);
+    }
     return err;
 }
 
-esp_err_t nvs_load_wifi_password(char *password, size_t len) {
-    if (!password || len < WIFI_PASS_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid WiFi password buffer parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
+/**
+ * @brief Load one field straight from NVS; a missing key or namespace gives its default
+ */
+static esp_err_t load_field(config_field_index_t index, void *value) {
+    const config_field_t *field = &config_schema[index];
+    device_config_t defaults;
+    config_schema_defaults(&defaults);
+    memcpy(value, (const uint8_t *)&defaults + field->offset, field->size);
+
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
         return err;
     }
-    
-    size_t required_size = len;
-    err = nvs_get_str(nvs_handle, KEY_WIFI_PASS, password, &required_size);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded WiFi password");
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "WiFi password not found in NVS, using default");
-        strcpy(password, "12345678");
+
+    err = get_field(nvs_handle, field, value);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW(TAG, "%s not found in NVS, using default", field->nvs_key);
         err = ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Failed to get WiFi password from NVS: %s", esp_err_to_name(err));
+    } else if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to get %s from NVS: %s", field->nvs_key, esp_err_to_name(err));
     }
-    
+
     nvs_close(nvs_handle);
     return err;
 }
@@ -249,28 +498,7 @@ esp_err_t nvs_store_espnow_active_key(const uint8_t *key) {
         ESP_LOGE(TAG, "Invalid ESP-NOW active key parameter");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    err = nvs_set_blob(nvs_handle, KEY_ESPNOW_ACTIVE, key, ESPNOW_KEY_LEN);
-    if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored ESP-NOW active key");
-        } else {
-            ESP_LOGE(TAG, "Failed to commit ESP-NOW active key to NVS: %s", esp_err_to_name(err));
-        }
-    } else {
-        ESP_LOGE(TAG, "Failed to set ESP-NOW active key in NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
+    return store_field(CONFIG_FIELD_espnow_active_key, key);
 }
 
 esp_err_t nvs_load_espnow_active_key(uint8_t *key) {
@@ -278,28 +506,7 @@ esp_err_t nvs_load_espnow_active_key(uint8_t *key) {
         ESP_LOGE(TAG, "Invalid ESP-NOW active key buffer parameter");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    size_t required_size = ESPNOW_KEY_LEN;
-    err = nvs_get_blob(nvs_handle, KEY_ESPNOW_ACTIVE, key, &required_size);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded ESP-NOW active key");
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "ESP-NOW active key not found in NVS, using default");
-        memset(key, 0, ESPNOW_KEY_LEN);
-        err = ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Failed to get ESP-NOW active key from NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
+    return load_field(CONFIG_FIELD_espnow_active_key, key);
 }
 
 esp_err_t nvs_store_espnow_pending_key(const uint8_t *key) {
@@ -307,28 +514,7 @@ esp_err_t nvs_store_espnow_pending_key(const uint8_t *key) {
         ESP_LOGE(TAG, "Invalid ESP-NOW pending key parameter");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    err = nvs_set_blob(nvs_handle, KEY_ESPNOW_PENDING, key, ESPNOW_KEY_LEN);
-    if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored ESP-NOW pending key");
-        } else {
-            ESP_LOGE(TAG, "Failed to commit ESP-NOW pending key to NVS: %s", esp_err_to_name(err));
-        }
-    } else {
-        ESP_LOGE(TAG, "Failed to set ESP-NOW pending key in NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
+    return store_field(CONFIG_FIELD_espnow_pending_key, key);
 }
 
 esp_err_t nvs_load_espnow_pending_key(uint8_t *key) {
@@ -336,28 +522,7 @@ esp_err_t nvs_load_espnow_pending_key(uint8_t *key) {
         ESP_LOGE(TAG, "Invalid ESP-NOW pending key buffer parameter");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    size_t required_size = ESPNOW_KEY_LEN;
-    err = nvs_get_blob(nvs_handle, KEY_ESPNOW_PENDING, key, &required_size);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded ESP-NOW pending key");
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "ESP-NOW pending key not found in NVS, using default");
-        memset(key, 0, ESPNOW_KEY_LEN);
-        err = ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Failed to get ESP-NOW pending key from NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
+    return load_field(CONFIG_FIELD_espnow_pending_key, key);
 }
 
 esp_err_t nvs_store_boot_count(uint32_t count) {
@@ -388,11 +553,9 @@ esp_err_t nvs_load_boot_count(uint32_t *count) {
     }
 }
 
-esp_err_t nvs_store_device_role(uint8_t role) {
-    // Validate role value
-    if (role != DEVICE_ROLE_GATEWAY && role != DEVICE_ROLE_RESPONDER) {
-        ESP_LOGE(TAG, "Invalid device role: %d (must be %d or %d)", 
-                 role, DEVICE_ROLE_GATEWAY, DEVICE_ROLE_RESPONDER);
+esp_err_t nvs_store_sta_cache(const nvs_sta_cache_t *cache) {
+    if (!cache) {
+        ESP_LOGE(TAG, "Invalid STA cache parameter");
         return ESP_ERR_INVALID_ARG;
     }
     
@@ -403,60 +566,62 @@ esp_err_t nvs_store_device_role(uint8_t role) {
         return err;
     }
     
-    err = nvs_set_u8(nvs_handle, KEY_DEVICE_ROLE, role);
+    if (cache->channel == 0) {
+        err = nvs_erase_key(nvs_handle, KEY_STA_CACHE);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    } else {
+        err = flash_io_nvs_set_blob(nvs_handle, KEY_STA_CACHE, cache, sizeof(*cache));
+    }
     if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
+        err = flash_io_nvs_commit(nvs_handle);
         if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored device role: %d (%s)", role, 
-                     role == DEVICE_ROLE_GATEWAY ? "Gateway" : "Responder");
+            ESP_LOGI(TAG, "Stored STA cache (channel %u)", cache->channel);
         } else {
-            ESP_LOGE(TAG, "Failed to commit device role to NVS: %s", esp_err_to_name(err));
+            ESP_LOGE(TAG, "Failed to commit STA cache to NVS: %s", esp_err_to_name(err));
         }
     } else {
-        ESP_LOGE(TAG, "Failed to set device role in NVS: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to set STA cache in NVS: %s", esp_err_to_name(err));
     }
     
     nvs_close(nvs_handle);
     return err;
 }
 
-esp_err_t nvs_load_device_role(uint8_t *role) {
-    if (!role) {
-        ESP_LOGE(TAG, "Invalid device role parameter");
+esp_err_t nvs_load_sta_cache(nvs_sta_cache_t *cache) {
+    if (!cache) {
+        ESP_LOGE(TAG, "Invalid STA cache buffer parameter");
         return ESP_ERR_INVALID_ARG;
     }
+    memset(cache, 0, sizeof(*cache));
     
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
     if (err != ESP_OK) {
-        if (err == ESP_ERR_NVS_NOT_FOUND) {
-            ESP_LOGW(TAG, "NVS namespace not found (first boot), using default device role");
-            *role = DEVICE_ROLE_RESPONDER; // Default to responder
-            return ESP_OK;
-        }
         ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
         return err;
     }
     
-    err = nvs_get_u8(nvs_handle, KEY_DEVICE_ROLE, role);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded device role: %d (%s)", *role, 
-                 *role == DEVICE_ROLE_GATEWAY ? "Gateway" : "Responder");
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "Device role not found in NVS, using default (Responder)");
-        *role = DEVICE_ROLE_RESPONDER; // Default to responder
+    size_t required_size = sizeof(*cache);
+    err = nvs_get_blob(nvs_handle, KEY_STA_CACHE, cache, &required_size);
+    if (err == ESP_OK && required_size == sizeof(*cache)) {
+        ESP_LOGI(TAG, "Loaded STA cache (channel %u)", cache->channel);
+    } else if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND || err == ESP_ERR_NVS_INVALID_LENGTH) {
+        // Nothing stored, or a layout from another firmware: scan instead
+        memset(cache, 0, sizeof(*cache));
         err = ESP_OK;
     } else {
-        ESP_LOGE(TAG, "Failed to get device role from NVS: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to get STA cache from NVS: %s", esp_err_to_name(err));
     }
     
     nvs_close(nvs_handle);
     return err;
 }
 
-esp_err_t nvs_store_bridge_ssid(const char *ssid) {
-    if (!ssid || strlen(ssid) >= BRIDGE_SSID_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid bridge SSID parameter");
+esp_err_t nvs_store_espnow_nodes(const nvs_espnow_nodes_t *nodes) {
+    if (!nodes || nodes->count > NVS_ESPNOW_NODES_MAX) {
+        ESP_LOGE(TAG, "Invalid ESP-NOW nodes parameter");
         return ESP_ERR_INVALID_ARG;
     }
     
@@ -467,27 +632,35 @@ esp_err_t nvs_store_bridge_ssid(const char *ssid) {
         return err;
     }
     
-    err = nvs_set_str(nvs_handle, KEY_BRIDGE_SSID, ssid);
+    if (nodes->count == 0) {
+        err = nvs_erase_key(nvs_handle, KEY_ESPNOW_NODES);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    } else {
+        err = flash_io_nvs_set_blob(nvs_handle, KEY_ESPNOW_NODES, nodes, sizeof(*nodes));
+    }
     if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
+        err = flash_io_nvs_commit(nvs_handle);
         if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored bridge SSID: %s", ssid);
+            ESP_LOGI(TAG, "Stored %u ESP-NOW nodes", nodes->count);
         } else {
-            ESP_LOGE(TAG, "Failed to commit bridge SSID to NVS: %s", esp_err_to_name(err));
+            ESP_LOGE(TAG, "Failed to commit ESP-NOW nodes to NVS: %s", esp_err_to_name(err));
         }
     } else {
-        ESP_LOGE(TAG, "Failed to set bridge SSID in NVS: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to set ESP-NOW nodes in NVS: %s", esp_err_to_name(err));
     }
     
     nvs_close(nvs_handle);
     return err;
 }
 
-esp_err_t nvs_load_bridge_ssid(char *ssid, size_t len) {
-    if (!ssid || len < BRIDGE_SSID_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid bridge SSID buffer parameter");
+esp_err_t nvs_load_espnow_nodes(nvs_espnow_nodes_t *nodes) {
+    if (!nodes) {
+        ESP_LOGE(TAG, "Invalid ESP-NOW nodes buffer parameter");
         return ESP_ERR_INVALID_ARG;
     }
+    memset(nodes, 0, sizeof(*nodes));
     
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
@@ -496,476 +669,18 @@ esp_err_t nvs_load_bridge_ssid(char *ssid, size_t len) {
         return err;
     }
     
-    size_t required_size = len;
-    err = nvs_get_str(nvs_handle, KEY_BRIDGE_SSID, ssid, &required_size);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded bridge SSID: %s", ssid);
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "Bridge SSID not found in NVS, using default");
-        strcpy(ssid, "MyBridgeWiFi");
+    size_t required_size = sizeof(*nodes);
+    err = nvs_get_blob(nvs_handle, KEY_ESPNOW_NODES, nodes, &required_size);
+    if (err == ESP_OK && required_size == sizeof(*nodes) && nodes->count <= NVS_ESPNOW_NODES_MAX) {
+        ESP_LOGI(TAG, "Loaded %u ESP-NOW nodes", nodes->count);
+    } else if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND || err == ESP_ERR_NVS_INVALID_LENGTH) {
+        // Nothing stored, or a layout from another firmware: nodes pair again
+        memset(nodes, 0, sizeof(*nodes));
         err = ESP_OK;
     } else {
-        ESP_LOGE(TAG, "Failed to get bridge SSID from NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_store_bridge_password(const char *password) {
-    if (!password || strlen(password) >= BRIDGE_PASS_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid bridge password parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    err = nvs_set_str(nvs_handle, KEY_BRIDGE_PASS, password);
-    if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored bridge password");
-        } else {
-            ESP_LOGE(TAG, "Failed to commit bridge password to NVS: %s", esp_err_to_name(err));
-        }
-    } else {
-        ESP_LOGE(TAG, "Failed to set bridge password in NVS: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to get ESP-NOW nodes from NVS: %s", esp_err_to_name(err));
     }
     
     nvs_close(nvs_handle);
     return err;
 }
-
-esp_err_t nvs_load_bridge_password(char *password, size_t len) {
-    if (!password || len < BRIDGE_PASS_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid bridge password buffer parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    size_t required_size = len;
-    err = nvs_get_str(nvs_handle, KEY_BRIDGE_PASS, password, &required_size);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded bridge password");
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "Bridge password not found in NVS, using default");
-        strcpy(password, "bridgepass123");
-        err = ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Failed to get bridge password from NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_store_mqtt_server_ip(const char *ip) {
-    if (!ip || strlen(ip) >= MQTT_IP_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid MQTT server IP parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    err = nvs_set_str(nvs_handle, KEY_MQTT_IP, ip);
-    if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored MQTT server IP: %s", ip);
-        } else {
-            ESP_LOGE(TAG, "Failed to commit MQTT server IP to NVS: %s", esp_err_to_name(err));
-        }
-    } else {
-        ESP_LOGE(TAG, "Failed to set MQTT server IP in NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_load_mqtt_server_ip(char *ip, size_t len) {
-    if (!ip || len < MQTT_IP_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid MQTT server IP buffer parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    size_t required_size = len;
-    err = nvs_get_str(nvs_handle, KEY_MQTT_IP, ip, &required_size);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded MQTT server IP: %s", ip);
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "MQTT server IP not found in NVS, using default");
-        strcpy(ip, "192.168.1.200");
-        err = ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Failed to get MQTT server IP from NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_store_mqtt_port(uint16_t port) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    err = nvs_set_u16(nvs_handle, KEY_MQTT_PORT, port);
-    if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored MQTT port: %d", port);
-        } else {
-            ESP_LOGE(TAG, "Failed to commit MQTT port to NVS: %s", esp_err_to_name(err));
-        }
-    } else {
-        ESP_LOGE(TAG, "Failed to set MQTT port in NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_load_mqtt_port(uint16_t *port) {
-    if (!port) {
-        ESP_LOGE(TAG, "Invalid MQTT port parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    err = nvs_get_u16(nvs_handle, KEY_MQTT_PORT, port);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded MQTT port: %d", *port);
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "MQTT port not found in NVS, using default");
-        *port = MQTT_DEFAULT_PORT;
-        err = ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Failed to get MQTT port from NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_store_mqtt_username(const char *username) {
-    if (!username || strlen(username) >= MQTT_USER_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid MQTT username parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    err = nvs_set_str(nvs_handle, KEY_MQTT_USER, username);
-    if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored MQTT username: %s", username);
-        } else {
-            ESP_LOGE(TAG, "Failed to commit MQTT username to NVS: %s", esp_err_to_name(err));
-        }
-    } else {
-        ESP_LOGE(TAG, "Failed to set MQTT username in NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_load_mqtt_username(char *username, size_t len) {
-    if (!username || len < MQTT_USER_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid MQTT username buffer parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    size_t required_size = len;
-    err = nvs_get_str(nvs_handle, KEY_MQTT_USER, username, &required_size);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded MQTT username: %s", username);
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "MQTT username not found in NVS, using default");
-        strcpy(username, "mqttuser");
-        err = ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Failed to get MQTT username from NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_store_mqtt_password(const char *password) {
-    if (!password || strlen(password) >= MQTT_PASS_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid MQTT password parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    err = nvs_set_str(nvs_handle, KEY_MQTT_PASS, password);
-    if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored MQTT password");
-        } else {
-            ESP_LOGE(TAG, "Failed to commit MQTT password to NVS: %s", esp_err_to_name(err));
-        }
-    } else {
-        ESP_LOGE(TAG, "Failed to set MQTT password in NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_load_mqtt_password(char *password, size_t len) {
-    if (!password || len < MQTT_PASS_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid MQTT password buffer parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    size_t required_size = len;
-    err = nvs_get_str(nvs_handle, KEY_MQTT_PASS, password, &required_size);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded MQTT password");
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "MQTT password not found in NVS, using default");
-        strcpy(password, "mqttpass123");
-        err = ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Failed to get MQTT password from NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_store_mqtt_client_id(const char *client_id) {
-    if (!client_id || strlen(client_id) >= MQTT_CLIENT_ID_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid MQTT client ID parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    err = nvs_set_str(nvs_handle, KEY_MQTT_CLIENT, client_id);
-    if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored MQTT client ID: %s", client_id);
-        } else {
-            ESP_LOGE(TAG, "Failed to commit MQTT client ID to NVS: %s", esp_err_to_name(err));
-        }
-    } else {
-        ESP_LOGE(TAG, "Failed to set MQTT client ID in NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_load_mqtt_client_id(char *client_id, size_t len) {
-    if (!client_id || len < MQTT_CLIENT_ID_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid MQTT client ID buffer parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    size_t required_size = len;
-    err = nvs_get_str(nvs_handle, KEY_MQTT_CLIENT, client_id, &required_size);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded MQTT client ID: %s", client_id);
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "MQTT client ID not found in NVS, using default");
-        strcpy(client_id, "ESP32WeatherStation");
-        err = ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Failed to get MQTT client ID from NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_store_mqtt_qos(uint8_t qos) {
-    // Validate QoS value (0, 1, or 2)
-    if (qos > 2) {
-        ESP_LOGE(TAG, "Invalid MQTT QoS value: %d (must be 0, 1, or 2)", qos);
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    err = nvs_set_u8(nvs_handle, KEY_MQTT_QOS, qos);
-    if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored MQTT QoS: %d", qos);
-        } else {
-            ESP_LOGE(TAG, "Failed to commit MQTT QoS to NVS: %s", esp_err_to_name(err));
-        }
-    } else {
-        ESP_LOGE(TAG, "Failed to set MQTT QoS in NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_load_mqtt_qos(uint8_t *qos) {
-    if (!qos) {
-        ESP_LOGE(TAG, "Invalid MQTT QoS parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    err = nvs_get_u8(nvs_handle, KEY_MQTT_QOS, qos);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded MQTT QoS: %d", *qos);
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "MQTT QoS not found in NVS, using default");
-        *qos = MQTT_DEFAULT_QOS;
-        err = ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Failed to get MQTT QoS from NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_store_mqtt_base_topic(const char *topic) {
-    if (!topic || strlen(topic) >= MQTT_BASE_TOPIC_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid MQTT base topic parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    err = nvs_set_str(nvs_handle, KEY_MQTT_TOPIC, topic);
-    if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Stored MQTT base topic: %s", topic);
-        } else {
-            ESP_LOGE(TAG, "Failed to commit MQTT base topic to NVS: %s", esp_err_to_name(err));
-        }
-    } else {
-        ESP_LOGE(TAG, "Failed to set MQTT base topic in NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
-
-esp_err_t nvs_load_mqtt_base_topic(char *topic, size_t len) {
-    if (!topic || len < MQTT_BASE_TOPIC_MAX_LEN) {
-        ESP_LOGE(TAG, "Invalid MQTT base topic buffer parameter");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    size_t required_size = len;
-    err = nvs_get_str(nvs_handle, KEY_MQTT_TOPIC, topic, &required_size);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Loaded MQTT base topic: %s", topic);
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "MQTT base topic not found in NVS, using default");
-        strcpy(topic, "weatherstation");
-        err = ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Failed to get MQTT base topic from NVS: %s", esp_err_to_name(err));
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
\ No newline at end of file
@@ -0,0 +1,274 @@
+/**
+ * @file nvs_wear.c
+ * @brief NVS fill level per namespace, writes per key, and how long the partition lasts at this write rate
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "nvs_wear.h"
+#include "metrics_export.h"
+#include "version.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register nvs_wear.c version
+REGISTER_VERSION(NvsWear, "1.0.0", "2026-10-15");
+
+static const char *TAG = "NVS_WEAR";
+
+#define SECONDS_PER_HOUR 3600
+#define SECONDS_PER_DAY 86400
+
+static bool running = false;
+static uint32_t usable_entries;                 // Less the page kept free for compaction
+static nvs_wear_key_t keys[NVS_WEAR_MAX_KEYS];
+static size_t key_count;
+static uint32_t hour_entries[NVS_WEAR_WINDOW_HOURS];  // Entries written per hour since boot, as a ring
+static uint32_t current_hour;                   // Hour since boot hour_entries was last advanced to
+static uint32_t writes;
+static uint32_t entries_written;
+static portMUX_TYPE wear_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static uint32_t entry_cost(size_t bytes);
+static void roll_window(uint32_t uptime_s);
+static uint32_t rate_per_day(uint32_t uptime_s);
+static uint32_t life_days(uint32_t per_day);
+static size_t list_namespaces(char names[][NVS_KEY_NAME_MAX_SIZE], size_t max);
+static void write_nvs_metrics(metrics_export_writer_t *w);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Entries a value of this size takes: one inline, or a header and its 32-byte data entries
+ */
+static uint32_t entry_cost(size_t bytes) {
+    return bytes <= 8 ? 1 : 2 + (uint32_t)((bytes + 31) / 32);
+}
+
+/**
+ * @brief Advance the hourly ring to uptime_s, clearing the hours that passed; wear_lock held
+ */
+static void roll_window(uint32_t uptime_s) {
+    uint32_t hour = uptime_s / SECONDS_PER_HOUR;
+    if (hour - current_hour >= NVS_WEAR_WINDOW_HOURS) {
+        memset(hour_entries, 0, sizeof(hour_entries));
+        current_hour = hour;
+        return;
+    }
+    while (current_hour < hour) {
+        current_hour++;
+        hour_entries[current_hour % NVS_WEAR_WINDOW_HOURS] = 0;
+    }
+}
+
+/**
+ * @brief Entries written per day over the window, counting at least an hour; wear_lock held
+ */
+static uint32_t rate_per_day(uint32_t uptime_s) {
+    roll_window(uptime_s);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < NVS_WEAR_WINDOW_HOURS; i++) {
+        sum += hour_entries[i];
+    }
+    // The oldest hour of a full ring is partly cleared already
+    uint32_t span_s = uptime_s < NVS_WEAR_WINDOW_HOURS * SECONDS_PER_HOUR
+                          ? uptime_s
+                          : (NVS_WEAR_WINDOW_HOURS - 1) * SECONDS_PER_HOUR + uptime_s % SECONDS_PER_HOUR;
+    if (span_s < SECONDS_PER_HOUR) {
+        span_s = SECONDS_PER_HOUR;
+    }
+    return (uint32_t)(sum * SECONDS_PER_DAY / span_s);
+}
+
+static uint32_t life_days(uint32_t per_day) {
+    if (per_day == 0) {
+        return NVS_WEAR_LIFE_CAP_DAYS;
+    }
+    uint64_t days = (uint64_t)NVS_WEAR_ENDURANCE_CYCLES * usable_entries / per_day;
+    return days > NVS_WEAR_LIFE_CAP_DAYS ? NVS_WEAR_LIFE_CAP_DAYS : (uint32_t)days;
+}
+
+void nvs_wear_note(const char *key, size_t bytes) {
+    uint32_t cost = entry_cost(bytes);
+    uint32_t uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+
+    portENTER_CRITICAL(&wear_lock);
+    roll_window(uptime_s);
+    hour_entries[current_hour % NVS_WEAR_WINDOW_HOURS] += cost;
+    writes++;
+    entries_written += cost;
+
+    nvs_wear_key_t *k = NULL;
+    for (size_t i = 0; i < key_count && k == NULL; i++) {
+        if (strcmp(keys[i].key, key) == 0) {
+            k = &keys[i];
+        }
+    }
+    if (k == NULL && key_count < NVS_WEAR_MAX_KEYS - 1) {
+        k = &keys[key_count++];
+        strlcpy(k->key, key, sizeof(k->key));
+    } else if (k == NULL) {
+        k = &keys[NVS_WEAR_MAX_KEYS - 1];
+        if (key_count < NVS_WEAR_MAX_KEYS) {
+            key_count = NVS_WEAR_MAX_KEYS;
+            strlcpy(k->key, "other", sizeof(k->key));
+        }
+    }
+    k->writes++;
+    k->entries += cost;
+    portEXIT_CRITICAL(&wear_lock);
+}
+
+bool nvs_wear_life_days(int64_t *days) {
+    if (!running) {
+        return false;
+    }
+    uint32_t uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+    portENTER_CRITICAL(&wear_lock);
+    uint32_t per_day = rate_per_day(uptime_s);
+    portEXIT_CRITICAL(&wear_lock);
+    *days = life_days(per_day);
+    return true;
+}
+
+void nvs_wear_get_stats(nvs_wear_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    nvs_stats_t st;
+    if (nvs_get_stats(NULL, &st) == ESP_OK) {
+        out->total_entries = st.total_entries;
+        out->used_entries = st.used_entries;
+        out->free_entries = st.free_entries;
+        out->namespaces = st.namespace_count;
+    }
+
+    uint32_t uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+    portENTER_CRITICAL(&wear_lock);
+    out->running = running;
+    out->writes = writes;
+    out->entries_written = entries_written;
+    out->entries_per_day = rate_per_day(uptime_s);
+    portEXIT_CRITICAL(&wear_lock);
+    out->life_days = life_days(out->entries_per_day);
+}
+
+size_t nvs_wear_get_keys(nvs_wear_key_t *out, size_t max) {
+    portENTER_CRITICAL(&wear_lock);
+    size_t n = key_count < max ? key_count : max;
+    memcpy(out, keys, n * sizeof(keys[0]));
+    portEXIT_CRITICAL(&wear_lock);
+    return n;
+}
+
+/**
+ * @brief Names of the namespaces that hold at least one key
+ */
+static size_t list_namespaces(char names[][NVS_KEY_NAME_MAX_SIZE], size_t max) {
+    size_t n = 0;
+    nvs_iterator_t it = NULL;
+    esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, NULL, NVS_TYPE_ANY, &it);
+    while (err == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        bool seen = false;
+        for (size_t i = 0; i < n && !seen; i++) {
+            seen = strcmp(names[i], info.namespace_name) == 0;
+        }
+        if (!seen && n < max) {
+            strlcpy(names[n++], info.namespace_name, NVS_KEY_NAME_MAX_SIZE);
+        }
+        err = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    return n;
+}
+
+/**
+ * @brief Partition fill, used entries per namespace, writes per key and the life projection
+ */
+static void write_nvs_metrics(metrics_export_writer_t *w) {
+    nvs_wear_stats_t st;
+    nvs_wear_get_stats(&st);
+    char labels[METRICS_EXPORT_LABEL_MAX + 16];
+    char escaped[METRICS_EXPORT_LABEL_MAX];
+
+    metrics_export_family(w, "nvs_entries", METRICS_EXPORT_GAUGE, NULL, "NVS partition entries by state");
+    metrics_export_sample_int(w, "nvs_entries", "", "state=\"used\"", st.used_entries);
+    metrics_export_sample_int(w, "nvs_entries", "", "state=\"free\"", st.free_entries);
+    metrics_export_sample_int(w, "nvs_entries", "", "state=\"total\"", st.total_entries);
+
+    char names[NVS_WEAR_MAX_NAMESPACES][NVS_KEY_NAME_MAX_SIZE];
+    size_t n = list_namespaces(names, NVS_WEAR_MAX_NAMESPACES);
+    metrics_export_family(w, "nvs_namespace_entries", METRICS_EXPORT_GAUGE, NULL, "NVS entries used per namespace");
+    for (size_t i = 0; i < n; i++) {
+        nvs_handle_t handle;
+        size_t used = 0;
+        if (nvs_open(names[i], NVS_READONLY, &handle) != ESP_OK) {
+            continue;
+        }
+        esp_err_t err = nvs_get_used_entry_count(handle, &used);
+        nvs_close(handle);
+        if (err == ESP_OK) {
+            snprintf(labels, sizeof(labels), "namespace=\"%s\"", metrics_export_escape(escaped, sizeof(escaped), names[i]));
+            metrics_export_sample_int(w, "nvs_namespace_entries", "", labels, (int64_t)used);
+        }
+    }
+
+    nvs_wear_key_t k[NVS_WEAR_MAX_KEYS];
+    size_t key_n = nvs_wear_get_keys(k, NVS_WEAR_MAX_KEYS);
+    metrics_export_family(w, "nvs_key_writes", METRICS_EXPORT_COUNTER, NULL, "NVS writes per key since boot");
+    for (size_t i = 0; i < key_n; i++) {
+        snprintf(labels, sizeof(labels), "key=\"%s\"", metrics_export_escape(escaped, sizeof(escaped), k[i].key));
+        metrics_export_sample_int(w, "nvs_key_writes", "_total", labels, k[i].writes);
+    }
+
+    metrics_export_family(w, "nvs_write_entries", METRICS_EXPORT_COUNTER, NULL,
+                          "NVS entries written since boot (estimated)");
+    metrics_export_sample_int(w, "nvs_write_entries", "_total", NULL, st.entries_written);
+    metrics_export_family(w, "nvs_write_entries_per_day", METRICS_EXPORT_GAUGE, NULL,
+                          "NVS entries written per day, averaged over the last day");
+    metrics_export_sample_int(w, "nvs_write_entries_per_day", "", NULL, st.entries_per_day);
+    metrics_export_family(w, "nvs_projected_life_days", METRICS_EXPORT_GAUGE, NULL,
+                          "Days until the NVS partition wears out at this write rate");
+    metrics_export_sample_int(w, "nvs_projected_life_days", "", NULL, st.life_days);
+}
+
+esp_err_t nvs_wear_start(void) {
+    if (running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    nvs_stats_t st;
+    esp_err_t err = nvs_get_stats(NULL, &st);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No NVS statistics: %s", esp_err_to_name(err));
+        return err;
+    }
+    usable_entries = st.total_entries > NVS_WEAR_ENTRIES_PER_PAGE ? st.total_entries - NVS_WEAR_ENTRIES_PER_PAGE : 0;
+
+    // system_metrics_init() has stored this boot's count, except on a wake from deep sleep
+    if (esp_reset_reason() != ESP_RST_DEEPSLEEP) {
+        nvs_wear_note("boot_count", sizeof(uint32_t));
+    }
+
+    running = true;
+    metrics_export_add_source(write_nvs_metrics);
+    ESP_LOGI(TAG, "NVS: %u of %u entries used in %u namespaces", (unsigned)st.used_entries,
+             (unsigned)st.total_entries, (unsigned)st.namespace_count);
+    return ESP_OK;
+}
@@ -9,15 +9,30 @@
 // Includes
 // =============================
 #include "ota_manager.h"
+#include "espnow_ota.h"
+#include "flash_io.h"
+#include "long_op.h"
+#include "mem_policy.h"
+#include "power_profile.h"
+#include "pipeline_trace.h"
+#include "storage.h"
+#include "static_mem.h"
 #include "SystemMetrics.h"
 #include "esp_log.h"
+#include "esp_image_format.h"
 #include "esp_ota_ops.h"
 #include "esp_partition.h"
 #include "esp_system.h"
-#include "esp_spiffs.h"
+#include "esp_timer.h"
 #include "esp_http_server.h"
 #include "mbedtls/sha256.h"
+#include "rom/miniz.h"
 #include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -31,6 +46,326 @@ static const esp_partition_t* g_update_partition = NULL;
 static mbedtls_sha256_context g_sha256_ctx;
 static bool g_crypto_init = false;
 
+// Writer pipeline: blocks cycle free -> filled by ota_process_chunk -> written -> free
+typedef struct {
+    uint8_t *data;                              // NULL tells the writer task to exit
+    size_t len;
+} ota_block_t;
+
+static uint8_t *g_block_mem = NULL;
+#if STATIC_MEMORY
+static uint8_t g_block_pool[OTA_WRITER_BLOCKS * OTA_CHUNK_SIZE];  // g_block_mem in a static build
+#endif
+static QueueHandle_t g_free_blocks = NULL;
+static QueueHandle_t g_full_blocks = NULL;
+static SemaphoreHandle_t g_writer_done = NULL;
+static bool g_writer_running = false;
+static ota_block_t g_fill_block = {0};          // Block being filled, data NULL if none held
+static volatile esp_err_t g_write_err = ESP_OK; // First writer failure, reported to the receiver
+static size_t g_write_offset = 0;               // Bytes committed to flash
+static size_t g_erased_to = 0;                  // Filesystem partition erased up to here
+static int64_t g_start_us = 0;                  // When the update started
+static int64_t g_flash_us = 0;                  // Writer time in flash operations
+static int64_t g_hash_us = 0;                   // Writer time in SHA-256 updates
+
+// Streaming inflate for OTA_ENCODING_ZLIB: the ROM inflater writes into a
+// circular dictionary window and each run of output goes straight to flash
+typedef struct {
+    tinfl_decompressor decomp;
+    uint8_t window[TINFL_LZ_DICT_SIZE];
+    size_t window_pos;
+    tinfl_status status;
+} ota_inflate_t;
+
+static ota_inflate_t *g_inflate = NULL;         // Allocated only for compressed uploads
+
+// Published copy of g_ota_status for readers on other tasks. Updaters serialise
+// on g_status_lock and bump g_status_seq around the copy (odd = copy under way);
+// readers never take the lock, they retry if the sequence moved.
+static ota_status_t g_status_snapshot = {0};
+static uint32_t g_status_seq = 0;
+static portMUX_TYPE g_status_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *STATE_NAMES[] = { "idle", "uploading", "verifying", "flashing", "success", "error" };
+
+static void publish_status(void);
+static esp_err_t start_update(const ota_config_t *config);
+static esp_err_t process_chunk(const uint8_t *data, size_t size);
+static esp_err_t finalize_update(void);
+static esp_err_t auto_rollback(void);
+static esp_err_t commit_image(const uint8_t *data, size_t size);
+static esp_err_t inflate_block(const uint8_t *data, size_t size);
+static esp_err_t write_block(const uint8_t *data, size_t size);
+static void ota_writer_task(void *pvParameter);
+static esp_err_t writer_start(void);
+static esp_err_t writer_stop(void);
+
+/**
+ * @brief Publish g_ota_status, with rate and ETA filled in, for ota_get_status()
+ */
+static void publish_status(void) {
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&g_status_lock);
+    __atomic_store_n(&g_status_seq, g_status_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&g_status_snapshot, &g_ota_status, sizeof(g_status_snapshot));
+    g_status_snapshot.written_size = g_write_offset;
+    if (g_status_snapshot.state == OTA_STATE_UPLOADING && now > g_start_us) {
+        uint64_t rate = (uint64_t)g_status_snapshot.uploaded_size * 1000000ULL / (uint64_t)(now - g_start_us);
+        g_status_snapshot.rate_bps = (uint32_t)rate;
+        g_status_snapshot.eta_s = (rate > 0 && g_status_snapshot.total_size > g_status_snapshot.uploaded_size)
+            ? (uint32_t)((g_status_snapshot.total_size - g_status_snapshot.uploaded_size) / rate) : 0;
+    }
+    __atomic_store_n(&g_status_seq, g_status_seq + 1, __ATOMIC_RELEASE);
+    taskEXIT_CRITICAL(&g_status_lock);
+}
+
+/**
+ * @brief Write image bytes to flash and fold them into the running hash (writer task)
+ */
+static esp_err_t commit_image(const uint8_t *data, size_t size) {
+    esp_err_t ret;
+    int64_t t0 = esp_timer_get_time();
+
+    if (g_write_offset + size > g_update_partition->size) {
+        ESP_LOGE(TAG, "Image exceeds partition %s (%" PRIu32 " bytes)",
+                 g_update_partition->label, g_update_partition->size);
+        snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
+                "Image larger than partition");
+        g_ota_status.state = OTA_STATE_ERROR;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (g_ota_status.type == OTA_TYPE_FIRMWARE) {
+        // Write to OTA partition
+        ret = flash_io_ota_write(g_update_partition, g_ota_handle, data, size);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "esp_ota_write failed: %s", esp_err_to_name(ret));
+            snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
+                    "OTA write failed: %s", esp_err_to_name(ret));
+            g_ota_status.state = OTA_STATE_ERROR;
+            return ret;
+        }
+    } else {
+        // An image of the other filesystem would only be formatted away on the next mount
+        if (g_write_offset == 0 && storage_check_image(data, size) == ESP_ERR_NOT_SUPPORTED) {
+            ESP_LOGE(TAG, "Filesystem image is not %s", storage_name());
+            snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
+                    "Image is not a %s filesystem", storage_name());
+            g_ota_status.state = OTA_STATE_ERROR;
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+
+        // Erase just the sectors this write reaches, so erasing overlaps receiving
+        size_t end = g_write_offset + size;
+        if (end > g_erased_to) {
+            size_t erase_end = (end + OTA_FLASH_SECTOR_SIZE - 1) & ~(size_t)(OTA_FLASH_SECTOR_SIZE - 1);
+            ret = long_op_erase(g_update_partition, g_erased_to, erase_end - g_erased_to, LONG_OP_OTA_ERASE);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Partition erase failed: %s", esp_err_to_name(ret));
+                snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
+                        "Partition erase failed: %s", esp_err_to_name(ret));
+                g_ota_status.state = OTA_STATE_ERROR;
+                return ret;
+            }
+            g_erased_to = erase_end;
+        }
+
+        // For filesystem, write directly to partition
+        ret = flash_io_write(FLASH_IO_OTA, g_update_partition, g_write_offset, data, size);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "esp_partition_write failed: %s", esp_err_to_name(ret));
+            snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
+                    "Partition write failed: %s", esp_err_to_name(ret));
+            g_ota_status.state = OTA_STATE_ERROR;
+            return ret;
+        }
+    }
+    g_write_offset += size;
+    int64_t t1 = esp_timer_get_time();
+    g_flash_us += t1 - t0;
+
+    // Update crypto hash if verification is enabled (SHA peripheral via CONFIG_MBEDTLS_HARDWARE_SHA)
+    if (g_crypto_init) {
+        if (mbedtls_sha256_update(&g_sha256_ctx, data, size) != 0) {
+            ESP_LOGE(TAG, "Failed to update SHA256 hash");
+            return ESP_FAIL;
+        }
+        g_hash_us += esp_timer_get_time() - t1;
+    }
+
+    ESP_LOGD(TAG, "Committed %zu bytes, total: %zu bytes", size, g_write_offset);
+    return ESP_OK;
+}
+
+/**
+ * @brief Inflate one block of a zlib upload, committing output as it appears
+ */
+static esp_err_t inflate_block(const uint8_t *data, size_t size) {
+    const int flags = TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT;
+
+    while (size > 0 || g_inflate->status == TINFL_STATUS_HAS_MORE_OUTPUT) {
+        if (g_inflate->status == TINFL_STATUS_DONE) {
+            ESP_LOGW(TAG, "Ignoring %zu bytes after the end of the compressed image", size);
+            return ESP_OK;
+        }
+
+        size_t in_len = size;
+        size_t out_len = TINFL_LZ_DICT_SIZE - g_inflate->window_pos;
+        g_inflate->status = tinfl_decompress(&g_inflate->decomp, data, &in_len, g_inflate->window,
+                                             g_inflate->window + g_inflate->window_pos, &out_len, flags);
+        if (g_inflate->status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Inflate failed: status %d", (int)g_inflate->status);
+            snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
+                    "Corrupt compressed image");
+            g_ota_status.state = OTA_STATE_ERROR;
+            return ESP_ERR_INVALID_CRC;
+        }
+        data += in_len;
+        size -= in_len;
+
+        if (out_len > 0) {
+            esp_err_t ret = commit_image(g_inflate->window + g_inflate->window_pos, out_len);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            g_inflate->window_pos = (g_inflate->window_pos + out_len) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Route one received block to flash, inflating it first if needed (writer task)
+ */
+static esp_err_t write_block(const uint8_t *data, size_t size) {
+    if (g_inflate != NULL) {
+        return inflate_block(data, size);
+    }
+    return commit_image(data, size);
+}
+
+static void ota_writer_task(void *pvParameter) {
+    (void)pvParameter;
+    ota_block_t block;
+
+    while (xQueueReceive(g_full_blocks, &block, portMAX_DELAY) == pdTRUE && block.data != NULL) {
+        // After a failure keep recycling blocks so the receiver never blocks on us
+        if (g_write_err == ESP_OK) {
+            PIPELINE_TRACE_BEGIN(PIPELINE_TRACE_OTA_WRITE);
+            g_write_err = write_block(block.data, block.len);
+            PIPELINE_TRACE_END(PIPELINE_TRACE_OTA_WRITE);
+            publish_status();
+        }
+        block.len = 0;
+        xQueueSend(g_free_blocks, &block, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(g_writer_done);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Allocate the ping-pong blocks and start the writer task
+ */
+static esp_err_t writer_start(void) {
+    writer_stop();  // Tear down anything left by an abandoned upload
+    g_write_err = ESP_OK;
+    g_write_offset = 0;
+    g_erased_to = 0;
+    g_flash_us = 0;
+    g_hash_us = 0;
+    g_fill_block.data = NULL;
+    g_fill_block.len = 0;
+
+    if (g_ota_config.encoding == OTA_ENCODING_ZLIB) {
+        g_inflate = mem_policy_malloc(MEM_BULK, sizeof(*g_inflate));
+        if (g_inflate == NULL) {
+            ESP_LOGE(TAG, "No memory for the %zu byte inflate window", sizeof(*g_inflate));
+            return ESP_ERR_NO_MEM;
+        }
+        tinfl_init(&g_inflate->decomp);
+        g_inflate->window_pos = 0;
+        g_inflate->status = TINFL_STATUS_NEEDS_MORE_INPUT;
+    }
+
+#if STATIC_MEMORY
+    g_block_mem = g_block_pool;
+#else
+    g_block_mem = mem_policy_malloc(MEM_BULK, (size_t)OTA_WRITER_BLOCKS * OTA_CHUNK_SIZE);
+#endif
+    g_free_blocks = xQueueCreate(OTA_WRITER_BLOCKS, sizeof(ota_block_t));
+    g_full_blocks = xQueueCreate(OTA_WRITER_BLOCKS + 1, sizeof(ota_block_t));  // +1 for the exit marker
+    g_writer_done = xSemaphoreCreateBinary();
+    if (g_block_mem == NULL || g_free_blocks == NULL || g_full_blocks == NULL || g_writer_done == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate OTA writer buffers");
+        writer_stop();
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < OTA_WRITER_BLOCKS; i++) {
+        ota_block_t block = { .data = g_block_mem + (size_t)i * OTA_CHUNK_SIZE, .len = 0 };
+        xQueueSend(g_free_blocks, &block, 0);
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(ota_writer_task, OTA_WRITER_TASK_NAME, OTA_WRITER_STACK_SIZE,
+                                                 NULL, OTA_WRITER_PRIORITY, NULL, OTA_WRITER_CORE);
+    if (created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create OTA writer task");
+        writer_stop();
+        return ESP_ERR_NO_MEM;
+    }
+    g_writer_running = true;
+    power_profile_acquire(POWER_LOCK_CPU);     // Inflate and hash at full clock until the writer stops
+    return ESP_OK;
+}
+
+/**
+ * @brief Drain the writer, stop its task and release the blocks
+ * @return The writer's first error, ESP_OK if every block was committed
+ */
+static esp_err_t writer_stop(void) {
+    if (g_writer_running) {
+        ota_block_t exit_marker = { .data = NULL, .len = 0 };
+        xQueueSend(g_full_blocks, &exit_marker, portMAX_DELAY);
+        xSemaphoreTake(g_writer_done, portMAX_DELAY);
+        g_writer_running = false;
+        power_profile_release(POWER_LOCK_CPU);
+
+        // Every block has been inflated; a stream that never reached its end is truncated
+        if (g_inflate != NULL && g_inflate->status != TINFL_STATUS_DONE && g_write_err == ESP_OK) {
+            ESP_LOGE(TAG, "Compressed image ended early");
+            snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
+                    "Compressed image truncated");
+            g_write_err = ESP_ERR_INVALID_SIZE;
+        }
+    }
+    free(g_inflate);
+    g_inflate = NULL;
+
+    if (g_writer_done != NULL) {
+        vSemaphoreDelete(g_writer_done);
+        g_writer_done = NULL;
+    }
+    if (g_full_blocks != NULL) {
+        vQueueDelete(g_full_blocks);
+        g_full_blocks = NULL;
+    }
+    if (g_free_blocks != NULL) {
+        vQueueDelete(g_free_blocks);
+        g_free_blocks = NULL;
+    }
+#if !STATIC_MEMORY
+    free(g_block_mem);
+#endif
+    g_block_mem = NULL;
+    g_fill_block.data = NULL;
+    g_fill_block.len = 0;
+
+    return g_write_err;
+}
+
 esp_err_t ota_manager_init(void) {
     memset(&g_ota_status, 0, sizeof(g_ota_status));
     g_ota_status.state = OTA_STATE_IDLE;
@@ -39,6 +374,7 @@ esp_err_t ota_manager_init(void) {
     g_ota_config.create_backup = true;
     g_ota_config.verify_crypto = true;
     g_ota_config.expected_hash[0] = '\0';
+    publish_status();
     ESP_LOGI(TAG, "OTA manager initialized");
     return ESP_OK;
 }
@@ -76,8 +412,7 @@ esp_err_t ota_register_endpoints(httpd_handle_t server) {
     return ESP_OK;
 }
 
-esp_err_t ota_start_update(const ota_config_t* config) {
-    if (!config) return ESP_ERR_INVALID_ARG;
+static esp_err_t start_update(const ota_config_t *config) {
     
     // Store user config
     memcpy(&g_ota_config, config, sizeof(g_ota_config));
@@ -90,6 +425,7 @@ esp_err_t ota_start_update(const ota_config_t* config) {
     g_ota_status.uploaded_size = 0;
     g_ota_status.progress_percent = 0;
     g_ota_status.type = config->update_type;
+    g_ota_status.total_size = config->total_size;
     
     if (config->update_type == OTA_TYPE_FIRMWARE) {
         // Get next available OTA partition
@@ -102,10 +438,12 @@ esp_err_t ota_start_update(const ota_config_t* config) {
             return ESP_ERR_NOT_FOUND;
         }
         
-        ESP_LOGI(TAG, "Starting OTA update to partition: %s", g_update_partition->label);
+        ESP_LOGI(TAG, "Starting OTA update to partition: %s%s", g_update_partition->label,
+                 config->for_nodes ? " (node firmware)" : "");
+        espnow_ota_unstage();  // A staged node image lives in this slot
         
-        // Begin OTA update
-        esp_err_t ret = esp_ota_begin(g_update_partition, OTA_SIZE_UNKNOWN, &g_ota_handle);
+        // Begin OTA update; sectors are erased as the writer reaches them, not all up front
+        esp_err_t ret = esp_ota_begin(g_update_partition, OTA_WITH_SEQUENTIAL_WRITES, &g_ota_handle);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(ret));
             snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
@@ -114,45 +452,48 @@ esp_err_t ota_start_update(const ota_config_t* config) {
             return ret;
         }
     } else {
-        // For filesystem updates, get SPIFFS partition
-        g_update_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, 
-                                                     ESP_PARTITION_SUBTYPE_DATA_SPIFFS, 
-                                                     "spiffs");
+        // For filesystem updates, the spare asset slot if the table has one, else the mounted one
+        const char *spare = storage_spare_label();
+        g_update_partition = storage_find_partition(spare != NULL ? spare : storage_active_label());
         if (g_update_partition == NULL) {
-            ESP_LOGE(TAG, "SPIFFS partition not found");
+            ESP_LOGE(TAG, "Filesystem partition not found");
             snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
-                    "SPIFFS partition not found");
+                    "Filesystem partition not found");
             g_ota_status.state = OTA_STATE_ERROR;
             return ESP_ERR_NOT_FOUND;
         }
         
-        ESP_LOGI(TAG, "Found SPIFFS partition: %s, size: %d bytes", 
+        ESP_LOGI(TAG, "Found %s partition: %s, size: %d bytes", storage_name(),
                  g_update_partition->label, g_update_partition->size);
-        
-        // Unmount SPIFFS before updating
-        ESP_LOGI(TAG, "Unmounting SPIFFS filesystem...");
-        esp_err_t unmount_ret = esp_vfs_spiffs_unregister(NULL);
-        if (unmount_ret == ESP_OK) {
-            ESP_LOGI(TAG, "SPIFFS unmounted successfully");
-        } else {
-            ESP_LOGW(TAG, "SPIFFS unmount failed or not mounted: %s", esp_err_to_name(unmount_ret));
+
+        // An image built for another partition table (partitions.csv, partitions_split.csv, partitions_ab.csv)
+        if (config->encoding == OTA_ENCODING_RAW && config->total_size > g_update_partition->size) {
+            ESP_LOGE(TAG, "Filesystem image of %zu bytes is larger than %s; built for another partition table?",
+                     config->total_size, g_update_partition->label);
+            snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message),
+                    "Image is larger than the %" PRIu32 " KB filesystem partition", g_update_partition->size / 1024);
+            g_ota_status.state = OTA_STATE_ERROR;
+            return ESP_ERR_INVALID_SIZE;
         }
         
-        // For SPIFFS updates, we need to erase the partition first
-        ESP_LOGI(TAG, "Erasing SPIFFS partition for update...");
-        esp_err_t ret = esp_partition_erase_range(g_update_partition, 0, g_update_partition->size);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to erase SPIFFS partition: %s", esp_err_to_name(ret));
-            snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
-                    "SPIFFS erase failed: %s", esp_err_to_name(ret));
-            g_ota_status.state = OTA_STATE_ERROR;
-            return ret;
+        if (spare != NULL) {
+            ESP_LOGI(TAG, "Writing to spare slot %s, %s stays mounted", spare, storage_active_label());
+        } else {
+            // Unmount the filesystem before updating
+            ESP_LOGI(TAG, "Unmounting %s filesystem...", storage_name());
+            esp_err_t unmount_ret = storage_unmount();
+            if (unmount_ret == ESP_OK) {
+                ESP_LOGI(TAG, "%s unmounted successfully", storage_name());
+            } else {
+                ESP_LOGW(TAG, "%s unmount failed or not mounted: %s", storage_name(), esp_err_to_name(unmount_ret));
+            }
         }
-        ESP_LOGI(TAG, "SPIFFS partition erased successfully");
+        // Sectors are erased by the writer task just ahead of each write
     }
     
-    // Initialize crypto verification if requested
-    if (config->verify_crypto && config->expected_hash[0] != '\0') {
+    // Hash every verified upload; with no expected hash the digest is still reported
+    g_start_us = esp_timer_get_time();
+    if (config->verify_crypto) {
         mbedtls_sha256_init(&g_sha256_ctx);
         int ret = mbedtls_sha256_starts(&g_sha256_ctx, 0); // SHA256, not SHA224
         if (ret != 0) {
@@ -161,54 +502,57 @@ esp_err_t ota_start_update(const ota_config_t* config) {
         }
         g_crypto_init = true;
     }
+
+    esp_err_t writer_ret = writer_start();
+    if (writer_ret != ESP_OK) {
+        snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
+                "OTA writer start failed");
+        ota_auto_rollback();
+        return writer_ret;
+    }
     
-    ESP_LOGI(TAG, "OTA update started: type=%d, backup=%d, verify=%d, partition=%s",
+    ESP_LOGI(TAG, "OTA update started: type=%d, backup=%d, verify=%d, encoding=%s, partition=%s",
              config->update_type, config->create_backup, config->verify_crypto,
-             g_update_partition->label);
+             config->encoding == OTA_ENCODING_ZLIB ? "zlib" : "raw", g_update_partition->label);
     
     return ESP_OK;
 }
 
-esp_err_t ota_process_chunk(const uint8_t* data, size_t size) {
-    if (!data || size == 0) return ESP_ERR_INVALID_ARG;
-    
-    esp_err_t ret = ESP_OK;
-    
+static esp_err_t process_chunk(const uint8_t *data, size_t size) {    
     // Log first few bytes to help debug
     if (g_ota_status.uploaded_size == 0 && size >= 8) {
         ESP_LOGI(TAG, "First chunk: %02x %02x %02x %02x %02x %02x %02x %02x", 
                 data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7]);
     }
-    
-    if (g_ota_status.type == OTA_TYPE_FIRMWARE) {
-        // Write to OTA partition
-        ret = esp_ota_write(g_ota_handle, data, size);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "esp_ota_write failed: %s", esp_err_to_name(ret));
-            snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
-                    "OTA write failed: %s", esp_err_to_name(ret));
-            g_ota_status.state = OTA_STATE_ERROR;
-            return ret;
+
+    size_t offset = 0;
+    while (offset < size) {
+        if (g_write_err != ESP_OK) {
+            return g_write_err;
         }
-    } else {
-        // For filesystem, write directly to partition
-        size_t offset = g_ota_status.uploaded_size;
-        ret = esp_partition_write(g_update_partition, offset, data, size);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "esp_partition_write failed: %s", esp_err_to_name(ret));
+
+        // Take a free block; this only waits while both blocks are queued for flash
+        if (g_fill_block.data == NULL &&
+            xQueueReceive(g_free_blocks, &g_fill_block, pdMS_TO_TICKS(OTA_WRITER_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGE(TAG, "OTA writer stalled");
             snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
-                    "Partition write failed: %s", esp_err_to_name(ret));
+                    "Flash writer timed out");
             g_ota_status.state = OTA_STATE_ERROR;
-            return ret;
+            return ESP_ERR_TIMEOUT;
         }
-    }
-    
-    // Update crypto hash if verification is enabled
-    if (g_crypto_init) {
-        int ret = mbedtls_sha256_update(&g_sha256_ctx, data, size);
-        if (ret != 0) {
-            ESP_LOGE(TAG, "Failed to update SHA256 hash");
-            return ESP_FAIL;
+
+        size_t n = size - offset;
+        if (n > OTA_CHUNK_SIZE - g_fill_block.len) {
+            n = OTA_CHUNK_SIZE - g_fill_block.len;
+        }
+        memcpy(g_fill_block.data + g_fill_block.len, data + offset, n);
+        g_fill_block.len += n;
+        offset += n;
+
+        // Full block: hand it to the writer and keep receiving into the other one
+        if (g_fill_block.len == OTA_CHUNK_SIZE) {
+            xQueueSend(g_full_blocks, &g_fill_block, portMAX_DELAY);
+            g_fill_block.data = NULL;
         }
     }
     
@@ -218,19 +562,39 @@ esp_err_t ota_process_chunk(const uint8_t* data, size_t size) {
         g_ota_status.progress_percent = (uint8_t)((g_ota_status.uploaded_size * 100) / g_ota_status.total_size);
     }
     
-    ESP_LOGD(TAG, "Processed chunk: %d bytes, total: %d bytes", size, g_ota_status.uploaded_size);
+    ESP_LOGD(TAG, "Queued chunk: %zu bytes, total: %zu bytes", size, g_ota_status.uploaded_size);
     
     return ESP_OK;
 }
 
-esp_err_t ota_finalize_update(void) {
+static esp_err_t finalize_update(void) {
+    // Commit the last partial block and wait for every write to land
+    if (g_fill_block.data != NULL && g_fill_block.len > 0 && g_write_err == ESP_OK) {
+        xQueueSend(g_full_blocks, &g_fill_block, portMAX_DELAY);
+        g_fill_block.data = NULL;
+    }
+    esp_err_t ret = writer_stop();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "OTA writer failed: %s", esp_err_to_name(ret));
+        ota_auto_rollback();
+        return ret;
+    }
+    g_ota_status.upload_ms = (uint32_t)((esp_timer_get_time() - g_start_us) / 1000);
+    g_ota_status.flash_ms = (uint32_t)(g_flash_us / 1000);
+    g_ota_status.hash_ms = (uint32_t)(g_hash_us / 1000);
+    g_ota_status.image_size = g_write_offset;
+    if (g_ota_config.encoding == OTA_ENCODING_ZLIB) {
+        ESP_LOGI(TAG, "Inflated %zu uploaded bytes to %zu", g_ota_status.uploaded_size, g_write_offset);
+    }
+    ESP_LOGI(TAG, "All %zu bytes committed in %lu ms (flash %lu ms, SHA-256 %lu ms)", g_write_offset,
+             (unsigned long)g_ota_status.upload_ms, (unsigned long)g_ota_status.flash_ms,
+             (unsigned long)g_ota_status.hash_ms);
+
     g_ota_status.state = OTA_STATE_VERIFYING;
     g_ota_status.progress_percent = 90;
     
-    esp_err_t ret = ESP_OK;
-    
     // Perform crypto verification if requested
-    if (g_crypto_init && g_ota_config.expected_hash[0] != '\0') {
+    if (g_crypto_init) {
         ESP_LOGI(TAG, "Verifying uploaded image hash...");
         
         unsigned char computed_hash[32];
@@ -247,9 +611,16 @@ esp_err_t ota_finalize_update(void) {
             return ESP_FAIL;
         }
         
+        for (int i = 0; i < OTA_HASH_LEN; i++) {
+            snprintf(&g_ota_status.computed_hash[i * 2], 3, "%02x", computed_hash[i]);
+        }
+        ESP_LOGI(TAG, "Image SHA-256: %s", g_ota_status.computed_hash);
+
         // Convert expected hash from hex string to binary
         unsigned char expected_hash[32];
-        if (strlen(g_ota_config.expected_hash) == 64) {
+        if (g_ota_config.expected_hash[0] == '\0') {
+            ESP_LOGW(TAG, "No expected hash supplied, image integrity not checked");
+        } else if (strlen(g_ota_config.expected_hash) == 64) {
             for (int i = 0; i < 32; i++) {
                 char byte_str[3] = { g_ota_config.expected_hash[i*2], g_ota_config.expected_hash[i*2+1], '\0' };
                 expected_hash[i] = (unsigned char)strtoul(byte_str, NULL, 16);
@@ -266,6 +637,7 @@ esp_err_t ota_finalize_update(void) {
                 ota_auto_rollback();
                 return ESP_ERR_INVALID_CRC;
             }
+            g_ota_status.hash_verified = true;
             ESP_LOGI(TAG, "Hash verification successful");
         } else {
             ESP_LOGW(TAG, "Invalid hash format, skipping verification");
@@ -285,6 +657,23 @@ esp_err_t ota_finalize_update(void) {
             g_ota_status.state = OTA_STATE_ERROR;
             return ret;
         }
+
+        // Node firmware stays in the slot for the gateway role to send out; this board keeps its own
+        if (g_ota_config.for_nodes) {
+            ret = espnow_ota_stage(g_update_partition, g_write_offset);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Staging node firmware failed: %s", esp_err_to_name(ret));
+                snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
+                        "Staging node firmware failed: %s", esp_err_to_name(ret));
+                g_ota_status.state = OTA_STATE_ERROR;
+                return ret;
+            }
+            g_ota_status.reboot_required = false;
+            g_ota_status.state = OTA_STATE_SUCCESS;
+            g_ota_status.progress_percent = 100;
+            ESP_LOGI(TAG, "Node firmware staged in %s", g_update_partition->label);
+            return ESP_OK;
+        }
         
         // Set boot partition to the new firmware
         ret = esp_ota_set_boot_partition(g_update_partition);
@@ -306,17 +695,26 @@ esp_err_t ota_finalize_update(void) {
         g_ota_status.reboot_required = true;
         
     } else {
-        // For filesystem updates, we need to ensure data is flushed
-        ESP_LOGI(TAG, "Filesystem update completed - flushing data");
-        
-        // Ensure all data is written to flash
-        if (g_update_partition) {
-            // The data should already be written via esp_partition_write calls
-            ESP_LOGI(TAG, "Filesystem data written to partition: %s", g_update_partition->label);
+        // Images from the build span the whole partition; a shorter one must not
+        // leave stale pages or blocks from the old filesystem behind it
+        if (g_erased_to < g_update_partition->size) {
+            ESP_LOGI(TAG, "Erasing %zu bytes past the end of the image", g_update_partition->size - g_erased_to);
+            ret = long_op_erase(g_update_partition, g_erased_to, g_update_partition->size - g_erased_to,
+                                LONG_OP_OTA_ERASE);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to erase %s tail: %s", storage_name(), esp_err_to_name(ret));
+                snprintf(g_ota_status.error_message, sizeof(g_ota_status.error_message), 
+                        "%s erase failed: %s", storage_name(), esp_err_to_name(ret));
+                g_ota_status.state = OTA_STATE_ERROR;
+                return ret;
+            }
         }
-        
-        ESP_LOGI(TAG, "Filesystem update completed - reboot required");
-        g_ota_status.reboot_required = true;
+        ESP_LOGI(TAG, "Filesystem data written to partition: %s", g_update_partition->label);
+
+        // A spare slot is switched to by the caller (web_server.c); the mounted one needs a reboot
+        g_ota_status.reboot_required = strcmp(g_update_partition->label, storage_active_label()) == 0;
+        ESP_LOGI(TAG, "Filesystem update completed - %s", g_ota_status.reboot_required ? "reboot required"
+                                                                                      : "ready to switch slots");
     }
     
     g_ota_status.state = OTA_STATE_SUCCESS;
@@ -326,22 +724,109 @@ esp_err_t ota_finalize_update(void) {
     return ESP_OK;
 }
 
+esp_err_t ota_start_update(const ota_config_t* config) {
+    if (!config) return ESP_ERR_INVALID_ARG;
+    esp_err_t ret = start_update(config);
+    publish_status();
+    return ret;
+}
+
+esp_err_t ota_process_chunk(const uint8_t* data, size_t size) {
+    if (!data || size == 0) return ESP_ERR_INVALID_ARG;
+    if (!g_writer_running) return ESP_ERR_INVALID_STATE;
+    esp_err_t ret = process_chunk(data, size);
+    publish_status();
+    return ret;
+}
+
+esp_err_t ota_finalize_update(void) {
+    esp_err_t ret = finalize_update();
+    publish_status();
+    return ret;
+}
+
 esp_err_t ota_get_status(ota_status_t* status) {
     if (!status) return ESP_ERR_INVALID_ARG;
-    memcpy(status, &g_ota_status, sizeof(ota_status_t));
+    uint32_t seq;
+    do {
+        // An odd sequence means an update is mid-copy on the other core
+        while ((seq = __atomic_load_n(&g_status_seq, __ATOMIC_ACQUIRE)) & 1U) {
+        }
+        memcpy(status, &g_status_snapshot, sizeof(ota_status_t));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&g_status_seq, __ATOMIC_RELAXED) != seq);
     return ESP_OK;
 }
 
+void ota_write_status_json(json_writer_t *w, const ota_status_t *status) {
+    json_kv_int(w, "state", status->state);
+    json_kv_str(w, "phase", ota_state_name(status->state));
+    json_kv_int(w, "type", status->type);
+    json_kv_int(w, "progress", status->progress_percent);
+    json_kv_uint(w, "uploaded", status->uploaded_size);
+    json_kv_uint(w, "total", status->total_size);
+    json_kv_uint(w, "written", status->written_size);
+    json_kv_uint(w, "rate_bps", status->rate_bps);
+    json_kv_uint(w, "eta_s", status->eta_s);
+    json_kv_str(w, "error", status->error_message);
+    json_kv_str(w, "sha256", status->computed_hash);
+    json_kv_bool(w, "hash_verified", status->hash_verified);
+    json_kv_uint(w, "upload_ms", status->upload_ms);
+    json_kv_uint(w, "flash_ms", status->flash_ms);
+    json_kv_uint(w, "hash_ms", status->hash_ms);
+    json_kv_uint(w, "image_size", status->image_size);
+}
+
+const char *ota_state_name(ota_state_t state) {
+    if ((unsigned)state >= sizeof(STATE_NAMES) / sizeof(STATE_NAMES[0])) {
+        return "unknown";
+    }
+    return STATE_NAMES[state];
+}
+
 esp_err_t ota_create_backup(ota_type_t type) {
-    // For now, we just mark backup available; actual streaming is handled by web handler
+    const esp_partition_t *partition;
+    size_t size;
+    esp_err_t ret = ota_get_backup_extent(type, &partition, &size);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "No %s backup: %s", type == OTA_TYPE_FILESYSTEM ? "filesystem" : "firmware",
+                 esp_err_to_name(ret));
+        return ret;
+    }
+    // The web server's task is the only writer while no update runs
     g_ota_status.backup_available = true;
     g_ota_status.backup_created = true;
-    ESP_LOGI(TAG, "Backup flagged available for type=%d", type);
+    publish_status();
+    ESP_LOGI(TAG, "Backup of %s: %zu bytes", partition->label, size);
     return ESP_OK;
 }
 
 bool ota_is_backup_available(ota_type_t type) {
-    return g_ota_status.backup_available;
+    const esp_partition_t *partition;
+    size_t size;
+    return ota_get_backup_extent(type, &partition, &size) == ESP_OK;
+}
+
+esp_err_t ota_get_backup_extent(ota_type_t type, const esp_partition_t **partition, size_t *size) {
+    if (!partition || !size) return ESP_ERR_INVALID_ARG;
+    esp_err_t ret = ota_get_partition_info(type, partition);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (type == OTA_TYPE_FILESYSTEM) {
+        *size = (*partition)->size;
+        return ESP_OK;
+    }
+
+    // Reads the segment headers only; the image was verified when it booted
+    const esp_partition_pos_t pos = { .offset = (*partition)->address, .size = (*partition)->size };
+    esp_image_metadata_t meta;
+    ret = esp_image_get_metadata(&pos, &meta);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    *size = meta.image_len;
+    return ESP_OK;
 }
 
 esp_err_t ota_verify_crypto(const uint8_t* data, size_t len, const uint8_t* expected_hash) {
@@ -358,7 +843,16 @@ esp_err_t ota_verify_crypto(const uint8_t* data, size_t len, const uint8_t* expe
 }
 
 esp_err_t ota_auto_rollback(void) {
+    esp_err_t ret = auto_rollback();
+    publish_status();
+    return ret;
+}
+
+static esp_err_t auto_rollback(void) {
     ESP_LOGW(TAG, "Automatic rollback initiated");
+
+    // Nothing may still be writing to the partition we are about to abandon
+    writer_stop();
     
     if (g_ota_status.type == OTA_TYPE_FIRMWARE) {
         // Cancel current OTA operation
@@ -415,7 +909,7 @@ esp_err_t ota_get_partition_info(ota_type_t type, const esp_partition_t** partit
     if (type == OTA_TYPE_FIRMWARE) {
         *partition = esp_ota_get_running_partition();
     } else {
-        *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, "spiffs");
+        *partition = storage_find_partition(storage_active_label());
     }
     return (*partition) ? ESP_OK : ESP_ERR_NOT_FOUND;
 }
@@ -0,0 +1,524 @@
+/**
+ * @file ota_pull.c
+ * @brief Gateway firmware and node images pulled over HTTPS from a manifest, with Range resume
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "ota_pull.h"
+#include "espnow_ota.h"
+#include "json_reader.h"
+#include "ota_manager.h"
+#include "static_mem.h"
+#include "version.h"
+#include "wifi_ap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_app_desc.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register ota_pull.c version
+REGISTER_VERSION(OtaPull, "1.0.0", "2026-10-15");
+
+static const char *TAG = "OTA_PULL";
+
+#define STOP_BIT (1U << 0)
+#define CHECK_BIT (1U << 1)
+#define STOP_TIMEOUT_MS (OTA_PULL_TIMEOUT_MS + 2000)  // A read in progress times out first
+
+/**
+ * @brief One manifest entry
+ */
+typedef struct {
+    bool present;
+    char version[OTA_PULL_VERSION_MAX];
+    char url[OTA_PULL_URL_MAX];
+    char sha256[OTA_HASH_STR_LEN];
+    size_t size;
+    ota_encoding_t encoding;
+} pull_image_t;
+
+typedef struct {
+    pull_image_t gateway;
+    pull_image_t node;
+    pull_image_t *current;                      // Entry whose members are being read
+} manifest_t;
+
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(pull_task_slot, OTA_PULL_TASK_STACK_SIZE);
+static SemaphoreHandle_t stopped_sem = NULL;
+static volatile bool stopping = false;
+static ota_pull_slot_fn_t slot_hook = NULL;
+static char *read_buf = NULL;
+
+// Hashes of images that failed; skipped until the manifest names another image
+static char refused_gateway[OTA_HASH_STR_LEN];
+static char refused_node[OTA_HASH_STR_LEN];
+
+static ota_pull_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_http_client_handle_t open_url(const char *url, size_t offset, int *status, int64_t *length);
+static esp_err_t on_manifest_event(void *ctx, const json_event_t *event);
+static esp_err_t fetch_manifest(manifest_t *m);
+static esp_err_t fetch_from(const pull_image_t *img, size_t *received, bool *fatal);
+static esp_err_t download(const pull_image_t *img, bool for_nodes);
+static bool refuse_after(esp_err_t err);
+static void check(void);
+static void pull_task(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Open a GET, from offset onwards when it is not 0, and read the response headers
+ *
+ * @return esp_http_client_handle_t The open client, or NULL with *status 0 when there was no answer
+ */
+static esp_http_client_handle_t open_url(const char *url, size_t offset, int *status, int64_t *length) {
+    esp_http_client_config_t config = {
+        .url = url,
+        .method = HTTP_METHOD_GET,
+        .timeout_ms = OTA_PULL_TIMEOUT_MS,
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        .crt_bundle_attach = esp_crt_bundle_attach,
+#endif
+    };
+    *status = 0;
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        return NULL;
+    }
+    if (offset > 0) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%zu-", offset);
+        esp_http_client_set_header(client, "Range", range);
+    }
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err == ESP_OK) {
+        *length = esp_http_client_fetch_headers(client);
+        *status = esp_http_client_get_status_code(client);
+    }
+    if (err != ESP_OK || *length < 0) {
+        ESP_LOGW(TAG, "GET %s: %s", url, esp_err_to_name(err != ESP_OK ? err : ESP_FAIL));
+        esp_http_client_cleanup(client);
+        *status = 0;
+        return NULL;
+    }
+    return client;
+}
+
+/**
+ * @brief Fill the manifest from the reader's events; unknown members are ignored
+ */
+static esp_err_t on_manifest_event(void *ctx, const json_event_t *event) {
+    manifest_t *m = ctx;
+    if (event->depth == 1) {
+        m->current = NULL;
+        if (event->type == JSON_EVENT_OBJECT_BEGIN && event->key != NULL) {
+            if (strcmp(event->key, "gateway") == 0) {
+                m->current = &m->gateway;
+            } else if (strcmp(event->key, "node") == 0) {
+                m->current = &m->node;
+            }
+            if (m->current != NULL) {
+                memset(m->current, 0, sizeof(*m->current));
+                m->current->present = true;
+            }
+        }
+        return ESP_OK;
+    }
+    if (event->depth != 2 || m->current == NULL || event->key == NULL || event->value == NULL) {
+        return ESP_OK;
+    }
+
+    pull_image_t *img = m->current;
+    if (event->type == JSON_EVENT_STRING && strcmp(event->key, "version") == 0) {
+        strlcpy(img->version, event->value, sizeof(img->version));
+    } else if (event->type == JSON_EVENT_STRING && strcmp(event->key, "url") == 0) {
+        strlcpy(img->url, event->value, sizeof(img->url));
+    } else if (event->type == JSON_EVENT_STRING && strcmp(event->key, "sha256") == 0) {
+        if (event->value_len == OTA_HASH_STR_LEN - 1) {
+            strlcpy(img->sha256, event->value, sizeof(img->sha256));
+        }
+    } else if (event->type == JSON_EVENT_NUMBER && strcmp(event->key, "size") == 0) {
+        img->size = (size_t)strtoul(event->value, NULL, 10);
+    } else if (event->type == JSON_EVENT_STRING && strcmp(event->key, "encoding") == 0) {
+        img->encoding = strcmp(event->value, "zlib") == 0 ? OTA_ENCODING_ZLIB : OTA_ENCODING_RAW;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief GET the manifest and parse it as it arrives
+ */
+static esp_err_t fetch_manifest(manifest_t *m) {
+    memset(m, 0, sizeof(*m));
+    int status;
+    int64_t length;
+    esp_http_client_handle_t client = open_url(OTA_PULL_MANIFEST_URL, 0, &status, &length);
+    if (client == NULL) {
+        return ESP_FAIL;
+    }
+    if (status != 200) {
+        ESP_LOGW(TAG, "Manifest: HTTP %d", status);
+        esp_http_client_cleanup(client);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    json_reader_t reader;
+    json_reader_init(&reader, on_manifest_event, m);
+    esp_err_t err = ESP_OK;
+    int n = 0;
+    while (err == ESP_OK && (n = esp_http_client_read(client, read_buf, OTA_PULL_READ_BYTES)) > 0) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.manifest_bytes += (uint32_t)n;
+        portEXIT_CRITICAL(&stats_lock);
+        err = json_reader_feed(&reader, read_buf, (size_t)n);
+    }
+    if (err == ESP_OK) {
+        err = n < 0 ? ESP_FAIL : json_reader_finish(&reader);
+    }
+    esp_http_client_cleanup(client);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Manifest unreadable: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+/**
+ * @brief Stream the image from *received onwards into the OTA writer
+ *
+ * @param fatal Set when trying again cannot help: the server's answer, or the writer failed
+ * @return esp_err_t ESP_OK once the whole image was read, the error otherwise
+ */
+static esp_err_t fetch_from(const pull_image_t *img, size_t *received, bool *fatal) {
+    *fatal = false;
+    int status;
+    int64_t length;
+    esp_http_client_handle_t client = open_url(img->url, *received, &status, &length);
+    if (client == NULL) {
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (*received > 0 && status == 200) {
+        // The whole file again; on a metered link that is worse than failing
+        ESP_LOGE(TAG, "Server ignored the Range request; not downloading %s twice", img->url);
+        err = ESP_ERR_NOT_SUPPORTED;
+        *fatal = true;
+    } else if (status != (*received > 0 ? 206 : 200)) {
+        ESP_LOGW(TAG, "GET %s: HTTP %d", img->url, status);
+        err = ESP_ERR_INVALID_RESPONSE;
+        *fatal = status < 500;
+    }
+
+    while (err == ESP_OK && !stopping) {
+        int n = esp_http_client_read(client, read_buf, OTA_PULL_READ_BYTES);
+        if (n < 0) {
+            err = ESP_FAIL;
+            break;
+        }
+        if (n == 0) {
+            // A connection that closed early looks the same as the end of the body
+            if (!esp_http_client_is_complete_data_received(client) || (img->size > 0 && *received < img->size)) {
+                err = ESP_ERR_INVALID_SIZE;
+            }
+            break;
+        }
+        err = ota_process_chunk((const uint8_t *)read_buf, (size_t)n);
+        if (err != ESP_OK) {
+            *fatal = true;
+            break;
+        }
+        *received += (size_t)n;
+        portENTER_CRITICAL(&stats_lock);
+        stats.bytes += (uint32_t)n;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+    if (stopping && err == ESP_OK) {
+        err = ESP_ERR_INVALID_STATE;
+        *fatal = true;
+    }
+    esp_http_client_cleanup(client);
+    return err;
+}
+
+/**
+ * @brief Download one image through the OTA writer, resuming after dropped connections
+ */
+static esp_err_t download(const pull_image_t *img, bool for_nodes) {
+    ota_config_t cfg = {
+        .create_backup = false,
+        .verify_crypto = true,
+        .update_type = OTA_TYPE_FIRMWARE,
+        .encoding = img->encoding,
+        .total_size = img->size,
+        .for_nodes = for_nodes,
+    };
+    strlcpy(cfg.expected_hash, img->sha256, sizeof(cfg.expected_hash));
+    esp_err_t err = ota_start_update(&cfg);
+    if (err != ESP_OK) {
+        return err;
+    }
+    ESP_LOGI(TAG, "Downloading %s %s (%zu bytes) from %s", for_nodes ? "node firmware" : "gateway firmware",
+             img->version, img->size, img->url);
+
+    size_t received = 0;
+    uint32_t pause_ms = OTA_PULL_RESUME_MS;
+    bool fatal = false;
+    for (int attempt = 0; attempt <= OTA_PULL_RESUMES; attempt++) {
+        if (attempt > 0) {
+            ESP_LOGW(TAG, "Connection lost at %zu bytes, resuming in %lu s", received,
+                     (unsigned long)(pause_ms / 1000));
+            // A stop cuts the pause short
+            xTaskNotifyWait(0, 0, NULL, pdMS_TO_TICKS(pause_ms));
+            if (stopping) {
+                err = ESP_ERR_INVALID_STATE;
+                break;
+            }
+            pause_ms *= 2;
+            portENTER_CRITICAL(&stats_lock);
+            stats.resumes++;
+            portEXIT_CRITICAL(&stats_lock);
+        }
+        err = fetch_from(img, &received, &fatal);
+        if (err == ESP_OK || fatal) {
+            break;
+        }
+    }
+
+    if (err != ESP_OK) {
+        ota_auto_rollback();
+        return err;
+    }
+    return ota_finalize_update();
+}
+
+/**
+ * @brief Whether a failed image would fail the same way again (as opposed to the link failing)
+ */
+static bool refuse_after(esp_err_t err) {
+    return err == ESP_ERR_INVALID_CRC || err == ESP_ERR_INVALID_VERSION || err == ESP_ERR_NOT_SUPPORTED;
+}
+
+/**
+ * @brief Read the manifest and pull what differs from what runs and what is staged
+ */
+static void check(void) {
+    static manifest_t m;                        // Only the pull task uses it
+    esp_err_t err = fetch_manifest(&m);
+    portENTER_CRITICAL(&stats_lock);
+    if (err == ESP_OK) {
+        stats.checks++;
+    } else {
+        stats.check_failures++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    if (err != ESP_OK) {
+        return;
+    }
+
+    ota_status_t os;
+    ota_get_status(&os);
+    if (os.state == OTA_STATE_UPLOADING || os.state == OTA_STATE_VERIFYING || os.state == OTA_STATE_FLASHING) {
+        ESP_LOGI(TAG, "An update is already being written; checking again later");
+        return;
+    }
+
+    const esp_app_desc_t *running = esp_app_get_description();
+    const pull_image_t *gw = &m.gateway;
+    if (gw->present && gw->url[0] != '\0' && gw->sha256[0] != '\0' && strcmp(gw->version, running->version) != 0) {
+        // An image boot_health rolled back stays refused, even across reboots
+        const esp_partition_t *invalid = esp_ota_get_last_invalid_partition();
+        esp_app_desc_t desc;
+        bool rolled_back = invalid != NULL && esp_ota_get_partition_description(invalid, &desc) == ESP_OK &&
+                           strcmp(desc.version, gw->version) == 0;
+        if (rolled_back || strcmp(gw->sha256, refused_gateway) == 0) {
+            portENTER_CRITICAL(&stats_lock);
+            stats.refused++;
+            portEXIT_CRITICAL(&stats_lock);
+            ESP_LOGI(TAG, "Gateway firmware %s %s; staying on %s", gw->version,
+                     rolled_back ? "was rolled back" : "failed before", running->version);
+        } else {
+            if (slot_hook != NULL) {
+                slot_hook(true);
+            }
+            err = download(gw, false);
+            const esp_partition_t *boot = esp_ota_get_boot_partition();
+            if (err == ESP_OK && (boot == NULL || esp_ota_get_partition_description(boot, &desc) != ESP_OK ||
+                                  strcmp(desc.version, gw->version) != 0)) {
+                // Booting it would only bring the same download back on the next check
+                ESP_LOGE(TAG, "Image is version %s, not the manifest's %s", desc.version, gw->version);
+                esp_ota_set_boot_partition(esp_ota_get_running_partition());
+                err = ESP_ERR_INVALID_VERSION;
+            }
+            if (err == ESP_OK) {
+                portENTER_CRITICAL(&stats_lock);
+                stats.gateway_updates++;
+                portEXIT_CRITICAL(&stats_lock);
+                ESP_LOGI(TAG, "Gateway firmware %s written; restarting into it", gw->version);
+                ota_reboot_system();
+            }
+            if (refuse_after(err)) {
+                strlcpy(refused_gateway, gw->sha256, sizeof(refused_gateway));
+            }
+            portENTER_CRITICAL(&stats_lock);
+            stats.failures++;
+            portEXIT_CRITICAL(&stats_lock);
+            ESP_LOGW(TAG, "Gateway firmware %s not installed: %s", gw->version, esp_err_to_name(err));
+            if (slot_hook != NULL) {
+                slot_hook(false);
+            }
+        }
+        return;                                 // The node image waits until the gateway runs the manifest's
+    }
+
+    const pull_image_t *node = &m.node;
+    if (!node->present || node->url[0] == '\0' || node->sha256[0] == '\0') {
+        return;
+    }
+    espnow_ota_stats_t ns;
+    espnow_ota_get_stats(&ns);
+    if (ns.staged && strcmp(ns.version, node->version) == 0) {
+        return;
+    }
+    if (strcmp(node->sha256, refused_node) == 0) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.refused++;
+        portEXIT_CRITICAL(&stats_lock);
+        return;
+    }
+    // The inactive slot still holds the firmware to roll back to until this one is confirmed
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) == ESP_OK &&
+        state == ESP_OTA_IMG_PENDING_VERIFY) {
+        ESP_LOGI(TAG, "Node firmware %s waits until this firmware is confirmed", node->version);
+        return;
+    }
+
+    if (slot_hook != NULL) {
+        slot_hook(true);
+    }
+    err = download(node, true);
+    if (slot_hook != NULL) {
+        slot_hook(false);
+    }
+    espnow_ota_get_stats(&ns);
+    if (err == ESP_OK && ns.staged && strcmp(ns.version, node->version) != 0) {
+        ESP_LOGE(TAG, "Node image is version %s, not the manifest's %s", ns.version, node->version);
+        err = ESP_ERR_INVALID_VERSION;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    if (err == ESP_OK) {
+        stats.node_images++;
+    } else {
+        stats.failures++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Node firmware %s staged", node->version);
+    } else {
+        ESP_LOGW(TAG, "Node firmware %s not staged: %s", node->version, esp_err_to_name(err));
+        if (refuse_after(err)) {
+            strlcpy(refused_node, node->sha256, sizeof(refused_node));
+        }
+    }
+}
+
+static void pull_task(void *arg) {
+    (void)arg;
+    uint32_t wait_ms = OTA_PULL_FIRST_MS;
+    while (!stopping) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, STOP_BIT | CHECK_BIT, &bits, pdMS_TO_TICKS(wait_ms));
+        if (stopping || (bits & STOP_BIT) != 0) {
+            break;
+        }
+        wifi_sta_status_t sta;
+        wifi_ap_get_sta_status(&sta);
+        if (sta.state != WIFI_STA_CONNECTED) {
+            wait_ms = OTA_PULL_OFFLINE_MS;
+            continue;
+        }
+        check();
+        wait_ms = OTA_PULL_INTERVAL_MS;
+    }
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t ota_pull_start(ota_pull_slot_fn_t slot_fn) {
+    if (task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (read_buf == NULL) {
+        read_buf = malloc(OTA_PULL_READ_BYTES);
+    }
+    if (stopped_sem == NULL) {
+        stopped_sem = xSemaphoreCreateBinary();
+    }
+    if (read_buf == NULL || stopped_sem == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(&stats, 0, sizeof(stats));
+    slot_hook = slot_fn;
+    stopping = false;
+    if (static_task_create(pull_task_slot, pull_task, OTA_PULL_TASK_NAME, OTA_PULL_TASK_STACK_SIZE, NULL,
+                           OTA_PULL_TASK_PRIORITY, &task_handle, TASK_CORE_NET) != pdPASS) {
+        task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    stats.running = true;
+    ESP_LOGI(TAG, "Checking %s every %d h", OTA_PULL_MANIFEST_URL, OTA_PULL_INTERVAL_MS / 3600000);
+    return ESP_OK;
+}
+
+void ota_pull_stop(void) {
+    if (task_handle == NULL) {
+        return;
+    }
+    stopping = true;
+    xTaskNotify(task_handle, STOP_BIT, eSetBits);
+    if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(STOP_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Pull task did not stop within %d ms", STOP_TIMEOUT_MS);
+        return;
+    }
+    task_handle = NULL;
+    free(read_buf);
+    read_buf = NULL;
+    stats.running = false;
+}
+
+void ota_pull_check_now(void) {
+    if (task_handle != NULL) {
+        xTaskNotify(task_handle, CHECK_BIT, eSetBits);
+    }
+}
+
+void ota_pull_get_stats(ota_pull_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
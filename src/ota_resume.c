@@ -0,0 +1,372 @@
+/**
+ * @file ota_resume.c
+ * @brief Resumable chunked OTA uploads with progress persisted in NVS
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "ota_resume.h"
+#include "version.h"
+#include "flash_io.h"
+#include "storage.h"
+#include "http_arena.h"
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register ota_resume.c version
+REGISTER_VERSION(OtaResume, "1.0.0", "2026-10-14");
+static const char *TAG = "OTA_RESUME";
+
+#define RESUME_RECORD_MAGIC 0x4F524531u         // "ORE1"; change whenever resume_record_t changes
+#define RESUME_NVS_KEY "session"
+#define RESUME_SECTOR_SIZE 4096
+#define RESUME_HASH_READ_SIZE 4096              // Read-back buffer for the final hash
+
+_Static_assert(OTA_RESUME_CHUNK_SIZE % RESUME_SECTOR_SIZE == 0, "chunks must cover whole flash sectors");
+
+// Everything needed to pick an upload up again, stored as one NVS blob.
+// The partition address guards against the boot slot changing in between.
+typedef struct {
+    uint32_t magic;
+    uint32_t partition_address;
+    uint32_t image_size;
+    uint32_t chunk_size;
+    uint8_t type;
+    char expected_hash[OTA_HASH_STR_LEN];
+    uint8_t bitmap[OTA_RESUME_MAX_CHUNKS / 8];  // Bit n set = chunk n is in flash
+} resume_record_t;
+
+// Session state; only touched from the httpd task
+static resume_record_t s_record;
+static const esp_partition_t *s_partition = NULL;
+static bool s_active = false;
+static bool s_loaded = false;
+
+// =============================
+// Function Prototypes
+// =============================
+static const esp_partition_t *target_partition(ota_type_t type);
+static uint32_t chunk_count(void);
+static uint32_t chunks_done(void);
+static void load_session(void);
+static esp_err_t save_session(void);
+static esp_err_t clear_session(void);
+static void release_spiffs(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+static const esp_partition_t *target_partition(ota_type_t type) {
+    if (type == OTA_TYPE_FIRMWARE) {
+        return esp_ota_get_next_update_partition(NULL);
+    }
+    const char *spare = storage_spare_label();
+    return storage_find_partition(spare != NULL ? spare : storage_active_label());
+}
+
+static uint32_t chunk_count(void) {
+    return (s_record.image_size + s_record.chunk_size - 1) / s_record.chunk_size;
+}
+
+static uint32_t chunks_done(void) {
+    uint32_t done = 0;
+    uint32_t total = chunk_count();
+    for (uint32_t i = 0; i < total; i++) {
+        if (s_record.bitmap[i / 8] & (1U << (i % 8))) {
+            done++;
+        }
+    }
+    return done;
+}
+
+/**
+ * @brief Pick up a session left by an earlier connection or boot (first call only)
+ */
+static void load_session(void) {
+    if (s_loaded) {
+        return;
+    }
+    s_loaded = true;
+
+    nvs_handle_t handle;
+    if (nvs_open(OTA_RESUME_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;  // Namespace not created yet: no session
+    }
+    size_t len = sizeof(s_record);
+    esp_err_t err = nvs_get_blob(handle, RESUME_NVS_KEY, &s_record, &len);
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        return;
+    }
+
+    const esp_partition_t *part = target_partition((ota_type_t)s_record.type);
+    if (len != sizeof(s_record) || s_record.magic != RESUME_RECORD_MAGIC ||
+        s_record.chunk_size != OTA_RESUME_CHUNK_SIZE || chunk_count() > OTA_RESUME_MAX_CHUNKS || part == NULL ||
+        part->address != s_record.partition_address || s_record.image_size > part->size) {
+        ESP_LOGW(TAG, "Discarding stale upload session");
+        clear_session();
+        return;
+    }
+
+    s_partition = part;
+    s_active = true;
+    ESP_LOGI(TAG, "Resumable %s upload pending: %" PRIu32 "/%" PRIu32 " chunks",
+             s_record.type == OTA_TYPE_FILESYSTEM ? "filesystem" : "firmware", chunks_done(), chunk_count());
+}
+
+static esp_err_t save_session(void) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(OTA_RESUME_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
+        return err;
+    }
+    err = flash_io_nvs_set_blob(handle, RESUME_NVS_KEY, &s_record, sizeof(s_record));
+    if (err == ESP_OK) {
+        err = flash_io_nvs_commit(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store upload session: %s", esp_err_to_name(err));
+    }
+    nvs_close(handle);
+    return err;
+}
+
+static esp_err_t clear_session(void) {
+    memset(&s_record, 0, sizeof(s_record));
+    s_partition = NULL;
+    s_active = false;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(OTA_RESUME_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_erase_key(handle, RESUME_NVS_KEY);
+    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
+        err = flash_io_nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+/**
+ * @brief The filesystem must not be mounted while its partition is rewritten underneath it
+ *
+ * Only with a single-slot table; otherwise the upload goes to the spare slot.
+ */
+static void release_spiffs(void) {
+    if (storage_spare_label() == NULL && storage_mounted()) {
+        ESP_LOGI(TAG, "Unmounting %s for the filesystem upload", storage_name());
+        storage_unmount();
+    }
+}
+
+esp_err_t ota_resume_begin(ota_type_t type, uint32_t image_size, const char *expected_hash, bool restart) {
+    load_session();
+
+    char hash[OTA_HASH_STR_LEN] = "";
+    if (expected_hash != NULL) {
+        size_t i = 0;
+        for (; expected_hash[i] != '\0' && i < sizeof(hash) - 1; i++) {
+            hash[i] = (char)tolower((unsigned char)expected_hash[i]);
+        }
+        hash[i] = '\0';
+    }
+
+    if (s_active && s_record.type == type && s_record.image_size == image_size &&
+        strcmp(s_record.expected_hash, hash) == 0) {
+        return ESP_OK;
+    }
+    if (s_active && !restart) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const esp_partition_t *part = target_partition(type);
+    if (part == NULL) {
+        ESP_LOGE(TAG, "No target partition for the upload");
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (image_size == 0 || image_size > part->size ||
+        (image_size + OTA_RESUME_CHUNK_SIZE - 1) / OTA_RESUME_CHUNK_SIZE > OTA_RESUME_MAX_CHUNKS) {
+        ESP_LOGE(TAG, "Image of %" PRIu32 " bytes does not fit %s", image_size, part->label);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memset(&s_record, 0, sizeof(s_record));
+    s_record.magic = RESUME_RECORD_MAGIC;
+    s_record.partition_address = part->address;
+    s_record.image_size = image_size;
+    s_record.chunk_size = OTA_RESUME_CHUNK_SIZE;
+    s_record.type = (uint8_t)type;
+    strlcpy(s_record.expected_hash, hash, sizeof(s_record.expected_hash));
+    s_partition = part;
+    s_active = true;
+
+    if (type == OTA_TYPE_FILESYSTEM) {
+        release_spiffs();
+    }
+    ESP_LOGI(TAG, "New chunked upload to %s: %" PRIu32 " bytes in %" PRIu32 " chunks",
+             part->label, image_size, chunk_count());
+    return save_session();
+}
+
+esp_err_t ota_resume_write(uint32_t offset, const uint8_t *data, size_t len) {
+    load_session();
+    if (!s_active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (data == NULL || offset % s_record.chunk_size != 0 || offset >= s_record.image_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t remaining = s_record.image_size - offset;
+    if (len != (remaining < s_record.chunk_size ? remaining : s_record.chunk_size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (s_record.type == OTA_TYPE_FILESYSTEM) {
+        if (offset == 0 && storage_check_image(data, len) == ESP_ERR_NOT_SUPPORTED) {
+            ESP_LOGE(TAG, "Filesystem image is not %s", storage_name());
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        release_spiffs();  // May have been mounted again by a reboot before the session was known
+    }
+
+    size_t erase_len = (len + RESUME_SECTOR_SIZE - 1) & ~(size_t)(RESUME_SECTOR_SIZE - 1);
+    esp_err_t err = flash_io_erase(FLASH_IO_OTA, s_partition, offset, erase_len);
+    if (err == ESP_OK) {
+        err = flash_io_write(FLASH_IO_OTA, s_partition, offset, data, len);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Chunk at %" PRIu32 " failed: %s", offset, esp_err_to_name(err));
+        return err;
+    }
+
+    uint32_t index = offset / s_record.chunk_size;
+    s_record.bitmap[index / 8] |= (uint8_t)(1U << (index % 8));
+    ESP_LOGD(TAG, "Chunk %" PRIu32 " committed (%" PRIu32 "/%" PRIu32 ")", index, chunks_done(), chunk_count());
+    return save_session();
+}
+
+esp_err_t ota_resume_finalize(char computed_hash[OTA_HASH_STR_LEN]) {
+    load_session();
+    if (!s_active || chunks_done() != chunk_count()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t *buf = http_arena_malloc(RESUME_HASH_READ_SIZE);
+    if (buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Hash what actually landed in flash, not what was received
+    unsigned char digest[OTA_HASH_LEN];
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    esp_err_t err = ESP_OK;
+    for (uint32_t pos = 0; pos < s_record.image_size && err == ESP_OK; pos += RESUME_HASH_READ_SIZE) {
+        uint32_t n = s_record.image_size - pos;
+        if (n > RESUME_HASH_READ_SIZE) {
+            n = RESUME_HASH_READ_SIZE;
+        }
+        err = flash_io_read(FLASH_IO_OTA, s_partition, pos, buf, n);
+        if (err == ESP_OK) {
+            mbedtls_sha256_update(&sha, buf, n);
+        }
+    }
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    http_arena_free(buf);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Image read-back failed: %s", esp_err_to_name(err));
+        clear_session();
+        return err;
+    }
+
+    char hex[OTA_HASH_STR_LEN];
+    for (int i = 0; i < OTA_HASH_LEN; i++) {
+        snprintf(&hex[i * 2], 3, "%02x", digest[i]);
+    }
+    if (computed_hash != NULL) {
+        strlcpy(computed_hash, hex, OTA_HASH_STR_LEN);
+    }
+    ESP_LOGI(TAG, "Chunked image complete, SHA-256 %s", hex);
+
+    if (s_record.expected_hash[0] != '\0' && strcmp(hex, s_record.expected_hash) != 0) {
+        ESP_LOGE(TAG, "Hash mismatch, expected %s", s_record.expected_hash);
+        clear_session();
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    if (s_record.type == OTA_TYPE_FIRMWARE) {
+        // Validates the app image before switching to it
+        err = esp_ota_set_boot_partition(s_partition);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "esp_ota_set_boot_partition failed: %s", esp_err_to_name(err));
+            clear_session();
+            return err;
+        }
+    }
+
+    return clear_session();
+}
+
+esp_err_t ota_resume_abort(void) {
+    load_session();
+    if (!s_active) {
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "Chunked upload session abandoned");
+    return clear_session();
+}
+
+esp_err_t ota_resume_get_info(ota_resume_info_t *info) {
+    if (info == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    load_session();
+
+    memset(info, 0, sizeof(*info));
+    info->chunk_size = OTA_RESUME_CHUNK_SIZE;
+    if (!s_active) {
+        return ESP_OK;
+    }
+
+    info->active = true;
+    info->type = (ota_type_t)s_record.type;
+    info->image_size = s_record.image_size;
+    info->chunks_total = chunk_count();
+    info->chunks_done = chunks_done();
+    info->next_offset = s_record.image_size;
+    for (uint32_t i = 0; i < info->chunks_total; i++) {
+        if (!(s_record.bitmap[i / 8] & (1U << (i % 8)))) {
+            info->next_offset = i * s_record.chunk_size;
+            break;
+        }
+    }
+    strlcpy(info->expected_hash, s_record.expected_hash, sizeof(info->expected_hash));
+    return ESP_OK;
+}
+
+bool ota_resume_pending(ota_type_t type) {
+    load_session();
+    return s_active && s_record.type == type;
+}
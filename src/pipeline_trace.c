@@ -0,0 +1,60 @@
+/**
+ * @file pipeline_trace.c
+ * @brief SEGGER SystemView markers around the pipeline stages, for timelines captured over JTAG
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "pipeline_trace.h"
+#include "version.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register pipeline_trace.c version
+REGISTER_VERSION(PipelineTrace, "1.0.0", "2026-10-15");
+
+static const char *TAG = "PIPE_TRACE";
+
+#if PIPELINE_TRACE != 0 && !defined(CONFIG_APPTRACE_SV_ENABLE)
+#error "PIPELINE_TRACE needs SystemView: build with sdkconfig.trace.defaults ([env:trace])"
+#endif
+
+static const char *const STAGE_NAMES[PIPELINE_TRACE_STAGE_COUNT] = {
+    [PIPELINE_TRACE_DNS_REPLY] = "dns_reply",
+    [PIPELINE_TRACE_FILE_SERVE] = "file_serve",
+    [PIPELINE_TRACE_OTA_WRITE] = "ota_write",
+    [PIPELINE_TRACE_SENSOR_SAMPLE] = "sensor_sample",
+    [PIPELINE_TRACE_ESPNOW_ENCODE] = "espnow_encode",
+    [PIPELINE_TRACE_ESPNOW_SEND] = "espnow_send",
+    [PIPELINE_TRACE_MQTT_PUBLISH] = "mqtt_publish",
+};
+
+// =============================
+// Function Definitions
+// =============================
+
+esp_err_t pipeline_trace_init(void) {
+    if (PIPELINE_TRACE == 0) {
+        return ESP_OK;
+    }
+    // A recording started later misses these names; the table in the log covers it
+    for (int i = 0; i < PIPELINE_TRACE_STAGE_COUNT; i++) {
+#if PIPELINE_TRACE != 0
+        SEGGER_SYSVIEW_NameMarker((unsigned)i, STAGE_NAMES[i]);
+#endif
+        ESP_LOGI(TAG, "Marker %d: %s", i, STAGE_NAMES[i]);
+    }
+    return ESP_OK;
+}
+
+const char *pipeline_trace_stage_name(pipeline_trace_stage_t stage) {
+    return stage < PIPELINE_TRACE_STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
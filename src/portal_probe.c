@@ -0,0 +1,208 @@
+/**
+ * @file portal_probe.c
+ * @brief Captive-portal probe responder: prebuilt answers to OS connectivity checks, counted per client
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "portal_probe.h"
+#include "https_portal.h"
+#include "web_routes.h"
+#include "version.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/sockets.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register portal_probe.c version
+REGISTER_VERSION(PortalProbe, "1.0.0", "2026-10-15");
+
+static const char *TAG = "PORTAL_PROBE";
+
+#if HTTPS_PORTAL
+#define PROBE_LOCATION "https://192.168.4.1/"
+#else
+#define PROBE_LOCATION "http://192.168.4.1/"
+#endif
+
+/**
+ * @brief A whole response, status line to blank line
+ */
+typedef struct {
+    const char *bytes;
+    size_t len;
+    bool redirect;
+} probe_response_t;
+
+#define PROBE_RESPONSE(text, is_redirect) { (text), sizeof(text) - 1, (is_redirect) }
+
+static const probe_response_t no_content = PROBE_RESPONSE(
+    "HTTP/1.1 204 No Content\r\n"
+    "Cache-Control: no-store\r\n"
+    "\r\n", false);
+
+static const probe_response_t redirect = PROBE_RESPONSE(
+    "HTTP/1.1 302 Found\r\n"
+    "Location: " PROBE_LOCATION "\r\n"
+    "Cache-Control: no-store\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n", true);
+
+/**
+ * @brief Probes from one client
+ */
+typedef struct {
+    uint32_t ip;                                // IPv4, network order; 0: slot free
+    uint32_t probes;
+    int64_t last_us;
+} probe_client_t;
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static portal_probe_stats_t stats;              // Under stats_lock
+static probe_client_t clients[PORTAL_PROBE_CLIENTS];  // Under stats_lock
+
+// =============================
+// Function Prototypes
+// =============================
+static uint32_t peer_ip(httpd_req_t *req);
+static void count(uint32_t ip, bool redirected, bool sent);
+static esp_err_t probe_handler(httpd_req_t *req);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief The client's IPv4 address, from a plain or an IPv4-mapped IPv6 peer; 0 if unknown
+ */
+static uint32_t peer_ip(httpd_req_t *req) {
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getpeername(httpd_req_to_sockfd(req), (struct sockaddr *)&addr, &len) != 0) {
+        return 0;
+    }
+    if (addr.ss_family == AF_INET) {
+        return ((struct sockaddr_in *)&addr)->sin_addr.s_addr;
+    }
+    if (addr.ss_family == AF_INET6) {
+        uint32_t ip;
+        memcpy(&ip, &((struct sockaddr_in6 *)&addr)->sin6_addr.s6_addr[12], sizeof(ip));
+        return ip;
+    }
+    return 0;
+}
+
+static void count(uint32_t ip, bool redirected, bool sent) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&stats_lock);
+    if (!sent) {
+        stats.send_failed++;
+    } else if (redirected) {
+        stats.redirect++;
+    } else {
+        stats.no_content++;
+    }
+
+    probe_client_t *slot = &clients[0];
+    for (int i = 0; i < PORTAL_PROBE_CLIENTS; i++) {
+        if (clients[i].ip == ip) {
+            slot = &clients[i];
+            break;
+        }
+        if (clients[i].last_us < slot->last_us) {
+            slot = &clients[i];                 // Free slots hold 0, so they go first
+        }
+    }
+    if (ip != 0) {
+        if (slot->ip != ip) {
+            *slot = (probe_client_t){ .ip = ip };
+        }
+        slot->probes++;
+        slot->last_us = now;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief Write the route's prebuilt response; no formatting, no log
+ */
+static esp_err_t probe_handler(httpd_req_t *req) {
+    const probe_response_t *response = (const probe_response_t *)req->user_ctx;
+    bool sent = httpd_send(req, response->bytes, response->len) == (int)response->len;
+    count(peer_ip(req), response->redirect, sent);
+    return sent ? ESP_OK : ESP_FAIL;            // A failed send drops the session
+}
+
+esp_err_t portal_probe_register(httpd_handle_t server) {
+    size_t route_count;
+    const web_route_t *routes = web_routes_get(&route_count);
+    size_t registered = 0;
+    for (size_t i = 0; i < route_count; i++) {
+        if (routes[i].kind == WEB_ROUTE_ASSET) {
+            continue;
+        }
+        httpd_uri_t probe_uri = {
+            .uri = routes[i].uri,
+            .method = HTTP_GET,
+            .handler = probe_handler,
+            .user_ctx = (void *)(routes[i].kind == WEB_ROUTE_PROBE_NO_CONTENT ? &no_content : &redirect)
+        };
+        esp_err_t err = httpd_register_uri_handler(server, &probe_uri);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Probe %s left to the fallback: %s", routes[i].uri, esp_err_to_name(err));
+            return err;
+        }
+        registered++;
+    }
+    ESP_LOGI(TAG, "%u probe URIs answered from prebuilt responses", (unsigned)registered);
+    return ESP_OK;
+}
+
+void portal_probe_get_stats(portal_probe_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void portal_probe_write_json(json_writer_t *w) {
+    portal_probe_stats_t totals;
+    probe_client_t snapshot[PORTAL_PROBE_CLIENTS];
+    portENTER_CRITICAL(&stats_lock);
+    totals = stats;
+    memcpy(snapshot, clients, sizeof(snapshot));
+    portEXIT_CRITICAL(&stats_lock);
+
+    int64_t now = esp_timer_get_time();
+    json_obj_begin(w);
+    json_kv_uint(w, "noContent", totals.no_content);
+    json_kv_uint(w, "redirect", totals.redirect);
+    json_kv_uint(w, "sendFailed", totals.send_failed);
+    json_key(w, "clients");
+    json_arr_begin(w);
+    for (int i = 0; i < PORTAL_PROBE_CLIENTS; i++) {
+        const probe_client_t *c = &snapshot[i];
+        if (c->ip == 0) {
+            continue;
+        }
+        const uint8_t *octet = (const uint8_t *)&c->ip;
+        char ip[16];
+        snprintf(ip, sizeof(ip), "%u.%u.%u.%u", octet[0], octet[1], octet[2], octet[3]);
+        json_obj_begin(w);
+        json_kv_str(w, "ip", ip);
+        json_kv_uint(w, "probes", c->probes);
+        json_kv_uint(w, "lastS", (uint64_t)((now - c->last_us) / 1000000));
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
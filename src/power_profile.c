@@ -0,0 +1,278 @@
+/**
+ * @file power_profile.c
+ * @brief Role-specific dynamic frequency scaling and light sleep, PM locks, and sleep time accounting
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "power_profile.h"
+#include "version.h"
+#include "SystemMetrics.h"
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_private/esp_clk.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register power_profile.c version
+REGISTER_VERSION(PowerProfile, "1.0.0", "2026-10-15");
+
+static const char *TAG = "POWER";
+
+static const char *const profile_names[] = {
+    [POWER_PROFILE_NONE] = "None",
+    [POWER_PROFILE_CONFIG] = "Config",
+    [POWER_PROFILE_GATEWAY] = "Gateway",
+    [POWER_PROFILE_GATEWAY_SLOTTED] = "Slotted gateway",
+    [POWER_PROFILE_NODE] = "Node",
+};
+
+static power_profile_t active = POWER_PROFILE_NONE;
+static esp_pm_lock_handle_t locks[POWER_LOCK_COUNT];
+
+// Light sleep, written by the exit callback with interrupts off
+static uint64_t light_sleep_us = 0;
+static uint32_t light_sleeps = 0;
+static bool light_sleep_tracked = false;
+static portMUX_TYPE sleep_lock = portMUX_INITIALIZER_UNLOCKED;
+
+const uint16_t power_awake_bucket_ms[POWER_AWAKE_BUCKETS - 1] = { 100, 200, 500, 1000, 2000, 5000, 10000 };
+
+static const char *const wake_names[POWER_WAKE_COUNT] = { "timer", "button", "ulp", "rain", "other" };
+
+/**
+ * @brief Deep sleep accounting; kept across wakes, zeroed at power-on
+ */
+typedef struct {
+    uint64_t deep_sleep_us;
+    uint64_t awake_us;
+    uint32_t deep_sleeps;
+    uint32_t wakes[POWER_WAKE_COUNT];
+    uint32_t awake_histogram[POWER_AWAKE_BUCKETS];
+    uint64_t sleep_start_us;                    // RTC clock when the last deep sleep began; 0 none
+} power_rtc_t;
+
+static RTC_DATA_ATTR power_rtc_t rtc;
+static uint64_t wake_start_us;                  // RTC clock when this wake began
+
+// =============================
+// Function Prototypes
+// =============================
+static void deep_sleep_hook(void);
+static power_wake_t wake_cause(void);
+static metric_error_t power_mode_provider(char *buf, size_t buf_len);
+static metric_error_t light_sleep_provider(char *buf, size_t buf_len);
+static metric_error_t deep_sleep_provider(char *buf, size_t buf_len);
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+static esp_err_t light_sleep_exit(int64_t sleep_time_us, void *arg);
+#endif
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Runs in esp_deep_sleep_start(), on every path into deep sleep
+ */
+static void deep_sleep_hook(void) {
+    uint64_t now_us = esp_clk_rtc_time();
+    uint64_t awake_us = now_us - wake_start_us;
+    uint32_t awake_ms = (uint32_t)(awake_us / 1000);
+    size_t bucket = 0;
+    while (bucket < POWER_AWAKE_BUCKETS - 1 && awake_ms > power_awake_bucket_ms[bucket]) {
+        bucket++;
+    }
+    rtc.awake_us += awake_us;
+    rtc.awake_histogram[bucket]++;
+    rtc.sleep_start_us = now_us;
+}
+
+static power_wake_t wake_cause(void) {
+    switch (esp_sleep_get_wakeup_cause()) {
+    case ESP_SLEEP_WAKEUP_TIMER:
+        return POWER_WAKE_TIMER;
+    case ESP_SLEEP_WAKEUP_EXT0:
+    case ESP_SLEEP_WAKEUP_GPIO:
+        return POWER_WAKE_BUTTON;
+    case ESP_SLEEP_WAKEUP_ULP:
+        return POWER_WAKE_ULP;
+    case ESP_SLEEP_WAKEUP_EXT1:
+        return POWER_WAKE_RAIN;
+    default:
+        return POWER_WAKE_OTHER;
+    }
+}
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+/**
+ * @brief Automatic light sleep ended; runs on the idle task with interrupts disabled
+ */
+static IRAM_ATTR esp_err_t light_sleep_exit(int64_t sleep_time_us, void *arg) {
+    portENTER_CRITICAL_ISR(&sleep_lock);
+    light_sleep_us += (uint64_t)sleep_time_us;
+    light_sleeps++;
+    portEXIT_CRITICAL_ISR(&sleep_lock);
+    return ESP_OK;
+}
+#endif
+
+static metric_error_t power_mode_provider(char *buf, size_t buf_len) {
+    esp_pm_config_t cfg;
+    if (active == POWER_PROFILE_NONE || esp_pm_get_configuration(&cfg) != ESP_OK) {
+        snprintf(buf, buf_len, "ERROR: Power management not enabled (CONFIG_PM_ENABLE)");
+        return METRIC_ERROR_NOT_AVAILABLE;
+    }
+    snprintf(buf, buf_len, "%s: %d-%d MHz, light sleep %s, now %d MHz", profile_names[active], cfg.min_freq_mhz,
+             cfg.max_freq_mhz, cfg.light_sleep_enable ? "on" : "off", esp_clk_cpu_freq() / 1000000);
+    return METRIC_OK;
+}
+
+static metric_error_t light_sleep_provider(char *buf, size_t buf_len) {
+    power_sleep_stats_t st;
+    power_profile_get_sleep_stats(&st);
+    if (!st.light_sleep_tracked) {
+        snprintf(buf, buf_len, "ERROR: Light sleep not tracked (CONFIG_PM_LIGHT_SLEEP_CALLBACKS)");
+        return METRIC_ERROR_NOT_SUPPORTED;
+    }
+    int64_t uptime_us = esp_timer_get_time();
+    snprintf(buf, buf_len, "%llu ms in %lu sleeps (%.1f%% of uptime)", (unsigned long long)(st.light_sleep_us / 1000),
+             (unsigned long)st.light_sleeps, uptime_us > 0 ? st.light_sleep_us * 100.0 / uptime_us : 0.0);
+    return METRIC_OK;
+}
+
+static metric_error_t deep_sleep_provider(char *buf, size_t buf_len) {
+    power_sleep_stats_t st;
+    power_profile_get_sleep_stats(&st);
+    int n = snprintf(buf, buf_len, "%llu ms in %lu sleeps, awake %u.%02u%%, %lu ms per wake; wakes:",
+                     (unsigned long long)(st.deep_sleep_us / 1000), (unsigned long)st.deep_sleeps, st.awake_bp / 100,
+                     st.awake_bp % 100, (unsigned long)st.wake_ms);
+    for (size_t i = 0; i < POWER_WAKE_COUNT && n > 0 && (size_t)n < buf_len; i++) {
+        n += snprintf(buf + n, buf_len - n, " %s %lu", wake_names[i], (unsigned long)st.wakes[i]);
+    }
+    return METRIC_OK;
+}
+
+void power_profile_boot(void) {
+    // The chip was running for as long as esp_timer has counted; before that it was booting out of sleep
+    wake_start_us = esp_clk_rtc_time() - (uint64_t)esp_timer_get_time();
+
+    // Only a wake from deep sleep ended one; any other reset leaves a stale start time behind
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED && rtc.sleep_start_us != 0 &&
+        wake_start_us > rtc.sleep_start_us) {
+        rtc.deep_sleep_us += wake_start_us - rtc.sleep_start_us;
+        rtc.deep_sleeps++;
+        rtc.wakes[wake_cause()]++;
+    }
+    rtc.sleep_start_us = 0;
+    esp_deep_sleep_register_hook(deep_sleep_hook);
+}
+
+esp_err_t power_profile_apply(power_profile_t profile) {
+    static const char *const lock_names[POWER_LOCK_COUNT] = { "power_cpu", "power_radio" };
+    static const esp_pm_lock_type_t lock_types[POWER_LOCK_COUNT] = { ESP_PM_CPU_FREQ_MAX, ESP_PM_NO_LIGHT_SLEEP };
+
+    set_metric_provider(METRIC_POWER_MODE, power_mode_provider);
+    set_metric_provider(METRIC_LIGHT_SLEEP_DURATION, light_sleep_provider);
+    set_metric_provider(METRIC_DEEP_SLEEP_DURATION, deep_sleep_provider);
+
+    esp_pm_config_t cfg = { 0 };
+    switch (profile) {
+    case POWER_PROFILE_GATEWAY:
+        cfg.max_freq_mhz = POWER_GATEWAY_MAX_MHZ;
+        cfg.min_freq_mhz = POWER_GATEWAY_MIN_MHZ;
+        break;
+    case POWER_PROFILE_GATEWAY_SLOTTED:
+        cfg.max_freq_mhz = POWER_GATEWAY_MAX_MHZ;
+        cfg.min_freq_mhz = POWER_GATEWAY_MIN_MHZ;
+        cfg.light_sleep_enable = true;
+        break;
+    case POWER_PROFILE_NODE:
+        cfg.max_freq_mhz = POWER_NODE_MAX_MHZ;
+        cfg.min_freq_mhz = POWER_NODE_MIN_MHZ;
+        cfg.light_sleep_enable = true;
+        break;
+    case POWER_PROFILE_CONFIG:
+        cfg.max_freq_mhz = POWER_CONFIG_MAX_MHZ;
+        cfg.min_freq_mhz = POWER_CONFIG_MIN_MHZ;
+        break;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Locks first: anything that takes one before esp_pm_configure() still holds it afterwards
+    for (size_t i = 0; i < POWER_LOCK_COUNT; i++) {
+        if (locks[i] == NULL) {
+            esp_err_t err = esp_pm_lock_create(lock_types[i], 0, lock_names[i], &locks[i]);
+            if (err != ESP_OK) {
+                locks[i] = NULL;
+                ESP_LOGW(TAG, "Power management unavailable, staying at %d MHz: %s", esp_clk_cpu_freq() / 1000000,
+                         esp_err_to_name(err));
+                return err;
+            }
+        }
+    }
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    if (cfg.light_sleep_enable && !light_sleep_tracked) {
+        esp_pm_sleep_cbs_register_config_t cbs = {
+            .exit_cb = light_sleep_exit,
+        };
+        light_sleep_tracked = esp_pm_light_sleep_register_cbs(&cbs) == ESP_OK;
+    }
+#endif
+
+    esp_err_t err = esp_pm_configure(&cfg);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "%s profile not applied: %s", profile_names[profile], esp_err_to_name(err));
+        return err;
+    }
+    active = profile;
+    ESP_LOGI(TAG, "%s profile: %d-%d MHz, light sleep %s", profile_names[profile], cfg.min_freq_mhz,
+             cfg.max_freq_mhz, cfg.light_sleep_enable ? "on" : "off");
+    return ESP_OK;
+}
+
+void power_profile_acquire(power_lock_t lock) {
+    if (lock < POWER_LOCK_COUNT && locks[lock] != NULL) {
+        esp_pm_lock_acquire(locks[lock]);
+    }
+}
+
+void power_profile_release(power_lock_t lock) {
+    if (lock < POWER_LOCK_COUNT && locks[lock] != NULL) {
+        esp_pm_lock_release(locks[lock]);
+    }
+}
+
+void power_profile_get_sleep_stats(power_sleep_stats_t *stats) {
+    portENTER_CRITICAL(&sleep_lock);
+    stats->light_sleep_us = light_sleep_us;
+    stats->light_sleeps = light_sleeps;
+    portEXIT_CRITICAL(&sleep_lock);
+    stats->light_sleep_tracked = light_sleep_tracked;
+    stats->deep_sleep_us = rtc.deep_sleep_us;
+    stats->deep_sleeps = rtc.deep_sleeps;
+    stats->awake_us = rtc.awake_us;
+    memcpy(stats->wakes, rtc.wakes, sizeof(stats->wakes));
+    memcpy(stats->awake_histogram, rtc.awake_histogram, sizeof(stats->awake_histogram));
+
+    uint64_t this_wake_us = esp_clk_rtc_time() - wake_start_us;
+    uint64_t light_us = stats->light_sleep_us < this_wake_us ? stats->light_sleep_us : this_wake_us;
+    uint64_t awake_us = rtc.awake_us + this_wake_us - light_us;
+    uint64_t total_us = awake_us + rtc.deep_sleep_us + light_us;
+    stats->awake_bp = total_us > 0 ? (uint16_t)(awake_us * 10000 / total_us) : 10000;
+    stats->wake_ms = rtc.deep_sleeps > 0 ? (uint32_t)(rtc.awake_us / rtc.deep_sleeps / 1000) : 0;
+}
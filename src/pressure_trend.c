@@ -0,0 +1,222 @@
+/**
+ * @file pressure_trend.c
+ * @brief Barometric tendency: least-squares pressure trend over the last 3 h, with falling and storm alarms
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "pressure_trend.h"
+#include "version.h"
+#include <stdio.h>
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register pressure_trend.c version
+REGISTER_VERSION(PressureTrend, "1.0.0", "2026-10-15");
+
+static int32_t falling_pa = PRESSURE_TREND_FALLING_PA_3H;
+static int32_t storm_pa = PRESSURE_TREND_STORM_PA_3H;
+
+// =============================
+// Function Prototypes
+// =============================
+static int64_t div_round(int64_t num, int64_t den);
+static void push_point(pressure_trend_t *pt, uint32_t time_s, uint32_t pressure);
+static void drop_oldest(pressure_trend_t *pt);
+static pressure_trend_alarm_t next_alarm(pressure_trend_alarm_t alarm, const pressure_trend_reading_t *r);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief num / den rounded half away from zero; den > 0
+ */
+static int64_t div_round(int64_t num, int64_t den) {
+    return num >= 0 ? (num + den / 2) / den : -((-num + den / 2) / den);
+}
+
+/**
+ * @brief Append a point, dropping the oldest when the ring is full
+ */
+static void push_point(pressure_trend_t *pt, uint32_t time_s, uint32_t pressure) {
+    if (pt->count == PRESSURE_TREND_SLOTS) {
+        drop_oldest(pt);
+    }
+    if (pt->count == 0) {
+        pt->base_s = time_s;
+    }
+    int64_t x = (int64_t)(time_s - pt->base_s);
+    pt->sum_t += x;
+    pt->sum_p += pressure;
+    pt->sum_tt += x * x;
+    pt->sum_tp += x * (int64_t)pressure;
+    pt->t[pt->head] = time_s;
+    pt->p[pt->head] = pressure;
+    pt->head = (pt->head + 1) % PRESSURE_TREND_SLOTS;
+    pt->count++;
+}
+
+/**
+ * @brief Remove the oldest point and move the time origin to the one after it
+ *
+ * Shifting t by d: St -= n*d, Stt -= 2*d*St - n*d*d, Stp -= d*Sp.
+ */
+static void drop_oldest(pressure_trend_t *pt) {
+    uint8_t oldest = (pt->head + PRESSURE_TREND_SLOTS - pt->count) % PRESSURE_TREND_SLOTS;
+    int64_t x = (int64_t)(pt->t[oldest] - pt->base_s);
+    int64_t p = pt->p[oldest];
+    pt->sum_t -= x;
+    pt->sum_p -= p;
+    pt->sum_tt -= x * x;
+    pt->sum_tp -= x * p;
+    pt->count--;
+    if (pt->count == 0) {
+        pt->sum_t = pt->sum_p = pt->sum_tt = pt->sum_tp = 0;
+        return;
+    }
+
+    int64_t n = pt->count;
+    int64_t d = (int64_t)(pt->t[(oldest + 1) % PRESSURE_TREND_SLOTS] - pt->base_s);
+    pt->sum_tt -= 2 * d * pt->sum_t - n * d * d;
+    pt->sum_tp -= d * pt->sum_p;
+    pt->sum_t -= n * d;
+    pt->base_s += (uint32_t)d;
+}
+
+/**
+ * @brief Alarm for a fresh reading: raised at a threshold, cleared PRESSURE_TREND_HYSTERESIS_PA below it
+ */
+static pressure_trend_alarm_t next_alarm(pressure_trend_alarm_t alarm, const pressure_trend_reading_t *r) {
+    if (!r->valid) {
+        return alarm;
+    }
+    int32_t fall = -r->change_pa_3h;
+    pressure_trend_alarm_t level = PRESSURE_TREND_ALARM_NONE;
+    if (fall >= storm_pa) {
+        level = PRESSURE_TREND_ALARM_STORM;
+    } else if (fall >= falling_pa) {
+        level = PRESSURE_TREND_ALARM_FALLING;
+    }
+    if (level >= alarm) {
+        return level;
+    }
+
+    // Step down only past the hysteresis of the level held
+    int32_t held_pa = alarm == PRESSURE_TREND_ALARM_STORM ? storm_pa : falling_pa;
+    if (fall > held_pa - PRESSURE_TREND_HYSTERESIS_PA) {
+        return alarm;
+    }
+    if (alarm == PRESSURE_TREND_ALARM_STORM && fall > falling_pa - PRESSURE_TREND_HYSTERESIS_PA) {
+        return PRESSURE_TREND_ALARM_FALLING;
+    }
+    return level;
+}
+
+void pressure_trend_init(pressure_trend_t *pt) {
+    memset(pt, 0, sizeof(*pt));
+}
+
+bool pressure_trend_add(pressure_trend_t *pt, uint32_t time_s, uint32_t pressure) {
+    bool empty = pt->count == 0 && pt->bucket_n == 0;
+    if (!empty && time_s < pt->last_s) {
+        if (pt->last_s - time_s <= PRESSURE_TREND_WINDOW_S) {
+            return false;
+        }
+        pressure_trend_alarm_t alarm = (pressure_trend_alarm_t)pt->alarm;
+        pressure_trend_init(pt);
+        pt->alarm = alarm;                      // Kept until the new series says otherwise
+    }
+
+    if (pt->bucket_n > 0 && time_s - pt->bucket_s >= PRESSURE_TREND_SPACING_S) {
+        push_point(pt, pt->bucket_s + (uint32_t)((pt->bucket_t + pt->bucket_n / 2) / pt->bucket_n),
+                   (uint32_t)((pt->bucket_p + pt->bucket_n / 2) / pt->bucket_n));
+        pt->bucket_n = 0;
+    }
+    if (pt->bucket_n == 0) {
+        pt->bucket_s = time_s;
+        pt->bucket_t = 0;
+        pt->bucket_p = 0;
+    }
+    pt->bucket_n++;
+    pt->bucket_t += time_s - pt->bucket_s;
+    pt->bucket_p += pressure;
+    pt->last_s = time_s;
+    pt->last_p = pressure;
+
+    while (pt->count > 0 && time_s - pt->t[(pt->head + PRESSURE_TREND_SLOTS - pt->count) % PRESSURE_TREND_SLOTS] >
+                                PRESSURE_TREND_WINDOW_S) {
+        drop_oldest(pt);
+    }
+
+    pressure_trend_reading_t r;
+    pressure_trend_get(pt, &r);
+    pressure_trend_alarm_t alarm = next_alarm((pressure_trend_alarm_t)pt->alarm, &r);
+    bool changed = alarm != pt->alarm;
+    pt->alarm = alarm;
+    return changed;
+}
+
+void pressure_trend_get(const pressure_trend_t *pt, pressure_trend_reading_t *r) {
+    memset(r, 0, sizeof(*r));
+    r->pressure = pt->last_p;
+    r->time_s = pt->last_s;
+    r->alarm = (pressure_trend_alarm_t)pt->alarm;
+    if (pt->count == 0 && pt->bucket_n == 0) {
+        return;
+    }
+
+    // The point still being averaged counts, so every sample moves the trend
+    int64_t n = pt->count;
+    int64_t st = pt->sum_t, sp = pt->sum_p, stt = pt->sum_tt, stp = pt->sum_tp;
+    uint32_t base_s = pt->count > 0 ? pt->base_s : pt->bucket_s;
+    if (pt->bucket_n > 0) {
+        int64_t x = (int64_t)(pt->bucket_s - base_s) + (int64_t)((pt->bucket_t + pt->bucket_n / 2) / pt->bucket_n);
+        int64_t p = (int64_t)((pt->bucket_p + pt->bucket_n / 2) / pt->bucket_n);
+        n++;
+        st += x;
+        sp += p;
+        stt += x * x;
+        stp += x * p;
+    }
+    r->points = (uint8_t)n;
+    r->span_s = pt->last_s - base_s;
+
+    int64_t den = n * stt - st * st;
+    if (n < 3 || den <= 0 || r->span_s < PRESSURE_TREND_MIN_SPAN_S) {
+        return;
+    }
+    int64_t num = n * stp - st * sp;
+    r->change_pa_3h = (int32_t)div_round(num * PRESSURE_TREND_WINDOW_S, den);
+    r->valid = true;
+}
+
+void pressure_trend_set_thresholds(int32_t falling_pa_3h, int32_t storm_pa_3h) {
+    falling_pa = falling_pa_3h;
+    storm_pa = storm_pa_3h > falling_pa_3h ? storm_pa_3h : falling_pa_3h;
+}
+
+const char *pressure_trend_alarm_name(pressure_trend_alarm_t alarm) {
+    switch (alarm) {
+    case PRESSURE_TREND_ALARM_FALLING:
+        return "falling";
+    case PRESSURE_TREND_ALARM_STORM:
+        return "storm";
+    default:
+        return "none";
+    }
+}
+
+int pressure_trend_alert_json(char *buf, size_t cap, uint32_t node_id, const pressure_trend_reading_t *r) {
+    return snprintf(buf, cap, "{\"node\":\"%08lx\",\"alarm\":\"%s\",\"change\":%ld,\"span\":%lu,"
+                    "\"pressure\":%lu,\"time\":%lu}", (unsigned long)node_id, pressure_trend_alarm_name(r->alarm),
+                    (long)r->change_pa_3h, (unsigned long)r->span_s, (unsigned long)r->pressure,
+                    (unsigned long)r->time_s);
+}
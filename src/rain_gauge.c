@@ -0,0 +1,284 @@
+/**
+ * @file rain_gauge.c
+ * @brief Tipping-bucket rain gauge: every tip counted, awake or in deep sleep, without polling
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "rain_gauge.h"
+#include "iram_profile.h"
+#include "version.h"
+#include <string.h>
+#include "driver/gpio.h"
+#include "soc/soc_caps.h"
+#if SOC_PM_SUPPORT_EXT1_WAKEUP
+#include "driver/rtc_io.h"
+#endif
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_private/esp_clk.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register rain_gauge.c version
+REGISTER_VERSION(RainGauge, "1.0.0", "2026-10-15");
+
+static const char *TAG = "RAIN_GAUGE";
+
+#define BUCKET_US ((uint64_t)RAIN_GAUGE_BUCKET_S * 1000000)
+
+_Static_assert(RAIN_GAUGE_BUCKETS * RAIN_GAUGE_BUCKET_S == 3600, "the rate buckets must cover one hour");
+
+/**
+ * @brief Counts kept across deep sleep; RTC_DATA_ATTR is zeroed at power-on
+ */
+typedef struct {
+    uint32_t tips;
+    uint64_t bucket;                            // RTC clock / BUCKET_US of the newest bucket
+    uint16_t counts[RAIN_GAUGE_BUCKETS];        // Tips per bucket, indexed by bucket % RAIN_GAUGE_BUCKETS
+    bool stuck;
+} rain_rtc_t;
+
+static RTC_DATA_ATTR rain_rtc_t rtc;
+static portMUX_TYPE rain_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool running = false;
+
+// Interrupt state; folded into rtc by the next task that reads it
+static uint32_t pending = 0;
+static bool held = false;                       // The current closure was counted; the interrupt waits for the release
+static int64_t last_tip_us = INT64_MIN / 2;
+
+// =============================
+// Function Prototypes
+// =============================
+static HOT_IRAM_ATTR void tip_isr(void *arg);
+static void fold(uint32_t tips);
+static bool wait_release(void);
+static int pin_level(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Level interrupt: count on low, then wait for high, so a held switch interrupts once per closure
+ *
+ * In flash unless IRAM_HOT_PATHS: gpio_set_intr_type() is only in IRAM with
+ * CONFIG_GPIO_CTRL_FUNC_IN_IRAM (iram_profile.h).
+ */
+static HOT_IRAM_ATTR void tip_isr(void *arg) {
+    portENTER_CRITICAL_ISR(&rain_lock);
+    if (held) {
+        held = false;
+        gpio_set_intr_type(RAIN_GAUGE_GPIO, GPIO_INTR_LOW_LEVEL);
+    } else {
+        int64_t now_us = esp_timer_get_time();
+        if (now_us - last_tip_us >= (int64_t)RAIN_GAUGE_LOCKOUT_MS * 1000) {
+            pending++;
+            last_tip_us = now_us;
+        }
+        held = true;
+        gpio_set_intr_type(RAIN_GAUGE_GPIO, GPIO_INTR_HIGH_LEVEL);
+    }
+    portEXIT_CRITICAL_ISR(&rain_lock);
+}
+
+/**
+ * @brief Add interrupt-counted tips and the given ones to the RTC counts, clearing buckets that aged out
+ */
+static void fold(uint32_t tips) {
+    uint64_t bucket = esp_clk_rtc_time() / BUCKET_US;
+
+    portENTER_CRITICAL(&rain_lock);
+    tips += pending;
+    pending = 0;
+    uint64_t steps = bucket > rtc.bucket ? bucket - rtc.bucket : 0;
+    if (steps > RAIN_GAUGE_BUCKETS) {
+        steps = RAIN_GAUGE_BUCKETS;
+    }
+    for (uint64_t i = 1; i <= steps; i++) {
+        rtc.counts[(rtc.bucket + i) % RAIN_GAUGE_BUCKETS] = 0;
+    }
+    if (bucket > rtc.bucket) {
+        rtc.bucket = bucket;
+    }
+    uint16_t *count = &rtc.counts[rtc.bucket % RAIN_GAUGE_BUCKETS];
+    *count = *count + tips > UINT16_MAX ? UINT16_MAX : (uint16_t)(*count + tips);
+    rtc.tips += tips;
+    portEXIT_CRITICAL(&rain_lock);
+}
+
+/**
+ * @brief The switch pin, read as an RTC input where EXT1 wakes on it (ESP32, S3), as a GPIO on the C3
+ */
+static int pin_level(void) {
+#if SOC_PM_SUPPORT_EXT1_WAKEUP
+    return rtc_gpio_get_level(RAIN_GAUGE_GPIO);
+#else
+    return gpio_get_level(RAIN_GAUGE_GPIO);
+#endif
+}
+
+/**
+ * @brief Wait for the switch to stay open for RAIN_GAUGE_RELEASE_MS; the pin must be set up for pin_level()
+ *
+ * @return true once open, false if still closed after RAIN_GAUGE_RELEASE_WAIT_MS
+ */
+static bool wait_release(void) {
+    int64_t start_us = esp_timer_get_time();
+    int64_t open_since_us = -1;
+    while (esp_timer_get_time() - start_us < (int64_t)RAIN_GAUGE_RELEASE_WAIT_MS * 1000) {
+        int64_t now_us = esp_timer_get_time();
+        if (pin_level() == 0) {
+            open_since_us = -1;
+        } else if (open_since_us < 0) {
+            open_since_us = now_us;
+        } else if (now_us - open_since_us >= (int64_t)RAIN_GAUGE_RELEASE_MS * 1000) {
+            return true;
+        }
+        vTaskDelay(1);
+    }
+    return false;
+}
+
+esp_err_t rain_gauge_start(void) {
+    if (running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+#if SOC_PM_SUPPORT_EXT1_WAKEUP
+    rtc_gpio_deinit(RAIN_GAUGE_GPIO);           // Held as an RTC input since the last deep sleep
+#endif
+    gpio_config_t io = {
+        .pin_bit_mask = 1ULL << RAIN_GAUGE_GPIO,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    esp_err_t err = gpio_config(&io);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // A switch already closed at start was counted by the wake, or predates the gauge
+    held = gpio_get_level(RAIN_GAUGE_GPIO) == 0;
+    err = gpio_install_isr_service(HOT_INTR_FLAGS);
+    if (err == ESP_OK || err == ESP_ERR_INVALID_STATE) {
+        err = gpio_isr_handler_add(RAIN_GAUGE_GPIO, tip_isr, NULL);
+    }
+    if (err == ESP_OK) {
+        err = gpio_wakeup_enable(RAIN_GAUGE_GPIO, held ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+    }
+    if (err == ESP_OK) {
+        err = esp_sleep_enable_gpio_wakeup();   // Light sleep ends on a tip
+    }
+    if (err != ESP_OK) {
+        gpio_isr_handler_remove(RAIN_GAUGE_GPIO);
+        return err;
+    }
+    gpio_intr_enable(RAIN_GAUGE_GPIO);
+
+    running = true;
+    ESP_LOGI(TAG, "Counting tips on GPIO %d, %d um each", RAIN_GAUGE_GPIO, RAIN_GAUGE_UM_PER_TIP);
+    return ESP_OK;
+}
+
+bool rain_gauge_woke(void) {
+#if SOC_PM_SUPPORT_EXT1_WAKEUP
+    return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT1 &&
+           (esp_sleep_get_ext1_wakeup_status() & (1ULL << RAIN_GAUGE_GPIO)) != 0;
+#else
+    return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO &&
+           (esp_sleep_get_gpio_wakeup_status() & (1ULL << RAIN_GAUGE_GPIO)) != 0;
+#endif
+}
+
+void rain_gauge_count_wake(void) {
+    fold(1);
+    held = true;
+}
+
+void rain_gauge_arm_sleep(void) {
+    rain_gauge_stop();
+#if SOC_PM_SUPPORT_EXT1_WAKEUP
+    rtc_gpio_init(RAIN_GAUGE_GPIO);
+    rtc_gpio_set_direction(RAIN_GAUGE_GPIO, RTC_GPIO_MODE_INPUT_ONLY);
+    rtc_gpio_pullup_en(RAIN_GAUGE_GPIO);
+    rtc_gpio_pulldown_dis(RAIN_GAUGE_GPIO);
+#else
+    // GPIO 0-5 keep their pad settings, the pull-up included, in deep sleep
+    gpio_set_direction(RAIN_GAUGE_GPIO, GPIO_MODE_INPUT);
+    gpio_pullup_en(RAIN_GAUGE_GPIO);
+    gpio_pulldown_dis(RAIN_GAUGE_GPIO);
+#endif
+
+    // A closure the interrupt never saw (it was removed mid-tip) still counts
+    if (pin_level() == 0 && !held &&
+        esp_timer_get_time() - last_tip_us >= (int64_t)RAIN_GAUGE_LOCKOUT_MS * 1000) {
+        fold(1);
+    }
+    held = false;
+    bool open = wait_release();
+    fold(0);
+
+    if (!open) {
+        if (!rtc.stuck) {
+            ESP_LOGW(TAG, "Switch on GPIO %d stays closed - not waking on it", RAIN_GAUGE_GPIO);
+        }
+        rtc.stuck = true;
+        return;
+    }
+    rtc.stuck = false;
+#if SOC_PM_SUPPORT_EXT1_WAKEUP
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);   // Keeps the internal pull-up
+    esp_err_t err = esp_sleep_enable_ext1_wakeup(1ULL << RAIN_GAUGE_GPIO, ESP_EXT1_WAKEUP_ALL_LOW);
+#else
+    esp_err_t err = esp_deep_sleep_enable_gpio_wakeup(1ULL << RAIN_GAUGE_GPIO, ESP_GPIO_WAKEUP_GPIO_LOW);
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Tip wakeup not armed: %s", esp_err_to_name(err));
+    }
+}
+
+void rain_gauge_get(rain_gauge_reading_t *reading) {
+    fold(0);
+    memset(reading, 0, sizeof(*reading));
+    portENTER_CRITICAL(&rain_lock);
+    reading->tips = rtc.tips;
+    for (size_t i = 0; i < RAIN_GAUGE_BUCKETS; i++) {
+        reading->tips_hour += rtc.counts[i];
+    }
+    reading->stuck = rtc.stuck;
+    portEXIT_CRITICAL(&rain_lock);
+    reading->total = (uint32_t)((uint64_t)reading->tips * RAIN_GAUGE_UM_PER_TIP / 10);
+    reading->rate = (uint32_t)reading->tips_hour * RAIN_GAUGE_UM_PER_TIP / 10;
+}
+
+void rain_gauge_log(void) {
+    rain_gauge_reading_t r;
+    rain_gauge_get(&r);
+    ESP_LOGI(TAG, "Rain %lu.%02lu mm/h (%u tips in the last hour), %lu.%02lu mm in %lu tips since power-on%s",
+             (unsigned long)(r.rate / 100), (unsigned long)(r.rate % 100), r.tips_hour,
+             (unsigned long)(r.total / 100), (unsigned long)(r.total % 100), (unsigned long)r.tips,
+             r.stuck ? " - switch stuck closed" : "");
+}
+
+void rain_gauge_stop(void) {
+    if (!running) {
+        return;
+    }
+    gpio_wakeup_disable(RAIN_GAUGE_GPIO);
+    gpio_isr_handler_remove(RAIN_GAUGE_GPIO);
+    running = false;
+}
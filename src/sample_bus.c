@@ -0,0 +1,302 @@
+/**
+ * @file sample_bus.c
+ * @brief Publish/subscribe fan-out of received records and GPS fixes in reference-counted blocks
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "sample_bus.h"
+#include "version.h"
+#include "static_mem.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register sample_bus.c version
+REGISTER_VERSION(SampleBus, "1.0.0", "2026-10-15");
+
+static const char *TAG = "SAMPLE_BUS";
+
+_Static_assert(SAMPLE_BUS_BLOCKS <= UINT16_MAX, "block indices are 16 bits");
+
+struct sample_bus_sub {
+    bool used;
+    QueueHandle_t queue;                        // sample_block_t pointers
+    sample_bus_sub_stats_t stats;
+};
+
+// The pool and its counters change under pool_lock; the subscriber table under
+// subs_lock, which a publish holds so a queue cannot be deleted under it
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t subs_lock = NULL;
+static sample_block_t *blocks = NULL;
+static uint16_t free_stack[SAMPLE_BUS_BLOCKS];
+static uint32_t free_count = 0;
+static uint32_t min_free = 0;
+static uint32_t published = 0;
+static uint32_t exhausted = 0;
+static sample_bus_sub_t subs[SAMPLE_BUS_MAX_SUBSCRIBERS];
+
+#if STATIC_MEMORY
+static sample_block_t block_pool[SAMPLE_BUS_BLOCKS];
+#endif
+
+// =============================
+// Function Prototypes
+// =============================
+static void add_ref(sample_block_t *block);
+static bool deliver(sample_bus_sub_t *sub, sample_block_t *block);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void add_ref(sample_block_t *block) {
+    portENTER_CRITICAL(&pool_lock);
+    block->refs++;
+    portEXIT_CRITICAL(&pool_lock);
+}
+
+/**
+ * @brief Queue a block to one subscriber, making room by dropping its oldest (caller holds subs_lock)
+ */
+static bool deliver(sample_bus_sub_t *sub, sample_block_t *block) {
+    add_ref(block);
+    if (xQueueSend(sub->queue, &block, 0) != pdTRUE) {
+        const sample_block_t *oldest;
+        if (xQueueReceive(sub->queue, &oldest, 0) == pdTRUE) {
+            sample_bus_release(oldest);
+            sub->stats.dropped++;
+        }
+        if (xQueueSend(sub->queue, &block, 0) != pdTRUE) {
+            sample_bus_release(block);
+            sub->stats.dropped++;
+            return false;
+        }
+    }
+    sub->stats.delivered++;
+    uint32_t waiting = uxQueueMessagesWaiting(sub->queue);
+    if (waiting > sub->stats.peak) {
+        sub->stats.peak = waiting;
+    }
+    return true;
+}
+
+esp_err_t sample_bus_init(void) {
+    if (blocks != NULL) {
+        return ESP_OK;
+    }
+    if (subs_lock == NULL) {
+        subs_lock = xSemaphoreCreateMutex();
+        if (subs_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+#if STATIC_MEMORY
+    sample_block_t *pool = block_pool;
+#else
+    sample_block_t *pool = malloc(SAMPLE_BUS_BLOCKS * sizeof(sample_block_t));
+    if (pool == NULL) {
+        ESP_LOGE(TAG, "No memory for %d sample blocks", SAMPLE_BUS_BLOCKS);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+    memset(subs, 0, sizeof(subs));
+    portENTER_CRITICAL(&pool_lock);
+    for (uint32_t i = 0; i < SAMPLE_BUS_BLOCKS; i++) {
+        pool[i].refs = 0;
+        free_stack[i] = (uint16_t)i;
+    }
+    free_count = SAMPLE_BUS_BLOCKS;
+    min_free = SAMPLE_BUS_BLOCKS;
+    published = 0;
+    exhausted = 0;
+    blocks = pool;
+    portEXIT_CRITICAL(&pool_lock);
+
+    ESP_LOGI(TAG, "%d blocks of %u bytes", SAMPLE_BUS_BLOCKS, (unsigned)sizeof(sample_block_t));
+    return ESP_OK;
+}
+
+void sample_bus_deinit(void) {
+    if (blocks == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < SAMPLE_BUS_MAX_SUBSCRIBERS; i++) {
+        if (subs[i].used) {
+            ESP_LOGW(TAG, "Subscriber %s still attached, pool kept", subs[i].stats.name);
+            return;
+        }
+    }
+    portENTER_CRITICAL(&pool_lock);
+    sample_block_t *pool = blocks;
+    blocks = NULL;
+    free_count = 0;
+    portEXIT_CRITICAL(&pool_lock);
+#if STATIC_MEMORY
+    (void)pool;
+#else
+    free(pool);
+#endif
+}
+
+esp_err_t sample_bus_subscribe(const char *name, uint32_t depth, sample_bus_sub_t **out) {
+    return sample_bus_subscribe_topics(name, depth, SAMPLE_TOPIC_RECORD, out);
+}
+
+esp_err_t sample_bus_subscribe_topics(const char *name, uint32_t depth, uint8_t topics, sample_bus_sub_t **out) {
+    *out = NULL;
+    if (blocks == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (depth == 0 || topics == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(subs_lock, portMAX_DELAY);
+    // Each subscriber can pin its whole queue plus the block it is reading
+    uint32_t committed = 0;
+    sample_bus_sub_t *sub = NULL;
+    for (uint32_t i = 0; i < SAMPLE_BUS_MAX_SUBSCRIBERS; i++) {
+        if (subs[i].used) {
+            committed += subs[i].stats.depth + 1;
+        } else if (sub == NULL) {
+            sub = &subs[i];
+        }
+    }
+    if (sub == NULL || committed + depth + 1 + SAMPLE_BUS_RESERVE > SAMPLE_BUS_BLOCKS) {
+        xSemaphoreGive(subs_lock);
+        ESP_LOGW(TAG, "No room for %s (depth %lu): %lu of %d blocks promised", name, (unsigned long)depth,
+                 (unsigned long)committed, SAMPLE_BUS_BLOCKS);
+        return ESP_ERR_NO_MEM;
+    }
+    QueueHandle_t queue = xQueueCreate(depth, sizeof(sample_block_t *));
+    if (queue == NULL) {
+        xSemaphoreGive(subs_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    memset(sub, 0, sizeof(*sub));
+    strlcpy(sub->stats.name, name, sizeof(sub->stats.name));
+    sub->stats.depth = depth;
+    sub->stats.topics = topics;
+    sub->queue = queue;
+    sub->used = true;
+    xSemaphoreGive(subs_lock);
+
+    *out = sub;
+    ESP_LOGI(TAG, "Subscriber %s, depth %lu", sub->stats.name, (unsigned long)depth);
+    return ESP_OK;
+}
+
+void sample_bus_unsubscribe(sample_bus_sub_t *sub) {
+    if (sub == NULL || !sub->used) {
+        return;
+    }
+    xSemaphoreTake(subs_lock, portMAX_DELAY);
+    sub->used = false;
+    const sample_block_t *block;
+    while (xQueueReceive(sub->queue, &block, 0) == pdTRUE) {
+        sample_bus_release(block);
+    }
+    vQueueDelete(sub->queue);
+    sub->queue = NULL;
+    xSemaphoreGive(subs_lock);
+}
+
+sample_block_t *sample_bus_alloc(void) {
+    sample_block_t *block = NULL;
+    portENTER_CRITICAL(&pool_lock);
+    if (blocks != NULL && free_count > 0) {
+        block = &blocks[free_stack[--free_count]];
+        block->refs = 1;
+        block->topic = SAMPLE_TOPIC_RECORD;
+        if (free_count < min_free) {
+            min_free = free_count;
+        }
+    } else if (blocks != NULL) {
+        exhausted++;
+    }
+    portEXIT_CRITICAL(&pool_lock);
+    return block;
+}
+
+uint32_t sample_bus_publish(sample_block_t *block) {
+    uint32_t reached = 0;
+    xSemaphoreTake(subs_lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < SAMPLE_BUS_MAX_SUBSCRIBERS; i++) {
+        if (subs[i].used && (subs[i].stats.topics & block->topic) != 0 && deliver(&subs[i], block)) {
+            reached++;
+        }
+    }
+    xSemaphoreGive(subs_lock);
+
+    portENTER_CRITICAL(&pool_lock);
+    published++;
+    portEXIT_CRITICAL(&pool_lock);
+    sample_bus_release(block);
+    return reached;
+}
+
+const sample_block_t *sample_bus_receive(sample_bus_sub_t *sub, TickType_t wait) {
+    const sample_block_t *block;
+    if (sub == NULL || xQueueReceive(sub->queue, &block, wait) != pdTRUE) {
+        return NULL;
+    }
+    return block;
+}
+
+void sample_bus_release(const sample_block_t *block) {
+    // The pointer came from the pool, so this is the bus's own block
+    sample_block_t *b = (sample_block_t *)block;
+    portENTER_CRITICAL(&pool_lock);
+    if (--b->refs == 0) {
+        free_stack[free_count++] = (uint16_t)(b - blocks);
+    }
+    portEXIT_CRITICAL(&pool_lock);
+}
+
+void sample_bus_get_stats(sample_bus_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    portENTER_CRITICAL(&pool_lock);
+    stats->published = published;
+    stats->exhausted = exhausted;
+    stats->free_blocks = free_count;
+    stats->min_free = min_free;
+    portEXIT_CRITICAL(&pool_lock);
+    if (subs_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(subs_lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < SAMPLE_BUS_MAX_SUBSCRIBERS; i++) {
+        if (subs[i].used) {
+            stats->subs[stats->subscribers++] = subs[i].stats;
+        }
+    }
+    xSemaphoreGive(subs_lock);
+}
+
+void sample_bus_log(void) {
+    sample_bus_stats_t s;
+    sample_bus_get_stats(&s);
+    ESP_LOGI(TAG, "%lu published, %lu/%d blocks free (low %lu), %lu allocations refused",
+             (unsigned long)s.published, (unsigned long)s.free_blocks, SAMPLE_BUS_BLOCKS,
+             (unsigned long)s.min_free, (unsigned long)s.exhausted);
+    for (uint32_t i = 0; i < s.subscribers; i++) {
+        const sample_bus_sub_stats_t *sub = &s.subs[i];
+        ESP_LOGI(TAG, "  %s: %lu delivered, %lu dropped, queue peak %lu/%lu", sub->name,
+                 (unsigned long)sub->delivered, (unsigned long)sub->dropped, (unsigned long)sub->peak,
+                 (unsigned long)sub->depth);
+    }
+}
@@ -0,0 +1,132 @@
+/**
+ * @file sample_rate.c
+ * @brief Adaptive sampling rate: the period and batch follow the supply's charge and the weather's volatility
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "sample_rate.h"
+#include "version.h"
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register sample_rate.c version
+REGISTER_VERSION(SampleRate, "1.0.0", "2026-10-15");
+
+_Static_assert(SAMPLE_RATE_SUPPLY_FULL_MV > SAMPLE_RATE_SUPPLY_EMPTY_MV, "full must be above empty");
+_Static_assert(SAMPLE_RATE_CALM_PERMILLE > 0 && SAMPLE_RATE_STORM_PERMILLE >= SAMPLE_RATE_CALM_PERMILLE,
+               "the rate must rise with volatility");
+
+// =============================
+// Function Prototypes
+// =============================
+static uint16_t charge_permille(uint16_t supply_mv);
+static uint16_t volatility_permille(const sample_rate_inputs_t *in);
+
+// =============================
+// Function Definitions
+// =============================
+
+static uint16_t charge_permille(uint16_t supply_mv) {
+    if (supply_mv == SAMPLE_RATE_UNKNOWN) {
+        return SAMPLE_RATE_UNKNOWN;
+    }
+    if (supply_mv <= SAMPLE_RATE_SUPPLY_EMPTY_MV) {
+        return 0;
+    }
+    if (supply_mv >= SAMPLE_RATE_SUPPLY_FULL_MV) {
+        return 1000;
+    }
+    return (uint16_t)((uint32_t)(supply_mv - SAMPLE_RATE_SUPPLY_EMPTY_MV) * 1000 /
+                      (SAMPLE_RATE_SUPPLY_FULL_MV - SAMPLE_RATE_SUPPLY_EMPTY_MV));
+}
+
+/**
+ * @brief The steeper of the pressure trend and the gust spread, 0..1000; unknown without either
+ */
+static uint16_t volatility_permille(const sample_rate_inputs_t *in) {
+    uint32_t v = 0;
+    if (!in->have_trend && !in->have_wind) {
+        return SAMPLE_RATE_UNKNOWN;
+    }
+    if (in->have_trend) {
+        uint32_t change = (uint32_t)(in->change_pa_3h < 0 ? -in->change_pa_3h : in->change_pa_3h);
+        v = change * 1000 / SAMPLE_RATE_PRESSURE_PA_3H;
+    }
+    if (in->have_wind && in->wind_avg >= SAMPLE_RATE_GUST_MIN_SPEED && in->wind_gust > in->wind_avg) {
+        uint32_t spread = (uint32_t)(in->wind_gust - in->wind_avg) * 1000 / in->wind_avg;
+        uint32_t w = spread * 1000 / SAMPLE_RATE_GUST_PERMILLE;
+        if (w > v) {
+            v = w;
+        }
+    }
+    return (uint16_t)(v > 1000 ? 1000 : v);
+}
+
+void sample_rate_init(sample_rate_t *rate) {
+    memset(rate, 0, sizeof(*rate));
+    rate->supply_mv = SAMPLE_RATE_UNKNOWN;
+    rate->charge_permille = SAMPLE_RATE_UNKNOWN;
+    rate->volatility_permille = SAMPLE_RATE_UNKNOWN;
+}
+
+bool sample_rate_update(sample_rate_t *rate, uint32_t base_ms, uint8_t base_batch, const sample_rate_inputs_t *in,
+                        const sample_rate_limits_t *limits) {
+    if (in->supply_mv != SAMPLE_RATE_UNKNOWN) {
+        rate->supply_mv = in->supply_mv;
+    }
+    uint16_t charge = charge_permille(rate->supply_mv);
+    uint16_t volatility = volatility_permille(in);
+
+    // Both factors per mille: stretch lengthens the period, speed shortens it
+    uint32_t stretch = 1000;
+    if (charge != SAMPLE_RATE_UNKNOWN && charge < SAMPLE_RATE_RESERVE_PERMILLE) {
+        stretch += (uint32_t)(SAMPLE_RATE_RESERVE_PERMILLE - charge) * (SAMPLE_RATE_LOW_STRETCH - 1) * 1000 /
+                   SAMPLE_RATE_RESERVE_PERMILLE;
+    }
+    uint32_t speed = 1000;
+    if (volatility != SAMPLE_RATE_UNKNOWN) {
+        speed = SAMPLE_RATE_CALM_PERMILLE +
+                (uint32_t)volatility * (SAMPLE_RATE_STORM_PERMILLE - SAMPLE_RATE_CALM_PERMILLE) / 1000;
+    }
+
+    uint64_t interval = (uint64_t)base_ms * stretch / speed;
+    if (limits->step_ms > 1) {
+        interval = (interval + limits->step_ms / 2) / limits->step_ms * limits->step_ms;
+    }
+    if (interval < limits->min_ms) {
+        interval = limits->min_ms;
+    } else if (interval > limits->max_ms) {
+        interval = limits->max_ms;
+    }
+    uint32_t batch = ((uint32_t)base_batch * stretch + speed / 2) / speed;
+    if (batch < 1) {
+        batch = 1;
+    } else if (batch > limits->max_batch) {
+        batch = limits->max_batch;
+    }
+    while (limits->max_batch_ms != 0 && batch > 1 && interval * batch >= limits->max_batch_ms) {
+        batch--;
+    }
+
+    uint32_t delta = interval > rate->interval_ms ? (uint32_t)interval - rate->interval_ms
+                                                  : rate->interval_ms - (uint32_t)interval;
+    bool changed = rate->interval_ms == 0 || batch != rate->batch ||
+                   (uint64_t)delta * 1000 > (uint64_t)rate->interval_ms * SAMPLE_RATE_HYSTERESIS_PERMILLE;
+    if (!changed) {
+        return false;
+    }
+    rate->interval_ms = (uint32_t)interval;
+    rate->batch = (uint8_t)batch;
+    rate->charge_permille = charge;
+    rate->volatility_permille = volatility;
+    rate->changes++;
+    return true;
+}
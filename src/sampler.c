@@ -0,0 +1,502 @@
+/**
+ * @file sampler.c
+ * @brief Timer-driven sensor sampling: esp_timer schedule, acquisition task, queue and transmit task
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "sampler.h"
+#include "pipeline_trace.h"
+#include "version.h"
+#include "static_mem.h"
+#include "SystemMetrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register sampler.c version
+REGISTER_VERSION(Sampler, "1.0.0", "2026-10-14");
+
+static const char *TAG = "SAMPLER";
+
+#define STOP_BIT (1u << 31)                     // Acquisition task notification: exit
+#define SENSOR_STOP 0xFF                        // Queued after the last sample: transmit task exits
+
+/**
+ * @brief A registered sensor, its schedule and its statistics
+ */
+typedef struct {
+    char name[SAMPLER_NAME_LEN];
+    uint32_t interval_ms;
+    sampler_trigger_t trigger;                  // NULL: read converts and returns at once
+    sampler_read_t read;
+    void *ctx;
+    esp_timer_handle_t timer;                   // NULL on a sensor that shares its leader's timer
+    uint8_t leader;                             // First sensor with the same period; its timer fires them all
+    int64_t start_us;                           // Periods are counted from here
+    uint32_t start_seq;                         // ... and from this seq
+    uint32_t seq;                               // Timer callbacks so far
+    bool pending;                               // Fired, not yet read
+    uint32_t pending_seq;
+    int64_t pending_fired_us;
+    uint32_t samples;
+    uint32_t failed;
+    uint32_t overruns;
+    uint32_t dropped;
+    int32_t jitter_min_us;
+    int32_t jitter_max_us;
+    uint64_t jitter_abs_sum_us;
+    uint32_t latency_max_us;
+} sampler_sensor_t;
+
+static sampler_sensor_t sensors[SAMPLER_MAX_SENSORS];
+static uint8_t sensor_count = 0;
+static bool running = false;
+static sampler_sink_t sink_fn = NULL;
+static sampler_idle_t idle_fn = NULL;
+static QueueHandle_t sample_queue = NULL;
+static SemaphoreHandle_t stopped_sem = NULL;
+static TaskHandle_t acquire_task_handle = NULL;
+static TaskHandle_t transmit_task_handle = NULL;
+STATIC_TASK_SLOT(acquire_task_slot, SAMPLER_ACQUIRE_TASK_STACK_SIZE);
+STATIC_TASK_SLOT(transmit_task_slot, SAMPLER_TRANSMIT_TASK_STACK_SIZE);
+static portMUX_TYPE sampler_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static void sampler_timer_cb(void *arg);
+static void acquire(uint8_t id, esp_err_t trigger_err);
+static void acquire_due(uint32_t bits);
+static void acquire_task(void *pvParameters);
+static TickType_t idle_wait(void);
+static void transmit_task(void *pvParameters);
+static metric_error_t sampler_jitter_provider(char *buf, size_t buf_len);
+static void release_resources(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Periodic timer: mark the sensors of its period due and wake the acquisition task
+ *
+ * Runs in the esp_timer task, so it only records the time and notifies.
+ */
+static void sampler_timer_cb(void *arg) {
+    uint8_t leader = (uint8_t)(uintptr_t)arg;
+    int64_t now = esp_timer_get_time();
+    uint32_t notify = 0;
+
+    portENTER_CRITICAL(&sampler_lock);
+    for (uint8_t id = leader; id < sensor_count; id++) {
+        sampler_sensor_t *s = &sensors[id];
+        if (s->leader != leader) {
+            continue;
+        }
+        s->seq++;
+        if (s->pending) {
+            s->overruns++;                      // Previous period still waiting for its read
+        } else {
+            s->pending = true;
+            s->pending_seq = s->seq;
+            s->pending_fired_us = now;
+            notify |= 1u << id;
+        }
+    }
+    portEXIT_CRITICAL(&sampler_lock);
+
+    if (notify != 0) {
+        xTaskNotify(acquire_task_handle, notify, eSetBits);
+    }
+}
+
+/**
+ * @brief Read one due sensor, update its statistics and queue the sample
+ *
+ * @param trigger_err A failed trigger: queued as the sample's status without a read
+ */
+static void acquire(uint8_t id, esp_err_t trigger_err) {
+    sampler_sensor_t *s = &sensors[id];
+    sampler_sample_t sample = { .sensor = id };
+
+    portENTER_CRITICAL(&sampler_lock);
+    sample.seq = s->pending_seq;
+    sample.fired_us = s->pending_fired_us;
+    int64_t start_us = s->start_us;
+    uint32_t start_seq = s->start_seq;
+    uint32_t interval_ms = s->interval_ms;
+    portEXIT_CRITICAL(&sampler_lock);
+    sample.due_us = start_us + (int64_t)(sample.seq - start_seq) * interval_ms * 1000;
+
+    size_t len = 0;
+    PIPELINE_TRACE_BEGIN(PIPELINE_TRACE_SENSOR_SAMPLE);
+    sample.status = trigger_err != ESP_OK ? trigger_err : s->read(s->ctx, sample.data, &len);
+    PIPELINE_TRACE_END(PIPELINE_TRACE_SENSOR_SAMPLE);
+    sample.len = len > SAMPLER_PAYLOAD_MAX ? SAMPLER_PAYLOAD_MAX : len;
+    sample.acquired_us = esp_timer_get_time();
+
+    int32_t jitter = (int32_t)(sample.fired_us - sample.due_us);
+    uint32_t latency = (uint32_t)(sample.acquired_us - sample.due_us);
+    portENTER_CRITICAL(&sampler_lock);
+    s->pending = false;
+    if (s->samples == 0 || jitter < s->jitter_min_us) {
+        s->jitter_min_us = jitter;
+    }
+    if (s->samples == 0 || jitter > s->jitter_max_us) {
+        s->jitter_max_us = jitter;
+    }
+    s->samples++;
+    s->jitter_abs_sum_us += (uint32_t)abs(jitter);
+    if (latency > s->latency_max_us) {
+        s->latency_max_us = latency;
+    }
+    if (sample.status != ESP_OK) {
+        s->failed++;
+    }
+    portEXIT_CRITICAL(&sampler_lock);
+
+    if (xQueueSend(sample_queue, &sample, 0) != pdTRUE) {
+        portENTER_CRITICAL(&sampler_lock);
+        s->dropped++;
+        portEXIT_CRITICAL(&sampler_lock);
+    }
+}
+
+/**
+ * @brief Start every due conversion, then read each as it completes, earliest first
+ */
+static void acquire_due(uint32_t bits) {
+    int64_t ready_us[SAMPLER_MAX_SENSORS];
+    uint32_t converting = 0;
+    for (uint8_t id = 0; id < sensor_count; id++) {
+        sampler_sensor_t *s = &sensors[id];
+        if (!(bits & (1u << id)) || s->trigger == NULL) {
+            continue;
+        }
+        uint32_t conversion_us = 0;
+        esp_err_t err = s->trigger(s->ctx, &conversion_us);
+        if (err != ESP_OK) {
+            acquire(id, err);
+            continue;
+        }
+        ready_us[id] = esp_timer_get_time() + conversion_us;
+        converting |= 1u << id;
+    }
+
+    // Instant reads go while the conversions run
+    for (uint8_t id = 0; id < sensor_count; id++) {
+        if ((bits & (1u << id)) && sensors[id].trigger == NULL) {
+            acquire(id, ESP_OK);
+        }
+    }
+
+    while (converting != 0) {
+        uint8_t next = 0;
+        for (uint8_t id = 0; id < sensor_count; id++) {
+            if ((converting & (1u << id)) && (!(converting & (1u << next)) || ready_us[id] < ready_us[next])) {
+                next = id;
+            }
+        }
+        int64_t wait_us = ready_us[next] - esp_timer_get_time();
+        if (wait_us > 0) {
+            vTaskDelay((TickType_t)((wait_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000)));
+        }
+        acquire(next, ESP_OK);
+        converting &= ~(1u << next);
+    }
+}
+
+/**
+ * @brief Acquisition stage: reads whichever sensors the timers marked due
+ */
+static void acquire_task(void *pvParameters) {
+    uint32_t bits = 0;
+    while (!(bits & STOP_BIT)) {
+        xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+        acquire_due(bits);
+    }
+
+    sampler_sample_t stop = { .sensor = SENSOR_STOP };
+    xQueueSend(sample_queue, &stop, portMAX_DELAY);
+    acquire_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Run the idle hook and convert its deadline to ticks, rounded up so it never spins
+ */
+static TickType_t idle_wait(void) {
+    uint32_t ms = idle_fn != NULL ? idle_fn() : SAMPLER_WAIT_FOREVER;
+    if (ms == SAMPLER_WAIT_FOREVER) {
+        return portMAX_DELAY;
+    }
+    return (TickType_t)((ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+}
+
+/**
+ * @brief Transmit stage: hands queued samples to the sink, however long it takes
+ */
+static void transmit_task(void *pvParameters) {
+    sampler_sample_t sample;
+    TickType_t wait = portMAX_DELAY;
+    for (;;) {
+        if (xQueueReceive(sample_queue, &sample, wait) != pdTRUE) {
+            wait = idle_wait();
+            continue;
+        }
+        if (sample.sensor == SENSOR_STOP) {
+            break;
+        }
+        sink_fn(&sample);
+        wait = idle_wait();
+    }
+
+    transmit_task_handle = NULL;
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief METRIC_SAMPLER_JITTER: schedule quality per sensor
+ */
+static metric_error_t sampler_jitter_provider(char *buf, size_t buf_len) {
+    if (sensor_count == 0) {
+        snprintf(buf, buf_len, "No sensors");
+        return METRIC_OK;
+    }
+
+    size_t pos = 0;
+    buf[0] = '\0';
+    for (uint8_t id = 0; id < sensor_count; id++) {
+        sampler_stats_t st;
+        sampler_get_stats(id, &st);
+        char entry[128];
+        int len = snprintf(entry, sizeof(entry), "%s%s %lu ms: jitter %ld..%ld us (avg %lu), %lu overruns, %lu dropped",
+                           id ? "; " : "", st.name, (unsigned long)st.interval_ms, (long)st.jitter_min_us,
+                           (long)st.jitter_max_us, (unsigned long)st.jitter_mean_us, (unsigned long)st.overruns,
+                           (unsigned long)st.dropped);
+        if (pos + len >= buf_len) {
+            break;                              // Whole entries only
+        }
+        memcpy(buf + pos, entry, len + 1);
+        pos += len;
+    }
+    return METRIC_OK;
+}
+
+/**
+ * @brief Delete the queue and semaphore once both tasks are gone
+ */
+static void release_resources(void) {
+    if (sample_queue != NULL) {
+        vQueueDelete(sample_queue);
+        sample_queue = NULL;
+    }
+    if (stopped_sem != NULL) {
+        vSemaphoreDelete(stopped_sem);
+        stopped_sem = NULL;
+    }
+}
+
+esp_err_t sampler_add_sensor(const char *name, uint32_t interval_ms, sampler_read_t read, void *ctx, uint8_t *id) {
+    return sampler_add_triggered(name, interval_ms, NULL, read, ctx, id);
+}
+
+esp_err_t sampler_add_triggered(const char *name, uint32_t interval_ms, sampler_trigger_t trigger,
+                                sampler_read_t read, void *ctx, uint8_t *id) {
+    if (name == NULL || read == NULL || interval_ms < SAMPLER_MIN_INTERVAL_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (sensor_count >= SAMPLER_MAX_SENSORS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    sampler_sensor_t *s = &sensors[sensor_count];
+    memset(s, 0, sizeof(*s));
+    strlcpy(s->name, name, sizeof(s->name));
+    s->interval_ms = interval_ms;
+    s->trigger = trigger;
+    s->read = read;
+    s->ctx = ctx;
+    s->leader = sensor_count;
+    for (uint8_t i = 0; i < sensor_count; i++) {
+        if (sensors[i].interval_ms == interval_ms) {
+            s->leader = i;
+            break;
+        }
+    }
+    if (id != NULL) {
+        *id = sensor_count;
+    }
+    sensor_count++;
+    ESP_LOGI(TAG, "Sensor %s every %lu ms", s->name, (unsigned long)interval_ms);
+    return ESP_OK;
+}
+
+esp_err_t sampler_start(sampler_sink_t sink) {
+    if (sink == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (running || sensor_count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sink_fn = sink;
+    sample_queue = xQueueCreate(SAMPLER_QUEUE_LEN, sizeof(sampler_sample_t));
+    stopped_sem = xSemaphoreCreateBinary();
+    if (sample_queue == NULL || stopped_sem == NULL ||
+        static_task_create(transmit_task_slot, transmit_task, SAMPLER_TRANSMIT_TASK_NAME, SAMPLER_TRANSMIT_TASK_STACK_SIZE, NULL,
+                           SAMPLER_TRANSMIT_TASK_PRIORITY, &transmit_task_handle, TASK_CORE_APP) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create sample queue or transmit task");
+        release_resources();
+        return ESP_ERR_NO_MEM;
+    }
+    if (static_task_create(acquire_task_slot, acquire_task, SAMPLER_ACQUIRE_TASK_NAME, SAMPLER_ACQUIRE_TASK_STACK_SIZE, NULL,
+                           SAMPLER_ACQUIRE_TASK_PRIORITY, &acquire_task_handle, TASK_CORE_APP) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create acquisition task");
+        sampler_sample_t stop = { .sensor = SENSOR_STOP };
+        xQueueSend(sample_queue, &stop, portMAX_DELAY);
+        xSemaphoreTake(stopped_sem, portMAX_DELAY);
+        release_resources();
+        return ESP_ERR_NO_MEM;
+    }
+
+    running = true;
+    int64_t start_us = esp_timer_get_time();
+    for (uint8_t id = 0; id < sensor_count; id++) {
+        sampler_sensor_t *s = &sensors[id];
+        s->start_us = start_us;
+        s->start_seq = s->seq;
+        if (s->leader != id) {
+            continue;                           // Fired by its leader's timer
+        }
+        esp_timer_create_args_t args = {
+            .callback = sampler_timer_cb,
+            .arg = (void *)(uintptr_t)id,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = s->name,
+        };
+        esp_err_t err = esp_timer_create(&args, &s->timer);
+        if (err == ESP_OK) {
+            err = esp_timer_start_periodic(s->timer, (uint64_t)s->interval_ms * 1000);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start timer for %s: %s", s->name, esp_err_to_name(err));
+            sampler_stop();
+            return err;
+        }
+    }
+
+    set_metric_provider(METRIC_SAMPLER_JITTER, sampler_jitter_provider);
+    ESP_LOGI(TAG, "Sampling %u sensor(s)", sensor_count);
+    return ESP_OK;
+}
+
+esp_err_t sampler_set_idle(sampler_idle_t idle) {
+    if (running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    idle_fn = idle;
+    return ESP_OK;
+}
+
+esp_err_t sampler_set_interval(uint8_t id, uint32_t interval_ms) {
+    if (id >= sensor_count || interval_ms < SAMPLER_MIN_INTERVAL_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint8_t leader = sensors[id].leader;
+    if (sensors[leader].interval_ms == interval_ms) {
+        return ESP_OK;
+    }
+
+    esp_timer_stop(sensors[leader].timer);
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&sampler_lock);
+    for (uint8_t i = leader; i < sensor_count; i++) {
+        sampler_sensor_t *s = &sensors[i];
+        if (s->leader == leader) {
+            s->interval_ms = interval_ms;
+            s->start_us = now;
+            s->start_seq = s->seq;
+        }
+    }
+    portEXIT_CRITICAL(&sampler_lock);
+    esp_err_t err = esp_timer_start_periodic(sensors[leader].timer, (uint64_t)interval_ms * 1000);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to restart timer for %s: %s", sensors[leader].name, esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Sensor %s now every %lu ms", sensors[leader].name, (unsigned long)interval_ms);
+    return ESP_OK;
+}
+
+esp_err_t sampler_stop(void) {
+    if (!running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (uint8_t id = 0; id < sensor_count; id++) {
+        if (sensors[id].timer != NULL) {
+            esp_timer_stop(sensors[id].timer);
+            esp_timer_delete(sensors[id].timer);
+            sensors[id].timer = NULL;
+        }
+        sensors[id].pending = false;
+    }
+
+    // The acquisition task passes the stop on to the transmit task through the queue
+    xTaskNotify(acquire_task_handle, STOP_BIT, eSetBits);
+    if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(SAMPLER_STOP_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Sampler tasks did not stop within %d ms", SAMPLER_STOP_TIMEOUT_MS);
+        return ESP_ERR_TIMEOUT;
+    }
+    release_resources();
+    running = false;
+    return ESP_OK;
+}
+
+esp_err_t sampler_get_stats(uint8_t id, sampler_stats_t *stats) {
+    if (id >= sensor_count || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const sampler_sensor_t *s = &sensors[id];
+    portENTER_CRITICAL(&sampler_lock);
+    strlcpy(stats->name, s->name, sizeof(stats->name));
+    stats->interval_ms = s->interval_ms;
+    stats->samples = s->samples;
+    stats->failed = s->failed;
+    stats->overruns = s->overruns;
+    stats->dropped = s->dropped;
+    stats->jitter_min_us = s->jitter_min_us;
+    stats->jitter_max_us = s->jitter_max_us;
+    stats->jitter_mean_us = s->samples ? (uint32_t)(s->jitter_abs_sum_us / s->samples) : 0;
+    stats->latency_max_us = s->latency_max_us;
+    portEXIT_CRITICAL(&sampler_lock);
+    return ESP_OK;
+}
+
+uint8_t sampler_sensor_count(void) {
+    return sensor_count;
+}
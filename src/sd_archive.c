@@ -0,0 +1,415 @@
+/**
+ * @file sd_archive.c
+ * @brief Gateway raw archive: every node record, in daily binary files on an SD card
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "sd_archive.h"
+#include "static_mem.h"
+#include "version.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "driver/sdmmc_host.h"
+#include "driver/sdspi_host.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_vfs_fat.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdmmc_cmd.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register sd_archive.c version
+REGISTER_VERSION(SdArchive, "1.0.0", "2026-10-15");
+static const char *TAG = "SD_ARCHIVE";
+
+#define STOP_TIMEOUT_MS 5000                    // A slow card may take this long to take a buffer
+#define MIN_VALID_YEAR 2024                     // Before this the clock has not been set
+
+_Static_assert(SD_ARCHIVE_BUF_BYTES % SD_ARCHIVE_SECTOR == 0, "Buffers are written as whole sectors");
+_Static_assert(SD_ARCHIVE_SECTOR % SD_ARCHIVE_RECORD_LEN == 0, "Records do not straddle sectors");
+
+// The fill buffer belongs to the forwarder; the write buffer to the forwarder
+// while write_busy is false and to the writer task while it is true.
+static uint8_t *buffers[2] = { NULL, NULL };
+static uint8_t *fill_buf = NULL;
+static size_t fill_len = 0;
+static int64_t fill_opened_us = 0;              // When the fill buffer got its first record
+static uint8_t *write_buf = NULL;
+static size_t write_len = 0;
+static uint32_t write_day = 0;                  // YYYYMMDD the write buffer belongs to
+static bool write_partial = false;              // Sealed by age: sync after writing it
+static volatile bool write_busy = false;
+static sdmmc_card_t *card = NULL;
+static int fd = -1;
+static uint32_t open_day = 0;
+static int64_t last_sync_us = 0;
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(writer_task_slot, SD_ARCHIVE_TASK_STACK_SIZE);
+static volatile bool run = false;
+static sd_archive_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t mount_card(void);
+static uint32_t today(void);
+static bool seal(bool partial);
+static bool open_day_file(uint32_t day);
+static void writer_task(void *arg);
+static void count_error(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void count_error(void) {
+    portENTER_CRITICAL(&stats_lock);
+    stats.errors++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief Mount the card's FAT volume at SD_ARCHIVE_MOUNT
+ */
+static esp_err_t mount_card(void) {
+    esp_vfs_fat_sdmmc_mount_config_t mount_config = {
+        .format_if_mount_failed = false,
+        .max_files = SD_ARCHIVE_MAX_FILES,
+        .allocation_unit_size = SD_ARCHIVE_BUF_BYTES,
+    };
+
+    if (SD_ARCHIVE_SDMMC != 0) {
+        sdmmc_host_t host = SDMMC_HOST_DEFAULT();
+        host.max_freq_khz = SDMMC_FREQ_HIGHSPEED;
+        sdmmc_slot_config_t slot = SDMMC_SLOT_CONFIG_DEFAULT();
+        slot.width = 4;
+        slot.flags |= SDMMC_SLOT_FLAG_INTERNAL_PULLUP;
+        return esp_vfs_fat_sdmmc_mount(SD_ARCHIVE_MOUNT, &host, &slot, &mount_config, &card);
+    }
+
+    sdmmc_host_t host = SDSPI_HOST_DEFAULT();
+    spi_bus_config_t bus = {
+        .mosi_io_num = SD_ARCHIVE_SPI_MOSI_GPIO,
+        .miso_io_num = SD_ARCHIVE_SPI_MISO_GPIO,
+        .sclk_io_num = SD_ARCHIVE_SPI_SCLK_GPIO,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = SD_ARCHIVE_BUF_BYTES,
+    };
+    esp_err_t err = spi_bus_initialize(host.slot, &bus, SDSPI_DEFAULT_DMA);
+    if (err != ESP_OK) {
+        return err;
+    }
+    sdspi_device_config_t slot = SDSPI_DEVICE_CONFIG_DEFAULT();
+    slot.gpio_cs = SD_ARCHIVE_SPI_CS_GPIO;
+    slot.host_id = host.slot;
+    err = esp_vfs_fat_sdspi_mount(SD_ARCHIVE_MOUNT, &host, &slot, &mount_config, &card);
+    if (err != ESP_OK) {
+        spi_bus_free(host.slot);
+    }
+    return err;
+}
+
+/**
+ * @brief Today's UTC date as YYYYMMDD, 0 while the clock is not set
+ */
+static uint32_t today(void) {
+    time_t now = time(NULL);
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    if (tm.tm_year + 1900 < MIN_VALID_YEAR) {
+        return 0;
+    }
+    return (uint32_t)(tm.tm_year + 1900) * 10000 + (uint32_t)(tm.tm_mon + 1) * 100 + (uint32_t)tm.tm_mday;
+}
+
+/**
+ * @brief Swap the fill buffer for the free one and hand it to the writer task
+ *
+ * @param partial Sealed by age rather than because it is full
+ * @return bool false if the writer still holds the other buffer
+ */
+static bool seal(bool partial) {
+    if (write_busy || fill_len == 0) {
+        return !write_busy;
+    }
+    size_t padded = (fill_len + SD_ARCHIVE_SECTOR - 1) / SD_ARCHIVE_SECTOR * SD_ARCHIVE_SECTOR;
+    memset(fill_buf + fill_len, 0, padded - fill_len);
+
+    uint8_t *sealed = fill_buf;
+    fill_buf = write_buf;
+    write_buf = sealed;
+    write_len = padded;
+    write_day = today();
+    write_partial = partial;
+    fill_len = 0;
+    write_busy = true;
+    xTaskNotifyGive(task_handle);
+    return true;
+}
+
+/**
+ * @brief Make fd the append handle of the day's file
+ */
+static bool open_day_file(uint32_t day) {
+    if (fd >= 0 && day == open_day) {
+        return true;
+    }
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+        fd = -1;
+    }
+    char path[SD_ARCHIVE_PATH_LEN];
+    sd_archive_path(path, day);
+    fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        count_error();
+        return false;
+    }
+    open_day = day;
+    last_sync_us = esp_timer_get_time();
+    portENTER_CRITICAL(&stats_lock);
+    stats.files++;
+    portEXIT_CRITICAL(&stats_lock);
+    ESP_LOGI(TAG, "Archiving to %s", path);
+    return true;
+}
+
+/**
+ * @brief Append each handed-over buffer to its day's file
+ */
+static void writer_task(void *arg) {
+    (void)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (write_busy) {
+            if (open_day_file(write_day)) {
+                int64_t start_us = esp_timer_get_time();
+                bool ok = write(fd, write_buf, write_len) == (ssize_t)write_len;
+                uint32_t took_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+                portENTER_CRITICAL(&stats_lock);
+                if (ok) {
+                    stats.writes++;
+                    stats.bytes += write_len;
+                } else {
+                    stats.errors++;
+                }
+                if (took_ms > stats.write_ms_max) {
+                    stats.write_ms_max = took_ms;
+                }
+                portEXIT_CRITICAL(&stats_lock);
+                if (!ok) {
+                    ESP_LOGW(TAG, "Write of %u bytes failed; buffer lost", (unsigned)write_len);
+                    // Reopen on the next buffer, in case the card was reinserted
+                    close(fd);
+                    fd = -1;
+                }
+            }
+            int64_t now_us = esp_timer_get_time();
+            if (fd >= 0 && (write_partial || !run || now_us - last_sync_us >= (int64_t)SD_ARCHIVE_SYNC_MS * 1000)) {
+                last_sync_us = now_us;
+                if (fsync(fd) == 0) {
+                    portENTER_CRITICAL(&stats_lock);
+                    stats.syncs++;
+                    portEXIT_CRITICAL(&stats_lock);
+                } else {
+                    count_error();
+                }
+            }
+            write_busy = false;
+        }
+        if (!run) {
+            break;
+        }
+    }
+    task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t sd_archive_start(void) {
+    if (task_handle != NULL) {
+        return ESP_OK;
+    }
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < 2; i++) {
+        buffers[i] = heap_caps_malloc(SD_ARCHIVE_BUF_BYTES, MALLOC_CAP_DMA);
+    }
+    if (buffers[0] == NULL || buffers[1] == NULL) {
+        sd_archive_stop();
+        return ESP_ERR_NO_MEM;
+    }
+    fill_buf = buffers[0];
+    write_buf = buffers[1];
+    fill_len = 0;
+    write_busy = false;
+
+    esp_err_t err = mount_card();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No SD card mounted: %s", esp_err_to_name(err));
+        card = NULL;
+        sd_archive_stop();
+        return err;
+    }
+    stats.mounted = true;
+
+    run = true;
+    if (static_task_create(writer_task_slot, writer_task, SD_ARCHIVE_TASK_NAME, SD_ARCHIVE_TASK_STACK_SIZE, NULL,
+                           SD_ARCHIVE_TASK_PRIORITY, &task_handle, TASK_CORE_NET) != pdPASS) {
+        run = false;
+        task_handle = NULL;
+        sd_archive_stop();
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "%s card, %llu MB, archiving to " SD_ARCHIVE_MOUNT, SD_ARCHIVE_SDMMC != 0 ? "SDMMC" : "SPI",
+             (unsigned long long)card->csd.capacity * card->csd.sector_size / (1024 * 1024));
+    return ESP_OK;
+}
+
+void sd_archive_stop(void) {
+    if (task_handle != NULL) {
+        // The last buffer may have to wait for the one in flight
+        int waited = 0;
+        while (!seal(true) && waited < STOP_TIMEOUT_MS) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            waited += 10;
+        }
+        run = false;
+        xTaskNotifyGive(task_handle);
+        while (task_handle != NULL && waited < 2 * STOP_TIMEOUT_MS) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            waited += 10;
+        }
+        if (task_handle != NULL) {
+            ESP_LOGW(TAG, "Writer task did not stop");
+            return;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (card != NULL) {
+        int spi_host = SD_ARCHIVE_SDMMC != 0 ? -1 : card->host.slot;
+        esp_vfs_fat_sdcard_unmount(SD_ARCHIVE_MOUNT, card);
+        if (spi_host >= 0) {
+            spi_bus_free(spi_host);
+        }
+        card = NULL;
+    }
+    for (int i = 0; i < 2; i++) {
+        heap_caps_free(buffers[i]);
+        buffers[i] = NULL;
+    }
+    fill_buf = NULL;
+    write_buf = NULL;
+    fill_len = 0;
+    write_busy = false;
+    open_day = 0;
+    stats.mounted = false;
+}
+
+void sd_archive_add(uint32_t node_id, const telemetry_record_t *rec) {
+    if (fill_buf == NULL || task_handle == NULL) {
+        return;
+    }
+    if (fill_len + SD_ARCHIVE_RECORD_LEN > SD_ARCHIVE_BUF_BYTES && !seal(false)) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.dropped++;
+        portEXIT_CRITICAL(&stats_lock);
+        return;
+    }
+
+    uint8_t *p = fill_buf + fill_len;
+    memset(p, 0, SD_ARCHIVE_RECORD_LEN);
+    p[0] = SD_ARCHIVE_KIND_RECORD;
+    p[1] = (uint8_t)((rec->gas_valid ? 0x01 : 0) | (rec->heat_stable ? 0x02 : 0) | (rec->held ? 0x04 : 0));
+    p[2] = (uint8_t)rec->temperature;
+    p[3] = (uint8_t)((uint16_t)rec->temperature >> 8);
+    const uint32_t words[6] = { node_id, rec->seq, rec->time_s, rec->pressure, rec->humidity, rec->gas_resistance };
+    for (int i = 0; i < 6; i++) {
+        uint8_t *w = p + 4 + 4 * i;
+        w[0] = (uint8_t)words[i];
+        w[1] = (uint8_t)(words[i] >> 8);
+        w[2] = (uint8_t)(words[i] >> 16);
+        w[3] = (uint8_t)(words[i] >> 24);
+    }
+    p[28] = rec->heater_step;
+
+    if (fill_len == 0) {
+        fill_opened_us = esp_timer_get_time();
+    }
+    fill_len += SD_ARCHIVE_RECORD_LEN;
+    portENTER_CRITICAL(&stats_lock);
+    stats.records++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void sd_archive_poll(void) {
+    if (fill_len > 0 && esp_timer_get_time() - fill_opened_us >= (int64_t)SD_ARCHIVE_SYNC_MS * 1000) {
+        seal(true);
+    }
+}
+
+uint32_t sd_archive_poll_due_ms(void) {
+    if (fill_len == 0) {
+        return UINT32_MAX;
+    }
+    int64_t age_ms = (esp_timer_get_time() - fill_opened_us) / 1000;
+    // Still due while the writer is busy; check back shortly rather than spin
+    if (age_ms >= SD_ARCHIVE_SYNC_MS) {
+        return write_busy ? 100 : 0;
+    }
+    return (uint32_t)(SD_ARCHIVE_SYNC_MS - age_ms);
+}
+
+void sd_archive_get_stats(sd_archive_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void sd_archive_path(char *path, uint32_t day) {
+    snprintf(path, SD_ARCHIVE_PATH_LEN, SD_ARCHIVE_MOUNT "/%08lu" SD_ARCHIVE_EXT, (unsigned long)day);
+}
+
+bool sd_archive_decode(const uint8_t *p, uint32_t *node_id, telemetry_record_t *rec) {
+    if (p[0] != SD_ARCHIVE_KIND_RECORD) {
+        return false;
+    }
+    uint32_t words[6];
+    for (int i = 0; i < 6; i++) {
+        const uint8_t *w = p + 4 + 4 * i;
+        words[i] = (uint32_t)w[0] | ((uint32_t)w[1] << 8) | ((uint32_t)w[2] << 16) | ((uint32_t)w[3] << 24);
+    }
+    *node_id = words[0];
+    *rec = (telemetry_record_t){
+        .seq = words[1],
+        .time_s = words[2],
+        .temperature = (int16_t)((uint16_t)p[2] | ((uint16_t)p[3] << 8)),
+        .pressure = words[3],
+        .humidity = words[4],
+        .gas_resistance = words[5],
+        .heater_step = p[28],
+        .gas_valid = (p[1] & 0x01) != 0,
+        .heat_stable = (p[1] & 0x02) != 0,
+        .held = (p[1] & 0x04) != 0,
+    };
+    return true;
+}
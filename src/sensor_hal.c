@@ -0,0 +1,184 @@
+/**
+ * @file sensor_hal.c
+ * @brief Sensor drivers behind one interface, registered at compile time and scheduled by the sampler
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "sensor_hal.h"
+#include "version.h"
+#include <string.h>
+#include "esp_log.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register sensor_hal.c version
+REGISTER_VERSION(SensorHal, "1.0.0", "2026-10-15");
+
+static const char *TAG = "SENSOR_HAL";
+
+// Bounds of the sensor_registry section, from SURROUND(sensor_registry) in src/linker.lf
+extern const sensor_driver_t _sensor_registry_start;
+extern const sensor_driver_t _sensor_registry_end;
+
+/**
+ * @brief A driver that answered its init, as the sampler's ctx
+ */
+typedef struct {
+    const sensor_driver_t *driver;
+    void *state;
+    uint8_t sensor;                             // Sampler id
+} sensor_hal_active_t;
+
+static sensor_hal_active_t active[SENSOR_HAL_DRIVERS];
+static uint8_t active_count = 0;
+static bool started = false;
+
+static const char *const quantity_names[SENSOR_QUANTITY_COUNT] = {
+    [SENSOR_TEMPERATURE] = "temperature_cC",
+    [SENSOR_HUMIDITY] = "humidity_mRH",
+    [SENSOR_PRESSURE] = "pressure_Pa",
+    [SENSOR_GAS_RESISTANCE] = "gas_ohm",
+    [SENSOR_HEATER_STEP] = "heater_step",
+    [SENSOR_GAS_STATUS] = "gas_status",
+    [SENSOR_VOLTAGE] = "voltage_mV",
+};
+
+// Keys match the per-metric MQTT topics (mqtt_forwarder.h)
+static const sensor_quantity_info_t quantity_info[SENSOR_QUANTITY_COUNT] = {
+    [SENSOR_TEMPERATURE]    = { "temperature", "Temperature", "temperature", "\u00b0C", 100, 2 },
+    [SENSOR_HUMIDITY]       = { "humidity", "Humidity", "humidity", "%", 1000, 1 },
+    [SENSOR_PRESSURE]       = { "pressure", "Pressure", "atmospheric_pressure", "hPa", 100, 2 },
+    [SENSOR_GAS_RESISTANCE] = { "gas", "Gas resistance", NULL, "\u03a9", 1, 0 },
+    [SENSOR_HEATER_STEP]    = { NULL, "Heater step", NULL, "", 1, 0 },
+    [SENSOR_GAS_STATUS]     = { NULL, "Gas status", NULL, "", 1, 0 },
+    [SENSOR_VOLTAGE]        = { "voltage", "Supply", "voltage", "V", 1000, 2 },
+};
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t hal_trigger(void *ctx, uint32_t *ready_us);
+static esp_err_t hal_read(void *ctx, void *data, size_t *len);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Sampler trigger callback
+ */
+static esp_err_t hal_trigger(void *ctx, uint32_t *ready_us) {
+    sensor_hal_active_t *a = (sensor_hal_active_t *)ctx;
+    return a->driver->trigger(a->state, ready_us);
+}
+
+/**
+ * @brief Sampler read callback; the sample goes out in the sampler payload as is
+ */
+static esp_err_t hal_read(void *ctx, void *data, size_t *len) {
+    sensor_hal_active_t *a = (sensor_hal_active_t *)ctx;
+    sensor_sample_t *sample = (sensor_sample_t *)data;
+    memset(sample, 0, sizeof(*sample));
+    *len = sizeof(*sample);
+    return a->driver->read(a->state, sample);
+}
+
+size_t sensor_hal_registered(void) {
+    return (size_t)(&_sensor_registry_end - &_sensor_registry_start);
+}
+
+esp_err_t sensor_hal_start(uint32_t interval_ms) {
+    if (started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (const sensor_driver_t *d = &_sensor_registry_start; d < &_sensor_registry_end; d++) {
+        if (active_count >= SENSOR_HAL_DRIVERS) {
+            ESP_LOGW(TAG, "No room for %s: %d drivers active", d->name, SENSOR_HAL_DRIVERS);
+            break;
+        }
+        void *state = NULL;
+        esp_err_t err = d->init != NULL ? d->init(&state) : ESP_OK;
+        if (err != ESP_OK) {
+            ESP_LOGI(TAG, "%s not present: %s", d->name, esp_err_to_name(err));
+            continue;
+        }
+
+        sensor_hal_active_t *a = &active[active_count];
+        a->driver = d;
+        a->state = state;
+        uint32_t period = d->interval_ms != 0 ? d->interval_ms : interval_ms;
+        err = d->trigger != NULL ? sampler_add_triggered(d->name, period, hal_trigger, hal_read, a, &a->sensor)
+                                 : sampler_add_sensor(d->name, period, hal_read, a, &a->sensor);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to schedule %s: %s", d->name, esp_err_to_name(err));
+            if (d->deinit != NULL) {
+                d->deinit(state);
+            }
+            continue;
+        }
+        active_count++;
+    }
+
+    started = true;
+    ESP_LOGI(TAG, "%u of %u sensor driver(s) active", active_count, (unsigned)sensor_hal_registered());
+    return active_count > 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t sensor_hal_set_interval(uint32_t interval_ms) {
+    for (uint8_t i = 0; i < active_count; i++) {
+        if (active[i].driver->interval_ms != 0) {
+            continue;
+        }
+        esp_err_t err = sampler_set_interval(active[i].sensor, interval_ms);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+const sensor_driver_t *sensor_hal_driver(uint8_t sensor) {
+    for (uint8_t i = 0; i < active_count; i++) {
+        if (active[i].sensor == sensor) {
+            return active[i].driver;
+        }
+    }
+    return NULL;
+}
+
+bool sensor_sample_find(const sensor_sample_t *sample, sensor_quantity_t quantity, int32_t *value) {
+    for (uint8_t i = 0; i < sample->count && i < SENSOR_SAMPLE_VALUES; i++) {
+        if (sample->quantity[i] == quantity) {
+            *value = sample->value[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *sensor_quantity_name(sensor_quantity_t quantity) {
+    return quantity < SENSOR_QUANTITY_COUNT && quantity_names[quantity] != NULL ? quantity_names[quantity] : "unknown";
+}
+
+const sensor_quantity_info_t *sensor_quantity_info(sensor_quantity_t quantity) {
+    return quantity < SENSOR_QUANTITY_COUNT ? &quantity_info[quantity] : NULL;
+}
+
+void sensor_hal_stop(void) {
+    for (uint8_t i = 0; i < active_count; i++) {
+        if (active[i].driver->deinit != NULL) {
+            active[i].driver->deinit(active[i].state);
+        }
+    }
+    memset(active, 0, sizeof(active));
+    active_count = 0;
+    started = false;
+}
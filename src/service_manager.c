@@ -0,0 +1,354 @@
+/**
+ * @file service_manager.c
+ * @brief Services started in dependency order, independent ones in parallel on both cores
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "service_manager.h"
+#include "version.h"
+#include "static_mem.h"
+#include "task_plan.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register service_manager.c version
+REGISTER_VERSION(ServiceManager, "1.0.0", "2026-10-15");
+
+static const char *TAG = "SERVICE_MGR";
+
+ESP_EVENT_DEFINE_BASE(SERVICE_EVENT);
+
+#define EVENT_POST_WAIT_MS 100                  // A full event queue drops the event rather than stall a start
+
+/**
+ * @brief A start finished on a worker
+ */
+typedef struct {
+    service_id_t id;
+    esp_err_t err;
+    uint32_t ms;
+} done_t;
+
+static service_def_t defs[SERVICE_MANAGER_MAX];
+static volatile service_state_t states[SERVICE_MANAGER_MAX];
+static uint8_t count = 0;
+
+// Workers take ids from work_queue and answer on done_queue; lock keeps one start or restart at a time
+static QueueHandle_t work_queue = NULL;
+static QueueHandle_t done_queue = NULL;
+static SemaphoreHandle_t lock = NULL;
+static TaskHandle_t workers[2] = { NULL, NULL };
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t ensure_workers(void);
+static void worker_task(void *param);
+static void set_state(service_id_t id, service_state_t state, esp_err_t err, uint32_t ms);
+static esp_err_t start_locked(uint32_t mask);
+static esp_err_t stop_locked(service_id_t id, uint32_t *stopped);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Runs starts handed to it until the device restarts
+ */
+static void worker_task(void *param) {
+    (void)param;
+    service_id_t id;
+    while (1) {
+        if (xQueueReceive(work_queue, &id, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        int64_t t0 = esp_timer_get_time();
+        done_t done = { .id = id, .err = defs[id].start() };
+        done.ms = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+        xQueueSend(done_queue, &done, portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief Create the queues, the lock and a worker on each core, once
+ */
+static esp_err_t ensure_workers(void) {
+    if (lock != NULL) {
+        return ESP_OK;
+    }
+    esp_err_t err = esp_event_loop_create_default();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to create event loop: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    if (work_queue == NULL) {
+        work_queue = xQueueCreate(SERVICE_MANAGER_MAX, sizeof(service_id_t));
+    }
+    if (done_queue == NULL) {
+        done_queue = xQueueCreate(SERVICE_MANAGER_MAX, sizeof(done_t));
+    }
+    if (work_queue == NULL || done_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create the queues");
+        return ESP_ERR_NO_MEM;
+    }
+    // Config mode only, so the stacks come from the heap rather than a slot every role would carry
+    static const char *const names[2] = { SERVICE_NET_TASK_NAME, SERVICE_APP_TASK_NAME };
+    static const BaseType_t cores[2] = { TASK_CORE_NET, TASK_CORE_APP };
+    for (int i = 0; i < 2; i++) {
+        if (workers[i] == NULL && static_task_create(NULL, worker_task, names[i], SERVICE_TASK_STACK_SIZE, NULL,
+                                                     SERVICE_TASK_PRIORITY, &workers[i], cores[i]) != pdPASS) {
+            workers[i] = NULL;
+            ESP_LOGE(TAG, "Failed to start the %s worker", names[i]);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    lock = xSemaphoreCreateMutex();
+    if (lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Record a state change, log it and post it
+ */
+static void set_state(service_id_t id, service_state_t state, esp_err_t err, uint32_t ms) {
+    states[id] = state;
+    const service_def_t *def = &defs[id];
+    if (state == SERVICE_RUNNING) {
+        ESP_LOGI(TAG, "%s running (%lu ms)", def->name, (unsigned long)ms);
+    } else if (state == SERVICE_FAILED) {
+        if (def->optional) {
+            ESP_LOGW(TAG, "%s unavailable: %s", def->name, esp_err_to_name(err));
+        } else {
+            ESP_LOGE(TAG, "%s failed: %s", def->name, esp_err_to_name(err));
+        }
+    } else {
+        ESP_LOGD(TAG, "%s %s", def->name, service_state_name(state));
+    }
+
+    service_event_t event = {
+        .id = id,
+        .name = def->name,
+        .state = state,
+        .err = err,
+        .start_ms = ms,
+    };
+    if (esp_event_post(SERVICE_EVENT, SERVICE_EVENT_STATE, &event, sizeof(event),
+                       pdMS_TO_TICKS(EVENT_POST_WAIT_MS)) != ESP_OK) {
+        ESP_LOGW(TAG, "Event queue full; %s %s not posted", def->name, service_state_name(state));
+    }
+}
+
+/**
+ * @brief Start the stopped and failed services in mask as their dependencies come up; lock held
+ */
+static esp_err_t start_locked(uint32_t mask) {
+    uint32_t todo = 0;
+    for (service_id_t i = 0; i < count; i++) {
+        if ((mask & SERVICE_DEP(i)) != 0 && (states[i] == SERVICE_STOPPED || states[i] == SERVICE_FAILED)) {
+            todo |= SERVICE_DEP(i);
+        }
+    }
+
+    esp_err_t first_err = ESP_OK;
+    uint32_t in_flight = 0;
+    int64_t t0 = esp_timer_get_time();
+    while (1) {
+        // Dependencies have lower ids, so one ascending pass settles everything that can go now
+        for (service_id_t i = 0; i < count; i++) {
+            if ((todo & SERVICE_DEP(i)) == 0) {
+                continue;
+            }
+            uint32_t deps = defs[i].depends;
+            bool ready = true;
+            bool dep_failed = false;
+            for (service_id_t d = 0; d < i; d++) {
+                if ((deps & SERVICE_DEP(d)) == 0) {
+                    continue;
+                }
+                if (states[d] == SERVICE_FAILED) {
+                    dep_failed = true;
+                } else if (states[d] != SERVICE_RUNNING) {
+                    ready = false;
+                }
+            }
+            if (dep_failed) {
+                todo &= ~SERVICE_DEP(i);
+                set_state(i, SERVICE_FAILED, ESP_ERR_INVALID_STATE, 0);
+                if (!defs[i].optional && first_err == ESP_OK) {
+                    first_err = ESP_ERR_INVALID_STATE;
+                }
+            } else if (ready) {
+                todo &= ~SERVICE_DEP(i);
+                set_state(i, SERVICE_STARTING, ESP_OK, 0);
+                xQueueSend(work_queue, &i, portMAX_DELAY);
+                in_flight++;
+            }
+        }
+        if (in_flight == 0) {
+            break;
+        }
+
+        done_t done;
+        if (xQueueReceive(done_queue, &done, pdMS_TO_TICKS(SERVICE_MANAGER_SLOW_START_MS)) != pdTRUE) {
+            for (service_id_t i = 0; i < count; i++) {
+                if (states[i] == SERVICE_STARTING) {
+                    ESP_LOGW(TAG, "Still waiting for %s", defs[i].name);
+                }
+            }
+            continue;
+        }
+        in_flight--;
+        if (done.err == ESP_OK) {
+            set_state(done.id, SERVICE_RUNNING, ESP_OK, done.ms);
+        } else {
+            set_state(done.id, SERVICE_FAILED, done.err, done.ms);
+            if (!defs[done.id].optional && first_err == ESP_OK) {
+                first_err = done.err;
+            }
+        }
+    }
+
+    ESP_LOGI(TAG, "Services settled in %lu ms", (unsigned long)((esp_timer_get_time() - t0) / 1000));
+    return first_err;
+}
+
+esp_err_t service_manager_add(const service_def_t *def, service_id_t *id) {
+    if (def == NULL || def->name == NULL || def->start == NULL || id == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (count >= SERVICE_MANAGER_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+    if ((def->depends & ~(SERVICE_DEP(count) - 1)) != 0) {
+        ESP_LOGE(TAG, "%s depends on a service not registered yet", def->name);
+        return ESP_ERR_INVALID_ARG;
+    }
+    defs[count] = *def;
+    states[count] = SERVICE_STOPPED;
+    *id = count++;
+    return ESP_OK;
+}
+
+esp_err_t service_manager_start_all(void) {
+    esp_err_t err = ensure_workers();
+    if (err != ESP_OK) {
+        return err;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    err = start_locked(UINT32_MAX);
+    xSemaphoreGive(lock);
+    return err;
+}
+
+/**
+ * @brief Stop a service and everything that needs it, directly or through another (lock held)
+ *
+ * @param stopped Receives the SERVICE_DEP() mask of the set, for start_locked()
+ */
+static esp_err_t stop_locked(service_id_t id, uint32_t *stopped) {
+    uint32_t set = SERVICE_DEP(id);
+    for (service_id_t i = id + 1; i < count; i++) {
+        if ((defs[i].depends & set) != 0) {
+            set |= SERVICE_DEP(i);
+        }
+    }
+    for (service_id_t i = id; i < count; i++) {
+        if ((set & SERVICE_DEP(i)) != 0 && states[i] == SERVICE_RUNNING && defs[i].stop == NULL) {
+            ESP_LOGW(TAG, "%s cannot be stopped; %s left running", defs[i].name, defs[id].name);
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    }
+
+    // Dependents first, so none runs without what it needs
+    for (int i = count - 1; i >= id; i--) {
+        if ((set & SERVICE_DEP(i)) != 0 && states[i] == SERVICE_RUNNING) {
+            set_state((service_id_t)i, SERVICE_STOPPING, ESP_OK, 0);
+            esp_err_t stop_err = defs[i].stop();
+            if (stop_err != ESP_OK) {
+                ESP_LOGW(TAG, "%s stop: %s", defs[i].name, esp_err_to_name(stop_err));
+            }
+            set_state((service_id_t)i, SERVICE_STOPPED, stop_err, 0);
+        }
+    }
+    *stopped = set;
+    return ESP_OK;
+}
+
+esp_err_t service_manager_restart(service_id_t id) {
+    if (id >= count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ensure_workers();
+    if (err != ESP_OK) {
+        return err;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    uint32_t set = 0;
+    err = stop_locked(id, &set);
+    if (err == ESP_OK) {
+        err = start_locked(set);
+    }
+    xSemaphoreGive(lock);
+    return err;
+}
+
+esp_err_t service_manager_stop(service_id_t id) {
+    if (id >= count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ensure_workers();
+    if (err != ESP_OK) {
+        return err;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    uint32_t set = 0;
+    err = stop_locked(id, &set);
+    xSemaphoreGive(lock);
+    return err;
+}
+
+service_state_t service_manager_state(service_id_t id) {
+    return id < count ? states[id] : SERVICE_STOPPED;
+}
+
+bool service_manager_all_running(void) {
+    for (service_id_t i = 0; i < count; i++) {
+        if (!defs[i].optional && states[i] != SERVICE_RUNNING) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char *service_state_name(service_state_t state) {
+    switch (state) {
+        case SERVICE_STOPPED:
+            return "stopped";
+        case SERVICE_STARTING:
+            return "starting";
+        case SERVICE_RUNNING:
+            return "running";
+        case SERVICE_STOPPING:
+            return "stopping";
+        case SERVICE_FAILED:
+            return "failed";
+        default:
+            return "unknown";
+    }
+}
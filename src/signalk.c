@@ -0,0 +1,593 @@
+/**
+ * @file signalk.c
+ * @brief Signal K delta stream: environment.* readings over a WebSocket for chartplotters and Node-RED
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "signalk.h"
+#include "sample_bus.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "http_perf.h"
+#include "static_mem.h"
+#include "version.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register signalk.c version
+REGISTER_VERSION(SignalK, "1.0.0", "2026-10-15");
+static const char *TAG = "SIGNALK";
+
+#define STOP_TIMEOUT_MS 2000
+#define RECEIVE_WAIT_MS 500                     // Longest the task blocks before checking for a stop
+#define SELF_LEN 64                             // "vessels.urn:mrn:signalk:uuid:" and a UUID
+#define TIMESTAMP_LEN 32
+#define VALUE_LEN 16
+#define HEADER_LEN 256
+#define FRAME_TRAILER "]}]}"
+#define HELLO_MAX 256
+
+// A path's entry up to its value, fixed at build time
+#define SIGNALK_PATH(p) { p, "{\"path\":\"" p "\",\"value\":", sizeof("{\"path\":\"" p "\",\"value\":") - 1 }
+
+typedef enum {
+    PATH_TEMPERATURE = 0,
+    PATH_PRESSURE,
+    PATH_HUMIDITY,
+    PATH_DEW_POINT,
+    PATH_COUNT
+} signalk_path_t;
+
+typedef struct {
+    const char *path;
+    const char *prefix;
+    uint8_t prefix_len;
+} path_entry_t;
+
+static const path_entry_t paths[PATH_COUNT] = {
+    SIGNALK_PATH("environment.outside.temperature"),
+    SIGNALK_PATH("environment.outside.pressure"),
+    SIGNALK_PATH("environment.outside.relativeHumidity"),
+    SIGNALK_PATH("environment.outside.dewPointTemperature"),
+};
+
+#define PATHS_ALL ((uint32_t)((1u << PATH_COUNT) - 1))
+
+_Static_assert(PATH_COUNT <= 32, "Subscriptions are a 32-bit mask");
+
+typedef struct {
+    int fd;
+    uint32_t paths;                             // Bit per paths[] entry the client follows
+} signalk_client_t;
+
+/**
+ * @brief A subscribe or unsubscribe message as it is parsed
+ */
+typedef struct {
+    bool unsubscribe;                           // Inside "unsubscribe" rather than "subscribe"
+    bool in_list;
+    bool other_context;                         // "context" names another vessel
+    uint32_t add;
+    uint32_t remove;
+} subscribe_parse_t;
+
+// The client list and every send (two tasks must not interleave frames on one
+// socket) hold client_lock. The frame buffers belong to the delta task, the
+// hello and rx buffers to the httpd task.
+static httpd_handle_t stream_server = NULL;
+static SemaphoreHandle_t client_lock = NULL;
+static signalk_client_t clients[SIGNALK_MAX_CLIENTS];
+static volatile uint32_t client_count = 0;
+static char self_context[SELF_LEN];
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(task_slot, SIGNALK_TASK_STACK_SIZE);
+static volatile bool run = false;
+static sample_bus_sub_t *bus_sub = NULL;
+static char frame[SIGNALK_FRAME_MAX];
+static char rx_buf[SIGNALK_RX_MAX + 1];
+static uint32_t last_time_s = 0;                // Reading last sent, delta task only
+static int64_t last_sent_us = 0;
+static bool have_sent = false;
+static signalk_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================
+// Function Prototypes
+// =============================
+static void make_self_context(void);
+static void format_timestamp(char *buf, size_t len, uint32_t time_s);
+static int32_t dew_point_centi_k(const telemetry_record_t *rec);
+static bool path_match(const char *pattern, const char *path);
+static uint32_t paths_matching(const char *pattern);
+static esp_err_t subscribe_on_event(void *ctx, const json_event_t *event);
+static void add_client(int fd, uint32_t mask);
+static void remove_client(uint32_t index);
+static void send_update(uint32_t node_id, const telemetry_record_t *rec);
+static void signalk_task(void *arg);
+static esp_err_t discovery_handler(httpd_req_t *req);
+static esp_err_t stream_handler(httpd_req_t *req);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief "vessels.urn:mrn:signalk:uuid:..." with a UUID fixed by this board's MAC
+ */
+static void make_self_context(void) {
+    uint8_t mac[6] = { 0 };
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(self_context, sizeof(self_context),
+             "vessels.urn:mrn:signalk:uuid:00000000-0000-4000-8000-%02x%02x%02x%02x%02x%02x",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+/**
+ * @brief ISO 8601 UTC, as Signal K timestamps are written
+ */
+static void format_timestamp(char *buf, size_t len, uint32_t time_s) {
+    time_t t = (time_t)time_s;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(buf, len, "%Y-%m-%dT%H:%M:%S.000Z", &tm);
+}
+
+/**
+ * @brief Dew point (Magnus formula), 0.01 K
+ */
+static int32_t dew_point_centi_k(const telemetry_record_t *rec) {
+    const float b = 17.62f;
+    const float c = 243.12f;
+    float t = rec->temperature / 100.0f;
+    float rh = rec->humidity / 1000.0f;
+    if (rh < 0.1f) {
+        rh = 0.1f;
+    }
+    float gamma = logf(rh / 100.0f) + b * t / (c + t);
+    return (int32_t)lroundf((c * gamma / (b - gamma) + 273.15f) * 100.0f);
+}
+
+/**
+ * @brief Match a subscription path, where '*' stands for any run of characters
+ */
+static bool path_match(const char *pattern, const char *path) {
+    const char *star = NULL;
+    const char *resume = NULL;
+    while (*path != '\0') {
+        if (*pattern == '*') {
+            star = pattern++;
+            resume = path;
+        } else if (*pattern == *path) {
+            pattern++;
+            path++;
+        } else if (star != NULL) {
+            pattern = star + 1;
+            path = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*') {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+static uint32_t paths_matching(const char *pattern) {
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < PATH_COUNT; i++) {
+        if (path_match(pattern, paths[i].path)) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+/**
+ * @brief Collect the paths of {"context":...,"subscribe"|"unsubscribe":[{"path":...},...]}
+ */
+static esp_err_t subscribe_on_event(void *ctx, const json_event_t *event) {
+    subscribe_parse_t *parse = (subscribe_parse_t *)ctx;
+    if (event->depth == 1 && event->key != NULL) {
+        if (event->type == JSON_EVENT_ARRAY_BEGIN) {
+            parse->in_list = strcmp(event->key, "subscribe") == 0 || strcmp(event->key, "unsubscribe") == 0;
+            parse->unsubscribe = strcmp(event->key, "unsubscribe") == 0;
+        } else if (event->type == JSON_EVENT_STRING && strcmp(event->key, "context") == 0) {
+            parse->other_context = !path_match(event->value, "vessels.self") &&
+                                   !path_match(event->value, self_context);
+        }
+    } else if (event->type == JSON_EVENT_ARRAY_END && event->depth == 1) {
+        parse->in_list = false;
+    } else if (parse->in_list && event->depth == 3 && event->type == JSON_EVENT_STRING &&
+               event->key != NULL && strcmp(event->key, "path") == 0) {
+        uint32_t mask = paths_matching(event->value);
+        if (parse->unsubscribe) {
+            parse->remove |= mask;
+        } else {
+            parse->add |= mask;
+        }
+    }
+    return ESP_OK;
+}
+
+static void add_client(int fd, uint32_t mask) {
+    xSemaphoreTake(client_lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < client_count; i++) {
+        if (clients[i].fd == fd) {
+            clients[i].paths = mask;
+            xSemaphoreGive(client_lock);
+            return;
+        }
+    }
+    if (client_count >= SIGNALK_MAX_CLIENTS) {
+        xSemaphoreGive(client_lock);
+        ESP_LOGW(TAG, "Client limit (%d) reached, fd %d will not receive deltas", SIGNALK_MAX_CLIENTS, fd);
+        return;
+    }
+    clients[client_count].fd = fd;
+    clients[client_count].paths = mask;
+    client_count++;
+    uint32_t count = client_count;
+    xSemaphoreGive(client_lock);
+    ESP_LOGI(TAG, "Client added (fd %d), %lu connected", fd, (unsigned long)count);
+}
+
+/**
+ * @brief Drop a client (caller holds client_lock)
+ */
+static void remove_client(uint32_t index) {
+    ESP_LOGI(TAG, "Client removed (fd %d)", clients[index].fd);
+    clients[index] = clients[client_count - 1];
+    client_count--;
+}
+
+/**
+ * @brief Turn one record into a delta and send it to every client, one frame per distinct path set
+ */
+static void send_update(uint32_t node_id, const telemetry_record_t *rec) {
+    if (SIGNALK_NODE_ID != 0 && node_id != SIGNALK_NODE_ID) {
+        return;
+    }
+    // Replayed backlog records are older than the reading already sent; a stale one gives way
+    int64_t now_us = esp_timer_get_time();
+    if (have_sent && rec->time_s < last_time_s && now_us - last_sent_us < (int64_t)SIGNALK_STALE_MS * 1000) {
+        return;
+    }
+    have_sent = true;
+    last_time_s = rec->time_s;
+    last_sent_us = now_us;
+
+    // Everything that depends on the record is formatted once
+    char values[PATH_COUNT][VALUE_LEN];
+    int value_len[PATH_COUNT];
+    long centi_k = (long)rec->temperature + 27315;
+    value_len[PATH_TEMPERATURE] = snprintf(values[PATH_TEMPERATURE], VALUE_LEN, "%ld.%02ld", centi_k / 100,
+                                           centi_k % 100);
+    value_len[PATH_PRESSURE] = snprintf(values[PATH_PRESSURE], VALUE_LEN, "%lu", (unsigned long)rec->pressure);
+    value_len[PATH_HUMIDITY] = snprintf(values[PATH_HUMIDITY], VALUE_LEN, "%lu.%05lu",
+                                        (unsigned long)(rec->humidity / 100000),
+                                        (unsigned long)(rec->humidity % 100000));
+    long dew = dew_point_centi_k(rec);
+    value_len[PATH_DEW_POINT] = snprintf(values[PATH_DEW_POINT], VALUE_LEN, "%ld.%02ld", dew / 100, dew % 100);
+
+    char timestamp[TIMESTAMP_LEN];
+    format_timestamp(timestamp, sizeof(timestamp), rec->time_s);
+    char header[HEADER_LEN];
+    int header_len = snprintf(header, sizeof(header),
+                              "{\"context\":\"%s\",\"updates\":[{\"source\":{\"label\":\"weather-station\","
+                              "\"type\":\"ESP-NOW\",\"src\":\"%08lx\"},\"timestamp\":\"%s\",\"values\":[",
+                              self_context, (unsigned long)node_id, timestamp);
+    if (header_len < 0 || (size_t)header_len >= sizeof(header)) {
+        return;
+    }
+
+    uint32_t built = 0;
+    uint32_t sent = 0;
+    uint32_t dropped = 0;
+    xSemaphoreTake(client_lock, portMAX_DELAY);
+    bool done[SIGNALK_MAX_CLIENTS] = { false };
+    uint32_t i = 0;
+    while (i < client_count) {
+        uint32_t mask = clients[i].paths;
+        if (done[i] || mask == 0) {
+            i++;
+            continue;
+        }
+
+        size_t len = (size_t)header_len;
+        memcpy(frame, header, len);
+        bool first = true;
+        for (uint32_t p = 0; p < PATH_COUNT; p++) {
+            if ((mask & (1u << p)) == 0) {
+                continue;
+            }
+            if (!first) {
+                frame[len++] = ',';
+            }
+            first = false;
+            memcpy(frame + len, paths[p].prefix, paths[p].prefix_len);
+            len += paths[p].prefix_len;
+            memcpy(frame + len, values[p], (size_t)value_len[p]);
+            len += (size_t)value_len[p];
+            frame[len++] = '}';
+        }
+        memcpy(frame + len, FRAME_TRAILER, strlen(FRAME_TRAILER));
+        len += strlen(FRAME_TRAILER);
+        built++;
+
+        httpd_ws_frame_t ws_frame = {
+            .final = true,
+            .fragmented = false,
+            .type = HTTPD_WS_TYPE_TEXT,
+            .payload = (uint8_t *)frame,
+            .len = len
+        };
+        // This client and every later one that follows the same paths; the list only shrinks
+        // from the back, so a client moved into slot j has not been served yet
+        uint32_t j = i;
+        while (j < client_count) {
+            if (done[j] || clients[j].paths != mask) {
+                j++;
+                continue;
+            }
+            if (httpd_ws_get_fd_info(stream_server, clients[j].fd) != HTTPD_WS_CLIENT_WEBSOCKET ||
+                httpd_ws_send_frame_async(stream_server, clients[j].fd, &ws_frame) != ESP_OK) {
+                remove_client(j);
+                done[j] = done[client_count];
+                dropped++;
+                continue;  // The last client moved into slot j
+            }
+            done[j] = true;
+            sent++;
+            j++;
+        }
+        // Slot i is served now, or holds a client moved from the back: look at it again
+    }
+    xSemaphoreGive(client_lock);
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.updates++;
+    stats.frames += built;
+    stats.sent += sent;
+    stats.dropped += dropped;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief Take each record off the bus and send it while anybody listens
+ */
+static void signalk_task(void *arg) {
+    (void)arg;
+    while (run) {
+        const sample_block_t *block = sample_bus_receive(bus_sub, pdMS_TO_TICKS(RECEIVE_WAIT_MS));
+        if (block == NULL) {
+            continue;
+        }
+        if (stream_server != NULL && client_count > 0) {
+            send_update(block->node_id, &block->rec);
+        }
+        sample_bus_release(block);
+    }
+    task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief GET /signalk: where the stream is, for clients that discover the server
+ */
+static esp_err_t discovery_handler(httpd_req_t *req) {
+    char host[64];
+    if (httpd_req_get_hdr_value_str(req, "Host", host, sizeof(host)) != ESP_OK) {
+        strlcpy(host, "192.168.4.1", sizeof(host));
+    }
+    char ws_url[sizeof(host) + sizeof(SIGNALK_STREAM_URI) + 8];
+    snprintf(ws_url, sizeof(ws_url), "ws://%s%s", host, SIGNALK_STREAM_URI);
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    json_obj_begin(&w);
+    json_key(&w, "endpoints");
+    json_obj_begin(&w);
+    json_key(&w, "v1");
+    json_obj_begin(&w);
+    json_kv_str(&w, "version", SIGNALK_VERSION);
+    json_kv_str(&w, "signalk-ws", ws_url);
+    json_obj_end(&w);
+    json_obj_end(&w);
+    json_key(&w, "server");
+    json_obj_begin(&w);
+    json_kv_str(&w, "id", PROJECT_NAME);
+    json_kv_str(&w, "version", PROJECT_VERSION);
+    json_obj_end(&w);
+    json_obj_end(&w);
+    return json_writer_finish(&w);
+}
+
+static esp_err_t stream_handler(httpd_req_t *req) {
+    int fd = httpd_req_to_sockfd(req);
+    if (req->method == HTTP_GET) {
+        // Handshake complete: ?subscribe=none starts with no paths, self and all with every one
+        char query[48];
+        char mode[8] = "self";
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            httpd_query_key_value(query, "subscribe", mode, sizeof(mode));
+        }
+        add_client(fd, strcmp(mode, "none") == 0 ? 0 : PATHS_ALL);
+
+        char timestamp[TIMESTAMP_LEN];
+        format_timestamp(timestamp, sizeof(timestamp), (uint32_t)time(NULL));
+        char hello[HELLO_MAX];
+        int len = snprintf(hello, sizeof(hello),
+                           "{\"name\":\"%s\",\"version\":\"%s\",\"self\":\"%s\",\"roles\":[\"master\",\"main\"],"
+                           "\"timestamp\":\"%s\"}",
+                           PROJECT_NAME, SIGNALK_VERSION, self_context, timestamp);
+        if (len > 0 && (size_t)len < sizeof(hello)) {
+            httpd_ws_frame_t ws_frame = {
+                .final = true,
+                .fragmented = false,
+                .type = HTTPD_WS_TYPE_TEXT,
+                .payload = (uint8_t *)hello,
+                .len = (size_t)len
+            };
+            xSemaphoreTake(client_lock, portMAX_DELAY);
+            httpd_ws_send_frame_async(req->handle, fd, &ws_frame);
+            xSemaphoreGive(client_lock);
+        }
+        return ESP_OK;
+    }
+
+    httpd_ws_frame_t ws_frame = { .type = HTTPD_WS_TYPE_TEXT };
+    esp_err_t err = httpd_ws_recv_frame(req, &ws_frame, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read frame length: %s", esp_err_to_name(err));
+        return err;
+    }
+    if (ws_frame.len == 0 || ws_frame.len > SIGNALK_RX_MAX) {
+        return ESP_OK;  // Nothing we understand; ignore it
+    }
+    ws_frame.payload = (uint8_t *)rx_buf;
+    err = httpd_ws_recv_frame(req, &ws_frame, ws_frame.len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read frame: %s", esp_err_to_name(err));
+        return err;
+    }
+    if (ws_frame.type != HTTPD_WS_TYPE_TEXT) {
+        return ESP_OK;
+    }
+
+    subscribe_parse_t parse = { 0 };
+    json_reader_t reader;
+    json_reader_init(&reader, subscribe_on_event, &parse);
+    json_reader_feed(&reader, rx_buf, ws_frame.len);
+    if (json_reader_finish(&reader) != ESP_OK || parse.other_context) {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(client_lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < client_count; i++) {
+        if (clients[i].fd == fd) {
+            clients[i].paths = (clients[i].paths | parse.add) & ~parse.remove;
+        }
+    }
+    xSemaphoreGive(client_lock);
+    return ESP_OK;
+}
+
+esp_err_t signalk_register(httpd_handle_t server) {
+    if (server == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (client_lock == NULL) {
+        client_lock = xSemaphoreCreateMutex();
+        if (client_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    make_self_context();
+
+    httpd_uri_t discovery_uri = {
+        .uri = SIGNALK_URI,
+        .method = HTTP_GET,
+        .handler = discovery_handler,
+        .user_ctx = NULL
+    };
+    esp_err_t err = http_perf_register(server, &discovery_uri);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register %s: %s", SIGNALK_URI, esp_err_to_name(err));
+        return err;
+    }
+
+    httpd_uri_t stream_uri = {
+        .uri = SIGNALK_STREAM_URI,
+        .method = HTTP_GET,
+        .handler = stream_handler,
+        .user_ctx = NULL,
+        .is_websocket = true
+    };
+    err = http_perf_register(server, &stream_uri);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register %s: %s", SIGNALK_STREAM_URI, esp_err_to_name(err));
+        return err;
+    }
+
+    xSemaphoreTake(client_lock, portMAX_DELAY);
+    client_count = 0;
+    stream_server = server;
+    xSemaphoreGive(client_lock);
+    ESP_LOGI(TAG, "Signal K %s stream on %s", SIGNALK_VERSION, SIGNALK_STREAM_URI);
+    return ESP_OK;
+}
+
+void signalk_unregister(void) {
+    if (client_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(client_lock, portMAX_DELAY);
+    stream_server = NULL;
+    client_count = 0;
+    xSemaphoreGive(client_lock);
+}
+
+esp_err_t signalk_start(void) {
+    if (task_handle != NULL) {
+        return ESP_OK;
+    }
+    esp_err_t err = sample_bus_subscribe("signalk", SIGNALK_BUS_DEPTH, &bus_sub);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    have_sent = false;
+    run = true;
+    if (static_task_create(task_slot, signalk_task, SIGNALK_TASK_NAME, SIGNALK_TASK_STACK_SIZE, NULL,
+                           SIGNALK_TASK_PRIORITY, &task_handle, TASK_CORE_NET) != pdPASS) {
+        run = false;
+        task_handle = NULL;
+        sample_bus_unsubscribe(bus_sub);
+        bus_sub = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void signalk_stop(void) {
+    if (task_handle == NULL) {
+        return;
+    }
+    run = false;
+    for (int waited = 0; task_handle != NULL && waited < STOP_TIMEOUT_MS; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    if (task_handle != NULL) {
+        ESP_LOGW(TAG, "Delta task did not stop");
+        return;
+    }
+    sample_bus_unsubscribe(bus_sub);
+    bus_sub = NULL;
+}
+
+void signalk_get_stats(signalk_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+    out->clients = client_count;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file spsc_ring.c
+ * @brief Lock-free single-producer, single-consumer ring of fixed-size slots
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "spsc_ring.h"
+#include "iram_profile.h"
+#include "version.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register spsc_ring.c version
+REGISTER_VERSION(SpscRing, "1.0.0", "2026-10-15");
+
+// =============================
+// Function Definitions
+// =============================
+
+esp_err_t spsc_ring_init(spsc_ring_t *ring, void *storage, size_t slot_size, uint32_t slots) {
+    if (ring == NULL || storage == NULL || slot_size == 0 || slots == 0 || (slots & (slots - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ring->storage = storage;
+    ring->slot_size = slot_size;
+    ring->mask = slots - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->high_water = 0;
+    return ESP_OK;
+}
+
+HOT_IRAM_ATTR void *spsc_ring_acquire(spsc_ring_t *ring) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);   // The consumer is done with the slot
+    if (head - tail > ring->mask) {
+        return NULL;
+    }
+    return ring->storage + (size_t)(head & ring->mask) * ring->slot_size;
+}
+
+HOT_IRAM_ATTR void spsc_ring_commit(spsc_ring_t *ring) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED) + 1;
+    uint32_t used = head - __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    if (used > ring->high_water) {
+        ring->high_water = used;
+    }
+    __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);             // Publish the slot's contents first
+}
+
+HOT_IRAM_ATTR void *spsc_ring_front(spsc_ring_t *ring) {
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);   // See what the producer wrote
+    if (head == tail) {
+        return NULL;
+    }
+    return ring->storage + (size_t)(tail & ring->mask) * ring->slot_size;
+}
+
+HOT_IRAM_ATTR void spsc_ring_release(spsc_ring_t *ring) {
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);         // Reads of the slot finish first
+}
+
+HOT_IRAM_ATTR uint32_t spsc_ring_count(const spsc_ring_t *ring) {
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+HOT_IRAM_ATTR uint32_t spsc_ring_space(const spsc_ring_t *ring) {
+    return ring->mask + 1 - spsc_ring_count(ring);
+}
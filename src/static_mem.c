@@ -0,0 +1,76 @@
+/**
+ * @file static_mem.c
+ * @brief Static memory build: task stacks and request buffers fixed at link time instead of taken from the heap
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "static_mem.h"
+#include "version.h"
+#include "esp_log.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register static_mem.c version
+REGISTER_VERSION(StaticMem, "1.0.0", "2026-10-15");
+
+static const char *TAG = "STATIC_MEM";
+
+static portMUX_TYPE mem_lock = portMUX_INITIALIZER_UNLOCKED;
+static static_mem_stats_t totals;               // Under mem_lock
+
+// =============================
+// Function Definitions
+// =============================
+
+BaseType_t static_task_create(static_task_slot_t *slot, TaskFunction_t fn, const char *name, uint32_t stack_size,
+                              void *arg, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id) {
+    if (slot != NULL && !slot->used && stack_size <= slot->stack_size) {
+        TaskHandle_t created = xTaskCreateStaticPinnedToCore(fn, name, slot->stack_size, arg, priority, slot->stack,
+                                                             &slot->tcb, core_id);
+        if (created == NULL) {
+            return pdFAIL;
+        }
+        slot->used = true;
+        if (handle != NULL) {
+            *handle = created;
+        }
+        portENTER_CRITICAL(&mem_lock);
+        totals.static_tasks++;
+        totals.static_stack_bytes += slot->stack_size;
+        portEXIT_CRITICAL(&mem_lock);
+        return pdPASS;
+    }
+
+    if (slot != NULL) {
+        ESP_LOGW(TAG, "%s started again, stack from the heap", name);
+        portENTER_CRITICAL(&mem_lock);
+        totals.heap_tasks++;
+        portEXIT_CRITICAL(&mem_lock);
+    }
+    return xTaskCreatePinnedToCore(fn, name, stack_size, arg, priority, handle, core_id);
+}
+
+void static_mem_get_stats(static_mem_stats_t *stats) {
+    portENTER_CRITICAL(&mem_lock);
+    *stats = totals;
+    portEXIT_CRITICAL(&mem_lock);
+    stats->enabled = STATIC_MEMORY != 0;
+}
+
+void static_mem_write_json(json_writer_t *w) {
+    static_mem_stats_t s;
+    static_mem_get_stats(&s);
+    json_obj_begin(w);
+    json_kv_bool(w, "enabled", s.enabled);
+    json_kv_uint(w, "staticTasks", s.static_tasks);
+    json_kv_uint(w, "staticStackBytes", s.static_stack_bytes);
+    json_kv_uint(w, "heapTasks", s.heap_tasks);
+    json_obj_end(w);
+}
@@ -0,0 +1,195 @@
+/**
+ * @file storage.c
+ * @brief Filesystem backend for the "spiffs" partition: SPIFFS or LittleFS, chosen at build time
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "storage.h"
+#include "flash_io.h"
+#include "version.h"
+#include <string.h>
+#include "esp_timer.h"
+#include "nvs.h"
+#if STORAGE_LITTLEFS
+#include "esp_littlefs.h"
+#else
+#include "esp_spiffs.h"
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register storage.c version
+REGISTER_VERSION(Storage, "1.0.0", "2026-10-15");
+
+static const char *const SLOT_LABELS[] = { STORAGE_PARTITION_LABEL, STORAGE_PARTITION_B_LABEL };
+
+// Slot mounted at the data path; read from NVS on first use, moved only by storage_set_active()
+static const char *active_label = NULL;
+
+// =============================
+// Function Definitions
+// =============================
+
+const char *storage_name(void) {
+    return STORAGE_LITTLEFS != 0 ? "LittleFS" : "SPIFFS";
+}
+
+#if STORAGE_LITTLEFS
+
+esp_err_t storage_mount_partition(const char *label, const char *base_path, size_t max_files,
+                                  bool format_if_mount_failed) {
+    (void)max_files;
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = base_path,
+        .partition_label = label,
+        .format_if_mount_failed = format_if_mount_failed,
+        .dont_mount = false,
+    };
+    return esp_vfs_littlefs_register(&conf);
+}
+
+esp_err_t storage_unmount_partition(const char *label) {
+    return esp_vfs_littlefs_unregister(label);
+}
+
+bool storage_partition_mounted(const char *label) {
+    return esp_littlefs_mounted(label);
+}
+
+esp_err_t storage_partition_info(const char *label, size_t *total, size_t *used) {
+    return esp_littlefs_info(label, total, used);
+}
+
+esp_err_t storage_format_partition(const char *label) {
+    return esp_littlefs_format(label);
+}
+
+#else
+
+esp_err_t storage_mount_partition(const char *label, const char *base_path, size_t max_files,
+                                  bool format_if_mount_failed) {
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = base_path,
+        .partition_label = label,
+        .max_files = max_files,
+        .format_if_mount_failed = format_if_mount_failed,
+    };
+    return esp_vfs_spiffs_register(&conf);
+}
+
+esp_err_t storage_unmount_partition(const char *label) {
+    return esp_vfs_spiffs_unregister(label);
+}
+
+bool storage_partition_mounted(const char *label) {
+    return esp_spiffs_mounted(label);
+}
+
+esp_err_t storage_partition_info(const char *label, size_t *total, size_t *used) {
+    return esp_spiffs_info(label, total, used);
+}
+
+esp_err_t storage_format_partition(const char *label) {
+    return esp_spiffs_format(label);
+}
+
+#endif
+
+const char *storage_active_label(void) {
+    if (active_label != NULL) {
+        return active_label;
+    }
+    if (storage_find_partition(STORAGE_PARTITION_B_LABEL) == NULL) {
+        active_label = STORAGE_PARTITION_LABEL;
+        return active_label;
+    }
+
+    uint8_t slot = 0;
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(STORAGE_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_OK) {
+        nvs_get_u8(handle, STORAGE_NVS_SLOT_KEY, &slot);
+        nvs_close(handle);
+    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
+        return STORAGE_PARTITION_LABEL;         // NVS not up yet: answer, but ask again next time
+    }
+    active_label = SLOT_LABELS[slot == 1 ? 1 : 0];
+    return active_label;
+}
+
+const char *storage_spare_label(void) {
+    if (storage_find_partition(STORAGE_PARTITION_B_LABEL) == NULL) {
+        return NULL;
+    }
+    return strcmp(storage_active_label(), STORAGE_PARTITION_LABEL) == 0 ? STORAGE_PARTITION_B_LABEL
+                                                                       : STORAGE_PARTITION_LABEL;
+}
+
+esp_err_t storage_set_active(const char *label) {
+    uint8_t slot;
+    if (label != NULL && strcmp(label, STORAGE_PARTITION_LABEL) == 0) {
+        slot = 0;
+    } else if (label != NULL && strcmp(label, STORAGE_PARTITION_B_LABEL) == 0 &&
+               storage_find_partition(STORAGE_PARTITION_B_LABEL) != NULL) {
+        slot = 1;
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(STORAGE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    int64_t start = esp_timer_get_time();
+    err = nvs_set_u8(handle, STORAGE_NVS_SLOT_KEY, slot);
+    flash_io_record_nvs(STORAGE_NVS_SLOT_KEY, sizeof(slot), start, err);
+    if (err == ESP_OK) {
+        err = flash_io_nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (err == ESP_OK) {
+        active_label = SLOT_LABELS[slot];
+    }
+    return err;
+}
+
+esp_err_t storage_mount(const char *base_path, size_t max_files, bool format_if_mount_failed) {
+    return storage_mount_partition(storage_active_label(), base_path, max_files, format_if_mount_failed);
+}
+
+esp_err_t storage_unmount(void) {
+    return storage_unmount_partition(storage_active_label());
+}
+
+bool storage_mounted(void) {
+    return storage_partition_mounted(storage_active_label());
+}
+
+esp_err_t storage_info(size_t *total, size_t *used) {
+    return storage_partition_info(storage_active_label(), total, used);
+}
+
+esp_err_t storage_format(void) {
+    return storage_format_partition(storage_active_label());
+}
+
+const esp_partition_t *storage_find_partition(const char *label) {
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, label);
+}
+
+esp_err_t storage_check_image(const uint8_t *data, size_t len) {
+    size_t magic_len = strlen(STORAGE_LITTLEFS_MAGIC);
+    if (data == NULL || len < STORAGE_LITTLEFS_MAGIC_OFFSET + magic_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    bool littlefs = memcmp(data + STORAGE_LITTLEFS_MAGIC_OFFSET, STORAGE_LITTLEFS_MAGIC, magic_len) == 0;
+    return littlefs == (STORAGE_LITTLEFS != 0) ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+}
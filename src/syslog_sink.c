@@ -0,0 +1,290 @@
+/**
+ * @file syslog_sink.c
+ * @brief Gateway log output copied to a remote syslog collector over UDP
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "syslog_sink.h"
+#include "static_mem.h"
+#include "task_plan.h"
+#include "version.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register syslog_sink.c version
+REGISTER_VERSION(SyslogSink, "1.0.0", "2026-10-15");
+static const char *TAG = "SYSLOG";
+
+#define STOP_TIMEOUT_MS 1000
+#define HOSTNAME_LEN 12                         // "wsgw-" and six hex digits, terminator included
+
+static syslog_sink_stats_t stats;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool hooked = false;            // The hook queues lines only while set
+static vprintf_like_t previous = NULL;          // Output the hook passes every line on to
+static int sock = -1;
+static struct sockaddr_in collector;
+static char hostname[HOSTNAME_LEN];
+static RingbufHandle_t ring = NULL;             // Kept once created: a hook call may still be inside it
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(syslog_task_slot, SYSLOG_TASK_STACK_SIZE);
+static SemaphoreHandle_t stopped_sem = NULL;
+static volatile bool stopping = false;
+
+// Send task only
+static char datagram[SYSLOG_DATAGRAM_MAX];
+static size_t datagram_len = 0;
+static uint32_t datagram_lines = 0;
+
+// =============================
+// Function Prototypes
+// =============================
+static int syslog_vprintf(const char *format, va_list args);
+static bool station_up(void);
+static void flush_datagram(void);
+static void append_line(const char *line);
+static void syslog_task(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief esp_log output hook: format the line into the ring, then print it as before
+ */
+static int syslog_vprintf(const char *format, va_list args) {
+    if (hooked) {
+        void *slot = NULL;
+        if (xRingbufferSendAcquire(ring, &slot, SYSLOG_LINE_MAX, 0) == pdTRUE) {
+            va_list copy;
+            va_copy(copy, args);
+            vsnprintf((char *)slot, SYSLOG_LINE_MAX, format, copy);
+            va_end(copy);
+            xRingbufferSendComplete(ring, slot);
+        } else {
+            portENTER_CRITICAL(&lock);
+            stats.dropped++;
+            portEXIT_CRITICAL(&lock);
+        }
+    }
+    return previous != NULL ? previous(format, args) : vprintf(format, args);
+}
+
+/**
+ * @brief Whether the station has an address to send from
+ */
+static bool station_up(void) {
+    esp_netif_t *sta = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_ip_info_t ip_info;
+    return sta != NULL && esp_netif_get_ip_info(sta, &ip_info) == ESP_OK && ip_info.ip.addr != 0;
+}
+
+/**
+ * @brief Send the lines collected so far as one datagram
+ */
+static void flush_datagram(void) {
+    if (datagram_lines == 0) {
+        return;
+    }
+    uint32_t lines = datagram_lines;
+    bool up = station_up();
+    bool ok = up && sendto(sock, datagram, datagram_len, 0, (struct sockaddr *)&collector, sizeof(collector)) >= 0;
+    datagram_len = 0;
+    datagram_lines = 0;
+
+    // Counted, not logged: a log line here would come straight back through the hook
+    portENTER_CRITICAL(&lock);
+    if (ok) {
+        stats.lines += lines;
+        stats.datagrams++;
+    } else if (!up) {
+        stats.no_uplink += lines;
+    } else {
+        stats.errors++;
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+/**
+ * @brief Add one ESP log line as "<PRI>HOSTNAME TAG: text\n", sending first if it does not fit
+ */
+static void append_line(const char *line) {
+    // "\033[0;31mE (1234) TAG: text\033[0m\n" with colours, "E (1234) TAG: text\n" without
+    const char *p = line;
+    if (*p == '\033') {
+        const char *m = strchr(p, 'm');
+        p = m != NULL ? m + 1 : p;
+    }
+    int severity;
+    switch (*p) {
+        case 'E':
+            severity = 3;
+            break;
+        case 'W':
+            severity = 4;
+            break;
+        case 'I':
+            severity = 6;
+            break;
+        case 'D':
+        case 'V':
+            severity = 7;
+            break;
+        default:
+            severity = 5;
+            break;
+    }
+    if (severity != 5 && p[1] == ' ' && p[2] == '(') {
+        const char *close = strstr(p, ") ");
+        if (close != NULL) {
+            p = close + 2;
+        }
+    }
+    size_t len = strlen(p);
+    while (len > 0 && (p[len - 1] == '\n' || p[len - 1] == '\r')) {
+        len--;
+    }
+    if (len >= 4 && strncmp(p + len - 4, "\033[0m", 4) == 0) {
+        len -= 4;
+    }
+    if (len == 0) {
+        return;
+    }
+
+    char header[32];
+    int header_len = snprintf(header, sizeof(header), "<%d>%s ", SYSLOG_FACILITY * 8 + severity, hostname);
+    if (header_len < 0) {
+        return;
+    }
+    size_t need = (size_t)header_len + len + 1;
+    if (need > sizeof(datagram)) {
+        len = sizeof(datagram) - (size_t)header_len - 1;
+        need = sizeof(datagram);
+    }
+    if (datagram_len + need > sizeof(datagram)) {
+        flush_datagram();
+    }
+    memcpy(datagram + datagram_len, header, (size_t)header_len);
+    memcpy(datagram + datagram_len + header_len, p, len);
+    datagram_len += need;
+    datagram[datagram_len - 1] = '\n';
+    datagram_lines++;
+}
+
+/**
+ * @brief Collect lines for up to SYSLOG_BATCH_MS after the first, then send them together
+ */
+static void syslog_task(void *arg) {
+    (void)arg;
+    while (!stopping) {
+        size_t size;
+        char *line = xRingbufferReceive(ring, &size, portMAX_DELAY);
+        int64_t deadline_us = esp_timer_get_time() + (int64_t)SYSLOG_BATCH_MS * 1000;
+        while (line != NULL) {
+            line[size - 1] = '\0';
+            if (!stopping) {
+                append_line(line);
+            }
+            vRingbufferReturnItem(ring, line);
+            int64_t left_us = deadline_us - esp_timer_get_time();
+            line = left_us > 0 && !stopping ? xRingbufferReceive(ring, &size, pdMS_TO_TICKS(left_us / 1000) + 1)
+                                            : NULL;
+        }
+        flush_datagram();
+    }
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t syslog_sink_start(void) {
+    if (task_handle != NULL) {
+        return ESP_OK;
+    }
+    memset(&stats, 0, sizeof(stats));
+    memset(&collector, 0, sizeof(collector));
+    collector.sin_family = AF_INET;
+    collector.sin_port = htons(SYSLOG_PORT);
+    collector.sin_addr.s_addr = inet_addr(SYSLOG_HOST);
+    if (collector.sin_addr.s_addr == INADDR_NONE) {
+        ESP_LOGE(TAG, "SYSLOG_HOST %s is not an IPv4 address", SYSLOG_HOST);
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t mac[6] = { 0 };
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(hostname, sizeof(hostname), "wsgw-%02x%02x%02x", mac[3], mac[4], mac[5]);
+
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Unable to create UDP socket: errno %d", errno);
+        return ESP_FAIL;
+    }
+    if (ring == NULL) {
+        ring = xRingbufferCreate(SYSLOG_RING_BYTES, RINGBUF_TYPE_NOSPLIT);
+    }
+    if (stopped_sem == NULL) {
+        stopped_sem = xSemaphoreCreateBinary();
+    }
+    stopping = false;
+    datagram_len = 0;
+    datagram_lines = 0;
+    if (ring == NULL || stopped_sem == NULL ||
+        static_task_create(syslog_task_slot, syslog_task, SYSLOG_TASK_NAME, SYSLOG_TASK_STACK_SIZE, NULL,
+                           SYSLOG_TASK_PRIORITY, &task_handle, TASK_CORE_NET) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the send task");
+        task_handle = NULL;
+        close(sock);
+        sock = -1;
+        return ESP_ERR_NO_MEM;
+    }
+
+    previous = esp_log_set_vprintf(syslog_vprintf);
+    hooked = true;
+    stats.running = true;
+    ESP_LOGI(TAG, "Log output to %s:%d as %s", SYSLOG_HOST, SYSLOG_PORT, hostname);
+    return ESP_OK;
+}
+
+void syslog_sink_stop(void) {
+    if (task_handle == NULL) {
+        return;
+    }
+    hooked = false;
+    esp_log_set_vprintf(previous != NULL ? previous : vprintf);
+
+    // Wake the task with an empty line; it sees stopping and exits
+    stopping = true;
+    char wake = '\0';
+    xRingbufferSend(ring, &wake, sizeof(wake), pdMS_TO_TICKS(STOP_TIMEOUT_MS));
+    if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(STOP_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Send task did not stop within %d ms", STOP_TIMEOUT_MS);
+    }
+    task_handle = NULL;
+    close(sock);
+    sock = -1;
+    stats.running = false;
+}
+
+void syslog_sink_get_stats(syslog_sink_stats_t *out) {
+    portENTER_CRITICAL(&lock);
+    *out = stats;
+    portEXIT_CRITICAL(&lock);
+}
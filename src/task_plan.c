@@ -0,0 +1,133 @@
+/**
+ * @file task_plan.c
+ * @brief Core, priority and stack of every task, in one place
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "task_plan.h"
+#include "version.h"
+#include "https_portal.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register task_plan.c version
+REGISTER_VERSION(TaskPlan, "1.0.0", "2026-10-15");
+
+static const char *TAG = "TASK_PLAN";
+
+#define TASK_PLAN_STACK_MARGIN 512              // Warn when a task has ever come closer than this to its stack end
+
+// The orderings the pipelines rely on
+_Static_assert(SAMPLER_ACQUIRE_TASK_PRIORITY > SAMPLER_TRANSMIT_TASK_PRIORITY,
+               "a slow radio must never delay a sensor read");
+_Static_assert(ESPNOW_LINK_TASK_PRIORITY > SAMPLER_ACQUIRE_TASK_PRIORITY,
+               "the link task only drains the rings and must keep ahead of the sampler");
+_Static_assert(ESPNOW_LINK_TASK_PRIORITY > ESPNOW_RELIABLE_ACK_TASK_PRIORITY,
+               "the ACK task is fed by the link task");
+_Static_assert(ENERGY_BENCH_TASK_PRIORITY > SAMPLER_ACQUIRE_TASK_PRIORITY,
+               "the energy meter must keep its period above the workload");
+
+/**
+ * @brief One planned task
+ */
+typedef struct {
+    const char *name;
+    BaseType_t core;
+    UBaseType_t priority;                       // 0: chosen by ESP-IDF, not checked
+} task_plan_entry_t;
+
+static const task_plan_entry_t plan[] = {
+    { WIFI_TASK_NAME, TASK_CORE_NET, 0 },
+    { LWIP_TASK_NAME, TASK_CORE_NET, 0 },
+    { MQTT_TASK_NAME, TASK_CORE_NET, MQTT_TASK_PRIORITY },
+    { NIMBLE_HOST_TASK_NAME, TASK_CORE_NET, 0 },
+    { DNS_TASK_NAME, TASK_CORE_NET, DNS_TASK_PRIORITY },
+    { WEB_SERVER_PORTAL_TASK_NAME, WEB_SERVER_PORTAL_CORE, WEB_SERVER_PORTAL_PRIORITY },
+    { METRICS_STREAM_TASK_NAME, TASK_CORE_NET, METRICS_STREAM_TASK_PRIORITY },
+    { ESPNOW_RELIABLE_ACK_TASK_NAME, TASK_CORE_NET, ESPNOW_RELIABLE_ACK_TASK_PRIORITY },
+    { ESPNOW_RELAY_TASK_NAME, TASK_CORE_NET, ESPNOW_RELAY_TASK_PRIORITY },
+    { NMEA_TASK_NAME, TASK_CORE_NET, NMEA_TASK_PRIORITY },
+    { SYSLOG_TASK_NAME, TASK_CORE_NET, SYSLOG_TASK_PRIORITY },
+    { OTA_PULL_TASK_NAME, TASK_CORE_NET, OTA_PULL_TASK_PRIORITY },
+    { NVS_CONFIG_FLUSH_TASK_NAME, TASK_CORE_NET, NVS_CONFIG_FLUSH_TASK_PRIORITY },
+    { METRIC_HISTORY_TASK_NAME, TASK_CORE_NET, METRIC_HISTORY_TASK_PRIORITY },
+    { HEALTH_WATCH_TASK_NAME, TASK_CORE_NET, HEALTH_WATCH_TASK_PRIORITY },
+    { WEB_SERVER_SPIFFS_TASK_NAME, TASK_CORE_NET, WEB_SERVER_SPIFFS_TASK_PRIORITY },
+    { BOOT_BUTTON_TASK_NAME, TASK_CORE_NET, BOOT_BUTTON_TASK_PRIORITY },
+    { EVENT_LOG_TASK_NAME, TASK_CORE_NET, EVENT_LOG_TASK_PRIORITY },
+    { SERVICE_NET_TASK_NAME, TASK_CORE_NET, SERVICE_TASK_PRIORITY },
+    { ESPNOW_OTA_TASK_NAME, TASK_CORE_NET, ESPNOW_OTA_TASK_PRIORITY },
+    { BENCH_RX_TASK_NAME, TASK_CORE_NET, BENCH_RX_TASK_PRIORITY },
+    { BENCH_FLASH_TASK_NAME, TASK_CORE_NET, BENCH_FLASH_TASK_PRIORITY },
+    { MAIN_TASK_NAME, TASK_CORE_APP, 0 },
+    { SAMPLER_ACQUIRE_TASK_NAME, TASK_CORE_APP, SAMPLER_ACQUIRE_TASK_PRIORITY },
+    { SAMPLER_TRANSMIT_TASK_NAME, TASK_CORE_APP, SAMPLER_TRANSMIT_TASK_PRIORITY },
+    { ESPNOW_LINK_TASK_NAME, ESPNOW_LINK_TASK_CORE, ESPNOW_LINK_TASK_PRIORITY },
+    { N2K_TASK_NAME, TASK_CORE_APP, N2K_TASK_PRIORITY },
+    { OTA_WRITER_TASK_NAME, OTA_WRITER_CORE, OTA_WRITER_PRIORITY },
+    { ENERGY_BENCH_TASK_NAME, TASK_CORE_APP, ENERGY_BENCH_TASK_PRIORITY },
+    { I2C_BUS_TASK_NAME, TASK_CORE_APP, I2C_BUS_TASK_PRIORITY },
+    { ADC_STREAM_TASK_NAME, TASK_CORE_APP, ADC_STREAM_TASK_PRIORITY },
+    { MOTION_TASK_NAME, TASK_CORE_APP, MOTION_TASK_PRIORITY },
+    { GPS_TASK_NAME, TASK_CORE_APP, GPS_TASK_PRIORITY },
+    { SERVICE_APP_TASK_NAME, TASK_CORE_APP, SERVICE_TASK_PRIORITY },
+};
+
+#define PLAN_COUNT (sizeof(plan) / sizeof(plan[0]))
+
+// =============================
+// Function Definitions
+// =============================
+
+esp_err_t task_plan_check(void) {
+    uint32_t running = 0;
+    uint32_t off_plan = 0;
+    for (size_t i = 0; i < PLAN_COUNT; i++) {
+        const task_plan_entry_t *p = &plan[i];
+        if (p->priority >= configMAX_PRIORITIES) {
+            ESP_LOGW(TAG, "%s: priority %u is above the highest (%d)", p->name, (unsigned)p->priority,
+                     configMAX_PRIORITIES - 1);
+            off_plan++;
+        }
+        TaskHandle_t handle = xTaskGetHandle(p->name);
+        if (handle == NULL) {
+            continue;
+        }
+        running++;
+
+        // The base priority: a task holding a mutex may be running boosted
+        TaskStatus_t status;
+        vTaskGetInfo(handle, &status, pdTRUE, eInvalid);
+        BaseType_t core = xTaskGetCoreID(handle);
+        uint32_t stack_free = (uint32_t)status.usStackHighWaterMark * sizeof(StackType_t);
+        bool core_ok = core == p->core;
+        bool priority_ok = p->priority == 0 || status.uxBasePriority == p->priority;
+        if (!core_ok || !priority_ok) {
+            off_plan++;
+            ESP_LOGW(TAG, "%s: core %d priority %u, planned core %d priority %u", p->name,
+                     core == tskNO_AFFINITY ? -1 : (int)core, (unsigned)status.uxBasePriority, (int)p->core,
+                     (unsigned)p->priority);
+        }
+        if (stack_free < TASK_PLAN_STACK_MARGIN) {
+            ESP_LOGW(TAG, "%s: only %lu bytes of stack were ever left", p->name, (unsigned long)stack_free);
+        }
+        ESP_LOGD(TAG, "%-14s core %d priority %u, %lu bytes stack free", p->name, (int)core,
+                 (unsigned)status.uxBasePriority, (unsigned long)stack_free);
+    }
+
+    ESP_LOGI(TAG, "Network core %d, sensor core %d: %lu planned tasks running, %lu off plan", TASK_CORE_NET,
+             TASK_CORE_APP, (unsigned long)running, (unsigned long)off_plan);
+    return off_plan == 0 ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
@@ -0,0 +1,579 @@
+/**
+ * @file telemetry.c
+ * @brief Node-to-gateway binary telemetry frame: encode and decode in place, no allocation
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "telemetry.h"
+#include "version.h"
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register telemetry.c version
+REGISTER_VERSION(Telemetry, "1.0.0", "2026-10-14");
+
+_Static_assert(TELEMETRY_PACKED_MAX_RECORDS <= UINT8_MAX, "count is one byte");
+_Static_assert(TELEMETRY_FRAME_MAX <= UINT8_MAX, "frame length is one byte in the decoded header");
+
+#define PRESSURE_MAX_PA (TELEMETRY_PRESSURE_OFFSET_PA + 2 * (uint32_t)UINT16_MAX)
+#define HUMIDITY_MAX 10000                      // 100.00 %RH
+#define GAS_MANTISSA_MAX 0x0FFF
+#define GAS_EXPONENT_MAX 15
+
+// Packed record mask bits, one per column
+#define COL_TIME (1 << 0)
+#define COL_TEMPERATURE (1 << 1)
+#define COL_PRESSURE (1 << 2)
+#define COL_HUMIDITY (1 << 3)
+#define COL_GAS (1 << 4)
+#define COL_FLAGS (1 << 5)
+#define COL_ALL 0x3F
+#define VARINT_MAX 5                            // Bytes of a 32-bit varint
+
+// =============================
+// Function Prototypes
+// =============================
+static void put_u16(uint8_t *p, uint16_t v);
+static void put_u32(uint8_t *p, uint32_t v);
+static uint16_t get_u16(const uint8_t *p);
+static uint32_t get_u32(const uint8_t *p);
+static uint16_t encode_gas(uint32_t ohm);
+static void quantize(const telemetry_record_t *rec, telemetry_packed_t *q);
+static void unquantize(const telemetry_packed_t *q, telemetry_record_t *rec);
+static size_t put_varint(uint8_t *p, uint32_t v);
+static bool get_varint(const uint8_t *p, size_t len, size_t *pos, uint32_t *v);
+static uint32_t zigzag(int32_t v);
+static int32_t unzigzag(uint32_t v);
+static size_t pack_record(const telemetry_packed_t *prev, const telemetry_packed_t *q, uint8_t *p);
+static bool unpack_record(const uint8_t *buf, size_t len, size_t *pos, telemetry_packed_t *q);
+
+// =============================
+// Function Definitions
+// =============================
+
+/** @brief Store little-endian */
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+/** @brief Store little-endian */
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+/** @brief Load little-endian */
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/** @brief Load little-endian */
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+/**
+ * @brief Pack a resistance into 4-bit exponent and 12-bit mantissa, rounding to nearest
+ */
+static uint16_t encode_gas(uint32_t ohm) {
+    uint32_t mantissa = ohm;
+    uint8_t exponent = 0;
+    while (mantissa > GAS_MANTISSA_MAX && exponent < GAS_EXPONENT_MAX) {
+        mantissa = (mantissa >> 1) + (mantissa & 1);
+        exponent++;
+    }
+    if (mantissa > GAS_MANTISSA_MAX) {
+        mantissa = GAS_MANTISSA_MAX;
+    }
+    return (uint16_t)((exponent << 12) | mantissa);
+}
+
+/**
+ * @brief A record at the resolution it is sent with; delta_s is left to the caller
+ */
+static void quantize(const telemetry_record_t *rec, telemetry_packed_t *q) {
+    uint32_t pressure = rec->pressure;
+    if (pressure < TELEMETRY_PRESSURE_OFFSET_PA) {
+        pressure = TELEMETRY_PRESSURE_OFFSET_PA;
+    } else if (pressure >= PRESSURE_MAX_PA) {
+        pressure = PRESSURE_MAX_PA - 1;         // Keeps the rounded value within 16 bits
+    }
+    uint32_t humidity = (rec->humidity + 5) / 10;
+    if (humidity > HUMIDITY_MAX) {
+        humidity = HUMIDITY_MAX;
+    }
+    uint8_t flags = (rec->heater_step << TELEMETRY_REC_STEP_SHIFT) & TELEMETRY_REC_STEP_MASK;
+    if (rec->gas_valid) {
+        flags |= TELEMETRY_REC_GAS_VALID;
+    }
+    if (rec->heat_stable) {
+        flags |= TELEMETRY_REC_HEAT_STABLE;
+    }
+    if (rec->held) {
+        flags |= TELEMETRY_REC_HELD;
+    }
+    if (rec->urgent) {
+        flags |= TELEMETRY_REC_URGENT;
+    }
+
+    q->time_s = rec->time_s;
+    q->temperature = rec->temperature;
+    q->pressure = (uint16_t)((pressure - TELEMETRY_PRESSURE_OFFSET_PA + 1) / 2);
+    q->humidity = (uint16_t)humidity;
+    q->gas = encode_gas(rec->gas_resistance);
+    q->flags = flags;
+}
+
+/**
+ * @brief Back to the record's units; seq is left to the caller
+ */
+static void unquantize(const telemetry_packed_t *q, telemetry_record_t *rec) {
+    rec->time_s = q->time_s;
+    rec->temperature = q->temperature;
+    rec->pressure = TELEMETRY_PRESSURE_OFFSET_PA + 2 * (uint32_t)q->pressure;
+    rec->humidity = q->humidity * 10u;
+    rec->gas_resistance = (uint32_t)(q->gas & GAS_MANTISSA_MAX) << (q->gas >> 12);
+    rec->heater_step = (q->flags & TELEMETRY_REC_STEP_MASK) >> TELEMETRY_REC_STEP_SHIFT;
+    rec->gas_valid = (q->flags & TELEMETRY_REC_GAS_VALID) != 0;
+    rec->heat_stable = (q->flags & TELEMETRY_REC_HEAT_STABLE) != 0;
+    rec->held = (q->flags & TELEMETRY_REC_HELD) != 0;
+    rec->urgent = (q->flags & TELEMETRY_REC_URGENT) != 0;
+}
+
+/** @brief Store a varint; returns its length */
+static size_t put_varint(uint8_t *p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+/** @brief Load a varint at *pos, within len; false if it runs past len or 32 bits */
+static bool get_varint(const uint8_t *p, size_t len, size_t *pos, uint32_t *v) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < VARINT_MAX; i++) {
+        if (*pos >= len) {
+            return false;
+        }
+        uint8_t b = p[(*pos)++];
+        value |= (uint32_t)(b & 0x7F) << (7 * i);
+        if ((b & 0x80) == 0) {
+            *v = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @brief Small magnitudes to small codes: 0, -1, 1, -2 ... to 0, 1, 2, 3 ... */
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/**
+ * @brief Encode q against the record before it; returns the length, at most TELEMETRY_PACKED_RECORD_MAX
+ */
+static size_t pack_record(const telemetry_packed_t *prev, const telemetry_packed_t *q, uint8_t *p) {
+    int32_t dod = q->delta_s - prev->delta_s;
+    int32_t temperature = q->temperature - prev->temperature;
+    int32_t pressure = (int32_t)q->pressure - prev->pressure;
+    int32_t humidity = (int32_t)q->humidity - prev->humidity;
+    uint16_t gas = q->gas ^ prev->gas;
+    uint8_t flags = q->flags ^ prev->flags;
+
+    size_t n = 1;
+    p[0] = 0;
+    if (dod != 0) {
+        p[0] |= COL_TIME;
+        n += put_varint(p + n, zigzag(dod));
+    }
+    if (temperature != 0) {
+        p[0] |= COL_TEMPERATURE;
+        n += put_varint(p + n, zigzag(temperature));
+    }
+    if (pressure != 0) {
+        p[0] |= COL_PRESSURE;
+        n += put_varint(p + n, zigzag(pressure));
+    }
+    if (humidity != 0) {
+        p[0] |= COL_HUMIDITY;
+        n += put_varint(p + n, zigzag(humidity));
+    }
+    if (gas != 0) {
+        p[0] |= COL_GAS;
+        n += put_varint(p + n, gas);
+    }
+    if (flags != 0) {
+        p[0] |= COL_FLAGS;
+        p[n++] = flags;
+    }
+    return n;
+}
+
+/**
+ * @brief Decode the record at *pos into q, which holds the record before it; false if it is malformed
+ */
+static bool unpack_record(const uint8_t *buf, size_t len, size_t *pos, telemetry_packed_t *q) {
+    if (*pos >= len) {
+        return false;
+    }
+    uint8_t mask = buf[(*pos)++];
+    uint32_t v = 0;
+    if (mask & ~COL_ALL) {
+        return false;
+    }
+    if (mask & COL_TIME) {
+        if (!get_varint(buf, len, pos, &v)) {
+            return false;
+        }
+        q->delta_s += unzigzag(v);
+    }
+    q->time_s += (uint32_t)q->delta_s;
+    if (mask & COL_TEMPERATURE) {
+        if (!get_varint(buf, len, pos, &v)) {
+            return false;
+        }
+        q->temperature = (int16_t)(q->temperature + unzigzag(v));
+    }
+    if (mask & COL_PRESSURE) {
+        if (!get_varint(buf, len, pos, &v)) {
+            return false;
+        }
+        q->pressure = (uint16_t)(q->pressure + unzigzag(v));
+    }
+    if (mask & COL_HUMIDITY) {
+        if (!get_varint(buf, len, pos, &v)) {
+            return false;
+        }
+        q->humidity = (uint16_t)(q->humidity + unzigzag(v));
+    }
+    if (mask & COL_GAS) {
+        if (!get_varint(buf, len, pos, &v)) {
+            return false;
+        }
+        q->gas ^= (uint16_t)v;
+    }
+    if (mask & COL_FLAGS) {
+        if (*pos >= len) {
+            return false;
+        }
+        q->flags ^= buf[(*pos)++];
+    }
+    return true;
+}
+
+esp_err_t telemetry_writer_init(telemetry_writer_t *w, uint8_t *buf, size_t cap, uint32_t node_id, uint8_t flags) {
+    memset(w, 0, sizeof(*w));
+    if (cap < TELEMETRY_HEADER_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    w->buf = buf;
+    w->cap = cap;
+    buf[0] = TELEMETRY_MAGIC;
+    buf[1] = (TELEMETRY_VERSION << 4) | TELEMETRY_TYPE_BME680;
+    buf[2] = 0;
+    buf[3] = flags;
+    put_u32(buf + 4, node_id);
+    put_u32(buf + 8, 0);
+    put_u32(buf + 12, 0);
+    w->len = TELEMETRY_HEADER_LEN;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_writer_add(telemetry_writer_t *w, const telemetry_record_t *rec) {
+    size_t max = w->packed ? TELEMETRY_PACKED_MAX_RECORDS : TELEMETRY_MAX_RECORDS;
+    if (w->buf == NULL || w->len + (w->packed ? 1 : TELEMETRY_RECORD_LEN) > w->cap || w->count >= max) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (w->count == 0) {
+        w->base_seq = rec->seq;
+        w->base_time_s = rec->time_s;
+        put_u32(w->buf + 8, rec->seq);
+        put_u32(w->buf + 12, rec->time_s);
+    } else if (rec->seq != w->base_seq + w->count || rec->time_s < w->base_time_s ||
+               rec->time_s - w->base_time_s > UINT16_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    telemetry_packed_t q;
+    quantize(rec, &q);
+    uint8_t *p = w->buf + w->len;
+    size_t n = TELEMETRY_RECORD_LEN;
+    if (w->packed) {
+        // Record 0 is predicted from zeros at the base time, which it sets
+        if (w->count == 0) {
+            memset(&w->prev, 0, sizeof(w->prev));
+            w->prev.time_s = rec->time_s;
+        }
+        q.delta_s = (int32_t)(q.time_s - w->prev.time_s);
+        uint8_t packed[TELEMETRY_PACKED_RECORD_MAX];
+        n = pack_record(&w->prev, &q, packed);
+        if (w->len + n > w->cap) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(p, packed, n);
+        w->prev = q;
+    } else {
+        put_u16(p, (uint16_t)(rec->time_s - w->base_time_s));
+        put_u16(p + 2, (uint16_t)q.temperature);
+        put_u16(p + 4, q.pressure);
+        put_u16(p + 6, q.humidity);
+        put_u16(p + 8, q.gas);
+        p[10] = q.flags;
+    }
+
+    w->len += n;
+    w->buf[2] = ++w->count;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_writer_set_power(telemetry_writer_t *w, uint16_t awake_bp, uint32_t wake_ms) {
+    if (w->buf == NULL || w->count > 0 || (w->buf[3] & TELEMETRY_FLAG_EXTENSIONS)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (w->len + TELEMETRY_POWER_LEN > w->cap) {
+        return ESP_ERR_NO_MEM;
+    }
+    put_u16(w->buf + w->len, awake_bp);
+    put_u16(w->buf + w->len + 2, wake_ms > UINT16_MAX ? UINT16_MAX : (uint16_t)wake_ms);
+    w->len += TELEMETRY_POWER_LEN;
+    w->buf[3] |= TELEMETRY_FLAG_POWER;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_writer_set_rain(telemetry_writer_t *w, uint32_t tips, uint32_t rate) {
+    if (w->buf == NULL || w->count > 0 || (w->buf[3] & TELEMETRY_FLAG_RAIN)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (w->len + TELEMETRY_RAIN_LEN > w->cap) {
+        return ESP_ERR_NO_MEM;
+    }
+    put_u16(w->buf + w->len, (uint16_t)tips);
+    put_u16(w->buf + w->len + 2, rate > UINT16_MAX ? UINT16_MAX : (uint16_t)rate);
+    w->len += TELEMETRY_RAIN_LEN;
+    w->buf[3] |= TELEMETRY_FLAG_RAIN;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_writer_set_config(telemetry_writer_t *w, uint16_t version) {
+    if (w->buf == NULL || w->count > 0 || (w->buf[3] & TELEMETRY_FLAG_CONFIG)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (w->len + TELEMETRY_CONFIG_LEN > w->cap) {
+        return ESP_ERR_NO_MEM;
+    }
+    put_u16(w->buf + w->len, version);
+    w->len += TELEMETRY_CONFIG_LEN;
+    w->buf[3] |= TELEMETRY_FLAG_CONFIG;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_writer_set_health(telemetry_writer_t *w, uint16_t supply_mv, uint32_t backlog) {
+    if (w->buf == NULL || w->count > 0 || (w->buf[3] & TELEMETRY_FLAG_HEALTH)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (w->len + TELEMETRY_HEALTH_LEN > w->cap) {
+        return ESP_ERR_NO_MEM;
+    }
+    put_u16(w->buf + w->len, supply_mv);
+    put_u16(w->buf + w->len + 2, backlog > UINT16_MAX ? UINT16_MAX : (uint16_t)backlog);
+    w->len += TELEMETRY_HEALTH_LEN;
+    w->buf[3] |= TELEMETRY_FLAG_HEALTH;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_writer_set_key(telemetry_writer_t *w, uint32_t fingerprint, uint32_t switch_seq) {
+    if (w->buf == NULL || w->count > 0 || (w->buf[3] & TELEMETRY_FLAG_KEY)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (w->len + TELEMETRY_KEY_LEN > w->cap) {
+        return ESP_ERR_NO_MEM;
+    }
+    put_u32(w->buf + w->len, fingerprint);
+    put_u32(w->buf + w->len + 4, switch_seq);
+    w->len += TELEMETRY_KEY_LEN;
+    w->buf[3] |= TELEMETRY_FLAG_KEY;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_writer_set_packed(telemetry_writer_t *w) {
+    if (w->buf == NULL || w->count > 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    w->packed = true;
+    w->buf[1] = (TELEMETRY_VERSION << 4) | TELEMETRY_TYPE_BME680_PACKED;
+    return ESP_OK;
+}
+
+void telemetry_writer_set_lr(telemetry_writer_t *w) {
+    if (w->buf != NULL) {
+        w->buf[3] |= TELEMETRY_FLAG_LR;
+    }
+}
+
+void telemetry_writer_set_flags(telemetry_writer_t *w, uint8_t flags) {
+    const uint8_t kept = TELEMETRY_FLAG_EXTENSIONS | TELEMETRY_FLAG_LR;
+    if (w->buf != NULL) {
+        w->buf[3] = (flags & ~kept) | (w->buf[3] & kept);
+    }
+}
+
+esp_err_t telemetry_decode_header(const uint8_t *buf, size_t len, telemetry_header_t *hdr) {
+    if (len < TELEMETRY_HEADER_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint8_t type = buf[1] & 0x0F;
+    if (buf[0] != TELEMETRY_MAGIC || (buf[1] >> 4) != TELEMETRY_VERSION ||
+        (type != TELEMETRY_TYPE_BME680 && type != TELEMETRY_TYPE_BME680_PACKED)) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (len > TELEMETRY_FRAME_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    hdr->type = type;
+    hdr->count = buf[2];
+    hdr->flags = buf[3];
+    hdr->node_id = get_u32(buf + 4);
+    hdr->base_seq = get_u32(buf + 8);
+    hdr->base_time_s = get_u32(buf + 12);
+    hdr->header_len = TELEMETRY_HEADER_LEN;
+    hdr->awake_bp = 0;
+    hdr->wake_ms = 0;
+    hdr->rain_tips = 0;
+    hdr->rain_rate = 0;
+    hdr->config_version = 0;
+    hdr->supply_mv = TELEMETRY_HEALTH_UNKNOWN;
+    hdr->backlog = 0;
+    hdr->key_fingerprint = 0;
+    hdr->key_switch_seq = 0;
+    if (hdr->flags & TELEMETRY_FLAG_POWER) {
+        if (len < (size_t)hdr->header_len + TELEMETRY_POWER_LEN) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        hdr->awake_bp = get_u16(buf + hdr->header_len);
+        hdr->wake_ms = get_u16(buf + hdr->header_len + 2);
+        hdr->header_len += TELEMETRY_POWER_LEN;
+    }
+    if (hdr->flags & TELEMETRY_FLAG_RAIN) {
+        if (len < (size_t)hdr->header_len + TELEMETRY_RAIN_LEN) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        hdr->rain_tips = get_u16(buf + hdr->header_len);
+        hdr->rain_rate = get_u16(buf + hdr->header_len + 2);
+        hdr->header_len += TELEMETRY_RAIN_LEN;
+    }
+    if (hdr->flags & TELEMETRY_FLAG_CONFIG) {
+        if (len < (size_t)hdr->header_len + TELEMETRY_CONFIG_LEN) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        hdr->config_version = get_u16(buf + hdr->header_len);
+        hdr->header_len += TELEMETRY_CONFIG_LEN;
+    }
+    if (hdr->flags & TELEMETRY_FLAG_HEALTH) {
+        if (len < (size_t)hdr->header_len + TELEMETRY_HEALTH_LEN) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        hdr->supply_mv = get_u16(buf + hdr->header_len);
+        hdr->backlog = get_u16(buf + hdr->header_len + 2);
+        hdr->header_len += TELEMETRY_HEALTH_LEN;
+    }
+    if (hdr->flags & TELEMETRY_FLAG_KEY) {
+        if (len < (size_t)hdr->header_len + TELEMETRY_KEY_LEN) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        hdr->key_fingerprint = get_u32(buf + hdr->header_len);
+        hdr->key_switch_seq = get_u32(buf + hdr->header_len + 4);
+        hdr->header_len += TELEMETRY_KEY_LEN;
+    }
+    hdr->len = (uint8_t)len;
+    if (type == TELEMETRY_TYPE_BME680_PACKED) {
+        if (hdr->count > TELEMETRY_PACKED_MAX_RECORDS) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        telemetry_reader_t r;
+        telemetry_record_t rec;
+        telemetry_reader_init(&r, buf, hdr);
+        for (uint8_t i = 0; i < hdr->count; i++) {
+            if (telemetry_reader_next(&r, &rec) != ESP_OK) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+        }
+        return r.pos == len ? ESP_OK : ESP_ERR_INVALID_SIZE;
+    }
+    if (len != hdr->header_len + (size_t)hdr->count * TELEMETRY_RECORD_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t telemetry_decode_record(const uint8_t *buf, const telemetry_header_t *hdr, uint8_t index,
+                                  telemetry_record_t *rec) {
+    if (index >= hdr->count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    telemetry_reader_t r;
+    telemetry_reader_init(&r, buf, hdr);
+    if (hdr->type == TELEMETRY_TYPE_BME680) {
+        r.pos += (size_t)index * TELEMETRY_RECORD_LEN;
+        r.index = index;
+    }
+    esp_err_t err;
+    do {
+        err = telemetry_reader_next(&r, rec);
+    } while (err == ESP_OK && r.index <= index);
+    return err;
+}
+
+void telemetry_reader_init(telemetry_reader_t *r, const uint8_t *buf, const telemetry_header_t *hdr) {
+    memset(r, 0, sizeof(*r));
+    r->buf = buf;
+    r->hdr = hdr;
+    r->pos = hdr->header_len;
+    r->prev.time_s = hdr->base_time_s;
+}
+
+esp_err_t telemetry_reader_next(telemetry_reader_t *r, telemetry_record_t *rec) {
+    const telemetry_header_t *hdr = r->hdr;
+    if (r->index >= hdr->count) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    telemetry_packed_t q;
+    if (hdr->type == TELEMETRY_TYPE_BME680_PACKED) {
+        if (!unpack_record(r->buf, hdr->len, &r->pos, &r->prev)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        q = r->prev;
+    } else {
+        if (r->pos + TELEMETRY_RECORD_LEN > hdr->len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        const uint8_t *p = r->buf + r->pos;
+        q.time_s = hdr->base_time_s + get_u16(p);
+        q.temperature = (int16_t)get_u16(p + 2);
+        q.pressure = get_u16(p + 4);
+        q.humidity = get_u16(p + 6);
+        q.gas = get_u16(p + 8);
+        q.flags = p[10];
+        r->pos += TELEMETRY_RECORD_LEN;
+    }
+    unquantize(&q, rec);
+    rec->seq = hdr->base_seq + r->index++;
+    return ESP_OK;
+}
@@ -0,0 +1,212 @@
+/**
+ * @file telemetry_mcast.c
+ * @brief Telemetry frames as UDP multicast on the uplink LAN, for listeners that need no broker
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "telemetry_mcast.h"
+#include "telemetry.h"
+#include "static_mem.h"
+#include "version.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register telemetry_mcast.c version
+REGISTER_VERSION(TelemetryMcast, "1.0.0", "2026-10-15");
+static const char *TAG = "TELEM_MCAST";
+
+#define STOP_TIMEOUT_MS 1000
+
+/**
+ * @brief A datagram for the send task, header already filled in
+ */
+typedef struct {
+    bool stop;
+    uint8_t len;                                // Of the frame; the datagram is the header longer
+    uint8_t datagram[TELEMETRY_MCAST_HEADER_LEN + TELEMETRY_FRAME_MAX];
+} mcast_item_t;
+
+static telemetry_mcast_stats_t stats;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static int sock = -1;
+static uint32_t bound_if = 0;                   // Station address IP_MULTICAST_IF was last set to
+static QueueHandle_t queue = NULL;
+static StaticQueue_t queue_buf;
+static uint8_t queue_storage[TELEMETRY_MCAST_QUEUE * sizeof(mcast_item_t)];
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK_SLOT(mcast_task_slot, TELEMETRY_MCAST_TASK_STACK_SIZE);
+static SemaphoreHandle_t stopped_sem = NULL;
+static mcast_item_t send_item;                  // Send task only; too big for its stack
+
+// =============================
+// Function Prototypes
+// =============================
+static uint32_t station_address(void);
+static void mcast_task(void *arg);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief The station's IPv4 address, network order; 0 while it has none
+ */
+static uint32_t station_address(void) {
+    esp_netif_t *sta = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_ip_info_t ip_info;
+    if (sta == NULL || esp_netif_get_ip_info(sta, &ip_info) != ESP_OK) {
+        return 0;
+    }
+    return ip_info.ip.addr;
+}
+
+/**
+ * @brief Send queued datagrams out of the station interface
+ */
+static void mcast_task(void *arg) {
+    (void)arg;
+    struct sockaddr_in group = {
+        .sin_family = AF_INET,
+        .sin_port = htons(TELEMETRY_MCAST_PORT),
+        .sin_addr.s_addr = inet_addr(TELEMETRY_MCAST_GROUP),
+    };
+    for (;;) {
+        if (xQueueReceive(queue, &send_item, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (send_item.stop) {
+            break;
+        }
+
+        // The uplink comes and goes, and its address with it; the AP side never gets these
+        uint32_t addr = station_address();
+        if (addr == 0) {
+            portENTER_CRITICAL(&lock);
+            stats.no_uplink++;
+            portEXIT_CRITICAL(&lock);
+            continue;
+        }
+        if (addr != bound_if) {
+            struct in_addr ifaddr = { .s_addr = addr };
+            if (setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr)) == 0) {
+                bound_if = addr;
+            }
+        }
+
+        bool ok = sendto(sock, send_item.datagram, TELEMETRY_MCAST_HEADER_LEN + send_item.len, 0,
+                         (struct sockaddr *)&group, sizeof(group)) >= 0;
+        portENTER_CRITICAL(&lock);
+        if (ok) {
+            stats.sent++;
+        } else {
+            stats.errors++;
+        }
+        portEXIT_CRITICAL(&lock);
+    }
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t telemetry_mcast_start(void) {
+    if (task_handle != NULL) {
+        return ESP_OK;
+    }
+    memset(&stats, 0, sizeof(stats));
+    bound_if = 0;
+
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Unable to create UDP socket: errno %d", errno);
+        return ESP_FAIL;
+    }
+    uint8_t ttl = TELEMETRY_MCAST_TTL;
+    uint8_t loop = 0;
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    if (queue == NULL) {
+        queue = xQueueCreateStatic(TELEMETRY_MCAST_QUEUE, sizeof(mcast_item_t), queue_storage, &queue_buf);
+    }
+    if (stopped_sem == NULL) {
+        stopped_sem = xSemaphoreCreateBinary();
+    }
+    if (queue == NULL || stopped_sem == NULL ||
+        static_task_create(mcast_task_slot, mcast_task, TELEMETRY_MCAST_TASK_NAME, TELEMETRY_MCAST_TASK_STACK_SIZE,
+                           NULL, TELEMETRY_MCAST_TASK_PRIORITY, &task_handle, TASK_CORE_NET) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the send task");
+        task_handle = NULL;
+        close(sock);
+        sock = -1;
+        return ESP_ERR_NO_MEM;
+    }
+
+    stats.running = true;
+    ESP_LOGI(TAG, "Telemetry frames to %s:%d on the uplink", TELEMETRY_MCAST_GROUP, TELEMETRY_MCAST_PORT);
+    return ESP_OK;
+}
+
+void telemetry_mcast_send(const uint8_t *data, size_t len) {
+    if (task_handle == NULL || len > TELEMETRY_FRAME_MAX) {
+        return;
+    }
+    mcast_item_t item;
+    item.stop = false;
+    item.len = (uint8_t)len;
+    memcpy(item.datagram + TELEMETRY_MCAST_HEADER_LEN, data, len);
+
+    // Numbered as queued, so a frame the full queue drops is a gap too
+    portENTER_CRITICAL(&lock);
+    uint32_t seq = stats.seq++;
+    portEXIT_CRITICAL(&lock);
+    item.datagram[0] = 'W';
+    item.datagram[1] = 'T';
+    item.datagram[2] = TELEMETRY_MCAST_VERSION;
+    item.datagram[3] = 0;
+    item.datagram[4] = (uint8_t)seq;
+    item.datagram[5] = (uint8_t)(seq >> 8);
+    item.datagram[6] = (uint8_t)(seq >> 16);
+    item.datagram[7] = (uint8_t)(seq >> 24);
+
+    if (xQueueSend(queue, &item, 0) != pdTRUE) {
+        portENTER_CRITICAL(&lock);
+        stats.queue_full++;
+        portEXIT_CRITICAL(&lock);
+    }
+}
+
+void telemetry_mcast_stop(void) {
+    if (task_handle == NULL) {
+        return;
+    }
+    mcast_item_t item = { .stop = true };
+    xQueueReset(queue);
+    xQueueSend(queue, &item, portMAX_DELAY);
+    if (xSemaphoreTake(stopped_sem, pdMS_TO_TICKS(STOP_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Send task did not stop within %d ms", STOP_TIMEOUT_MS);
+    }
+    task_handle = NULL;
+    close(sock);
+    sock = -1;
+    stats.running = false;
+}
+
+void telemetry_mcast_get_stats(telemetry_mcast_stats_t *out) {
+    portENTER_CRITICAL(&lock);
+    *out = stats;
+    portEXIT_CRITICAL(&lock);
+}
@@ -0,0 +1,93 @@
+/**
+ * @file true_wind.c
+ * @brief Masthead wind corrected for heel and mast motion, and true wind from GPS speed and course
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "true_wind.h"
+#include "gps.h"
+#include "motion.h"
+#include "version.h"
+#include "wind.h"
+#include <math.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register true_wind.c version
+REGISTER_VERSION(TrueWind, "1.0.0", "2026-10-15");
+
+#define RAD_PER_DEG 0.017453293f
+
+// =============================
+// Function Prototypes
+// =============================
+static float clamp_tilt(int16_t centideg);
+static int16_t to_degrees(float rad);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief A roll or pitch in 0.01 deg as radians, limited to TRUE_WIND_TILT_MAX_DEG
+ */
+static float clamp_tilt(int16_t centideg) {
+    int32_t limit = TRUE_WIND_TILT_MAX_DEG * 100;
+    int32_t v = centideg > limit ? limit : centideg < -limit ? -limit : centideg;
+    return v * (RAD_PER_DEG / 100.0f);
+}
+
+/**
+ * @brief An angle from atan2f as whole degrees 0..359
+ */
+static int16_t to_degrees(float rad) {
+    int32_t deg = (int32_t)lroundf(rad / RAD_PER_DEG);
+    deg %= 360;
+    return (int16_t)(deg < 0 ? deg + 360 : deg);
+}
+
+bool true_wind_get(true_wind_t *out) {
+    wind_reading_t w;
+    wind_get(&w);
+    if (!w.running || w.dir_now < 0) {
+        return false;
+    }
+
+    // Wind-from vector in the mast's plane, m/s: u from ahead, v from starboard
+    float awa = w.dir_now * RAD_PER_DEG;
+    float aws = w.speed_3s / 100.0f;
+    float u = aws * cosf(awa);
+    float v = aws * sinf(awa);
+
+    motion_attitude_t m;
+    out->compensated = motion_get(&m);
+    if (out->compensated) {
+        u = u / cosf(clamp_tilt(m.pitch)) - m.mast_vx / 100.0f;
+        v = v / cosf(clamp_tilt(m.roll)) - m.mast_vy / 100.0f;
+    }
+    out->awa = to_degrees(atan2f(v, u));
+    out->aws = (uint16_t)lroundf(sqrtf(u * u + v * v) * 100.0f);
+
+    gps_fix_t fix;
+    out->have_true = gps_get_fix(&fix);
+    out->twa = out->awa;
+    out->tws = out->aws;
+    out->twd = -1;
+    if (out->have_true) {
+        // Boat velocity along the bow appears as wind from ahead; take it off
+        float tu = u - fix.sog / 100.0f;
+        out->twa = to_degrees(atan2f(v, tu));
+        out->tws = (uint16_t)lroundf(sqrtf(tu * tu + v * v) * 100.0f);
+        if (fix.sog >= TRUE_WIND_MIN_SOG && fix.cog >= 0) {
+            out->twd = (int16_t)(((fix.cog + 5) / 10 + out->twa) % 360);
+        }
+    }
+    return true;
+}
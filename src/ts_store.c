@@ -0,0 +1,899 @@
+/**
+ * @file ts_store.c
+ * @brief On-gateway time-series store: append-only day segments on flash with a block index, range queries
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "ts_store.h"
+#include "flash_io.h"
+#include "long_op.h"
+#include "mem_policy.h"
+#include "version.h"
+#include "storage.h"
+#include "http_arena.h"
+#include "web_server.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register ts_store.c version
+REGISTER_VERSION(TsStore, "1.0.0", "2026-10-15");
+
+static const char *TAG = "TS_STORE";
+
+#define PATH_LEN 40
+#define RETRY_MS 1000                           // Partition not mounted, or a query holds the lock
+#define READ_RECORDS 16                         // Records per fread in a query
+#define READ_BLOCKS 16                          // Index entries per fread
+#define SHUTDOWN_LOCK_MS 200                    // How long a restart waits for a running query
+#define OWN_MAX_FILES 4                         // Open at once on the store's own partition: a query and a flush
+
+_Static_assert(TS_STORE_PENDING >= TS_STORE_BLOCK_RECORDS, "the buffer must hold a block");
+
+/**
+ * @brief One day in the RAM directory
+ */
+typedef struct {
+    uint32_t day;                               // time_s / TS_STORE_SEGMENT_S
+    uint32_t min_s;
+    uint32_t max_s;
+    uint32_t bytes;                             // .dat and .idx together
+} segment_t;
+
+/**
+ * @brief One step bucket of a query
+ */
+typedef struct {
+    uint32_t n;
+    int32_t min;
+    int32_t max;
+    int64_t sum;
+} bucket_t;
+
+/**
+ * @brief Query working memory, allocated per request
+ */
+typedef struct {
+    bucket_t buckets[TS_STORE_QUERY_CHUNK];
+    ts_store_record_t pending[TS_STORE_PENDING];
+    ts_store_record_t records[READ_RECORDS];
+    ts_store_block_t blocks[READ_BLOCKS];
+    long_op_slice_t op;
+} query_t;
+
+// Segments and files: lock. The RAM buffer: pending_lock, appended by the forwarder only.
+static SemaphoreHandle_t lock = NULL;
+static portMUX_TYPE pending_lock = portMUX_INITIALIZER_UNLOCKED;
+static ts_store_record_t *pending = NULL;       // TS_STORE_PENDING
+static uint32_t pending_count = 0;
+static int64_t pending_since_us = 0;            // When the oldest buffered record arrived
+static int64_t retry_at_us = 0;                 // Last flush could not run; try again from here
+static ts_store_record_t block[TS_STORE_BLOCK_RECORDS];
+static segment_t segments[TS_STORE_MAX_SEGMENTS];
+static uint32_t segment_count = 0;
+static bool loaded = false;                     // Directory read from the filesystem
+static const char *label = STORAGE_PARTITION_LABEL; // Partition the segments live on
+static const char *base_path = SPIFFS_BASE_PATH;
+static bool own_partition = false;              // STORAGE_HISTORY_LABEL, mounted by this module
+static ts_store_info_t totals;                  // Under pending_lock
+
+// =============================
+// Function Prototypes
+// =============================
+static void segment_path(char *path, uint32_t day, const char *ext);
+static void count_add(uint32_t *counter, uint32_t n);
+static void remove_files(uint32_t day);
+static void refresh_totals(void);
+static void delete_segment(uint32_t index);
+static esp_err_t load_segment(uint32_t day, segment_t *seg);
+static void load_directory(void);
+static segment_t *find_segment(uint32_t day, bool create);
+static void write_block(uint32_t day, const ts_store_record_t *recs, uint32_t n);
+static void enforce_retention(void);
+static void flush_locked(void);
+static void shutdown_flush(void);
+static bool record_value(const ts_store_record_t *rec, ts_store_metric_t metric, int32_t *value);
+static void fold(query_t *q, const ts_store_record_t *rec, ts_store_metric_t metric, uint32_t node_id,
+                 uint32_t start_s, uint32_t end_s, uint32_t step_s);
+static void scan_segment(query_t *q, const segment_t *seg, ts_store_metric_t metric, uint32_t node_id,
+                         uint32_t start_s, uint32_t end_s, uint32_t step_s);
+static bool export_segment(ts_store_cursor_t *cur, ts_store_record_t *out, size_t max, size_t *produced);
+
+// =============================
+// Function Definitions
+// =============================
+
+static void segment_path(char *path, uint32_t day, const char *ext) {
+    snprintf(path, PATH_LEN, "%s/" TS_STORE_FILE_PREFIX "%lu.%s", base_path, (unsigned long)day, ext);
+}
+
+static void count_add(uint32_t *counter, uint32_t n) {
+    portENTER_CRITICAL(&pending_lock);
+    *counter += n;
+    portEXIT_CRITICAL(&pending_lock);
+}
+
+static void remove_files(uint32_t day) {
+    char path[PATH_LEN];
+    segment_path(path, day, "idx");
+    unlink(path);
+    segment_path(path, day, "dat");
+    unlink(path);
+}
+
+/**
+ * @brief Recompute the directory totals; call with lock held
+ */
+static void refresh_totals(void) {
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < segment_count; i++) {
+        bytes += segments[i].bytes;
+    }
+    portENTER_CRITICAL(&pending_lock);
+    totals.ready = loaded;
+    totals.segments = segment_count;
+    totals.bytes = bytes;
+    totals.oldest_s = segment_count > 0 ? segments[0].min_s : 0;
+    totals.newest_s = segment_count > 0 ? segments[segment_count - 1].max_s : 0;
+    portEXIT_CRITICAL(&pending_lock);
+}
+
+/**
+ * @brief Remove a segment's files and its directory entry; call with lock held
+ */
+static void delete_segment(uint32_t index) {
+    remove_files(segments[index].day);
+    memmove(&segments[index], &segments[index + 1], (segment_count - index - 1) * sizeof(segment_t));
+    segment_count--;
+}
+
+/**
+ * @brief Read a segment's span from its index
+ */
+static esp_err_t load_segment(uint32_t day, segment_t *seg) {
+    char path[PATH_LEN];
+    struct stat st;
+    segment_path(path, day, "dat");
+    if (stat(path, &st) != 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    seg->day = day;
+    seg->min_s = UINT32_MAX;
+    seg->max_s = 0;
+    seg->bytes = (uint32_t)st.st_size;
+
+    segment_path(path, day, "idx");
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    ts_store_block_t entries[READ_BLOCKS];
+    size_t n;
+    while ((n = fread(entries, sizeof(ts_store_block_t), READ_BLOCKS, f)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (entries[i].min_s < seg->min_s) {
+                seg->min_s = entries[i].min_s;
+            }
+            if (entries[i].max_s > seg->max_s) {
+                seg->max_s = entries[i].max_s;
+            }
+            seg->bytes += sizeof(ts_store_block_t);
+        }
+    }
+    fclose(f);
+    return seg->max_s >= seg->min_s ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief Build the directory from the files on the partition; call with lock held
+ *
+ * A segment with no usable index (power lost before its first index write)
+ * is deleted; the oldest days go if there are more than the directory holds.
+ */
+static void load_directory(void) {
+    int64_t start_us = esp_timer_get_time();
+    segment_count = 0;
+    DIR *dir = opendir(base_path);
+    if (dir == NULL) {
+        ESP_LOGE(TAG, "Failed to open %s", base_path);
+        return;
+    }
+
+    size_t prefix_len = strlen(TS_STORE_FILE_PREFIX);
+    long_op_slice_t op;
+    long_op_begin(&op, LONG_OP_HISTORY_SCAN);
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (!ts_store_owns_file(ent->d_name)) {
+            continue;
+        }
+        long_op_step(&op);
+        char *end;
+        uint32_t day = strtoul(ent->d_name + prefix_len, &end, 10);
+        if (strcmp(end, ".dat") != 0) {
+            continue;                           // Each segment once, by its data file
+        }
+
+        segment_t seg;
+        if (load_segment(day, &seg) != ESP_OK) {
+            ESP_LOGW(TAG, "Deleting segment %lu: no index", (unsigned long)day);
+            remove_files(day);
+            continue;
+        }
+
+        // Insertion sort by day; a full directory gives up its oldest day
+        if (segment_count == TS_STORE_MAX_SEGMENTS) {
+            if (day < segments[0].day) {
+                remove_files(day);
+                continue;
+            }
+            delete_segment(0);
+        }
+        uint32_t i = segment_count;
+        while (i > 0 && segments[i - 1].day > day) {
+            segments[i] = segments[i - 1];
+            i--;
+        }
+        segments[i] = seg;
+        segment_count++;
+    }
+    closedir(dir);
+    long_op_end(&op);
+
+    loaded = true;
+    refresh_totals();
+    ESP_LOGI(TAG, "%lu segments (%lu bytes) loaded in %lu ms", (unsigned long)segment_count,
+             (unsigned long)totals.bytes, (unsigned long)((esp_timer_get_time() - start_us) / 1000));
+}
+
+/**
+ * @brief Directory entry for a day, created (and the oldest dropped) if need be; call with lock held
+ *
+ * @return NULL for a day older than every segment of a full directory
+ */
+static segment_t *find_segment(uint32_t day, bool create) {
+    uint32_t i = segment_count;
+    while (i > 0 && segments[i - 1].day > day) {
+        i--;
+    }
+    if (i > 0 && segments[i - 1].day == day) {
+        return &segments[i - 1];
+    }
+    if (!create) {
+        return NULL;
+    }
+    if (segment_count == TS_STORE_MAX_SEGMENTS) {
+        if (i == 0) {
+            return NULL;
+        }
+        delete_segment(0);
+        count_add(&totals.expired, 1);
+        i--;
+    }
+    memmove(&segments[i + 1], &segments[i], (segment_count - i) * sizeof(segment_t));
+    segments[i] = (segment_t){ .day = day, .min_s = UINT32_MAX, .max_s = 0, .bytes = 0 };
+    segment_count++;
+    return &segments[i];
+}
+
+/**
+ * @brief Append one block to a day's data file, then its index entry; call with lock held
+ *
+ * The data goes first: if power is lost between the two writes the block
+ * is only unreachable, and the next block's offset comes from the file.
+ */
+static void write_block(uint32_t day, const ts_store_record_t *recs, uint32_t n) {
+    segment_t *seg = find_segment(day, true);
+    if (seg == NULL) {
+        count_add(&totals.dropped, n);
+        return;
+    }
+
+    ts_store_block_t entry = { .min_s = UINT32_MAX, .max_s = 0, .count = (uint16_t)n };
+    for (uint32_t i = 0; i < n; i++) {
+        if (recs[i].time_s < entry.min_s) {
+            entry.min_s = recs[i].time_s;
+        }
+        if (recs[i].time_s > entry.max_s) {
+            entry.max_s = recs[i].time_s;
+        }
+    }
+
+    char path[PATH_LEN];
+    segment_path(path, day, "dat");
+    int64_t start = esp_timer_get_time();
+    FILE *f = fopen(path, "ab");
+    bool ok = f != NULL && fseek(f, 0, SEEK_END) == 0;
+    long offset = ok ? ftell(f) : -1;
+    ok = ok && offset >= 0 && fwrite(recs, sizeof(ts_store_record_t), n, f) == n;
+    if (f != NULL) {
+        ok = fclose(f) == 0 && ok;
+    }
+    if (ok) {
+        entry.offset = (uint32_t)offset;
+        segment_path(path, day, "idx");
+        f = fopen(path, "ab");
+        ok = f != NULL && fwrite(&entry, sizeof(entry), 1, f) == 1;
+        if (f != NULL) {
+            ok = fclose(f) == 0 && ok;
+        }
+    }
+    flash_io_record(FLASH_IO_FILES, FLASH_IO_WRITE, label, n * sizeof(ts_store_record_t) + sizeof(entry), start,
+                    ok ? ESP_OK : ESP_FAIL);
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to append %lu records to segment %lu", (unsigned long)n, (unsigned long)day);
+        count_add(&totals.dropped, n);
+        if (seg->max_s < seg->min_s) {
+            delete_segment((uint32_t)(seg - segments));  // Nothing of it was indexed
+        }
+        return;
+    }
+
+    seg->bytes += n * sizeof(ts_store_record_t) + sizeof(entry);
+    if (entry.min_s < seg->min_s) {
+        seg->min_s = entry.min_s;
+    }
+    if (entry.max_s > seg->max_s) {
+        seg->max_s = entry.max_s;
+    }
+    count_add(&totals.records, n);
+    count_add(&totals.blocks, 1);
+}
+
+/**
+ * @brief Delete the oldest days while the store is over budget or the partition is nearly full; call with lock held
+ *
+ * On its own partition the store may fill it, so only free space counts.
+ * The newest day is always kept.
+ */
+static void enforce_retention(void) {
+    while (segment_count > 1) {
+        uint32_t bytes = 0;
+        for (uint32_t i = 0; i < segment_count; i++) {
+            bytes += segments[i].bytes;
+        }
+        size_t total = 0, used = 0;
+        bool low = storage_partition_info(label, &total, &used) == ESP_OK && total - used < TS_STORE_MIN_FREE_BYTES;
+        if ((own_partition || bytes <= TS_STORE_MAX_BYTES) && !low) {
+            return;
+        }
+        ESP_LOGI(TAG, "Deleting segment %lu (%lu bytes): %s", (unsigned long)segments[0].day,
+                 (unsigned long)segments[0].bytes, low ? "filesystem nearly full" : "over budget");
+        delete_segment(0);
+        count_add(&totals.expired, 1);
+    }
+}
+
+/**
+ * @brief Write every buffered record, one block per day they fall on; call with lock held
+ *
+ * Records only arrive out of day order with a node's backlog, so this is
+ * one block in practice.
+ */
+static void flush_locked(void) {
+    portENTER_CRITICAL(&pending_lock);
+    uint32_t n = pending_count;                 // The forwarder only appends past these
+    portEXIT_CRITICAL(&pending_lock);
+    if (n == 0) {
+        return;
+    }
+
+    bool taken[TS_STORE_PENDING] = { false };
+    for (uint32_t first = 0; first < n; first++) {
+        if (taken[first]) {
+            continue;
+        }
+        uint32_t day = pending[first].time_s / TS_STORE_SEGMENT_S;
+        uint32_t count = 0;
+        for (uint32_t i = first; i < n && count < TS_STORE_BLOCK_RECORDS; i++) {
+            if (!taken[i] && pending[i].time_s / TS_STORE_SEGMENT_S == day) {
+                block[count++] = pending[i];
+                taken[i] = true;
+            }
+        }
+        write_block(day, block, count);
+    }
+    enforce_retention();
+
+    portENTER_CRITICAL(&pending_lock);
+    memmove(pending, &pending[n], (pending_count - n) * sizeof(ts_store_record_t));
+    pending_count -= n;
+    pending_since_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&pending_lock);
+    refresh_totals();
+}
+
+/**
+ * @brief Save buffered records on esp_restart(); skipped if a query holds the lock
+ */
+static void shutdown_flush(void) {
+    if (loaded && xSemaphoreTake(lock, pdMS_TO_TICKS(SHUTDOWN_LOCK_MS)) == pdTRUE) {
+        flush_locked();
+        xSemaphoreGive(lock);
+    }
+}
+
+esp_err_t ts_store_init(void) {
+    ts_store_deinit();
+    lock = xSemaphoreCreateMutex();
+    pending = mem_policy_malloc(MEM_BULK, TS_STORE_PENDING * sizeof(ts_store_record_t));
+    if (lock == NULL || pending == NULL) {
+        ts_store_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+    pending_count = 0;
+    segment_count = 0;
+    loaded = false;
+    retry_at_us = 0;
+    memset(&totals, 0, sizeof(totals));
+
+    // partitions_split.csv and partitions_ab.csv give the store a partition of its own;
+    // otherwise it shares the web server's
+    label = STORAGE_PARTITION_LABEL;
+    base_path = SPIFFS_BASE_PATH;
+    own_partition = false;
+    const esp_partition_t *part = storage_find_partition(STORAGE_HISTORY_LABEL);
+    if (part != NULL) {
+        esp_err_t err = storage_mount_partition(STORAGE_HISTORY_LABEL, STORAGE_HISTORY_BASE_PATH, OWN_MAX_FILES, true);
+        if (err == ESP_OK) {
+            label = STORAGE_HISTORY_LABEL;
+            base_path = STORAGE_HISTORY_BASE_PATH;
+            own_partition = true;
+            ESP_LOGI(TAG, "Segments on the '%s' partition (%s, %lu KB)", label, storage_name(),
+                     (unsigned long)(part->size / 1024));
+        } else {
+            ESP_LOGW(TAG, "Failed to mount the '%s' partition, sharing '%s': %s", STORAGE_HISTORY_LABEL,
+                     STORAGE_PARTITION_LABEL, esp_err_to_name(err));
+        }
+    }
+    esp_register_shutdown_handler(shutdown_flush);
+    return ESP_OK;
+}
+
+void ts_store_deinit(void) {
+    if (lock != NULL) {
+        esp_unregister_shutdown_handler(shutdown_flush);
+        xSemaphoreTake(lock, portMAX_DELAY);
+        if (loaded && pending != NULL && storage_partition_mounted(label)) {
+            flush_locked();
+        }
+        loaded = false;
+        if (own_partition) {
+            storage_unmount_partition(label);
+            own_partition = false;
+        }
+        xSemaphoreGive(lock);
+        vSemaphoreDelete(lock);
+        lock = NULL;
+    }
+    free(pending);
+    pending = NULL;
+    pending_count = 0;
+}
+
+void ts_store_add(uint32_t node_id, const telemetry_record_t *rec) {
+    if (pending == NULL) {
+        return;
+    }
+    if (rec->time_s < TS_STORE_MIN_TIME_S) {
+        portENTER_CRITICAL(&pending_lock);
+        totals.no_clock++;
+        portEXIT_CRITICAL(&pending_lock);
+        return;
+    }
+
+    ts_store_record_t r = {
+        .time_s = rec->time_s,
+        .node_id = node_id,
+        .temperature = rec->temperature,
+    };
+    if (rec->pressure >= TS_STORE_PRESSURE_BASE && rec->pressure - TS_STORE_PRESSURE_BASE <= UINT16_MAX) {
+        r.pressure = (uint16_t)(rec->pressure - TS_STORE_PRESSURE_BASE);
+        r.flags |= TS_STORE_HAS_PRESSURE;
+    }
+    if (rec->humidity <= 100000) {
+        r.humidity = (uint16_t)((rec->humidity + 5) / 10);
+        r.flags |= TS_STORE_HAS_HUMIDITY;
+    }
+
+    portENTER_CRITICAL(&pending_lock);
+    if (pending_count < TS_STORE_PENDING) {
+        if (pending_count == 0) {
+            pending_since_us = esp_timer_get_time();
+        }
+        pending[pending_count++] = r;
+    } else {
+        totals.dropped++;
+    }
+    portEXIT_CRITICAL(&pending_lock);
+}
+
+void ts_store_poll(void) {
+    if (lock == NULL || esp_timer_get_time() < retry_at_us) {
+        return;
+    }
+    bool mounted = storage_partition_mounted(label);
+    if (loaded == mounted && ts_store_poll_due_ms() > 0) {
+        return;
+    }
+    if (xSemaphoreTake(lock, 0) != pdTRUE) {
+        retry_at_us = esp_timer_get_time() + (int64_t)RETRY_MS * 1000;
+        return;
+    }
+    if (!mounted) {
+        // Not mounted yet, or unmounted for a filesystem update that will replace the files
+        if (loaded) {
+            loaded = false;
+            segment_count = 0;
+            refresh_totals();
+        }
+        retry_at_us = esp_timer_get_time() + (int64_t)RETRY_MS * 1000;
+    } else {
+        if (!loaded) {
+            load_directory();
+        }
+        if (ts_store_poll_due_ms() == 0) {
+            flush_locked();
+        }
+    }
+    xSemaphoreGive(lock);
+}
+
+uint32_t ts_store_poll_due_ms(void) {
+    portENTER_CRITICAL(&pending_lock);
+    uint32_t count = pending_count;
+    int64_t since_us = pending_since_us;
+    portEXIT_CRITICAL(&pending_lock);
+    if (count == 0) {
+        return UINT32_MAX;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    if (now_us < retry_at_us) {
+        return (uint32_t)((retry_at_us - now_us + 999) / 1000);
+    }
+    int64_t age_ms = (now_us - since_us) / 1000;
+    if (count >= TS_STORE_BLOCK_RECORDS || age_ms >= TS_STORE_FLUSH_MS) {
+        return 0;
+    }
+    return TS_STORE_FLUSH_MS - (uint32_t)age_ms;
+}
+
+void ts_store_get_info(ts_store_info_t *info) {
+    portENTER_CRITICAL(&pending_lock);
+    *info = totals;
+    info->pending = pending_count;
+    portEXIT_CRITICAL(&pending_lock);
+}
+
+const char *ts_store_metric_name(ts_store_metric_t metric) {
+    switch (metric) {
+    case TS_STORE_TEMPERATURE:
+        return "temperature";
+    case TS_STORE_PRESSURE:
+        return "pressure";
+    case TS_STORE_HUMIDITY:
+        return "humidity";
+    default:
+        return "unknown";
+    }
+}
+
+esp_err_t ts_store_metric_from_name(const char *name, ts_store_metric_t *metric) {
+    for (int i = 0; i < TS_STORE_METRICS; i++) {
+        if (strcmp(name, ts_store_metric_name((ts_store_metric_t)i)) == 0) {
+            *metric = (ts_store_metric_t)i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+bool ts_store_owns_file(const char *name) {
+    size_t prefix_len = strlen(TS_STORE_FILE_PREFIX);
+    return strncmp(name, TS_STORE_FILE_PREFIX, prefix_len) == 0 && name[prefix_len] >= '0' &&
+           name[prefix_len] <= '9';
+}
+
+/**
+ * @brief A record's value for a metric, in record units
+ */
+static bool record_value(const ts_store_record_t *rec, ts_store_metric_t metric, int32_t *value) {
+    switch (metric) {
+    case TS_STORE_TEMPERATURE:
+        *value = rec->temperature;
+        return true;
+    case TS_STORE_PRESSURE:
+        *value = (int32_t)rec->pressure + TS_STORE_PRESSURE_BASE;
+        return (rec->flags & TS_STORE_HAS_PRESSURE) != 0;
+    case TS_STORE_HUMIDITY:
+        *value = (int32_t)rec->humidity * 10;
+        return (rec->flags & TS_STORE_HAS_HUMIDITY) != 0;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Fold a record into its bucket if it is in [start_s, end_s) and matches
+ */
+static void fold(query_t *q, const ts_store_record_t *rec, ts_store_metric_t metric, uint32_t node_id,
+                 uint32_t start_s, uint32_t end_s, uint32_t step_s) {
+    int32_t value;
+    if (rec->time_s < start_s || rec->time_s >= end_s || (node_id != 0 && rec->node_id != node_id) ||
+        !record_value(rec, metric, &value)) {
+        return;
+    }
+    bucket_t *b = &q->buckets[(rec->time_s - start_s) / step_s];
+    if (b->n == 0 || value < b->min) {
+        b->min = value;
+    }
+    if (b->n == 0 || value > b->max) {
+        b->max = value;
+    }
+    b->sum += value;
+    b->n++;
+}
+
+/**
+ * @brief Fold the blocks of a segment that overlap [start_s, end_s); call with lock held
+ */
+static void scan_segment(query_t *q, const segment_t *seg, ts_store_metric_t metric, uint32_t node_id,
+                         uint32_t start_s, uint32_t end_s, uint32_t step_s) {
+    char path[PATH_LEN];
+    segment_path(path, seg->day, "idx");
+    FILE *idx = fopen(path, "rb");
+    segment_path(path, seg->day, "dat");
+    FILE *dat = fopen(path, "rb");
+    if (idx == NULL || dat == NULL) {
+        ESP_LOGW(TAG, "Segment %lu unreadable", (unsigned long)seg->day);
+    } else {
+        size_t n;
+        while ((n = fread(q->blocks, sizeof(ts_store_block_t), READ_BLOCKS, idx)) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                const ts_store_block_t *b = &q->blocks[i];
+                if (b->max_s < start_s || b->min_s >= end_s || fseek(dat, (long)b->offset, SEEK_SET) != 0) {
+                    continue;
+                }
+                for (uint32_t left = b->count; left > 0;) {
+                    size_t want = left < READ_RECORDS ? left : READ_RECORDS;
+                    size_t got = fread(q->records, sizeof(ts_store_record_t), want, dat);
+                    for (size_t r = 0; r < got; r++) {
+                        fold(q, &q->records[r], metric, node_id, start_s, end_s, step_s);
+                    }
+                    if (got < want) {
+                        break;                  // Block cut short by a lost write
+                    }
+                    left -= got;
+                    long_op_step(&q->op);
+                }
+            }
+        }
+    }
+    if (idx != NULL) {
+        fclose(idx);
+    }
+    if (dat != NULL) {
+        fclose(dat);
+    }
+}
+
+esp_err_t ts_store_write_json(json_writer_t *w, ts_store_metric_t metric, uint32_t node_id, uint32_t from_s,
+                              uint32_t to_s, uint32_t step_s) {
+    if (metric >= TS_STORE_METRICS || to_s <= from_s) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (lock == NULL || !loaded) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t span_s = to_s - from_s;
+    if (step_s == 0) {
+        step_s = (span_s + TS_STORE_DEFAULT_POINTS - 1) / TS_STORE_DEFAULT_POINTS;
+    }
+    if ((span_s + (uint64_t)step_s - 1) / step_s > TS_STORE_MAX_POINTS) {
+        step_s = (span_s + TS_STORE_MAX_POINTS - 1) / TS_STORE_MAX_POINTS;
+    }
+
+    query_t *q = http_arena_malloc(sizeof(query_t));
+    if (q == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    json_obj_begin(w);
+    json_kv_str(w, "metric", ts_store_metric_name(metric));
+    if (node_id != 0) {
+        char node[9];
+        snprintf(node, sizeof(node), "%08lx", (unsigned long)node_id);
+        json_kv_str(w, "node", node);
+    } else {
+        json_kv_str(w, "node", "all");
+    }
+    json_kv_uint(w, "from", from_s);
+    json_kv_uint(w, "to", to_s);
+    json_kv_uint(w, "step", step_s);
+    json_key(w, "points");
+    json_arr_begin(w);
+
+    // One chunk of buckets per pass: read what overlaps it, write it out, move on
+    long_op_begin(&q->op, LONG_OP_HISTORY_SCAN);
+    uint64_t chunk_s = (uint64_t)step_s * TS_STORE_QUERY_CHUNK;
+    for (uint64_t start = from_s; start < to_s && w->err == ESP_OK; start += chunk_s) {
+        uint32_t end = start + chunk_s < to_s ? (uint32_t)(start + chunk_s) : to_s;
+        memset(q->buckets, 0, sizeof(q->buckets));
+
+        xSemaphoreTake(lock, portMAX_DELAY);
+        for (uint32_t i = 0; i < segment_count; i++) {
+            if (segments[i].max_s >= start && segments[i].min_s < end) {
+                scan_segment(q, &segments[i], metric, node_id, (uint32_t)start, end, step_s);
+            }
+        }
+        portENTER_CRITICAL(&pending_lock);
+        uint32_t n = pending_count;
+        memcpy(q->pending, pending, n * sizeof(ts_store_record_t));
+        portEXIT_CRITICAL(&pending_lock);
+        xSemaphoreGive(lock);
+        for (uint32_t i = 0; i < n; i++) {
+            fold(q, &q->pending[i], metric, node_id, (uint32_t)start, end, step_s);
+        }
+
+        for (uint32_t i = 0; i < TS_STORE_QUERY_CHUNK; i++) {
+            const bucket_t *b = &q->buckets[i];
+            if (b->n == 0) {
+                continue;
+            }
+            int64_t half = b->n / 2;
+            json_arr_begin(w);
+            json_uint(w, start + (uint64_t)i * step_s);
+            json_uint(w, b->n);
+            json_int(w, b->min);
+            json_int(w, b->max);
+            json_int(w, b->sum >= 0 ? (b->sum + half) / b->n : -((-b->sum + half) / b->n));
+            json_arr_end(w);
+        }
+    }
+
+    long_op_end(&q->op);
+
+    json_arr_end(w);
+    json_obj_end(w);
+    http_arena_free(q);
+    return ESP_OK;
+}
+
+esp_err_t ts_store_export_begin(ts_store_cursor_t *cur, uint32_t from_s, uint32_t to_s) {
+    if (to_s <= from_s) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (lock == NULL || !loaded) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    *cur = (ts_store_cursor_t){ .from_s = from_s, .to_s = to_s, .day = from_s / TS_STORE_SEGMENT_S };
+    return ESP_OK;
+}
+
+/**
+ * @brief Export from the cursor's segment until max is reached; call with lock held
+ *
+ * @return bool true once the segment has nothing more to give
+ */
+static bool export_segment(ts_store_cursor_t *cur, ts_store_record_t *out, size_t max, size_t *produced) {
+    char path[PATH_LEN];
+    segment_path(path, cur->day, "idx");
+    FILE *idx = fopen(path, "rb");
+    if (idx == NULL || fseek(idx, (long)(cur->block * sizeof(ts_store_block_t)), SEEK_SET) != 0) {
+        if (idx != NULL) {
+            fclose(idx);
+        }
+        return true;                            // Unreadable: on to the next day
+    }
+
+    FILE *dat = NULL;
+    ts_store_record_t records[READ_RECORDS];
+    ts_store_block_t b;
+    bool done = false;
+    while (*produced < max) {
+        if (fread(&b, sizeof(b), 1, idx) != 1) {
+            done = true;
+            break;
+        }
+        bool overlaps = b.max_s >= cur->from_s && b.min_s < cur->to_s;
+        bool inside = b.min_s >= cur->from_s && b.max_s < cur->to_s;
+        if (!overlaps) {
+            cur->record = b.count;
+        } else if (inside && out == NULL) {
+            size_t take = b.count - cur->record;
+            if (take > max - *produced) {
+                take = max - *produced;
+            }
+            cur->record += take;
+            *produced += take;
+        } else {
+            if (dat == NULL) {
+                segment_path(path, cur->day, "dat");
+                dat = fopen(path, "rb");
+            }
+            if (dat == NULL || fseek(dat, (long)(b.offset + cur->record * sizeof(ts_store_record_t)), SEEK_SET) != 0) {
+                done = true;
+                break;
+            }
+            while (cur->record < b.count && *produced < max) {
+                size_t want = b.count - cur->record < READ_RECORDS ? b.count - cur->record : READ_RECORDS;
+                size_t got = fread(records, sizeof(ts_store_record_t), want, dat);
+                size_t used = 0;
+                while (used < got && *produced < max) {
+                    const ts_store_record_t *r = &records[used++];
+                    if (r->time_s >= cur->from_s && r->time_s < cur->to_s) {
+                        if (out != NULL) {
+                            out[*produced] = *r;
+                        }
+                        (*produced)++;
+                    }
+                }
+                cur->record += used;
+                if (got < want) {
+                    cur->record = b.count;      // Block cut short by a lost write
+                }
+            }
+        }
+        if (cur->record < b.count) {
+            break;                              // Full mid-block; resume here
+        }
+        cur->block++;
+        cur->record = 0;
+    }
+    fclose(idx);
+    if (dat != NULL) {
+        fclose(dat);
+    }
+    return done;
+}
+
+size_t ts_store_export_read(ts_store_cursor_t *cur, ts_store_record_t *out, size_t max) {
+    size_t produced = 0;
+    if (lock == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    while (produced < max && loaded) {
+        // The next day from the cursor on that overlaps the range; days may have expired meanwhile
+        const segment_t *seg = NULL;
+        for (uint32_t i = 0; i < segment_count && seg == NULL; i++) {
+            if (segments[i].day >= cur->day && segments[i].max_s >= cur->from_s && segments[i].min_s < cur->to_s) {
+                seg = &segments[i];
+            }
+        }
+        if (seg == NULL) {
+            break;
+        }
+        if (seg->day != cur->day) {
+            cur->day = seg->day;
+            cur->block = 0;
+            cur->record = 0;
+        }
+        if (export_segment(cur, out, max, &produced)) {
+            cur->day++;
+            cur->block = 0;
+            cur->record = 0;
+        }
+    }
+    xSemaphoreGive(lock);
+    return produced;
+}
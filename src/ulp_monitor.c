@@ -0,0 +1,183 @@
+/**
+ * @file ulp_monitor.c
+ * @brief ULP coprocessor ADC watch during deep sleep: buffers samples, wakes on a threshold or a full buffer
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "ulp_monitor.h"
+#include "version.h"
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#if CONFIG_ULP_COPROC_TYPE_FSM
+#include "ulp.h"
+#include "ulp_adc.h"
+#include "soc/rtc_cntl_reg.h"
+#include "soc/soc.h"
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register ulp_monitor.c version
+REGISTER_VERSION(UlpMonitor, "1.0.0", "2026-10-14");
+
+static const char *TAG = "ULP_MONITOR";
+
+// Started before the last deep sleep; RTC_DATA_ATTR so it is only kept across deep sleep
+static RTC_DATA_ATTR bool ulp_armed = false;
+
+#if CONFIG_ULP_COPROC_TYPE_FSM
+
+_Static_assert(ULP_MONITOR_RESERVE_BYTES <= CONFIG_ULP_COPROC_RESERVE_MEM,
+               "CONFIG_ULP_COPROC_RESERVE_MEM too small for the ULP monitor");
+
+// Data words after the program; the ULP only writes the low 16 bits of each
+#define VAR_BASE ULP_MONITOR_PROGRAM_WORDS
+#define VAR_COUNT 0
+#define VAR_LAST 1
+#define VAR_REASON 2
+#define VAR_BUF 4
+#define ULP_MEM ((volatile uint32_t *)SOC_RTC_DATA_LOW)
+
+// Program labels
+#define LBL_CROSSED 1
+#define LBL_FULL 2
+#define LBL_WAKE 3
+
+#endif
+
+// =============================
+// Function Definitions
+// =============================
+
+esp_err_t ulp_monitor_start(uint16_t low_raw, uint16_t high_raw) {
+#if CONFIG_ULP_COPROC_TYPE_FSM
+    ulp_adc_cfg_t adc_cfg = {
+        .adc_n = ADC_UNIT_1,
+        .channel = ULP_MONITOR_ADC_CHANNEL,
+        .width = ADC_BITWIDTH_12,
+        .atten = ADC_ATTEN_DB_12,
+        .ulp_mode = ADC_ULP_MODE_FSM,
+    };
+    esp_err_t err = ulp_adc_init(&adc_cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ULP ADC setup failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // R3 = data base, R1 = count, R2 = scratch; thresholds are immediates
+    const ulp_insn_t program[] = {
+        I_ADC(R0, 0, ULP_MONITOR_ADC_CHANNEL),
+        I_MOVI(R3, VAR_BASE),
+        I_ST(R0, R3, VAR_LAST),
+        I_LD(R1, R3, VAR_COUNT),
+        I_ADDR(R2, R3, R1),
+        I_ST(R0, R2, VAR_BUF),                  // buf[count] = sample
+        I_ADDI(R1, R1, 1),
+        I_ST(R1, R3, VAR_COUNT),
+        I_MOVR(R2, R0),
+        I_MOVR(R0, R1),
+        M_BGE(LBL_FULL, ULP_MONITOR_BUFFER_LEN),
+        I_MOVR(R0, R2),
+        M_BL(LBL_CROSSED, low_raw),
+        M_BGE(LBL_CROSSED, high_raw),
+        I_HALT(),
+
+        M_LABEL(LBL_CROSSED),
+        I_MOVI(R0, ULP_MONITOR_WAKE_THRESHOLD),
+        I_ST(R0, R3, VAR_REASON),
+        M_BX(LBL_WAKE),
+
+        M_LABEL(LBL_FULL),
+        I_MOVI(R0, ULP_MONITOR_WAKE_FULL),
+        I_ST(R0, R3, VAR_REASON),
+
+        // Wait until the SoC can take a wake-up, wake it, and stop the ULP timer
+        M_LABEL(LBL_WAKE),
+        I_RD_REG(RTC_CNTL_LOW_POWER_ST_REG, RTC_CNTL_RDY_FOR_WAKEUP_S, RTC_CNTL_RDY_FOR_WAKEUP_S),
+        I_ANDI(R0, R0, 1),
+        M_BXZ(LBL_WAKE),
+        I_WAKE(),
+        I_END(),
+        I_HALT(),
+    };
+
+    ULP_MEM[VAR_BASE + VAR_COUNT] = 0;
+    ULP_MEM[VAR_BASE + VAR_REASON] = ULP_MONITOR_WAKE_NONE;
+    size_t size = sizeof(program) / sizeof(program[0]);
+    err = ulp_process_macros_and_load(0, program, &size);
+    if (err == ESP_OK && size > ULP_MONITOR_PROGRAM_WORDS) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err == ESP_OK) {
+        err = ulp_set_wakeup_period(0, ULP_MONITOR_PERIOD_MS * 1000);
+    }
+    if (err == ESP_OK) {
+        err = ulp_run(0);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ULP program start failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ulp_armed = true;
+    ESP_LOGI(TAG, "ULP watching ADC1_CH%d every %d ms (wake below %u or from %u, or after %d samples)",
+             ULP_MONITOR_ADC_CHANNEL, ULP_MONITOR_PERIOD_MS, low_raw, high_raw, ULP_MONITOR_BUFFER_LEN);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void ulp_monitor_stop(void) {
+#if CONFIG_ULP_COPROC_TYPE_FSM
+    if (ulp_armed) {
+        CLEAR_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);
+    }
+#endif
+    ulp_armed = false;
+}
+
+bool ulp_monitor_running(void) {
+    return ulp_armed;
+}
+
+size_t ulp_monitor_drain(uint16_t *samples, size_t max, ulp_monitor_summary_t *summary) {
+    ulp_monitor_summary_t s = { 0 };
+    size_t copied = 0;
+#if CONFIG_ULP_COPROC_TYPE_FSM
+    uint16_t count = ULP_MEM[VAR_BASE + VAR_COUNT] & 0xFFFF;
+    if (count > ULP_MONITOR_BUFFER_LEN) {
+        count = ULP_MONITOR_BUFFER_LEN;         // Garbage after power-on
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t v = ULP_MEM[VAR_BASE + VAR_BUF + i] & 0xFFFF;
+        if (i == 0 || v < s.min) {
+            s.min = v;
+        }
+        if (i == 0 || v > s.max) {
+            s.max = v;
+        }
+        if (samples != NULL && copied < max) {
+            samples[copied++] = v;
+        }
+    }
+    s.count = count;
+    s.last = ULP_MEM[VAR_BASE + VAR_LAST] & 0xFFFF;
+    uint16_t reason = ULP_MEM[VAR_BASE + VAR_REASON] & 0xFFFF;
+    s.reason = reason <= ULP_MONITOR_WAKE_FULL ? (ulp_monitor_wake_t)reason : ULP_MONITOR_WAKE_NONE;
+    ULP_MEM[VAR_BASE + VAR_COUNT] = 0;
+    ULP_MEM[VAR_BASE + VAR_REASON] = ULP_MONITOR_WAKE_NONE;
+#endif
+    if (summary != NULL) {
+        *summary = s;
+    }
+    return copied;
+}
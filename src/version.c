@@ -1,69 +1,98 @@
 /**
  * @file version.c
  * @brief Implementation of version information functions
- * @version 1.0.0
- * @date 2025-10-18
+ * @version 1.1.0
+ * @date 2026-10-15
  * @author John Devine
  * @email john.h.devine@gmail.com
  */
 
 #include "version.h"
+#include "version_manifest.h"
 #include "esp_log.h"
 
 // Register version.c version
-REGISTER_VERSION(Version, "1.0.0", "2025-10-18");
+REGISTER_VERSION(Version, "1.1.0", "2026-10-15");
+
+// Register project version (once, here: every registration is a linker section entry)
+REGISTER_VERSION(Project, PROJECT_VERSION, PROJECT_BUILD_DATE);
 
 static const char* TAG = "VERSION";
 
+// Bounds of the version_registry section, from SURROUND(version_registry) in src/linker.lf
+extern const version_info_t _version_registry_start;
+extern const version_info_t _version_registry_end;
+
+// Built by the compiler from the generated manifest; nothing is formatted at runtime
+static const char version_html[] =
+    "<div class=\"version-info\">"
+    "<h3>" PROJECT_NAME " v" PROJECT_VERSION "</h3>"
+    "<p><strong>Built:</strong> " PROJECT_BUILD_DATE " at " PROJECT_BUILD_TIME "</p>"
+    "<p><strong>Author:</strong> John Devine &lt;john.h.devine@gmail.com&gt;</p>"
+    "<hr>"
+    "<h4>Component Versions:</h4>"
+    "<ul>" VERSION_MANIFEST_HTML_ITEMS "</ul>"
+    "</div>";
+
+static const char version_json[] =
+    "{\"project\":\"" PROJECT_NAME "\",\"version\":\"" PROJECT_VERSION "\","
+    "\"built\":\"" PROJECT_BUILD_DATE " " PROJECT_BUILD_TIME "\","
+    "\"components\":[" VERSION_MANIFEST_JSON_ITEMS "]}";
+
+size_t version_registry_count(void) {
+    return (size_t)(&_version_registry_end - &_version_registry_start);
+}
+
+const version_info_t* version_registry_get(size_t index) {
+    if (index >= version_registry_count()) {
+        return NULL;
+    }
+    return &_version_registry_start + index;
+}
+
 /**
  * @brief Print project version information
- * 
- * This function prints the project version and build date
+ *
+ * Lists every registration linked into the firmware. A count that differs
+ * from the manifest means a source file's object was not linked (nothing
+ * referenced it) or the manifest is stale.
  */
 void print_version_info(void) {
+    size_t count = version_registry_count();
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "%s v%s", PROJECT_NAME, PROJECT_VERSION);
     ESP_LOGI(TAG, "Built on %s at %s", PROJECT_BUILD_DATE, PROJECT_BUILD_TIME);
     ESP_LOGI(TAG, "Author: John Devine <john.h.devine@gmail.com>");
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "Component Versions:");
-    ESP_LOGI(TAG, "  Main Application: v1.0.0");
-    ESP_LOGI(TAG, "  DNS Server: v1.0.0");
-    ESP_LOGI(TAG, "  NVS Utils: v1.0.0");
-    ESP_LOGI(TAG, "  Web Server: v1.0.0");
-    ESP_LOGI(TAG, "  WiFi AP: v1.0.0");
-    ESP_LOGI(TAG, "  Version System: v1.0.0");
-    ESP_LOGI(TAG, "  SystemMetrics Lib: v1.0.0");
+    for (size_t i = 0; i < count; i++) {
+        const version_info_t* info = version_registry_get(i);
+        ESP_LOGI(TAG, "  %s: v%s (%s)", info->component, info->version, info->date);
+    }
     ESP_LOGI(TAG, "========================================");
+
+    // The manifest leaves out Project, which is registered from build flags
+    if (count != VERSION_MANIFEST_COUNT + 1) {
+        ESP_LOGW(TAG, "%u components linked, %d in the manifest", (unsigned)(count - 1), VERSION_MANIFEST_COUNT);
+    }
 }
 
 /**
  * @brief Get comprehensive version information as formatted string
- * 
+ *
  * Returns a formatted string containing all project and component version
  * information suitable for display in web interfaces.
  */
-const char* get_version_info_string(void) {
-    static char version_buffer[1024];
-    
-    snprintf(version_buffer, sizeof(version_buffer),
-        "<div class=\"version-info\">"
-        "<h3>%s v%s</h3>"
-        "<p><strong>Built:</strong> %s at %s</p>"
-        "<p><strong>Author:</strong> John Devine &lt;john.h.devine@gmail.com&gt;</p>"
-        "<hr>"
-        "<h4>Component Versions:</h4>"
-        "<ul>"
-        "<li><strong>Main Application:</strong> v1.0.0</li>"
-        "<li><strong>DNS Server:</strong> v1.0.0</li>"
-        "<li><strong>NVS Utils:</strong> v1.0.0</li>"
-        "<li><strong>Web Server:</strong> v1.0.0</li>"
-        "<li><strong>WiFi AP:</strong> v1.0.0</li>"
-        "<li><strong>Version System:</strong> v1.0.0</li>"
-        "<li><strong>SystemMetrics Lib:</strong> v1.0.0</li>"
-        "</ul>"
-        "</div>",
-        PROJECT_NAME, PROJECT_VERSION, PROJECT_BUILD_DATE, PROJECT_BUILD_TIME);
-    
-    return version_buffer;
+const char* get_version_info_string(size_t *len) {
+    if (len != NULL) {
+        *len = sizeof(version_html) - 1;
+    }
+    return version_html;
+}
+
+const char* get_version_info_json(size_t *len) {
+    if (len != NULL) {
+        *len = sizeof(version_json) - 1;
+    }
+    return version_json;
 }
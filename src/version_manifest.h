@@ -0,0 +1,133 @@
+/**
+ * @file version_manifest.h
+ * @brief Component version manifest - generated by scripts/version_manifest.py, do not edit
+ */
+
+#ifndef VERSION_MANIFEST_H
+#define VERSION_MANIFEST_H
+
+#define VERSION_MANIFEST_COUNT 57
+
+// One <li> per component
+#define VERSION_MANIFEST_HTML_ITEMS \
+    "<li><strong>Aggregator:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>AssetCache:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>BenchSuite:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>BME680:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>BootTrace:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>CborWriter:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>CoreDump:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>CpuMonitor:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>Discovery:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>DnsPacket:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>DnsServer:</strong> v1.0.0 (2025-10-18)</li>" \
+    "<li><strong>EnergyBench:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>EspnowBatch:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>EspnowLink:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>EspnowReliable:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>FlashBacklog:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>HeapMonitor:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>HttpArena:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>HttpPerf:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>HttpsPortal:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>INA219:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>JsonReader:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>JsonWriter:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>LinkTest:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>LogPolicy:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>LongOp:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>Main:</strong> v1.0.0 (2025-10-18)</li>" \
+    "<li><strong>MetricHistory:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>MetricsExport:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>MetricsStream:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>MqttForwarder:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>MultipartReader:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>N2k:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>NetStats:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>Nmea:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>NodeTable:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>NvsUtils:</strong> v1.0.0 (2025-10-18)</li>" \
+    "<li><strong>OtaResume:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>PowerProfile:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>PressureTrend:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>RainGauge:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>SampleBus:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>Sampler:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>SpscRing:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>StaticMem:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>Storage:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>SystemMetrics:</strong> v1.1.0 (2026-10-14)</li>" \
+    "<li><strong>TaskPlan:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>Telemetry:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>TsStore:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>UlpMonitor:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>Version:</strong> v1.1.0 (2026-10-15)</li>" \
+    "<li><strong>WebAssets:</strong> v1.0.0 (2026-10-15)</li>" \
+    "<li><strong>WebRoutes:</strong> v1.0.0 (2026-10-14)</li>" \
+    "<li><strong>WebServer:</strong> v1.0.0 (2025-10-18)</li>" \
+    "<li><strong>WifiAp:</strong> v1.0.0 (2025-10-18)</li>" \
+    "<li><strong>Wind:</strong> v1.0.0 (2026-10-15)</li>" \
+    ""
+
+// Comma-separated JSON objects, one per component
+#define VERSION_MANIFEST_JSON_ITEMS \
+    "{\"name\":\"Aggregator\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"AssetCache\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"BenchSuite\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"BME680\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"BootTrace\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"CborWriter\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"CoreDump\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"CpuMonitor\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"Discovery\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"DnsPacket\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"DnsServer\",\"version\":\"1.0.0\",\"date\":\"2025-10-18\"}," \
+    "{\"name\":\"EnergyBench\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"EspnowBatch\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"EspnowLink\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"EspnowReliable\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"FlashBacklog\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"HeapMonitor\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"HttpArena\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"HttpPerf\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"HttpsPortal\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"INA219\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"JsonReader\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"JsonWriter\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"LinkTest\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"LogPolicy\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"LongOp\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"Main\",\"version\":\"1.0.0\",\"date\":\"2025-10-18\"}," \
+    "{\"name\":\"MetricHistory\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"MetricsExport\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"MetricsStream\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"MqttForwarder\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"MultipartReader\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"N2k\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"NetStats\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"Nmea\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"NodeTable\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"NvsUtils\",\"version\":\"1.0.0\",\"date\":\"2025-10-18\"}," \
+    "{\"name\":\"OtaResume\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"PowerProfile\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"PressureTrend\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"RainGauge\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"SampleBus\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"Sampler\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"SpscRing\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"StaticMem\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"Storage\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"SystemMetrics\",\"version\":\"1.1.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"TaskPlan\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"Telemetry\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"TsStore\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"UlpMonitor\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"Version\",\"version\":\"1.1.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"WebAssets\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}," \
+    "{\"name\":\"WebRoutes\",\"version\":\"1.0.0\",\"date\":\"2026-10-14\"}," \
+    "{\"name\":\"WebServer\",\"version\":\"1.0.0\",\"date\":\"2025-10-18\"}," \
+    "{\"name\":\"WifiAp\",\"version\":\"1.0.0\",\"date\":\"2025-10-18\"}," \
+    "{\"name\":\"Wind\",\"version\":\"1.0.0\",\"date\":\"2026-10-15\"}" \
+    ""
+
+#endif // VERSION_MANIFEST_H
@@ -0,0 +1,151 @@
+/**
+ * @file web_assets.c
+ * @brief Web UI assets built into the app image, served without the filesystem
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "web_assets.h"
+#include "version.h"
+#include <string.h>
+#if WEB_EMBED_ASSETS
+#include <stdio.h>
+#include <sys/stat.h>
+#include "asset_cache.h"
+#include "esp_log.h"
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register web_assets.c version
+REGISTER_VERSION(WebAssets, "1.0.0", "2026-10-15");
+
+#if WEB_EMBED_ASSETS
+
+static const char *TAG = "WEB_ASSETS";
+
+// Table generated from the staged assets by scripts/build_web_assets.py, blob embedded by src/CMakeLists.txt
+#include "web_assets_table.h"
+
+extern const uint8_t web_assets_blob_start[] asm("_binary_web_assets_bin_start");
+extern const uint8_t web_assets_blob_end[] asm("_binary_web_assets_bin_end");
+
+#define PATH_LEN 64
+
+static bool overridden[WEB_ASSET_COUNT];
+static uint32_t override_count = 0;
+static uint32_t served_count = 0;
+
+#endif
+
+// =============================
+// Function Prototypes
+// =============================
+#if WEB_EMBED_ASSETS
+static bool blob_matches(void);
+#endif
+
+// =============================
+// Function Definitions
+// =============================
+
+#if WEB_EMBED_ASSETS
+
+/**
+ * @brief False when the embedded blob is from another build than the table
+ */
+static bool blob_matches(void) {
+    return (size_t)(web_assets_blob_end - web_assets_blob_start) >= WEB_ASSET_BLOB_SIZE;
+}
+
+const web_asset_t *web_assets_find(const char *path) {
+    if (path == NULL || !blob_matches()) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < WEB_ASSET_COUNT; i++) {
+        if (strcmp(web_asset_table[i].path, path) == 0) {
+            return overridden[i] ? NULL : &web_asset_table[i];
+        }
+    }
+    return NULL;
+}
+
+const uint8_t *web_assets_data(const web_asset_t *asset) {
+    return web_assets_blob_start + asset->offset;
+}
+
+void web_assets_scan_overrides(const char *base_path) {
+    if (!blob_matches()) {
+        ESP_LOGE(TAG, "Embedded blob is %lu bytes, the table expects %lu; serving from the filesystem",
+                 (unsigned long)(web_assets_blob_end - web_assets_blob_start), (unsigned long)WEB_ASSET_BLOB_SIZE);
+        return;
+    }
+
+    char filepath[PATH_LEN];
+    override_count = 0;
+    for (uint32_t i = 0; i < WEB_ASSET_COUNT; i++) {
+        const web_asset_t *asset = &web_asset_table[i];
+        const char *suffix = asset->gzip ? ".gz" : "";
+        struct stat st;
+        bool differs = false;
+        snprintf(filepath, sizeof(filepath), "%s%s%s", base_path, asset->path, suffix);
+        if (stat(filepath, &st) == 0) {
+            // The manifest is keyed by path relative to the mount point, as the cache looks it up
+            const char *etag = asset_cache_get_etag(filepath + strlen(base_path));
+            differs = etag == NULL || strcmp(etag, asset->etag) != 0;
+        } else if (asset->gzip) {
+            // A plain copy without its .gz sibling did not come from the build
+            snprintf(filepath, sizeof(filepath), "%s%s", base_path, asset->path);
+            differs = stat(filepath, &st) == 0;
+        }
+        overridden[i] = differs;
+        if (differs) {
+            override_count++;
+            ESP_LOGI(TAG, "%s overridden by the filesystem", asset->path);
+        }
+    }
+    ESP_LOGI(TAG, "%lu embedded assets (%lu bytes), %lu overridden", (unsigned long)WEB_ASSET_COUNT,
+             (unsigned long)WEB_ASSET_BLOB_SIZE, (unsigned long)override_count);
+}
+
+void web_assets_record_served(void) {
+    served_count++;
+}
+
+void web_assets_get_stats(web_assets_stats_t *stats) {
+    stats->assets = WEB_ASSET_COUNT;
+    stats->bytes = WEB_ASSET_BLOB_SIZE;
+    stats->overridden = override_count;
+    stats->served = served_count;
+}
+
+#else
+
+const web_asset_t *web_assets_find(const char *path) {
+    (void)path;
+    return NULL;
+}
+
+const uint8_t *web_assets_data(const web_asset_t *asset) {
+    (void)asset;
+    return NULL;
+}
+
+void web_assets_scan_overrides(const char *base_path) {
+    (void)base_path;
+}
+
+void web_assets_record_served(void) {
+}
+
+void web_assets_get_stats(web_assets_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+#endif
@@ -0,0 +1,23 @@
+/**
+ * @file web_assets_table.h
+ * @brief Embedded web asset table - generated by scripts/build_web_assets.py, do not edit
+ */
+
+#ifndef WEB_ASSETS_TABLE_H
+#define WEB_ASSETS_TABLE_H
+
+#define WEB_ASSET_COUNT 8
+#define WEB_ASSET_BLOB_SIZE 49685
+
+static const web_asset_t web_asset_table[WEB_ASSET_COUNT] = {
+    { "/configuration.html", "text/html", "\"75e05ac80e8a52b8\"", 0, 9486, true },
+    { "/favicon.ico", "image/x-icon", "\"714520df76c310c1\"", 9486, 14, false },
+    { "/fleet.html", "text/html", "\"fbc3b26ee41de341\"", 9500, 2625, true },
+    { "/index.html", "text/html", "\"36a7f46a5727fddf\"", 12125, 7368, true },
+    { "/information.html", "text/html", "\"5ceb15ff0d355d2e\"", 19493, 11187, true },
+    { "/ota.html", "text/html", "\"6c52a799de46c352\"", 30680, 9717, true },
+    { "/scripts.js", "application/javascript", "\"4916693a0bb3d9bf\"", 40397, 4691, true },
+    { "/styles.css", "text/css", "\"1b215a340430476e\"", 45088, 4597, true },
+};
+
+#endif // WEB_ASSETS_TABLE_H
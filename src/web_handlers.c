@@ -0,0 +1,350 @@
+/**
+ * @file web_handlers.c
+ * @brief Request logic of the portal's config and OTA upload endpoints, on the portable http_io.h interface
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "web_handlers.h"
+#include "config_schema.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "multipart_reader.h"
+#include "version.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register web_handlers.c version
+REGISTER_VERSION(WebHandlers, "1.0.0", "2026-10-15");
+
+#define OTA_CONTENT_TYPE_MAX 128
+
+/**
+ * @brief Multipart state of one /api/ota upload
+ */
+typedef struct {
+    web_ota_form_t *form;                       // Filled from the form fields before the file part
+    const web_ota_sink_t *sink;
+    void *sink_ctx;
+    char field[MULTIPART_NAME_MAX];             // Current plain field
+    char value[WEB_OTA_HASH_LEN];               // Its value, truncated to fit
+    size_t value_len;
+    bool in_file;
+    bool started;                               // sink->begin() succeeded
+    bool file_complete;
+    const char *failure;                        // Error response text, NULL if the body was at fault
+    int failure_code;
+} ota_upload_t;
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t config_on_event(void *ctx, const json_event_t *event);
+static esp_err_t ota_on_part_begin(void *ctx, const char *name, const char *filename);
+static esp_err_t ota_on_part_data(void *ctx, const uint8_t *data, size_t len);
+static esp_err_t ota_on_part_end(void *ctx);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Map a top-level /save_config member onto the pending configuration
+ *
+ * The schema (config_schema.h) decides where each member lands and how it
+ * is checked; bootCount, kept by SystemMetrics, is the one member outside
+ * it. Nested members are ignored.
+ */
+static esp_err_t config_on_event(void *ctx, const json_event_t *event) {
+    web_config_body_t *body = (web_config_body_t *)ctx;
+
+    if (event->depth != 1 || event->key == NULL ||
+        (event->type != JSON_EVENT_STRING && event->type != JSON_EVENT_NUMBER)) {
+        return ESP_OK;
+    }
+
+    const config_field_t *field = config_schema_find_json(event->key);
+    if (field != NULL) {
+        if (config_schema_apply_json(&body->cfg, field, event->value, event->value_len)) {
+            body->fields_set++;
+        }
+    } else if (strcmp(event->key, "bootCount") == 0) {
+        body->boot_count = (uint32_t)strtoul(event->value, NULL, 10);
+        body->have_boot_count = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t web_config_receive(http_io_t *io, web_config_body_t *body) {
+    size_t remaining = io->content_len;
+    if (remaining == 0) {
+        http_io_send_error(io, 400, "Empty content");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (remaining > WEB_CONFIG_MAX_BODY) {
+        http_io_send_error(io, 400, "Content too large");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    body->fields_set = 0;
+    body->have_boot_count = false;
+    body->parse_err = ESP_OK;
+
+    // Parse straight from the socket, one recv buffer at a time
+    json_reader_t reader;
+    json_reader_init(&reader, config_on_event, body);
+
+    char chunk[WEB_CONFIG_RECV_CHUNK];
+    esp_err_t parse_result = ESP_OK;
+    while (remaining > 0) {
+        int ret = http_io_recv(io, chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+        if (ret <= 0) {
+            if (ret == HTTP_IO_RECV_TIMEOUT) {
+                http_io_send_error(io, 408, "Request timeout");
+                return ESP_ERR_TIMEOUT;
+            }
+            return ESP_FAIL;
+        }
+        remaining -= (size_t)ret;
+
+        // Keep draining after a parse error so the connection stays usable
+        if (parse_result == ESP_OK) {
+            parse_result = json_reader_feed(&reader, chunk, (size_t)ret);
+        }
+    }
+    if (parse_result == ESP_OK) {
+        parse_result = json_reader_finish(&reader);
+    }
+
+    if (parse_result != ESP_OK) {
+        body->parse_err = parse_result;
+        http_io_set_status(io, "400 Bad Request");
+        http_io_set_type(io, "application/json");
+        http_io_send_str(io, "{\"message\":\"Invalid configuration JSON\",\"status\":\"error\"}");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t web_config_send(http_io_t *io, const device_config_t *cfg, uint32_t boot_count) {
+    if (io->head) {
+        http_io_set_type(io, "application/json");
+        return http_io_send(io, NULL, 0);
+    }
+
+    json_writer_t w;
+    http_io_init_json(&w, io);
+    json_obj_begin(&w);
+    config_schema_write_json(&w, cfg);
+    json_kv_uint(&w, "bootCount", boot_count);
+    json_obj_end(&w);
+    return json_writer_finish(&w);
+}
+
+esp_err_t web_config_export(http_io_t *io, const device_config_t *cfg, bool unit, uint8_t *buf) {
+    size_t len = config_schema_export_blob(cfg, unit, buf, CONFIG_SCHEMA_BLOB_MAX);
+    if (len == 0) {
+        http_io_send_error(io, 500, "Config does not fit the blob");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    http_io_set_type(io, "application/octet-stream");
+    return http_io_send(io, (const char *)buf, len);
+}
+
+esp_err_t web_config_import(http_io_t *io, device_config_t *cfg, uint8_t *buf, config_import_result_t *result) {
+    size_t len = io->content_len;
+    if (len == 0) {
+        http_io_send_error(io, 400, "Empty content");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (len > CONFIG_SCHEMA_BLOB_MAX) {
+        http_io_send_error(io, 400, "Content too large");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    for (size_t got = 0; got < len;) {
+        int ret = http_io_recv(io, (char *)buf + got, len - got);
+        if (ret <= 0) {
+            if (ret == HTTP_IO_RECV_TIMEOUT) {
+                http_io_send_error(io, 408, "Request timeout");
+                return ESP_ERR_TIMEOUT;
+            }
+            return ESP_FAIL;
+        }
+        got += (size_t)ret;
+    }
+
+    esp_err_t err = config_schema_import_blob(cfg, buf, len, result);
+    if (err == ESP_ERR_INVALID_CRC) {
+        http_io_send_error(io, 400, "Config blob CRC mismatch");
+    } else if (err == ESP_ERR_NOT_SUPPORTED) {
+        http_io_send_error(io, 400, "Unsupported config blob version");
+    } else if (err != ESP_OK) {
+        http_io_send_error(io, 400, "Invalid config blob");
+    }
+    return err;
+}
+
+bool web_ota_hash_valid(const char *hash) {
+    size_t i = 0;
+    for (; hash[i] != '\0'; i++) {
+        if (!isxdigit((unsigned char)hash[i])) {
+            return false;
+        }
+    }
+    return i == WEB_OTA_HASH_LEN - 1;
+}
+
+/**
+ * @brief Begin the sink when the file part opens; plain fields are collected for part end
+ */
+static esp_err_t ota_on_part_begin(void *ctx, const char *name, const char *filename) {
+    ota_upload_t *upload = (ota_upload_t *)ctx;
+
+    upload->value_len = 0;
+    strlcpy(upload->field, name, sizeof(upload->field));
+    if (filename == NULL || upload->started) {
+        upload->in_file = false;                // A plain field, or an extra file part to skip
+        return ESP_OK;
+    }
+
+    // Form fields precede the file, so the form is complete by now
+    if (upload->form->hash[0] != '\0' && !web_ota_hash_valid(upload->form->hash)) {
+        upload->failure = "Invalid image hash";
+        upload->failure_code = 400;
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (upload->form->for_nodes && upload->form->filesystem) {
+        upload->failure = "Only firmware can be sent to the nodes";
+        upload->failure_code = 400;
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = upload->sink->begin(upload->sink_ctx, upload->form, filename);
+    if (ret != ESP_OK) {
+        upload->failure = "OTA start failed";
+        upload->failure_code = 500;
+        return ret;
+    }
+    upload->started = true;
+    upload->in_file = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief File data goes straight from the receive buffer to the sink
+ */
+static esp_err_t ota_on_part_data(void *ctx, const uint8_t *data, size_t len) {
+    ota_upload_t *upload = (ota_upload_t *)ctx;
+
+    if (upload->in_file) {
+        esp_err_t ret = upload->sink->write(upload->sink_ctx, data, len);
+        if (ret != ESP_OK) {
+            upload->failure = "OTA write failed";
+            upload->failure_code = 500;
+        }
+        return ret;
+    }
+
+    // Short text field; anything past the buffer is dropped
+    size_t room = sizeof(upload->value) - 1 - upload->value_len;
+    size_t n = len < room ? len : room;
+    memcpy(upload->value + upload->value_len, data, n);
+    upload->value_len += n;
+    return ESP_OK;
+}
+
+static esp_err_t ota_on_part_end(void *ctx) {
+    ota_upload_t *upload = (ota_upload_t *)ctx;
+
+    if (upload->in_file) {
+        upload->in_file = false;
+        upload->file_complete = true;
+        return ESP_OK;
+    }
+
+    upload->value[upload->value_len] = '\0';
+    if (strcmp(upload->field, "type") == 0 && strcmp(upload->value, "filesystem") == 0) {
+        upload->form->filesystem = true;
+    } else if (strcmp(upload->field, "target") == 0 && strcmp(upload->value, "nodes") == 0) {
+        upload->form->for_nodes = true;
+    } else if (strcmp(upload->field, "encoding") == 0 && strcmp(upload->value, "zlib") == 0) {
+        upload->form->zlib = true;
+    } else if (strcmp(upload->field, "hash") == 0 && upload->value_len > 0) {
+        strlcpy(upload->form->hash, upload->value, sizeof(upload->form->hash));
+    }
+    // skipBackup is ignored: a backup is taken beforehand from GET /api/ota/backup
+    return ESP_OK;
+}
+
+esp_err_t web_ota_receive(http_io_t *io, const web_ota_sink_t *sink, void *ctx, uint8_t *buf, size_t buf_len,
+                          web_ota_form_t *form) {
+    size_t total = io->content_len;
+    if (total == 0) {
+        http_io_send_error(io, 400, "Empty upload");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (total > WEB_OTA_MAX_UPLOAD) {
+        http_io_send_error(io, 413, "Upload too large");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memset(form, 0, sizeof(*form));
+    // The hash may come as a header or as a "hash" form field (the field wins)
+    if (http_io_get_header(io, "X-Image-SHA256", form->hash, sizeof(form->hash)) != ESP_OK) {
+        form->hash[0] = '\0';
+    }
+    ota_upload_t upload = { .form = form, .sink = sink, .sink_ctx = ctx };
+
+    static const multipart_callbacks_t callbacks = {
+        .on_part_begin = ota_on_part_begin,
+        .on_part_data = ota_on_part_data,
+        .on_part_end = ota_on_part_end
+    };
+    char content_type[OTA_CONTENT_TYPE_MAX];
+    multipart_reader_t parser;
+    if (http_io_get_header(io, "Content-Type", content_type, sizeof(content_type)) != ESP_OK ||
+        multipart_reader_init(&parser, content_type, &callbacks, &upload) != ESP_OK) {
+        http_io_send_error(io, 400, "Malformed upload");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t remaining = total;
+    esp_err_t ret = ESP_OK;
+    while (remaining > 0 && ret == ESP_OK) {
+        int r = http_io_recv(io, (char *)buf, remaining < buf_len ? remaining : buf_len);
+        if (r <= 0) {
+            upload.failure = "Receive error";
+            upload.failure_code = 408;
+            ret = ESP_FAIL;
+            break;
+        }
+        remaining -= (size_t)r;
+        ret = multipart_reader_feed(&parser, buf, (size_t)r);
+    }
+    if (ret == ESP_OK) {
+        ret = multipart_reader_finish(&parser);
+    }
+
+    if (ret != ESP_OK || !upload.file_complete) {
+        if (upload.started && sink->abort != NULL) {
+            sink->abort(ctx);
+        }
+        if (upload.failure != NULL) {
+            http_io_send_error(io, upload.failure_code, upload.failure);
+        } else if (!upload.started) {
+            http_io_send_error(io, 400, "No file in upload");
+        } else {
+            http_io_send_error(io, 400, "Malformed upload");
+        }
+        return ret != ESP_OK ? ret : ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
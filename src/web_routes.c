@@ -0,0 +1,74 @@
+/**
+ * @file web_routes.c
+ * @brief Constant-time URI routing for the web UI assets and captive-portal probes
+ * @version 1.0.0
+ * @date 2026-10-14
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "web_routes.h"
+#include "version.h"
+#include <string.h>
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register web_routes.c version
+REGISTER_VERSION(WebRoutes, "1.0.0", "2026-10-14");
+
+// Table and hash seed are generated from data/ by scripts/build_web_assets.py
+#include "web_routes_table.h"
+
+_Static_assert(WEB_ROUTE_COUNT <= WEB_ROUTES_MAX, "more routes than the portal reserves handlers for");
+_Static_assert((WEB_ROUTE_SLOT_COUNT & (WEB_ROUTE_SLOT_COUNT - 1)) == 0,
+               "slot count must be a power of two");
+
+// =============================
+// Function Prototypes
+// =============================
+static uint32_t route_hash(const char *uri, size_t len);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Seeded FNV-1a; must match route_hash() in scripts/build_web_assets.py
+ */
+static uint32_t route_hash(const char *uri, size_t len) {
+    uint32_t hash = WEB_ROUTE_HASH_SEED;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)uri[i]) * 16777619u;
+    }
+    return hash;
+}
+
+const web_route_t *web_route_find(const char *uri) {
+    if (uri == NULL) {
+        return NULL;
+    }
+
+    size_t len = strcspn(uri, "?");
+    int index = web_route_slots[route_hash(uri, len) & (WEB_ROUTE_SLOT_COUNT - 1)];
+    if (index < 0) {
+        return NULL;
+    }
+
+    // The slot may belong to a different URI with the same hash bits
+    const web_route_t *route = &web_route_table[index];
+    if (strncmp(route->uri, uri, len) != 0 || route->uri[len] != '\0') {
+        return NULL;
+    }
+    return route;
+}
+
+const web_route_t *web_routes_get(size_t *count) {
+    if (count != NULL) {
+        *count = WEB_ROUTE_COUNT;
+    }
+    return web_route_table;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file web_routes_table.h
+ * @brief URI routing table - generated by scripts/build_web_assets.py, do not edit
+ */
+
+#ifndef WEB_ROUTES_TABLE_H
+#define WEB_ROUTES_TABLE_H
+
+#define WEB_ROUTE_COUNT 21
+#define WEB_ROUTE_SLOT_COUNT 64
+#define WEB_ROUTE_HASH_SEED 0x811C9DE4u
+
+static const web_route_t web_route_table[WEB_ROUTE_COUNT] = {
+    { "/", "/index.html", "text/html", WEB_ROUTE_ASSET },
+    { "/configuration.html", "/configuration.html", "text/html", WEB_ROUTE_ASSET },
+    { "/favicon.ico", "/favicon.ico", "image/x-icon", WEB_ROUTE_ASSET },
+    { "/fleet.html", "/fleet.html", "text/html", WEB_ROUTE_ASSET },
+    { "/index.html", "/index.html", "text/html", WEB_ROUTE_ASSET },
+    { "/information.html", "/information.html", "text/html", WEB_ROUTE_ASSET },
+    { "/ota.html", "/ota.html", "text/html", WEB_ROUTE_ASSET },
+    { "/scripts.js", "/scripts.js", "application/javascript", WEB_ROUTE_ASSET },
+    { "/styles.css", "/styles.css", "text/css", WEB_ROUTE_ASSET },
+    { "/canonical.html", NULL, NULL, WEB_ROUTE_PROBE_REDIRECT },
+    { "/check_network_status.txt", NULL, NULL, WEB_ROUTE_PROBE_REDIRECT },
+    { "/connectivity-check.html", NULL, NULL, WEB_ROUTE_PROBE_REDIRECT },
+    { "/connecttest.txt", NULL, NULL, WEB_ROUTE_PROBE_REDIRECT },
+    { "/gen_204", NULL, NULL, WEB_ROUTE_PROBE_NO_CONTENT },
+    { "/generate_204", NULL, NULL, WEB_ROUTE_PROBE_NO_CONTENT },
+    { "/hotspot-detect.html", NULL, NULL, WEB_ROUTE_PROBE_REDIRECT },
+    { "/kindle-wifi/wifistub.html", NULL, NULL, WEB_ROUTE_PROBE_REDIRECT },
+    { "/library/test/success.html", NULL, NULL, WEB_ROUTE_PROBE_REDIRECT },
+    { "/ncsi.txt", NULL, NULL, WEB_ROUTE_PROBE_NO_CONTENT },
+    { "/redirect", NULL, NULL, WEB_ROUTE_PROBE_REDIRECT },
+    { "/success.txt", NULL, NULL, WEB_ROUTE_PROBE_REDIRECT },
+};
+
+// Route index per hash slot, -1 for an empty slot
+static const int8_t web_route_slots[WEB_ROUTE_SLOT_COUNT] = {
+    -1, -1, 20, -1, -1, -1,  4, 14,  5, -1, -1, -1,  1, 19, -1, -1,
+    18,  0, -1, -1, -1, -1, -1, -1, -1, 16,  8, -1, 17, -1, -1, -1,
+     9, -1, -1, 12,  2, -1, -1, 15,  6, -1, -1, -1, -1, -1, -1, 10,
+     7, -1,  3, -1, 13, -1, -1, -1, -1, -1, 11, -1, -1, -1, -1, -1,
+};
+
+#endif // WEB_ROUTES_TABLE_H
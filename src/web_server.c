@@ -12,27 +12,117 @@
 // =============================
 #include "web_server.h"
 #include "nvs_utils.h"
+#include "config_schema.h"
 #include "version.h"
 #include "SystemMetrics.h"
 #include "ota_manager.h"
+#include "ota_resume.h"
+#include "asset_cache.h"
+#include "web_assets.h"
+#include "web_routes.h"
+#include "metrics_stream.h"
+#include "signalk.h"
+#include "history_export.h"
+#include "gateway.h"
+#include "json_writer.h"
+#include "log_policy.h"
+#include "event_log.h"
+#include "http_perf.h"
+#include "cpu_monitor.h"
+#include "heap_monitor.h"
+#include "net_stats.h"
+#include "metric_history.h"
+#include "coredump.h"
+#include "metrics_export.h"
+#include "discovery.h"
+#include "boot_trace.h"
+#include "pipeline_trace.h"
+#include "node_table.h"
+#include "latest_values.h"
+#include "aggregator.h"
+#include "calib.h"
+#include "storage.h"
+#include "ts_store.h"
+#include "static_mem.h"
+#include "http_arena.h"
+#include "https_portal.h"
+#include "http_gzip.h"
+#include "http_session.h"
+#include "portal_probe.h"
+#include "http_io.h"
+#include "web_handlers.h"
+#include <inttypes.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
-#include "esp_spiffs.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+#include "lwip/sockets.h"
 #include <errno.h>
 #include "esp_log.h"
 
 // =============================
 // Function Prototypes
 // =============================
+static esp_err_t mount_spiffs(void);
+static void load_assets(void);
+static esp_err_t switch_asset_slot(void);
+static void spiffs_mount_task(void *arg);
+static bool spiffs_wait_ready(void);
 static esp_err_t file_get_handler(httpd_req_t *req);
+static esp_err_t serve_file(httpd_req_t *req);
+static void set_asset_headers(httpd_req_t *req, const char *mime_type, bool gzip_encoded, const char *etag);
+static bool etag_matches(httpd_req_t *req, const char *etag);
+static esp_err_t send_not_modified(httpd_req_t *req, const char *mime_type, bool gzip_encoded, const char *etag);
+static esp_err_t send_cached_asset(httpd_req_t *req, const asset_cache_entry_t *entry,
+                                   const char *mime_type, bool gzip_encoded);
+static esp_err_t send_embedded_asset(httpd_req_t *req, const web_asset_t *asset, const char *mime_type);
+static esp_err_t ota_sink_begin(void *ctx, const web_ota_form_t *form, const char *filename);
+static esp_err_t ota_sink_write(void *ctx, const uint8_t *data, size_t len);
+static void ota_sink_abort(void *ctx);
 static esp_err_t save_config_handler(httpd_req_t *req);
 static esp_err_t get_config_handler(httpd_req_t *req);
+static esp_err_t get_config_schema_handler(httpd_req_t *req);
+static esp_err_t config_export_handler(httpd_req_t *req);
+static esp_err_t config_import_handler(httpd_req_t *req);
+static void write_metric_json(json_writer_t *w, system_metric_t metric,
+                              const char *value, metric_error_t error);
+static void write_metric_value_json(json_writer_t *w, const metric_sample_t *sample);
 static esp_err_t get_metric_handler(httpd_req_t *req);
+static esp_err_t api_metrics_handler(httpd_req_t *req);
 static esp_err_t get_version_info_handler(httpd_req_t *req);
 static esp_err_t captive_portal_redirect_handler(httpd_req_t *req);
+static esp_err_t not_found_handler(httpd_req_t *req, httpd_err_code_t error);
 static esp_err_t ota_api_get_handler(httpd_req_t *req);
+static esp_err_t ota_backup_get_handler(httpd_req_t *req);
+static esp_err_t ota_chunk_get_handler(httpd_req_t *req);
+static esp_err_t ota_chunk_put_handler(httpd_req_t *req);
+static esp_err_t server_stats_handler(httpd_req_t *req);
+static esp_err_t perf_handler(httpd_req_t *req);
+static esp_err_t heap_handler(httpd_req_t *req);
+static esp_err_t history_handler(httpd_req_t *req);
+static esp_err_t series_history(httpd_req_t *req, const char *query, const char *metric_name);
+static esp_err_t boot_trace_handler(httpd_req_t *req);
+static esp_err_t nodes_handler(httpd_req_t *req);
+static esp_err_t latest_handler(httpd_req_t *req);
+static esp_err_t aggregates_handler(httpd_req_t *req);
+static esp_err_t calibration_get_handler(httpd_req_t *req);
+static esp_err_t calibration_post_handler(httpd_req_t *req);
+static esp_err_t coredump_get_handler(httpd_req_t *req);
+static esp_err_t coredump_delete_handler(httpd_req_t *req);
+static esp_err_t log_level_get_handler(httpd_req_t *req);
+static esp_err_t log_level_post_handler(httpd_req_t *req);
+static esp_err_t event_log_handler(httpd_req_t *req);
+static void portal_httpd_config(httpd_config_t *config);
+static esp_err_t portal_open_fn(httpd_handle_t hd, int sockfd);
+static void portal_close_fn(httpd_handle_t hd, int sockfd);
 // Reboot task for delayed filesystem reboot
 static void reboot_task(void *pvParameter) {
     static const char* REBOOT_TAG = "REBOOT_TASK";
@@ -51,106 +141,349 @@ REGISTER_VERSION(WebServer, "1.0.0", "2025-10-18");
 static const char *TAG = "WEB_SERVER";
 static httpd_handle_t server_handle = NULL;
 
+// Background SPIFFS mount; asset requests wait on SPIFFS_EVT_DONE
+#define SPIFFS_EVT_DONE (1 << 0)
+static EventGroupHandle_t spiffs_events = NULL;
+static StaticEventGroup_t spiffs_events_buf;
+static bool spiffs_mounted = false;
+
+// Connection accounting; the open/close callbacks run on the httpd task
+static web_server_conn_stats_t conn_stats;
+static int open_fds[WEB_SERVER_PORTAL_MAX_SOCKETS];
+
+// Rate limits for warnings a busy portal can trigger on every request
+static log_rate_limit_t unknown_uri_log = LOG_RATE_LIMIT_INIT(5, 2000);
+static log_rate_limit_t probe_log = LOG_RATE_LIMIT_INIT(5, 2000);
+static log_rate_limit_t conn_log = LOG_RATE_LIMIT_INIT(5, 1000);
+
+#define PORTAL_URL (HTTPS_PORTAL != 0 ? "https://192.168.4.1/" : "http://192.168.4.1/")  // Where probes and misses go
+
+_Static_assert(HTTP_PERF_MAX_HANDLERS >= WEB_SERVER_PORTAL_MAX_HANDLERS,
+               "a portal handler without an http_perf slot would run without a request arena");
+_Static_assert(WEB_OTA_HASH_LEN == OTA_HASH_STR_LEN, "the upload form carries an OTA image hash");
+
 // =============================
 // Function Definitions
 // =============================
 
-esp_err_t web_server_init_spiffs(void) {
-    ESP_LOGI(TAG, "Initializing SPIFFS...");
-
-    esp_vfs_spiffs_conf_t conf = {
-        .base_path = SPIFFS_BASE_PATH,
-        .partition_label = NULL,
-        .max_files = 10,
-        .format_if_mount_failed = true
-    };
+/**
+ * @brief Mount the data partition (formatting if needed) and fill the asset cache
+ */
+static esp_err_t mount_spiffs(void) {
+    // A half-written image would fail to mount and be formatted, losing the upload
+    if (ota_resume_pending(OTA_TYPE_FILESYSTEM) && storage_spare_label() == NULL) {
+        ESP_LOGW(TAG, "Chunked filesystem upload pending, leaving %s unmounted", storage_name());
+        return ESP_OK;
+    }
 
-    esp_err_t ret = esp_vfs_spiffs_register(&conf);
+    esp_err_t ret = storage_mount(SPIFFS_BASE_PATH, 10, true);
 
     if (ret == ESP_FAIL) {
-        ESP_LOGW(TAG, "Failed to mount SPIFFS, formatting...");
-        ret = esp_spiffs_format(NULL);
+        ESP_LOGW(TAG, "Failed to mount %s, formatting...", storage_name());
+        ret = storage_format();
         if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to format SPIFFS: %s", esp_err_to_name(ret));
+            ESP_LOGE(TAG, "Failed to format %s: %s", storage_name(), esp_err_to_name(ret));
             return ret;
         }
-        ret = esp_vfs_spiffs_register(&conf);
+        ret = storage_mount(SPIFFS_BASE_PATH, 10, true);
     }
 
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize SPIFFS: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to initialize %s: %s", storage_name(), esp_err_to_name(ret));
         return ret;
     }
 
     size_t total = 0, used = 0;
-    ret = esp_spiffs_info(NULL, &total, &used);
+    ret = storage_info(&total, &used);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to get SPIFFS partition information: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to get %s partition information: %s", storage_name(), esp_err_to_name(ret));
         return ret;
     }
 
-    ESP_LOGI(TAG, "SPIFFS partition size: total=%zu bytes, used=%zu bytes", total, used);
+    ESP_LOGI(TAG, "%s partition %s size: total=%zu bytes, used=%zu bytes", storage_name(),
+             storage_active_label(), total, used);
+
+    load_assets();
+    spiffs_mounted = true;
     return ESP_OK;
 }
 
-static esp_err_t file_get_handler(httpd_req_t *req) {
-    ESP_LOGI(TAG, "File request: %s", req->uri);
-    ESP_LOGI(TAG, "Request method: %s", req->method == HTTP_GET ? "GET" : "OTHER");
-
-    // Check if this is a known file request
-    if (strcmp(req->uri, "/") == 0 ||
-        strcmp(req->uri, "/index.html") == 0 ||
-        strcmp(req->uri, "/configuration.html") == 0 ||
-        strcmp(req->uri, "/information.html") == 0 ||
-        strcmp(req->uri, "/ota.html") == 0 ||
-        strcmp(req->uri, "/styles.css") == 0 ||
-        strcmp(req->uri, "/scripts.js") == 0 ||
-        strcmp(req->uri, "/favicon.ico") == 0) {
-        ESP_LOGI(TAG, "Recognized file request for: %s", req->uri);
-    } else {
-        ESP_LOGW(TAG, "Unexpected file request for: %s", req->uri);
+/**
+ * @brief Fill the asset cache from the mounted slot
+ */
+static void load_assets(void) {
+    // Keep the UI in RAM so page loads skip the filesystem; failures just mean more misses.
+    // An image that carries the UI only needs the ETags, to spot the files that override it.
+    esp_err_t ret = asset_cache_init(SPIFFS_BASE_PATH, WEB_EMBED_ASSETS != 0 ? 0 : ASSET_CACHE_BUDGET_BYTES);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Asset cache unavailable, serving from %s: %s", storage_name(), esp_err_to_name(ret));
     }
+    web_assets_scan_overrides(SPIFFS_BASE_PATH);
+}
 
-    char filepath[512];  // Increased buffer size
-    const char *uri = req->uri;
+/**
+ * @brief Serve the web UI from the spare slot a verified filesystem image was just written to
+ *
+ * Runs on the httpd task, so no asset request is in flight while the
+ * slots change over; the ones that arrive meanwhile wait in the socket.
+ * The new slot is mounted before the NVS pointer moves, and the old one
+ * goes back if it does not mount, so the portal is never left without a
+ * filesystem.
+ */
+static esp_err_t switch_asset_slot(void) {
+    const char *old_label = storage_active_label();
+    const char *new_label = storage_spare_label();
+    if (new_label == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
 
-    // Handle root path - serve index.html
-    if (strcmp(uri, "/") == 0) {
-        uri = "/index.html";
-        ESP_LOGI(TAG, "Root request, serving index.html");
+    int64_t start_us = esp_timer_get_time();
+    spiffs_wait_ready();
+    spiffs_mounted = false;
+    asset_cache_deinit();
+    if (storage_mounted()) {
+        storage_unmount();
     }
 
-    // Build full file path with proper bounds checking
-    size_t base_path_len = strlen(SPIFFS_BASE_PATH);
-    size_t uri_len = strlen(uri);
-    
-    if (base_path_len + uri_len + 1 >= sizeof(filepath)) {
-        ESP_LOGW(TAG, "URI too long: %s", uri);
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "URI too long");
-        return ESP_FAIL;
+    esp_err_t ret = storage_mount_partition(new_label, SPIFFS_BASE_PATH, 10, false);
+    if (ret == ESP_OK) {
+        ret = storage_set_active(new_label);
+        if (ret != ESP_OK) {
+            storage_unmount_partition(new_label);
+        }
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot switch to %s, staying on %s: %s", new_label, old_label, esp_err_to_name(ret));
+        mount_spiffs();
+        return ret;
+    }
+
+    load_assets();
+    spiffs_mounted = true;
+    ESP_LOGI(TAG, "Web assets switched from %s to %s in %lu ms", old_label, new_label,
+             (unsigned long)((esp_timer_get_time() - start_us) / 1000));
+    return ESP_OK;
+}
+
+static void spiffs_mount_task(void *arg) {
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = mount_spiffs();
+    ESP_LOGI(TAG, "%s mount finished in %lu ms: %s", storage_name(),
+             (unsigned long)((esp_timer_get_time() - start_us) / 1000), esp_err_to_name(ret));
+    xEventGroupSetBits(spiffs_events, SPIFFS_EVT_DONE);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Wait for the background mount to finish
+ *
+ * @return true if SPIFFS is mounted
+ */
+static bool spiffs_wait_ready(void) {
+    if (spiffs_events == NULL) {
+        return spiffs_mounted;
+    }
+    xEventGroupWaitBits(spiffs_events, SPIFFS_EVT_DONE, pdFALSE, pdFALSE,
+                        pdMS_TO_TICKS(WEB_SERVER_SPIFFS_WAIT_MS));
+    return spiffs_mounted;
+}
+
+esp_err_t web_server_init_spiffs(void) {
+    if (spiffs_events != NULL) {
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "Mounting %s in the background...", storage_name());
+
+    // A mount after an unclean shutdown can take seconds; nothing at boot needs the files
+    spiffs_events = xEventGroupCreateStatic(&spiffs_events_buf);
+    if (xTaskCreatePinnedToCore(spiffs_mount_task, WEB_SERVER_SPIFFS_TASK_NAME, WEB_SERVER_SPIFFS_TASK_STACK_SIZE,
+                                NULL, WEB_SERVER_SPIFFS_TASK_PRIORITY, NULL, TASK_CORE_NET) != pdPASS) {
+        ESP_LOGW(TAG, "Mount task unavailable, mounting %s inline", storage_name());
+        esp_err_t ret = mount_spiffs();
+        xEventGroupSetBits(spiffs_events, SPIFFS_EVT_DONE);
+        return ret;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Set the headers shared by cached and filesystem asset responses
+ *
+ * Asset names carry no version, so HTML, styles.css and scripts.js are
+ * "no-cache": a UI update shows up on the next load, and an unchanged file
+ * costs a 304 on its ETag. Everything else (the favicon) is kept for
+ * WEB_ASSET_MAX_AGE_STR seconds.
+ */
+static void set_asset_headers(httpd_req_t *req, const char *mime_type, bool gzip_encoded, const char *etag) {
+    httpd_resp_set_type(req, mime_type);
+    if (gzip_encoded) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    }
+    // Caches must key on Accept-Encoding since the body depends on it
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    if (etag != NULL) {
+        httpd_resp_set_hdr(req, "ETag", etag);
+    }
+    if (strcmp(mime_type, "text/html") == 0 || strcmp(mime_type, "text/css") == 0 ||
+        strcmp(mime_type, "application/javascript") == 0) {
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    } else {
+        httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=" WEB_ASSET_MAX_AGE_STR);
+    }
+}
+
+/**
+ * @brief Check whether the client's If-None-Match header names our ETag
+ */
+static bool etag_matches(httpd_req_t *req, const char *etag) {
+    if (etag == NULL) {
+        return false;
+    }
+    char if_none_match[96];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) != ESP_OK) {
+        return false;
+    }
+    return strcmp(if_none_match, "*") == 0 || strstr(if_none_match, etag) != NULL;
+}
+
+/**
+ * @brief Answer a conditional request whose cached copy is still current
+ */
+static esp_err_t send_not_modified(httpd_req_t *req, const char *mime_type, bool gzip_encoded, const char *etag) {
+    set_asset_headers(req, mime_type, gzip_encoded, etag);
+    httpd_resp_set_status(req, "304 Not Modified");
+    ESP_LOGD(TAG, "Not modified: %s", req->uri);
+    return httpd_resp_send(req, NULL, 0);
+}
+
+/**
+ * @brief Send an asset held in the RAM cache as a single Content-Length response
+ */
+static esp_err_t send_cached_asset(httpd_req_t *req, const asset_cache_entry_t *entry,
+                                   const char *mime_type, bool gzip_encoded) {
+    if (etag_matches(req, entry->etag)) {
+        return send_not_modified(req, mime_type, gzip_encoded, entry->etag);
+    }
+    set_asset_headers(req, mime_type, gzip_encoded, entry->etag);
+    ESP_LOGD(TAG, "Serving %s from cache (%zu bytes%s)", req->uri, entry->size, gzip_encoded ? ", gzip" : "");
+    return httpd_resp_send(req, (const char *)entry->data, entry->size);
+}
+
+/**
+ * @brief Send an asset built into the app image, straight from flash-mapped rodata
+ */
+static esp_err_t send_embedded_asset(httpd_req_t *req, const web_asset_t *asset, const char *mime_type) {
+    asset_cache_entry_t entry = {
+        .data = web_assets_data(asset),
+        .size = asset->size,
+        .etag = asset->etag,
+    };
+    web_assets_record_served();
+    return send_cached_asset(req, &entry, mime_type, asset->gzip);
+}
+
+static esp_err_t file_get_handler(httpd_req_t *req) {
+    PIPELINE_TRACE_BEGIN(PIPELINE_TRACE_FILE_SERVE);
+    esp_err_t ret = serve_file(req);
+    PIPELINE_TRACE_END(PIPELINE_TRACE_FILE_SERVE);
+    return ret;
+}
+
+/**
+ * @brief Serve one web asset: built in, from the RAM cache, or from the filesystem
+ */
+static esp_err_t serve_file(httpd_req_t *req) {
+    ESP_LOGD(TAG, "File request: %s", req->uri);
+
+    // Path and content type come from the generated routing table
+    const web_route_t *route = web_route_find(req->uri);
+    if (route == NULL || route->kind != WEB_ROUTE_ASSET) {
+        ESP_LOGW_RATE(unknown_uri_log, TAG, "No asset route for %s - redirecting to index", req->uri);
+        httpd_resp_set_status(req, "302 Found");
+        httpd_resp_set_hdr(req, "Location", PORTAL_URL);
+        httpd_resp_send(req, NULL, 0);
+        return ESP_OK;
     }
 
-    int written = snprintf(filepath, sizeof(filepath), "%s%s", SPIFFS_BASE_PATH, uri);
+    char filepath[128];
+    size_t base_path_len = strlen(SPIFFS_BASE_PATH);
+    int written = snprintf(filepath, sizeof(filepath), "%s%s", SPIFFS_BASE_PATH, route->path);
     if (written >= (int)sizeof(filepath) || written < 0) {
-        ESP_LOGW(TAG, "Path construction failed for URI: %s", uri);
+        ESP_LOGW(TAG, "Path construction failed for URI: %s", req->uri);
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid URI");
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "Full file path: %s", filepath);
+    ESP_LOGD(TAG, "Full file path: %s", filepath);
 
-    // Check if file exists
+    // Content type always follows the original asset, not the .gz variant
+    const char *mime_type = route->mime_type;
+    const char *cache_path = filepath + base_path_len;  // Path relative to the mount point
+    bool accepts_gzip = http_gzip_accepted(req) && written + 3 < (int)sizeof(filepath);
+
+    // Assets built into the image need no filesystem, unless it holds a different copy
+    const web_asset_t *embedded = web_assets_find(route->path);
+    if (embedded != NULL && (accepts_gzip || !embedded->gzip)) {
+        return send_embedded_asset(req, embedded, mime_type);
+    }
+
+    // Both the asset cache and the files appear once the background mount is done
+    if (!spiffs_wait_ready()) {
+        if (embedded != NULL) {
+            return send_embedded_asset(req, embedded, mime_type);  // Gzip regardless; every browser decodes it
+        }
+        ESP_LOGW_RATE(unknown_uri_log, TAG, "%s not mounted - cannot serve %s", storage_name(), req->uri);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        httpd_resp_send(req, NULL, 0);
+        return ESP_OK;
+    }
+
+    // Serve straight from RAM when the asset is cached, preferring the gzip variant
+    asset_cache_entry_t cached;
+    if (accepts_gzip) {
+        strcat(filepath, ".gz");
+        if (asset_cache_lookup(cache_path, &cached)) {
+            return send_cached_asset(req, &cached, mime_type, true);
+        }
+        filepath[written] = '\0';
+    }
+    if (asset_cache_lookup(cache_path, &cached)) {
+        return send_cached_asset(req, &cached, mime_type, false);
+    }
+    asset_cache_record_miss();
+
+    // Prefer the pre-compressed copy staged by scripts/build_web_assets.py
     struct stat st;
-    if (stat(filepath, &st) != 0) {
+    bool gzip_encoded = false;
+    if (accepts_gzip) {
+        strcat(filepath, ".gz");
+        if (stat(filepath, &st) == 0) {
+            gzip_encoded = true;
+        } else {
+            filepath[written] = '\0';  // No compressed copy, fall back to the plain file
+        }
+    }
+
+    // Check if file exists
+    if (!gzip_encoded && stat(filepath, &st) != 0) {
+        if (embedded != NULL) {
+            return send_embedded_asset(req, embedded, mime_type);
+        }
         ESP_LOGW(TAG, "File not found: %s (errno: %d)", filepath, errno);
         // Redirect to captive portal for missing files
         httpd_resp_set_status(req, "302 Found");
-        httpd_resp_set_hdr(req, "Location", "http://192.168.4.1/");
+        httpd_resp_set_hdr(req, "Location", PORTAL_URL);
         httpd_resp_send(req, NULL, 0);
         return ESP_OK;
     }
 
-    ESP_LOGI(TAG, "File exists, size: %ld bytes", st.st_size);
+    ESP_LOGD(TAG, "File exists, size: %ld bytes%s", st.st_size, gzip_encoded ? " (gzip)" : "");
+
+    const char *etag = asset_cache_get_etag(cache_path);
+    if (etag_matches(req, etag)) {
+        return send_not_modified(req, mime_type, gzip_encoded, etag);
+    }
 
     // Open file
     FILE *fd = fopen(filepath, "r");
@@ -160,26 +493,9 @@ static esp_err_t file_get_handler(httpd_req_t *req) {
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "File opened successfully");
+    ESP_LOGD(TAG, "File opened successfully");
 
-    // Set content type based on file extension
-    const char *mime_type = "text/plain";
-    if (strstr(filepath, ".html")) {
-        mime_type = "text/html";
-        ESP_LOGI(TAG, "Serving HTML file");
-    } else if (strstr(filepath, ".css")) {
-        mime_type = "text/css";
-        ESP_LOGI(TAG, "Serving CSS file");
-    } else if (strstr(filepath, ".js")) {
-        mime_type = "application/javascript";
-        ESP_LOGI(TAG, "Serving JavaScript file");
-    } else if (strstr(filepath, ".ico")) {
-        mime_type = "image/x-icon";
-        ESP_LOGI(TAG, "Serving icon file");
-    }
-
-    httpd_resp_set_type(req, mime_type);
-    ESP_LOGI(TAG, "Set content type: %s", mime_type);
+    set_asset_headers(req, mime_type, gzip_encoded, etag);
 
     // Read and send file in chunks
     char buffer[1024];
@@ -198,7 +514,7 @@ static esp_err_t file_get_handler(httpd_req_t *req) {
 
     fclose(fd);
     httpd_resp_sendstr_chunk(req, NULL);  // End chunked response
-    ESP_LOGI(TAG, "File sent successfully, total bytes: %zu", total_sent);
+    ESP_LOGD(TAG, "File sent successfully, total bytes: %zu", total_sent);
     return ESP_OK;
 }
 
@@ -208,9 +524,8 @@ static esp_err_t file_get_handler(httpd_req_t *req) {
  * Returns JSON status information
  */
 static esp_err_t ota_api_get_handler(httpd_req_t *req) {
-    ESP_LOGI(TAG, "OTA GET request: %s", req->uri);
+    ESP_LOGD(TAG, "OTA GET request: %s", req->uri);
 
-    // Return JSON status (backup functionality removed)
     ota_status_t status;
     if (ota_get_status(&status) != ESP_OK) {
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to get status");
@@ -224,205 +539,172 @@ static esp_err_t ota_api_get_handler(httpd_req_t *req) {
         partition_name = running_partition->label;
     }
 
-    char resp[512];
-    snprintf(resp, sizeof(resp),
-             "{\"state\":%d,\"type\":%d,\"progress\":%d,\"backup_available\":%s,\"backup_created\":%s,\"backup_skipped\":%s,\"current_partition\":\"%s\",\"error\":\"%s\"}",
-             status.state, status.type, status.progress_percent,
-             status.backup_available ? "true" : "false",
-             status.backup_created ? "true" : "false",
-             status.backup_skipped ? "true" : "false",
-             partition_name,
-             status.error_message);
-
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, resp, strlen(resp));
-    return ESP_OK;
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    json_obj_begin(&w);
+    ota_write_status_json(&w, &status);
+    json_kv_bool(&w, "backup_available", ota_is_backup_available(OTA_TYPE_FIRMWARE));
+    json_kv_bool(&w, "backup_created", status.backup_created);
+    json_kv_bool(&w, "backup_skipped", status.backup_skipped);
+    json_kv_str(&w, "current_partition", partition_name);
+    json_obj_end(&w);
+    return json_writer_finish(&w);
 }
 
 /**
- * @brief Handle POST /api/ota
- * Accepts multipart/form-data with fields: type, hash, file
+ * @brief Handle GET /api/ota/backup[?type=filesystem]: the running image, sent straight from flash
+ *
+ * The partition is mapped OTA_BACKUP_MAP_BYTES at a time and each chunk is
+ * sent from the mapping, so nothing is copied before lwIP takes it. The
+ * SHA-256 of what was sent follows the last chunk as the X-Image-SHA256
+ * trailer, ready for the hash field of the upload that restores it. A
+ * filesystem backup is read while the filesystem stays mounted; a file
+ * written meanwhile may be caught half-way.
  */
-static esp_err_t ota_api_post_handler(httpd_req_t *req) {
-    ESP_LOGI(TAG, "OTA POST upload received");
-
-    int total = req->content_len;
-    if (total <= 0) {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Empty upload");
-        return ESP_FAIL;
-    }
-
-    const int MAX_UPLOAD = 4 * 1024 * 1024; // 4MB
-    if (total > MAX_UPLOAD) {
-        httpd_resp_send_err(req, HTTPD_413_CONTENT_TOO_LARGE, "Upload too large");
-        return ESP_FAIL;
-    }
-
-    // Use a larger buffer for better multipart parsing
-    const int HEADER_BUF_SIZE = 4096;
-    char *header_buf = malloc(HEADER_BUF_SIZE);
-    if (!header_buf) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+static esp_err_t ota_backup_get_handler(httpd_req_t *req) {
+    char query[48];
+    char param[16];
+    ota_type_t type = OTA_TYPE_FIRMWARE;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "type", param, sizeof(param)) == ESP_OK && strcmp(param, "filesystem") == 0) {
+        type = OTA_TYPE_FILESYSTEM;
+    }
+
+    const esp_partition_t *partition;
+    size_t size;
+    if (ota_create_backup(type) != ESP_OK || ota_get_backup_extent(type, &partition, &size) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No image to back up");
         return ESP_FAIL;
     }
 
-    // Read enough data to parse the multipart headers
-    int received = 0;
-    int header_read = 0;
-    while (header_read < HEADER_BUF_SIZE - 1 && received < total) {
-        int to_read = (HEADER_BUF_SIZE - 1 - header_read > total - received) ? 
-                      total - received : HEADER_BUF_SIZE - 1 - header_read;
-        int r = httpd_req_recv(req, header_buf + header_read, to_read);
-        if (r <= 0) {
-            free(header_buf);
-            httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, "Receive error");
-            return ESP_FAIL;
-        }
-        header_read += r;
-        received += r;
-        
-        // Check if we have found the file data start
-        header_buf[header_read] = '\0';
-        if (strstr(header_buf, "filename=\"") && strstr(header_buf, "\r\n\r\n")) {
+    char header[64];
+    httpd_resp_set_type(req, "application/octet-stream");
+    snprintf(header, sizeof(header), "attachment; filename=\"%s.bin\"", partition->label);
+    httpd_resp_set_hdr(req, "Content-Disposition", header);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    httpd_resp_set_hdr(req, "Trailer", "X-Image-SHA256");
+
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+    for (size_t offset = 0; offset < size && ret == ESP_OK; offset += OTA_BACKUP_MAP_BYTES) {
+        size_t window = size - offset < OTA_BACKUP_MAP_BYTES ? size - offset : OTA_BACKUP_MAP_BYTES;
+        const void *mapped;
+        esp_partition_mmap_handle_t handle;
+        ret = esp_partition_mmap(partition, offset, window, ESP_PARTITION_MMAP_DATA, &mapped, &handle);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Cannot map %s at %zu: %s", partition->label, offset, esp_err_to_name(ret));
             break;
         }
-    }
-
-    ESP_LOGI(TAG, "Read %d bytes for header parsing", header_read);
-
-    // Parse configuration from headers
-    ota_config_t cfg = {0};
-    cfg.create_backup = false; // Always skip backup (functionality removed)
-    cfg.verify_crypto = false; // Disable crypto for streaming
-    cfg.expected_hash[0] = '\0';
-    cfg.update_type = OTA_TYPE_FIRMWARE;
-
-    // Extract 'type' field
-    char* tptr = strstr(header_buf, "name=\"type\"");
-    if (tptr) {
-        char *val = strstr(tptr, "\r\n\r\n");
-        if (val && val < header_buf + header_read) {
-            val += 4;
-            char *end = strstr(val, "\r\n");
-            if (end && end < header_buf + header_read) {
-                char v[32];
-                int len = end - val;
-                if (len > 0 && len < (int)sizeof(v)) {
-                    memcpy(v, val, len);
-                    v[len] = '\0';
-                    if (strcmp(v, "filesystem") == 0) cfg.update_type = OTA_TYPE_FILESYSTEM;
-                }
-            }
+        for (size_t sent = 0; sent < window && ret == ESP_OK; sent += OTA_BACKUP_SEND_BYTES) {
+            size_t n = window - sent < OTA_BACKUP_SEND_BYTES ? window - sent : OTA_BACKUP_SEND_BYTES;
+            const uint8_t *chunk = (const uint8_t *)mapped + sent;
+            mbedtls_sha256_update(&sha, chunk, n);
+            ret = httpd_resp_send_chunk(req, (const char *)chunk, (ssize_t)n);
         }
+        esp_partition_munmap(handle);
     }
 
-    // skipBackup processing removed - backup is always disabled
-
-    // Find start of file data by looking for the filename field
-    char *filename_start = strstr(header_buf, "filename=\"");
-    if (!filename_start) {
-        free(header_buf);
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No file in upload");
-        return ESP_FAIL;
+    uint8_t digest[OTA_HASH_LEN];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Backup of %s abandoned: %s", partition->label, esp_err_to_name(ret));
+        return ESP_FAIL;                        // Closes the socket; the client sees a truncated body
     }
 
-    // Find the actual file data start after the filename section
-    char *file_data_start = strstr(filename_start, "\r\n\r\n");
-    if (!file_data_start) {
-        free(header_buf);
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed upload");
+    // The last chunk by hand: httpd_resp_send_chunk(req, NULL, 0) cannot carry a trailer
+    char hex[OTA_HASH_STR_LEN];
+    for (int i = 0; i < OTA_HASH_LEN; i++) {
+        snprintf(hex + i * 2, sizeof(hex) - i * 2, "%02x", digest[i]);
+    }
+    char trailer[OTA_HASH_STR_LEN + 32];
+    int len = snprintf(trailer, sizeof(trailer), "0\r\nX-Image-SHA256: %s\r\n\r\n", hex);
+    if (httpd_send(req, trailer, len) != len) {
         return ESP_FAIL;
     }
-    file_data_start += 4; // Skip past \r\n\r\n
-
-    // Calculate how much file data is in the header buffer
-    int header_size = file_data_start - header_buf;
-    int first_data_size = header_read - header_size;
+    ESP_LOGI(TAG, "Backup of %s: %zu bytes in %lu ms, SHA-256 %s", partition->label, size,
+             (unsigned long)((esp_timer_get_time() - start_us) / 1000), hex);
+    return ESP_OK;
+}
 
-    ESP_LOGI(TAG, "Header size: %d, First data chunk: %d bytes", header_size, first_data_size);
+/**
+ * @brief The upload's file part opens: start the update with the form's settings
+ */
+static esp_err_t ota_sink_begin(void *ctx, const web_ota_form_t *form, const char *filename) {
+    ota_config_t *cfg = (ota_config_t *)ctx;
+
+    cfg->update_type = form->filesystem ? OTA_TYPE_FILESYSTEM : OTA_TYPE_FIRMWARE;
+    cfg->for_nodes = form->for_nodes;
+    if (form->zlib) {
+        cfg->encoding = OTA_ENCODING_ZLIB;
+    }
+    strlcpy(cfg->expected_hash, form->hash, sizeof(cfg->expected_hash));
+    ESP_LOGI(TAG, "Receiving %s image '%s'", cfg->for_nodes ? "node firmware" :
+             cfg->update_type == OTA_TYPE_FILESYSTEM ? "filesystem" : "firmware", filename);
+    ota_resume_abort();  // This upload overwrites whatever a chunked session had written
+    spiffs_wait_ready();  // A single-slot filesystem update unmounts SPIFFS; the mount must not land afterwards
+    return ota_start_update(cfg);
+}
 
-    // Start OTA update
-    // Backup preference setting removed
-    esp_err_t ret = ota_start_update(&cfg);
+/**
+ * @brief File data goes straight from the receive buffer to the OTA writer
+ */
+static esp_err_t ota_sink_write(void *ctx, const uint8_t *data, size_t len) {
+    esp_err_t ret = ota_process_chunk(data, len);
     if (ret != ESP_OK) {
-        free(header_buf);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA start failed");
-        return ESP_FAIL;
+        ESP_LOGE(TAG, "Failed to process data chunk");
     }
+    return ret;
+}
 
-    // Process first chunk of file data if any
-    if (first_data_size > 0) {
-        ESP_LOGI(TAG, "Processing first chunk: %d bytes", first_data_size);
-        ret = ota_process_chunk((const uint8_t*)file_data_start, first_data_size);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to process first chunk");
-            ota_auto_rollback();
-            free(header_buf);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA write failed");
-            return ESP_FAIL;
-        }
-    }
+static void ota_sink_abort(void *ctx) {
+    ota_auto_rollback();
+}
+
+/**
+ * @brief Handle POST /api/ota
+ *
+ * Accepts multipart/form-data with fields: type, target, encoding, hash, file (web_ota_receive()).
+ * The expected SHA-256 comes from the hash field or an X-Image-SHA256 header; one that is not
+ * 64 hex digits is answered 400 before any flash is touched.
+ */
+static esp_err_t ota_api_post_handler(httpd_req_t *req) {
+    ESP_LOGI(TAG, "OTA POST upload received");
 
-    // Now stream remaining data
-    const int CHUNK_SIZE = 2048;
-    char *data_buf = malloc(CHUNK_SIZE);
-    if (!data_buf) {
-        ota_auto_rollback();
-        free(header_buf);
+    ota_config_t cfg = {0};
+    cfg.create_backup = false; // Nothing is copied on upload; see ota_backup_get_handler
+    cfg.verify_crypto = true;  // Hashed on the OTA writer task by the SHA peripheral
+    cfg.update_type = OTA_TYPE_FIRMWARE;
+    cfg.total_size = req->content_len;  // Includes the multipart framing; close enough for an ETA
+
+    // One receive buffer from the request arena; file data is written from it in place
+    uint8_t *recv_buf = http_arena_alloc(req, OTA_CHUNK_SIZE);
+    if (!recv_buf) {
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
         return ESP_FAIL;
     }
 
-    // Calculate remaining bytes to process
-    int remaining = total - received;
-    ESP_LOGI(TAG, "Streaming remaining %d bytes", remaining);
-
-    while (remaining > 0) {
-        int to_recv = (remaining > CHUNK_SIZE) ? CHUNK_SIZE : remaining;
-        int r = httpd_req_recv(req, data_buf, to_recv);
-        if (r <= 0) {
-            ESP_LOGE(TAG, "Receive error while streaming");
-            ota_auto_rollback();
-            free(data_buf);
-            free(header_buf);
-            httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, "Receive error");
-            return ESP_FAIL;
-        }
-        received += r;
-        remaining -= r;
-
-        // Process this chunk, but check for boundary at the end
-        int process_size = r;
-        if (remaining == 0) {
-            // Last chunk - look for boundary to exclude it
-            for (int i = 0; i < r - 5; i++) {
-                if (data_buf[i] == '\r' && data_buf[i+1] == '\n' && 
-                    data_buf[i+2] == '-' && data_buf[i+3] == '-') {
-                    process_size = i;
-                    break;
-                }
-            }
-        }
-
-        if (process_size > 0) {
-            ret = ota_process_chunk((const uint8_t*)data_buf, process_size);
-            if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to process data chunk");
-                ota_auto_rollback();
-                free(data_buf);
-                free(header_buf);
-                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA write failed");
-                return ESP_FAIL;
-            }
-        }
+    static const web_ota_sink_t sink = {
+        .begin = ota_sink_begin,
+        .write = ota_sink_write,
+        .abort = ota_sink_abort
+    };
+    http_io_t io;
+    web_ota_form_t form;
+    http_io_init_httpd(&io, req);
+    esp_err_t ret = web_ota_receive(&io, &sink, &cfg, recv_buf, OTA_CHUNK_SIZE, &form);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "OTA upload failed: %s", esp_err_to_name(ret));
+        return ESP_FAIL;
     }
 
     // Finalize OTA update
     ESP_LOGI(TAG, "Finalizing OTA update");
     ret = ota_finalize_update();
-    
-    free(data_buf);
-    free(header_buf);
 
     if (ret == ESP_OK) {
         // Get final status to check if reboot is required
@@ -436,22 +718,46 @@ static esp_err_t ota_api_post_handler(httpd_req_t *req) {
             const char* update_type = (status.type == OTA_TYPE_FILESYSTEM) ? "Filesystem" : "Firmware";
             char response[256];
             snprintf(response, sizeof(response), 
-                "{\"status\":\"ok\",\"reboot\":true,\"message\":\"%s updated, rebooting in 3 seconds\"}", 
-                update_type);
+                "{\"status\":\"ok\",\"reboot\":true,\"sha256\":\"%s\",\"message\":\"%s updated, rebooting in 3 seconds\"}", 
+                status.computed_hash, update_type);
             httpd_resp_send(req, response, -1);
             ESP_LOGI(TAG, "OTA %s update completed - scheduling reboot task", update_type);
             
             // Create a task to handle the delayed reboot
-            BaseType_t result = xTaskCreate(reboot_task, "reboot_task", 2048, NULL, 5, NULL);
+            BaseType_t result = xTaskCreatePinnedToCore(reboot_task, WEB_SERVER_REBOOT_TASK_NAME,
+                                                        WEB_SERVER_REBOOT_TASK_STACK_SIZE, NULL,
+                                                        WEB_SERVER_REBOOT_TASK_PRIORITY, NULL, TASK_CORE_NET);
             if (result != pdPASS) {
                 ESP_LOGE(TAG, "Failed to create reboot task, rebooting immediately");
                 esp_restart();
             }
+        } else if (status.type == OTA_TYPE_FILESYSTEM) {
+            // Written to the spare slot: switch to it now, no reboot
+            if (switch_asset_slot() != ESP_OK) {
+                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "New filesystem did not mount");
+                return ESP_FAIL;
+            }
+            char response[256];
+            snprintf(response, sizeof(response),
+                "{\"status\":\"ok\",\"reboot\":false,\"sha256\":\"%s\",\"message\":\"Web assets updated, "
+                "reload the page\"}", status.computed_hash);
+            httpd_resp_send(req, response, -1);
+        } else if (cfg.for_nodes) {
+            // Served to the nodes over ESP-NOW once the board runs as the gateway
+            char response[256];
+            snprintf(response, sizeof(response),
+                "{\"status\":\"ok\",\"reboot\":false,\"sha256\":\"%s\",\"message\":\"Node firmware staged; "
+                "the gateway sends it to the nodes\"}", status.computed_hash);
+            httpd_resp_send(req, response, -1);
+            ESP_LOGI(TAG, "Node firmware staged");
         } else {
             // This shouldn't happen anymore, but keep as fallback
             httpd_resp_send(req, "{\"status\":\"ok\",\"message\":\"Update completed successfully\"}", -1);
             ESP_LOGI(TAG, "OTA update completed successfully (no reboot required)");
         }
+    } else if (ret == ESP_ERR_INVALID_CRC) {
+        ESP_LOGE(TAG, "OTA image rejected: SHA-256 mismatch");
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Image hash mismatch");
     } else {
         ESP_LOGE(TAG, "OTA finalize failed: %s", esp_err_to_name(ret));
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA finalize failed");
@@ -460,603 +766,408 @@ static esp_err_t ota_api_post_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-static esp_err_t save_config_handler(httpd_req_t *req) {
-    int remaining = req->content_len;
-    if (remaining <= 0) {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Empty content");
+/**
+ * @brief Handle GET /api/ota/chunk: where a resumable upload stands
+ */
+static esp_err_t ota_chunk_get_handler(httpd_req_t *req) {
+    ota_resume_info_t info;
+    ota_resume_get_info(&info);
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    json_obj_begin(&w);
+    json_kv_bool(&w, "active", info.active);
+    json_kv_str(&w, "type", info.type == OTA_TYPE_FILESYSTEM ? "filesystem" : "firmware");
+    json_kv_uint(&w, "size", info.image_size);
+    json_kv_uint(&w, "chunk_size", info.chunk_size);
+    json_kv_uint(&w, "chunks_total", info.chunks_total);
+    json_kv_uint(&w, "chunks_done", info.chunks_done);
+    json_kv_uint(&w, "next_offset", info.next_offset);
+    json_kv_str(&w, "sha256", info.expected_hash);
+    json_obj_end(&w);
+    return json_writer_finish(&w);
+}
+
+/**
+ * @brief Handle PUT /api/ota/chunk?offset=N&size=TOTAL[&type=filesystem][&sha256=HEX]
+ *
+ * The body is one whole chunk. Progress survives dropped connections and
+ * reboots; the client resumes from next_offset. The last chunk verifies the
+ * image, activates it and schedules a reboot.
+ */
+static esp_err_t ota_chunk_put_handler(httpd_req_t *req) {
+    char query[192];
+    char param[OTA_HASH_STR_LEN + 1];           // One spare byte so an overlong hash is caught
+    char hash[OTA_HASH_STR_LEN] = "";
+    ota_type_t type = OTA_TYPE_FIRMWARE;
+    char *end;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "offset", param, sizeof(param)) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing offset");
         return ESP_FAIL;
     }
-
-    // Cap incoming content to a reasonable size to avoid OOM
-    const size_t MAX_CONTENT = 4096;
-    size_t to_alloc = (size_t)remaining + 1;
-    if (to_alloc > MAX_CONTENT) {
-        to_alloc = MAX_CONTENT;
+    uint32_t offset = (uint32_t)strtoul(param, &end, 10);
+    if (param[0] == '\0' || *end != '\0') {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid offset");
+        return ESP_FAIL;
     }
-
-    char *content = (char *)malloc(to_alloc);
-    if (!content) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    if (httpd_query_key_value(query, "size", param, sizeof(param)) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing size");
         return ESP_FAIL;
     }
-
-    size_t received = 0;
-    while (remaining > 0 && received < to_alloc - 1) {
-        int chunk = remaining > 1024 ? 1024 : remaining;
-        int ret = httpd_req_recv(req, content + received, chunk);
-        if (ret <= 0) {
-            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-                httpd_resp_send_408(req);
-            }
-            free(content);
+    uint32_t image_size = (uint32_t)strtoul(param, &end, 10);
+    if (param[0] == '\0' || *end != '\0') {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid size");
+        return ESP_FAIL;
+    }
+    if (httpd_query_key_value(query, "type", param, sizeof(param)) == ESP_OK &&
+        strcmp(param, "filesystem") == 0) {
+        type = OTA_TYPE_FILESYSTEM;
+    }
+    if (httpd_query_key_value(query, "sha256", param, sizeof(param)) == ESP_OK && param[0] != '\0') {
+        if (!web_ota_hash_valid(param)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid image hash");
             return ESP_FAIL;
         }
-        received += ret;
-        remaining -= ret;
+        strlcpy(hash, param, sizeof(hash));
     }
 
-    // Null-terminate
-    content[received] = '\0';
-
-    ESP_LOGI(TAG, "Received config data: %s", content);
-
-    // Parse JSON-like data (simple string parsing)
-    char mac_address[MAC_ADDR_STR_LEN] = "";
-    char ip_address[IP_ADDR_STR_LEN] = "";
-    char password[WIFI_PASS_MAX_LEN] = "";
-    char active_key[33] = "";     // 32 hex chars + null terminator
-    char pending_key[33] = "";
-    uint32_t boot_count = 0;
-    uint8_t device_role = DEVICE_ROLE_RESPONDER;
-
-    // Extract macAddress
-    char *mac_start = strstr(content, "\"macAddress\":\"");
-    if (mac_start) {
-        mac_start += 14;
-        char *mac_end = strchr(mac_start, '"');
-        if (mac_end && (mac_end - mac_start) < sizeof(mac_address)) {
-            strncpy(mac_address, mac_start, mac_end - mac_start);
-            mac_address[mac_end - mac_start] = '\0';
-        }
+    ota_status_t status;
+    ota_get_status(&status);
+    if (status.state == OTA_STATE_UPLOADING) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "Streaming upload in progress");
+        return ESP_FAIL;
     }
 
-    // Extract ipAddress
-    char *ip_start = strstr(content, "\"ipAddress\":\"");
-    if (ip_start) {
-        ip_start += 13;
-        char *ip_end = strchr(ip_start, '"');
-        if (ip_end && (ip_end - ip_start) < sizeof(ip_address)) {
-            strncpy(ip_address, ip_start, ip_end - ip_start);
-            ip_address[ip_end - ip_start] = '\0';
-        }
+    // Only the first chunk may replace a different session
+    spiffs_wait_ready();
+    esp_err_t ret = ota_resume_begin(type, image_size, hash, offset == 0);
+    if (ret == ESP_ERR_INVALID_STATE) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "A different chunked upload is in progress");
+        return ESP_FAIL;
     }
-
-    // Extract password
-    char *pass_start = strstr(content, "\"password\":\"");
-    if (pass_start) {
-        pass_start += 12;
-        char *pass_end = strchr(pass_start, '"');
-        if (pass_end && (pass_end - pass_start) < sizeof(password)) {
-            strncpy(password, pass_start, pass_end - pass_start);
-            password[pass_end - pass_start] = '\0';
-        }
+    if (ret == ESP_ERR_INVALID_SIZE) {
+        httpd_resp_send_err(req, HTTPD_413_CONTENT_TOO_LARGE, "Image too large for partition");
+        return ESP_FAIL;
     }
-
-    // Extract activeKey
-    char *active_start = strstr(content, "\"activeKey\":\"");
-    if (active_start) {
-        active_start += 13;
-        char *active_end = strchr(active_start, '"');
-        if (active_end && (active_end - active_start) < sizeof(active_key)) {
-            strncpy(active_key, active_start, active_end - active_start);
-            active_key[active_end - active_start] = '\0';
-        }
+    if (ret != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Upload session failed");
+        return ESP_FAIL;
     }
 
-    // Extract pendingKey
-    char *pending_start = strstr(content, "\"pendingKey\":\"");
-    if (pending_start) {
-        pending_start += 14;
-        char *pending_end = strchr(pending_start, '"');
-        if (pending_end && (pending_end - pending_start) < sizeof(pending_key)) {
-            strncpy(pending_key, pending_start, pending_end - pending_start);
-            pending_key[pending_end - pending_start] = '\0';
-        }
+    if (offset % OTA_RESUME_CHUNK_SIZE != 0 || offset >= image_size) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Offset not on a chunk boundary");
+        return ESP_FAIL;
     }
-
-    // Extract bootCount
-    char *boot_start = strstr(content, "\"bootCount\":");
-    if (boot_start) {
-        boot_start += 12;
-        char *boot_end = strpbrk(boot_start, ",}");
-        if (boot_end) {
-            char boot_str[32];
-            int len = boot_end - boot_start;
-            if (len < sizeof(boot_str)) {
-                strncpy(boot_str, boot_start, len);
-                boot_str[len] = '\0';
-                boot_count = (uint32_t)atol(boot_str);
-            }
-        }
+    size_t len = image_size - offset < OTA_RESUME_CHUNK_SIZE ? image_size - offset : OTA_RESUME_CHUNK_SIZE;
+    if (req->content_len != len) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Chunk length mismatch");
+        return ESP_FAIL;
     }
 
-    // Extract deviceRole
-    char *role_start = strstr(content, "\"deviceRole\":");
-    if (role_start) {
-        role_start += 13;
-        char *role_end = strpbrk(role_start, ",}");
-        if (role_end) {
-            char role_str[8];
-            int len = role_end - role_start;
-            if (len < sizeof(role_str)) {
-                strncpy(role_str, role_start, len);
-                role_str[len] = '\0';
-                device_role = (uint8_t)atoi(role_str);
-                // Validate role value
-                if (device_role != DEVICE_ROLE_GATEWAY && device_role != DEVICE_ROLE_RESPONDER) {
-                    ESP_LOGW(TAG, "Invalid device role %d, defaulting to responder", device_role);
-                    device_role = DEVICE_ROLE_RESPONDER;
-                }
-            }
-        }
+    uint8_t *buf = http_arena_alloc(req, len);
+    if (buf == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
     }
-
-    // Extract bridge WiFi configuration
-    char bridge_ssid[BRIDGE_SSID_MAX_LEN] = "";
-    char bridge_password[BRIDGE_PASS_MAX_LEN] = "";
-    char mqtt_server_ip[MQTT_IP_MAX_LEN] = "";
-    uint16_t mqtt_port = MQTT_DEFAULT_PORT;
-    char mqtt_username[MQTT_USER_MAX_LEN] = "";
-    char mqtt_password[MQTT_PASS_MAX_LEN] = "";
-    char mqtt_client_id[MQTT_CLIENT_ID_MAX_LEN] = "";
-    uint8_t mqtt_qos = MQTT_DEFAULT_QOS;
-    char mqtt_base_topic[MQTT_BASE_TOPIC_MAX_LEN] = "";
-
-    // Extract bridgeSsid
-    char *bridge_ssid_start = strstr(content, "\"bridgeSsid\":\"");
-    if (bridge_ssid_start) {
-        bridge_ssid_start += 14;
-        char *bridge_ssid_end = strchr(bridge_ssid_start, '"');
-        if (bridge_ssid_end && (bridge_ssid_end - bridge_ssid_start) < sizeof(bridge_ssid)) {
-            strncpy(bridge_ssid, bridge_ssid_start, bridge_ssid_end - bridge_ssid_start);
-            bridge_ssid[bridge_ssid_end - bridge_ssid_start] = '\0';
+    size_t received = 0;
+    while (received < len) {
+        int r = httpd_req_recv(req, (char *)buf + received, len - received);
+        if (r <= 0) {
+            // Nothing was written; the client simply sends this chunk again
+            ESP_LOGW(TAG, "Chunk at %" PRIu32 " cut off after %zu bytes", offset, received);
+            httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, "Receive error");
+            return ESP_FAIL;
         }
+        received += (size_t)r;
     }
-
-    // Extract bridgePassword
-    char *bridge_pass_start = strstr(content, "\"bridgePassword\":");
-    if (bridge_pass_start) {
-        bridge_pass_start += 17; // skip "bridgePassword":
-        // skip whitespace and "
-        while (*bridge_pass_start && (*bridge_pass_start == ' ' || *bridge_pass_start == '\t' || *bridge_pass_start == '"')) bridge_pass_start++;
-        char *bridge_pass_end = strchr(bridge_pass_start, '"');
-        if (bridge_pass_end && (bridge_pass_end - bridge_pass_start) < sizeof(bridge_password)) {
-            strncpy(bridge_password, bridge_pass_start, bridge_pass_end - bridge_pass_start);
-            bridge_password[bridge_pass_end - bridge_pass_start] = '\0';
-        }
+    ret = ota_resume_write(offset, buf, len);
+    if (ret == ESP_ERR_NOT_SUPPORTED) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Filesystem image does not match the firmware's filesystem");
+        return ESP_FAIL;
     }
-
-    ESP_LOGI(TAG, "Extracted bridge password: '%s' (len=%zu)", bridge_password, strlen(bridge_password));
-
-    // Extract mqttServerIp
-    char *mqtt_ip_start = strstr(content, "\"mqttServerIp\":\"");
-    if (mqtt_ip_start) {
-        mqtt_ip_start += 16;
-        char *mqtt_ip_end = strchr(mqtt_ip_start, '"');
-        if (mqtt_ip_end && (mqtt_ip_end - mqtt_ip_start) < sizeof(mqtt_server_ip)) {
-            strncpy(mqtt_server_ip, mqtt_ip_start, mqtt_ip_end - mqtt_ip_start);
-            mqtt_server_ip[mqtt_ip_end - mqtt_ip_start] = '\0';
-        }
+    if (ret != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Chunk write failed");
+        return ESP_FAIL;
     }
 
-    // Extract mqttPort
-    char *mqtt_port_start = strstr(content, "\"mqttPort\":");
-    if (mqtt_port_start) {
-        mqtt_port_start += 11;
-        char *mqtt_port_end = strpbrk(mqtt_port_start, ",}");
-        if (mqtt_port_end) {
-            char mqtt_port_str[8];
-            int len = mqtt_port_end - mqtt_port_start;
-            if (len < sizeof(mqtt_port_str)) {
-                strncpy(mqtt_port_str, mqtt_port_start, len);
-                mqtt_port_str[len] = '\0';
-                mqtt_port = (uint16_t)atoi(mqtt_port_str);
-            }
-        }
+    ota_resume_info_t info;
+    ota_resume_get_info(&info);
+    if (info.chunks_done < info.chunks_total) {
+        return ota_chunk_get_handler(req);
     }
 
-    // Extract mqttUsername
-    char *mqtt_user_start = strstr(content, "\"mqttUsername\":\"");
-    if (mqtt_user_start) {
-        mqtt_user_start += 16;
-        char *mqtt_user_end = strchr(mqtt_user_start, '"');
-        if (mqtt_user_end && (mqtt_user_end - mqtt_user_start) < sizeof(mqtt_username)) {
-            strncpy(mqtt_username, mqtt_user_start, mqtt_user_end - mqtt_user_start);
-            mqtt_username[mqtt_user_end - mqtt_user_start] = '\0';
-        }
+    char computed[OTA_HASH_STR_LEN] = "";
+    ret = ota_resume_finalize(computed);
+    if (ret == ESP_ERR_INVALID_CRC) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Image hash mismatch");
+        return ESP_FAIL;
     }
-
-    // Extract mqttPassword
-    char *mqtt_pass_start = strstr(content, "\"mqttPassword\":\"");
-    if (mqtt_pass_start) {
-        mqtt_pass_start += 16;
-        char *mqtt_pass_end = strchr(mqtt_pass_start, '"');
-        if (mqtt_pass_end && (mqtt_pass_end - mqtt_pass_start) < sizeof(mqtt_password)) {
-            strncpy(mqtt_password, mqtt_pass_start, mqtt_pass_end - mqtt_pass_start);
-            mqtt_password[mqtt_pass_end - mqtt_pass_start] = '\0';
-        }
+    if (ret != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Image verification failed");
+        return ESP_FAIL;
     }
 
-    // Extract mqttClientId
-    char *mqtt_client_start = strstr(content, "\"mqttClientId\":\"");
-    if (mqtt_client_start) {
-        mqtt_client_start += 16;
-        char *mqtt_client_end = strchr(mqtt_client_start, '"');
-        if (mqtt_client_end && (mqtt_client_end - mqtt_client_start) < sizeof(mqtt_client_id)) {
-            strncpy(mqtt_client_id, mqtt_client_start, mqtt_client_end - mqtt_client_start);
-            mqtt_client_id[mqtt_client_end - mqtt_client_start] = '\0';
-        }
-    }
-
-    // Extract mqttQos
-    char *mqtt_qos_start = strstr(content, "\"mqttQos\":");
-    if (mqtt_qos_start) {
-        mqtt_qos_start += 10;
-        char *mqtt_qos_end = strpbrk(mqtt_qos_start, ",}");
-        if (mqtt_qos_end) {
-            char mqtt_qos_str[4];
-            int len = mqtt_qos_end - mqtt_qos_start;
-            if (len < sizeof(mqtt_qos_str)) {
-                strncpy(mqtt_qos_str, mqtt_qos_start, len);
-                mqtt_qos_str[len] = '\0';
-                mqtt_qos = (uint8_t)atoi(mqtt_qos_str);
-                // Validate QoS value (0, 1, or 2)
-                if (mqtt_qos > 2) {
-                    ESP_LOGW(TAG, "Invalid MQTT QoS %d, defaulting to 0", mqtt_qos);
-                    mqtt_qos = 0;
-                }
-            }
+    char response[160];
+    if (info.type == OTA_TYPE_FILESYSTEM && storage_spare_label() != NULL) {
+        if (switch_asset_slot() != ESP_OK) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "New filesystem did not mount");
+            return ESP_FAIL;
         }
+        snprintf(response, sizeof(response), "{\"status\":\"ok\",\"complete\":true,\"reboot\":false,\"sha256\":\"%s\"}",
+                 computed);
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_sendstr(req, response);
+        return ESP_OK;
     }
-
-    // Extract mqttBaseTopic
-    char *mqtt_topic_start = strstr(content, "\"mqttBaseTopic\":\"");
-    if (mqtt_topic_start) {
-        mqtt_topic_start += 17;
-        char *mqtt_topic_end = strchr(mqtt_topic_start, '"');
-        if (mqtt_topic_end && (mqtt_topic_end - mqtt_topic_start) < sizeof(mqtt_base_topic)) {
-            strncpy(mqtt_base_topic, mqtt_topic_start, mqtt_topic_end - mqtt_topic_start);
-            mqtt_base_topic[mqtt_topic_end - mqtt_topic_start] = '\0';
-        }
+    snprintf(response, sizeof(response), "{\"status\":\"ok\",\"complete\":true,\"reboot\":true,\"sha256\":\"%s\"}",
+             computed);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, response);
+    ESP_LOGI(TAG, "Chunked %s upload complete - scheduling reboot",
+             info.type == OTA_TYPE_FILESYSTEM ? "filesystem" : "firmware");
+    if (xTaskCreatePinnedToCore(reboot_task, WEB_SERVER_REBOOT_TASK_NAME, WEB_SERVER_REBOOT_TASK_STACK_SIZE, NULL,
+                                WEB_SERVER_REBOOT_TASK_PRIORITY, NULL, TASK_CORE_NET) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create reboot task, rebooting immediately");
+        esp_restart();
     }
+    return ESP_OK;
+}
 
-    // Save to NVS
-    esp_err_t save_result = ESP_OK;
-    
-    if (strlen(mac_address) > 0) {
-        save_result = nvs_store_server_mac(mac_address);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save MAC address");
-        }
+/**
+ * @brief Handle POST /save_config: the body is parsed onto the current config (web_config_receive())
+ */
+static esp_err_t save_config_handler(httpd_req_t *req) {
+    // Start from the current configuration; the body only overrides what it names
+    web_config_body_t body = { 0 };
+    if (nvs_config_get(&body.cfg) != ESP_OK) {
+        ESP_LOGW(TAG, "Some stored config values failed to load, saving over them");
     }
 
-    if (strlen(ip_address) > 0) {
-        save_result = nvs_store_ip_address(ip_address);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save IP address");
-        }
+    http_io_t io;
+    http_io_init_httpd(&io, req);
+    esp_err_t parse_result = web_config_receive(&io, &body);
+    if (parse_result == ESP_ERR_INVALID_ARG) {
+        ESP_LOGW(TAG, "Rejected config body: %s", esp_err_to_name(body.parse_err));
+        return ESP_OK;
     }
-
-    if (strlen(password) > 0) {
-        save_result = nvs_store_wifi_password(password);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save WiFi password");
-        }
+    if (parse_result != ESP_OK) {
+        return ESP_FAIL;
     }
 
-    // Convert hex string keys to binary and save
-    if (strlen(active_key) == 32) {  // 16 bytes = 32 hex chars
-        uint8_t key_binary[ESPNOW_KEY_LEN];
-        bool valid_hex = true;
-        
-        for (int i = 0; i < ESPNOW_KEY_LEN; i++) {
-            char hex_byte[3] = {active_key[i*2], active_key[i*2+1], '\0'};
-            char *endptr;
-            key_binary[i] = strtol(hex_byte, &endptr, 16);
-            if (*endptr != '\0') {
-                valid_hex = false;
-                break;
-            }
-        }
-        
-        if (valid_hex) {
-            save_result = nvs_store_espnow_active_key(key_binary);
-            if (save_result != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to save ESP-NOW active key");
-            }
-        } else {
-            ESP_LOGE(TAG, "Invalid hex format for active key");
-        }
-    }
+    ESP_LOGI(TAG, "Parsed %lu config fields from %zu bytes",
+             (unsigned long)body.fields_set, req->content_len);
 
-    if (strlen(pending_key) == 32) {  // 16 bytes = 32 hex chars
-        uint8_t key_binary[ESPNOW_KEY_LEN];
-        bool valid_hex = true;
-        
-        for (int i = 0; i < ESPNOW_KEY_LEN; i++) {
-            char hex_byte[3] = {pending_key[i*2], pending_key[i*2+1], '\0'};
-            char *endptr;
-            key_binary[i] = strtol(hex_byte, &endptr, 16);
-            if (*endptr != '\0') {
-                valid_hex = false;
-                break;
-            }
-        }
-        
-        if (valid_hex) {
-            save_result = nvs_store_espnow_pending_key(key_binary);
-            if (save_result != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to save ESP-NOW pending key");
-            }
-        } else {
-            ESP_LOGE(TAG, "Invalid hex format for pending key");
-        }
+    // Update the cached config; the flush task commits it
+    esp_err_t save_result = nvs_config_update(&body.cfg);
+    if (save_result != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save configuration");
+    } else if (discovery_is_running()) {
+        discovery_update_telemetry();           // The advertised broker and topic follow the config
     }
 
-    // Save boot count if provided
-    if (boot_count > 0 || strstr(content, "\"bootCount\":0")) {
-        save_result = nvs_store_boot_count(boot_count);
-        if (save_result != ESP_OK) {
+    // Boot count lives in the SystemMetrics namespace, so it is saved on its own
+    if (body.have_boot_count) {
+        esp_err_t boot_result = nvs_store_boot_count(body.boot_count);
+        if (boot_result != ESP_OK) {
             ESP_LOGE(TAG, "Failed to save boot count");
+            save_result = boot_result;
         }
     }
 
-    // Save device role if provided
-    if (strstr(content, "\"deviceRole\":")) {
-        save_result = nvs_store_device_role(device_role);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save device role");
-        }
+    // Send response
+    const char *response = "{\"message\":\"Configuration saved successfully!\",\"status\":\"success\"}";
+    if (save_result != ESP_OK) {
+        response = "{\"message\":\"Failed to save configuration\",\"status\":\"error\"}";
     }
 
-    // Save bridge WiFi configuration
-    if (strlen(bridge_ssid) > 0) {
-        save_result = nvs_store_bridge_ssid(bridge_ssid);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save bridge SSID");
-        }
-    }
+    http_io_set_type(&io, "application/json");
+    http_io_send_str(&io, response);
 
-    if (strlen(bridge_password) > 0) {
-        save_result = nvs_store_bridge_password(bridge_password);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save bridge password");
-        }
-    }
+    return ESP_OK;
+}
 
-    // Save MQTT configuration
-    if (strlen(mqtt_server_ip) > 0) {
-        save_result = nvs_store_mqtt_server_ip(mqtt_server_ip);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save MQTT server IP");
-        }
-    }
+static esp_err_t get_config_handler(httpd_req_t *req) {
+    device_config_t cfg = { 0 };
+    uint32_t boot_count = 0;
 
-    if (strstr(content, "\"mqttPort\":")) {
-        save_result = nvs_store_mqtt_port(mqtt_port);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save MQTT port");
+    // A HEAD request needs no values, only the headers
+    if (req->method != HTTP_HEAD) {
+        if (nvs_config_get(&cfg) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to load some config values, using defaults for them");
         }
-    }
-
-    if (strlen(mqtt_username) > 0) {
-        save_result = nvs_store_mqtt_username(mqtt_username);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save MQTT username");
+        if (nvs_load_boot_count(&boot_count) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to load boot count");
+            boot_count = 0;
         }
     }
 
-    if (strlen(mqtt_password) > 0) {
-        save_result = nvs_store_mqtt_password(mqtt_password);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save MQTT password");
-        }
+    http_io_t io;
+    http_io_init_httpd(&io, req);
+    esp_err_t send_result = web_config_send(&io, &cfg, boot_count);
+    if (send_result != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send config: %s", esp_err_to_name(send_result));
     }
+    return send_result;
+}
 
-    if (strlen(mqtt_client_id) > 0) {
-        save_result = nvs_store_mqtt_client_id(mqtt_client_id);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save MQTT client ID");
-        }
-    }
+/**
+ * @brief GET /config_schema: the fields /get_config and /save_config carry, with their limits and defaults
+ */
+static esp_err_t get_config_schema_handler(httpd_req_t *req) {
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    config_schema_write_meta(&w);
 
-    if (strstr(content, "\"mqttQos\":")) {
-        save_result = nvs_store_mqtt_qos(mqtt_qos);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save MQTT QoS");
-        }
+    esp_err_t send_result = json_writer_finish(&w);
+    if (send_result != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send config schema: %s", esp_err_to_name(send_result));
     }
+    return send_result;
+}
 
-    if (strlen(mqtt_base_topic) > 0) {
-        save_result = nvs_store_mqtt_base_topic(mqtt_base_topic);
-        if (save_result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to save MQTT base topic");
-        }
+/**
+ * @brief The whole config as one provisioning blob: GET /api/config/export[?unit=1]
+ *
+ * Fleet fields only by default, to load onto other boards; unit=1 adds
+ * this board's calibration and node settings, for a backup of it.
+ */
+static esp_err_t config_export_handler(httpd_req_t *req) {
+    char query[16];
+    char unit_arg[4] = "";
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "unit", unit_arg, sizeof(unit_arg));
     }
 
-    // Send response
-    const char *response = "{\"message\":\"Configuration saved successfully!\",\"status\":\"success\"}";
-    if (save_result != ESP_OK) {
-        response = "{\"message\":\"Failed to save configuration\",\"status\":\"error\"}";
+    device_config_t cfg;
+    if (nvs_config_get(&cfg) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to load some config values, using defaults for them");
     }
-
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, response, strlen(response));
-
-    free(content);
-    return ESP_OK;
-}
-
-static esp_err_t get_config_handler(httpd_req_t *req) {
-    // If this is a HEAD request, respond with headers only (no body)
-    if (req->method == HTTP_HEAD) {
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, NULL, 0);
-        return ESP_OK;
+    uint8_t *buf = http_arena_alloc(req, CONFIG_SCHEMA_BLOB_MAX);
+    if (buf == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "GET config handler called");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=config.bin");
+    http_io_t io;
+    http_io_init_httpd(&io, req);
+    return web_config_export(&io, &cfg, strcmp(unit_arg, "1") == 0, buf);
+}
 
-    char mac_address[MAC_ADDR_STR_LEN] = "";
-    char ip_address[IP_ADDR_STR_LEN] = "";
-    char password[WIFI_PASS_MAX_LEN] = "";
-    uint8_t active_key[ESPNOW_KEY_LEN];
-    uint8_t pending_key[ESPNOW_KEY_LEN];
-    uint32_t boot_count = 0;
-    uint8_t device_role = DEVICE_ROLE_RESPONDER;
-    char bridge_ssid[BRIDGE_SSID_MAX_LEN] = "";
-    char bridge_password[BRIDGE_PASS_MAX_LEN] = "";
-    char mqtt_server_ip[MQTT_IP_MAX_LEN] = "";
-    uint16_t mqtt_port = MQTT_DEFAULT_PORT;
-    char mqtt_username[MQTT_USER_MAX_LEN] = "";
-    char mqtt_password[MQTT_PASS_MAX_LEN] = "";
-    char mqtt_client_id[MQTT_CLIENT_ID_MAX_LEN] = "";
-    uint8_t mqtt_qos = MQTT_DEFAULT_QOS;
-    char mqtt_base_topic[MQTT_BASE_TOPIC_MAX_LEN] = "";
-
-    // Load values from NVS with error checking
-    ESP_LOGI(TAG, "Loading NVS values...");
-    if (nvs_load_server_mac(mac_address, sizeof(mac_address)) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load server MAC");
-    }
-    ESP_LOGI(TAG, "Loaded server MAC: %s", mac_address);
-
-    if (nvs_load_ip_address(ip_address, sizeof(ip_address)) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load IP address");
-    }
-    if (nvs_load_wifi_password(password, sizeof(password)) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load WiFi password");
-    }
-    if (nvs_load_espnow_active_key(active_key) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load ESP-NOW active key");
-        memset(active_key, 0, ESPNOW_KEY_LEN);
-    }
-    if (nvs_load_espnow_pending_key(pending_key) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load ESP-NOW pending key");
-        memset(pending_key, 0, ESPNOW_KEY_LEN);
-    }
-    if (nvs_load_boot_count(&boot_count) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load boot count");
-        boot_count = 0;
-    }
-    if (nvs_load_device_role(&device_role) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load device role");
-        device_role = DEVICE_ROLE_RESPONDER;
-    }
-    if (nvs_load_bridge_ssid(bridge_ssid, sizeof(bridge_ssid)) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load bridge SSID");
-    }
-    if (nvs_load_bridge_password(bridge_password, sizeof(bridge_password)) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load bridge password");
-    } else {
-        ESP_LOGI(TAG, "Bridge password loaded: '%s' (len=%zu)", bridge_password, strlen(bridge_password));
-    }
-    if (nvs_load_mqtt_server_ip(mqtt_server_ip, sizeof(mqtt_server_ip)) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load MQTT server IP");
+/**
+ * @brief Load a blob from /api/config/export: POST /api/config/import
+ *
+ * Every field the blob carries is applied at once and committed to NVS
+ * in one transaction, rather than the page's field-by-field saves.
+ */
+static esp_err_t config_import_handler(httpd_req_t *req) {
+    device_config_t cfg;
+    if (nvs_config_get(&cfg) != ESP_OK) {
+        ESP_LOGW(TAG, "Some stored config values failed to load, importing over them");
     }
-    if (nvs_load_mqtt_port(&mqtt_port) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load MQTT port");
-        mqtt_port = MQTT_DEFAULT_PORT;
+    uint8_t *buf = http_arena_alloc(req, CONFIG_SCHEMA_BLOB_MAX);
+    if (buf == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
     }
-    if (nvs_load_mqtt_username(mqtt_username, sizeof(mqtt_username)) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load MQTT username");
+
+    http_io_t io;
+    http_io_init_httpd(&io, req);
+    config_import_result_t result = { 0 };
+    esp_err_t err = web_config_import(&io, &cfg, buf, &result);
+    if (err == ESP_ERR_TIMEOUT || err == ESP_FAIL) {
+        return ESP_FAIL;
     }
-    if (nvs_load_mqtt_password(mqtt_password, sizeof(mqtt_password)) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load MQTT password");
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Rejected config blob: %s", esp_err_to_name(err));
+        return ESP_OK;
     }
-    if (nvs_load_mqtt_client_id(mqtt_client_id, sizeof(mqtt_client_id)) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load MQTT client ID");
+
+    err = nvs_config_update(&cfg);
+    if (err == ESP_OK) {
+        err = nvs_config_flush();
     }
-    if (nvs_load_mqtt_qos(&mqtt_qos) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load MQTT QoS");
-        mqtt_qos = MQTT_DEFAULT_QOS;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store imported config: %s", esp_err_to_name(err));
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to store the configuration");
+        return ESP_FAIL;
     }
-    if (nvs_load_mqtt_base_topic(mqtt_base_topic, sizeof(mqtt_base_topic)) != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load MQTT base topic");
+    if ((result.flags & CONFIG_SCHEMA_BLOB_UNIT) != 0) {
+        calib_load();
     }
-
-    ESP_LOGI(TAG, "All NVS values loaded, building JSON response...");
-
-    // Convert binary keys to hex strings
-    char active_key_hex[33] = "";
-    char pending_key_hex[33] = "";
-    
-    for (int i = 0; i < ESPNOW_KEY_LEN; i++) {
-        sprintf(&active_key_hex[i*2], "%02X", active_key[i]);
-        sprintf(&pending_key_hex[i*2], "%02X", pending_key[i]);
+    if (discovery_is_running()) {
+        discovery_update_telemetry();
     }
+    ESP_LOGI(TAG, "Imported %u config fields (%u unknown skipped)%s", result.applied, result.unknown,
+             (result.flags & CONFIG_SCHEMA_BLOB_UNIT) != 0 ? " with per-unit fields" : "");
 
-    // Build JSON response with safe buffer size calculation
-    // Calculate required buffer size to prevent overflow
-    size_t required_size = 1024 + // base JSON structure
-                          strlen(mac_address) + strlen(ip_address) + strlen(password) +
-                          strlen(active_key_hex) + strlen(pending_key_hex) +
-                          strlen(bridge_ssid) + strlen(bridge_password) +
-                          strlen(mqtt_server_ip) + strlen(mqtt_username) + strlen(mqtt_password) +
-                          strlen(mqtt_client_id) + strlen(mqtt_base_topic) + 256; // padding
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    json_obj_begin(&w);
+    json_kv_str(&w, "status", "success");
+    json_kv_uint(&w, "applied", result.applied);
+    json_kv_uint(&w, "unknown", result.unknown);
+    json_kv_bool(&w, "unit", (result.flags & CONFIG_SCHEMA_BLOB_UNIT) != 0);
+    json_obj_end(&w);
+    return json_writer_finish(&w);
+}
 
-    ESP_LOGI(TAG, "Calculated required buffer size: %zu bytes", required_size);
+/**
+ * @brief Write one metric as {"id":N,"value":"...","status":"ok"|"error"}
+ *
+ * Same shape as format_metric_json(), streamed with full escaping.
+ */
+static void write_metric_json(json_writer_t *w, system_metric_t metric,
+                              const char *value, metric_error_t error) {
+    bool ok = (error == METRIC_OK && value != NULL);
+
+    json_obj_begin(w);
+    json_kv_int(w, "id", metric);
+    json_kv_str(w, "value", ok ? value : (error == METRIC_OK ? "unavailable" : get_metric_error_name(error)));
+    json_kv_str(w, "status", ok ? "ok" : "error");
+    json_obj_end(w);
+}
 
-    char *response = (char *)malloc(required_size);
-    if (!response) {
-        ESP_LOGE(TAG, "Failed to allocate memory for JSON response");
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
-        return ESP_FAIL;
+/**
+ * @brief Write one metric as {"id":N,"value":<number or string>,"unit":"...","status":"ok"},
+ *        or the write_metric_json() error shape
+ */
+static void write_metric_value_json(json_writer_t *w, const metric_sample_t *sample) {
+    const metric_value_t *value = &sample->value;
+    if (sample->error != METRIC_OK) {
+        write_metric_json(w, sample->metric, NULL, sample->error);
+        return;
+    }
+
+    json_obj_begin(w);
+    json_kv_int(w, "id", sample->metric);
+    json_key(w, "value");
+    switch (value->type) {
+        case METRIC_VALUE_INT:
+            json_int(w, value->i);
+            break;
+        case METRIC_VALUE_FLOAT:
+            json_double(w, value->f, 2);
+            break;
+        default:
+            json_str(w, value->s);
+            break;
     }
-
-    int written = snprintf(response, required_size,
-             "{"
-             "\"macAddress\":\"%s\","
-             "\"ipAddress\":\"%s\","
-             "\"password\":\"%s\","
-             "\"activeKey\":\"%s\","
-             "\"pendingKey\":\"%s\","
-             "\"bootCount\":%lu,"
-             "\"deviceRole\":%d,"
-             "\"bridgeSsid\":\"%s\","
-             "\"bridgePassword\":\"%s\","
-             "\"mqttServerIp\":\"%s\","
-             "\"mqttPort\":%d,"
-             "\"mqttUsername\":\"%s\","
-             "\"mqttPassword\":\"%s\","
-             "\"mqttClientId\":\"%s\","
-             "\"mqttQos\":%d,"
-             "\"mqttBaseTopic\":\"%s\""
-             "}",
-             mac_address, ip_address, password, active_key_hex, pending_key_hex, boot_count, device_role,
-             bridge_ssid, bridge_password, mqtt_server_ip, mqtt_port, mqtt_username, mqtt_password,
-             mqtt_client_id, mqtt_qos, mqtt_base_topic);
-
-    ESP_LOGI(TAG, "JSON response built, length: %d bytes", written);
-
-    if (written >= (int)required_size || written < 0) {
-        ESP_LOGE(TAG, "JSON response buffer overflow or error: written=%d, required=%zu", written, required_size);
-        free(response);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Response too large");
-        return ESP_FAIL;
+    if (value->unit != NULL && value->unit[0] != '\0') {
+        json_kv_str(w, "unit", value->unit);
     }
-
-    httpd_resp_set_type(req, "application/json");
-    esp_err_t send_result = httpd_resp_send(req, response, strlen(response));
-    
-    free(response);
-    
-    ESP_LOGI(TAG, "GET config handler completed successfully");
-    return send_result;
+    json_kv_str(w, "status", "ok");
+    json_obj_end(w);
 }
 
 static esp_err_t get_metric_handler(httpd_req_t *req) {
-    ESP_LOGI(TAG, "GET metric request received: %s", req->uri);
+    ESP_LOGD(TAG, "GET metric request received: %s", req->uri);
     
     // Parse query string to get metric ID
     char query_str[128];
@@ -1070,7 +1181,7 @@ static esp_err_t get_metric_handler(httpd_req_t *req) {
         return ESP_OK;
     }
 
-    ESP_LOGI(TAG, "Query string: %s", query_str);
+    ESP_LOGD(TAG, "Query string: %s", query_str);
 
     // Extract metric ID from query string
     char metric_id_str[32] = "";
@@ -1082,7 +1193,7 @@ static esp_err_t get_metric_handler(httpd_req_t *req) {
 
     // Convert metric ID to integer
     int metric_id = atoi(metric_id_str);
-    ESP_LOGI(TAG, "Requesting metric ID: %d", metric_id);
+    ESP_LOGD(TAG, "Requesting metric ID: %d", metric_id);
     
     if (metric_id < 0 || metric_id >= METRIC_COUNT) {
         ESP_LOGW(TAG, "Invalid metric ID: %d (max: %d)", metric_id, METRIC_COUNT-1);
@@ -1092,132 +1203,760 @@ static esp_err_t get_metric_handler(httpd_req_t *req) {
     }
 
     // Get the metric value
-    const char* metric_value = get_system_metric((system_metric_t)metric_id);
-    metric_error_t error_code = get_metric_error();
+    char metric_value[METRIC_MAX_STRING_LENGTH];
+    metric_error_t error_code;
+    get_system_metric_r((system_metric_t)metric_id, metric_value, sizeof(metric_value), &error_code);
     
-    ESP_LOGI(TAG, "Metric %d result: error=%d, value='%s'", metric_id, error_code, metric_value ? metric_value : "NULL");
+    ESP_LOGD(TAG, "Metric %d result: error=%d, value='%s'", metric_id, error_code, metric_value);
     
-    // Build JSON response
-    char response[256];
-    if (error_code == METRIC_OK && metric_value != NULL) {
-        // Escape any quotes in the metric value for JSON safety
-        char escaped_value[192];
-        int j = 0;
-        for (int i = 0; metric_value[i] && j < sizeof(escaped_value) - 2; i++) {
-            if (metric_value[i] == '"' || metric_value[i] == '\\') {
-                escaped_value[j++] = '\\';
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    write_metric_json(&w, (system_metric_t)metric_id, metric_value, error_code);
+    return json_writer_finish(&w);
+}
+
+static esp_err_t api_metrics_handler(httpd_req_t *req) {
+    // Select metrics: ?ids=0,1,2 or ?group=wifi, everything when neither is given.
+    // ?format=typed reports numbers with units instead of display strings.
+    metric_mask_t selected = METRIC_MASK_ALL;
+    char query_str[256];
+    char param[200];
+    bool have_query = httpd_req_get_url_query_str(req, query_str, sizeof(query_str)) == ESP_OK;
+    bool typed = have_query && httpd_query_key_value(query_str, "format", param, sizeof(param)) == ESP_OK &&
+                 strcmp(param, "typed") == 0;
+
+    if (have_query && httpd_query_key_value(query_str, "ids", param, sizeof(param)) == ESP_OK) {
+        selected = 0;
+        char *saveptr = NULL;
+        for (char *tok = strtok_r(param, ",", &saveptr); tok != NULL; tok = strtok_r(NULL, ",", &saveptr)) {
+            char *end = NULL;
+            long metric_id = strtol(tok, &end, 10);
+            if (end == tok || *end != '\0' || metric_id < 0 || metric_id >= METRIC_COUNT) {
+                ESP_LOGW(TAG, "Invalid metric ID in batch request: '%s'", tok);
+                httpd_resp_set_status(req, "400 Bad Request");
+                httpd_resp_set_type(req, "application/json");
+                httpd_resp_send(req, "{\"error\":\"Invalid metric ID in 'ids' parameter\"}", -1);
+                return ESP_OK;
             }
-            escaped_value[j++] = metric_value[i];
+            selected |= METRIC_MASK(metric_id);
         }
-        escaped_value[j] = '\0';
-        
-        snprintf(response, sizeof(response), 
-                "{\"id\":%d,\"value\":\"%s\",\"status\":\"ok\"}", 
-                metric_id, escaped_value);
-    } else {
-        // Determine error message based on error code
-        const char* error_msg = "unavailable";
-        switch (error_code) {
-            case METRIC_ERROR_INVALID_ID:
-                error_msg = "invalid_id";
-                break;
-            case METRIC_ERROR_NOT_AVAILABLE:
-                error_msg = "not_available";
-                break;
-            case METRIC_ERROR_NOT_SUPPORTED:
-                error_msg = "not_supported";
-                break;
-            case METRIC_ERROR_HARDWARE_FAULT:
-                error_msg = "hardware_fault";
-                break;
-            default:
-                error_msg = "unavailable";
-                break;
+    } else if (have_query && httpd_query_key_value(query_str, "group", param, sizeof(param)) == ESP_OK) {
+        metric_group_t group = get_metric_group_by_name(param);
+        if (group == METRIC_GROUP_COUNT) {
+            ESP_LOGW(TAG, "Unknown metric group in batch request: '%s'", param);
+            httpd_resp_set_status(req, "400 Bad Request");
+            httpd_resp_set_type(req, "application/json");
+            httpd_resp_send(req, "{\"error\":\"Unknown metric group\"}", -1);
+            return ESP_OK;
         }
-        
-        snprintf(response, sizeof(response), 
-                "{\"id\":%d,\"value\":\"%s\",\"status\":\"error\"}", 
-                metric_id, error_msg);
+        selected = get_metric_group_mask(group);
     }
 
-    httpd_resp_set_type(req, "application/json");
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_send(req, response, strlen(response));
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    // One batch over the selected metrics, streamed a few at a time as they are read
+    metric_batch_t batch;
+    metric_sample_t samples[METRIC_COLLECT_CHUNK];
+    size_t n;
+    uint32_t count = 0;
+    system_metrics_batch_init(&batch, selected, !typed);
+    json_obj_begin(&w);
+    json_kv_str(&w, "schema", metrics_export_schema_version());
+    json_key(&w, "metrics");
+    json_arr_begin(&w);
+
+    while (w.err == ESP_OK && (n = system_metrics_collect(&batch, samples, METRIC_COLLECT_CHUNK)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (typed) {
+                write_metric_value_json(&w, &samples[i]);
+            } else {
+                write_metric_json(&w, samples[i].metric, samples[i].value.s, samples[i].error);
+            }
+        }
+        count += n;
+    }
 
+    json_arr_end(&w);
+    json_obj_end(&w);
+
+    esp_err_t err = json_writer_finish(&w);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send metrics batch: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGD(TAG, "Sent %lu metrics in one batch", (unsigned long)count);
     return ESP_OK;
 }
 
 static esp_err_t get_version_info_handler(httpd_req_t *req) {
-    ESP_LOGI(TAG, "GET version info request received");
-    
-    // Get comprehensive version information
-    const char* version_html = get_version_info_string();
-    
+    ESP_LOGD(TAG, "GET version info request received");
+
+    // ?format=json gives the same manifest as JSON; both are built at compile time
+    char query[32];
+    char param[8];
+    bool json = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+                httpd_query_key_value(query, "format", param, sizeof(param)) == ESP_OK &&
+                strcmp(param, "json") == 0;
+    size_t len;
+    const char *body = json ? get_version_info_json(&len) : get_version_info_string(&len);
+
     // Set response headers
-    httpd_resp_set_type(req, "text/html");
+    httpd_resp_set_type(req, json ? "application/json" : "text/html");
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    
-    // Send the formatted HTML response
-    httpd_resp_send(req, version_html, strlen(version_html));
-    
-    return ESP_OK;
+
+    return httpd_resp_send(req, body, len);
 }
 
 static esp_err_t captive_portal_redirect_handler(httpd_req_t *req) {
-    ESP_LOGI(TAG, "Captive portal handler called for URI: %s", req->uri);
-
-    // Check if this should have been handled by file_get_handler
-    if (strcmp(req->uri, "/configuration.html") == 0 ||
-        strcmp(req->uri, "/information.html") == 0 ||
-        strcmp(req->uri, "/ota.html") == 0 ||
-        strcmp(req->uri, "/styles.css") == 0 ||
-        strcmp(req->uri, "/scripts.js") == 0 ||
-        strcmp(req->uri, "/favicon.ico") == 0) {
-        ESP_LOGW(TAG, "ERROR: Captive portal handler called for file that should be handled by file_get_handler: %s", req->uri);
-    }
+    ESP_LOGD(TAG, "Captive portal handler called for URI: %s", req->uri);
 
-    // Handle root requests normally
-    if (strcmp(req->uri, "/") == 0) {
-        ESP_LOGI(TAG, "Root request, calling file_get_handler");
+    const web_route_t *route = web_route_find(req->uri);
+    if (route != NULL && route->kind == WEB_ROUTE_ASSET) {
         return file_get_handler(req);
     }
 
-    // Common captive portal detection URLs
-    if (strstr(req->uri, "generate_204") ||
-        strstr(req->uri, "connecttest") ||
-        strstr(req->uri, "hotspot-detect") ||
-        strstr(req->uri, "success.txt") ||
-        strstr(req->uri, "ncsi.txt") ||
-        strstr(req->uri, "connectivity-check") ||
-        strstr(req->uri, "gstatic.com") ||
-        strstr(req->uri, "captive.apple.com") ||
-        strstr(req->uri, "msftconnecttest.com") ||
-        strstr(req->uri, "detectportal")) {
-
-        ESP_LOGI(TAG, "Captive portal detection URL detected: %s", req->uri);
+    if (route != NULL) {
+        ESP_LOGI_RATE(probe_log, TAG, "Captive portal detection URL detected: %s", req->uri);
 
         // Some devices expect a 204 response
-        if (strstr(req->uri, "generate_204") || strstr(req->uri, "ncsi.txt")) {
+        if (route->kind == WEB_ROUTE_PROBE_NO_CONTENT) {
             httpd_resp_set_status(req, "204 No Content");
             httpd_resp_send(req, NULL, 0);
             return ESP_OK;
         }
-
-        // Others expect a redirect
-        httpd_resp_set_status(req, "302 Found");
-        httpd_resp_set_hdr(req, "Location", "http://192.168.4.1/");
-        httpd_resp_send(req, NULL, 0);
-        return ESP_OK;
+    } else {
+        ESP_LOGW_RATE(unknown_uri_log, TAG, "Unknown request URI: %s - redirecting to index", req->uri);
     }
 
-    // For any other unknown requests, redirect to index page
-    ESP_LOGW(TAG, "Unknown request URI: %s - redirecting to index", req->uri);
+    // Probes and everything else go to the portal
     httpd_resp_set_status(req, "302 Found");
-    httpd_resp_set_hdr(req, "Location", "http://192.168.4.1/");
+    httpd_resp_set_hdr(req, "Location", PORTAL_URL);
     httpd_resp_send(req, NULL, 0);
     return ESP_OK;
 }
 
+/**
+ * @brief Route every URI without a registered handler through the captive portal
+ */
+static esp_err_t not_found_handler(httpd_req_t *req, httpd_err_code_t error) {
+    (void)error;
+    return captive_portal_redirect_handler(req);
+}
+
+/**
+ * @brief Fill in the "portal" server profile
+ */
+static void portal_httpd_config(httpd_config_t *config) {
+    *config = (httpd_config_t)HTTPD_DEFAULT_CONFIG();
+    config->server_port = WEB_SERVER_PORT;
+    config->max_uri_handlers = WEB_SERVER_PORTAL_MAX_HANDLERS;  // Routes plus the API; see web_server.h
+    config->max_resp_headers = 13;  // Static assets carry encoding, Vary, ETag and Cache-Control; every response Keep-Alive
+    config->stack_size = WEB_SERVER_PORTAL_STACK_SIZE;
+    config->core_id = WEB_SERVER_PORTAL_CORE;
+    config->task_priority = WEB_SERVER_PORTAL_PRIORITY;
+
+    // Phones open several sockets at once for probes plus the page; when the
+    // pool is full, evict the idlest session instead of stalling the newcomer
+    config->max_open_sockets = WEB_SERVER_PORTAL_MAX_SOCKETS;
+    config->backlog_conn = WEB_SERVER_PORTAL_BACKLOG;
+    config->lru_purge_enable = true;
+
+    // Reap sockets of clients that left the AP without closing them
+    config->keep_alive_enable = true;
+    config->keep_alive_idle = WEB_SERVER_PORTAL_KEEPALIVE_IDLE;
+    config->keep_alive_interval = WEB_SERVER_PORTAL_KEEPALIVE_INTERVAL;
+    config->keep_alive_count = WEB_SERVER_PORTAL_KEEPALIVE_COUNT;
+
+    config->open_fn = portal_open_fn;
+    config->close_fn = portal_close_fn;
+
+    // TLS sessions each hold their own record buffers, and the handshake runs on the server task
+    if (HTTPS_PORTAL != 0) {
+        config->server_port = HTTPS_PORTAL_PORT;
+        config->max_open_sockets = HTTPS_PORTAL_MAX_SOCKETS;
+        config->stack_size = HTTPS_PORTAL_STACK_SIZE;
+    }
+}
+
+static esp_err_t portal_open_fn(httpd_handle_t hd, int sockfd) {
+    // Leave headroom for the sessions already being served
+    uint32_t free_heap = esp_get_free_heap_size();
+    if (free_heap < WEB_SERVER_PORTAL_MIN_FREE_HEAP) {
+        conn_stats.refused++;
+        ESP_LOGW_RATE(conn_log, TAG, "Refusing connection (fd %d): only %lu bytes free", sockfd, (unsigned long)free_heap);
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < WEB_SERVER_PORTAL_MAX_SOCKETS; i++) {
+        if (open_fds[i] < 0) {
+            open_fds[i] = sockfd;
+            conn_stats.accepted++;
+            conn_stats.active++;
+            if (conn_stats.active > conn_stats.peak_active) {
+                conn_stats.peak_active = conn_stats.active;
+            }
+            ESP_LOGD(TAG, "Connection opened (fd %d), %lu active", sockfd, (unsigned long)conn_stats.active);
+            http_session_open(sockfd);          // Same pool size, so there is always a slot
+            // Count response bytes for /api/perf; over TLS the send hook is the SSL layer's, so no byte counts
+            if (HTTPS_PORTAL == 0) {
+                httpd_sess_set_send_override(hd, sockfd, http_perf_send);
+            }
+            return ESP_OK;
+        }
+    }
+
+    conn_stats.refused++;
+    ESP_LOGW_RATE(conn_log, TAG, "Refusing connection (fd %d): no free session slot", sockfd);
+    return ESP_FAIL;
+}
+
+static void portal_close_fn(httpd_handle_t hd, int sockfd) {
+    (void)hd;
+
+    for (int i = 0; i < WEB_SERVER_PORTAL_MAX_SOCKETS; i++) {
+        if (open_fds[i] != sockfd) {
+            continue;
+        }
+
+        // A full pool closing a socket whose peer is still there is the LRU purge
+        if (conn_stats.active >= WEB_SERVER_PORTAL_MAX_SOCKETS) {
+            char peek;
+            int ret = recv(sockfd, &peek, 1, MSG_PEEK | MSG_DONTWAIT);
+            if (ret > 0 || (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))) {
+                conn_stats.purged++;
+                ESP_LOGI_RATE(conn_log, TAG, "Purged idle connection (fd %d) for a new client", sockfd);
+            }
+        }
+
+        open_fds[i] = -1;
+        http_session_close(sockfd);
+        conn_stats.closed++;
+        conn_stats.active--;
+        ESP_LOGD(TAG, "Connection closed (fd %d), %lu active", sockfd, (unsigned long)conn_stats.active);
+        break;
+    }
+
+    // Installing close_fn makes closing the socket our job
+    close(sockfd);
+}
+
+static esp_err_t server_stats_handler(httpd_req_t *req) {
+    web_server_conn_stats_t stats;
+    http_gzip_stats_t gzip;
+    http_session_stats_t sessions;
+    web_server_get_conn_stats(&stats);
+    http_gzip_get_stats(&gzip);
+    http_session_get_stats(&sessions);
+
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    json_obj_begin(&w);
+    json_kv_uint(&w, "accepted", stats.accepted);
+    json_kv_uint(&w, "closed", stats.closed);
+    json_kv_uint(&w, "purged", stats.purged);
+    json_kv_uint(&w, "refused", stats.refused);
+    json_kv_uint(&w, "active", stats.active);
+    json_kv_uint(&w, "peakActive", stats.peak_active);
+    json_kv_uint(&w, "maxSockets", stats.max_sockets);
+    json_key(&w, "gzip");
+    json_obj_begin(&w);
+    json_kv_uint(&w, "responses", gzip.responses);
+    json_kv_uint(&w, "skipped", gzip.skipped);
+    json_kv_uint(&w, "bytesIn", gzip.bytes_in);
+    json_kv_uint(&w, "bytesOut", gzip.bytes_out);
+    json_obj_end(&w);
+    json_key(&w, "sessions");
+    json_obj_begin(&w);
+    json_kv_uint(&w, "opened", sessions.sessions);
+    json_kv_uint(&w, "requests", sessions.requests);
+    json_kv_uint(&w, "reused", sessions.reused);
+    json_kv_uint(&w, "idleClosed", sessions.idle_closed);
+    json_kv_uint(&w, "mostRequests", sessions.most_requests);
+    json_kv_uint(&w, "idleTimeoutS", HTTP_SESSION_IDLE_S);
+    json_obj_end(&w);
+    json_key(&w, "probes");
+    portal_probe_write_json(&w);
+    json_obj_end(&w);
+    return json_writer_finish(&w);
+}
+
+/**
+ * @brief Performance data: GET /api/perf -> {"http":{...},"cpu":{...},"net":{...}}
+ *
+ * ?reset=1 zeroes the HTTP counters after reporting.
+ */
+static esp_err_t perf_handler(httpd_req_t *req) {
+    char query[32];
+    char reset[4] = "";
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "reset", reset, sizeof(reset));
+    }
+
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    json_obj_begin(&w);
+    json_key(&w, "http");
+    http_perf_write_json(&w);
+    json_key(&w, "cpu");
+    cpu_monitor_write_json(&w);
+    json_key(&w, "net");
+    net_stats_write_json(&w);
+    json_obj_end(&w);
+    esp_err_t ret = json_writer_finish(&w);
+
+    if (strcmp(reset, "1") == 0) {
+        http_perf_reset();
+    }
+    return ret;
+}
+
+/**
+ * @brief Heap profile: GET /api/heap -> capabilities, failures and per-task allocations
+ *
+ * ?check=1 also walks every heap for corruption; ?reset=1 zeroes the task counters.
+ */
+static esp_err_t heap_handler(httpd_req_t *req) {
+    char query[32];
+    char check[4] = "";
+    char reset[4] = "";
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "check", check, sizeof(check));
+        httpd_query_key_value(query, "reset", reset, sizeof(reset));
+    }
+
+    // Before streaming starts, so the walk is not interleaved with the response
+    bool run_check = strcmp(check, "1") == 0;
+    bool intact = run_check ? heap_caps_check_integrity_all(true) : true;
+
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    json_obj_begin(&w);
+    json_key(&w, "heap");
+    heap_monitor_write_json(&w);
+    json_key(&w, "staticMemory");
+    static_mem_write_json(&w);
+    json_key(&w, "requestArena");
+    http_arena_write_json(&w);
+    if (run_check) {
+        json_kv_bool(&w, "integrity", intact);
+    }
+    json_obj_end(&w);
+    esp_err_t ret = json_writer_finish(&w);
+
+    if (strcmp(reset, "1") == 0) {
+        heap_monitor_reset();
+    }
+    return ret;
+}
+
+/**
+ * @brief Stored metric history: GET /api/history
+ *
+ * ?from=<seq>&count=<n> reads forward from a sequence number; ?last=<n>
+ * returns the newest n records. Follow "next" to page through the rest.
+ *
+ * With ?metric= it queries the gateway's sensor history instead (see
+ * series_history()).
+ */
+static esp_err_t history_handler(httpd_req_t *req) {
+    char query[128];
+    char value[12];
+    uint32_t from = 0;
+    uint32_t count = 60;
+    bool have_from = false;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "metric", value, sizeof(value)) == ESP_OK) {
+            return series_history(req, query, value);
+        }
+        if (httpd_query_key_value(query, "count", value, sizeof(value)) == ESP_OK) {
+            count = strtoul(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "from", value, sizeof(value)) == ESP_OK) {
+            from = strtoul(value, NULL, 10);
+            have_from = true;
+        } else if (httpd_query_key_value(query, "last", value, sizeof(value)) == ESP_OK) {
+            count = strtoul(value, NULL, 10);
+        }
+    }
+
+    if (!have_from) {
+        metric_history_info_t info;
+        metric_history_get_info(&info);
+        from = info.next_seq > count ? info.next_seq - count : 0;
+    }
+
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    json_writer_t w;
+    http_gzip_init_json(&w, req);
+    metric_history_write_json(&w, from, count);
+    return json_writer_finish(&w);
+}
+
+/**
+ * @brief Node samples from the time-series store: GET /api/history?metric=&from=&to=&step=&node=
+ *
+ * from and to are Unix seconds (to defaults to just after the newest
+ * sample, from to a day before to); step is the bucket width in seconds,
+ * by default about TS_STORE_DEFAULT_POINTS buckets; node is a hex node id,
+ * by default all nodes together. The buckets stream out as they are read.
+ */
+static esp_err_t series_history(httpd_req_t *req, const char *query, const char *metric_name) {
+    char value[12];
+    ts_store_metric_t metric;
+    if (ts_store_metric_from_name(metric_name, &metric) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown metric");
+        return ESP_FAIL;
+    }
+
+    ts_store_info_t info;
+    ts_store_get_info(&info);
+    uint32_t to = info.newest_s + 1;
+    uint32_t step = 0;
+    uint32_t node = 0;
+    if (httpd_query_key_value(query, "to", value, sizeof(value)) == ESP_OK) {
+        to = strtoul(value, NULL, 10);
+    }
+    uint32_t from = to > TS_STORE_SEGMENT_S ? to - TS_STORE_SEGMENT_S : 0;
+    if (httpd_query_key_value(query, "from", value, sizeof(value)) == ESP_OK) {
+        from = strtoul(value, NULL, 10);
+    }
+    if (httpd_query_key_value(query, "step", value, sizeof(value)) == ESP_OK) {
+        step = strtoul(value, NULL, 10);
+    }
+    if (httpd_query_key_value(query, "node", value, sizeof(value)) == ESP_OK) {
+        node = strtoul(value, NULL, 16);
+    }
+
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    // Nothing is sent before the query is accepted, so a refusal can still be an error status
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    esp_err_t err = ts_store_write_json(&w, metric, node, from, to, step);
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad range");
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_type(req, "text/plain");
+        httpd_resp_sendstr(req, err == ESP_ERR_INVALID_STATE ? "History not ready" : "Out of memory");
+        return ESP_FAIL;
+    }
+    return json_writer_finish(&w);
+}
+
+/**
+ * @brief Startup checkpoints of this boot and the previous one: GET /api/boot
+ */
+static esp_err_t boot_trace_handler(httpd_req_t *req) {
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    boot_trace_write_json(&w);
+    return json_writer_finish(&w);
+}
+
+/**
+ * @brief Nodes heard by the gateway, with seq, RSSI, key epoch and link quality: GET /api/nodes
+ */
+static esp_err_t nodes_handler(httpd_req_t *req) {
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    node_table_write_json(&w);
+    return json_writer_finish(&w);
+}
+
+/**
+ * @brief Each node's newest reading, read without a lock (latest_values.h): GET /api/latest
+ */
+static esp_err_t latest_handler(httpd_req_t *req) {
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    latest_values_write_json(&w);
+    return json_writer_finish(&w);
+}
+
+/**
+ * @brief Window aggregates per node and metric, open and last closed: GET /api/aggregates
+ */
+static esp_err_t aggregates_handler(httpd_req_t *req) {
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    aggregator_write_json(&w);
+    return json_writer_finish(&w);
+}
+
+/**
+ * @brief Each sensor's calibration table in force, with its units (calib.h): GET /api/calibration
+ */
+static esp_err_t calibration_get_handler(httpd_req_t *req) {
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    calib_write_json(&w);
+    return json_writer_finish(&w);
+}
+
+/**
+ * @brief Set a calibration table: POST /api/calibration?sensor=vane&points=0:0,4096:3600
+ *
+ * points are "input:output" pairs with rising inputs; empty points returns
+ * the sensor to the build's constants. Answers with the GET.
+ */
+static esp_err_t calibration_post_handler(httpd_req_t *req) {
+    char query[CALIB_TEXT_MAX + 48];
+    char name[16];
+    char points[CALIB_TEXT_MAX];
+    calib_sensor_t sensor;
+    calib_table_t table;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "sensor", name, sizeof(name)) != ESP_OK || !calib_find(name, &sensor)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing or unknown sensor");
+        return ESP_FAIL;
+    }
+    if (httpd_query_key_value(query, "points", points, sizeof(points)) != ESP_OK) {
+        points[0] = '\0';
+    }
+    if (calib_parse(points, &table) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Points must be 2 or more rising x:y pairs");
+        return ESP_FAIL;
+    }
+    if (calib_set(sensor, &table) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to store the table");
+        return ESP_FAIL;
+    }
+    return calibration_get_handler(req);
+}
+
+/**
+ * @brief Stored core dump: GET /api/coredump
+ *
+ * Streams the raw image (ELF) straight from the coredump partition in
+ * COREDUMP_READ_CHUNK pieces; ?info=1 returns the decoded summary as JSON.
+ */
+static esp_err_t coredump_get_handler(httpd_req_t *req) {
+    char query[16];
+    char info_arg[4] = "";
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "info", info_arg, sizeof(info_arg));
+    }
+
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    if (strcmp(info_arg, "1") == 0) {
+        json_writer_t w;
+        json_writer_init_httpd(&w, req);
+        coredump_write_json(&w);
+        return json_writer_finish(&w);
+    }
+
+    coredump_info_t info;
+    if (coredump_get_info(&info) != ESP_OK || !info.present) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No core dump stored");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=coredump.elf");
+
+    char buffer[COREDUMP_READ_CHUNK];
+    for (size_t offset = 0; offset < info.size;) {
+        size_t len = info.size - offset < sizeof(buffer) ? info.size - offset : sizeof(buffer);
+        esp_err_t err = coredump_read(offset, buffer, len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Core dump read failed at %u: %s", (unsigned)offset, esp_err_to_name(err));
+            httpd_resp_sendstr_chunk(req, NULL);
+            return ESP_FAIL;
+        }
+        if (httpd_resp_send_chunk(req, buffer, len) != ESP_OK) {
+            ESP_LOGW(TAG, "Core dump download aborted at %u of %u bytes", (unsigned)offset, (unsigned)info.size);
+            return ESP_FAIL;
+        }
+        offset += len;
+    }
+    ESP_LOGI(TAG, "Core dump downloaded (%u bytes)", (unsigned)info.size);
+    return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+/**
+ * @brief Discard the stored core dump: DELETE /api/coredump -> the now-empty info
+ */
+static esp_err_t coredump_delete_handler(httpd_req_t *req) {
+    esp_err_t err = coredump_erase();
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Core dump to flash is disabled");
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to erase core dump");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    coredump_write_json(&w);
+    return json_writer_finish(&w);
+}
+
+static esp_err_t log_level_get_handler(httpd_req_t *req) {
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    json_writer_t w;
+    json_writer_init_httpd(&w, req);
+    json_obj_begin(&w);
+    json_key(&w, "subsystems");
+    json_arr_begin(&w);
+    for (size_t i = 0; i < log_policy_count(); i++) {
+        log_policy_entry_t entry;
+        if (log_policy_get(i, &entry) != ESP_OK) {
+            continue;
+        }
+        json_obj_begin(&w);
+        json_kv_str(&w, "tag", entry.tag);
+        json_kv_str(&w, "level", log_policy_level_name(entry.level));
+        json_kv_str(&w, "default", log_policy_level_name(entry.default_level));
+        json_kv_uint(&w, "boostRemaining", entry.boost_remaining_s);
+        json_obj_end(&w);
+    }
+    json_arr_end(&w);
+    json_obj_end(&w);
+    return json_writer_finish(&w);
+}
+
+/**
+ * @brief Change a log level: POST /api/log_level?tag=WEB_SERVER&level=debug&duration=300
+ *
+ * tag defaults to every subsystem, duration to LOG_POLICY_DEFAULT_BOOST_S;
+ * duration=0 keeps the level until reboot.
+ */
+static esp_err_t log_level_post_handler(httpd_req_t *req) {
+    char query[96];
+    char tag[24] = LOG_POLICY_ALL_TAGS;
+    char level_name[12];
+    char duration_str[12];
+    esp_log_level_t level;
+    uint32_t duration_s = LOG_POLICY_DEFAULT_BOOST_S;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "level", level_name, sizeof(level_name)) != ESP_OK ||
+        !log_policy_level_from_name(level_name, &level)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing or invalid level");
+        return ESP_FAIL;
+    }
+    httpd_query_key_value(query, "tag", tag, sizeof(tag));
+    if (httpd_query_key_value(query, "duration", duration_str, sizeof(duration_str)) == ESP_OK) {
+        duration_s = (uint32_t)strtoul(duration_str, NULL, 10);
+    }
+
+    esp_err_t err = log_policy_set_level(tag, level, duration_s);
+    if (err == ESP_ERR_NOT_FOUND) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown log tag");
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid level");
+        return ESP_FAIL;
+    }
+    return log_level_get_handler(req);
+}
+
+/**
+ * @brief Recorded events as text, formatted now: GET /api/log?since=1234
+ *
+ * One "I (ms) TAG: text" line per event from seq since (default: the
+ * oldest kept) up to the newest when the request came in, whatever the
+ * tags' log levels. X-Log-Next is the since of the next poll.
+ */
+static esp_err_t event_log_handler(httpd_req_t *req) {
+    char query[32];
+    char since_str[12];
+    uint32_t end = event_log_head();
+    uint32_t cursor = end > EVENT_LOG_SLOTS ? end - EVENT_LOG_SLOTS : 0;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", since_str, sizeof(since_str)) == ESP_OK) {
+        cursor = (uint32_t)strtoul(since_str, NULL, 10);
+    }
+
+    char next[12];
+    snprintf(next, sizeof(next), "%lu", (unsigned long)end);
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    httpd_resp_set_hdr(req, "X-Log-Next", next);
+
+    char chunk[1024];
+    size_t used = 0;
+    event_log_entry_t entry;
+    uint32_t lost;
+    while ((int32_t)(end - cursor) > 0 && event_log_read(&cursor, &entry, &lost)) {
+        if (lost > 0) {
+            used += (size_t)snprintf(chunk + used, sizeof(chunk) - used, "W (%lu) EVENT_LOG: %lu events overwritten\n",
+                                     (unsigned long)(esp_timer_get_time() / 1000), (unsigned long)lost);
+        }
+        if ((int32_t)(end - entry.seq) <= 0) {
+            break;
+        }
+        used += event_log_format(&entry, chunk + used, sizeof(chunk) - used - 1);
+        chunk[used++] = '\n';
+        if (sizeof(chunk) - used < EVENT_LOG_LINE_MAX + 64) {
+            if (httpd_resp_send_chunk(req, chunk, used) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            used = 0;
+        }
+    }
+    if (used > 0 && httpd_resp_send_chunk(req, chunk, used) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+esp_err_t web_server_get_conn_stats(web_server_conn_stats_t *stats) {
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *stats = conn_stats;
+    return ESP_OK;
+}
+
 esp_err_t web_server_start(void) {
     ESP_LOGI(TAG, "=== WEB SERVER START INITIATED ===");
 
@@ -1228,109 +1967,259 @@ esp_err_t web_server_start(void) {
 
     ESP_LOGI(TAG, "Starting web server...");
 
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.server_port = WEB_SERVER_PORT;
-    config.max_uri_handlers = 20;  // Increased from 16 for future expansion
+    httpd_config_t config;
+    portal_httpd_config(&config);
+
+    memset(&conn_stats, 0, sizeof(conn_stats));
+    conn_stats.max_sockets = config.max_open_sockets;
+    for (int i = 0; i < WEB_SERVER_PORTAL_MAX_SOCKETS; i++) {
+        open_fds[i] = -1;
+    }
+
+    ESP_LOGI(TAG, "Portal profile: %u sockets, backlog %u, LRU purge, keep-alive, core %d",
+             (unsigned)config.max_open_sockets, (unsigned)config.backlog_conn, (int)config.core_id);
 
-    esp_err_t ret = httpd_start(&server_handle, &config);
+    // Without an arena the server still runs; uploads answer "Out of memory"
+    http_arena_init();
+
+    esp_err_t ret = HTTPS_PORTAL != 0 ? https_portal_start(&server_handle, &config) : httpd_start(&server_handle, &config);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Error starting server: %s", esp_err_to_name(ret));
         return ret;
     }
+    http_session_start(server_handle);          // Without the sweep, idle sessions wait for the LRU purge
+
+    // Probes first, so they match ahead of everything; over HTTPS they arrive at the port 80 redirect server
+    if (HTTPS_PORTAL == 0) {
+        portal_probe_register(server_handle);
+    }
+
+    // Register URI handlers - one per asset in the routing table
+    size_t route_count;
+    const web_route_t *routes = web_routes_get(&route_count);
+    for (size_t i = 0; i < route_count; i++) {
+        if (routes[i].kind != WEB_ROUTE_ASSET) {
+            continue;
+        }
+        httpd_uri_t asset_uri = {
+            .uri = routes[i].uri,
+            .method = HTTP_GET,
+            .handler = file_get_handler,
+            .user_ctx = NULL
+        };
+        http_perf_register(server_handle, &asset_uri);
+        ESP_LOGD(TAG, "Registered handler for %s", routes[i].uri);
+    }
+
+    // API endpoints
+    httpd_uri_t save_config_uri = {
+        .uri = "/save_config",
+        .method = HTTP_POST,
+        .handler = save_config_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &save_config_uri);
+
+    httpd_uri_t get_config_uri = {
+        .uri = "/get_config",
+        .method = HTTP_GET,
+        .handler = get_config_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &get_config_uri);
+
+    httpd_uri_t get_config_schema_uri = {
+        .uri = "/config_schema",
+        .method = HTTP_GET,
+        .handler = get_config_schema_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &get_config_schema_uri);
+
+    httpd_uri_t config_export_uri = {
+        .uri = "/api/config/export",
+        .method = HTTP_GET,
+        .handler = config_export_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &config_export_uri);
+
+    httpd_uri_t config_import_uri = {
+        .uri = "/api/config/import",
+        .method = HTTP_POST,
+        .handler = config_import_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &config_import_uri);
+
+    httpd_uri_t get_metric_uri = {
+        .uri = "/get_metric",
+        .method = HTTP_GET,
+        .handler = get_metric_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &get_metric_uri);
 
-    // Register URI handlers
-    httpd_uri_t index_uri = {
-        .uri = "/",
+    httpd_uri_t api_metrics_uri = {
+        .uri = "/api/metrics",
         .method = HTTP_GET,
-        .handler = file_get_handler,
+        .handler = api_metrics_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &index_uri);
-    ESP_LOGI(TAG, "Registered handler for /");
+    http_perf_register(server_handle, &api_metrics_uri);
 
-    httpd_uri_t index_html_uri = {
-        .uri = "/index.html",
+    httpd_uri_t metrics_schema_uri = {
+        .uri = METRICS_EXPORT_SCHEMA_URI,
         .method = HTTP_GET,
-        .handler = file_get_handler,
+        .handler = metrics_export_schema_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &index_html_uri);
-    ESP_LOGI(TAG, "Registered handler for /index.html");
+    http_perf_register(server_handle, &metrics_schema_uri);
+
+    // Live metrics push channel for the information page
+    ret = metrics_stream_start(server_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Metrics stream unavailable, clients will poll: %s", esp_err_to_name(ret));
+    }
+    if (GATEWAY_SIGNALK != 0) {
+        ret = signalk_register(server_handle);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Signal K endpoints unavailable: %s", esp_err_to_name(ret));
+        }
+    }
+    ret = history_export_register(server_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "History export unavailable: %s", esp_err_to_name(ret));
+    }
 
-    httpd_uri_t config_html_uri = {
-        .uri = "/configuration.html",
+    httpd_uri_t server_stats_uri = {
+        .uri = "/api/server_stats",
         .method = HTTP_GET,
-        .handler = file_get_handler,
+        .handler = server_stats_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &config_html_uri);
-    ESP_LOGI(TAG, "Registered handler for /configuration.html");
+    http_perf_register(server_handle, &server_stats_uri);
 
-    httpd_uri_t information_html_uri = {
-        .uri = "/information.html",
+    httpd_uri_t perf_uri = {
+        .uri = "/api/perf",
         .method = HTTP_GET,
-        .handler = file_get_handler,
+        .handler = perf_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &information_html_uri);
-    ESP_LOGI(TAG, "Registered handler for /information.html");
+    http_perf_register(server_handle, &perf_uri);
 
-    httpd_uri_t ota_html_uri = {
-        .uri = "/ota.html",
+    httpd_uri_t heap_uri = {
+        .uri = "/api/heap",
         .method = HTTP_GET,
-        .handler = file_get_handler,
+        .handler = heap_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &ota_html_uri);
+    http_perf_register(server_handle, &heap_uri);
 
-    httpd_uri_t css_uri = {
-        .uri = "/styles.css",
+    httpd_uri_t history_uri = {
+        .uri = "/api/history",
         .method = HTTP_GET,
-        .handler = file_get_handler,
+        .handler = history_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &css_uri);
+    http_perf_register(server_handle, &history_uri);
 
-    httpd_uri_t js_uri = {
-        .uri = "/scripts.js",
+    httpd_uri_t boot_trace_uri = {
+        .uri = "/api/boot",
         .method = HTTP_GET,
-        .handler = file_get_handler,
+        .handler = boot_trace_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &js_uri);
+    http_perf_register(server_handle, &boot_trace_uri);
 
-    httpd_uri_t favicon_uri = {
-        .uri = "/favicon.ico",
+    httpd_uri_t nodes_uri = {
+        .uri = "/api/nodes",
         .method = HTTP_GET,
-        .handler = file_get_handler,
+        .handler = nodes_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &favicon_uri);
+    http_perf_register(server_handle, &nodes_uri);
 
-    // API endpoints
-    httpd_uri_t save_config_uri = {
-        .uri = "/save_config",
+    httpd_uri_t latest_uri = {
+        .uri = "/api/latest",
+        .method = HTTP_GET,
+        .handler = latest_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &latest_uri);
+
+    httpd_uri_t aggregates_uri = {
+        .uri = "/api/aggregates",
+        .method = HTTP_GET,
+        .handler = aggregates_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &aggregates_uri);
+
+    httpd_uri_t calibration_get_uri = {
+        .uri = "/api/calibration",
+        .method = HTTP_GET,
+        .handler = calibration_get_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &calibration_get_uri);
+
+    httpd_uri_t calibration_post_uri = {
+        .uri = "/api/calibration",
         .method = HTTP_POST,
-        .handler = save_config_handler,
+        .handler = calibration_post_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &save_config_uri);
+    http_perf_register(server_handle, &calibration_post_uri);
 
-    httpd_uri_t get_config_uri = {
-        .uri = "/get_config",
+    httpd_uri_t coredump_get_uri = {
+        .uri = "/api/coredump",
         .method = HTTP_GET,
-        .handler = get_config_handler,
+        .handler = coredump_get_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &get_config_uri);
+    http_perf_register(server_handle, &coredump_get_uri);
 
-    httpd_uri_t get_metric_uri = {
-        .uri = "/get_metric",
+    httpd_uri_t coredump_delete_uri = {
+        .uri = "/api/coredump",
+        .method = HTTP_DELETE,
+        .handler = coredump_delete_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &coredump_delete_uri);
+
+    // Prometheus scrape target; the handler streams the exposition itself
+    httpd_uri_t metrics_export_uri = {
+        .uri = METRICS_EXPORT_URI,
         .method = HTTP_GET,
-        .handler = get_metric_handler,
+        .handler = metrics_export_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &get_metric_uri);
+    http_perf_register(server_handle, &metrics_export_uri);
+
+    httpd_uri_t log_level_get_uri = {
+        .uri = "/api/log_level",
+        .method = HTTP_GET,
+        .handler = log_level_get_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &log_level_get_uri);
+
+    httpd_uri_t log_level_post_uri = {
+        .uri = "/api/log_level",
+        .method = HTTP_POST,
+        .handler = log_level_post_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &log_level_post_uri);
+
+    httpd_uri_t event_log_uri = {
+        .uri = "/api/log",
+        .method = HTTP_GET,
+        .handler = event_log_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &event_log_uri);
 
     httpd_uri_t get_version_info_uri = {
         .uri = "/get_version_info",
@@ -1338,7 +2227,7 @@ esp_err_t web_server_start(void) {
         .handler = get_version_info_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &get_version_info_uri);
+    http_perf_register(server_handle, &get_version_info_uri);
 
     // OTA API handlers (consolidated)
     httpd_uri_t ota_api_get = {
@@ -1347,7 +2236,7 @@ esp_err_t web_server_start(void) {
         .handler = ota_api_get_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &ota_api_get);
+    http_perf_register(server_handle, &ota_api_get);
 
     httpd_uri_t ota_api_post = {
         .uri = "/api/ota",
@@ -1355,7 +2244,32 @@ esp_err_t web_server_start(void) {
         .handler = ota_api_post_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &ota_api_post);
+    http_perf_register(server_handle, &ota_api_post);
+
+    httpd_uri_t ota_backup_get = {
+        .uri = "/api/ota/backup",
+        .method = HTTP_GET,
+        .handler = ota_backup_get_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &ota_backup_get);
+
+    // Resumable chunked uploads
+    httpd_uri_t ota_chunk_get = {
+        .uri = "/api/ota/chunk",
+        .method = HTTP_GET,
+        .handler = ota_chunk_get_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &ota_chunk_get);
+
+    httpd_uri_t ota_chunk_put = {
+        .uri = "/api/ota/chunk",
+        .method = HTTP_PUT,
+        .handler = ota_chunk_put_handler,
+        .user_ctx = NULL
+    };
+    http_perf_register(server_handle, &ota_chunk_put);
 
     // Also register HEAD handler for get_config so HEAD probes (connectivity checks) succeed
     httpd_uri_t get_config_head_uri = {
@@ -1364,7 +2278,7 @@ esp_err_t web_server_start(void) {
         .handler = get_config_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &get_config_head_uri);
+    http_perf_register(server_handle, &get_config_head_uri);
 
     // Also register POST handler for get_config (some clients may use POST)
     httpd_uri_t get_config_post_uri = {
@@ -1373,34 +2287,10 @@ esp_err_t web_server_start(void) {
         .handler = get_config_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server_handle, &get_config_post_uri);
+    http_perf_register(server_handle, &get_config_post_uri);
 
-    // Captive portal detection handlers
-    httpd_uri_t hotspot_detect_uri = {
-        .uri = "/hotspot-detect.html",
-        .method = HTTP_GET,
-        .handler = captive_portal_redirect_handler,
-        .user_ctx = NULL
-    };
-    httpd_register_uri_handler(server_handle, &hotspot_detect_uri);
-
-    httpd_uri_t generate_204_uri = {
-        .uri = "/generate_204",
-        .method = HTTP_GET,
-        .handler = captive_portal_redirect_handler,
-        .user_ctx = NULL
-    };
-    httpd_register_uri_handler(server_handle, &generate_204_uri);
-
-    // Wildcard handler for any other requests (must be last)
-    httpd_uri_t wildcard_uri = {
-        .uri = "/*",
-        .method = HTTP_GET,
-        .handler = captive_portal_redirect_handler,
-        .user_ctx = NULL
-    };
-    httpd_register_uri_handler(server_handle, &wildcard_uri);
-    ESP_LOGI(TAG, "Registered wildcard handler for /*");
+    // Captive portal probes and any other unknown URI are resolved via the routing table
+    httpd_register_err_handler(server_handle, HTTPD_404_NOT_FOUND, not_found_handler);
 
     // Initialize OTA manager
     esp_err_t ota_ret = ota_manager_init();
@@ -1410,7 +2300,7 @@ esp_err_t web_server_start(void) {
         ESP_LOGI(TAG, "OTA manager initialized successfully");
     }
 
-    ESP_LOGI(TAG, "Web server started successfully on port %d", WEB_SERVER_PORT);
+    ESP_LOGI(TAG, "Web server started successfully on port %u", (unsigned)config.server_port);
     ESP_LOGI(TAG, "=== WEB SERVER START COMPLETED ===");
     return ESP_OK;
 }
@@ -1422,10 +2312,14 @@ esp_err_t web_server_stop(void) {
     }
 
     ESP_LOGI(TAG, "Stopping web server...");
+    metrics_stream_stop();
+    signalk_unregister();
+    http_session_stop();
 
-    esp_err_t ret = httpd_stop(server_handle);
+    esp_err_t ret = HTTPS_PORTAL != 0 ? https_portal_stop(server_handle) : httpd_stop(server_handle);
     if (ret == ESP_OK) {
         server_handle = NULL;
+        http_perf_clear();
         ESP_LOGI(TAG, "Web server stopped successfully");
     } else {
         ESP_LOGE(TAG, "Failed to stop web server: %s", esp_err_to_name(ret));
@@ -12,33 +12,315 @@
 // =============================
 #include "wifi_ap.h"
 #include "nvs_utils.h"
+#include "dns_server.h"
 #include "version.h"
+#include <stdio.h>
 #include <string.h>
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_timer.h"
 #include "esp_log.h"
+#include "sdkconfig.h"
 
 // =============================
 // Constants & Definitions
 // =============================
 // Register wifi_ap.c version
 REGISTER_VERSION(WifiAp, "1.0.0", "2025-10-18");
+
+// A node wakes into wifi_espnow_init() every cycle; without the stored calibration each wake pays a full one
+#if !CONFIG_ESP_PHY_CALIBRATION_AND_DATA_STORAGE
+#warning "CONFIG_ESP_PHY_CALIBRATION_AND_DATA_STORAGE is off: every node wake runs a full PHY calibration"
+#endif
 static const char *TAG = "WIFI_AP";
 static bool ap_running = false;
+static bool radio_only = false;                 // Started by wifi_espnow_init() alone
+
+// Bridge uplink; events arrive on the event task, retries on the esp_timer task
+static esp_netif_t *ap_netif = NULL;
+static esp_netif_t *sta_netif = NULL;
+static esp_event_handler_instance_t wifi_handler = NULL;
+static esp_event_handler_instance_t ip_handler = NULL;
+static esp_timer_handle_t retry_timer = NULL;
+static char bridge_ssid[BRIDGE_SSID_MAX_LEN];
+static char bridge_password[BRIDGE_PASS_MAX_LEN];
+static nvs_sta_cache_t sta_cache;
+static wifi_sta_status_t sta_status;
+static uint32_t backoff_ms = STA_BACKOFF_MIN_MS;
+static bool use_cache;                          // Next attempt goes straight to the cached BSSID/channel
+static int64_t attempt_start_us;
+static portMUX_TYPE sta_lock = portMUX_INITIALIZER_UNLOCKED;
+
+typedef struct {
+    const char *name;
+    uint16_t beacon_tu;
+    uint8_t dtim;
+    uint8_t max_connections;
+    uint16_t inactive_s;
+    uint16_t listen_interval;
+    wifi_ps_type_t sta_ps;                      // Station-only mode; APSTA always runs WIFI_PS_NONE
+} radio_profile_t;
+
+static const radio_profile_t PROFILES[] = {
+    [WIFI_PROFILE_PORTAL_FAST] = { "portal-fast", WIFI_FAST_BEACON_TU, WIFI_FAST_DTIM, AP_MAX_CONNECTIONS,
+                                   WIFI_FAST_INACTIVE_S, WIFI_FAST_LISTEN_INTERVAL, WIFI_PS_NONE },
+    [WIFI_PROFILE_LOW_POWER] = { "low-power", WIFI_LOW_BEACON_TU, WIFI_LOW_DTIM, WIFI_LOW_MAX_CONNECTIONS,
+                                 WIFI_LOW_INACTIVE_S, WIFI_LOW_LISTEN_INTERVAL, WIFI_PS_MAX_MODEM },
+};
+static const radio_profile_t *profile = &PROFILES[WIFI_PROFILE_PORTAL_FAST];
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t wifi_driver_init(bool netif);
+static void load_bridge_config(void);
+static esp_err_t sta_setup(void);
+static void sta_connect(void);
+static void sta_schedule_retry(void);
+static void sta_retry_cb(void *arg);
+static void sta_got_ip(const ip_event_got_ip_t *evt);
+static void sta_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data);
+static void apply_profile_live(void);
 
 // =============================
 // Function Definitions
 // =============================
 
-esp_err_t wifi_ap_init(void) {
-    ESP_LOGI(TAG, "Initializing WiFi Access Point...");
+/**
+ * @brief Create the STA netif, retry timer and event handlers for the bridge uplink
+ */
+static esp_err_t sta_setup(void) {
+    sta_netif = esp_netif_create_default_wifi_sta();
 
-    // Initialize the underlying TCP/IP stack
-    esp_err_t ret = esp_netif_init();
+    const esp_timer_create_args_t timer_args = {
+        .callback = sta_retry_cb,
+        .name = "sta_retry",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &retry_timer);
+    if (ret == ESP_OK) {
+        ret = esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, sta_event_handler, NULL,
+                                                  &wifi_handler);
+    }
+    if (ret == ESP_OK) {
+        ret = esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, sta_event_handler, NULL,
+                                                  &ip_handler);
+    }
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize netif: %s", esp_err_to_name(ret));
-        return ret;
+        ESP_LOGE(TAG, "Failed to set up bridge uplink: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+/**
+ * @brief Start one association attempt, at the cached BSSID/channel or by full scan
+ */
+static void sta_connect(void) {
+    wifi_config_t sta_config = { 0 };
+    strlcpy((char *)sta_config.sta.ssid, bridge_ssid, sizeof(sta_config.sta.ssid));
+    strlcpy((char *)sta_config.sta.password, bridge_password, sizeof(sta_config.sta.password));
+    sta_config.sta.pmf_cfg.capable = true;
+    sta_config.sta.listen_interval = profile->listen_interval;
+
+    bool fast = use_cache && sta_cache.channel != 0;
+    if (fast) {
+        // Probe one channel for one BSSID: a few hundred ms instead of a scan of all 13
+        sta_config.sta.bssid_set = true;
+        memcpy(sta_config.sta.bssid, sta_cache.bssid, sizeof(sta_config.sta.bssid));
+        sta_config.sta.channel = sta_cache.channel;
+        sta_config.sta.scan_method = WIFI_FAST_SCAN;
+    } else {
+        sta_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        sta_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+        sta_config.sta.threshold.rssi = STA_RSSI_THRESHOLD;
+    }
+
+    portENTER_CRITICAL(&sta_lock);
+    sta_status.state = WIFI_STA_CONNECTING;
+    sta_status.fast_connect = fast;
+    sta_status.retry_in_ms = 0;
+    sta_status.attempts++;
+    portEXIT_CRITICAL(&sta_lock);
+    attempt_start_us = esp_timer_get_time();
+
+    esp_err_t ret = esp_wifi_set_config(WIFI_IF_STA, &sta_config);
+    if (ret == ESP_OK) {
+        ret = esp_wifi_connect();
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Uplink connect failed to start: %s", esp_err_to_name(ret));
+        sta_schedule_retry();
+        return;
+    }
+    ESP_LOGI(TAG, "Connecting to uplink '%s' (%s)", bridge_ssid,
+             fast ? "cached BSSID and channel" : "full scan");
+}
+
+/**
+ * @brief Retry after the current backoff plus up to 25% jitter, then double it
+ */
+static void sta_schedule_retry(void) {
+    uint32_t delay_ms = backoff_ms + esp_random() % (backoff_ms / 4 + 1);
+    backoff_ms = backoff_ms * 2 > STA_BACKOFF_MAX_MS ? STA_BACKOFF_MAX_MS : backoff_ms * 2;
+
+    portENTER_CRITICAL(&sta_lock);
+    sta_status.state = WIFI_STA_BACKOFF;
+    sta_status.retry_in_ms = delay_ms;
+    portEXIT_CRITICAL(&sta_lock);
+
+    esp_timer_stop(retry_timer);
+    esp_timer_start_once(retry_timer, (uint64_t)delay_ms * 1000);
+    ESP_LOGI(TAG, "Retrying uplink in %lu ms", (unsigned long)delay_ms);
+}
+
+static void sta_retry_cb(void *arg) {
+    if (sta_status.state == WIFI_STA_BACKOFF) {
+        sta_connect();
+    }
+}
+
+/**
+ * @brief Uplink is up: remember where it is, forward DNS and NAT the AP through it
+ */
+static void sta_got_ip(const ip_event_got_ip_t *evt) {
+    uint32_t connect_ms = (uint32_t)((esp_timer_get_time() - attempt_start_us) / 1000);
+    backoff_ms = STA_BACKOFF_MIN_MS;
+    use_cache = true;
+
+    wifi_ap_record_t ap_info;
+    uint8_t channel = 0;
+    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        channel = ap_info.primary;
+        // Written only when the uplink moved, so reconnects cost no flash writes
+        if (channel != sta_cache.channel || memcmp(ap_info.bssid, sta_cache.bssid, sizeof(sta_cache.bssid)) != 0 ||
+            strcmp(sta_cache.ssid, bridge_ssid) != 0) {
+            strlcpy(sta_cache.ssid, bridge_ssid, sizeof(sta_cache.ssid));
+            memcpy(sta_cache.bssid, ap_info.bssid, sizeof(sta_cache.bssid));
+            sta_cache.channel = channel;
+            nvs_store_sta_cache(&sta_cache);
+        }
+    }
+
+    portENTER_CRITICAL(&sta_lock);
+    sta_status.state = WIFI_STA_CONNECTED;
+    sta_status.ip = evt->ip_info.ip.addr;
+    sta_status.channel = channel;
+    sta_status.connect_ms = connect_ms;
+    bool fast = sta_status.fast_connect;
+    portEXIT_CRITICAL(&sta_lock);
+
+    ESP_LOGI(TAG, "Uplink connected in %lu ms (%s), IP " IPSTR ", channel %u", (unsigned long)connect_ms,
+             fast ? "fast" : "scan", IP2STR(&evt->ip_info.ip), channel);
+
+    // AP clients resolve through us; hand everything but the portal names to the uplink's resolver
+    esp_netif_dns_info_t dns;
+    if (esp_netif_get_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK && dns.ip.u_addr.ip4.addr != 0) {
+        char upstream[16];
+        snprintf(upstream, sizeof(upstream), IPSTR, IP2STR(&dns.ip.u_addr.ip4));
+        dns_server_set_mode(DNS_MODE_FORWARD, upstream);
+    }
+
+#if CONFIG_LWIP_IPV4_NAPT
+    if (ap_netif != NULL && esp_netif_napt_enable(ap_netif) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to enable NAT for AP clients");
+    }
+#endif
+}
+
+static void sta_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    if (sta_status.state == WIFI_STA_DISABLED) {
+        return;
+    }
+
+    if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+        sta_got_ip((const ip_event_got_ip_t *)data);
+    } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_START) {
+        sta_connect();
+    } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_CONNECTED) {
+        const wifi_event_sta_connected_t *evt = (const wifi_event_sta_connected_t *)data;
+        // One radio: the AP moves to the uplink's channel, briefly dropping its clients
+        wifi_config_t ap_config;
+        if (esp_wifi_get_config(WIFI_IF_AP, &ap_config) == ESP_OK && ap_config.ap.channel != evt->channel) {
+            ESP_LOGW(TAG, "AP follows uplink from channel %u to %u", ap_config.ap.channel, evt->channel);
+        }
+    } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
+        const wifi_event_sta_disconnected_t *evt = (const wifi_event_sta_disconnected_t *)data;
+        portENTER_CRITICAL(&sta_lock);
+        bool was_connected = sta_status.state == WIFI_STA_CONNECTED;
+        bool was_fast = sta_status.fast_connect;
+        sta_status.disconnects++;
+        sta_status.last_reason = evt->reason;
+        sta_status.ip = 0;
+        portEXIT_CRITICAL(&sta_lock);
+        ESP_LOGW(TAG, "Uplink disconnected, reason %u", evt->reason);
+
+        if (was_connected) {
+            // Back to answering locally until the uplink returns
+            dns_server_set_mode(DNS_MODE_HIJACK, NULL);
+            // The AP most likely rebooted in place: go straight back to it
+            use_cache = true;
+            sta_connect();
+        } else if (was_fast) {
+            // The cached AP is gone or moved: scan at once rather than wait
+            use_cache = false;
+            sta_connect();
+        } else {
+            sta_schedule_retry();
+        }
+    }
+}
+
+/**
+ * @brief Apply the parts of the profile a started radio can change without a restart
+ */
+static void apply_profile_live(void) {
+    if (ap_running) {
+        esp_err_t ret = esp_wifi_set_inactive_time(WIFI_IF_AP, profile->inactive_s);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "AP inactivity timeout not set: %s", esp_err_to_name(ret));
+        }
+    }
+    // Modem sleep only for a station on its own: the AP has to beacon on time
+    wifi_ps_type_t ps = ap_running ? WIFI_PS_NONE : profile->sta_ps;
+    if (sta_status.state != WIFI_STA_DISABLED || ap_running) {
+        esp_err_t ret = esp_wifi_set_ps(ps);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Power save not set: %s", esp_err_to_name(ret));
+        }
+    }
+}
+
+void wifi_set_profile(wifi_profile_t p) {
+    if ((unsigned)p >= sizeof(PROFILES) / sizeof(PROFILES[0])) {
+        return;
+    }
+    profile = &PROFILES[p];
+    if (ap_running || sta_status.state != WIFI_STA_DISABLED) {
+        apply_profile_live();
+        ESP_LOGI(TAG, "Radio profile %s", profile->name);
+    }
+}
+
+const char *wifi_profile_name(wifi_profile_t p) {
+    return (unsigned)p < sizeof(PROFILES) / sizeof(PROFILES[0]) ? PROFILES[p].name : "unknown";
+}
+
+/**
+ * @brief Bring up the default event loop and WiFi driver, and the TCP/IP stack if asked
+ *
+ * @param netif false for ESP-NOW alone: no TCP/IP stack, and the driver
+ *              skips reading its saved config from NVS, which nothing uses
+ */
+static esp_err_t wifi_driver_init(bool netif) {
+    esp_err_t ret;
+    if (netif) {
+        // Initialize the underlying TCP/IP stack
+        ret = esp_netif_init();
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to initialize netif: %s", esp_err_to_name(ret));
+            return ret;
+        }
     }
 
     // Create default event loop if not already created
@@ -48,34 +330,83 @@ esp_err_t wifi_ap_init(void) {
         return ret;
     }
 
-    // Create default WiFi AP
-    esp_netif_create_default_wifi_ap();
-
     // Initialize WiFi driver
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    if (!netif) {
+        cfg.nvs_enable = 0;
+    }
     ret = esp_wifi_init(&cfg);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize WiFi: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    // Load WiFi password from NVS
-    char wifi_password[WIFI_PASS_MAX_LEN];
-    ret = nvs_load_wifi_password(wifi_password, sizeof(wifi_password));
+    // The config is set on every boot and every uplink attempt; keep it out of flash
+    esp_wifi_set_storage(WIFI_STORAGE_RAM);
+    return ESP_OK;
+}
+
+/**
+ * @brief Load the cached BSSID/channel, dropping it if it is for another SSID
+ */
+static void load_bridge_config(void) {
+    nvs_load_sta_cache(&sta_cache);
+    if (strcmp(sta_cache.ssid, bridge_ssid) != 0) {
+        memset(&sta_cache, 0, sizeof(sta_cache));
+    }
+    use_cache = true;
+}
+
+esp_err_t wifi_ap_init(void) {
+    ESP_LOGI(TAG, "Initializing WiFi Access Point...");
+
+    esp_err_t ret = wifi_driver_init(true);
     if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Create default WiFi AP
+    ap_netif = esp_netif_create_default_wifi_ap();
+
+    // Load WiFi password from the config cache
+    char wifi_password[WIFI_PASS_MAX_LEN];
+    device_config_t device_cfg;
+    ret = nvs_config_get(&device_cfg);
+    if (ret == ESP_OK) {
+        strcpy(wifi_password, device_cfg.wifi_password);
+        strlcpy(bridge_ssid, device_cfg.bridge_ssid, sizeof(bridge_ssid));
+        strlcpy(bridge_password, device_cfg.bridge_password, sizeof(bridge_password));
+    } else {
         ESP_LOGW(TAG, "Failed to load WiFi password from NVS, using default");
         strcpy(wifi_password, AP_DEFAULT_PASSWORD);
     }
 
+    // A bridge SSID turns on the uplink; the cache only counts if it is for that SSID
+    bool sta_enabled = bridge_ssid[0] != '\0';
+    uint8_t ap_channel = AP_CHANNEL;
+    if (sta_enabled) {
+        load_bridge_config();
+        if (sta_cache.channel != 0) {
+            ap_channel = sta_cache.channel;     // Start where the uplink will pull the radio anyway
+        }
+        ret = sta_setup();
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        sta_status.state = WIFI_STA_CONNECTING;
+    }
+
     // Configure AP settings
     wifi_config_t ap_config = {
         .ap = {
             .ssid = AP_SSID,
             .ssid_len = strlen(AP_SSID),
-            .channel = AP_CHANNEL,
+            .channel = ap_channel,
             .password = "",
-            .max_connection = AP_MAX_CONNECTIONS,
-            .authmode = WIFI_AUTH_WPA_WPA2_PSK
+            .max_connection = profile->max_connections,
+            .authmode = WIFI_AUTH_WPA_WPA2_PSK,
+            .beacon_interval = profile->beacon_tu,
+            .dtim_period = profile->dtim,
         }
     };
 
@@ -88,8 +419,8 @@ esp_err_t wifi_ap_init(void) {
         ap_config.ap.authmode = WIFI_AUTH_OPEN;
     }
 
-    // Set WiFi mode to Access Point
-    ret = esp_wifi_set_mode(WIFI_MODE_AP);
+    // Access Point, plus the station when there is an uplink to join
+    ret = esp_wifi_set_mode(sta_enabled ? WIFI_MODE_APSTA : WIFI_MODE_AP);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set WiFi mode: %s", esp_err_to_name(ret));
         return ret;
@@ -110,27 +441,113 @@ esp_err_t wifi_ap_init(void) {
     }
 
     ap_running = true;
+    apply_profile_live();
     ESP_LOGI(TAG, "WiFi Access Point started successfully");
     ESP_LOGI(TAG, "SSID: %s", AP_SSID);
-    ESP_LOGI(TAG, "Channel: %d", AP_CHANNEL);
-    ESP_LOGI(TAG, "Max connections: %d", AP_MAX_CONNECTIONS);
+    ESP_LOGI(TAG, "Channel: %d", ap_channel);
+    if (sta_enabled) {
+        ESP_LOGI(TAG, "Uplink: %s", bridge_ssid);
+    }
+    ESP_LOGI(TAG, "Max connections: %d", profile->max_connections);
+    ESP_LOGI(TAG, "Profile: %s (beacon %u TU, DTIM %u, idle stations dropped after %u s)", profile->name,
+             profile->beacon_tu, profile->dtim, profile->inactive_s);
     ESP_LOGI(TAG, "IP: 192.168.4.1");
 
     return ESP_OK;
 }
 
+esp_err_t wifi_sta_init(void) {
+    ESP_LOGI(TAG, "Initializing WiFi uplink (station only)...");
+
+    device_config_t device_cfg;
+    if (nvs_config_get(&device_cfg) != ESP_OK || device_cfg.bridge_ssid[0] == '\0') {
+        ESP_LOGW(TAG, "No bridge SSID configured - uplink not started");
+        return ESP_ERR_INVALID_STATE;
+    }
+    strlcpy(bridge_ssid, device_cfg.bridge_ssid, sizeof(bridge_ssid));
+    strlcpy(bridge_password, device_cfg.bridge_password, sizeof(bridge_password));
+
+    esp_err_t ret = wifi_driver_init(true);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    load_bridge_config();
+    ret = sta_setup();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    sta_status.state = WIFI_STA_CONNECTING;
+
+    ret = esp_wifi_set_mode(WIFI_MODE_STA);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set WiFi mode: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // WIFI_EVENT_STA_START kicks off the first attempt
+    ret = esp_wifi_start();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start WiFi: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    apply_profile_live();
+    ESP_LOGI(TAG, "Uplink: %s (%s, %s)", bridge_ssid, profile->name,
+             profile->sta_ps == WIFI_PS_NONE ? "modem awake" : "modem sleep");
+    return ESP_OK;
+}
+
+esp_err_t wifi_espnow_init(uint8_t channel) {
+    if (ap_running || radio_only || sta_status.state != WIFI_STA_DISABLED) {
+        return ESP_OK;                          // Already up; ESP-NOW follows its channel
+    }
+
+    esp_err_t ret = wifi_driver_init(false);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = esp_wifi_set_mode(WIFI_MODE_STA);
+    if (ret == ESP_OK) {
+        ret = esp_wifi_start();
+    }
+    if (ret == ESP_OK) {
+        ret = esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the radio for ESP-NOW: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    radio_only = true;
+    ESP_LOGI(TAG, "Radio up for ESP-NOW on channel %u", channel);
+    return ESP_OK;
+}
+
 bool wifi_ap_is_running(void) {
     return ap_running;
 }
 
 esp_err_t wifi_ap_stop(void) {
-    if (!ap_running) {
+    if (!ap_running && !radio_only && sta_status.state == WIFI_STA_DISABLED) {
         ESP_LOGW(TAG, "WiFi AP is not running");
         return ESP_OK;
     }
 
     ESP_LOGI(TAG, "Stopping WiFi Access Point...");
 
+    if (sta_status.state != WIFI_STA_DISABLED) {
+        sta_status.state = WIFI_STA_DISABLED;   // Ignore the disconnect that stopping causes
+        esp_timer_stop(retry_timer);
+        esp_timer_delete(retry_timer);
+        retry_timer = NULL;
+        esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_handler);
+        esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, ip_handler);
+        wifi_handler = NULL;
+        ip_handler = NULL;
+        dns_server_set_mode(DNS_MODE_HIJACK, NULL);
+    }
+
     esp_err_t ret = esp_wifi_stop();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to stop WiFi: %s", esp_err_to_name(ret));
@@ -143,8 +560,37 @@ esp_err_t wifi_ap_stop(void) {
         return ret;
     }
 
+    // wifi_ap_init() creates them again, under the same default keys
+    if (ap_netif != NULL) {
+        esp_netif_destroy_default_wifi(ap_netif);
+        ap_netif = NULL;
+    }
+    if (sta_netif != NULL) {
+        esp_netif_destroy_default_wifi(sta_netif);
+        sta_netif = NULL;
+    }
+
     ap_running = false;
+    radio_only = false;
     ESP_LOGI(TAG, "WiFi Access Point stopped successfully");
 
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+void wifi_ap_get_sta_status(wifi_sta_status_t *status) {
+    portENTER_CRITICAL(&sta_lock);
+    *status = sta_status;
+    portEXIT_CRITICAL(&sta_lock);
+}
+
+uint8_t wifi_ap_station_count(void) {
+    wifi_sta_list_t list;
+    if (!ap_running || esp_wifi_ap_get_sta_list(&list) != ESP_OK) {
+        return 0;
+    }
+    return (uint8_t)list.num;
+}
+
+bool wifi_ap_sta_is_connected(void) {
+    return sta_status.state == WIFI_STA_CONNECTED;
+}
@@ -0,0 +1,483 @@
+/**
+ * @file wind.c
+ * @brief Anemometer pulse counting on the PCNT peripheral, wind vane on ADC1, gust and sliding averages
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "wind.h"
+#include "adc_stream.h"
+#include "calib.h"
+#include "version.h"
+#include "power_profile.h"
+#include "SystemMetrics.h"
+#include <math.h>
+#include <string.h>
+#include <sys/param.h>
+#include "driver/gpio.h"
+#include "soc/soc_caps.h"
+#if SOC_PCNT_SUPPORTED
+#include "driver/pulse_cnt.h"
+#else
+#include "iram_profile.h"
+#endif
+#include "esp_adc/adc_oneshot.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+// Register wind.c version
+REGISTER_VERSION(Wind, "1.0.0", "2026-10-15");
+
+static const char *TAG = "WIND";
+
+#define TICKS_PER_S (1000 / WIND_TICK_MS)
+#define GUST_TICKS (WIND_GUST_S * TICKS_PER_S)
+#define VANE_UNIT 1000                          // Unit vector scale in the direction sums
+#define ADC_FULL_SCALE 4096
+
+#if SOC_PCNT_SUPPORTED
+static pcnt_unit_handle_t pcnt_unit = NULL;
+static pcnt_channel_handle_t pcnt_chan = NULL;
+#else
+static volatile uint32_t edge_count = 0;        // Closures counted by edge_isr()
+static int64_t last_edge_us = INT64_MIN / 2;
+static bool edge_isr_added = false;
+#endif
+static adc_oneshot_unit_handle_t adc_unit = NULL;
+static bool vane_streamed = false;              // The vane's channel is in the ADC stream
+static uint8_t vane_id;
+static esp_timer_handle_t tick_timer = NULL;
+static bool running = false;
+static portMUX_TYPE wind_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Timer callback state (esp_timer task)
+static int last_count = 0;
+static uint8_t tick_in_s = 0;
+static uint32_t pulses_this_s = 0;
+static uint32_t gust_max_this_s = 0;            // Highest 3 s sum seen during this second
+
+/**
+ * @brief Ring buffers and their running sums; each update adds the newest entry and drops the oldest
+ */
+typedef struct {
+    uint32_t pulses;
+    uint16_t ticks[GUST_TICKS];                 // Pulses per tick, last WIND_GUST_S
+    uint8_t tick_pos;
+    uint32_t gust_sum;
+    uint16_t secs[WIND_LONG_AVG_S];             // Pulses per second, last WIND_LONG_AVG_S
+    int16_t vane_x[WIND_LONG_AVG_S];            // Vane unit vector per second, x VANE_UNIT (0, 0 without a reading)
+    int16_t vane_y[WIND_LONG_AVG_S];
+    uint16_t sec_pos;
+    uint32_t seconds;                           // Since wind_start()
+    uint32_t short_sum;
+    uint32_t long_sum;
+    int32_t short_x, short_y;
+    int32_t long_x, long_y;
+    int16_t dir_now;
+    // Gust: 3 s sums per second in decreasing order, with the second each was taken in
+    uint16_t dq_val[WIND_LONG_AVG_S];
+    uint32_t dq_sec[WIND_LONG_AVG_S];
+    uint16_t dq_head;
+    uint16_t dq_len;
+} wind_state_t;
+
+static wind_state_t state;
+
+// =============================
+// Function Prototypes
+// =============================
+#if !SOC_PCNT_SUPPORTED
+static HOT_IRAM_ATTR void edge_isr(void *arg);
+#endif
+static esp_err_t counter_start(void);
+static bool counter_read(int *count);
+static void counter_release(void);
+static void tick_cb(void *arg);
+static bool read_vane(int16_t *deg);
+static void add_second(uint32_t pulses, uint32_t gust_sum, bool vane_ok, int16_t deg);
+static uint16_t pulses_to_cmps(uint32_t pulses, uint32_t seconds);
+static int16_t vector_dir(int32_t x, int32_t y);
+static void release(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+#if SOC_PCNT_SUPPORTED
+/**
+ * @brief Count falling edges (switch closures); the watch point lets the driver accumulate past the hardware limit
+ */
+static esp_err_t counter_start(void) {
+    pcnt_unit_config_t unit_cfg = {
+        .low_limit = -1,
+        .high_limit = WIND_PCNT_HIGH_LIMIT,
+        .flags.accum_count = 1,
+    };
+    pcnt_glitch_filter_config_t filter_cfg = { .max_glitch_ns = WIND_PCNT_GLITCH_NS };
+    pcnt_chan_config_t chan_cfg = {
+        .edge_gpio_num = WIND_ANEMOMETER_GPIO,
+        .level_gpio_num = -1,
+    };
+    esp_err_t err = pcnt_new_unit(&unit_cfg, &pcnt_unit);
+    if (err == ESP_OK) {
+        err = pcnt_unit_set_glitch_filter(pcnt_unit, &filter_cfg);
+    }
+    if (err == ESP_OK) {
+        err = pcnt_new_channel(pcnt_unit, &chan_cfg, &pcnt_chan);
+    }
+    if (err == ESP_OK) {
+        err = pcnt_channel_set_edge_action(pcnt_chan, PCNT_CHANNEL_EDGE_ACTION_HOLD,
+                                           PCNT_CHANNEL_EDGE_ACTION_INCREASE);
+    }
+    if (err == ESP_OK) {
+        err = pcnt_unit_add_watch_point(pcnt_unit, WIND_PCNT_HIGH_LIMIT);
+    }
+    if (err == ESP_OK) {
+        gpio_pullup_en(WIND_ANEMOMETER_GPIO);
+        err = pcnt_unit_enable(pcnt_unit);
+    }
+    if (err == ESP_OK) {
+        err = pcnt_unit_clear_count(pcnt_unit);
+    }
+    if (err == ESP_OK) {
+        err = pcnt_unit_start(pcnt_unit);
+    }
+    return err;
+}
+
+static bool counter_read(int *count) {
+    return pcnt_unit_get_count(pcnt_unit, count) == ESP_OK;
+}
+
+static void counter_release(void) {
+    if (pcnt_unit != NULL) {
+        pcnt_unit_stop(pcnt_unit);
+        pcnt_unit_disable(pcnt_unit);
+    }
+    if (pcnt_chan != NULL) {
+        pcnt_del_channel(pcnt_chan);
+        pcnt_chan = NULL;
+    }
+    if (pcnt_unit != NULL) {
+        pcnt_del_unit(pcnt_unit);
+        pcnt_unit = NULL;
+    }
+}
+#else
+/**
+ * @brief A closure: count it unless it is bounce from the last one; in IRAM with IRAM_HOT_PATHS, as the rain gauge's
+ */
+static HOT_IRAM_ATTR void edge_isr(void *arg) {
+    int64_t now_us = esp_timer_get_time();
+    if (now_us - last_edge_us >= (int64_t)WIND_EDGE_LOCKOUT_US) {
+        edge_count = edge_count + 1;
+        last_edge_us = now_us;
+    }
+}
+
+/**
+ * @brief No PCNT on this chip: a falling-edge interrupt per closure instead
+ */
+static esp_err_t counter_start(void) {
+    gpio_config_t io = {
+        .pin_bit_mask = 1ULL << WIND_ANEMOMETER_GPIO,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    edge_count = 0;
+    esp_err_t err = gpio_config(&io);
+    if (err == ESP_OK) {
+        // The first install sets the service's flags (the rain gauge and boot button install it too)
+        err = gpio_install_isr_service(HOT_INTR_FLAGS);
+        if (err == ESP_ERR_INVALID_STATE) {
+            err = ESP_OK;
+        }
+    }
+    if (err == ESP_OK) {
+        err = gpio_isr_handler_add(WIND_ANEMOMETER_GPIO, edge_isr, NULL);
+        edge_isr_added = err == ESP_OK;
+    }
+    return err;
+}
+
+static bool counter_read(int *count) {
+    *count = (int)edge_count;                   // One aligned word; the tick takes the difference, so wrapping is fine
+    return true;
+}
+
+static void counter_release(void) {
+    if (edge_isr_added) {
+        gpio_isr_handler_remove(WIND_ANEMOMETER_GPIO);
+        gpio_set_intr_type(WIND_ANEMOMETER_GPIO, GPIO_INTR_DISABLE);
+        edge_isr_added = false;
+    }
+}
+#endif
+
+/**
+ * @brief esp_timer task: take the pulses since the last tick; once a second also read the vane
+ */
+static void tick_cb(void *arg) {
+    int count = 0;
+    if (!counter_read(&count)) {
+        return;                                 // The next tick picks these pulses up
+    }
+    uint32_t delta = (uint32_t)(count - last_count);
+    last_count = count;
+    if (delta > UINT16_MAX) {
+        delta = UINT16_MAX;
+    }
+
+    bool second_done = ++tick_in_s >= TICKS_PER_S;
+    int16_t deg = -1;
+    bool vane_ok = second_done && read_vane(&deg);
+
+    portENTER_CRITICAL(&wind_lock);
+    state.pulses += delta;
+    state.gust_sum += delta - state.ticks[state.tick_pos];
+    state.ticks[state.tick_pos] = (uint16_t)delta;
+    state.tick_pos = (uint8_t)((state.tick_pos + 1) % GUST_TICKS);
+    portEXIT_CRITICAL(&wind_lock);
+
+    pulses_this_s += delta;
+    if (state.gust_sum > gust_max_this_s) {
+        gust_max_this_s = state.gust_sum;
+    }
+    if (second_done) {
+        add_second(pulses_this_s, gust_max_this_s, vane_ok, deg);
+        tick_in_s = 0;
+        pulses_this_s = 0;
+        gust_max_this_s = 0;
+    }
+}
+
+/**
+ * @brief The vane angle: the ADC stream's latest frame mean, or WIND_VANE_OVERSAMPLE conversions averaged
+ *
+ * Without the stream SystemMetrics reads the same unit; a conversion that
+ * finds the unit busy fails at once instead of blocking and is left out of
+ * the average.
+ */
+static bool read_vane(int16_t *deg) {
+    int32_t mean;
+    if (vane_streamed) {
+        adc_stream_value_t v;
+        if (!adc_stream_get(vane_id, &v) || esp_timer_get_time() - v.time_us > (int64_t)WIND_TICK_MS * 1000) {
+            return false;                       // No frame yet, or the stream stopped
+        }
+        mean = v.raw;
+    } else {
+        if (adc_unit == NULL) {
+            return false;
+        }
+        int32_t sum = 0;
+        int n = 0;
+        for (int i = 0; i < WIND_VANE_OVERSAMPLE; i++) {
+            int raw;
+            if (adc_oneshot_read(adc_unit, WIND_VANE_ADC_CHANNEL, &raw) == ESP_OK) {
+                sum += raw;
+                n++;
+            }
+        }
+        if (n == 0) {
+            return false;
+        }
+        mean = sum / n;
+    }
+    int32_t d10 = calib_apply(CALIB_VANE, mean);  // 0.1 degree, the mounting offset included
+    *deg = (int16_t)((((d10 + 5) / 10) % 360 + 360) % 360);
+    return true;
+}
+
+/**
+ * @brief Push one second into the rings: O(1) sums, amortised O(1) gust deque
+ */
+static void add_second(uint32_t pulses, uint32_t gust_sum, bool vane_ok, int16_t deg) {
+    int16_t x = 0;
+    int16_t y = 0;
+    if (vane_ok) {
+        float rad = (float)deg * (float)M_PI / 180.0f;
+        x = (int16_t)lroundf(cosf(rad) * VANE_UNIT);
+        y = (int16_t)lroundf(sinf(rad) * VANE_UNIT);
+    }
+    if (pulses > UINT16_MAX) {
+        pulses = UINT16_MAX;
+    }
+
+    portENTER_CRITICAL(&wind_lock);
+    uint16_t pos = state.sec_pos;
+    uint16_t short_old = (uint16_t)((pos + WIND_LONG_AVG_S - WIND_SHORT_AVG_S) % WIND_LONG_AVG_S);
+
+    // Entries not yet written are zero, so the sums need no special case while the rings fill
+    state.long_sum += pulses - state.secs[pos];
+    state.short_sum += pulses - state.secs[short_old];
+    state.long_x += x - state.vane_x[pos];
+    state.long_y += y - state.vane_y[pos];
+    state.short_x += x - state.vane_x[short_old];
+    state.short_y += y - state.vane_y[short_old];
+    state.secs[pos] = (uint16_t)pulses;
+    state.vane_x[pos] = x;
+    state.vane_y[pos] = y;
+    state.sec_pos = (uint16_t)((pos + 1) % WIND_LONG_AVG_S);
+    state.seconds++;
+    if (vane_ok) {
+        state.dir_now = deg;
+    }
+
+    // Gust deque: drop expired values from the front, and from the back the smaller ones, which can never be
+    // the maximum again
+    while (state.dq_len > 0 && state.dq_sec[state.dq_head] + WIND_LONG_AVG_S <= state.seconds) {
+        state.dq_head = (uint16_t)((state.dq_head + 1) % WIND_LONG_AVG_S);
+        state.dq_len--;
+    }
+    while (state.dq_len > 0) {
+        uint16_t back = (uint16_t)((state.dq_head + state.dq_len - 1) % WIND_LONG_AVG_S);
+        if (state.dq_val[back] > gust_sum) {
+            break;
+        }
+        state.dq_len--;
+    }
+    uint16_t slot = (uint16_t)((state.dq_head + state.dq_len) % WIND_LONG_AVG_S);
+    state.dq_val[slot] = (uint16_t)MIN(gust_sum, UINT16_MAX);
+    state.dq_sec[slot] = state.seconds;
+    state.dq_len++;
+    portEXIT_CRITICAL(&wind_lock);
+}
+
+static uint16_t pulses_to_cmps(uint32_t pulses, uint32_t seconds) {
+    if (seconds == 0) {
+        return 0;
+    }
+    int32_t hz_x100 = (int32_t)MIN((uint64_t)pulses * 100 / seconds, INT32_MAX);
+    int32_t cmps = calib_apply(CALIB_ANEMOMETER, hz_x100);
+    return (uint16_t)MAX(0, MIN(cmps, UINT16_MAX));
+}
+
+/**
+ * @brief Direction of a summed unit vector; -1 when the sum is zero (no vane reading)
+ */
+static int16_t vector_dir(int32_t x, int32_t y) {
+    if (x == 0 && y == 0) {
+        return -1;
+    }
+    int deg = (int)lroundf(atan2f((float)y, (float)x) * 180.0f / (float)M_PI);
+    return (int16_t)((deg + 360) % 360);
+}
+
+static void release(void) {
+    if (tick_timer != NULL) {
+        esp_timer_stop(tick_timer);
+        esp_timer_delete(tick_timer);
+        tick_timer = NULL;
+    }
+    counter_release();
+    adc_unit = NULL;                            // Owned by SystemMetrics
+    vane_streamed = false;                      // ... or by the ADC stream
+}
+
+esp_err_t wind_start(void) {
+    if (running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(&state, 0, sizeof(state));
+    state.dir_now = -1;
+    last_count = 0;
+    tick_in_s = 0;
+    pulses_this_s = 0;
+    gust_max_this_s = 0;
+
+    esp_err_t err = counter_start();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Anemometer counter setup failed: %s", esp_err_to_name(err));
+        release();
+        return err;
+    }
+
+    // The vane is optional: without the ADC stream or ADC1 only speed and gust are reported
+    vane_streamed = adc_stream_find(WIND_VANE_ADC_CHANNEL, &vane_id);
+    adc_unit = vane_streamed ? NULL : system_metrics_adc_unit();
+    adc_oneshot_chan_cfg_t adc_cfg = {
+        .bitwidth = ADC_BITWIDTH_12,
+        .atten = ADC_ATTEN_DB_12,
+    };
+    if (!vane_streamed &&
+        (adc_unit == NULL || adc_oneshot_config_channel(adc_unit, WIND_VANE_ADC_CHANNEL, &adc_cfg) != ESP_OK)) {
+        ESP_LOGW(TAG, "Wind vane unavailable (ADC1 not claimed), reporting speed only");
+        adc_unit = NULL;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = tick_cb,
+        .name = "wind",
+    };
+    err = esp_timer_create(&timer_args, &tick_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(tick_timer, WIND_TICK_MS * 1000);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Wind timer failed: %s", esp_err_to_name(err));
+        release();
+        return err;
+    }
+
+    power_profile_acquire(POWER_LOCK_RADIO);    // No light sleep: it would stop the counter
+    running = true;
+    ESP_LOGI(TAG, "Anemometer on GPIO%d, vane on ADC1_CH%d%s", WIND_ANEMOMETER_GPIO, WIND_VANE_ADC_CHANNEL,
+             vane_streamed ? " (streamed)" : adc_unit == NULL ? " (off)" : "");
+    return ESP_OK;
+}
+
+void wind_get(wind_reading_t *reading) {
+    portENTER_CRITICAL(&wind_lock);
+    wind_state_t *s = &state;
+    uint32_t short_s = MIN(s->seconds, WIND_SHORT_AVG_S);
+    uint32_t long_s = MIN(s->seconds, WIND_LONG_AVG_S);
+    *reading = (wind_reading_t){
+        .running = running,
+        .pulses = s->pulses,
+        .speed_3s = pulses_to_cmps(s->gust_sum, WIND_GUST_S),
+        .gust = s->dq_len > 0 ? pulses_to_cmps(s->dq_val[s->dq_head], WIND_GUST_S) : 0,
+        .avg_2min = pulses_to_cmps(s->short_sum, short_s),
+        .avg_10min = pulses_to_cmps(s->long_sum, long_s),
+        .dir_now = s->dir_now,
+        .window_s = (uint16_t)long_s,
+    };
+    int32_t short_x = s->short_x, short_y = s->short_y;
+    int32_t long_x = s->long_x, long_y = s->long_y;
+    portEXIT_CRITICAL(&wind_lock);
+
+    reading->dir_2min = vector_dir(short_x, short_y);
+    reading->dir_10min = vector_dir(long_x, long_y);
+}
+
+void wind_log(void) {
+    wind_reading_t r;
+    wind_get(&r);
+    if (!r.running) {
+        return;
+    }
+    ESP_LOGI(TAG, "Wind %u.%02u m/s (gust %u.%02u), 2 min %u.%02u m/s from %d deg, 10 min %u.%02u m/s from %d deg "
+             "(%u s of data, %lu pulses)", r.speed_3s / 100, r.speed_3s % 100, r.gust / 100, r.gust % 100,
+             r.avg_2min / 100, r.avg_2min % 100, r.dir_2min, r.avg_10min / 100, r.avg_10min % 100, r.dir_10min,
+             r.window_s, (unsigned long)r.pulses);
+}
+
+void wind_stop(void) {
+    if (!running) {
+        return;
+    }
+    release();
+    power_profile_release(POWER_LOCK_RADIO);
+    running = false;
+}
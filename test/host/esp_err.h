@@ -0,0 +1,50 @@
+/**
+ * @file esp_err.h
+ * @brief Stand-in for ESP-IDF's esp_err.h in [env:native] test builds
+ *
+ * Every host-built module needs esp_err_t and the error codes; the
+ * parsers and the telemetry codec need nothing else from ESP-IDF. The
+ * values are ESP-IDF's, so a code a test prints reads the same as one in
+ * a device log. The web handlers and config schema also use the other
+ * stand-ins in this directory (esp_log.h, esp_rom_crc.h, nvs.h).
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESP_ERR_H
+#define ESP_ERR_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Constants & Definitions
+// =============================
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_NOT_SUPPORTED 0x106
+#define ESP_ERR_TIMEOUT 0x107
+#define ESP_ERR_INVALID_RESPONSE 0x108
+#define ESP_ERR_INVALID_CRC 0x109
+#define ESP_ERR_INVALID_VERSION 0x10A
+#define ESP_ERR_INVALID_MAC 0x10B
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_ERR_H
@@ -0,0 +1,39 @@
+/**
+ * @file esp_log.h
+ * @brief Stand-in for ESP-IDF's esp_log.h in [env:native] test builds
+ *
+ * The ESP_LOGx macros keep their printf format checking and print nothing,
+ * so a suite's output is its own; the arguments are still evaluated.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Function Definitions
+// =============================
+static inline __attribute__((format(printf, 2, 3))) void esp_log_host(const char *tag, const char *format, ...) {
+    (void)tag;
+    (void)format;
+}
+
+#define ESP_LOGE(tag, format, ...) esp_log_host(tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) esp_log_host(tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) esp_log_host(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) esp_log_host(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) esp_log_host(tag, format, ##__VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_LOG_H
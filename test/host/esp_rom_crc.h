@@ -0,0 +1,42 @@
+/**
+ * @file esp_rom_crc.h
+ * @brief Stand-in for ESP-IDF's esp_rom_crc.h in [env:native] test builds
+ *
+ * The ROM's little-endian CRC-32, bit by bit: the IEEE 802.3 polynomial,
+ * reflected, with crc inverted on entry and exit, so esp_rom_crc32_le(0, ...)
+ * is the usual CRC-32 and a blob checked here passes on the device.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef ESP_ROM_CRC_H
+#define ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================
+// Function Definitions
+// =============================
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_ROM_CRC_H
@@ -0,0 +1,33 @@
+/**
+ * @file host_compat.h
+ * @brief Force-included in [env:native] builds: what newlib gives the target and a host libc may lack
+ *
+ * strlcpy() is in newlib and in glibc from 2.38; older glibc gets this copy.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef HOST_COMPAT_H
+#define HOST_COMPAT_H
+
+#include <string.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+/**
+ * @brief Copy src into dst of size bytes, always terminated; returns strlen(src)
+ */
+static inline size_t strlcpy(char *dst, const char *src, size_t size) {
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+#endif // HOST_COMPAT_H
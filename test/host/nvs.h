@@ -0,0 +1,24 @@
+/**
+ * @file nvs.h
+ * @brief Stand-in for ESP-IDF's nvs.h in [env:native] test builds
+ *
+ * config_schema.c only checks its key names against NVS_KEY_NAME_MAX_SIZE;
+ * storage goes through nvs_utils.c, which does not build on a host.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+#ifndef NVS_H
+#define NVS_H
+
+#include "esp_err.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+#define NVS_KEY_NAME_MAX_SIZE 16                // Including the terminator, as ESP-IDF
+
+#endif // NVS_H
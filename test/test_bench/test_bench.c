@@ -0,0 +1,292 @@
+/**
+ * @file test_bench.c
+ * @brief Host micro-benchmarks for the pure-C modules: JSON, DNS, multipart, telemetry, BME680 compensation
+ *
+ * Each case times a fixed workload with CLOCK_MONOTONIC and prints ns per
+ * operation; the assertions only check that the work succeeded. Numbers
+ * are for comparing two builds on the same machine, not the target, whose
+ * own suite is src/bench_suite.c. Run with `pio test -e native -f test_bench`.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "bme680_compensate.h"
+#include "dns_packet.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "multipart_reader.h"
+#include "telemetry.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "unity.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+#define BENCH_ITERATIONS 20000
+
+static const uint8_t dns_query[] = {
+    0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    17, 'c', 'o', 'n', 'n', 'e', 'c', 't', 'i', 'v', 'i', 't', 'y', 'c', 'h', 'e', 'c', 'k',
+    7, 'g', 's', 't', 'a', 't', 'i', 'c', 3, 'c', 'o', 'm', 0,
+    0x00, 0x01, 0x00, 0x01,
+};
+
+static const char status_json[] =
+    "{\"device\":\"weather-01\",\"uptimeS\":86400,\"wifi\":{\"ssid\":\"home\",\"rssi\":-61,\"connected\":true},"
+    "\"sensor\":{\"temperature\":21.37,\"pressure\":101325,\"humidity\":48.512,\"gas\":120000},"
+    "\"nodes\":[{\"id\":\"a1b2c3d4\",\"lastS\":12},{\"id\":\"0badf00d\",\"lastS\":59}],\"note\":\"caf\\u00e9\"}";
+
+#define MULTIPART_TYPE "multipart/form-data; boundary=----bench"
+static char multipart_body[8192];
+static size_t multipart_len;
+
+// Coefficients read from a production sensor
+static const bme680_calib_t calib = {
+    .par_t1 = 26203, .par_t2 = 26104, .par_t3 = 3,
+    .par_p1 = 35609, .par_p2 = -10384, .par_p3 = 88, .par_p4 = 6894, .par_p5 = -99, .par_p6 = 30,
+    .par_p7 = 35, .par_p8 = -3418, .par_p9 = -2305, .par_p10 = 30,
+    .par_h1 = 778, .par_h2 = 1003, .par_h3 = 0, .par_h4 = 45, .par_h5 = 20, .par_h6 = 120, .par_h7 = -100,
+    .par_g1 = -30, .par_g2 = -12256, .par_g3 = 18,
+    .res_heat_range = 1, .res_heat_val = 45, .range_sw_err = 0,
+};
+
+static volatile uint32_t sink;                  // Keeps results live
+
+// =============================
+// Function Prototypes
+// =============================
+static int64_t now_ns(void);
+static void report(const char *name, int64_t start_ns, uint32_t ops);
+static esp_err_t discard(void *ctx, const char *data, size_t len);
+static esp_err_t count_event(void *ctx, const json_event_t *event);
+static esp_err_t part_begin(void *ctx, const char *name, const char *filename);
+static esp_err_t part_data(void *ctx, const uint8_t *data, size_t len);
+static esp_err_t part_end(void *ctx);
+static size_t encode_frame(uint8_t *frame, bool packed);
+
+static const multipart_callbacks_t part_callbacks = { part_begin, part_data, part_end };
+
+// =============================
+// Function Definitions
+// =============================
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void report(const char *name, int64_t start_ns, uint32_t ops) {
+    char line[96];
+    snprintf(line, sizeof(line), "%-24s %10.1f ns/op", name, (double)(now_ns() - start_ns) / ops);
+    TEST_MESSAGE(line);
+}
+
+static esp_err_t discard(void *ctx, const char *data, size_t len) {
+    *(size_t *)ctx += len;
+    (void)data;
+    return ESP_OK;
+}
+
+static esp_err_t count_event(void *ctx, const json_event_t *event) {
+    (*(uint32_t *)ctx)++;
+    (void)event;
+    return ESP_OK;
+}
+
+static esp_err_t part_begin(void *ctx, const char *name, const char *filename) {
+    (void)name;
+    (void)filename;
+    (*(size_t *)ctx)++;
+    return ESP_OK;
+}
+
+static esp_err_t part_data(void *ctx, const uint8_t *data, size_t len) {
+    (void)data;
+    *(size_t *)ctx += len;
+    return ESP_OK;
+}
+
+static esp_err_t part_end(void *ctx) {
+    (void)ctx;
+    return ESP_OK;
+}
+
+/**
+ * @brief A full frame of a 60 s series; returns its length
+ */
+static size_t encode_frame(uint8_t *frame, bool packed) {
+    telemetry_writer_t w;
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_init(&w, frame, TELEMETRY_FRAME_MAX, 0xA1B2C3D4u, 0));
+    if (packed) {
+        TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_set_packed(&w));
+    }
+    for (uint32_t i = 0;; i++) {
+        telemetry_record_t rec = {
+            .seq = 1000 + i,
+            .time_s = 1790000000u + 60 * i,
+            .temperature = (int16_t)(2137 + (int16_t)(i % 5)),
+            .pressure = 101324 + 2 * (i / 4),
+            .humidity = 48500 + 10 * (i % 3),
+            .gas_resistance = 120000,
+            .gas_valid = true,
+            .heat_stable = true,
+        };
+        if (telemetry_writer_add(&w, &rec) != ESP_OK) {
+            break;                              // Full
+        }
+    }
+    return w.len;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+static void bench_json_write(void) {
+    size_t written = 0;
+    int64_t start = now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        json_writer_t w;
+        json_writer_init(&w, discard, &written);
+        json_obj_begin(&w);
+        json_kv_str(&w, "device", "weather-01");
+        json_kv_uint(&w, "uptimeS", 86400 + i);
+        json_key(&w, "sensor");
+        json_obj_begin(&w);
+        json_key(&w, "temperature");
+        json_double(&w, 21.37, 2);
+        json_kv_int(&w, "rssi", -61);
+        json_kv_bool(&w, "connected", true);
+        json_obj_end(&w);
+        json_key(&w, "nodes");
+        json_arr_begin(&w);
+        for (int n = 0; n < 4; n++) {
+            json_str(&w, "a1b2c3d4");
+        }
+        json_arr_end(&w);
+        json_obj_end(&w);
+        TEST_ASSERT_EQUAL(ESP_OK, json_writer_finish(&w));
+    }
+    report("json_write", start, BENCH_ITERATIONS);
+    TEST_ASSERT_GREATER_THAN(0, written);
+}
+
+static void bench_json_parse(void) {
+    uint32_t events = 0;
+    int64_t start = now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        json_reader_t r;
+        json_reader_init(&r, count_event, &events);
+        TEST_ASSERT_EQUAL(ESP_OK, json_reader_feed(&r, status_json, sizeof(status_json) - 1));
+        TEST_ASSERT_EQUAL(ESP_OK, json_reader_finish(&r));
+    }
+    report("json_parse", start, BENCH_ITERATIONS);
+    TEST_ASSERT_EQUAL_UINT32(0, events % BENCH_ITERATIONS);
+}
+
+static void bench_dns_parse(void) {
+    dns_question_t q;
+    uint8_t answer[DNS_A_ANSWER_LEN];
+    int64_t start = now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS * 10; i++) {
+        TEST_ASSERT_TRUE(dns_packet_parse_question(dns_query, sizeof(dns_query), &q));
+        dns_packet_a_answer(0x0104A8C0u, 60, answer);
+        sink += q.name_len + answer[0];
+    }
+    report("dns_parse_answer", start, BENCH_ITERATIONS * 10);
+}
+
+static void bench_multipart(void) {
+    size_t counted = 0;
+    int64_t start = now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS / 10; i++) {
+        multipart_reader_t r;
+        TEST_ASSERT_EQUAL(ESP_OK, multipart_reader_init(&r, MULTIPART_TYPE, &part_callbacks, &counted));
+        for (size_t pos = 0; pos < multipart_len; pos += 1460) {  // One TCP segment at a time
+            size_t n = multipart_len - pos < 1460 ? multipart_len - pos : 1460;
+            TEST_ASSERT_EQUAL(ESP_OK, multipart_reader_feed(&r, (const uint8_t *)multipart_body + pos, n));
+        }
+        TEST_ASSERT_EQUAL(ESP_OK, multipart_reader_finish(&r));
+    }
+    int64_t elapsed = now_ns() - start;
+    char line[96];
+    snprintf(line, sizeof(line), "%-24s %10.1f MB/s", "multipart_feed",
+             (double)multipart_len * (BENCH_ITERATIONS / 10) * 1000.0 / (double)elapsed);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_GREATER_THAN(0, counted);
+}
+
+static void bench_telemetry(void) {
+    static const bool modes[] = { false, true };
+    static const char *const names[][2] = {
+        { "telemetry_encode_fixed", "telemetry_decode_fixed" },
+        { "telemetry_encode_packed", "telemetry_decode_packed" },
+    };
+    uint8_t frame[TELEMETRY_FRAME_MAX];
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        int64_t start = now_ns();
+        size_t len = 0;
+        for (uint32_t i = 0; i < BENCH_ITERATIONS / 10; i++) {
+            len = encode_frame(frame, modes[m]);
+        }
+        report(names[m][0], start, BENCH_ITERATIONS / 10);
+
+        uint32_t records = 0;
+        start = now_ns();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS / 10; i++) {
+            telemetry_header_t hdr;
+            TEST_ASSERT_EQUAL(ESP_OK, telemetry_decode_header(frame, len, &hdr));
+            telemetry_reader_t r;
+            telemetry_reader_init(&r, frame, &hdr);
+            telemetry_record_t rec;
+            while (telemetry_reader_next(&r, &rec) == ESP_OK) {
+                records++;
+            }
+        }
+        report(names[m][1], start, BENCH_ITERATIONS / 10);
+        TEST_ASSERT_GREATER_THAN(0, records);
+    }
+}
+
+static void bench_bme680(void) {
+    int64_t start = now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS * 10; i++) {
+        int32_t t_fine;
+        sink += (uint32_t)bme680_compensate_temperature(&calib, 500000 + (i & 0xFFF), &t_fine);
+        sink += bme680_compensate_pressure(&calib, 350000 + (i & 0xFFF), t_fine);
+        sink += bme680_compensate_humidity(&calib, (uint16_t)(20000 + (i & 0xFFF)), t_fine);
+        sink += bme680_compensate_gas(&calib, (uint16_t)(600 + (i & 0xFF)), (uint8_t)(i & 0xF));
+    }
+    report("bme680_compensate", start, BENCH_ITERATIONS * 10);
+}
+
+int main(void) {
+    multipart_len = (size_t)snprintf(multipart_body, sizeof(multipart_body),
+                                     "------bench\r\nContent-Disposition: form-data; name=\"ssid\"\r\n\r\nhome\r\n"
+                                     "------bench\r\nContent-Disposition: form-data; name=\"file\"; "
+                                     "filename=\"fw.bin\"\r\nContent-Type: application/octet-stream\r\n\r\n");
+    memset(multipart_body + multipart_len, 0xA5, 6144);
+    multipart_len += 6144;
+    multipart_len += (size_t)snprintf(multipart_body + multipart_len, sizeof(multipart_body) - multipart_len,
+                                      "\r\n------bench--\r\n");
+
+    UNITY_BEGIN();
+    RUN_TEST(bench_json_write);
+    RUN_TEST(bench_json_parse);
+    RUN_TEST(bench_dns_parse);
+    RUN_TEST(bench_multipart);
+    RUN_TEST(bench_telemetry);
+    RUN_TEST(bench_bme680);
+    return UNITY_END();
+}
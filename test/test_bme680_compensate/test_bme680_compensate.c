@@ -0,0 +1,147 @@
+/**
+ * @file test_bme680_compensate.c
+ * @brief Host tests for the BME680 integer compensation: monotonic outputs, clamps, edge cases, heater encodings
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include <stdbool.h>
+#include "bme680_compensate.h"
+#include "unity.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+
+// Coefficients read from a production sensor
+static const bme680_calib_t calib = {
+    .par_t1 = 26203, .par_t2 = 26104, .par_t3 = 3,
+    .par_p1 = 35609, .par_p2 = -10384, .par_p3 = 88, .par_p4 = 6894, .par_p5 = -99, .par_p6 = 30,
+    .par_p7 = 35, .par_p8 = -3418, .par_p9 = -2305, .par_p10 = 30,
+    .par_h1 = 778, .par_h2 = 1003, .par_h3 = 0, .par_h4 = 45, .par_h5 = 20, .par_h6 = 120, .par_h7 = -100,
+    .par_g1 = -30, .par_g2 = -12256, .par_g3 = 18,
+    .res_heat_range = 1, .res_heat_val = 45, .range_sw_err = 0,
+};
+
+#define ADC_20_MAX ((1u << 20) - 1)             // Temperature and pressure ADCs are 20 bits
+
+// =============================
+// Function Definitions
+// =============================
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+static void test_temperature_monotonic(void) {
+    int32_t t_fine;
+    int16_t last = bme680_compensate_temperature(&calib, 300000, &t_fine);
+    for (uint32_t adc = 300000 + 997; adc <= 700000; adc += 997) {
+        int16_t t = bme680_compensate_temperature(&calib, adc, &t_fine);
+        TEST_ASSERT_GREATER_OR_EQUAL(last, t);
+        TEST_ASSERT_EQUAL_INT16((t_fine * 5 + 128) >> 8, t);   // t_fine is what the others compensate with
+        last = t;
+    }
+}
+
+static void test_pressure_falls_with_adc(void) {
+    int32_t t_fine;
+    bme680_compensate_temperature(&calib, 500000, &t_fine);
+    uint32_t last = bme680_compensate_pressure(&calib, 200000, t_fine);
+    TEST_ASSERT_GREATER_THAN(100000, last);
+    for (uint32_t adc = 200000 + 1009; adc <= 600000; adc += 1009) {
+        uint32_t p = bme680_compensate_pressure(&calib, adc, t_fine);
+        TEST_ASSERT_LESS_OR_EQUAL(last, p);
+        last = p;
+    }
+    TEST_ASSERT_LESS_THAN(60000, last);
+}
+
+static void test_pressure_edges(void) {
+    int32_t t_fine;
+    bme680_compensate_temperature(&calib, 500000, &t_fine);
+    TEST_ASSERT_EQUAL_UINT32(0, bme680_compensate_pressure(&calib, ADC_20_MAX, t_fine));  // Nothing left to divide
+
+    bme680_calib_t zero = calib;
+    zero.par_p1 = 0;                            // Bad calibration: no division by zero
+    TEST_ASSERT_EQUAL_UINT32(0, bme680_compensate_pressure(&zero, 400000, t_fine));
+
+    // Cold and high: the doubling that Bosch's int32 code wraps on
+    bme680_compensate_temperature(&calib, 300000, &t_fine);
+    uint32_t p = bme680_compensate_pressure(&calib, 100000, t_fine);
+    TEST_ASSERT_GREATER_THAN(100000, p);
+    TEST_ASSERT_LESS_THAN(200000, p);
+}
+
+static void test_humidity_range(void) {
+    int32_t t_fine;
+    bme680_compensate_temperature(&calib, 500000, &t_fine);
+    uint32_t last = 0;
+    bool saw_top = false;
+    for (uint32_t adc = 0; adc <= UINT16_MAX; adc += 61) {
+        uint32_t h = bme680_compensate_humidity(&calib, (uint16_t)adc, t_fine);
+        TEST_ASSERT_LESS_OR_EQUAL(BME680_HUMIDITY_MAX, h);
+        TEST_ASSERT_GREATER_OR_EQUAL(last, h);
+        saw_top |= h == BME680_HUMIDITY_MAX;
+        last = h;
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, bme680_compensate_humidity(&calib, 0, t_fine));
+    TEST_ASSERT_TRUE(saw_top);
+}
+
+static void test_gas(void) {
+    for (uint8_t range = 0; range < 16; range++) {
+        uint32_t last = UINT32_MAX;
+        for (uint32_t adc = 0; adc < 1024; adc += 7) {
+            uint32_t ohm = bme680_compensate_gas(&calib, (uint16_t)adc, range);
+            TEST_ASSERT_LESS_OR_EQUAL(last, ohm);   // More ADC counts, less resistance
+            last = ohm;
+        }
+    }
+    // Each range up divides the resistance by two
+    uint32_t r4 = bme680_compensate_gas(&calib, 700, 4);
+    uint32_t r5 = bme680_compensate_gas(&calib, 700, 6);
+    TEST_ASSERT_UINT32_WITHIN(r4 / 100, r4, 4 * r5);
+}
+
+static void test_heater_wait(void) {
+    TEST_ASSERT_EQUAL_HEX8(0x00, bme680_heater_wait(0));
+    TEST_ASSERT_EQUAL_HEX8(0x3F, bme680_heater_wait(63));
+    TEST_ASSERT_EQUAL_HEX8(0x50, bme680_heater_wait(64));     // 16 x 4 ms
+    TEST_ASSERT_EQUAL_HEX8(0x59, bme680_heater_wait(100));    // Datasheet example: 25 x 4 ms
+    TEST_ASSERT_EQUAL_HEX8(0xBE, bme680_heater_wait(1000));   // 62 x 16 ms
+    TEST_ASSERT_EQUAL_HEX8(0xFF, bme680_heater_wait(BME680_HEATER_MAX_MS));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, bme680_heater_wait(UINT16_MAX));
+}
+
+static void test_heater_resistance(void) {
+    uint8_t last = 0;
+    for (uint16_t target = 200; target <= BME680_HEATER_MAX_TEMP_C; target += 10) {
+        uint8_t res = bme680_heater_resistance(&calib, 2500, target);
+        TEST_ASSERT_GREATER_THAN(last, res);
+        last = res;
+    }
+    TEST_ASSERT_EQUAL(bme680_heater_resistance(&calib, 2500, BME680_HEATER_MAX_TEMP_C),
+                      bme680_heater_resistance(&calib, 2500, 1000));         // Target clamped
+    TEST_ASSERT_GREATER_THAN(bme680_heater_resistance(&calib, -1000, 320),
+                             bme680_heater_resistance(&calib, 4000, 320));   // Ambient moves it with par_g3
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_temperature_monotonic);
+    RUN_TEST(test_pressure_falls_with_adc);
+    RUN_TEST(test_pressure_edges);
+    RUN_TEST(test_humidity_range);
+    RUN_TEST(test_gas);
+    RUN_TEST(test_heater_wait);
+    RUN_TEST(test_heater_resistance);
+    return UNITY_END();
+}
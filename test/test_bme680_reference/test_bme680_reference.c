@@ -0,0 +1,269 @@
+/**
+ * @file test_bme680_reference.c
+ * @brief Host validation of the BME680 integer compensation against the datasheet's floating-point formulas
+ *
+ * The float formulas below are the datasheet's, in double. Raw values are
+ * swept across the operating range (-40..85 degC, 30..110 kPa, 0..100 %RH)
+ * for two calibration sets, and every integer result must stay within a
+ * fixed distance of the float one. The worst difference per quantity is
+ * printed so a change that costs accuracy shows up before it fails.
+ *
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "bme680_compensate.h"
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "unity.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+#define TEMP_MIN_C (-40.0)
+#define TEMP_MAX_C 85.0
+#define PRESSURE_MIN_PA 30000.0
+#define PRESSURE_MAX_PA 110000.0
+
+#define TEMP_TOLERANCE_C 0.01                   // One output step
+#define PRESSURE_TOLERANCE_PA 10.0
+#define HUMIDITY_TOLERANCE_RH 0.1
+#define GAS_TOLERANCE 0.002                     // Relative
+#define HEATER_TOLERANCE 1                      // Register codes
+
+// Coefficients read from two production sensors
+static const bme680_calib_t calib_sets[] = {
+    {
+        .par_t1 = 26203, .par_t2 = 26104, .par_t3 = 3,
+        .par_p1 = 35609, .par_p2 = -10384, .par_p3 = 88, .par_p4 = 6894, .par_p5 = -99, .par_p6 = 30,
+        .par_p7 = 35, .par_p8 = -3418, .par_p9 = -2305, .par_p10 = 30,
+        .par_h1 = 778, .par_h2 = 1003, .par_h3 = 0, .par_h4 = 45, .par_h5 = 20, .par_h6 = 120, .par_h7 = -100,
+        .par_g1 = -30, .par_g2 = -12256, .par_g3 = 18,
+        .res_heat_range = 1, .res_heat_val = 45, .range_sw_err = 0,
+    },
+    {
+        .par_t1 = 25800, .par_t2 = 26500, .par_t3 = 3,
+        .par_p1 = 37200, .par_p2 = -10500, .par_p3 = 88, .par_p4 = 7900, .par_p5 = -120, .par_p6 = 30,
+        .par_p7 = 50, .par_p8 = -2800, .par_p9 = -3100, .par_p10 = 30,
+        .par_h1 = 820, .par_h2 = 980, .par_h3 = 0, .par_h4 = 45, .par_h5 = 20, .par_h6 = 120, .par_h7 = -100,
+        .par_g1 = -20, .par_g2 = -9000, .par_g3 = 18,
+        .res_heat_range = 2, .res_heat_val = 40, .range_sw_err = 2,
+    },
+};
+#define CALIB_SETS (sizeof(calib_sets) / sizeof(calib_sets[0]))
+
+// Datasheet gas range corrections, in percent
+static const double gas_k1[16] = { 0, 0, 0, 0, 0, -1, 0, -0.8, 0, 0, -0.2, -0.5, 0, -1, 0, 0 };
+static const double gas_k2[16] = { 0, 0, 0, 0, 0.1, 0.7, 0, -0.8, -0.1, 0, 0, 0, 0, 0, 0, 0 };
+
+// =============================
+// Function Prototypes
+// =============================
+static double float_temperature(const bme680_calib_t *c, uint32_t adc, double *t_fine);
+static double float_pressure(const bme680_calib_t *c, uint32_t adc, double t_fine);
+static double float_humidity(const bme680_calib_t *c, uint16_t adc, double t_fine);
+static double float_gas(const bme680_calib_t *c, uint16_t adc, uint8_t range);
+static double float_heater(const bme680_calib_t *c, double ambient_c, double target_c);
+static void report(const char *name, double worst, const char *unit);
+
+// =============================
+// Function Definitions
+// =============================
+
+static double float_temperature(const bme680_calib_t *c, uint32_t adc, double *t_fine) {
+    double var1 = ((double)adc / 16384.0 - (double)c->par_t1 / 1024.0) * (double)c->par_t2;
+    double var2 = (double)adc / 131072.0 - (double)c->par_t1 / 8192.0;
+    var2 = var2 * var2 * ((double)c->par_t3 * 16.0);
+    *t_fine = var1 + var2;
+    return *t_fine / 5120.0;
+}
+
+static double float_pressure(const bme680_calib_t *c, uint32_t adc, double t_fine) {
+    double var1 = t_fine / 2.0 - 64000.0;
+    double var2 = var1 * var1 * ((double)c->par_p6 / 131072.0);
+    var2 = var2 + var1 * (double)c->par_p5 * 2.0;
+    var2 = var2 / 4.0 + (double)c->par_p4 * 65536.0;
+    var1 = (((double)c->par_p3 * var1 * var1) / 16384.0 + (double)c->par_p2 * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * (double)c->par_p1;
+    double p = 1048576.0 - (double)adc;
+    p = ((p - var2 / 4096.0) * 6250.0) / var1;
+    var1 = ((double)c->par_p9 * p * p) / 2147483648.0;
+    var2 = p * ((double)c->par_p8 / 32768.0);
+    double var3 = (p / 256.0) * (p / 256.0) * (p / 256.0) * ((double)c->par_p10 / 131072.0);
+    return p + (var1 + var2 + var3 + (double)c->par_p7 * 128.0) / 16.0;
+}
+
+static double float_humidity(const bme680_calib_t *c, uint16_t adc, double t_fine) {
+    double temp = t_fine / 5120.0;
+    double var1 = (double)adc - ((double)c->par_h1 * 16.0 + ((double)c->par_h3 / 2.0) * temp);
+    double var2 = var1 * (((double)c->par_h2 / 262144.0) *
+                          (1.0 + ((double)c->par_h4 / 16384.0) * temp +
+                           ((double)c->par_h5 / 1048576.0) * temp * temp));
+    double var3 = (double)c->par_h6 / 16384.0;
+    double var4 = (double)c->par_h7 / 2097152.0;
+    double hum = var2 + (var3 + var4 * temp) * var2 * var2;
+    return hum > 100.0 ? 100.0 : (hum < 0.0 ? 0.0 : hum);
+}
+
+static double float_gas(const bme680_calib_t *c, uint16_t adc, uint8_t range) {
+    double var1 = 1340.0 + 5.0 * (double)c->range_sw_err;
+    double var2 = var1 * (1.0 + gas_k1[range] / 100.0);
+    double var3 = 1.0 + gas_k2[range] / 100.0;
+    return 1.0 / (var3 * 0.000000125 * (double)(1u << range) * (((double)adc - 512.0) / var2 + 1.0));
+}
+
+static double float_heater(const bme680_calib_t *c, double ambient_c, double target_c) {
+    double var1 = (double)c->par_g1 / 16.0 + 49.0;
+    double var2 = ((double)c->par_g2 / 32768.0) * 0.0005 + 0.00235;
+    double var3 = (double)c->par_g3 / 1024.0;
+    double var4 = var1 * (1.0 + var2 * target_c);
+    double var5 = var4 + var3 * ambient_c;
+    return 3.4 * (var5 * (4.0 / (4.0 + (double)c->res_heat_range)) *
+                  (1.0 / (1.0 + (double)c->res_heat_val * 0.002)) - 25.0);
+}
+
+static void report(const char *name, double worst, const char *unit) {
+    char line[80];
+    snprintf(line, sizeof(line), "worst %s difference %.4f %s", name, worst, unit);
+    TEST_MESSAGE(line);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+static void test_temperature(void) {
+    double worst = 0;
+    uint32_t checked = 0;
+    for (size_t s = 0; s < CALIB_SETS; s++) {
+        const bme680_calib_t *c = &calib_sets[s];
+        for (uint32_t adc = 0; adc < (1u << 20); adc += 37) {
+            double t_fine_f;
+            double expected = float_temperature(c, adc, &t_fine_f);
+            if (expected < TEMP_MIN_C || expected > TEMP_MAX_C) {
+                continue;
+            }
+            int32_t t_fine;
+            double actual = bme680_compensate_temperature(c, adc, &t_fine) / 100.0;
+            double diff = fabs(actual - expected);
+            TEST_ASSERT_DOUBLE_WITHIN(TEMP_TOLERANCE_C, expected, actual);
+            worst = diff > worst ? diff : worst;
+            checked++;
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(10000, checked);   // The sweep reached the range
+    report("temperature", worst, "degC");
+}
+
+static void test_pressure(void) {
+    double worst = 0;
+    uint32_t checked = 0;
+    for (size_t s = 0; s < CALIB_SETS; s++) {
+        const bme680_calib_t *c = &calib_sets[s];
+        for (uint32_t t_adc = 0; t_adc < (1u << 20); t_adc += 4099) {
+            double t_fine_f;
+            double temp = float_temperature(c, t_adc, &t_fine_f);
+            if (temp < TEMP_MIN_C || temp > TEMP_MAX_C) {
+                continue;
+            }
+            int32_t t_fine;
+            bme680_compensate_temperature(c, t_adc, &t_fine);
+            for (uint32_t adc = 0; adc < (1u << 20); adc += 211) {
+                double expected = float_pressure(c, adc, t_fine_f);
+                if (expected < PRESSURE_MIN_PA || expected > PRESSURE_MAX_PA) {
+                    continue;
+                }
+                double actual = bme680_compensate_pressure(c, adc, t_fine);
+                double diff = fabs(actual - expected);
+                TEST_ASSERT_DOUBLE_WITHIN(PRESSURE_TOLERANCE_PA, expected, actual);
+                worst = diff > worst ? diff : worst;
+                checked++;
+            }
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(10000, checked);
+    report("pressure", worst, "Pa");
+}
+
+static void test_humidity(void) {
+    double worst = 0;
+    uint32_t checked = 0;
+    for (size_t s = 0; s < CALIB_SETS; s++) {
+        const bme680_calib_t *c = &calib_sets[s];
+        for (uint32_t t_adc = 0; t_adc < (1u << 20); t_adc += 4099) {
+            double t_fine_f;
+            double temp = float_temperature(c, t_adc, &t_fine_f);
+            if (temp < TEMP_MIN_C || temp > TEMP_MAX_C) {
+                continue;
+            }
+            int32_t t_fine;
+            bme680_compensate_temperature(c, t_adc, &t_fine);
+            for (uint32_t adc = 0; adc <= UINT16_MAX; adc += 13) {
+                double expected = float_humidity(c, (uint16_t)adc, t_fine_f);
+                double actual = bme680_compensate_humidity(c, (uint16_t)adc, t_fine) / 1000.0;
+                double diff = fabs(actual - expected);
+                TEST_ASSERT_DOUBLE_WITHIN(HUMIDITY_TOLERANCE_RH, expected, actual);
+                worst = diff > worst ? diff : worst;
+                checked++;
+            }
+        }
+    }
+    report("humidity", worst, "%RH");
+    TEST_ASSERT_GREATER_THAN(10000, checked);
+}
+
+static void test_gas(void) {
+    double worst = 0;
+    for (size_t s = 0; s < CALIB_SETS; s++) {
+        const bme680_calib_t *c = &calib_sets[s];
+        for (uint8_t range = 0; range < 16; range++) {
+            for (uint32_t adc = 0; adc < 1024; adc++) {
+                double expected = float_gas(c, (uint16_t)adc, range);
+                double actual = bme680_compensate_gas(c, (uint16_t)adc, range);
+                if (expected < 1000.0) {
+                    TEST_ASSERT_DOUBLE_WITHIN(1.0, expected, actual);   // Integer Ohm resolution
+                    continue;
+                }
+                double diff = fabs(actual - expected) / expected;
+                TEST_ASSERT_DOUBLE_WITHIN(GAS_TOLERANCE * expected, expected, actual);
+                worst = diff > worst ? diff : worst;
+            }
+        }
+    }
+    report("relative gas", worst, "");
+}
+
+static void test_heater(void) {
+    int worst = 0;
+    for (size_t s = 0; s < CALIB_SETS; s++) {
+        const bme680_calib_t *c = &calib_sets[s];
+        for (int ambient = -40; ambient <= 85; ambient += 5) {
+            for (int target = 200; target <= BME680_HEATER_MAX_TEMP_C; target += 5) {
+                double expected = float_heater(c, ambient, target);
+                int actual = bme680_heater_resistance(c, (int16_t)(ambient * 100), (uint16_t)target);
+                int diff = abs(actual - (int)lround(expected));
+                TEST_ASSERT_LESS_OR_EQUAL(HEATER_TOLERANCE, diff);
+                worst = diff > worst ? diff : worst;
+            }
+        }
+    }
+    report("heater", worst, "codes");
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_temperature);
+    RUN_TEST(test_pressure);
+    RUN_TEST(test_humidity);
+    RUN_TEST(test_gas);
+    RUN_TEST(test_heater);
+    return UNITY_END();
+}
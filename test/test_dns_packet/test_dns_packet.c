@@ -0,0 +1,173 @@
+/**
+ * @file test_dns_packet.c
+ * @brief Host tests for the DNS wire format: question parsing, name skipping, TTL/EDNS rewriting, A answers
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "dns_packet.h"
+#include <string.h>
+#include "unity.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+
+// Query for Connectivity-Check.Example.com, type A, class IN
+static const uint8_t query[] = {
+    0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    18, 'C', 'o', 'n', 'n', 'e', 'c', 't', 'i', 'v', 'i', 't', 'y', '-', 'C', 'h', 'e', 'c', 'k',
+    7, 'E', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0,
+    0x00, 0x01, 0x00, 0x01,
+};
+
+// Response to a.io: two A answers (TTL 300 and 60, the second with a compressed name) and an OPT record
+static const uint8_t response[] = {
+    0xAB, 0xCD, 0x81, 0x80, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01,
+    1, 'a', 2, 'i', 'o', 0, 0x00, 0x01, 0x00, 0x01,
+    1, 'a', 2, 'i', 'o', 0, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2C, 0x00, 0x04, 10, 0, 0, 1,
+    0xC0, 0x0C, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3C, 0x00, 0x04, 10, 0, 0, 2,
+    0, 0x00, 0x29, 0x10, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00,
+};
+#define RESPONSE_TTL1 32                        // Offsets into response
+#define RESPONSE_TTL2 48
+#define RESPONSE_OPT_CLASS 61
+
+// =============================
+// Function Prototypes
+// =============================
+static uint32_t get_u32(const uint8_t *p);
+
+// =============================
+// Function Definitions
+// =============================
+
+static uint32_t get_u32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+static void test_parse_question(void) {
+    dns_question_t q;
+    TEST_ASSERT_TRUE(dns_packet_parse_question(query, sizeof(query), &q));
+    TEST_ASSERT_EQUAL_STRING("connectivity-check.example.com", q.name);
+    TEST_ASSERT_EQUAL(strlen(q.name), q.name_len);
+    TEST_ASSERT_EQUAL(DNS_TYPE_A, q.qtype);
+    TEST_ASSERT_EQUAL(DNS_CLASS_IN, q.qclass);
+    TEST_ASSERT_EQUAL(sizeof(query), q.end);
+}
+
+static void test_parse_root_name(void) {
+    uint8_t pkt[DNS_HEADER_SIZE + 5] = { 0 };
+    pkt[DNS_HEADER_SIZE + 2] = DNS_TYPE_ANY;
+    dns_question_t q;
+    TEST_ASSERT_TRUE(dns_packet_parse_question(pkt, sizeof(pkt), &q));
+    TEST_ASSERT_EQUAL_STRING("", q.name);
+    TEST_ASSERT_EQUAL(DNS_TYPE_ANY, q.qtype);
+}
+
+static void test_parse_rejects(void) {
+    dns_question_t q;
+    for (int len = 0; len < (int)sizeof(query); len++) {
+        TEST_ASSERT_FALSE(dns_packet_parse_question(query, len, &q));   // Every truncation
+    }
+
+    uint8_t pkt[sizeof(query)];
+    memcpy(pkt, query, sizeof(pkt));
+    pkt[DNS_HEADER_SIZE] = 0xC0;                // Compression pointer in a question
+    TEST_ASSERT_FALSE(dns_packet_parse_question(pkt, sizeof(pkt), &q));
+    pkt[DNS_HEADER_SIZE] = 0x40;                // Reserved label type
+    TEST_ASSERT_FALSE(dns_packet_parse_question(pkt, sizeof(pkt), &q));
+}
+
+static void test_parse_name_limit(void) {
+    // Labels of 63 until the dotted name passes DNS_MAX_NAME_LEN
+    uint8_t pkt[DNS_HEADER_SIZE + 5 * 64 + 5] = { 0 };
+    int pos = DNS_HEADER_SIZE;
+    for (int label = 0; label < 5; label++) {
+        pkt[pos++] = 63;
+        memset(&pkt[pos], 'x', 63);
+        pos += 63;
+    }
+    pkt[pos] = 0;
+    dns_question_t q;
+    TEST_ASSERT_FALSE(dns_packet_parse_question(pkt, pos + 5, &q));
+
+    pkt[DNS_HEADER_SIZE + 4 * 64] = 0;          // Four labels: 255 with the dots
+    TEST_ASSERT_TRUE(dns_packet_parse_question(pkt, sizeof(pkt), &q));
+    TEST_ASSERT_EQUAL(4 * 63 + 3, q.name_len);
+}
+
+static void test_skip_name(void) {
+    TEST_ASSERT_EQUAL(DNS_HEADER_SIZE + 6, dns_packet_skip_name(response, sizeof(response), DNS_HEADER_SIZE));
+    TEST_ASSERT_EQUAL(44, dns_packet_skip_name(response, sizeof(response), 42));     // Pointer: two bytes
+    TEST_ASSERT_EQUAL(-1, dns_packet_skip_name(response, 43, 42));                   // Cut inside the pointer
+    TEST_ASSERT_EQUAL(-1, dns_packet_skip_name(response, DNS_HEADER_SIZE + 3, DNS_HEADER_SIZE));
+    const uint8_t reserved[] = { 0x80, 0x00 };
+    TEST_ASSERT_EQUAL(-1, dns_packet_skip_name(reserved, sizeof(reserved), 0));
+}
+
+static void test_adjust_records(void) {
+    uint8_t pkt[sizeof(response)];
+    memcpy(pkt, response, sizeof(pkt));
+    dns_record_ctx_t ctx = { .elapsed_s = 100, .max_payload = 1232 };
+    TEST_ASSERT_TRUE(dns_packet_adjust_records(pkt, sizeof(pkt), &ctx));
+    TEST_ASSERT_EQUAL_UINT32(200, get_u32(&pkt[RESPONSE_TTL1]));
+    TEST_ASSERT_EQUAL_UINT32(0, get_u32(&pkt[RESPONSE_TTL2]));   // Expired stays at 0
+    TEST_ASSERT_EQUAL_UINT32(0, ctx.min_ttl);
+    TEST_ASSERT_EQUAL(1232, (pkt[RESPONSE_OPT_CLASS] << 8) | pkt[RESPONSE_OPT_CLASS + 1]);
+    TEST_ASSERT_EQUAL_UINT32(0x00008000, get_u32(&pkt[RESPONSE_OPT_CLASS + 2]));  // OPT flags not aged
+
+    memcpy(pkt, response, sizeof(pkt));
+    ctx = (dns_record_ctx_t){ .elapsed_s = 0, .max_payload = 0 };
+    TEST_ASSERT_TRUE(dns_packet_adjust_records(pkt, sizeof(pkt), &ctx));
+    TEST_ASSERT_EQUAL_UINT32(60, ctx.min_ttl);
+    TEST_ASSERT_EQUAL_MEMORY(response, pkt, sizeof(pkt));      // Nothing to change
+}
+
+static void test_adjust_rejects(void) {
+    uint8_t pkt[sizeof(response)];
+    dns_record_ctx_t ctx = { 0 };
+    for (int len = 0; len < (int)sizeof(response); len++) {
+        memcpy(pkt, response, sizeof(pkt));
+        TEST_ASSERT_FALSE(dns_packet_adjust_records(pkt, len, &ctx));
+    }
+    memcpy(pkt, response, sizeof(pkt));
+    pkt[RESPONSE_TTL1 + 5] = 0x40;              // RDLENGTH past the end
+    TEST_ASSERT_FALSE(dns_packet_adjust_records(pkt, sizeof(pkt), &ctx));
+}
+
+static void test_a_answer(void) {
+    const uint8_t ip[4] = { 192, 168, 4, 1 };
+    uint32_t ip_n;
+    memcpy(&ip_n, ip, sizeof(ip_n));
+    uint8_t out[DNS_A_ANSWER_LEN];
+    dns_packet_a_answer(ip_n, 0x01020304, out);
+    const uint8_t expected[DNS_A_ANSWER_LEN] = {
+        0xC0, 0x0C, 0x00, 0x01, 0x00, 0x01, 0x01, 0x02, 0x03, 0x04, 0x00, 0x04, 192, 168, 4, 1,
+    };
+    TEST_ASSERT_EQUAL_MEMORY(expected, out, sizeof(expected));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_question);
+    RUN_TEST(test_parse_root_name);
+    RUN_TEST(test_parse_rejects);
+    RUN_TEST(test_parse_name_limit);
+    RUN_TEST(test_skip_name);
+    RUN_TEST(test_adjust_records);
+    RUN_TEST(test_adjust_rejects);
+    RUN_TEST(test_a_answer);
+    return UNITY_END();
+}
@@ -0,0 +1,315 @@
+/**
+ * @file test_frame_replay.c
+ * @brief Host tests for capture files: the byte layout, and captures replayed through the telemetry decoder
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "capture_file.h"
+#include "telemetry.h"
+#include <string.h>
+#include "unity.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+#define CAPTURE_START 1790000000u
+#define CAPTURE_MAX 16384
+#define NODES 3
+#define ROUNDS 6
+#define SLOT_REQUEST 0x53                       // First byte of a frame that is not telemetry
+
+/**
+ * @brief A captured node, and what the replay decoded of it
+ */
+typedef struct {
+    uint8_t mac[CAPTURE_FILE_MAC_LEN];
+    int8_t rssi;
+    uint32_t node_id;
+    bool packed;
+    uint32_t per_frame;                         // Records per frame
+    uint32_t next_seq;                          // Capture: seq of the next record written
+    uint32_t frames;                            // Replay: telemetry frames decoded
+    uint32_t records;                           // ... and their records, each checked against sample()
+} node_t;
+
+/**
+ * @brief What a replay saw
+ */
+typedef struct {
+    uint32_t start;
+    uint32_t frames;                            // Whole records read
+    uint32_t other;                             // Frames that are not telemetry
+    bool partial;                               // Stopped at a partial or malformed record
+} replay_result_t;
+
+static uint8_t capture[CAPTURE_MAX];
+static size_t capture_len;
+static node_t nodes[NODES];
+
+// =============================
+// Function Prototypes
+// =============================
+static telemetry_record_t sample(uint32_t node_id, uint32_t seq);
+static void append(uint32_t t_ms, const node_t *node, const uint8_t *frame, size_t len);
+static void build_capture(void);
+static node_t *node_by_mac(const uint8_t *mac);
+static void assert_same(const telemetry_record_t *expected, const telemetry_record_t *actual);
+static esp_err_t replay(const uint8_t *buf, size_t len, replay_result_t *result);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Record seq of a node, sampled every 60 s, already at the encoded resolution
+ */
+static telemetry_record_t sample(uint32_t node_id, uint32_t seq) {
+    telemetry_record_t rec = {
+        .seq = seq,
+        .time_s = CAPTURE_START + 60 * seq,
+        .temperature = (int16_t)(2000 + (int16_t)(node_id % 7) * 10 + (int16_t)(seq % 5)),
+        .pressure = 101300 + 2 * (seq % 9),
+        .humidity = 45000 + 10 * (seq % 4),
+        .gas_resistance = 4000 + seq % 50,
+        .heater_step = (uint8_t)(seq % 10),
+        .gas_valid = seq % 11 != 0,
+        .heat_stable = true,
+    };
+    return rec;
+}
+
+/**
+ * @brief Append one record and its frame to capture[], as frame_capture.c writes them
+ */
+static void append(uint32_t t_ms, const node_t *node, const uint8_t *frame, size_t len) {
+    capture_file_record_t rec = { .t_ms = t_ms, .rssi = node->rssi, .len = (uint8_t)len };
+    memcpy(rec.mac, node->mac, sizeof(rec.mac));
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(capture), capture_len + CAPTURE_FILE_RECORD_LEN + len);
+    capture_file_write_record(capture + capture_len, &rec);
+    memcpy(capture + capture_len + CAPTURE_FILE_RECORD_LEN, frame, len);
+    capture_len += CAPTURE_FILE_RECORD_LEN + len;
+}
+
+/**
+ * @brief A capture of three nodes, fixed and packed frames, with a slot request from each between rounds
+ */
+static void build_capture(void) {
+    static const node_t init[NODES] = {
+        { { 0x24, 0x6F, 0x28, 0x00, 0x00, 0x01 }, -41, 0x00000101u, false, 5, 100, 0, 0 },
+        { { 0x24, 0x6F, 0x28, 0x00, 0x00, 0x02 }, -67, 0x00000202u, true, 12, 5000, 0, 0 },
+        { { 0x24, 0x6F, 0x28, 0x00, 0x00, 0x03 }, -90, 0x00000303u, true, 1, 7, 0, 0 },
+    };
+    memcpy(nodes, init, sizeof(nodes));
+
+    capture_file_write_header(capture, CAPTURE_START);
+    capture_len = CAPTURE_FILE_HEADER_LEN;
+    uint32_t t_ms = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int n = 0; n < NODES; n++) {
+            node_t *node = &nodes[n];
+            uint8_t frame[TELEMETRY_FRAME_MAX];
+            telemetry_writer_t w;
+            TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_init(&w, frame, sizeof(frame), node->node_id, 0));
+            if (node->packed) {
+                TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_set_packed(&w));
+            }
+            for (uint32_t i = 0; i < node->per_frame; i++) {
+                telemetry_record_t rec = sample(node->node_id, node->next_seq++);
+                TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_add(&w, &rec));
+            }
+            append(t_ms, node, frame, w.len);
+            t_ms += 37;
+
+            const uint8_t request[] = { SLOT_REQUEST, (uint8_t)round, (uint8_t)n };
+            append(t_ms, node, request, sizeof(request));
+            t_ms += 5;
+        }
+        t_ms += 60000;
+    }
+}
+
+static node_t *node_by_mac(const uint8_t *mac) {
+    for (int n = 0; n < NODES; n++) {
+        if (memcmp(nodes[n].mac, mac, CAPTURE_FILE_MAC_LEN) == 0) {
+            return &nodes[n];
+        }
+    }
+    return NULL;
+}
+
+static void assert_same(const telemetry_record_t *expected, const telemetry_record_t *actual) {
+    TEST_ASSERT_EQUAL_UINT32(expected->seq, actual->seq);
+    TEST_ASSERT_EQUAL_UINT32(expected->time_s, actual->time_s);
+    TEST_ASSERT_EQUAL_INT16(expected->temperature, actual->temperature);
+    TEST_ASSERT_EQUAL_UINT32(expected->pressure, actual->pressure);
+    TEST_ASSERT_EQUAL_UINT32(expected->humidity, actual->humidity);
+    TEST_ASSERT_EQUAL_UINT32(expected->gas_resistance, actual->gas_resistance);
+    TEST_ASSERT_EQUAL(expected->heater_step, actual->heater_step);
+    TEST_ASSERT_EQUAL(expected->gas_valid, actual->gas_valid);
+    TEST_ASSERT_EQUAL(expected->heat_stable, actual->heat_stable);
+}
+
+/**
+ * @brief Walk a capture as replay_task() does, decoding each telemetry frame into records
+ *
+ * Every record is checked against the node it came from; frames that are
+ * not telemetry are counted, as the gateway hands them to other layers.
+ */
+static esp_err_t replay(const uint8_t *buf, size_t len, replay_result_t *result) {
+    memset(result, 0, sizeof(*result));
+    for (int n = 0; n < NODES; n++) {
+        nodes[n].frames = 0;
+        nodes[n].records = 0;
+    }
+    if (len < CAPTURE_FILE_HEADER_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t ret = capture_file_read_header(buf, &result->start);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    size_t pos = CAPTURE_FILE_HEADER_LEN;
+    uint32_t last_t_ms = 0;
+    while (pos + CAPTURE_FILE_RECORD_LEN <= len) {
+        capture_file_record_t rec;
+        if (capture_file_read_record(buf + pos, &rec) != ESP_OK ||
+            pos + CAPTURE_FILE_RECORD_LEN + rec.len > len) {
+            result->partial = true;
+            return ESP_OK;
+        }
+        const uint8_t *frame = buf + pos + CAPTURE_FILE_RECORD_LEN;
+        pos += CAPTURE_FILE_RECORD_LEN + rec.len;
+        result->frames++;
+
+        TEST_ASSERT_GREATER_OR_EQUAL(last_t_ms, rec.t_ms);
+        last_t_ms = rec.t_ms;
+        node_t *node = node_by_mac(rec.mac);
+        TEST_ASSERT_NOT_NULL(node);
+        TEST_ASSERT_EQUAL(node->rssi, rec.rssi);
+
+        telemetry_header_t hdr;
+        if (telemetry_decode_header(frame, rec.len, &hdr) != ESP_OK) {
+            TEST_ASSERT_EQUAL(SLOT_REQUEST, frame[0]);
+            result->other++;
+            continue;
+        }
+        TEST_ASSERT_EQUAL_UINT32(node->node_id, hdr.node_id);
+        TEST_ASSERT_EQUAL(node->packed ? TELEMETRY_TYPE_BME680_PACKED : TELEMETRY_TYPE_BME680, hdr.type);
+        node->frames++;
+
+        telemetry_reader_t r;
+        telemetry_record_t got;
+        telemetry_reader_init(&r, frame, &hdr);
+        while ((ret = telemetry_reader_next(&r, &got)) == ESP_OK) {
+            telemetry_record_t expected = sample(node->node_id, got.seq);
+            assert_same(&expected, &got);
+            node->records++;
+        }
+        TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, ret);
+    }
+    result->partial = pos != len;
+    return ESP_OK;
+}
+
+void setUp(void) {
+    memset(capture, 0, sizeof(capture));
+    build_capture();
+}
+
+void tearDown(void) {
+}
+
+static void test_layout(void) {
+    uint8_t header[CAPTURE_FILE_HEADER_LEN];
+    capture_file_write_header(header, 0x6AB0C100);
+    const uint8_t expected_header[CAPTURE_FILE_HEADER_LEN] = { 'W', 'X', 'C', '1', 0x00, 0xC1, 0xB0, 0x6A };
+    TEST_ASSERT_EQUAL_MEMORY(expected_header, header, sizeof(header));
+
+    capture_file_record_t rec = { .t_ms = 0x00012345, .mac = { 1, 2, 3, 4, 5, 6 }, .rssi = -80, .len = 250 };
+    uint8_t bytes[CAPTURE_FILE_RECORD_LEN];
+    capture_file_write_record(bytes, &rec);
+    const uint8_t expected_record[CAPTURE_FILE_RECORD_LEN] = { 0x45, 0x23, 0x01, 0x00, 1, 2, 3, 4, 5, 6, 0xB0, 250 };
+    TEST_ASSERT_EQUAL_MEMORY(expected_record, bytes, sizeof(bytes));
+
+    capture_file_record_t back;
+    TEST_ASSERT_EQUAL(ESP_OK, capture_file_read_record(bytes, &back));
+    TEST_ASSERT_EQUAL_UINT32(rec.t_ms, back.t_ms);
+    TEST_ASSERT_EQUAL_MEMORY(rec.mac, back.mac, sizeof(rec.mac));
+    TEST_ASSERT_EQUAL(-80, back.rssi);
+    TEST_ASSERT_EQUAL(250, back.len);
+}
+
+static void test_replay_decodes_records(void) {
+    replay_result_t result;
+    TEST_ASSERT_EQUAL(ESP_OK, replay(capture, capture_len, &result));
+    TEST_ASSERT_FALSE(result.partial);
+    TEST_ASSERT_EQUAL_UINT32(CAPTURE_START, result.start);
+    TEST_ASSERT_EQUAL(ROUNDS * NODES * 2, result.frames);
+    TEST_ASSERT_EQUAL(ROUNDS * NODES, result.other);
+    for (int n = 0; n < NODES; n++) {
+        TEST_ASSERT_EQUAL(ROUNDS, nodes[n].frames);
+        TEST_ASSERT_EQUAL(ROUNDS * nodes[n].per_frame, nodes[n].records);
+    }
+}
+
+static void test_truncated_capture(void) {
+    replay_result_t result;
+
+    // Cut at every byte of the last record and its frame: everything before it still replays
+    size_t last = capture_len - CAPTURE_FILE_RECORD_LEN - 3;     // The final slot request
+    for (size_t len = last + 1; len < capture_len; len++) {
+        TEST_ASSERT_EQUAL(ESP_OK, replay(capture, len, &result));
+        TEST_ASSERT_TRUE(result.partial);
+        TEST_ASSERT_EQUAL(ROUNDS * NODES * 2 - 1, result.frames);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, replay(capture, last, &result));
+    TEST_ASSERT_FALSE(result.partial);
+
+    // Only a header: an empty capture
+    TEST_ASSERT_EQUAL(ESP_OK, replay(capture, CAPTURE_FILE_HEADER_LEN, &result));
+    TEST_ASSERT_EQUAL(0, result.frames);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, replay(capture, CAPTURE_FILE_HEADER_LEN - 1, &result));
+}
+
+static void test_malformed(void) {
+    replay_result_t result;
+
+    // Not a capture
+    capture[3] = '2';
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, replay(capture, capture_len, &result));
+    capture[3] = '1';
+
+    // Impossible frame lengths stop the replay at that record
+    capture_file_record_t rec;
+    uint8_t *first = capture + CAPTURE_FILE_HEADER_LEN;
+    uint8_t len = first[11];
+    first[11] = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, capture_file_read_record(first, &rec));
+    TEST_ASSERT_EQUAL(ESP_OK, replay(capture, capture_len, &result));
+    TEST_ASSERT_TRUE(result.partial);
+    TEST_ASSERT_EQUAL(0, result.frames);
+    first[11] = CAPTURE_FILE_FRAME_MAX + 1;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, capture_file_read_record(first, &rec));
+    first[11] = len;
+
+    // A frame that is cut short but framed whole is the decoder's to reject, not the capture's
+    uint8_t *frame = first + CAPTURE_FILE_RECORD_LEN;
+    telemetry_header_t hdr;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, telemetry_decode_header(frame, len - 1, &hdr));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_layout);
+    RUN_TEST(test_replay_decodes_records);
+    RUN_TEST(test_truncated_capture);
+    RUN_TEST(test_malformed);
+    return UNITY_END();
+}
@@ -0,0 +1,195 @@
+/**
+ * @file test_json_reader.c
+ * @brief Host tests for the streaming JSON tokenizer: events, split input, escapes, limits and malformed input
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "json_reader.h"
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+#define LOG_MAX 2048
+
+/**
+ * @brief Events rendered one per line as "depth kind key=value"
+ */
+typedef struct {
+    char text[LOG_MAX];
+    size_t len;
+    int events;
+    int stop_at;                                // Event that returns ESP_FAIL; 0 for none
+} event_log_t;
+
+static event_log_t events;
+static json_reader_t r;
+
+static const char *const kinds[] = { "{", "}", "[", "]", "str", "num", "bool", "null" };
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t record(void *ctx, const json_event_t *event);
+static esp_err_t parse(const char *doc, size_t piece);
+
+// =============================
+// Function Definitions
+// =============================
+
+static esp_err_t record(void *ctx, const json_event_t *event) {
+    event_log_t *log = (event_log_t *)ctx;
+    if (++log->events == log->stop_at) {
+        return ESP_FAIL;
+    }
+    int n = snprintf(log->text + log->len, sizeof(log->text) - log->len, "%u %s %s=%s\n", event->depth,
+                     kinds[event->type], event->key != NULL ? event->key : "-",
+                     event->value != NULL ? event->value : "-");
+    TEST_ASSERT_TRUE(n > 0 && (size_t)n < sizeof(log->text) - log->len);
+    if (event->value != NULL) {
+        TEST_ASSERT_EQUAL(strlen(event->value), event->value_len);
+    }
+    log->len += (size_t)n;
+    return ESP_OK;
+}
+
+/**
+ * @brief Feed doc in pieces of piece bytes (0: all at once) and finish
+ */
+static esp_err_t parse(const char *doc, size_t piece) {
+    memset(&events.text, 0, sizeof(events.text));
+    events.len = 0;
+    events.events = 0;
+    json_reader_init(&r, record, &events);
+    size_t len = strlen(doc);
+    if (piece == 0) {
+        piece = len;
+    }
+    for (size_t i = 0; i < len; i += piece) {
+        json_reader_feed(&r, doc + i, len - i < piece ? len - i : piece);
+    }
+    return json_reader_finish(&r);
+}
+
+void setUp(void) {
+    memset(&events, 0, sizeof(events));
+}
+
+void tearDown(void) {
+}
+
+static void test_events(void) {
+    const char *doc = "{\"ssid\":\"boat\",\"ch\":6,\"on\":true,\"x\":null,\"list\":[1,\"a\",{\"k\":-2.5e3}]}";
+    const char *expected =
+        "0 { -=-\n"
+        "1 str ssid=boat\n"
+        "1 num ch=6\n"
+        "1 bool on=true\n"
+        "1 null x=null\n"
+        "1 [ list=-\n"
+        "2 num -=1\n"
+        "2 str -=a\n"
+        "2 { -=-\n"
+        "3 num k=-2.5e3\n"
+        "2 } -=-\n"
+        "1 ] -=-\n"
+        "0 } -=-\n";
+    TEST_ASSERT_EQUAL(ESP_OK, parse(doc, 0));
+    TEST_ASSERT_EQUAL_STRING(expected, events.text);
+}
+
+static void test_split_anywhere(void) {
+    const char *doc = " { \"name\" : \"a\\\"b\\u00e9\" , \"n\" : [ 12345 , false ] } ";
+    TEST_ASSERT_EQUAL(ESP_OK, parse(doc, 0));
+    char whole[LOG_MAX];
+    strcpy(whole, events.text);
+    for (size_t piece = 1; piece < 8; piece++) {
+        TEST_ASSERT_EQUAL(ESP_OK, parse(doc, piece));
+        TEST_ASSERT_EQUAL_STRING(whole, events.text);
+    }
+}
+
+static void test_escapes(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, parse("[\"\\\\\\/\\b\\f\\n\\r\\t\", \"\\u0041\\u00e9\\u20ac\\ud800\"]", 0));
+    TEST_ASSERT_EQUAL_STRING("0 [ -=-\n"
+                             "1 str -=\\/\b\f\n\r\t\n"
+                             "1 str -=A\xc3\xa9\xe2\x82\xac?\n"
+                             "0 ] -=-\n", events.text);
+}
+
+static void test_root_scalar(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, parse("42", 0));  // No terminator: finish() completes it
+    TEST_ASSERT_EQUAL_STRING("0 num -=42\n", events.text);
+    TEST_ASSERT_EQUAL(ESP_OK, parse("\"s\"  ", 0));
+}
+
+static void test_malformed(void) {
+    const char *bad[] = {
+        "", "{", "[1,]x", "{\"a\" 1}", "{\"a\":1,}", "[1 2]", "{1:2}", "[1}", "}", "{} {}",
+        "[tru]", "[01x]", "[\"a\nb\"]", "[\"\\q\"]", "[\"\\u12G4\"]", "[+1]", "[.5]",
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        esp_err_t err = parse(bad[i], 0);
+        if (err != ESP_ERR_INVALID_ARG) {
+            TEST_MESSAGE(bad[i]);
+        }
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, err);
+    }
+}
+
+static void test_limits(void) {
+    char doc[256];
+    char *p = doc;
+    for (int i = 0; i <= JSON_READER_MAX_DEPTH; i++) {
+        *p++ = '[';
+    }
+    *p = '\0';
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, parse(doc, 0));
+
+    char key[JSON_READER_MAX_KEY + 1];
+    memset(key, 'k', sizeof(key) - 1);
+    key[sizeof(key) - 1] = '\0';
+    snprintf(doc, sizeof(doc), "{\"%s\":1}", key);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, parse(doc, 0));
+    key[JSON_READER_MAX_KEY - 1] = '\0';        // Longest that fits
+    snprintf(doc, sizeof(doc), "{\"%s\":1}", key);
+    TEST_ASSERT_EQUAL(ESP_OK, parse(doc, 0));
+
+    char value[JSON_READER_MAX_TOKEN + 1];
+    memset(value, 'v', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+    snprintf(doc, sizeof(doc), "[\"%s\"]", value);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, parse(doc, 0));
+}
+
+static void test_handler_stops(void) {
+    events.stop_at = 3;
+    TEST_ASSERT_EQUAL(ESP_FAIL, parse("[1,2,3,4]", 0));
+    TEST_ASSERT_EQUAL(3, events.events);        // Nothing after the error
+}
+
+static void test_no_handler(void) {
+    json_reader_init(&r, NULL, NULL);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, json_reader_feed(&r, "1", 1));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_events);
+    RUN_TEST(test_split_anywhere);
+    RUN_TEST(test_escapes);
+    RUN_TEST(test_root_scalar);
+    RUN_TEST(test_malformed);
+    RUN_TEST(test_limits);
+    RUN_TEST(test_handler_stops);
+    RUN_TEST(test_no_handler);
+    return UNITY_END();
+}
@@ -0,0 +1,214 @@
+/**
+ * @file test_json_writer.c
+ * @brief Host tests for the streaming JSON writer: separators, escaping, numbers, flushing and errors
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "json_writer.h"
+#include <math.h>
+#include <string.h>
+#include "unity.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+#define OUT_MAX 4096
+
+/**
+ * @brief Everything the writer flushed, and how
+ */
+typedef struct {
+    char text[OUT_MAX + 1];
+    size_t len;
+    int flushes;                                // Calls with data
+    bool ended;                                 // The (NULL, 0) end call came
+    esp_err_t fail_with;                        // Returned from every data call when set
+} sink_t;
+
+static sink_t sink;
+static json_writer_t w;
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t collect(void *ctx, const char *data, size_t len);
+static const char *finish(void);
+
+// =============================
+// Function Definitions
+// =============================
+
+static esp_err_t collect(void *ctx, const char *data, size_t len) {
+    sink_t *s = (sink_t *)ctx;
+    if (data == NULL) {
+        s->ended = true;
+        return ESP_OK;
+    }
+    s->flushes++;
+    if (s->fail_with != ESP_OK) {
+        return s->fail_with;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(OUT_MAX, s->len + len);
+    memcpy(s->text + s->len, data, len);
+    s->len += len;
+    s->text[s->len] = '\0';
+    return ESP_OK;
+}
+
+/**
+ * @brief Finish the document, expecting success, and return the text
+ */
+static const char *finish(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, json_writer_finish(&w));
+    TEST_ASSERT_TRUE(sink.ended);
+    return sink.text;
+}
+
+void setUp(void) {
+    memset(&sink, 0, sizeof(sink));
+    json_writer_init(&w, collect, &sink);
+}
+
+void tearDown(void) {
+}
+
+static void test_nested_separators(void) {
+    json_obj_begin(&w);
+    json_kv_str(&w, "a", "x");
+    json_key(&w, "b");
+    json_arr_begin(&w);
+    json_uint(&w, 1);
+    json_obj_begin(&w);
+    json_obj_end(&w);
+    json_arr_begin(&w);
+    json_arr_end(&w);
+    json_null(&w);
+    json_arr_end(&w);
+    json_kv_bool(&w, "c", false);
+    json_obj_end(&w);
+    TEST_ASSERT_EQUAL_STRING("{\"a\":\"x\",\"b\":[1,{},[],null],\"c\":false}", finish());
+}
+
+static void test_string_escaping(void) {
+    json_arr_begin(&w);
+    json_str(&w, "q\"b\\n\nr\rt\tb\bf\f");
+    json_str(&w, "\x01\x1f");
+    json_str(&w, "caf\xc3\xa9");               // UTF-8 goes through untouched
+    json_str(&w, NULL);
+    json_arr_end(&w);
+    TEST_ASSERT_EQUAL_STRING("[\"q\\\"b\\\\n\\nr\\rt\\tb\\bf\\f\",\"\\u0001\\u001F\",\"caf\xc3\xa9\",null]", finish());
+}
+
+static void test_integers(void) {
+    json_arr_begin(&w);
+    json_int(&w, 0);
+    json_int(&w, -1);
+    json_int(&w, INT64_MIN);
+    json_int(&w, INT64_MAX);
+    json_uint(&w, UINT64_MAX);
+    json_arr_end(&w);
+    TEST_ASSERT_EQUAL_STRING("[0,-1,-9223372036854775808,9223372036854775807,18446744073709551615]", finish());
+}
+
+static void test_negative_member(void) {
+    json_obj_begin(&w);
+    json_kv_int(&w, "t", -1250);
+    json_kv_int(&w, "u", 7);
+    json_obj_end(&w);
+    TEST_ASSERT_EQUAL_STRING("{\"t\":-1250,\"u\":7}", finish());
+}
+
+static void test_doubles(void) {
+    json_arr_begin(&w);
+    json_double(&w, 21.456, 2);
+    json_double(&w, -0.5, 0);
+    json_double(&w, NAN, 1);
+    json_double(&w, INFINITY, 1);
+    json_double(&w, 1e300, 2);                 // Too long for the number buffer
+    json_arr_end(&w);
+    TEST_ASSERT_EQUAL_STRING("[21.46,-0,null,null,null]", finish());
+}
+
+static void test_hex(void) {
+    const uint8_t bytes[] = { 0x00, 0xAB, 0x7F };
+    json_obj_begin(&w);
+    json_key(&w, "h");
+    json_hex(&w, bytes, sizeof(bytes));
+    json_obj_end(&w);
+    TEST_ASSERT_EQUAL_STRING("{\"h\":\"00AB7F\"}", finish());
+}
+
+static void test_flushes_when_full(void) {
+    char value[JSON_WRITER_BUF_SIZE];
+    memset(value, 'v', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+
+    json_arr_begin(&w);
+    json_str(&w, value);
+    json_str(&w, value);
+    json_arr_end(&w);
+    const char *text = finish();
+    TEST_ASSERT_EQUAL(2 * (JSON_WRITER_BUF_SIZE - 1 + 2) + 3, strlen(text));
+    TEST_ASSERT_EQUAL(3, sink.flushes);
+    TEST_ASSERT_EQUAL('[', text[0]);
+    TEST_ASSERT_EQUAL(']', text[strlen(text) - 1]);
+}
+
+static void test_unbalanced(void) {
+    json_obj_begin(&w);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, json_writer_finish(&w));
+    TEST_ASSERT_TRUE(sink.ended);               // The stream is still ended
+
+    setUp();
+    json_arr_end(&w);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, json_writer_finish(&w));
+}
+
+static void test_too_deep(void) {
+    for (int i = 0; i <= JSON_WRITER_MAX_DEPTH; i++) {
+        json_arr_begin(&w);
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, w.err);
+}
+
+static void test_flush_error_sticks(void) {
+    sink.fail_with = ESP_FAIL;
+    char value[JSON_WRITER_BUF_SIZE];
+    memset(value, 'v', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+
+    json_arr_begin(&w);
+    json_str(&w, value);
+    json_str(&w, value);
+    json_arr_end(&w);
+    TEST_ASSERT_EQUAL(ESP_FAIL, json_writer_finish(&w));
+    TEST_ASSERT_EQUAL(1, sink.flushes);         // Nothing more after the first failure
+}
+
+static void test_no_sink(void) {
+    json_writer_init(&w, NULL, NULL);
+    json_null(&w);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, json_writer_finish(&w));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_nested_separators);
+    RUN_TEST(test_string_escaping);
+    RUN_TEST(test_integers);
+    RUN_TEST(test_negative_member);
+    RUN_TEST(test_doubles);
+    RUN_TEST(test_hex);
+    RUN_TEST(test_flushes_when_full);
+    RUN_TEST(test_unbalanced);
+    RUN_TEST(test_too_deep);
+    RUN_TEST(test_flush_error_sticks);
+    RUN_TEST(test_no_sink);
+    return UNITY_END();
+}
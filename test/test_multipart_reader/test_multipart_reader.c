@@ -0,0 +1,215 @@
+/**
+ * @file test_multipart_reader.c
+ * @brief Host tests for the multipart/form-data parser: parts, boundaries across pieces, look-alikes, errors
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "multipart_reader.h"
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+#define CONTENT_TYPE "multipart/form-data; boundary=----WebKitFormBoundaryX3"
+#define BOUNDARY "------WebKitFormBoundaryX3"   // "--" + the boundary, as it appears in the body
+#define LOG_MAX 4096
+
+/**
+ * @brief Parts rendered as "<name|filename>data</>", data concatenated across calls
+ */
+typedef struct {
+    char text[LOG_MAX];
+    size_t len;
+    int data_calls;
+    int parts;
+    int fail_part;                              // on_part_begin of this part (1-based) fails; 0 for none
+} part_log_t;
+
+static part_log_t parts;
+static multipart_reader_t r;
+
+// =============================
+// Function Prototypes
+// =============================
+static void append(const char *data, size_t len);
+static esp_err_t on_begin(void *ctx, const char *name, const char *filename);
+static esp_err_t on_data(void *ctx, const uint8_t *data, size_t len);
+static esp_err_t on_end(void *ctx);
+static esp_err_t parse(const char *body, size_t len, size_t piece);
+
+static const multipart_callbacks_t callbacks = { on_begin, on_data, on_end };
+
+// =============================
+// Function Definitions
+// =============================
+
+static void append(const char *data, size_t len) {
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(parts.text) - 1, parts.len + len);
+    memcpy(parts.text + parts.len, data, len);
+    parts.len += len;
+    parts.text[parts.len] = '\0';
+}
+
+static esp_err_t on_begin(void *ctx, const char *name, const char *filename) {
+    (void)ctx;
+    if (++parts.parts == parts.fail_part) {
+        return ESP_FAIL;
+    }
+    char tag[MULTIPART_NAME_MAX + MULTIPART_FILENAME_MAX + 4];
+    int n = snprintf(tag, sizeof(tag), "<%s|%s>", name, filename != NULL ? filename : "-");
+    append(tag, (size_t)n);
+    return ESP_OK;
+}
+
+static esp_err_t on_data(void *ctx, const uint8_t *data, size_t len) {
+    (void)ctx;
+    TEST_ASSERT_GREATER_THAN(0, len);
+    parts.data_calls++;
+    append((const char *)data, len);
+    return ESP_OK;
+}
+
+static esp_err_t on_end(void *ctx) {
+    (void)ctx;
+    append("</>", 3);
+    return ESP_OK;
+}
+
+/**
+ * @brief Feed body in pieces of piece bytes (0: all at once) and finish
+ */
+static esp_err_t parse(const char *body, size_t len, size_t piece) {
+    memset(&parts, 0, offsetof(part_log_t, fail_part));
+    esp_err_t err = multipart_reader_init(&r, CONTENT_TYPE, &callbacks, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (piece == 0) {
+        piece = len;
+    }
+    for (size_t i = 0; i < len; i += piece) {
+        multipart_reader_feed(&r, (const uint8_t *)body + i, len - i < piece ? len - i : piece);
+    }
+    return multipart_reader_finish(&r);
+}
+
+void setUp(void) {
+    memset(&parts, 0, sizeof(parts));
+}
+
+void tearDown(void) {
+}
+
+static const char form[] =
+    BOUNDARY "\r\n"
+    "Content-Disposition: form-data; name=\"sha256\"\r\n"
+    "\r\n"
+    "abc123\r\n"
+    BOUNDARY "\r\n"
+    "Content-Disposition: form-data; name=\"firmware\"; filename=\"fw.bin\"\r\n"
+    "Content-Type: application/octet-stream\r\n"
+    "\r\n"
+    "\x00\x01\r\n-\r\n--\r\n------WebKitFormBoundaryX\r\r\n\r\n" "tail\r\n"
+    BOUNDARY "--\r\n"
+    "epilogue";
+
+static const char form_parts[] =
+    "<sha256|->abc123</>"
+    "<firmware|fw.bin>\x00\x01\r\n-\r\n--\r\n------WebKitFormBoundaryX\r\r\n\r\ntail</>";
+#define FORM_PARTS_LEN (sizeof(form_parts) - 1)
+
+static void test_parts(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, parse(form, sizeof(form) - 1, 0));
+    TEST_ASSERT_EQUAL(FORM_PARTS_LEN, parts.len);
+    TEST_ASSERT_EQUAL_MEMORY(form_parts, parts.text, FORM_PARTS_LEN);
+    TEST_ASSERT_EQUAL(2, parts.data_calls);     // One span of the input per part
+}
+
+static void test_every_split(void) {
+    for (size_t piece = 1; piece <= sizeof(form); piece++) {
+        TEST_ASSERT_EQUAL(ESP_OK, parse(form, sizeof(form) - 1, piece));
+        if (parts.len != FORM_PARTS_LEN || memcmp(form_parts, parts.text, FORM_PARTS_LEN) != 0) {
+            char where[40];
+            snprintf(where, sizeof(where), "pieces of %u bytes", (unsigned)piece);
+            TEST_FAIL_MESSAGE(where);
+        }
+    }
+}
+
+static void test_preamble_and_padding(void) {
+    static const char body[] =
+        "ignored preamble\r\n"
+        BOUNDARY " \t\r\n"
+        "content-disposition: form-data; name=plain\r\n"
+        "\r\n"
+        "v\r\n"
+        BOUNDARY "--";
+    TEST_ASSERT_EQUAL(ESP_OK, parse(body, sizeof(body) - 1, 0));
+    TEST_ASSERT_EQUAL_STRING("<plain|->v</>", parts.text);
+}
+
+static void test_empty_part(void) {
+    static const char body[] =
+        BOUNDARY "\r\n"
+        "Content-Disposition: form-data; name=\"e\"\r\n"
+        "\r\n"
+        "\r\n"
+        BOUNDARY "--\r\n";
+    TEST_ASSERT_EQUAL(ESP_OK, parse(body, sizeof(body) - 1, 0));
+    TEST_ASSERT_EQUAL_STRING("<e|-></>", parts.text);
+    TEST_ASSERT_EQUAL(0, parts.data_calls);
+}
+
+static void test_truncated(void) {
+    for (size_t len = 0; len < sizeof(form) - 1 - strlen("--\r\nepilogue"); len++) {
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, parse(form, len, 0));
+    }
+}
+
+static void test_bad_after_boundary(void) {
+    static const char body[] = BOUNDARY "x\r\n";
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, parse(body, sizeof(body) - 1, 0));
+    static const char half_close[] = BOUNDARY "-x";
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, parse(half_close, sizeof(half_close) - 1, 0));
+}
+
+static void test_content_types(void) {
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, multipart_reader_init(&r, "application/json", &callbacks, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, multipart_reader_init(&r, "multipart/form-data", &callbacks, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG,
+                      multipart_reader_init(&r, "multipart/form-data; boundary=", &callbacks, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, multipart_reader_init(&r, "Multipart/Form-Data; BOUNDARY=\"q b\"", &callbacks, NULL));
+
+    char too_long[128];
+    memset(too_long, 0, sizeof(too_long));
+    strcpy(too_long, "multipart/form-data; boundary=");
+    memset(too_long + strlen(too_long), 'b', MULTIPART_BOUNDARY_MAX + 1);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, multipart_reader_init(&r, too_long, &callbacks, NULL));
+}
+
+static void test_handler_error(void) {
+    parts.fail_part = 2;
+    TEST_ASSERT_EQUAL(ESP_FAIL, parse(form, sizeof(form) - 1, 0));
+    TEST_ASSERT_EQUAL_STRING("<sha256|->abc123</>", parts.text);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_parts);
+    RUN_TEST(test_every_split);
+    RUN_TEST(test_preamble_and_padding);
+    RUN_TEST(test_empty_part);
+    RUN_TEST(test_truncated);
+    RUN_TEST(test_bad_after_boundary);
+    RUN_TEST(test_content_types);
+    RUN_TEST(test_handler_error);
+    return UNITY_END();
+}
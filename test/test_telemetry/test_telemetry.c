@@ -0,0 +1,297 @@
+/**
+ * @file test_telemetry.c
+ * @brief Host tests for the telemetry frame codec: wire layout, extensions, packed records, limits, bad frames
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "telemetry.h"
+#include <string.h>
+#include "unity.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+#define NODE_ID 0xA1B2C3D4u
+#define BASE_SEQ 1000u
+#define BASE_TIME 1790000000u
+#define SERIES_LEN 40
+
+static uint8_t frame[TELEMETRY_FRAME_MAX];
+static telemetry_writer_t w;
+
+// =============================
+// Function Prototypes
+// =============================
+static telemetry_record_t sample(uint32_t i);
+static void assert_same(const telemetry_record_t *expected, const telemetry_record_t *actual);
+static size_t encode_series(bool packed, uint32_t count);
+
+// =============================
+// Function Definitions
+// =============================
+
+/**
+ * @brief Record i of a series sampled every 60 s, already at the encoded resolution
+ */
+static telemetry_record_t sample(uint32_t i) {
+    telemetry_record_t rec = {
+        .seq = BASE_SEQ + i,
+        .time_s = BASE_TIME + 60 * i + (i == 7 ? 3 : 0),   // One late sample
+        .temperature = (int16_t)(-150 + (int16_t)(i % 5)),
+        .pressure = 101324 + 2 * (i / 4),
+        .humidity = 55000 + 10 * (i % 3),
+        .gas_resistance = i < 20 ? 120000 : 4095,
+        .heater_step = (uint8_t)(i % 10),
+        .gas_valid = i != 3,
+        .heat_stable = true,
+        .held = i == 12,
+        .urgent = i == 30,
+    };
+    return rec;
+}
+
+static void assert_same(const telemetry_record_t *expected, const telemetry_record_t *actual) {
+    TEST_ASSERT_EQUAL_UINT32(expected->seq, actual->seq);
+    TEST_ASSERT_EQUAL_UINT32(expected->time_s, actual->time_s);
+    TEST_ASSERT_EQUAL_INT16(expected->temperature, actual->temperature);
+    TEST_ASSERT_EQUAL_UINT32(expected->pressure, actual->pressure);
+    TEST_ASSERT_EQUAL_UINT32(expected->humidity, actual->humidity);
+    TEST_ASSERT_EQUAL_UINT32(expected->gas_resistance, actual->gas_resistance);
+    TEST_ASSERT_EQUAL(expected->heater_step, actual->heater_step);
+    TEST_ASSERT_EQUAL(expected->gas_valid, actual->gas_valid);
+    TEST_ASSERT_EQUAL(expected->heat_stable, actual->heat_stable);
+    TEST_ASSERT_EQUAL(expected->held, actual->held);
+    TEST_ASSERT_EQUAL(expected->urgent, actual->urgent);
+}
+
+/**
+ * @brief A frame of the first count records of the series; returns its length
+ */
+static size_t encode_series(bool packed, uint32_t count) {
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_init(&w, frame, sizeof(frame), NODE_ID, 0));
+    if (packed) {
+        TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_set_packed(&w));
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        telemetry_record_t rec = sample(i);
+        TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_add(&w, &rec));
+    }
+    return w.len;
+}
+
+void setUp(void) {
+    memset(frame, 0, sizeof(frame));
+}
+
+void tearDown(void) {
+}
+
+static void test_wire_layout(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_init(&w, frame, sizeof(frame), NODE_ID, TELEMETRY_FLAG_SAMPLES_LOST));
+    telemetry_record_t rec = {
+        .seq = 0x01020304, .time_s = 0x05060708, .temperature = -1, .pressure = 30000 + 2 * 0x0A0B,
+        .humidity = 10 * 0x0C0D, .gas_resistance = 0x0123, .heater_step = 3, .gas_valid = true,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_add(&w, &rec));
+    const uint8_t expected[TELEMETRY_HEADER_LEN + TELEMETRY_RECORD_LEN] = {
+        TELEMETRY_MAGIC, 0x11, 1, TELEMETRY_FLAG_SAMPLES_LOST, 0xD4, 0xC3, 0xB2, 0xA1,
+        0x04, 0x03, 0x02, 0x01, 0x08, 0x07, 0x06, 0x05,
+        0x00, 0x00, 0xFF, 0xFF, 0x0B, 0x0A, 0x0D, 0x0C, 0x23, 0x01, TELEMETRY_REC_GAS_VALID | (3 << 2),
+    };
+    TEST_ASSERT_EQUAL(sizeof(expected), w.len);
+    TEST_ASSERT_EQUAL_MEMORY(expected, frame, sizeof(expected));
+}
+
+static void test_extensions(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_init(&w, frame, sizeof(frame), NODE_ID, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_set_power(&w, 1234, 70000));
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_set_rain(&w, 0x12345, 250));
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_set_config(&w, 9));
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_set_health(&w, 3300, 100000));
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_set_key(&w, 0xDEADBEEF, 4242));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, telemetry_writer_set_health(&w, 3300, 0));  // Once only
+    telemetry_record_t rec = sample(0);
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_add(&w, &rec));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, telemetry_writer_set_config(&w, 1));       // After a record
+    telemetry_writer_set_lr(&w);
+    telemetry_writer_set_flags(&w, TELEMETRY_FLAG_MORE);
+
+    telemetry_header_t hdr;
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_decode_header(frame, w.len, &hdr));
+    TEST_ASSERT_EQUAL_HEX8(TELEMETRY_FLAG_EXTENSIONS | TELEMETRY_FLAG_LR | TELEMETRY_FLAG_MORE, hdr.flags);
+    TEST_ASSERT_EQUAL(TELEMETRY_HEADER_LEN + TELEMETRY_POWER_LEN + TELEMETRY_RAIN_LEN + TELEMETRY_CONFIG_LEN +
+                      TELEMETRY_HEALTH_LEN + TELEMETRY_KEY_LEN, hdr.header_len);
+    TEST_ASSERT_EQUAL(1234, hdr.awake_bp);
+    TEST_ASSERT_EQUAL(UINT16_MAX, hdr.wake_ms);             // Saturated
+    TEST_ASSERT_EQUAL(0x2345, hdr.rain_tips);               // Low 16 bits
+    TEST_ASSERT_EQUAL(250, hdr.rain_rate);
+    TEST_ASSERT_EQUAL(9, hdr.config_version);
+    TEST_ASSERT_EQUAL(3300, hdr.supply_mv);
+    TEST_ASSERT_EQUAL(UINT16_MAX, hdr.backlog);
+    TEST_ASSERT_EQUAL_UINT32(0xDEADBEEF, hdr.key_fingerprint);
+    TEST_ASSERT_EQUAL_UINT32(4242, hdr.key_switch_seq);
+
+    telemetry_record_t out;
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_decode_record(frame, &hdr, 0, &out));
+    assert_same(&rec, &out);
+}
+
+static void test_no_extensions_defaults(void) {
+    size_t len = encode_series(false, 1);
+    telemetry_header_t hdr;
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_decode_header(frame, len, &hdr));
+    TEST_ASSERT_EQUAL(TELEMETRY_HEALTH_UNKNOWN, hdr.supply_mv);
+    TEST_ASSERT_EQUAL(0, hdr.config_version);
+    TEST_ASSERT_EQUAL(TELEMETRY_HEADER_LEN, hdr.header_len);
+}
+
+static void test_fixed_round_trip(void) {
+    size_t len = encode_series(false, TELEMETRY_MAX_RECORDS);
+    TEST_ASSERT_EQUAL(TELEMETRY_HEADER_LEN + TELEMETRY_MAX_RECORDS * TELEMETRY_RECORD_LEN, len);
+    telemetry_record_t extra = sample(TELEMETRY_MAX_RECORDS);
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, telemetry_writer_add(&w, &extra));
+    TEST_ASSERT_EQUAL(len, w.len);              // Unchanged
+
+    telemetry_header_t hdr;
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_decode_header(frame, len, &hdr));
+    TEST_ASSERT_EQUAL(TELEMETRY_TYPE_BME680, hdr.type);
+    TEST_ASSERT_EQUAL(TELEMETRY_MAX_RECORDS, hdr.count);
+    TEST_ASSERT_EQUAL_UINT32(NODE_ID, hdr.node_id);
+    TEST_ASSERT_EQUAL_UINT32(BASE_SEQ, hdr.base_seq);
+    TEST_ASSERT_EQUAL_UINT32(BASE_TIME, hdr.base_time_s);
+
+    telemetry_reader_t r;
+    telemetry_record_t out;
+    telemetry_reader_init(&r, frame, &hdr);
+    for (uint32_t i = 0; i < TELEMETRY_MAX_RECORDS; i++) {
+        telemetry_record_t expected = sample(i);
+        TEST_ASSERT_EQUAL(ESP_OK, telemetry_reader_next(&r, &out));
+        assert_same(&expected, &out);
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, telemetry_reader_next(&r, &out));
+}
+
+static void test_packed_round_trip(void) {
+    size_t len = encode_series(true, SERIES_LEN);
+    TEST_ASSERT_LESS_THAN(TELEMETRY_HEADER_LEN + SERIES_LEN * 5, len);     // Far under the fixed size
+
+    telemetry_header_t hdr;
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_decode_header(frame, len, &hdr));
+    TEST_ASSERT_EQUAL(TELEMETRY_TYPE_BME680_PACKED, hdr.type);
+    TEST_ASSERT_EQUAL(SERIES_LEN, hdr.count);
+    telemetry_reader_t r;
+    telemetry_record_t out;
+    telemetry_reader_init(&r, frame, &hdr);
+    for (uint32_t i = 0; i < SERIES_LEN; i++) {
+        telemetry_record_t expected = sample(i);
+        TEST_ASSERT_EQUAL(ESP_OK, telemetry_reader_next(&r, &out));
+        assert_same(&expected, &out);
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, telemetry_reader_next(&r, &out));
+
+    telemetry_record_t expected = sample(25);   // Random access decodes from the start
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_decode_record(frame, &hdr, 25, &out));
+    assert_same(&expected, &out);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, telemetry_decode_record(frame, &hdr, SERIES_LEN, &out));
+}
+
+static void test_packed_steady_series(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_init(&w, frame, sizeof(frame), NODE_ID, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_set_packed(&w));
+    telemetry_record_t rec = sample(0);
+    for (uint32_t i = 0; i < TELEMETRY_PACKED_MAX_RECORDS; i++) {
+        rec.seq = BASE_SEQ + i;
+        rec.time_s = BASE_TIME + 300 * i;
+        TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_add(&w, &rec));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, telemetry_writer_add(&w, &rec));
+    // From record 2 on nothing differs from its prediction: one mask byte each
+    TEST_ASSERT_LESS_OR_EQUAL(TELEMETRY_HEADER_LEN + 2 * TELEMETRY_PACKED_RECORD_MAX + TELEMETRY_PACKED_MAX_RECORDS,
+                              w.len);
+}
+
+static void test_writer_rejects(void) {
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, telemetry_writer_init(&w, frame, TELEMETRY_HEADER_LEN - 1, NODE_ID, 0));
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, telemetry_writer_add(&w, &(telemetry_record_t){ 0 }));
+
+    encode_series(false, 2);
+    telemetry_record_t gap = sample(3);         // Seq does not follow on
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, telemetry_writer_add(&w, &gap));
+    telemetry_record_t late = sample(2);
+    late.time_s = BASE_TIME + UINT16_MAX + 1;   // Past the 16-bit time delta
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, telemetry_writer_add(&w, &late));
+    late.time_s = BASE_TIME - 1;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, telemetry_writer_add(&w, &late));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, telemetry_writer_set_packed(&w));
+    TEST_ASSERT_EQUAL(2, w.count);
+
+    uint8_t small[TELEMETRY_HEADER_LEN + 2];
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_init(&w, small, sizeof(small), NODE_ID, 0));
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, telemetry_writer_set_power(&w, 0, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_set_config(&w, 1));
+}
+
+static void test_quantization(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_init(&w, frame, sizeof(frame), NODE_ID, 0));
+    telemetry_record_t in[] = {
+        { .seq = 1, .time_s = BASE_TIME, .pressure = 101325, .humidity = 54996, .gas_resistance = 4095 },
+        { .seq = 2, .time_s = BASE_TIME, .pressure = 1000, .humidity = 120000, .gas_resistance = 4097 },
+        { .seq = 3, .time_s = BASE_TIME, .pressure = 999999, .humidity = 4, .gas_resistance = UINT32_MAX },
+    };
+    const uint32_t pressure[] = { 101326, TELEMETRY_PRESSURE_OFFSET_PA, TELEMETRY_PRESSURE_OFFSET_PA + 2 * 65535 };
+    const uint32_t humidity[] = { 55000, 100000, 0 };
+    const uint32_t gas[] = { 4095, 4098, 4095u << 15 };
+    for (size_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, telemetry_writer_add(&w, &in[i]));
+    }
+    telemetry_header_t hdr;
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_decode_header(frame, w.len, &hdr));
+    for (uint8_t i = 0; i < 3; i++) {
+        telemetry_record_t out;
+        TEST_ASSERT_EQUAL(ESP_OK, telemetry_decode_record(frame, &hdr, i, &out));
+        TEST_ASSERT_EQUAL_UINT32(pressure[i], out.pressure);
+        TEST_ASSERT_EQUAL_UINT32(humidity[i], out.humidity);
+        TEST_ASSERT_EQUAL_UINT32(gas[i], out.gas_resistance);
+    }
+}
+
+static void test_decode_rejects(void) {
+    size_t len = encode_series(false, 3);
+    telemetry_header_t hdr;
+    for (size_t n = 0; n < len; n++) {
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, telemetry_decode_header(frame, n, &hdr));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, telemetry_decode_header(frame, len + 1, &hdr));
+    frame[0] ^= 0xFF;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, telemetry_decode_header(frame, len, &hdr));
+    frame[0] ^= 0xFF;
+    frame[1] = (TELEMETRY_VERSION << 4) | 0x0F;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, telemetry_decode_header(frame, len, &hdr));
+
+    len = encode_series(true, SERIES_LEN);
+    for (size_t n = TELEMETRY_HEADER_LEN; n < len; n++) {
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, telemetry_decode_header(frame, n, &hdr));
+    }
+    frame[TELEMETRY_HEADER_LEN] = 0xC0;         // Mask bits past the columns
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, telemetry_decode_header(frame, len, &hdr));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_wire_layout);
+    RUN_TEST(test_extensions);
+    RUN_TEST(test_no_extensions_defaults);
+    RUN_TEST(test_fixed_round_trip);
+    RUN_TEST(test_packed_round_trip);
+    RUN_TEST(test_packed_steady_series);
+    RUN_TEST(test_writer_rejects);
+    RUN_TEST(test_quantization);
+    RUN_TEST(test_decode_rejects);
+    return UNITY_END();
+}
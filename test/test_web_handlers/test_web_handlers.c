@@ -0,0 +1,400 @@
+/**
+ * @file test_web_handlers.c
+ * @brief Host tests for the portable web handlers through the memory adapter: uploads, config get and save
+ * @version 1.0.0
+ * @date 2026-10-15
+ * @author John Devine
+ * @email john.h.devine@gmail.com
+ */
+
+// =============================
+// Includes
+// =============================
+#include "web_handlers.h"
+#include "config_schema.h"
+#include "http_io.h"
+#include "multipart_reader.h"
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+
+// =============================
+// Constants & Definitions
+// =============================
+#define BOUNDARY "----WebKitFormBoundaryW7"
+#define CONTENT_TYPE_HEADER "Content-Type: multipart/form-data; boundary=" BOUNDARY "\n"
+#define HASH_A "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+#define HASH_B "fedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210"
+#define IMAGE_MAX 2048
+#define BODY_MAX 4096
+#define OUT_MAX 4096
+#define OTA_BUF_LEN 100                         // Short, so a part spans several receive buffers
+
+/**
+ * @brief What the upload sink was handed
+ */
+typedef struct {
+    int begins;
+    int writes;
+    int aborts;
+    esp_err_t begin_result;
+    web_ota_form_t form;                        // As seen by begin()
+    char filename[MULTIPART_FILENAME_MAX];
+    uint8_t data[IMAGE_MAX];
+    size_t len;
+} sink_log_t;
+
+static sink_log_t sink_log;
+static uint8_t image[IMAGE_MAX];
+static char body[BODY_MAX];
+static char out[OUT_MAX];
+static web_config_body_t config_body;
+
+// =============================
+// Function Prototypes
+// =============================
+static esp_err_t sink_begin(void *ctx, const web_ota_form_t *form, const char *filename);
+static esp_err_t sink_write(void *ctx, const uint8_t *data, size_t len);
+static void sink_abort(void *ctx);
+static size_t build_upload(const char *fields, size_t image_len);
+static esp_err_t upload(const char *headers, size_t len, size_t recv_max, web_ota_form_t *form, http_io_mem_t *mem);
+static void modified_config(device_config_t *cfg);
+
+static const web_ota_sink_t sink = { sink_begin, sink_write, sink_abort };
+
+// =============================
+// Function Definitions
+// =============================
+
+static esp_err_t sink_begin(void *ctx, const web_ota_form_t *form, const char *filename) {
+    (void)ctx;
+    sink_log.begins++;
+    sink_log.form = *form;
+    snprintf(sink_log.filename, sizeof(sink_log.filename), "%s", filename);
+    return sink_log.begin_result;
+}
+
+static esp_err_t sink_write(void *ctx, const uint8_t *data, size_t len) {
+    (void)ctx;
+    TEST_ASSERT_GREATER_THAN(0, len);
+    TEST_ASSERT_LESS_OR_EQUAL(OTA_BUF_LEN, len);
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(sink_log.data), sink_log.len + len);
+    memcpy(sink_log.data + sink_log.len, data, len);
+    sink_log.len += len;
+    sink_log.writes++;
+    return ESP_OK;
+}
+
+static void sink_abort(void *ctx) {
+    (void)ctx;
+    sink_log.aborts++;
+}
+
+/**
+ * @brief A multipart body: the given text fields (already framed) then image[] as the file part
+ * @return Body length in body[]
+ */
+static size_t build_upload(const char *fields, size_t image_len) {
+    int n = snprintf(body, sizeof(body),
+                     "%s--" BOUNDARY "\r\n"
+                     "Content-Disposition: form-data; name=\"update\"; filename=\"firmware.bin\"\r\n"
+                     "Content-Type: application/octet-stream\r\n\r\n",
+                     fields);
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(body), (size_t)n + image_len + 64);
+    memcpy(body + n, image, image_len);
+    n += (int)image_len;
+    n += snprintf(body + n, sizeof(body) - (size_t)n, "\r\n--" BOUNDARY "--\r\n");
+    return (size_t)n;
+}
+
+/**
+ * @brief Run web_ota_receive over the first len bytes of body[], handed out recv_max bytes at a time
+ */
+static esp_err_t upload(const char *headers, size_t len, size_t recv_max, web_ota_form_t *form, http_io_mem_t *mem) {
+    http_io_t io;
+    uint8_t buf[OTA_BUF_LEN];
+
+    memset(&sink_log, 0, sizeof(sink_log));
+    *mem = (http_io_mem_t){ .body = body, .body_len = len, .recv_max = recv_max, .headers = headers,
+                            .out = out, .out_cap = sizeof(out) };
+    http_io_init_mem(&io, mem);
+    return web_ota_receive(&io, &sink, NULL, buf, sizeof(buf), form);
+}
+
+/**
+ * @brief Defaults with a member of each kind changed
+ */
+static void modified_config(device_config_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    config_schema_defaults(cfg);
+    strcpy(cfg->mqtt_server_ip, "10.1.2.3");
+    strcpy(cfg->mqtt_base_topic, "lab/\"west\"\\bench");
+    strcpy(cfg->bridge_ssid, "Workshop");
+    cfg->mqtt_port = 8883;
+    cfg->mqtt_qos = 2;
+    cfg->espnow_active_key[0] = 0xA5;
+    cfg->espnow_active_key[sizeof(cfg->espnow_active_key) - 1] = 0x5A;
+}
+
+void setUp(void) {
+    for (size_t i = 0; i < sizeof(image); i++) {
+        image[i] = (uint8_t)(i * 131 + 7);
+    }
+    memset(&config_body, 0, sizeof(config_body));
+}
+
+void tearDown(void) {
+}
+
+static void test_ota_upload_split_across_reads(void) {
+    const char *fields = "--" BOUNDARY "\r\n"
+                         "Content-Disposition: form-data; name=\"type\"\r\n\r\n"
+                         "filesystem\r\n"
+                         "--" BOUNDARY "\r\n"
+                         "Content-Disposition: form-data; name=\"hash\"\r\n\r\n"
+                         HASH_A "\r\n";
+    size_t len = build_upload(fields, 1500);
+    static const size_t reads[] = { 1, 2, 3, 7, 13, 40, 99, 100, 101, 1460, 0 };
+
+    for (size_t i = 0; i < sizeof(reads) / sizeof(reads[0]); i++) {
+        web_ota_form_t form;
+        http_io_mem_t mem;
+        TEST_ASSERT_EQUAL(ESP_OK, upload(CONTENT_TYPE_HEADER, len, reads[i], &form, &mem));
+        TEST_ASSERT_EQUAL(len, mem.pos);
+        TEST_ASSERT_EQUAL(1, sink_log.begins);
+        TEST_ASSERT_EQUAL(0, sink_log.aborts);
+        TEST_ASSERT_EQUAL_STRING("firmware.bin", sink_log.filename);
+        TEST_ASSERT_TRUE(sink_log.form.filesystem);
+        TEST_ASSERT_FALSE(sink_log.form.for_nodes);
+        TEST_ASSERT_EQUAL_STRING(HASH_A, sink_log.form.hash);
+        TEST_ASSERT_EQUAL(1500, sink_log.len);
+        TEST_ASSERT_EQUAL_MEMORY(image, sink_log.data, 1500);
+        TEST_ASSERT_EQUAL(0, mem.out_len);      // The caller answers a good upload
+    }
+}
+
+static void test_ota_hash_header_and_field(void) {
+    web_ota_form_t form;
+    http_io_mem_t mem;
+    size_t len = build_upload("", 300);
+
+    // Header only
+    TEST_ASSERT_EQUAL(ESP_OK, upload(CONTENT_TYPE_HEADER "X-Image-SHA256: " HASH_B "\n", len, 17, &form, &mem));
+    TEST_ASSERT_EQUAL_STRING(HASH_B, form.hash);
+    TEST_ASSERT_FALSE(form.filesystem);
+
+    // The form field wins over the header
+    len = build_upload("--" BOUNDARY "\r\nContent-Disposition: form-data; name=\"hash\"\r\n\r\n" HASH_A "\r\n", 300);
+    TEST_ASSERT_EQUAL(ESP_OK, upload(CONTENT_TYPE_HEADER "x-image-sha256: " HASH_B "\n", len, 17, &form, &mem));
+    TEST_ASSERT_EQUAL_STRING(HASH_A, form.hash);
+    TEST_ASSERT_EQUAL_MEMORY(image, sink_log.data, 300);
+}
+
+static void test_ota_rejects(void) {
+    web_ota_form_t form;
+    http_io_mem_t mem;
+
+    // A hash that is not 64 hex digits
+    size_t len = build_upload("", 64);
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, upload(CONTENT_TYPE_HEADER "X-Image-SHA256: 0123xyz\n", len, 0, &form, &mem));
+    TEST_ASSERT_EQUAL(400, mem.status);
+    TEST_ASSERT_EQUAL(0, sink_log.begins);
+    TEST_ASSERT_NOT_NULL(strstr(out, "Invalid image hash"));
+
+    // Filesystem images are not sent to the nodes
+    len = build_upload("--" BOUNDARY "\r\nContent-Disposition: form-data; name=\"type\"\r\n\r\nfilesystem\r\n"
+                       "--" BOUNDARY "\r\nContent-Disposition: form-data; name=\"target\"\r\n\r\nnodes\r\n", 64);
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, upload(CONTENT_TYPE_HEADER, len, 0, &form, &mem));
+    TEST_ASSERT_EQUAL(400, mem.status);
+    TEST_ASSERT_EQUAL(0, sink_log.begins);
+
+    // No boundary to parse with
+    len = build_upload("", 64);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, upload("Content-Type: text/plain\n", len, 0, &form, &mem));
+    TEST_ASSERT_EQUAL(400, mem.status);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, upload(NULL, len, 0, &form, &mem));
+    TEST_ASSERT_EQUAL(400, mem.status);
+
+    // Empty body
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, upload(CONTENT_TYPE_HEADER, 0, 0, &form, &mem));
+    TEST_ASSERT_EQUAL(400, mem.status);
+
+    // Cut off before the closing boundary: the started sink is aborted
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, upload(CONTENT_TYPE_HEADER, len - 10, 9, &form, &mem));
+    TEST_ASSERT_EQUAL(400, mem.status);
+    TEST_ASSERT_EQUAL(1, sink_log.begins);
+    TEST_ASSERT_EQUAL(1, sink_log.aborts);
+
+    // A sink that cannot start
+    memset(&sink_log, 0, sizeof(sink_log));
+    sink_log.begin_result = ESP_ERR_NO_MEM;
+    http_io_t io;
+    uint8_t buf[OTA_BUF_LEN];
+    mem = (http_io_mem_t){ .body = body, .body_len = len, .headers = CONTENT_TYPE_HEADER,
+                           .out = out, .out_cap = sizeof(out) };
+    http_io_init_mem(&io, &mem);
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, web_ota_receive(&io, &sink, NULL, buf, sizeof(buf), &form));
+    TEST_ASSERT_EQUAL(500, mem.status);
+    TEST_ASSERT_EQUAL(0, sink_log.aborts);
+}
+
+static void test_config_get(void) {
+    device_config_t cfg;
+    http_io_mem_t mem = { .out = out, .out_cap = sizeof(out) - 1 };
+    http_io_t io;
+
+    modified_config(&cfg);
+    http_io_init_mem(&io, &mem);
+    TEST_ASSERT_EQUAL(ESP_OK, web_config_send(&io, &cfg, 42));
+    out[mem.out_len] = '\0';
+
+    TEST_ASSERT_EQUAL(200, mem.status);
+    TEST_ASSERT_EQUAL_STRING("application/json", mem.type);
+    TEST_ASSERT_TRUE(mem.ended);
+    TEST_ASSERT_LESS_OR_EQUAL(mem.out_cap, mem.out_len);
+    TEST_ASSERT_EQUAL('{', out[0]);
+    TEST_ASSERT_EQUAL('}', out[mem.out_len - 1]);
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"mqttServerIp\":\"10.1.2.3\""));
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"mqttPort\":8883"));
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"mqttBaseTopic\":\"lab/\\\"west\\\"\\\\bench\""));
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"bootCount\":42}"));
+
+    // HEAD: the headers only
+    mem = (http_io_mem_t){ .head = true, .out = out, .out_cap = sizeof(out) };
+    http_io_init_mem(&io, &mem);
+    TEST_ASSERT_EQUAL(ESP_OK, web_config_send(&io, &cfg, 42));
+    TEST_ASSERT_EQUAL_STRING("application/json", mem.type);
+    TEST_ASSERT_TRUE(mem.ended);
+    TEST_ASSERT_EQUAL(0, mem.out_len);
+}
+
+static void test_config_save_round_trip(void) {
+    device_config_t sent;
+    http_io_mem_t mem = { .out = body, .out_cap = sizeof(body) };
+    http_io_t io;
+
+    modified_config(&sent);
+    http_io_init_mem(&io, &mem);
+    TEST_ASSERT_EQUAL(ESP_OK, web_config_send(&io, &sent, 42));
+    size_t len = mem.out_len;
+
+    // What GET returned, saved back in reads of every length around the chunk size
+    static const size_t reads[] = { 1, 5, 64, WEB_CONFIG_RECV_CHUNK - 1, WEB_CONFIG_RECV_CHUNK, 0 };
+    for (size_t i = 0; i < sizeof(reads) / sizeof(reads[0]); i++) {
+        memset(&config_body, 0, sizeof(config_body));
+        config_schema_defaults(&config_body.cfg);
+        mem = (http_io_mem_t){ .body = body, .body_len = len, .recv_max = reads[i],
+                               .out = out, .out_cap = sizeof(out) };
+        http_io_init_mem(&io, &mem);
+
+        TEST_ASSERT_EQUAL(ESP_OK, web_config_receive(&io, &config_body));
+        TEST_ASSERT_EQUAL(len, mem.pos);
+        TEST_ASSERT_EQUAL(0, mem.out_len);      // The caller answers a good save
+        TEST_ASSERT_EQUAL(ESP_OK, config_body.parse_err);
+        TEST_ASSERT_GREATER_THAN(5, config_body.fields_set);
+        TEST_ASSERT_TRUE(config_body.have_boot_count);
+        TEST_ASSERT_EQUAL(42, config_body.boot_count);
+        TEST_ASSERT_EQUAL_MEMORY(&sent, &config_body.cfg, sizeof(sent));
+    }
+}
+
+static void test_config_save_partial(void) {
+    static const char json[] = "{\"mqttPort\":1884,\"mqttQos\":7,\"nested\":{\"mqttPort\":1},\"unknown\":\"x\"}";
+    device_config_t before;
+    device_config_t defaults;
+    http_io_mem_t mem = { .body = json, .body_len = sizeof(json) - 1, .recv_max = 3,
+                          .out = out, .out_cap = sizeof(out) };
+    http_io_t io;
+
+    memset(&defaults, 0, sizeof(defaults));
+    config_schema_defaults(&defaults);
+    modified_config(&before);
+    config_body.cfg = before;
+    http_io_init_mem(&io, &mem);
+
+    // Only the top-level schema members land; an out-of-range number falls back to the default
+    TEST_ASSERT_EQUAL(ESP_OK, web_config_receive(&io, &config_body));
+    TEST_ASSERT_EQUAL(2, config_body.fields_set);
+    TEST_ASSERT_FALSE(config_body.have_boot_count);
+    TEST_ASSERT_EQUAL(1884, config_body.cfg.mqtt_port);
+    TEST_ASSERT_EQUAL(defaults.mqtt_qos, config_body.cfg.mqtt_qos);
+    before.mqtt_port = 1884;
+    before.mqtt_qos = defaults.mqtt_qos;
+    TEST_ASSERT_EQUAL_MEMORY(&before, &config_body.cfg, sizeof(before));
+}
+
+static void test_config_save_rejects(void) {
+    static const char bad[] = "{\"mqttPort\":1884,\"mqttQos\":}  trailing bytes the reader never sees";
+    http_io_mem_t mem = { .body = bad, .body_len = sizeof(bad) - 1, .recv_max = 8,
+                          .out = out, .out_cap = sizeof(out) - 1 };
+    http_io_t io;
+
+    // Invalid JSON: a 400 with a JSON body, and the request drained
+    http_io_init_mem(&io, &mem);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, web_config_receive(&io, &config_body));
+    out[mem.out_len] = '\0';
+    TEST_ASSERT_EQUAL(400, mem.status);
+    TEST_ASSERT_EQUAL_STRING("application/json", mem.type);
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"status\":\"error\""));
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, config_body.parse_err);
+    TEST_ASSERT_EQUAL(mem.body_len, mem.pos);
+
+    // Empty
+    mem = (http_io_mem_t){ .body = bad, .body_len = 0, .out = out, .out_cap = sizeof(out) };
+    http_io_init_mem(&io, &mem);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, web_config_receive(&io, &config_body));
+    TEST_ASSERT_EQUAL(400, mem.status);
+
+    // Refused by its length before anything is read
+    mem = (http_io_mem_t){ .body = bad, .body_len = WEB_CONFIG_MAX_BODY + 1, .out = out, .out_cap = sizeof(out) };
+    http_io_init_mem(&io, &mem);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, web_config_receive(&io, &config_body));
+    TEST_ASSERT_EQUAL(400, mem.status);
+    TEST_ASSERT_EQUAL(0, mem.pos);
+}
+
+static void test_config_blob_round_trip(void) {
+    static uint8_t blob[CONFIG_SCHEMA_BLOB_MAX];
+    static uint8_t buf[CONFIG_SCHEMA_BLOB_MAX];
+    device_config_t sent;
+    device_config_t got;
+    config_import_result_t result;
+    http_io_mem_t mem = { .out = (char *)blob, .out_cap = sizeof(blob) };
+    http_io_t io;
+
+    modified_config(&sent);
+    http_io_init_mem(&io, &mem);
+    TEST_ASSERT_EQUAL(ESP_OK, web_config_export(&io, &sent, false, buf));
+    TEST_ASSERT_EQUAL_STRING("application/octet-stream", mem.type);
+    TEST_ASSERT_GREATER_THAN(0, mem.out_len);
+    size_t len = mem.out_len;
+
+    memset(&got, 0, sizeof(got));
+    config_schema_defaults(&got);
+    mem = (http_io_mem_t){ .body = (const char *)blob, .body_len = len, .recv_max = 11,
+                           .out = out, .out_cap = sizeof(out) };
+    http_io_init_mem(&io, &mem);
+    TEST_ASSERT_EQUAL(ESP_OK, web_config_import(&io, &got, buf, &result));
+    TEST_ASSERT_EQUAL(0, result.unknown);
+    TEST_ASSERT_EQUAL_MEMORY(&sent, &got, sizeof(sent));
+
+    // A flipped bit fails the CRC
+    blob[len / 2] ^= 0x10;
+    mem = (http_io_mem_t){ .body = (const char *)blob, .body_len = len, .out = out, .out_cap = sizeof(out) };
+    http_io_init_mem(&io, &mem);
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, web_config_import(&io, &got, buf, &result));
+    TEST_ASSERT_EQUAL(400, mem.status);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_ota_upload_split_across_reads);
+    RUN_TEST(test_ota_hash_header_and_field);
+    RUN_TEST(test_ota_rejects);
+    RUN_TEST(test_config_get);
+    RUN_TEST(test_config_save_round_trip);
+    RUN_TEST(test_config_save_partial);
+    RUN_TEST(test_config_save_rejects);
+    RUN_TEST(test_config_blob_round_trip);
+    return UNITY_END();
+}